@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "CoverArt.hxx"
+#include "tag/TagHandler.hxx"
+#include "tag/TagScanFile.hxx"
+#include "tag/HeaderScan.hxx"
+#include "fs/Path.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "fs/io/FileReader.hxx"
+#include "util/ASCII.hxx"
+#include "util/Macros.hxx"
+#include "util/Error.hxx"
+
+#include <string.h>
+
+/**
+ * The base names (without suffix) of image files which are
+ * recognized as cover art, in order of preference.
+ */
+static constexpr const char *cover_names[] = {
+	"cover",
+	"folder",
+	"front",
+};
+
+static constexpr struct {
+	const char *suffix, *mime_type;
+} cover_suffixes[] = {
+	{ "jpg", "image/jpeg" },
+	{ "jpeg", "image/jpeg" },
+	{ "png", "image/png" },
+	{ "webp", "image/webp" },
+};
+
+/**
+ * Check if the file name is a cover image.
+ *
+ * @param rank receives the index in #cover_names
+ * @return the MIME type or nullptr
+ */
+static const char *
+GetCoverMimeType(const char *name, unsigned &rank)
+{
+	const char *dot = strrchr(name, '.');
+	if (dot == nullptr)
+		return nullptr;
+
+	const char *mime_type = nullptr;
+	for (const auto &i : cover_suffixes) {
+		if (StringEqualsCaseASCII(dot + 1, i.suffix)) {
+			mime_type = i.mime_type;
+			break;
+		}
+	}
+
+	if (mime_type == nullptr)
+		return nullptr;
+
+	const size_t length = dot - name;
+	for (unsigned i = 0; i < ARRAY_SIZE(cover_names); ++i) {
+		if (strlen(cover_names[i]) == length &&
+		    StringEqualsCaseASCII(name, cover_names[i], length)) {
+			rank = i;
+			return mime_type;
+		}
+	}
+
+	return nullptr;
+}
+
+bool
+CoverArt::IsCurrent() const
+{
+	FileInfo fi;
+	return GetFileInfo(source, fi) &&
+		fi.GetModificationTime() == source_mtime;
+}
+
+bool
+CoverArt::IsFor(Path song_fs) const
+{
+	return !embedded || source == AllocatedPath(song_fs);
+}
+
+bool
+CoverArt::LoadImageFile(Path path_fs)
+{
+	FileInfo fi;
+	if (!GetFileInfo(path_fs, fi) || !fi.IsRegular() ||
+	    fi.GetSize() == 0 || fi.GetSize() > TAG_MAX_PICTURE_SIZE)
+		return false;
+
+	Error error;
+	FileReader reader(path_fs, error);
+	if (!reader.IsDefined())
+		return false;
+
+	data.resize(fi.GetSize());
+
+	size_t fill = 0;
+	while (fill < data.size()) {
+		size_t nbytes = reader.Read(&data[fill], data.size() - fill,
+					    error);
+		if (nbytes == 0) {
+			data.clear();
+			return false;
+		}
+
+		fill += nbytes;
+	}
+
+	source = AllocatedPath(path_fs);
+	source_mtime = fi.GetModificationTime();
+	embedded = false;
+	return true;
+}
+
+bool
+CoverArt::LoadDirectory(Path directory_fs)
+{
+	DirectoryReader reader(directory_fs);
+	if (reader.HasFailed())
+		return false;
+
+	/* find the most preferred image file name */
+	AllocatedPath best = AllocatedPath::Null();
+	const char *best_mime_type = nullptr;
+	unsigned best_rank = ARRAY_SIZE(cover_names);
+
+	while (reader.ReadEntry()) {
+		const std::string name_utf8 = reader.GetEntry().ToUTF8();
+		unsigned rank;
+		const char *m = GetCoverMimeType(name_utf8.c_str(), rank);
+		if (m != nullptr && rank < best_rank) {
+			best = AllocatedPath::Build(directory_fs,
+						    reader.GetEntry());
+			best_mime_type = m;
+			best_rank = rank;
+		}
+	}
+
+	if (best.IsNull() || !LoadImageFile(best))
+		return false;
+
+	mime_type = best_mime_type;
+	return true;
+}
+
+struct EmbeddedPicture {
+	std::string mime_type, data;
+	unsigned type;
+
+	EmbeddedPicture():type(0) {}
+
+	bool IsFrontCover() const {
+		return !data.empty() && type == TAG_PICTURE_FRONT_COVER;
+	}
+};
+
+static void
+embedded_picture_handler(const char *mime_type, unsigned type,
+			 ConstBuffer<void> data, void *ctx)
+{
+	EmbeddedPicture &picture = *(EmbeddedPicture *)ctx;
+
+	/* the front cover wins; else use the first picture */
+	if (data.IsEmpty() || picture.IsFrontCover() ||
+	    (!picture.data.empty() && type != TAG_PICTURE_FRONT_COVER))
+		return;
+
+	picture.mime_type = mime_type;
+	picture.data.assign((const char *)data.data, data.size);
+	picture.type = type;
+}
+
+static constexpr tag_handler embedded_picture_tag_handler = {
+	nullptr,
+	nullptr,
+	nullptr,
+	embedded_picture_handler,
+};
+
+void
+CoverArt::LoadEmbedded(Path song_fs)
+{
+	source = AllocatedPath(song_fs);
+	embedded = true;
+
+	FileInfo fi;
+	if (!GetFileInfo(song_fs, fi))
+		return;
+
+	source_mtime = fi.GetModificationTime();
+
+	LocalTagScanFile file(song_fs);
+	if (!file.IsDefined())
+		return;
+
+	EmbeddedPicture picture;
+	if (!tag_header_scan(file, song_fs, embedded_picture_tag_handler,
+			     &picture) ||
+	    picture.data.empty())
+		tag_ape_id3_scan(file, &embedded_picture_tag_handler,
+				 &picture);
+
+	mime_type = std::move(picture.mime_type);
+	data = std::move(picture.data);
+}
+
+void
+CoverArt::Load(Path song_fs)
+{
+	mime_type.clear();
+	data.clear();
+
+	const AllocatedPath directory_fs = song_fs.GetDirectoryName();
+	if (!directory_fs.IsNull() && LoadDirectory(directory_fs))
+		return;
+
+	LoadEmbedded(song_fs);
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_COVER_ART_HXX
+#define MPD_COVER_ART_HXX
+
+#include "check.h"
+#include "fs/AllocatedPath.hxx"
+#include "Compiler.h"
+
+#include <string>
+
+#include <time.h>
+
+class Path;
+
+/**
+ * The cover art of a song: an image file in the song's directory
+ * (e.g. "cover.jpg"), or else the picture embedded in the song's
+ * tags.
+ */
+struct CoverArt {
+	/**
+	 * The file the picture was read from: the image file or the
+	 * song itself.
+	 */
+	AllocatedPath source;
+
+	/**
+	 * The modification time of #source when it was read.
+	 */
+	time_t source_mtime;
+
+	/**
+	 * Was the picture embedded in #source (or was #source
+	 * searched for an embedded picture without success)?  Such
+	 * an entry is only valid for this one song, while an image
+	 * file is shared by all songs in the directory.
+	 */
+	bool embedded;
+
+	/**
+	 * The MIME type of the image; empty if unknown.
+	 */
+	std::string mime_type;
+
+	/**
+	 * The image data.  Empty if the song has no cover art.
+	 */
+	std::string data;
+
+	CoverArt()
+		:source(AllocatedPath::Null()), source_mtime(0),
+		 embedded(false) {}
+
+	bool IsEmpty() const {
+		return data.empty();
+	}
+
+	/**
+	 * Has #source not been modified since it was read?
+	 */
+	gcc_pure
+	bool IsCurrent() const;
+
+	/**
+	 * Can this object be used for the specified song?
+	 */
+	gcc_pure
+	bool IsFor(Path song_fs) const;
+
+	/**
+	 * Load the cover art of the specified song.  This performs
+	 * blocking I/O.  If there is none, the object remains empty,
+	 * and this negative result is remembered for the song.
+	 */
+	void Load(Path song_fs);
+
+private:
+	bool LoadDirectory(Path directory_fs);
+	bool LoadImageFile(Path path_fs);
+	void LoadEmbedded(Path song_fs);
+};
+
+#endif
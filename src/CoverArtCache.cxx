@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "CoverArtCache.hxx"
+#include "CoverArt.hxx"
+
+#include <iterator>
+
+#include <assert.h>
+
+size_t
+CoverArtCache::Entry::GetMemorySize() const
+{
+	return sizeof(*this) + sizeof(*cover) + directory.length() +
+		cover->source.length() + cover->mime_type.length() +
+		cover->data.length();
+}
+
+void
+CoverArtCache::Erase(List::iterator i)
+{
+	assert(memory_size >= i->GetMemorySize());
+
+	memory_size -= i->GetMemorySize();
+	map.erase(i->directory);
+	list.erase(i);
+}
+
+std::shared_ptr<const CoverArt>
+CoverArtCache::Lookup(const std::string &directory, time_t mtime)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(directory);
+	if (i == map.end())
+		return nullptr;
+
+	const List::iterator entry = i->second;
+	if (entry->mtime != mtime) {
+		/* the directory has been modified; the entry is
+		   stale */
+		Erase(entry);
+		return nullptr;
+	}
+
+	/* mark it "most recently used" */
+	list.splice(list.begin(), list, entry);
+
+	return entry->cover;
+}
+
+void
+CoverArtCache::Store(const std::string &directory, time_t mtime,
+		     std::shared_ptr<const CoverArt> cover)
+{
+	assert(cover != nullptr);
+
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(directory);
+	if (i != map.end())
+		Erase(i->second);
+
+	list.emplace_front(directory, mtime, std::move(cover));
+	const size_t entry_size = list.front().GetMemorySize();
+	if (entry_size > capacity) {
+		list.pop_front();
+		return;
+	}
+
+	map.emplace(directory, list.begin());
+	memory_size += entry_size;
+
+	/* evict the least recently used entries */
+	while (memory_size > capacity)
+		Erase(std::prev(list.end()));
+}
+
+void
+CoverArtCache::Remove(const std::string &directory)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(directory);
+	if (i != map.end())
+		Erase(i->second);
+}
+
+void
+CoverArtCache::Clear()
+{
+	const ScopeLock protect(mutex);
+
+	map.clear();
+	list.clear();
+	memory_size = 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_COVER_ART_CACHE_HXX
+#define MPD_COVER_ART_CACHE_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "Compiler.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <stddef.h>
+#include <time.h>
+
+struct CoverArt;
+
+/**
+ * A cache of #CoverArt objects, keyed by the directory of the song
+ * and the directory's modification time, so the "albumart" command,
+ * which is repeated for each chunk and usually for all songs of an
+ * album, does not need to read the picture again.  Adding or
+ * removing a cover image modifies the directory, which makes the
+ * entry miss.
+ *
+ * The capacity is measured in bytes.  When the cache is full, the
+ * least recently used entries are evicted.  This class is
+ * thread-safe.
+ */
+class CoverArtCache {
+	struct Entry {
+		std::string directory;
+		time_t mtime;
+
+		std::shared_ptr<const CoverArt> cover;
+
+		Entry(const std::string &_directory, time_t _mtime,
+		      std::shared_ptr<const CoverArt> &&_cover)
+			:directory(_directory), mtime(_mtime),
+			 cover(std::move(_cover)) {}
+
+		gcc_pure
+		size_t GetMemorySize() const;
+	};
+
+	typedef std::list<Entry> List;
+
+	const size_t capacity;
+
+	mutable Mutex mutex;
+
+	/**
+	 * The sum of Entry::GetMemorySize() of all entries.
+	 */
+	size_t memory_size;
+
+	/**
+	 * All entries, the most recently used one first.
+	 */
+	List list;
+
+	std::map<std::string, List::iterator> map;
+
+public:
+	explicit CoverArtCache(size_t _capacity)
+		:capacity(_capacity), memory_size(0) {}
+
+	CoverArtCache(const CoverArtCache &) = delete;
+	CoverArtCache &operator=(const CoverArtCache &) = delete;
+
+	gcc_pure
+	unsigned GetSize() const {
+		const ScopeLock protect(mutex);
+		return map.size();
+	}
+
+	gcc_pure
+	size_t GetMemorySize() const {
+		const ScopeLock protect(mutex);
+		return memory_size;
+	}
+
+	/**
+	 * Look up a directory.
+	 *
+	 * @return the cover art or nullptr if there is no valid entry
+	 */
+	std::shared_ptr<const CoverArt> Lookup(const std::string &directory,
+					       time_t mtime);
+
+	/**
+	 * Add or replace the entry of a directory.
+	 */
+	void Store(const std::string &directory, time_t mtime,
+		   std::shared_ptr<const CoverArt> cover);
+
+	/**
+	 * Remove the entry of a directory, e.g. because the picture
+	 * file has been modified.
+	 */
+	void Remove(const std::string &directory);
+
+	void Clear();
+
+private:
+	void Erase(List::iterator i);
+};
+
+#endif
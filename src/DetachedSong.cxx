@@ -24,28 +24,85 @@
 #include "fs/Traits.hxx"
 
 DetachedSong::DetachedSong(const LightSong &other)
-	:uri(other.GetURI().c_str()),
-	 real_uri(other.real_uri != nullptr ? other.real_uri : ""),
+	:uri(other.GetURI()),
+	 real_uri_is_prefix(false),
 	 tag(*other.tag),
 	 mtime(other.mtime),
 	 start_time(other.start_time),
-	 end_time(other.end_time) {}
+	 end_time(other.end_time)
+{
+	if (other.real_uri != nullptr)
+		SetRealURI(other.real_uri);
+}
 
 DetachedSong::~DetachedSong()
 {
 	/* this destructor exists here just so it won't  inlined */
 }
 
+void
+DetachedSong::SetURI(SharedUri &&_uri)
+{
+	if (real_uri_is_prefix) {
+		/* the real URI depends on the old URI; store it
+		   completely */
+		real_uri = SharedUri(GetRealURI());
+		real_uri_is_prefix = false;
+	}
+
+	uri = std::move(_uri);
+}
+
+std::string
+DetachedSong::GetRealURI() const
+{
+	if (!HasRealURI())
+		return uri.c_str();
+
+	std::string result(real_uri.c_str(), real_uri.length());
+	if (real_uri_is_prefix)
+		result.append(uri.c_str(), uri.length());
+	return result;
+}
+
+void
+DetachedSong::SetRealURI(const char *_uri, size_t length)
+{
+	/* if the real URI ends with "/" + uri (e.g. the music
+	   directory followed by the relative URI), store only the
+	   prefix */
+	const size_t uri_length = uri.length();
+	if (uri_length > 0 && length > uri_length &&
+	    _uri[length - uri_length - 1] == '/' &&
+	    memcmp(_uri + length - uri_length, uri.c_str(), uri_length) == 0) {
+		real_uri = SharedUri(_uri, length - uri_length);
+		real_uri_is_prefix = true;
+	} else {
+		real_uri = SharedUri(_uri, length);
+		real_uri_is_prefix = false;
+	}
+}
+
 bool
 DetachedSong::IsRemote() const
 {
-	return uri_has_scheme(GetRealURI());
+	if (!HasRealURI())
+		return uri_has_scheme(GetURI());
+
+	/* the prefix ends with a slash, therefore "://" cannot span
+	   both parts */
+	return uri_has_scheme(real_uri.c_str()) ||
+		(real_uri_is_prefix && uri_has_scheme(GetURI()));
 }
 
 bool
 DetachedSong::IsAbsoluteFile() const
 {
-	return PathTraitsUTF8::IsAbsolute(GetRealURI());
+	/* this only checks the beginning of the real URI, which is
+	   the prefix if #real_uri_is_prefix is set */
+	return PathTraitsUTF8::IsAbsolute(HasRealURI()
+					  ? real_uri.c_str()
+					  : GetURI());
 }
 
 bool
@@ -63,10 +120,11 @@ DetachedSong::GetDuration() const
 {
 	SongTime a = start_time, b = end_time;
 	if (!b.IsPositive()) {
-		if (tag.duration.IsNegative())
-			return tag.duration;
+		const SignedSongTime duration = tag->duration;
+		if (duration.IsNegative())
+			return duration;
 
-		b = SongTime(tag.duration);
+		b = SongTime(duration);
 	}
 
 	return SignedSongTime(b - a);
@@ -22,12 +22,15 @@
 
 #include "check.h"
 #include "tag/Tag.hxx"
+#include "tag/SharedTag.hxx"
+#include "SharedUri.hxx"
 #include "Chrono.hxx"
 #include "Compiler.h"
 
 #include <string>
 #include <utility>
 
+#include <string.h>
 #include <time.h>
 
 struct LightSong;
@@ -47,8 +50,11 @@ class DetachedSong {
 	 * - an absolute file name
 	 *
 	 * - a file name relative to the music directory
+	 *
+	 * The string is shared with all other songs with the same
+	 * URI, so IsSame() only compares pointers.
 	 */
-	std::string uri;
+	SharedUri uri;
 
 	/**
 	 * The "real" URI, the one to be used for opening the
@@ -56,11 +62,21 @@ class DetachedSong {
 	 * used.
 	 *
 	 * This attribute is used for songs from the database which
-	 * have a relative URI.
+	 * have a relative URI.  Usually, the real URI is the storage
+	 * location followed by #uri; in that case, only that prefix
+	 * is stored here (and shared by all songs from the same
+	 * storage), and #real_uri_is_prefix is set.
 	 */
-	std::string real_uri;
+	SharedUri real_uri;
 
-	Tag tag;
+	bool real_uri_is_prefix;
+
+	/**
+	 * The song's tag; it is shared with all other songs that
+	 * have an equal one, so copies of a song (e.g. queue entries
+	 * added from the database) don't duplicate it.
+	 */
+	SharedTag tag;
 
 	time_t mtime;
 
@@ -81,23 +97,18 @@ public:
 	explicit DetachedSong(const DetachedSong &) = default;
 
 	explicit DetachedSong(const char *_uri)
-		:uri(_uri),
+		:uri(_uri), real_uri_is_prefix(false),
 		 mtime(0),
 		 start_time(SongTime::zero()), end_time(SongTime::zero()) {}
 
 	explicit DetachedSong(const std::string &_uri)
-		:uri(_uri),
-		 mtime(0),
-		 start_time(SongTime::zero()), end_time(SongTime::zero()) {}
-
-	explicit DetachedSong(std::string &&_uri)
-		:uri(std::move(_uri)),
+		:uri(_uri), real_uri_is_prefix(false),
 		 mtime(0),
 		 start_time(SongTime::zero()), end_time(SongTime::zero()) {}
 
 	template<typename U>
 	DetachedSong(U &&_uri, Tag &&_tag)
-		:uri(std::forward<U>(_uri)),
+		:uri(std::forward<U>(_uri)), real_uri_is_prefix(false),
 		 tag(std::move(_tag)),
 		 mtime(0),
 		 start_time(SongTime::zero()), end_time(SongTime::zero()) {}
@@ -111,11 +122,16 @@ public:
 		return uri.c_str();
 	}
 
-	template<typename T>
-	void SetURI(T &&_uri) {
-		uri = std::forward<T>(_uri);
+	void SetURI(const char *_uri) {
+		SetURI(SharedUri(_uri));
 	}
 
+	void SetURI(const std::string &_uri) {
+		SetURI(SharedUri(_uri));
+	}
+
+	void SetURI(SharedUri &&_uri);
+
 	/**
 	 * Does this object have a "real" URI different from the
 	 * displayed URI?
@@ -130,15 +146,18 @@ public:
 	 * GetURI().
 	 */
 	gcc_pure
-	const char *GetRealURI() const {
-		return (HasRealURI() ? real_uri : uri).c_str();
+	std::string GetRealURI() const;
+
+	void SetRealURI(const char *_uri) {
+		SetRealURI(_uri, strlen(_uri));
 	}
 
-	template<typename T>
-	void SetRealURI(T &&_uri) {
-		real_uri = std::forward<T>(_uri);
+	void SetRealURI(const std::string &_uri) {
+		SetRealURI(_uri.data(), _uri.length());
 	}
 
+	void SetRealURI(const char *_uri, size_t length);
+
 	/**
 	 * Returns true if both objects refer to the same physical
 	 * song.
@@ -150,6 +169,14 @@ public:
 
 	gcc_pure gcc_nonnull_all
 	bool IsURI(const char *other_uri) const {
+		return strcmp(uri.c_str(), other_uri) == 0;
+	}
+
+	/**
+	 * Like IsURI(), but only compares pointers.
+	 */
+	gcc_pure
+	bool IsURI(const SharedUri &other_uri) const {
 		return uri == other_uri;
 	}
 
@@ -168,19 +195,23 @@ public:
 	bool IsInDatabase() const;
 
 	const Tag &GetTag() const {
-		return tag;
+		return *tag;
 	}
 
-	Tag &WritableTag() {
+	const SharedTag &GetSharedTag() const {
 		return tag;
 	}
 
 	void SetTag(const Tag &_tag) {
-		tag = Tag(_tag);
+		tag = SharedTag(_tag);
 	}
 
 	void SetTag(Tag &&_tag) {
-		tag = std::move(_tag);
+		tag = SharedTag(std::move(_tag));
+	}
+
+	void SetTag(const SharedTag &_tag) {
+		tag = _tag;
 	}
 
 	void MoveTagFrom(DetachedSong &&other) {
@@ -35,13 +35,12 @@ IcyMetaDataParser::Reset()
 	if (!IsDefined())
 		return;
 
-	if (data_rest == 0 && meta_size > 0)
-		delete[] meta_data;
-
 	delete tag;
+	tag = nullptr;
 
 	data_rest = data_size;
 	meta_size = 0;
+	have_last_meta = false;
 }
 
 size_t
@@ -122,6 +121,7 @@ icy_parse_tag(char *p, char *const end)
 	assert(p <= end);
 
 	TagBuilder tag;
+	tag.SetTransient();
 
 	while (p != end) {
 		const char *const name = p;
@@ -163,6 +163,27 @@ icy_parse_tag(char *p, char *const end)
 	return tag.CommitNew();
 }
 
+void
+IcyMetaDataParser::OnMetaBlock()
+{
+	/* ignore the null padding */
+	size_t size = meta_size;
+	while (size > 0 && meta_data[size - 1] == 0)
+		--size;
+
+	if (have_last_meta && size == last_meta_size &&
+	    memcmp(meta_data, last_meta, size) == 0)
+		/* unchanged; don't emit a duplicate tag */
+		return;
+
+	memcpy(last_meta, meta_data, size);
+	last_meta_size = size;
+	have_last_meta = true;
+
+	delete tag;
+	tag = icy_parse_tag(meta_data, meta_data + size);
+}
+
 size_t
 IcyMetaDataParser::Meta(const void *data, size_t length)
 {
@@ -186,10 +207,8 @@ IcyMetaDataParser::Meta(const void *data, size_t length)
 		   return value */
 		--length;
 
-		/* initialize metadata reader, allocate enough
-		   memory (+1 for the null terminator) */
+		/* initialize metadata reader */
 		meta_position = 0;
-		meta_data = new char[meta_size + 1];
 	}
 
 	assert(meta_position < meta_size);
@@ -205,12 +224,7 @@ IcyMetaDataParser::Meta(const void *data, size_t length)
 		++length;
 
 	if (meta_position == meta_size) {
-		/* parse */
-
-		delete tag;
-
-		tag = icy_parse_tag(meta_data, meta_data + meta_size);
-		delete[] meta_data;
+		OnMetaBlock();
 
 		/* change back to normal data mode */
 
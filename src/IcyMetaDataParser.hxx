@@ -25,15 +25,40 @@
 struct Tag;
 
 class IcyMetaDataParser {
+	/**
+	 * The maximum size of a metadata block: its length byte is
+	 * multiplied by 16.
+	 */
+	static constexpr size_t MAX_META_SIZE = 255 * 16;
+
 	size_t data_size, data_rest;
 
 	size_t meta_size, meta_position;
-	char *meta_data;
+
+	/**
+	 * The metadata block which is being received.  This is a
+	 * fixed buffer, to avoid an allocation for each block.
+	 */
+	char meta_data[MAX_META_SIZE];
+
+	/**
+	 * A copy of the most recently parsed metadata block (without
+	 * its null padding).  Most stations repeat the same block
+	 * until the song changes; those are not parsed again, and no
+	 * new #Tag is emitted.
+	 */
+	char last_meta[MAX_META_SIZE];
+	size_t last_meta_size;
+	bool have_last_meta;
 
 	Tag *tag;
 
 public:
 	IcyMetaDataParser():data_size(0) {}
+
+	IcyMetaDataParser(const IcyMetaDataParser &) = delete;
+	IcyMetaDataParser &operator=(const IcyMetaDataParser &) = delete;
+
 	~IcyMetaDataParser() {
 		Reset();
 	}
@@ -45,6 +70,7 @@ public:
 	void Start(size_t _data_size) {
 		data_size = data_rest = _data_size;
 		meta_size = 0;
+		have_last_meta = false;
 		tag = nullptr;
 	}
 
@@ -82,6 +108,14 @@ public:
 	 */
 	size_t ParseInPlace(void *data, size_t length);
 
+private:
+	/**
+	 * A metadata block has been received completely.
+	 */
+	void OnMetaBlock();
+
+public:
+
 	Tag *ReadTag() {
 		Tag *result = tag;
 		tag = nullptr;
@@ -26,6 +26,7 @@
 #include "Idle.hxx"
 #include "GlobalEvents.hxx"
 #include "util/ASCII.hxx"
+#include "util/Macros.hxx"
 
 #include <atomic>
 
@@ -50,6 +51,9 @@ static const char *const idle_names[] = {
 	nullptr
 };
 
+static_assert(ARRAY_SIZE(idle_names) == IDLE_NUM + 1,
+	      "IDLE_NUM does not match idle_names");
+
 void
 idle_add(unsigned flags)
 {
@@ -67,6 +67,9 @@ static constexpr unsigned IDLE_NEIGHBOR = 0x800;
 /** the mount list has changed */
 static constexpr unsigned IDLE_MOUNT = 0x1000;
 
+/** the number of idle flags */
+static constexpr unsigned IDLE_NUM = 13;
+
 /**
  * Adds idle flag (with bitwise "or") and queues notifications to all
  * clients.
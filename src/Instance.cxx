@@ -31,16 +31,36 @@
 #ifdef ENABLE_SQLITE
 #include "sticker/StickerDatabase.hxx"
 #include "sticker/SongSticker.hxx"
+#include "loudness/Service.hxx"
 #endif
 
 Database *
 Instance::GetDatabase(Error &error)
 {
-	if (database == nullptr)
-		error.Set(db_domain, DB_DISABLED, "No database");
+	if (database == nullptr) {
+		if (IsDatabaseLoading())
+			error.Set(db_domain, DB_LOADING,
+				  "Database is loading");
+		else
+			error.Set(db_domain, DB_DISABLED, "No database");
+	}
+
 	return database;
 }
 
+void
+Instance::DatabaseLoaded(Database &db)
+{
+	assert(database == nullptr);
+	assert(database_loader == nullptr);
+
+	database = &db;
+
+	/* fill in the tags of the songs restored from the state
+	   file */
+	OnDatabaseModified();
+}
+
 #endif
 
 void
@@ -67,6 +87,11 @@ Instance::OnDatabaseModified()
 	stats_invalidate();
 	partition->DatabaseModified(*database);
 	idle_add(IDLE_DATABASE);
+
+#ifdef ENABLE_SQLITE
+	if (loudness != nullptr)
+		loudness->Rescan(*database);
+#endif
 }
 
 void
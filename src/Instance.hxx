@@ -31,8 +31,12 @@ class NeighborGlue;
 #ifdef ENABLE_DATABASE
 #include "db/DatabaseListener.hxx"
 class Database;
+class DatabaseLoader;
 class Storage;
 class UpdateService;
+#ifdef ENABLE_SQLITE
+class LoudnessService;
+#endif
 #endif
 
 class EventLoop;
@@ -70,6 +74,21 @@ struct Instance final
 	Storage *storage;
 
 	UpdateService *update;
+
+	/**
+	 * Loads the database in a separate thread during startup.
+	 * While this is set, #database is nullptr and GetDatabase()
+	 * fails with #DB_LOADING.
+	 */
+	DatabaseLoader *database_loader;
+
+#ifdef ENABLE_SQLITE
+	/**
+	 * Measures songs without ReplayGain or MixRamp tags; nullptr if
+	 * "loudness_analysis" is disabled.
+	 */
+	LoudnessService *loudness;
+#endif
 #endif
 
 	ClientList *client_list;
@@ -80,6 +99,10 @@ struct Instance final
 #ifdef ENABLE_DATABASE
 		storage = nullptr;
 		update = nullptr;
+		database_loader = nullptr;
+#ifdef ENABLE_SQLITE
+		loudness = nullptr;
+#endif
 #endif
 	}
 
@@ -87,9 +110,21 @@ struct Instance final
 	/**
 	 * Returns the global #Database instance.  May return nullptr
 	 * if this MPD configuration has no database (no
-	 * music_directory was configured).
+	 * music_directory was configured) or while the database is
+	 * still being loaded.
 	 */
 	Database *GetDatabase(Error &error);
+
+	bool IsDatabaseLoading() const {
+		return database_loader != nullptr;
+	}
+
+	/**
+	 * The #DatabaseLoader has finished: make the #Database
+	 * available and update the subsystems which were initialized
+	 * without it.
+	 */
+	void DatabaseLoaded(Database &db);
 #endif
 
 	/**
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "LatencyProfile.hxx"
+#include "config/Param.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "system/FatalError.hxx"
+
+#include <assert.h>
+#include <string.h>
+
+LatencyProfile latency_profile = LatencyProfile::NORMAL;
+
+static constexpr LatencySettings latency_settings[] = {
+	/* LOW: 20 ms ALSA buffer in 4 periods, start right away */
+	{ 0, 8, 20000, 5000, 10 },
+
+	/* NORMAL */
+	{ 10, 64, 500000, 0, 100 },
+
+	/* HIGH */
+	{ 20, 128, 1000000, 0, 1000 },
+};
+
+const char *
+latency_profile_to_string(LatencyProfile profile)
+{
+	switch (profile) {
+	case LatencyProfile::LOW:
+		return "low";
+
+	case LatencyProfile::NORMAL:
+		return "normal";
+
+	case LatencyProfile::HIGH:
+		return "high";
+	}
+
+	assert(false);
+	gcc_unreachable();
+}
+
+const LatencySettings &
+GetLatencySettings(LatencyProfile profile)
+{
+	return latency_settings[unsigned(profile)];
+}
+
+void
+latency_profile_global_init()
+{
+	const struct config_param *param =
+		config_get_param(ConfigOption::LATENCY_PROFILE);
+	if (param == nullptr)
+		return;
+
+	const char *value = param->value.c_str();
+	if (strcmp(value, "low") == 0)
+		latency_profile = LatencyProfile::LOW;
+	else if (strcmp(value, "normal") == 0)
+		latency_profile = LatencyProfile::NORMAL;
+	else if (strcmp(value, "high") == 0)
+		latency_profile = LatencyProfile::HIGH;
+	else
+		FormatFatalError("latency_profile value \"%s\" at line %i is invalid",
+				 value, param->line);
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_LATENCY_PROFILE_HXX
+#define MPD_LATENCY_PROFILE_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <stdint.h>
+
+/**
+ * A global trade-off between latency and robustness, configured with
+ * the "latency_profile" setting.  It provides defaults for several
+ * settings which would otherwise have to be tuned together.
+ */
+enum class LatencyProfile : uint8_t {
+	/**
+	 * Start playback as quickly as possible and keep very little
+	 * audio queued; needs a fast machine and a reliable decoder.
+	 */
+	LOW,
+
+	/**
+	 * The traditional MPD defaults.
+	 */
+	NORMAL,
+
+	/**
+	 * Queue more audio to survive load spikes and slow storage.
+	 */
+	HIGH,
+};
+
+struct LatencySettings {
+	/**
+	 * The default value of "buffer_before_play" in percent.
+	 */
+	unsigned buffer_before_play;
+
+	/**
+	 * The maximum number of chunks the player thread queues for
+	 * the audio outputs.
+	 */
+	unsigned output_chunks;
+
+	/**
+	 * The default "buffer_time" and "period_time" of the ALSA
+	 * output plugin in microseconds; 0 lets libasound choose.
+	 */
+	unsigned alsa_buffer_time, alsa_period_time;
+
+	/**
+	 * The timer slack of the output threads in microseconds.
+	 */
+	unsigned output_timer_slack;
+};
+
+extern LatencyProfile latency_profile;
+
+/**
+ * Load the "latency_profile" setting.  Exits with a fatal error if
+ * the setting is invalid.
+ */
+void
+latency_profile_global_init();
+
+gcc_const
+const char *
+latency_profile_to_string(LatencyProfile profile);
+
+gcc_const
+const LatencySettings &
+GetLatencySettings(LatencyProfile profile);
+
+/**
+ * Returns the settings of the configured #latency_profile.
+ */
+gcc_pure
+static inline const LatencySettings &
+GetLatencySettings()
+{
+	return GetLatencySettings(latency_profile);
+}
+
+#endif
@@ -25,14 +25,24 @@
 #include "config/ConfigOption.hxx"
 #include "net/SocketAddress.hxx"
 #include "event/ServerSocket.hxx"
+#include "event/AsyncResolver.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "Log.hxx"
 
+#include <forward_list>
+#include <string>
+
 #include <string.h>
 #include <assert.h>
 
+#ifdef WIN32
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#endif
+
 #ifdef ENABLE_SYSTEMD_DAEMON
 #include <systemd/sd-daemon.h>
 #endif
@@ -58,6 +68,46 @@ private:
 static ClientListener *listen_socket;
 int listen_port;
 
+/**
+ * A "bind_to_address" host name which is being resolved
+ * asynchronously, so a slow DNS server does not delay the startup.
+ * The listeners are opened as soon as the lookup finishes.
+ */
+class ListenLookup final : ResolverHandler {
+	ResolveRequest request;
+
+	const std::string host;
+	const int line;
+
+public:
+	ListenLookup(EventLoop &_loop, const char *_host, int _line)
+		:request(_loop, resolver_get(), *this),
+		 host(_host), line(_line) {}
+
+	void Start(unsigned port) {
+		request.Start(host.c_str(), port, AI_PASSIVE, SOCK_STREAM);
+	}
+
+private:
+	/* virtual methods from class ResolverHandler */
+	void OnResolverSuccess(const ResolverResult &addresses) override {
+		Error error;
+		if (listen_socket->OpenAddresses(addresses, error))
+			FormatDebug(listen_domain, "listening on %s",
+				    host.c_str());
+		else
+			OnResolverError(error);
+	}
+
+	void OnResolverError(const Error &error) override {
+		FormatError(listen_domain,
+			    "Failed to listen on %s (line %i): %s",
+			    host.c_str(), line, error.GetMessage());
+	}
+};
+
+static std::forward_list<ListenLookup> listen_lookups;
+
 static bool
 listen_add_config_param(unsigned int port,
 			const struct config_param *param,
@@ -72,8 +122,21 @@ listen_add_config_param(unsigned int port,
 		return !path.IsNull() &&
 			listen_socket->AddPath(std::move(path), error_r);
 	} else {
-		return listen_socket->AddHost(param->value.c_str(), port,
-					      error_r);
+		ResolverResult addresses;
+		if (resolver_get().LookupCached(param->value.c_str(), port,
+						AI_PASSIVE, SOCK_STREAM,
+						addresses)) {
+			/* a numeric address: bind it right now, before
+			   privileges are dropped */
+			listen_socket->AddAddresses(addresses);
+			return true;
+		}
+
+		listen_lookups.emplace_front(listen_socket->GetEventLoop(),
+					     param->value.c_str(),
+					     param->line);
+		listen_lookups.front().Start(port);
+		return true;
 	}
 }
 
@@ -123,6 +186,7 @@ listen_global_init(EventLoop &loop, Partition &partition, Error &error)
 
 		do {
 			if (!listen_add_config_param(port, param, error)) {
+				listen_lookups.clear();
 				delete listen_socket;
 				error.FormatPrefix("Failed to listen on %s (line %i): ",
 						   param->value.c_str(),
@@ -142,6 +206,7 @@ listen_global_init(EventLoop &loop, Partition &partition, Error &error)
 	}
 
 	if (!listen_socket->Open(error)) {
+		listen_lookups.clear();
 		delete listen_socket;
 		return false;
 	}
@@ -156,5 +221,6 @@ void listen_global_finish(void)
 
 	assert(listen_socket != nullptr);
 
+	listen_lookups.clear();
 	delete listen_socket;
 }
@@ -20,6 +20,8 @@
 #include "config.h"
 #include "LogBackend.hxx"
 #include "Log.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
 #include "util/Domain.hxx"
 #include "util/StringUtil.hxx"
 
@@ -27,7 +29,10 @@
 #include <glib.h>
 #endif
 
+#include <atomic>
+
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
@@ -102,12 +107,18 @@ EnableLogTimestamp()
 	enable_timestamp = true;
 }
 
-static const char *log_date(void)
+static constexpr size_t LOG_DATE_BUF_SIZE = 16;
+
+static const char *
+log_date(char (&buf)[LOG_DATE_BUF_SIZE], time_t t)
 {
-	static constexpr size_t LOG_DATE_BUF_SIZE = 16;
-	static char buf[LOG_DATE_BUF_SIZE];
-	time_t t = time(nullptr);
-	strftime(buf, LOG_DATE_BUF_SIZE, "%b %d %H:%M : ", localtime(&t));
+#ifdef WIN32
+	const struct tm *tm = localtime(&t);
+#else
+	struct tm tm_buffer;
+	const struct tm *tm = localtime_r(&t, &tm_buffer);
+#endif
+	strftime(buf, LOG_DATE_BUF_SIZE, "%b %d %H:%M : ", tm);
 	return buf;
 }
 
@@ -173,7 +184,7 @@ LogFinishSysLog()
 #endif
 
 static void
-FileLog(const Domain &domain, const char *message)
+FileLog(const Domain &domain, const char *message, time_t t)
 {
 #ifdef HAVE_GLIB
 	char *converted;
@@ -189,8 +200,9 @@ FileLog(const Domain &domain, const char *message)
 		converted = nullptr;
 #endif
 
+	char date_buffer[LOG_DATE_BUF_SIZE];
 	fprintf(stderr, "%s%s: %.*s\n",
-		enable_timestamp ? log_date() : "",
+		enable_timestamp ? log_date(date_buffer, t) : "",
 		domain.GetName(),
 		chomp_length(message), message);
 
@@ -205,6 +217,284 @@ FileLog(const Domain &domain, const char *message)
 #endif
 }
 
+/**
+ * Write a message to the log file or to syslog in the calling
+ * thread.
+ */
+static void
+LogDirect(const Domain &domain, LogLevel level, const char *msg, time_t t)
+{
+#ifdef HAVE_SYSLOG
+	if (enable_syslog) {
+		SysLog(domain, level, msg);
+		return;
+	}
+#else
+	(void)level;
+#endif
+
+	FileLog(domain, msg, t);
+}
+
+/*
+ * The asynchronous log queue: a bounded lock-free multi-producer
+ * queue (after Dmitry Vyukov's design) with a single consumer, the
+ * log thread.  Messages which don't fit are counted and dropped, so
+ * a slow log destination never blocks the audio threads.
+ */
+
+/**
+ * The number of slots; must be a power of two.
+ */
+static constexpr size_t LOG_QUEUE_SIZE = 256;
+
+/**
+ * Longer messages are truncated.
+ */
+static constexpr size_t LOG_MESSAGE_SIZE = 1024;
+
+/**
+ * Identical consecutive messages are written at most once per this
+ * many seconds; the others are counted.
+ */
+static constexpr time_t LOG_REPEAT_INTERVAL = 10;
+
+struct LogQueueSlot {
+	/**
+	 * Equals the position when the slot is free for the
+	 * producer which claims this position, and position+1 when
+	 * the message is ready for the consumer.
+	 */
+	std::atomic<size_t> sequence;
+
+	const Domain *domain;
+	LogLevel level;
+	time_t time;
+	char message[LOG_MESSAGE_SIZE];
+};
+
+static LogQueueSlot log_queue[LOG_QUEUE_SIZE];
+
+static std::atomic_bool log_queue_enabled;
+
+/**
+ * The next position to be claimed by a producer.
+ */
+static std::atomic<size_t> log_queue_head;
+
+/**
+ * The next position to be read by the consumer.  Only accessed by
+ * the consumer.
+ */
+static size_t log_queue_tail;
+
+/**
+ * The number of messages dropped because the queue was full.
+ */
+static std::atomic_ulong log_queue_dropped;
+
+/**
+ * Is the consumer about to wait for #log_queue_cond?  Producers
+ * signal the condition only in this case.
+ */
+static std::atomic_bool log_queue_sleeping;
+
+static Mutex log_queue_mutex;
+static Cond log_queue_cond;
+
+/**
+ * Consumer state for suppressing repeated messages.
+ */
+static struct {
+	const Domain *domain;
+	LogLevel level;
+	char message[LOG_MESSAGE_SIZE];
+
+	/**
+	 * When was the message last written?
+	 */
+	time_t time;
+
+	/**
+	 * The number of suppressed repetitions since then.
+	 */
+	unsigned repeated;
+} log_last;
+
+static constexpr Domain log_queue_domain("log");
+
+static void
+LogQueuePush(const Domain &domain, LogLevel level, const char *msg)
+{
+	size_t position = log_queue_head.load(std::memory_order_relaxed);
+	LogQueueSlot *slot;
+
+	while (true) {
+		slot = &log_queue[position & (LOG_QUEUE_SIZE - 1)];
+		const size_t sequence =
+			slot->sequence.load(std::memory_order_acquire);
+		const intptr_t diff = intptr_t(sequence) - intptr_t(position);
+
+		if (diff == 0) {
+			if (log_queue_head.compare_exchange_weak(position,
+								 position + 1,
+								 std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			/* the queue is full */
+			log_queue_dropped.fetch_add(1,
+						    std::memory_order_relaxed);
+			return;
+		} else
+			position = log_queue_head.load(std::memory_order_relaxed);
+	}
+
+	slot->domain = &domain;
+	slot->level = level;
+	slot->time = time(nullptr);
+	snprintf(slot->message, sizeof(slot->message), "%s", msg);
+	slot->sequence.store(position + 1, std::memory_order_release);
+
+	/* pairs with the fence in LogQueueWait(): either the
+	   consumer sees the new message, or we see that it is about
+	   to sleep */
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (log_queue_sleeping.load(std::memory_order_relaxed)) {
+		const ScopeLock protect(log_queue_mutex);
+		log_queue_cond.signal();
+	}
+}
+
+gcc_pure
+static bool
+LogQueueIsEmpty()
+{
+	const LogQueueSlot &slot =
+		log_queue[log_queue_tail & (LOG_QUEUE_SIZE - 1)];
+	return slot.sequence.load(std::memory_order_acquire) !=
+		log_queue_tail + 1;
+}
+
+/**
+ * Write the "repeated" summary of #log_last, if there is one.
+ */
+static void
+LogFlushRepeated(time_t now)
+{
+	if (log_last.repeated == 0)
+		return;
+
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer),
+		 "last message repeated %u times", log_last.repeated);
+	LogDirect(*log_last.domain, log_last.level, buffer, now);
+
+	log_last.repeated = 0;
+	log_last.time = now;
+}
+
+/**
+ * Write a message from the queue, unless it repeats the previous one
+ * within #LOG_REPEAT_INTERVAL.
+ */
+static void
+LogQueueWrite(const LogQueueSlot &slot)
+{
+	if (log_last.domain == slot.domain &&
+	    log_last.level == slot.level &&
+	    strcmp(log_last.message, slot.message) == 0) {
+		if (slot.time < log_last.time + LOG_REPEAT_INTERVAL) {
+			++log_last.repeated;
+			return;
+		}
+
+		LogFlushRepeated(slot.time);
+	} else {
+		LogFlushRepeated(slot.time);
+
+		log_last.domain = slot.domain;
+		log_last.level = slot.level;
+		strcpy(log_last.message, slot.message);
+	}
+
+	log_last.time = slot.time;
+	LogDirect(*slot.domain, slot.level, slot.message, slot.time);
+}
+
+void
+EnableLogQueue()
+{
+	assert(!log_queue_enabled);
+
+	for (size_t i = 0; i < LOG_QUEUE_SIZE; ++i)
+		log_queue[i].sequence.store(i, std::memory_order_relaxed);
+
+	log_queue_head.store(0, std::memory_order_relaxed);
+	log_queue_tail = 0;
+	log_last.domain = nullptr;
+	log_last.repeated = 0;
+
+	log_queue_enabled.store(true, std::memory_order_release);
+}
+
+void
+DisableLogQueue()
+{
+	log_queue_enabled.store(false, std::memory_order_relaxed);
+}
+
+void
+LogQueueWait(unsigned timeout_ms)
+{
+	const ScopeLock protect(log_queue_mutex);
+
+	log_queue_sleeping.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (LogQueueIsEmpty())
+		log_queue_cond.timed_wait(log_queue_mutex, timeout_ms);
+
+	log_queue_sleeping.store(false, std::memory_order_relaxed);
+}
+
+void
+LogQueueWake()
+{
+	const ScopeLock protect(log_queue_mutex);
+	log_queue_cond.signal();
+}
+
+void
+LogQueueFlush()
+{
+	while (!LogQueueIsEmpty()) {
+		LogQueueSlot &slot =
+			log_queue[log_queue_tail & (LOG_QUEUE_SIZE - 1)];
+		LogQueueWrite(slot);
+
+		slot.sequence.store(log_queue_tail + LOG_QUEUE_SIZE,
+				    std::memory_order_release);
+		++log_queue_tail;
+	}
+
+	const time_t now = time(nullptr);
+
+	const unsigned long dropped =
+		log_queue_dropped.exchange(0, std::memory_order_relaxed);
+	if (dropped > 0) {
+		LogFlushRepeated(now);
+
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer),
+			 "%lu log messages dropped", dropped);
+		LogDirect(log_queue_domain, LogLevel::WARNING, buffer, now);
+	}
+
+	if (log_last.repeated > 0 &&
+	    now >= log_last.time + LOG_REPEAT_INTERVAL)
+		LogFlushRepeated(now);
+}
+
 #endif /* !ANDROID */
 
 void
@@ -218,13 +508,15 @@ Log(const Domain &domain, LogLevel level, const char *msg)
 	if (level < log_threshold)
 		return;
 
-#ifdef HAVE_SYSLOG
-	if (enable_syslog) {
-		SysLog(domain, level, msg);
+	/* errors are rare, and they must not get lost if the
+	   process aborts right afterwards (see FatalError()), so
+	   they bypass the queue */
+	if (level < LogLevel::ERROR &&
+	    log_queue_enabled.load(std::memory_order_acquire)) {
+		LogQueuePush(domain, level, msg);
 		return;
 	}
-#endif
 
-	FileLog(domain, msg);
+	LogDirect(domain, level, msg, time(nullptr));
 #endif /* !ANDROID */
 }
@@ -42,4 +42,38 @@ LogInitSysLog();
 void
 LogFinishSysLog();
 
+/**
+ * From now on, Log() only appends messages to a lock-free queue, and
+ * a thread (see LogInit.cxx) writes them with LogQueueWait() and
+ * LogQueueFlush().
+ */
+void
+EnableLogQueue();
+
+/**
+ * Write messages in the calling thread again.  Call LogQueueFlush()
+ * afterwards to write the remaining queued messages.
+ */
+void
+DisableLogQueue();
+
+/**
+ * Wait until the queue is not empty, or until the timeout expires,
+ * or until LogQueueWake() is called.  Only the log thread may call
+ * this.
+ */
+void
+LogQueueWait(unsigned timeout_ms);
+
+void
+LogQueueWake();
+
+/**
+ * Write all queued messages, and report dropped and repeated
+ * messages.  Only the log thread may call this (or any thread after
+ * it has exited).
+ */
+void
+LogQueueFlush();
+
 #endif /* LOG_H */
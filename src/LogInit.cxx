@@ -27,6 +27,8 @@
 #include "system/FatalError.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/FileSystem.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "system/FatalError.hxx"
@@ -35,6 +37,8 @@
 #include <glib.h>
 #endif
 
+#include <atomic>
+
 #include <assert.h>
 #include <string.h>
 #include <fcntl.h>
@@ -54,6 +58,53 @@ static constexpr Domain log_domain("log");
 static int out_fd;
 static AllocatedPath out_path = AllocatedPath::Null();
 
+/**
+ * The thread which writes log messages, so a slow log destination
+ * does not block the threads which log.
+ */
+static Thread log_thread;
+static std::atomic_bool log_thread_quit;
+
+static void
+log_thread_run(gcc_unused void *ctx)
+{
+	SetThreadName("log");
+
+	while (!log_thread_quit.load(std::memory_order_relaxed)) {
+		/* wake up every second to report suppressed
+		   repetitions */
+		LogQueueWait(1000);
+		LogQueueFlush();
+	}
+}
+
+static void
+log_thread_start()
+{
+	log_thread_quit = false;
+	EnableLogQueue();
+
+	Error error;
+	if (!log_thread.Start(log_thread_run, nullptr, error)) {
+		DisableLogQueue();
+		LogError(error);
+	}
+}
+
+static void
+log_thread_stop()
+{
+	if (!log_thread.IsDefined())
+		return;
+
+	log_thread_quit = true;
+	LogQueueWake();
+	log_thread.Join();
+
+	DisableLogQueue();
+	LogQueueFlush();
+}
+
 static void redirect_logs(int fd)
 {
 	assert(fd >= 0);
@@ -188,6 +239,7 @@ void
 log_deinit(void)
 {
 #ifndef ANDROID
+	log_thread_stop();
 	close_log_files();
 	out_path = AllocatedPath::Null();
 #endif
@@ -198,28 +250,31 @@ void setup_log_output(bool use_stdout)
 #ifdef ANDROID
 	(void)use_stdout;
 #else
-	if (use_stdout)
-		return;
-
-	fflush(nullptr);
+	if (!use_stdout) {
+		fflush(nullptr);
 
-	if (out_fd < 0) {
+		if (out_fd < 0) {
 #ifdef WIN32
-		return;
-#else
-		out_fd = open("/dev/null", O_WRONLY);
-		if (out_fd < 0)
 			return;
+#else
+			out_fd = open("/dev/null", O_WRONLY);
+			if (out_fd < 0)
+				return;
 #endif
-	}
+		}
 
-	redirect_logs(out_fd);
-	close(out_fd);
-	out_fd = -1;
+		redirect_logs(out_fd);
+		close(out_fd);
+		out_fd = -1;
 
 #ifdef HAVE_GLIB
-	SetLogCharset(nullptr);
+		SetLogCharset(nullptr);
 #endif
+	}
+
+	/* this is called after daemonization, so the thread survives
+	   the fork() */
+	log_thread_start();
 #endif
 }
 
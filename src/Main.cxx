@@ -25,22 +25,31 @@
 #include "PlaylistGlobal.hxx"
 #include "MusicChunk.hxx"
 #include "StateFile.hxx"
+#include "StatusPage.hxx"
 #include "PlayerThread.hxx"
 #include "Mapper.hxx"
 #include "Permission.hxx"
 #include "Listen.hxx"
+#include "metrics/Server.hxx"
+#include "TraceFile.hxx"
 #include "client/Client.hxx"
 #include "client/ClientList.hxx"
 #include "command/AllCommands.hxx"
 #include "Partition.hxx"
 #include "tag/TagConfig.hxx"
 #include "ReplayGainConfig.hxx"
+#include "LatencyProfile.hxx"
+#include "ThreadConfig.hxx"
 #include "Idle.hxx"
 #include "Log.hxx"
 #include "LogInit.hxx"
 #include "GlobalEvents.hxx"
 #include "input/Init.hxx"
+#include "input/InputCache.hxx"
+#include "input/InputPrefetcher.hxx"
 #include "event/Loop.hxx"
+#include "event/Call.hxx"
+#include "event/AsyncResolver.hxx"
 #include "IOThread.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/Config.hxx"
@@ -71,6 +80,7 @@
 #ifdef ENABLE_DATABASE
 #include "db/update/Service.hxx"
 #include "db/Configured.hxx"
+#include "db/DatabaseLoader.hxx"
 #include "db/DatabasePlugin.hxx"
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "storage/Configured.hxx"
@@ -86,6 +96,9 @@
 
 #ifdef ENABLE_SQLITE
 #include "sticker/StickerDatabase.hxx"
+#ifdef ENABLE_DATABASE
+#include "loudness/Service.hxx"
+#endif
 #endif
 
 #ifdef ENABLE_ARCHIVE
@@ -128,7 +141,6 @@
 #include <limits.h>
 
 static constexpr unsigned DEFAULT_BUFFER_SIZE = 4096;
-static constexpr unsigned DEFAULT_BUFFER_BEFORE_PLAY = 10;
 
 static constexpr Domain main_domain("main");
 
@@ -139,6 +151,7 @@ Context *context;
 Instance *instance;
 
 static StateFile *state_file;
+static StatusPage *status_page;
 
 #ifdef ENABLE_DAEMON
 
@@ -189,6 +202,80 @@ InitStorage(Error &error)
 	return true;
 }
 
+/**
+ * Create the #UpdateService if the database is a #SimpleDatabase.
+ *
+ * @return false if the database file does not exist yet, and the
+ * caller should create it after the process has been daemonized
+ */
+static bool
+glue_update_init()
+{
+	if (!instance->database->IsPlugin(simple_db_plugin))
+		return true;
+
+	SimpleDatabase &db = *(SimpleDatabase *)instance->database;
+	instance->update = new UpdateService(*instance->event_loop, db,
+					     static_cast<CompositeStorage &>(*instance->storage),
+					     *instance);
+
+	/* run database update after daemonization? */
+	return db.FileExists();
+}
+
+static void
+glue_update_create_db()
+{
+	/* the database failed to load: recreate the database */
+	unsigned job = instance->update->Enqueue("", true);
+	if (job == 0)
+		FatalError("directory update failed");
+}
+
+static void
+glue_inotify_init()
+{
+	if (!config_get_bool(ConfigOption::AUTO_UPDATE, false))
+		return;
+
+#ifdef ENABLE_INOTIFY
+	if (instance->storage != nullptr &&
+	    instance->update != nullptr)
+		mpd_inotify_init(*instance->event_loop,
+				 *instance->storage,
+				 *instance->update,
+				 config_get_unsigned(ConfigOption::AUTO_UPDATE_DEPTH,
+						     INT_MAX));
+#else
+	FormatWarning(main_domain,
+		      "inotify: auto_update was disabled. enable during compilation phase");
+#endif
+}
+
+/**
+ * Callback for #DatabaseLoader: the database has been loaded in the
+ * background; finish its initialization.
+ */
+static void
+glue_db_loaded(DatabaseLoader &loader)
+{
+	assert(instance->database_loader == &loader);
+
+	if (!loader.IsSuccess())
+		FatalError(loader.GetError());
+
+	Database &db = loader.GetDatabase();
+	instance->database_loader = nullptr;
+	delete &loader;
+
+	instance->DatabaseLoaded(db);
+
+	if (!glue_update_init())
+		glue_update_create_db();
+
+	glue_inotify_init();
+}
+
 /**
  * Returns the database.  If this function returns false, this has not
  * succeeded, and the caller should create the database after the
@@ -227,19 +314,23 @@ glue_db_init_and_load(void)
 				   "because the database does not need it");
 	}
 
-	if (!instance->database->Open(error))
-		FatalError(error);
-
-	if (!instance->database->IsPlugin(simple_db_plugin))
+	if (instance->database->IsPlugin(simple_db_plugin) &&
+	    config_get_bool(ConfigOption::DB_BACKGROUND_LOAD, false)) {
+		/* the database file will be loaded by a separate
+		   thread (started by mpd_main_after_fork()), and
+		   glue_db_loaded() finishes the initialization */
+		instance->database_loader =
+			new DatabaseLoader(*instance->event_loop,
+					   *instance->database,
+					   glue_db_loaded);
+		instance->database = nullptr;
 		return true;
+	}
 
-	SimpleDatabase &db = *(SimpleDatabase *)instance->database;
-	instance->update = new UpdateService(*instance->event_loop, db,
-					     static_cast<CompositeStorage &>(*instance->storage),
-					     *instance);
+	if (!instance->database->Open(error))
+		FatalError(error);
 
-	/* run database update after daemonization? */
-	return db.FileExists();
+	return glue_update_init();
 }
 
 static bool
@@ -266,11 +357,48 @@ glue_sticker_init(void)
 		return;
 	}
 
-	if (!sticker_global_init(std::move(sticker_file), error))
+	const char *synchronous =
+		config_get_string(ConfigOption::STICKER_SYNCHRONOUS,
+				  "normal");
+
+	if (!sticker_global_init(std::move(sticker_file), synchronous,
+				 error))
 		FatalError(error);
 #endif
 }
 
+/**
+ * Start the loudness analysis if it is enabled.  Call this after
+ * the sticker database and the storage have been initialized.
+ */
+static void
+glue_loudness_init()
+{
+#if defined(ENABLE_DATABASE) && defined(ENABLE_SQLITE)
+	if (!config_get_bool(ConfigOption::LOUDNESS_ANALYSIS, false))
+		return;
+
+	if (!sticker_enabled() || instance->storage == nullptr) {
+		LogWarning(main_domain,
+			   "loudness_analysis requires music_directory and sticker_file");
+		return;
+	}
+
+	const unsigned n_threads =
+		config_get_positive(ConfigOption::LOUDNESS_THREADS, 1);
+
+	instance->loudness = new LoudnessService(*instance->event_loop,
+						 *instance->storage,
+						 n_threads);
+	instance->loudness->Load();
+
+	/* if the database is still being loaded,
+	   Instance::DatabaseLoaded() will start the scan */
+	if (instance->database != nullptr)
+		instance->loudness->Rescan(*instance->database);
+#endif
+}
+
 static bool
 glue_state_file_init(Error &error)
 {
@@ -301,6 +429,19 @@ glue_state_file_init(Error &error)
 	return true;
 }
 
+static bool
+glue_status_page_init(Error &error)
+{
+	auto path_fs = config_get_path(ConfigOption::STATUS_PAGE, error);
+	if (path_fs.IsNull())
+		return !error.IsDefined();
+
+	status_page = StatusPage::Create(*instance->event_loop,
+					 *instance->partition,
+					 std::move(path_fs), error);
+	return status_page != nullptr;
+}
+
 /**
  * Windows-only initialization of the Winsock2 library.
  */
@@ -343,7 +484,35 @@ initialize_decoder_and_player(void)
 
 	buffer_size *= 1024;
 
-	const unsigned buffered_chunks = buffer_size / CHUNK_SIZE;
+	/* the budget for all buffers together, beyond their reserves
+	   (in KiB); 0 means unlimited */
+	MusicBuffer::SetBudget(size_t(config_get_unsigned(ConfigOption::AUDIO_BUFFER_BUDGET,
+							  0)) * 1024);
+
+	size_t chunk_size;
+	param = config_get_param(ConfigOption::AUDIO_CHUNK_SIZE);
+	if (param != nullptr) {
+		char *test;
+		long tmp = strtol(param->value.c_str(), &test, 10);
+		if (*test != '\0' || tmp < long(MIN_CHUNK_SIZE) ||
+		    tmp > long(MAX_CHUNK_SIZE))
+			FormatFatalError("chunk size \"%s\" is not "
+					 "between %u and %u, line %i",
+					 param->value.c_str(),
+					 unsigned(MIN_CHUNK_SIZE),
+					 unsigned(MAX_CHUNK_SIZE),
+					 param->line);
+		chunk_size = tmp;
+	} else
+		chunk_size = DEFAULT_CHUNK_SIZE;
+
+	const unsigned buffered_chunks = buffer_size / chunk_size;
+
+	if (buffered_chunks < 16)
+		FormatFatalError("buffer size \"%lu\" is too small for "
+				 "chunk size \"%lu\"",
+				 (unsigned long)buffer_size,
+				 (unsigned long)chunk_size);
 
 	if (buffered_chunks >= 1 << 15)
 		FormatFatalError("buffer size \"%lu\" is too big",
@@ -361,7 +530,7 @@ initialize_decoder_and_player(void)
 					 param->value.c_str(), param->line);
 		}
 	} else
-		perc = DEFAULT_BUFFER_BEFORE_PLAY;
+		perc = GetLatencySettings().buffer_before_play;
 
 	unsigned buffered_before_play = (perc / 100) * buffered_chunks;
 	if (buffered_before_play > buffered_chunks)
@@ -374,6 +543,7 @@ initialize_decoder_and_player(void)
 	instance->partition = new Partition(*instance,
 					    max_length,
 					    buffered_chunks,
+					    chunk_size,
 					    buffered_before_play);
 }
 
@@ -392,6 +562,10 @@ idle_event_emitted(void)
 	if (flags & (IDLE_PLAYLIST|IDLE_PLAYER|IDLE_MIXER|IDLE_OUTPUT) &&
 	    state_file != nullptr)
 		state_file->CheckModified();
+
+	if (flags & (IDLE_PLAYLIST|IDLE_PLAYER|IDLE_MIXER|IDLE_OPTIONS) &&
+	    status_page != nullptr)
+		status_page->Update();
 }
 
 #ifdef WIN32
@@ -510,8 +684,11 @@ int mpd_main(int argc, char *argv[])
 
 	const unsigned max_clients =
 		config_get_positive(ConfigOption::MAX_CONN, 10);
-	instance->client_list = new ClientList(max_clients);
+	instance->client_list = new ClientList(*instance->event_loop,
+					       max_clients);
 
+	latency_profile_global_init();
+	thread_config_global_init();
 	initialize_decoder_and_player();
 
 	if (!listen_global_init(*instance->event_loop, *instance->partition,
@@ -520,6 +697,11 @@ int mpd_main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	if (!metrics_global_init(*instance->event_loop, *instance, error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
 #ifdef ENABLE_DAEMON
 	daemonize_set_user();
 	daemonize_begin(options.daemon);
@@ -562,9 +744,18 @@ static int mpd_main_after_fork(struct options options)
 		return EXIT_FAILURE;
 	}
 
+	if (!trace_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
 	initPermissions();
 	playlist_global_init();
 	spl_global_init();
+	spl_cache_init(*instance->event_loop);
+#ifdef ENABLE_INOTIFY
+	spl_index_init(*instance->event_loop);
+#endif
 #ifdef ENABLE_ARCHIVE
 	archive_plugin_init_all();
 #endif
@@ -594,6 +785,14 @@ static int mpd_main_after_fork(struct options options)
 		return EXIT_FAILURE;
 	}
 
+#ifndef WIN32
+	if (!input_cache_global_init(error) ||
+	    !input_prefetcher_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+#endif
+
 	playlist_list_global_init();
 
 #ifdef ENABLE_DAEMON
@@ -606,7 +805,15 @@ static int mpd_main_after_fork(struct options options)
 	SignalHandlersInit(*instance->event_loop);
 #endif
 
+	thread_config_lock_memory();
+
 	io_thread_start();
+	BlockingCall(io_thread_get(), [](){ ApplyThreadConfig("io"); });
+
+	if (!resolver_global_start(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	if (instance->neighbors != nullptr &&
@@ -619,37 +826,34 @@ static int mpd_main_after_fork(struct options options)
 	StartPlayerThread(instance->partition->pc);
 
 #ifdef ENABLE_DATABASE
-	if (create_db) {
-		/* the database failed to load: recreate the
-		   database */
-		unsigned job = instance->update->Enqueue("", true);
-		if (job == 0)
-			FatalError("directory update failed");
-	}
+	if (create_db)
+		glue_update_create_db();
+
+	/* start loading the database now that the signal mask of the
+	   main thread has been set up; meanwhile, the state file is
+	   restored without it */
+	if (instance->database_loader != nullptr &&
+	    !instance->database_loader->Start(error))
+		FatalError(error);
 #endif
 
+	glue_loudness_init();
+
 	if (!glue_state_file_init(error)) {
 		LogError(error);
 		return EXIT_FAILURE;
 	}
 
+	if (!glue_status_page_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
 	instance->partition->outputs.SetReplayGainMode(replay_gain_get_real_mode(instance->partition->playlist.queue.random));
 
 #ifdef ENABLE_DATABASE
-	if (config_get_bool(ConfigOption::AUTO_UPDATE, false)) {
-#ifdef ENABLE_INOTIFY
-		if (instance->storage != nullptr &&
-		    instance->update != nullptr)
-			mpd_inotify_init(*instance->event_loop,
-					 *instance->storage,
-					 *instance->update,
-					 config_get_unsigned(ConfigOption::AUTO_UPDATE_DEPTH,
-							     INT_MAX));
-#else
-		FormatWarning(main_domain,
-			      "inotify: auto_update was disabled. enable during compilation phase");
-#endif
-	}
+	if (instance->database_loader == nullptr)
+		glue_inotify_init();
 #endif
 
 	config_global_check();
@@ -686,14 +890,23 @@ static int mpd_main_after_fork(struct options options)
 		instance->update->CancelAllAsync();
 #endif
 
+	spl_cache_finish();
+
+#ifdef ENABLE_INOTIFY
+	spl_index_finish();
+#endif
+
 	if (state_file != nullptr) {
 		state_file->Write();
 		delete state_file;
 	}
 
+	delete status_page;
+
 	instance->partition->pc.Kill();
 	ZeroconfDeinit();
 	listen_global_finish();
+	metrics_global_finish();
 	delete instance->client_list;
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
@@ -704,8 +917,19 @@ static int mpd_main_after_fork(struct options options)
 #endif
 
 #ifdef ENABLE_DATABASE
+#ifdef ENABLE_SQLITE
+	delete instance->loudness;
+#endif
+
 	delete instance->update;
 
+	if (instance->database_loader != nullptr) {
+		/* still loading: wait for the thread to finish */
+		Database &db = instance->database_loader->GetDatabase();
+		delete instance->database_loader;
+		delete &db;
+	}
+
 	if (instance->database != nullptr) {
 		instance->database->Close();
 		delete instance->database;
@@ -721,6 +945,10 @@ static int mpd_main_after_fork(struct options options)
 	GlobalEvents::Deinitialize();
 
 	playlist_list_global_finish();
+#ifndef WIN32
+	input_prefetcher_global_finish();
+	input_cache_global_finish();
+#endif
 	input_stream_global_finish();
 
 #ifdef ENABLE_DATABASE
@@ -736,10 +964,12 @@ static int mpd_main_after_fork(struct options options)
 	archive_plugin_deinit_all();
 #endif
 	config_global_finish();
+	resolver_global_finish();
 	io_thread_deinit();
 #ifndef ANDROID
 	SignalHandlersFinish();
 #endif
+	trace_global_finish();
 	delete instance->event_loop;
 	delete instance;
 	instance = nullptr;
@@ -21,20 +21,368 @@
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
 #include "system/FatalError.hxx"
+#include "util/HugeAllocator.hxx"
+
+#include <algorithm>
+#include <new>
 
 #include <assert.h>
 
-MusicBuffer::MusicBuffer(unsigned num_chunks)
-	:buffer(num_chunks) {
-	if (buffer.IsOOM())
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+/**
+ * Shared between a #MusicBuffer and the magazines which cache its
+ * chunks.  A magazine uses it to find out whether its buffer still
+ * exists.
+ */
+struct MusicBuffer::Anchor {
+	/** protects #buffer */
+	Mutex mutex;
+
+	/**
+	 * The #MusicBuffer, or nullptr after it has been destroyed.
+	 */
+	MusicBuffer *buffer;
+
+	explicit Anchor(MusicBuffer &_buffer):buffer(&_buffer) {}
+};
+
+/**
+ * A per-thread cache of free chunks.  All chunks in it have been
+ * allocated from the #SliceBuffer of the buffer referred to by
+ * #anchor, and have been reinitialized already.
+ *
+ * A magazine is only ever accessed by its own thread.
+ */
+struct MusicBuffer::Magazine {
+	/**
+	 * Refers to the #MusicBuffer which owns the chunks in this
+	 * magazine, or nullptr if it is not attached.
+	 */
+	std::shared_ptr<Anchor> anchor;
+
+	/** the number of chunks in #chunks */
+	unsigned n = 0;
+
+	/**
+	 * Counters which have not yet been added to the global
+	 * statistics.  They are accounted while the shared buffer is
+	 * locked anyway.
+	 */
+	unsigned allocate_hits = 0, return_hits = 0;
+
+	MusicChunk *chunks[MAGAZINE_SIZE];
+
+	~Magazine() {
+		Release();
+	}
+
+	/**
+	 * Return all chunks to the buffer (if it still exists) and
+	 * detach from it.
+	 */
+	void Release();
+};
+
+static thread_local MusicBuffer::Magazine thread_magazine;
+
+void
+MusicBuffer::Magazine::Release()
+{
+	if (anchor == nullptr)
+		return;
+
+	{
+		const ScopeLock protect(anchor->mutex);
+		if (anchor->buffer != nullptr)
+			anchor->buffer->Detach(*this);
+		else {
+			/* the buffer has been destroyed, and with it
+			   the memory of these chunks */
+			n = 0;
+			allocate_hits = return_hits = 0;
+		}
+	}
+
+	anchor.reset();
+}
+
+static std::atomic_ulong total_allocate_hits, total_allocate_misses;
+static std::atomic_ulong total_return_hits, total_return_misses;
+static std::atomic_ulong total_chunks, total_chunks_in_use;
+
+/**
+ * The process-wide budget for chunks beyond the reserves [bytes]; 0
+ * means unlimited, and then the reserves are ignored.
+ */
+static size_t budget;
+
+/**
+ * The payload memory of all borrowed chunks [bytes].
+ */
+static std::atomic_size_t total_borrowed;
+
+static std::atomic_ulong total_chunks_borrowed;
+
+/**
+ * Charge the budget for one chunk.
+ *
+ * @return false if the budget is exhausted
+ */
+static bool
+BorrowFromBudget(size_t size)
+{
+	size_t old_value = total_borrowed.load(std::memory_order_relaxed);
+	do {
+		if (budget > 0 && old_value + size > budget)
+			return false;
+	} while (!total_borrowed.compare_exchange_weak(old_value,
+						       old_value + size,
+						       std::memory_order_relaxed));
+
+	total_chunks_borrowed.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+static void
+ReturnToBudget(size_t size)
+{
+	total_borrowed.fetch_sub(size, std::memory_order_relaxed);
+	total_chunks_borrowed.fetch_sub(1, std::memory_order_relaxed);
+}
+
+/**
+ * Give the memory pages which lie completely inside the specified
+ * range back to the kernel.
+ */
+static void
+DiscardPages(uint8_t *p, size_t size)
+{
+#ifdef WIN32
+	static constexpr size_t page_size = 4096;
+#else
+	static const size_t page_size = sysconf(_SC_PAGESIZE);
+#endif
+
+	const uintptr_t start = ((uintptr_t)p + page_size - 1)
+		/ page_size * page_size;
+	const uintptr_t end = ((uintptr_t)p + size) / page_size * page_size;
+	if (start < end)
+		HugeDiscard((void *)start, end - start);
+}
+
+void
+MusicBuffer::SetBudget(size_t bytes)
+{
+	budget = bytes;
+}
+
+MusicBuffer::MusicBuffer(unsigned num_chunks, size_t _chunk_size,
+			 unsigned _reserve)
+	:buffer(num_chunks), chunk_size(_chunk_size),
+	 payload_stride((chunk_size + PAYLOAD_ALIGNMENT - 1)
+			/ PAYLOAD_ALIGNMENT * PAYLOAD_ALIGNMENT),
+	 payload((uint8_t *)HugeAllocate(num_chunks * payload_stride)),
+	 anchor(std::make_shared<Anchor>(*this)),
+	 use_magazines(num_chunks >= MAGAZINE_SIZE * 16),
+	 reserve(std::min(_reserve, num_chunks)),
+	 n_allocated(0), n_borrowed(0) {
+	assert(chunk_size >= MIN_CHUNK_SIZE);
+	assert(chunk_size <= MAX_CHUNK_SIZE);
+
+	if (buffer.IsOOM() || payload == nullptr)
 		FatalError("Failed to allocate buffer");
+
+	total_chunks.fetch_add(num_chunks, std::memory_order_relaxed);
+}
+
+MusicBuffer::~MusicBuffer()
+{
+	/* this thread's magazine can be returned right away */
+	if (thread_magazine.anchor == anchor)
+		thread_magazine.Release();
+
+	{
+		/* wait for other threads which are currently flushing
+		   their magazines into this buffer; after that, they
+		   will discard the chunks of this buffer instead */
+		const ScopeLock protect(anchor->mutex);
+		anchor->buffer = nullptr;
+	}
+
+	/* all chunks which are still allocated are cached in the
+	   magazines of other threads; they have been reinitialized
+	   already, and will never be used again */
+	buffer.Abandon();
+
+	/* chunks cached in magazines are never freed, so give
+	   their share back to the budget here */
+	while (n_borrowed > 0) {
+		--n_borrowed;
+		ReturnToBudget(chunk_size);
+	}
+
+	HugeFree(payload, buffer.GetCapacity() * payload_stride);
+
+	total_chunks.fetch_sub(buffer.GetCapacity(),
+			       std::memory_order_relaxed);
+}
+
+inline MusicChunk *
+MusicBuffer::Prepare(MusicChunk *chunk)
+{
+	if (chunk != nullptr) {
+		chunk->data = payload + buffer.IndexOf(chunk) * payload_stride;
+		chunk->capacity = chunk_size;
+	}
+
+	return chunk;
+}
+
+inline MusicChunk *
+MusicBuffer::AllocateLocked()
+{
+	if (buffer.IsFull())
+		return nullptr;
+
+	if (budget > 0 && n_allocated >= reserve) {
+		if (!BorrowFromBudget(chunk_size))
+			return nullptr;
+
+		++n_borrowed;
+	}
+
+	MusicChunk *chunk = Prepare(buffer.Allocate());
+	assert(chunk != nullptr);
+	++n_allocated;
+	return chunk;
+}
+
+inline void
+MusicBuffer::FreeLocked(MusicChunk *chunk)
+{
+	assert(n_allocated > 0);
+	--n_allocated;
+
+	if (n_borrowed > 0) {
+		/* shrink: give this chunk's memory back, so other
+		   buffers may borrow it */
+		--n_borrowed;
+		ReturnToBudget(chunk_size);
+		DiscardPages(payload + buffer.IndexOf(chunk) * payload_stride,
+			     payload_stride);
+	}
+
+	buffer.Free(chunk);
+
+	/* like SliceBuffer, give the payload memory back to the
+	   kernel when the last chunk was freed */
+	if (buffer.IsEmpty())
+		HugeDiscard(payload, buffer.GetCapacity() * payload_stride);
+}
+
+void
+MusicBuffer::Attach(Magazine &magazine)
+{
+	assert(magazine.anchor != anchor);
+
+	magazine.Release();
+	assert(magazine.n == 0);
+
+	magazine.anchor = anchor;
+}
+
+void
+MusicBuffer::Detach(Magazine &magazine)
+{
+	assert(magazine.anchor == anchor);
+
+	const ScopeLock protect(mutex);
+	FlushLocked(magazine, magazine.n);
+}
+
+void
+MusicBuffer::Refill(Magazine &magazine)
+{
+	assert(magazine.anchor == anchor);
+	assert(magazine.n == 0);
+
+	const ScopeLock protect(mutex);
+
+	while (magazine.n < MAGAZINE_SIZE / 2) {
+		MusicChunk *chunk = AllocateLocked();
+		if (chunk == nullptr)
+			break;
+
+		magazine.chunks[magazine.n++] = chunk;
+	}
+
+	total_allocate_hits.fetch_add(magazine.allocate_hits,
+				      std::memory_order_relaxed);
+	magazine.allocate_hits = 0;
+	total_allocate_misses.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+MusicBuffer::FlushLocked(Magazine &magazine, unsigned n)
+{
+	assert(n <= magazine.n);
+
+	while (n-- > 0)
+		FreeLocked(magazine.chunks[--magazine.n]);
+
+	total_return_hits.fetch_add(magazine.return_hits,
+				    std::memory_order_relaxed);
+	magazine.return_hits = 0;
+}
+
+inline void
+MusicBuffer::Recycle(Magazine &magazine, MusicChunk *chunk)
+{
+	/* reinitialize the chunk now, so Allocate() can hand it out
+	   right away */
+	uint8_t *const data = chunk->data;
+	chunk->~MusicChunk();
+	::new((void *)chunk) MusicChunk();
+	chunk->data = data;
+	chunk->capacity = chunk_size;
+
+	if (magazine.n == MAGAZINE_SIZE) {
+		const ScopeLock protect(mutex);
+		FlushLocked(magazine, MAGAZINE_SIZE / 2);
+		total_return_misses.fetch_add(1, std::memory_order_relaxed);
+	} else
+		++magazine.return_hits;
+
+	magazine.chunks[magazine.n++] = chunk;
 }
 
 MusicChunk *
 MusicBuffer::Allocate()
 {
-	const ScopeLock protect(mutex);
-	return buffer.Allocate();
+	if (!use_magazines) {
+		const ScopeLock protect(mutex);
+		MusicChunk *chunk = AllocateLocked();
+		if (chunk != nullptr)
+			total_chunks_in_use.fetch_add(1, std::memory_order_relaxed);
+		return chunk;
+	}
+
+	Magazine &magazine = thread_magazine;
+	if (magazine.anchor != anchor)
+		Attach(magazine);
+
+	if (magazine.n == 0) {
+		Refill(magazine);
+		if (magazine.n == 0)
+			return nullptr;
+	} else
+		++magazine.allocate_hits;
+
+	total_chunks_in_use.fetch_add(1, std::memory_order_relaxed);
+	return magazine.chunks[--magazine.n];
 }
 
 void
@@ -42,12 +390,54 @@ MusicBuffer::Return(MusicChunk *chunk)
 {
 	assert(chunk != nullptr);
 
-	const ScopeLock protect(mutex);
+	total_chunks_in_use.fetch_sub(chunk->other != nullptr ? 2 : 1,
+				      std::memory_order_relaxed);
+
+	if (!use_magazines) {
+		const ScopeLock protect(mutex);
+
+		if (chunk->other != nullptr) {
+			assert(chunk->other->other == nullptr);
+			FreeLocked(chunk->other);
+		}
+
+		FreeLocked(chunk);
+		return;
+	}
+
+	Magazine &magazine = thread_magazine;
+	if (magazine.anchor != anchor)
+		Attach(magazine);
 
 	if (chunk->other != nullptr) {
 		assert(chunk->other->other == nullptr);
-		buffer.Free(chunk->other);
+		Recycle(magazine, chunk->other);
 	}
 
-	buffer.Free(chunk);
+	Recycle(magazine, chunk);
+}
+
+void
+MusicBuffer::FlushThreadCache()
+{
+	Magazine &magazine = thread_magazine;
+	if (magazine.anchor != anchor || magazine.n == 0)
+		return;
+
+	const ScopeLock protect(mutex);
+	FlushLocked(magazine, magazine.n);
+}
+
+MusicBuffer::Stats
+MusicBuffer::GetStats()
+{
+	return {
+		total_allocate_hits.load(std::memory_order_relaxed),
+		total_allocate_misses.load(std::memory_order_relaxed),
+		total_return_hits.load(std::memory_order_relaxed),
+		total_return_misses.load(std::memory_order_relaxed),
+		total_chunks.load(std::memory_order_relaxed),
+		total_chunks_in_use.load(std::memory_order_relaxed),
+		total_chunks_borrowed.load(std::memory_order_relaxed),
+	};
 }
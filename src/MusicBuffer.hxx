@@ -23,31 +23,158 @@
 #include "util/SliceBuffer.hxx"
 #include "thread/Mutex.hxx"
 
+#include <atomic>
+#include <memory>
+
+#include <limits.h>
+#include <stdint.h>
+
 struct MusicChunk;
 
 /**
  * An allocator for #MusicChunk objects.
+ *
+ * Each thread has a small cache of free chunks (a "magazine"), and
+ * the shared #SliceBuffer (and its mutex) is only accessed when the
+ * magazine is empty (in Allocate()) or full (in Return()).
+ *
+ * All instances share a process-wide memory budget (see
+ * SetBudget()).  A buffer may always use up to its "reserve" of
+ * chunks; beyond that, it borrows from the budget, and each borrowed
+ * chunk's memory is given back to the kernel as soon as a chunk is
+ * returned.  Without a budget, all chunks are available.
  */
 class MusicBuffer {
+public:
+	struct Magazine;
+	struct Anchor;
+
+	/**
+	 * The number of chunks which can be cached in one
+	 * magazine.
+	 */
+	static constexpr unsigned MAGAZINE_SIZE = 32;
+
+	/**
+	 * The alignment of MusicChunk::data: one cache line, which
+	 * is also enough for all SIMD loads and stores.
+	 */
+	static constexpr size_t PAYLOAD_ALIGNMENT = 64;
+
+	/**
+	 * Counters describing how often the per-thread magazines
+	 * were able to satisfy a request without locking the shared
+	 * buffer.  These are global for all #MusicBuffer instances.
+	 */
+	struct Stats {
+		unsigned long allocate_hits, allocate_misses;
+		unsigned long return_hits, return_misses;
+
+		/**
+		 * The number of chunks reserved by all buffers, and
+		 * how many of them are currently handed out by
+		 * Allocate().  Chunks cached in magazines count as
+		 * free.
+		 */
+		unsigned long chunks, chunks_in_use;
+
+		/**
+		 * The number of chunks which all buffers have
+		 * borrowed from the budget beyond their reserve.
+		 */
+		unsigned long chunks_borrowed;
+	};
+
+private:
 	/** a mutex which protects #buffer */
 	Mutex mutex;
 
 	SliceBuffer<MusicChunk> buffer;
 
+	/**
+	 * The payload size of each chunk.
+	 */
+	const size_t chunk_size;
+
+	/**
+	 * The distance between two payloads in #payload: #chunk_size
+	 * rounded up to #PAYLOAD_ALIGNMENT.
+	 */
+	const size_t payload_stride;
+
+	/**
+	 * The payload memory of all chunks, #payload_stride bytes
+	 * per slice in #buffer.  It is page aligned, and the payload
+	 * of each chunk is aligned to #PAYLOAD_ALIGNMENT.
+	 */
+	uint8_t *const payload;
+
+	/**
+	 * Identifies this instance to the per-thread magazines.  It
+	 * outlives this object as long as a magazine refers to it,
+	 * so a new buffer at the same address is never mistaken for
+	 * this one.
+	 */
+	const std::shared_ptr<Anchor> anchor;
+
+	/**
+	 * Are per-thread magazines enabled?  They are disabled for
+	 * very small buffers, because the chunks cached by one
+	 * thread are not available to the others.
+	 */
+	const bool use_magazines;
+
+	/**
+	 * The number of chunks which can be allocated without asking
+	 * the budget.
+	 */
+	const unsigned reserve;
+
+	/**
+	 * The number of chunks allocated from #buffer (including
+	 * those cached in magazines).  Protected by #mutex.
+	 */
+	unsigned n_allocated;
+
+	/**
+	 * The number of allocated chunks beyond #reserve, which have
+	 * been charged to the budget.  Protected by #mutex.
+	 */
+	unsigned n_borrowed;
+
 public:
 	/**
 	 * Creates a new #MusicBuffer object.
 	 *
 	 * @param num_chunks the number of #MusicChunk reserved in
 	 * this buffer
+	 * @param chunk_size the payload size of each chunk
+	 * @param reserve the number of chunks which are available
+	 * regardless of the budget; more chunks (up to #num_chunks)
+	 * are only available while the budget permits
+	 */
+	MusicBuffer(unsigned num_chunks, size_t chunk_size,
+		    unsigned reserve=UINT_MAX);
+
+	/**
+	 * Frees the object.  All chunks must have been returned, but
+	 * other threads may still cache some in their magazines;
+	 * those threads discard them the next time they access their
+	 * magazine.  This object does not touch the magazines of
+	 * other threads.
 	 */
-	MusicBuffer(unsigned num_chunks);
+	~MusicBuffer();
+
+	MusicBuffer(const MusicBuffer &) = delete;
+	MusicBuffer &operator=(const MusicBuffer &) = delete;
 
 #ifndef NDEBUG
 	/**
 	 * Check whether the buffer is empty.  This call is not
 	 * protected with the mutex, and may only be used while this
-	 * object is inaccessible to other threads.
+	 * object is inaccessible to other threads.  Chunks cached in
+	 * magazines count as allocated; call FlushThreadCache()
+	 * first.
 	 */
 	bool IsEmptyUnsafe() const {
 		return buffer.IsEmpty();
@@ -64,6 +191,13 @@ public:
 		return buffer.GetCapacity();
 	}
 
+	/**
+	 * Returns the payload size of each chunk.
+	 */
+	size_t GetChunkSize() const {
+		return chunk_size;
+	}
+
 	/**
 	 * Allocates a chunk from the buffer.  When it is not used anymore,
 	 * call Return().
@@ -78,6 +212,52 @@ public:
 	 * Allocate() then.
 	 */
 	void Return(MusicChunk *chunk);
+
+	/**
+	 * Moves all chunks cached in the current thread's magazine
+	 * back to the shared buffer.  Call this when the thread
+	 * becomes idle, to make the chunks available to other
+	 * threads and to allow the memory to be given back to the
+	 * kernel.
+	 */
+	void FlushThreadCache();
+
+	gcc_pure
+	static Stats GetStats();
+
+	/**
+	 * Limit the payload memory of all #MusicBuffer instances
+	 * together (not counting their reserves, which are always
+	 * available).  Call this before the first buffer is created.
+	 *
+	 * @param bytes the budget in bytes; 0 means unlimited
+	 */
+	static void SetBudget(size_t bytes);
+
+private:
+	/**
+	 * Initialize a chunk which has just been allocated from
+	 * #buffer.  Caller must lock the mutex.
+	 */
+	MusicChunk *Prepare(MusicChunk *chunk);
+
+	/**
+	 * Allocate a chunk from #buffer, charging the budget if
+	 * necessary.  Caller must lock the mutex.
+	 */
+	MusicChunk *AllocateLocked();
+
+	/**
+	 * Free a chunk.  Caller must lock the mutex.
+	 */
+	void FreeLocked(MusicChunk *chunk);
+
+	void Attach(Magazine &magazine);
+	void Detach(Magazine &magazine);
+
+	void Refill(Magazine &magazine);
+	void Recycle(Magazine &magazine, MusicChunk *chunk);
+	void FlushLocked(Magazine &magazine, unsigned n);
 };
 
 #endif
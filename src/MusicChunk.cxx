@@ -22,8 +22,26 @@
 #include "AudioFormat.hxx"
 #include "tag/Tag.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 
+size_t
+CalcChunkLimit(const AudioFormat af, size_t capacity)
+{
+	assert(af.IsValid());
+
+	/* fill at least DEFAULT_CHUNK_SIZE bytes, but no more than
+	   50 ms */
+	size_t limit = std::max(size_t(af.GetTimeToSize()) / 20,
+				DEFAULT_CHUNK_SIZE);
+	if (limit > capacity)
+		limit = capacity;
+
+	const size_t frame_size = af.GetFrameSize();
+	return limit - limit % frame_size;
+}
+
 MusicChunk::~MusicChunk()
 {
 	delete tag;
@@ -59,7 +77,7 @@ MusicChunk::Write(const AudioFormat af,
 	}
 
 	const size_t frame_size = af.GetFrameSize();
-	size_t num_frames = (sizeof(data) - length) / frame_size;
+	size_t num_frames = (capacity - length) / frame_size;
 	return { data + length, num_frames * frame_size };
 }
 
@@ -68,10 +86,10 @@ MusicChunk::Expand(const AudioFormat af, size_t _length)
 {
 	const size_t frame_size = af.GetFrameSize();
 
-	assert(length + _length <= sizeof(data));
+	assert(length + _length <= capacity);
 	assert(audio_format == af);
 
 	length += _length;
 
-	return length + frame_size > sizeof(data);
+	return length + frame_size > capacity;
 }
@@ -28,21 +28,53 @@
 #include "AudioFormat.hxx"
 #endif
 
+#include <atomic>
+
 #include <stdint.h>
 #include <stddef.h>
+#include <assert.h>
+
+/**
+ * The default payload size of a #MusicChunk.  Can be changed with
+ * the "audio_chunk_size" setting.
+ */
+static constexpr size_t DEFAULT_CHUNK_SIZE = 4096;
 
-static constexpr size_t CHUNK_SIZE = 4096;
+static constexpr size_t MIN_CHUNK_SIZE = 1024;
+static constexpr size_t MAX_CHUNK_SIZE = 256 * 1024;
 
 struct AudioFormat;
 struct Tag;
 
+/**
+ * Determine how many bytes of a chunk with the given capacity shall
+ * be filled with data in the specified audio format.  Large chunks
+ * are only filled partially for low bit rates, to keep the time
+ * resolution (elapsed time, cross-fading) reasonable.  The result is
+ * a multiple of the frame size.
+ */
+gcc_pure
+size_t
+CalcChunkLimit(AudioFormat af, size_t capacity);
+
 /**
  * A chunk of music data.  Its format is defined by the
  * MusicPipe::Push() caller.
+ *
+ * This object is only the header: the payload lives in a separate
+ * slab owned by the #MusicBuffer (see #data), so the headers of all
+ * chunks are packed densely.  The attributes which are checked while
+ * walking the pipe (see ao_count_batch()) come first, within the
+ * first cache line; the replay gain values, which are only read
+ * when they change, come last.
  */
-struct MusicChunk {
-	/** the next chunk in a linked list */
-	MusicChunk *next;
+struct alignas(64) MusicChunk {
+	/**
+	 * The next chunk in a linked list.  This is atomic because
+	 * the #MusicPipe is lock-free, and readers walk the list
+	 * while the producer appends to it.
+	 */
+	std::atomic<MusicChunk *> next;
 
 	/**
 	 * An optional chunk which should be mixed into this chunk.
@@ -50,21 +82,6 @@ struct MusicChunk {
 	 */
 	MusicChunk *other;
 
-	/**
-	 * The current mix ratio for cross-fading: 1.0 means play 100%
-	 * of this chunk, 0.0 means play 100% of the "other" chunk.
-	 */
-	float mix_ratio;
-
-	/** number of bytes stored in this chunk */
-	uint16_t length;
-
-	/** current bit rate of the source file */
-	uint16_t bit_rate;
-
-	/** the time stamp within the song */
-	SignedSongTime time;
-
 	/**
 	 * An optional tag associated with this chunk (and the
 	 * following chunks); appears at song boundaries.  The tag
@@ -74,10 +91,26 @@ struct MusicChunk {
 	Tag *tag;
 
 	/**
-	 * Replay gain information associated with this chunk.
-	 * Only valid if the serial is not 0.
+	 * The payload buffer.  It is owned by the #MusicBuffer,
+	 * which assigns it after allocating the chunk.
 	 */
-	ReplayGainInfo replay_gain_info;
+	uint8_t *data;
+
+	/**
+	 * The position of this chunk in the #MusicPipe, assigned by
+	 * MusicPipe::Push().  It grows with each chunk, and it is
+	 * never 0.
+	 */
+	uint64_t serial;
+
+	/** number of bytes stored in this chunk */
+	uint32_t length;
+
+	/**
+	 * The number of bytes which may be stored in #data.  The
+	 * decoder may lower this with SetLimit().
+	 */
+	uint32_t capacity;
 
 	/**
 	 * A serial number for checking if replay gain info has
@@ -86,8 +119,23 @@ struct MusicChunk {
 	 */
 	unsigned replay_gain_serial;
 
-	/** the data (probably PCM) */
-	uint8_t data[CHUNK_SIZE];
+	/** the time stamp within the song */
+	SignedSongTime time;
+
+	/**
+	 * The current mix ratio for cross-fading: 1.0 means play 100%
+	 * of this chunk, 0.0 means play 100% of the "other" chunk.
+	 */
+	float mix_ratio;
+
+	/** current bit rate of the source file */
+	uint16_t bit_rate;
+
+	/**
+	 * Replay gain information associated with this chunk.
+	 * Only valid if #replay_gain_serial is not 0.
+	 */
+	ReplayGainInfo replay_gain_info;
 
 #ifndef NDEBUG
 	AudioFormat audio_format;
@@ -95,8 +143,9 @@ struct MusicChunk {
 
 	MusicChunk()
 		:other(nullptr),
-		 length(0),
 		 tag(nullptr),
+		 data(nullptr),
+		 length(0), capacity(0),
 		 replay_gain_serial(0) {}
 
 	~MusicChunk();
@@ -105,6 +154,16 @@ struct MusicChunk {
 		return length == 0 && tag == nullptr;
 	}
 
+	/**
+	 * Reduce the usable capacity of this (empty) chunk.
+	 */
+	void SetLimit(size_t limit) {
+		assert(length == 0);
+
+		if (limit < capacity)
+			capacity = limit;
+	}
+
 #ifndef NDEBUG
 	/**
 	 * Checks if the audio format if the chunk is equal to the
@@ -22,14 +22,20 @@
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
 
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#include <time.h>
+#endif
+
 #ifndef NDEBUG
 
 bool
 MusicPipe::Contains(const MusicChunk *chunk) const
 {
-	const ScopeLock protect(mutex);
-
-	for (const MusicChunk *i = head; i != nullptr; i = i->next)
+	for (const MusicChunk *i = Peek(); i != nullptr;
+	     i = i->next.load(std::memory_order_acquire))
 		if (i == chunk)
 			return true;
 
@@ -38,36 +44,103 @@ MusicPipe::Contains(const MusicChunk *chunk) const
 
 #endif
 
-MusicChunk *
-MusicPipe::Shift()
+/**
+ * Wait until the producer has linked a chunk after the specified
+ * one.  Push() does that right after replacing the tail, so this
+ * window is usually only a few instructions wide; but the producer
+ * may be preempted inside it (e.g. by a real-time consumer thread on
+ * the same CPU), therefore spin only briefly, then give the CPU
+ * away.
+ */
+static MusicChunk *
+WaitNext(const MusicChunk &chunk)
 {
-	const ScopeLock protect(mutex);
+	static constexpr unsigned MAX_SPIN = 128;
+	static constexpr unsigned MAX_YIELD = 64;
 
-	MusicChunk *chunk = head;
-	if (chunk != nullptr) {
-		assert(!chunk->IsEmpty());
+	for (unsigned i = 0;; ++i) {
+		MusicChunk *next = chunk.next.load(std::memory_order_acquire);
+		if (next != nullptr)
+			return next;
 
-		head = chunk->next;
-		--size;
+		if (i < MAX_SPIN) {
+#if defined(__i386__) || defined(__x86_64__)
+			__builtin_ia32_pause();
+#endif
+		} else if (i < MAX_SPIN + MAX_YIELD) {
+#ifdef WIN32
+			SwitchToThread();
+#else
+			sched_yield();
+#endif
+		} else {
+			/* yielding does not help if the producer has
+			   a lower (real-time) priority; sleep to let
+			   it run */
+#ifdef WIN32
+			Sleep(1);
+#else
+			const struct timespec ts = { 0, 50000 };
+			nanosleep(&ts, nullptr);
+#endif
+		}
+	}
+}
 
-		if (head == nullptr) {
-			assert(size == 0);
-			assert(tail_r == &chunk->next);
+MusicChunk *
+MusicPipe::Shift()
+{
+	if (size.load(std::memory_order_acquire) == 0)
+		return nullptr;
+
+	/* "size" is incremented only after the chunk has been
+	   linked, so "head" is valid now */
+	MusicChunk *chunk = head.load(std::memory_order_acquire);
+	assert(chunk != nullptr);
+	assert(!chunk->IsEmpty());
 
-			tail_r = &head;
+	MusicChunk *next = chunk->next.load(std::memory_order_acquire);
+	if (next == nullptr) {
+		/* this is (or was) the last chunk: try to detach it
+		   from the tail before the producer links another
+		   one after it */
+		MusicChunk *expected = chunk;
+		if (tail.compare_exchange_strong(expected, nullptr,
+						 std::memory_order_acq_rel)) {
+			/* the pipe is empty now; the producer may
+			   have installed a new head meanwhile, which
+			   must not be overwritten */
+			expected = chunk;
+			head.compare_exchange_strong(expected, nullptr,
+						     std::memory_order_acq_rel);
 		} else {
-			assert(size > 0);
-			assert(tail_r != &chunk->next);
+			/* Push() has already replaced the tail and
+			   is about to link the new chunk */
+			next = WaitNext(*chunk);
+			head.store(next, std::memory_order_release);
 		}
+	} else
+		head.store(next, std::memory_order_release);
 
 #ifndef NDEBUG
-		/* poison the "next" reference */
-		chunk->next = (MusicChunk *)(void *)0x01010101;
+	/* poison the "next" reference */
+	chunk->next.store((MusicChunk *)(void *)0x01010101,
+			  std::memory_order_relaxed);
+#endif
+
+	const unsigned old_size =
+		size.fetch_sub(1, std::memory_order_acq_rel);
+	assert(old_size > 0);
 
-		if (size == 0)
+#ifndef NDEBUG
+	if (old_size == 1) {
+		const ScopeLock protect(mutex);
+		if (size.load(std::memory_order_relaxed) == 0)
 			audio_format.Clear();
-#endif
 	}
+#else
+	(void)old_size;
+#endif
 
 	return chunk;
 }
@@ -87,20 +160,27 @@ MusicPipe::Push(MusicChunk *chunk)
 	assert(!chunk->IsEmpty());
 	assert(chunk->length == 0 || chunk->audio_format.IsValid());
 
-	const ScopeLock protect(mutex);
+#ifndef NDEBUG
+	{
+		const ScopeLock protect(mutex);
 
-	assert(size > 0 || !audio_format.IsDefined());
-	assert(!audio_format.IsDefined() ||
-	       chunk->CheckFormat(audio_format));
+		assert(!audio_format.IsDefined() ||
+		       chunk->CheckFormat(audio_format));
 
-#ifndef NDEBUG
-	if (!audio_format.IsDefined() && chunk->length > 0)
-		audio_format = chunk->audio_format;
+		if (!audio_format.IsDefined() && chunk->length > 0)
+			audio_format = chunk->audio_format;
+	}
 #endif
 
-	chunk->next = nullptr;
-	*tail_r = chunk;
-	tail_r = &chunk->next;
+	chunk->next.store(nullptr, std::memory_order_relaxed);
+	chunk->serial = next_serial++;
+
+	MusicChunk *prev = tail.exchange(chunk, std::memory_order_acq_rel);
+	if (prev == nullptr)
+		/* the pipe was empty */
+		head.store(chunk, std::memory_order_release);
+	else
+		prev->next.store(chunk, std::memory_order_release);
 
-	++size;
+	size.fetch_add(1, std::memory_order_release);
 }
@@ -20,13 +20,15 @@
 #ifndef MPD_PIPE_H
 #define MPD_PIPE_H
 
-#include "thread/Mutex.hxx"
 #include "Compiler.h"
 
 #ifndef NDEBUG
+#include "thread/Mutex.hxx"
 #include "AudioFormat.hxx"
 #endif
 
+#include <atomic>
+
 #include <assert.h>
 
 struct MusicChunk;
@@ -35,21 +37,44 @@ class MusicBuffer;
 /**
  * A queue of #MusicChunk objects.  One party appends chunks at the
  * tail, and the other consumes them from the head.
+ *
+ * This class is lock-free: there may be one thread calling Push()
+ * and another thread calling Shift() (or Clear()) at the same time,
+ * without any additional locking.  Any number of readers may walk
+ * the list starting at Peek() via MusicChunk::next, as long as the
+ * consumer does not remove the chunks they are looking at.
  */
 class MusicPipe {
-	/** the first chunk */
-	MusicChunk *head;
+	/**
+	 * The first chunk.  It is modified by the consumer, and by
+	 * the producer only while the pipe is empty.
+	 */
+	std::atomic<MusicChunk *> head;
 
-	/** a pointer to the tail of the chunk */
-	MusicChunk **tail_r;
+	/**
+	 * The last chunk.  It is modified by the producer, and by the
+	 * consumer only when it removes the last chunk.
+	 */
+	std::atomic<MusicChunk *> tail;
 
-	/** the current number of chunks */
-	unsigned size;
+	/**
+	 * The current number of chunks.  It is incremented by the
+	 * producer after the new chunk has been linked, and
+	 * decremented by the consumer after a chunk has been
+	 * unlinked.
+	 */
+	std::atomic_uint size;
 
-	/** a mutex which protects #head and #tail_r */
-	mutable Mutex mutex;
+	/**
+	 * The #MusicChunk::serial of the next chunk passed to
+	 * Push().  Only used by the producer.
+	 */
+	uint64_t next_serial;
 
 #ifndef NDEBUG
+	/** a mutex which protects #audio_format */
+	mutable Mutex mutex;
+
 	AudioFormat audio_format;
 #endif
 
@@ -58,7 +83,7 @@ public:
 	 * Creates a new #MusicPipe object.  It is empty.
 	 */
 	MusicPipe()
-		:head(nullptr), tail_r(&head), size(0) {
+		:head(nullptr), tail(nullptr), size(0), next_serial(1) {
 #ifndef NDEBUG
 		audio_format.Clear();
 #endif
@@ -69,7 +94,7 @@ public:
 	 */
 	~MusicPipe() {
 		assert(head == nullptr);
-		assert(tail_r == &head);
+		assert(tail == nullptr);
 	}
 
 #ifndef NDEBUG
@@ -79,6 +104,7 @@ public:
 	 */
 	gcc_pure
 	bool CheckFormat(AudioFormat other) const {
+		const ScopeLock protect(mutex);
 		return !audio_format.IsDefined() ||
 			audio_format == other;
 	}
@@ -96,11 +122,12 @@ public:
 	 */
 	gcc_pure
 	const MusicChunk *Peek() const {
-		return head;
+		return head.load(std::memory_order_acquire);
 	}
 
 	/**
 	 * Removes the first chunk from the head, and returns it.
+	 * This must only be called by the consumer.
 	 */
 	MusicChunk *Shift();
 
@@ -112,7 +139,8 @@ public:
 	void Clear(MusicBuffer &buffer);
 
 	/**
-	 * Pushes a chunk to the tail of the pipe.
+	 * Pushes a chunk to the tail of the pipe.  This must only be
+	 * called by the producer.
 	 */
 	void Push(MusicChunk *chunk);
 
@@ -121,7 +149,7 @@ public:
 	 */
 	gcc_pure
 	unsigned GetSize() const {
-		return size;
+		return size.load(std::memory_order_acquire);
 	}
 
 	gcc_pure
@@ -33,6 +33,13 @@ Partition::DatabaseModified(const Database &db)
 	playlist.DatabaseModified(db);
 }
 
+void
+Partition::StorageMountChanged(const Storage &storage,
+			       const char *mount_point)
+{
+	playlist.StorageMountChanged(storage, mount_point);
+}
+
 #endif
 
 void
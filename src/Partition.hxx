@@ -31,6 +31,7 @@
 struct Instance;
 class MultipleOutputs;
 class SongLoader;
+class Storage;
 
 /**
  * A partition of the Music Player Daemon.  It is a separate unit with
@@ -48,10 +49,12 @@ struct Partition final : private PlayerListener, private MixerListener {
 	Partition(Instance &_instance,
 		  unsigned max_length,
 		  unsigned buffer_chunks,
+		  size_t chunk_size,
 		  unsigned buffered_before_play)
 		:instance(_instance), playlist(max_length),
 		 outputs(*this),
-		 pc(*this, outputs, buffer_chunks, buffered_before_play) {}
+		 pc(*this, outputs, buffer_chunks, chunk_size,
+		    buffered_before_play) {}
 
 	void ClearQueue() {
 		playlist.Clear(pc);
@@ -181,6 +184,13 @@ struct Partition final : private PlayerListener, private MixerListener {
 	 * all subsystems.
 	 */
 	void DatabaseModified(const Database &db);
+
+	/**
+	 * A storage has been mounted or unmounted.  See
+	 * playlist::StorageMountChanged().
+	 */
+	void StorageMountChanged(const Storage &storage,
+				 const char *mount_point);
 #endif
 
 	/**
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "PlayerControl.hxx"
+#include "PlayerListener.hxx"
 #include "Idle.hxx"
 #include "DetachedSong.hxx"
 
@@ -29,26 +30,80 @@
 PlayerControl::PlayerControl(PlayerListener &_listener,
 			     MultipleOutputs &_outputs,
 			     unsigned _buffer_chunks,
+			     size_t _chunk_size,
 			     unsigned _buffered_before_play)
 	:listener(_listener), outputs(_outputs),
 	 buffer_chunks(_buffer_chunks),
+	 chunk_size(_chunk_size),
 	 buffered_before_play(_buffered_before_play),
 	 command(PlayerCommand::NONE),
 	 state(PlayerState::STOP),
+	 async_command(PlayerCommand::NONE),
+	 submitted_commands(0), finished_commands(0),
 	 error_type(PlayerError::NONE),
 	 tagged_song(nullptr),
 	 next_song(nullptr),
 	 total_play_time(0),
 	 border_pause(false)
 {
+	statistics.Clear();
 }
 
 PlayerControl::~PlayerControl()
 {
+	assert(waiters.empty());
+
 	delete next_song;
 	delete tagged_song;
 }
 
+bool
+PlayerControl::AddWaiter(PlayerCommandWaiter &waiter)
+{
+	const ScopeLock protect(mutex);
+
+	if (finished_commands == submitted_commands)
+		return false;
+
+	waiter.serial = submitted_commands;
+	waiters.push_front(&waiter);
+	return true;
+}
+
+void
+PlayerControl::RemoveWaiter(PlayerCommandWaiter &waiter)
+{
+	const ScopeLock protect(mutex);
+	waiters.remove(&waiter);
+}
+
+void
+PlayerControl::NotifyWaiters()
+{
+	waiters.remove_if([this](PlayerCommandWaiter *waiter){
+			if (int(finished_commands - waiter->serial) < 0)
+				return false;
+
+			waiter->OnPlayerCommandsFinished();
+			return true;
+		});
+}
+
+void
+PlayerControl::AsyncCommandFinished()
+{
+	const PlayerCommand cmd = async_command;
+	async_command = PlayerCommand::NONE;
+
+	/* the main thread has skipped the work which depends on
+	   the result (e.g. queueing the next song); let it catch
+	   up now */
+	listener.OnPlayerSync();
+
+	if (cmd == PlayerCommand::SEEK)
+		idle_add(IDLE_PLAYER);
+}
+
 void
 PlayerControl::Play(DetachedSong *song)
 {
@@ -56,14 +111,16 @@ PlayerControl::Play(DetachedSong *song)
 
 	Lock();
 
+	WaitCommandLocked();
+
 	if (state != PlayerState::STOP)
 		SynchronousCommand(PlayerCommand::STOP);
 
 	assert(next_song == nullptr);
 
-	EnqueueSongLocked(song);
-
-	assert(next_song == nullptr);
+	/* don't wait for the decoder to open the song */
+	next_song = song;
+	SubmitCommand(PlayerCommand::QUEUE);
 
 	Unlock();
 }
@@ -104,6 +161,9 @@ PlayerControl::Kill()
 void
 PlayerControl::PauseLocked()
 {
+	/* a pending asynchronous command may change the state */
+	WaitCommandLocked();
+
 	if (state != PlayerState::STOP) {
 		SynchronousCommand(PlayerCommand::PAUSE);
 		idle_add(IDLE_PLAYER);
@@ -122,6 +182,7 @@ void
 PlayerControl::SetPause(bool pause_flag)
 {
 	Lock();
+	WaitCommandLocked();
 
 	switch (state) {
 	case PlayerState::STOP:
@@ -155,6 +216,9 @@ PlayerControl::GetStatus()
 	player_status status;
 
 	Lock();
+
+	/* this waits for a pending asynchronous command, so the
+	   status reflects its outcome */
 	SynchronousCommand(PlayerCommand::REFRESH);
 
 	status.state = state;
@@ -164,6 +228,9 @@ PlayerControl::GetStatus()
 		status.audio_format = audio_format;
 		status.total_time = total_time;
 		status.elapsed_time = elapsed_time;
+		status.input_buffered = statistics.decoder.input_buffered;
+		status.input_buffer_limit =
+			statistics.decoder.input_buffer_limit;
 	}
 
 	Unlock();
@@ -171,6 +238,17 @@ PlayerControl::GetStatus()
 	return status;
 }
 
+PlayerStatistics
+PlayerControl::GetStatistics()
+{
+	Lock();
+	SynchronousCommand(PlayerCommand::REFRESH);
+	const PlayerStatistics result = statistics;
+	Unlock();
+
+	return result;
+}
+
 void
 PlayerControl::SetError(PlayerError type, Error &&_error)
 {
@@ -227,16 +305,15 @@ PlayerControl::Seek(DetachedSong *song, SongTime t)
 
 	Lock();
 
+	/* the player thread may still be using #next_song */
+	WaitCommandLocked();
+
 	delete next_song;
 	next_song = song;
 	seek_time = t;
-	SynchronousCommand(PlayerCommand::SEEK);
+	SubmitCommand(PlayerCommand::SEEK);
 	Unlock();
 
-	assert(next_song == nullptr);
-
-	idle_add(IDLE_PLAYER);
-
 	return true;
 }
 
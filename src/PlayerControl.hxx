@@ -21,6 +21,7 @@
 #define MPD_PLAYER_CONTROL_HXX
 
 #include "AudioFormat.hxx"
+#include "decoder/DecoderStatistics.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
@@ -28,6 +29,9 @@
 #include "CrossFade.hxx"
 #include "Chrono.hxx"
 
+#include <algorithm>
+#include <forward_list>
+
 #include <stdint.h>
 
 class PlayerListener;
@@ -91,6 +95,67 @@ struct player_status {
 	AudioFormat audio_format;
 	SignedSongTime total_time;
 	SongTime elapsed_time;
+
+	/**
+	 * The fill level of the decoder's read-ahead input buffer;
+	 * see DecoderStatistics::input_buffered.
+	 */
+	size_t input_buffered, input_buffer_limit;
+};
+
+/**
+ * Instrumentation of the song currently being played.
+ */
+struct PlayerStatistics {
+	static constexpr unsigned PIPE_FILL_BUCKETS = 10;
+
+	/**
+	 * A copy of DecoderControl::statistics for this song.
+	 */
+	DecoderStatistics decoder;
+
+	/**
+	 * The number of times the #MusicPipe ran empty while the
+	 * decoder was still busy, i.e. playback was interrupted
+	 * because the decoder was too slow.
+	 */
+	unsigned stalls;
+
+	/**
+	 * A histogram of the #MusicPipe fill level, sampled each time
+	 * a chunk is sent to the audio outputs.  Bucket i counts the
+	 * samples where the pipe was i/#PIPE_FILL_BUCKETS full.
+	 */
+	unsigned pipe_fill[PIPE_FILL_BUCKETS];
+
+	void Clear() {
+		decoder.Clear();
+		stalls = 0;
+		std::fill_n(pipe_fill, PIPE_FILL_BUCKETS, 0u);
+	}
+};
+
+/**
+ * An object which waits for the player thread to finish all commands
+ * which were submitted before PlayerControl::AddWaiter().  This is
+ * used to delay a client's response to an asynchronous command.
+ */
+class PlayerCommandWaiter {
+	friend struct PlayerControl;
+
+	/**
+	 * The value of PlayerControl::submitted_commands when this
+	 * object was added.
+	 */
+	unsigned serial;
+
+public:
+	/**
+	 * All commands have been finished.  This is called by the
+	 * player thread while PlayerControl::mutex is locked, and
+	 * the object has already been removed.
+	 */
+	virtual void OnPlayerCommandsFinished() = 0;
 };
 
 struct PlayerControl {
@@ -100,6 +165,11 @@ struct PlayerControl {
 
 	const unsigned buffer_chunks;
 
+	/**
+	 * The payload size of each #MusicChunk.
+	 */
+	const size_t chunk_size;
+
 	const unsigned buffered_before_play;
 
 	/**
@@ -127,6 +197,25 @@ struct PlayerControl {
 	PlayerCommand command;
 	PlayerState state;
 
+	/**
+	 * The command which was submitted without waiting for it
+	 * (see SubmitCommand()), or PlayerCommand::NONE.  Unlike
+	 * #command, it is not modified by the player thread.
+	 */
+	PlayerCommand async_command;
+
+	/**
+	 * The number of commands submitted by the main thread and
+	 * the number of commands finished by the player thread.
+	 * Protected by #mutex.
+	 */
+	unsigned submitted_commands, finished_commands;
+
+	/**
+	 * Protected by #mutex.
+	 */
+	std::forward_list<PlayerCommandWaiter *> waiters;
+
 	PlayerError error_type;
 
 	/**
@@ -154,6 +243,11 @@ struct PlayerControl {
 	SignedSongTime total_time;
 	SongTime elapsed_time;
 
+	/**
+	 * Protected by #mutex.  Updated by the PlayerThread.
+	 */
+	PlayerStatistics statistics;
+
 	/**
 	 * The next queued song.
 	 *
@@ -180,6 +274,7 @@ struct PlayerControl {
 	PlayerControl(PlayerListener &_listener,
 		      MultipleOutputs &_outputs,
 		      unsigned buffer_chunks,
+		      size_t chunk_size,
 		      unsigned buffered_before_play);
 	~PlayerControl();
 
@@ -260,10 +355,59 @@ struct PlayerControl {
 		assert(command != PlayerCommand::NONE);
 
 		command = PlayerCommand::NONE;
+		++finished_commands;
 		ClientSignal();
+
+		if (async_command != PlayerCommand::NONE)
+			AsyncCommandFinished();
+
+		if (!waiters.empty())
+			NotifyWaiters();
 	}
 
+	/**
+	 * Is a command still being executed by the player thread?
+	 * This can only be an asynchronous one (see Seek() and
+	 * Play()).
+	 *
+	 * Caller must lock the object.
+	 */
+	bool IsCommandPending() const {
+		return command != PlayerCommand::NONE;
+	}
+
+	/**
+	 * Wait until the pending asynchronous command (if any) has
+	 * been finished.  This method locks the object.
+	 */
+	void LockWaitCommand() {
+		Lock();
+		WaitCommandLocked();
+		Unlock();
+	}
+
+	/**
+	 * Register a #PlayerCommandWaiter which will be notified
+	 * when all commands submitted so far have been finished.
+	 *
+	 * To be called from the main thread.  This method locks the
+	 * object.
+	 *
+	 * @return false if no command is pending; the object has not
+	 * been registered
+	 */
+	bool AddWaiter(PlayerCommandWaiter &waiter);
+
+	/**
+	 * Unregister a #PlayerCommandWaiter, unless it has already
+	 * been notified.  This method locks the object.
+	 */
+	void RemoveWaiter(PlayerCommandWaiter &waiter);
+
 private:
+	void AsyncCommandFinished();
+	void NotifyWaiters();
+
 	/**
 	 * Wait for the command to be finished by the player thread.
 	 *
@@ -275,17 +419,36 @@ private:
 			ClientWait();
 	}
 
+	/**
+	 * Send a command to the player thread and return
+	 * immediately.  When the player thread has finished it, the
+	 * #PlayerListener is asked to synchronize the playlist.  If
+	 * another command is still pending, wait for it first.
+	 *
+	 * To be called from the main thread.  Caller must lock the
+	 * object.
+	 */
+	void SubmitCommand(PlayerCommand cmd) {
+		WaitCommandLocked();
+
+		command = async_command = cmd;
+		++submitted_commands;
+		Signal();
+	}
+
 	/**
 	 * Send a command to the player thread and synchronously wait
-	 * for it to finish.
+	 * for it to finish.  If another command is still pending,
+	 * wait for it first.
 	 *
 	 * To be called from the main thread.  Caller must lock the
 	 * object.
 	 */
 	void SynchronousCommand(PlayerCommand cmd) {
-		assert(command == PlayerCommand::NONE);
+		WaitCommandLocked();
 
 		command = cmd;
+		++submitted_commands;
 		Signal();
 		WaitCommandLocked();
 	}
@@ -305,6 +468,9 @@ private:
 
 public:
 	/**
+	 * Start playing the song.  This does not wait until the
+	 * decoder has opened it.
+	 *
 	 * @param song the song to be queued; the given instance will
 	 * be owned and freed by the player
 	 */
@@ -330,9 +496,21 @@ public:
 
 	void Kill();
 
+	/**
+	 * Query the current status from the player thread.  If an
+	 * asynchronous command (see Seek() and Play()) is pending,
+	 * this waits until it has been finished.
+	 */
 	gcc_pure
 	player_status GetStatus();
 
+	/**
+	 * Returns the instrumentation of the current song.  Waits
+	 * for a pending asynchronous command, like GetStatus().
+	 */
+	gcc_pure
+	PlayerStatistics GetStatistics();
+
 	PlayerState GetState() const {
 		return state;
 	}
@@ -414,6 +592,8 @@ public:
 private:
 	void EnqueueSongLocked(DetachedSong *song) {
 		assert(song != nullptr);
+
+		WaitCommandLocked();
 		assert(next_song == nullptr);
 
 		next_song = song;
@@ -429,6 +609,8 @@ public:
 
 	/**
 	 * Makes the player thread seek the specified song to a position.
+	 * This does not wait for the seek to complete; afterwards,
+	 * the #PlayerListener is asked to synchronize the playlist.
 	 *
 	 * @param song the song to be queued; the given instance will be owned
 	 * and freed by the player
@@ -20,7 +20,6 @@
 #include "config.h"
 #include "PlayerThread.hxx"
 #include "PlayerListener.hxx"
-#include "decoder/DecoderThread.hxx"
 #include "decoder/DecoderControl.hxx"
 #include "MusicPipe.hxx"
 #include "MusicBuffer.hxx"
@@ -28,14 +27,29 @@
 #include "DetachedSong.hxx"
 #include "system/FatalError.hxx"
 #include "CrossFade.hxx"
+#include "LatencyProfile.hxx"
+#include "ThreadConfig.hxx"
 #include "PlayerControl.hxx"
 #include "output/MultipleOutputs.hxx"
+#include "pcm/PcmMix.hxx"
+#include "pcm/PcmDither.hxx"
+#include "pcm/Volume.hxx"
+#include "ReplayGainConfig.hxx"
+#include "metrics/Metrics.hxx"
+#include "system/Trace.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "util/Error.hxx"
+#include "util/ConstBuffer.hxx"
 #include "tag/Tag.hxx"
 #include "Idle.hxx"
 #include "util/Domain.hxx"
 #include "thread/Name.hxx"
 #include "Log.hxx"
 
+#include <string>
+#include <algorithm>
+
 #include <string.h>
 
 static constexpr Domain player_domain("player");
@@ -72,6 +86,13 @@ class Player {
 	 */
 	bool decoder_woken;
 
+	/**
+	 * Has the #MusicPipe run empty while the decoder was busy?
+	 * This is used to count each stall only once in
+	 * PlayerStatistics::stalls.
+	 */
+	bool stalled;
+
 	/**
 	 * is the player paused?
 	 */
@@ -117,6 +138,14 @@ class Player {
 	 */
 	Tag *cross_fade_tag;
 
+	/**
+	 * Mix cross-faded chunks here instead of passing both chunks
+	 * to the outputs?  This is the "player_cross_fade" setting.
+	 */
+	const bool premix_cross_fade;
+
+	PcmDither cross_fade_dither;
+
 	/**
 	 * The current audio format for the audio outputs.
 	 */
@@ -138,6 +167,7 @@ public:
 		 buffering(true),
 		 decoder_starting(false),
 		 decoder_woken(false),
+		 stalled(false),
 		 paused(false),
 		 queued(true),
 		 output_open(false),
@@ -146,9 +176,18 @@ public:
 		 cross_fading(false),
 		 cross_fade_chunks(0),
 		 cross_fade_tag(nullptr),
+		 premix_cross_fade(config_get_bool(ConfigOption::PLAYER_CROSS_FADE,
+						   false)),
 		 elapsed_time(SongTime::zero()) {}
 
 private:
+	/**
+	 * Mix the "other" chunk into the specified chunk, so the
+	 * outputs receive pre-mixed PCM data.  The "other" chunk is
+	 * returned to the buffer.
+	 */
+	bool MixCrossFade(MusicChunk &chunk, Error &error);
+
 	void ClearAndDeletePipe() {
 		pipe->Clear(buffer);
 		delete pipe;
@@ -164,6 +203,25 @@ private:
 		pipe = _pipe;
 	}
 
+	/**
+	 * Copy the decoder's statistics to the #PlayerControl, unless
+	 * it is already decoding the next song.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void UpdateDecoderStatistics() {
+		if (!IsDecoderAtNextSong())
+			pc.statistics.decoder = dc.statistics;
+	}
+
+	/**
+	 * Log the statistics of the song which has just been played
+	 * and reset them.
+	 *
+	 * Player lock is not held.
+	 */
+	void FinishStatistics();
+
 	/**
 	 * Start the decoder.
 	 *
@@ -210,6 +268,21 @@ private:
 		return dc.pipe != nullptr && !IsDecoderAtCurrentSong();
 	}
 
+	/**
+	 * If the seek target has already been decoded into the
+	 * current #pipe, discard the chunks before it instead of
+	 * seeking the decoder.
+	 *
+	 * The player lock is not held.
+	 *
+	 * @param target the seek target within the file (including
+	 * the song's start time)
+	 * @return the time stamp of the chunk which contains the
+	 * target, or a negative value if the target is not in the
+	 * pipe (the pipe is unmodified then)
+	 */
+	SignedSongTime SkipBufferedChunks(SongTime target);
+
 	/**
 	 * This is the handler for the #PlayerCommand::SEEK command.
 	 *
@@ -497,7 +570,7 @@ Player::SendSilence()
 	const size_t frame_size = play_audio_format.GetFrameSize();
 	/* this formula ensures that we don't send
 	   partial frames */
-	unsigned num_frames = sizeof(chunk->data) / frame_size;
+	unsigned num_frames = chunk->capacity / frame_size;
 
 	chunk->time = SignedSongTime::Negative(); /* undefined time stamp */
 	chunk->length = num_frames * frame_size;
@@ -513,6 +586,49 @@ Player::SendSilence()
 	return true;
 }
 
+SignedSongTime
+Player::SkipBufferedChunks(SongTime target)
+{
+	const MusicChunk *chunk = pipe->Peek();
+	if (chunk == nullptr || chunk->length == 0 ||
+	    chunk->tag != nullptr || chunk->time > target)
+		return SignedSongTime::Negative();
+
+	/* find the chunk which contains the target; the decoder may
+	   append more chunks meanwhile, but it does not modify the
+	   ones which are already in the pipe */
+	unsigned n = 0;
+	while (true) {
+		const MusicChunk *next =
+			chunk->next.load(std::memory_order_acquire);
+
+		/* the target may be beyond the last chunk, or a tag
+		   would get lost: let the decoder seek */
+		if (next == nullptr || next->length == 0 ||
+		    next->tag != nullptr)
+			return SignedSongTime::Negative();
+
+		if (next->time > target)
+			break;
+
+		chunk = next;
+		++n;
+	}
+
+	const SignedSongTime time = chunk->time;
+
+	while (n-- > 0)
+		buffer.Return(pipe->Shift());
+
+	/* there is room in the pipe now */
+	pc.Lock();
+	if (!dc.IsIdle())
+		dc.Signal();
+	pc.Unlock();
+
+	return time;
+}
+
 inline bool
 Player::SeekDecoder()
 {
@@ -568,7 +684,15 @@ Player::SeekDecoder()
 			where = total_time;
 	}
 
-	if (!dc.Seek(where + start_time)) {
+	const SignedSongTime skipped = IsDecoderAtCurrentSong()
+		? SkipBufferedChunks(where + start_time)
+		: SignedSongTime::Negative();
+	if (!skipped.IsNegative()) {
+		/* the target was already in the pipe; there's no
+		   need to decode it again */
+		if (skipped >= SignedSongTime(start_time))
+			where = SongTime(skipped) - start_time;
+	} else if (!dc.Seek(where + start_time)) {
 		/* decoder failure */
 		player_command_finished(pc);
 		return false;
@@ -612,6 +736,17 @@ Player::ProcessCommand()
 
 		queued = true;
 		pc.CommandFinished();
+
+		{
+			/* start opening the next song while the
+			   decoder is still busy with the current
+			   one */
+			const std::string uri = pc.next_song->GetRealURI();
+			pc.Unlock();
+			dc.lookahead.Start(uri.c_str());
+			pc.Lock();
+		}
+
 		break;
 
 	case PlayerCommand::PAUSE:
@@ -661,6 +796,10 @@ Player::ProcessCommand()
 			pc.Lock();
 		}
 
+		pc.Unlock();
+		dc.lookahead.Cancel();
+		pc.Lock();
+
 		delete pc.next_song;
 		pc.next_song = nullptr;
 		queued = false;
@@ -678,6 +817,8 @@ Player::ProcessCommand()
 			? SongTime(pc.outputs.GetElapsedTime())
 			: elapsed_time;
 
+		UpdateDecoderStatistics();
+
 		pc.CommandFinished();
 		break;
 	}
@@ -742,14 +883,93 @@ play_chunk(PlayerControl &pc,
 	return true;
 }
 
+/**
+ * Calculate the replay gain scale which the outputs will apply to
+ * the chunk.
+ */
+gcc_pure
+static float
+CalculateReplayGainScale(const MusicChunk &chunk, ReplayGainMode mode)
+{
+	ReplayGainInfo info;
+	if (chunk.replay_gain_serial != 0)
+		info = chunk.replay_gain_info;
+	else
+		info.Clear();
+
+	return info.tuples[mode].CalculateScale(replay_gain_preamp,
+						replay_gain_missing_preamp,
+						replay_gain_limit);
+}
+
+bool
+Player::MixCrossFade(MusicChunk &chunk, Error &error)
+{
+	MusicChunk &other = *chunk.other;
+	assert(!other.IsEmpty());
+
+	const SampleFormat format = play_audio_format.format;
+
+	/* the outputs will apply the replay gain of the current
+	   song to the mixed chunk; scale the new song's data so it
+	   gets its own replay gain */
+	const ReplayGainMode mode = pc.outputs.GetReplayGainMode();
+	if (mode != REPLAY_GAIN_OFF &&
+	    other.replay_gain_serial != chunk.replay_gain_serial) {
+		const float scale = CalculateReplayGainScale(other, mode) /
+			CalculateReplayGainScale(chunk, mode);
+		const unsigned volume = pcm_float_to_volume(scale);
+
+		if (volume != PCM_VOLUME_1) {
+			PcmVolume pv;
+			if (!pv.Open(format, error))
+				return false;
+
+			pv.SetVolume(volume);
+			const auto dest =
+				pv.Apply(ConstBuffer<void>(other.data,
+							    other.length));
+			memcpy(other.data, dest.data, dest.size);
+			pv.Close();
+		}
+	}
+
+	/* see pre_output_filter_chunk(): if the "other" chunk is
+	   longer, its trailer is used as-is; the mix ratio is
+	   reversed because the arguments to pcm_mix() are reversed,
+	   except for the negative MixRamp special case */
+
+	const size_t size = std::min(chunk.length, other.length);
+
+	float mix_ratio = chunk.mix_ratio;
+	if (mix_ratio >= 0)
+		mix_ratio = 1.0 - mix_ratio;
+
+	if (!pcm_mix(cross_fade_dither, other.data, chunk.data, size,
+		     format, mix_ratio)) {
+		error.Format(player_domain, "Cannot cross-fade format %s",
+			     sample_format_to_string(format));
+		return false;
+	}
+
+	memcpy(chunk.data, other.data, other.length);
+	chunk.length = other.length;
+
+	chunk.other = nullptr;
+	buffer.Return(&other);
+	return true;
+}
+
 inline bool
 Player::PlayNextChunk()
 {
-	if (!pc.outputs.Wait(pc, 64))
+	if (!pc.outputs.Wait(pc, GetLatencySettings().output_chunks))
 		/* the output pipe is still large enough, don't send
 		   another chunk */
 		return true;
 
+	const ScopeTrace trace("Player::PlayNextChunk");
+
 	unsigned cross_fade_position;
 	MusicChunk *chunk = nullptr;
 	if (xfade_state == CrossFadeState::ENABLED && IsDecoderAtNextSong() &&
@@ -799,6 +1019,13 @@ Player::PlayNextChunk()
 			}
 
 			chunk->other = other_chunk;
+
+			Error error;
+			if (premix_cross_fade && other_chunk != nullptr &&
+			    !MixCrossFade(*chunk, error)) {
+				/* fall back to mixing in the outputs */
+				LogError(error);
+			}
 		} else {
 			/* there are not enough decoded chunks yet */
 
@@ -857,10 +1084,19 @@ Player::PlayNextChunk()
 		return false;
 	}
 
+	stalled = false;
+
 	/* this formula should prevent that the decoder gets woken up
 	   with each chunk; it is more efficient to make it decode a
 	   larger block at a time */
 	pc.Lock();
+
+	const unsigned fill = std::min(pipe->GetSize() *
+				       PlayerStatistics::PIPE_FILL_BUCKETS /
+				       buffer.GetSize(),
+				       PlayerStatistics::PIPE_FILL_BUCKETS - 1);
+	++pc.statistics.pipe_fill[fill];
+	global_metrics.pipe_chunks.Set(pipe->GetSize());
 	if (!dc.IsIdle() &&
 	    dc.pipe->GetSize() <= (pc.buffered_before_play +
 				   buffer.GetSize() * 3) / 4) {
@@ -875,12 +1111,45 @@ Player::PlayNextChunk()
 	return true;
 }
 
+void
+Player::FinishStatistics()
+{
+	pc.Lock();
+	const PlayerStatistics s = pc.statistics;
+	pc.statistics.Clear();
+	pc.Unlock();
+
+	const DecoderStatistics &d = s.decoder;
+	const double run_time = d.run_time / 1000000.;
+	const double cpu_load = d.run_time > 0
+		? d.cpu_time * 100. / d.run_time
+		: 0;
+
+	if (s.stalls > 0)
+		FormatWarning(player_domain,
+			      "%u stalls in \"%s\": decoder %.1fx real time, "
+			      "%.1f%% CPU, waited %.3fs for input",
+			      s.stalls, song->GetURI(),
+			      d.GetSpeed(), cpu_load,
+			      d.input_wait_time / 1000000.);
+	else
+		FormatDebug(player_domain,
+			    "decoded %.1fs in %.3fs (%.1fx real time, "
+			    "%.1f%% CPU), waited %.3fs for buffer, "
+			    "%.3fs for input",
+			    d.GetDecodedDuration(), run_time,
+			    d.GetSpeed(), cpu_load,
+			    d.buffer_wait_time / 1000000.,
+			    d.input_wait_time / 1000000.);
+}
+
 inline bool
 Player::SongBorder()
 {
 	xfade_state = CrossFadeState::UNKNOWN;
 
 	FormatDefault(player_domain, "played \"%s\"", song->GetURI());
+	FinishStatistics();
 
 	ReplacePipe(dc.pipe);
 
@@ -922,6 +1191,7 @@ Player::Run()
 
 	pc.Lock();
 	pc.state = PlayerState::PLAY;
+	pc.statistics.Clear();
 
 	if (pc.command == PlayerCommand::SEEK)
 		elapsed_time = pc.seek_time;
@@ -988,6 +1258,10 @@ Player::Run()
 
 			assert(dc.pipe == nullptr || dc.pipe == pipe);
 
+			pc.Lock();
+			UpdateDecoderStatistics();
+			pc.Unlock();
+
 			StartDecoder(*new MusicPipe());
 		}
 
@@ -1008,6 +1282,7 @@ Player::Run()
 							dc.GetMixRampPreviousEnd(),
 							dc.out_audio_format,
 							play_audio_format,
+							buffer.GetChunkSize(),
 							buffer.GetSize() -
 							pc.buffered_before_play);
 			if (cross_fade_chunks > 0) {
@@ -1062,6 +1337,15 @@ Player::Run()
 			/* the decoder is too busy and hasn't provided
 			   new PCM data in time: send silence (if the
 			   output pipe is empty) */
+			if (!stalled) {
+				stalled = true;
+
+				pc.Lock();
+				++pc.statistics.stalls;
+				global_metrics.player_stalls.Add();
+				pc.Unlock();
+			}
+
 			if (!SendSilence())
 				break;
 		}
@@ -1069,6 +1353,10 @@ Player::Run()
 		pc.Lock();
 	}
 
+	pc.Lock();
+	UpdateDecoderStatistics();
+	pc.Unlock();
+
 	StopDecoder();
 
 	ClearAndDeletePipe();
@@ -1077,6 +1365,7 @@ Player::Run()
 
 	if (song != nullptr) {
 		FormatDefault(player_domain, "played \"%s\"", song->GetURI());
+		FinishStatistics();
 		delete song;
 	}
 
@@ -1109,11 +1398,19 @@ player_task(void *arg)
 	PlayerControl &pc = *(PlayerControl *)arg;
 
 	SetThreadName("player");
+	ApplyThreadConfig("player");
 
 	DecoderControl dc(pc.mutex, pc.cond);
-	decoder_thread_start(dc);
 
-	MusicBuffer buffer(pc.buffer_chunks);
+	/* the chunks up to the level where the decoder gets woken up
+	   (see Player::PlayNextChunk()), plus those cached in the
+	   magazines of both threads, are always available; the
+	   decoder would miss its wakeup otherwise.  Only the rest is
+	   subject to the "audio_buffer_budget". */
+	const unsigned reserve =
+		(pc.buffered_before_play + pc.buffer_chunks * 3) / 4 +
+		2 * MusicBuffer::MAGAZINE_SIZE;
+	MusicBuffer buffer(pc.buffer_chunks, pc.chunk_size, reserve);
 
 	pc.Lock();
 
@@ -1125,6 +1422,7 @@ player_task(void *arg)
 
 			pc.Unlock();
 			do_play(pc, dc, buffer);
+			buffer.FlushThreadCache();
 			pc.listener.OnPlayerSync();
 			pc.Lock();
 			break;
@@ -1147,6 +1445,7 @@ player_task(void *arg)
 			pc.Unlock();
 
 			pc.outputs.Release();
+			buffer.FlushThreadCache();
 
 			pc.Lock();
 			pc.CommandFinished();
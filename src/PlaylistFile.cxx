@@ -40,10 +40,25 @@
 #include "fs/FileSystem.hxx"
 #include "fs/FileInfo.hxx"
 #include "fs/DirectoryReader.hxx"
+#include "event/TimeoutMonitor.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Macros.hxx"
 #include "util/StringUtil.hxx"
 #include "util/UriUtil.hxx"
 #include "util/Error.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_INOTIFY
+#include "db/update/InotifySource.hxx"
+
+#include <map>
+
+#include <sys/inotify.h>
+#endif
+
+#include <functional>
+#include <list>
+#include <algorithm>
 
 #include <assert.h>
 #include <sys/stat.h>
@@ -197,28 +212,224 @@ LoadPlaylistFileInfo(PlaylistInfo &info,
 	return true;
 }
 
-PlaylistVector
-ListPlaylistFiles(Error &error)
+static bool
+ReadPlaylistDirectory(Path parent_path_fs,
+		      std::function<void(const Path, PlaylistInfo &&)> f,
+		      Error &error)
 {
-	PlaylistVector list;
-
-	const auto &parent_path_fs = spl_map(error);
-	if (parent_path_fs.IsNull())
-		return list;
-
 	DirectoryReader reader(parent_path_fs);
 	if (reader.HasFailed()) {
 		error.SetErrno();
-		return list;
+		return false;
 	}
 
 	PlaylistInfo info;
 	while (reader.ReadEntry()) {
 		const auto entry = reader.GetEntry();
 		if (LoadPlaylistFileInfo(info, parent_path_fs, entry))
-			list.push_back(std::move(info));
+			f(entry, std::move(info));
+	}
+
+	return true;
+}
+
+#ifdef ENABLE_INOTIFY
+
+/**
+ * An in-memory copy of the playlist directory listing, so
+ * "listplaylists" does not need to read the directory and stat() each
+ * file.  It is kept up to date with inotify.
+ */
+class PlaylistIndex {
+	const AllocatedPath &directory;
+
+	/**
+	 * The playlists, indexed by their file names (in the file
+	 * system character set).
+	 */
+	std::map<PathTraitsFS::string, PlaylistInfo> playlists;
+
+	InotifySource *source;
+
+	/**
+	 * Does #playlists reflect the directory contents?  This is
+	 * cleared when the kernel has dropped events; List() reads the
+	 * directory again then.
+	 */
+	bool valid;
+
+	/**
+	 * Is the inotify watch still active?  It is removed by the
+	 * kernel when the directory is deleted; the index is not used
+	 * anymore then.
+	 */
+	bool watching;
+
+public:
+	explicit PlaylistIndex(const AllocatedPath &_directory)
+		:directory(_directory), source(nullptr),
+		 valid(false), watching(false) {}
+
+	~PlaylistIndex() {
+		delete source;
+	}
+
+	bool Open(EventLoop &loop, Error &error);
+
+	bool IsActive() const {
+		return watching;
+	}
+
+	bool List(PlaylistVector &list, Error &error);
+
+	/**
+	 * Check the specified file again and update its entry.
+	 */
+	void Update(const Path name_fs);
+
+private:
+	bool Rescan(Error &error);
+
+	static void Callback(int wd, unsigned mask, const char *name,
+			     void *ctx);
+};
+
+bool
+PlaylistIndex::Open(EventLoop &loop, Error &error)
+{
+	source = InotifySource::Create(loop, Callback, this, error);
+	if (source == nullptr)
+		return false;
+
+	/* watch the directory before reading it, so no change gets
+	   lost */
+	if (source->Add(directory.c_str(),
+			IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|
+			IN_CLOSE_WRITE|IN_ATTRIB|IN_ONLYDIR,
+			error) < 0)
+		return false;
+
+	watching = true;
+	return Rescan(error);
+}
+
+bool
+PlaylistIndex::Rescan(Error &error)
+{
+	playlists.clear();
+	valid = ReadPlaylistDirectory(directory,
+				      [this](const Path name_fs,
+					     PlaylistInfo &&info){
+					      playlists.emplace(name_fs.c_str(),
+								std::move(info));
+				      },
+				      error);
+	return valid;
+}
+
+bool
+PlaylistIndex::List(PlaylistVector &list, Error &error)
+{
+	assert(watching);
+
+	if (!valid && !Rescan(error))
+		return false;
+
+	for (const auto &i : playlists)
+		list.push_back(PlaylistInfo(i.second.name, i.second.mtime));
+
+	return true;
+}
+
+void
+PlaylistIndex::Update(const Path name_fs)
+{
+	if (!valid)
+		/* List() will read everything again */
+		return;
+
+	playlists.erase(name_fs.c_str());
+
+	PlaylistInfo info;
+	if (LoadPlaylistFileInfo(info, directory, name_fs))
+		playlists.emplace(name_fs.c_str(), std::move(info));
+}
+
+void
+PlaylistIndex::Callback(gcc_unused int wd, unsigned mask, const char *name,
+			void *ctx)
+{
+	PlaylistIndex &index = *(PlaylistIndex *)ctx;
+
+	if (mask & IN_IGNORED) {
+		index.watching = false;
+		index.playlists.clear();
+	} else if (mask & IN_Q_OVERFLOW)
+		index.valid = false;
+	else if (name != nullptr)
+		index.Update(Path::FromFS(name));
+}
+
+static PlaylistIndex *spl_index;
+
+void
+spl_index_init(EventLoop &loop)
+{
+	assert(spl_index == nullptr);
+
+	const auto &path_fs = map_spl_path();
+	if (path_fs.IsNull())
+		return;
+
+	spl_index = new PlaylistIndex(path_fs);
+
+	Error error;
+	if (!spl_index->Open(loop, error)) {
+		LogError(error);
+		delete spl_index;
+		spl_index = nullptr;
 	}
+}
+
+void
+spl_index_finish()
+{
+	delete spl_index;
+	spl_index = nullptr;
+}
+
+#endif
 
+void
+spl_index_update(gcc_unused Path path_fs)
+{
+#ifdef ENABLE_INOTIFY
+	if (spl_index != nullptr && spl_index->IsActive())
+		spl_index->Update(path_fs.GetBase());
+#endif
+}
+
+PlaylistVector
+ListPlaylistFiles(Error &error)
+{
+	PlaylistVector list;
+
+	const auto &parent_path_fs = spl_map(error);
+	if (parent_path_fs.IsNull())
+		return list;
+
+#ifdef ENABLE_INOTIFY
+	if (spl_index != nullptr && spl_index->IsActive()) {
+		spl_index->List(list, error);
+		return list;
+	}
+#endif
+
+	ReadPlaylistDirectory(parent_path_fs,
+			      [&list](const Path, PlaylistInfo &&info){
+				      list.push_back(std::move(info));
+			      },
+			      error);
 	return list;
 }
 
@@ -243,11 +454,15 @@ SavePlaylistFile(const PlaylistFileContents &contents, const char *utf8path,
 	for (const auto &uri_utf8 : contents)
 		playlist_print_uri(bos, uri_utf8.c_str());
 
-	return bos.Flush(error) && fos.Commit(error);
+	if (!bos.Flush(error) || !fos.Commit(error))
+		return false;
+
+	spl_index_update(path_fs);
+	return true;
 }
 
-PlaylistFileContents
-LoadPlaylistFile(const char *utf8path, Error &error)
+static PlaylistFileContents
+ReadPlaylistFile(const char *utf8path, Error &error)
 {
 	PlaylistFileContents contents;
 
@@ -308,6 +523,284 @@ LoadPlaylistFile(const char *utf8path, Error &error)
 	return contents;
 }
 
+/**
+ * An in-memory copy of recently used stored playlists, so editing
+ * commands don't need to load and rewrite the whole file each time.
+ * Modifications are written back after a short delay, which combines
+ * many edits into one write.
+ *
+ * Clean copies are checked against the file's modification time and
+ * size before each use, to notice changes by other processes.
+ *
+ * Playlists are edited in the main thread, but they are also read
+ * by #BackgroundResponseStream threads.  Lookup(), Get(), MarkDirty()
+ * and Remove() must be called while holding #mutex; the Flush()
+ * methods lock it.  Only the main thread may call MarkDirty() and
+ * Flush() without a parameter.
+ */
+class PlaylistFileCache final : TimeoutMonitor {
+	/**
+	 * How long to wait before writing modifications [ms].
+	 */
+	static constexpr unsigned WRITE_DELAY = 2000;
+
+	/**
+	 * The maximum number of playlists in the cache.
+	 */
+	static constexpr size_t MAX_PLAYLISTS = 8;
+
+public:
+	struct Entry {
+		std::string name;
+
+		PlaylistFileContents contents;
+
+		/**
+		 * The modification time and the size of the file
+		 * after it was last read or written.
+		 */
+		time_t mtime;
+		uint64_t size;
+
+		/**
+		 * Does #contents have modifications which have not
+		 * been written yet?
+		 */
+		bool dirty;
+
+		Entry(const char *_name, PlaylistFileContents &&_contents,
+		      const FileInfo &fi)
+			:name(_name), contents(std::move(_contents)),
+			 mtime(fi.GetModificationTime()), size(fi.GetSize()),
+			 dirty(false) {}
+	};
+
+private:
+	/**
+	 * Most recently used first.
+	 */
+	std::list<Entry> entries;
+
+public:
+	Mutex mutex;
+
+	explicit PlaylistFileCache(EventLoop &_loop)
+		:TimeoutMonitor(_loop) {}
+
+	~PlaylistFileCache() {
+		Flush();
+	}
+
+	/**
+	 * Look up a cached playlist.  A clean copy which does not
+	 * match the file anymore is discarded.
+	 *
+	 * @return the entry or nullptr if the playlist is not cached
+	 */
+	Entry *Lookup(const char *name_utf8, Path path_fs);
+
+	/**
+	 * Like Lookup(), but load the playlist if it is not cached.
+	 *
+	 * @return the entry or nullptr on error
+	 */
+	Entry *Get(const char *name_utf8, Error &error);
+
+	/**
+	 * Schedule writing the modified entry.
+	 */
+	void MarkDirty(Entry &entry) {
+		entry.dirty = true;
+		if (!IsActive())
+			ScheduleCoarse(WRITE_DELAY);
+	}
+
+	/**
+	 * Write pending modifications of one playlist.
+	 */
+	void Flush(const char *name_utf8);
+
+	/**
+	 * Write all pending modifications.
+	 */
+	void Flush();
+
+	/**
+	 * Discard a playlist without writing it, because its file
+	 * is about to be deleted or replaced.
+	 */
+	void Remove(const char *name_utf8);
+
+private:
+	std::list<Entry>::iterator Find(const char *name_utf8) {
+		return std::find_if(entries.begin(), entries.end(),
+				    [name_utf8](const Entry &e){
+					    return e.name == name_utf8;
+				    });
+	}
+
+	void Save(Entry &entry);
+
+	/* virtual methods from class TimeoutMonitor */
+	void OnTimeout() override {
+		Flush();
+	}
+};
+
+PlaylistFileCache::Entry *
+PlaylistFileCache::Lookup(const char *name_utf8, Path path_fs)
+{
+	auto i = Find(name_utf8);
+	if (i == entries.end())
+		return nullptr;
+
+	if (!i->dirty) {
+		FileInfo fi;
+		if (!GetFileInfo(path_fs, fi) ||
+		    fi.GetModificationTime() != i->mtime ||
+		    fi.GetSize() != i->size) {
+			/* modified or deleted by somebody else */
+			entries.erase(i);
+			return nullptr;
+		}
+	}
+
+	entries.splice(entries.begin(), entries, i);
+	return &entries.front();
+}
+
+PlaylistFileCache::Entry *
+PlaylistFileCache::Get(const char *name_utf8, Error &error)
+{
+	const auto path_fs = spl_map_to_fs(name_utf8, error);
+	if (path_fs.IsNull())
+		return nullptr;
+
+	Entry *entry = Lookup(name_utf8, path_fs);
+	if (entry != nullptr)
+		return entry;
+
+	/* obtain the file information first, so a modification
+	   while reading is noticed next time */
+	FileInfo fi;
+	if (!GetFileInfo(path_fs, fi, error)) {
+		TranslatePlaylistError(error);
+		return nullptr;
+	}
+
+	auto contents = ReadPlaylistFile(name_utf8, error);
+	if (contents.empty() && error.IsDefined())
+		return nullptr;
+
+	entries.emplace_front(name_utf8, std::move(contents), fi);
+
+	if (entries.size() > MAX_PLAYLISTS) {
+		Entry &last = entries.back();
+		if (last.dirty)
+			Save(last);
+		entries.pop_back();
+	}
+
+	return &entries.front();
+}
+
+void
+PlaylistFileCache::Save(Entry &entry)
+{
+	assert(entry.dirty);
+
+	Error error;
+	if (!SavePlaylistFile(entry.contents, entry.name.c_str(), error)) {
+		/* keep it dirty; the next modification tries
+		   again */
+		LogError(error);
+		return;
+	}
+
+	entry.dirty = false;
+
+	const auto path_fs = map_spl_utf8_to_fs(entry.name.c_str());
+	FileInfo fi;
+	if (!path_fs.IsNull() && GetFileInfo(path_fs, fi)) {
+		entry.mtime = fi.GetModificationTime();
+		entry.size = fi.GetSize();
+	}
+}
+
+void
+PlaylistFileCache::Flush(const char *name_utf8)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = Find(name_utf8);
+	if (i != entries.end() && i->dirty)
+		Save(*i);
+}
+
+void
+PlaylistFileCache::Flush()
+{
+	Cancel();
+
+	const ScopeLock protect(mutex);
+	for (auto &i : entries)
+		if (i.dirty)
+			Save(i);
+}
+
+void
+PlaylistFileCache::Remove(const char *name_utf8)
+{
+	auto i = Find(name_utf8);
+	if (i != entries.end())
+		entries.erase(i);
+}
+
+static PlaylistFileCache *spl_cache;
+
+void
+spl_cache_init(EventLoop &loop)
+{
+	assert(spl_cache == nullptr);
+
+	if (!map_spl_path().IsNull())
+		spl_cache = new PlaylistFileCache(loop);
+}
+
+void
+spl_cache_finish()
+{
+	delete spl_cache;
+	spl_cache = nullptr;
+}
+
+void
+spl_flush(const char *name_utf8)
+{
+	if (spl_cache != nullptr)
+		spl_cache->Flush(name_utf8);
+}
+
+PlaylistFileContents
+LoadPlaylistFile(const char *utf8path, Error &error)
+{
+	if (spl_cache != nullptr) {
+		const auto path_fs = spl_map_to_fs(utf8path, error);
+		if (path_fs.IsNull())
+			return PlaylistFileContents();
+
+		const ScopeLock protect(spl_cache->mutex);
+		const auto *entry = spl_cache->Lookup(utf8path, path_fs);
+		if (entry != nullptr)
+			return entry->contents;
+	}
+
+	/* only editing adds playlists to the cache; this function
+	   may be called by a background thread, which reads the file
+	   without holding the lock */
+	return ReadPlaylistFile(utf8path, error);
+}
+
 bool
 spl_move_index(const char *utf8path, unsigned src, unsigned dest,
 	       Error &error)
@@ -317,6 +810,32 @@ spl_move_index(const char *utf8path, unsigned src, unsigned dest,
 		   what the hell.. */
 		return true;
 
+	if (spl_cache != nullptr) {
+		const ScopeLock protect(spl_cache->mutex);
+		auto *entry = spl_cache->Get(utf8path, error);
+		if (entry == nullptr)
+			return false;
+
+		auto &contents = entry->contents;
+		if (src >= contents.size() || dest >= contents.size()) {
+			error.Set(playlist_domain,
+				  int(PlaylistResult::BAD_RANGE),
+				  "Bad range");
+			return false;
+		}
+
+		const auto src_i = std::next(contents.begin(), src);
+		const auto dest_i = std::next(contents.begin(), dest);
+		if (src < dest)
+			std::rotate(src_i, std::next(src_i), std::next(dest_i));
+		else
+			std::rotate(dest_i, src_i, std::next(src_i));
+
+		spl_cache->MarkDirty(*entry);
+		idle_add(IDLE_STORED_PLAYLIST);
+		return true;
+	}
+
 	auto contents = LoadPlaylistFile(utf8path, error);
 	if (contents.empty() && error.IsDefined())
 		return false;
@@ -347,6 +866,11 @@ spl_clear(const char *utf8path, Error &error)
 	if (path_fs.IsNull())
 		return false;
 
+	if (spl_cache != nullptr) {
+		const ScopeLock protect(spl_cache->mutex);
+		spl_cache->Remove(utf8path);
+	}
+
 	FILE *file = FOpen(path_fs, FOpenMode::WriteText);
 	if (file == nullptr) {
 		playlist_errno(error);
@@ -355,6 +879,7 @@ spl_clear(const char *utf8path, Error &error)
 
 	fclose(file);
 
+	spl_index_update(path_fs);
 	idle_add(IDLE_STORED_PLAYLIST);
 	return true;
 }
@@ -366,11 +891,17 @@ spl_delete(const char *name_utf8, Error &error)
 	if (path_fs.IsNull())
 		return false;
 
+	if (spl_cache != nullptr) {
+		const ScopeLock protect(spl_cache->mutex);
+		spl_cache->Remove(name_utf8);
+	}
+
 	if (!RemoveFile(path_fs)) {
 		playlist_errno(error);
 		return false;
 	}
 
+	spl_index_update(path_fs);
 	idle_add(IDLE_STORED_PLAYLIST);
 	return true;
 }
@@ -378,6 +909,27 @@ spl_delete(const char *name_utf8, Error &error)
 bool
 spl_remove_index(const char *utf8path, unsigned pos, Error &error)
 {
+	if (spl_cache != nullptr) {
+		const ScopeLock protect(spl_cache->mutex);
+		auto *entry = spl_cache->Get(utf8path, error);
+		if (entry == nullptr)
+			return false;
+
+		auto &contents = entry->contents;
+		if (pos >= contents.size()) {
+			error.Set(playlist_domain,
+				  int(PlaylistResult::BAD_RANGE),
+				  "Bad range");
+			return false;
+		}
+
+		contents.erase(std::next(contents.begin(), pos));
+
+		spl_cache->MarkDirty(*entry);
+		idle_add(IDLE_STORED_PLAYLIST);
+		return true;
+	}
+
 	auto contents = LoadPlaylistFile(utf8path, error);
 	if (contents.empty() && error.IsDefined())
 		return false;
@@ -403,6 +955,29 @@ spl_append_song(const char *utf8path, const DetachedSong &song, Error &error)
 	if (path_fs.IsNull())
 		return false;
 
+	if (spl_cache != nullptr) {
+		const ScopeLock protect(spl_cache->mutex);
+		auto *entry = spl_cache->Lookup(utf8path, path_fs);
+		if (entry != nullptr) {
+			/* the playlist is cached: append to the copy;
+			   this is the URI which LoadPlaylistFile()
+			   would read from the line written by
+			   playlist_print_song() */
+			if (entry->contents.size() >= playlist_max_length) {
+				error.Set(playlist_domain,
+					  int(PlaylistResult::TOO_LARGE),
+					  "Stored playlist is too large");
+				return false;
+			}
+
+			entry->contents.emplace_back(song.GetURI());
+
+			spl_cache->MarkDirty(*entry);
+			idle_add(IDLE_STORED_PLAYLIST);
+			return true;
+		}
+	}
+
 	AppendFileOutputStream fos(path_fs, error);
 	if (!fos.IsDefined()) {
 		TranslatePlaylistError(error);
@@ -422,6 +997,7 @@ spl_append_song(const char *utf8path, const DetachedSong &song, Error &error)
 	if (!bos.Flush(error) || !fos.Commit(error))
 		return false;
 
+	spl_index_update(path_fs);
 	idle_add(IDLE_STORED_PLAYLIST);
 	return true;
 }
@@ -461,6 +1037,8 @@ spl_rename_internal(Path from_path_fs, Path to_path_fs,
 		return false;
 	}
 
+	spl_index_update(from_path_fs);
+	spl_index_update(to_path_fs);
 	idle_add(IDLE_STORED_PLAYLIST);
 	return true;
 }
@@ -476,5 +1054,12 @@ spl_rename(const char *utf8from, const char *utf8to, Error &error)
 	if (to_path_fs.IsNull())
 		return false;
 
+	if (spl_cache != nullptr) {
+		spl_cache->Flush(utf8from);
+
+		const ScopeLock protect(spl_cache->mutex);
+		spl_cache->Remove(utf8from);
+	}
+
 	return spl_rename_internal(from_path_fs, to_path_fs, error);
 }
@@ -20,6 +20,8 @@
 #ifndef MPD_PLAYLIST_FILE_HXX
 #define MPD_PLAYLIST_FILE_HXX
 
+#include "check.h"
+
 #include <vector>
 #include <string>
 
@@ -28,6 +30,8 @@ class SongLoader;
 class PlaylistVector;
 class Error;
 class AllocatedPath;
+class Path;
+class EventLoop;
 
 typedef std::vector<std::string> PlaylistFileContents;
 
@@ -39,6 +43,50 @@ extern bool playlist_saveAbsolutePaths;
 void
 spl_global_init();
 
+#ifdef ENABLE_INOTIFY
+
+/**
+ * Read the playlist directory into an in-memory index, and watch it
+ * with inotify.  ListPlaylistFiles() uses this index if available.
+ */
+void
+spl_index_init(EventLoop &loop);
+
+void
+spl_index_finish();
+
+#endif
+
+/**
+ * Create the cache of recently used stored playlists.  Without it,
+ * each modification loads and writes the whole file.
+ */
+void
+spl_cache_init(EventLoop &loop);
+
+/**
+ * Write all pending modifications and free the cache.
+ */
+void
+spl_cache_finish();
+
+/**
+ * Write pending modifications of the specified stored playlist, so
+ * its file can be read by other code, e.g. the playlist plugins.
+ * Call this in the main thread.
+ */
+void
+spl_flush(const char *name_utf8);
+
+/**
+ * Update the playlist index after MPD has modified (or created or
+ * deleted) the specified playlist file, so the next
+ * ListPlaylistFiles() call sees the change before the inotify event
+ * has been received.
+ */
+void
+spl_index_update(Path path_fs);
+
 /**
  * Determines whether the specified string is a valid name for a
  * stored playlist.
@@ -33,6 +33,8 @@
 #include "util/Error.hxx"
 #include "thread/Cond.hxx"
 
+#include <assert.h>
+
 #define SONG_FILE "file: "
 #define SONG_TIME "Time: "
 
@@ -134,22 +136,32 @@ PrintSongDetails(Client &client, const char *uri_utf8)
 bool
 spl_print(Client &client, const char *name_utf8, bool detail,
 	  Error &error)
+{
+	PlaylistFileContents contents = LoadPlaylistFile(name_utf8, error);
+	if (contents.empty() && error.IsDefined())
+		return false;
+
+	spl_print_contents(client, contents, 0, contents.size(), detail);
+	return true;
+}
+
+void
+spl_print_contents(Client &client, const PlaylistFileContents &contents,
+		   size_t start, size_t end, bool detail)
 {
 #ifndef ENABLE_DATABASE
 	(void)detail;
 #endif
 
-	PlaylistFileContents contents = LoadPlaylistFile(name_utf8, error);
-	if (contents.empty() && error.IsDefined())
-		return false;
+	assert(start <= end);
+	assert(end <= contents.size());
+
+	for (size_t i = start; i < end; ++i) {
+		const char *uri_utf8 = contents[i].c_str();
 
-	for (const auto &uri_utf8 : contents) {
 #ifdef ENABLE_DATABASE
-		if (!detail || !PrintSongDetails(client, uri_utf8.c_str()))
+		if (!detail || !PrintSongDetails(client, uri_utf8))
 #endif
-			client_printf(client, SONG_FILE "%s\n",
-				      uri_utf8.c_str());
+			client_printf(client, SONG_FILE "%s\n", uri_utf8);
 	}
-
-	return true;
 }
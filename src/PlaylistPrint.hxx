@@ -20,7 +20,10 @@
 #ifndef MPD_PLAYLIST_PRINT_HXX
 #define MPD_PLAYLIST_PRINT_HXX
 
+#include "PlaylistFile.hxx"
+
 #include <stdint.h>
+#include <stddef.h>
 
 struct playlist;
 class SongFilter;
@@ -95,4 +98,14 @@ bool
 spl_print(Client &client, const char *name_utf8, bool detail,
 	  Error &error);
 
+/**
+ * Send the range [start, end) of a stored playlist which was loaded
+ * with LoadPlaylistFile() to the client.
+ *
+ * @param detail true if all details should be printed
+ */
+void
+spl_print_contents(Client &client, const PlaylistFileContents &contents,
+		   size_t start, size_t end, bool detail);
+
 #endif
@@ -42,11 +42,11 @@
 void
 playlist_print_song(BufferedOutputStream &os, const DetachedSong &song)
 {
-	const char *uri_utf8 = playlist_saveAbsolutePaths
+	const std::string uri_utf8 = playlist_saveAbsolutePaths
 		? song.GetRealURI()
-		: song.GetURI();
+		: std::string(song.GetURI());
 
-	const auto uri_fs = AllocatedPath::FromUTF8(uri_utf8);
+	const auto uri_fs = AllocatedPath::FromUTF8(uri_utf8.c_str());
 	if (!uri_fs.IsNull())
 		os.Format("%s\n", NarrowPath(uri_fs).c_str());
 }
@@ -94,6 +94,7 @@ spl_save_queue(const char *name_utf8, const Queue &queue, Error &error)
 	if (!bos.Flush(error) || !fos.Commit(error))
 		return false;
 
+	spl_index_update(path_fs);
 	idle_add(IDLE_STORED_PLAYLIST);
 	return true;
 }
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SharedUri.hxx"
+#include "thread/Mutex.hxx"
+#include "util/VarSize.hxx"
+
+#include <algorithm>
+#include <vector>
+
+#include <assert.h>
+
+/**
+ * Protects the pool and the reference counters.
+ */
+static Mutex shared_uri_mutex;
+
+static std::vector<SharedUri::Block *> buckets;
+static unsigned num_blocks;
+
+gcc_pure
+static size_t
+Hash(const char *p, size_t length)
+{
+	/* FNV-1a */
+	size_t hash = 2166136261u;
+	for (size_t i = 0; i < length; ++i)
+		hash = (hash ^ (unsigned char)p[i]) * 16777619u;
+	return hash;
+}
+
+static SharedUri::Block *&
+GetBucket(size_t hash)
+{
+	return buckets[hash & (buckets.size() - 1)];
+}
+
+static void
+Grow()
+{
+	std::vector<SharedUri::Block *> old(buckets.size() * 2, nullptr);
+	old.swap(buckets);
+
+	for (auto *b : old) {
+		while (b != nullptr) {
+			auto *next = b->next;
+			auto &bucket = GetBucket(b->hash);
+			b->next = bucket;
+			bucket = b;
+			b = next;
+		}
+	}
+}
+
+SharedUri::SharedUri(const char *value, size_t length)
+	:block(nullptr)
+{
+	if (length == 0)
+		return;
+
+	const size_t hash = Hash(value, length);
+
+	/* the whole operation runs inside the lock (unlike
+	   SharedTag), because operator==() relies on each string
+	   having only one block */
+	const ScopeLock protect(shared_uri_mutex);
+
+	if (buckets.empty())
+		buckets.resize(1024, nullptr);
+
+	for (auto *b = GetBucket(hash); b != nullptr; b = b->next) {
+		if (b->hash == hash && b->length == length &&
+		    memcmp(b->value, value, length) == 0) {
+			++b->ref;
+			block = b;
+			return;
+		}
+	}
+
+	/* value-initializing the Block writes the whole declared
+	   struct, so never allocate less than that */
+	Block *b = NewVarSize<Block>(sizeof(b->value),
+				     std::max<size_t>(length + 1,
+						      sizeof(b->value)));
+	b->hash = hash;
+	b->ref = 1;
+	b->length = length;
+	memcpy(b->value, value, length);
+	b->value[length] = 0;
+
+	if (++num_blocks > buckets.size())
+		Grow();
+
+	auto &bucket = GetBucket(hash);
+	b->next = bucket;
+	bucket = b;
+	block = b;
+}
+
+SharedUri::SharedUri(const SharedUri &other)
+	:block(other.block)
+{
+	if (block != nullptr) {
+		const ScopeLock protect(shared_uri_mutex);
+		assert(block->ref > 0);
+		++block->ref;
+	}
+}
+
+void
+SharedUri::Release(Block *b)
+{
+	{
+		const ScopeLock protect(shared_uri_mutex);
+		assert(b->ref > 0);
+		if (--b->ref > 0)
+			return;
+
+		Block **p = &GetBucket(b->hash);
+		while (*p != b) {
+			assert(*p != nullptr);
+			p = &(*p)->next;
+		}
+
+		*p = b->next;
+		--num_blocks;
+	}
+
+	DeleteVarSize(b);
+}
+
+unsigned
+SharedUri::GetPoolSize()
+{
+	const ScopeLock protect(shared_uri_mutex);
+	return num_blocks;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SHARED_URI_HXX
+#define MPD_SHARED_URI_HXX
+
+#include "Compiler.h"
+
+#include <string>
+#include <utility>
+
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * An immutable UTF-8 URI string which is shared by all holders of an
+ * equal string.  The blocks are reference counted and kept in a
+ * global pool, similar to #SharedTag.
+ *
+ * Because there is never more than one block for a string, two
+ * instances are equal if and only if they point to the same block,
+ * which makes comparisons cheap.
+ */
+class SharedUri {
+public:
+	struct Block {
+		Block *next;
+
+		size_t hash;
+
+		/**
+		 * The number of #SharedUri instances referring to
+		 * this block.  Protected by the pool's mutex.
+		 */
+		unsigned ref;
+
+		unsigned length;
+
+		char value[sizeof(size_t)];
+	};
+
+private:
+	Block *block;
+
+public:
+	/**
+	 * Create an empty string.
+	 */
+	SharedUri():block(nullptr) {}
+
+	explicit SharedUri(const char *value)
+		:SharedUri(value, strlen(value)) {}
+
+	explicit SharedUri(const std::string &value)
+		:SharedUri(value.data(), value.length()) {}
+
+	SharedUri(const char *value, size_t length);
+
+	SharedUri(const SharedUri &other);
+
+	SharedUri(SharedUri &&other):block(other.block) {
+		other.block = nullptr;
+	}
+
+	~SharedUri() {
+		if (block != nullptr)
+			Release(block);
+	}
+
+	SharedUri &operator=(const SharedUri &other) {
+		SharedUri tmp(other);
+		std::swap(block, tmp.block);
+		return *this;
+	}
+
+	SharedUri &operator=(SharedUri &&other) {
+		std::swap(block, other.block);
+		return *this;
+	}
+
+	bool operator==(const SharedUri &other) const {
+		return block == other.block;
+	}
+
+	bool operator!=(const SharedUri &other) const {
+		return block != other.block;
+	}
+
+	bool empty() const {
+		return block == nullptr;
+	}
+
+	size_t length() const {
+		return block != nullptr ? block->length : 0;
+	}
+
+	const char *c_str() const {
+		return block != nullptr ? block->value : "";
+	}
+
+	/**
+	 * Returns the number of blocks in the pool.  For debugging and
+	 * statistics.
+	 */
+	gcc_pure
+	static unsigned GetPoolSize();
+
+private:
+	static void Release(Block *block);
+};
+
+#endif
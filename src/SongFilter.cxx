@@ -22,11 +22,14 @@
 #include "db/LightSong.hxx"
 #include "DetachedSong.hxx"
 #include "tag/Tag.hxx"
+#include "tag/TagPool.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/ASCII.hxx"
 #include "util/UriUtil.hxx"
 #include "lib/icu/Collate.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
@@ -70,7 +73,7 @@ SongFilter::Item::Item(unsigned _tag, const char *_value, bool _fold_case)
 }
 
 SongFilter::Item::Item(unsigned _tag, time_t _time)
-	:tag(_tag), time(_time)
+	:tag(_tag), fold_case(false), time(_time)
 {
 }
 
@@ -90,11 +93,28 @@ SongFilter::Item::StringMatch(const char *s) const
 	}
 }
 
+bool
+SongFilter::Item::StringMatch(const TagItem &item) const
+{
+	if (!fold_case)
+		return value == item.value;
+
+	/* the folded value is calculated only once for each pooled
+	   item, and is then cached in the #TagPool */
+	const char *folded = tag_pool_get_folded(item);
+	if (folded == nullptr) {
+		const std::string tmp = IcuCaseFold(item.value);
+		folded = tag_pool_set_folded(item, tmp.data(), tmp.length());
+	}
+
+	return strstr(folded, value.c_str()) != nullptr;
+}
+
 bool
 SongFilter::Item::Match(const TagItem &item) const
 {
 	return (tag == LOCATE_TAG_ANY_TYPE || (unsigned)item.type == tag) &&
-		StringMatch(item.value);
+		StringMatch(item);
 }
 
 bool
@@ -125,7 +145,7 @@ SongFilter::Item::Match(const Tag &_tag) const
 			   only "artist" exists, use that */
 			for (const auto &item : _tag)
 				if (item.type == TAG_ARTIST &&
-				    StringMatch(item.value))
+				    StringMatch(item))
 					return true;
 		}
 	}
@@ -167,14 +187,190 @@ SongFilter::Item::Match(const LightSong &song) const
 	return Match(*song.tag);
 }
 
+SongFilter::Predicate::Predicate(const Item &_item)
+	:tag(_item.GetTag()), item(&_item), pooled(nullptr),
+	 hash(0), artist_hash(0)
+{
+	const bool fold_case = item->GetFoldCase();
+
+	if (tag == LOCATE_TAG_BASE_TYPE)
+		kind = Kind::BASE;
+	else if (tag == LOCATE_TAG_MODIFIED_SINCE)
+		kind = Kind::MODIFIED_SINCE;
+	else if (tag == LOCATE_TAG_FILE_TYPE)
+		kind = fold_case ? Kind::URI_FOLDED : Kind::URI_EXACT;
+	else if (tag == LOCATE_TAG_ANY_TYPE)
+		kind = fold_case ? Kind::ANY_FOLDED : Kind::ANY_EXACT;
+	else if (fold_case)
+		kind = Kind::TAG_FOLDED;
+	else {
+		assert(tag < TAG_NUM_OF_ITEM_TYPES);
+
+		kind = Kind::TAG_EXACT;
+
+		const std::string &value = item->GetValue();
+		hash = tag_pool_hash(TagType(tag),
+				     value.data(), value.length());
+		artist_hash = tag_pool_hash(TAG_ARTIST,
+					    value.data(), value.length());
+
+		/* songs which have this value most likely refer to
+		   the same pooled item */
+		const ScopeLock protect(tag_pool_lock);
+		pooled = tag_pool_get_item(TagType(tag),
+					   value.data(), value.length());
+	}
+}
+
+void
+SongFilter::Predicate::Dispose()
+{
+	if (pooled != nullptr)
+		tag_pool_put_item(pooled);
+}
+
+inline bool
+SongFilter::Predicate::MatchURI(const char *uri) const
+{
+	switch (kind) {
+	case Kind::URI_EXACT:
+		return item->GetValue() == uri;
+
+	case Kind::URI_FOLDED:
+		return item->StringMatch(uri);
+
+	case Kind::BASE:
+		return uri_is_child_or_same(item->GetValue().c_str(), uri);
+
+	default:
+		assert(false);
+		gcc_unreachable();
+	}
+}
+
+inline bool
+SongFilter::Predicate::MatchExact(const Tag &_tag) const
+{
+	assert(kind == Kind::TAG_EXACT);
+
+	const std::string &value = item->GetValue();
+
+	bool found = false, have_artist = false;
+	for (const auto &i : _tag) {
+		if (i.type == tag) {
+			/* the pointer comparison usually decides a
+			   match, and the hash a mismatch */
+			if (&i == pooled ||
+			    (tag_pool_item_hash(i) == hash && value == i.value))
+				return true;
+
+			found = true;
+		} else if (i.type == TAG_ARTIST)
+			have_artist = true;
+	}
+
+	if (found)
+		return false;
+
+	/* see Item::Match(const Tag &) */
+
+	if (value.empty())
+		return true;
+
+	if (tag == TAG_ALBUM_ARTIST && have_artist)
+		for (const auto &i : _tag)
+			if (i.type == TAG_ARTIST &&
+			    tag_pool_item_hash(i) == artist_hash &&
+			    value == i.value)
+				return true;
+
+	return false;
+}
+
+inline bool
+SongFilter::Predicate::Match(const Tag &_tag) const
+{
+	return kind == Kind::TAG_EXACT
+		? MatchExact(_tag)
+		: item->Match(_tag);
+}
+
+bool
+SongFilter::Predicate::Match(const DetachedSong &song) const
+{
+	switch (kind) {
+	case Kind::MODIFIED_SINCE:
+		return song.GetLastModified() >= item->GetTime();
+
+	case Kind::URI_EXACT:
+	case Kind::URI_FOLDED:
+	case Kind::BASE:
+		return MatchURI(song.GetURI());
+
+	default:
+		return Match(song.GetTag());
+	}
+}
+
+bool
+SongFilter::Predicate::Match(const LightSong &song) const
+{
+	switch (kind) {
+	case Kind::MODIFIED_SINCE:
+		return song.mtime >= item->GetTime();
+
+	case Kind::URI_EXACT:
+	case Kind::URI_FOLDED:
+	case Kind::BASE: {
+		const auto uri = song.GetURI();
+		return MatchURI(uri.c_str());
+	}
+
+	default:
+		return Match(*song.tag);
+	}
+}
+
 SongFilter::SongFilter(unsigned tag, const char *value, bool fold_case)
 {
 	items.push_back(Item(tag, value, fold_case));
+	Compile();
 }
 
 SongFilter::~SongFilter()
 {
-	/* this destructor exists here just so it won't get inlined */
+	DisposePredicates();
+}
+
+void
+SongFilter::DisposePredicates()
+{
+	for (auto &i : predicates)
+		i.Dispose();
+	predicates.clear();
+	n_base = 0;
+}
+
+void
+SongFilter::Compile()
+{
+	DisposePredicates();
+
+	predicates.reserve(items.size());
+	for (const auto &i : items)
+		predicates.emplace_back(i);
+
+	/* the evaluation order is the order of Predicate::Kind;
+	   items of the same kind stay in the client's order */
+	std::stable_sort(predicates.begin(), predicates.end(),
+			 [](const Predicate &a, const Predicate &b){
+				 return a.kind < b.kind;
+			 });
+
+	n_base = std::count_if(predicates.begin(), predicates.end(),
+			       [](const Predicate &p){
+				       return p.kind == Predicate::Kind::BASE;
+			       });
 }
 
 #if !defined(__GLIBC__) && !defined(WIN32)
@@ -250,10 +446,12 @@ SongFilter::Parse(const char *tag_string, const char *value, bool fold_case)
 			return false;
 
 		items.push_back(Item(tag, t));
+		Compile();
 		return true;
 	}
 
 	items.push_back(Item(tag, value, fold_case));
+	Compile();
 	return true;
 }
 
@@ -273,7 +471,7 @@ SongFilter::Parse(ConstBuffer<const char *> args, bool fold_case)
 bool
 SongFilter::Match(const DetachedSong &song) const
 {
-	for (const auto &i : items)
+	for (const auto &i : predicates)
 		if (!i.Match(song))
 			return false;
 
@@ -283,13 +481,49 @@ SongFilter::Match(const DetachedSong &song) const
 bool
 SongFilter::Match(const LightSong &song) const
 {
-	for (const auto &i : items)
+	for (const auto &i : predicates)
 		if (!i.Match(song))
 			return false;
 
 	return true;
 }
 
+bool
+SongFilter::MatchIgnoringBase(const LightSong &song) const
+{
+	for (auto i = predicates.begin(), end = predicates.end() - n_base;
+	     i != end; ++i)
+		if (!i->Match(song))
+			return false;
+
+	return true;
+}
+
+SongFilter::BaseMatch
+SongFilter::CheckBase(const char *directory_uri) const
+{
+	BaseMatch result = BaseMatch::ALL;
+
+	for (auto i = predicates.end() - n_base, end = predicates.end();
+	     i != end; ++i) {
+		const char *base = i->item->GetValue().c_str();
+
+		if (*directory_uri != 0 &&
+		    uri_is_child_or_same(base, directory_uri))
+			/* the whole directory is inside */
+			continue;
+
+		if (*directory_uri == 0 || uri_is_child(directory_uri, base))
+			/* "base" is inside the directory; it may
+			   even name one of its songs */
+			result = BaseMatch::SOME;
+		else
+			return BaseMatch::NONE;
+	}
+
+	return result;
+}
+
 bool
 SongFilter::HasOtherThanBase() const
 {
@@ -23,6 +23,7 @@
 #include "Compiler.h"
 
 #include <list>
+#include <vector>
 #include <string>
 
 #include <stdint.h>
@@ -80,9 +81,20 @@ public:
 			return value;
 		}
 
+		time_t GetTime() const {
+			return time;
+		}
+
 		gcc_pure gcc_nonnull(2)
 		bool StringMatch(const char *s) const;
 
+		/**
+		 * Like StringMatch(const char *), but uses the
+		 * case-folded value cached in the #TagPool.
+		 */
+		gcc_pure
+		bool StringMatch(const TagItem &item) const;
+
 		gcc_pure
 		bool Match(const TagItem &tag_item) const;
 
@@ -96,11 +108,137 @@ public:
 		bool Match(const LightSong &song) const;
 	};
 
+	/**
+	 * The result of CheckBase().
+	 */
+	enum class BaseMatch : uint8_t {
+		/**
+		 * No song in this directory or below can match.
+		 */
+		NONE,
+
+		/**
+		 * Some songs may match; check each with Match().
+		 */
+		SOME,
+
+		/**
+		 * All songs in this directory and below match the
+		 * "base" items; MatchIgnoringBase() is enough.
+		 */
+		ALL,
+	};
+
 private:
+	/**
+	 * An #Item compiled for Match(): the tag type, "fold_case"
+	 * and the kind of comparison have been resolved already.
+	 */
+	struct Predicate {
+		/**
+		 * The order of this enum is the evaluation order:
+		 * cheap and selective checks come first.
+		 */
+		enum class Kind : uint8_t {
+			/**
+			 * Exact value of one tag type; compares the
+			 * pooled #TagItem hash and pointer before the
+			 * string.
+			 */
+			TAG_EXACT,
+
+			MODIFIED_SINCE,
+
+			/**
+			 * Exact value of any tag type.
+			 */
+			ANY_EXACT,
+
+			/**
+			 * Exact URI ("file").
+			 */
+			URI_EXACT,
+
+			/**
+			 * Case-folded substring of one tag type,
+			 * using the folded value cached in the
+			 * #TagPool.
+			 */
+			TAG_FOLDED,
+
+			ANY_FOLDED,
+
+			/**
+			 * Case-folded substring of the URI; folds
+			 * the URI of each song.
+			 */
+			URI_FOLDED,
+
+			/**
+			 * The song is inside the given directory;
+			 * usually decided by the database walk
+			 * already, see CheckBase().
+			 */
+			BASE,
+		};
+
+		Kind kind;
+
+		uint8_t tag;
+
+		const Item *item;
+
+		/**
+		 * For #TAG_EXACT: a #TagPool reference with the
+		 * value.  If the song's item is the same one, it
+		 * matches without comparing the strings.
+		 */
+		TagItem *pooled;
+
+		/**
+		 * For #TAG_EXACT: tag_pool_hash() of the value, and of
+		 * the value as #TAG_ARTIST (for the "album artist"
+		 * fallback).  Items with a different hash cannot
+		 * match.
+		 */
+		unsigned hash, artist_hash;
+
+		explicit Predicate(const Item &item);
+
+		/**
+		 * Release the #TagPool reference.
+		 */
+		void Dispose();
+
+		gcc_pure
+		bool MatchURI(const char *uri) const;
+
+		gcc_pure
+		bool MatchExact(const Tag &tag) const;
+
+		gcc_pure
+		bool Match(const Tag &tag) const;
+
+		gcc_pure
+		bool Match(const DetachedSong &song) const;
+
+		gcc_pure
+		bool Match(const LightSong &song) const;
+	};
+
 	std::list<Item> items;
 
+	/**
+	 * The compiled #items, see Compile().  The "base" items are
+	 * at the end; their number is #n_base.
+	 */
+	std::vector<Predicate> predicates;
+
+	unsigned n_base = 0;
+
 public:
 	SongFilter() = default;
+	SongFilter(SongFilter &&) = default;
 
 	gcc_nonnull(3)
 	SongFilter(unsigned tag, const char *value, bool fold_case=false);
@@ -121,6 +259,24 @@ public:
 	gcc_pure
 	bool Match(const LightSong &song) const;
 
+	/**
+	 * Like Match(), but skip the "base" items, because the
+	 * caller has determined that they match (see CheckBase()).
+	 */
+	gcc_pure
+	bool MatchIgnoringBase(const LightSong &song) const;
+
+	/**
+	 * Check the "base" items against a directory, to allow the
+	 * caller to skip directories which cannot contain matching
+	 * songs.
+	 *
+	 * @param directory_uri the URI of the directory (UTF-8); an
+	 * empty string is the root directory
+	 */
+	gcc_pure
+	BaseMatch CheckBase(const char *directory_uri) const;
+
 	const std::list<Item> &GetItems() const {
 		return items;
 	}
@@ -154,6 +310,17 @@ public:
 	 */
 	gcc_pure
 	std::string GetBase() const;
+
+private:
+	/**
+	 * Release all #predicates.
+	 */
+	void DisposePredicates();
+
+	/**
+	 * Rebuild #predicates from #items.
+	 */
+	void Compile();
 };
 
 /**
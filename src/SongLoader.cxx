@@ -29,6 +29,13 @@
 #include "util/Error.hxx"
 #include "DetachedSong.hxx"
 #include "PlaylistError.hxx"
+#include "util/ConstBuffer.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/Interface.hxx"
+#endif
+
+#include <vector>
 
 #include <assert.h>
 #include <string.h>
@@ -37,7 +44,7 @@
 
 SongLoader::SongLoader(const Client &_client)
 	:client(&_client), db(_client.GetDatabase(IgnoreError())),
-	 storage(_client.GetStorage()) {}
+	 storage(_client.GetStorage()), db_loading(false) {}
 
 #endif
 
@@ -105,6 +112,9 @@ SongLoader::LoadSong(const char *uri_utf8, Error &error) const
 		if (db != nullptr)
 			return DatabaseDetachSong(*db, *storage,
 						  uri_utf8, error);
+
+		if (db_loading)
+			return new DetachedSong(uri_utf8);
 #endif
 
 		error.Set(playlist_domain, int(PlaylistResult::NO_SUCH_SONG),
@@ -112,3 +122,22 @@ SongLoader::LoadSong(const char *uri_utf8, Error &error) const
 		return nullptr;
 	}
 }
+
+void
+SongLoader::Prefetch(ConstBuffer<const char *> uris) const
+{
+#ifdef ENABLE_DATABASE
+	if (db == nullptr)
+		return;
+
+	std::vector<const char *> relative;
+	for (const char *uri : uris)
+		if (!PathTraitsUTF8::IsAbsolute(uri) && !uri_has_scheme(uri))
+			relative.push_back(uri);
+
+	if (!relative.empty())
+		db->Prefetch({relative.data(), relative.size()});
+#else
+	(void)uris;
+#endif
+}
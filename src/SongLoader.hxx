@@ -25,6 +25,7 @@
 
 #include <cstddef>
 
+template<typename T> struct ConstBuffer;
 class Client;
 class Database;
 class Storage;
@@ -43,16 +44,26 @@ class SongLoader {
 #ifdef ENABLE_DATABASE
 	const Database *const db;
 	const Storage *const storage;
+
+	/**
+	 * The database is still being loaded.  URIs relative to the
+	 * music directory are accepted without looking them up; their
+	 * tags are filled in by playlist::DatabaseModified() later.
+	 */
+	const bool db_loading;
 #endif
 
 public:
 #ifdef ENABLE_DATABASE
 	explicit SongLoader(const Client &_client);
-	SongLoader(const Database *_db, const Storage *_storage)
-		:client(nullptr), db(_db), storage(_storage) {}
+	SongLoader(const Database *_db, const Storage *_storage,
+		   bool _db_loading=false)
+		:client(nullptr), db(_db), storage(_storage),
+		 db_loading(_db_loading) {}
 	SongLoader(const Client &_client, const Database *_db,
 		   const Storage *_storage)
-		:client(&_client), db(_db), storage(_storage) {}
+		:client(&_client), db(_db), storage(_storage),
+		 db_loading(false) {}
 #else
 	explicit SongLoader(const Client &_client)
 		:client(&_client) {}
@@ -69,6 +80,13 @@ public:
 	gcc_nonnull_all
 	DetachedSong *LoadSong(const char *uri_utf8, Error &error) const;
 
+	/**
+	 * A hint that the given URIs are going to be passed to
+	 * LoadSong() soon: the ones relative to the music directory
+	 * are passed to Database::Prefetch().
+	 */
+	void Prefetch(ConstBuffer<const char *> uris) const;
+
 private:
 	gcc_nonnull_all
 	DetachedSong *LoadFile(const char *path_utf8, Error &error) const;
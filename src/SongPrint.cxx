@@ -25,9 +25,12 @@
 #include "TimePrint.hxx"
 #include "TagPrint.hxx"
 #include "client/Client.hxx"
+#include "client/CompactRecord.hxx"
 #include "fs/Traits.hxx"
 #include "util/UriUtil.hxx"
 
+#include <stdio.h>
+
 #define SONG_FILE "file: "
 
 static void
@@ -52,15 +55,20 @@ song_print_uri(Client &client, const char *uri, bool base)
 			uri = allocated.c_str();
 	}
 
-	client_printf(client, SONG_FILE "%s\n", uri);
+	client_print_field(client, COMPACT_FILE, uri);
 }
 
 void
 song_print_uri(Client &client, const LightSong &song, bool base)
 {
 	if (!base && song.directory != nullptr) {
-		client_printf(client, SONG_FILE "%s/%s\n",
-			      song.directory, song.uri);
+		if (client.record_depth > 0) {
+			const auto uri = PathTraitsUTF8::Build(song.directory,
+							       song.uri);
+			client_print_field(client, COMPACT_FILE, uri.c_str());
+		} else
+			client_printf(client, SONG_FILE "%s/%s\n",
+				      song.directory, song.uri);
 	} else
 		song_print_uri(client, song.uri, base);
 }
@@ -71,49 +79,53 @@ song_print_uri(Client &client, const DetachedSong &song, bool base)
 	song_print_uri(client, song.GetURI(), base);
 }
 
+static void
+song_print_range(Client &client, unsigned start_ms, unsigned end_ms)
+{
+	char buffer[64];
+
+	if (end_ms > 0)
+		snprintf(buffer, sizeof(buffer), "%u.%03u-%u.%03u",
+			 start_ms / 1000,
+			 start_ms % 1000,
+			 end_ms / 1000,
+			 end_ms % 1000);
+	else if (start_ms > 0)
+		snprintf(buffer, sizeof(buffer), "%u.%03u-",
+			 start_ms / 1000,
+			 start_ms % 1000);
+	else
+		return;
+
+	client_print_field(client, COMPACT_RANGE, buffer);
+}
+
 void
 song_print_info(Client &client, const LightSong &song, bool base)
 {
-	song_print_uri(client, song, base);
+	client_begin_record(client);
 
-	const unsigned start_ms = song.start_time.ToMS();
-	const unsigned end_ms = song.end_time.ToMS();
+	song_print_uri(client, song, base);
 
-	if (end_ms > 0)
-		client_printf(client, "Range: %u.%03u-%u.%03u\n",
-			      start_ms / 1000,
-			      start_ms % 1000,
-			      end_ms / 1000,
-			      end_ms % 1000);
-	else if (start_ms > 0)
-		client_printf(client, "Range: %u.%03u-\n",
-			      start_ms / 1000,
-			      start_ms % 1000);
+	song_print_range(client, song.start_time.ToMS(), song.end_time.ToMS());
 
 	if (song.mtime > 0)
 		time_print(client, "Last-Modified", song.mtime);
 
 	tag_print(client, *song.tag);
+
+	client_end_record(client);
 }
 
 void
 song_print_info(Client &client, const DetachedSong &song, bool base)
 {
-	song_print_uri(client, song, base);
+	client_begin_record(client);
 
-	const unsigned start_ms = song.GetStartTime().ToMS();
-	const unsigned end_ms = song.GetEndTime().ToMS();
+	song_print_uri(client, song, base);
 
-	if (end_ms > 0)
-		client_printf(client, "Range: %u.%03u-%u.%03u\n",
-			      start_ms / 1000,
-			      start_ms % 1000,
-			      end_ms / 1000,
-			      end_ms % 1000);
-	else if (start_ms > 0)
-		client_printf(client, "Range: %u.%03u-\n",
-			      start_ms / 1000,
-			      start_ms % 1000);
+	song_print_range(client, song.GetStartTime().ToMS(),
+			 song.GetEndTime().ToMS());
 
 	if (song.GetLastModified() > 0)
 		time_print(client, "Last-Modified", song.GetLastModified());
@@ -122,8 +134,7 @@ song_print_info(Client &client, const DetachedSong &song, bool base)
 
 	const auto duration = song.GetDuration();
 	if (!duration.IsNegative())
-		client_printf(client, "Time: %i\n"
-			      "duration: %1.3f\n",
-			      duration.RoundS(),
-			      duration.ToDoubleS());
+		tag_print_duration(client, duration);
+
+	client_end_record(client);
 }
@@ -22,7 +22,7 @@
 #include "db/plugins/simple/Song.hxx"
 #include "DetachedSong.hxx"
 #include "TagSave.hxx"
-#include "fs/io/TextFile.hxx"
+#include "fs/io/LineReader.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "tag/Tag.hxx"
 #include "tag/TagBuilder.hxx"
@@ -34,7 +34,7 @@
 #include <stdlib.h>
 
 #define SONG_MTIME "mtime"
-#define SONG_END "song_end"
+#define SONG_SIZE "size"
 
 static constexpr Domain song_save_domain("song_save");
 
@@ -57,6 +57,11 @@ song_save(BufferedOutputStream &os, const Song &song)
 	tag_save(os, song.tag);
 
 	os.Format(SONG_MTIME ": %li\n", (long)song.mtime);
+
+	if (song.size > 0)
+		os.Format(SONG_SIZE ": %llu\n",
+			  (unsigned long long)song.size);
+
 	os.Format(SONG_END "\n");
 }
 
@@ -74,11 +79,14 @@ song_save(BufferedOutputStream &os, const DetachedSong &song)
 }
 
 DetachedSong *
-song_load(TextFile &file, const char *uri,
-	  Error &error)
+song_load(LineReader &file, const char *uri,
+	  Error &error, uint64_t *size_r)
 {
 	DetachedSong *song = new DetachedSong(uri);
 
+	if (size_r != nullptr)
+		*size_r = 0;
+
 	TagBuilder tag;
 
 	char *line;
@@ -105,6 +113,9 @@ song_load(TextFile &file, const char *uri,
 			tag.SetHasPlaylist(strcmp(value, "yes") == 0);
 		} else if (strcmp(line, SONG_MTIME) == 0) {
 			song->SetLastModified(atoi(value));
+		} else if (strcmp(line, SONG_SIZE) == 0) {
+			if (size_r != nullptr)
+				*size_r = strtoull(value, nullptr, 10);
 		} else if (strcmp(line, "Range") == 0) {
 			char *endptr;
 
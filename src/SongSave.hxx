@@ -21,12 +21,15 @@
 #define MPD_SONG_SAVE_HXX
 
 #define SONG_BEGIN "song_begin: "
+#define SONG_END "song_end"
+
+#include <stdint.h>
 
 struct Song;
 struct Directory;
 class DetachedSong;
 class BufferedOutputStream;
-class TextFile;
+class LineReader;
 class Error;
 
 void
@@ -40,10 +43,12 @@ song_save(BufferedOutputStream &os, const DetachedSong &song);
  * "song_end" line.
  *
  * @param error location to store the error occurring
+ * @param size_r if not nullptr, receives the file size (0 if the
+ * file does not specify it)
  * @return true on success, false on error
  */
 DetachedSong *
-song_load(TextFile &file, const char *uri,
-	  Error &error);
+song_load(LineReader &file, const char *uri,
+	  Error &error, uint64_t *size_r=nullptr);
 
 #endif
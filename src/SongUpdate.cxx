@@ -28,12 +28,13 @@
 #include "fs/AllocatedPath.hxx"
 #include "fs/Traits.hxx"
 #include "fs/FileInfo.hxx"
+#include "system/FileDescriptor.hxx"
 #include "decoder/DecoderList.hxx"
 #include "tag/Tag.hxx"
 #include "tag/TagBuilder.hxx"
 #include "tag/TagHandler.hxx"
-#include "tag/TagId3.hxx"
-#include "tag/ApeTag.hxx"
+#include "tag/HeaderScan.hxx"
+#include "tag/TagScanFile.hxx"
 #include "TagFile.hxx"
 #include "TagStream.hxx"
 
@@ -47,6 +48,25 @@
 
 #ifdef ENABLE_DATABASE
 
+/**
+ * Evict a file which has just been scanned by a decoder plugin from
+ * the page cache: the database update reads each file only once,
+ * and should not push the files being played out of the cache.
+ */
+static void
+DropPageCache(Path path_fs)
+{
+#ifndef WIN32
+	FileDescriptor fd;
+	if (fd.OpenReadOnly(path_fs.c_str())) {
+		fd.AdviseDontNeed();
+		fd.Close();
+	}
+#else
+	(void)path_fs;
+#endif
+}
+
 Song *
 Song::LoadFile(Storage &storage, const char *path_utf8, Directory &parent)
 {
@@ -80,8 +100,9 @@ static bool
 tag_scan_fallback(Path path,
 		  const struct tag_handler *handler, void *handler_ctx)
 {
-	return tag_ape_scan2(path, handler, handler_ctx) ||
-		tag_id3_scan(path, handler, handler_ctx);
+	LocalTagScanFile file(path);
+	return file.IsDefined() &&
+		tag_ape_id3_scan(file, handler, handler_ctx);
 }
 
 #ifdef ENABLE_DATABASE
@@ -89,34 +110,64 @@ tag_scan_fallback(Path path,
 bool
 Song::UpdateFile(Storage &storage)
 {
-	const auto &relative_uri = GetURI();
+	uint64_t bytes_read;
+	return ScanFile(storage, GetURI().c_str(), tag, mtime, size,
+			bytes_read);
+}
 
+bool
+Song::ScanFile(Storage &storage, const char *relative_uri,
+	       Tag &tag, time_t &mtime, uint64_t &size,
+	       uint64_t &bytes_read)
+{
 	StorageFileInfo info;
-	if (!storage.GetInfo(relative_uri.c_str(), true, info, IgnoreError()))
+	if (!storage.GetInfo(relative_uri, true, info, IgnoreError()))
 		return false;
 
 	if (!info.IsRegular())
 		return false;
 
 	TagBuilder tag_builder;
+	bytes_read = info.size;
 
-	const auto path_fs = storage.MapFS(relative_uri.c_str());
+	const auto path_fs = storage.MapFS(relative_uri);
 	if (path_fs.IsNull()) {
 		const auto absolute_uri =
-			storage.MapUTF8(relative_uri.c_str());
-		if (!tag_stream_scan(absolute_uri.c_str(),
-				     full_tag_handler, &tag_builder))
+			storage.MapUTF8(relative_uri);
+		if (!tag_stream_scan(absolute_uri.c_str(), tag_builder))
 			return false;
 	} else {
-		if (!tag_file_scan(path_fs, full_tag_handler, &tag_builder))
+		/* open the file only once for the header scanner and
+		   the APE/ID3 fallback */
+		LocalTagScanFile file(path_fs);
+		if (!file.IsDefined())
 			return false;
 
-		if (tag_builder.IsEmpty())
-			tag_scan_fallback(path_fs, &full_tag_handler,
-					  &tag_builder);
+		if (!tag_header_scan(file, path_fs,
+				     full_tag_handler, &tag_builder)) {
+			/* unsupported format: discard the partial
+			   result and ask the decoder plugins */
+			tag_builder.Clear();
+
+			const bool success =
+				tag_file_scan(path_fs, full_tag_handler,
+					      &tag_builder);
+			if (success && tag_builder.IsEmpty())
+				tag_ape_id3_scan(file, &full_tag_handler,
+						 &tag_builder);
+
+			DropPageCache(path_fs);
+
+			if (!success)
+				return false;
+
+			bytes_read = info.size + file.GetBytesRead();
+		} else
+			bytes_read = file.GetBytesRead();
 	}
 
 	mtime = info.mtime;
+	size = info.size;
 	tag_builder.Commit(tag);
 	return true;
 }
@@ -139,7 +190,7 @@ Song::UpdateFileInArchive(const Storage &storage)
 
 	const auto path_fs = parent->IsRoot()
 		? storage.MapFS(uri)
-		: storage.MapChildFS(parent->GetPath(), uri);
+		: storage.MapChildFS(parent->GetPath().c_str(), uri);
 	if (path_fs.IsNull())
 		return false;
 
@@ -158,7 +209,7 @@ DetachedSong::Update()
 {
 	if (IsAbsoluteFile()) {
 		const AllocatedPath path_fs =
-			AllocatedPath::FromUTF8(GetRealURI());
+			AllocatedPath::FromUTF8(GetRealURI().c_str());
 
 		FileInfo fi;
 		if (!GetFileInfo(path_fs, fi) || !fi.IsRegular())
@@ -173,7 +224,7 @@ DetachedSong::Update()
 					  &tag_builder);
 
 		mtime = fi.GetModificationTime();
-		tag_builder.Commit(tag);
+		SetTag(tag_builder.Commit());
 		return true;
 	} else if (IsRemote()) {
 		TagBuilder tag_builder;
@@ -182,7 +233,7 @@ DetachedSong::Update()
 			return false;
 
 		mtime = 0;
-		tag_builder.Commit(tag);
+		SetTag(tag_builder.Commit());
 		return true;
 	} else
 		// TODO: implement
@@ -43,7 +43,8 @@ StateFile::StateFile(AllocatedPath &&_path, unsigned _interval,
 	 interval(_interval),
 	 partition(_partition),
 	 prev_volume_version(0), prev_output_version(0),
-	 prev_playlist_version(0)
+	 prev_playlist_version(0), prev_queue_version(0),
+	 base_size(0), journal_size(0)
 {
 }
 
@@ -54,6 +55,7 @@ StateFile::RememberVersions()
 	prev_output_version = audio_output_state_get_version();
 	prev_playlist_version = playlist_state_get_hash(partition.playlist,
 							partition.pc);
+	prev_queue_version = partition.playlist.queue.version;
 }
 
 bool
@@ -81,19 +83,80 @@ StateFile::Write(OutputStream &os, Error &error)
 	return bos.Flush(error);
 }
 
+inline bool
+StateFile::CanAppend() const
+{
+	return base_size > 0 && journal_size < base_size &&
+		prev_volume_version == sw_volume_state_get_hash() &&
+		prev_output_version == audio_output_state_get_version() &&
+		/* after a version number overflow, all songs are
+		   "modified" */
+		partition.playlist.queue.version >= prev_queue_version;
+}
+
+inline bool
+StateFile::Append()
+{
+	FormatDebug(state_file_domain,
+		    "Appending to state file %s", path_utf8.c_str());
+
+	Error error;
+	AppendFileOutputStream fos(path, error);
+	if (!fos.IsDefined()) {
+		LogError(error);
+		return false;
+	}
+
+	BufferedOutputStream bos(fos);
+	playlist_state_save_changes(bos, partition.playlist, partition.pc,
+				    prev_queue_version);
+	if (!bos.Flush(error)) {
+		LogError(error);
+		return false;
+	}
+
+	const uint64_t size = fos.Tell();
+	if (!fos.Commit(error)) {
+		LogError(error);
+		return false;
+	}
+
+	journal_size = size - base_size;
+	return true;
+}
+
 void
 StateFile::Write()
 {
+	if (CanAppend()) {
+		if (Append()) {
+			RememberVersions();
+			return;
+		}
+
+		/* the file may end with a partial journal block now,
+		   which would corrupt the next one; rewrite it */
+	}
+
 	FormatDebug(state_file_domain,
 		    "Saving state file %s", path_utf8.c_str());
 
+	base_size = journal_size = 0;
+
 	Error error;
 	FileOutputStream fos(path, error);
-	if (!fos.IsDefined() || !Write(fos, error) || !fos.Commit(error)) {
+	if (!fos.IsDefined() || !Write(fos, error)) {
+		LogError(error);
+		return;
+	}
+
+	const uint64_t size = fos.Tell();
+	if (!fos.Commit(error)) {
 		LogError(error);
 		return;
 	}
 
+	base_size = size;
 	RememberVersions();
 }
 
@@ -113,7 +176,8 @@ StateFile::Read()
 
 #ifdef ENABLE_DATABASE
 	const SongLoader song_loader(partition.instance.database,
-				     partition.instance.storage);
+				     partition.instance.storage,
+				     partition.instance.IsDatabaseLoading());
 #else
 	const SongLoader song_loader(nullptr, nullptr);
 #endif
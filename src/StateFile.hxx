@@ -26,6 +26,8 @@
 
 #include <string>
 
+#include <stdint.h>
+
 struct Partition;
 class OutputStream;
 class BufferedOutputStream;
@@ -45,6 +47,26 @@ class StateFile final : private TimeoutMonitor {
 	unsigned prev_volume_version, prev_output_version,
 		prev_playlist_version;
 
+	/**
+	 * The queue version at the last write.  Songs modified after
+	 * that are appended to the file as a journal block.
+	 */
+	uint32_t prev_queue_version;
+
+	/**
+	 * The size of the last full write; 0 if there was none (or if
+	 * the file must be rewritten for another reason).  Once the
+	 * journal blocks appended after it are larger, the file is
+	 * compacted by writing it from scratch.
+	 */
+	uint64_t base_size;
+
+	/**
+	 * The total size of the journal blocks appended since the
+	 * last full write.
+	 */
+	uint64_t journal_size;
+
 public:
 	static constexpr unsigned DEFAULT_INTERVAL = 2 * 60;
 
@@ -63,6 +85,22 @@ private:
 	bool Write(OutputStream &os, Error &error);
 	void Write(BufferedOutputStream &os);
 
+	/**
+	 * Can the current state be saved by appending a journal
+	 * block?  This is only possible if just the playlist was
+	 * modified.
+	 */
+	gcc_pure
+	bool CanAppend() const;
+
+	/**
+	 * Append the playback state and the modified songs to the
+	 * file.
+	 *
+	 * @return false on error; the caller should rewrite the file
+	 */
+	bool Append();
+
 	/**
 	 * Save the current state versions for use with IsModified().
 	 */
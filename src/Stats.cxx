@@ -20,16 +20,23 @@
 #include "config.h"
 #include "Stats.hxx"
 #include "PlayerControl.hxx"
+#include "MusicBuffer.hxx"
 #include "client/Client.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "db/Selection.hxx"
 #include "db/Interface.hxx"
 #include "db/Stats.hxx"
+#include "db/DatabaseLock.hxx"
+#include "tag/TagPool.hxx"
 #include "util/Error.hxx"
 #include "system/Clock.hxx"
 #include "Log.hxx"
 
+#ifdef ENABLE_NFS
+#include "lib/nfs/Glue.hxx"
+#endif
+
 #ifndef WIN32
 /**
  * The monotonic time stamp when MPD was started.  It is used to
@@ -121,22 +128,70 @@ db_stats_print(Client &client, const Database &db)
 
 #endif
 
+unsigned
+stats_get_uptime()
+{
+#ifdef WIN32
+	return GetProcessUptimeS();
+#else
+	return MonotonicClockS() - start_time;
+#endif
+}
+
 void
 stats_print(Client &client)
 {
 	client_printf(client,
 		      "uptime: %u\n"
 		      "playtime: %lu\n",
-#ifdef WIN32
-		      GetProcessUptimeS(),
-#else
-		      MonotonicClockS() - start_time,
-#endif
+		      stats_get_uptime(),
 		      (unsigned long)(client.player_control.GetTotalPlayTime() + 0.5));
 
+	const auto buffer_stats = MusicBuffer::GetStats();
+	client_printf(client,
+		      "buffer_allocate_hits: %lu\n"
+		      "buffer_allocate_misses: %lu\n"
+		      "buffer_return_hits: %lu\n"
+		      "buffer_return_misses: %lu\n",
+		      buffer_stats.allocate_hits,
+		      buffer_stats.allocate_misses,
+		      buffer_stats.return_hits,
+		      buffer_stats.return_misses);
+
+	const auto tag_stats = tag_pool_get_stats();
+	client_printf(client,
+		      "tag_pool_items: %lu\n"
+		      "tag_pool_load: %.2f\n",
+		      (unsigned long)tag_stats.items,
+		      tag_stats.buckets > 0
+		      ? double(tag_stats.items) / tag_stats.buckets
+		      : 0.);
+
 #ifdef ENABLE_DATABASE
+	const auto lock_stats = db_lock_get_stats();
+	client_printf(client,
+		      "db_lock_shared: %lu\n"
+		      "db_lock_exclusive: %lu\n"
+		      "db_lock_contended: %lu\n"
+		      "db_lock_wait_ms: %lu\n",
+		      lock_stats.shared,
+		      lock_stats.exclusive,
+		      lock_stats.contended,
+		      lock_stats.wait_us / 1000);
+
 	const Database *db = client.partition.instance.database;
 	if (db != nullptr)
 		db_stats_print(client, *db);
 #endif
+
+#ifdef ENABLE_NFS
+	for (const auto &i : nfs_get_stats())
+		client_printf(client,
+			      "nfs_session: %s:%s\n"
+			      "nfs_rtt_us: %u\n"
+			      "nfs_queue: %u\n"
+			      "nfs_leases: %u\n",
+			      i.server.c_str(), i.export_name.c_str(),
+			      i.rtt_us, i.queue_depth, i.leases);
+#endif
 }
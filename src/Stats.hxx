@@ -20,6 +20,8 @@
 #ifndef MPD_STATS_HXX
 #define MPD_STATS_HXX
 
+#include "Compiler.h"
+
 class Client;
 
 void
@@ -28,6 +30,13 @@ stats_global_init();
 void
 stats_invalidate();
 
+/**
+ * Returns the number of seconds since MPD was started.
+ */
+gcc_pure
+unsigned
+stats_get_uptime();
+
 void
 stats_print(Client &client);
 
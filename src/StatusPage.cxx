@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "StatusPage.hxx"
+#include "Partition.hxx"
+#include "mixer/Volume.hxx"
+#include "system/Clock.hxx"
+#include "fs/FileSystem.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+static constexpr Domain status_page_domain("status_page");
+
+StatusPage *
+StatusPage::Create(EventLoop &loop, Partition &partition,
+		   AllocatedPath &&path, Error &error)
+{
+#ifdef WIN32
+	(void)loop;
+	(void)partition;
+	(void)path;
+
+	error.Set(status_page_domain,
+		  "The status page is not supported on this platform");
+	return nullptr;
+#else
+	int fd = OpenFile(path, O_RDWR|O_CREAT, 0644);
+	if (fd < 0) {
+		error.FormatErrno("Failed to create %s",
+				  path.ToUTF8().c_str());
+		return nullptr;
+	}
+
+	if (ftruncate(fd, sizeof(StatusPageData)) < 0) {
+		error.FormatErrno("Failed to resize %s",
+				  path.ToUTF8().c_str());
+		close(fd);
+		return nullptr;
+	}
+
+	void *p = mmap(nullptr, sizeof(StatusPageData),
+		       PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) {
+		error.FormatErrno("Failed to map %s",
+				  path.ToUTF8().c_str());
+		close(fd);
+		return nullptr;
+	}
+
+	auto *data = (StatusPageData *)p;
+
+	/* readers which have mapped an older file see an odd
+	   sequence number until the first Update() */
+	const uint32_t sequence =
+		__atomic_load_n(&data->sequence, __ATOMIC_RELAXED);
+	__atomic_store_n(&data->sequence, sequence | 1, __ATOMIC_RELAXED);
+	data->magic = StatusPageData::MAGIC;
+	data->version = StatusPageData::LAYOUT_VERSION;
+
+	auto *page = new StatusPage(loop, partition, std::move(path),
+				    fd, data);
+	page->Update();
+	return page;
+#endif
+}
+
+StatusPage::~StatusPage()
+{
+#ifndef WIN32
+	/* tell readers which keep the file mapped that MPD is
+	   gone */
+	StatusPageData stopped;
+	memset(&stopped, 0, sizeof(stopped));
+	stopped.volume = -1;
+	stopped.song_id = stopped.song_pos = -1;
+	stopped.duration_ms = -1;
+	stopped.timestamp_us = MonotonicClockUS();
+	Publish(stopped);
+
+	munmap(data, sizeof(*data));
+	close(fd);
+	RemoveFile(path);
+#endif
+}
+
+void
+StatusPage::Publish(const StatusPageData &src)
+{
+	/* the header (magic, version, sequence) is not copied */
+	static constexpr size_t offset =
+		offsetof(StatusPageData, sequence) + sizeof(uint32_t);
+
+	const uint32_t sequence =
+		__atomic_load_n(&data->sequence, __ATOMIC_RELAXED) | 1;
+
+	__atomic_store_n(&data->sequence, sequence, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memcpy((char *)data + offset, (const char *)&src + offset,
+	       sizeof(src) - offset);
+
+	__atomic_store_n(&data->sequence, sequence + 1, __ATOMIC_RELEASE);
+}
+
+void
+StatusPage::Update()
+{
+	const auto status = partition.pc.GetStatus();
+	const auto &playlist = partition.playlist;
+
+	StatusPageData page;
+	memset(&page, 0, sizeof(page));
+
+	page.state = uint8_t(status.state);
+	page.volume = volume_level_get(partition.outputs);
+	page.queue_version = playlist.GetVersion();
+
+	const int position = playlist.GetCurrentPosition();
+	page.song_pos = position;
+	page.song_id = position >= 0
+		? int32_t(playlist.PositionToId(position))
+		: -1;
+
+	page.duration_ms = -1;
+
+	if (status.state != PlayerState::STOP) {
+		page.bit_rate = status.bit_rate;
+		page.elapsed_ms = status.elapsed_time.ToMS();
+
+		if (!status.total_time.IsNegative())
+			page.duration_ms = status.total_time.ToMS();
+
+		if (status.audio_format.IsDefined()) {
+			page.format = uint8_t(status.audio_format.format);
+			page.channels = status.audio_format.channels;
+			page.sample_rate = status.audio_format.sample_rate;
+		}
+	}
+
+	page.timestamp_us = MonotonicClockUS();
+
+	Publish(page);
+
+	/* while playing, correct the readers' extrapolation
+	   regularly */
+	if (status.state == PlayerState::PLAY)
+		TimeoutMonitor::ScheduleSeconds(REFRESH_INTERVAL);
+	else
+		TimeoutMonitor::Cancel();
+}
+
+void
+StatusPage::OnTimeout()
+{
+	Update();
+}
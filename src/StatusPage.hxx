@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STATUS_PAGE_HXX
+#define MPD_STATUS_PAGE_HXX
+
+#include "event/TimeoutMonitor.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "Compiler.h"
+
+#include <stdint.h>
+
+struct Partition;
+class Error;
+
+/**
+ * The layout of the file which is mapped by #StatusPage.  All
+ * integers are in host byte order; the file is meant to be read by
+ * processes on the same host only.
+ *
+ * The writer increments #sequence before and after modifying the
+ * other attributes, i.e. it is odd while an update is in progress.
+ * A reader copies the whole struct, and retries if #sequence was odd
+ * or has changed meanwhile ("seqlock").
+ */
+struct StatusPageData {
+	static constexpr uint32_t MAGIC = 0x5344504d; /* "MPDS" */
+	static constexpr uint32_t LAYOUT_VERSION = 1;
+
+	uint32_t magic;
+	uint32_t version;
+
+	uint32_t sequence;
+
+	/**
+	 * The #PlayerState: 0 = stop, 1 = pause, 2 = play.
+	 */
+	uint8_t state;
+
+	/**
+	 * The #SampleFormat of the audio being played; 0 if unknown.
+	 */
+	uint8_t format;
+
+	uint8_t channels;
+
+	/**
+	 * The mixer volume [0..100]; -1 if there is no mixer.
+	 */
+	int8_t volume;
+
+	uint32_t sample_rate;
+
+	/**
+	 * The bit rate of the current song [kbit/s]; 0 if unknown.
+	 */
+	uint32_t bit_rate;
+
+	/**
+	 * The id and the position of the current song in the queue;
+	 * -1 if there is none.
+	 */
+	int32_t song_id, song_pos;
+
+	/**
+	 * The queue version, see "plchanges".
+	 */
+	uint32_t queue_version;
+
+	/**
+	 * The duration of the current song [ms]; -1 if unknown.
+	 */
+	int32_t duration_ms;
+
+	/**
+	 * The elapsed time of the current song [ms], sampled at
+	 * #timestamp_us.  While playing, readers should add the
+	 * CLOCK_MONOTONIC time passed since then.
+	 */
+	uint32_t elapsed_ms;
+
+	uint32_t reserved;
+
+	/**
+	 * The CLOCK_MONOTONIC time [us] when #elapsed_ms was sampled.
+	 */
+	uint64_t timestamp_us;
+};
+
+static_assert(sizeof(StatusPageData) == 56,
+	      "Unexpected StatusPageData layout");
+
+/**
+ * Publishes the status of a #Partition in a shared memory file
+ * (configured with "status_page"), which local clients can map and
+ * read without talking to MPD.  It is updated on "idle" events and
+ * periodically while playing.
+ */
+class StatusPage final : TimeoutMonitor {
+	Partition &partition;
+
+	const AllocatedPath path;
+
+	int fd;
+
+	StatusPageData *data;
+
+	StatusPage(EventLoop &_loop, Partition &_partition,
+		   AllocatedPath &&_path, int _fd, StatusPageData *_data)
+		:TimeoutMonitor(_loop), partition(_partition),
+		 path(std::move(_path)), fd(_fd), data(_data) {}
+
+public:
+	/**
+	 * Refresh the page while playing after this duration
+	 * [seconds], to correct the extrapolated elapsed time.
+	 */
+	static constexpr unsigned REFRESH_INTERVAL = 1;
+
+	~StatusPage();
+
+	/**
+	 * Create and map the file.
+	 *
+	 * @return the new object or nullptr on error
+	 */
+	static StatusPage *Create(EventLoop &loop, Partition &partition,
+				  AllocatedPath &&path, Error &error);
+
+	/**
+	 * Rewrite the page with the current status.  Call this from
+	 * the main thread after "idle" events.
+	 */
+	void Update();
+
+private:
+	void Publish(const StatusPageData &src);
+
+	/* virtual methods from class TimeoutMonitor */
+	void OnTimeout() override;
+};
+
+#endif
@@ -94,7 +94,8 @@ tag_file_scan(Path path_fs, const tag_handler &handler, void *handler_ctx)
 	const auto suffix_utf8 = Path::FromFS(suffix).ToUTF8();
 
 	TagFileScan tfs(path_fs, suffix_utf8.c_str(), handler, handler_ctx);
-	return decoder_plugins_try([&](const DecoderPlugin &plugin){
+	return decoder_plugins_try_format(suffix_utf8.c_str(), nullptr,
+					  [&](const DecoderPlugin &plugin){
 			return tfs.Scan(plugin);
 		});
 }
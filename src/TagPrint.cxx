@@ -22,6 +22,10 @@
 #include "tag/Tag.hxx"
 #include "tag/TagSettings.h"
 #include "client/Client.hxx"
+#include "client/CompactRecord.hxx"
+#include "Chrono.hxx"
+
+#include <stdio.h>
 
 void tag_print_types(Client &client)
 {
@@ -29,32 +33,38 @@ void tag_print_types(Client &client)
 
 	for (i = 0; i < TAG_NUM_OF_ITEM_TYPES; i++) {
 		if (!ignore_tag_items[i])
-			client_printf(client, "tagtype: %s\n",
-				      tag_item_names[i]);
+			client_print_pair(client, "tagtype",
+					  tag_item_names[i]);
 	}
 }
 
 void
 tag_print(Client &client, TagType type, const char *value)
 {
-	client_printf(client, "%s: %s\n", tag_item_names[type], value);
+	client_print_field(client, type, value);
 }
 
 void
 tag_print_values(Client &client, const Tag &tag)
 {
 	for (const auto &i : tag)
-		client_printf(client, "%s: %s\n",
-			      tag_item_names[i.type], i.value);
+		client_print_field(client, i.type, i.value);
+}
+
+void
+tag_print_duration(Client &client, SignedSongTime duration)
+{
+	client_print_field(client, COMPACT_TIME, unsigned(duration.RoundS()));
+
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%1.3f", duration.ToDoubleS());
+	client_print_field(client, COMPACT_DURATION, buffer);
 }
 
 void tag_print(Client &client, const Tag &tag)
 {
 	if (!tag.duration.IsNegative())
-		client_printf(client, "Time: %i\n"
-			      "duration: %1.3f\n",
-			      tag.duration.RoundS(),
-			      tag.duration.ToDoubleS());
+		tag_print_duration(client, tag.duration);
 
 	tag_print_values(client, tag);
 }
@@ -26,6 +26,7 @@ enum TagType : uint8_t;
 
 struct Tag;
 class Client;
+class SignedSongTime;
 
 void tag_print_types(Client &client);
 
@@ -35,6 +36,12 @@ tag_print(Client &client, TagType type, const char *value);
 void
 tag_print_values(Client &client, const Tag &tag);
 
+/**
+ * Print the "Time" and "duration" attributes.
+ */
+void
+tag_print_duration(Client &client, SignedSongTime duration);
+
 void
 tag_print(Client &client, const Tag &tag);
 
@@ -19,6 +19,10 @@
 
 #include "config.h"
 #include "TagStream.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/TagHandler.hxx"
+#include "tag/TagScanFile.hxx"
+#include "tag/HeaderScan.hxx"
 #include "util/UriUtil.hxx"
 #include "util/Error.hxx"
 #include "decoder/DecoderList.hxx"
@@ -29,6 +33,40 @@
 
 #include <assert.h>
 
+/**
+ * A #TagScanFile reading from an #InputStream.
+ */
+class InputStreamTagScanFile final : public TagScanFile {
+	InputStream &is;
+
+public:
+	explicit InputStreamTagScanFile(InputStream &_is)
+		:is(_is) {
+		if (is.KnownSize())
+			SetSize(is.GetSize());
+	}
+
+protected:
+	/* virtual methods from class TagScanFile */
+	size_t ReadRaw(uint64_t offset, void *dest, size_t length) override {
+		if (!is.LockSeek(offset, IgnoreError()))
+			return 0;
+
+		size_t nbytes = 0;
+		while (nbytes < length) {
+			size_t n = is.LockRead((uint8_t *)dest + nbytes,
+					       length - nbytes,
+					       IgnoreError());
+			if (n == 0)
+				break;
+
+			nbytes += n;
+		}
+
+		return nbytes;
+	}
+};
+
 /**
  * Does the #DecoderPlugin support either the suffix or the MIME type?
  */
@@ -53,8 +91,9 @@ tag_stream_scan(InputStream &is, const tag_handler &handler, void *ctx)
 	if (suffix == nullptr && mime == nullptr)
 		return false;
 
-	return decoder_plugins_try([suffix, mime, &is,
-				    &handler, ctx](const DecoderPlugin &plugin){
+	return decoder_plugins_try_format(suffix, mime,
+					  [suffix, mime, &is,
+					   &handler, ctx](const DecoderPlugin &plugin){
 			is.LockRewind(IgnoreError());
 
 			return CheckDecoderPlugin(plugin, suffix, mime) &&
@@ -77,3 +116,25 @@ tag_stream_scan(const char *uri, const tag_handler &handler, void *ctx)
 	delete is;
 	return success;
 }
+
+bool
+tag_stream_scan(const char *uri, TagBuilder &builder)
+{
+	Mutex mutex;
+	Cond cond;
+
+	InputStream *is = InputStream::OpenReady(uri, mutex, cond,
+						 IgnoreError());
+	if (is == nullptr)
+		return false;
+
+	bool success = tag_stream_scan(*is, full_tag_handler, &builder);
+	if (success && builder.IsEmpty() &&
+	    is->IsSeekable() && is->KnownSize()) {
+		InputStreamTagScanFile file(*is);
+		tag_ape_id3_scan(file, &full_tag_handler, &builder);
+	}
+
+	delete is;
+	return success;
+}
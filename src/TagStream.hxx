@@ -23,6 +23,7 @@
 #include "check.h"
 
 class InputStream;
+class TagBuilder;
 struct tag_handler;
 
 /**
@@ -38,4 +39,13 @@ tag_stream_scan(InputStream &is, const tag_handler &handler, void *ctx);
 bool
 tag_stream_scan(const char *uri, const tag_handler &handler, void *ctx);
 
+/**
+ * Scan the tags of the given URI into a #TagBuilder.  If the decoder
+ * plugin finds no tags and the stream is seekable, the APE and ID3
+ * scanners are invoked on the same #InputStream, i.e. the resource
+ * is opened only once.
+ */
+bool
+tag_stream_scan(const char *uri, TagBuilder &builder);
+
 #endif
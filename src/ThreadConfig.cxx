@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ThreadConfig.hxx"
+#include "config/Block.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "thread/Slack.hxx"
+#include "system/FatalError.hxx"
+#include "util/HugeAllocator.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+static constexpr Domain thread_config_domain("thread_config");
+
+struct ThreadConfig {
+	std::string name;
+
+	/**
+	 * The scheduling policy, or -1 to leave it unchanged.
+	 */
+	int policy = -1;
+
+	int priority = 0;
+
+	/**
+	 * The timer slack in microseconds, or -1 to leave it
+	 * unchanged.
+	 */
+	long timer_slack = -1;
+
+#ifdef __linux__
+	bool have_affinity = false;
+	cpu_set_t affinity;
+#endif
+};
+
+static std::vector<ThreadConfig> thread_configs;
+
+#ifdef __linux__
+
+static int
+ParseSchedulingPolicy(const char *s)
+{
+	if (strcmp(s, "other") == 0)
+		return SCHED_OTHER;
+	else if (strcmp(s, "fifo") == 0)
+		return SCHED_FIFO;
+	else if (strcmp(s, "rr") == 0)
+		return SCHED_RR;
+#ifdef SCHED_BATCH
+	else if (strcmp(s, "batch") == 0)
+		return SCHED_BATCH;
+#endif
+#ifdef SCHED_IDLE
+	else if (strcmp(s, "idle") == 0)
+		return SCHED_IDLE;
+#endif
+	else
+		return -1;
+}
+
+/**
+ * Parse a list of CPU numbers and ranges, e.g. "0,2-3".
+ */
+static bool
+ParseCpuList(const char *s, cpu_set_t &set)
+{
+	CPU_ZERO(&set);
+
+	while (true) {
+		char *endptr;
+		unsigned long first = strtoul(s, &endptr, 10);
+		if (endptr == s)
+			return false;
+
+		unsigned long last = first;
+		if (*endptr == '-') {
+			s = endptr + 1;
+			last = strtoul(s, &endptr, 10);
+			if (endptr == s || last < first)
+				return false;
+		}
+
+		if (last >= CPU_SETSIZE)
+			return false;
+
+		for (unsigned long i = first; i <= last; ++i)
+			CPU_SET(i, &set);
+
+		if (*endptr == 0)
+			return true;
+
+		if (*endptr != ',')
+			return false;
+
+		s = endptr + 1;
+	}
+}
+
+#endif
+
+static ThreadConfig
+ParseThreadConfig(const ConfigBlock &block)
+{
+	ThreadConfig tc;
+
+	const char *name = block.GetBlockValue("name");
+	if (name == nullptr)
+		FormatFatalError("Missing \"name\" in thread block at line %i",
+				 block.line);
+
+	tc.name = name;
+
+#ifdef __linux__
+	const char *scheduler = block.GetBlockValue("scheduler");
+	if (scheduler != nullptr) {
+		tc.policy = ParseSchedulingPolicy(scheduler);
+		if (tc.policy < 0)
+			FormatFatalError("Invalid scheduler \"%s\" at line %i",
+					 scheduler, block.line);
+	}
+
+	tc.priority = block.GetBlockValue("priority", 0);
+	if (tc.policy == SCHED_FIFO || tc.policy == SCHED_RR) {
+		if (tc.priority < sched_get_priority_min(tc.policy) ||
+		    tc.priority > sched_get_priority_max(tc.policy))
+			FormatFatalError("Invalid priority %d at line %i",
+					 tc.priority, block.line);
+	} else if (tc.priority != 0)
+		FormatFatalError("\"priority\" requires scheduler \"fifo\" or \"rr\" at line %i",
+				 block.line);
+
+	const char *affinity = block.GetBlockValue("cpu_affinity");
+	if (affinity != nullptr) {
+		if (!ParseCpuList(affinity, tc.affinity))
+			FormatFatalError("Invalid cpu_affinity \"%s\" at line %i",
+					 affinity, block.line);
+
+		tc.have_affinity = true;
+	}
+#else
+	if (block.GetBlockValue("scheduler") != nullptr ||
+	    block.GetBlockValue("cpu_affinity") != nullptr)
+		FormatFatalError("Thread scheduling is not supported on this platform (line %i)",
+				 block.line);
+#endif
+
+	const char *slack = block.GetBlockValue("timer_slack");
+	if (slack != nullptr) {
+		char *endptr;
+		tc.timer_slack = strtol(slack, &endptr, 10);
+		if (endptr == slack || *endptr != 0 || tc.timer_slack < 0)
+			FormatFatalError("Invalid timer_slack \"%s\" at line %i",
+					 slack, block.line);
+	}
+
+	return tc;
+}
+
+void
+thread_config_global_init()
+{
+	for (const auto *block = config_get_block(ConfigBlockOption::THREAD);
+	     block != nullptr; block = block->next) {
+		ThreadConfig tc = ParseThreadConfig(*block);
+
+		for (const auto &i : thread_configs)
+			if (i.name == tc.name)
+				FormatFatalError("Duplicate thread block \"%s\" at line %i",
+						 tc.name.c_str(), block->line);
+
+		thread_configs.emplace_back(std::move(tc));
+	}
+}
+
+/**
+ * Implementation of "lock_memory audio": fault in and lock only the
+ * buffers on the audio path, which are allocated with
+ * HugeAllocate().
+ */
+static void
+thread_config_lock_audio_buffers()
+{
+#ifdef __linux__
+	struct rlimit rl;
+	if (getrlimit(RLIMIT_MEMLOCK, &rl) == 0 &&
+	    rl.rlim_cur != RLIM_INFINITY)
+		FormatWarning(thread_config_domain,
+			      "RLIMIT_MEMLOCK is %lu kB; audio buffers "
+			      "exceeding it will not be locked",
+			      (unsigned long)(rl.rlim_cur / 1024));
+
+	HugeSetLocked(true);
+#else
+	LogWarning(thread_config_domain,
+		   "lock_memory is not supported on this platform");
+#endif
+}
+
+void
+thread_config_lock_memory()
+{
+	const char *value = config_get_string(ConfigOption::LOCK_MEMORY,
+					      nullptr);
+	if (value != nullptr && strcmp(value, "audio") == 0) {
+		thread_config_lock_audio_buffers();
+		return;
+	}
+
+	if (!config_get_bool(ConfigOption::LOCK_MEMORY, false))
+		return;
+
+#ifdef __linux__
+	if (mlockall(MCL_CURRENT|MCL_FUTURE) < 0)
+		LogErrno(thread_config_domain, "mlockall() failed");
+#else
+	LogWarning(thread_config_domain,
+		   "lock_memory is not supported on this platform");
+#endif
+}
+
+gcc_pure
+static const ThreadConfig *
+FindThreadConfig(const char *name)
+{
+	for (const auto &i : thread_configs)
+		if (i.name == name)
+			return &i;
+
+	return nullptr;
+}
+
+void
+ApplyThreadConfig(const char *name, const char *instance)
+{
+	const ThreadConfig *tc = nullptr;
+	if (instance != nullptr)
+		tc = FindThreadConfig((std::string(name) + ':' + instance).c_str());
+	if (tc == nullptr)
+		tc = FindThreadConfig(name);
+	if (tc == nullptr)
+		return;
+
+#ifdef __linux__
+	if (tc->policy >= 0) {
+		struct sched_param sched_param;
+		sched_param.sched_priority = tc->priority;
+
+		int policy = tc->policy;
+#ifdef SCHED_RESET_ON_FORK
+		if (policy == SCHED_FIFO || policy == SCHED_RR)
+			policy |= SCHED_RESET_ON_FORK;
+#endif
+
+		if (sched_setscheduler(0, policy, &sched_param) < 0)
+			FormatErrno(thread_config_domain,
+				    "Failed to set the scheduler of thread \"%s\"",
+				    tc->name.c_str());
+	}
+
+	if (tc->have_affinity &&
+	    sched_setaffinity(0, sizeof(tc->affinity), &tc->affinity) < 0)
+		FormatErrno(thread_config_domain,
+			    "Failed to set the CPU affinity of thread \"%s\"",
+			    tc->name.c_str());
+#endif
+
+	if (tc->timer_slack >= 0)
+		SetThreadTimerSlackUS(tc->timer_slack);
+}
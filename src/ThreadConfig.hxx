@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_THREAD_CONFIG_HXX
+#define MPD_THREAD_CONFIG_HXX
+
+#include "check.h"
+
+/**
+ * Load the "thread" blocks, which configure the scheduling policy,
+ * the CPU affinity and the timer slack of MPD's threads.  Exits with
+ * a fatal error if a block is invalid.
+ */
+void
+thread_config_global_init();
+
+/**
+ * Lock all current and future memory pages into RAM if the
+ * "lock_memory" setting is enabled.  With "lock_memory audio", only
+ * the audio buffers allocated after this call are faulted in and
+ * locked (see HugeSetLocked()).  This must be called after
+ * daemonizing, because memory locks are not inherited by a child
+ * process.
+ */
+void
+thread_config_lock_memory();
+
+/**
+ * Apply the "thread" block matching the calling thread.  A block
+ * named "NAME:INSTANCE" is preferred over one named "NAME".  Errors
+ * are logged, but not fatal.
+ *
+ * @param name the kind of thread, e.g. "output" or "decoder"
+ * @param instance the name of the instance, e.g. the name of an audio
+ * output; nullptr if there is only one
+ */
+void
+ApplyThreadConfig(const char *name, const char *instance=nullptr);
+
+#endif
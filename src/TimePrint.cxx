@@ -41,5 +41,5 @@ time_print(Client &client, const char *name, time_t t)
 		 "%FT%TZ",
 #endif
 		 tm2);
-	client_printf(client, "%s: %s\n", name, buffer);
+	client_print_pair(client, name, buffer);
 }
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "TraceFile.hxx"
+#include "system/Trace.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "util/Error.hxx"
+
+#include <assert.h>
+
+static AllocatedPath trace_path = AllocatedPath::Null();
+
+bool
+trace_global_init(Error &error)
+{
+	trace_path = config_get_path(ConfigOption::TRACE_FILE, error);
+	if (trace_path.IsNull())
+		return !error.IsDefined();
+
+	trace_enabled.store(true, std::memory_order_relaxed);
+	return true;
+}
+
+void
+trace_global_finish()
+{
+	trace_enabled.store(false, std::memory_order_relaxed);
+	trace_free_buffers();
+	trace_path = AllocatedPath::Null();
+}
+
+bool
+trace_dump(Error &error)
+{
+	assert(!trace_path.IsNull());
+
+	const auto threads = trace_snapshot();
+
+	FileOutputStream fos(trace_path, error);
+	if (!fos.IsDefined())
+		return false;
+
+	BufferedOutputStream bos(fos);
+	bos.Write("{\"traceEvents\":[\n");
+
+	bool first = true;
+	for (const auto &t : threads) {
+		/* thread names are set by MPD itself and contain no
+		   characters which need escaping */
+		bos.Format("%s{\"name\":\"thread_name\",\"ph\":\"M\","
+			   "\"pid\":1,\"tid\":%u,"
+			   "\"args\":{\"name\":\"%s\"}}",
+			   first ? "" : ",\n", t.tid, t.name);
+		first = false;
+
+		for (const auto &e : t.events)
+			bos.Format(",\n{\"name\":\"%s\",\"ph\":\"X\","
+				   "\"pid\":1,\"tid\":%u,"
+				   "\"ts\":%llu,\"dur\":%llu,"
+				   "\"args\":{\"arg\":%llu}}",
+				   e.name, t.tid,
+				   (unsigned long long)e.start_us,
+				   (unsigned long long)e.duration_us,
+				   (unsigned long long)e.arg);
+	}
+
+	bos.Write("\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	return bos.Flush(error) && fos.Commit(error);
+}
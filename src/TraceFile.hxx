@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_TRACE_FILE_HXX
+#define MPD_TRACE_FILE_HXX
+
+class Error;
+
+/**
+ * Read the "trace_file" setting, and enable tracing if it is set.
+ */
+bool
+trace_global_init(Error &error);
+
+/**
+ * Disable tracing and free all buffers.  Must be called after all
+ * other threads have exited.
+ */
+void
+trace_global_finish();
+
+/**
+ * Write all buffered events to the "trace_file" in the Chrome trace
+ * JSON format, which can be loaded into chrome://tracing or
+ * Perfetto.  The events are not removed from the buffers.
+ */
+bool
+trace_dump(Error &error);
+
+#endif
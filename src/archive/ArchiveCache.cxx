@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ArchiveCache.hxx"
+#include "ArchivePlugin.hxx"
+#include "ArchiveFile.hxx"
+#include "thread/Mutex.hxx"
+#include "fs/Path.hxx"
+#include "fs/FileInfo.hxx"
+
+#include <list>
+#include <iterator>
+#include <string>
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Keeps the most recently used #ArchiveFile handles open, together
+ * with the directory which the plugin has parsed.  Each item holds one
+ * reference; streams which are still open keep the handle alive after
+ * it has been evicted.
+ */
+class ArchiveCache {
+	/**
+	 * Each item holds a file descriptor, therefore only a few
+	 * are kept.
+	 */
+	static constexpr size_t MAX_ITEMS = 8;
+
+	struct Item {
+		const ArchivePlugin *plugin;
+		std::string path;
+		time_t mtime;
+		uint64_t size;
+
+		ArchiveFile *file;
+	};
+
+	Mutex mutex;
+
+	/**
+	 * Most recently used first.
+	 */
+	std::list<Item> items;
+
+public:
+	~ArchiveCache() {
+		Clear();
+	}
+
+	ArchiveFile *Open(const ArchivePlugin &plugin, Path path,
+			  Error &error);
+
+	void Clear();
+
+private:
+	/**
+	 * Caller must lock the mutex.
+	 */
+	std::list<Item>::iterator Find(const ArchivePlugin &plugin,
+				       Path path);
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void Erase(std::list<Item>::iterator i) {
+		i->file->Close();
+		items.erase(i);
+	}
+};
+
+static ArchiveCache archive_cache;
+
+std::list<ArchiveCache::Item>::iterator
+ArchiveCache::Find(const ArchivePlugin &plugin, Path path)
+{
+	for (auto i = items.begin(); i != items.end(); ++i)
+		if (i->plugin == &plugin && i->path == path.c_str())
+			return i;
+
+	return items.end();
+}
+
+ArchiveFile *
+ArchiveCache::Open(const ArchivePlugin &plugin, Path path, Error &error)
+{
+	FileInfo fi;
+	if (!GetFileInfo(path, fi))
+		/* let the plugin report the error */
+		return archive_file_open(&plugin, path, error);
+
+	{
+		const ScopeLock protect(mutex);
+
+		auto i = Find(plugin, path);
+		if (i != items.end()) {
+			if (i->mtime == fi.GetModificationTime() &&
+			    i->size == fi.GetSize()) {
+				items.splice(items.begin(), items, i);
+				i->file->Ref();
+				return i->file;
+			}
+
+			/* the file has been modified */
+			Erase(i);
+		}
+	}
+
+	/* parsing the archive may take a while; don't block other
+	   threads meanwhile */
+	ArchiveFile *file = archive_file_open(&plugin, path, error);
+	if (file == nullptr)
+		return nullptr;
+
+	const ScopeLock protect(mutex);
+
+	/* another thread may have opened the same file in the
+	   meantime */
+	auto i = Find(plugin, path);
+	if (i != items.end())
+		Erase(i);
+
+	if (items.size() >= MAX_ITEMS)
+		Erase(std::prev(items.end()));
+
+	file->Ref();
+	items.push_front({&plugin, path.c_str(),
+			  fi.GetModificationTime(), fi.GetSize(),
+			  file});
+	return file;
+}
+
+void
+ArchiveCache::Clear()
+{
+	const ScopeLock protect(mutex);
+
+	while (!items.empty())
+		Erase(items.begin());
+}
+
+ArchiveFile *
+archive_cache_open(const ArchivePlugin &plugin, Path path, Error &error)
+{
+	return archive_cache.Open(plugin, path, error);
+}
+
+void
+archive_cache_clear()
+{
+	archive_cache.Clear();
+}
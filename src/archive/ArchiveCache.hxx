@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ARCHIVE_CACHE_HXX
+#define MPD_ARCHIVE_CACHE_HXX
+
+class ArchiveFile;
+class Path;
+class Error;
+struct ArchivePlugin;
+
+/**
+ * Open an archive file, or obtain a new reference to a handle which
+ * has been opened recently (as long as the file has not been
+ * modified since).  This avoids parsing the archive's directory again
+ * for each file which is opened from it, e.g. while the database
+ * update scans its songs or while an album is being played.
+ *
+ * @return an #ArchiveFile which must be released with
+ * ArchiveFile::Close(), or nullptr on error
+ */
+ArchiveFile *
+archive_cache_open(const ArchivePlugin &plugin, Path path, Error &error);
+
+/**
+ * Release all cached handles.  Called before the archive plugins are
+ * deinitialized.
+ */
+void
+archive_cache_clear();
+
+#endif
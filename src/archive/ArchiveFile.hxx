@@ -41,15 +41,29 @@ protected:
 	~ArchiveFile() {}
 
 public:
+	/**
+	 * Release a reference.  The object is freed after the last
+	 * reference (including the ones held by streams opened with
+	 * OpenStream()) has been released.
+	 */
 	virtual void Close() = 0;
 
 	/**
-	 * Visit all entries inside this archive.
+	 * Obtain another reference, which must be released with
+	 * Close().
+	 */
+	virtual void Ref() = 0;
+
+	/**
+	 * Visit all entries inside this archive.  The visitor may
+	 * call OpenStream() on this object.
 	 */
 	virtual void Visit(ArchiveVisitor &visitor) = 0;
 
 	/**
-	 * Opens an InputStream of a file within the archive.
+	 * Opens an InputStream of a file within the archive.  This
+	 * method and the returned stream may be used by several
+	 * threads at the same time.
 	 *
 	 * @param path the path within the archive
 	 */
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "ArchiveList.hxx"
 #include "ArchivePlugin.hxx"
+#include "ArchiveCache.hxx"
 #include "util/StringUtil.hxx"
 #include "plugins/Bzip2ArchivePlugin.hxx"
 #include "plugins/Iso9660ArchivePlugin.hxx"
@@ -83,6 +84,8 @@ void archive_plugin_init_all(void)
 
 void archive_plugin_deinit_all(void)
 {
+	archive_cache_clear();
+
 	archive_plugins_for_each_enabled(plugin)
 		if (plugin->finish != nullptr)
 			plugin->finish();
@@ -29,14 +29,24 @@
 #include "input/InputStream.hxx"
 #include "input/InputPlugin.hxx"
 #include "input/LocalOpen.hxx"
+#include "lib/bzip2/Block.hxx"
+#include "thread/Mutex.hxx"
 #include "util/RefCount.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "fs/Traits.hxx"
 #include "fs/Path.hxx"
+#include "fs/FileInfo.hxx"
 
 #include <bzlib.h>
 
+#include <algorithm>
+#include <memory>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <assert.h>
 #include <stddef.h>
 
 #ifdef HAVE_OLDER_BZIP2
@@ -44,6 +54,260 @@
 #define BZ2_bzDecompress bzDecompress
 #endif
 
+static constexpr Domain bz2_domain("bz2");
+
+/**
+ * The positions of the compressed blocks in a bzip2 file and (after
+ * they have been decoded once) their uncompressed sizes.  This allows
+ * seeking by decoding only the block which contains the new
+ * position.
+ *
+ * The index is built incrementally while the file is being read, and
+ * it is shared by all streams of the file.  All methods (and all I/O
+ * on the underlying file) require locking #mutex.
+ */
+class Bzip2Index {
+public:
+	struct Block {
+		/**
+		 * Bit offset of the block marker in the file.
+		 */
+		uint64_t start;
+
+		/**
+		 * Bit offset of the following marker.  0 if not yet
+		 * known.
+		 */
+		uint64_t end;
+
+		/**
+		 * The uncompressed offset of this block.  Only valid
+		 * if all previous blocks have been sized.
+		 */
+		uint64_t offset;
+
+		/**
+		 * The uncompressed size.  Only valid if this is one
+		 * of the first #n_sized blocks.
+		 */
+		uint64_t size;
+	};
+
+	Mutex mutex;
+
+private:
+	std::vector<Block> blocks;
+
+	Bzip2BlockScanner scanner;
+
+	/**
+	 * The number of leading blocks whose uncompressed size is
+	 * known.
+	 */
+	size_t n_sized;
+
+	/**
+	 * The block size level from the stream header, used for
+	 * decoding single blocks.
+	 */
+	char level;
+
+	/**
+	 * Has the scanner reached the end of the file?
+	 */
+	bool scanned;
+
+public:
+	Bzip2Index():n_sized(0), level('9'), scanned(false) {}
+
+	char GetLevel() const {
+		return level;
+	}
+
+	/**
+	 * Make sure the boundaries of the specified block are known.
+	 *
+	 * @return false if there is no such block or on I/O error
+	 * (#error is set then)
+	 */
+	bool FindBlock(size_t i, InputStream &is, Error &error);
+
+	const Block &GetBlock(size_t i) const {
+		assert(i < blocks.size());
+		assert(blocks[i].end > 0);
+
+		return blocks[i];
+	}
+
+	size_t GetSizedCount() const {
+		return n_sized;
+	}
+
+	uint64_t GetSizedEnd() const {
+		return n_sized > 0
+			? blocks[n_sized - 1].offset + blocks[n_sized - 1].size
+			: 0;
+	}
+
+	/**
+	 * Has the whole file been decoded once, i.e. is the total
+	 * size known?
+	 */
+	bool IsComplete() const {
+		return scanned && n_sized == CountCompleteBlocks();
+	}
+
+	/**
+	 * Remember the uncompressed size of a block after it has
+	 * been decoded.
+	 */
+	void SetSize(size_t i, uint64_t size) {
+		if (i != n_sized)
+			/* already known, or a previous block is not */
+			return;
+
+		blocks[i].offset = GetSizedEnd();
+		blocks[i].size = size;
+		++n_sized;
+	}
+
+	/**
+	 * Find the sized block which contains the specified
+	 * uncompressed offset.  Returns GetSizedCount() if it is
+	 * beyond the sized blocks.
+	 */
+	gcc_pure
+	size_t FindOffset(uint64_t offset) const {
+		auto end = blocks.begin() + n_sized;
+		auto i = std::upper_bound(blocks.begin(), end, offset,
+					  [](uint64_t o, const Block &b){
+						  return o < b.offset + b.size;
+					  });
+		return i - blocks.begin();
+	}
+
+private:
+	size_t CountCompleteBlocks() const {
+		return !blocks.empty() && blocks.back().end == 0
+			? blocks.size() - 1
+			: blocks.size();
+	}
+
+	bool Scan(InputStream &is, Error &error);
+};
+
+bool
+Bzip2Index::Scan(InputStream &is, Error &error)
+{
+	assert(!scanned);
+
+	uint8_t buffer[65536];
+
+	const uint64_t position = scanner.GetPosition() / 8;
+	if (!is.LockSeek(position, error))
+		return false;
+
+	const size_t nbytes = is.LockRead(buffer, sizeof(buffer), error);
+	if (nbytes == 0) {
+		if (error.IsDefined())
+			return false;
+
+		/* a block without a following marker is truncated;
+		   ignore it */
+		if (!blocks.empty() && blocks.back().end == 0)
+			blocks.pop_back();
+
+		scanned = true;
+		return true;
+	}
+
+	if (position == 0 && nbytes >= 4 &&
+	    buffer[3] >= '1' && buffer[3] <= '9')
+		level = buffer[3];
+
+	scanner.Feed(buffer, nbytes, [this](uint64_t bit, bool end){
+			if (!blocks.empty() && blocks.back().end == 0)
+				blocks.back().end = bit;
+
+			if (!end)
+				blocks.push_back({bit, 0, 0, 0});
+		});
+
+	return true;
+}
+
+bool
+Bzip2Index::FindBlock(size_t i, InputStream &is, Error &error)
+{
+	while (i >= CountCompleteBlocks()) {
+		if (scanned)
+			return false;
+
+		if (!Scan(is, error))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Keeps the #Bzip2Index of recently opened files, so seeking is fast
+ * when a file is opened again (e.g. by the decoder after the update
+ * has scanned it).
+ */
+class Bzip2IndexCache {
+	static constexpr size_t MAX_ITEMS = 32;
+
+	struct Item {
+		std::string path;
+		time_t mtime;
+		uint64_t size;
+
+		std::shared_ptr<Bzip2Index> index;
+	};
+
+	Mutex mutex;
+
+	/**
+	 * Most recently used first.
+	 */
+	std::list<Item> items;
+
+public:
+	std::shared_ptr<Bzip2Index> Get(Path path) {
+		FileInfo fi;
+		if (!GetFileInfo(path, fi))
+			return std::make_shared<Bzip2Index>();
+
+		const ScopeLock protect(mutex);
+
+		for (auto i = items.begin(); i != items.end(); ++i) {
+			if (i->path != path.c_str())
+				continue;
+
+			if (i->mtime == fi.GetModificationTime() &&
+			    i->size == fi.GetSize()) {
+				items.splice(items.begin(), items, i);
+				return i->index;
+			}
+
+			/* the file has been modified */
+			items.erase(i);
+			break;
+		}
+
+		if (items.size() >= MAX_ITEMS)
+			items.pop_back();
+
+		auto index = std::make_shared<Bzip2Index>();
+		items.push_front({path.c_str(), fi.GetModificationTime(),
+				  fi.GetSize(), index});
+		return index;
+	}
+};
+
+static Bzip2IndexCache bz2_index_cache;
+
 class Bzip2ArchiveFile final : public ArchiveFile {
 public:
 	RefCount ref;
@@ -51,10 +315,13 @@ public:
 	std::string name;
 	InputStream *const istream;
 
-	Bzip2ArchiveFile(Path path, InputStream *_is)
+	const std::shared_ptr<Bzip2Index> index;
+
+	Bzip2ArchiveFile(Path path, InputStream *_is,
+			 std::shared_ptr<Bzip2Index> &&_index)
 		:ArchiveFile(bz2_archive_plugin),
 		 name(path.GetBase().c_str()),
-		 istream(_is) {
+		 istream(_is), index(std::move(_index)) {
 		// remove .bz2 suffix
 		const size_t len = name.length();
 		if (len > 4)
@@ -65,7 +332,7 @@ public:
 		delete istream;
 	}
 
-	void Ref() {
+	virtual void Ref() override {
 		ref.Increment();
 	}
 
@@ -89,50 +356,70 @@ public:
 					Error &error) override;
 };
 
+/**
+ * Decodes the file one block at a time: each block is converted to a
+ * stand-alone bzip2 stream (see Bzip2MakeBlockStream()), so decoding
+ * can begin at any block after a seek.
+ */
 struct Bzip2InputStream final : public InputStream {
 	Bzip2ArchiveFile *archive;
 
+	Bzip2Index &index;
+
 	bool eof;
 
+	/**
+	 * Is #bzstream initialized?
+	 */
+	bool active;
+
+	/**
+	 * The block which is being decoded (if #active) or which
+	 * will be decoded next.
+	 */
+	size_t block;
+
+	/**
+	 * The number of bytes decoded from the current block.
+	 */
+	uint64_t block_position;
+
 	bz_stream bzstream;
 
-	char buffer[5000];
+	/**
+	 * The stand-alone stream of the current block.
+	 */
+	std::vector<uint8_t> block_stream;
 
 	Bzip2InputStream(Bzip2ArchiveFile &context, const char *uri,
 			 Mutex &mutex, Cond &cond);
 	~Bzip2InputStream();
 
-	bool Open(Error &error);
+	void Open();
 
 	/* virtual methods from InputStream */
 	bool IsEOF() override;
 	size_t Read(void *ptr, size_t size, Error &error) override;
-};
+	bool Seek(offset_type offset, Error &error) override;
 
-static constexpr Domain bz2_domain("bz2");
+private:
+	void EndBlock();
 
-/* single archive handling allocation helpers */
+	/**
+	 * Begin decoding #block.
+	 *
+	 * @return false at the end of the file or on error (#error is
+	 * set then)
+	 */
+	bool StartBlock(Error &error);
 
-inline bool
-Bzip2InputStream::Open(Error &error)
-{
-	bzstream.bzalloc = nullptr;
-	bzstream.bzfree = nullptr;
-	bzstream.opaque = nullptr;
-
-	bzstream.next_in = (char *)buffer;
-	bzstream.avail_in = 0;
+	/**
+	 * Decode and discard the specified number of bytes.
+	 */
+	bool Skip(uint64_t nbytes, Error &error);
 
-	int ret = BZ2_bzDecompressInit(&bzstream, 0, 0);
-	if (ret != BZ_OK) {
-		error.Set(bz2_domain, ret,
-			  "BZ2_bzDecompressInit() has failed");
-		return false;
-	}
-
-	SetReady();
-	return true;
-}
+	void UpdateSize();
+};
 
 /* archive open && listing routine */
 
@@ -145,7 +432,8 @@ bz2_open(Path pathname, Error &error)
 	if (is == nullptr)
 		return nullptr;
 
-	return new Bzip2ArchiveFile(pathname, is);
+	return new Bzip2ArchiveFile(pathname, is,
+				    bz2_index_cache.Get(pathname));
 }
 
 /* single archive handling */
@@ -154,86 +442,208 @@ Bzip2InputStream::Bzip2InputStream(Bzip2ArchiveFile &_context,
 				   const char *_uri,
 				   Mutex &_mutex, Cond &_cond)
 	:InputStream(_uri, _mutex, _cond),
-	 archive(&_context), eof(false)
+	 archive(&_context), index(*_context.index),
+	 eof(false), active(false), block(0), block_position(0)
 {
 	archive->Ref();
 }
 
 Bzip2InputStream::~Bzip2InputStream()
 {
-	BZ2_bzDecompressEnd(&bzstream);
+	EndBlock();
 	archive->Unref();
 }
 
+inline void
+Bzip2InputStream::Open()
+{
+	seekable = true;
+	UpdateSize();
+	SetReady();
+}
+
 InputStream *
 Bzip2ArchiveFile::OpenStream(const char *path,
 			     Mutex &mutex, Cond &cond,
-			     Error &error)
+			     gcc_unused Error &error)
 {
 	Bzip2InputStream *bis = new Bzip2InputStream(*this, path, mutex, cond);
-	if (!bis->Open(error)) {
-		delete bis;
-		return nullptr;
-	}
-
+	bis->Open();
 	return bis;
 }
 
-static bool
-bz2_fillbuffer(Bzip2InputStream *bis, Error &error)
+void
+Bzip2InputStream::UpdateSize()
 {
-	size_t count;
-	bz_stream *bzstream;
+	const ScopeLock protect(index.mutex);
+	if (index.IsComplete())
+		size = index.GetSizedEnd();
+}
 
-	bzstream = &bis->bzstream;
+void
+Bzip2InputStream::EndBlock()
+{
+	if (!active)
+		return;
 
-	if (bzstream->avail_in > 0)
-		return true;
+	BZ2_bzDecompressEnd(&bzstream);
+	active = false;
+}
+
+bool
+Bzip2InputStream::StartBlock(Error &error)
+{
+	assert(!active);
+
+	InputStream &is = *archive->istream;
+
+	{
+		const ScopeLock protect(index.mutex);
+
+		if (!index.FindBlock(block, is, error))
+			return false;
+
+		const auto &b = index.GetBlock(block);
+		const uint64_t n_bits = b.end - b.start;
+		const size_t n_bytes = (b.start % 8 + n_bits + 7) / 8;
+
+		std::unique_ptr<uint8_t[]> src(new uint8_t[n_bytes]);
+		if (!is.LockSeek(b.start / 8, error))
+			return false;
 
-	count = bis->archive->istream->Read(bis->buffer, sizeof(bis->buffer),
-					    error);
-	if (count == 0)
+		for (size_t fill = 0; fill < n_bytes;) {
+			size_t nbytes = is.LockRead(src.get() + fill,
+						    n_bytes - fill, error);
+			if (nbytes == 0) {
+				if (!error.IsDefined())
+					error.Set(bz2_domain,
+						  "Unexpected end of file");
+				return false;
+			}
+
+			fill += nbytes;
+		}
+
+		block_stream.resize(Bzip2BlockStreamSize(n_bits));
+		Bzip2MakeBlockStream(block_stream.data(), src.get(),
+				     b.start % 8, n_bits, index.GetLevel());
+	}
+
+	bzstream.bzalloc = nullptr;
+	bzstream.bzfree = nullptr;
+	bzstream.opaque = nullptr;
+
+	bzstream.next_in = (char *)block_stream.data();
+	bzstream.avail_in = block_stream.size();
+
+	int ret = BZ2_bzDecompressInit(&bzstream, 0, 0);
+	if (ret != BZ_OK) {
+		error.Set(bz2_domain, ret,
+			  "BZ2_bzDecompressInit() has failed");
 		return false;
+	}
 
-	bzstream->next_in = bis->buffer;
-	bzstream->avail_in = count;
+	active = true;
+	block_position = 0;
 	return true;
 }
 
 size_t
 Bzip2InputStream::Read(void *ptr, size_t length, Error &error)
 {
-	int bz_result;
-	size_t nbytes = 0;
-
 	if (eof)
 		return 0;
 
-	bzstream.next_out = (char *)ptr;
-	bzstream.avail_out = length;
+	while (true) {
+		if (!active && !StartBlock(error)) {
+			if (!error.IsDefined()) {
+				eof = true;
+				UpdateSize();
+			}
 
-	do {
-		if (!bz2_fillbuffer(this, error))
 			return 0;
+		}
 
-		bz_result = BZ2_bzDecompress(&bzstream);
+		bzstream.next_out = (char *)ptr;
+		bzstream.avail_out = length;
 
-		if (bz_result == BZ_STREAM_END) {
-			eof = true;
-			break;
-		}
+		int bz_result = BZ2_bzDecompress(&bzstream);
+		const size_t nbytes = length - bzstream.avail_out;
+		block_position += nbytes;
 
-		if (bz_result != BZ_OK) {
+		if (bz_result == BZ_STREAM_END) {
+			{
+				const ScopeLock protect(index.mutex);
+				index.SetSize(block, block_position);
+			}
+
+			EndBlock();
+			++block;
+		} else if (bz_result != BZ_OK) {
 			error.Set(bz2_domain, bz_result,
 				  "BZ2_bzDecompress() has failed");
 			return 0;
+		} else if (nbytes == 0 && bzstream.avail_in == 0) {
+			error.Set(bz2_domain, "Truncated bzip2 block");
+			return 0;
+		}
+
+		if (nbytes > 0) {
+			offset += nbytes;
+			return nbytes;
+		}
+	}
+}
+
+bool
+Bzip2InputStream::Skip(uint64_t nbytes, Error &error)
+{
+	char buffer[16384];
+
+	while (nbytes > 0) {
+		size_t n = Read(buffer, std::min<uint64_t>(nbytes,
+							   sizeof(buffer)),
+				error);
+		if (n == 0) {
+			if (!error.IsDefined())
+				error.Set(bz2_domain, "Seek beyond end of file");
+			return false;
 		}
-	} while (bzstream.avail_out == length);
 
-	nbytes = length - bzstream.avail_out;
-	offset += nbytes;
+		nbytes -= n;
+	}
+
+	return true;
+}
+
+bool
+Bzip2InputStream::Seek(offset_type new_offset, Error &error)
+{
+	size_t target;
+	uint64_t target_offset;
+
+	{
+		const ScopeLock protect(index.mutex);
+
+		/* if the new offset is beyond the blocks whose size
+		   is known, this finds the first unknown one */
+		target = index.FindOffset(new_offset);
+		target_offset = target < index.GetSizedCount()
+			? index.GetBlock(target).offset
+			: index.GetSizedEnd();
+	}
+
+	if (new_offset < offset || target > block) {
+		/* restart decoding at the block which contains the
+		   new offset (or the first one which has not been
+		   decoded yet) */
+		EndBlock();
+		block = target;
+		offset = target_offset;
+		eof = false;
+	}
 
-	return nbytes;
+	return Skip(new_offset - offset, error);
 }
 
 bool
@@ -256,4 +666,3 @@ const ArchivePlugin bz2_archive_plugin = {
 	bz2_open,
 	bz2_extensions,
 };
-
@@ -29,6 +29,7 @@
 #include "input/InputStream.hxx"
 #include "input/InputPlugin.hxx"
 #include "fs/Path.hxx"
+#include "thread/Mutex.hxx"
 #include "util/RefCount.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
@@ -45,6 +46,12 @@ class Iso9660ArchiveFile final : public ArchiveFile {
 
 	iso9660_t *iso;
 
+	/**
+	 * Protects #iso.  The handle may be shared by several
+	 * threads (see archive_cache_open()).
+	 */
+	mutable Mutex mutex;
+
 public:
 	Iso9660ArchiveFile(iso9660_t *_iso)
 		:ArchiveFile(iso9660_archive_plugin), iso(_iso) {}
@@ -53,7 +60,7 @@ public:
 		iso9660_close(iso);
 	}
 
-	void Ref() {
+	virtual void Ref() override {
 		ref.Increment();
 	}
 
@@ -63,6 +70,7 @@ public:
 	}
 
 	long SeekRead(void *ptr, lsn_t start, long int i_size) const {
+		const ScopeLock protect(mutex);
 		return iso9660_iso_seek_read(iso, ptr, start, i_size);
 	}
 
@@ -91,7 +99,11 @@ Iso9660ArchiveFile::Visit(const char *psz_path, ArchiveVisitor &visitor)
 	iso9660_stat_t *statbuf;
 	char pathname[4096];
 
+	/* the lock is not held while visiting, because the visitor
+	   may open streams */
+	mutex.lock();
 	entlist = iso9660_ifs_readdir (iso, psz_path);
+	mutex.unlock();
 	if (!entlist) {
 		return;
 	}
@@ -170,7 +182,9 @@ Iso9660ArchiveFile::OpenStream(const char *pathname,
 			       Mutex &mutex, Cond &cond,
 			       Error &error)
 {
+	mutex.lock();
 	auto statbuf = iso9660_ifs_stat_translate(iso, pathname);
+	mutex.unlock();
 	if (statbuf == nullptr) {
 		error.Format(iso9660_domain,
 			     "not found in the ISO file: %s", pathname);
@@ -29,18 +29,29 @@
 #include "input/InputStream.hxx"
 #include "input/InputPlugin.hxx"
 #include "fs/Path.hxx"
+#include "thread/Mutex.hxx"
 #include "util/RefCount.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 
 #include <zzip/zzip.h>
 
+#include <string>
+#include <vector>
+
 class ZzipArchiveFile final : public ArchiveFile {
 public:
 	RefCount ref;
 
 	ZZIP_DIR *const dir;
 
+	/**
+	 * Protects #dir.  The handle may be shared by several
+	 * threads (see archive_cache_open()), and zziplib switches
+	 * the file position of #dir between the open entries.
+	 */
+	Mutex mutex;
+
 	ZzipArchiveFile(ZZIP_DIR *_dir)
 		:ArchiveFile(zzip_archive_plugin), dir(_dir) {}
 
@@ -57,6 +68,10 @@ public:
 		Unref();
 	}
 
+	virtual void Ref() override {
+		ref.Increment();
+	}
+
 	virtual void Visit(ArchiveVisitor &visitor) override;
 
 	virtual InputStream *OpenStream(const char *path,
@@ -84,13 +99,24 @@ zzip_archive_open(Path pathname, Error &error)
 inline void
 ZzipArchiveFile::Visit(ArchiveVisitor &visitor)
 {
-	zzip_rewinddir(dir);
+	/* copy the names first, because the visitor may open
+	   streams */
+	std::vector<std::string> names;
+
+	{
+		const ScopeLock protect(mutex);
+
+		zzip_rewinddir(dir);
 
-	ZZIP_DIRENT dirent;
-	while (zzip_dir_read(dir, &dirent))
-		//add only files
-		if (dirent.st_size > 0)
-			visitor.VisitArchiveEntry(dirent.d_name);
+		ZZIP_DIRENT dirent;
+		while (zzip_dir_read(dir, &dirent))
+			//add only files
+			if (dirent.st_size > 0)
+				names.emplace_back(dirent.d_name);
+	}
+
+	for (const auto &name : names)
+		visitor.VisitArchiveEntry(name.c_str());
 }
 
 /* single archive handling */
@@ -114,11 +140,15 @@ struct ZzipInputStream final : public InputStream {
 
 		SetReady();
 
-		archive->ref.Increment();
+		archive->Ref();
 	}
 
 	~ZzipInputStream() {
-		zzip_file_close(file);
+		{
+			const ScopeLock protect(archive->mutex);
+			zzip_file_close(file);
+		}
+
 		archive->Unref();
 	}
 
@@ -133,6 +163,8 @@ ZzipArchiveFile::OpenStream(const char *pathname,
 			    Mutex &mutex, Cond &cond,
 			    Error &error)
 {
+	const ScopeLock protect(mutex);
+
 	ZZIP_FILE *_file = zzip_file_open(dir, pathname, 0);
 	if (_file == nullptr) {
 		error.Format(zzip_domain, "not found in the ZIP file: %s",
@@ -148,6 +180,8 @@ ZzipArchiveFile::OpenStream(const char *pathname,
 size_t
 ZzipInputStream::Read(void *ptr, size_t read_size, Error &error)
 {
+	const ScopeLock protect(archive->mutex);
+
 	int ret = zzip_file_read(file, ptr, read_size);
 	if (ret < 0) {
 		error.Set(zzip_domain, "zzip_file_read() has failed");
@@ -161,12 +195,14 @@ ZzipInputStream::Read(void *ptr, size_t read_size, Error &error)
 bool
 ZzipInputStream::IsEOF()
 {
-	return offset_type(zzip_tell(file)) == size;
+	return offset == size;
 }
 
 bool
 ZzipInputStream::Seek(offset_type new_offset, Error &error)
 {
+	const ScopeLock protect(archive->mutex);
+
 	zzip_off_t ofs = zzip_seek(file, new_offset, SEEK_SET);
 	if (ofs < 0) {
 		error.Set(zzip_domain, "zzip_seek() has failed");
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "BackgroundResponseStream.hxx"
+#include "Client.hxx"
+#include "protocol/Result.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+
+BackgroundResponseStream::BackgroundResponseStream(Client &_client,
+						   const char *_command)
+	:DeferredMonitor(*_client.partition.instance.event_loop),
+	 client(_client), command(_command), done(false) {}
+
+BackgroundResponseStream::~BackgroundResponseStream()
+{
+	if (thread.IsDefined())
+		thread.Join();
+}
+
+bool
+BackgroundResponseStream::Start(Error &error)
+{
+	return thread.Start(ThreadFunc, this, error);
+}
+
+void
+BackgroundResponseStream::ThreadFunc(void *ctx)
+{
+	BackgroundResponseStream &stream = *(BackgroundResponseStream *)ctx;
+
+	stream.Run();
+
+	stream.done.store(true, std::memory_order_release);
+	stream.DeferredMonitor::Schedule();
+}
+
+CommandResult
+BackgroundResponseStream::Continue(Client &_client)
+{
+	if (!done.load(std::memory_order_acquire)) {
+		OnProgress(_client);
+
+		/* RunDeferred() will resume */
+		return CommandResult::DEFERRED;
+	}
+
+	if (thread.IsDefined())
+		thread.Join();
+
+	/* we are called after command_process() has returned */
+	current_command = command;
+	command_list_num = 0;
+
+	return Finish(_client);
+}
+
+void
+BackgroundResponseStream::RunDeferred()
+{
+	/* this may delete this object */
+	client.ContinueResponse();
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_BACKGROUND_RESPONSE_STREAM_HXX
+#define MPD_BACKGROUND_RESPONSE_STREAM_HXX
+
+#include "check.h"
+#include "ResponseStream.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "thread/Thread.hxx"
+#include "Compiler.h"
+
+#include <atomic>
+
+class Client;
+class Error;
+
+/**
+ * A #ResponseStream whose data is prepared by a blocking operation
+ * (e.g. reading a file) in a separate thread, so the event loop can
+ * serve other clients meanwhile.  When the operation has finished,
+ * the client is woken up, and Finish() generates the response in the
+ * main thread.
+ */
+class BackgroundResponseStream : public ResponseStream, DeferredMonitor {
+	Client &client;
+
+	/**
+	 * The command which created this object; it is restored
+	 * for the error messages of Finish().
+	 */
+	const char *const command;
+
+	Thread thread;
+
+	/**
+	 * Set by the thread after Run() has returned.
+	 */
+	std::atomic_bool done;
+
+public:
+	BackgroundResponseStream(Client &_client, const char *_command);
+
+	/**
+	 * Waits for the thread; the operation cannot be canceled.
+	 */
+	virtual ~BackgroundResponseStream();
+
+	/**
+	 * Start the thread.  On success, the caller installs this
+	 * object with Client::SetResponseStream() and returns
+	 * CommandResult::DEFERRED.
+	 */
+	bool Start(Error &error);
+
+	/* virtual methods from class ResponseStream */
+	CommandResult Continue(Client &_client) final;
+
+protected:
+	/**
+	 * The blocking operation.  It runs in the thread and must not
+	 * access the #Client.
+	 */
+	virtual void Run() = 0;
+
+	/**
+	 * Wake up the main thread while Run() is still in progress;
+	 * it will call OnProgress().  May be called only from
+	 * Run().
+	 */
+	void Progress() {
+		DeferredMonitor::Schedule();
+	}
+
+	/**
+	 * Called in the main thread after Progress() while the
+	 * thread is still running, e.g. to consume partial results.
+	 * It may be called more than once per Progress() call.
+	 */
+	virtual void OnProgress(gcc_unused Client &_client) {}
+
+	/**
+	 * Generate (the next portion of) the response.  See
+	 * ResponseStream::Continue().
+	 */
+	virtual CommandResult Finish(Client &_client) = 0;
+
+private:
+	static void ThreadFunc(void *ctx);
+
+	/* virtual methods from class DeferredMonitor */
+	void RunDeferred() override;
+};
+
+#endif
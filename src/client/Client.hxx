@@ -22,17 +22,20 @@
 
 #include "check.h"
 #include "ClientMessage.hxx"
+#include "ResponseStream.hxx"
 #include "command/CommandListBuilder.hxx"
 #include "event/FullyBufferedSocket.hxx"
-#include "event/TimeoutMonitor.hxx"
+#include "Idle.hxx"
 #include "Compiler.h"
 
 #include <boost/intrusive/list.hpp>
 
 #include <set>
 #include <string>
-#include <list>
+#include <deque>
+#include <memory>
 
+#include <assert.h>
 #include <stddef.h>
 #include <stdarg.h>
 
@@ -44,7 +47,7 @@ class Database;
 class Storage;
 
 class Client final
-	: FullyBufferedSocket, TimeoutMonitor,
+	: FullyBufferedSocket,
 	  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
 public:
 	Partition &partition;
@@ -66,6 +69,11 @@ public:
 
 	unsigned int num;	/* client number */
 
+	/**
+	 * The address of the peer, for log messages.
+	 */
+	const std::string remote;
+
 	/** is this client waiting for an "idle" response? */
 	bool idle_waiting;
 
@@ -76,6 +84,44 @@ public:
 	/** idle flags that the client wants to receive */
 	unsigned idle_subscriptions;
 
+	/**
+	 * The ClientList::GetIdleSerial() value when the global idle
+	 * flags were last merged into #idle_flags.
+	 */
+	unsigned long idle_serial;
+
+	/**
+	 * While #idle_waiting, the position of this client in each
+	 * of ClientList's per-flag waiter lists.
+	 */
+	unsigned idle_waiter_index[IDLE_NUM];
+
+	typedef boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink>> TimeoutHook;
+
+	/**
+	 * Hook for ClientList's timeout list.
+	 */
+	TimeoutHook timeout_hook;
+
+	/**
+	 * When does the timeout expire?  A EventLoop::GetTimeMS()
+	 * value.
+	 */
+	unsigned timeout_due_ms;
+
+	/**
+	 * Hook for ClientList's list of clients which have received
+	 * an "idle" response less than #client_idle_min_interval_ms
+	 * ago.  While linked, new idle events are only collected.
+	 */
+	TimeoutHook idle_hold_hook;
+
+	/**
+	 * When does the "idle" hold expire?  A EventLoop::GetTimeMS()
+	 * value.
+	 */
+	unsigned idle_hold_due_ms;
+
 	/**
 	 * A list of channel names this client is subscribed to.
 	 */
@@ -88,12 +134,53 @@ public:
 	unsigned num_subscriptions;
 
 	/**
-	 * A list of messages this client has received.
+	 * A list of messages this client has received.  The messages
+	 * are shared with the other subscribers of the channel.
+	 */
+	std::deque<ClientMessagePtr> messages;
+
+	/**
+	 * The response currently being generated, if it did not fit
+	 * in the output buffer at once.  See SetResponseStream().
+	 */
+	std::unique_ptr<ResponseStream> response_stream;
+
+	/**
+	 * Send songs as "compact" records instead of "name: value"
+	 * lines?  Enabled with the "compact" command.
+	 */
+	bool compact;
+
+	/**
+	 * The nesting level of client_begin_record() calls.  While
+	 * this is non-zero, fields are collected in #record.
+	 */
+	unsigned record_depth;
+
+	/**
+	 * The compact record being generated.  It is kept here so its
+	 * allocation can be reused by the next record.
 	 */
-	std::list<ClientMessage> messages;
+	std::string record;
+
+	/**
+	 * An output filter which will be installed as soon as the
+	 * response to the current command (list) is complete.  See
+	 * client_process_line().
+	 */
+	std::unique_ptr<SocketOutputFilter> pending_output_filter;
+
+	/**
+	 * Statistics: the number of commands (lines) processed, the
+	 * number of times OnSocketInput() found at least one complete
+	 * line, and the largest number of lines processed at once.
+	 * Logged when the client is closed.
+	 */
+	unsigned long num_commands;
+	unsigned num_wakeups, max_batch;
 
 	Client(EventLoop &loop, Partition &partition,
-	       int fd, int uid, int num);
+	       int fd, int uid, int num, std::string &&remote);
 
 	~Client() {
 		if (FullyBufferedSocket::IsDefined())
@@ -113,6 +200,11 @@ public:
 	void SetExpired();
 
 	using FullyBufferedSocket::Write;
+	using FullyBufferedSocket::PrepareWrite;
+	using FullyBufferedSocket::CommitWrite;
+	using FullyBufferedSocket::SetOutputFilter;
+	using FullyBufferedSocket::HasOutputFilter;
+	using FullyBufferedSocket::GetOutputCount;
 
 	/**
 	 * returns the uid of the client process, or a negative value
@@ -138,6 +230,26 @@ public:
 		permission = _permission;
 	}
 
+	/**
+	 * Continue the current response with the given
+	 * #ResponseStream (allocated with "new") each time the output
+	 * buffer becomes empty.  The command handler then returns
+	 * CommandResult::DEFERRED.
+	 */
+	void SetResponseStream(ResponseStream *stream) {
+		assert(response_stream == nullptr);
+
+		response_stream.reset(stream);
+	}
+
+	/**
+	 * Continue the #ResponseStream now if the output buffer is
+	 * empty (otherwise, OnSocketDrained() will do it).  This is
+	 * called by a #ResponseStream which has been waiting for
+	 * something else.
+	 */
+	void ContinueResponse();
+
 	/**
 	 * Send "idle" response to this client.
 	 */
@@ -145,6 +257,37 @@ public:
 	void IdleAdd(unsigned flags);
 	bool IdleWait(unsigned flags);
 
+	/**
+	 * Leave "idle" mode without a notification ("noidle").
+	 */
+	void IdleCancel();
+
+	gcc_pure
+	bool IsIdleHeld() const {
+		return idle_hold_hook.is_linked();
+	}
+
+	/**
+	 * Called by the #ClientList when the minimum interval after
+	 * the last "idle" response has elapsed.  Sends the events
+	 * collected in the meantime if the client is waiting.
+	 */
+	void OnIdleHoldExpired();
+
+	/**
+	 * Restart the timeout; the client will be closed if it stays
+	 * inactive for #client_timeout seconds.
+	 */
+	void ScheduleTimeout();
+	void CancelTimeout();
+
+	/**
+	 * Called by the #ClientList when the timeout has expired, or
+	 * when this client has been marked as expired.  Closes and
+	 * deletes the client.
+	 */
+	void OnTimeout();
+
 	enum class SubscribeResult {
 		/** success */
 		OK,
@@ -167,7 +310,14 @@ public:
 	SubscribeResult Subscribe(const char *channel);
 	bool Unsubscribe(const char *channel);
 	void UnsubscribeAll();
-	bool PushMessage(const ClientMessage &msg);
+
+	/**
+	 * Append a message to this client's queue.  The caller has
+	 * verified that the client is subscribed to the channel.
+	 *
+	 * @return false if the queue is full
+	 */
+	bool PushMessage(const ClientMessagePtr &msg);
 
 	/**
 	 * Is this client allowed to use the specified local file?
@@ -196,8 +346,8 @@ private:
 	virtual void OnSocketError(Error &&error) override;
 	virtual void OnSocketClosed() override;
 
-	/* virtual methods from class TimeoutMonitor */
-	virtual void OnTimeout() override;
+	/* virtual methods from class FullyBufferedSocket */
+	virtual bool OnSocketDrained() override;
 };
 
 void
@@ -207,11 +357,54 @@ void
 client_new(EventLoop &loop, Partition &partition,
 	   int fd, SocketAddress address, int uid);
 
+/**
+ * Write a block of (binary) data to the client.
+ */
+void
+client_write(Client &client, const void *data, size_t length);
+
 /**
  * Write a C string to the client.
  */
 void client_puts(Client &client, const char *s);
 
+/**
+ * Write a "name: value" line to the client.  This is cheaper than
+ * client_printf(), because it copies the strings without parsing a
+ * format string.
+ */
+void
+client_print_pair(Client &client, const char *name, const char *value);
+
+/**
+ * Write a "name: value" line with an unsigned integer value.
+ */
+void
+client_print_pair(Client &client, const char *name, unsigned value);
+
+/**
+ * Start a song record.  If the client has enabled "compact" mode,
+ * all following fields are collected and sent as one binary record
+ * by client_end_record(); otherwise, this is a no-op.  Calls may be
+ * nested; only the outermost client_end_record() sends the record.
+ */
+void
+client_begin_record(Client &client);
+
+void
+client_end_record(Client &client);
+
+/**
+ * Write a field of a song record, identified by a #CompactKey (or a
+ * #TagType).  Outside of a compact record, this writes a "name:
+ * value" line.
+ */
+void
+client_print_field(Client &client, unsigned key, const char *value);
+
+void
+client_print_field(Client &client, unsigned key, unsigned value);
+
 /**
  * Write a printf-like formatted string to the client.
  */
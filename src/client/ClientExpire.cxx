@@ -19,6 +19,9 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "ClientList.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
 #include "Log.hxx"
 
 void
@@ -27,8 +30,24 @@ Client::SetExpired()
 	if (IsExpired())
 		return;
 
+	if (idle_waiting)
+		IdleCancel();
+
 	FullyBufferedSocket::Close();
-	TimeoutMonitor::Schedule(0);
+	partition.instance.client_list->ScheduleExpire(*this);
+}
+
+void
+Client::ScheduleTimeout()
+{
+	partition.instance.client_list->ScheduleTimeout(*this,
+							client_timeout);
+}
+
+void
+Client::CancelTimeout()
+{
+	partition.instance.client_list->CancelTimeout(*this);
 }
 
 void
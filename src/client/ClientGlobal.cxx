@@ -20,14 +20,71 @@
 #include "config.h"
 #include "ClientInternal.hxx"
 #include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "system/FatalError.hxx"
+#include "Idle.hxx"
+
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
 
 #define CLIENT_TIMEOUT_DEFAULT			(60)
 #define CLIENT_MAX_COMMAND_LIST_DEFAULT		(2048*1024)
 #define CLIENT_MAX_OUTPUT_BUFFER_SIZE_DEFAULT	(8192*1024)
+#define CLIENT_MAX_SUBSCRIPTIONS_DEFAULT	(16)
+#define CLIENT_MAX_MESSAGES_DEFAULT		(64)
 
 int client_timeout;
 size_t client_max_command_list_size;
 size_t client_max_output_buffer_size;
+unsigned client_max_subscriptions;
+unsigned client_max_messages;
+unsigned client_idle_min_interval_ms;
+unsigned client_idle_coalesce_ms[IDLE_NUM];
+
+/**
+ * Parse the "idle_coalesce" setting: a comma separated list of
+ * "NAME:MILLISECONDS" items.
+ */
+static void
+client_parse_idle_coalesce(const char *value)
+{
+	const char *p = value;
+	while (*p != 0) {
+		const char *comma = strchr(p, ',');
+		if (comma == nullptr)
+			comma = p + strlen(p);
+
+		const char *colon = (const char *)memchr(p, ':', comma - p);
+		if (colon == nullptr)
+			FormatFatalError("Malformed idle_coalesce item: %.*s",
+					 int(comma - p), p);
+
+		while (*p == ' ')
+			++p;
+
+		const std::string name(p, colon);
+		const unsigned flag = idle_parse_name(name.c_str());
+		if (flag == 0)
+			FormatFatalError("Unknown idle event in idle_coalesce: %s",
+					 name.c_str());
+
+		char *endptr;
+		const unsigned long ms = strtoul(colon + 1, &endptr, 10);
+		while (*endptr == ' ')
+			++endptr;
+		if (endptr == colon + 1 || endptr != comma)
+			FormatFatalError("Malformed idle_coalesce item: %.*s",
+					 int(comma - p), p);
+
+		for (unsigned i = 0; i < IDLE_NUM; ++i)
+			if (flag == 1u << i)
+				client_idle_coalesce_ms[i] = ms;
+
+		p = *comma == ',' ? comma + 1 : comma;
+	}
+}
 
 void client_manager_init(void)
 {
@@ -42,4 +99,19 @@ void client_manager_init(void)
 		config_get_positive(ConfigOption::MAX_OUTPUT_BUFFER_SIZE,
 				    CLIENT_MAX_OUTPUT_BUFFER_SIZE_DEFAULT / 1024)
 		* 1024;
+
+	client_max_subscriptions =
+		config_get_positive(ConfigOption::MAX_SUBSCRIPTIONS,
+				    CLIENT_MAX_SUBSCRIPTIONS_DEFAULT);
+	client_max_messages =
+		config_get_positive(ConfigOption::MAX_MESSAGES,
+				    CLIENT_MAX_MESSAGES_DEFAULT);
+
+	client_idle_min_interval_ms =
+		config_get_unsigned(ConfigOption::IDLE_MIN_INTERVAL, 0);
+
+	const char *idle_coalesce =
+		config_get_string(ConfigOption::IDLE_COALESCE, nullptr);
+	if (idle_coalesce != nullptr)
+		client_parse_idle_coalesce(idle_coalesce);
 }
@@ -19,7 +19,10 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "ClientList.hxx"
 #include "Idle.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
 
 #include <assert.h>
 
@@ -29,8 +32,12 @@ Client::IdleNotify()
 	assert(idle_waiting);
 	assert(idle_flags != 0);
 
+	ClientList &client_list = *partition.instance.client_list;
+	client_list.RemoveIdleWaiter(*this, idle_subscriptions);
+
 	unsigned flags = idle_flags;
 	idle_flags = 0;
+	idle_serial = client_list.GetIdleSerial();
 	idle_waiting = false;
 
 	const char *const*idle_names = idle_get_names();
@@ -42,7 +49,10 @@ Client::IdleNotify()
 
 	client_puts(*this, "OK\n");
 
-	TimeoutMonitor::ScheduleSeconds(client_timeout);
+	ScheduleTimeout();
+
+	if (client_idle_min_interval_ms > 0)
+		client_list.HoldIdle(*this);
 }
 
 void
@@ -61,15 +71,56 @@ Client::IdleWait(unsigned flags)
 {
 	assert(!idle_waiting);
 
+	if (IsIdleHeld()) {
+		/* the last response was sent too recently; the
+		   ClientList will call OnIdleHoldExpired() */
+		idle_waiting = true;
+		idle_subscriptions = flags;
+		CancelTimeout();
+		return false;
+	}
+
+	/* collect the flags which were added while this client was
+	   not waiting */
+	ClientList &client_list = *partition.instance.client_list;
+	idle_flags |= client_list.GetIdleFlagsSince(idle_serial);
+	idle_serial = client_list.GetIdleSerial();
+
 	idle_waiting = true;
 	idle_subscriptions = flags;
+	client_list.AddIdleWaiter(*this, idle_subscriptions);
 
 	if (idle_flags & idle_subscriptions) {
 		IdleNotify();
 		return true;
 	} else {
 		/* disable timeouts while in "idle" */
-		TimeoutMonitor::Cancel();
+		CancelTimeout();
 		return false;
 	}
 }
+
+void
+Client::IdleCancel()
+{
+	assert(idle_waiting);
+
+	if (!IsIdleHeld())
+		partition.instance.client_list->RemoveIdleWaiter(*this,
+								 idle_subscriptions);
+	idle_waiting = false;
+}
+
+void
+Client::OnIdleHoldExpired()
+{
+	assert(!IsIdleHeld());
+
+	if (!idle_waiting || IsExpired())
+		return;
+
+	/* enter "idle" again, now for real; this sends the events
+	   collected in the meantime */
+	idle_waiting = false;
+	IdleWait(idle_subscriptions);
+}
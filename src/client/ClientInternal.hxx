@@ -24,15 +24,35 @@
 #include "Client.hxx"
 #include "command/CommandResult.hxx"
 
-static constexpr unsigned CLIENT_MAX_SUBSCRIPTIONS = 16;
-static constexpr unsigned CLIENT_MAX_MESSAGES = 64;
-
 extern const class Domain client_domain;
 
 extern int client_timeout;
 extern size_t client_max_command_list_size;
 extern size_t client_max_output_buffer_size;
 
+/**
+ * The maximum number of channels a client may subscribe to.
+ */
+extern unsigned client_max_subscriptions;
+
+/**
+ * The maximum number of unread messages queued for a client;
+ * further messages are dropped for this client.
+ */
+extern unsigned client_max_messages;
+
+/**
+ * The minimum time between two "idle" responses to the same client
+ * [ms]; 0 disables the limit.
+ */
+extern unsigned client_idle_min_interval_ms;
+
+/**
+ * The coalescing window for each idle flag [ms]; 0 means the events
+ * are delivered immediately.
+ */
+extern unsigned client_idle_coalesce_ms[IDLE_NUM];
+
 CommandResult
 client_process_line(Client &client, char *line);
 
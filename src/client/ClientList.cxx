@@ -20,22 +20,53 @@
 #include "config.h"
 #include "ClientList.hxx"
 #include "ClientInternal.hxx"
+#include "event/Loop.hxx"
 
 #include <algorithm>
 
 #include <assert.h>
 
+ClientList::ClientList(EventLoop &_loop, unsigned _max_size)
+	:TimeoutMonitor(_loop), max_size(_max_size), idle_serial(0),
+	 idle_timer(_loop, *this),
+	 idle_window_open(0), idle_deferred(0)
+{
+	std::fill_n(idle_flag_serials, IDLE_NUM, 0);
+}
+
 void
 ClientList::Remove(Client &client)
 {
 	assert(!list.empty());
 
 	list.erase(list.iterator_to(client));
+
+	if (client.idle_waiting && !client.IsIdleHeld())
+		RemoveIdleWaiter(client, client.idle_subscriptions);
+
+	if (client.IsIdleHeld())
+		idle_holds.erase(idle_holds.iterator_to(client));
+
+	for (const auto &channel : client.subscriptions)
+		RemoveSubscriber(client, channel);
+
+	CancelTimeout(client);
 }
 
 void
 ClientList::CloseAll()
 {
+	TimeoutMonitor::Cancel();
+	timeouts.clear();
+
+	idle_timer.Cancel();
+	idle_holds.clear();
+
+	channels.clear();
+
+	for (auto &i : idle_waiters)
+		i.clear();
+
 	list.clear_and_dispose(Client::Disposer());
 }
 
@@ -44,6 +75,263 @@ ClientList::IdleAdd(unsigned flags)
 {
 	assert(flags != 0);
 
-	for (auto &client : list)
-		client.IdleAdd(flags);
+	bool schedule = false;
+	const unsigned now_ms = GetEventLoop().GetTimeMS();
+
+	for (unsigned i = 0; i < IDLE_NUM; ++i) {
+		const unsigned bit = 1u << i;
+		if ((flags & bit) == 0 || client_idle_coalesce_ms[i] == 0)
+			continue;
+
+		if (idle_window_open & bit) {
+			/* a notification was sent recently: collect
+			   this one until the window closes */
+			idle_deferred |= bit;
+			flags &= ~bit;
+		} else {
+			/* deliver now, and open a new window */
+			idle_window_open |= bit;
+			idle_window_due_ms[i] = now_ms + client_idle_coalesce_ms[i];
+			schedule = true;
+		}
+	}
+
+	if (schedule)
+		ScheduleIdleTimer();
+
+	if (flags != 0)
+		NotifyIdle(flags);
+}
+
+void
+ClientList::NotifyIdle(unsigned flags)
+{
+	assert(flags != 0);
+
+	++idle_serial;
+
+	for (unsigned i = 0; i < IDLE_NUM; ++i) {
+		if ((flags & (1u << i)) == 0)
+			continue;
+
+		idle_flag_serials[i] = idle_serial;
+
+		/* Client::IdleNotify() removes the client from all
+		   lists, including this one */
+		auto &waiters = idle_waiters[i];
+		while (!waiters.empty())
+			waiters.back()->IdleAdd(flags);
+	}
+}
+
+unsigned
+ClientList::GetIdleFlagsSince(unsigned long serial) const
+{
+	unsigned flags = 0;
+	for (unsigned i = 0; i < IDLE_NUM; ++i)
+		if (idle_flag_serials[i] > serial)
+			flags |= 1u << i;
+
+	return flags;
+}
+
+void
+ClientList::AddIdleWaiter(Client &client, unsigned flags)
+{
+	for (unsigned i = 0; i < IDLE_NUM; ++i) {
+		if ((flags & (1u << i)) == 0)
+			continue;
+
+		auto &waiters = idle_waiters[i];
+		client.idle_waiter_index[i] = waiters.size();
+		waiters.push_back(&client);
+	}
+}
+
+void
+ClientList::RemoveIdleWaiter(Client &client, unsigned flags)
+{
+	for (unsigned i = 0; i < IDLE_NUM; ++i) {
+		if ((flags & (1u << i)) == 0)
+			continue;
+
+		auto &waiters = idle_waiters[i];
+		const unsigned index = client.idle_waiter_index[i];
+		assert(index < waiters.size());
+		assert(waiters[index] == &client);
+
+		/* move the last one into the gap */
+		Client &last = *waiters.back();
+		waiters[index] = &last;
+		last.idle_waiter_index[i] = index;
+		waiters.pop_back();
+	}
+}
+
+void
+ClientList::AddSubscriber(Client &client, const std::string &channel)
+{
+	channels[channel].push_back(&client);
+}
+
+void
+ClientList::RemoveSubscriber(Client &client, const std::string &channel)
+{
+	auto i = channels.find(channel);
+	assert(i != channels.end());
+
+	auto &subscribers = i->second;
+	auto j = std::find(subscribers.begin(), subscribers.end(), &client);
+	assert(j != subscribers.end());
+
+	/* move the last one into the gap */
+	*j = subscribers.back();
+	subscribers.pop_back();
+
+	if (subscribers.empty())
+		channels.erase(i);
+}
+
+const ClientList::SubscriberList *
+ClientList::FindSubscribers(const char *channel) const
+{
+	auto i = channels.find(channel);
+	return i != channels.end()
+		? &i->second
+		: nullptr;
+}
+
+void
+ClientList::HoldIdle(Client &client)
+{
+	assert(!client.IsIdleHeld());
+	assert(client_idle_min_interval_ms > 0);
+
+	client.idle_hold_due_ms = GetEventLoop().GetTimeMS() +
+		client_idle_min_interval_ms;
+	idle_holds.push_back(client);
+
+	if (!idle_timer.IsActive())
+		idle_timer.Schedule(client_idle_min_interval_ms);
+}
+
+void
+ClientList::ScheduleIdleTimer()
+{
+	const unsigned now_ms = GetEventLoop().GetTimeMS();
+	int next = -1;
+
+	for (unsigned i = 0; i < IDLE_NUM; ++i) {
+		if ((idle_window_open & (1u << i)) == 0)
+			continue;
+
+		const int remaining = std::max(int(idle_window_due_ms[i] - now_ms),
+					       0);
+		if (next < 0 || remaining < next)
+			next = remaining;
+	}
+
+	if (!idle_holds.empty()) {
+		const int remaining =
+			std::max(int(idle_holds.front().idle_hold_due_ms - now_ms),
+				 0);
+		if (next < 0 || remaining < next)
+			next = remaining;
+	}
+
+	if (next >= 0)
+		idle_timer.Schedule(next);
+	else
+		idle_timer.Cancel();
+}
+
+void
+ClientList::OnIdleTimer()
+{
+	const unsigned now_ms = GetEventLoop().GetTimeMS();
+
+	/* close the expired coalescing windows; if events were
+	   collected, deliver them and open a new window, so a steady
+	   stream of events results in one notification per window */
+	unsigned deliver = 0;
+	for (unsigned i = 0; i < IDLE_NUM; ++i) {
+		const unsigned bit = 1u << i;
+		if ((idle_window_open & bit) == 0 ||
+		    int(idle_window_due_ms[i] - now_ms) > 0)
+			continue;
+
+		if (idle_deferred & bit) {
+			deliver |= bit;
+			idle_window_due_ms[i] = now_ms + client_idle_coalesce_ms[i];
+		} else
+			idle_window_open &= ~bit;
+	}
+
+	if (deliver != 0) {
+		idle_deferred &= ~deliver;
+		NotifyIdle(deliver);
+	}
+
+	/* release the clients whose hold has expired; those which
+	   receive a response now are appended to the list again */
+	while (!idle_holds.empty()) {
+		Client &client = idle_holds.front();
+		if (int(client.idle_hold_due_ms - now_ms) > 0)
+			break;
+
+		idle_holds.pop_front();
+		client.OnIdleHoldExpired();
+	}
+
+	ScheduleIdleTimer();
+}
+
+void
+ClientList::ScheduleTimeout(Client &client, unsigned seconds)
+{
+	CancelTimeout(client);
+
+	const unsigned ms = seconds * 1000u;
+	client.timeout_due_ms = GetEventLoop().GetTimeMS() + ms;
+	timeouts.push_back(client);
+
+	if (!TimeoutMonitor::IsActive())
+		TimeoutMonitor::ScheduleCoarse(ms);
+}
+
+void
+ClientList::CancelTimeout(Client &client)
+{
+	if (client.timeout_hook.is_linked())
+		timeouts.erase(timeouts.iterator_to(client));
+}
+
+void
+ClientList::ScheduleExpire(Client &client)
+{
+	CancelTimeout(client);
+
+	client.timeout_due_ms = GetEventLoop().GetTimeMS();
+	timeouts.push_front(client);
+
+	TimeoutMonitor::Schedule(0);
+}
+
+void
+ClientList::OnTimeout()
+{
+	const unsigned now_ms = GetEventLoop().GetTimeMS();
+
+	while (!timeouts.empty()) {
+		Client &client = timeouts.front();
+
+		const int remaining = int(client.timeout_due_ms - now_ms);
+		if (remaining > 0) {
+			TimeoutMonitor::ScheduleCoarse(remaining);
+			return;
+		}
+
+		timeouts.pop_front();
+		client.OnTimeout();
+	}
 }
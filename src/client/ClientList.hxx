@@ -21,20 +21,123 @@
 #define MPD_CLIENT_LIST_HXX
 
 #include "Client.hxx"
+#include "Idle.hxx"
+#include "event/TimeoutMonitor.hxx"
+
+#include <map>
+#include <string>
+#include <vector>
 
 class Client;
 
-class ClientList {
+class ClientList final : TimeoutMonitor {
 	typedef boost::intrusive::list<Client,
 				       boost::intrusive::constant_time_size<true>> List;
 
+	/**
+	 * Clients with a pending timeout, ordered by
+	 * Client::timeout_due_ms.  All clients use the same timeout,
+	 * so appending keeps the list sorted, and rescheduling is
+	 * O(1).  Expired clients are inserted at the front, to be
+	 * disposed of as soon as possible.
+	 */
+	typedef boost::intrusive::list<Client,
+				       boost::intrusive::member_hook<Client,
+								     Client::TimeoutHook,
+								     &Client::timeout_hook>,
+				       boost::intrusive::constant_time_size<false>> TimeoutList;
+
+	/**
+	 * Clients on hold after an "idle" response, ordered by
+	 * Client::idle_hold_due_ms.  Like #TimeoutList, this is
+	 * sorted because all clients use the same interval.
+	 */
+	typedef boost::intrusive::list<Client,
+				       boost::intrusive::member_hook<Client,
+								     Client::TimeoutHook,
+								     &Client::idle_hold_hook>,
+				       boost::intrusive::constant_time_size<false>> IdleHoldList;
+
+	/**
+	 * The timer for the coalescing windows and the #idle_holds.
+	 */
+	class IdleTimer final : public TimeoutMonitor {
+		ClientList &list;
+
+	public:
+		IdleTimer(EventLoop &_loop, ClientList &_list)
+			:TimeoutMonitor(_loop), list(_list) {}
+
+	protected:
+		void OnTimeout() override {
+			list.OnIdleTimer();
+		}
+	};
+
 	const unsigned max_size;
 
 	List list;
 
+	TimeoutList timeouts;
+
+	/**
+	 * The clients waiting in "idle", one list per idle flag they
+	 * have subscribed to.  Client::idle_waiter_index points
+	 * into these.
+	 */
+	std::vector<Client *> idle_waiters[IDLE_NUM];
+
+	/**
+	 * Incremented by each IdleAdd() call.  Clients which are not
+	 * waiting are not notified; they compare their
+	 * Client::idle_serial with #idle_flag_serials when they
+	 * enter "idle".
+	 */
+	unsigned long idle_serial;
+
+	/**
+	 * The #idle_serial of the most recent IdleAdd() call for
+	 * each idle flag.
+	 */
+	unsigned long idle_flag_serials[IDLE_NUM];
+
+	IdleHoldList idle_holds;
+
 public:
-	ClientList(unsigned _max_size)
-		:max_size(_max_size) {}
+	typedef std::vector<Client *> SubscriberList;
+	typedef std::map<std::string, SubscriberList> ChannelMap;
+
+private:
+	/**
+	 * The subscribers of each channel; a channel without
+	 * subscribers is removed.  Client::subscriptions is the
+	 * reverse index.
+	 */
+	ChannelMap channels;
+
+	IdleTimer idle_timer;
+
+	/**
+	 * The idle flags whose coalescing window (see
+	 * #client_idle_coalesce_ms) is open: an event was delivered
+	 * less than one window ago.
+	 */
+	unsigned idle_window_open;
+
+	/**
+	 * Events which arrived during an open window; they will be
+	 * delivered when it closes.
+	 */
+	unsigned idle_deferred;
+
+	/**
+	 * When does the coalescing window of each idle flag close?  A
+	 * EventLoop::GetTimeMS() value.
+	 */
+	unsigned idle_window_due_ms[IDLE_NUM];
+
+public:
+	ClientList(EventLoop &_loop, unsigned _max_size);
 	~ClientList() {
 		CloseAll();
 	}
@@ -47,6 +150,10 @@ public:
 		return list.end();
 	}
 
+	unsigned GetSize() const {
+		return list.size();
+	}
+
 	bool IsFull() const {
 		return list.size() >= max_size;
 	}
@@ -59,7 +166,80 @@ public:
 
 	void CloseAll();
 
+	/**
+	 * Notify all clients about the given idle events.  Events
+	 * with a coalescing window are delivered at most once per
+	 * window.
+	 */
 	void IdleAdd(unsigned flags);
+
+	unsigned long GetIdleSerial() const {
+		return idle_serial;
+	}
+
+	/**
+	 * Returns the idle flags which were added after the given
+	 * GetIdleSerial() value.
+	 */
+	gcc_pure
+	unsigned GetIdleFlagsSince(unsigned long serial) const;
+
+	/**
+	 * Register a client which waits in "idle" for the given
+	 * flags.
+	 */
+	void AddIdleWaiter(Client &client, unsigned flags);
+	void RemoveIdleWaiter(Client &client, unsigned flags);
+
+	void AddSubscriber(Client &client, const std::string &channel);
+	void RemoveSubscriber(Client &client, const std::string &channel);
+
+	/**
+	 * Returns all channels which have at least one subscriber,
+	 * sorted by name.
+	 */
+	const ChannelMap &GetChannels() const {
+		return channels;
+	}
+
+	/**
+	 * Returns the subscribers of the given channel, or nullptr
+	 * if there are none.
+	 */
+	gcc_pure
+	const SubscriberList *FindSubscribers(const char *channel) const;
+
+	/**
+	 * Hold back further "idle" responses to the given client for
+	 * #client_idle_min_interval_ms.  Call this after a response
+	 * has been sent.
+	 */
+	void HoldIdle(Client &client);
+
+	/**
+	 * (Re)start the timeout of the given client.
+	 */
+	void ScheduleTimeout(Client &client, unsigned seconds);
+	void CancelTimeout(Client &client);
+
+	/**
+	 * Dispose of the given (expired) client as soon as possible.
+	 */
+	void ScheduleExpire(Client &client);
+
+private:
+	void NotifyIdle(unsigned flags);
+
+	/**
+	 * (Re)schedule #idle_timer for the next window or hold
+	 * expiry.
+	 */
+	void ScheduleIdleTimer();
+
+	void OnIdleTimer();
+
+	/* virtual methods from class TimeoutMonitor */
+	void OnTimeout() override;
 };
 
 #endif
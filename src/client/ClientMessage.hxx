@@ -22,6 +22,7 @@
 
 #include "Compiler.h"
 
+#include <memory>
 #include <string>
 
 #ifdef WIN32
@@ -31,7 +32,8 @@
 #endif
 
 /**
- * A client-to-client message.
+ * A client-to-client message.  It is immutable, and one instance is
+ * shared by all recipients (see #ClientMessagePtr).
  */
 class ClientMessage {
 	std::string channel, message;
@@ -51,6 +53,8 @@ public:
 	}
 };
 
+typedef std::shared_ptr<const ClientMessage> ClientMessagePtr;
+
 gcc_pure
 bool
 client_message_valid_channel_name(const char *name);
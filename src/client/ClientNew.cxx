@@ -43,18 +43,21 @@
 static const char GREETING[] = "OK MPD " PROTOCOL_VERSION "\n";
 
 Client::Client(EventLoop &_loop, Partition &_partition,
-	       int _fd, int _uid, int _num)
-	:FullyBufferedSocket(_fd, _loop, 16384, client_max_output_buffer_size),
-	 TimeoutMonitor(_loop),
+	       int _fd, int _uid, int _num, std::string &&_remote)
+	:FullyBufferedSocket(_fd, _loop, 16384, client_max_output_buffer_size,
+			     true),
 	 partition(_partition),
 	 playlist(partition.playlist), player_control(partition.pc),
 	 permission(getDefaultPermissions()),
 	 uid(_uid),
-	 num(_num),
+	 num(_num), remote(std::move(_remote)),
 	 idle_waiting(false), idle_flags(0),
-	 num_subscriptions(0)
+	 idle_serial(partition.instance.client_list->GetIdleSerial()),
+	 num_subscriptions(0),
+	 compact(false), record_depth(0),
+	 num_commands(0), num_wakeups(0), max_batch(0)
 {
-	TimeoutMonitor::ScheduleSeconds(client_timeout);
+	ScheduleTimeout();
 }
 
 void
@@ -62,7 +65,7 @@ client_new(EventLoop &loop, Partition &partition,
 	   int fd, SocketAddress address, int uid)
 {
 	static unsigned int next_client_num;
-	const auto remote = sockaddr_to_string(address);
+	auto remote = sockaddr_to_string(address);
 
 	assert(fd >= 0);
 
@@ -96,14 +99,14 @@ client_new(EventLoop &loop, Partition &partition,
 	}
 
 	Client *client = new Client(loop, partition, fd, uid,
-				    next_client_num++);
+				    next_client_num++, std::move(remote));
 
 	(void)send(fd, GREETING, sizeof(GREETING) - 1, 0);
 
 	client_list.Add(*client);
 
 	FormatInfo(client_domain, "[%u] opened from %s",
-		   client->num, remote.c_str());
+		   client->num, client->remote.c_str());
 }
 
 void
@@ -111,8 +114,11 @@ Client::Close()
 {
 	partition.instance.client_list->Remove(*this);
 
-	SetExpired();
-
 	FormatInfo(client_domain, "[%u] closed", num);
+	if (num_wakeups > 0)
+		FormatDebug(client_domain,
+			    "[%u] %lu commands in %u wakeups (%.1f per wakeup, max %u)",
+			    num, num_commands, num_wakeups,
+			    double(num_commands) / num_wakeups, max_batch);
 	delete this;
 }
@@ -23,6 +23,10 @@
 #include "command/AllCommands.hxx"
 #include "Log.hxx"
 
+#ifdef ENABLE_SQLITE
+#include "sticker/StickerDatabase.hxx"
+#endif
+
 #include <string.h>
 
 #define CLIENT_LIST_MODE_BEGIN "command_list_begin"
@@ -36,6 +40,11 @@ client_process_command_list(Client &client, bool list_ok,
 	CommandResult ret = CommandResult::OK;
 	unsigned num = 0;
 
+#ifdef ENABLE_SQLITE
+	/* commit all sticker modifications of this list at once */
+	const ScopeStickerBatch sticker_batch;
+#endif
+
 	for (auto &&i : list) {
 		char *cmd = &*i.begin();
 
@@ -59,7 +68,7 @@ client_process_line(Client &client, char *line)
 	if (strcmp(line, "noidle") == 0) {
 		if (client.idle_waiting) {
 			/* send empty idle response and leave idle mode */
-			client.idle_waiting = false;
+			client.IdleCancel();
 			command_success(client);
 		}
 
@@ -137,5 +146,11 @@ client_process_line(Client &client, char *line)
 		}
 	}
 
+	if (client.pending_output_filter != nullptr &&
+	    !client.cmd_list.IsActive())
+		/* the response is complete; filter everything after
+		   it */
+		client.SetOutputFilter(std::move(client.pending_output_filter));
+
 	return ret;
 }
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "protocol/Result.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "event/Loop.hxx"
@@ -29,47 +30,109 @@
 BufferedSocket::InputResult
 Client::OnSocketInput(void *data, size_t length)
 {
+	if (response_stream != nullptr)
+		/* don't read the next command until the current
+		   response is complete; OnSocketDrained() resumes */
+		return InputResult::PAUSE;
+
 	char *p = (char *)data;
+	char *const buffer_end = p + length;
 	char *newline = (char *)memchr(p, '\n', length);
 	if (newline == nullptr)
 		return InputResult::MORE;
 
-	TimeoutMonitor::ScheduleSeconds(client_timeout);
+	ScheduleTimeout();
+
+	++num_wakeups;
+	unsigned batch = 0;
+
+	/* execute all complete lines in the buffer at once; the
+	   responses are collected in the output buffer, which is
+	   flushed only when the event loop becomes idle, i.e. with
+	   one send() for the whole batch */
 
-	BufferedSocket::ConsumeInput(newline + 1 - p);
+	do {
+		BufferedSocket::ConsumeInput(newline + 1 - p);
 
-	/* skip whitespace at the end of the line */
-	char *end = StripRight(p, newline);
+		/* skip whitespace at the end of the line */
+		char *end = StripRight(p, newline);
 
-	/* terminate the string at the end of the line */
-	*end = 0;
+		/* terminate the string at the end of the line */
+		*end = 0;
 
-	CommandResult result = client_process_line(*this, p);
-	switch (result) {
-	case CommandResult::OK:
-	case CommandResult::IDLE:
-	case CommandResult::ERROR:
-		break;
+		CommandResult result = client_process_line(*this, p);
+		++num_commands;
+		if (++batch > max_batch)
+			max_batch = batch;
+
+		switch (result) {
+		case CommandResult::OK:
+		case CommandResult::IDLE:
+		case CommandResult::ERROR:
+		case CommandResult::DEFERRED:
+			break;
+
+		case CommandResult::KILL:
+			Close();
+			partition.instance.event_loop->Break();
+			return InputResult::CLOSED;
 
-	case CommandResult::KILL:
-		Close();
-		partition.instance.event_loop->Break();
-		return InputResult::CLOSED;
+		case CommandResult::FINISH:
+			if (Flush())
+				Close();
+			return InputResult::CLOSED;
 
-	case CommandResult::FINISH:
-		if (Flush())
+		case CommandResult::CLOSE:
 			Close();
-		return InputResult::CLOSED;
+			return InputResult::CLOSED;
+		}
 
-	case CommandResult::CLOSE:
-		Close();
-		return InputResult::CLOSED;
-	}
+		if (IsExpired()) {
+			Close();
+			return InputResult::CLOSED;
+		}
+
+		if (result == CommandResult::DEFERRED)
+			return InputResult::PAUSE;
+
+		p = newline + 1;
+		newline = (char *)memchr(p, '\n', buffer_end - p);
+	} while (newline != nullptr);
+
+	return InputResult::MORE;
+}
 
-	if (IsExpired()) {
-		Close();
-		return InputResult::CLOSED;
-	}
+bool
+Client::OnSocketDrained()
+{
+	if (response_stream == nullptr)
+		return true;
+
+	ScheduleTimeout();
+
+	const CommandResult result = response_stream->Continue(*this);
+	if (result == CommandResult::DEFERRED)
+		return true;
+
+	response_stream.reset();
+
+	if (result == CommandResult::OK)
+		command_success(*this);
+
+	if (IsExpired())
+		/* the #TimeoutMonitor will dispose this object */
+		return false;
+
+	/* process the commands which were received in the
+	   meantime */
+	return ResumeInput();
+}
+
+void
+Client::ContinueResponse()
+{
+	if (response_stream == nullptr || IsExpired() || !IsOutputEmpty())
+		return;
 
-	return InputResult::AGAIN;
+	OnSocketDrained();
 }
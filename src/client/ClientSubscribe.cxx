@@ -19,6 +19,9 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "ClientList.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
 #include "Idle.hxx"
 
 #include <assert.h>
@@ -31,7 +34,7 @@ Client::Subscribe(const char *channel)
 	if (!client_message_valid_channel_name(channel))
 		return Client::SubscribeResult::INVALID;
 
-	if (num_subscriptions >= CLIENT_MAX_SUBSCRIPTIONS)
+	if (num_subscriptions >= client_max_subscriptions)
 		return Client::SubscribeResult::FULL;
 
 	auto r = subscriptions.insert(channel);
@@ -40,6 +43,8 @@ Client::Subscribe(const char *channel)
 
 	++num_subscriptions;
 
+	partition.instance.client_list->AddSubscriber(*this, *r.first);
+
 	idle_add(IDLE_SUBSCRIPTION);
 
 	return Client::SubscribeResult::OK;
@@ -54,6 +59,7 @@ Client::Unsubscribe(const char *channel)
 
 	assert(num_subscriptions > 0);
 
+	partition.instance.client_list->RemoveSubscriber(*this, *i);
 	subscriptions.erase(i);
 	--num_subscriptions;
 
@@ -68,15 +74,20 @@ Client::Unsubscribe(const char *channel)
 void
 Client::UnsubscribeAll()
 {
+	ClientList &client_list = *partition.instance.client_list;
+	for (const auto &channel : subscriptions)
+		client_list.RemoveSubscriber(*this, channel);
+
 	subscriptions.clear();
 	num_subscriptions = 0;
 }
 
 bool
-Client::PushMessage(const ClientMessage &msg)
+Client::PushMessage(const ClientMessagePtr &msg)
 {
-	if (messages.size() >= CLIENT_MAX_MESSAGES ||
-	    !IsSubscribed(msg.GetChannel()))
+	assert(IsSubscribed(msg->GetChannel()));
+
+	if (messages.size() >= client_max_messages)
 		return false;
 
 	if (messages.empty())
@@ -19,15 +19,14 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "CompactRecord.hxx"
 #include "util/FormatString.hxx"
 
+#include <stdio.h>
 #include <string.h>
 
-/**
- * Write a block of data to the client.
- */
-static void
-client_write(Client &client, const char *data, size_t length)
+void
+client_write(Client &client, const void *data, size_t length)
 {
 	/* if the client is going to be closed, do nothing */
 	if (client.IsExpired() || length == 0)
@@ -42,9 +41,173 @@ client_puts(Client &client, const char *s)
 	client_write(client, s, strlen(s));
 }
 
+static void
+client_write_pair(Client &client, const char *name, const char *value)
+{
+	if (client.IsExpired())
+		return;
+
+	const size_t name_length = strlen(name);
+	const size_t value_length = strlen(value);
+	const size_t length = name_length + 2 + value_length + 1;
+
+	const auto w = client.PrepareWrite();
+	if (w.size >= length) {
+		char *p = (char *)w.data;
+		memcpy(p, name, name_length);
+		p += name_length;
+		*p++ = ':';
+		*p++ = ' ';
+		memcpy(p, value, value_length);
+		p += value_length;
+		*p = '\n';
+
+		client.CommitWrite(length);
+	} else {
+		/* not enough contiguous room; let the PeakBuffer
+		   deal with it */
+		client.Write(name, name_length) &&
+			client.Write(": ", 2) &&
+			client.Write(value, value_length) &&
+			client.Write("\n", 1);
+	}
+}
+
+/**
+ * Format an unsigned integer at the end of the given buffer, and
+ * return a pointer to the first digit.
+ */
+static const char *
+format_unsigned(char (&buffer)[16], unsigned value)
+{
+	char *p = buffer + sizeof(buffer);
+	*--p = 0;
+
+	do {
+		*--p = '0' + value % 10;
+		value /= 10;
+	} while (value > 0);
+
+	return p;
+}
+
+static void
+client_record_append(Client &client, unsigned key,
+		     const char *name, const char *value)
+{
+	if (key != COMPACT_OTHER) {
+		compact_record_append(client.record, key,
+				      value, strlen(value));
+		return;
+	}
+
+	std::string line(name);
+	line.append(": ");
+	line.append(value);
+	compact_record_append(client.record, key, line.data(), line.length());
+}
+
+void
+client_print_pair(Client &client, const char *name, const char *value)
+{
+	if (client.record_depth > 0)
+		client_record_append(client, compact_key_parse(name),
+				     name, value);
+	else
+		client_write_pair(client, name, value);
+}
+
+void
+client_print_pair(Client &client, const char *name, unsigned value)
+{
+	char buffer[16];
+	client_print_pair(client, name, format_unsigned(buffer, value));
+}
+
+void
+client_begin_record(Client &client)
+{
+	if (!client.compact)
+		return;
+
+	if (client.record_depth++ == 0)
+		client.record.clear();
+}
+
+void
+client_end_record(Client &client)
+{
+	if (client.record_depth == 0 || --client.record_depth > 0)
+		return;
+
+	char buffer[16];
+	client_write_pair(client, "record",
+			  format_unsigned(buffer, client.record.length()));
+	client_write(client, client.record.data(), client.record.length());
+	client_write(client, "\n", 1);
+}
+
+void
+client_print_field(Client &client, unsigned key, const char *value)
+{
+	if (client.record_depth > 0)
+		compact_record_append(client.record, key,
+				      value, strlen(value));
+	else
+		client_write_pair(client, compact_key_name(key), value);
+}
+
+void
+client_print_field(Client &client, unsigned key, unsigned value)
+{
+	char buffer[16];
+	client_print_field(client, key, format_unsigned(buffer, value));
+}
+
 void
 client_vprintf(Client &client, const char *fmt, va_list args)
 {
+	if (client.IsExpired())
+		return;
+
+	/* format directly into the output buffer; this is the common
+	   case and doesn't need a copy or a heap allocation */
+
+	const auto w = client.PrepareWrite();
+	if (w.size > 0) {
+		va_list tmp;
+		va_copy(tmp, args);
+		int length = vsnprintf((char *)w.data, w.size, fmt, tmp);
+		va_end(tmp);
+
+		if (gcc_unlikely(length < 0))
+			return;
+
+		/* vsnprintf() needs room for the null terminator,
+		   which is not committed */
+		if (size_t(length) < w.size) {
+			client.CommitWrite(length);
+			return;
+		}
+	}
+
+	/* the output buffer is (nearly) full: format into a stack
+	   buffer, and allocate only for very long lines */
+
+	char buffer[1024];
+	va_list tmp;
+	va_copy(tmp, args);
+	int length = vsnprintf(buffer, sizeof(buffer), fmt, tmp);
+	va_end(tmp);
+
+	if (gcc_unlikely(length < 0))
+		return;
+
+	if (size_t(length) < sizeof(buffer)) {
+		client_write(client, buffer, length);
+		return;
+	}
+
 	char *p = FormatNewV(fmt, args);
 	client_write(client, p, strlen(p));
 	delete[] p;
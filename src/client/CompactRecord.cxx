@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "CompactRecord.hxx"
+#include "tag/TagType.h"
+
+#include <string.h>
+
+static const char *const compact_key_names[COMPACT_KEY_END - COMPACT_FILE] = {
+	"file",
+	"Last-Modified",
+	"Range",
+	"Time",
+	"duration",
+	"Pos",
+	"Id",
+	"Prio",
+};
+
+const char *
+compact_key_name(unsigned key)
+{
+	if (key < TAG_NUM_OF_ITEM_TYPES)
+		return tag_item_names[key];
+
+	if (key >= COMPACT_FILE && key < COMPACT_KEY_END)
+		return compact_key_names[key - COMPACT_FILE];
+
+	return nullptr;
+}
+
+unsigned
+compact_key_parse(const char *name)
+{
+	for (unsigned i = COMPACT_FILE; i < COMPACT_KEY_END; ++i)
+		if (strcmp(name, compact_key_names[i - COMPACT_FILE]) == 0)
+			return i;
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (strcmp(name, tag_item_names[i]) == 0)
+			return i;
+
+	return COMPACT_OTHER;
+}
+
+void
+compact_record_append(std::string &record, unsigned key,
+		      const char *value, size_t length)
+{
+	record.push_back(char(key));
+
+	size_t n = length;
+	do {
+		unsigned char byte = n & 0x7f;
+		n >>= 7;
+		if (n > 0)
+			byte |= 0x80;
+		record.push_back(char(byte));
+	} while (n > 0);
+
+	record.append(value, length);
+}
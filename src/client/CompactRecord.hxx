@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_COMPACT_RECORD_HXX
+#define MPD_COMPACT_RECORD_HXX
+
+#include "Compiler.h"
+
+#include <string>
+
+#include <stddef.h>
+
+/**
+ * The numeric keys of fields in a "compact" song record.  Keys below
+ * #TAG_NUM_OF_ITEM_TYPES are #TagType values (with the names from
+ * #tag_item_names); the song attributes which are not tags start at
+ * #COMPACT_FILE.
+ *
+ * A record is sent as a "record: LENGTH" line, followed by LENGTH
+ * bytes and a newline.  Each field inside consists of the key byte,
+ * the value length (unsigned LEB128) and the value.  Numbers are
+ * encoded as decimal strings, just like in the text protocol.
+ */
+enum CompactKey : unsigned {
+	COMPACT_FILE = 0x80,
+	COMPACT_LAST_MODIFIED,
+	COMPACT_RANGE,
+	COMPACT_TIME,
+	COMPACT_DURATION,
+	COMPACT_POS,
+	COMPACT_ID,
+	COMPACT_PRIO,
+
+	COMPACT_KEY_END,
+
+	/**
+	 * A field which has no numeric key.  Its value is the
+	 * complete "name: value" string.
+	 */
+	COMPACT_OTHER = 0xff,
+};
+
+/**
+ * Returns the protocol name of the specified key, or nullptr if the
+ * key is unknown.
+ */
+gcc_const
+const char *
+compact_key_name(unsigned key);
+
+/**
+ * Look up the key of a protocol attribute name.  Returns
+ * #COMPACT_OTHER if it has none.
+ */
+gcc_pure gcc_nonnull_all
+unsigned
+compact_key_parse(const char *name);
+
+/**
+ * Append one field to a record.
+ */
+void
+compact_record_append(std::string &record, unsigned key,
+		      const char *value, size_t length);
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DeflateOutputFilter.hxx"
+#include "lib/zlib/Domain.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/DynamicFifoBuffer.hxx"
+#include "util/Error.hxx"
+
+DeflateOutputFilter::DeflateOutputFilter(int _level, size_t _threshold,
+					 Error &error)
+	:level(_level), current_level(_level), threshold(_threshold)
+{
+	z.next_in = nullptr;
+	z.avail_in = 0;
+	z.zalloc = Z_NULL;
+	z.zfree = Z_NULL;
+	z.opaque = Z_NULL;
+
+	int result = deflateInit(&z, level);
+	if (result != Z_OK) {
+		z.opaque = this;
+		error.Set(zlib_domain, result, zError(result));
+	}
+}
+
+DeflateOutputFilter::~DeflateOutputFilter()
+{
+	if (IsDefined())
+		deflateEnd(&z);
+}
+
+bool
+DeflateOutputFilter::Filter(ConstBuffer<void> src,
+			    DynamicFifoBuffer<uint8_t> &dest,
+			    Error &error)
+{
+	const int want_level = src.size >= threshold
+		? level
+		: Z_NO_COMPRESSION;
+	if (want_level != current_level) {
+		/* the previous chunk ended with Z_SYNC_FLUSH, so this
+		   will not emit much; give it some room anyway */
+		constexpr size_t max = 64;
+		Bytef *out = dest.Write(max);
+		z.next_in = nullptr;
+		z.avail_in = 0;
+		z.next_out = out;
+		z.avail_out = max;
+
+		int result = deflateParams(&z, want_level, Z_DEFAULT_STRATEGY);
+		if (result != Z_OK && result != Z_BUF_ERROR) {
+			error.Set(zlib_domain, result, zError(result));
+			return false;
+		}
+
+		dest.Append(z.next_out - out);
+		current_level = want_level;
+	}
+
+	/* zlib's API requires non-const input pointer */
+	z.next_in = reinterpret_cast<Bytef *>(const_cast<void *>(src.data));
+	z.avail_in = src.size;
+
+	do {
+		const size_t max = deflateBound(&z, z.avail_in) + 16;
+		Bytef *out = dest.Write(max);
+		z.next_out = out;
+		z.avail_out = max;
+
+		int result = deflate(&z, Z_SYNC_FLUSH);
+		if (result != Z_OK && result != Z_BUF_ERROR) {
+			error.Set(zlib_domain, result, zError(result));
+			return false;
+		}
+
+		dest.Append(z.next_out - out);
+	} while (z.avail_in > 0 || z.avail_out == 0);
+
+	return true;
+}
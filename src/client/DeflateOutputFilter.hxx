@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DEFLATE_OUTPUT_FILTER_HXX
+#define MPD_DEFLATE_OUTPUT_FILTER_HXX
+
+#include "check.h"
+#include "event/SocketOutputFilter.hxx"
+
+#include <zlib.h>
+
+#include <stddef.h>
+
+class Error;
+
+/**
+ * A #SocketOutputFilter which compresses the client's responses into
+ * one continuous zlib stream.  Each chunk ends with Z_SYNC_FLUSH, so
+ * the peer can decompress everything it has received so far.
+ *
+ * Chunks smaller than the threshold are sent as "stored" deflate
+ * blocks, which costs almost no CPU.
+ */
+class DeflateOutputFilter final : public SocketOutputFilter {
+	z_stream z;
+
+	const int level;
+	int current_level;
+
+	const size_t threshold;
+
+public:
+	/**
+	 * Construct the filter.  Call IsDefined() to check whether
+	 * the constructor has succeeded.  If not, #error will hold
+	 * information about the failure.
+	 */
+	DeflateOutputFilter(int _level, size_t _threshold, Error &error);
+	~DeflateOutputFilter();
+
+	/**
+	 * Check whether the constructor has succeeded.
+	 */
+	bool IsDefined() const {
+		return z.opaque == nullptr;
+	}
+
+	/* virtual methods from class SocketOutputFilter */
+	bool Filter(ConstBuffer<void> src, DynamicFifoBuffer<uint8_t> &dest,
+		    Error &error) override;
+};
+
+#endif
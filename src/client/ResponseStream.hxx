@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_RESPONSE_STREAM_HXX
+#define MPD_RESPONSE_STREAM_HXX
+
+#include "check.h"
+#include "command/CommandResult.hxx"
+
+class Client;
+
+/**
+ * A response which is too large to be generated at once.  The
+ * command handler generates the first portion and then installs the
+ * #ResponseStream with Client::SetResponseStream(); the next portion
+ * is generated each time the client's output buffer becomes empty.
+ * Until the stream is finished, no more commands are read from this
+ * client.
+ */
+class ResponseStream {
+public:
+	virtual ~ResponseStream() {}
+
+	/**
+	 * Generate the next portion of the response.
+	 *
+	 * @return CommandResult::DEFERRED if there is more to send,
+	 * CommandResult::OK if the response is complete (the "OK"
+	 * has not yet been sent) or CommandResult::ERROR (the "ACK"
+	 * has been sent)
+	 */
+	virtual CommandResult Continue(Client &client) = 0;
+};
+
+#endif
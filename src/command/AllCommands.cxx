@@ -29,22 +29,38 @@
 #include "OutputCommands.hxx"
 #include "MessageCommands.hxx"
 #include "NeighborCommands.hxx"
+#include "FilterCommands.hxx"
 #include "OtherCommands.hxx"
+#include "CommandHash.hxx"
 #include "Permission.hxx"
+#include "metrics/Counter.hxx"
+#include "metrics/Writer.hxx"
 #include "tag/TagType.h"
 #include "protocol/Result.hxx"
 #include "Partition.hxx"
 #include "client/Client.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "system/Clock.hxx"
 #include "util/Macros.hxx"
 #include "util/Tokenizer.hxx"
 #include "util/Error.hxx"
+#include "util/Domain.hxx"
 #include "util/ConstBuffer.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/DatabaseLock.hxx"
+#endif
 
 #ifdef ENABLE_SQLITE
 #include "StickerCommands.hxx"
 #include "sticker/StickerDatabase.hxx"
 #endif
 
+#include <algorithm>
+#include <string>
+
 #include <assert.h>
 #include <string.h>
 
@@ -81,12 +97,14 @@ static constexpr struct command commands[] = {
 	{ "add", PERMISSION_ADD, 1, 1, handle_add },
 	{ "addid", PERMISSION_ADD, 1, 2, handle_addid },
 	{ "addtagid", PERMISSION_ADD, 3, 3, handle_addtagid },
+	{ "albumart", PERMISSION_READ, 2, 2, handle_albumart },
 	{ "channels", PERMISSION_READ, 0, 0, handle_channels },
 	{ "clear", PERMISSION_CONTROL, 0, 0, handle_clear },
 	{ "clearerror", PERMISSION_CONTROL, 0, 0, handle_clearerror },
 	{ "cleartagid", PERMISSION_ADD, 1, 2, handle_cleartagid },
 	{ "close", PERMISSION_NONE, -1, -1, handle_close },
 	{ "commands", PERMISSION_NONE, 0, 0, handle_commands },
+	{ "compact", PERMISSION_NONE, 0, 1, handle_compact },
 	{ "config", PERMISSION_ADMIN, 0, 0, handle_config },
 	{ "consume", PERMISSION_CONTROL, 1, 1, handle_consume },
 #ifdef ENABLE_DATABASE
@@ -95,10 +113,14 @@ static constexpr struct command commands[] = {
 	{ "crossfade", PERMISSION_CONTROL, 1, 1, handle_crossfade },
 	{ "currentsong", PERMISSION_READ, 0, 0, handle_currentsong },
 	{ "decoders", PERMISSION_READ, 0, 0, handle_decoders },
+#ifdef ENABLE_ZLIB
+	{ "deflate", PERMISSION_NONE, 0, 1, handle_deflate },
+#endif
 	{ "delete", PERMISSION_CONTROL, 1, 1, handle_delete },
 	{ "deleteid", PERMISSION_CONTROL, 1, 1, handle_deleteid },
 	{ "disableoutput", PERMISSION_ADMIN, 1, 1, handle_disableoutput },
 	{ "enableoutput", PERMISSION_ADMIN, 1, 1, handle_enableoutput },
+	{ "equalizers", PERMISSION_READ, 0, 0, handle_equalizers },
 #ifdef ENABLE_DATABASE
 	{ "find", PERMISSION_READ, 2, -1, handle_find },
 	{ "findadd", PERMISSION_ADD, 2, -1, handle_findadd},
@@ -107,8 +129,8 @@ static constexpr struct command commands[] = {
 	{ "kill", PERMISSION_ADMIN, -1, -1, handle_kill },
 #ifdef ENABLE_DATABASE
 	{ "list", PERMISSION_READ, 1, -1, handle_list },
-	{ "listall", PERMISSION_READ, 0, 1, handle_listall },
-	{ "listallinfo", PERMISSION_READ, 0, 1, handle_listallinfo },
+	{ "listall", PERMISSION_READ, 0, 7, handle_listall },
+	{ "listallinfo", PERMISSION_READ, 0, 7, handle_listallinfo },
 #endif
 	{ "listfiles", PERMISSION_READ, 0, 1, handle_listfiles },
 #ifdef ENABLE_DATABASE
@@ -136,6 +158,7 @@ static constexpr struct command commands[] = {
 	{ "pause", PERMISSION_CONTROL, 0, 1, handle_pause },
 	{ "ping", PERMISSION_NONE, 0, 0, handle_ping },
 	{ "play", PERMISSION_CONTROL, 0, 1, handle_play },
+	{ "playerstats", PERMISSION_READ, 0, 0, handle_playerstats },
 	{ "playid", PERMISSION_CONTROL, 0, 1, handle_playid },
 	{ "playlist", PERMISSION_READ, 0, 0, handle_playlist },
 	{ "playlistadd", PERMISSION_CONTROL, 2, 2, handle_playlistadd },
@@ -173,6 +196,7 @@ static constexpr struct command commands[] = {
 	{ "seekcur", PERMISSION_CONTROL, 1, 1, handle_seekcur },
 	{ "seekid", PERMISSION_CONTROL, 2, 2, handle_seekid },
 	{ "sendmessage", PERMISSION_CONTROL, 2, 2, handle_send_message },
+	{ "setequalizer", PERMISSION_CONTROL, 3, 5, handle_setequalizer },
 	{ "setvol", PERMISSION_CONTROL, 1, 1, handle_setvol },
 	{ "shuffle", PERMISSION_CONTROL, 0, 1, handle_shuffle },
 	{ "single", PERMISSION_CONTROL, 1, 1, handle_single },
@@ -198,6 +222,97 @@ static constexpr struct command commands[] = {
 
 static constexpr unsigned num_commands = ARRAY_SIZE(commands);
 
+static constexpr Domain command_domain("command");
+
+/**
+ * Upper bounds of the command duration histogram buckets [s].
+ */
+static constexpr double command_duration_bounds[] = {
+	0.0001, 0.001, 0.01, 0.1, 1, 10,
+};
+
+struct CommandMetrics {
+	MetricCounter calls;
+
+	/**
+	 * The size of the responses before compression [bytes].
+	 * Responses which are streamed after the handler has
+	 * returned (CommandResult::DEFERRED) are only partially
+	 * included.
+	 */
+	MetricCounter response_bytes;
+
+	/**
+	 * The time spent in the command handler.
+	 */
+	MetricHistogram<ARRAY_SIZE(command_duration_bounds)> duration;
+
+	CommandMetrics():duration(command_duration_bounds) {}
+};
+
+/**
+ * Statistics about each command, indexed like #commands.
+ */
+static CommandMetrics command_metrics[num_commands];
+
+/**
+ * Commands which take longer than this are logged [microseconds];
+ * 0 disables the slow command log.  Configured with
+ * "slow_command_threshold" (in milliseconds).
+ */
+static uint64_t slow_command_threshold_us;
+
+static constexpr bool
+command_slot_collides(unsigned i, unsigned j)
+{
+	return j < num_commands &&
+		(command_hash_slot(commands[i].cmd) ==
+		 command_hash_slot(commands[j].cmd) ||
+		 command_slot_collides(i, j + 1));
+}
+
+static constexpr bool
+command_hash_is_perfect(unsigned i=0)
+{
+	return i >= num_commands ||
+		(!command_slot_collides(i, i + 1) &&
+		 command_hash_is_perfect(i + 1));
+}
+
+static_assert(command_hash_is_perfect(),
+	      "Command hash collision; please change COMMAND_HASH_SEED");
+
+static_assert(num_commands < 256, "Too many commands for uint8_t slots");
+
+/**
+ * Maps command_hash_slot() to the command index plus one (zero
+ * means "no command").  Since the hash is perfect, a lookup needs
+ * only one strcmp().
+ */
+class CommandHashTable {
+	uint8_t slots[COMMAND_HASH_SIZE];
+
+public:
+	CommandHashTable() {
+		std::fill_n(slots, COMMAND_HASH_SIZE, 0);
+
+		for (unsigned i = 0; i < num_commands; ++i)
+			slots[command_hash_slot(commands[i].cmd)] = i + 1;
+	}
+
+	gcc_pure
+	const struct command *Find(const char *name) const {
+		const unsigned i = slots[command_hash_slot(name)];
+		if (i == 0)
+			return nullptr;
+
+		const struct command *cmd = &commands[i - 1];
+		return strcmp(name, cmd->cmd) == 0
+			? cmd
+			: nullptr;
+	}
+};
+
 static bool
 command_available(gcc_unused const Partition &partition,
 		  gcc_unused const struct command *cmd)
@@ -265,6 +380,16 @@ command_init()
 	for (unsigned i = 0; i < num_commands - 1; ++i)
 		assert(strcmp(commands[i].cmd, commands[i + 1].cmd) < 0);
 #endif
+
+	slow_command_threshold_us =
+		uint64_t(config_get_unsigned(ConfigOption::SLOW_COMMAND_THRESHOLD,
+					     0)) * 1000;
+
+#ifdef ENABLE_DATABASE
+	/* the slow command log reports how long the database lock
+	   was held */
+	db_lock_timing = slow_command_threshold_us > 0;
+#endif
 }
 
 void
@@ -272,25 +397,90 @@ command_finish()
 {
 }
 
+void
+command_write_metrics(OpenMetricsWriter &writer)
+{
+	writer.Family("mpd_commands", "counter",
+		      "Invocations of each protocol command");
+
+	for (unsigned i = 0; i < num_commands; ++i)
+		writer.Sample("mpd_commands", "_total",
+			      "command", commands[i].cmd,
+			      command_metrics[i].calls.Get());
+
+	/* the following families omit commands which have never
+	   been invoked, to keep the response small */
+
+	writer.Family("mpd_command_response_bytes", "counter",
+		      "Response size of each protocol command");
+
+	for (unsigned i = 0; i < num_commands; ++i)
+		if (command_metrics[i].calls.Get() > 0)
+			writer.Sample("mpd_command_response_bytes", "_total",
+				      "command", commands[i].cmd,
+				      command_metrics[i].response_bytes.Get());
+
+	writer.Family("mpd_command_duration_seconds", "histogram",
+		      "Time spent in each protocol command");
+
+	for (unsigned i = 0; i < num_commands; ++i)
+		if (command_metrics[i].calls.Get() > 0)
+			writer.HistogramSamples("mpd_command_duration_seconds",
+						"command", commands[i].cmd,
+						command_metrics[i].duration);
+}
+
+/**
+ * Format the arguments of a command for the slow command log,
+ * truncating long argument lists.
+ */
+static std::string
+command_format_args(ConstBuffer<const char *> args)
+{
+	std::string result;
+
+	for (const char *arg : args) {
+		if (result.length() >= 200) {
+			result.append(" ...");
+			break;
+		}
+
+		result.append(" \"");
+		result.append(arg);
+		result.push_back('"');
+	}
+
+	return result;
+}
+
+/**
+ * Log a command which has exceeded #slow_command_threshold_us.
+ */
+static void
+command_log_slow(const Client &client, const struct command *cmd,
+		 ConstBuffer<const char *> args, unsigned list_num,
+		 uint64_t duration_us, uint64_t response_bytes,
+		 uint64_t db_lock_us)
+{
+	const std::string list_position = client.cmd_list.IsActive()
+		? " (command list position " + std::to_string(list_num) + ")"
+		: std::string();
+
+	FormatWarning(command_domain,
+		      "[%u] slow command from %s: %s%s%s took %.1f ms, "
+		      "%llu bytes, database lock held %.1f ms",
+		      client.num, client.remote.c_str(),
+		      cmd->cmd, command_format_args(args).c_str(),
+		      list_position.c_str(),
+		      duration_us / 1000., (unsigned long long)response_bytes,
+		      db_lock_us / 1000.);
+}
+
 static const struct command *
 command_lookup(const char *name)
 {
-	unsigned a = 0, b = num_commands, i;
-
-	/* binary search */
-	do {
-		i = (a + b) / 2;
-
-		const auto cmp = strcmp(name, commands[i].cmd);
-		if (cmp == 0)
-			return &commands[i];
-		else if (cmp < 0)
-			b = i;
-		else if (cmp > 0)
-			a = i + 1;
-	} while (a < b);
-
-	return nullptr;
+	static const CommandHashTable table;
+	return table.Find(name);
 }
 
 static bool
@@ -411,9 +601,39 @@ command_process(Client &client, unsigned num, char *line)
 		command_checked_lookup(client, client.GetPermission(),
 				       cmd_name, args);
 
-	CommandResult ret = cmd
-		? cmd->handler(client, args)
-		: CommandResult::ERROR;
+	if (cmd == nullptr) {
+		current_command = nullptr;
+		command_list_num = 0;
+		return CommandResult::ERROR;
+	}
+
+	CommandMetrics &metrics = command_metrics[cmd - commands];
+	metrics.calls.Add();
+
+	const uint64_t start_us = MonotonicClockUS();
+	const uint64_t start_bytes = client.GetOutputCount();
+#ifdef ENABLE_DATABASE
+	const uint64_t start_db_lock_us = db_lock_held_us;
+#endif
+
+	CommandResult ret = cmd->handler(client, args);
+
+	const uint64_t duration_us = MonotonicClockUS() - start_us;
+	const uint64_t response_bytes = client.GetOutputCount() - start_bytes;
+
+	metrics.duration.Observe(duration_us / 1000000.);
+	metrics.response_bytes.Add(response_bytes);
+
+	if (slow_command_threshold_us > 0 &&
+	    duration_us >= slow_command_threshold_us) {
+#ifdef ENABLE_DATABASE
+		const uint64_t db_lock_us = db_lock_held_us - start_db_lock_us;
+#else
+		const uint64_t db_lock_us = 0;
+#endif
+		command_log_slow(client, cmd, args, num,
+				 duration_us, response_bytes, db_lock_us);
+	}
 
 	current_command = nullptr;
 	command_list_num = 0;
@@ -23,6 +23,7 @@
 #include "CommandResult.hxx"
 
 class Client;
+class OpenMetricsWriter;
 
 void
 command_init();
@@ -33,4 +34,10 @@ command_finish();
 CommandResult
 command_process(Client &client, unsigned num, char *line);
 
+/**
+ * Write the number of invocations of each command.
+ */
+void
+command_write_metrics(OpenMetricsWriter &writer);
+
 #endif
@@ -105,6 +105,7 @@ print_error(Client &client, const Error &error)
 	} else if (error.IsDomain(db_domain)) {
 		switch ((enum db_error)error.GetCode()) {
 		case DB_DISABLED:
+		case DB_LOADING:
 			command_error(client, ACK_ERROR_NO_EXIST, "%s",
 				      error.GetMessage());
 			return CommandResult::ERROR;
@@ -116,6 +117,11 @@ print_error(Client &client, const Error &error)
 		case DB_CONFLICT:
 			command_error(client, ACK_ERROR_ARG, "Conflict");
 			return CommandResult::ERROR;
+
+		case DB_MODIFIED:
+			command_error(client, ACK_ERROR_NO_EXIST,
+				      "Database has been modified");
+			return CommandResult::ERROR;
 		}
 #endif
 	} else if (error.IsDomain(errno_domain)) {
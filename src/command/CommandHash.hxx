@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_COMMAND_HASH_HXX
+#define MPD_COMMAND_HASH_HXX
+
+#include "Compiler.h"
+
+#include <stdint.h>
+
+/**
+ * The number of slots in the command hash table.  Must be a power of
+ * two.
+ */
+static constexpr unsigned COMMAND_HASH_SIZE = 1024;
+
+/**
+ * The FNV-1a offset basis, tweaked so command_hash_slot() maps all
+ * command names to distinct slots.  Only the low bits matter.  If a
+ * new command causes a collision (AllCommands.cxx checks this with
+ * static_assert), try other values.
+ */
+static constexpr uint32_t COMMAND_HASH_SEED = 2166136264u;
+
+/**
+ * FNV-1a, usable in constant expressions.
+ */
+gcc_pure
+static constexpr uint32_t
+command_hash(const char *s, uint32_t h=COMMAND_HASH_SEED)
+{
+	return *s == 0
+		? h
+		: command_hash(s + 1, (h ^ uint8_t(*s)) * 16777619u);
+}
+
+gcc_pure
+static constexpr unsigned
+command_hash_slot(const char *name)
+{
+	return command_hash(name) & (COMMAND_HASH_SIZE - 1);
+}
+
+#endif
@@ -47,6 +47,12 @@ enum class CommandResult {
 	 */
 	ERROR,
 
+	/**
+	 * The response will be completed later by a
+	 * #ResponseStream, which also sends the "OK" or "ACK".
+	 */
+	DEFERRED,
+
 	/**
 	 * The client has asked MPD to close the connection.  MPD will
 	 * flush the remaining output buffer first.
@@ -25,6 +25,8 @@
 #include "db/DatabasePrint.hxx"
 #include "db/Count.hxx"
 #include "db/Selection.hxx"
+#include "db/Interface.hxx"
+#include "db/WalkCursor.hxx"
 #include "CommandError.hxx"
 #include "client/Client.hxx"
 #include "tag/Tag.hxx"
@@ -35,7 +37,10 @@
 #include "protocol/ArgParser.hxx"
 #include "BulkEdit.hxx"
 
+#include <memory>
+
 #include <string.h>
+#include <stdlib.h>
 
 CommandResult
 handle_listfiles_db(Client &client, const char *uri)
@@ -64,32 +69,296 @@ handle_lsinfo2(Client &client, ConstBuffer<const char *> args)
 	return CommandResult::OK;
 }
 
-static CommandResult
-handle_match(Client &client, ConstBuffer<const char *> args, bool fold_case)
+/**
+ * The number of entities printed in one portion of a
+ * #DatabasePrintStream.
+ */
+static constexpr unsigned PRINT_STREAM_BATCH = 4096;
+
+/**
+ * Generates a large database listing in portions of
+ * #PRINT_STREAM_BATCH entities, one each time the client's output
+ * buffer becomes empty, so the output buffer does not need to hold
+ * the whole response.  The #DatabaseWalkCursor continues where the
+ * previous portion has stopped.
+ */
+class DatabasePrintStream final : public ResponseStream {
+	const char *const command;
+
+	const SongFilter filter;
+	const bool full;
+
+	DatabaseWalkCursor cursor;
+
+public:
+	DatabasePrintStream(const char *_command, const Database &db,
+			    const char *uri, SongFilter &&_filter, bool _full)
+		:command(_command), filter(std::move(_filter)), full(_full),
+		 cursor(db, uri, filter.IsEmpty() ? nullptr : &filter) {}
+
+	/* virtual methods from class ResponseStream */
+	CommandResult Continue(Client &client) override;
+};
+
+CommandResult
+DatabasePrintStream::Continue(Client &client)
 {
-	unsigned window_start = 0, window_end = std::numeric_limits<int>::max();
+	/* we may be called after command_process() has returned */
+	current_command = command;
+	command_list_num = 0;
+
+	Error error;
+	if (!db_cursor_print(client, cursor, full, PRINT_STREAM_BATCH, error))
+		return print_error(client, error);
+
+	return cursor.IsFinished()
+		? CommandResult::OK
+		: CommandResult::DEFERRED;
+}
+
+/**
+ * Parse the optional "stream 0|1" arguments at the end of the
+ * argument list, and remove them.
+ */
+static bool
+ParseStream(Client &client, ConstBuffer<const char *> &args, bool &stream_r)
+{
+	stream_r = false;
+	if (args.size < 2 || strcmp(args[args.size - 2], "stream") != 0)
+		return true;
+
+	if (!check_bool(client, &stream_r, args.back()))
+		return false;
+
+	args.pop_back();
+	args.pop_back();
+	return true;
+}
+
+/**
+ * Parse the optional "cursor TOKEN" and "window START:END" arguments
+ * at the end of the argument list, and remove them.
+ *
+ * @param cursor_r set to the cursor token (or nullptr if there is
+ * none)
+ */
+static bool
+ParseCursorWindow(Client &client, ConstBuffer<const char *> &args,
+		  const char *&cursor_r,
+		  unsigned &window_start, unsigned &window_end)
+{
+	window_start = 0;
+	window_end = std::numeric_limits<int>::max();
 	if (args.size >= 2 && strcmp(args[args.size - 2], "window") == 0) {
 		if (!check_range(client, &window_start, &window_end,
 				 args.back()))
-			return CommandResult::ERROR;
+			return false;
+
+		args.pop_back();
+		args.pop_back();
+	}
+
+	cursor_r = nullptr;
+	if (args.size >= 2 && strcmp(args[args.size - 2], "cursor") == 0) {
+		cursor_r = args.back();
 
 		args.pop_back();
 		args.pop_back();
 	}
 
+	return true;
+}
+
+/**
+ * Parse a cursor token which was generated by PrintCursor().  An
+ * empty string is the beginning of a new listing.
+ */
+static bool
+ParseCursor(Client &client, const char *s, time_t stamp,
+	    unsigned &position_r)
+{
+	if (*s == 0) {
+		position_r = 0;
+		return true;
+	}
+
+	char *endptr;
+	const unsigned long cursor_stamp = strtoul(s, &endptr, 16);
+	if (endptr == s || *endptr != '.') {
+		command_error(client, ACK_ERROR_ARG, "Malformed cursor");
+		return false;
+	}
+
+	s = endptr + 1;
+	const unsigned long position = strtoul(s, &endptr, 16);
+	if (endptr == s || *endptr != 0 ||
+	    position > (unsigned long)std::numeric_limits<int>::max()) {
+		command_error(client, ACK_ERROR_ARG, "Malformed cursor");
+		return false;
+	}
+
+	if (cursor_stamp != (unsigned long)stamp) {
+		command_error(client, ACK_ERROR_NO_EXIST,
+			      "Cursor has expired");
+		return false;
+	}
+
+	position_r = position;
+	return true;
+}
+
+static void
+PrintCursor(Client &client, time_t stamp, unsigned position)
+{
+	client_printf(client, "cursor: %lx.%x\n",
+		      (unsigned long)stamp, position);
+}
+
+/**
+ * Print the songs (and directories and playlists, unless there is a
+ * filter) below the given URI.
+ *
+ * With a cursor, the window is relative to the cursor position, and
+ * a new cursor is printed if there are more entities.  If the client
+ * has asked for a streamed response (and there is neither window nor
+ * cursor), it is generated in portions with a #DatabasePrintStream.
+ */
+static CommandResult
+PrintSelection(Client &client, const char *uri, SongFilter &&filter,
+	       bool full, bool stream, const char *cursor,
+	       unsigned window_start, unsigned window_end)
+{
+	Error error;
+	const Database *db = client.GetDatabase(error);
+	if (db == nullptr)
+		return print_error(client, error);
+
+	const time_t stamp = db->GetUpdateStamp();
+	const DatabaseSelection selection(uri, true,
+					  filter.IsEmpty() ? nullptr : &filter);
+
+	if (cursor != nullptr) {
+		unsigned position;
+		if (!ParseCursor(client, cursor, stamp, position))
+			return CommandResult::ERROR;
+
+		bool more;
+		if (!db_selection_print(client, selection, full, false,
+					position + window_start,
+					position + window_end,
+					more, error))
+			return print_error(client, error);
+
+		if (more)
+			PrintCursor(client, stamp, position + window_end);
+
+		return CommandResult::OK;
+	}
+
+	if (!stream || window_start > 0 ||
+	    window_end < (unsigned)std::numeric_limits<int>::max() ||
+	    /* inside a command list, the response must be generated
+	       before the next command */
+	    client.cmd_list.IsActive())
+		return db_selection_print(client, selection, full, false,
+					  window_start, window_end, error)
+			? CommandResult::OK
+			: print_error(client, error);
+
+	std::unique_ptr<DatabasePrintStream>
+		print_stream(new DatabasePrintStream(current_command, *db, uri,
+						     std::move(filter), full));
+	const CommandResult result = print_stream->Continue(client);
+	if (result == CommandResult::DEFERRED)
+		client.SetResponseStream(print_stream.release());
+
+	return result;
+}
+
+/**
+ * Parse the optional "sort [-]TAG" arguments at the end of the
+ * argument list (before "cursor" and "window"), and remove them.
+ *
+ * @param sort_r set to the tag, #SORT_TAG_LAST_MODIFIED or
+ * #TAG_NUM_OF_ITEM_TYPES if there is no "sort"
+ */
+static bool
+ParseSort(Client &client, ConstBuffer<const char *> &args,
+	  unsigned &sort_r, bool &descending_r)
+{
+	sort_r = TAG_NUM_OF_ITEM_TYPES;
+	descending_r = false;
+
+	if (args.size < 2 || strcmp(args[args.size - 2], "sort") != 0)
+		return true;
+
+	const char *s = args.back();
+	if (*s == '-') {
+		descending_r = true;
+		++s;
+	}
+
+	if (strcmp(s, "Last-Modified") == 0)
+		sort_r = SORT_TAG_LAST_MODIFIED;
+	else {
+		sort_r = tag_name_parse_i(s);
+		if (sort_r == TAG_NUM_OF_ITEM_TYPES) {
+			command_error(client, ACK_ERROR_ARG,
+				      "Unknown sort tag: %s", s);
+			return false;
+		}
+	}
+
+	args.pop_back();
+	args.pop_back();
+	return true;
+}
+
+static CommandResult
+handle_match(Client &client, ConstBuffer<const char *> args, bool fold_case)
+{
+	bool stream;
+	if (!ParseStream(client, args, stream))
+		return CommandResult::ERROR;
+
+	const char *cursor;
+	unsigned window_start, window_end;
+	if (!ParseCursorWindow(client, args, cursor,
+			       window_start, window_end))
+		return CommandResult::ERROR;
+
+	unsigned sort;
+	bool descending;
+	if (!ParseSort(client, args, sort, descending))
+		return CommandResult::ERROR;
+
 	SongFilter filter;
 	if (!filter.Parse(args, fold_case)) {
 		command_error(client, ACK_ERROR_ARG, "incorrect arguments");
 		return CommandResult::ERROR;
 	}
 
-	const DatabaseSelection selection("", true, &filter);
+	if (sort != TAG_NUM_OF_ITEM_TYPES) {
+		if (cursor != nullptr) {
+			/* cursor positions refer to the database
+			   order */
+			command_error(client, ACK_ERROR_ARG,
+				      "Cannot combine sort and cursor");
+			return CommandResult::ERROR;
+		}
 
-	Error error;
-	return db_selection_print(client, selection, true, false,
-				  window_start, window_end, error)
-		? CommandResult::OK
-		: print_error(client, error);
+		const DatabaseSelection selection("", true, &filter);
+		Error error;
+		return db_selection_print_sorted(client, selection, true,
+						 sort, descending,
+						 window_start, window_end,
+						 error)
+			? CommandResult::OK
+			: print_error(client, error);
+	}
+
+	return PrintSelection(client, "", std::move(filter), true, stream,
+			      cursor, window_start, window_end);
 }
 
 CommandResult
@@ -185,17 +454,35 @@ handle_count(Client &client, ConstBuffer<const char *> args)
 		: print_error(client, error);
 }
 
-CommandResult
-handle_listall(Client &client, ConstBuffer<const char *> args)
+static CommandResult
+handle_listall2(Client &client, ConstBuffer<const char *> args, bool full)
 {
+	bool stream;
+	if (!ParseStream(client, args, stream))
+		return CommandResult::ERROR;
+
+	const char *cursor;
+	unsigned window_start, window_end;
+	if (!ParseCursorWindow(client, args, cursor,
+			       window_start, window_end))
+		return CommandResult::ERROR;
+
+	if (args.size > 1) {
+		command_error(client, ACK_ERROR_ARG, "incorrect arguments");
+		return CommandResult::ERROR;
+	}
+
 	/* default is root directory */
 	const char *const uri = args.IsEmpty() ? "" : args.front();
 
-	Error error;
-	return db_selection_print(client, DatabaseSelection(uri, true),
-				  false, false, error)
-		? CommandResult::OK
-		: print_error(client, error);
+	return PrintSelection(client, uri, SongFilter(), full, stream,
+			      cursor, window_start, window_end);
+}
+
+CommandResult
+handle_listall(Client &client, ConstBuffer<const char *> args)
+{
+	return handle_listall2(client, args, false);
 }
 
 CommandResult
@@ -273,12 +560,5 @@ handle_list(Client &client, ConstBuffer<const char *> args)
 CommandResult
 handle_listallinfo(Client &client, ConstBuffer<const char *> args)
 {
-	/* default is root directory */
-	const char *const uri = args.IsEmpty() ? "" : args.front();
-
-	Error error;
-	return db_selection_print(client, DatabaseSelection(uri, true),
-				  true, false, error)
-		? CommandResult::OK
-		: print_error(client, error);
+	return handle_listall2(client, args, true);
 }
@@ -25,6 +25,8 @@
 #include "protocol/Ack.hxx"
 #include "protocol/Result.hxx"
 #include "client/Client.hxx"
+#include "client/BackgroundResponseStream.hxx"
+#include "protocol/ArgParser.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/CharUtil.hxx"
 #include "util/UriUtil.hxx"
@@ -32,14 +34,21 @@
 #include "tag/TagHandler.hxx"
 #include "tag/ApeTag.hxx"
 #include "tag/TagId3.hxx"
+#include "tag/TagScanFile.hxx"
 #include "TagStream.hxx"
 #include "TagFile.hxx"
+#include "CoverArt.hxx"
+#include "CoverArtCache.hxx"
 #include "storage/StorageInterface.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/FileInfo.hxx"
 #include "fs/DirectoryReader.hxx"
 #include "TimePrint.hxx"
 #include "ls.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <memory>
 
 #include <assert.h>
 #include <sys/stat.h>
@@ -167,6 +176,7 @@ static constexpr tag_handler print_comment_handler = {
 	nullptr,
 	nullptr,
 	print_pair,
+	nullptr,
 };
 
 static CommandResult
@@ -197,8 +207,11 @@ read_file_comments(Client &client, const Path path_fs)
 		return CommandResult::ERROR;
 	}
 
-	tag_ape_scan2(path_fs, &print_comment_handler, &client);
-	tag_id3_scan(path_fs, &print_comment_handler, &client);
+	LocalTagScanFile file(path_fs);
+	if (file.IsDefined()) {
+		tag_ape_scan2(file, &print_comment_handler, &client);
+		tag_id3_scan(file, &print_comment_handler, &client);
+	}
 
 	return CommandResult::OK;
 
@@ -270,3 +283,181 @@ handle_read_comments(Client &client, ConstBuffer<const char *> args)
 		return CommandResult::ERROR;
 	}
 }
+
+/**
+ * The maximum number of bytes sent by one "albumart" response.
+ */
+static constexpr size_t COVER_ART_CHUNK_SIZE = 8192;
+
+static CoverArtCache cover_art_cache(32 * 1024 * 1024);
+
+static CommandResult
+send_cover_art_chunk(Client &client, const CoverArt &cover, unsigned offset)
+{
+	if (cover.IsEmpty()) {
+		command_error(client, ACK_ERROR_NO_EXIST, "No cover art");
+		return CommandResult::ERROR;
+	}
+
+	const size_t size = cover.data.size();
+	if (offset > size) {
+		command_error(client, ACK_ERROR_ARG, "Bad file offset");
+		return CommandResult::ERROR;
+	}
+
+	const size_t length = std::min(size - offset, COVER_ART_CHUNK_SIZE);
+
+	client_print_pair(client, "size", unsigned(size));
+	if (!cover.mime_type.empty())
+		client_print_pair(client, "type", cover.mime_type.c_str());
+	client_print_pair(client, "binary", unsigned(length));
+	client_write(client, cover.data.data() + offset, length);
+	client_puts(client, "\n");
+	return CommandResult::OK;
+}
+
+/**
+ * Loads the cover art of a song which is not in the
+ * #cover_art_cache in a separate thread, and then sends the first
+ * chunk.
+ */
+class CoverArtLoadStream final : public BackgroundResponseStream {
+	const AllocatedPath song_fs;
+	const std::string directory;
+	const time_t directory_mtime;
+	const unsigned offset;
+
+	std::shared_ptr<CoverArt> cover;
+
+public:
+	CoverArtLoadStream(Client &_client, const char *_command,
+			   Path _song_fs,
+			   const std::string &_directory,
+			   time_t _directory_mtime, unsigned _offset)
+		:BackgroundResponseStream(_client, _command),
+		 song_fs(_song_fs),
+		 directory(_directory), directory_mtime(_directory_mtime),
+		 offset(_offset), cover(std::make_shared<CoverArt>()) {}
+
+protected:
+	/* virtual methods from class BackgroundResponseStream */
+	void Run() override {
+		cover->Load(song_fs);
+	}
+
+	CommandResult Finish(Client &_client) override {
+		cover_art_cache.Store(directory, directory_mtime, cover);
+		return send_cover_art_chunk(_client, *cover, offset);
+	}
+};
+
+/**
+ * Determine the local file name of the specified song URI.  On
+ * error, a response is sent to the client, and a "nulled" path is
+ * returned.
+ */
+static AllocatedPath
+map_cover_art_uri(Client &client, const char *uri)
+{
+	if (memcmp(uri, "file:///", 8) == 0) {
+		AllocatedPath path_fs = AllocatedPath::FromUTF8(uri + 7);
+		if (path_fs.IsNull()) {
+			command_error(client, ACK_ERROR_NO_EXIST,
+				      "unsupported file name");
+			return path_fs;
+		}
+
+		Error error;
+		if (!client.AllowFile(path_fs, error)) {
+			print_error(client, error);
+			return AllocatedPath::Null();
+		}
+
+		return path_fs;
+	}
+
+	if (uri_has_scheme(uri) || PathTraitsUTF8::IsAbsolute(uri) ||
+	    !uri_safe_local(uri)) {
+		command_error(client, ACK_ERROR_NO_EXIST,
+			      "Not a local file");
+		return AllocatedPath::Null();
+	}
+
+#ifdef ENABLE_DATABASE
+	const Storage *storage = client.GetStorage();
+	if (storage == nullptr) {
+#endif
+		command_error(client, ACK_ERROR_NO_EXIST, "No database");
+		return AllocatedPath::Null();
+#ifdef ENABLE_DATABASE
+	}
+
+	AllocatedPath path_fs = storage->MapFS(uri);
+	if (path_fs.IsNull())
+		/* cover art from remote storage is not implemented */
+		command_error(client, ACK_ERROR_NO_EXIST,
+			      "Not a local file");
+
+	return path_fs;
+#endif
+}
+
+CommandResult
+handle_albumart(Client &client, ConstBuffer<const char *> args)
+{
+	assert(args.size == 2);
+
+	unsigned offset;
+	if (!check_unsigned(client, &offset, args[1]))
+		return CommandResult::ERROR;
+
+	AllocatedPath song_fs = map_cover_art_uri(client, args.front());
+	if (song_fs.IsNull())
+		return CommandResult::ERROR;
+
+	const AllocatedPath directory_fs = song_fs.GetDirectoryName();
+	FileInfo song_info, directory_info;
+	if (!GetFileInfo(song_fs, song_info) || !song_info.IsRegular() ||
+	    directory_fs.IsNull() ||
+	    !GetFileInfo(directory_fs, directory_info)) {
+		command_error(client, ACK_ERROR_NO_EXIST, "No such file");
+		return CommandResult::ERROR;
+	}
+
+	const std::string directory = directory_fs.ToUTF8();
+	const time_t directory_mtime = directory_info.GetModificationTime();
+
+	auto cover = cover_art_cache.Lookup(directory, directory_mtime);
+	if (cover != nullptr && !cover->IsCurrent()) {
+		/* the picture has been modified */
+		cover_art_cache.Remove(directory);
+		cover.reset();
+	}
+
+	if (cover != nullptr && cover->IsFor(song_fs))
+		return send_cover_art_chunk(client, *cover, offset);
+
+	if (!client.cmd_list.IsActive()) {
+		/* read the picture in a separate thread, so the
+		   other clients are not blocked meanwhile; inside a
+		   command list, the response must be generated before
+		   the next command */
+		std::unique_ptr<CoverArtLoadStream>
+			stream(new CoverArtLoadStream(client, current_command,
+						      song_fs, directory,
+						      directory_mtime,
+						      offset));
+		Error error;
+		if (stream->Start(error)) {
+			client.SetResponseStream(stream.release());
+			return CommandResult::DEFERRED;
+		}
+
+		LogError(error);
+	}
+
+	const auto loaded = std::make_shared<CoverArt>();
+	loaded->Load(song_fs);
+	cover_art_cache.Store(directory, directory_mtime, loaded);
+	return send_cover_art_chunk(client, *loaded, offset);
+}
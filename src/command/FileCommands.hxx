@@ -31,4 +31,7 @@ handle_listfiles_local(Client &client, const char *path_utf8);
 CommandResult
 handle_read_comments(Client &client, ConstBuffer<const char *> args);
 
+CommandResult
+handle_albumart(Client &client, ConstBuffer<const char *> args);
+
 #endif
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "FilterCommands.hxx"
+#include "client/Client.hxx"
+#include "protocol/Result.hxx"
+#include "protocol/ArgParser.hxx"
+#include "filter/plugins/EqualizerFilterPlugin.hxx"
+#include "pcm/Equalizer.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <string.h>
+
+CommandResult
+handle_equalizers(Client &client, gcc_unused ConstBuffer<const char *> args)
+{
+	const char *previous = nullptr;
+
+	equalizer_filter_visit([&client, &previous](const char *name,
+						    unsigned n,
+						    const EqualizerBand &band){
+			if (previous == nullptr ||
+			    strcmp(previous, name) != 0)
+				client_printf(client, "equalizer: %s\n",
+					      name);
+			previous = name;
+
+			client_printf(client,
+				      "band: %u\n"
+				      "type: %s\n"
+				      "frequency: %g\n"
+				      "gain: %g\n"
+				      "q: %g\n",
+				      n, GetEqualizerBandTypeName(band.type),
+				      band.frequency, band.gain, band.q);
+		});
+
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_setequalizer(Client &client, ConstBuffer<const char *> args)
+{
+	const char *const name = args[0];
+
+	unsigned n;
+	if (!check_unsigned(client, &n, args[1]))
+		return CommandResult::ERROR;
+
+	EqualizerBand band;
+	if (!equalizer_filter_get_band(name, n, band)) {
+		command_error(client, ACK_ERROR_NO_EXIST,
+			      "No such equalizer band");
+		return CommandResult::ERROR;
+	}
+
+	if (!check_float(client, &band.gain, args[2]))
+		return CommandResult::ERROR;
+
+	if (args.size > 3 && !check_float(client, &band.frequency, args[3]))
+		return CommandResult::ERROR;
+
+	if (args.size > 4 && !check_float(client, &band.q, args[4]))
+		return CommandResult::ERROR;
+
+	if (!(band.gain >= -EQUALIZER_MAX_GAIN) ||
+	    !(band.gain <= EQUALIZER_MAX_GAIN)) {
+		command_error(client, ACK_ERROR_ARG,
+			      "Gain out of range");
+		return CommandResult::ERROR;
+	}
+
+	if (!(band.frequency > 0) || !(band.q > 0)) {
+		command_error(client, ACK_ERROR_ARG,
+			      "Invalid frequency or quality");
+		return CommandResult::ERROR;
+	}
+
+	equalizer_filter_set_band(name, n, band);
+	return CommandResult::OK;
+}
@@ -26,9 +26,6 @@
 #include "protocol/Result.hxx"
 #include "util/ConstBuffer.hxx"
 
-#include <set>
-#include <string>
-
 #include <assert.h>
 
 CommandResult
@@ -82,13 +79,8 @@ handle_channels(Client &client, gcc_unused ConstBuffer<const char *> args)
 {
 	assert(args.IsEmpty());
 
-	std::set<std::string> channels;
-	for (const auto &c : *client.partition.instance.client_list)
-		channels.insert(c.subscriptions.begin(),
-				c.subscriptions.end());
-
-	for (const auto &channel : channels)
-		client_printf(client, "channel: %s\n", channel.c_str());
+	for (const auto &i : client.partition.instance.client_list->GetChannels())
+		client_printf(client, "channel: %s\n", i.first.c_str());
 
 	return CommandResult::OK;
 }
@@ -100,7 +92,7 @@ handle_read_messages(Client &client,
 	assert(args.IsEmpty());
 
 	while (!client.messages.empty()) {
-		const ClientMessage &msg = client.messages.front();
+		const ClientMessage &msg = *client.messages.front();
 
 		client_printf(client, "channel: %s\nmessage: %s\n",
 			      msg.GetChannel(), msg.GetMessage());
@@ -124,11 +116,19 @@ handle_send_message(Client &client, ConstBuffer<const char *> args)
 		return CommandResult::ERROR;
 	}
 
+	const auto *subscribers =
+		client.partition.instance.client_list->FindSubscribers(channel_name);
+
 	bool sent = false;
-	const ClientMessage msg(channel_name, message_text);
-	for (auto &c : *client.partition.instance.client_list)
-		if (c.PushMessage(msg))
-			sent = true;
+	if (subscribers != nullptr) {
+		/* one copy of the message is shared by all
+		   subscribers */
+		const auto msg = std::make_shared<const ClientMessage>(channel_name,
+								       message_text);
+		for (Client *c : *subscribers)
+			if (c->PushMessage(msg))
+				sent = true;
+	}
 
 	if (sent)
 		return CommandResult::OK;
@@ -44,10 +44,15 @@
 #include "PlaylistFile.hxx"
 #include "db/PlaylistVector.hxx"
 #include "client/Client.hxx"
+#include "client/CompactRecord.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "Idle.hxx"
 
+#ifdef ENABLE_ZLIB
+#include "client/DeflateOutputFilter.hxx"
+#endif
+
 #ifdef ENABLE_DATABASE
 #include "DatabaseCommands.hxx"
 #include "db/Interface.hxx"
@@ -148,6 +153,7 @@ static constexpr tag_handler print_tag_handler = {
 	nullptr,
 	print_tag,
 	nullptr,
+	nullptr,
 };
 
 CommandResult
@@ -283,6 +289,12 @@ handle_update(Client &client, ConstBuffer<const char *> args, bool discard)
 	Database *db = client.partition.instance.database;
 	if (db != nullptr)
 		return handle_update(client, *db, path, discard);
+
+	if (client.partition.instance.IsDatabaseLoading()) {
+		command_error(client, ACK_ERROR_NO_EXIST,
+			      "Database is loading");
+		return CommandResult::ERROR;
+	}
 #else
 	(void)args;
 	(void)discard;
@@ -390,6 +402,61 @@ handle_password(Client &client, ConstBuffer<const char *> args)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_compact(Client &client, ConstBuffer<const char *> args)
+{
+	if (args.IsEmpty()) {
+		/* print the key table */
+		for (unsigned i = 0; i < COMPACT_OTHER; ++i) {
+			const char *name = compact_key_name(i);
+			if (name != nullptr)
+				client_printf(client, "compactkey: %u %s\n",
+					      i, name);
+		}
+
+		return CommandResult::OK;
+	}
+
+	bool status;
+	if (!check_bool(client, &status, args.front()))
+		return CommandResult::ERROR;
+
+	client.compact = status;
+	return CommandResult::OK;
+}
+
+#ifdef ENABLE_ZLIB
+
+CommandResult
+handle_deflate(Client &client, ConstBuffer<const char *> args)
+{
+	if (client.HasOutputFilter() ||
+	    client.pending_output_filter != nullptr) {
+		command_error(client, ACK_ERROR_ARG,
+			      "Compression is already enabled");
+		return CommandResult::ERROR;
+	}
+
+	/* small responses are not worth compressing; they are sent
+	   as "stored" deflate blocks */
+	unsigned threshold = 1024;
+	if (!args.IsEmpty() &&
+	    !check_unsigned(client, &threshold, args.front()))
+		return CommandResult::ERROR;
+
+	Error error;
+	std::unique_ptr<DeflateOutputFilter>
+		filter(new DeflateOutputFilter(Z_DEFAULT_COMPRESSION,
+					       threshold, error));
+	if (!filter->IsDefined())
+		return print_error(client, error);
+
+	client.pending_output_filter = std::move(filter);
+	return CommandResult::OK;
+}
+
+#endif
+
 CommandResult
 handle_config(Client &client, gcc_unused ConstBuffer<const char *> args)
 {
@@ -67,6 +67,14 @@ handle_ping(Client &client, ConstBuffer<const char *> args);
 CommandResult
 handle_password(Client &client, ConstBuffer<const char *> args);
 
+CommandResult
+handle_compact(Client &client, ConstBuffer<const char *> args);
+
+#ifdef ENABLE_ZLIB
+CommandResult
+handle_deflate(Client &client, ConstBuffer<const char *> args);
+#endif
+
 CommandResult
 handle_config(Client &client, ConstBuffer<const char *> args);
 
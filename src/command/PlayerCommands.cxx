@@ -31,6 +31,11 @@
 #include "AudioFormat.hxx"
 #include "ReplayGainConfig.hxx"
 #include "util/ConstBuffer.hxx"
+#include "client/ResponseStream.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "PlayerControl.hxx"
+
+#include <atomic>
 
 #ifdef ENABLE_DATABASE
 #include "db/update/Service.hxx"
@@ -55,6 +60,132 @@
 #define COMMAND_STATUS_MIXRAMPDELAY	"mixrampdelay"
 #define COMMAND_STATUS_AUDIO		"audio"
 #define COMMAND_STATUS_UPDATING_DB	"updating_db"
+#define COMMAND_STATUS_LOADING_DB	"loading_db"
+
+/**
+ * Delays the response of a command until the player thread has
+ * finished all pending commands (e.g. the decoder has seeked), while
+ * the event loop keeps serving other clients.
+ */
+class PlayerCommandStream final
+	: public ResponseStream, PlayerCommandWaiter, DeferredMonitor {
+public:
+	typedef CommandResult (*Handler)(Client &client);
+
+private:
+	Client &client;
+	PlayerControl &pc;
+
+	const char *const command;
+
+	/**
+	 * Generates the response after the player thread has
+	 * finished; nullptr sends just "OK".
+	 */
+	const Handler handler;
+
+	std::atomic_bool finished;
+
+public:
+	PlayerCommandStream(Client &_client, const char *_command,
+			    Handler _handler=nullptr)
+		:DeferredMonitor(*_client.partition.instance.event_loop),
+		 client(_client), pc(_client.player_control),
+		 command(_command), handler(_handler),
+		 finished(false) {}
+
+	~PlayerCommandStream() {
+		pc.RemoveWaiter(*this);
+	}
+
+	/**
+	 * @return false if the player thread has already finished
+	 * all commands
+	 */
+	bool Start() {
+		return pc.AddWaiter(*this);
+	}
+
+	/* virtual methods from class ResponseStream */
+	CommandResult Continue(gcc_unused Client &_client) override {
+		if (!finished.load(std::memory_order_acquire))
+			return CommandResult::DEFERRED;
+
+		if (handler == nullptr)
+			return CommandResult::OK;
+
+		/* we may be called after command_process() has
+		   returned */
+		current_command = command;
+		command_list_num = 0;
+
+		return handler(client);
+	}
+
+private:
+	/* virtual methods from class PlayerCommandWaiter */
+	void OnPlayerCommandsFinished() override {
+		finished.store(true, std::memory_order_release);
+		DeferredMonitor::Schedule();
+	}
+
+	/* virtual methods from class DeferredMonitor */
+	void RunDeferred() override {
+		/* this may delete this object */
+		client.ContinueResponse();
+	}
+};
+
+/**
+ * Finish a player command which has succeeded: if the player thread
+ * is still working on it, respond when it is done.  Inside a command
+ * list, the next command may depend on the result (e.g. "status"
+ * after "seek"), so this waits for the player thread.
+ */
+static CommandResult
+FinishPlayerCommand(Client &client, CommandResult result)
+{
+	if (result != CommandResult::OK)
+		return result;
+
+	if (client.cmd_list.IsActive()) {
+		client.player_control.LockWaitCommand();
+		return result;
+	}
+
+	auto *stream = new PlayerCommandStream(client, current_command);
+	if (!stream->Start()) {
+		delete stream;
+		return result;
+	}
+
+	client.SetResponseStream(stream);
+	return CommandResult::DEFERRED;
+}
+
+/**
+ * Run a command which reports the player's state.  While the player
+ * thread is still working on a command (submitted by another
+ * client), the response is generated after it has finished, without
+ * blocking the event loop.  Inside a command list,
+ * PlayerControl::GetStatus() waits for it.
+ */
+static CommandResult
+AfterPlayerCommands(Client &client, PlayerCommandStream::Handler handler)
+{
+	if (!client.cmd_list.IsActive()) {
+		auto *stream = new PlayerCommandStream(client, current_command,
+						       handler);
+		if (stream->Start()) {
+			client.SetResponseStream(stream);
+			return CommandResult::DEFERRED;
+		}
+
+		delete stream;
+	}
+
+	return handler(client);
+}
 
 CommandResult
 handle_play(Client &client, ConstBuffer<const char *> args)
@@ -64,7 +195,8 @@ handle_play(Client &client, ConstBuffer<const char *> args)
 	if (!args.IsEmpty() && !check_int(client, &song, args.front()))
 		return CommandResult::ERROR;
 	PlaylistResult result = client.partition.PlayPosition(song);
-	return print_playlist_result(client, result);
+	return FinishPlayerCommand(client,
+				   print_playlist_result(client, result));
 }
 
 CommandResult
@@ -76,7 +208,8 @@ handle_playid(Client &client, ConstBuffer<const char *> args)
 		return CommandResult::ERROR;
 
 	PlaylistResult result = client.partition.PlayId(id);
-	return print_playlist_result(client, result);
+	return FinishPlayerCommand(client,
+				   print_playlist_result(client, result));
 }
 
 CommandResult
@@ -86,13 +219,23 @@ handle_stop(Client &client, gcc_unused ConstBuffer<const char *> args)
 	return CommandResult::OK;
 }
 
-CommandResult
-handle_currentsong(Client &client, gcc_unused ConstBuffer<const char *> args)
+static CommandResult
+PrintCurrentSong(Client &client)
 {
+	/* wait for a pending "play" to report the song which is
+	   really playing */
+	client.player_control.LockWaitCommand();
+
 	playlist_print_current(client, client.playlist);
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_currentsong(Client &client, gcc_unused ConstBuffer<const char *> args)
+{
+	return AfterPlayerCommands(client, PrintCurrentSong);
+}
+
 CommandResult
 handle_pause(Client &client, ConstBuffer<const char *> args)
 {
@@ -108,8 +251,8 @@ handle_pause(Client &client, ConstBuffer<const char *> args)
 	return CommandResult::OK;
 }
 
-CommandResult
-handle_status(Client &client, gcc_unused ConstBuffer<const char *> args)
+static CommandResult
+PrintStatus(Client &client)
 {
 	const char *state = nullptr;
 	int song;
@@ -191,6 +334,12 @@ handle_status(Client &client, gcc_unused ConstBuffer<const char *> args)
 				      audio_format_to_string(player_status.audio_format,
 							     &af_string));
 		}
+
+		if (player_status.input_buffer_limit > 0)
+			client_printf(client,
+				      "input_buffer: %lu:%lu\n",
+				      (unsigned long)player_status.input_buffered,
+				      (unsigned long)player_status.input_buffer_limit);
 	}
 
 #ifdef ENABLE_DATABASE
@@ -203,6 +352,9 @@ handle_status(Client &client, gcc_unused ConstBuffer<const char *> args)
 			      COMMAND_STATUS_UPDATING_DB ": %i\n",
 			      updateJobId);
 	}
+
+	if (client.partition.instance.IsDatabaseLoading())
+		client_printf(client, COMMAND_STATUS_LOADING_DB ": 1\n");
 #endif
 
 	Error error = client.player_control.LockGetError();
@@ -222,6 +374,42 @@ handle_status(Client &client, gcc_unused ConstBuffer<const char *> args)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_status(Client &client, gcc_unused ConstBuffer<const char *> args)
+{
+	return AfterPlayerCommands(client, PrintStatus);
+}
+
+CommandResult
+handle_playerstats(Client &client, gcc_unused ConstBuffer<const char *> args)
+{
+	const auto s = client.player_control.GetStatistics();
+	const DecoderStatistics &d = s.decoder;
+
+	client_printf(client,
+		      "decoded: %1.3f\n"
+		      "decoder_time: %1.3f\n"
+		      "decoder_cpu: %1.3f\n"
+		      "decoder_speed: %1.2f\n"
+		      "buffer_wait: %1.3f\n"
+		      "input_wait: %1.3f\n"
+		      "stalls: %u\n"
+		      "pipe_fill:",
+		      d.GetDecodedDuration(),
+		      d.run_time / 1000000.,
+		      d.cpu_time / 1000000.,
+		      d.GetSpeed(),
+		      d.buffer_wait_time / 1000000.,
+		      d.input_wait_time / 1000000.,
+		      s.stalls);
+
+	for (unsigned i = 0; i < PlayerStatistics::PIPE_FILL_BUCKETS; ++i)
+		client_printf(client, " %u", s.pipe_fill[i]);
+
+	client_puts(client, "\n");
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_next(Client &client, gcc_unused ConstBuffer<const char *> args)
 {
@@ -235,14 +423,14 @@ handle_next(Client &client, gcc_unused ConstBuffer<const char *> args)
 	client.partition.PlayNext();
 
 	playlist.queue.single = single;
-	return CommandResult::OK;
+	return FinishPlayerCommand(client, CommandResult::OK);
 }
 
 CommandResult
 handle_previous(Client &client, gcc_unused ConstBuffer<const char *> args)
 {
 	client.partition.PlayPrevious();
-	return CommandResult::OK;
+	return FinishPlayerCommand(client, CommandResult::OK);
 }
 
 CommandResult
@@ -310,7 +498,8 @@ handle_seek(Client &client, ConstBuffer<const char *> args)
 
 	PlaylistResult result =
 		client.partition.SeekSongPosition(song, seek_time);
-	return print_playlist_result(client, result);
+	return FinishPlayerCommand(client,
+				   print_playlist_result(client, result));
 }
 
 CommandResult
@@ -326,7 +515,8 @@ handle_seekid(Client &client, ConstBuffer<const char *> args)
 
 	PlaylistResult result =
 		client.partition.SeekSongId(id, seek_time);
-	return print_playlist_result(client, result);
+	return FinishPlayerCommand(client,
+				   print_playlist_result(client, result));
 }
 
 CommandResult
@@ -340,7 +530,8 @@ handle_seekcur(Client &client, ConstBuffer<const char *> args)
 
 	PlaylistResult result =
 		client.partition.SeekCurrent(seek_time, relative);
-	return print_playlist_result(client, result);
+	return FinishPlayerCommand(client,
+				   print_playlist_result(client, result));
 }
 
 CommandResult
@@ -43,6 +43,9 @@ handle_pause(Client &client, ConstBuffer<const char *> args);
 CommandResult
 handle_status(Client &client, ConstBuffer<const char *> args);
 
+CommandResult
+handle_playerstats(Client &client, ConstBuffer<const char *> args);
+
 CommandResult
 handle_next(Client &client, ConstBuffer<const char *> args);
 
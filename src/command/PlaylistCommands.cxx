@@ -28,10 +28,14 @@
 #include "SongLoader.hxx"
 #include "BulkEdit.hxx"
 #include "playlist/PlaylistQueue.hxx"
+#include "playlist/PlaylistAny.hxx"
+#include "playlist/SongEnumerator.hxx"
+#include "playlist/MemorySongEnumerator.hxx"
 #include "playlist/Print.hxx"
 #include "queue/Playlist.hxx"
 #include "TimePrint.hxx"
 #include "client/Client.hxx"
+#include "client/BackgroundResponseStream.hxx"
 #include "protocol/ArgParser.hxx"
 #include "protocol/Result.hxx"
 #include "ls.hxx"
@@ -40,6 +44,27 @@
 #include "util/UriUtil.hxx"
 #include "util/Error.hxx"
 #include "util/ConstBuffer.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "DetachedSong.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <forward_list>
+#include <memory>
+#include <string>
+
+/**
+ * The number of songs sent by one StoredPlaylistPrintStream::Finish()
+ * call.
+ */
+static constexpr size_t PRINT_STREAM_BATCH = 1024;
+
+/**
+ * The number of parsed songs after which PlaylistLoadStream wakes up
+ * the main thread to append them to the queue.
+ */
+static constexpr unsigned LOAD_STREAM_BATCH = 256;
 
 bool
 playlist_commands_available()
@@ -67,6 +92,152 @@ handle_save(Client &client, ConstBuffer<const char *> args)
 		: print_error(client, error);
 }
 
+/**
+ * Reads a playlist with a playlist plugin in a separate thread, and
+ * appends the songs to the queue in portions while the thread is
+ * still parsing (e.g. a slow remote playlist).
+ */
+class PlaylistLoadStream final : public BackgroundResponseStream {
+	const std::string uri;
+	const unsigned start_index, end_index;
+
+#ifdef ENABLE_DATABASE
+	const Storage *const storage;
+#endif
+
+	/**
+	 * Protects #pending and #pending_tail.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Songs which have been parsed by the thread, but have not
+	 * yet been appended to the queue.
+	 */
+	std::forward_list<DetachedSong> pending;
+	std::forward_list<DetachedSong>::iterator pending_tail;
+
+	bool found;
+
+	/**
+	 * The first error which occurred while appending to the
+	 * queue; songs parsed after that are discarded.
+	 */
+	Error error;
+
+public:
+	PlaylistLoadStream(Client &_client, const char *_command,
+			   const char *_uri,
+			   unsigned _start_index, unsigned _end_index,
+			   gcc_unused const SongLoader &loader)
+		:BackgroundResponseStream(_client, _command),
+		 uri(_uri), start_index(_start_index), end_index(_end_index),
+#ifdef ENABLE_DATABASE
+		 storage(loader.GetStorage()),
+#endif
+		 pending_tail(pending.before_begin()),
+		 found(false) {}
+
+protected:
+	/* virtual methods from class BackgroundResponseStream */
+	void Run() override;
+	void OnProgress(Client &_client) override;
+	CommandResult Finish(Client &_client) override;
+
+private:
+	/**
+	 * Append all pending songs to the queue.
+	 */
+	void Flush(Client &_client);
+};
+
+void
+PlaylistLoadStream::Run()
+{
+	Mutex input_mutex;
+	Cond input_cond;
+
+	std::unique_ptr<SongEnumerator>
+		e(playlist_open_any(uri.c_str(),
+#ifdef ENABLE_DATABASE
+				    storage,
+#endif
+				    input_mutex, input_cond));
+	if (e == nullptr)
+		return;
+
+	found = true;
+
+	DetachedSong *song;
+	for (unsigned i = 0;
+	     i < end_index && (song = e->NextSong()) != nullptr; ++i) {
+		if (i < start_index) {
+			/* skip songs before the start index */
+			delete song;
+			continue;
+		}
+
+		{
+			const ScopeLock protect(mutex);
+			pending_tail = pending.emplace_after(pending_tail,
+							     std::move(*song));
+		}
+
+		delete song;
+
+		if ((i - start_index) % LOAD_STREAM_BATCH ==
+		    LOAD_STREAM_BATCH - 1)
+			/* let the main thread append this portion */
+			Progress();
+	}
+}
+
+void
+PlaylistLoadStream::Flush(Client &_client)
+{
+	std::forward_list<DetachedSong> songs;
+
+	{
+		const ScopeLock protect(mutex);
+		songs.swap(pending);
+		pending_tail = pending.before_begin();
+	}
+
+	if (songs.empty() || error.IsDefined())
+		return;
+
+	const ScopeBulkEdit bulk_edit(_client.partition);
+
+	const SongLoader loader(_client);
+	MemorySongEnumerator e(std::move(songs));
+	playlist_load_into_queue(uri.c_str(), e, 0, unsigned(-1),
+				 _client.playlist,
+				 _client.player_control, loader, error);
+}
+
+void
+PlaylistLoadStream::OnProgress(Client &_client)
+{
+	Flush(_client);
+}
+
+CommandResult
+PlaylistLoadStream::Finish(Client &_client)
+{
+	if (!found) {
+		error.Set(playlist_domain, int(PlaylistResult::NO_SUCH_LIST),
+			  "No such playlist");
+		return print_error(_client, error);
+	}
+
+	Flush(_client);
+
+	if (error.IsDefined())
+		return print_error(_client, error);
+
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_load(Client &client, ConstBuffer<const char *> args)
 {
@@ -78,10 +249,33 @@ handle_load(Client &client, ConstBuffer<const char *> args)
 	} else if (!check_range(client, &start_index, &end_index, args[1]))
 		return CommandResult::ERROR;
 
-	const ScopeBulkEdit bulk_edit(client.partition);
+	/* the playlist plugins parse the file */
+	spl_flush(args.front());
 
 	Error error;
 	const SongLoader loader(client);
+
+	if (!client.cmd_list.IsActive()) {
+		/* read the playlist in a separate thread, so the
+		   other clients are not blocked meanwhile; inside a
+		   command list, the response must be generated before
+		   the next command */
+		std::unique_ptr<PlaylistLoadStream>
+			stream(new PlaylistLoadStream(client, current_command,
+						      args.front(),
+						      start_index, end_index,
+						      loader));
+		if (stream->Start(error)) {
+			client.SetResponseStream(stream.release());
+			return CommandResult::DEFERRED;
+		}
+
+		LogError(error);
+		error.Clear();
+	}
+
+	const ScopeBulkEdit bulk_edit(client.partition);
+
 	if (!playlist_open_into_queue(args.front(),
 				      start_index, end_index,
 				      client.playlist,
@@ -91,34 +285,95 @@ handle_load(Client &client, ConstBuffer<const char *> args)
 	return CommandResult::OK;
 }
 
+/**
+ * Reads a stored playlist file in a separate thread, and then sends
+ * it to the client in portions.
+ */
+class StoredPlaylistPrintStream final : public BackgroundResponseStream {
+	const std::string name;
+	const bool detail;
+
+	PlaylistFileContents contents;
+	Error error;
+
+	/**
+	 * The number of songs which have been sent already.
+	 */
+	size_t position;
+
+public:
+	StoredPlaylistPrintStream(Client &_client, const char *_command,
+				  const char *_name, bool _detail)
+		:BackgroundResponseStream(_client, _command),
+		 name(_name), detail(_detail), position(0) {}
+
+protected:
+	/* virtual methods from class BackgroundResponseStream */
+	void Run() override {
+		contents = LoadPlaylistFile(name.c_str(), error);
+	}
+
+	CommandResult Finish(Client &_client) override;
+};
+
 CommandResult
-handle_listplaylist(Client &client, ConstBuffer<const char *> args)
+StoredPlaylistPrintStream::Finish(Client &_client)
 {
-	const char *const name = args.front();
+	if (contents.empty() && error.IsDefined())
+		return print_error(_client, error);
 
-	if (playlist_file_print(client, name, false))
-		return CommandResult::OK;
+	const size_t end = std::min(position + PRINT_STREAM_BATCH,
+				    contents.size());
+	spl_print_contents(_client, contents, position, end, detail);
+	position = end;
 
-	Error error;
-	return spl_print(client, name, false, error)
-		? CommandResult::OK
-		: print_error(client, error);
+	return position < contents.size()
+		? CommandResult::DEFERRED
+		: CommandResult::OK;
 }
 
-CommandResult
-handle_listplaylistinfo(Client &client, ConstBuffer<const char *> args)
+static CommandResult
+handle_listplaylist_common(Client &client, const char *name, bool detail)
 {
-	const char *const name = args.front();
+	/* the playlist plugins parse the file */
+	spl_flush(name);
 
-	if (playlist_file_print(client, name, true))
+	if (playlist_file_print(client, name, detail))
 		return CommandResult::OK;
 
 	Error error;
-	return spl_print(client, name, true, error)
+
+	if (!client.cmd_list.IsActive()) {
+		std::unique_ptr<StoredPlaylistPrintStream>
+			stream(new StoredPlaylistPrintStream(client,
+							     current_command,
+							     name, detail));
+		if (stream->Start(error)) {
+			client.SetResponseStream(stream.release());
+			return CommandResult::DEFERRED;
+		}
+
+		LogError(error);
+		error.Clear();
+	}
+
+	return spl_print(client, name, detail, error)
 		? CommandResult::OK
 		: print_error(client, error);
 }
 
+CommandResult
+handle_listplaylist(Client &client, ConstBuffer<const char *> args)
+{
+	return handle_listplaylist_common(client, args.front(), false);
+}
+
+CommandResult
+handle_listplaylistinfo(Client &client, ConstBuffer<const char *> args)
+{
+	return handle_listplaylist_common(client, args.front(), true);
+}
+
 CommandResult
 handle_rm(Client &client, ConstBuffer<const char *> args)
 {
@@ -28,10 +28,16 @@
 #include "CommandError.hxx"
 #include "protocol/Result.hxx"
 #include "client/Client.hxx"
+#include "client/BackgroundResponseStream.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "util/Error.hxx"
 #include "util/ConstBuffer.hxx"
+#include "Log.hxx"
+
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <string.h>
 
@@ -51,6 +57,63 @@ sticker_song_find_print_cb(const LightSong &song, const char *value,
 	sticker_print_value(data->client, data->name, value);
 }
 
+/**
+ * Runs the "sticker find" query in a separate thread, so a large
+ * sticker database does not block the other clients; the songs are
+ * looked up and printed by the main thread afterwards.
+ */
+class StickerFindStream final : public BackgroundResponseStream {
+	const std::string base_uri, name, value;
+	const StickerOperator op;
+
+	std::vector<SongStickerMatch> matches;
+
+	Error error;
+
+public:
+	StickerFindStream(Client &_client, const char *_command,
+			  const char *_base_uri, const char *_name,
+			  StickerOperator _op, const char *_value)
+		:BackgroundResponseStream(_client, _command),
+		 base_uri(_base_uri), name(_name),
+		 value(_value != nullptr ? _value : ""),
+		 op(_op) {}
+
+protected:
+	/* virtual methods from class BackgroundResponseStream */
+	void Run() override;
+	CommandResult Finish(Client &_client) override;
+};
+
+void
+StickerFindStream::Run()
+{
+	sticker_song_find_values(base_uri.c_str(), name.c_str(), op,
+				 op == StickerOperator::EXISTS
+				 ? nullptr : value.c_str(),
+				 matches, error);
+}
+
+CommandResult
+StickerFindStream::Finish(Client &_client)
+{
+	if (error.IsDefined())
+		return print_error(_client, error);
+
+	const Database *db = _client.GetDatabase(error);
+	if (db == nullptr)
+		return print_error(_client, error);
+
+	struct sticker_song_find_data data = {
+		_client,
+		name.c_str(),
+	};
+
+	sticker_song_visit_matches(*db, base_uri.c_str(), matches,
+				   sticker_song_find_print_cb, &data);
+	return CommandResult::OK;
+}
+
 static CommandResult
 handle_sticker_song(Client &client, ConstBuffer<const char *> args)
 {
@@ -166,6 +229,24 @@ handle_sticker_song(Client &client, ConstBuffer<const char *> args)
 			}
 		}
 
+		if (!client.cmd_list.IsActive()) {
+			/* query the sticker database in a separate
+			   thread; inside a command list, the response
+			   must be generated before the next command */
+			std::unique_ptr<StickerFindStream>
+				stream(new StickerFindStream(client,
+							     current_command,
+							     base_uri, args[3],
+							     op, value));
+			if (stream->Start(error)) {
+				client.SetResponseStream(stream.release());
+				return CommandResult::DEFERRED;
+			}
+
+			LogError(error);
+			error.Clear();
+		}
+
 		bool success;
 		struct sticker_song_find_data data = {
 			client,
@@ -249,6 +249,8 @@ handle_mount(Client &client, ConstBuffer<const char *> args)
 	}
 #endif
 
+	client.partition.StorageMountChanged(composite, local_uri);
+
 	return CommandResult::OK;
 }
 
@@ -294,5 +296,7 @@ handle_unmount(Client &client, ConstBuffer<const char *> args)
 
 	idle_add(IDLE_MOUNT);
 
+	client.partition.StorageMountChanged(composite, local_uri);
+
 	return CommandResult::OK;
 }
@@ -34,16 +34,23 @@ enum class ConfigOption {
 	FOLLOW_INSIDE_SYMLINKS,
 	FOLLOW_OUTSIDE_SYMLINKS,
 	DB_FILE,
+	DB_FILE_FORMAT,
+	DB_BACKGROUND_LOAD,
 	STICKER_FILE,
+	STICKER_SYNCHRONOUS,
 	LOG_FILE,
+	TRACE_FILE,
 	PID_FILE,
 	STATE_FILE,
 	STATE_FILE_INTERVAL,
 	RESTORE_PAUSED,
+	STATUS_PAGE,
 	USER,
 	GROUP,
 	BIND_TO_ADDRESS,
 	PORT,
+	METRICS_PORT,
+	METRICS_BIND_TO_ADDRESS,
 	LOG_LEVEL,
 	ZEROCONF_NAME,
 	ZEROCONF_ENABLED,
@@ -55,10 +62,17 @@ enum class ConfigOption {
 	REPLAYGAIN_PREAMP,
 	REPLAYGAIN_MISSING_PREAMP,
 	REPLAYGAIN_LIMIT,
+	LOUDNESS_ANALYSIS,
+	LOUDNESS_THREADS,
 	VOLUME_NORMALIZATION,
 	SAMPLERATE_CONVERTER,
 	AUDIO_BUFFER_SIZE,
+	AUDIO_BUFFER_BUDGET,
+	AUDIO_CHUNK_SIZE,
 	BUFFER_BEFORE_PLAY,
+	LATENCY_PROFILE,
+	LOCK_MEMORY,
+	PLAYER_CROSS_FADE,
 	HTTP_PROXY_HOST,
 	HTTP_PROXY_PORT,
 	HTTP_PROXY_USER,
@@ -68,6 +82,11 @@ enum class ConfigOption {
 	MAX_PLAYLIST_LENGTH,
 	MAX_COMMAND_LIST_SIZE,
 	MAX_OUTPUT_BUFFER_SIZE,
+	MAX_SUBSCRIPTIONS,
+	MAX_MESSAGES,
+	SLOW_COMMAND_THRESHOLD,
+	IDLE_COALESCE,
+	IDLE_MIN_INTERVAL,
 	FS_CHARSET,
 	ID3V1_ENCODING,
 	METADATA_TO_USE,
@@ -75,6 +94,9 @@ enum class ConfigOption {
 	GAPLESS_MP3_PLAYBACK,
 	AUTO_UPDATE,
 	AUTO_UPDATE_DEPTH,
+	UPDATE_THREADS,
+	UPDATE_TRUST_STAT,
+	UPDATE_TRUST_DIRECTORY_MTIME,
 	DESPOTIFY_USER,
 	DESPOTIFY_PASSWORD,
 	DESPOTIFY_HIGH_BITRATE,
@@ -90,6 +112,8 @@ enum class ConfigBlockOption {
 	AUDIO_FILTER,
 	DATABASE,
 	NEIGHBORS,
+	INPUT_CACHE,
+	THREAD,
 	MAX
 };
 
@@ -29,16 +29,23 @@ const ConfigTemplate config_param_templates[] = {
 	{ "follow_inside_symlinks", false },
 	{ "follow_outside_symlinks", false },
 	{ "db_file", false },
+	{ "db_file_format", false },
+	{ "db_background_load", false },
 	{ "sticker_file", false },
+	{ "sticker_synchronous", false },
 	{ "log_file", false },
+	{ "trace_file", false },
 	{ "pid_file", false },
 	{ "state_file", false },
 	{ "state_file_interval", false },
 	{ "restore_paused", false },
+	{ "status_page", false },
 	{ "user", false },
 	{ "group", false },
 	{ "bind_to_address", true },
 	{ "port", false },
+	{ "metrics_port", false },
+	{ "metrics_bind_to_address", false },
 	{ "log_level", false },
 	{ "zeroconf_name", false },
 	{ "zeroconf_enabled", false },
@@ -50,10 +57,17 @@ const ConfigTemplate config_param_templates[] = {
 	{ "replaygain_preamp", false },
 	{ "replaygain_missing_preamp", false },
 	{ "replaygain_limit", false },
+	{ "loudness_analysis", false },
+	{ "loudness_threads", false },
 	{ "volume_normalization", false },
 	{ "samplerate_converter", false },
 	{ "audio_buffer_size", false },
+	{ "audio_buffer_budget", false },
+	{ "audio_chunk_size", false },
 	{ "buffer_before_play", false },
+	{ "latency_profile", false },
+	{ "lock_memory", false },
+	{ "player_cross_fade", false },
 	{ "http_proxy_host", false },
 	{ "http_proxy_port", false },
 	{ "http_proxy_user", false },
@@ -63,6 +77,11 @@ const ConfigTemplate config_param_templates[] = {
 	{ "max_playlist_length", false },
 	{ "max_command_list_size", false },
 	{ "max_output_buffer_size", false },
+	{ "max_subscriptions", false },
+	{ "max_messages", false },
+	{ "slow_command_threshold", false },
+	{ "idle_coalesce", false },
+	{ "idle_min_interval", false },
 	{ "filesystem_charset", false },
 	{ "id3v1_encoding", false },
 	{ "metadata_to_use", false },
@@ -70,6 +89,9 @@ const ConfigTemplate config_param_templates[] = {
 	{ "gapless_mp3_playback", false },
 	{ "auto_update", false },
 	{ "auto_update_depth", false },
+	{ "update_threads", false },
+	{ "update_trust_stat", false },
+	{ "update_trust_directory_mtime", false },
 	{ "despotify_user", false },
 	{ "despotify_password", false },
 	{ "despotify_high_bitrate", false },
@@ -90,6 +112,8 @@ const ConfigTemplate config_block_templates[] = {
 	{ "filter", true },
 	{ "database", false },
 	{ "neighbors", true },
+	{ "input_cache", false },
+	{ "thread", true },
 };
 
 static constexpr unsigned n_config_block_templates =
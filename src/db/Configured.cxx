@@ -35,6 +35,7 @@ CreateConfiguredDatabase(EventLoop &loop, DatabaseListener &listener,
 {
 	const auto *param = config_get_block(ConfigBlockOption::DATABASE);
 	const auto *path = config_get_param(ConfigOption::DB_FILE);
+	const auto *format = config_get_param(ConfigOption::DB_FILE_FORMAT);
 
 	if (param != nullptr && path != nullptr) {
 		error.Format(config_domain,
@@ -43,6 +44,13 @@ CreateConfiguredDatabase(EventLoop &loop, DatabaseListener &listener,
 		return nullptr;
 	}
 
+	if (param != nullptr && format != nullptr) {
+		error.Format(config_domain,
+			     "Found both 'database' (line %d) and 'db_file_format' (line %d) setting",
+			     param->line, format->line);
+		return nullptr;
+	}
+
 	ConfigBlock *allocated = nullptr;
 
 	if (param == nullptr && path != nullptr) {
@@ -70,6 +78,10 @@ CreateConfiguredDatabase(EventLoop &loop, DatabaseListener &listener,
 		param = allocated;
 	}
 
+	if (format != nullptr)
+		allocated->AddBlockParam("format", format->value.c_str(),
+					 format->line);
+
 	Database *db = DatabaseGlobalInit(loop, listener, *param,
 					  error);
 	delete allocated;
@@ -21,23 +21,11 @@
 #include "Count.hxx"
 #include "Selection.hxx"
 #include "Interface.hxx"
+#include "Stats.hxx"
 #include "client/Client.hxx"
 #include "LightSong.hxx"
-#include "tag/Tag.hxx"
 
 #include <functional>
-#include <map>
-
-struct SearchStats {
-	unsigned n_songs;
-	std::chrono::duration<std::uint64_t, SongTime::period> total_duration;
-
-	constexpr SearchStats()
-		:n_songs(0), total_duration(0) {}
-};
-
-class TagCountMap : public std::map<std::string, SearchStats> {
-};
 
 static void
 PrintSearchStats(Client &client, const SearchStats &stats)
@@ -51,16 +39,15 @@ PrintSearchStats(Client &client, const SearchStats &stats)
 		      stats.n_songs, total_duration_s);
 }
 
-static void
-Print(Client &client, TagType group, const TagCountMap &m)
+static bool
+PrintGroup(Client &client, TagType group,
+	   const char *value, const SearchStats &stats)
 {
 	assert(unsigned(group) < TAG_NUM_OF_ITEM_TYPES);
 
-	for (const auto &i : m) {
-		client_printf(client, "%s: %s\n",
-			      tag_item_names[group], i.first.c_str());
-		PrintSearchStats(client, i.second);
-	}
+	client_printf(client, "%s: %s\n", tag_item_names[group], value);
+	PrintSearchStats(client, stats);
+	return true;
 }
 
 static bool
@@ -75,39 +62,6 @@ stats_visitor_song(SearchStats &stats, const LightSong &song)
 	return true;
 }
 
-static bool
-CollectGroupCounts(TagCountMap &map, TagType group, const Tag &tag)
-{
-	bool found = false;
-	for (const auto &item : tag) {
-		if (item.type == group) {
-			auto r = map.insert(std::make_pair(item.value,
-							   SearchStats()));
-			SearchStats &s = r.first->second;
-			++s.n_songs;
-			if (!tag.duration.IsNegative())
-				s.total_duration += tag.duration;
-
-			found = true;
-		}
-	}
-
-	return found;
-}
-
-static bool
-GroupCountVisitor(TagCountMap &map, TagType group, const LightSong &song)
-{
-	assert(song.tag != nullptr);
-
-	const Tag &tag = *song.tag;
-	if (!CollectGroupCounts(map, group, tag) && group == TAG_ALBUM_ARTIST)
-		/* fall back to "Artist" if no "AlbumArtist" was found */
-		CollectGroupCounts(map, TAG_ARTIST, tag);
-
-	return true;
-}
-
 bool
 PrintSongCount(Client &client, const char *name,
 	       const SongFilter *filter,
@@ -133,18 +87,14 @@ PrintSongCount(Client &client, const char *name,
 
 		PrintSearchStats(client, stats);
 	} else {
-		/* group by the specified tag: store counts in a
-		   std::map */
-
-		TagCountMap map;
+		/* group by the specified tag; the database may have
+		   the counts already */
 
 		using namespace std::placeholders;
-		const auto f = std::bind(GroupCountVisitor, std::ref(map),
-					 group, _1);
-		if (!db->Visit(selection, f, error))
+		const auto f = std::bind(PrintGroup, std::ref(client),
+					 group, _1, _2);
+		if (!db->VisitTagCounts(selection, group, f, error))
 			return false;
-
-		Print(client, group, map);
 	}
 
 	return true;
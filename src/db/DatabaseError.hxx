@@ -32,6 +32,18 @@ enum db_error {
 	DB_NOT_FOUND,
 
 	DB_CONFLICT,
+
+	/**
+	 * The database is still being loaded in the background
+	 * (see #DatabaseLoader).
+	 */
+	DB_LOADING,
+
+	/**
+	 * The database has been modified while a
+	 * #DatabaseWalkCursor was visiting it.
+	 */
+	DB_MODIFIED,
 };
 
 extern const Domain db_domain;
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "DatabaseLoader.hxx"
+#include "Interface.hxx"
+#include "thread/Name.hxx"
+#include "ThreadConfig.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <chrono>
+
+static constexpr Domain db_loader_domain("db_loader");
+
+DatabaseLoader::~DatabaseLoader()
+{
+	if (thread.IsDefined()) {
+		thread.Join();
+
+		if (success)
+			db.Close();
+	}
+}
+
+bool
+DatabaseLoader::Start(Error &_error)
+{
+	assert(!thread.IsDefined());
+
+	return thread.Start(Run, this, _error);
+}
+
+inline void
+DatabaseLoader::Run()
+{
+	SetThreadName("db_load");
+	ApplyThreadConfig("update");
+
+	const auto start_time = std::chrono::steady_clock::now();
+
+	success = db.Open(error);
+
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start_time;
+	FormatDebug(db_loader_domain, "database loaded in %.1f s",
+		    duration.count());
+
+	DeferredMonitor::Schedule();
+}
+
+void
+DatabaseLoader::Run(void *ctx)
+{
+	DatabaseLoader &loader = *(DatabaseLoader *)ctx;
+	loader.Run();
+}
+
+void
+DatabaseLoader::RunDeferred()
+{
+	thread.Join();
+	callback(*this);
+}
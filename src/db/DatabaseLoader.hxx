@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DATABASE_LOADER_HXX
+#define MPD_DATABASE_LOADER_HXX
+
+#include "check.h"
+#include "event/DeferredMonitor.hxx"
+#include "thread/Thread.hxx"
+#include "util/Error.hxx"
+
+class Database;
+
+/**
+ * Calls Database::Open() in a separate thread, to allow MPD to serve
+ * clients while a large database file is being loaded.  When the
+ * thread finishes, the callback is invoked in the #EventLoop thread.
+ *
+ * Only database plugins which do not use the #EventLoop in Open()
+ * may be loaded this way.
+ */
+class DatabaseLoader final : DeferredMonitor {
+public:
+	typedef void (*Callback)(DatabaseLoader &loader);
+
+private:
+	Database &db;
+
+	const Callback callback;
+
+	Thread thread;
+
+	/**
+	 * The result of Database::Open().  Only valid in the
+	 * callback.
+	 */
+	bool success;
+
+	Error error;
+
+public:
+	DatabaseLoader(EventLoop &_loop, Database &_db, Callback _callback)
+		:DeferredMonitor(_loop), db(_db), callback(_callback),
+		 success(false) {}
+
+	/**
+	 * Waits for the thread to finish.  If the callback has not
+	 * been invoked yet, the #Database is closed (but not
+	 * deleted).
+	 */
+	~DatabaseLoader();
+
+	Database &GetDatabase() {
+		return db;
+	}
+
+	bool IsSuccess() const {
+		return success;
+	}
+
+	Error &GetError() {
+		return error;
+	}
+
+	bool Start(Error &error);
+
+private:
+	void Run();
+	static void Run(void *ctx);
+
+	/* virtual methods from class DeferredMonitor */
+	virtual void RunDeferred() override;
+};
+
+#endif
@@ -19,9 +19,43 @@
 
 #include "config.h"
 #include "DatabaseLock.hxx"
+#include "system/Clock.hxx"
 
-Mutex db_mutex;
+SharedMutex db_mutex;
+
+std::atomic_ulong db_lock_shared_count, db_lock_exclusive_count;
+static std::atomic_ulong db_lock_contended_count, db_lock_wait_us;
+
+bool db_lock_timing;
+thread_local uint64_t db_lock_held_us, db_lock_since_us;
 
 #ifndef NDEBUG
 ThreadId db_mutex_holder;
+thread_local bool db_mutex_shared;
 #endif
+
+void
+db_lock_wait(bool shared)
+{
+	const uint64_t start = MonotonicClockUS();
+
+	if (shared)
+		db_mutex.lock_shared();
+	else
+		db_mutex.lock();
+
+	db_lock_contended_count.fetch_add(1, std::memory_order_relaxed);
+	db_lock_wait_us.fetch_add(MonotonicClockUS() - start,
+				  std::memory_order_relaxed);
+}
+
+DatabaseLockStats
+db_lock_get_stats()
+{
+	return {
+		db_lock_shared_count.load(std::memory_order_relaxed),
+		db_lock_exclusive_count.load(std::memory_order_relaxed),
+		db_lock_contended_count.load(std::memory_order_relaxed),
+		db_lock_wait_us.load(std::memory_order_relaxed),
+	};
+}
@@ -27,12 +27,59 @@
 #define MPD_DB_LOCK_HXX
 
 #include "check.h"
-#include "thread/Mutex.hxx"
+#include "thread/SharedMutex.hxx"
+#include "system/Clock.hxx"
 #include "Compiler.h"
 
+#include <atomic>
+
 #include <assert.h>
 
-extern Mutex db_mutex;
+/**
+ * The global database lock.  Readers may share it (db_lock_shared()),
+ * but modifications require exclusive access (db_lock()).
+ */
+extern SharedMutex db_mutex;
+
+/**
+ * Counters describing how the #db_mutex is used; see
+ * db_lock_get_stats().
+ */
+struct DatabaseLockStats {
+	unsigned long shared, exclusive;
+
+	/**
+	 * The number of acquisitions which had to wait for another
+	 * thread.
+	 */
+	unsigned long contended;
+
+	/**
+	 * The total time spent waiting for the lock [microseconds].
+	 */
+	unsigned long wait_us;
+};
+
+extern std::atomic_ulong db_lock_shared_count, db_lock_exclusive_count;
+
+/**
+ * Measure how long each thread holds the lock?  This is enabled at
+ * startup by the slow command log, and must not be changed while
+ * the lock is held.
+ */
+extern bool db_lock_timing;
+
+/**
+ * The total time the current thread has held the lock
+ * [microseconds].  Only updated if #db_lock_timing is enabled.
+ */
+extern thread_local uint64_t db_lock_held_us;
+
+/**
+ * The MonotonicClockUS() value when the current thread has obtained
+ * the lock.
+ */
+extern thread_local uint64_t db_lock_since_us;
 
 #ifndef NDEBUG
 
@@ -41,27 +88,57 @@ extern Mutex db_mutex;
 extern ThreadId db_mutex_holder;
 
 /**
- * Does the current thread hold the database lock?
+ * Does the current thread hold the shared database lock?
+ */
+extern thread_local bool db_mutex_shared;
+
+/**
+ * Does the current thread hold the exclusive database lock?
  */
 gcc_pure
 static inline bool
-holding_db_lock(void)
+holding_db_lock_exclusive(void)
 {
 	return db_mutex_holder.IsInside();
 }
 
+/**
+ * Does the current thread hold the database lock (shared or
+ * exclusive)?
+ */
+gcc_pure
+static inline bool
+holding_db_lock(void)
+{
+	return holding_db_lock_exclusive() || db_mutex_shared;
+}
+
 #endif
 
 /**
- * Obtain the global database lock.  This is needed before
- * dereferencing a #song or #directory.  It is not recursive.
+ * Block until the lock becomes available, and account for the time
+ * spent waiting.  Called by db_lock() and db_lock_shared() after the
+ * non-blocking attempt has failed.
+ */
+void
+db_lock_wait(bool shared);
+
+/**
+ * Obtain the global database lock exclusively.  This is needed
+ * before modifying a #song or #directory.  It is not recursive.
  */
 static inline void
 db_lock(void)
 {
 	assert(!holding_db_lock());
 
-	db_mutex.lock();
+	if (!db_mutex.try_lock())
+		db_lock_wait(false);
+
+	db_lock_exclusive_count.fetch_add(1, std::memory_order_relaxed);
+
+	if (db_lock_timing)
+		db_lock_since_us = MonotonicClockUS();
 
 	assert(db_mutex_holder.IsNull());
 #ifndef NDEBUG
@@ -75,14 +152,61 @@ db_lock(void)
 static inline void
 db_unlock(void)
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 #ifndef NDEBUG
 	db_mutex_holder = ThreadId::Null();
 #endif
 
+	if (db_lock_timing)
+		db_lock_held_us += MonotonicClockUS() - db_lock_since_us;
+
 	db_mutex.unlock();
 }
 
+/**
+ * Obtain the global database lock for reading.  This is needed
+ * before dereferencing a #song or #directory.  Other readers may
+ * hold it at the same time.  It is not recursive.
+ */
+static inline void
+db_lock_shared(void)
+{
+	assert(!holding_db_lock());
+
+	if (!db_mutex.try_lock_shared())
+		db_lock_wait(true);
+
+	db_lock_shared_count.fetch_add(1, std::memory_order_relaxed);
+
+	if (db_lock_timing)
+		db_lock_since_us = MonotonicClockUS();
+
+#ifndef NDEBUG
+	db_mutex_shared = true;
+#endif
+}
+
+/**
+ * Release the shared database lock.
+ */
+static inline void
+db_unlock_shared(void)
+{
+	assert(db_mutex_shared);
+#ifndef NDEBUG
+	db_mutex_shared = false;
+#endif
+
+	if (db_lock_timing)
+		db_lock_held_us += MonotonicClockUS() - db_lock_since_us;
+
+	db_mutex.unlock_shared();
+}
+
+gcc_pure
+DatabaseLockStats
+db_lock_get_stats();
+
 class ScopeDatabaseLock {
 public:
 	ScopeDatabaseLock() {
@@ -94,4 +218,15 @@ public:
 	}
 };
 
+class ScopeDatabaseSharedLock {
+public:
+	ScopeDatabaseSharedLock() {
+		db_lock_shared();
+	}
+
+	~ScopeDatabaseSharedLock() {
+		db_unlock_shared();
+	}
+};
+
 #endif
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "DatabasePrint.hxx"
 #include "Selection.hxx"
+#include "WalkCursor.hxx"
 #include "SongFilter.hxx"
 #include "SongPrint.hxx"
 #include "TimePrint.hxx"
@@ -29,9 +30,19 @@
 #include "LightDirectory.hxx"
 #include "PlaylistInfo.hxx"
 #include "Interface.hxx"
+#include "DatabaseError.hxx"
 #include "fs/Traits.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
 
+#include <algorithm>
 #include <functional>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
 
 static const char *
 ApplyBaseFlag(const char *uri, bool base)
@@ -145,11 +156,36 @@ PrintPlaylistFull(Client &client, bool base,
 	return true;
 }
 
+/**
+ * This pseudo error is used to abort the visit after the end of the
+ * window.
+ */
+static constexpr Domain window_end_domain("window_end");
+
+/**
+ * Count the visited entity.
+ *
+ * @param print_r set to true if the entity is inside the window
+ * @return false if the end of the window has been reached
+ */
+static bool
+CheckWindow(unsigned &i, unsigned window_start, unsigned window_end,
+	    bool &print_r, Error &error)
+{
+	if (i >= window_end) {
+		error.Set(window_end_domain, "End of window");
+		return false;
+	}
+
+	print_r = i++ >= window_start;
+	return true;
+}
+
 bool
 db_selection_print(Client &client, const DatabaseSelection &selection,
 		   bool full, bool base,
 		   unsigned window_start, unsigned window_end,
-		   Error &error)
+		   bool &more_r, Error &error)
 {
 	const Database *db = client.GetDatabase(error);
 	if (db == nullptr)
@@ -158,27 +194,76 @@ db_selection_print(Client &client, const DatabaseSelection &selection,
 	unsigned i = 0;
 
 	using namespace std::placeholders;
-	const auto d = selection.filter == nullptr
+	VisitDirectory d = selection.filter == nullptr
 		? std::bind(full ? PrintDirectoryFull : PrintDirectoryBrief,
 			    std::ref(client), base, _1)
 		: VisitDirectory();
 	VisitSong s = std::bind(full ? PrintSongFull : PrintSongBrief,
 				std::ref(client), base, _1);
-	const auto p = selection.filter == nullptr
+	VisitPlaylist p = selection.filter == nullptr
 		? std::bind(full ? PrintPlaylistFull : PrintPlaylistBrief,
 			    std::ref(client), base, _1, _2)
 		: VisitPlaylist();
 
 	if (window_start > 0 ||
-	    window_end < (unsigned)std::numeric_limits<int>::max())
+	    window_end < (unsigned)std::numeric_limits<int>::max()) {
+		if (d)
+			d = [d, window_start, window_end, &i]
+				(const LightDirectory &directory,
+				 Error &error2){
+				/* the root directory is not printed, and
+				   thus not counted */
+				if (directory.IsRoot())
+					return true;
+
+				bool print;
+				return CheckWindow(i, window_start, window_end,
+						   print, error2) &&
+					(!print || d(directory, error2));
+			};
+
 		s = [s, window_start, window_end, &i](const LightSong &song,
 						      Error &error2){
-			const bool in_window = i >= window_start && i < window_end;
-			++i;
-			return !in_window || s(song, error2);
+			bool print;
+			return CheckWindow(i, window_start, window_end,
+					   print, error2) &&
+				(!print || s(song, error2));
 		};
 
-	return db->Visit(selection, d, s, p, error);
+		if (p)
+			p = [p, window_start, window_end, &i]
+				(const PlaylistInfo &playlist,
+				 const LightDirectory &directory,
+				 Error &error2){
+				bool print;
+				return CheckWindow(i, window_start, window_end,
+						   print, error2) &&
+					(!print || p(playlist, directory,
+						     error2));
+			};
+	}
+
+	more_r = false;
+	if (!db->Visit(selection, d, s, p, error)) {
+		if (!error.IsDomain(window_end_domain))
+			return false;
+
+		error.Clear();
+		more_r = true;
+	}
+
+	return true;
+}
+
+bool
+db_selection_print(Client &client, const DatabaseSelection &selection,
+		   bool full, bool base,
+		   unsigned window_start, unsigned window_end,
+		   Error &error)
+{
+	bool more;
+	return db_selection_print(client, selection, full, base,
+				  window_start, window_end, more, error);
 }
 
 bool
@@ -191,6 +276,197 @@ db_selection_print(Client &client, const DatabaseSelection &selection,
 				  error);
 }
 
+bool
+db_cursor_print(Client &client, DatabaseWalkCursor &cursor,
+		bool full, unsigned limit, Error &error)
+{
+	const Database *db = client.GetDatabase(error);
+	if (db == nullptr)
+		return false;
+
+	const bool base = false;
+
+	using namespace std::placeholders;
+	const VisitDirectory d = cursor.GetFilter() == nullptr
+		? std::bind(full ? PrintDirectoryFull : PrintDirectoryBrief,
+			    std::ref(client), base, _1)
+		: VisitDirectory();
+	const VisitSong s = std::bind(full ? PrintSongFull : PrintSongBrief,
+				      std::ref(client), base, _1);
+	const VisitPlaylist p = cursor.GetFilter() == nullptr
+		? std::bind(full ? PrintPlaylistFull : PrintPlaylistBrief,
+			    std::ref(client), base, _1, _2)
+		: VisitPlaylist();
+
+	return cursor.Visit(*db, limit, d, s, p, error);
+}
+
+/**
+ * A song collected by #SongSorter.  Only the sort key and the URI are
+ * copied; the song is looked up again for printing.
+ */
+struct SortedSong {
+	std::string value;
+
+	/**
+	 * The numeric sort key for #TAG_TRACK, #TAG_DISC and
+	 * #SORT_TAG_LAST_MODIFIED.
+	 */
+	long number;
+
+	/**
+	 * The position in the database walk, which makes the sort
+	 * stable.
+	 */
+	unsigned sequence;
+
+	std::string uri;
+};
+
+/**
+ * Selects the first #limit songs in sort order with a bounded
+ * max-heap: a song is copied only if it sorts before the last one
+ * which has been kept so far.
+ */
+class SongSorter {
+	const unsigned sort;
+	const bool descending;
+	const size_t limit;
+
+	unsigned sequence = 0;
+
+	std::vector<SortedSong> heap;
+
+public:
+	SongSorter(unsigned _sort, bool _descending, size_t _limit)
+		:sort(_sort), descending(_descending), limit(_limit) {}
+
+	bool Add(const LightSong &song);
+
+	/**
+	 * Returns the collected songs in sort order.
+	 */
+	std::vector<SortedSong> &Finish() {
+		std::sort_heap(heap.begin(), heap.end(), Compare{*this});
+		return heap;
+	}
+
+private:
+	bool IsNumeric() const {
+		return sort == SORT_TAG_LAST_MODIFIED ||
+			sort == TAG_TRACK || sort == TAG_DISC;
+	}
+
+	gcc_pure
+	bool Less(const char *a_value, long a_number, unsigned a_sequence,
+		  const SortedSong &b) const {
+		int cmp = IsNumeric()
+			? (a_number > b.number) - (a_number < b.number)
+			: strcmp(a_value, b.value.c_str());
+		if (descending)
+			cmp = -cmp;
+
+		return cmp < 0 || (cmp == 0 && a_sequence < b.sequence);
+	}
+
+	struct Compare {
+		const SongSorter &sorter;
+
+		bool operator()(const SortedSong &a,
+				const SortedSong &b) const {
+			return sorter.Less(a.value.c_str(), a.number,
+					   a.sequence, b);
+		}
+	};
+};
+
+bool
+SongSorter::Add(const LightSong &song)
+{
+	const unsigned song_sequence = sequence++;
+
+	const char *value = "";
+	long number = 0;
+	if (sort == SORT_TAG_LAST_MODIFIED) {
+		number = song.mtime;
+	} else {
+		value = song.tag->GetValue(TagType(sort));
+		if (value == nullptr && sort == TAG_ALBUM_ARTIST)
+			value = song.tag->GetValue(TAG_ARTIST);
+		if (value == nullptr)
+			value = "";
+
+		if (IsNumeric())
+			number = strtol(value, nullptr, 10);
+	}
+
+	if (heap.size() >= limit) {
+		if (heap.empty() ||
+		    !Less(value, number, song_sequence, heap.front()))
+			return true;
+
+		std::pop_heap(heap.begin(), heap.end(), Compare{*this});
+		heap.pop_back();
+	}
+
+	heap.push_back({value, number, song_sequence, song.GetURI()});
+	std::push_heap(heap.begin(), heap.end(), Compare{*this});
+	return true;
+}
+
+bool
+db_selection_print_sorted(Client &client, const DatabaseSelection &selection,
+			  bool full, unsigned sort, bool descending,
+			  unsigned window_start, unsigned window_end,
+			  Error &error)
+{
+	assert(sort < TAG_NUM_OF_ITEM_TYPES || sort == SORT_TAG_LAST_MODIFIED);
+
+	const Database *db = client.GetDatabase(error);
+	if (db == nullptr)
+		return false;
+
+	SongSorter sorter(sort, descending, window_end);
+
+	using namespace std::placeholders;
+	const auto f = std::bind(&SongSorter::Add, &sorter, _1);
+	if (!db->Visit(selection, f, error))
+		return false;
+
+	const auto &songs = sorter.Finish();
+	if (window_start >= songs.size())
+		return true;
+
+	std::vector<const char *> uris;
+	uris.reserve(songs.size() - window_start);
+	for (size_t i = window_start; i < songs.size(); ++i)
+		uris.push_back(songs[i].uri.c_str());
+
+	db->Prefetch(ConstBuffer<const char *>(uris.data(), uris.size()));
+
+	for (const char *uri : uris) {
+		const LightSong *song = db->GetSong(uri, error);
+		if (song == nullptr) {
+			if (!error.IsDomain(db_domain) ||
+			    error.GetCode() != DB_NOT_FOUND)
+				return false;
+
+			/* deleted by the update thread meanwhile */
+			error.Clear();
+			continue;
+		}
+
+		if (full)
+			PrintSongFull(client, false, *song);
+		else
+			PrintSongBrief(client, false, *song);
+
+		db->ReturnSong(song);
+	}
+
+	return true;
+}
+
 static bool
 PrintSongURIVisitor(Client &client, const LightSong &song)
 {
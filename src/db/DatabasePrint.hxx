@@ -20,12 +20,20 @@
 #ifndef MPD_DB_PRINT_H
 #define MPD_DB_PRINT_H
 
+#include "tag/TagType.h"
 #include "Compiler.h"
 
 #include <stdint.h>
 
+/**
+ * Sort by the modification time instead of a tag, see
+ * db_selection_print_sorted().
+ */
+#define SORT_TAG_LAST_MODIFIED (TAG_NUM_OF_ITEM_TYPES + 3)
+
 class SongFilter;
 struct DatabaseSelection;
+class DatabaseWalkCursor;
 class Client;
 class Error;
 
@@ -37,12 +45,53 @@ bool
 db_selection_print(Client &client, const DatabaseSelection &selection,
 		   bool full, bool base, Error &error);
 
+/**
+ * Print only the entities (directories, songs and playlists) in the
+ * range [window_start, window_end).
+ */
 bool
 db_selection_print(Client &client, const DatabaseSelection &selection,
 		   bool full, bool base,
 		   unsigned window_start, unsigned window_end,
 		   Error &error);
 
+/**
+ * Like above, but stops visiting after the end of the window.
+ *
+ * @param more_r set to true if there are more entities after
+ * #window_end
+ */
+bool
+db_selection_print(Client &client, const DatabaseSelection &selection,
+		   bool full, bool base,
+		   unsigned window_start, unsigned window_end,
+		   bool &more_r, Error &error);
+
+/**
+ * Print the next portion of a listing.
+ *
+ * @param limit the maximum number of entities to be printed
+ */
+bool
+db_cursor_print(Client &client, DatabaseWalkCursor &cursor,
+		bool full, unsigned limit, Error &error);
+
+/**
+ * Print the songs of the selection in the range [window_start,
+ * window_end) of the sorted list.  Only the first #window_end songs
+ * are kept in a bounded heap while visiting, and only the songs in
+ * the window are looked up and printed.
+ *
+ * @param sort the tag to sort by, or #SORT_TAG_LAST_MODIFIED
+ * @param descending reverse the order (songs with the same value
+ * remain in database order)
+ */
+bool
+db_selection_print_sorted(Client &client, const DatabaseSelection &selection,
+			  bool full, unsigned sort, bool descending,
+			  unsigned window_start, unsigned window_end,
+			  Error &error);
+
 bool
 PrintUniqueTags(Client &client, unsigned type, uint32_t group_mask,
 		const SongFilter *filter,
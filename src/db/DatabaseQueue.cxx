@@ -25,19 +25,7 @@
 #include "Instance.hxx"
 #include "DetachedSong.hxx"
 
-#include <functional>
-
-static bool
-AddToQueue(Partition &partition, const LightSong &song, Error &error)
-{
-	const Storage &storage = *partition.instance.storage;
-	unsigned id =
-		partition.playlist.AppendSong(partition.pc,
-					      DatabaseDetachSong(storage,
-								 song),
-					      error);
-	return id != 0;
-}
+#include <vector>
 
 bool
 AddFromDatabase(Partition &partition, const DatabaseSelection &selection,
@@ -47,7 +35,33 @@ AddFromDatabase(Partition &partition, const DatabaseSelection &selection,
 	if (db == nullptr)
 		return false;
 
-	using namespace std::placeholders;
-	const auto f = std::bind(AddToQueue, std::ref(partition), _1, _2);
-	return db->Visit(selection, f, error);
+	const Queue &queue = partition.playlist.queue;
+	const unsigned room = queue.max_length - queue.GetLength();
+
+	const Storage &storage = *partition.instance.storage;
+
+	/* collect the songs, so they can be appended to the queue in
+	   one batch; collecting stops when the queue would be full,
+	   but one extra song is kept, so playlist::AppendSongs() can
+	   report the error */
+	std::vector<DetachedSong *> songs;
+	const auto f = [&songs, room, &storage](const LightSong &song,
+						gcc_unused Error &_error){
+		if (songs.size() <= room)
+			songs.push_back(new DetachedSong(DatabaseDetachSong(storage,
+									    song)));
+		return true;
+	};
+
+	bool success = db->Visit(selection, f, error);
+
+	/* add what has been collected even after an error, just like
+	   the songs visited before the error used to be added */
+	Error append_error;
+	if (!partition.playlist.AppendSongs(partition.pc,
+					    songs.data(), songs.size(),
+					    success ? error : append_error))
+		success = false;
+
+	return success;
 }
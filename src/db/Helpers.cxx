@@ -23,8 +23,13 @@
 #include "LightSong.hxx"
 #include "tag/Tag.hxx"
 
+#include <algorithm>
 #include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
+#include <assert.h>
 #include <string.h>
 
 struct StringLess {
@@ -96,3 +101,69 @@ GetStats(const Database &db, const DatabaseSelection &selection,
 	stats.album_count = albums.size();
 	return true;
 }
+
+typedef std::unordered_map<std::string, SearchStats> TagCountMap;
+
+static bool
+CollectTagCounts(TagCountMap &map, TagType tag_type, const Tag &tag)
+{
+	bool found = false;
+	for (const auto &item : tag) {
+		if (item.type == tag_type) {
+			map[item.value].Add(tag.duration);
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+bool
+VisitTagCounts(const Database &db, const DatabaseSelection &selection,
+	       TagType tag_type, VisitTagCount visit,
+	       Error &error)
+{
+	TagCountMap map;
+
+	const auto f = [&map, tag_type](const LightSong &song, Error &){
+		assert(song.tag != nullptr);
+
+		const Tag &tag = *song.tag;
+		if (!CollectTagCounts(map, tag_type, tag) &&
+		    tag_type == TAG_ALBUM_ARTIST)
+			/* fall back to "Artist" if no "AlbumArtist"
+			   was found */
+			CollectTagCounts(map, TAG_ARTIST, tag);
+
+		return true;
+	};
+
+	if (!db.Visit(selection, f, error))
+		return false;
+
+	/* sort only the distinct values */
+	std::vector<const TagCountMap::value_type *> sorted;
+	sorted.reserve(map.size());
+	for (const auto &i : map)
+		sorted.push_back(&i);
+
+	std::sort(sorted.begin(), sorted.end(),
+		  [](const TagCountMap::value_type *a,
+		     const TagCountMap::value_type *b){
+			  return a->first < b->first;
+		  });
+
+	for (const auto *i : sorted)
+		if (!visit(i->first.c_str(), i->second, error))
+			return false;
+
+	return true;
+}
+
+bool
+Database::VisitTagCounts(const DatabaseSelection &selection,
+			 TagType tag_type, VisitTagCount visit,
+			 Error &error) const
+{
+	return ::VisitTagCounts(*this, selection, tag_type, visit, error);
+}
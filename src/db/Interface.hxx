@@ -22,6 +22,7 @@
 
 #include "Visitor.hxx"
 #include "tag/TagType.h"
+#include "util/ConstBuffer.hxx"
 #include "Compiler.h"
 
 #include <time.h>
@@ -81,6 +82,14 @@ public:
 	 */
 	virtual void ReturnSong(const LightSong *song) const = 0;
 
+	/**
+	 * A hint that the songs with the given URIs are going to be
+	 * looked up with GetSong() soon.  Implementations where each
+	 * lookup is expensive (e.g. a remote server) may fetch them
+	 * in one batch.  Errors are ignored; GetSong() reports them.
+	 */
+	virtual void Prefetch(gcc_unused ConstBuffer<const char *> uris) const {}
+
 	/**
 	 * Visit the selected entities.
 	 */
@@ -111,6 +120,20 @@ public:
 				     VisitTag visit_tag,
 				     Error &error) const = 0;
 
+	/**
+	 * Visit all values of the specified tag in the selected songs
+	 * in strcmp() order, with the number of songs and their total
+	 * duration.  Songs without "AlbumArtist" are counted with
+	 * their "Artist" values.
+	 *
+	 * The default implementation visits all songs, see
+	 * ::VisitTagCounts().
+	 */
+	virtual bool VisitTagCounts(const DatabaseSelection &selection,
+				    TagType tag_type,
+				    VisitTagCount visit,
+				    Error &error) const;
+
 	virtual bool GetStats(const DatabaseSelection &selection,
 			      DatabaseStats &stats,
 			      Error &error) const = 0;
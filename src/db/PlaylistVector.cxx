@@ -22,6 +22,7 @@
 #include "db/DatabaseLock.hxx"
 
 #include <algorithm>
+#include <iterator>
 
 #include <assert.h>
 
@@ -31,14 +32,46 @@ PlaylistVector::find(const char *name)
 	assert(holding_db_lock());
 	assert(name != nullptr);
 
+	if (index != nullptr) {
+		auto i = index->find(name);
+		return i != index->end()
+			? i->second
+			: end();
+	}
+
 	return std::find_if(begin(), end(),
 			    PlaylistInfo::CompareName(name));
 }
 
+void
+PlaylistVector::push_back(PlaylistInfo &&pi)
+{
+	std::list<PlaylistInfo>::push_back(std::move(pi));
+
+	if (index != nullptr) {
+		auto i = std::prev(end());
+		index->emplace(i->name.c_str(), i);
+	} else if (size() >= INDEX_THRESHOLD) {
+		index.reset(new Index());
+		index->reserve(size());
+		for (auto i = begin(), e = end(); i != e; ++i)
+			index->emplace(i->name.c_str(), i);
+	}
+}
+
+void
+PlaylistVector::erase(iterator i)
+{
+	if (index != nullptr)
+		index->erase(i->name.c_str());
+
+	std::list<PlaylistInfo>::erase(i);
+}
+
 bool
 PlaylistVector::UpdateOrInsert(PlaylistInfo &&pi)
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 
 	auto i = find(pi.name.c_str());
 	if (i != end()) {
@@ -55,7 +88,7 @@ PlaylistVector::UpdateOrInsert(PlaylistInfo &&pi)
 bool
 PlaylistVector::erase(const char *name)
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 
 	auto i = find(name);
 	if (i == end())
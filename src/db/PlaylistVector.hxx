@@ -21,11 +21,27 @@
 #define MPD_PLAYLIST_VECTOR_HXX
 
 #include "db/PlaylistInfo.hxx"
+#include "util/StringHash.hxx"
 #include "Compiler.h"
 
 #include <list>
+#include <unordered_map>
+#include <memory>
 
 class PlaylistVector : protected std::list<PlaylistInfo> {
+	typedef std::unordered_map<const char *, iterator,
+				   CStringHash, CStringEqual> Index;
+
+	/**
+	 * An index of all items by their name, for find().  The keys
+	 * point to PlaylistInfo::name.  It is only allocated when
+	 * there are at least #INDEX_THRESHOLD items; smaller lists
+	 * are searched linearly.
+	 */
+	std::unique_ptr<Index> index;
+
+	static constexpr size_type INDEX_THRESHOLD = 16;
+
 protected:
 	/**
 	 * Caller must lock the #db_mutex.
@@ -34,11 +50,17 @@ protected:
 	iterator find(const char *name);
 
 public:
+	PlaylistVector() = default;
+	PlaylistVector(PlaylistVector &&) = default;
+	PlaylistVector &operator=(PlaylistVector &&) = default;
+
 	using std::list<PlaylistInfo>::empty;
 	using std::list<PlaylistInfo>::begin;
 	using std::list<PlaylistInfo>::end;
-	using std::list<PlaylistInfo>::push_back;
-	using std::list<PlaylistInfo>::erase;
+
+	void push_back(PlaylistInfo &&pi);
+
+	void erase(iterator i);
 
 	/**
 	 * Caller must lock the #db_mutex.
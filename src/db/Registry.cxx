@@ -21,6 +21,7 @@
 #include "Registry.hxx"
 #include "DatabasePlugin.hxx"
 #include "plugins/simple/SimpleDatabasePlugin.hxx"
+#include "plugins/MappedDatabasePlugin.hxx"
 #include "plugins/ProxyDatabasePlugin.hxx"
 #include "plugins/upnp/UpnpDatabasePlugin.hxx"
 
@@ -28,6 +29,7 @@
 
 const DatabasePlugin *const database_plugins[] = {
 	&simple_db_plugin,
+	&mapped_db_plugin,
 #ifdef ENABLE_LIBMPDCLIENT
 	&proxy_db_plugin,
 #endif
@@ -50,4 +50,34 @@ struct DatabaseStats {
 	}
 };
 
+/**
+ * The number of songs and their total duration, e.g. of all songs
+ * with one tag value.
+ */
+struct SearchStats {
+	unsigned n_songs;
+	std::chrono::duration<std::uint64_t, SongTime::period> total_duration;
+
+	constexpr SearchStats()
+		:n_songs(0), total_duration(0) {}
+
+	void Add(SignedSongTime duration) {
+		++n_songs;
+		if (!duration.IsNegative())
+			total_duration += duration;
+	}
+
+	void Remove(SignedSongTime duration) {
+		--n_songs;
+		if (!duration.IsNegative())
+			total_duration -= duration;
+	}
+
+	SearchStats &operator+=(const SearchStats &other) {
+		n_songs += other.n_songs;
+		total_duration += other.total_duration;
+		return *this;
+	}
+};
+
 #endif
@@ -21,10 +21,17 @@
 #include "Interface.hxx"
 #include "LightSong.hxx"
 #include "tag/Set.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/TagSettings.h"
 
+#include <algorithm>
 #include <functional>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 #include <assert.h>
+#include <string.h>
 
 static bool
 CollectTags(TagSet &set, TagType tag_type, uint32_t group_mask,
@@ -37,12 +44,94 @@ CollectTags(TagSet &set, TagType tag_type, uint32_t group_mask,
 	return true;
 }
 
+typedef std::unordered_set<std::string> StringSet;
+
+static bool
+CollectValues(StringSet &set, TagType tag_type, const Tag &tag)
+{
+	bool found = false;
+	for (const auto &item : tag) {
+		if (item.type == tag_type) {
+			set.emplace(item.value);
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+/**
+ * Like TagSet::InsertUnique() without a group mask: songs without
+ * the tag are represented by an empty value.
+ */
+static void
+CollectValues(StringSet &set, TagType tag_type, const LightSong &song)
+{
+	assert(song.tag != nullptr);
+	const Tag &tag = *song.tag;
+
+	if (!CollectValues(set, tag_type, tag) &&
+	    (tag_type != TAG_ALBUM_ARTIST ||
+	     ignore_tag_items[TAG_ALBUM_ARTIST] ||
+	     /* fall back to "Artist" if no "AlbumArtist" was found */
+	     !CollectValues(set, TAG_ARTIST, tag)))
+		set.emplace();
+}
+
+bool
+VisitUniqueTagValues(TagType tag_type, const char *const*values, size_t n,
+		     VisitTag visit_tag, Error &error)
+{
+	for (size_t i = 0; i < n; ++i) {
+		TagBuilder builder;
+		if (*values[i] == 0)
+			builder.AddEmptyItem(tag_type);
+		else
+			builder.AddItem(tag_type, values[i]);
+
+		if (!visit_tag(builder.Commit(), error))
+			return false;
+	}
+
+	return true;
+}
+
 bool
 VisitUniqueTags(const Database &db, const DatabaseSelection &selection,
 		TagType tag_type, uint32_t group_mask,
 		VisitTag visit_tag,
 		Error &error)
 {
+	if (group_mask == 0) {
+		/* a hash table of plain strings is much cheaper than
+		   building a #Tag for each song */
+		StringSet set;
+
+		const auto f = [&set, tag_type](const LightSong &song,
+						Error &){
+			CollectValues(set, tag_type, song);
+			return true;
+		};
+
+		if (!db.Visit(selection, f, error))
+			return false;
+
+		/* sort only the distinct values */
+		std::vector<const char *> sorted;
+		sorted.reserve(set.size());
+		for (const auto &i : set)
+			sorted.push_back(i.c_str());
+
+		std::sort(sorted.begin(), sorted.end(),
+			  [](const char *a, const char *b){
+				  return strcmp(a, b) < 0;
+			  });
+
+		return VisitUniqueTagValues(tag_type,
+					    sorted.data(), sorted.size(),
+					    visit_tag, error);
+	}
+
 	TagSet set;
 
 	using namespace std::placeholders;
@@ -23,12 +23,22 @@
 #include "Visitor.hxx"
 #include "tag/TagType.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
 class Error;
 class Database;
 struct DatabaseSelection;
 
+/**
+ * Visit the specified values (already sorted and unique) as #Tag
+ * objects with one item.  An empty string stands for songs which
+ * don't have this tag.
+ */
+bool
+VisitUniqueTagValues(TagType tag_type, const char *const*values, size_t n,
+		     VisitTag visit_tag, Error &error);
+
 bool
 VisitUniqueTags(const Database &db, const DatabaseSelection &selection,
 		TagType tag_type, uint32_t group_mask,
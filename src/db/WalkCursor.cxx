@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "WalkCursor.hxx"
+#include "Interface.hxx"
+#include "Selection.hxx"
+#include "LightDirectory.hxx"
+#include "DatabaseError.hxx"
+#include "SongFilter.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#include <iterator>
+
+#include <string.h>
+
+/**
+ * This pseudo error is used to abort the visit at the end of a
+ * portion.
+ */
+static constexpr Domain walk_limit_domain("walk_limit");
+
+DatabaseWalkCursor::DatabaseWalkCursor(const Database &db, const char *uri,
+				       const SongFilter *_filter)
+	:filter(_filter), stamp(db.GetUpdateStamp()),
+	 /* without a base URI, DatabaseSelection picks the one from
+	    the SongFilter */
+	 current(DatabaseSelection(uri, true, _filter).uri),
+	 skip(0), has_current(true), started(false),
+	 current_exists(false) {}
+
+bool
+DatabaseWalkCursor::VisitBase(const Database &db,
+			      const VisitDirectory &visit_directory,
+			      Error &error)
+{
+	if (current.empty())
+		return visit_directory(LightDirectory::Root(), error);
+
+	/* the base directory's attributes are only known to its
+	   parent */
+	const char *uri = current.c_str();
+	const char *slash = strrchr(uri, '/');
+	const std::string parent = slash != nullptr
+		? std::string(uri, slash)
+		: std::string();
+
+	const VisitDirectory d = [this, &visit_directory]
+		(const LightDirectory &directory, Error &error2){
+		return strcmp(directory.uri, current.c_str()) != 0 ||
+			visit_directory(directory, error2);
+	};
+
+	if (!db.Visit(DatabaseSelection(parent.c_str(), false), d,
+		      VisitSong(), VisitPlaylist(), error)) {
+		if (!error.IsDomain(db_domain) ||
+		    error.GetCode() != DB_NOT_FOUND)
+			return false;
+
+		/* the first VisitCurrent() call will report this */
+		error.Clear();
+	}
+
+	return true;
+}
+
+bool
+DatabaseWalkCursor::VisitCurrent(const Database &db,
+				 unsigned limit, unsigned &n,
+				 const VisitSong &visit_song,
+				 const VisitPlaylist &visit_playlist,
+				 bool &complete_r, Error &error)
+{
+	unsigned i = 0;
+
+	/* the child directories are not passed to the caller now;
+	   they are visited after all other entities of this
+	   directory, like Database::Visit() does recursively */
+	const VisitDirectory d = [this, &i](const LightDirectory &directory,
+					    gcc_unused Error &error2){
+		if (i++ >= skip &&
+		    (filter == nullptr ||
+		     filter->CheckBase(directory.uri) !=
+		     SongFilter::BaseMatch::NONE))
+			children.emplace_back(directory.uri,
+					      directory.mtime);
+		return true;
+	};
+
+	const auto check = [this, &i, &n, limit](Error &error2){
+		if (i < skip) {
+			++i;
+			return false;
+		}
+
+		if (n >= limit) {
+			error2.Set(walk_limit_domain, "End of portion");
+			return false;
+		}
+
+		++i;
+		++n;
+		return true;
+	};
+
+	VisitSong s;
+	if (visit_song)
+		s = [&check, &visit_song](const LightSong &song,
+					  Error &error2){
+			return check(error2)
+				? visit_song(song, error2)
+				: !error2.IsDefined();
+		};
+
+	VisitPlaylist p;
+	if (visit_playlist)
+		p = [&check, &visit_playlist](const PlaylistInfo &playlist,
+					      const LightDirectory &directory,
+					      Error &error2){
+			return check(error2)
+				? visit_playlist(playlist, directory, error2)
+				: !error2.IsDefined();
+		};
+
+	if (!db.Visit(DatabaseSelection(current.c_str(), false, filter),
+		      d, s, p, error)) {
+		if (error.IsDomain(walk_limit_domain)) {
+			error.Clear();
+			skip = i;
+			current_exists = true;
+			complete_r = false;
+			return true;
+		}
+
+		if (current_exists && error.IsDomain(db_domain) &&
+		    error.GetCode() == DB_NOT_FOUND) {
+			error.Clear();
+			error.Set(db_domain, DB_MODIFIED,
+				  "Database has been modified");
+		}
+
+		return false;
+	}
+
+	complete_r = true;
+	return true;
+}
+
+bool
+DatabaseWalkCursor::Visit(const Database &db, unsigned limit,
+			  VisitDirectory visit_directory, VisitSong visit_song,
+			  VisitPlaylist visit_playlist,
+			  Error &error)
+{
+	if (db.GetUpdateStamp() != stamp) {
+		error.Set(db_domain, DB_MODIFIED,
+			  "Database has been modified");
+		return false;
+	}
+
+	if (!started) {
+		started = true;
+
+		if (visit_directory && !VisitBase(db, visit_directory, error))
+			return false;
+	}
+
+	unsigned n = 0;
+
+	while (true) {
+		if (!has_current) {
+			if (pending.empty() || n >= limit)
+				return true;
+
+			PendingDirectory &next = pending.back();
+			if (visit_directory &&
+			    !visit_directory(LightDirectory(next.uri.c_str(),
+							    next.mtime),
+					     error))
+				return false;
+
+			if (visit_directory)
+				++n;
+
+			current = std::move(next.uri);
+			pending.pop_back();
+			skip = 0;
+			has_current = true;
+			current_exists = true;
+		}
+
+		bool complete;
+		if (!VisitCurrent(db, limit, n, visit_song, visit_playlist,
+				  complete, error))
+			return false;
+
+		if (!complete)
+			return true;
+
+		/* the first child is visited next */
+		pending.insert(pending.end(),
+			       std::make_move_iterator(children.rbegin()),
+			       std::make_move_iterator(children.rend()));
+		children.clear();
+		has_current = false;
+	}
+}
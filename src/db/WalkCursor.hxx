@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DB_WALK_CURSOR_HXX
+#define MPD_DB_WALK_CURSOR_HXX
+
+#include "Visitor.hxx"
+#include "Compiler.h"
+
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+class Database;
+class SongFilter;
+class Error;
+
+/**
+ * Visits a recursive selection in portions, for responses which are
+ * too large to be generated at once.  The entities are visited in
+ * the same order as a recursive Database::Visit() call would visit
+ * them.
+ *
+ * Instead of a position (which could only be reached by visiting
+ * everything before it again), the cursor remembers the directories
+ * which have not been visited yet.  Each directory is visited
+ * non-recursively; only a directory with more entities than fit in
+ * one portion is visited again, skipping the entities which have
+ * been visited already.
+ *
+ * If the database's update stamp changes between two portions, or
+ * if a directory which has been seen before disappears, Visit()
+ * fails with #DB_MODIFIED.
+ */
+class DatabaseWalkCursor {
+	struct PendingDirectory {
+		std::string uri;
+		time_t mtime;
+
+		PendingDirectory(const char *_uri, time_t _mtime)
+			:uri(_uri), mtime(_mtime) {}
+	};
+
+	const SongFilter *const filter;
+
+	/**
+	 * The database's update stamp when the walk was started.
+	 */
+	const time_t stamp;
+
+	/**
+	 * The directories which have not been visited yet; the last
+	 * element is the next one.
+	 */
+	std::vector<PendingDirectory> pending;
+
+	/**
+	 * The URI of the directory which is being visited.
+	 */
+	std::string current;
+
+	/**
+	 * The child directories of #current which have been found so
+	 * far.  They are moved to #pending when #current is complete.
+	 */
+	std::vector<PendingDirectory> children;
+
+	/**
+	 * The number of entities in #current which have been visited
+	 * already.
+	 */
+	unsigned skip;
+
+	/**
+	 * Is #current valid?
+	 */
+	bool has_current;
+
+	/**
+	 * Has the base directory been passed to the #VisitDirectory
+	 * already?
+	 */
+	bool started;
+
+	/**
+	 * Has #current been seen in the database before?  If it
+	 * disappears, the database has been modified.
+	 */
+	bool current_exists;
+
+public:
+	/**
+	 * @param uri the base URI of the recursive selection
+	 * @param filter an optional filter for songs; it must remain
+	 * valid until this object is destroyed
+	 */
+	DatabaseWalkCursor(const Database &db, const char *uri,
+			   const SongFilter *filter);
+
+	const SongFilter *GetFilter() const {
+		return filter;
+	}
+
+	gcc_pure
+	bool IsFinished() const {
+		return !has_current && pending.empty();
+	}
+
+	/**
+	 * Visit the next portion.  Directories and playlists are
+	 * counted as entities, too, but only if there is a visitor
+	 * for them.
+	 *
+	 * @param limit the maximum number of entities
+	 */
+	bool Visit(const Database &db, unsigned limit,
+		   VisitDirectory visit_directory, VisitSong visit_song,
+		   VisitPlaylist visit_playlist,
+		   Error &error);
+
+private:
+	bool VisitBase(const Database &db,
+		       const VisitDirectory &visit_directory,
+		       Error &error);
+
+	/**
+	 * Visit the entities of #current.
+	 *
+	 * @param n the number of entities visited in this portion;
+	 * will be incremented
+	 * @param complete_r set to true if all entities of #current
+	 * have been visited
+	 */
+	bool VisitCurrent(const Database &db, unsigned limit, unsigned &n,
+			  const VisitSong &visit_song,
+			  const VisitPlaylist &visit_playlist,
+			  bool &complete_r, Error &error);
+};
+
+#endif
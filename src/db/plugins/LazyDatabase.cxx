@@ -20,6 +20,7 @@
 #include "config.h"
 #include "LazyDatabase.hxx"
 #include "db/Interface.hxx"
+#include "util/Error.hxx"
 
 #include <assert.h>
 
@@ -71,6 +72,13 @@ LazyDatabase::ReturnSong(const LightSong *song) const
 	db->ReturnSong(song);
 }
 
+void
+LazyDatabase::Prefetch(ConstBuffer<const char *> uris) const
+{
+	if (EnsureOpen(IgnoreError()))
+		db->Prefetch(uris);
+}
+
 bool
 LazyDatabase::Visit(const DatabaseSelection &selection,
 		    VisitDirectory visit_directory,
@@ -94,6 +102,16 @@ LazyDatabase::VisitUniqueTags(const DatabaseSelection &selection,
 				    error);
 }
 
+bool
+LazyDatabase::VisitTagCounts(const DatabaseSelection &selection,
+			     TagType tag_type,
+			     VisitTagCount visit,
+			     Error &error) const
+{
+	return EnsureOpen(error) &&
+		db->VisitTagCounts(selection, tag_type, visit, error);
+}
+
 bool
 LazyDatabase::GetStats(const DatabaseSelection &selection,
 		       DatabaseStats &stats, Error &error) const
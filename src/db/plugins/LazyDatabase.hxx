@@ -44,6 +44,7 @@ public:
 	virtual const LightSong *GetSong(const char *uri_utf8,
 					 Error &error) const override;
 	void ReturnSong(const LightSong *song) const override;
+	void Prefetch(ConstBuffer<const char *> uris) const override;
 
 	virtual bool Visit(const DatabaseSelection &selection,
 			   VisitDirectory visit_directory,
@@ -56,6 +57,11 @@ public:
 				     VisitTag visit_tag,
 				     Error &error) const override;
 
+	virtual bool VisitTagCounts(const DatabaseSelection &selection,
+				    TagType tag_type,
+				    VisitTagCount visit,
+				    Error &error) const override;
+
 	virtual bool GetStats(const DatabaseSelection &selection,
 			      DatabaseStats &stats,
 			      Error &error) const override;
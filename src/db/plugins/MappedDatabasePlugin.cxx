@@ -0,0 +1,810 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MappedDatabasePlugin.hxx"
+#include "simple/BinaryFormat.hxx"
+#include "db/Interface.hxx"
+#include "db/DatabasePlugin.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/DatabaseError.hxx"
+#include "db/Selection.hxx"
+#include "db/Helpers.hxx"
+#include "db/UniqueTags.hxx"
+#include "db/PlaylistInfo.hxx"
+#include "db/LightDirectory.hxx"
+#include "db/LightSong.hxx"
+#include "db/Uri.hxx"
+#include "SongFilter.hxx"
+#include "config/Block.hxx"
+#include "event/TimeoutMonitor.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/io/MappedFile.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagPool.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <string.h>
+
+static constexpr Domain mapped_db_domain("mapped_db");
+
+static constexpr uint32_t MAPPED_DB_NO_DIRECTORY = 0xffffffff;
+
+/**
+ * One mapped database file and the per-process data derived from it.
+ * Everything else is read directly from the shared mapping.
+ */
+struct MappedImage {
+	MappedFile file;
+
+	const time_t mtime;
+
+	const char *strings;
+	ConstBuffer<uint32_t> song_items;
+	ConstBuffer<BinarySong> songs;
+	ConstBuffer<BinaryDirectory> directories;
+	ConstBuffer<BinaryPlaylist> playlists;
+
+	/**
+	 * A #TagPool reference for each record in
+	 * #BINARY_SECTION_ITEMS; nullptr for tag types which are
+	 * disabled.  Pooled items are required by
+	 * SongFilter::Item::fold_case.
+	 */
+	std::vector<TagItem *> items;
+
+	/**
+	 * For each directory, the index of the first directory after
+	 * its subtree.  The directories are stored in pre-order, so
+	 * this allows enumerating the children of a directory
+	 * without visiting its descendants.
+	 */
+	std::vector<uint32_t> subtree_end;
+
+	explicit MappedImage(time_t _mtime):mtime(_mtime) {}
+
+	~MappedImage() {
+		FreeBinaryTagItems(items);
+	}
+
+	bool Load(Path path, Error &error);
+
+	const char *GetString(uint32_t ref) const {
+		return strings + ref;
+	}
+
+	/**
+	 * Find a child directory.
+	 *
+	 * @return the directory index or #MAPPED_DB_NO_DIRECTORY
+	 */
+	gcc_pure
+	uint32_t FindChild(uint32_t parent,
+			   const char *name, size_t length) const;
+
+	/**
+	 * Like Directory::LookupDirectory(): find the deepest
+	 * directory which matches the beginning of the URI.
+	 *
+	 * @param rest_r receives the remaining part of the URI, or
+	 * nullptr if the whole URI is a directory
+	 */
+	gcc_pure
+	uint32_t LookupDirectory(const char *uri, const char *&rest_r) const;
+
+	gcc_pure
+	const BinarySong *FindSong(uint32_t directory,
+				   const char *name) const;
+
+	gcc_pure
+	std::string GetPath(uint32_t directory) const;
+
+	/**
+	 * Like Directory::Walk().
+	 */
+	bool Walk(uint32_t directory, const std::string &path,
+		  bool recursive, const SongFilter *filter,
+		  VisitDirectory visit_directory, VisitSong visit_song,
+		  VisitPlaylist visit_playlist,
+		  Error &error) const;
+
+private:
+	bool Validate(const BinaryDatabaseReader &reader, Error &error);
+};
+
+/**
+ * Exports a #BinarySong as #LightSong.  The #Tag borrows the item
+ * references from MappedImage::items, and must therefore be released
+ * with Reset() instead of Tag::Clear().
+ */
+class MappedLightSong {
+	Tag tag;
+
+	std::vector<TagItem *> tag_items;
+
+public:
+	LightSong song;
+
+	MappedLightSong() = default;
+	MappedLightSong(const MappedLightSong &) = delete;
+
+	~MappedLightSong() {
+		Reset();
+	}
+
+	void Set(const MappedImage &image, const BinarySong &s,
+		 const char *directory);
+
+	void Reset() {
+		tag.DiscardItems();
+	}
+};
+
+void
+MappedLightSong::Set(const MappedImage &image, const BinarySong &s,
+		     const char *directory)
+{
+	Reset();
+
+	tag_items.clear();
+	const uint32_t *const first = image.song_items.data + s.first_item;
+	for (unsigned i = 0; i < s.n_items; ++i) {
+		TagItem *item = image.items[first[i]];
+		if (item != nullptr)
+			tag_items.push_back(item);
+	}
+
+	tag.duration = s.duration_ms < 0
+		? SignedSongTime::Negative()
+		: SignedSongTime::FromMS(s.duration_ms);
+	tag.has_playlist = (s.flags & BINARY_SONG_HAS_PLAYLIST) != 0;
+	tag.foreign_items = true;
+	tag.num_items = tag_items.size();
+	tag.items = tag_items.data();
+
+	song.directory = directory;
+	song.uri = image.GetString(s.uri);
+	song.real_uri = nullptr;
+	song.tag = &tag;
+	song.mtime = s.mtime;
+	song.start_time = SongTime::FromMS(s.start_ms);
+	song.end_time = SongTime::FromMS(s.end_ms);
+}
+
+bool
+MappedImage::Load(Path path, Error &error)
+{
+	if (!file.Open(path, error))
+		return false;
+
+	BinaryDatabaseReader reader(file.Get());
+	if (!reader.Check(error) || !reader.CheckCharset(error))
+		return false;
+
+	std::vector<TagType> tag_types;
+	if (!LoadBinaryTagTypes(reader, tag_types, error))
+		return false;
+
+	{
+		const ScopeLock protect(tag_pool_lock);
+		if (!LoadBinaryTagItems(reader, tag_types, items, error))
+			return false;
+	}
+
+	strings = reader.GetString(0);
+	song_items = reader.GetSection<uint32_t>(BINARY_SECTION_SONG_ITEMS);
+	songs = reader.GetSection<BinarySong>(BINARY_SECTION_SONGS);
+	directories =
+		reader.GetSection<BinaryDirectory>(BINARY_SECTION_DIRECTORIES);
+	playlists = reader.GetSection<BinaryPlaylist>(BINARY_SECTION_PLAYLISTS);
+
+	return Validate(reader, error);
+}
+
+/**
+ * Check all references once, so the lookups don't need to.  This
+ * reads the whole file, but the pages stay in the (shared) page
+ * cache.
+ */
+bool
+MappedImage::Validate(const BinaryDatabaseReader &reader, Error &error)
+{
+	if (directories.IsEmpty() ||
+	    directories.front().parent != BINARY_DB_NO_PARENT) {
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	subtree_end.resize(directories.size);
+
+	/* the current directory and its ancestors; the parent of
+	   each directory must be one of them, or else the records
+	   are not in pre-order */
+	std::vector<uint32_t> stack;
+
+	for (uint32_t i = 0; i < directories.size; ++i) {
+		const auto &d = directories[i];
+
+		if (i > 0) {
+			while (!stack.empty() && stack.back() != d.parent)
+				stack.pop_back();
+
+			if (stack.empty() || !reader.IsValidString(d.name) ||
+			    *GetString(d.name) == 0) {
+				error.Set(db_domain, "Database corrupted");
+				return false;
+			}
+		}
+
+		stack.push_back(i);
+		subtree_end[i] = i + 1;
+
+		if (d.first_song > songs.size ||
+		    d.n_songs > songs.size - d.first_song ||
+		    d.first_playlist > playlists.size ||
+		    d.n_playlists > playlists.size - d.first_playlist) {
+			error.Set(db_domain, "Database corrupted");
+			return false;
+		}
+
+		for (uint32_t j = 0; j < d.n_playlists; ++j) {
+			if (!reader.IsValidString(playlists[d.first_playlist + j].name)) {
+				error.Set(db_domain, "Database corrupted");
+				return false;
+			}
+		}
+
+		for (uint32_t j = 0; j < d.n_songs; ++j) {
+			const auto &s = songs[d.first_song + j];
+			if (!reader.IsValidString(s.uri) ||
+			    *GetString(s.uri) == 0 ||
+			    s.first_item > song_items.size ||
+			    s.n_items > song_items.size - s.first_item ||
+			    s.n_items > std::numeric_limits<decltype(Tag::num_items)>::max()) {
+				error.Set(db_domain, "Database corrupted");
+				return false;
+			}
+
+			for (uint32_t k = 0; k < s.n_items; ++k) {
+				if (song_items[s.first_item + k] >= items.size()) {
+					error.Set(db_domain,
+						  "Database corrupted");
+					return false;
+				}
+			}
+		}
+	}
+
+	/* a directory's descendants have higher indexes, so each
+	   subtree end is complete before it is propagated to the
+	   parent */
+	for (uint32_t i = directories.size - 1; i > 0; --i) {
+		uint32_t &end = subtree_end[directories[i].parent];
+		if (subtree_end[i] > end)
+			end = subtree_end[i];
+	}
+
+	return true;
+}
+
+uint32_t
+MappedImage::FindChild(uint32_t parent, const char *name, size_t length) const
+{
+	for (uint32_t i = parent + 1; i < subtree_end[parent];
+	     i = subtree_end[i]) {
+		const char *child_name = GetString(directories[i].name);
+		if (memcmp(child_name, name, length) == 0 &&
+		    child_name[length] == 0)
+			return i;
+	}
+
+	return MAPPED_DB_NO_DIRECTORY;
+}
+
+uint32_t
+MappedImage::LookupDirectory(const char *uri, const char *&rest_r) const
+{
+	rest_r = nullptr;
+	if (isRootDirectory(uri))
+		return 0;
+
+	uint32_t directory = 0;
+	while (true) {
+		const char *slash = strchr(uri, '/');
+		if (slash == uri)
+			break;
+
+		const size_t length = slash != nullptr
+			? size_t(slash - uri)
+			: strlen(uri);
+		const uint32_t child = FindChild(directory, uri, length);
+		if (child == MAPPED_DB_NO_DIRECTORY)
+			break;
+
+		directory = child;
+
+		if (slash == nullptr)
+			/* found everything */
+			return directory;
+
+		uri = slash + 1;
+	}
+
+	rest_r = uri;
+	return directory;
+}
+
+const BinarySong *
+MappedImage::FindSong(uint32_t directory, const char *name) const
+{
+	const auto &d = directories[directory];
+	for (uint32_t i = 0; i < d.n_songs; ++i) {
+		const BinarySong &s = songs[d.first_song + i];
+		if (strcmp(GetString(s.uri), name) == 0)
+			return &s;
+	}
+
+	return nullptr;
+}
+
+std::string
+MappedImage::GetPath(uint32_t directory) const
+{
+	std::string path;
+
+	for (; directory != 0; directory = directories[directory].parent) {
+		const char *name = GetString(directories[directory].name);
+		if (!path.empty())
+			path.insert(path.begin(), '/');
+		path.insert(0, name);
+	}
+
+	return path;
+}
+
+bool
+MappedImage::Walk(uint32_t directory, const std::string &path,
+		  bool recursive, const SongFilter *filter,
+		  VisitDirectory visit_directory, VisitSong visit_song,
+		  VisitPlaylist visit_playlist,
+		  Error &error) const
+{
+	const auto &d = directories[directory];
+
+	const auto base_match = filter != nullptr
+		? filter->CheckBase(path.c_str())
+		: SongFilter::BaseMatch::ALL;
+	if (base_match == SongFilter::BaseMatch::NONE &&
+	    !visit_directory && !visit_playlist)
+		/* nothing in this subtree can match the "base"
+		   items */
+		return true;
+
+	if (visit_song && d.n_songs > 0 &&
+	    base_match != SongFilter::BaseMatch::NONE) {
+		MappedLightSong song;
+		const char *const song_directory =
+			path.empty() ? nullptr : path.c_str();
+
+		for (uint32_t i = 0; i < d.n_songs; ++i) {
+			song.Set(*this, songs[d.first_song + i],
+				 song_directory);
+			if ((filter == nullptr ||
+			     (base_match == SongFilter::BaseMatch::ALL
+			      ? filter->MatchIgnoringBase(song.song)
+			      : filter->Match(song.song))) &&
+			    !visit_song(song.song, error))
+				return false;
+		}
+	}
+
+	if (visit_playlist) {
+		const LightDirectory parent(path.c_str(), d.mtime);
+		for (uint32_t i = 0; i < d.n_playlists; ++i) {
+			const auto &p = playlists[d.first_playlist + i];
+			const PlaylistInfo pi(GetString(p.name),
+					      (time_t)p.mtime);
+			if (!visit_playlist(pi, parent, error))
+				return false;
+		}
+	}
+
+	if (subtree_end[directory] == directory + 1)
+		/* no children */
+		return true;
+
+	std::string child_path(path);
+	if (!child_path.empty())
+		child_path.push_back('/');
+	const size_t prefix_length = child_path.length();
+
+	for (uint32_t i = directory + 1; i < subtree_end[directory];
+	     i = subtree_end[i]) {
+		const auto &child = directories[i];
+		child_path.replace(prefix_length, std::string::npos,
+				   GetString(child.name));
+
+		if (visit_directory &&
+		    !visit_directory(LightDirectory(child_path.c_str(),
+						    child.mtime),
+				     error))
+			return false;
+
+		if (recursive &&
+		    !Walk(i, child_path, recursive, filter,
+			  visit_directory, visit_song, visit_playlist,
+			  error))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * All methods are called in the main thread, which is also the one
+ * that replaces the #MappedImage, so no locking is necessary.
+ */
+class MappedDatabase final : public Database, TimeoutMonitor {
+	DatabaseListener &listener;
+
+	AllocatedPath path;
+	std::string path_utf8;
+
+	/**
+	 * How often the file is checked for replacement [seconds].
+	 */
+	unsigned check_interval;
+
+	/**
+	 * The currently mapped file; nullptr if none could be loaded
+	 * yet.
+	 */
+	MappedImage *image;
+
+	/**
+	 * The attributes of the file which was loaded last (whether
+	 * that succeeded or not), to detect when it gets replaced.
+	 */
+	FileInfo checked_info;
+	bool have_checked_info;
+
+	/**
+	 * A buffer for GetSong().
+	 */
+	mutable MappedLightSong light_song;
+
+	/**
+	 * The path of the directory containing #light_song.
+	 */
+	mutable std::string light_song_directory;
+
+#ifndef NDEBUG
+	mutable bool borrowed_song;
+#endif
+
+public:
+	MappedDatabase(EventLoop &_loop, DatabaseListener &_listener)
+		:Database(mapped_db_plugin),
+		 TimeoutMonitor(_loop),
+		 listener(_listener),
+		 path(AllocatedPath::Null()),
+		 image(nullptr) {}
+
+	static Database *Create(EventLoop &loop, DatabaseListener &listener,
+				const ConfigBlock &block,
+				Error &error);
+
+	/* virtual methods from class Database */
+	bool Open(Error &error) override;
+	void Close() override;
+
+	const LightSong *GetSong(const char *uri_utf8,
+				 Error &error) const override;
+	void ReturnSong(const LightSong *song) const override;
+
+	bool Visit(const DatabaseSelection &selection,
+		   VisitDirectory visit_directory,
+		   VisitSong visit_song,
+		   VisitPlaylist visit_playlist,
+		   Error &error) const override;
+
+	bool VisitUniqueTags(const DatabaseSelection &selection,
+			     TagType tag_type, uint32_t group_mask,
+			     VisitTag visit_tag,
+			     Error &error) const override;
+
+	bool GetStats(const DatabaseSelection &selection,
+		      DatabaseStats &stats,
+		      Error &error) const override;
+
+	time_t GetUpdateStamp() const override {
+		return image != nullptr ? image->mtime : 0;
+	}
+
+private:
+	bool Configure(const ConfigBlock &block, Error &error);
+
+	/**
+	 * Map the file unless it is the same one which was loaded
+	 * last.
+	 *
+	 * @return true if a new file has been mapped; false on error
+	 * (with #Error set) or if the file does not exist or has not
+	 * been replaced (#Error not set)
+	 */
+	bool Reload(Error &error);
+
+	/* virtual methods from class TimeoutMonitor */
+	void OnTimeout() override;
+};
+
+gcc_pure
+static bool
+IsSameFile(const FileInfo &a, const FileInfo &b)
+{
+	return a.GetModificationTime() == b.GetModificationTime() &&
+		a.GetSize() == b.GetSize()
+#ifndef WIN32
+		&& a.GetDevice() == b.GetDevice() &&
+		a.GetInode() == b.GetInode()
+#endif
+		;
+}
+
+Database *
+MappedDatabase::Create(EventLoop &loop, DatabaseListener &listener,
+		       const ConfigBlock &block, Error &error)
+{
+	MappedDatabase *db = new MappedDatabase(loop, listener);
+	if (!db->Configure(block, error)) {
+		delete db;
+		db = nullptr;
+	}
+
+	return db;
+}
+
+bool
+MappedDatabase::Configure(const ConfigBlock &block, Error &error)
+{
+	path = block.GetBlockPath("path", error);
+	if (path.IsNull()) {
+		if (!error.IsDefined())
+			error.Set(mapped_db_domain,
+				  "No \"path\" parameter specified");
+		return false;
+	}
+
+	path_utf8 = path.ToUTF8();
+
+	check_interval = block.GetBlockValue("check_interval", 10u);
+	if (check_interval == 0) {
+		error.Set(mapped_db_domain,
+			  "\"check_interval\" must be positive");
+		return false;
+	}
+
+	return true;
+}
+
+bool
+MappedDatabase::Reload(Error &error)
+{
+	FileInfo info;
+	if (!GetFileInfo(path, info))
+		return false;
+
+	if (have_checked_info && IsSameFile(info, checked_info))
+		return false;
+
+	checked_info = info;
+	have_checked_info = true;
+
+	MappedImage *new_image = new MappedImage(info.GetModificationTime());
+	if (!new_image->Load(path, error)) {
+		delete new_image;
+		return false;
+	}
+
+	delete image;
+	image = new_image;
+	return true;
+}
+
+bool
+MappedDatabase::Open(Error &error)
+{
+	assert(image == nullptr);
+
+	have_checked_info = false;
+#ifndef NDEBUG
+	borrowed_song = false;
+#endif
+
+	if (!Reload(error)) {
+		if (!error.IsDefined())
+			error.Format(mapped_db_domain,
+				     "Database file \"%s\" does not exist",
+				     path_utf8.c_str());
+
+		/* not fatal: the file may be created later by the
+		   instance which owns it */
+		LogError(error);
+		error.Clear();
+	}
+
+	ScheduleSeconds(check_interval);
+	return true;
+}
+
+void
+MappedDatabase::Close()
+{
+	assert(!borrowed_song);
+
+	TimeoutMonitor::Cancel();
+
+	delete image;
+	image = nullptr;
+}
+
+void
+MappedDatabase::OnTimeout()
+{
+	Error error;
+	if (Reload(error)) {
+		FormatDebug(mapped_db_domain, "Reloaded \"%s\"",
+			    path_utf8.c_str());
+		listener.OnDatabaseModified();
+	} else if (error.IsDefined())
+		LogError(error);
+
+	ScheduleSeconds(check_interval);
+}
+
+const LightSong *
+MappedDatabase::GetSong(const char *uri, Error &error) const
+{
+	assert(!borrowed_song);
+
+	const char *rest = nullptr;
+	const uint32_t directory = image != nullptr
+		? image->LookupDirectory(uri, rest)
+		: 0;
+	const BinarySong *song = image != nullptr && rest != nullptr &&
+		strchr(rest, '/') == nullptr
+		? image->FindSong(directory, rest)
+		: nullptr;
+	if (song == nullptr) {
+		error.Format(db_domain, DB_NOT_FOUND,
+			     "No such song: %s", uri);
+		return nullptr;
+	}
+
+	light_song_directory = image->GetPath(directory);
+	light_song.Set(*image, *song,
+		       light_song_directory.empty()
+		       ? nullptr : light_song_directory.c_str());
+
+#ifndef NDEBUG
+	borrowed_song = true;
+#endif
+
+	return &light_song.song;
+}
+
+void
+MappedDatabase::ReturnSong(gcc_unused const LightSong *song) const
+{
+	assert(song == &light_song.song);
+	assert(borrowed_song);
+
+	light_song.Reset();
+
+#ifndef NDEBUG
+	borrowed_song = false;
+#endif
+}
+
+bool
+MappedDatabase::Visit(const DatabaseSelection &selection,
+		      VisitDirectory visit_directory,
+		      VisitSong visit_song,
+		      VisitPlaylist visit_playlist,
+		      Error &error) const
+{
+	if (image == nullptr) {
+		/* not loaded yet: behave like an empty database */
+		if (isRootDirectory(selection.uri.c_str()))
+			return !selection.recursive || !visit_directory ||
+				visit_directory(LightDirectory::Root(), error);
+
+		error.Set(db_domain, DB_NOT_FOUND, "No such directory");
+		return false;
+	}
+
+	const char *rest = nullptr;
+	const uint32_t directory =
+		image->LookupDirectory(selection.uri.c_str(), rest);
+	if (rest == nullptr) {
+		/* it's a directory */
+		const std::string directory_path =
+			image->GetPath(directory);
+
+		if (selection.recursive && visit_directory &&
+		    !visit_directory(LightDirectory(directory_path.c_str(),
+						    image->directories[directory].mtime),
+				     error))
+			return false;
+
+		return image->Walk(directory, directory_path,
+				   selection.recursive, selection.filter,
+				   visit_directory, visit_song,
+				   visit_playlist,
+				   error);
+	}
+
+	if (strchr(rest, '/') == nullptr && visit_song) {
+		const BinarySong *song = image->FindSong(directory, rest);
+		if (song != nullptr) {
+			const std::string directory_path =
+				image->GetPath(directory);
+			MappedLightSong song2;
+			song2.Set(*image, *song,
+				  directory_path.empty()
+				  ? nullptr : directory_path.c_str());
+			return !selection.Match(song2.song) ||
+				visit_song(song2.song, error);
+		}
+	}
+
+	error.Set(db_domain, DB_NOT_FOUND, "No such directory");
+	return false;
+}
+
+bool
+MappedDatabase::VisitUniqueTags(const DatabaseSelection &selection,
+				TagType tag_type, uint32_t group_mask,
+				VisitTag visit_tag,
+				Error &error) const
+{
+	return ::VisitUniqueTags(*this, selection, tag_type, group_mask,
+				 visit_tag,
+				 error);
+}
+
+bool
+MappedDatabase::GetStats(const DatabaseSelection &selection,
+			 DatabaseStats &stats, Error &error) const
+{
+	return ::GetStats(*this, selection, stats, error);
+}
+
+const DatabasePlugin mapped_db_plugin = {
+	"mapped",
+	DatabasePlugin::FLAG_REQUIRE_STORAGE,
+	MappedDatabase::Create,
+};
@@ -38,14 +38,26 @@
 #include "protocol/Ack.hxx"
 #include "event/SocketMonitor.hxx"
 #include "event/IdleMonitor.hxx"
+#include "event/AsyncResolver.hxx"
+#include "net/Resolver.hxx"
 #include "Log.hxx"
 
 #include <mpd/client.h>
 #include <mpd/async.h>
 
+#include <algorithm>
 #include <cassert>
 #include <string>
 #include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#ifdef WIN32
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#endif
 
 class ProxySong : public LightSong {
 	Tag tag2;
@@ -66,13 +78,65 @@ public:
 	}
 };
 
-class ProxyDatabase final : public Database, SocketMonitor, IdleMonitor {
+class ProxyEntity {
+	struct mpd_entity *entity;
+
+public:
+	explicit ProxyEntity(struct mpd_entity *_entity)
+		:entity(_entity) {}
+
+	ProxyEntity(const ProxyEntity &other) = delete;
+
+	ProxyEntity(ProxyEntity &&other)
+		:entity(other.entity) {
+		other.entity = nullptr;
+	}
+
+	~ProxyEntity() {
+		if (entity != nullptr)
+			mpd_entity_free(entity);
+	}
+
+	ProxyEntity &operator=(const ProxyEntity &other) = delete;
+
+	operator const struct mpd_entity *() const {
+		return entity;
+	}
+};
+
+typedef std::list<ProxyEntity> ProxyEntityList;
+
+/**
+ * The maximum number of songs in ProxyDatabase::song_cache.
+ */
+static constexpr size_t PROXY_SONG_CACHE_SIZE = 32768;
+
+/**
+ * The maximum number of directories in
+ * ProxyDatabase::directory_cache.
+ */
+static constexpr size_t PROXY_DIRECTORY_CACHE_SIZE = 1024;
+
+/**
+ * The number of "lsinfo" commands sent in one command list by
+ * ProxyDatabase::Prefetch().
+ */
+static constexpr size_t PROXY_PREFETCH_BATCH = 256;
+
+class ProxyDatabase final
+	: public Database, SocketMonitor, IdleMonitor, ResolverHandler {
 	DatabaseListener &listener;
 
 	std::string host;
 	unsigned port;
 	bool keepalive;
 
+	/**
+	 * Resolves #host in the background, so the first connection
+	 * does not block the #EventLoop on a slow DNS server.
+	 */
+	ResolveRequest resolve;
+
 	struct mpd_connection *connection;
 
 	/* this is mutable because GetStats() must be "const" */
@@ -90,11 +154,36 @@ class ProxyDatabase final : public Database, SocketMonitor, IdleMonitor {
 	 */
 	bool is_idle;
 
+	/**
+	 * Songs received from the other MPD, to answer GetSong()
+	 * without a round trip.  Like #directory_cache, this is
+	 * flushed when the other MPD reports a "database" idle
+	 * event, after reconnecting and when it is full.
+	 */
+	mutable std::unordered_map<std::string, mpd_song *> song_cache;
+
+	/**
+	 * "lsinfo" responses of recently visited directories.  The
+	 * lists are shared, because a Visit() may still be iterating
+	 * one while the cache is flushed.
+	 */
+	mutable std::unordered_map<std::string,
+				   std::shared_ptr<const ProxyEntityList>> directory_cache;
+
+	/**
+	 * The last "stats" response of the other MPD; valid if
+	 * #stats_cached is set.  Flushed together with the other
+	 * caches.
+	 */
+	mutable DatabaseStats stats_cache;
+	mutable bool stats_cached = false;
+
 public:
 	ProxyDatabase(EventLoop &_loop, DatabaseListener &_listener)
 		:Database(proxy_db_plugin),
 		 SocketMonitor(_loop), IdleMonitor(_loop),
-		 listener(_listener) {}
+		 listener(_listener),
+		 resolve(_loop, resolver_get(), *this) {}
 
 	static Database *Create(EventLoop &loop, DatabaseListener &listener,
 				const ConfigBlock &block,
@@ -105,6 +194,7 @@ public:
 	virtual const LightSong *GetSong(const char *uri_utf8,
 				     Error &error) const override;
 	void ReturnSong(const LightSong *song) const override;
+	void Prefetch(ConstBuffer<const char *> uris) const override;
 
 	virtual bool Visit(const DatabaseSelection &selection,
 			   VisitDirectory visit_directory,
@@ -128,9 +218,35 @@ public:
 		return update_stamp;
 	}
 
+	/**
+	 * Obtain the "lsinfo" response of the given directory,
+	 * either from #directory_cache or from the other MPD.
+	 *
+	 * @return the entity list or nullptr on error
+	 */
+	std::shared_ptr<const ProxyEntityList> ListDirectory(const char *uri,
+							     Error &error) const;
+
 private:
+	/**
+	 * Add a song to #song_cache, which takes over ownership.
+	 */
+	void CacheSong(mpd_song *song) const;
+
+	void FlushCache() const;
+
 	bool Configure(const ConfigBlock &block, Error &error);
 
+	/**
+	 * Does #host specify a host name (or address), as opposed to
+	 * a local socket or libmpdclient's default?
+	 */
+	gcc_pure
+	bool IsHostName() const {
+		return !host.empty() && host.front() != '/' &&
+			host.front() != '@';
+	}
+
 	bool Connect(Error &error);
 	bool CheckConnection(Error &error);
 	bool EnsureConnected(Error &error);
@@ -142,6 +258,10 @@ private:
 
 	/* virtual methods from IdleMonitor */
 	virtual void OnIdle() override;
+
+	/* virtual methods from ResolverHandler */
+	void OnResolverSuccess(const ResolverResult &addresses) override;
+	void OnResolverError(const Error &error) override;
 };
 
 static constexpr Domain libmpdclient_domain("libmpdclient");
@@ -345,36 +465,84 @@ ProxyDatabase::Configure(const ConfigBlock &block, gcc_unused Error &error)
 bool
 ProxyDatabase::Open(Error &error)
 {
-	if (!Connect(error))
-		return false;
-
+	connection = nullptr;
 	update_stamp = 0;
 
-	return true;
+	ResolverResult addresses;
+	if (IsHostName() &&
+	    !resolver_get().LookupCached(host.c_str(), port, 0, SOCK_STREAM,
+					 addresses)) {
+		/* don't block the startup on a slow DNS server;
+		   connect as soon as the host name is resolved, or
+		   when the database is used first */
+		resolve.Start(host.c_str(), port, 0, SOCK_STREAM);
+		return true;
+	}
+
+	return Connect(error);
 }
 
 void
 ProxyDatabase::Close()
 {
+	resolve.Cancel();
+
 	if (connection != nullptr)
 		Disconnect();
+
+	FlushCache();
 }
 
-bool
-ProxyDatabase::Connect(Error &error)
+/**
+ * Wrapper for mpd_connection_new() which returns nullptr on error.
+ */
+static struct mpd_connection *
+ConnectHost(const char *host, unsigned port, Error &error)
 {
-	const char *_host = host.empty() ? nullptr : host.c_str();
-	connection = mpd_connection_new(_host, port, 0);
-	if (connection == nullptr) {
+	struct mpd_connection *c = mpd_connection_new(host, port, 0);
+	if (c == nullptr) {
 		error.Set(libmpdclient_domain, (int)MPD_ERROR_OOM,
 			  "Out of memory");
-		return false;
+		return nullptr;
 	}
 
-	if (!CheckError(connection, error)) {
-		mpd_connection_free(connection);
-		connection = nullptr;
+	if (!CheckError(c, error)) {
+		mpd_connection_free(c);
+		return nullptr;
+	}
+
+	return c;
+}
+
+bool
+ProxyDatabase::Connect(Error &error)
+{
+	ResolverResult addresses;
+	if (IsHostName() &&
+	    resolver_get().LookupCached(host.c_str(), port, 0, SOCK_STREAM,
+					addresses)) {
+		/* pass numeric addresses from the resolver cache to
+		   libmpdclient, which would resolve the name
+		   synchronously */
+		for (const auto &address : addresses) {
+			const auto s = sockaddr_host_to_string(address);
+			if (s.empty())
+				continue;
+
+			error.Clear();
+			connection = ConnectHost(s.c_str(), port, error);
+			if (connection != nullptr)
+				break;
+		}
+	} else {
+		const char *_host = host.empty() ? nullptr : host.c_str();
+		connection = ConnectHost(_host, port, error);
+	}
 
+	if (connection == nullptr) {
+		if (!error.IsDefined())
+			error.Format(libmpdclient_domain,
+				     "Failed to connect to %s", host.c_str());
 		return false;
 	}
 
@@ -385,6 +553,9 @@ ProxyDatabase::Connect(Error &error)
 	idle_received = unsigned(-1);
 	is_idle = false;
 
+	/* idle events may have been missed while disconnected */
+	FlushCache();
+
 	SocketMonitor::Open(mpd_async_get_fd(mpd_connection_get_async(connection)));
 	IdleMonitor::Schedule();
 
@@ -471,8 +642,10 @@ ProxyDatabase::OnIdle()
 
 	/* handle previous idle events */
 
-	if (idle_received & MPD_IDLE_DATABASE)
+	if (idle_received & MPD_IDLE_DATABASE) {
+		FlushCache();
 		listener.OnDatabaseModified();
+	}
 
 	idle_received = 0;
 
@@ -497,9 +670,61 @@ ProxyDatabase::OnIdle()
 	SocketMonitor::ScheduleRead();
 }
 
+void
+ProxyDatabase::OnResolverSuccess(gcc_unused const ResolverResult &addresses)
+{
+	if (connection != nullptr)
+		/* a client request has connected meanwhile */
+		return;
+
+	/* Connect() picks up the result from the resolver cache */
+	Error error;
+	if (!Connect(error))
+		LogError(error);
+}
+
+void
+ProxyDatabase::OnResolverError(const Error &error)
+{
+	LogError(error);
+}
+
+void
+ProxyDatabase::CacheSong(mpd_song *song) const
+{
+	if (song_cache.size() >= PROXY_SONG_CACHE_SIZE) {
+		/* simply start over; a full cache means the client
+		   walks more songs than it can hold anyway */
+		for (const auto &i : song_cache)
+			mpd_song_free(i.second);
+		song_cache.clear();
+	}
+
+	auto result = song_cache.emplace(mpd_song_get_uri(song), song);
+	if (!result.second) {
+		mpd_song_free(result.first->second);
+		result.first->second = song;
+	}
+}
+
+void
+ProxyDatabase::FlushCache() const
+{
+	for (const auto &i : song_cache)
+		mpd_song_free(i.second);
+	song_cache.clear();
+
+	directory_cache.clear();
+	stats_cached = false;
+}
+
 const LightSong *
 ProxyDatabase::GetSong(const char *uri, Error &error) const
 {
+	auto i = song_cache.find(uri);
+	if (i != song_cache.end())
+		return new AllocatedProxySong(mpd_song_dup(i->second));
+
 	// TODO: eliminate the const_cast
 	if (!const_cast<ProxyDatabase *>(this)->EnsureConnected(error))
 		return nullptr;
@@ -522,6 +747,7 @@ ProxyDatabase::GetSong(const char *uri, Error &error) const
 		return nullptr;
 	}
 
+	CacheSong(mpd_song_dup(song));
 	return new AllocatedProxySong(song);
 }
 
@@ -535,14 +761,73 @@ ProxyDatabase::ReturnSong(const LightSong *_song) const
 	delete song;
 }
 
+void
+ProxyDatabase::Prefetch(ConstBuffer<const char *> uris) const
+{
+	std::vector<const char *> missing;
+	for (const char *uri : uris)
+		if (song_cache.find(uri) == song_cache.end())
+			missing.push_back(uri);
+
+	if (missing.empty())
+		return;
+
+	Error error;
+	// TODO: eliminate the const_cast
+	if (!const_cast<ProxyDatabase *>(this)->EnsureConnected(error)) {
+		LogError(error);
+		return;
+	}
+
+	/* send "lsinfo" commands in command lists instead of one
+	   round trip per song; if one fails (e.g. the song has been
+	   deleted), the other MPD aborts the list, and the next list
+	   starts after the failed one */
+	size_t i = 0;
+	while (i < missing.size()) {
+		const size_t end = std::min(i + PROXY_PREFETCH_BATCH,
+					    missing.size());
+
+		bool sent = mpd_command_list_begin(connection, true);
+		for (size_t j = i; sent && j < end; ++j)
+			sent = mpd_send_list_meta(connection, missing[j]);
+		sent = sent && mpd_command_list_end(connection);
+		if (!sent) {
+			if (!CheckError(connection, error))
+				LogError(error);
+			return;
+		}
+
+		for (; i < end; ++i) {
+			mpd_song *song;
+			while ((song = mpd_recv_song(connection)) != nullptr)
+				CacheSong(song);
+
+			if (i + 1 < end && !mpd_response_next(connection))
+				break;
+		}
+
+		mpd_response_finish(connection);
+
+		if (mpd_connection_get_error(connection) == MPD_ERROR_SERVER) {
+			/* skip the song which was not found */
+			mpd_connection_clear_error(connection);
+			++i;
+		} else if (!CheckError(connection, error)) {
+			LogError(error);
+			return;
+		}
+	}
+}
+
 static bool
-Visit(struct mpd_connection *connection, const char *uri,
+Visit(const ProxyDatabase &db, const char *uri,
       bool recursive, const SongFilter *filter,
       VisitDirectory visit_directory, VisitSong visit_song,
       VisitPlaylist visit_playlist, Error &error);
 
 static bool
-Visit(struct mpd_connection *connection,
+Visit(const ProxyDatabase &db,
       bool recursive, const SongFilter *filter,
       const struct mpd_directory *directory,
       VisitDirectory visit_directory, VisitSong visit_song,
@@ -560,7 +845,7 @@ Visit(struct mpd_connection *connection,
 		return false;
 
 	if (recursive &&
-	    !Visit(connection, path, recursive, filter,
+	    !Visit(db, path, recursive, filter,
 		   visit_directory, visit_song, visit_playlist, error))
 		return false;
 
@@ -599,64 +884,64 @@ Visit(const struct mpd_playlist *playlist,
 	return visit_playlist(p, LightDirectory::Root(), error);
 }
 
-class ProxyEntity {
+static ProxyEntityList
+ReceiveEntities(struct mpd_connection *connection)
+{
+	ProxyEntityList entities;
 	struct mpd_entity *entity;
+	while ((entity = mpd_recv_entity(connection)) != nullptr)
+		entities.push_back(ProxyEntity(entity));
 
-public:
-	explicit ProxyEntity(struct mpd_entity *_entity)
-		:entity(_entity) {}
-
-	ProxyEntity(const ProxyEntity &other) = delete;
+	mpd_response_finish(connection);
+	return entities;
+}
 
-	ProxyEntity(ProxyEntity &&other)
-		:entity(other.entity) {
-		other.entity = nullptr;
-	}
+std::shared_ptr<const ProxyEntityList>
+ProxyDatabase::ListDirectory(const char *uri, Error &error) const
+{
+	auto i = directory_cache.find(uri);
+	if (i != directory_cache.end())
+		return i->second;
 
-	~ProxyEntity() {
-		if (entity != nullptr)
-			mpd_entity_free(entity);
+	if (!mpd_send_list_meta(connection, uri)) {
+		CheckError(connection, error);
+		return nullptr;
 	}
 
-	ProxyEntity &operator=(const ProxyEntity &other) = delete;
+	std::shared_ptr<const ProxyEntityList>
+		entities(new ProxyEntityList(ReceiveEntities(connection)));
+	if (!CheckError(connection, error))
+		return nullptr;
 
-	operator const struct mpd_entity *() const {
-		return entity;
-	}
-};
+	/* remember the songs for GetSong() */
+	for (const auto &entity : *entities)
+		if (mpd_entity_get_type(entity) == MPD_ENTITY_TYPE_SONG)
+			CacheSong(mpd_song_dup(mpd_entity_get_song(entity)));
 
-static std::list<ProxyEntity>
-ReceiveEntities(struct mpd_connection *connection)
-{
-	std::list<ProxyEntity> entities;
-	struct mpd_entity *entity;
-	while ((entity = mpd_recv_entity(connection)) != nullptr)
-		entities.push_back(ProxyEntity(entity));
+	if (directory_cache.size() >= PROXY_DIRECTORY_CACHE_SIZE)
+		directory_cache.clear();
 
-	mpd_response_finish(connection);
+	directory_cache.emplace(uri, entities);
 	return entities;
 }
 
 static bool
-Visit(struct mpd_connection *connection, const char *uri,
+Visit(const ProxyDatabase &db, const char *uri,
       bool recursive, const SongFilter *filter,
       VisitDirectory visit_directory, VisitSong visit_song,
       VisitPlaylist visit_playlist, Error &error)
 {
-	if (!mpd_send_list_meta(connection, uri))
-		return CheckError(connection, error);
-
-	std::list<ProxyEntity> entities(ReceiveEntities(connection));
-	if (!CheckError(connection, error))
+	const auto entities = db.ListDirectory(uri, error);
+	if (entities == nullptr)
 		return false;
 
-	for (const auto &entity : entities) {
+	for (const auto &entity : *entities) {
 		switch (mpd_entity_get_type(entity)) {
 		case MPD_ENTITY_TYPE_UNKNOWN:
 			break;
 
 		case MPD_ENTITY_TYPE_DIRECTORY:
-			if (!Visit(connection, recursive, filter,
+			if (!Visit(db, recursive, filter,
 				   mpd_entity_get_directory(entity),
 				   visit_directory, visit_song, visit_playlist,
 				   error))
@@ -678,7 +963,7 @@ Visit(struct mpd_connection *connection, const char *uri,
 		}
 	}
 
-	return CheckError(connection, error);
+	return true;
 }
 
 static bool
@@ -747,8 +1032,9 @@ ProxyDatabase::Visit(const DatabaseSelection &selection,
 		   certain conditions */
 		return ::SearchSongs(connection, selection, visit_song, error);
 
-	/* fall back to recursive walk (slow!) */
-	return ::Visit(connection, selection.uri.c_str(),
+	/* fall back to recursive walk (slow, but the directories
+	   are cached) */
+	return ::Visit(*this, selection.uri.c_str(),
 		       selection.recursive, selection.filter,
 		       visit_directory, visit_song, visit_playlist,
 		       error);
@@ -814,6 +1100,11 @@ ProxyDatabase::GetStats(const DatabaseSelection &selection,
 	// TODO: match
 	(void)selection;
 
+	if (stats_cached) {
+		stats = stats_cache;
+		return true;
+	}
+
 	// TODO: eliminate the const_cast
 	if (!const_cast<ProxyDatabase *>(this)->EnsureConnected(error))
 		return false;
@@ -831,6 +1122,8 @@ ProxyDatabase::GetStats(const DatabaseSelection &selection,
 	stats.album_count = mpd_stats_get_number_of_albums(stats2);
 	mpd_stats_free(stats2);
 
+	stats_cache = stats;
+	stats_cached = true;
 	return true;
 }
 
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "BinaryFormat.hxx"
+#include "db/DatabaseError.hxx"
+#include "fs/Charset.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagItem.hxx"
+#include "tag/TagPool.hxx"
+#include "tag/TagSettings.h"
+#include "util/Error.hxx"
+
+#include <string.h>
+
+static constexpr size_t binary_section_record_size[BINARY_SECTION_COUNT] = {
+	1,
+	sizeof(uint32_t),
+	sizeof(BinaryTagItem),
+	sizeof(uint32_t),
+	sizeof(BinarySong),
+	sizeof(BinaryDirectory),
+	sizeof(BinaryPlaylist),
+};
+
+bool
+BinaryDatabaseReader::Check(Error &error)
+{
+	if (size < sizeof(header) ||
+	    memcmp(header.magic, BINARY_DB_MAGIC, sizeof(header.magic)) != 0) {
+		error.Set(db_domain, "Not a binary database file");
+		return false;
+	}
+
+	if (header.byte_order != BINARY_DB_BYTE_ORDER ||
+	    header.version != BINARY_DB_VERSION) {
+		error.Set(db_domain,
+			  "Database format mismatch, "
+			  "discarding database file");
+		return false;
+	}
+
+	for (unsigned i = 0; i < BINARY_SECTION_COUNT; ++i) {
+		const auto &s = header.sections[i];
+		const uint64_t record_size = binary_section_record_size[i];
+		if (s.offset % 8 != 0 || s.offset > size ||
+		    s.count > (size - s.offset) / record_size) {
+			error.Set(db_domain, "Database corrupted");
+			return false;
+		}
+	}
+
+	const auto s = GetSection<char>(BINARY_SECTION_STRINGS);
+	strings = s.data;
+	strings_size = s.size;
+
+	/* the last string must be terminated; this guarantees that
+	   every valid string reference points to a terminated
+	   string */
+	if (strings_size == 0 || strings[strings_size - 1] != 0 ||
+	    !IsValidString(header.fs_charset)) {
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	return true;
+}
+
+bool
+BinaryDatabaseReader::CheckCharset(Error &error) const
+{
+	const char *new_charset = GetString(GetFSCharset());
+	const char *const old_charset = ::GetFSCharset();
+	if (*old_charset != 0 && strcmp(new_charset, old_charset) != 0) {
+		error.Format(db_domain,
+			     "Existing database has charset "
+			     "\"%s\" instead of \"%s\"; "
+			     "discarding database file",
+			     new_charset, old_charset);
+		return false;
+	}
+
+	return true;
+}
+
+bool
+LoadBinaryTagTypes(const BinaryDatabaseReader &reader,
+		   std::vector<TagType> &tag_types, Error &error)
+{
+	bool tags[TAG_NUM_OF_ITEM_TYPES];
+	memset(tags, false, sizeof(tags));
+
+	for (uint32_t ref : reader.GetSection<uint32_t>(BINARY_SECTION_TAG_TYPES)) {
+		if (!reader.IsValidString(ref)) {
+			error.Set(db_domain, "Database corrupted");
+			return false;
+		}
+
+		const char *name = reader.GetString(ref);
+		TagType tag = tag_name_parse(name);
+		if (tag == TAG_NUM_OF_ITEM_TYPES) {
+			error.Format(db_domain,
+				     "Unrecognized tag '%s', "
+				     "discarding database file",
+				     name);
+			return false;
+		}
+
+		tags[tag] = true;
+		tag_types.push_back(tag);
+	}
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		if (!ignore_tag_items[i] && !tags[i]) {
+			error.Set(db_domain,
+				  "Tag list mismatch, "
+				  "discarding database file");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool
+LoadBinaryTagItems(const BinaryDatabaseReader &reader,
+		   const std::vector<TagType> &tag_types,
+		   std::vector<TagItem *> &items, Error &error)
+{
+	for (const auto &i : reader.GetSection<BinaryTagItem>(BINARY_SECTION_ITEMS)) {
+		if (i.type >= tag_types.size() || !reader.IsValidString(i.value)) {
+			error.Set(db_domain, "Database corrupted");
+			return false;
+		}
+
+		const TagType type = tag_types[i.type];
+		const char *value = reader.GetString(i.value);
+		const size_t length = strlen(value);
+
+		items.push_back(ignore_tag_items[type] || length == 0
+				? nullptr
+				: tag_pool_get_item(type, value, length));
+	}
+
+	return true;
+}
+
+void
+FreeBinaryTagItems(std::vector<TagItem *> &items)
+{
+	for (auto i : items)
+		if (i != nullptr)
+			tag_pool_put_item(i);
+
+	items.clear();
+}
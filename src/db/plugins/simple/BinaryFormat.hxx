@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DATABASE_BINARY_FORMAT_HXX
+#define MPD_DATABASE_BINARY_FORMAT_HXX
+
+#include "tag/TagType.h"
+#include "util/ConstBuffer.hxx"
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct TagItem;
+class Error;
+
+/*
+ * All integers are stored in host byte order; BinaryHeader::byte_order
+ * is used to detect files written on a different architecture.  All
+ * sections start at an 8 byte boundary, so the records can be
+ * accessed directly in the mapped file.
+ */
+
+static constexpr char BINARY_DB_MAGIC[8] = {
+	'M', 'P', 'D', 'B', 'I', 'N', 'D', 'B',
+};
+
+static constexpr uint32_t BINARY_DB_VERSION = 2;
+static constexpr uint32_t BINARY_DB_BYTE_ORDER = 0x01020304;
+
+/**
+ * The "parent" value of the root directory.
+ */
+static constexpr uint32_t BINARY_DB_NO_PARENT = 0xffffffff;
+
+/**
+ * Flag for BinarySong::flags: Tag::has_playlist.
+ */
+static constexpr uint32_t BINARY_SONG_HAS_PLAYLIST = 0x1;
+
+enum BinarySection {
+	/**
+	 * The string table: null-terminated strings, referenced by
+	 * their byte offset.  Count is the size in bytes.
+	 */
+	BINARY_SECTION_STRINGS,
+
+	/**
+	 * The names of the tag types (string references), which are
+	 * referenced by BinaryTagItem::type.
+	 */
+	BINARY_SECTION_TAG_TYPES,
+
+	/**
+	 * #BinaryTagItem records; each distinct tag item is stored
+	 * only once.
+	 */
+	BINARY_SECTION_ITEMS,
+
+	/**
+	 * Indexes into #BINARY_SECTION_ITEMS (uint32_t), referenced
+	 * by BinarySong::first_item.
+	 */
+	BINARY_SECTION_SONG_ITEMS,
+
+	BINARY_SECTION_SONGS,
+
+	/**
+	 * #BinaryDirectory records in pre-order; the first one is the
+	 * root directory.
+	 */
+	BINARY_SECTION_DIRECTORIES,
+
+	BINARY_SECTION_PLAYLISTS,
+
+	BINARY_SECTION_COUNT
+};
+
+struct BinarySectionHeader {
+	uint64_t offset;
+	uint64_t count;
+};
+
+struct BinaryHeader {
+	char magic[sizeof(BINARY_DB_MAGIC)];
+	uint32_t version;
+	uint32_t byte_order;
+
+	/**
+	 * String reference: the filesystem charset.
+	 */
+	uint32_t fs_charset;
+
+	uint32_t reserved;
+
+	BinarySectionHeader sections[BINARY_SECTION_COUNT];
+};
+
+struct BinaryTagItem {
+	uint32_t type;
+	uint32_t value;
+};
+
+struct BinarySong {
+	uint32_t uri;
+	uint32_t first_item, n_items;
+
+	/**
+	 * The duration in milliseconds; negative if unknown.
+	 */
+	int32_t duration_ms;
+
+	uint32_t start_ms, end_ms;
+	int64_t mtime;
+	uint32_t flags;
+	uint32_t reserved;
+
+	/**
+	 * The file size in bytes; 0 if unknown.
+	 */
+	uint64_t size;
+};
+
+struct BinaryDirectory {
+	uint32_t name;
+	uint32_t parent;
+	uint32_t first_song, n_songs;
+	uint32_t first_playlist, n_playlists;
+	uint32_t device;
+	uint32_t reserved;
+	int64_t mtime;
+};
+
+struct BinaryPlaylist {
+	uint32_t name;
+	uint32_t reserved;
+	int64_t mtime;
+};
+
+static_assert(sizeof(BinaryHeader) % 8 == 0, "Wrong header size");
+static_assert(sizeof(BinarySong) % 8 == 0, "Wrong record size");
+static_assert(sizeof(BinaryDirectory) % 8 == 0, "Wrong record size");
+static_assert(sizeof(BinaryPlaylist) % 8 == 0, "Wrong record size");
+
+static constexpr size_t
+BinaryAlign(size_t size)
+{
+	return (size + 7) & ~size_t(7);
+}
+
+/**
+ * Provides validated access to the sections of a mapped binary
+ * database file.
+ */
+class BinaryDatabaseReader {
+	const uint8_t *const data;
+	const size_t size;
+
+	const BinaryHeader &header;
+
+	const char *strings;
+	size_t strings_size;
+
+public:
+	BinaryDatabaseReader(ConstBuffer<void> buffer)
+		:data((const uint8_t *)buffer.data), size(buffer.size),
+		 header(*(const BinaryHeader *)buffer.data) {}
+
+	/**
+	 * Validate the header and the section table.  Must be called
+	 * before any other method.
+	 */
+	bool Check(Error &error);
+
+	/**
+	 * Check that the file was written with the current
+	 * filesystem charset.
+	 */
+	bool CheckCharset(Error &error) const;
+
+	template<typename T>
+	ConstBuffer<T> GetSection(BinarySection section) const {
+		const auto &s = header.sections[section];
+		return {(const T *)(data + s.offset), (size_t)s.count};
+	}
+
+	bool IsValidString(uint32_t ref) const {
+		return ref < strings_size;
+	}
+
+	const char *GetString(uint32_t ref) const {
+		return strings + ref;
+	}
+
+	uint32_t GetFSCharset() const {
+		return header.fs_charset;
+	}
+};
+
+/**
+ * Translates the tag type table of the file to #TagType values, and
+ * checks that all enabled tag types were enabled when the file was
+ * written (like the "tag:" lines of the text format).
+ */
+bool
+LoadBinaryTagTypes(const BinaryDatabaseReader &reader,
+		   std::vector<TagType> &tag_types, Error &error);
+
+/**
+ * Obtains one #TagItem reference from the #TagPool for each distinct
+ * tag item in the file.  Items of tag types which are disabled now
+ * are nullptr.  Caller must lock #tag_pool_lock.
+ */
+bool
+LoadBinaryTagItems(const BinaryDatabaseReader &reader,
+		   const std::vector<TagType> &tag_types,
+		   std::vector<TagItem *> &items, Error &error);
+
+/**
+ * Release the references obtained by LoadBinaryTagItems() and clear
+ * the vector.
+ */
+void
+FreeBinaryTagItems(std::vector<TagItem *> &items);
+
+#endif
@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "DatabaseBinary.hxx"
+#include "BinaryFormat.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/DatabaseError.hxx"
+#include "db/PlaylistVector.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "fs/io/OutputStream.hxx"
+#include "fs/io/MappedFile.hxx"
+#include "fs/Path.hxx"
+#include "fs/Charset.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagItem.hxx"
+#include "tag/TagPool.hxx"
+#include "tag/TagSettings.h"
+#include "util/Arena.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <limits>
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Collects all records in memory, to be written by Write().
+ */
+class BinaryDatabaseWriter {
+	std::string strings;
+
+	/**
+	 * Look-up table for deduplicating strings which occur often
+	 * (tag values and names).
+	 */
+	std::unordered_map<std::string, uint32_t> string_map;
+
+	/**
+	 * Maps #TagType to an index in #tag_types.
+	 */
+	uint32_t tag_type_index[TAG_NUM_OF_ITEM_TYPES];
+
+	/**
+	 * Maps pooled #TagItem pointers (which are unique for each
+	 * distinct type/value pair) to an index in #items.
+	 */
+	std::unordered_map<const TagItem *, uint32_t> item_map;
+
+	std::vector<uint32_t> tag_types;
+	std::vector<BinaryTagItem> items;
+	std::vector<uint32_t> song_items;
+	std::vector<BinarySong> songs;
+	std::vector<BinaryDirectory> directories;
+	std::vector<BinaryPlaylist> playlists;
+
+public:
+	BinaryDatabaseWriter() {
+		/* reference 0 is the empty string */
+		strings.push_back(0);
+
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+			if (ignore_tag_items[i]) {
+				tag_type_index[i] = BINARY_DB_NO_PARENT;
+				continue;
+			}
+
+			tag_type_index[i] = tag_types.size();
+			tag_types.push_back(AddString(tag_item_names[i]));
+		}
+	}
+
+	void AddDirectory(const Directory &directory, uint32_t parent);
+
+	bool Write(OutputStream &os, Error &error);
+
+private:
+	uint32_t AppendString(const char *s) {
+		const size_t offset = strings.size();
+		strings.append(s, strlen(s) + 1);
+		return offset;
+	}
+
+	uint32_t AddString(const char *s) {
+		auto i = string_map.emplace(s, 0);
+		if (i.second)
+			i.first->second = AppendString(s);
+		return i.first->second;
+	}
+
+	uint32_t AddItem(const TagItem &item) {
+		auto i = item_map.emplace(&item, 0);
+		if (i.second) {
+			i.first->second = items.size();
+			items.push_back({tag_type_index[item.type],
+					 AddString(item.value)});
+		}
+
+		return i.first->second;
+	}
+
+	void AddSong(const Song &song);
+};
+
+inline void
+BinaryDatabaseWriter::AddSong(const Song &song)
+{
+	BinarySong s;
+	s.uri = AppendString(song.uri);
+	s.first_item = song_items.size();
+
+	for (const auto &item : song.tag) {
+		if (tag_type_index[item.type] == BINARY_DB_NO_PARENT)
+			continue;
+
+		song_items.push_back(AddItem(item));
+	}
+
+	s.n_items = song_items.size() - s.first_item;
+	s.duration_ms = song.tag.duration.IsNegative()
+		? -1
+		: song.tag.duration.ToMS();
+	s.start_ms = song.start_time.ToMS();
+	s.end_ms = song.end_time.ToMS();
+	s.mtime = song.mtime;
+	s.size = song.size;
+	s.flags = song.tag.has_playlist ? BINARY_SONG_HAS_PLAYLIST : 0;
+	s.reserved = 0;
+
+	songs.push_back(s);
+}
+
+void
+BinaryDatabaseWriter::AddDirectory(const Directory &directory,
+				   uint32_t parent)
+{
+	const uint32_t index = directories.size();
+
+	BinaryDirectory d;
+	d.name = directory.IsRoot() ? 0 : AppendString(directory.GetName());
+	d.parent = parent;
+	d.device = directory.device == DEVICE_INARCHIVE ||
+		directory.device == DEVICE_CONTAINER
+		? directory.device
+		: 0;
+	d.reserved = 0;
+	d.mtime = directory.mtime;
+
+	d.first_song = songs.size();
+	for (const auto &song : directory.songs)
+		AddSong(song);
+	d.n_songs = songs.size() - d.first_song;
+
+	d.first_playlist = playlists.size();
+	for (const auto &playlist : directory.playlists)
+		playlists.push_back({AppendString(playlist.name.c_str()), 0,
+				     (int64_t)playlist.mtime});
+	d.n_playlists = playlists.size() - d.first_playlist;
+
+	directories.push_back(d);
+
+	for (const auto &child : directory.children)
+		/* mount points are not saved; they belong to another
+		   database */
+		if (!child.IsMount())
+			AddDirectory(child, index);
+}
+
+static bool
+WritePadded(OutputStream &os, const void *data, size_t size, Error &error)
+{
+	static constexpr char padding[8] = {};
+
+	return os.Write(data, size, error) &&
+		os.Write(padding, BinaryAlign(size) - size, error);
+}
+
+template<typename T>
+static bool
+WriteSection(OutputStream &os, const std::vector<T> &v, Error &error)
+{
+	return WritePadded(os, v.data(), v.size() * sizeof(T), error);
+}
+
+bool
+BinaryDatabaseWriter::Write(OutputStream &os, Error &error)
+{
+	const uint32_t fs_charset = AddString(GetFSCharset());
+
+	if (strings.size() > std::numeric_limits<uint32_t>::max() ||
+	    song_items.size() > std::numeric_limits<uint32_t>::max()) {
+		error.Set(db_domain, "Database too large for the binary format");
+		return false;
+	}
+
+	BinaryHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BINARY_DB_MAGIC, sizeof(header.magic));
+	header.version = BINARY_DB_VERSION;
+	header.byte_order = BINARY_DB_BYTE_ORDER;
+	header.fs_charset = fs_charset;
+
+	const size_t sizes[BINARY_SECTION_COUNT][2] = {
+		{ strings.size(), 1 },
+		{ tag_types.size(), sizeof(tag_types.front()) },
+		{ items.size(), sizeof(items.front()) },
+		{ song_items.size(), sizeof(song_items.front()) },
+		{ songs.size(), sizeof(songs.front()) },
+		{ directories.size(), sizeof(directories.front()) },
+		{ playlists.size(), sizeof(playlists.front()) },
+	};
+
+	uint64_t offset = sizeof(header);
+	for (unsigned i = 0; i < BINARY_SECTION_COUNT; ++i) {
+		header.sections[i].offset = offset;
+		header.sections[i].count = sizes[i][0];
+		offset += BinaryAlign(sizes[i][0] * sizes[i][1]);
+	}
+
+	return os.Write(&header, sizeof(header), error) &&
+		WritePadded(os, strings.data(), strings.size(), error) &&
+		WriteSection(os, tag_types, error) &&
+		WriteSection(os, items, error) &&
+		WriteSection(os, song_items, error) &&
+		WriteSection(os, songs, error) &&
+		WriteSection(os, directories, error) &&
+		WriteSection(os, playlists, error);
+}
+
+bool
+db_save_binary(OutputStream &os, const Directory &root, Error &error)
+{
+	BinaryDatabaseWriter writer;
+	writer.AddDirectory(root, BINARY_DB_NO_PARENT);
+	return writer.Write(os, error);
+}
+
+/**
+ * Add a reference to a cached #TagItem.
+ */
+static TagItem *
+DupCachedItem(TagItem *&cached)
+{
+	TagItem *item = tag_pool_dup_item(cached);
+	if (item != cached) {
+		/* the reference counter of the cached item has
+		   overflowed, and the #TagPool has allocated a new
+		   one; cache that instead, or else each following
+		   call would allocate yet another one */
+		tag_pool_put_item(cached);
+		cached = tag_pool_dup_item(item);
+	}
+
+	return item;
+}
+
+static bool
+LoadSong(const BinaryDatabaseReader &reader, const BinarySong &s,
+	 std::vector<TagItem *> &items, Directory &directory,
+	 Arena &arena, Error &error)
+{
+	const auto song_items =
+		reader.GetSection<uint32_t>(BINARY_SECTION_SONG_ITEMS);
+
+	if (!reader.IsValidString(s.uri) || *reader.GetString(s.uri) == 0 ||
+	    s.first_item > song_items.size ||
+	    s.n_items > song_items.size - s.first_item ||
+	    s.n_items > std::numeric_limits<decltype(Tag::num_items)>::max()) {
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	const uint32_t *const first = song_items.data + s.first_item;
+	unsigned n = 0;
+	for (unsigned i = 0; i < s.n_items; ++i) {
+		if (first[i] >= items.size()) {
+			error.Set(db_domain, "Database corrupted");
+			return false;
+		}
+
+		if (items[first[i]] != nullptr)
+			++n;
+	}
+
+	Song *song = Song::NewFile(reader.GetString(s.uri), directory,
+				   arena);
+	song->mtime = s.mtime;
+	song->size = s.size;
+	song->start_time = SongTime::FromMS(s.start_ms);
+	song->end_time = SongTime::FromMS(s.end_ms);
+
+	Tag &tag = song->tag;
+	tag.duration = s.duration_ms < 0
+		? SignedSongTime::Negative()
+		: SignedSongTime::FromMS(s.duration_ms);
+	tag.has_playlist = (s.flags & BINARY_SONG_HAS_PLAYLIST) != 0;
+
+	if (n > 0) {
+		tag.num_items = n;
+		tag.items = arena.NewArray<TagItem *>(n);
+		tag.foreign_items = true;
+
+		unsigned j = 0;
+		for (unsigned i = 0; i < s.n_items; ++i)
+			if (items[first[i]] != nullptr)
+				tag.items[j++] = DupCachedItem(items[first[i]]);
+	}
+
+	directory.AddSong(song);
+	return true;
+}
+
+static bool
+LoadDirectories(const BinaryDatabaseReader &reader, Directory &root,
+		std::vector<TagItem *> &items, Arena &arena, Error &error)
+{
+	const auto directories =
+		reader.GetSection<BinaryDirectory>(BINARY_SECTION_DIRECTORIES);
+	const auto songs = reader.GetSection<BinarySong>(BINARY_SECTION_SONGS);
+	const auto playlists =
+		reader.GetSection<BinaryPlaylist>(BINARY_SECTION_PLAYLISTS);
+
+	if (directories.IsEmpty() ||
+	    directories.front().parent != BINARY_DB_NO_PARENT) {
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	std::vector<Directory *> loaded;
+	loaded.reserve(directories.size);
+
+	for (const auto &d : directories) {
+		Directory *directory;
+		if (loaded.empty()) {
+			directory = &root;
+		} else {
+			if (d.parent >= loaded.size() ||
+			    !reader.IsValidString(d.name) ||
+			    *reader.GetString(d.name) == 0 ||
+			    loaded[d.parent]->FindChild(reader.GetString(d.name)) != nullptr) {
+				error.Set(db_domain, "Database corrupted");
+				return false;
+			}
+
+			directory = loaded[d.parent]->CreateChild(reader.GetString(d.name));
+			directory->device = d.device;
+		}
+
+		directory->mtime = d.mtime;
+		loaded.push_back(directory);
+
+		if (d.first_song > songs.size ||
+		    d.n_songs > songs.size - d.first_song ||
+		    d.first_playlist > playlists.size ||
+		    d.n_playlists > playlists.size - d.first_playlist) {
+			error.Set(db_domain, "Database corrupted");
+			return false;
+		}
+
+		for (unsigned i = 0; i < d.n_songs; ++i)
+			if (!LoadSong(reader, songs[d.first_song + i],
+				      items, *directory, arena, error))
+				return false;
+
+		for (unsigned i = 0; i < d.n_playlists; ++i) {
+			const auto &p = playlists[d.first_playlist + i];
+			if (!reader.IsValidString(p.name)) {
+				error.Set(db_domain, "Database corrupted");
+				return false;
+			}
+
+			directory->playlists.push_back(PlaylistInfo(reader.GetString(p.name),
+								    (time_t)p.mtime));
+		}
+	}
+
+	return true;
+}
+
+bool
+db_load_binary(Path path, Directory &root, Arena &arena, Error &error)
+{
+	MappedFile file;
+	if (!file.Open(path, error))
+		return false;
+
+	BinaryDatabaseReader reader(file.Get());
+	if (!reader.Check(error))
+		return false;
+
+	if (!reader.CheckCharset(error))
+		return false;
+
+	std::vector<TagType> tag_types;
+	if (!LoadBinaryTagTypes(reader, tag_types, error))
+		return false;
+
+	LogDebug(db_domain, "reading DB");
+
+	std::vector<TagItem *> items;
+	bool success;
+
+	{
+		const ScopeLock protect(tag_pool_lock);
+		success = LoadBinaryTagItems(reader, tag_types, items, error);
+	}
+
+	if (success) {
+		db_lock();
+		success = LoadDirectories(reader, root, items, arena,
+					  error);
+		db_unlock();
+	}
+
+	FreeBinaryTagItems(items);
+	return success;
+}
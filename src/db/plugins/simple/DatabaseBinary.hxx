@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DATABASE_BINARY_HXX
+#define MPD_DATABASE_BINARY_HXX
+
+struct Directory;
+class OutputStream;
+class Path;
+class Error;
+class Arena;
+
+/**
+ * Save the database in the binary format: a string table and
+ * fixed-size records for directories, songs, tag items and
+ * playlists.  Unlike the text format, it cannot be compressed,
+ * because db_load_binary() maps the file into memory.
+ */
+bool
+db_save_binary(OutputStream &os, const Directory &root, Error &error);
+
+/**
+ * Load a database file which was written by db_save_binary().  The
+ * songs and their tag item arrays are allocated from the given
+ * #Arena.
+ */
+bool
+db_load_binary(Path path, Directory &root, Arena &arena, Error &error);
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DatabaseJournal.hxx"
+#include "DirectorySave.hxx"
+#include "Directory.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/DatabaseError.hxx"
+#include "fs/io/OutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/io/TextFile.hxx"
+#include "util/StringUtil.hxx"
+#include "util/Error.hxx"
+
+#include <stdlib.h>
+
+#define JOURNAL_BASE "journal_base: "
+
+/**
+ * An #OutputStream which calculates the FNV-1a hash and the size of
+ * everything written to it.
+ */
+class HashOutputStream final : public OutputStream {
+	uint64_t hash;
+	uint64_t size;
+
+public:
+	HashOutputStream() {
+		Reset();
+	}
+
+	void Reset() {
+		hash = 14695981039346656037ull;
+		size = 0;
+	}
+
+	uint64_t GetHash() const {
+		return hash;
+	}
+
+	uint64_t GetSize() const {
+		return size;
+	}
+
+	/* virtual methods from class OutputStream */
+	bool Write(const void *data, size_t length,
+		   gcc_unused Error &error) override {
+		const unsigned char *p = (const unsigned char *)data;
+		for (size_t i = 0; i < length; ++i)
+			hash = (hash ^ p[i]) * 1099511628211ull;
+
+		size += length;
+		return true;
+	}
+};
+
+class JournalScanner {
+	HashOutputStream hash_os;
+	BufferedOutputStream hash_bos;
+
+	BufferedOutputStream *const os;
+
+public:
+	uint64_t total_size = 0;
+
+	explicit JournalScanner(BufferedOutputStream *_os)
+		:hash_bos(hash_os), os(_os) {}
+
+	void Scan(Directory &directory) {
+		hash_os.Reset();
+		directory_save_shallow(hash_bos, directory);
+		hash_bos.Flush();
+
+		total_size += hash_os.GetSize();
+
+		if (hash_os.GetHash() != directory.journal_hash) {
+			directory.journal_hash = hash_os.GetHash();
+
+			if (os != nullptr)
+				directory_save_shallow(*os, directory);
+		}
+
+		for (auto &child : directory.children)
+			if (!child.IsMount())
+				Scan(child);
+	}
+};
+
+uint64_t
+db_journal_scan(Directory &root, BufferedOutputStream *os)
+{
+	assert(holding_db_lock());
+
+	JournalScanner scanner(os);
+	scanner.Scan(root);
+	return scanner.total_size;
+}
+
+void
+db_journal_save_header(BufferedOutputStream &os,
+		       uint64_t base_size, time_t base_mtime)
+{
+	os.Format(JOURNAL_BASE "%llu %lu\n",
+		  (unsigned long long)base_size, (unsigned long)base_mtime);
+}
+
+bool
+db_journal_load(TextFile &file, uint64_t base_size, time_t base_mtime,
+		Directory &root, Arena &arena, Error &error)
+{
+	const char *line = file.ReadLine();
+	if (line == nullptr || !StringStartsWith(line, JOURNAL_BASE)) {
+		error.Set(db_domain, "Journal corrupted");
+		return false;
+	}
+
+	char *endptr;
+	const uint64_t size =
+		strtoull(line + sizeof(JOURNAL_BASE) - 1, &endptr, 10);
+	const time_t mtime = strtoul(endptr, &endptr, 10);
+	if (size != base_size || mtime != base_mtime) {
+		error.Set(db_domain,
+			  "Journal does not belong to the database file");
+		return false;
+	}
+
+	db_lock();
+	bool success = directory_load_shallow(file, root, arena, error);
+	db_unlock();
+
+	return success;
+}
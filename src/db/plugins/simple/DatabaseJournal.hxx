@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DATABASE_JOURNAL_HXX
+#define MPD_DATABASE_JOURNAL_HXX
+
+#include <stdint.h>
+#include <time.h>
+
+struct Directory;
+class BufferedOutputStream;
+class TextFile;
+class Error;
+class Arena;
+
+/*
+ * The database journal: if only a few directories have been modified,
+ * they are appended to a journal file instead of rewriting the whole
+ * database file (in the text format).  Each record is written by
+ * directory_save_shallow() and replaces the contents of one directory.
+ * The journal begins with a line which identifies the database file
+ * it applies to.
+ */
+
+/**
+ * Calculate the journal record hashes of all directories.  The
+ * records of directories whose hash differs from
+ * Directory::journal_hash are written to the given stream (unless it
+ * is nullptr), and the new hash is remembered.
+ *
+ * The caller must hold the database lock (shared access is enough).
+ *
+ * @return the total size of all records, which approximates the size
+ * of the database in the text format
+ */
+uint64_t
+db_journal_scan(Directory &root, BufferedOutputStream *os);
+
+/**
+ * Write the first line of a new journal.
+ *
+ * @param base_size the size of the database file
+ * @param base_mtime the modification time of the database file
+ */
+void
+db_journal_save_header(BufferedOutputStream &os,
+		       uint64_t base_size, time_t base_mtime);
+
+/**
+ * Load a journal and apply it to the directory tree.  Fails if it
+ * does not belong to the specified database file.  On error, the
+ * tree must be discarded.
+ */
+bool
+db_journal_load(TextFile &file, uint64_t base_size, time_t base_mtime,
+		Directory &root, Arena &arena, Error &error);
+
+#endif
@@ -42,7 +42,7 @@
 #define DIRECTORY_FS_CHARSET "fs_charset: "
 #define DB_TAG_PREFIX "tag: "
 
-static constexpr unsigned DB_FORMAT = 2;
+static constexpr unsigned DB_FORMAT = 3;
 
 /**
  * The oldest database format understood by this MPD version.
@@ -67,7 +67,8 @@ db_save_internal(BufferedOutputStream &os, const Directory &music_root)
 }
 
 bool
-db_load_internal(TextFile &file, Directory &music_root, Error &error)
+db_load_internal(TextFile &file, Directory &music_root, Arena &arena,
+		 Error &error)
 {
 	char *line;
 	unsigned format = 0;
@@ -153,7 +154,7 @@ db_load_internal(TextFile &file, Directory &music_root, Error &error)
 	LogDebug(db_domain, "reading DB");
 
 	db_lock();
-	success = directory_load(file, music_root, error);
+	success = directory_load(file, music_root, arena, error);
 	db_unlock();
 
 	return success;
@@ -24,11 +24,17 @@ struct Directory;
 class BufferedOutputStream;
 class TextFile;
 class Error;
+class Arena;
 
 void
 db_save_internal(BufferedOutputStream &os, const Directory &root);
 
+/**
+ * Load a database file which was written by db_save_internal().  The
+ * songs are allocated from the given #Arena.
+ */
 bool
-db_load_internal(TextFile &file, Directory &root, Error &error);
+db_load_internal(TextFile &file, Directory &root, Arena &arena,
+		 Error &error);
 
 #endif
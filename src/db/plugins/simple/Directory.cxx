@@ -29,20 +29,23 @@
 #include "db/Interface.hxx"
 #include "SongFilter.hxx"
 #include "lib/icu/Collate.hxx"
-#include "fs/Traits.hxx"
 #include "util/Alloc.hxx"
 #include "util/Error.hxx"
 
+#include <iterator>
+
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 
-Directory::Directory(std::string &&_path_utf8, Directory *_parent)
-	:parent(_parent),
+Directory::Directory(std::string &&_name_utf8, Directory *_parent)
+	:song_count(0),
+	 parent(_parent),
 	 mtime(0),
 	 inode(0), device(0),
-	 path(std::move(_path_utf8)),
-	 mounted_database(nullptr)
+	 name(std::move(_name_utf8)),
+	 mounted_database(nullptr),
+	 journal_hash(0)
 {
 }
 
@@ -50,68 +53,91 @@ Directory::~Directory()
 {
 	delete mounted_database;
 
+	song_index.reset();
 	songs.clear_and_dispose(Song::Disposer());
+	child_index.reset();
 	children.clear_and_dispose(Disposer());
 }
 
+
 void
 Directory::Delete()
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 	assert(parent != nullptr);
 
+	parent->child_index->erase(name.c_str());
 	parent->children.erase_and_dispose(parent->children.iterator_to(*this),
 					   Disposer());
 }
 
-const char *
-Directory::GetName() const
+std::string
+Directory::GetPath() const
 {
-	assert(!IsRoot());
+	if (IsRoot())
+		return std::string();
+
+	size_t length = name.length();
+	for (const Directory *d = parent; !d->IsRoot(); d = d->parent)
+		length += d->name.length() + 1;
+
+	/* fill the buffer from the end */
+	std::string result(length, '/');
+	for (const Directory *d = this; !d->IsRoot(); d = d->parent) {
+		length -= d->name.length();
+		result.replace(length, d->name.length(), d->name);
+		if (length > 0)
+			--length;
+	}
 
-	return PathTraitsUTF8::GetBase(path.c_str());
+	return result;
 }
 
 Directory *
 Directory::CreateChild(const char *name_utf8)
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 	assert(name_utf8 != nullptr);
 	assert(*name_utf8 != 0);
 
-	std::string path_utf8 = IsRoot()
-		? std::string(name_utf8)
-		: PathTraitsUTF8::Build(GetPath(), name_utf8);
+	assert(FindChild(name_utf8) == nullptr);
 
-	Directory *child = new Directory(std::move(path_utf8), this);
+	if (child_index == nullptr)
+		child_index.reset(new ChildIndex());
+
+	Directory *child = new Directory(std::string(name_utf8), this);
 	children.push_back(*child);
+	child_index->emplace(child->GetName(), child);
 	return child;
 }
 
 const Directory *
-Directory::FindChild(const char *name) const
+Directory::FindChild(const char *_name) const
 {
 	assert(holding_db_lock());
 
-	for (const auto &child : children)
-		if (strcmp(child.GetName(), name) == 0)
-			return &child;
+	if (child_index == nullptr)
+		return nullptr;
 
-	return nullptr;
+	auto i = child_index->find(_name);
+	return i != child_index->end()
+		? i->second
+		: nullptr;
 }
 
 void
 Directory::PruneEmpty()
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 
 	for (auto child = children.begin(), end = children.end();
 	     child != end;) {
 		child->PruneEmpty();
 
-		if (child->IsEmpty())
+		if (child->IsEmpty()) {
+			child_index->erase(child->GetName());
 			child = children.erase_and_dispose(child, Disposer());
-		else
+		} else
 			++child;
 	}
 }
@@ -125,18 +151,18 @@ Directory::LookupDirectory(const char *uri)
 	if (isRootDirectory(uri))
 		return { this, nullptr };
 
-	char *duplicated = xstrdup(uri), *name = duplicated;
+	char *duplicated = xstrdup(uri), *segment = duplicated;
 
 	Directory *d = this;
 	while (true) {
-		char *slash = strchr(name, '/');
-		if (slash == name)
+		char *slash = strchr(segment, '/');
+		if (slash == segment)
 			break;
 
 		if (slash != nullptr)
 			*slash = '\0';
 
-		Directory *tmp = d->FindChild(name);
+		Directory *tmp = d->FindChild(segment);
 		if (tmp == nullptr)
 			/* not found */
 			break;
@@ -145,18 +171,18 @@ Directory::LookupDirectory(const char *uri)
 
 		if (slash == nullptr) {
 			/* found everything */
-			name = nullptr;
+			segment = nullptr;
 			break;
 		}
 
-		name = slash + 1;
+		segment = slash + 1;
 	}
 
 	free(duplicated);
 
-	const char *rest = name == nullptr
+	const char *rest = segment == nullptr
 		? nullptr
-		: uri + (name - duplicated);
+		: uri + (segment - duplicated);
 
 	return { d, rest };
 }
@@ -164,21 +190,35 @@ Directory::LookupDirectory(const char *uri)
 void
 Directory::AddSong(Song *song)
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 	assert(song != nullptr);
 	assert(song->parent == this);
 
 	songs.push_back(*song);
+	++song_count;
+
+	if (song_index != nullptr) {
+		song_index->emplace(song->uri, song);
+	} else if (song_count >= SONG_INDEX_THRESHOLD) {
+		song_index.reset(new SongNameIndex());
+		song_index->reserve(song_count);
+		for (auto &i : songs)
+			song_index->emplace(i.uri, &i);
+	}
 }
 
 void
 Directory::RemoveSong(Song *song)
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 	assert(song != nullptr);
 	assert(song->parent == this);
 
 	songs.erase(songs.iterator_to(*song));
+	--song_count;
+
+	if (song_index != nullptr)
+		song_index->erase(song->uri);
 }
 
 const Song *
@@ -187,6 +227,13 @@ Directory::FindSong(const char *name_utf8) const
 	assert(holding_db_lock());
 	assert(name_utf8 != nullptr);
 
+	if (song_index != nullptr) {
+		auto i = song_index->find(name_utf8);
+		return i != song_index->end()
+			? i->second
+			: nullptr;
+	}
+
 	for (auto &song : songs) {
 		assert(song.parent == this);
 
@@ -201,28 +248,48 @@ gcc_pure
 static bool
 directory_cmp(const Directory &a, const Directory &b)
 {
-	return IcuCollate(a.path.c_str(), b.path.c_str()) < 0;
+	/* both are children of the same directory, so comparing the
+	   base names is enough */
+	return IcuCollate(a.name.c_str(), b.name.c_str()) < 0;
+}
+
+inline void
+Directory::SortChildren(std::vector<SongList *> &song_lists, size_t &n_songs)
+{
+	children.sort(directory_cmp);
+
+	if (!songs.empty()) {
+		song_lists.push_back(&songs);
+		n_songs += song_count;
+	}
+
+	for (auto &child : children)
+		child.SortChildren(song_lists, n_songs);
 }
 
 void
 Directory::Sort()
 {
-	assert(holding_db_lock());
+	assert(holding_db_lock_exclusive());
 
-	children.sort(directory_cmp);
-	song_list_sort(songs);
+	/* sort the directories first, and collect the song lists to
+	   sort them all at once */
+	std::vector<SongList *> song_lists;
+	size_t n_songs = 0;
+	SortChildren(song_lists, n_songs);
 
-	for (auto &child : children)
-		child.Sort();
+	song_lists_sort(song_lists, n_songs);
 }
 
-bool
-Directory::Walk(bool recursive, const SongFilter *filter,
+inline bool
+Directory::Walk(const std::string &path,
+		bool recursive, const SongFilter *filter,
 		VisitDirectory visit_directory, VisitSong visit_song,
 		VisitPlaylist visit_playlist,
 		Error &error) const
 {
 	assert(!error.IsDefined());
+	assert(path == GetPath());
 
 	if (IsMount()) {
 		assert(IsEmpty());
@@ -230,20 +297,32 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 		/* TODO: eliminate this unlock/lock; it is necessary
 		   because the child's SimpleDatabasePlugin::Visit()
 		   call will lock it again */
-		db_unlock();
-		bool result = WalkMount(GetPath(), *mounted_database,
+		db_unlock_shared();
+		bool result = WalkMount(path.c_str(), *mounted_database, "",
 					recursive, filter,
 					visit_directory, visit_song,
 					visit_playlist,
 					error);
-		db_lock();
+		db_lock_shared();
 		return result;
 	}
 
-	if (visit_song) {
+	const auto base_match = filter != nullptr
+		? filter->CheckBase(path.c_str())
+		: SongFilter::BaseMatch::ALL;
+	if (base_match == SongFilter::BaseMatch::NONE &&
+	    !visit_directory && !visit_playlist)
+		/* nothing in this subtree can match the "base"
+		   items */
+		return true;
+
+	if (visit_song && base_match != SongFilter::BaseMatch::NONE) {
 		for (auto &song : songs){
-			const LightSong song2 = song.Export();
-			if ((filter == nullptr || filter->Match(song2)) &&
+			const LightSong song2 = song.Export(path);
+			if ((filter == nullptr ||
+			     (base_match == SongFilter::BaseMatch::ALL
+			      ? filter->MatchIgnoringBase(song2)
+			      : filter->Match(song2))) &&
 			    !visit_song(song2, error))
 				return false;
 		}
@@ -251,17 +330,30 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 
 	if (visit_playlist) {
 		for (const PlaylistInfo &p : playlists)
-			if (!visit_playlist(p, Export(), error))
+			if (!visit_playlist(p, Export(path), error))
 				return false;
 	}
 
+	if (children.empty())
+		return true;
+
+	/* build the children's paths incrementally instead of
+	   calling GetPath() for each of them */
+	std::string child_path(path);
+	if (!child_path.empty())
+		child_path.push_back('/');
+	const size_t prefix_length = child_path.length();
+
 	for (auto &child : children) {
+		child_path.replace(prefix_length, std::string::npos,
+				   child.name);
+
 		if (visit_directory &&
-		    !visit_directory(child.Export(), error))
+		    !visit_directory(child.Export(child_path), error))
 			return false;
 
 		if (recursive &&
-		    !child.Walk(recursive, filter,
+		    !child.Walk(child_path, recursive, filter,
 				visit_directory, visit_song, visit_playlist,
 				error))
 			return false;
@@ -270,8 +362,13 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 	return true;
 }
 
-LightDirectory
-Directory::Export() const
+bool
+Directory::Walk(bool recursive, const SongFilter *filter,
+		VisitDirectory visit_directory, VisitSong visit_song,
+		VisitPlaylist visit_playlist,
+		Error &error) const
 {
-	return LightDirectory(GetPath(), mtime);
+	return Walk(GetPath(), recursive, filter,
+		    visit_directory, visit_song, visit_playlist,
+		    error);
 }
@@ -24,11 +24,19 @@
 #include "Compiler.h"
 #include "db/Visitor.hxx"
 #include "db/PlaylistVector.hxx"
+#include "db/LightDirectory.hxx"
 #include "Song.hxx"
+#include "util/StringHash.hxx"
 
 #include <boost/intrusive/list.hpp>
 
 #include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+
+#include <assert.h>
+#include <stdint.h>
 
 /**
  * Virtual directory that is really an archive file or a folder inside
@@ -82,6 +90,19 @@ struct Directory {
 	 */
 	List children;
 
+	typedef std::unordered_map<const char *, Directory *,
+				   CStringHash, CStringEqual> ChildIndex;
+
+	/**
+	 * An index of #children by their name, for FindChild().  The
+	 * keys point to the #name of each child.  It is allocated
+	 * with the first child, so leaf directories (the majority)
+	 * don't pay for it.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	std::unique_ptr<ChildIndex> child_index;
+
 	/**
 	 * A doubly linked list of songs within this directory.
 	 *
@@ -90,13 +111,38 @@ struct Directory {
 	 */
 	SongList songs;
 
+	/**
+	 * The number of items in #songs.
+	 */
+	unsigned song_count;
+
+	typedef std::unordered_map<const char *, Song *,
+				   CStringHash, CStringEqual> SongNameIndex;
+
+	/**
+	 * An index of #songs by their name, for FindSong().  The keys
+	 * point to Song::uri.  It is only allocated when the
+	 * directory contains at least #SONG_INDEX_THRESHOLD songs;
+	 * smaller directories are searched linearly.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	std::unique_ptr<SongNameIndex> song_index;
+
+	static constexpr unsigned SONG_INDEX_THRESHOLD = 32;
+
 	PlaylistVector playlists;
 
 	Directory *parent;
 	time_t mtime;
 	unsigned inode, device;
 
-	std::string path;
+	/**
+	 * The base name of this directory (UTF-8); empty in the root
+	 * directory.  The full path is not stored, GetPath()
+	 * reconstructs it from the #parent chain.
+	 */
+	std::string name;
 
 	/**
 	 * If this is not nullptr, then this directory does not really
@@ -104,8 +150,17 @@ struct Directory {
 	 */
 	Database *mounted_database;
 
+	/**
+	 * The hash of this directory's journal record (see
+	 * DatabaseJournal.hxx) when the database was last saved.  If
+	 * the record hashes differently now, the directory has been
+	 * modified since.  Only used by the thread which loads and
+	 * saves the database.
+	 */
+	uint64_t journal_hash;
+
 public:
-	Directory(std::string &&_path_utf8, Directory *_parent);
+	Directory(std::string &&_name_utf8, Directory *_parent);
 	~Directory();
 
 	/**
@@ -142,12 +197,12 @@ public:
 	 * Caller must lock the #db_mutex.
 	 */
 	gcc_pure
-	const Directory *FindChild(const char *name) const;
+	const Directory *FindChild(const char *_name) const;
 
 	gcc_pure
-	Directory *FindChild(const char *name) {
+	Directory *FindChild(const char *_name) {
 		const Directory *cthis = this;
-		return const_cast<Directory *>(cthis->FindChild(name));
+		return const_cast<Directory *>(cthis->FindChild(_name));
 	}
 
 	/**
@@ -194,16 +249,25 @@ public:
 			playlists.empty();
 	}
 
+	/**
+	 * Build the path of this directory relative to the music
+	 * directory by walking up the #parent chain.  Returns an
+	 * empty string for the root directory.
+	 *
+	 * Caller must lock the #db_mutex (or be the update thread).
+	 */
 	gcc_pure
-	const char *GetPath() const {
-		return path.c_str();
-	}
+	std::string GetPath() const;
 
 	/**
 	 * Returns the base name of the directory.
 	 */
 	gcc_pure
-	const char *GetName() const;
+	const char *GetName() const {
+		assert(!IsRoot());
+
+		return name.c_str();
+	}
 
 	/**
 	 * Is this the root directory of the music database?
@@ -270,16 +334,37 @@ public:
 	 */
 	void Sort();
 
+private:
 	/**
-	 * Caller must lock #db_mutex.
+	 * Sort the child directories recursively, and collect the
+	 * song lists for song_lists_sort().
+	 */
+	void SortChildren(std::vector<SongList *> &song_lists,
+			  size_t &n_songs);
+
+	bool Walk(const std::string &path,
+		  bool recursive, const SongFilter *match,
+		  VisitDirectory visit_directory, VisitSong visit_song,
+		  VisitPlaylist visit_playlist,
+		  Error &error) const;
+
+public:
+	/**
+	 * Caller must lock #db_mutex (shared access is enough).
 	 */
 	bool Walk(bool recursive, const SongFilter *match,
 		  VisitDirectory visit_directory, VisitSong visit_song,
 		  VisitPlaylist visit_playlist,
 		  Error &error) const;
 
+	/**
+	 * @param path the return value of GetPath(); the returned
+	 * object points into it
+	 */
 	gcc_pure
-	LightDirectory Export() const;
+	LightDirectory Export(const std::string &path) const {
+		return LightDirectory(path.c_str(), mtime);
+	}
 };
 
 #endif
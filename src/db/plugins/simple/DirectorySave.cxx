@@ -22,6 +22,7 @@
 #include "Directory.hxx"
 #include "Song.hxx"
 #include "SongSave.hxx"
+#include "SongLoadPool.hxx"
 #include "DetachedSong.hxx"
 #include "PlaylistDatabase.hxx"
 #include "fs/io/TextFile.hxx"
@@ -31,8 +32,13 @@
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 
+#include <algorithm>
+#include <set>
+#include <string>
+
 #include <stddef.h>
 #include <string.h>
+#include <unistd.h>
 
 #define DIRECTORY_DIR "directory: "
 #define DIRECTORY_TYPE "type: "
@@ -70,20 +76,31 @@ ParseTypeString(const char *type)
 		return 0;
 }
 
+/**
+ * Write the attributes of a directory, followed by the "begin" line.
+ */
+static void
+SaveHeader(BufferedOutputStream &os, const Directory &directory,
+	   const char *path)
+{
+	const char *type = DeviceToTypeString(directory.device);
+	if (type != nullptr)
+		os.Format(DIRECTORY_TYPE "%s\n", type);
+
+	if (directory.mtime != 0)
+		os.Format(DIRECTORY_MTIME "%lu\n",
+			  (unsigned long)directory.mtime);
+
+	os.Format("%s%s\n", DIRECTORY_BEGIN, path);
+}
+
 void
 directory_save(BufferedOutputStream &os, const Directory &directory)
 {
-	if (!directory.IsRoot()) {
-		const char *type = DeviceToTypeString(directory.device);
-		if (type != nullptr)
-			os.Format(DIRECTORY_TYPE "%s\n", type);
-
-		if (directory.mtime != 0)
-			os.Format(DIRECTORY_MTIME "%lu\n",
-				  (unsigned long)directory.mtime);
+	const std::string path = directory.GetPath();
 
-		os.Format("%s%s\n", DIRECTORY_BEGIN, directory.GetPath());
-	}
+	if (!directory.IsRoot())
+		SaveHeader(os, directory, path.c_str());
 
 	for (const auto &child : directory.children) {
 		os.Format(DIRECTORY_DIR "%s\n", child.GetName());
@@ -101,7 +118,29 @@ directory_save(BufferedOutputStream &os, const Directory &directory)
 	playlist_vector_save(os, directory.playlists);
 
 	if (!directory.IsRoot())
-		os.Format(DIRECTORY_END "%s\n", directory.GetPath());
+		os.Format(DIRECTORY_END "%s\n", path.c_str());
+}
+
+void
+directory_save_shallow(BufferedOutputStream &os, const Directory &directory)
+{
+	const std::string path = directory.GetPath();
+
+	/* the root directory has an empty path, which would be
+	   ambiguous here */
+	const char *const path_s = directory.IsRoot() ? "/" : path.c_str();
+
+	SaveHeader(os, directory, path_s);
+
+	for (const auto &child : directory.children)
+		os.Format(DIRECTORY_DIR "%s\n", child.GetName());
+
+	for (const auto &song : directory.songs)
+		song_save(os, song);
+
+	playlist_vector_save(os, directory.playlists);
+
+	os.Format(DIRECTORY_END "%s\n", path_s);
 }
 
 static bool
@@ -119,26 +158,134 @@ ParseLine(Directory &directory, const char *line)
 	return true;
 }
 
-static Directory *
-directory_load_subdir(TextFile &file, Directory &parent, const char *name,
-		      Error &error)
+/**
+ * Start a new #SongLoadChunk after this many bytes of text.
+ */
+static constexpr size_t SONG_LOAD_CHUNK_SIZE = 256 * 1024;
+
+/**
+ * The maximum number of #SongLoadChunk objects per thread which may
+ * be in flight; this limits the amount of memory occupied by text
+ * which has not been parsed yet.
+ */
+static constexpr unsigned SONG_LOAD_CHUNKS_PER_THREAD = 4;
+
+static constexpr unsigned SONG_LOAD_MAX_THREADS = 16;
+
+static unsigned
+GetSongLoadThreadCount()
 {
-	bool success;
+#ifdef _SC_NPROCESSORS_ONLN
+	/* the calling thread reads the file; the others parse
+	   songs */
+	const long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n > 1)
+		return std::min<unsigned long>(n - 1, SONG_LOAD_MAX_THREADS);
+#endif
+
+	return 0;
+}
 
+/**
+ * The state of directory_load(), shared by all recursion levels.
+ */
+struct DirectoryLoader {
+	TextFile &file;
+
+	SongLoadPool pool;
+
+	/**
+	 * The chunk which is currently being filled; it is passed to
+	 * the #pool when it is full.
+	 */
+	SongLoadChunk *chunk = nullptr;
+
+	unsigned max_chunks;
+
+	DirectoryLoader(TextFile &_file, Arena &arena)
+		:file(_file), pool(arena) {
+		const unsigned n_threads = GetSongLoadThreadCount();
+		pool.Start(n_threads);
+		max_chunks = std::max(n_threads, 1u) *
+			SONG_LOAD_CHUNKS_PER_THREAD;
+	}
+
+	~DirectoryLoader() {
+		delete chunk;
+	}
+
+	bool Flush(Error &error) {
+		if (chunk != nullptr) {
+			pool.Push(chunk);
+			chunk = nullptr;
+		}
+
+		while (pool.GetCount() > max_chunks)
+			if (!pool.MergeOne(error))
+				return false;
+
+		return true;
+	}
+
+	/**
+	 * Copy the lines of a song to the current chunk, to be parsed
+	 * by the #pool.
+	 */
+	bool LoadSong(Directory &directory, const char *name,
+		      Error &error) {
+		if (chunk == nullptr)
+			chunk = new SongLoadChunk();
+
+		chunk->directories.push_back(&directory);
+		chunk->AppendLine(name);
+
+		const char *line;
+		while ((line = file.ReadLine()) != nullptr) {
+			chunk->AppendLine(line);
+			if (strcmp(line, SONG_END) == 0)
+				break;
+		}
+
+		return chunk->GetSize() < SONG_LOAD_CHUNK_SIZE ||
+			Flush(error);
+	}
+
+	bool LoadDirectory(Directory &directory, Error &error);
+
+	bool LoadSubdir(Directory &parent, const char *name,
+			Error &error);
+
+	bool Finish(Error &error) {
+		return Flush(error) && pool.MergeAll(error);
+	}
+
+	/**
+	 * Load a record written by directory_save_shallow() after its
+	 * "begin" line, and replace the contents of the directory.
+	 */
+	bool ReplaceDirectory(Directory &root, const char *path,
+			      const Directory &attributes, Error &error);
+};
+
+inline bool
+DirectoryLoader::LoadSubdir(Directory &parent, const char *name,
+			    Error &error)
+{
 	if (parent.FindChild(name) != nullptr) {
 		error.Format(directory_domain,
 			     "Duplicate subdirectory '%s'", name);
-		return nullptr;
+		return false;
 	}
 
+	/* on error, the caller discards the whole tree; it is not
+	   deleted here, because unmerged chunks may refer to it */
 	Directory *directory = parent.CreateChild(name);
 
 	while (true) {
 		const char *line = file.ReadLine();
 		if (line == nullptr) {
 			error.Set(directory_domain, "Unexpected end of file");
-			directory->Delete();
-			return nullptr;
+			return false;
 		}
 
 		if (StringStartsWith(line, DIRECTORY_BEGIN))
@@ -147,50 +294,96 @@ directory_load_subdir(TextFile &file, Directory &parent, const char *name,
 		if (!ParseLine(*directory, line)) {
 			error.Format(directory_domain,
 				     "Malformed line: %s", line);
-			directory->Delete();
-			return nullptr;
+			return false;
 		}
 	}
 
-	success = directory_load(file, *directory, error);
-	if (!success) {
-		directory->Delete();
-		return nullptr;
-	}
-
-	return directory;
+	return LoadDirectory(*directory, error);
 }
 
 bool
-directory_load(TextFile &file, Directory &directory, Error &error)
+DirectoryLoader::LoadDirectory(Directory &directory, Error &error)
 {
 	const char *line;
 
 	while ((line = file.ReadLine()) != nullptr &&
 	       !StringStartsWith(line, DIRECTORY_END)) {
 		if (StringStartsWith(line, DIRECTORY_DIR)) {
-			Directory *subdir =
-				directory_load_subdir(file, directory,
-						      line + sizeof(DIRECTORY_DIR) - 1,
-						      error);
-			if (subdir == nullptr)
+			if (!LoadSubdir(directory,
+					line + sizeof(DIRECTORY_DIR) - 1,
+					error))
 				return false;
 		} else if (StringStartsWith(line, SONG_BEGIN)) {
-			const char *name = line + sizeof(SONG_BEGIN) - 1;
-
-			if (directory.FindSong(name) != nullptr) {
-				error.Format(directory_domain,
-					     "Duplicate song '%s'", name);
+			if (!LoadSong(directory,
+				      line + sizeof(SONG_BEGIN) - 1,
+				      error))
 				return false;
-			}
-
-			DetachedSong *song = song_load(file, name, error);
-			if (song == nullptr)
+		} else if (StringStartsWith(line, PLAYLIST_META_BEGIN)) {
+			const char *name = line + sizeof(PLAYLIST_META_BEGIN) - 1;
+			if (!playlist_metadata_load(file, directory.playlists,
+						    name, error))
 				return false;
+		} else {
+			error.Format(directory_domain,
+				     "Malformed line: %s", line);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool
+directory_load(TextFile &file, Directory &directory, Arena &arena,
+	       Error &error)
+{
+	DirectoryLoader loader(file, arena);
+	return loader.LoadDirectory(directory, error) &&
+		loader.Finish(error);
+}
+
+inline bool
+DirectoryLoader::ReplaceDirectory(Directory &root, const char *path,
+				  const Directory &attributes, Error &error)
+{
+	const auto lr = root.LookupDirectory(path);
+	if (lr.uri != nullptr) {
+		error.Format(directory_domain,
+			     "No such directory: %s", path);
+		return false;
+	}
+
+	Directory &directory = *lr.directory;
+
+	/* songs of earlier records may still refer to child
+	   directories which are about to be deleted */
+	if (!Finish(error))
+		return false;
+
+	directory.mtime = attributes.mtime;
+	directory.device = attributes.device;
+
+	directory.ForEachSongSafe([&directory](Song &song){
+			directory.RemoveSong(&song);
+			song.Free();
+		});
 
-			directory.AddSong(Song::NewFrom(std::move(*song),
-							directory));
-			delete song;
+	directory.playlists = PlaylistVector();
+
+	std::set<std::string> children;
+
+	const char *line;
+	while ((line = file.ReadLine()) != nullptr &&
+	       !StringStartsWith(line, DIRECTORY_END)) {
+		if (StringStartsWith(line, DIRECTORY_DIR)) {
+			const char *name = line + sizeof(DIRECTORY_DIR) - 1;
+			directory.MakeChild(name);
+			children.emplace(name);
+		} else if (StringStartsWith(line, SONG_BEGIN)) {
+			if (!LoadSong(directory,
+				      line + sizeof(SONG_BEGIN) - 1,
+				      error))
+				return false;
 		} else if (StringStartsWith(line, PLAYLIST_META_BEGIN)) {
 			const char *name = line + sizeof(PLAYLIST_META_BEGIN) - 1;
 			if (!playlist_metadata_load(file, directory.playlists,
@@ -203,5 +396,51 @@ directory_load(TextFile &file, Directory &directory, Error &error)
 		}
 	}
 
+	if (line == nullptr) {
+		error.Set(directory_domain, "Unexpected end of file");
+		return false;
+	}
+
+	/* the record lists all children; the others have been
+	   deleted */
+	directory.ForEachChildSafe([&children](Directory &child){
+			if (children.find(child.GetName()) == children.end())
+				child.Delete();
+		});
+
 	return true;
 }
+
+bool
+directory_load_shallow(TextFile &file, Directory &root, Arena &arena,
+		       Error &error)
+{
+	DirectoryLoader loader(file, arena);
+
+	/* collects the attributes preceding the "begin" line */
+	Directory attributes(std::string(), nullptr);
+
+	const char *line;
+	while ((line = file.ReadLine()) != nullptr) {
+		if (StringStartsWith(line, DIRECTORY_BEGIN)) {
+			if (!loader.ReplaceDirectory(root,
+						     line + sizeof(DIRECTORY_BEGIN) - 1,
+						     attributes, error))
+				return false;
+
+			attributes.mtime = 0;
+			attributes.device = 0;
+		} else if (!ParseLine(attributes, line)) {
+			error.Format(directory_domain,
+				     "Malformed line: %s", line);
+			return false;
+		}
+	}
+
+	if (attributes.mtime != 0 || attributes.device != 0) {
+		error.Set(directory_domain, "Unexpected end of file");
+		return false;
+	}
+
+	return loader.Finish(error);
+}
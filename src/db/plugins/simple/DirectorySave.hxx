@@ -24,11 +24,38 @@ struct Directory;
 class TextFile;
 class BufferedOutputStream;
 class Error;
+class Arena;
 
 void
 directory_save(BufferedOutputStream &os, const Directory &directory);
 
+/**
+ * Save a directory, but not the contents of its children; only their
+ * names are listed.  This is a record of the database journal, see
+ * DatabaseJournal.hxx.
+ */
+void
+directory_save_shallow(BufferedOutputStream &os, const Directory &directory);
+
+/**
+ * Load a directory and its children.  The songs are allocated from
+ * the given #Arena.  They are parsed by a #SongLoadPool while this
+ * thread reads the file.  The caller must hold the database lock.
+ * On error, the partially loaded tree must be discarded.
+ */
+bool
+directory_load(TextFile &file, Directory &directory, Arena &arena,
+	       Error &error);
+
+/**
+ * Load all records written by directory_save_shallow() until the end
+ * of the file, and replace the contents of the directories they
+ * describe.  Children which are not listed in a record are deleted.
+ * The caller must hold the database lock.  On error, the tree may
+ * have been modified partially and must be discarded.
+ */
 bool
-directory_load(TextFile &file, Directory &directory, Error &error);
+directory_load_shallow(TextFile &file, Directory &root, Arena &arena,
+		       Error &error);
 
 #endif
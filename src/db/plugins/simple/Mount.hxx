@@ -27,7 +27,7 @@ class SongFilter;
 class Error;
 
 bool
-WalkMount(const char *base, const Database &db,
+WalkMount(const char *base, const Database &db, const char *uri,
 	  bool recursive, const SongFilter *filter,
 	  const VisitDirectory &visit_directory, const VisitSong &visit_song,
 	  const VisitPlaylist &visit_playlist,
@@ -26,14 +26,18 @@
 #include "db/UniqueTags.hxx"
 #include "db/LightDirectory.hxx"
 #include "Directory.hxx"
+#include "Mount.hxx"
 #include "Song.hxx"
 #include "SongFilter.hxx"
 #include "DatabaseSave.hxx"
+#include "DatabaseBinary.hxx"
+#include "DatabaseJournal.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/DatabaseError.hxx"
 #include "fs/io/TextFile.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "fs/io/FileOutputStream.hxx"
+#include "fs/io/StringOutputStream.hxx"
 #include "fs/FileInfo.hxx"
 #include "config/Block.hxx"
 #include "fs/FileSystem.hxx"
@@ -46,16 +50,29 @@
 #include "fs/io/GzipOutputStream.hxx"
 #endif
 
+#include <algorithm>
+
 #include <errno.h>
+#include <string.h>
 
 static constexpr Domain simple_db_domain("simple_db");
 
+/**
+ * Save() rewrites the whole database file instead of appending to the
+ * journal when the journal would exceed this fraction of the database
+ * size.
+ */
+static constexpr unsigned JOURNAL_MAX_RATIO = 4;
+
 inline SimpleDatabase::SimpleDatabase()
 	:Database(simple_db_plugin),
 	 path(AllocatedPath::Null()),
+	 format(FileFormat::TEXT),
 #ifdef ENABLE_ZLIB
 	 compress(true),
 #endif
+	 incremental_save(false),
+	 journal_path(AllocatedPath::Null()),
 	 cache_path(AllocatedPath::Null()),
 	 prefixed_light_song(nullptr) {}
 
@@ -67,9 +84,12 @@ inline SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
 	:Database(simple_db_plugin),
 	 path(std::move(_path)),
 	 path_utf8(path.ToUTF8()),
+	 format(FileFormat::TEXT),
 #ifdef ENABLE_ZLIB
 	 compress(_compress),
 #endif
+	 incremental_save(false),
+	 journal_path(AllocatedPath::Null()),
 	 cache_path(AllocatedPath::Null()),
 	 prefixed_light_song(nullptr) {
 }
@@ -105,10 +125,33 @@ SimpleDatabase::Configure(const ConfigBlock &block, Error &error)
 	if (path.IsNull() && error.IsDefined())
 		return false;
 
+	const char *format_name = block.GetBlockValue("format", "text");
+	if (strcmp(format_name, "text") == 0)
+		format = FileFormat::TEXT;
+	else if (strcmp(format_name, "binary") == 0)
+		format = FileFormat::BINARY;
+	else {
+		error.Format(simple_db_domain,
+			     "Unknown database file format: %s", format_name);
+		return false;
+	}
+
 #ifdef ENABLE_ZLIB
 	compress = block.GetBlockValue("compress", compress);
 #endif
 
+	incremental_save = block.GetBlockValue("incremental_save", false);
+	if (incremental_save) {
+		if (format != FileFormat::TEXT) {
+			error.Set(simple_db_domain,
+				  "\"incremental_save\" requires the text format");
+			return false;
+		}
+
+		journal_path = AllocatedPath::FromFS(std::string(path.c_str()) +
+						     ".journal");
+	}
+
 	return true;
 }
 
@@ -176,23 +219,87 @@ SimpleDatabase::Check(Error &error) const
 	return true;
 }
 
-bool
-SimpleDatabase::Load(Error &error)
+inline bool
+SimpleDatabase::LoadFile(Error &error)
 {
 	assert(!path.IsNull());
 	assert(root != nullptr);
 
-	TextFile file(path, error);
+	if (format == FileFormat::BINARY) {
+		if (!db_load_binary(path, *root, arena, error))
+			return false;
+	} else {
+		TextFile file(path, error);
+		if (file.HasFailed())
+			return false;
+
+		if (!db_load_internal(file, *root, arena, error) ||
+		    !file.Check(error))
+			return false;
+	}
+
+	return true;
+}
+
+inline bool
+SimpleDatabase::LoadJournal(const FileInfo &base, Error &error)
+{
+	FileInfo fi;
+	if (!GetFileInfo(journal_path, fi))
+		/* there is no journal */
+		return true;
+
+	TextFile file(journal_path, error);
 	if (file.HasFailed())
 		return false;
 
-	if (!db_load_internal(file, *root, error) || !file.Check(error))
+	if (!db_journal_load(file, base.GetSize(),
+			     base.GetModificationTime(),
+			     *root, arena, error) ||
+	    !file.Check(error))
+		return false;
+
+	journal_size = fi.GetSize();
+	mtime = std::max(mtime, fi.GetModificationTime());
+	return true;
+}
+
+bool
+SimpleDatabase::Load(Error &error)
+{
+	if (!LoadFile(error))
 		return false;
 
 	FileInfo fi;
 	if (GetFileInfo(path, fi))
 		mtime = fi.GetModificationTime();
 
+	if (incremental_save) {
+		if (!LoadJournal(fi, error)) {
+			LogError(error, "Discarding the database journal");
+			error.Clear();
+			RemoveFile(journal_path);
+			journal_size = 0;
+
+			/* the journal may have been applied partially;
+			   start over without it */
+			delete root;
+			arena.Clear();
+			root = Directory::NewRoot();
+
+			if (!LoadFile(error))
+				return false;
+		}
+
+		/* remember the state of all directories, so the
+		   next Save() finds the modified ones */
+		db_lock_shared();
+		db_journal_scan(*root, nullptr);
+		db_unlock_shared();
+
+		journal_consistent = true;
+	}
+
 	return true;
 }
 
@@ -202,7 +309,10 @@ SimpleDatabase::Open(Error &error)
 	assert(prefixed_light_song == nullptr);
 
 	root = Directory::NewRoot();
+	mount_count = 0;
 	mtime = 0;
+	journal_size = 0;
+	journal_consistent = false;
 
 #ifndef NDEBUG
 	borrowed_song_count = 0;
@@ -210,6 +320,7 @@ SimpleDatabase::Open(Error &error)
 
 	if (!Load(error)) {
 		delete root;
+		arena.Clear();
 
 		LogError(error);
 		error.Clear();
@@ -220,6 +331,10 @@ SimpleDatabase::Open(Error &error)
 		root = Directory::NewRoot();
 	}
 
+	db_lock();
+	index.AddRecursive(*root);
+	db_unlock();
+
 	return true;
 }
 
@@ -230,7 +345,12 @@ SimpleDatabase::Close()
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
+	db_lock();
+	index.Clear();
+	db_unlock();
+
 	delete root;
+	arena.Clear();
 }
 
 const LightSong *
@@ -240,13 +360,13 @@ SimpleDatabase::GetSong(const char *uri, Error &error) const
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
-	db_lock();
+	db_lock_shared();
 
 	auto r = root->LookupDirectory(uri);
 
 	if (r.directory->IsMount()) {
 		/* pass the request to the mounted database */
-		db_unlock();
+		db_unlock_shared();
 
 		const LightSong *song =
 			r.directory->mounted_database->GetSong(r.uri, error);
@@ -254,13 +374,14 @@ SimpleDatabase::GetSong(const char *uri, Error &error) const
 			return nullptr;
 
 		prefixed_light_song =
-			new PrefixedLightSong(*song, r.directory->GetPath());
+			new PrefixedLightSong(*song,
+					      r.directory->GetPath().c_str());
 		return prefixed_light_song;
 	}
 
 	if (r.uri == nullptr) {
 		/* it's a directory */
-		db_unlock();
+		db_unlock_shared();
 		error.Format(db_domain, DB_NOT_FOUND,
 			     "No such song: %s", uri);
 		return nullptr;
@@ -268,21 +389,24 @@ SimpleDatabase::GetSong(const char *uri, Error &error) const
 
 	if (strchr(r.uri, '/') != nullptr) {
 		/* refers to a URI "below" the actual song */
-		db_unlock();
+		db_unlock_shared();
 		error.Format(db_domain, DB_NOT_FOUND,
 			     "No such song: %s", uri);
 		return nullptr;
 	}
 
 	const Song *song = r.directory->FindSong(r.uri);
-	db_unlock();
 	if (song == nullptr) {
+		db_unlock_shared();
 		error.Format(db_domain, DB_NOT_FOUND,
 			     "No such song: %s", uri);
 		return nullptr;
 	}
 
-	light_song = song->Export();
+	light_song_directory = r.directory->GetPath();
+	db_unlock_shared();
+
+	light_song = song->Export(light_song_directory);
 
 #ifndef NDEBUG
 	++borrowed_song_count;
@@ -315,27 +439,71 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		      VisitPlaylist visit_playlist,
 		      Error &error) const
 {
-	ScopeDatabaseLock protect;
+	ScopeDatabaseSharedLock protect;
 
 	auto r = root->LookupDirectory(selection.uri.c_str());
 	if (r.uri == nullptr) {
 		/* it's a directory */
 
 		if (selection.recursive && visit_directory &&
-		    !visit_directory(r.directory->Export(), error))
+		    !visit_directory(r.directory->Export(r.directory->GetPath()),
+				     error))
 			return false;
 
+		std::vector<const Song *> songs;
+		if (visit_song && !visit_directory && !visit_playlist &&
+		    selection.filter != nullptr && mount_count == 0 &&
+		    index.Lookup(*r.directory, selection.recursive,
+				 *selection.filter, songs)) {
+			/* the songs are in database order, i.e. grouped
+			   by directory; build each path only once */
+			const Directory *parent = nullptr;
+			std::string parent_path;
+
+			for (const Song *song : songs) {
+				if (song->parent != parent) {
+					parent = song->parent;
+					parent_path = parent->GetPath();
+				}
+
+				const LightSong song2 = song->Export(parent_path);
+				if (selection.filter->Match(song2) &&
+				    !visit_song(song2, error))
+					return false;
+			}
+
+			return true;
+		}
+
 		return r.directory->Walk(selection.recursive, selection.filter,
 					 visit_directory, visit_song,
 					 visit_playlist,
 					 error);
 	}
 
+	if (r.directory->IsMount()) {
+		/* pass the request to the mounted database; see
+		   Directory::Walk() about this unlock/lock */
+		const std::string base = r.directory->GetPath();
+		const std::string rest(r.uri);
+		const Database &mounted = *r.directory->mounted_database;
+
+		db_unlock_shared();
+		bool result = WalkMount(base.c_str(), mounted, rest.c_str(),
+					selection.recursive, selection.filter,
+					visit_directory, visit_song,
+					visit_playlist,
+					error);
+		db_lock_shared();
+		return result;
+	}
+
 	if (strchr(r.uri, '/') == nullptr) {
 		if (visit_song) {
 			Song *song = r.directory->FindSong(r.uri);
 			if (song != nullptr) {
-				const LightSong song2 = song->Export();
+				const auto parent_path = r.directory->GetPath();
+				const LightSong song2 = song->Export(parent_path);
 				return !selection.Match(song2) ||
 					visit_song(song2, error);
 			}
@@ -346,44 +514,73 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 	return false;
 }
 
+/**
+ * Does the selection cover the whole database, which allows
+ * answering it with the #SongIndex statistics?
+ */
+gcc_pure
+static bool
+IsWholeDatabase(const DatabaseSelection &selection)
+{
+	return selection.uri.empty() && selection.recursive &&
+		selection.filter == nullptr;
+}
+
 bool
 SimpleDatabase::VisitUniqueTags(const DatabaseSelection &selection,
 				TagType tag_type, uint32_t group_mask,
 				VisitTag visit_tag,
 				Error &error) const
 {
+	if (group_mask == 0 && IsWholeDatabase(selection)) {
+		ScopeDatabaseSharedLock protect;
+
+		if (mount_count == 0)
+			return index.VisitUniqueTags(tag_type, visit_tag,
+						     error);
+	}
+
 	return ::VisitUniqueTags(*this, selection, tag_type, group_mask,
 				 visit_tag,
 				 error);
 }
 
 bool
-SimpleDatabase::GetStats(const DatabaseSelection &selection,
-			 DatabaseStats &stats, Error &error) const
+SimpleDatabase::VisitTagCounts(const DatabaseSelection &selection,
+			       TagType tag_type,
+			       VisitTagCount visit,
+			       Error &error) const
 {
-	return ::GetStats(*this, selection, stats, error);
+	if (IsWholeDatabase(selection)) {
+		ScopeDatabaseSharedLock protect;
+
+		if (mount_count == 0)
+			return index.VisitTagCounts(tag_type, visit, error);
+	}
+
+	return ::VisitTagCounts(*this, selection, tag_type, visit, error);
 }
 
 bool
-SimpleDatabase::Save(Error &error)
+SimpleDatabase::GetStats(const DatabaseSelection &selection,
+			 DatabaseStats &stats, Error &error) const
 {
-	db_lock();
+	if (IsWholeDatabase(selection)) {
+		ScopeDatabaseSharedLock protect;
 
-	LogDebug(simple_db_domain, "removing empty directories from DB");
-	root->PruneEmpty();
-
-	LogDebug(simple_db_domain, "sorting DB");
-	root->Sort();
-
-	db_unlock();
-
-	LogDebug(simple_db_domain, "writing DB");
+		if (mount_count == 0) {
+			index.GetStats(stats);
+			return true;
+		}
+	}
 
-	FileOutputStream fos(path, error);
-	if (!fos.IsDefined())
-		return false;
+	return ::GetStats(*this, selection, stats, error);
+}
 
-	OutputStream *os = &fos;
+inline bool
+SimpleDatabase::SaveText(OutputStream &_os, Error &error)
+{
+	OutputStream *os = &_os;
 
 #ifdef ENABLE_ZLIB
 	GzipOutputStream *gzip = nullptr;
@@ -418,6 +615,127 @@ SimpleDatabase::Save(Error &error)
 	}
 #endif
 
+	return true;
+}
+
+inline bool
+SimpleDatabase::SaveJournal(const std::string &records, Error &error)
+{
+	if (journal_size == 0) {
+		/* start a new journal which refers to the current
+		   database file */
+		FileInfo base;
+		if (!GetFileInfo(path, base, error))
+			return false;
+
+		FileOutputStream fos(journal_path, error);
+		if (!fos.IsDefined())
+			return false;
+
+		BufferedOutputStream bos(fos);
+		db_journal_save_header(bos, base.GetSize(),
+				       base.GetModificationTime());
+		bos.Write(records.data(), records.size());
+
+		if (!bos.Flush(error) || !fos.Commit(error))
+			return false;
+	} else {
+		AppendFileOutputStream fos(journal_path, error);
+		if (!fos.IsDefined())
+			return false;
+
+		if (!fos.Write(records.data(), records.size(), error) ||
+		    !fos.Commit(error))
+			return false;
+	}
+
+	FileInfo fi;
+	if (GetFileInfo(journal_path, fi)) {
+		journal_size = fi.GetSize();
+		mtime = fi.GetModificationTime();
+	}
+
+	return true;
+}
+
+bool
+SimpleDatabase::Save(Error &error)
+{
+	db_lock();
+
+	LogDebug(simple_db_domain, "removing empty directories from DB");
+	root->PruneEmpty();
+
+	LogDebug(simple_db_domain, "sorting DB");
+	root->Sort();
+
+	db_unlock();
+
+	if (incremental_save) {
+		/* serialize the modified directories while clients
+		   may continue to read the database; the journal is
+		   written after the lock has been released */
+		StringOutputStream records;
+		uint64_t total_size;
+
+		{
+			BufferedOutputStream bos(records);
+
+			db_lock_shared();
+			total_size = db_journal_scan(*root, &bos);
+			db_unlock_shared();
+
+			bos.Flush();
+		}
+
+		const size_t size = records.GetValue().size();
+		if (journal_consistent &&
+		    journal_size + size <= total_size / JOURNAL_MAX_RATIO) {
+			if (size == 0)
+				return true;
+
+			LogDebug(simple_db_domain, "appending to DB journal");
+
+			if (SaveJournal(records.GetValue(), error))
+				return true;
+
+			/* the hashes have been updated already, so the
+			   whole file needs to be written now */
+			LogError(error, "Failed to write the database journal");
+			error.Clear();
+		}
+
+		/* the new database file contains everything; delete
+		   the journal before committing it, so a crash in
+		   between cannot combine the new file with the old
+		   journal */
+		RemoveFile(journal_path);
+		journal_size = 0;
+		journal_consistent = false;
+	}
+
+	LogDebug(simple_db_domain, "writing DB");
+
+	FileOutputStream fos(path, error);
+	if (!fos.IsDefined())
+		return false;
+
+	/* only the update thread modifies the tree, and it is busy
+	   here; the shared lock protects against Mount() and
+	   Unmount() and lets clients continue to read */
+	db_lock_shared();
+
+	/* the binary format is never compressed, because it gets
+	   mapped into memory by db_load_binary() */
+	const bool success = format == FileFormat::BINARY
+		? db_save_binary(fos, *root, error)
+		: SaveText(fos, error);
+
+	db_unlock_shared();
+
+	if (!success)
+		return false;
+
 	if (!fos.Commit(error))
 		return false;
 
@@ -425,6 +743,7 @@ SimpleDatabase::Save(Error &error)
 	if (GetFileInfo(path, fi))
 		mtime = fi.GetModificationTime();
 
+	journal_consistent = incremental_save;
 	return true;
 }
 
@@ -455,6 +774,7 @@ SimpleDatabase::Mount(const char *uri, Database *db, Error &error)
 
 	Directory *mnt = r.directory->CreateChild(r.uri);
 	mnt->mounted_database = db;
+	++mount_count;
 	return true;
 }
 
@@ -522,6 +842,9 @@ SimpleDatabase::LockUmountSteal(const char *uri)
 	r.directory->mounted_database = nullptr;
 	r.directory->Delete();
 
+	assert(mount_count > 0);
+	--mount_count;
+
 	return db;
 }
 
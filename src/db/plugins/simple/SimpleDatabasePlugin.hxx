@@ -24,6 +24,8 @@
 #include "db/Interface.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "db/LightSong.hxx"
+#include "SongIndex.hxx"
+#include "util/Arena.hxx"
 #include "Compiler.h"
 
 #include <cassert>
@@ -34,15 +36,52 @@ struct DatabasePlugin;
 class EventLoop;
 class DatabaseListener;
 class PrefixedLightSong;
+class OutputStream;
+class FileInfo;
 
 class SimpleDatabase : public Database {
 	AllocatedPath path;
 	std::string path_utf8;
 
+	/**
+	 * The on-disk format of the database file.
+	 */
+	enum class FileFormat {
+		/**
+		 * The traditional text format, see DatabaseSave.hxx.
+		 */
+		TEXT,
+
+		/**
+		 * The binary format, see DatabaseBinary.hxx.
+		 */
+		BINARY,
+	} format;
+
 #ifdef ENABLE_ZLIB
 	bool compress;
 #endif
 
+	/**
+	 * Append modified directories to a journal instead of
+	 * rewriting the whole database file?  See DatabaseJournal.hxx.
+	 */
+	bool incremental_save;
+
+	AllocatedPath journal_path;
+
+	/**
+	 * The size of the journal file; 0 if there is none.
+	 */
+	uint64_t journal_size;
+
+	/**
+	 * Do the database file and the journal contain the state
+	 * recorded in the Directory::journal_hash attributes?  If not,
+	 * the next Save() rewrites the whole database file.
+	 */
+	bool journal_consistent;
+
 	/**
 	 * The path where cache files for Mount() are located.
 	 */
@@ -50,6 +89,27 @@ class SimpleDatabase : public Database {
 
 	Directory *root;
 
+	/**
+	 * The #Song objects loaded from the database file (and their
+	 * tag item arrays) are allocated here.  It is freed after
+	 * #root has been deleted.  Songs added later by the update
+	 * thread are allocated with malloc().
+	 */
+	Arena arena;
+
+	/**
+	 * An inverted index of all songs in #root, used by Visit()
+	 * for exact-match filters.  Protected by #db_mutex.
+	 */
+	SongIndex index;
+
+	/**
+	 * The number of databases mounted with Mount().  The #index
+	 * doesn't cover them, therefore it is only used while there
+	 * are none.  Protected by #db_mutex.
+	 */
+	unsigned mount_count;
+
 	time_t mtime;
 
 	/**
@@ -63,6 +123,12 @@ class SimpleDatabase : public Database {
 	 */
 	mutable LightSong light_song;
 
+	/**
+	 * The path of the directory containing #light_song, which
+	 * its "directory" attribute points to.
+	 */
+	mutable std::string light_song_directory;
+
 #ifndef NDEBUG
 	mutable unsigned borrowed_song_count;
 #endif
@@ -83,6 +149,14 @@ public:
 		return *root;
 	}
 
+	/**
+	 * Caller must lock the #db_mutex while using the returned
+	 * object.
+	 */
+	SongIndex &GetIndex() {
+		return index;
+	}
+
 	bool Save(Error &error);
 
 	/**
@@ -125,6 +199,11 @@ public:
 				     VisitTag visit_tag,
 				     Error &error) const override;
 
+	virtual bool VisitTagCounts(const DatabaseSelection &selection,
+				    TagType tag_type,
+				    VisitTagCount visit,
+				    Error &error) const override;
+
 	virtual bool GetStats(const DatabaseSelection &selection,
 			      DatabaseStats &stats,
 			      Error &error) const override;
@@ -139,8 +218,28 @@ private:
 	gcc_pure
 	bool Check(Error &error) const;
 
+	bool LoadFile(Error &error);
+
+	/**
+	 * Apply the journal (if one exists) to the loaded tree.
+	 *
+	 * @param base information about the database file
+	 */
+	bool LoadJournal(const FileInfo &base, Error &error);
+
 	bool Load(Error &error);
 
+	/**
+	 * Append records to the journal, or create a new one.
+	 */
+	bool SaveJournal(const std::string &records, Error &error);
+
+	/**
+	 * Write the database in the text format to the given stream,
+	 * optionally compressed.
+	 */
+	bool SaveText(OutputStream &os, Error &error);
+
 	Database *LockUmountSteal(const char *uri);
 };
 
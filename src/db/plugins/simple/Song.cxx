@@ -22,16 +22,20 @@
 #include "Directory.hxx"
 #include "tag/Tag.hxx"
 #include "util/VarSize.hxx"
+#include "util/Arena.hxx"
 #include "DetachedSong.hxx"
 #include "db/LightSong.hxx"
 
+#include <new>
+
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 
 inline Song::Song(const char *_uri, size_t uri_length, Directory &_parent)
-	:parent(&_parent), mtime(0),
-	 start_time(SongTime::zero()), end_time(SongTime::zero())
+	:parent(&_parent), mtime(0), size(0),
+	 start_time(SongTime::zero()), end_time(SongTime::zero()),
+	 in_arena(false)
 {
 	memcpy(uri, _uri, uri_length + 1);
 }
@@ -54,11 +58,42 @@ song_alloc(const char *uri, Directory &parent)
 				uri, uri_length, parent);
 }
 
+static Song *
+song_alloc(const char *uri, Directory &parent, Arena &arena)
+{
+	size_t uri_length;
+
+	assert(uri);
+	uri_length = strlen(uri);
+	assert(uri_length);
+
+	void *p = arena.Allocate(sizeof(Song) - sizeof(Song::uri) +
+				 uri_length + 1);
+	Song *song = new(p) Song(uri, uri_length, parent);
+	song->in_arena = true;
+	return song;
+}
+
 Song *
 Song::NewFrom(DetachedSong &&other, Directory &parent)
 {
 	Song *song = song_alloc(other.GetURI(), parent);
-	song->tag = std::move(other.WritableTag());
+	song->tag = Tag(other.GetTag());
+	song->mtime = other.GetLastModified();
+	song->start_time = other.GetStartTime();
+	song->end_time = other.GetEndTime();
+	return song;
+}
+
+Song *
+Song::NewFrom(DetachedSong &&other, Directory &parent, Arena &arena)
+{
+	Song *song = song_alloc(other.GetURI(), parent, arena);
+
+	const Tag &tag = other.GetTag();
+	song->tag.AssignForeign(tag,
+				arena.NewArray<TagItem *>(tag.num_items));
+
 	song->mtime = other.GetLastModified();
 	song->start_time = other.GetStartTime();
 	song->end_time = other.GetEndTime();
@@ -71,10 +106,19 @@ Song::NewFile(const char *path, Directory &parent)
 	return song_alloc(path, parent);
 }
 
+Song *
+Song::NewFile(const char *path, Directory &parent, Arena &arena)
+{
+	return song_alloc(path, parent, arena);
+}
+
 void
 Song::Free()
 {
-	DeleteVarSize(this);
+	if (in_arena)
+		this->~Song();
+	else
+		DeleteVarSize(this);
 }
 
 std::string
@@ -85,11 +129,7 @@ Song::GetURI() const
 	if (parent->IsRoot())
 		return std::string(uri);
 	else {
-		const char *path = parent->GetPath();
-
-		std::string result;
-		result.reserve(strlen(path) + 1 + strlen(uri));
-		result.assign(path);
+		std::string result = parent->GetPath();
 		result.push_back('/');
 		result.append(uri);
 		return result;
@@ -97,11 +137,13 @@ Song::GetURI() const
 }
 
 LightSong
-Song::Export() const
+Song::Export(const std::string &parent_path) const
 {
+	assert(parent_path.empty() == parent->IsRoot());
+
 	LightSong dest;
-	dest.directory = parent->IsRoot()
-		? nullptr : parent->GetPath();
+	dest.directory = parent_path.empty()
+		? nullptr : parent_path.c_str();
 	dest.uri = uri;
 	dest.real_uri = nullptr;
 	dest.tag = &tag;
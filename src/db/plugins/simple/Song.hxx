@@ -30,12 +30,14 @@
 #include <string>
 
 #include <assert.h>
+#include <stdint.h>
 #include <time.h>
 
 struct LightSong;
 struct Directory;
 class DetachedSong;
 class Storage;
+class Arena;
 
 /**
  * A song file inside the configured music directory.  Internal
@@ -72,6 +74,12 @@ struct Song {
 
 	time_t mtime;
 
+	/**
+	 * The file size in bytes.  Together with #mtime, it is used
+	 * to detect modifications.  0 means unknown.
+	 */
+	uint64_t size;
+
 	/**
 	 * Start of this sub-song within the file.
 	 */
@@ -83,6 +91,13 @@ struct Song {
 	 */
 	SongTime end_time;
 
+	/**
+	 * Was this object (and its #Tag::items array) allocated from
+	 * the database's #Arena?  Then Free() only destructs it; the
+	 * memory is released when the database is unloaded.
+	 */
+	bool in_arena;
+
 	/**
 	 * The file name.
 	 */
@@ -94,10 +109,25 @@ struct Song {
 	gcc_malloc
 	static Song *NewFrom(DetachedSong &&other, Directory &parent);
 
+	/**
+	 * Like NewFrom(), but allocate the object and its tag item
+	 * array from the #Arena.
+	 */
+	gcc_malloc
+	static Song *NewFrom(DetachedSong &&other, Directory &parent,
+			     Arena &arena);
+
 	/** allocate a new song with a local file name */
 	gcc_malloc
 	static Song *NewFile(const char *path_utf8, Directory &parent);
 
+	/**
+	 * Like NewFile(), but allocate the object from the #Arena.
+	 */
+	gcc_malloc
+	static Song *NewFile(const char *path_utf8, Directory &parent,
+			     Arena &arena);
+
 	/**
 	 * allocate a new song structure with a local file name and attempt to
 	 * load its metadata.  If all decoder plugin fail to read its meta
@@ -111,6 +141,24 @@ struct Song {
 
 	bool UpdateFile(Storage &storage);
 
+	/**
+	 * Scan the tags of the given song file.  Unlike UpdateFile(),
+	 * this doesn't access any #Song or #Directory object, and may
+	 * therefore be called from any thread without holding the
+	 * #db_mutex.
+	 *
+	 * @param relative_uri the URI of the song within the #Storage
+	 * @param tag receives the tags on success
+	 * @param mtime receives the modification time on success
+	 * @param size receives the file size on success
+	 * @param bytes_read receives the number of bytes which were
+	 * read from the file on success; this is the file size if it
+	 * was scanned by a decoder plugin (an upper bound)
+	 */
+	static bool ScanFile(Storage &storage, const char *relative_uri,
+			     Tag &tag, time_t &mtime, uint64_t &size,
+			     uint64_t &bytes_read);
+
 #ifdef ENABLE_ARCHIVE
 	bool UpdateFileInArchive(const Storage &storage);
 #endif
@@ -122,8 +170,13 @@ struct Song {
 	gcc_pure
 	std::string GetURI() const;
 
+	/**
+	 * @param parent_path the return value of
+	 * Directory::GetPath() of the #parent; the returned object
+	 * points into it
+	 */
 	gcc_pure
-	LightSong Export() const;
+	LightSong Export(const std::string &parent_path) const;
 };
 
 typedef boost::intrusive::list<Song,
@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "SongIndex.hxx"
+#include "Song.hxx"
+#include "Directory.hxx"
+#include "SongFilter.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/UniqueTags.hxx"
+#include "tag/TagSettings.h"
+
+#include <algorithm>
+
+#include <assert.h>
+
+void
+SongIndex::Clear()
+{
+	for (auto &map : maps)
+		map.clear();
+
+	std::fill_n(n_missing, TAG_NUM_OF_ITEM_TYPES, 0u);
+	n_missing_artist = 0;
+	totals = SearchStats();
+}
+
+gcc_pure
+static uint32_t
+GetTagMask(const Tag &tag)
+{
+	static_assert(sizeof(uint32_t) * 8 >= TAG_NUM_OF_ITEM_TYPES,
+		      "Mask is too small");
+
+	uint32_t mask = 0;
+	for (const auto &item : tag)
+		mask |= 1u << unsigned(item.type);
+	return mask;
+}
+
+inline void
+SongIndex::UpdateMissing(uint32_t present, int delta)
+{
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if ((present & (1u << i)) == 0)
+			n_missing[i] += delta;
+
+	if ((present & ((1u << TAG_ALBUM_ARTIST) | (1u << TAG_ARTIST))) == 0)
+		n_missing_artist += delta;
+}
+
+void
+SongIndex::Add(Song &song)
+{
+	assert(holding_db_lock_exclusive());
+
+	const uint32_t present = GetTagMask(song.tag);
+	const bool fallback = (present & (1u << TAG_ALBUM_ARTIST)) == 0;
+	const auto duration = song.tag.duration;
+
+	for (const auto &item : song.tag) {
+		auto &e = maps[item.type][item.value];
+		e.stats.Add(duration);
+		if (fallback && item.type == TAG_ARTIST)
+			e.fallback.Add(duration);
+
+		auto &v = e.songs;
+
+		/* this check catches the common case of duplicate
+		   values; Remove() tolerates the rest */
+		if (v.empty() || v.back() != &song)
+			v.push_back(&song);
+	}
+
+	UpdateMissing(present, 1);
+	totals.Add(duration);
+}
+
+void
+SongIndex::Remove(Song &song)
+{
+	assert(holding_db_lock_exclusive());
+
+	const uint32_t present = GetTagMask(song.tag);
+	const bool fallback = (present & (1u << TAG_ALBUM_ARTIST)) == 0;
+	const auto duration = song.tag.duration;
+
+	for (const auto &item : song.tag) {
+		auto &map = maps[item.type];
+		auto i = map.find(item.value);
+		if (i == map.end())
+			/* a duplicate value whose entry has already
+			   been erased */
+			continue;
+
+		auto &e = i->second;
+		e.stats.Remove(duration);
+		if (fallback && item.type == TAG_ARTIST)
+			e.fallback.Remove(duration);
+
+		auto &v = e.songs;
+		auto j = std::find(v.begin(), v.end(), &song);
+		if (j == v.end())
+			continue;
+
+		/* the order doesn't matter, Lookup() sorts the
+		   result */
+		*j = v.back();
+		v.pop_back();
+
+		if (v.empty())
+			map.erase(i);
+	}
+
+	UpdateMissing(present, -1);
+	totals.Remove(duration);
+}
+
+void
+SongIndex::AddRecursive(Directory &directory)
+{
+	for (auto &song : directory.songs)
+		Add(song);
+
+	for (auto &child : directory.children)
+		AddRecursive(child);
+}
+
+inline const SongIndex::SongVector *
+SongIndex::Find(TagType type, const std::string &value) const
+{
+	const auto &map = maps[type];
+	auto i = map.find(value);
+	return i != map.end()
+		? &i->second.songs
+		: nullptr;
+}
+
+inline size_t
+SongIndex::Count(TagType type, const std::string &value) const
+{
+	const SongVector *v = Find(type, value);
+	size_t n = v != nullptr ? v->size() : 0;
+
+	if (type == TAG_ALBUM_ARTIST)
+		/* SongFilter::Item falls back to "artist" for songs
+		   without "album artist" */
+		n += Count(TAG_ARTIST, value);
+
+	return n;
+}
+
+gcc_pure
+static bool
+IsInside(const Directory *d, const Directory &directory, bool recursive)
+{
+	if (!recursive)
+		return d == &directory;
+
+	for (; d != nullptr; d = d->parent)
+		if (d == &directory)
+			return true;
+
+	return false;
+}
+
+gcc_pure
+static unsigned
+GetDepth(const Directory *d)
+{
+	unsigned depth = 0;
+	while ((d = d->parent) != nullptr)
+		++depth;
+	return depth;
+}
+
+/**
+ * Does #a appear before #b in the given list?  Both must be members
+ * of the list.
+ */
+template<typename L, typename T>
+gcc_pure
+static bool
+IsBefore(const L &list, const T &a, const T &b)
+{
+	for (const auto &i : list) {
+		if (&i == &a)
+			return true;
+
+		if (&i == &b)
+			return false;
+	}
+
+	assert(false);
+	gcc_unreachable();
+}
+
+/**
+ * Does Directory::Walk() visit #a before #b?
+ */
+gcc_pure
+static bool
+WalkOrder(const Song *a, const Song *b)
+{
+	const Directory *pa = a->parent, *pb = b->parent;
+	if (pa == pb)
+		return a != b && IsBefore(pa->songs, *a, *b);
+
+	const unsigned depth_a = GetDepth(pa), depth_b = GetDepth(pb);
+
+	for (unsigned i = depth_a; i > depth_b; --i)
+		pa = pa->parent;
+
+	for (unsigned i = depth_b; i > depth_a; --i)
+		pb = pb->parent;
+
+	if (pa == pb)
+		/* one is an ancestor of the other; its songs are
+		   visited before the sub directories */
+		return depth_a < depth_b;
+
+	while (pa->parent != pb->parent) {
+		pa = pa->parent;
+		pb = pb->parent;
+	}
+
+	return IsBefore(pa->parent->children, *pa, *pb);
+}
+
+bool
+SongIndex::Lookup(const Directory &directory, bool recursive,
+		  const SongFilter &filter,
+		  std::vector<const Song *> &result) const
+{
+	assert(holding_db_lock());
+
+	/* find the exact-match item with the fewest candidates */
+
+	const SongFilter::Item *best = nullptr;
+	size_t best_count = 0;
+
+	for (const auto &i : filter.GetItems()) {
+		if (i.GetFoldCase() || i.GetTag() >= TAG_NUM_OF_ITEM_TYPES ||
+		    /* an empty value matches songs which don't have
+		       this tag at all */
+		    i.GetValue().empty())
+			continue;
+
+		const size_t n = Count(TagType(i.GetTag()), i.GetValue());
+		if (best == nullptr || n < best_count) {
+			best = &i;
+			best_count = n;
+		}
+	}
+
+	if (best == nullptr)
+		return false;
+
+	const TagType type = TagType(best->GetTag());
+	const std::string &value = best->GetValue();
+
+	result.clear();
+	result.reserve(best_count);
+
+	const auto add = [&](const SongVector *v){
+		if (v != nullptr)
+			for (const Song *song : *v)
+				if (IsInside(song->parent, directory,
+					     recursive))
+					result.push_back(song);
+	};
+
+	add(Find(type, value));
+
+	if (type == TAG_ALBUM_ARTIST)
+		add(Find(TAG_ARTIST, value));
+
+	/* a song may be listed twice if it has the same value more
+	   than once, or both "artist" and "album artist" */
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()),
+		     result.end());
+
+	std::sort(result.begin(), result.end(), WalkOrder);
+	return true;
+}
+
+void
+SongIndex::Collect(TagType tag_type, bool fallback,
+		   std::vector<ValueStats> &result) const
+{
+	const auto &map = maps[tag_type];
+	result.reserve(map.size());
+	for (const auto &i : map)
+		result.emplace_back(&i.first, i.second.stats);
+
+	const auto less = [](const ValueStats &a, const ValueStats &b){
+		return *a.first < *b.first;
+	};
+
+	if (!fallback || tag_type != TAG_ALBUM_ARTIST) {
+		std::sort(result.begin(), result.end(), less);
+		return;
+	}
+
+	for (const auto &i : maps[TAG_ARTIST])
+		if (i.second.fallback.n_songs > 0)
+			result.emplace_back(&i.first, i.second.fallback);
+
+	std::sort(result.begin(), result.end(), less);
+
+	/* merge values which are both "AlbumArtist" and "Artist" */
+	auto dest = result.begin();
+	for (auto i = result.begin(); i != result.end(); ++i) {
+		if (dest != result.begin() && *std::prev(dest)->first == *i->first)
+			std::prev(dest)->second += i->second;
+		else
+			*dest++ = *i;
+	}
+
+	result.erase(dest, result.end());
+}
+
+bool
+SongIndex::VisitUniqueTags(TagType tag_type, VisitTag visit_tag,
+			   Error &error) const
+{
+	assert(holding_db_lock());
+
+	std::vector<ValueStats> v;
+	Collect(tag_type, !ignore_tag_items[TAG_ALBUM_ARTIST], v);
+
+	std::vector<const char *> values;
+	values.reserve(v.size() + 1);
+
+	/* songs without the tag are listed with an empty value,
+	   which sorts first */
+	const unsigned n_empty = tag_type == TAG_ALBUM_ARTIST &&
+		!ignore_tag_items[TAG_ALBUM_ARTIST]
+		? n_missing_artist
+		: n_missing[tag_type];
+	if (n_empty > 0 && (v.empty() || !v.front().first->empty()))
+		values.push_back("");
+
+	for (const auto &i : v)
+		values.push_back(i.first->c_str());
+
+	return VisitUniqueTagValues(tag_type, values.data(), values.size(),
+				    visit_tag, error);
+}
+
+bool
+SongIndex::VisitTagCounts(TagType tag_type, VisitTagCount visit,
+			  Error &error) const
+{
+	assert(holding_db_lock());
+
+	std::vector<ValueStats> v;
+	Collect(tag_type, true, v);
+
+	for (const auto &i : v)
+		if (!visit(i.first->c_str(), i.second, error))
+			return false;
+
+	return true;
+}
+
+void
+SongIndex::GetStats(DatabaseStats &stats) const
+{
+	assert(holding_db_lock());
+
+	stats.song_count = totals.n_songs;
+	stats.total_duration = totals.total_duration;
+	stats.artist_count = maps[TAG_ARTIST].size();
+	stats.album_count = maps[TAG_ALBUM].size();
+}
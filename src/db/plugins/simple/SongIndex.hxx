@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_SONG_INDEX_HXX
+#define MPD_SONG_INDEX_HXX
+
+#include "db/Stats.hxx"
+#include "db/Visitor.hxx"
+#include "tag/TagType.h"
+#include "Compiler.h"
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <string>
+
+#include <stdint.h>
+
+struct Song;
+struct Directory;
+class SongFilter;
+class Error;
+
+/**
+ * An inverted index which maps tag values to the songs having them.
+ * It allows #SimpleDatabase to answer exact-match #SongFilter
+ * queries without walking the whole #Directory tree, and it keeps
+ * per-value statistics for "list" and "count group".
+ *
+ * All methods must be called with the #db_mutex locked.
+ */
+class SongIndex {
+	typedef std::vector<Song *> SongVector;
+
+	struct Entry {
+		SongVector songs;
+
+		/**
+		 * The songs with this value.  Like "count group", a
+		 * song is counted once per tag item.
+		 */
+		SearchStats stats;
+
+		/**
+		 * The subset of #stats without "AlbumArtist"; only
+		 * used for "Artist" values.  These songs are grouped
+		 * by their "Artist" when grouping by "AlbumArtist".
+		 */
+		SearchStats fallback;
+	};
+
+	typedef std::unordered_map<std::string, Entry> Map;
+
+	/**
+	 * One map per tag type.
+	 */
+	Map maps[TAG_NUM_OF_ITEM_TYPES];
+
+	/**
+	 * The number of songs without an item of each tag type.
+	 */
+	unsigned n_missing[TAG_NUM_OF_ITEM_TYPES];
+
+	/**
+	 * The number of songs with neither "AlbumArtist" nor
+	 * "Artist".
+	 */
+	unsigned n_missing_artist;
+
+	/**
+	 * All songs in the index.
+	 */
+	SearchStats totals;
+
+public:
+	SongIndex() {
+		Clear();
+	}
+	SongIndex(const SongIndex &) = delete;
+	SongIndex &operator=(const SongIndex &) = delete;
+
+	void Clear();
+
+	/**
+	 * Add the given song.  Its #Tag must not be modified until it
+	 * is removed again.
+	 */
+	void Add(Song &song);
+
+	/**
+	 * Remove the given song, which must have been added with an
+	 * identical #Tag.
+	 */
+	void Remove(Song &song);
+
+	/**
+	 * Add all songs in the given #Directory and all of its sub
+	 * directories.  Mount points are skipped.
+	 */
+	void AddRecursive(Directory &directory);
+
+	/**
+	 * Look up all songs within the given #Directory which may
+	 * match the #SongFilter.  The result is a superset of the
+	 * matching songs; the caller must still apply the filter.  It
+	 * is sorted in the order Directory::Walk() would visit the
+	 * songs.
+	 *
+	 * @return false if the index cannot be used for this filter
+	 * (e.g. because it has no exact-match tag item)
+	 */
+	bool Lookup(const Directory &directory, bool recursive,
+		    const SongFilter &filter,
+		    std::vector<const Song *> &result) const;
+
+	/**
+	 * Visit all values of the tag type in all songs, like
+	 * ::VisitUniqueTags() without a filter and without grouping,
+	 * but without visiting the songs.
+	 */
+	bool VisitUniqueTags(TagType tag_type, VisitTag visit_tag,
+			     Error &error) const;
+
+	/**
+	 * Visit the precomputed statistics of all values of the tag
+	 * type, like ::VisitTagCounts() without a filter.
+	 */
+	bool VisitTagCounts(TagType tag_type, VisitTagCount visit,
+			    Error &error) const;
+
+	/**
+	 * Fill the #DatabaseStats of all songs, like ::GetStats()
+	 * without walking the songs.
+	 */
+	void GetStats(DatabaseStats &stats) const;
+
+private:
+	typedef std::pair<const std::string *, SearchStats> ValueStats;
+
+	/**
+	 * Collect all values of the tag type with their statistics,
+	 * sorted by value, with duplicates merged.
+	 *
+	 * @param fallback include the "Artist" values of songs
+	 * without "AlbumArtist" when collecting "AlbumArtist"
+	 */
+	void Collect(TagType tag_type, bool fallback,
+		     std::vector<ValueStats> &result) const;
+
+	/**
+	 * Update #n_missing and #n_missing_artist for a song with
+	 * the given bit mask of tag types.
+	 */
+	void UpdateMissing(uint32_t present, int delta);
+
+	gcc_pure
+	const SongVector *Find(TagType type, const std::string &value) const;
+
+	/**
+	 * Determine the number of candidates for the given tag
+	 * search.
+	 */
+	gcc_pure
+	size_t Count(TagType type, const std::string &value) const;
+};
+
+#endif
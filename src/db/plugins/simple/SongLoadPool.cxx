@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "SongLoadPool.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "SongSave.hxx"
+#include "DetachedSong.hxx"
+#include "fs/io/LineReader.hxx"
+#include "thread/Name.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+
+static constexpr Domain song_load_domain("song_load");
+
+/**
+ * Reads the null-terminated lines of a #SongLoadChunk.
+ */
+class ChunkLineReader final : public LineReader {
+	char *p;
+	char *const end;
+
+public:
+	ChunkLineReader(char *_p, char *_end):p(_p), end(_end) {}
+
+	/* virtual methods from class LineReader */
+	char *ReadLine() override {
+		if (p == end)
+			return nullptr;
+
+		char *line = p;
+		p += strlen(p) + 1;
+		return line;
+	}
+};
+
+void
+SongLoadChunk::Parse(Arena &arena)
+{
+	ChunkLineReader reader(text.data(), text.data() + text.size());
+
+	songs.reserve(directories.size());
+
+	for (Directory *directory : directories) {
+		const char *name = reader.ReadLine();
+		assert(name != nullptr);
+
+		uint64_t size;
+		DetachedSong *song = song_load(reader, name, error, &size);
+		if (song == nullptr)
+			return;
+
+		Song *song2 = Song::NewFrom(std::move(*song), *directory,
+					    arena);
+		song2->size = size;
+		songs.push_back(song2);
+		delete song;
+	}
+
+	/* the text is not needed anymore */
+	std::vector<char>().swap(text);
+}
+
+void
+SongLoadChunk::FreeSongs()
+{
+	for (Song *song : songs)
+		song->Free();
+
+	songs.clear();
+}
+
+SongLoadPool::~SongLoadPool()
+{
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (auto &worker : workers)
+		worker.thread.Join();
+
+	for (SongLoadChunk *chunk : chunks) {
+		chunk->FreeSongs();
+		delete chunk;
+	}
+
+	for (auto &worker : workers)
+		arena.Splice(worker.arena);
+}
+
+void
+SongLoadPool::Start(unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i) {
+		workers.emplace_front(*this);
+
+		Error error;
+		if (!workers.front().thread.Start(Worker::Run,
+						  &workers.front(), error)) {
+			workers.pop_front();
+			LogError(error);
+			break;
+		}
+	}
+}
+
+void
+SongLoadPool::Push(SongLoadChunk *chunk)
+{
+	chunks.push_back(chunk);
+
+	if (workers.empty()) {
+		/* no threads: parse it right now */
+		chunk->Parse(arena);
+		chunk->done = true;
+		return;
+	}
+
+	const ScopeLock protect(mutex);
+	pending.push_back(chunk);
+	cond.signal();
+}
+
+bool
+SongLoadPool::MergeOne(Error &error)
+{
+	assert(!chunks.empty());
+
+	SongLoadChunk *chunk = chunks.front();
+	chunks.pop_front();
+
+	mutex.lock();
+	while (!chunk->done)
+		finished_cond.wait(mutex);
+	mutex.unlock();
+
+	bool success = true;
+	auto &songs = chunk->songs;
+	auto i = songs.begin();
+	for (; i != songs.end(); ++i) {
+		Song *song = *i;
+		Directory &directory = *song->parent;
+
+		if (directory.FindSong(song->uri) != nullptr) {
+			error.Format(song_load_domain,
+				     "Duplicate song '%s'", song->uri);
+			success = false;
+			break;
+		}
+
+		directory.AddSong(song);
+	}
+
+	/* free the songs which have not been added */
+	songs.erase(songs.begin(), i);
+	chunk->FreeSongs();
+
+	if (success && chunk->error.IsDefined()) {
+		error = std::move(chunk->error);
+		success = false;
+	}
+
+	delete chunk;
+	return success;
+}
+
+bool
+SongLoadPool::MergeAll(Error &error)
+{
+	while (!chunks.empty())
+		if (!MergeOne(error))
+			return false;
+
+	return true;
+}
+
+inline void
+SongLoadPool::Worker::Run()
+{
+	SetThreadName("db_parse");
+
+	const ScopeLock protect(pool.mutex);
+
+	while (!pool.quit) {
+		if (pool.pending.empty()) {
+			pool.cond.wait(pool.mutex);
+			continue;
+		}
+
+		SongLoadChunk *chunk = pool.pending.front();
+		pool.pending.pop_front();
+
+		pool.mutex.unlock();
+		chunk->Parse(arena);
+		pool.mutex.lock();
+
+		chunk->done = true;
+		pool.finished_cond.signal();
+	}
+}
+
+void
+SongLoadPool::Worker::Run(void *ctx)
+{
+	Worker &worker = *(Worker *)ctx;
+	worker.Run();
+}
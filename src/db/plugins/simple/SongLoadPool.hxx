@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_SONG_LOAD_POOL_HXX
+#define MPD_SONG_LOAD_POOL_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "util/Arena.hxx"
+#include "util/Error.hxx"
+
+#include <deque>
+#include <forward_list>
+#include <vector>
+
+#include <string.h>
+
+struct Directory;
+struct Song;
+
+/**
+ * A portion of the text database file: the lines of consecutive
+ * song blocks, which are parsed by a #SongLoadPool thread.
+ */
+struct SongLoadChunk {
+	/**
+	 * The lines of all songs, each terminated with a null byte.
+	 * Each song begins with its name (the value of the
+	 * "song_begin" line) and ends with the "song_end" line.
+	 */
+	std::vector<char> text;
+
+	/**
+	 * The #Directory of each song in #text.
+	 */
+	std::vector<Directory *> directories;
+
+	/**
+	 * The parsed songs, one for each item in #directories.  They
+	 * are not yet added to their #Directory.
+	 */
+	std::vector<Song *> songs;
+
+	Error error;
+
+	/**
+	 * Has a thread finished parsing this chunk?  Protected by
+	 * SongLoadPool::mutex.
+	 */
+	bool done = false;
+
+	void AppendLine(const char *line) {
+		text.insert(text.end(), line, line + strlen(line) + 1);
+	}
+
+	size_t GetSize() const {
+		return text.size();
+	}
+
+	/**
+	 * Parse all songs in #text.
+	 *
+	 * @param arena the songs are allocated here
+	 */
+	void Parse(Arena &arena);
+
+	/**
+	 * Free all songs which have not been added to their
+	 * #Directory.
+	 */
+	void FreeSongs();
+};
+
+/**
+ * A pool of threads which parse the song blocks of the text database
+ * file, while the calling thread reads the file and builds the
+ * #Directory tree.  The parsed songs are added to their #Directory in
+ * the calling thread, in the order of the file.
+ */
+class SongLoadPool {
+	struct Worker {
+		SongLoadPool &pool;
+
+		Thread thread;
+
+		/**
+		 * The songs parsed by this thread are allocated
+		 * here.  Arenas are not thread-safe, therefore each
+		 * thread has its own.
+		 */
+		Arena arena;
+
+		explicit Worker(SongLoadPool &_pool):pool(_pool) {}
+
+		void Run();
+		static void Run(void *ctx);
+	};
+
+	/**
+	 * All blocks of the #Worker arenas are moved here in the
+	 * destructor.
+	 */
+	Arena &arena;
+
+	std::forward_list<Worker> workers;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a new chunk was pushed or when the pool
+	 * shall quit.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled when a chunk has been parsed.
+	 */
+	Cond finished_cond;
+
+	/**
+	 * All chunks which have not been merged yet, in the order
+	 * they were pushed.
+	 */
+	std::deque<SongLoadChunk *> chunks;
+
+	/**
+	 * Chunks which have not been picked up by a thread yet.
+	 */
+	std::deque<SongLoadChunk *> pending;
+
+	bool quit;
+
+public:
+	explicit SongLoadPool(Arena &_arena)
+		:arena(_arena), quit(false) {}
+
+	/**
+	 * Stops all threads, frees the songs of all chunks which
+	 * have not been merged, and moves the memory of the worker
+	 * arenas to the #Arena passed to the constructor.  Songs
+	 * which have been merged already are allocated there.
+	 */
+	~SongLoadPool();
+
+	SongLoadPool(const SongLoadPool &) = delete;
+	SongLoadPool &operator=(const SongLoadPool &) = delete;
+
+	/**
+	 * Start the given number of worker threads.  If none could be
+	 * started, Push() parses the chunks in the calling thread.
+	 */
+	void Start(unsigned n);
+
+	/**
+	 * Returns the number of chunks which have not been merged
+	 * yet.
+	 */
+	unsigned GetCount() const {
+		return chunks.size();
+	}
+
+	/**
+	 * Submit a chunk.  The pool gains ownership of it.
+	 */
+	void Push(SongLoadChunk *chunk);
+
+	/**
+	 * Wait until the oldest chunk has been parsed, and add its
+	 * songs to their #Directory objects.  The caller must hold
+	 * the database lock.
+	 *
+	 * @return false on error (parser error or duplicate song)
+	 */
+	bool MergeOne(Error &error);
+
+	/**
+	 * Merge all chunks, see MergeOne().
+	 */
+	bool MergeAll(Error &error);
+};
+
+#endif
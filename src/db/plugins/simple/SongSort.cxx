@@ -22,87 +22,182 @@
 #include "Song.hxx"
 #include "tag/Tag.hxx"
 #include "lib/icu/Collate.hxx"
+#include "thread/Thread.hxx"
+#include "util/Error.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <forward_list>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <stdlib.h>
+#include <unistd.h>
 
-static int
-compare_utf8_string(const char *a, const char *b)
-{
-	if (a == nullptr)
-		return b == nullptr ? 0 : -1;
+/**
+ * Use worker threads only if there are at least this many songs to
+ * be sorted.
+ */
+static constexpr unsigned SONG_SORT_PARALLEL_MIN = 16384;
 
-	if (b == nullptr)
-		return 1;
-
-	return IcuCollate(a, b);
-}
+static constexpr unsigned SONG_SORT_MAX_THREADS = 8;
 
 /**
- * Compare two string tag values, ignoring case.  Either one may be
- * nullptr.
+ * Parse a tag value which should contain an integer value (e.g. disc
+ * or track number).  Missing and non-positive values are all treated
+ * the same: they sort before all others.
  */
-static int
-compare_string_tag_item(const Tag &a, const Tag &b,
-			TagType type)
+gcc_pure
+static unsigned long
+ParseSortNumber(const char *s)
 {
-	return compare_utf8_string(a.GetValue(type),
-				   b.GetValue(type));
+	const long i = s == nullptr ? 0 : strtol(s, nullptr, 10);
+	return i > 0 ? i : 0;
 }
 
 /**
- * Compare two tag values which should contain an integer value
- * (e.g. disc or track number).  Either one may be nullptr.
+ * The sort criteria of one song, calculated only once, because
+ * collating strings and parsing numbers while comparing is
+ * expensive.
  */
-static int
-compare_number_string(const char *a, const char *b)
-{
-	long ai = a == nullptr ? 0 : strtol(a, nullptr, 10);
-	long bi = b == nullptr ? 0 : strtol(b, nullptr, 10);
-
-	if (ai <= 0)
-		return bi <= 0 ? 0 : -1;
+struct SongSortKey {
+	Song *song;
+
+	/**
+	 * The collation key of the album name, or nullptr if the song
+	 * has no album (which sorts before all others).  It is owned
+	 * by a cache shared by all songs in the directory.
+	 */
+	const std::string *album;
+
+	unsigned long disc, track;
+
+	std::string uri;
+
+	SongSortKey(Song &_song, const std::string *_album)
+		:song(&_song), album(_album),
+		 disc(ParseSortNumber(_song.tag.GetValue(TAG_DISC))),
+		 track(ParseSortNumber(_song.tag.GetValue(TAG_TRACK))),
+		 uri(IcuCollateKey(_song.uri)) {}
+
+	/* Only used for sorting a SongList, not general purpose
+	   compares */
+	gcc_pure
+	bool operator<(const SongSortKey &other) const {
+		/* first sort by album */
+		if (album != other.album) {
+			if (album == nullptr)
+				return true;
+
+			if (other.album == nullptr)
+				return false;
+
+			const int ret = album->compare(*other.album);
+			if (ret != 0)
+				return ret < 0;
+		}
+
+		/* then sort by disc */
+		if (disc != other.disc)
+			return disc < other.disc;
+
+		/* then by track number */
+		if (track != other.track)
+			return track < other.track;
+
+		/* still no difference?  compare file name */
+		return uri < other.uri;
+	}
+};
 
-	if (bi <= 0)
-		return 1;
-
-	return ai - bi;
+void
+song_list_sort(SongList &songs)
+{
+	if (songs.empty() || std::next(songs.begin()) == songs.end())
+		/* nothing to sort */
+		return;
+
+	/* songs of the same album usually share the tag value
+	   (#TagPool), so the album key is calculated once per
+	   value */
+	std::unordered_map<const char *, std::string> albums;
+
+	std::vector<SongSortKey> keys;
+	for (Song &song : songs) {
+		const char *album = song.tag.GetValue(TAG_ALBUM);
+		const std::string *album_key = nullptr;
+		if (album != nullptr) {
+			auto i = albums.emplace(album, std::string());
+			if (i.second)
+				i.first->second = IcuCollateKey(album);
+			album_key = &i.first->second;
+		}
+
+		keys.emplace_back(song, album_key);
+	}
+
+	std::sort(keys.begin(), keys.end());
+
+	songs.clear();
+	for (const auto &key : keys)
+		songs.push_back(*key.song);
 }
 
-static int
-compare_tag_item(const Tag &a, const Tag &b, TagType type)
+static unsigned
+GetSortThreadCount()
 {
-	return compare_number_string(a.GetValue(type),
-				     b.GetValue(type));
+#ifdef _SC_NPROCESSORS_ONLN
+	const long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n > 1)
+		return std::min<unsigned long>(n, SONG_SORT_MAX_THREADS);
+#endif
+
+	return 1;
 }
 
-/* Only used for sorting/searchin a songvec, not general purpose compares */
-gcc_pure
-static bool
-song_cmp(const Song &a, const Song &b)
-{
-	int ret;
+class SongListSorter {
+	const std::vector<SongList *> &lists;
 
-	/* first sort by album */
-	ret = compare_string_tag_item(a.tag, b.tag, TAG_ALBUM);
-	if (ret != 0)
-		return ret < 0;
+	std::atomic_size_t next;
 
-	/* then sort by disc */
-	ret = compare_tag_item(a.tag, b.tag, TAG_DISC);
-	if (ret != 0)
-		return ret < 0;
+public:
+	explicit SongListSorter(const std::vector<SongList *> &_lists)
+		:lists(_lists), next(0) {}
 
-	/* then by track number */
-	ret = compare_tag_item(a.tag, b.tag, TAG_TRACK);
-	if (ret != 0)
-		return ret < 0;
+	void Run() {
+		size_t i;
+		while ((i = next.fetch_add(1)) < lists.size())
+			song_list_sort(*lists[i]);
+	}
 
-	/* still no difference?  compare file name */
-	return IcuCollate(a.uri, b.uri) < 0;
-}
+	static void Run(void *ctx) {
+		SongListSorter &sorter = *(SongListSorter *)ctx;
+		sorter.Run();
+	}
+};
 
 void
-song_list_sort(SongList &songs)
+song_lists_sort(const std::vector<SongList *> &lists, size_t n_songs)
 {
-	songs.sort(song_cmp);
+	SongListSorter sorter(lists);
+
+	std::forward_list<Thread> threads;
+	if (n_songs >= SONG_SORT_PARALLEL_MIN && lists.size() > 1) {
+		/* the current thread is one of the workers */
+		for (unsigned i = 1, n = GetSortThreadCount(); i < n; ++i) {
+			threads.emplace_front();
+			if (!threads.front().Start(SongListSorter::Run,
+						   &sorter, IgnoreError())) {
+				threads.pop_front();
+				break;
+			}
+		}
+	}
+
+	sorter.Run();
+
+	for (auto &thread : threads)
+		thread.Join();
 }
@@ -22,9 +22,24 @@
 
 #include "Song.hxx"
 
+#include <vector>
+
+#include <stddef.h>
+
 struct list_head;
 
 void
 song_list_sort(SongList &songs);
 
+/**
+ * Sort all the given song lists.  If there are many songs, the work
+ * is distributed over several threads; the caller must hold the
+ * #db_mutex exclusively, and no other thread may access the lists
+ * meanwhile.
+ *
+ * @param n_songs the total number of songs in all lists
+ */
+void
+song_lists_sort(const std::vector<SongList *> &lists, size_t n_songs);
+
 #endif
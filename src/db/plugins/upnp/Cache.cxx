@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Cache.hxx"
+#include "Directory.hxx"
+#include "lib/upnp/Domain.hxx"
+#include "system/Clock.hxx"
+#include "util/Error.hxx"
+
+/**
+ * Check the "SystemUpdateID" of a server at most this often
+ * [seconds].
+ */
+static constexpr unsigned UPNP_CACHE_CHECK_INTERVAL = 10;
+
+/**
+ * The number of worker threads which read sub-containers in
+ * parallel.
+ */
+static constexpr unsigned UPNP_CACHE_THREADS = 4;
+
+/**
+ * Read at most this many sub-containers of one listing in the
+ * background.
+ */
+static constexpr unsigned UPNP_CACHE_PREFETCH = 32;
+
+/**
+ * When a server has this many entries, the expired ones are
+ * discarded; if that is not enough, all of them are.
+ */
+static constexpr size_t UPNP_CACHE_MAX_ENTRIES = 4096;
+
+static std::string
+MakeKey(bool children, const char *objid)
+{
+	std::string key(1, children ? 'c' : 'm');
+	key.append(objid);
+	return key;
+}
+
+bool
+UpnpCache::Start(Error &error)
+{
+	if (ttl == 0)
+		return true;
+
+	if (!queue.start(UPNP_CACHE_THREADS, Work, this)) {
+		error.Set(upnp_domain, "Cache work queue start failed");
+		return false;
+	}
+
+	return true;
+}
+
+void
+UpnpCache::Stop()
+{
+	queue.setTerminateAndWait();
+}
+
+void
+UpnpCache::Validate(const ContentDirectoryService &server)
+{
+	if (ttl == 0)
+		return;
+
+	const std::string server_id = server.GetURI();
+	const unsigned now = MonotonicClockS();
+
+	{
+		const ScopeLock protect(mutex);
+		Server &s = servers[server_id];
+		if (now < s.next_check)
+			return;
+
+		s.next_check = now + UPNP_CACHE_CHECK_INTERVAL;
+	}
+
+	unsigned update_id;
+	Error error;
+	if (!server.getSystemUpdateID(handle, update_id, error))
+		/* not implemented by this server; rely on the
+		   TTL */
+		return;
+
+	const ScopeLock protect(mutex);
+	Server &s = servers[server_id];
+	if (s.have_update_id && s.update_id != update_id)
+		s.Clear();
+
+	s.update_id = update_id;
+	s.have_update_id = true;
+}
+
+std::shared_ptr<const UPnPDirContent>
+UpnpCache::Get(const ContentDirectoryService &server, bool children,
+	       const char *objid, bool wait, Error &error)
+{
+	const std::string server_id = server.GetURI();
+	const std::string key = MakeKey(children, objid);
+	unsigned generation = 0;
+
+	if (ttl > 0) {
+		const ScopeLock protect(mutex);
+		Server &s = servers[server_id];
+
+		while (true) {
+			auto i = s.entries.find(key);
+			if (i == s.entries.end())
+				break;
+
+			if (i->second.content == nullptr) {
+				/* another thread is reading this
+				   object; wait for its response */
+				if (!wait)
+					return nullptr;
+
+				cond.wait(mutex);
+				continue;
+			}
+
+			if (MonotonicClockS() < i->second.expires)
+				return i->second.content;
+
+			s.entries.erase(i);
+			break;
+		}
+
+		if (s.entries.size() >= UPNP_CACHE_MAX_ENTRIES) {
+			const unsigned now = MonotonicClockS();
+			for (auto i = s.entries.begin(); i != s.entries.end();) {
+				if (i->second.content != nullptr &&
+				    now >= i->second.expires)
+					i = s.entries.erase(i);
+				else
+					++i;
+			}
+
+			if (s.entries.size() >= UPNP_CACHE_MAX_ENTRIES)
+				s.Clear();
+		}
+
+		/* insert a placeholder which tells other threads
+		   that this object is being read */
+		s.entries.emplace(key, Entry());
+		generation = s.generation;
+	}
+
+	std::shared_ptr<UPnPDirContent> content =
+		std::make_shared<UPnPDirContent>();
+	const bool success = children
+		? server.readDir(handle, objid, *content, error)
+		: server.getMetadata(handle, objid, *content, error);
+
+	if (ttl > 0) {
+		const ScopeLock protect(mutex);
+		Server &s = servers[server_id];
+		auto i = s.entries.find(key);
+		if (s.generation == generation && i != s.entries.end() &&
+		    i->second.content == nullptr) {
+			if (success) {
+				i->second.content = content;
+				i->second.expires = MonotonicClockS() + ttl;
+			} else
+				s.entries.erase(i);
+		}
+
+		cond.broadcast();
+	}
+
+	if (!success)
+		return nullptr;
+
+	return content;
+}
+
+inline bool
+UpnpCache::IsCached(const std::string &server_id, const std::string &key)
+{
+	const ScopeLock protect(mutex);
+	const Server &s = servers[server_id];
+	return s.entries.find(key) != s.entries.end();
+}
+
+void
+UpnpCache::Prefetch(const ContentDirectoryService &server,
+		    const UPnPDirContent &content)
+{
+	if (ttl == 0)
+		return;
+
+	const std::string server_id = server.GetURI();
+
+	unsigned n = 0;
+	for (const auto &object : content.objects) {
+		if (object.type != UPnPDirObject::Type::CONTAINER ||
+		    IsCached(server_id, MakeKey(true, object.id.c_str())))
+			continue;
+
+		queue.put(PrefetchTask(server, object.id));
+		if (++n >= UPNP_CACHE_PREFETCH)
+			break;
+	}
+}
+
+inline void
+UpnpCache::Work()
+{
+	PrefetchTask task;
+	while (queue.take(task)) {
+		Error error;
+		Get(task.server, true, task.objid.c_str(), false, error);
+	}
+
+	queue.workerExit();
+}
+
+void *
+UpnpCache::Work(void *ctx)
+{
+	UpnpCache &cache = *(UpnpCache *)ctx;
+	cache.Work();
+	return (void*)1;
+}
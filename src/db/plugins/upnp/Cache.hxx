@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPNP_CACHE_HXX
+#define MPD_UPNP_CACHE_HXX
+
+#include "lib/upnp/ContentDirectoryService.hxx"
+#include "lib/upnp/WorkQueue.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+
+#include <upnp/upnp.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class Error;
+class UPnPDirContent;
+
+/**
+ * A cache for "Browse" responses of UPnP media servers.  Entries
+ * expire after a configurable time, and all entries of a server are
+ * discarded when its "SystemUpdateID" changes.
+ *
+ * After a container has been listed, a pool of worker threads reads
+ * its sub-containers in the background, so descending into one of
+ * them does not need another round trip.
+ *
+ * All methods are thread-safe.
+ */
+class UpnpCache {
+	struct Entry {
+		/**
+		 * nullptr while a request for this entry is in
+		 * progress.
+		 */
+		std::shared_ptr<const UPnPDirContent> content;
+
+		/**
+		 * The MonotonicClockS() time stamp when this entry
+		 * expires.
+		 */
+		unsigned expires;
+	};
+
+	struct Server {
+		std::unordered_map<std::string, Entry> entries;
+
+		/**
+		 * Incremented each time #entries is cleared, to
+		 * discard responses to requests started before.
+		 */
+		unsigned generation = 0;
+
+		unsigned update_id;
+		bool have_update_id = false;
+
+		/**
+		 * The MonotonicClockS() time stamp when
+		 * "SystemUpdateID" shall be checked again.
+		 */
+		unsigned next_check = 0;
+
+		void Clear() {
+			entries.clear();
+			++generation;
+		}
+	};
+
+	struct PrefetchTask {
+		ContentDirectoryService server;
+		std::string objid;
+
+		PrefetchTask() = default;
+		PrefetchTask(const ContentDirectoryService &_server,
+			     const std::string &_objid)
+			:server(_server), objid(_objid) {}
+	};
+
+	const UpnpClient_Handle handle;
+
+	/**
+	 * The lifetime of a cache entry [seconds].  0 disables the
+	 * cache.
+	 */
+	const unsigned ttl;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a request finishes.
+	 */
+	Cond cond;
+
+	/**
+	 * Indexed by ContentDirectoryService::GetURI().
+	 */
+	std::map<std::string, Server> servers;
+
+	WorkQueue<PrefetchTask> queue;
+
+public:
+	UpnpCache(UpnpClient_Handle _handle, unsigned _ttl)
+		:handle(_handle), ttl(_ttl), queue("UpnpCache") {}
+
+	UpnpCache(const UpnpCache &) = delete;
+	UpnpCache &operator=(const UpnpCache &) = delete;
+
+	/**
+	 * Start the worker threads.
+	 */
+	bool Start(Error &error);
+
+	/**
+	 * Stop the worker threads and wait for them to finish their
+	 * current requests.
+	 */
+	void Stop();
+
+	/**
+	 * Check the server's "SystemUpdateID" (at most once every
+	 * few seconds) and flush its entries if it has changed.
+	 * Servers which do not implement it rely on the TTL.
+	 */
+	void Validate(const ContentDirectoryService &server);
+
+	/**
+	 * Like ContentDirectoryService::readDir().
+	 *
+	 * @return the container's children or nullptr on error
+	 */
+	std::shared_ptr<const UPnPDirContent>
+	ReadDir(const ContentDirectoryService &server, const char *objid,
+		Error &error) {
+		return Get(server, true, objid, true, error);
+	}
+
+	/**
+	 * Like ContentDirectoryService::getMetadata().
+	 */
+	std::shared_ptr<const UPnPDirContent>
+	GetMetadata(const ContentDirectoryService &server, const char *objid,
+		    Error &error) {
+		return Get(server, false, objid, true, error);
+	}
+
+	/**
+	 * Queue background reads of the sub-containers of a
+	 * container which has just been listed.
+	 */
+	void Prefetch(const ContentDirectoryService &server,
+		      const UPnPDirContent &content);
+
+private:
+	std::shared_ptr<const UPnPDirContent>
+	Get(const ContentDirectoryService &server, bool children,
+	    const char *objid, bool wait, Error &error);
+
+	bool IsCached(const std::string &server_id,
+		      const std::string &key);
+
+	static void *Work(void *ctx);
+	void Work();
+};
+
+#endif
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "UpnpDatabasePlugin.hxx"
 #include "Directory.hxx"
+#include "Cache.hxx"
 #include "Tags.hxx"
 #include "lib/upnp/Domain.hxx"
 #include "lib/upnp/ClientInit.hxx"
@@ -70,10 +71,22 @@ public:
 	}
 };
 
+/**
+ * The default lifetime of cached "Browse" responses [seconds].
+ */
+static constexpr unsigned DEFAULT_CACHE_TTL = 300;
+
 class UpnpDatabase : public Database {
 	UpnpClient_Handle handle;
 	UPnPDeviceDirectory *discovery;
 
+	/**
+	 * The "cache_ttl" setting.
+	 */
+	unsigned cache_ttl;
+
+	UpnpCache *cache;
+
 public:
 	UpnpDatabase():Database(upnp_db_plugin) {}
 
@@ -173,8 +186,9 @@ UpnpDatabase::Create(gcc_unused EventLoop &loop,
 }
 
 inline bool
-UpnpDatabase::Configure(const ConfigBlock &, Error &)
+UpnpDatabase::Configure(const ConfigBlock &block, Error &)
 {
+	cache_ttl = block.GetBlockValue("cache_ttl", DEFAULT_CACHE_TTL);
 	return true;
 }
 
@@ -191,12 +205,22 @@ UpnpDatabase::Open(Error &error)
 		return false;
 	}
 
+	cache = new UpnpCache(handle, cache_ttl);
+	if (!cache->Start(error)) {
+		delete cache;
+		delete discovery;
+		UpnpClientGlobalFinish();
+		return false;
+	}
+
 	return true;
 }
 
 void
 UpnpDatabase::Close()
 {
+	cache->Stop();
+	delete cache;
 	delete discovery;
 	UpnpClientGlobalFinish();
 }
@@ -227,6 +251,8 @@ UpnpDatabase::GetSong(const char *uri, Error &error) const
 
 	vpath.pop_front();
 
+	cache->Validate(server);
+
 	UPnPDirObject dirent;
 	if (vpath.front() != rootid) {
 		if (!Namei(server, vpath, dirent, error))
@@ -429,12 +455,12 @@ UpnpDatabase::ReadNode(const ContentDirectoryService &server,
 		       const char *objid, UPnPDirObject &dirent,
 		       Error &error) const
 {
-	UPnPDirContent dirbuf;
-	if (!server.getMetadata(handle, objid, dirbuf, error))
+	const auto dirbuf = cache->GetMetadata(server, objid, error);
+	if (dirbuf == nullptr)
 		return false;
 
-	if (dirbuf.objects.size() == 1) {
-		dirent = std::move(dirbuf.objects.front());
+	if (dirbuf->objects.size() == 1) {
+		dirent = UPnPDirObject(dirbuf->objects.front());
 	} else {
 		error.Format(upnp_domain, "Bad resource");
 		return false;
@@ -488,12 +514,13 @@ UpnpDatabase::Namei(const ContentDirectoryService &server,
 
 	// Walk the path elements, read each directory and try to find the next one
 	for (auto i = vpath.begin(), last = std::prev(vpath.end());; ++i) {
-		UPnPDirContent dirbuf;
-		if (!server.readDir(handle, objid.c_str(), dirbuf, error))
+		const auto dirbuf = cache->ReadDir(server, objid.c_str(),
+						   error);
+		if (dirbuf == nullptr)
 			return false;
 
 		// Look for the name in the sub-container list
-		UPnPDirObject *child = dirbuf.FindObject(i->c_str());
+		const UPnPDirObject *child = dirbuf->FindObject(i->c_str());
 		if (child == nullptr) {
 			error.Format(db_domain, DB_NOT_FOUND,
 				     "No such object");
@@ -501,7 +528,7 @@ UpnpDatabase::Namei(const ContentDirectoryService &server,
 		}
 
 		if (i == last) {
-			odirent = std::move(*child);
+			odirent = UPnPDirObject(*child);
 			return true;
 		}
 
@@ -511,7 +538,7 @@ UpnpDatabase::Namei(const ContentDirectoryService &server,
 			return false;
 		}
 
-		objid = std::move(child->id);
+		objid = child->id;
 	}
 }
 
@@ -587,6 +614,8 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 			  VisitPlaylist visit_playlist,
 			  Error &error) const
 {
+	cache->Validate(server);
+
 	/* If the path begins with rootid, we know that this is a
 	   song, not a directory (because that's how we set things
 	   up). Just visit it. Note that the choice of rootid is
@@ -659,12 +688,16 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 	/* Target was a a container. Visit it. We could read slices
 	   and loop here, but it's not useful as mpd will only return
 	   data to the client when we're done anyway. */
-	UPnPDirContent dirbuf;
-	if (!server.readDir(handle, tdirent.id.c_str(), dirbuf,
-			    error))
+	const auto dirbuf = cache->ReadDir(server, tdirent.id.c_str(),
+					   error);
+	if (dirbuf == nullptr)
 		return false;
 
-	for (auto &dirent : dirbuf.objects) {
+	/* the client will probably descend into one of the
+	   sub-containers next; read them in the background */
+	cache->Prefetch(server, *dirbuf);
+
+	for (const auto &dirent : dirbuf->objects) {
 		const std::string uri = PathTraitsUTF8::Build(base_uri,
 							      dirent.name.c_str());
 		if (!VisitObject(dirent, uri.c_str(),
@@ -28,6 +28,7 @@
 #include "storage/FileInfo.hxx"
 #include "archive/ArchiveList.hxx"
 #include "archive/ArchivePlugin.hxx"
+#include "archive/ArchiveCache.hxx"
 #include "archive/ArchiveFile.hxx"
 #include "archive/ArchiveVisitor.hxx"
 #include "util/Error.hxx"
@@ -61,19 +62,17 @@ UpdateWalk::UpdateArchiveTree(Directory &directory, const char *name)
 		}
 
 		//add file
-		db_lock();
+		db_lock_shared();
 		Song *song = directory.FindSong(name);
-		db_unlock();
+		db_unlock_shared();
 		if (song == nullptr) {
 			song = Song::LoadFile(storage, name, directory);
 			if (song != nullptr) {
-				db_lock();
-				directory.AddSong(song);
-				db_unlock();
+				editor.LockAddSong(directory, song);
 
 				modified = true;
 				FormatDefault(update_domain, "added %s/%s",
-					      directory.GetPath(), name);
+					      directory.GetPath().c_str(), name);
 			}
 		}
 	}
@@ -107,9 +106,9 @@ UpdateWalk::UpdateArchiveFile(Directory &parent, const char *name,
 			      const StorageFileInfo &info,
 			      const ArchivePlugin &plugin)
 {
-	db_lock();
+	db_lock_shared();
 	Directory *directory = parent.FindChild(name);
-	db_unlock();
+	db_unlock_shared();
 
 	if (directory != nullptr && directory->mtime == info.mtime &&
 	    !walk_discard)
@@ -117,15 +116,18 @@ UpdateWalk::UpdateArchiveFile(Directory &parent, const char *name,
 		   changed since - don't consider updating it */
 		return;
 
-	const auto path_fs = storage.MapChildFS(parent.GetPath(), name);
+	const auto path_fs = storage.MapChildFS(parent.GetPath().c_str(), name);
 	if (path_fs.IsNull())
 		/* not a local file: skip, because the archive API
 		   supports only local files */
 		return;
 
 	/* open archive */
+	CountOpen(info.size);
 	Error error;
-	ArchiveFile *file = archive_file_open(&plugin, path_fs, error);
+	/* the handle stays in the cache, so the songs which are
+	   scanned below don't open and parse the archive again */
+	ArchiveFile *file = archive_cache_open(plugin, path_fs, error);
 	if (file == nullptr) {
 		LogError(error);
 		if (directory != nullptr)
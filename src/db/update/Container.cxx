@@ -28,37 +28,8 @@
 #include "decoder/DecoderList.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "storage/FileInfo.hxx"
-#include "tag/TagHandler.hxx"
-#include "tag/TagBuilder.hxx"
 #include "Log.hxx"
 
-#include <sys/stat.h>
-
-Directory *
-UpdateWalk::MakeDirectoryIfModified(Directory &parent, const char *name,
-				    const StorageFileInfo &info)
-{
-	Directory *directory = parent.FindChild(name);
-
-	// directory exists already
-	if (directory != nullptr) {
-		if (directory->IsMount())
-			return nullptr;
-
-		if (directory->mtime == info.mtime && !walk_discard) {
-			/* not modified */
-			return nullptr;
-		}
-
-		editor.DeleteDirectory(directory);
-		modified = true;
-	}
-
-	directory = parent.MakeChild(name);
-	directory->mtime = info.mtime;
-	return directory;
-}
-
 static bool
 SupportsContainerSuffix(const DecoderPlugin &plugin, const char *suffix)
 {
@@ -78,58 +49,64 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 		return false;
 	const DecoderPlugin &plugin = *_plugin;
 
-	db_lock();
-	Directory *contdir = MakeDirectoryIfModified(directory, name, info);
-	if (contdir == nullptr) {
-		/* not modified */
-		db_unlock();
-		return true;
-	}
+	db_lock_shared();
+	const Directory *contdir = directory.FindChild(name);
+	const bool unmodified = contdir != nullptr &&
+		(contdir->IsMount() ||
+		 (contdir->mtime == info.mtime && !walk_discard));
+	db_unlock_shared();
 
-	contdir->device = DEVICE_CONTAINER;
-	db_unlock();
+	if (unmodified)
+		return true;
 
-	const auto pathname = storage.MapFS(contdir->GetPath());
-	if (pathname.IsNull()) {
+	if (storage.MapChildFS(directory.GetPath().c_str(), name).IsNull())
 		/* not a local file: skip, because the container API
 		   supports only local files */
-		editor.LockDeleteDirectory(contdir);
 		return false;
-	}
 
-	char *vtrack;
-	unsigned int tnum = 0;
-	TagBuilder tag_builder;
-	while ((vtrack = plugin.container_scan(pathname, ++tnum)) != nullptr) {
-		Song *song = Song::NewFile(vtrack, *contdir);
+	/* the container is scanned in the #scan_pool like any other
+	   file; MergeContainer() replaces the song (or the old
+	   container directory) with the tracks */
+	SongScanJob job(directory.GetPath().c_str(), name);
+	job.container_plugin = &plugin;
+	job.mtime = info.mtime;
+	job.size = info.size;
+	PushScan(std::move(job));
+	return true;
+}
 
-		// shouldn't be necessary but it's there..
-		song->mtime = info.mtime;
+void
+UpdateWalk::MergeContainer(Directory &directory, SongScanJob &job)
+{
+	const char *name = job.name.c_str();
 
-		const auto vtrack_fs = AllocatedPath::FromUTF8(vtrack);
-		// TODO: check vtrack_fs.IsNull()
+	Song *song = directory.FindSong(name);
+	if (song != nullptr)
+		editor.DeleteSong(directory, song);
 
-		const auto child_path_fs = AllocatedPath::Build(pathname,
-								vtrack_fs);
-		plugin.ScanFile(child_path_fs,
-				add_tag_handler, &tag_builder);
+	Directory *contdir = directory.FindChild(name);
+	if (contdir != nullptr)
+		editor.DeleteDirectory(contdir);
 
-		tag_builder.Commit(song->tag);
+	contdir = directory.MakeChild(name);
+	contdir->mtime = job.mtime;
+	contdir->device = DEVICE_CONTAINER;
 
-		db_lock();
-		contdir->AddSong(song);
-		db_unlock();
+	CountOpen(job.bytes_read);
 
-		modified = true;
+	for (auto &track : job.tracks) {
+		song = Song::NewFile(track.name.c_str(), *contdir);
+
+		// shouldn't be necessary but it's there..
+		song->mtime = job.mtime;
+		song->tag = std::move(track.tag);
+
+		editor.AddSong(*contdir, song);
 
 		FormatDefault(update_domain, "added %s/%s",
-			      directory.GetPath(), vtrack);
-		delete[] vtrack;
+			      contdir->GetPath().c_str(),
+			      track.name.c_str());
 	}
 
-	if (tnum == 1) {
-		editor.LockDeleteDirectory(contdir);
-		return false;
-	} else
-		return true;
+	modified = true;
 }
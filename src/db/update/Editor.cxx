@@ -24,16 +24,50 @@
 #include "db/DatabaseLock.hxx"
 #include "db/plugins/simple/Directory.hxx"
 #include "db/plugins/simple/Song.hxx"
+#include "db/plugins/simple/SongIndex.hxx"
 
 #include <assert.h>
 #include <stddef.h>
 
+void
+DatabaseEditor::AddSong(Directory &parent, Song *song)
+{
+	assert(song->parent == &parent);
+	assert(index != nullptr);
+
+	parent.AddSong(song);
+	index->Add(*song);
+}
+
+void
+DatabaseEditor::LockAddSong(Directory &parent, Song *song)
+{
+	db_lock();
+	AddSong(parent, song);
+	db_unlock();
+}
+
+void
+DatabaseEditor::UpdateSong(Song &song, Tag &&tag,
+			   time_t mtime, uint64_t size)
+{
+	assert(index != nullptr);
+
+	index->Remove(song);
+	song.tag = std::move(tag);
+	song.mtime = mtime;
+	song.size = size;
+	index->Add(song);
+}
+
 void
 DatabaseEditor::DeleteSong(Directory &dir, Song *del)
 {
 	assert(del->parent == &dir);
+	assert(index != nullptr);
 
 	/* first, prevent traversers in main task from getting this */
+	index->Remove(*del);
 	dir.RemoveSong(del);
 
 	db_unlock(); /* temporary unlock, because update_remove_song() blocks */
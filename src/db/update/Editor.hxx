@@ -24,16 +24,51 @@
 #include "Remove.hxx"
 #include "Compiler.h"
 
+#include <stdint.h>
+#include <time.h>
+
 struct Directory;
+struct Tag;
 struct Song;
+class SongIndex;
 class UpdateRemoveService;
 
 class DatabaseEditor final {
 	UpdateRemoveService remove;
 
+	/**
+	 * The index of the database being edited.
+	 */
+	SongIndex *index;
+
 public:
 	DatabaseEditor(EventLoop &_loop, DatabaseListener &_listener)
-		:remove(_loop, _listener) {}
+		:remove(_loop, _listener), index(nullptr) {}
+
+	void SetIndex(SongIndex &_index) {
+		index = &_index;
+	}
+
+	/**
+	 * Add a new song to the directory and to the index.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void AddSong(Directory &parent, Song *song);
+
+	/**
+	 * AddSong() with automatic locking.
+	 */
+	void LockAddSong(Directory &parent, Song *song);
+
+	/**
+	 * Replace the #Tag, the modification time and the size of a
+	 * song, and update the index.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void UpdateSong(Song &song, Tag &&tag,
+			time_t mtime, uint64_t size);
 
 	/**
 	 * Caller must lock the #db_mutex.
@@ -31,12 +31,12 @@
 #include "util/Error.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
 
-#ifdef HAVE_GLIB
-
 gcc_pure
 static bool
 IsFileNotFound(const Error &error)
@@ -49,12 +49,92 @@ IsFileNotFound(const Error &error)
 #endif
 }
 
-#endif
+/**
+ * Skip one UTF-8 character.
+ */
+gcc_pure
+static const char *
+NextCharacter(const char *p)
+{
+	assert(*p != 0);
+
+	++p;
+	while ((*p & 0xc0) == 0x80)
+		++p;
+	return p;
+}
+
+/**
+ * Match a pattern with '*' and '?' against a string.  When a
+ * literal character does not match, only the most recent '*' is
+ * extended; earlier ones never need to be revisited, so this is
+ * O(pattern * string) in the worst case, without recursion.
+ */
+gcc_pure
+static bool
+GlobMatch(const char *pattern, const char *s)
+{
+	const char *star = nullptr, *resume = nullptr;
+
+	while (*s != 0) {
+		if (*pattern == '*') {
+			star = ++pattern;
+			resume = s;
+		} else if (*pattern == '?') {
+			++pattern;
+			s = NextCharacter(s);
+		} else if (*pattern == *s) {
+			++pattern;
+			++s;
+		} else if (star != nullptr) {
+			pattern = star;
+			s = resume = NextCharacter(resume);
+		} else
+			return false;
+	}
+
+	while (*pattern == '*')
+		++pattern;
+
+	return *pattern == 0;
+}
+
+void
+ExcludePatterns::Add(const char *pattern)
+{
+	if (strpbrk(pattern, "*?") == nullptr) {
+		names.emplace(pattern);
+		return;
+	}
+
+	if (*pattern == '*') {
+		const char *suffix = pattern;
+		while (*suffix == '*')
+			++suffix;
+
+		if (strpbrk(suffix, "*?") == nullptr) {
+			const size_t length = strlen(suffix);
+			auto i = std::find_if(suffix_groups.begin(),
+					      suffix_groups.end(),
+					      [length](const SuffixGroup &g){
+						      return g.length == length;
+					      });
+			if (i == suffix_groups.end()) {
+				suffix_groups.emplace_back(length);
+				i = suffix_groups.end() - 1;
+			}
+
+			i->suffixes.emplace(suffix);
+			return;
+		}
+	}
+
+	globs.emplace_back(pattern);
+}
 
 bool
-ExcludeList::LoadFile(Path path_fs)
+ExcludePatterns::LoadFile(Path path_fs)
 {
-#ifdef HAVE_GLIB
 	Error error;
 	TextFile file(path_fs, error);
 	if (file.HasFailed()) {
@@ -71,31 +151,88 @@ ExcludeList::LoadFile(Path path_fs)
 
 		p = Strip(line);
 		if (*p != 0)
-			patterns.emplace_front(p);
+			Add(p);
 	}
-#else
-	// TODO: implement
-	(void)path_fs;
-#endif
 
 	return true;
 }
 
+bool
+ExcludePatterns::Check(const char *name_fs) const
+{
+	/* XXX include full path name in check */
+
+	if (!names.empty() && names.find(name_fs) != names.end())
+		return true;
+
+	if (!suffix_groups.empty()) {
+		const size_t length = strlen(name_fs);
+		for (const auto &g : suffix_groups) {
+			if (g.length > length)
+				continue;
+
+			if (g.suffixes.find(std::string(name_fs + length - g.length,
+							 g.length)) != g.suffixes.end())
+				return true;
+		}
+	}
+
+	for (const auto &i : globs)
+		if (GlobMatch(i.c_str(), name_fs))
+			return true;
+
+	return false;
+}
+
 bool
 ExcludeList::Check(Path name_fs) const
 {
 	assert(!name_fs.IsNull());
 
-	/* XXX include full path name in check */
+	if (IsEmpty())
+		return false;
+
+	const NarrowPath name(name_fs);
 
-#ifdef HAVE_GLIB
-	for (const auto &i : patterns)
-		if (i.Check(NarrowPath(name_fs).c_str()))
+	for (const ExcludeList *i = this; i != nullptr; i = i->parent)
+		if (i->patterns != nullptr && i->patterns->Check(name))
 			return true;
-#else
-	// TODO: implement
-	(void)name_fs;
-#endif
 
 	return false;
 }
+
+std::shared_ptr<const ExcludePatterns>
+ExcludeCache::Load(Path path_fs, time_t mtime, uint64_t size)
+{
+	auto &item = items[path_fs.c_str()];
+	if (item.exists && item.mtime == mtime && item.size == size)
+		return item.patterns;
+
+	item.mtime = mtime;
+	item.size = size;
+	item.exists = true;
+
+	ExcludePatterns *patterns = new ExcludePatterns();
+	if (!patterns->LoadFile(path_fs) || patterns->IsEmpty()) {
+		delete patterns;
+		patterns = nullptr;
+	}
+
+	item.patterns.reset(patterns);
+	return item.patterns;
+}
+
+void
+ExcludeCache::SetAbsent(Path path_fs)
+{
+	auto &item = items[path_fs.c_str()];
+	item.exists = false;
+	item.patterns.reset();
+}
+
+bool
+ExcludeCache::IsAbsent(Path path_fs) const
+{
+	auto i = items.find(path_fs.c_str());
+	return i != items.end() && !i->second.exists;
+}
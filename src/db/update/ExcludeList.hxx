@@ -26,67 +26,149 @@
 #define MPD_EXCLUDE_H
 
 #include "check.h"
+#include "fs/Traits.hxx"
 #include "Compiler.h"
 
-#include <forward_list>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_set>
+#include <unordered_map>
 
-#ifdef HAVE_GLIB
-#include <glib.h>
-#endif
+#include <stdint.h>
+#include <time.h>
 
 class Path;
 
-class ExcludeList {
-#ifdef HAVE_GLIB
-	class Pattern {
-		GPatternSpec *pattern;
-
-	public:
-		Pattern(const char *_pattern)
-			:pattern(g_pattern_spec_new(_pattern)) {}
-
-		Pattern(Pattern &&other)
-			:pattern(other.pattern) {
-			other.pattern = nullptr;
-		}
-
-		~Pattern() {
-			g_pattern_spec_free(pattern);
-		}
-
-		gcc_pure
-		bool Check(const char *name_fs) const {
-			return g_pattern_match_string(pattern, name_fs);
-		}
+/**
+ * The compiled patterns of one .mpdignore file.  Patterns are
+ * sorted by their shape when they are added: plain names are looked
+ * up in a hash set, patterns like "*.jpg" in a table of suffixes
+ * (grouped by their length), and only the remaining patterns are
+ * matched one by one.
+ *
+ * The special characters are '*' (any number of characters) and
+ * '?' (exactly one UTF-8 character).
+ */
+class ExcludePatterns {
+	std::unordered_set<std::string> names;
+
+	struct SuffixGroup {
+		size_t length;
+
+		std::unordered_set<std::string> suffixes;
+
+		explicit SuffixGroup(size_t _length):length(_length) {}
 	};
 
-	std::forward_list<Pattern> patterns;
-#else
-	// TODO: implement
-#endif
+	std::vector<SuffixGroup> suffix_groups;
+
+	std::vector<std::string> globs;
 
 public:
 	gcc_pure
 	bool IsEmpty() const {
-#ifdef HAVE_GLIB
-		return patterns.empty();
-#else
-		// TODO: implement
-		return true;
-#endif
+		return names.empty() && suffix_groups.empty() &&
+			globs.empty();
 	}
 
+	void Add(const char *pattern);
+
 	/**
 	 * Loads and parses a .mpdignore file.
 	 */
 	bool LoadFile(Path path_fs);
 
 	/**
-	 * Checks whether one of the patterns in the .mpdignore file matches
-	 * the specified file name.
+	 * Checks whether one of the patterns matches the specified
+	 * file name.
+	 */
+	gcc_pure
+	bool Check(const char *name_fs) const;
+};
+
+/**
+ * The .mpdignore rules which apply to one directory: the patterns
+ * of its own .mpdignore file and those of all parent directories.
+ * The parent's #ExcludeList must outlive this object.
+ */
+class ExcludeList {
+	const ExcludeList *const parent;
+
+	const std::shared_ptr<const ExcludePatterns> patterns;
+
+public:
+	ExcludeList():parent(nullptr) {}
+
+	ExcludeList(const ExcludeList &_parent,
+		    std::shared_ptr<const ExcludePatterns> &&_patterns)
+		:parent(_parent.patterns == nullptr
+			? _parent.parent
+			: &_parent),
+		 patterns(std::move(_patterns)) {}
+
+	ExcludeList(const ExcludeList &) = delete;
+	ExcludeList &operator=(const ExcludeList &) = delete;
+
+	gcc_pure
+	bool IsEmpty() const {
+		return patterns == nullptr && parent == nullptr;
+	}
+
+	/**
+	 * Checks whether one of the patterns in the .mpdignore files
+	 * matches the specified file name.
 	 */
+	gcc_pure
 	bool Check(Path name_fs) const;
 };
 
+/**
+ * Keeps the compiled .mpdignore files across updates.  A file is
+ * parsed again only if its modification time or size has changed.
+ * This object is used only by the update thread.
+ */
+class ExcludeCache {
+	struct Item {
+		time_t mtime;
+		uint64_t size;
+
+		/**
+		 * The compiled file; nullptr if there is no such
+		 * file, or if it contains no patterns.
+		 */
+		std::shared_ptr<const ExcludePatterns> patterns;
+
+		/**
+		 * Did the file exist when it was last seen?
+		 */
+		bool exists;
+	};
+
+	std::unordered_map<PathTraitsFS::string, Item> items;
+
+public:
+	/**
+	 * Returns the compiled patterns of the specified .mpdignore
+	 * file, which has the given modification time and size.
+	 *
+	 * @return the patterns or nullptr if there are none
+	 */
+	std::shared_ptr<const ExcludePatterns> Load(Path path_fs,
+						    time_t mtime,
+						    uint64_t size);
+
+	/**
+	 * Remember that the specified .mpdignore file does not exist.
+	 */
+	void SetAbsent(Path path_fs);
+
+	/**
+	 * Was the specified .mpdignore file known to be absent the
+	 * last time it was looked at?
+	 */
+	gcc_pure
+	bool IsAbsent(Path path_fs) const;
+};
 
 #endif
@@ -21,37 +21,44 @@
 #include "InotifyQueue.hxx"
 #include "InotifyDomain.hxx"
 #include "Service.hxx"
+#include "system/Clock.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <string.h>
 
 /**
  * Wait this long after the last change before calling
- * update_enqueue().  This increases the probability that updates can
- * be bundled.
+ * UpdateService::Enqueue().  This increases the probability that
+ * updates can be bundled.
  */
 static constexpr unsigned INOTIFY_UPDATE_DELAY_S = 5;
 
+/**
+ * Submit the queue after this duration even if there are still
+ * changes, so a continuous stream of events does not postpone the
+ * update forever.
+ */
+static constexpr unsigned INOTIFY_UPDATE_MAX_DELAY_S = 60;
+
 void
 InotifyQueue::OnTimeout()
 {
-	unsigned id;
-
-	while (!queue.empty()) {
-		const char *uri_utf8 = queue.front().c_str();
+	if (queue.empty())
+		return;
 
-		id = update.Enqueue(uri_utf8, false);
-		if (id == 0) {
-			/* retry later */
-			ScheduleSeconds(INOTIFY_UPDATE_DELAY_S);
-			return;
-		}
+	const unsigned id = update.Enqueue(queue);
+	if (id == 0) {
+		/* retry later */
+		ScheduleSeconds(INOTIFY_UPDATE_DELAY_S);
+		return;
+	}
 
-		FormatDebug(inotify_domain, "updating '%s' job=%u",
-			    uri_utf8, id);
+	FormatDebug(inotify_domain, "updating %u paths job=%u",
+		    unsigned(queue.size()), id);
 
-		queue.pop_front();
-	}
+	queue.clear();
 }
 
 static bool
@@ -59,7 +66,7 @@ path_in(const char *path, const char *possible_parent)
 {
 	size_t length = strlen(possible_parent);
 
-	return path[0] == 0 ||
+	return possible_parent[0] == 0 ||
 		(memcmp(possible_parent, path, length) == 0 &&
 		 (path[length] == 0 || path[length] == '/'));
 }
@@ -67,7 +74,15 @@ path_in(const char *path, const char *possible_parent)
 void
 InotifyQueue::Enqueue(const char *uri_utf8)
 {
-	ScheduleSeconds(INOTIFY_UPDATE_DELAY_S);
+	const unsigned now = MonotonicClockS();
+	if (queue.empty())
+		first_time = now;
+
+	const unsigned age = now - first_time;
+	ScheduleSeconds(age < INOTIFY_UPDATE_MAX_DELAY_S
+			? std::min(INOTIFY_UPDATE_DELAY_S,
+				   INOTIFY_UPDATE_MAX_DELAY_S - age)
+			: 0);
 
 	for (auto i = queue.begin(), end = queue.end(); i != end;) {
 		const char *current_uri = i->c_str();
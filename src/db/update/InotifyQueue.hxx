@@ -28,11 +28,25 @@
 
 class UpdateService;
 
+/**
+ * Collects the paths reported by inotify, and submits them to the
+ * #UpdateService as one job after the file system has settled.
+ */
 class InotifyQueue final : private TimeoutMonitor {
 	UpdateService &update;
 
+	/**
+	 * The paths to be updated.  None of them is inside another
+	 * one.
+	 */
 	std::list<std::string> queue;
 
+	/**
+	 * The monotonic time stamp [s] when the oldest item in
+	 * #queue was added.
+	 */
+	unsigned first_time;
+
 public:
 	InotifyQueue(EventLoop &_loop, UpdateService &_update)
 		:TimeoutMonitor(_loop), update(_update) {}
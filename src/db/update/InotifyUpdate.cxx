@@ -237,9 +237,40 @@ WatchDirectory::GetDepth() const
 	return depth;
 }
 
+/**
+ * Queue a database update for the given child of the watched
+ * directory, or for the directory itself if no (usable) name was
+ * given.
+ */
+static void
+enqueue_update(const AllocatedPath &uri_fs, const char *name)
+{
+	if (name != nullptr && *name != 0 && !skip_path(name) &&
+	    /* a new exclude list affects all siblings
+	       and their sub directories */
+	    strcmp(name, ".mpdignore") != 0) {
+		const auto child_uri_fs = uri_fs.IsNull()
+			? AllocatedPath::FromFS(name)
+			: AllocatedPath::Build(uri_fs, name);
+		const std::string uri_utf8 = child_uri_fs.ToUTF8();
+		if (!uri_utf8.empty()) {
+			inotify_queue->Enqueue(uri_utf8.c_str());
+			return;
+		}
+	}
+
+	if (!uri_fs.IsNull()) {
+		const std::string uri_utf8 = uri_fs.ToUTF8();
+		if (!uri_utf8.empty())
+			inotify_queue->Enqueue(uri_utf8.c_str());
+	}
+	else
+		inotify_queue->Enqueue("");
+}
+
 static void
 mpd_inotify_callback(int wd, unsigned mask,
-		     gcc_unused const char *name, gcc_unused void *ctx)
+		     const char *name, gcc_unused void *ctx)
 {
 	WatchDirectory *directory;
 
@@ -276,15 +307,10 @@ mpd_inotify_callback(int wd, unsigned mask,
 	    (directory->GetDepth() == inotify_max_depth &&
 	     (mask & (IN_CREATE|IN_ISDIR)) == (IN_CREATE|IN_ISDIR))) {
 		/* a file was changed, or a directory was
-		   moved/deleted: queue a database update */
+		   moved/deleted: queue a database update of only
+		   this file or directory */
 
-		if (!uri_fs.IsNull()) {
-			const std::string uri_utf8 = uri_fs.ToUTF8();
-			if (!uri_utf8.empty())
-				inotify_queue->Enqueue(uri_utf8.c_str());
-		}
-		else
-			inotify_queue->Enqueue("");
+		enqueue_update(uri_fs, name);
 	}
 }
 
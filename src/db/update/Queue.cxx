@@ -20,15 +20,18 @@
 #include "config.h"
 #include "Queue.hxx"
 
-bool
-UpdateQueue::Push(SimpleDatabase &db, Storage &storage,
-		  const char *path, bool discard, unsigned id)
+unsigned
+UpdateQueue::Push(UpdateQueueItem &&item)
 {
+	for (const auto &i : update_queue)
+		if (i.IsSame(item))
+			return i.id;
+
 	if (update_queue.size() >= MAX_UPDATE_QUEUE_SIZE)
-		return false;
+		return 0;
 
-	update_queue.emplace_back(db, storage, path, discard, id);
-	return true;
+	update_queue.push_back(std::move(item));
+	return update_queue.back().id;
 }
 
 UpdateQueueItem
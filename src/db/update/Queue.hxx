@@ -34,10 +34,19 @@ struct UpdateQueueItem {
 	Storage *storage;
 
 	std::string path_utf8;
+
+	/**
+	 * More paths to be updated in the same job, after
+	 * #path_utf8.  This bundles the changes reported by inotify;
+	 * see UpdateService::Enqueue(const std::list<std::string> &).
+	 */
+	std::list<std::string> more_paths;
+
 	unsigned id;
 	bool discard;
 
-	UpdateQueueItem():id(0) {}
+	UpdateQueueItem()
+		:db(nullptr), storage(nullptr), id(0), discard(false) {}
 
 	UpdateQueueItem(SimpleDatabase &_db,
 			Storage &_storage,
@@ -49,6 +58,17 @@ struct UpdateQueueItem {
 	bool IsDefined() const {
 		return id != 0;
 	}
+
+	/**
+	 * Does this job update the same paths as the specified one?
+	 */
+	gcc_pure
+	bool IsSame(const UpdateQueueItem &other) const {
+		return db == other.db && storage == other.storage &&
+			discard == other.discard &&
+			path_utf8 == other.path_utf8 &&
+			more_paths == other.more_paths;
+	}
 };
 
 class UpdateQueue {
@@ -57,9 +77,15 @@ class UpdateQueue {
 	std::list<UpdateQueueItem> update_queue;
 
 public:
-	gcc_nonnull_all
-	bool Push(SimpleDatabase &db, Storage &storage,
-		  const char *path, bool discard, unsigned id);
+	/**
+	 * Add a job to the end of the queue.  If an identical job is
+	 * already queued, no new one is added.
+	 *
+	 * @return the id of the new job (i.e. #UpdateQueueItem::id)
+	 * or of the identical job already queued, or 0 if the queue
+	 * is full
+	 */
+	unsigned Push(UpdateQueueItem &&item);
 
 	UpdateQueueItem Pop();
 
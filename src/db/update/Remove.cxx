@@ -21,6 +21,7 @@
 #include "Remove.hxx"
 #include "UpdateDomain.hxx"
 #include "db/plugins/simple/Song.hxx"
+#include "db/plugins/simple/Directory.hxx"
 #include "db/LightSong.hxx"
 #include "db/DatabaseListener.hxx"
 #include "Log.hxx"
@@ -41,7 +42,8 @@ UpdateRemoveService::RunDeferred()
 		FormatDefault(update_domain, "removing %s", uri.c_str());
 	}
 
-	listener.OnDatabaseSongRemoved(removed_song->Export());
+	const auto parent_path = removed_song->parent->GetPath();
+	listener.OnDatabaseSongRemoved(removed_song->Export(parent_path));
 
 	/* clear "removed_song" and send signal to update thread */
 	remove_mutex.lock();
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h" /* must be first for large file support */
+#include "ScanPool.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "storage/StorageInterface.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "ThreadConfig.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+
+std::string
+SongScanJob::GetURI() const
+{
+	if (directory.empty())
+		return name;
+
+	std::string uri(directory);
+	uri.push_back('/');
+	uri.append(name);
+	return uri;
+}
+
+void
+SongScanJob::Run(Storage &storage)
+{
+	const std::string uri = GetURI();
+
+	if (container_plugin != nullptr) {
+		const auto path_fs = storage.MapFS(uri.c_str());
+		if (!path_fs.IsNull()) {
+			tracks = container_plugin->ContainerScan(path_fs);
+			if (!tracks.empty()) {
+				/* the container has been read
+				   completely */
+				bytes_read = size;
+				success = true;
+				return;
+			}
+		}
+	}
+
+	success = Song::ScanFile(storage, uri.c_str(),
+				 tag, mtime, size, bytes_read);
+}
+
+SongScanPool::~SongScanPool()
+{
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (auto &thread : threads)
+		thread.Join();
+}
+
+unsigned
+SongScanPool::Start(unsigned n)
+{
+	unsigned started = 0;
+
+	for (; started < n; ++started) {
+		threads.emplace_front();
+
+		Error error;
+		if (!threads.front().Start(Run, this, error)) {
+			threads.pop_front();
+			LogError(error);
+			break;
+		}
+	}
+
+	return started;
+}
+
+void
+SongScanPool::Push(SongScanJob &&job)
+{
+	const ScopeLock protect(mutex);
+	pending.push_back(std::move(job));
+	cond.signal();
+}
+
+unsigned
+SongScanPool::GetCount()
+{
+	const ScopeLock protect(mutex);
+	return pending.size() + n_running + finished.size();
+}
+
+void
+SongScanPool::Collect(std::list<SongScanJob> &dest, bool wait)
+{
+	const ScopeLock protect(mutex);
+
+	if (wait)
+		while (finished.empty() && (!pending.empty() || n_running > 0))
+			finished_cond.wait(mutex);
+
+	dest.splice(dest.end(), finished);
+}
+
+inline void
+SongScanPool::Run()
+{
+	SetThreadName("update_scan");
+	SetThreadIdlePriority();
+	ApplyThreadConfig("update");
+
+	const ScopeLock protect(mutex);
+
+	while (true) {
+		if (quit)
+			break;
+
+		if (pending.empty()) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		/* take the job out of the list while working on it,
+		   and move it to #finished when done */
+		std::list<SongScanJob> job;
+		job.splice(job.end(), pending, pending.begin());
+		++n_running;
+
+		mutex.unlock();
+
+		job.front().Run(storage);
+
+		mutex.lock();
+
+		--n_running;
+		finished.splice(finished.end(), job);
+		finished_cond.signal();
+	}
+}
+
+void
+SongScanPool::Run(void *ctx)
+{
+	SongScanPool &pool = *(SongScanPool *)ctx;
+	pool.Run();
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_UPDATE_SCAN_POOL_HXX
+#define MPD_UPDATE_SCAN_POOL_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "tag/Tag.hxx"
+#include "decoder/ContainerTrack.hxx"
+#include "Compiler.h"
+
+#include <string>
+#include <list>
+#include <forward_list>
+
+#include <stdint.h>
+#include <time.h>
+
+class Storage;
+struct DecoderPlugin;
+
+/**
+ * A request to scan the tags of one song file, and its result.
+ */
+struct SongScanJob {
+	/**
+	 * The URI of the #Directory containing the song (UTF-8).
+	 * The #Directory is referenced only by its URI, because it
+	 * may be deleted while the job is being processed.
+	 */
+	std::string directory;
+
+	/**
+	 * The name of the song within the #Directory (UTF-8).
+	 */
+	std::string name;
+
+	/**
+	 * If not nullptr, then the file is scanned as a container
+	 * with this plugin first; see DecoderPlugin::container_scan().
+	 * #mtime and #size must be set by the caller in this case.
+	 */
+	const DecoderPlugin *container_plugin;
+
+	/**
+	 * Was the file scanned successfully?  If not, #tag, #mtime,
+	 * #size and #bytes_read are undefined.
+	 */
+	bool success;
+
+	Tag tag;
+	time_t mtime;
+	uint64_t size;
+
+	/**
+	 * See Song::ScanFile().
+	 */
+	uint64_t bytes_read;
+
+	/**
+	 * The "virtual" tracks found by #container_plugin.  If this
+	 * is empty, then the file is not a container, and it was
+	 * scanned as a plain song file.
+	 */
+	std::forward_list<ContainerTrack> tracks;
+
+	SongScanJob(const char *_directory, const char *_name)
+		:directory(_directory), name(_name),
+		 container_plugin(nullptr), success(false) {}
+
+	/**
+	 * Returns the URI of the song within the #Storage.
+	 */
+	gcc_pure
+	std::string GetURI() const;
+
+	/**
+	 * Scan the file (blocking).  This is called by the
+	 * #SongScanPool threads.
+	 */
+	void Run(Storage &storage);
+};
+
+/**
+ * A pool of threads which scan song files (and container files)
+ * concurrently with SongScanJob::Run(), to hide the I/O latency of
+ * slow file systems.
+ * The #UpdateWalk thread submits jobs with Push() and merges the
+ * results into the #Directory tree.
+ */
+class SongScanPool {
+	Storage &storage;
+
+	std::forward_list<Thread> threads;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a new job was pushed or when the pool shall
+	 * quit.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled when a job has finished.
+	 */
+	Cond finished_cond;
+
+	/**
+	 * Jobs which have not been started yet.
+	 */
+	std::list<SongScanJob> pending;
+
+	/**
+	 * Jobs which have been finished, but not yet collected with
+	 * Collect().
+	 */
+	std::list<SongScanJob> finished;
+
+	/**
+	 * The number of jobs which are currently being worked on.
+	 */
+	unsigned n_running;
+
+	bool quit;
+
+public:
+	explicit SongScanPool(Storage &_storage)
+		:storage(_storage), n_running(0), quit(false) {}
+
+	~SongScanPool();
+
+	SongScanPool(const SongScanPool &) = delete;
+	SongScanPool &operator=(const SongScanPool &) = delete;
+
+	/**
+	 * Start the given number of worker threads.  Failures are
+	 * logged.
+	 *
+	 * @return the number of threads which were started
+	 */
+	unsigned Start(unsigned n);
+
+	void Push(SongScanJob &&job);
+
+	/**
+	 * Returns the number of jobs which have not been collected
+	 * yet.
+	 */
+	gcc_pure
+	unsigned GetCount();
+
+	/**
+	 * Move all finished jobs to the given list.
+	 *
+	 * @param wait if true, then wait until at least one job has
+	 * finished (unless there are no jobs at all)
+	 */
+	void Collect(std::list<SongScanJob> &dest, bool wait);
+
+private:
+	void Run();
+	static void Run(void *ctx);
+};
+
+#endif
@@ -30,6 +30,8 @@
 #include "util/Error.hxx"
 #include "Log.hxx"
 #include "Instance.hxx"
+#include "ThreadConfig.hxx"
+#include "metrics/Metrics.hxx"
 #include "system/FatalError.hxx"
 #include "thread/Id.hxx"
 #include "thread/Thread.hxx"
@@ -39,7 +41,11 @@
 #include "event/Loop.hxx"
 #endif
 
+#include <algorithm>
+#include <chrono>
+
 #include <assert.h>
+#include <string.h>
 
 UpdateService::UpdateService(EventLoop &_loop, SimpleDatabase &_db,
 			     CompositeStorage &_storage,
@@ -80,9 +86,9 @@ UpdateService::CancelMount(const char *uri)
 	/* determine which (mounted) database will be updated and what
 	   storage will be scanned */
 
-	db_lock();
+	db_lock_shared();
 	const auto lr = db.GetRoot().LookupDirectory(uri);
-	db_unlock();
+	db_unlock_shared();
 
 	if (!lr.directory->IsMount())
 		return;
@@ -115,16 +121,27 @@ UpdateService::Task()
 {
 	assert(walk != nullptr);
 
-	if (!next.path_utf8.empty())
+	if (!next.more_paths.empty())
+		FormatDebug(update_domain, "starting: %s and %u more",
+			    next.path_utf8.c_str(),
+			    unsigned(next.more_paths.size()));
+	else if (!next.path_utf8.empty())
 		FormatDebug(update_domain, "starting: %s",
 			    next.path_utf8.c_str());
 	else
 		LogDebug(update_domain, "starting");
 
 	SetThreadIdlePriority();
+	ApplyThreadConfig("update");
+
+	const auto start_time = std::chrono::steady_clock::now();
+
+	modified = walk->Walk(next.db->GetRoot(), next.db->GetIndex(),
+			      next.path_utf8.c_str(), next.discard);
 
-	modified = walk->Walk(next.db->GetRoot(), next.path_utf8.c_str(),
-			      next.discard);
+	for (const auto &path : next.more_paths)
+		modified |= walk->Walk(next.db->GetRoot(), next.db->GetIndex(),
+				       path.c_str(), next.discard);
 
 	if (modified || !next.db->FileExists()) {
 		Error error;
@@ -132,11 +149,16 @@ UpdateService::Task()
 			LogError(error, "Failed to save database");
 	}
 
-	if (!next.path_utf8.empty())
-		FormatDebug(update_domain, "finished: %s",
-			    next.path_utf8.c_str());
-	else
-		LogDebug(update_domain, "finished");
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start_time;
+	global_metrics.update_duration.Observe(duration.count());
+
+	const auto &stats = walk->GetStatistics();
+	FormatDebug(update_domain,
+		    "finished: %s (%u directories listed, %u skipped, %u files stat'ed, %u opened, %llu bytes read)",
+		    next.path_utf8.empty() ? "/" : next.path_utf8.c_str(),
+		    stats.n_list, stats.n_skipped, stats.n_stat, stats.n_open,
+		    (unsigned long long)stats.read_bytes);
 
 	progress = UPDATE_PROGRESS_DONE;
 	DeferredMonitor::Schedule();
@@ -159,7 +181,8 @@ UpdateService::StartThread(UpdateQueueItem &&i)
 	modified = false;
 
 	next = std::move(i);
-	walk = new UpdateWalk(GetEventLoop(), listener, *next.storage);
+	walk = new UpdateWalk(GetEventLoop(), listener, *next.storage,
+			      exclude_cache);
 
 	Error error;
 	if (!update_thread.Start(Task, this, error))
@@ -178,19 +201,13 @@ UpdateService::GenerateId()
 	return id;
 }
 
-unsigned
-UpdateService::Enqueue(const char *path, bool discard)
+bool
+UpdateService::Resolve(const char *&path,
+		       SimpleDatabase *&db_r, Storage *&storage_r)
 {
-	assert(GetEventLoop().IsInsideOrNull());
-
-	/* determine which (mounted) database will be updated and what
-	   storage will be scanned */
-	SimpleDatabase *db2;
-	Storage *storage2;
-
-	db_lock();
+	db_lock_shared();
 	const auto lr = db.GetRoot().LookupDirectory(path);
-	db_unlock();
+	db_unlock_shared();
 	if (lr.directory->IsMount()) {
 		/* follow the mountpoint, update the mounted
 		   database */
@@ -198,12 +215,12 @@ UpdateService::Enqueue(const char *path, bool discard)
 		Database &_db2 = *lr.directory->mounted_database;
 		if (!_db2.IsPlugin(simple_db_plugin))
 			/* cannot update this type of database */
-			return 0;
+			return false;
 
-		db2 = static_cast<SimpleDatabase *>(&_db2);
+		db_r = static_cast<SimpleDatabase *>(&_db2);
 
 		if (lr.uri == nullptr) {
-			storage2 = storage.GetMount(path);
+			storage_r = storage.GetMount(path);
 			path = "";
 		} else {
 			assert(lr.uri > path);
@@ -211,38 +228,95 @@ UpdateService::Enqueue(const char *path, bool discard)
 			assert(lr.uri[-1] == '/');
 
 			const std::string mountpoint(path, lr.uri - 1);
-			storage2 = storage.GetMount(mountpoint.c_str());
+			storage_r = storage.GetMount(mountpoint.c_str());
 			path = lr.uri;
 		}
 	} else {
 		/* use the "root" database/storage */
 
-		db2 = &db;
-		storage2 = storage.GetMount("");
+		db_r = &db;
+		storage_r = storage.GetMount("");
 	}
 
-	if (storage2 == nullptr)
-		/* no storage found at this mount point - should not
-		   happen */
-		return 0;
+	/* no storage found at this mount point - should not
+	   happen */
+	return storage_r != nullptr;
+}
+
+unsigned
+UpdateService::Submit(UpdateQueueItem &&item)
+{
+	const unsigned id = item.id;
 
 	if (progress != UPDATE_PROGRESS_IDLE) {
-		const unsigned id = GenerateId();
-		if (!queue.Push(*db2, *storage2, path, discard, id))
-			return 0;
+		const unsigned queued_id = queue.Push(std::move(item));
+		if (queued_id == id)
+			update_task_id = id;
 
-		update_task_id = id;
-		return id;
+		return queued_id;
 	}
 
-	const unsigned id = update_task_id = GenerateId();
-	StartThread(UpdateQueueItem(*db2, *storage2, path, discard, id));
+	update_task_id = id;
+	StartThread(std::move(item));
 
 	idle_add(IDLE_UPDATE);
 
 	return id;
 }
 
+unsigned
+UpdateService::Enqueue(const char *path, bool discard)
+{
+	assert(GetEventLoop().IsInsideOrNull());
+
+	/* determine which (mounted) database will be updated and what
+	   storage will be scanned */
+	SimpleDatabase *db2;
+	Storage *storage2;
+	if (!Resolve(path, db2, storage2))
+		return 0;
+
+	return Submit(UpdateQueueItem(*db2, *storage2, path, discard,
+				      GenerateId()));
+}
+
+unsigned
+UpdateService::Enqueue(const std::list<std::string> &paths)
+{
+	assert(GetEventLoop().IsInsideOrNull());
+
+	/* one job per (mounted) database */
+	std::list<UpdateQueueItem> items;
+
+	for (const auto &i : paths) {
+		const char *path = i.c_str();
+		SimpleDatabase *db2;
+		Storage *storage2;
+		if (!Resolve(path, db2, storage2))
+			continue;
+
+		auto item = std::find_if(items.begin(), items.end(),
+					 [db2, storage2](const UpdateQueueItem &j){
+						 return j.db == db2 &&
+							 j.storage == storage2;
+					 });
+		if (item == items.end())
+			items.emplace_back(*db2, *storage2, path, false, 0);
+		else
+			item->more_paths.emplace_back(path);
+	}
+
+	unsigned id = 0;
+	for (auto &item : items) {
+		item.id = GenerateId();
+		id = Submit(std::move(item));
+		if (id == 0)
+			break;
+	}
+
+	return id;
+}
+
 /**
  * Called in the main thread after the database update is finished.
  */
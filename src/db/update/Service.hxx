@@ -22,11 +22,13 @@
 
 #include "check.h"
 #include "Queue.hxx"
+#include "ExcludeList.hxx"
 #include "event/DeferredMonitor.hxx"
 #include "thread/Thread.hxx"
 #include "Compiler.h"
 
 class SimpleDatabase;
+class Storage;
 class DatabaseListener;
 class UpdateWalk;
 class CompositeStorage;
@@ -62,6 +64,13 @@ class UpdateService final : DeferredMonitor {
 
 	UpdateWalk *walk;
 
+	/**
+	 * The compiled .mpdignore files; only accessed by the update
+	 * thread.  Kept here, so the next update needs to parse only
+	 * files which have been modified.
+	 */
+	ExcludeCache exclude_cache;
+
 public:
 	UpdateService(EventLoop &_loop, SimpleDatabase &_db,
 		      CompositeStorage &_storage,
@@ -87,6 +96,15 @@ public:
 	gcc_nonnull_all
 	unsigned Enqueue(const char *path, bool discard);
 
+	/**
+	 * Add these paths to the database update queue.  Paths which
+	 * belong to the same database are updated by one job.  This
+	 * is used by inotify.
+	 *
+	 * @return the id of the last job, or 0 on error
+	 */
+	unsigned Enqueue(const std::list<std::string> &paths);
+
 	/**
 	 * Clear the queue and cancel the current update.  Does not
 	 * wait for the thread to exit.
@@ -110,6 +128,24 @@ private:
 
 	void StartThread(UpdateQueueItem &&i);
 
+	/**
+	 * Determine which (mounted) database will be updated and
+	 * what storage will be scanned.
+	 *
+	 * @param path the path; it is modified to be relative to the
+	 * mounted database
+	 */
+	bool Resolve(const char *&path,
+		     SimpleDatabase *&db_r, Storage *&storage_r);
+
+	/**
+	 * Start the given job, or add it to the queue if an update is
+	 * already running.
+	 *
+	 * @return the job id, or 0 on error
+	 */
+	unsigned Submit(UpdateQueueItem &&item);
+
 	unsigned GenerateId();
 };
 
@@ -23,7 +23,6 @@
 #include "db/plugins/simple/Directory.hxx"
 #include "storage/FileInfo.hxx"
 #include "storage/StorageInterface.hxx"
-#include "fs/Traits.hxx"
 #include "fs/FileSystem.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "util/Error.hxx"
@@ -42,48 +41,6 @@ GetInfo(Storage &storage, const char *uri_utf8, StorageFileInfo &info)
 	return success;
 }
 
-bool
-GetInfo(StorageDirectoryReader &reader, StorageFileInfo &info)
-{
-	Error error;
-	bool success = reader.GetInfo(true, info, error);
-	if (!success)
-		LogError(error);
-	return success;
-}
-
-bool
-DirectoryExists(Storage &storage, const Directory &directory)
-{
-	StorageFileInfo info;
-	if (!storage.GetInfo(directory.GetPath(), true, info, IgnoreError()))
-		return false;
-
-	return directory.device == DEVICE_INARCHIVE ||
-		directory.device == DEVICE_CONTAINER
-		? info.IsRegular()
-		: info.IsDirectory();
-}
-
-static bool
-GetDirectoryChildInfo(Storage &storage, const Directory &directory,
-		      const char *name_utf8, StorageFileInfo &info, Error &error)
-{
-	const auto uri_utf8 = PathTraitsUTF8::Build(directory.GetPath(),
-						    name_utf8);
-	return storage.GetInfo(uri_utf8.c_str(), true, info, error);
-}
-
-bool
-directory_child_is_regular(Storage &storage, const Directory &directory,
-			   const char *name_utf8)
-{
-	StorageFileInfo info;
-	return GetDirectoryChildInfo(storage, directory, name_utf8, info,
-				     IgnoreError()) &&
-		info.IsRegular();
-}
-
 bool
 directory_child_access(Storage &storage, const Directory &directory,
 		       const char *name, int mode)
@@ -96,7 +53,7 @@ directory_child_access(Storage &storage, const Directory &directory,
 	(void)mode;
 	return true;
 #else
-	const auto path = storage.MapChildFS(directory.GetPath(), name);
+	const auto path = storage.MapChildFS(directory.GetPath().c_str(), name);
 	if (path.IsNull())
 		/* does not point to local file: silently ignore the
 		   check */
@@ -26,7 +26,6 @@
 struct Directory;
 struct StorageFileInfo;
 class Storage;
-class StorageDirectoryReader;
 
 /**
  * Wrapper for Storage::GetInfo() that logs errors instead of
@@ -35,22 +34,6 @@ class StorageDirectoryReader;
 bool
 GetInfo(Storage &storage, const char *uri_utf8, StorageFileInfo &info);
 
-/**
- * Wrapper for LocalDirectoryReader::GetInfo() that logs errors
- * instead of returning them.
- */
-bool
-GetInfo(StorageDirectoryReader &reader, StorageFileInfo &info);
-
-gcc_pure
-bool
-DirectoryExists(Storage &storage, const Directory &directory);
-
-gcc_pure
-bool
-directory_child_is_regular(Storage &storage, const Directory &directory,
-			   const char *name_utf8);
-
 /**
  * Checks if the given permissions on the mapped file are given.
  */
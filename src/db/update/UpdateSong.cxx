@@ -30,63 +30,55 @@
 
 #include <unistd.h>
 
+bool
+UpdateWalk::IsUnmodified(const Song &song, const StorageFileInfo &info) const
+{
+	if (trust_stat && song.size > 0)
+		return info.size == song.size;
+
+	return info.mtime == song.mtime &&
+		(song.size == 0 || info.size == song.size);
+}
+
 inline void
 UpdateWalk::UpdateSongFile2(Directory &directory,
 			    const char *name, const char *suffix,
 			    const StorageFileInfo &info)
 {
-	db_lock();
+	db_lock_shared();
 	Song *song = directory.FindSong(name);
-	db_unlock();
+	db_unlock_shared();
+
+	const bool unmodified = song != nullptr && !walk_discard &&
+		IsUnmodified(*song, info);
 
-	if (!directory_child_access(storage, directory, name, R_OK)) {
+	/* with "update_trust_stat", an unmodified song is not
+	   touched at all, not even with access() */
+	if (!(unmodified && trust_stat) &&
+	    !directory_child_access(storage, directory, name, R_OK)) {
 		FormatError(update_domain,
 			    "no read permissions on %s/%s",
-			    directory.GetPath(), name);
+			    directory.GetPath().c_str(), name);
 		if (song != nullptr)
 			editor.LockDeleteSong(directory, song);
 
 		return;
 	}
 
-	if (!(song != nullptr && info.mtime == song->mtime &&
-	      !walk_discard) &&
-	    UpdateContainerFile(directory, name, suffix, info)) {
-		if (song != nullptr)
-			editor.LockDeleteSong(directory, song);
-
+	if (!unmodified &&
+	    UpdateContainerFile(directory, name, suffix, info))
+		/* MergeScan() replaces the song with the container
+		   directory */
 		return;
-	}
 
 	if (song == nullptr) {
 		FormatDebug(update_domain, "reading %s/%s",
-			    directory.GetPath(), name);
-		song = Song::LoadFile(storage, name, directory);
-		if (song == nullptr) {
-			FormatDebug(update_domain,
-				    "ignoring unrecognized file %s/%s",
-				    directory.GetPath(), name);
-			return;
-		}
-
-		db_lock();
-		directory.AddSong(song);
-		db_unlock();
-
-		modified = true;
-		FormatDefault(update_domain, "added %s/%s",
-			      directory.GetPath(), name);
-	} else if (info.mtime != song->mtime || walk_discard) {
+			    directory.GetPath().c_str(), name);
+		QueueScan(directory, name);
+	} else if (!unmodified) {
 		FormatDefault(update_domain, "updating %s/%s",
-			      directory.GetPath(), name);
-		if (!song->UpdateFile(storage)) {
-			FormatDebug(update_domain,
-				    "deleting unrecognized file %s/%s",
-				    directory.GetPath(), name);
-			editor.LockDeleteSong(directory, song);
-		}
-
-		modified = true;
+			      directory.GetPath().c_str(), name);
+		QueueScan(directory, name);
 	}
 }
 
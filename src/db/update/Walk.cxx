@@ -35,6 +35,7 @@
 #include "fs/AllocatedPath.hxx"
 #include "fs/Traits.hxx"
 #include "fs/FileSystem.hxx"
+#include "fs/FileInfo.hxx"
 #include "fs/Charset.hxx"
 #include "storage/FileInfo.hxx"
 #include "util/Alloc.hxx"
@@ -48,12 +49,17 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <memory>
+#include <vector>
+#include <algorithm>
 
 UpdateWalk::UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
-		       Storage &_storage)
+		       Storage &_storage, ExcludeCache &_exclude_cache)
 	:cancel(false),
 	 storage(_storage),
-	 editor(_loop, _listener)
+	 exclude_cache(_exclude_cache),
+	 editor(_loop, _listener),
+	 walk_root(nullptr),
+	 max_scan_jobs(MAX_STAGED_SCANS)
 {
 #ifndef WIN32
 	follow_inside_symlinks =
@@ -64,6 +70,148 @@ UpdateWalk::UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
 		config_get_bool(ConfigOption::FOLLOW_OUTSIDE_SYMLINKS,
 				DEFAULT_FOLLOW_OUTSIDE_SYMLINKS);
 #endif
+
+	trust_stat = config_get_bool(ConfigOption::UPDATE_TRUST_STAT,
+				     DEFAULT_UPDATE_TRUST_STAT);
+
+	trust_directory_mtime =
+		config_get_bool(ConfigOption::UPDATE_TRUST_DIRECTORY_MTIME,
+				DEFAULT_UPDATE_TRUST_DIRECTORY_MTIME);
+
+	const unsigned n_threads =
+		config_get_positive(ConfigOption::UPDATE_THREADS,
+				    DEFAULT_UPDATE_THREADS);
+	if (n_threads > 1) {
+		scan_pool.reset(new SongScanPool(storage));
+
+		const unsigned started = scan_pool->Start(n_threads);
+		if (started == 0)
+			scan_pool.reset();
+
+		/* keep the workers busy while the walk merges
+		   finished jobs in batches */
+		max_scan_jobs = started * 4;
+	}
+}
+
+void
+UpdateWalk::QueueScan(Directory &directory, const char *name)
+{
+	PushScan(SongScanJob(directory.GetPath().c_str(), name));
+}
+
+void
+UpdateWalk::PushScan(SongScanJob &&job)
+{
+	if (scan_pool == nullptr) {
+		/* no worker threads: scan right here, but publish
+		   the result in a batch with the others */
+		job.Run(storage);
+		staged_scans.push_back(std::move(job));
+
+		if (staged_scans.size() >= max_scan_jobs)
+			CollectScans(false);
+		return;
+	}
+
+	while (scan_pool->GetCount() >= max_scan_jobs)
+		CollectScans(true);
+
+	scan_pool->Push(std::move(job));
+}
+
+void
+UpdateWalk::CollectScans(bool wait)
+{
+	if (scan_pool != nullptr)
+		scan_pool->Collect(staged_scans, wait);
+
+	if (staged_scans.empty())
+		return;
+
+	/* publish all of them with only one db_lock() call */
+	db_lock();
+	for (auto &job : staged_scans)
+		MergeScan(job);
+	db_unlock();
+
+	staged_scans.clear();
+}
+
+void
+UpdateWalk::FlushScans()
+{
+	if (scan_pool != nullptr)
+		while (scan_pool->GetCount() > 0)
+			CollectScans(true);
+
+	CollectScans(false);
+}
+
+void
+UpdateWalk::MergeScan(SongScanJob &job)
+{
+	assert(walk_root != nullptr);
+
+	const auto r = walk_root->LookupDirectory(job.directory.c_str());
+	if (r.uri != nullptr)
+		/* the directory has been deleted meanwhile */
+		return;
+
+	Directory &directory = *r.directory;
+	const char *name = job.name.c_str();
+
+	if (!job.tracks.empty()) {
+		MergeContainer(directory, job);
+		return;
+	}
+
+	if (job.container_plugin != nullptr) {
+		/* not a container (anymore) */
+		Directory *contdir = directory.FindChild(name);
+		if (contdir != nullptr && contdir->device == DEVICE_CONTAINER) {
+			editor.DeleteDirectory(contdir);
+			modified = true;
+		}
+	}
+
+	Song *song = directory.FindSong(name);
+
+	++stats.n_open;
+
+	if (!job.success) {
+		if (song != nullptr) {
+			FormatDebug(update_domain,
+				    "deleting unrecognized file %s/%s",
+				    directory.GetPath().c_str(), name);
+			editor.DeleteSong(directory, song);
+			modified = true;
+		} else
+			FormatDebug(update_domain,
+				    "ignoring unrecognized file %s/%s",
+				    directory.GetPath().c_str(), name);
+		return;
+	}
+
+	stats.read_bytes += job.bytes_read;
+	FormatDebug(update_domain, "scanned %s/%s: %llu bytes read",
+		    directory.GetPath().c_str(), name,
+		    (unsigned long long)job.bytes_read);
+
+	if (song == nullptr) {
+		song = Song::NewFile(name, directory);
+		song->tag = std::move(job.tag);
+		song->mtime = job.mtime;
+		song->size = job.size;
+		editor.AddSong(directory, song);
+
+		FormatDefault(update_domain, "added %s/%s",
+			      directory.GetPath().c_str(), name);
+	} else
+		editor.UpdateSong(*song, std::move(job.tag),
+				  job.mtime, job.size);
+
+	modified = true;
 }
 
 static void
@@ -102,38 +250,149 @@ UpdateWalk::RemoveExcludedFromDirectory(Directory &directory,
 	db_unlock();
 }
 
-inline void
-UpdateWalk::PurgeDeletedFromDirectory(Directory &directory)
+std::shared_ptr<const ExcludePatterns>
+UpdateWalk::LoadExcludeFile(const Directory &directory,
+			    const StorageFileInfo *info)
 {
-	directory.ForEachChildSafe([&](Directory &child){
-			if (DirectoryExists(storage, child))
-				return;
+	const auto path_fs =
+		storage.MapChildFS(directory.GetPath().c_str(), ".mpdignore");
+	if (path_fs.IsNull())
+		/* not a local directory */
+		return nullptr;
 
-			editor.LockDeleteDirectory(&child);
+	if (info == nullptr || !info->IsRegular()) {
+		exclude_cache.SetAbsent(path_fs);
+		return nullptr;
+	}
 
-			modified = true;
-		});
+	return exclude_cache.Load(path_fs, info->mtime, info->size);
+}
 
-	directory.ForEachSongSafe([&](Song &song){
-			if (!directory_child_is_regular(storage, directory,
-							song.uri)) {
-				editor.LockDeleteSong(directory, &song);
+std::shared_ptr<const ExcludePatterns>
+UpdateWalk::StatExcludeFile(const Directory &directory, bool trust_absent)
+{
+	const auto path_fs =
+		storage.MapChildFS(directory.GetPath().c_str(), ".mpdignore");
+	if (path_fs.IsNull())
+		/* not a local directory */
+		return nullptr;
 
-				modified = true;
-			}
-		});
+	if (trust_absent && exclude_cache.IsAbsent(path_fs))
+		return nullptr;
+
+	FileInfo fi;
+	++stats.n_stat;
+	if (!GetFileInfo(path_fs, fi) || !fi.IsRegular()) {
+		exclude_cache.SetAbsent(path_fs);
+		return nullptr;
+	}
 
+	return exclude_cache.Load(path_fs, fi.GetModificationTime(),
+				  fi.GetSize());
+}
+
+typedef std::vector<const StorageDirectoryEntry *> SortedListing;
+
+static SortedListing
+SortListing(const StorageDirectoryListing &listing)
+{
+	SortedListing result;
+	for (const auto &i : listing)
+		result.push_back(&i);
+
+	std::sort(result.begin(), result.end(),
+		  [](const StorageDirectoryEntry *a,
+		     const StorageDirectoryEntry *b){
+			  return a->name < b->name;
+		  });
+	return result;
+}
+
+/**
+ * Look up a name in a listing which was sorted by SortListing().
+ */
+gcc_pure
+static const StorageFileInfo *
+FindInListing(const SortedListing &listing, const char *name)
+{
+	auto i = std::lower_bound(listing.begin(), listing.end(), name,
+				  [](const StorageDirectoryEntry *a,
+				     const char *b){
+					  return strcmp(a->name.c_str(), b) < 0;
+				  });
+	if (i == listing.end() || strcmp((*i)->name.c_str(), name) != 0)
+		return nullptr;
+
+	return &(*i)->info;
+}
+
+gcc_pure
+static bool
+ChildDirectoryExists(const SortedListing &listing, const Directory &child)
+{
+	const StorageFileInfo *info = FindInListing(listing, child.GetName());
+	if (info == nullptr)
+		return false;
+
+	return child.device == DEVICE_INARCHIVE ||
+		child.device == DEVICE_CONTAINER
+		? info->IsRegular()
+		: info->IsDirectory();
+}
+
+gcc_pure
+static bool
+ChildIsRegular(const SortedListing &listing, const char *name)
+{
+	const StorageFileInfo *info = FindInListing(listing, name);
+	return info != nullptr && info->IsRegular();
+}
+
+inline void
+UpdateWalk::PurgeDeletedFromDirectory(Directory &directory,
+				      const StorageDirectoryListing &listing)
+{
+	/* check the directory listing first without holding the
+	   db_mutex, and then delete everything in one batch */
+
+	const SortedListing sorted = SortListing(listing);
+
+	std::vector<Directory *> dead_directories;
+	for (auto &child : directory.children)
+		if (!ChildDirectoryExists(sorted, child))
+			dead_directories.push_back(&child);
+
+	std::vector<Song *> dead_songs;
+	for (auto &song : directory.songs)
+		if (!ChildIsRegular(sorted, song.uri))
+			dead_songs.push_back(&song);
+
+	std::vector<decltype(directory.playlists.begin())> dead_playlists;
 	for (auto i = directory.playlists.begin(),
 		     end = directory.playlists.end();
-	     i != end;) {
-		if (!directory_child_is_regular(storage, directory,
-						i->name.c_str())) {
-			db_lock();
-			i = directory.playlists.erase(i);
-			db_unlock();
-		} else
-			++i;
-	}
+	     i != end; ++i)
+		if (!ChildIsRegular(sorted, i->name.c_str()))
+			dead_playlists.push_back(i);
+
+	if (dead_directories.empty() && dead_songs.empty() &&
+	    dead_playlists.empty())
+		return;
+
+	db_lock();
+
+	for (Directory *child : dead_directories)
+		editor.DeleteDirectory(child);
+
+	for (Song *song : dead_songs)
+		editor.DeleteSong(directory, song);
+
+	for (auto i : dead_playlists)
+		directory.playlists.erase(i);
+
+	db_unlock();
+
+	if (!dead_directories.empty() || !dead_songs.empty())
+		modified = true;
 }
 
 #ifndef WIN32
@@ -141,7 +400,7 @@ static bool
 update_directory_stat(Storage &storage, Directory &directory)
 {
 	StorageFileInfo info;
-	if (!GetInfo(storage, directory.GetPath(), info))
+	if (!GetInfo(storage, directory.GetPath().c_str(), info))
 		return false;
 
 	directory_set_stat(directory, info);
@@ -219,6 +478,7 @@ UpdateWalk::UpdateRegularFile(Directory &directory,
 
 void
 UpdateWalk::UpdateDirectoryChild(Directory &directory,
+				 const ExcludeList &exclude_list,
 				 const char *name, const StorageFileInfo &info)
 {
 	assert(strchr(name, '/') == nullptr);
@@ -236,7 +496,9 @@ UpdateWalk::UpdateDirectoryChild(Directory &directory,
 
 		assert(&directory == subdir->parent);
 
-		if (!UpdateDirectory(*subdir, info))
+		if (IsUnmodified(*subdir, info))
+			UpdateUnmodifiedDirectory(*subdir, exclude_list, info);
+		else if (!UpdateDirectory(*subdir, exclude_list, info))
 			editor.LockDeleteDirectory(subdir);
 	} else {
 		FormatDebug(update_domain,
@@ -258,7 +520,7 @@ UpdateWalk::SkipSymlink(const Directory *directory,
 			const char *utf8_name) const
 {
 #ifndef WIN32
-	const auto path_fs = storage.MapChildFS(directory->GetPath(),
+	const auto path_fs = storage.MapChildFS(directory->GetPath().c_str(),
 						utf8_name);
 	if (path_fs.IsNull())
 		/* not a local file: don't skip */
@@ -327,35 +589,50 @@ UpdateWalk::SkipSymlink(const Directory *directory,
 }
 
 bool
-UpdateWalk::UpdateDirectory(Directory &directory, const StorageFileInfo &info)
+UpdateWalk::UpdateDirectory(Directory &directory,
+			    const ExcludeList &parent_exclude_list,
+			    const StorageFileInfo &info)
 {
 	assert(info.IsDirectory());
 
 	directory_set_stat(directory, info);
 
+	/* one request for all names and their file information;
+	   for remote storages, this avoids one round trip per
+	   entry */
 	Error error;
-	const std::unique_ptr<StorageDirectoryReader> reader(storage.OpenDirectory(directory.GetPath(), error));
-	if (reader.get() == nullptr) {
+	StorageDirectoryListing listing;
+	++stats.n_list;
+	if (!storage.ListDirectory(directory.GetPath().c_str(), true,
+				   listing, error)) {
 		LogError(error);
 		return false;
 	}
 
-	ExcludeList exclude_list;
-
-	{
-		const auto exclude_path_fs =
-			storage.MapChildFS(directory.GetPath(), ".mpdignore");
-		if (!exclude_path_fs.IsNull())
-			exclude_list.LoadFile(exclude_path_fs);
+	/* the listing tells whether there is a .mpdignore file and
+	   whether it has changed; it is only opened if it has */
+	const StorageFileInfo *exclude_info = nullptr;
+	for (const auto &entry : listing) {
+		if (entry.name == ".mpdignore") {
+			exclude_info = &entry.info;
+			break;
+		}
 	}
 
+	const ExcludeList exclude_list(parent_exclude_list,
+				       LoadExcludeFile(directory,
+						       exclude_info));
+
 	if (!exclude_list.IsEmpty())
 		RemoveExcludedFromDirectory(directory, exclude_list);
 
-	PurgeDeletedFromDirectory(directory);
+	PurgeDeletedFromDirectory(directory, listing);
+
+	for (const auto &entry : listing) {
+		if (cancel)
+			break;
 
-	const char *name_utf8;
-	while (!cancel && (name_utf8 = reader->Read()) != nullptr) {
+		const char *name_utf8 = entry.name.c_str();
 		if (skip_path(name_utf8))
 			continue;
 
@@ -370,18 +647,81 @@ UpdateWalk::UpdateDirectory(Directory &directory, const StorageFileInfo &info)
 			continue;
 		}
 
-		StorageFileInfo info2;
-		if (!GetInfo(*reader, info2)) {
-			modified |= editor.DeleteNameIn(directory, name_utf8);
+		UpdateDirectoryChild(directory, exclude_list,
+				     name_utf8, entry.info);
+	}
+
+	if (!cancel)
+		/* remember the time stamp only if all entries have
+		   been seen, or IsUnmodified() would skip the rest
+		   next time */
+		directory.mtime = info.mtime;
+
+	CollectScans(false);
+
+	return true;
+}
+
+bool
+UpdateWalk::IsUnmodified(const Directory &directory,
+			 const StorageFileInfo &info) const
+{
+	return trust_directory_mtime && !walk_discard &&
+		directory.mtime != 0 && info.mtime == directory.mtime;
+}
+
+void
+UpdateWalk::UpdateUnmodifiedDirectory(Directory &directory,
+				      const ExcludeList &parent_exclude_list,
+				      const StorageFileInfo &info)
+{
+	assert(info.IsDirectory());
+
+	directory_set_stat(directory, info);
+	++stats.n_skipped;
+
+	/* creating or deleting the .mpdignore file would have
+	   modified the directory, but editing it would not */
+	const ExcludeList exclude_list(parent_exclude_list,
+				       StatExcludeFile(directory, true));
+
+	if (!exclude_list.IsEmpty())
+		RemoveExcludedFromDirectory(directory, exclude_list);
+
+	/* no entries have been added or removed, but the contents of
+	   the sub directories may have changed */
+
+	std::vector<std::string> names;
+
+	db_lock_shared();
+	for (const auto &child : directory.children)
+		if (child.device != DEVICE_INARCHIVE &&
+		    child.device != DEVICE_CONTAINER)
+			names.emplace_back(child.GetName());
+	db_unlock_shared();
+
+	const auto path = directory.GetPath();
+
+	for (const auto &name : names) {
+		if (cancel)
+			break;
+
+		const auto uri = PathTraitsUTF8::Build(path.c_str(),
+						       name.c_str());
+
+		StorageFileInfo child_info;
+		++stats.n_stat;
+		if (!GetInfo(storage, uri.c_str(), child_info)) {
+			modified |= editor.DeleteNameIn(directory,
+							name.c_str());
 			continue;
 		}
 
-		UpdateDirectoryChild(directory, name_utf8, info2);
+		UpdateDirectoryChild(directory, exclude_list,
+				     name.c_str(), child_info);
 	}
 
-	directory.mtime = info.mtime;
-
-	return true;
+	CollectScans(false);
 }
 
 inline Directory *
@@ -389,9 +729,9 @@ UpdateWalk::DirectoryMakeChildChecked(Directory &parent,
 				      const char *uri_utf8,
 				      const char *name_utf8)
 {
-	db_lock();
+	db_lock_shared();
 	Directory *directory = parent.FindChild(name_utf8);
-	db_unlock();
+	db_unlock_shared();
 
 	if (directory != nullptr) {
 		if (directory->IsMount())
@@ -401,6 +741,7 @@ UpdateWalk::DirectoryMakeChildChecked(Directory &parent,
 	}
 
 	StorageFileInfo info;
+	++stats.n_stat;
 	if (!GetInfo(storage, uri_utf8, info) ||
 	    FindAncestorLoop(storage, &parent, info.inode, info.device))
 		return nullptr;
@@ -457,23 +798,49 @@ UpdateWalk::UpdateUri(Directory &root, const char *uri)
 
 	const char *name = PathTraitsUTF8::GetBase(uri);
 
+	/* apply the exclude lists of the parent and all its
+	   ancestors, just like UpdateDirectory() does */
+	std::vector<const Directory *> ancestors;
+	for (const Directory *i = parent; i != nullptr; i = i->parent)
+		ancestors.push_back(i);
+
+	std::list<ExcludeList> exclude_lists;
+	exclude_lists.emplace_back();
+	for (auto i = ancestors.rbegin(); i != ancestors.rend(); ++i)
+		exclude_lists.emplace_back(exclude_lists.back(),
+					   StatExcludeFile(**i, false));
+
+	const ExcludeList &exclude_list = exclude_lists.back();
+
+	{
+		const auto name_fs = AllocatedPath::FromUTF8(name);
+		if (name_fs.IsNull() || exclude_list.Check(name_fs)) {
+			modified |= editor.DeleteNameIn(*parent, name);
+			return;
+		}
+	}
+
 	if (SkipSymlink(parent, name)) {
 		modified |= editor.DeleteNameIn(*parent, name);
 		return;
 	}
 
 	StorageFileInfo info;
+	++stats.n_stat;
 	if (!GetInfo(storage, uri, info)) {
 		modified |= editor.DeleteNameIn(*parent, name);
 		return;
 	}
 
-	UpdateDirectoryChild(*parent, name, info);
+	UpdateDirectoryChild(*parent, exclude_list, name, info);
 }
 
 bool
-UpdateWalk::Walk(Directory &root, const char *path, bool discard)
+UpdateWalk::Walk(Directory &root, SongIndex &index,
+		 const char *path, bool discard)
 {
+	editor.SetIndex(index);
+	walk_root = &root;
 	walk_discard = discard;
 	modified = false;
 
@@ -481,11 +848,15 @@ UpdateWalk::Walk(Directory &root, const char *path, bool discard)
 		UpdateUri(root, path);
 	} else {
 		StorageFileInfo info;
+		++stats.n_stat;
 		if (!GetInfo(storage, "", info))
 			return false;
 
-		UpdateDirectory(root, info);
+		const ExcludeList exclude_list;
+		UpdateDirectory(root, exclude_list, info);
 	}
 
+	FlushScans();
+
 	return modified;
 }
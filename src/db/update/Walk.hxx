@@ -22,22 +22,42 @@
 
 #include "check.h"
 #include "Editor.hxx"
+#include "ScanPool.hxx"
+#include "storage/FileInfo.hxx"
+#include "storage/DirectoryListing.hxx"
 #include "Compiler.h"
 
+#include <memory>
+#include <list>
+
+#include <stdint.h>
 #include <sys/stat.h>
 
 struct stat;
-struct StorageFileInfo;
 struct Directory;
+struct Song;
 struct ArchivePlugin;
 class Storage;
 class ExcludeList;
+class ExcludePatterns;
+class ExcludeCache;
+class SongIndex;
 
 class UpdateWalk final {
 #ifdef ENABLE_ARCHIVE
 	friend class UpdateArchiveVisitor;
 #endif
 
+	static constexpr unsigned DEFAULT_UPDATE_THREADS = 1;
+	static constexpr bool DEFAULT_UPDATE_TRUST_STAT = false;
+	static constexpr bool DEFAULT_UPDATE_TRUST_DIRECTORY_MTIME = false;
+
+	/**
+	 * Without #scan_pool, publish scanned songs after this many
+	 * have been staged (or at the end of each directory).
+	 */
+	static constexpr unsigned MAX_STAGED_SCANS = 64;
+
 #ifndef WIN32
 	static constexpr bool DEFAULT_FOLLOW_INSIDE_SYMLINKS = true;
 	static constexpr bool DEFAULT_FOLLOW_OUTSIDE_SYMLINKS = true;
@@ -46,6 +66,21 @@ class UpdateWalk final {
 	bool follow_outside_symlinks;
 #endif
 
+	/**
+	 * Consider a song file unmodified if its size has not
+	 * changed, even if its modification time has.  This avoids
+	 * opening files whose time stamp was touched by a backup or
+	 * copy tool.
+	 */
+	bool trust_stat;
+
+	/**
+	 * Consider the entries of a directory unmodified if its
+	 * modification time has not changed.  Such a directory is
+	 * not listed again; only its sub directories are checked.
+	 */
+	bool trust_directory_mtime;
+
 	bool walk_discard;
 	bool modified;
 
@@ -58,11 +93,84 @@ class UpdateWalk final {
 
 	Storage &storage;
 
+	/**
+	 * The compiled .mpdignore files, owned by the
+	 * #UpdateService; they survive this object.
+	 */
+	ExcludeCache &exclude_cache;
+
 	DatabaseEditor editor;
 
+	/**
+	 * The root of the #Directory tree being walked.  Only valid
+	 * during Walk().
+	 */
+	Directory *walk_root;
+
+	/**
+	 * Scans song files in worker threads if the option
+	 * "update_threads" is larger than 1; nullptr otherwise.
+	 */
+	std::unique_ptr<SongScanPool> scan_pool;
+
+	/**
+	 * Scanned songs which have not yet been merged into the
+	 * tree.  They are published in batches by CollectScans(), to
+	 * avoid locking the #db_mutex for each song.
+	 */
+	std::list<SongScanJob> staged_scans;
+
+	/**
+	 * The maximum number of scan jobs which have not yet been
+	 * merged into the tree.
+	 */
+	unsigned max_scan_jobs;
+
+public:
+	/**
+	 * Counters describing how much I/O the update caused.
+	 */
+	struct Statistics {
+		/**
+		 * The number of files and directories which were
+		 * stat()ed.
+		 */
+		unsigned n_stat = 0;
+
+		/**
+		 * The number of directories which were listed with
+		 * Storage::ListDirectory().  Their entries are not
+		 * counted in #n_stat.
+		 */
+		unsigned n_list = 0;
+
+		/**
+		 * The number of directories which were not listed,
+		 * because they are unmodified (see
+		 * #trust_directory_mtime).
+		 */
+		unsigned n_skipped = 0;
+
+		/**
+		 * The number of files which were opened for scanning.
+		 */
+		unsigned n_open = 0;
+
+		/**
+		 * The number of bytes read from the opened files.
+		 * For files which were not scanned by
+		 * tag_header_scan(), the file size is counted (an
+		 * upper bound).
+		 */
+		uint64_t read_bytes = 0;
+	};
+
+private:
+	Statistics stats;
+
 public:
 	UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
-		   Storage &_storage);
+		   Storage &_storage, ExcludeCache &_exclude_cache);
 
 	/**
 	 * Cancel the current update and quit the Walk() method as
@@ -74,8 +182,20 @@ public:
 
 	/**
 	 * Returns true if the database was modified.
+	 *
+	 * @param index the #SongIndex of the database which owns
+	 * #root; it is kept up to date while walking
 	 */
-	bool Walk(Directory &root, const char *path, bool discard);
+	bool Walk(Directory &root, SongIndex &index,
+		  const char *path, bool discard);
+
+	/**
+	 * Returns the counters accumulated by all Walk() calls on
+	 * this object.
+	 */
+	const Statistics &GetStatistics() const {
+		return stats;
+	}
 
 private:
 	gcc_pure
@@ -85,7 +205,87 @@ private:
 	void RemoveExcludedFromDirectory(Directory &directory,
 					 const ExcludeList &exclude_list);
 
-	void PurgeDeletedFromDirectory(Directory &directory);
+	/**
+	 * Obtain the .mpdignore file of the given directory from
+	 * #exclude_cache, parsing it only if it has been modified.
+	 *
+	 * @param info the file information from the directory
+	 * listing; nullptr if the listing has no ".mpdignore"
+	 * @return the patterns or nullptr if there are none
+	 */
+	std::shared_ptr<const ExcludePatterns>
+	LoadExcludeFile(const Directory &directory,
+			const StorageFileInfo *info);
+
+	/**
+	 * Like LoadExcludeFile(), but for a directory which has not
+	 * been listed: the file is stat()ed, unless it was absent
+	 * last time and #trust_absent is set.
+	 */
+	std::shared_ptr<const ExcludePatterns>
+	StatExcludeFile(const Directory &directory, bool trust_absent);
+
+	/**
+	 * Delete all children which do not exist (anymore) in the
+	 * given directory listing.
+	 */
+	void PurgeDeletedFromDirectory(Directory &directory,
+				       const StorageDirectoryListing &listing);
+
+	/**
+	 * Scan a song file, or submit it to the #scan_pool.  The
+	 * result will be merged into the tree by CollectScans().
+	 */
+	void QueueScan(Directory &directory, const char *name);
+
+	/**
+	 * Run the job, or submit it to the #scan_pool.
+	 */
+	void PushScan(SongScanJob &&job);
+
+	/**
+	 * Merge the results of finished #scan_pool jobs into the
+	 * tree.
+	 *
+	 * @param wait wait for at least one job to finish?
+	 */
+	void CollectScans(bool wait);
+
+	/**
+	 * Wait for all #scan_pool jobs and merge them into the tree.
+	 */
+	void FlushScans();
+
+	/**
+	 * Caller must lock the #db_mutex.
+	 */
+	void MergeScan(SongScanJob &job);
+
+	/**
+	 * Replace the song (or the old container) with a
+	 * #DEVICE_CONTAINER directory containing the tracks of the
+	 * job.  Caller must lock the #db_mutex.
+	 */
+	void MergeContainer(Directory &directory, SongScanJob &job);
+
+	/**
+	 * Has the song file been modified since it was scanned?
+	 * Compares the modification time and (if known) the size;
+	 * with #trust_stat, only the size is compared.
+	 */
+	gcc_pure
+	bool IsUnmodified(const Song &song,
+			  const StorageFileInfo &info) const;
+
+	/**
+	 * Count the opening of a file in #stats.
+	 *
+	 * @param bytes_read the number of bytes read from the file
+	 */
+	void CountOpen(uint64_t bytes_read) {
+		++stats.n_open;
+		stats.read_bytes += bytes_read;
+	}
 
 	void UpdateSongFile2(Directory &directory,
 			     const char *name, const char *suffix,
@@ -95,6 +295,13 @@ private:
 			    const char *name, const char *suffix,
 			    const StorageFileInfo &info);
 
+	/**
+	 * If a decoder plugin supports the file as a container,
+	 * submit it to the #scan_pool, unless the container
+	 * directory is unmodified.
+	 *
+	 * @return false if the file is not handled as a container
+	 */
 	bool UpdateContainerFile(Directory &directory,
 				 const char *name, const char *suffix,
 				 const StorageFileInfo &info);
@@ -128,23 +335,38 @@ private:
 	bool UpdateRegularFile(Directory &directory,
 			       const char *name, const StorageFileInfo &info);
 
+	/**
+	 * @param exclude_list the .mpdignore rules of #directory
+	 */
 	void UpdateDirectoryChild(Directory &directory,
+				  const ExcludeList &exclude_list,
 				  const char *name,
 				  const StorageFileInfo &info);
 
+	/**
+	 * @param parent_exclude_list the .mpdignore rules of the
+	 * parent directory, which also apply to this one
+	 */
 	bool UpdateDirectory(Directory &directory,
+			     const ExcludeList &parent_exclude_list,
 			     const StorageFileInfo &info);
 
 	/**
-	 * Create the specified directory object if it does not exist
-	 * already or if the #stat object indicates that it has been
-	 * modified since the last update.  Returns nullptr when it
-	 * exists already and is unmodified.
-	 *
-	 * The caller must lock the database.
+	 * Has the directory been modified since it was listed?
+	 * Always true unless #trust_directory_mtime is enabled.
+	 */
+	gcc_pure
+	bool IsUnmodified(const Directory &directory,
+			  const StorageFileInfo &info) const;
+
+	/**
+	 * Update a directory whose entries have not changed (see
+	 * IsUnmodified()) without listing it: only its sub
+	 * directories are checked.
 	 */
-	Directory *MakeDirectoryIfModified(Directory &parent, const char *name,
-					   const StorageFileInfo &info);
+	void UpdateUnmodifiedDirectory(Directory &directory,
+				       const ExcludeList &parent_exclude_list,
+				       const StorageFileInfo &info);
 
 	Directory *DirectoryMakeChildChecked(Directory &parent,
 					     const char *uri_utf8,
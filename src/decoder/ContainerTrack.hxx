@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CONTAINER_TRACK_HXX
+#define MPD_CONTAINER_TRACK_HXX
+
+#include "check.h"
+#include "tag/Tag.hxx"
+
+#include <string>
+
+/**
+ * A "virtual" track of a container file, as returned by
+ * DecoderPlugin::container_scan().
+ */
+struct ContainerTrack {
+	/**
+	 * The file name of the track relative to the container file,
+	 * e.g. "tune_001.sid".
+	 */
+	std::string name;
+
+	Tag tag;
+
+	ContainerTrack(std::string &&_name, Tag &&_tag)
+		:name(std::move(_name)), tag(std::move(_tag)) {}
+};
+
+#endif
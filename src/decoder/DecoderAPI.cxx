@@ -30,6 +30,8 @@
 #include "DecoderInternal.hxx"
 #include "DetachedSong.hxx"
 #include "input/InputStream.hxx"
+#include "system/Clock.hxx"
+#include "system/Trace.hxx"
 #include "util/Error.hxx"
 #include "util/ConstBuffer.hxx"
 #include "Log.hxx"
@@ -62,6 +64,9 @@ decoder_initialized(Decoder &decoder,
 	dc.seekable = seekable;
 	dc.total_time = duration;
 
+	decoder.chunk_limit = CalcChunkLimit(dc.out_audio_format,
+					     dc.buffer->GetChunkSize());
+
 	FormatDebug(decoder_domain, "audio_format=%s, seekable=%s",
 		    audio_format_to_string(dc.in_audio_format, &af_string),
 		    seekable ? "true" : "false");
@@ -307,6 +312,43 @@ decoder_check_cancel_read(const Decoder *decoder)
 	return true;
 }
 
+/**
+ * Wait for the #InputStream to become available, and account the
+ * time in DecoderStatistics::input_wait_time.
+ *
+ * Caller must lock the #InputStream.
+ */
+static void
+decoder_wait_input(Decoder *decoder, InputStream &is)
+{
+	if (decoder == nullptr) {
+		is.cond.wait(is.mutex);
+		return;
+	}
+
+	const uint64_t wait_start = MonotonicClockUS();
+	is.cond.wait(is.mutex);
+	decoder->statistics.input_wait_time +=
+		MonotonicClockUS() - wait_start;
+}
+
+/**
+ * Copy the fill level of the #InputStream's read-ahead buffer to
+ * #DecoderStatistics.
+ *
+ * Caller must lock the #InputStream.
+ */
+static void
+decoder_update_input_level(Decoder *decoder, InputStream &is)
+{
+	if (decoder == nullptr)
+		return;
+
+	auto &s = decoder->statistics;
+	if (!is.GetBufferLevel(s.input_buffered, s.input_buffer_limit))
+		s.input_buffered = s.input_buffer_limit = 0;
+}
+
 size_t
 decoder_read(Decoder *decoder,
 	     InputStream &is,
@@ -322,6 +364,8 @@ decoder_read(Decoder *decoder,
 	if (length == 0)
 		return 0;
 
+	ScopeTrace trace("decoder_read");
+
 	is.Lock();
 
 	while (true) {
@@ -333,7 +377,7 @@ decoder_read(Decoder *decoder,
 		if (is.IsAvailable())
 			break;
 
-		is.cond.wait(is.mutex);
+		decoder_wait_input(decoder, is);
 	}
 
 	Error error;
@@ -341,14 +385,53 @@ decoder_read(Decoder *decoder,
 	assert(nbytes == 0 || !error.IsDefined());
 	assert(nbytes > 0 || error.IsDefined() || is.IsEOF());
 
+	decoder_update_input_level(decoder, is);
+
 	is.Unlock();
 
 	if (gcc_unlikely(nbytes == 0 && error.IsDefined()))
 		LogError(error);
 
+	trace.SetArgument(nbytes);
 	return nbytes;
 }
 
+ConstBuffer<void>
+decoder_peek(Decoder *decoder, InputStream &is)
+{
+	assert(decoder == nullptr ||
+	       decoder->dc.state == DecoderState::START ||
+	       decoder->dc.state == DecoderState::DECODE);
+	assert(is.SupportsPeek());
+
+	is.Lock();
+
+	while (true) {
+		if (decoder_check_cancel_read(decoder)) {
+			is.Unlock();
+			return nullptr;
+		}
+
+		if (is.IsAvailable())
+			break;
+
+		decoder_wait_input(decoder, is);
+	}
+
+	Error error;
+	const auto r = is.Peek(error);
+	assert(!r.IsEmpty() || error.IsDefined() || is.IsEOF());
+
+	decoder_update_input_level(decoder, is);
+
+	is.Unlock();
+
+	if (gcc_unlikely(r.IsEmpty() && error.IsDefined()))
+		LogError(error);
+
+	return r;
+}
+
 bool
 decoder_read_full(Decoder *decoder, InputStream &is,
 		  void *_buffer, size_t size)
@@ -441,25 +524,24 @@ update_stream_tag(Decoder &decoder, InputStream *is)
 	return true;
 }
 
-DecoderCommand
-decoder_data(Decoder &decoder,
-	     InputStream *is,
-	     const void *data, size_t length,
-	     uint16_t kbit_rate)
+/**
+ * Check for a pending command and send new stream tags; this must be
+ * done before PCM data is submitted.
+ */
+static DecoderCommand
+decoder_prepare_data(Decoder &decoder, InputStream *is)
 {
 	DecoderControl &dc = decoder.dc;
 	DecoderCommand cmd;
 
 	assert(dc.state == DecoderState::DECODE);
 	assert(dc.pipe != nullptr);
-	assert(length % dc.in_audio_format.GetFrameSize() == 0);
 
 	dc.Lock();
 	cmd = decoder_get_virtual_command(decoder);
 	dc.Unlock();
 
-	if (cmd == DecoderCommand::STOP || cmd == DecoderCommand::SEEK ||
-	    length == 0)
+	if (cmd == DecoderCommand::STOP || cmd == DecoderCommand::SEEK)
 		return cmd;
 
 	assert(!decoder.initial_seek_pending);
@@ -482,13 +564,102 @@ decoder_data(Decoder &decoder,
 			return cmd;
 	}
 
+	return DecoderCommand::NONE;
+}
+
+/**
+ * Returns the free space in the current chunk (whole frames only);
+ * a full chunk is flushed, and a new one is allocated.
+ *
+ * @return the buffer, or nullptr if we have received a decoder
+ * command
+ */
+static WritableBuffer<void>
+decoder_get_chunk_space(Decoder &decoder, uint16_t kbit_rate)
+{
+	DecoderControl &dc = decoder.dc;
+
+	while (true) {
+		MusicChunk *chunk = decoder.GetChunk();
+		if (chunk == nullptr) {
+			assert(dc.command != DecoderCommand::NONE);
+			return nullptr;
+		}
+
+		const auto dest =
+			chunk->Write(dc.out_audio_format,
+				     SongTime::FromS(decoder.timestamp) -
+				     dc.song->GetStartTime(),
+				     kbit_rate);
+		if (!dest.IsEmpty())
+			return dest;
+
+		/* the chunk is full, flush it */
+		decoder.FlushChunk();
+	}
+}
+
+/**
+ * Account for data which has been written into the current chunk
+ * (obtained from decoder_get_chunk_space()).
+ */
+static DecoderCommand
+decoder_expand_chunk(Decoder &decoder, size_t nbytes)
+{
+	DecoderControl &dc = decoder.dc;
+
+	assert(decoder.chunk != nullptr);
+
+	decoder.statistics.decoded_bytes += nbytes;
+
+	/* expand the music pipe chunk */
+
+	if (decoder.chunk->Expand(dc.out_audio_format, nbytes))
+		/* the chunk is full, flush it */
+		decoder.FlushChunk();
+
+	decoder.timestamp += (double)nbytes /
+		dc.out_audio_format.GetTimeToSize();
+
+	if (dc.end_time.IsPositive() &&
+	    decoder.timestamp >= dc.end_time.ToDoubleS())
+		/* the end of this range has been reached:
+		   stop decoding */
+		return DecoderCommand::STOP;
+
+	return DecoderCommand::NONE;
+}
+
+DecoderCommand
+decoder_data(Decoder &decoder,
+	     InputStream *is,
+	     const void *data, size_t length,
+	     uint16_t kbit_rate)
+{
+	const ScopeTrace trace("decoder_data");
+
+	DecoderControl &dc = decoder.dc;
+
+	assert(length % dc.in_audio_format.GetFrameSize() == 0);
+
+	if (length == 0) {
+		dc.Lock();
+		DecoderCommand cmd = decoder_get_virtual_command(decoder);
+		dc.Unlock();
+		return cmd;
+	}
+
+	DecoderCommand cmd = decoder_prepare_data(decoder, is);
+	if (cmd != DecoderCommand::NONE)
+		return cmd;
+
 	if (decoder.convert != nullptr) {
 		assert(dc.in_audio_format != dc.out_audio_format);
 
 		Error error;
 		auto result = decoder.convert->Convert({data, length},
 						       error);
-		if (data == nullptr) {
+		if (result.IsNull()) {
 			/* the PCM conversion has failed - stop
 			   playback, since we have no better way to
 			   bail out */
@@ -503,25 +674,9 @@ decoder_data(Decoder &decoder,
 	}
 
 	while (length > 0) {
-		MusicChunk *chunk;
-		bool full;
-
-		chunk = decoder.GetChunk();
-		if (chunk == nullptr) {
-			assert(dc.command != DecoderCommand::NONE);
+		const auto dest = decoder_get_chunk_space(decoder, kbit_rate);
+		if (dest.IsNull())
 			return dc.command;
-		}
-
-		const auto dest =
-			chunk->Write(dc.out_audio_format,
-				     SongTime::FromS(decoder.timestamp) -
-				     dc.song->GetStartTime(),
-				     kbit_rate);
-		if (dest.IsEmpty()) {
-			/* the chunk is full, flush it */
-			decoder.FlushChunk();
-			continue;
-		}
 
 		const size_t nbytes = std::min(dest.size, length);
 
@@ -529,30 +684,45 @@ decoder_data(Decoder &decoder,
 
 		memcpy(dest.data, data, nbytes);
 
-		/* expand the music pipe chunk */
-
-		full = chunk->Expand(dc.out_audio_format, nbytes);
-		if (full) {
-			/* the chunk is full, flush it */
-			decoder.FlushChunk();
-		}
+		cmd = decoder_expand_chunk(decoder, nbytes);
+		if (cmd != DecoderCommand::NONE)
+			return cmd;
 
 		data = (const uint8_t *)data + nbytes;
 		length -= nbytes;
-
-		decoder.timestamp += (double)nbytes /
-			dc.out_audio_format.GetTimeToSize();
-
-		if (dc.end_time.IsPositive() &&
-		    decoder.timestamp >= dc.end_time.ToDoubleS())
-			/* the end of this range has been reached:
-			   stop decoding */
-			return DecoderCommand::STOP;
 	}
 
 	return DecoderCommand::NONE;
 }
 
+WritableBuffer<void>
+decoder_write_begin(Decoder &decoder, InputStream *is, uint16_t kbit_rate)
+{
+	if (decoder.convert != nullptr)
+		/* the data needs to be converted; the plugin must
+		   use decoder_data() */
+		return nullptr;
+
+	assert(decoder.dc.in_audio_format == decoder.dc.out_audio_format);
+
+	if (decoder_prepare_data(decoder, is) != DecoderCommand::NONE)
+		return nullptr;
+
+	return decoder_get_chunk_space(decoder, kbit_rate);
+}
+
+DecoderCommand
+decoder_write_commit(Decoder &decoder, size_t length)
+{
+	assert(decoder.convert == nullptr);
+	assert(length % decoder.dc.out_audio_format.GetFrameSize() == 0);
+
+	if (length == 0)
+		return DecoderCommand::NONE;
+
+	return decoder_expand_chunk(decoder, length);
+}
+
 DecoderCommand
 decoder_tag(Decoder &decoder, InputStream *is,
 	    Tag &&tag)
@@ -637,5 +807,11 @@ decoder_mixramp(Decoder &decoder, MixRampInfo &&mix_ramp)
 {
 	DecoderControl &dc = decoder.dc;
 
+	if (!mix_ramp.IsDefined())
+		/* keep the values measured by the loudness
+		   analysis; CycleMixRamp() has cleared the old ones
+		   already */
+		return;
+
 	dc.SetMixRamp(std::move(mix_ramp));
 }
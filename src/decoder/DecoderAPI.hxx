@@ -38,6 +38,8 @@
 #include "MixRampInfo.hxx"
 #include "config/Block.hxx"
 #include "Chrono.hxx"
+#include "util/WritableBuffer.hxx"
+#include "util/ConstBuffer.hxx"
 
 // IWYU pragma: end_exports
 
@@ -140,6 +142,19 @@ decoder_read(Decoder &decoder, InputStream &is,
 	return decoder_read(&decoder, is, buffer, length);
 }
 
+/**
+ * Blocking "peek" from the input stream: wait until data is
+ * available, and return it without copying (see
+ * InputStream::Peek()).  Call InputStream::Consume() with the mutex
+ * locked to discard it.  The stream must support peeking.
+ *
+ * @param decoder the decoder object, may be nullptr
+ * @return the data, or an empty buffer if one of the following
+ * occurs: end of file; error; command (like SEEK or STOP).
+ */
+ConstBuffer<void>
+decoder_peek(Decoder *decoder, InputStream &is);
+
 /**
  * Blocking read from the input stream.  Attempts to fill the buffer
  * completely; there is no partial result.
@@ -193,6 +208,47 @@ decoder_data(Decoder &decoder, InputStream &is,
 	return decoder_data(decoder, &is, data, length, kbit_rate);
 }
 
+/**
+ * Obtain a buffer inside the music pipe, so the decoder plugin can
+ * decode directly into it, avoiding the copy done by decoder_data().
+ * After writing to the buffer, call decoder_write_commit().  The
+ * buffer may be smaller than what the plugin has to write; then it
+ * can commit the first portion and call this function again.  If
+ * the plugin decides not to use the buffer, it may simply not commit
+ * it.
+ *
+ * This is only possible if no PCM conversion is necessary.
+ *
+ * @param decoder the decoder object
+ * @param is an input stream which is buffering while we are waiting
+ * for the player
+ * @return a buffer (whole frames in the audio format passed to
+ * decoder_initialized()), or nullptr if data cannot be written in
+ * place now (a command is pending or the data needs to be
+ * converted); in that case, the plugin should fall back to
+ * decoder_data(), which also returns the pending command
+ */
+WritableBuffer<void>
+decoder_write_begin(Decoder &decoder, InputStream *is, uint16_t kbit_rate);
+
+static inline WritableBuffer<void>
+decoder_write_begin(Decoder &decoder, InputStream &is, uint16_t kbit_rate)
+{
+	return decoder_write_begin(decoder, &is, kbit_rate);
+}
+
+/**
+ * Submit data which was written into the buffer returned by
+ * decoder_write_begin().
+ *
+ * @param length the number of bytes which were written (whole
+ * frames, not more than the buffer size)
+ * @return the current command, or DecoderCommand::NONE if there is no
+ * command pending
+ */
+DecoderCommand
+decoder_write_commit(Decoder &decoder, size_t length);
+
 /**
  * This function is called by the decoder plugin when it has
  * successfully decoded a tag.
@@ -20,17 +20,72 @@
 #include "config.h"
 #include "DecoderBuffer.hxx"
 #include "DecoderAPI.hxx"
+#include "input/InputStream.hxx"
+
+#include <algorithm>
 
 #include <assert.h>
+#include <string.h>
+
+DecoderBuffer::DecoderBuffer(Decoder *_decoder, InputStream &_is,
+			     size_t _size)
+	:decoder(_decoder), is(_is), peek(is.SupportsPeek()),
+	 buffer(_size), direct(nullptr) {}
+
+void
+DecoderBuffer::ConsumeDirect(size_t nbytes)
+{
+	assert(nbytes <= direct.size);
+
+	if (nbytes == 0)
+		return;
+
+	direct.skip_front(nbytes);
+
+	const ScopeLock protect(is.mutex);
+	is.Consume(nbytes);
+}
+
+void
+DecoderBuffer::Clear()
+{
+	buffer.Clear();
+	ConsumeDirect(direct.size);
+	direct = nullptr;
+}
+
+offset_type
+DecoderBuffer::GetOffset() const
+{
+	/* the data in #direct has not been consumed from the stream
+	   yet, therefore only #buffer needs to be subtracted */
+	return is.GetOffset() - buffer.GetAvailable();
+}
 
 bool
 DecoderBuffer::Fill()
 {
+	if (peek && buffer.IsEmpty() && direct.IsEmpty()) {
+		direct = ConstBuffer<uint8_t>::FromVoid(decoder_peek(decoder,
+								     is));
+		return !direct.IsEmpty();
+	}
+
 	auto w = buffer.Write();
 	if (w.IsEmpty())
 		/* buffer is full */
 		return false;
 
+	if (!direct.IsEmpty()) {
+		/* the caller needs more contiguous data than the
+		   stream's buffer provides: fall back to copying */
+		const size_t nbytes = std::min(w.size, direct.size);
+		memcpy(w.data, direct.data, nbytes);
+		buffer.Append(nbytes);
+		ConsumeDirect(nbytes);
+		return true;
+	}
+
 	size_t nbytes = decoder_read(decoder, is,
 				     w.data, w.size);
 	if (nbytes == 0)
@@ -67,5 +122,13 @@ DecoderBuffer::Skip(size_t nbytes)
 	buffer.Clear();
 	nbytes -= r.size;
 
+	if (direct.size >= nbytes) {
+		ConsumeDirect(nbytes);
+		return true;
+	}
+
+	nbytes -= direct.size;
+	ConsumeDirect(direct.size);
+
 	return decoder_skip(decoder, is, nbytes);
 }
@@ -23,6 +23,7 @@
 #include "Compiler.h"
 #include "util/DynamicFifoBuffer.hxx"
 #include "util/ConstBuffer.hxx"
+#include "input/Offset.hxx"
 
 #include <stddef.h>
 
@@ -33,13 +34,30 @@ class InputStream;
  * This objects handles buffered reads in decoder plugins easily.  You
  * create a buffer object, and use its high-level methods to fill and
  * read it.  It will automatically handle shifting the buffer.
+ *
+ * If the #InputStream supports InputStream::Peek(), the data is
+ * parsed directly inside the stream's buffer; it is only copied into
+ * our own buffer if the caller needs more contiguous data than the
+ * stream can provide (e.g. at the wraparound point of its ring
+ * buffer).
  */
 class DecoderBuffer {
 	Decoder *const decoder;
 	InputStream &is;
 
+	/**
+	 * Does #is support InputStream::Peek()?
+	 */
+	const bool peek;
+
 	DynamicFifoBuffer<uint8_t> buffer;
 
+	/**
+	 * Data inside the stream's buffer which follows the contents
+	 * of #buffer.  It has not yet been consumed from the stream.
+	 */
+	ConstBuffer<uint8_t> direct;
+
 public:
 	/**
 	 * Creates a new buffer.
@@ -50,16 +68,17 @@ public:
 	 * @param _size the maximum size of the buffer
 	 */
 	DecoderBuffer(Decoder *_decoder, InputStream &_is,
-		      size_t _size)
-		:decoder(_decoder), is(_is), buffer(_size) {}
+		      size_t _size);
 
 	const InputStream &GetStream() const {
 		return is;
 	}
 
-	void Clear() {
-		buffer.Clear();
-	}
+	/**
+	 * Discard all data.  If the stream is going to be seeked,
+	 * call this method before InputStream::Seek().
+	 */
+	void Clear();
 
 	/**
 	 * Read data from the #InputStream and append it to the buffer.
@@ -75,9 +94,16 @@ public:
 	 */
 	gcc_pure
 	size_t GetAvailable() const {
-		return buffer.GetAvailable();
+		return buffer.GetAvailable() + direct.size;
 	}
 
+	/**
+	 * Returns the stream offset of the first byte returned by
+	 * Read().
+	 */
+	gcc_pure
+	offset_type GetOffset() const;
+
 	/**
 	 * Reads data from the buffer.  This data is not yet consumed,
 	 * you have to call Consume() to do that.  The returned buffer
@@ -85,6 +111,9 @@ public:
 	 */
 	ConstBuffer<void> Read() const {
 		auto r = buffer.Read();
+		if (r.IsEmpty())
+			return direct.ToVoid();
+
 		return { r.data, r.size };
 	}
 
@@ -102,7 +131,10 @@ public:
 	 * @param nbytes the number of bytes to consume
 	 */
 	void Consume(size_t nbytes) {
-		buffer.Consume(nbytes);
+		if (!buffer.IsEmpty())
+			buffer.Consume(nbytes);
+		else
+			ConsumeDirect(nbytes);
 	}
 
 	/**
@@ -112,6 +144,9 @@ public:
 	 * @return true on success, false on error
 	 */
 	bool Skip(size_t nbytes);
+
+private:
+	void ConsumeDirect(size_t nbytes);
 };
 
 #endif
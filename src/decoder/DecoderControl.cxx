@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "DecoderControl.hxx"
+#include "DecoderThread.hxx"
 #include "MusicPipe.hxx"
 #include "DetachedSong.hxx"
 
@@ -28,17 +29,34 @@ DecoderControl::DecoderControl(Mutex &_mutex, Cond &_client_cond)
 	:mutex(_mutex), client_cond(_client_cond),
 	 state(DecoderState::STOP),
 	 command(DecoderCommand::NONE),
+	 running(false), background(false),
 	 client_is_waiting(false),
 	 song(nullptr),
-	 replay_gain_db(0), replay_gain_prev_db(0) {}
+	 replay_gain_db(0), replay_gain_prev_db(0),
+	 lookahead(_mutex, cond) {
+	statistics.Clear();
+}
 
 DecoderControl::~DecoderControl()
 {
+	assert(!running);
+
 	ClearError();
 
 	delete song;
 }
 
+void
+DecoderControl::Signal()
+{
+	if (running)
+		cond.signal();
+	else if (command != DecoderCommand::NONE) {
+		running = true;
+		decoder_thread_start(*this);
+	}
+}
+
 void
 DecoderControl::WaitForDecoder()
 {
@@ -123,12 +141,19 @@ DecoderControl::Seek(SongTime t)
 void
 DecoderControl::Quit()
 {
-	assert(thread.IsDefined());
+	Lock();
+
+	if (running) {
+		command = DecoderCommand::STOP;
+		Signal();
 
-	quit = true;
-	LockAsynchronousCommand(DecoderCommand::STOP);
+		while (running)
+			WaitForDecoder();
+	}
+
+	Unlock();
 
-	thread.Join();
+	lookahead.Cancel();
 }
 
 void
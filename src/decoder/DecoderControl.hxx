@@ -21,11 +21,12 @@
 #define MPD_DECODER_CONTROL_HXX
 
 #include "DecoderCommand.hxx"
+#include "DecoderLookahead.hxx"
+#include "DecoderStatistics.hxx"
 #include "AudioFormat.hxx"
 #include "MixRampInfo.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
-#include "thread/Thread.hxx"
 #include "Chrono.hxx"
 #include "util/Error.hxx"
 
@@ -56,11 +57,6 @@ enum class DecoderState : uint8_t {
 };
 
 struct DecoderControl {
-	/**
-	 * The handle of the decoder thread.
-	 */
-	Thread thread;
-
 	/**
 	 * This lock protects #state and #command.
 	 *
@@ -97,7 +93,21 @@ struct DecoderControl {
 	 */
 	Error error;
 
-	bool quit;
+	/**
+	 * Is a thread of the decoder pool currently serving this
+	 * object?  It is submitted to the pool when a command is sent
+	 * while this is false, and the thread clears it when the
+	 * decoder has become idle.
+	 */
+	bool running;
+
+	/**
+	 * Is this a background decoder, which does not feed the
+	 * player, e.g. for the loudness analysis?  It is served by a
+	 * thread running at idle priority, after all foreground
+	 * decoders.  This must be set before the first command.
+	 */
+	bool background;
 
 	/**
 	 * Is the client currently waiting for the DecoderThread?  If
@@ -158,6 +168,20 @@ struct DecoderControl {
 
 	MixRampInfo mix_ramp, previous_mix_ramp;
 
+	/**
+	 * Opens the next song's input stream while the current one
+	 * is being decoded.
+	 */
+	DecoderLookahead lookahead;
+
+	/**
+	 * Instrumentation of the current song, published by the
+	 * decoder thread from time to time.
+	 *
+	 * This attribute is protected by #mutex.
+	 */
+	DecoderStatistics statistics;
+
 	/**
 	 * @param _mutex see #mutex
 	 * @param _client_cond see #client_cond
@@ -180,13 +204,12 @@ struct DecoderControl {
 	}
 
 	/**
-	 * Signals the object.  This function is only valid in the
-	 * player thread.  The object should be locked prior to
-	 * calling this function.
+	 * Signals the object.  If no decoder thread is serving it and
+	 * there is a command, one is obtained from the decoder pool.
+	 * This function is only valid in the player thread.  The
+	 * object should be locked prior to calling this function.
 	 */
-	void Signal() {
-		cond.signal();
-	}
+	void Signal();
 
 	/**
 	 * Waits for a signal on the #DecoderControl object.  This function
@@ -342,13 +365,6 @@ private:
 		Unlock();
 	}
 
-	void LockAsynchronousCommand(DecoderCommand cmd) {
-		Lock();
-		command = cmd;
-		Signal();
-		Unlock();
-	}
-
 public:
 	/**
 	 * Start the decoder.
@@ -367,6 +383,10 @@ public:
 
 	bool Seek(SongTime t);
 
+	/**
+	 * Stop the decoder and wait until no thread is serving this
+	 * object anymore.  Call this before destructing it.
+	 */
 	void Quit();
 
 	const char *GetMixRampStart() const {
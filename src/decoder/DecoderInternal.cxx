@@ -25,6 +25,7 @@
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
 #include "tag/Tag.hxx"
+#include "system/Clock.hxx"
 
 #include <assert.h>
 
@@ -67,6 +68,9 @@ Decoder::GetChunk()
 	do {
 		chunk = dc.buffer->Allocate();
 		if (chunk != nullptr) {
+			if (chunk_limit > 0)
+				chunk->SetLimit(chunk_limit);
+
 			chunk->replay_gain_serial = replay_gain_serial;
 			if (replay_gain_serial != 0)
 				chunk->replay_gain_info = replay_gain_info;
@@ -74,9 +78,13 @@ Decoder::GetChunk()
 			return chunk;
 		}
 
+		const uint64_t wait_start = MonotonicClockUS();
+
 		dc.Lock();
 		cmd = need_chunks(dc);
 		dc.Unlock();
+
+		statistics.buffer_wait_time += MonotonicClockUS() - wait_start;
 	} while (cmd == DecoderCommand::NONE);
 
 	return nullptr;
@@ -98,7 +106,30 @@ Decoder::FlushChunk()
 	chunk = nullptr;
 
 	dc.Lock();
+	PublishStatistics();
 	if (dc.client_is_waiting)
 		dc.client_cond.signal();
 	dc.Unlock();
 }
+
+void
+Decoder::StartStatistics()
+{
+	statistics.Clear();
+	start_time_us = MonotonicClockUS();
+	start_cpu_time_us = ThreadCpuTimeUS();
+}
+
+void
+Decoder::PublishStatistics()
+{
+	statistics.audio_format = dc.out_audio_format;
+	statistics.run_time = MonotonicClockUS() - start_time_us;
+
+	const uint64_t cpu_time = ThreadCpuTimeUS();
+	statistics.cpu_time = cpu_time > 0
+		? cpu_time - start_cpu_time_us
+		: 0;
+
+	dc.statistics = statistics;
+}
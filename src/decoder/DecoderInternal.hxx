@@ -21,6 +21,7 @@
 #define MPD_DECODER_INTERNAL_HXX
 
 #include "ReplayGainInfo.hxx"
+#include "DecoderStatistics.hxx"
 #include "util/Error.hxx"
 
 class PcmConvert;
@@ -79,6 +80,13 @@ struct Decoder {
 	/** the chunk currently being written to */
 	MusicChunk *chunk;
 
+	/**
+	 * The number of bytes to be filled in each chunk, depending
+	 * on the output audio format (see CalcChunkLimit()).  0
+	 * means the whole chunk.
+	 */
+	size_t chunk_limit;
+
 	ReplayGainInfo replay_gain_info;
 
 	/**
@@ -93,6 +101,19 @@ struct Decoder {
 	 */
 	Error error;
 
+	/**
+	 * Instrumentation of this song, updated by the decoder thread
+	 * without holding the lock; it is copied to
+	 * DecoderControl::statistics by PublishStatistics().
+	 */
+	DecoderStatistics statistics;
+
+	/**
+	 * MonotonicClockUS() and ThreadCpuTimeUS() when decoding
+	 * was started.
+	 */
+	uint64_t start_time_us, start_cpu_time_us;
+
 	Decoder(DecoderControl &_dc, bool _initial_seek_pending, Tag *_tag)
 		:dc(_dc),
 		 convert(nullptr),
@@ -101,8 +122,9 @@ struct Decoder {
 		 initial_seek_running(false),
 		 seeking(false),
 		 song_tag(_tag), stream_tag(nullptr), decoder_tag(nullptr),
-		 chunk(nullptr),
+		 chunk(nullptr), chunk_limit(0),
 		 replay_gain_serial(0) {
+		StartStatistics();
 	}
 
 	~Decoder();
@@ -121,6 +143,19 @@ struct Decoder {
 	 * Caller must not lock the #DecoderControl object.
 	 */
 	void FlushChunk();
+
+	/**
+	 * Reset the statistics and start the clocks.
+	 */
+	void StartStatistics();
+
+	/**
+	 * Update the clocks in #statistics and copy it to
+	 * DecoderControl::statistics.
+	 *
+	 * Caller must lock the #DecoderControl object.
+	 */
+	void PublishStatistics();
 };
 
 #endif
@@ -44,8 +44,13 @@
 #include "plugins/FluidsynthDecoderPlugin.hxx"
 #include "plugins/SidplayDecoderPlugin.hxx"
 #include "util/Macros.hxx"
+#include "util/StringUtil.hxx"
 
+#include <string>
+
+#include <assert.h>
 #include <string.h>
+#include <strings.h>
 
 const struct DecoderPlugin *const decoder_plugins[] = {
 #ifdef ENABLE_MAD
@@ -117,6 +122,58 @@ static constexpr unsigned num_decoder_plugins =
 /** which plugins have been initialized successfully? */
 bool decoder_plugins_enabled[num_decoder_plugins];
 
+bool decoder_plugins_have_preferences;
+
+/**
+ * Comma separated lists of file name suffixes and MIME types for
+ * which the plugin shall be tried before all others; configured
+ * with "prefer_suffix" and "prefer_mime_type".
+ */
+static std::string decoder_prefer_suffixes[num_decoder_plugins];
+static std::string decoder_prefer_mime_types[num_decoder_plugins];
+
+/**
+ * Does the comma separated list contain the specified string
+ * (case-insensitive)?  Whitespace around list items is ignored.
+ */
+gcc_pure
+static bool
+StringListContainsCase(const std::string &list, const char *s)
+{
+	const size_t length = strlen(s);
+
+	const char *p = list.c_str();
+	while (true) {
+		p = StripLeft(p);
+
+		const char *comma = strchr(p, ',');
+		const char *end = comma != nullptr ? comma : p + strlen(p);
+		const char *item_end = StripRight(p, end);
+
+		if (size_t(item_end - p) == length &&
+		    strncasecmp(p, s, length) == 0)
+			return true;
+
+		if (comma == nullptr)
+			return false;
+
+		p = comma + 1;
+	}
+}
+
+bool
+decoder_plugin_is_preferred(unsigned i, const char *suffix,
+			    const char *mime_type)
+{
+	assert(i < num_decoder_plugins);
+
+	return (suffix != nullptr &&
+		StringListContainsCase(decoder_prefer_suffixes[i], suffix)) ||
+		(mime_type != nullptr &&
+		 StringListContainsCase(decoder_prefer_mime_types[i],
+					mime_type));
+}
+
 const struct DecoderPlugin *
 decoder_plugin_from_name(const char *name)
 {
@@ -141,8 +198,22 @@ void decoder_plugin_init_all(void)
 			/* the plugin is disabled in mpd.conf */
 			continue;
 
-		if (plugin.Init(*param))
-			decoder_plugins_enabled[i] = true;
+		if (!plugin.Init(*param))
+			continue;
+
+		decoder_plugins_enabled[i] = true;
+
+		const char *value = param->GetBlockValue("prefer_suffix");
+		if (value != nullptr) {
+			decoder_prefer_suffixes[i] = value;
+			decoder_plugins_have_preferences = true;
+		}
+
+		value = param->GetBlockValue("prefer_mime_type");
+		if (value != nullptr) {
+			decoder_prefer_mime_types[i] = value;
+			decoder_plugins_have_preferences = true;
+		}
 	}
 }
 
@@ -151,6 +222,13 @@ void decoder_plugin_deinit_all(void)
 	decoder_plugins_for_each_enabled([=](const DecoderPlugin &plugin){
 			plugin.Finish();
 		});
+
+	for (unsigned i = 0; i < num_decoder_plugins; ++i) {
+		decoder_prefer_suffixes[i].clear();
+		decoder_prefer_mime_types[i].clear();
+	}
+
+	decoder_plugins_have_preferences = false;
 }
 
 bool
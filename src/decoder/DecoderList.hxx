@@ -63,6 +63,50 @@ decoder_plugins_try(F f)
 	return false;
 }
 
+/**
+ * Is at least one plugin configured with "prefer_suffix" or
+ * "prefer_mime_type"?
+ */
+extern bool decoder_plugins_have_preferences;
+
+/**
+ * Was the plugin with the specified index configured to be preferred
+ * for this file name suffix or MIME type?  Both may be nullptr.
+ */
+gcc_pure
+bool
+decoder_plugin_is_preferred(unsigned i, const char *suffix,
+			    const char *mime_type);
+
+/**
+ * Like decoder_plugins_try(), but first try the plugins which are
+ * configured to be preferred for the specified file name suffix or
+ * MIME type (see decoder_plugin_is_preferred()).  The function is
+ * still responsible for checking whether the plugin supports the
+ * format.
+ */
+template<typename F>
+static inline bool
+decoder_plugins_try_format(const char *suffix, const char *mime_type, F f)
+{
+	if (!decoder_plugins_have_preferences)
+		return decoder_plugins_try(f);
+
+	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i)
+		if (decoder_plugins_enabled[i] &&
+		    decoder_plugin_is_preferred(i, suffix, mime_type) &&
+		    f(*decoder_plugins[i]))
+			return true;
+
+	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i)
+		if (decoder_plugins_enabled[i] &&
+		    !decoder_plugin_is_preferred(i, suffix, mime_type) &&
+		    f(*decoder_plugins[i]))
+			return true;
+
+	return false;
+}
+
 template<typename F>
 static inline void
 decoder_plugins_for_each(F f)
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DecoderLookahead.hxx"
+#include "DecoderError.hxx"
+#include "input/InputStream.hxx"
+#include "fs/Traits.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "system/FileDescriptor.hxx"
+#include "thread/Name.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+/**
+ * The number of bytes at the beginning of a local file which are
+ * loaded into the page cache in advance.
+ */
+static constexpr off_t LOCAL_PREFETCH_SIZE = 4 * 1024 * 1024;
+
+/**
+ * Ask the kernel to load the beginning of the local file into the
+ * page cache asynchronously, so a spinning disk does not delay the
+ * next song.
+ */
+static void
+PrefetchLocalFile(const char *uri)
+{
+#ifndef WIN32
+	const auto path = AllocatedPath::FromUTF8(uri, IgnoreError());
+	if (path.IsNull())
+		return;
+
+	FileDescriptor fd;
+	if (fd.OpenReadOnly(path.c_str())) {
+		fd.AdviseWillNeed(0, LOCAL_PREFETCH_SIZE);
+		fd.Close();
+	}
+#else
+	(void)uri;
+#endif
+}
+
+InputStream *
+DecoderLookahead::JoinLocked()
+{
+	if (!thread.IsDefined())
+		return nullptr;
+
+	thread.Join();
+
+	InputStream *result = is;
+	is = nullptr;
+	return result;
+}
+
+void
+DecoderLookahead::Start(const char *_uri)
+{
+	if (PathTraitsUTF8::IsAbsolute(_uri)) {
+		/* local files open quickly, no thread needed */
+		PrefetchLocalFile(_uri);
+		return;
+	}
+
+	const ScopeLock protect(mutex);
+
+	delete JoinLocked();
+
+	uri = _uri;
+
+	Error error;
+	if (!thread.Start(ThreadFunc, this, error))
+		LogError(error);
+}
+
+void
+DecoderLookahead::Cancel()
+{
+	const ScopeLock protect(mutex);
+
+	delete JoinLocked();
+}
+
+InputStream *
+DecoderLookahead::Take(const char *_uri)
+{
+	const ScopeLock protect(mutex);
+
+	InputStream *result = JoinLocked();
+	if (result != nullptr && uri != _uri) {
+		/* this lookahead was for a different song */
+		delete result;
+		result = nullptr;
+	}
+
+	if (result != nullptr)
+		FormatDebug(decoder_domain, "using lookahead stream for %s",
+			    _uri);
+
+	return result;
+}
+
+inline void
+DecoderLookahead::Run()
+{
+	/* errors are ignored here; the decoder thread will try
+	   again and report them */
+	Error error;
+	is = InputStream::Open(uri.c_str(), stream_mutex, stream_cond,
+			       error);
+}
+
+void
+DecoderLookahead::ThreadFunc(void *ctx)
+{
+	DecoderLookahead &lookahead = *(DecoderLookahead *)ctx;
+
+	SetThreadName("lookahead");
+
+	lookahead.Run();
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DECODER_LOOKAHEAD_HXX
+#define MPD_DECODER_LOOKAHEAD_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "thread/Thread.hxx"
+
+#include <string>
+
+class InputStream;
+class Cond;
+
+/**
+ * Opens the #InputStream of the next song in a separate thread,
+ * while the decoder thread is still busy with the current song.
+ * Remote streams (HTTP, NFS, SMB, ...) then connect and fill their
+ * own buffer in parallel, and a slow server does not delay the
+ * beginning of the next song.
+ *
+ * The stream is opened with the mutex and the condition of the
+ * #DecoderControl, so the decoder thread can take it over with
+ * Take().  For local files, the kernel is only asked to load their
+ * beginning into the page cache.
+ */
+class DecoderLookahead {
+	Mutex &stream_mutex;
+	Cond &stream_cond;
+
+	/**
+	 * Serializes the public methods, which may be called by the
+	 * player thread and by the decoder thread.
+	 */
+	Mutex mutex;
+
+	Thread thread;
+
+	std::string uri;
+
+	/**
+	 * The stream opened by the thread.  Only accessed after the
+	 * thread has been joined.
+	 */
+	InputStream *is;
+
+public:
+	DecoderLookahead(Mutex &_stream_mutex, Cond &_stream_cond)
+		:stream_mutex(_stream_mutex), stream_cond(_stream_cond),
+		 is(nullptr) {}
+
+	~DecoderLookahead() {
+		Cancel();
+	}
+
+	DecoderLookahead(const DecoderLookahead &) = delete;
+	DecoderLookahead &operator=(const DecoderLookahead &) = delete;
+
+	/**
+	 * Start opening the specified URI, replacing the previous
+	 * one.  Local files are only prefetched into the page cache.
+	 *
+	 * The caller must not hold the #DecoderControl lock.
+	 */
+	void Start(const char *uri);
+
+	/**
+	 * Cancel the lookahead and close its stream.
+	 *
+	 * The caller must not hold the #DecoderControl lock.
+	 */
+	void Cancel();
+
+	/**
+	 * Take over the stream if it was opened for the specified
+	 * URI; a lookahead for a different URI is canceled.  This
+	 * waits for InputStream::Open() to finish, but not for the
+	 * stream to become ready.
+	 *
+	 * The caller must not hold the #DecoderControl lock.
+	 *
+	 * @return the stream or nullptr if there is none for this
+	 * URI (the caller must open it then)
+	 */
+	InputStream *Take(const char *uri);
+
+private:
+	/**
+	 * Wait for the thread and return its result.  Caller must
+	 * hold #mutex.
+	 */
+	InputStream *JoinLocked();
+
+	void Run();
+	static void ThreadFunc(void *ctx);
+};
+
+#endif
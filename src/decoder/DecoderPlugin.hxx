@@ -22,10 +22,13 @@
 
 #include "Compiler.h"
 
+#include <forward_list>
+
 struct ConfigBlock;
 class InputStream;
 struct tag_handler;
 class Path;
+struct ContainerTrack;
 
 /**
  * Opaque handle which the decoder plugin passes to the functions in
@@ -87,18 +90,15 @@ struct DecoderPlugin {
 			    void *handler_ctx);
 
 	/**
-	 * @brief Return a "virtual" filename for subtracks in
-	 * container formats like flac
-	 * @param const char* pathname full pathname for the file on fs
-	 * @param const unsigned int tnum track number
-	 *
-	 * @return nullptr if there are no multiple files
-	 * a filename for every single track according to tnum (param 2)
-	 * do not include full pathname here, just the "virtual" file
+	 * Enumerate the "virtual" tracks of a container file (e.g.
+	 * the sub-tunes of a chiptune file) and scan their metadata,
+	 * all while the file is opened only once.
 	 *
-	 * Free the return value with delete[].
+	 * @return the tracks in playing order; an empty list if the
+	 * file is not a container (e.g. if it contains only one
+	 * track) or if it could not be read
 	 */
-	char* (*container_scan)(Path path_fs, const unsigned int tnum);
+	std::forward_list<ContainerTrack> (*container_scan)(Path path_fs);
 
 	/* last element in these arrays must always be a nullptr: */
 	const char *const*suffixes;
@@ -162,11 +162,11 @@ struct DecoderPlugin {
 	}
 
 	/**
-	 * return "virtual" tracks in a container
+	 * Return the "virtual" tracks in a container.
 	 */
 	template<typename P>
-	char *ContainerScan(P path, const unsigned int tnum) const {
-		return container_scan(path, tnum);
+	std::forward_list<ContainerTrack> ContainerScan(P path) const {
+		return container_scan(path);
 	}
 
 	/**
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DecoderPool.hxx"
+#include "DecoderControl.hxx"
+#include "ThreadConfig.hxx"
+#include "system/FatalError.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "util/Error.hxx"
+
+#include <assert.h>
+
+DecoderPool::~DecoderPool()
+{
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (auto &worker : workers)
+		worker.thread.Join();
+
+	assert(queue.empty());
+}
+
+void
+DecoderPool::Submit(DecoderControl &dc)
+{
+	const ScopeLock protect(mutex);
+
+	Reap();
+	Enqueue(dc);
+
+	bool launch;
+	if (dc.background)
+		launch = n_idle == 0 && n_threads < max_threads;
+	else
+		/* never let a foreground decoder wait for another
+		   one to finish */
+		launch = n_queued_foreground > n_idle_foreground;
+
+	if (launch) {
+		Error error;
+		if (!Launch(error))
+			FatalError(error);
+	} else
+		cond.broadcast();
+}
+
+void
+DecoderPool::Enqueue(DecoderControl &dc)
+{
+	if (dc.background) {
+		queue.push_back(&dc);
+		return;
+	}
+
+	auto i = queue.begin();
+	while (i != queue.end() && !(*i)->background)
+		++i;
+
+	queue.insert(i, &dc);
+	++n_queued_foreground;
+}
+
+bool
+DecoderPool::Launch(Error &error)
+{
+	workers.emplace_back(*this);
+	if (!workers.back().thread.Start(Worker::Run, &workers.back(),
+					 error)) {
+		workers.pop_back();
+		return false;
+	}
+
+	++n_threads;
+	return true;
+}
+
+void
+DecoderPool::Reap()
+{
+	for (auto i = workers.begin(); i != workers.end();) {
+		if (i->finished) {
+			i->thread.Join();
+			i = workers.erase(i);
+		} else
+			++i;
+	}
+}
+
+DecoderControl *
+DecoderPool::Pop(const Worker &worker)
+{
+	for (auto i = queue.begin(); i != queue.end(); ++i) {
+		DecoderControl *dc = *i;
+		if (!worker.CanServe(*dc) ||
+		    (dc->background && n_background >= max_threads))
+			continue;
+
+		queue.erase(i);
+		if (!dc->background)
+			--n_queued_foreground;
+		return dc;
+	}
+
+	return nullptr;
+}
+
+inline bool
+DecoderPool::Worker::CanServe(const DecoderControl &dc) const
+{
+	return !background || dc.background;
+}
+
+inline void
+DecoderPool::Worker::Run()
+{
+	SetThreadName("decoder");
+	ApplyThreadConfig("decoder");
+
+	const ScopeLock protect(pool.mutex);
+
+	while (true) {
+		DecoderControl *dc = pool.Pop(*this);
+		if (dc == nullptr) {
+			if (pool.quit || pool.n_threads > pool.max_threads)
+				break;
+
+			++pool.n_idle;
+			if (!background)
+				++pool.n_idle_foreground;
+
+			pool.cond.wait(pool.mutex);
+
+			--pool.n_idle;
+			if (!background)
+				--pool.n_idle_foreground;
+			continue;
+		}
+
+		/* the object may be freed as soon as it has been
+		   served */
+		const bool dc_background = dc->background;
+		if (dc_background) {
+			++pool.n_background;
+
+			if (!background) {
+				background = true;
+
+				pool.mutex.unlock();
+				SetThreadIdlePriority();
+				ApplyThreadConfig("loudness");
+				pool.mutex.lock();
+			}
+		}
+
+		pool.mutex.unlock();
+		pool.serve(*dc);
+		pool.mutex.lock();
+
+		if (dc_background)
+			--pool.n_background;
+	}
+
+	--pool.n_threads;
+	finished = true;
+}
+
+void
+DecoderPool::Worker::Run(void *ctx)
+{
+	Worker &worker = *(Worker *)ctx;
+	worker.Run();
+}
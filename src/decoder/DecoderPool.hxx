@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DECODER_POOL_HXX
+#define MPD_DECODER_POOL_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <list>
+
+struct DecoderControl;
+class Error;
+
+/**
+ * A pool of threads which serve #DecoderControl objects on demand.
+ * A #DecoderControl gets a thread only while it has a command to
+ * execute or a song to decode; idle decoders (e.g. of stopped
+ * partitions) do not occupy a thread.
+ *
+ * Decoder plugins block, therefore a foreground decoder (one which
+ * feeds a player) never waits for a thread: if none is idle, a new
+ * one is launched.  Background decoders (e.g. the loudness analysis)
+ * are queued behind foreground decoders and are limited to
+ * #max_threads.  A thread which has served a background decoder
+ * runs at idle priority and serves only background decoders after
+ * that.  Idle threads beyond #max_threads exit.
+ */
+class DecoderPool {
+	struct Worker {
+		DecoderPool &pool;
+
+		Thread thread;
+
+		/**
+		 * Has this thread served a background decoder?  Its
+		 * priority has been lowered, which cannot be undone.
+		 */
+		bool background = false;
+
+		/**
+		 * Has this thread finished?  It needs to be joined.
+		 */
+		bool finished = false;
+
+		explicit Worker(DecoderPool &_pool):pool(_pool) {}
+
+		/**
+		 * May this thread serve the specified decoder?
+		 */
+		bool CanServe(const DecoderControl &dc) const;
+
+		void Run();
+		static void Run(void *ctx);
+	};
+
+	/**
+	 * The function which executes the commands of a
+	 * #DecoderControl, until it becomes idle.
+	 */
+	void (*const serve)(DecoderControl &dc);
+
+	/**
+	 * The number of threads to keep; at most this number of
+	 * threads serve background decoders.
+	 */
+	const unsigned max_threads;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a decoder was submitted or when the pool
+	 * shall quit.
+	 */
+	Cond cond;
+
+	std::list<Worker> workers;
+
+	/**
+	 * Decoders waiting for a thread.  Foreground decoders are
+	 * before background decoders.
+	 */
+	std::list<DecoderControl *> queue;
+
+	/**
+	 * The number of threads in #workers which have not finished.
+	 */
+	unsigned n_threads = 0;
+
+	/**
+	 * The number of threads which wait for a decoder, and how
+	 * many of them are foreground threads.
+	 */
+	unsigned n_idle = 0, n_idle_foreground = 0;
+
+	/**
+	 * The number of foreground decoders in #queue.
+	 */
+	unsigned n_queued_foreground = 0;
+
+	/**
+	 * The number of background decoders being served.
+	 */
+	unsigned n_background = 0;
+
+	bool quit = false;
+
+public:
+	DecoderPool(void (*_serve)(DecoderControl &dc),
+		    unsigned _max_threads)
+		:serve(_serve), max_threads(_max_threads) {}
+
+	/**
+	 * All decoders must be idle.
+	 */
+	~DecoderPool();
+
+	DecoderPool(const DecoderPool &) = delete;
+	DecoderPool &operator=(const DecoderPool &) = delete;
+
+	/**
+	 * Let a thread invoke the serve function for the specified
+	 * decoder, which must not be served currently.  The caller
+	 * may hold the #DecoderControl's mutex.
+	 */
+	void Submit(DecoderControl &dc);
+
+private:
+	void Enqueue(DecoderControl &dc);
+
+	/**
+	 * Launch a new thread.  Caller must lock the mutex.
+	 *
+	 * @return false if the thread could not be created
+	 */
+	bool Launch(Error &error);
+
+	/**
+	 * Join and remove threads which have finished.  Caller must
+	 * lock the mutex.
+	 */
+	void Reap();
+
+	/**
+	 * Take the first queued decoder the specified thread may
+	 * serve.  Caller must lock the mutex.
+	 */
+	DecoderControl *Pop(const Worker &worker);
+};
+
+#endif
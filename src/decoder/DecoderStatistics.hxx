@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DECODER_STATISTICS_HXX
+#define MPD_DECODER_STATISTICS_HXX
+
+#include "AudioFormat.hxx"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Instrumentation of the decoder thread for one song.  All times are
+ * in microseconds.
+ */
+struct DecoderStatistics {
+	/**
+	 * The format of #decoded_bytes.
+	 */
+	AudioFormat audio_format;
+
+	/**
+	 * The number of PCM bytes (after conversion) which were
+	 * submitted to the #MusicPipe.
+	 */
+	uint64_t decoded_bytes;
+
+	/**
+	 * The wall-clock time since decoding was started.
+	 */
+	uint64_t run_time;
+
+	/**
+	 * The CPU time consumed by the decoder thread, or 0 if
+	 * unknown.
+	 */
+	uint64_t cpu_time;
+
+	/**
+	 * The time the decoder was blocked because all #MusicBuffer
+	 * chunks were in use, i.e. the #MusicPipe was full.
+	 */
+	uint64_t buffer_wait_time;
+
+	/**
+	 * The time the decoder was blocked waiting for data from the
+	 * #InputStream.
+	 */
+	uint64_t input_wait_time;
+
+	/**
+	 * The fill level of the #InputStream's read-ahead buffer
+	 * after the most recent read, and its current limit (in
+	 * bytes).  The limit is 0 if the stream has no such buffer.
+	 */
+	size_t input_buffered, input_buffer_limit;
+
+	void Clear() {
+		audio_format.Clear();
+		decoded_bytes = 0;
+		run_time = cpu_time = 0;
+		buffer_wait_time = input_wait_time = 0;
+		input_buffered = input_buffer_limit = 0;
+	}
+
+	/**
+	 * Returns the duration of the decoded audio data in
+	 * seconds.
+	 */
+	gcc_pure
+	double GetDecodedDuration() const {
+		return audio_format.IsValid()
+			? decoded_bytes / audio_format.GetTimeToSize()
+			: 0;
+	}
+
+	/**
+	 * Returns the decoder speed relative to real time, not
+	 * counting the time it was waiting for buffer space (which
+	 * means it was faster than necessary).  Returns 0 if
+	 * unknown.
+	 */
+	gcc_pure
+	double GetSpeed() const {
+		return run_time > buffer_wait_time
+			? GetDecodedDuration() * 1000000. /
+			(run_time - buffer_wait_time)
+			: 0;
+	}
+};
+
+#endif
@@ -19,28 +19,33 @@
 
 #include "config.h"
 #include "DecoderThread.hxx"
+#include "DecoderPool.hxx"
 #include "DecoderControl.hxx"
 #include "DecoderInternal.hxx"
 #include "DecoderError.hxx"
 #include "DecoderPlugin.hxx"
 #include "DetachedSong.hxx"
-#include "system/FatalError.hxx"
 #include "MusicPipe.hxx"
+#include "MusicBuffer.hxx"
 #include "fs/Traits.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "input/LocalOpen.hxx"
 #include "DecoderList.hxx"
+#include "ThreadConfig.hxx"
 #include "util/UriUtil.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "thread/Name.hxx"
 #include "tag/ApeReplayGain.hxx"
+#include "loudness/Table.hxx"
 #include "Log.hxx"
 
 #include <functional>
 
+#include <unistd.h>
+
 static constexpr Domain decoder_thread_domain("decoder_thread");
 
 /**
@@ -75,7 +80,10 @@ decoder_input_stream_open(DecoderControl &dc, const char *uri)
 {
 	Error error;
 
-	InputStream *is = InputStream::Open(uri, dc.mutex, dc.cond, error);
+	/* the stream may have been opened in advance */
+	InputStream *is = dc.lookahead.Take(uri);
+	if (is == nullptr)
+		is = InputStream::Open(uri, dc.mutex, dc.cond, error);
 	if (is == nullptr) {
 		if (error.IsDefined())
 			LogError(error);
@@ -244,7 +252,7 @@ decoder_run_stream_locked(Decoder &decoder, InputStream &is,
 	const auto f = std::bind(decoder_run_stream_plugin,
 				 std::ref(decoder), std::ref(is), suffix,
 				 _1, std::ref(tried_r));
-	return decoder_plugins_try(f);
+	return decoder_plugins_try_format(suffix, is.GetMimeType(), f);
 }
 
 /**
@@ -361,8 +369,9 @@ decoder_run_file(Decoder &decoder, const char *uri_utf8, Path path_fs)
 
 	decoder_load_replay_gain(decoder, path_fs);
 
-	if (decoder_plugins_try([&decoder, path_fs,
-				 suffix](const DecoderPlugin &plugin){
+	if (decoder_plugins_try_format(suffix, nullptr,
+				       [&decoder, path_fs,
+					suffix](const DecoderPlugin &plugin){
 				return TryDecoderFile(decoder,
 						      path_fs, suffix,
 						      plugin);
@@ -380,10 +389,25 @@ decoder_run_song(DecoderControl &dc,
 	Decoder decoder(dc, dc.start_time.IsPositive(),
 			new Tag(song.GetTag()));
 
+	dc.statistics.Clear();
 	dc.state = DecoderState::START;
 
 	decoder_command_finished_locked(dc);
 
+	/* apply the gain and the MixRamp points measured by the
+	   loudness analysis; tags found by the decoder plugin override
+	   them */
+	ReplayGainInfo replay_gain_info;
+	MixRampInfo mix_ramp;
+	if (!dc.background &&
+	    loudness_table_get(song.GetURI(), replay_gain_info, mix_ramp)) {
+		if (replay_gain_info.IsDefined())
+			decoder_replay_gain(decoder, &replay_gain_info);
+
+		if (mix_ramp.IsDefined())
+			dc.SetMixRamp(std::move(mix_ramp));
+	}
+
 	const int ret = !path_fs.IsNull()
 		? decoder_run_file(decoder, uri, path_fs)
 		: decoder_run_stream(decoder, uri);
@@ -395,8 +419,13 @@ decoder_run_song(DecoderControl &dc,
 	if (decoder.chunk != nullptr)
 		decoder.FlushChunk();
 
+	/* give the chunks cached by this thread back to the player */
+	dc.buffer->FlushThreadCache();
+
 	dc.Lock();
 
+	decoder.PublishStatistics();
+
 	if (decoder.error.IsDefined()) {
 		/* copy the Error from sruct Decoder to
 		   DecoderControl */
@@ -427,12 +456,13 @@ decoder_run(DecoderControl &dc)
 	assert(dc.song != nullptr);
 	const DetachedSong &song = *dc.song;
 
-	const char *const uri_utf8 = song.GetRealURI();
+	const std::string uri_utf8 = song.GetRealURI();
 
 	Path path_fs = Path::Null();
 	AllocatedPath path_buffer = AllocatedPath::Null();
-	if (PathTraitsUTF8::IsAbsolute(uri_utf8)) {
-		path_buffer = AllocatedPath::FromUTF8(uri_utf8, dc.error);
+	if (PathTraitsUTF8::IsAbsolute(uri_utf8.c_str())) {
+		path_buffer = AllocatedPath::FromUTF8(uri_utf8.c_str(),
+						      dc.error);
 		if (path_buffer.IsNull()) {
 			dc.state = DecoderState::ERROR;
 			decoder_command_finished_locked(dc);
@@ -442,20 +472,22 @@ decoder_run(DecoderControl &dc)
 		path_fs = path_buffer;
 	}
 
-	decoder_run_song(dc, song, uri_utf8, path_fs);
+	decoder_run_song(dc, song, uri_utf8.c_str(), path_fs);
 
 }
 
+/**
+ * Execute the commands of the #DecoderControl until it is idle.
+ * This is the job of a #DecoderPool thread.
+ */
 static void
-decoder_task(void *arg)
+decoder_serve(DecoderControl &dc)
 {
-	DecoderControl &dc = *(DecoderControl *)arg;
-
-	SetThreadName("decoder");
-
 	dc.Lock();
 
-	do {
+	assert(dc.running);
+
+	while (dc.command != DecoderCommand::NONE) {
 		assert(dc.state == DecoderState::STOP ||
 		       dc.state == DecoderState::ERROR);
 
@@ -485,22 +517,37 @@ decoder_task(void *arg)
 			break;
 
 		case DecoderCommand::NONE:
-			dc.Wait();
-			break;
+			gcc_unreachable();
 		}
-	} while (dc.command != DecoderCommand::NONE || !dc.quit);
+	}
+
+	/* give the thread back to the pool; the next command will
+	   submit this object again */
+	dc.running = false;
+	if (dc.client_is_waiting)
+		dc.client_cond.signal();
 
 	dc.Unlock();
 }
 
+static unsigned
+GetDecoderPoolSize()
+{
+#ifdef _SC_NPROCESSORS_ONLN
+	const long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n > 1)
+		return n;
+#endif
+
+	return 2;
+}
+
+static DecoderPool decoder_pool(decoder_serve, GetDecoderPoolSize());
+
 void
 decoder_thread_start(DecoderControl &dc)
 {
-	assert(!dc.thread.IsDefined());
+	assert(dc.running);
 
-	dc.quit = false;
-
-	Error error;
-	if (!dc.thread.Start(decoder_task, &dc, error))
-		FatalError(error);
+	decoder_pool.Submit(dc);
 }
@@ -22,6 +22,11 @@
 
 struct DecoderControl;
 
+/**
+ * Let a thread of the decoder pool execute the commands of the
+ * #DecoderControl, until it is idle again.  Called by
+ * DecoderControl::Signal(), which sets DecoderControl::running.
+ */
 void
 decoder_thread_start(DecoderControl &dc);
 
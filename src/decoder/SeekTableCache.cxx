@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "SeekTableCache.hxx"
+
+#include <iterator>
+
+#include <assert.h>
+
+void
+SeekTableCache::Erase(List::iterator i)
+{
+	assert(memory_size >= i->GetMemorySize());
+
+	memory_size -= i->GetMemorySize();
+	map.erase(i->uri);
+	list.erase(i);
+}
+
+bool
+SeekTableCache::Lookup(const std::string &uri, uint64_t size,
+		       std::vector<uint32_t> &offsets)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(uri);
+	if (i == map.end())
+		return false;
+
+	const List::iterator entry = i->second;
+	if (entry->size != size) {
+		/* the file has been modified; the entry is stale */
+		Erase(entry);
+		return false;
+	}
+
+	/* mark it "most recently used" */
+	list.splice(list.begin(), list, entry);
+
+	offsets = entry->offsets;
+	return true;
+}
+
+void
+SeekTableCache::Store(const std::string &uri, uint64_t size,
+		      std::vector<uint32_t> &&offsets)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(uri);
+	if (i != map.end()) {
+		if (i->second->size == size &&
+		    i->second->offsets.size() >= offsets.size())
+			/* we already know more */
+			return;
+
+		Erase(i->second);
+	}
+
+	list.emplace_front(uri, size, std::move(offsets));
+	const size_t entry_size = list.front().GetMemorySize();
+	if (entry_size > capacity) {
+		list.pop_front();
+		return;
+	}
+
+	map.emplace(uri, list.begin());
+	memory_size += entry_size;
+
+	/* evict the least recently used entries */
+	while (memory_size > capacity)
+		Erase(std::prev(list.end()));
+}
+
+void
+SeekTableCache::Clear()
+{
+	const ScopeLock protect(mutex);
+
+	map.clear();
+	list.clear();
+	memory_size = 0;
+}
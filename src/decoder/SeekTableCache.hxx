@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_SEEK_TABLE_CACHE_HXX
+#define MPD_SEEK_TABLE_CACHE_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "Compiler.h"
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A cache of seek tables: the stream offset of each frame which was
+ * decoded once, keyed by the URI.  This allows decoder plugins for
+ * formats without a usable index (e.g. MP3 without a Xing TOC) to
+ * seek to any part of a song which has been played before with a
+ * single seek, instead of decoding everything from the beginning
+ * again.
+ *
+ * Each entry remembers the size of the stream it was built from; a
+ * lookup misses when the size has changed since.
+ *
+ * The capacity is measured in bytes.  When the cache is full, the
+ * least recently used entries are evicted.  This class is
+ * thread-safe.
+ */
+class SeekTableCache {
+	struct Entry {
+		std::string uri;
+		uint64_t size;
+
+		std::vector<uint32_t> offsets;
+
+		Entry(const std::string &_uri, uint64_t _size,
+		      std::vector<uint32_t> &&_offsets)
+			:uri(_uri), size(_size),
+			 offsets(std::move(_offsets)) {}
+
+		size_t GetMemorySize() const {
+			return sizeof(*this) + uri.length() +
+				offsets.size() * sizeof(offsets.front());
+		}
+	};
+
+	typedef std::list<Entry> List;
+
+	const size_t capacity;
+
+	mutable Mutex mutex;
+
+	/**
+	 * The sum of Entry::GetMemorySize() of all entries.
+	 */
+	size_t memory_size;
+
+	/**
+	 * All entries, the most recently used one first.
+	 */
+	List list;
+
+	std::map<std::string, List::iterator> map;
+
+public:
+	explicit SeekTableCache(size_t _capacity)
+		:capacity(_capacity), memory_size(0) {}
+
+	SeekTableCache(const SeekTableCache &) = delete;
+	SeekTableCache &operator=(const SeekTableCache &) = delete;
+
+	gcc_pure
+	unsigned GetSize() const {
+		const ScopeLock protect(mutex);
+		return map.size();
+	}
+
+	gcc_pure
+	size_t GetMemorySize() const {
+		const ScopeLock protect(mutex);
+		return memory_size;
+	}
+
+	/**
+	 * Look up a stream.  On success, a copy of the frame offsets
+	 * is returned in #offsets.
+	 *
+	 * @return true if a valid entry was found
+	 */
+	bool Lookup(const std::string &uri, uint64_t size,
+		    std::vector<uint32_t> &offsets);
+
+	/**
+	 * Add the table for the specified stream.  An existing entry
+	 * is only replaced if the new table is longer (or if the
+	 * size of the stream has changed).
+	 */
+	void Store(const std::string &uri, uint64_t size,
+		   std::vector<uint32_t> &&offsets);
+
+	void Clear();
+
+private:
+	void Erase(List::iterator i);
+};
+
+#endif
@@ -143,8 +143,7 @@ adts_song_duration(DecoderBuffer &buffer)
 			   extrapolate the song duration from what we
 			   have until now */
 
-			const auto offset = is.GetOffset()
-				- buffer.GetAvailable();
+			const auto offset = buffer.GetOffset();
 			if (offset <= 0)
 				return SignedSongTime::Negative();
 
@@ -193,10 +192,10 @@ faad_song_duration(DecoderBuffer &buffer, InputStream &is)
 
 		auto song_length = adts_song_duration(buffer);
 
-		is.LockSeek(tagsize, IgnoreError());
-
 		buffer.Clear();
 
+		is.LockSeek(tagsize, IgnoreError());
+
 		return song_length;
 	} else if (data.size >= 5 && memcmp(data.data, "ADIF", 4) == 0) {
 		/* obtain the duration from the ADIF header */
@@ -54,6 +54,8 @@ extern "C" {
 #endif
 }
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 
@@ -72,9 +74,37 @@ FfmpegOpenInput(AVIOContext *pb,
 	return context;
 }
 
+/**
+ * The "threads" setting: the number of threads used by libavcodec
+ * for decoding one stream; 0 means automatic.
+ */
+static int ffmpeg_thread_count;
+
+/**
+ * The "thread_type" setting: a combination of FF_THREAD_FRAME and
+ * FF_THREAD_SLICE.
+ */
+static int ffmpeg_thread_type;
+
 static bool
-ffmpeg_init(gcc_unused const ConfigBlock &block)
+ffmpeg_init(const ConfigBlock &block)
 {
+	ffmpeg_thread_count = block.GetBlockValue("threads", 1u);
+
+	const char *thread_type = block.GetBlockValue("thread_type", "both");
+	if (strcmp(thread_type, "frame") == 0)
+		ffmpeg_thread_type = FF_THREAD_FRAME;
+	else if (strcmp(thread_type, "slice") == 0)
+		ffmpeg_thread_type = FF_THREAD_SLICE;
+	else if (strcmp(thread_type, "both") == 0)
+		ffmpeg_thread_type = FF_THREAD_FRAME|FF_THREAD_SLICE;
+	else {
+		FormatError(ffmpeg_domain,
+			    "Invalid thread_type '%s' at line %d",
+			    thread_type, block.line);
+		return false;
+	}
+
 	FfmpegInit();
 	return true;
 }
@@ -103,12 +133,15 @@ start_time_fallback(const AVStream &stream)
 	return FfmpegTimestampFallback(stream.start_time, 0);
 }
 
+/**
+ * Interleave the frames [start, end) of a planar buffer.
+ */
 static void
 copy_interleave_frame2(uint8_t *dest, uint8_t **src,
-		       unsigned nframes, unsigned nchannels,
+		       unsigned start, unsigned end, unsigned nchannels,
 		       unsigned sample_size)
 {
-	for (unsigned frame = 0; frame < nframes; ++frame) {
+	for (unsigned frame = start; frame < end; ++frame) {
 		for (unsigned channel = 0; channel < nchannels; ++channel) {
 			memcpy(dest, src[channel] + frame * sample_size,
 			       sample_size);
@@ -152,7 +185,7 @@ copy_interleave_frame(const AVCodecContext &codec_context,
 
 		copy_interleave_frame2((uint8_t *)output_buffer,
 				       frame.extended_data,
-				       frame.nb_samples,
+				       0, frame.nb_samples,
 				       codec_context.channels,
 				       av_get_bytes_per_sample(codec_context.sample_fmt));
 	} else {
@@ -162,6 +195,107 @@ copy_interleave_frame(const AVCodecContext &codec_context,
 	return { output_buffer, (size_t)data_size };
 }
 
+/**
+ * Send the PCM data of a decoded #AVFrame to the decoder API.
+ * Planar data is interleaved directly into the music pipe if
+ * possible.
+ */
+static DecoderCommand
+ffmpeg_send_frame(Decoder &decoder, InputStream &is,
+		  const AVCodecContext &codec_context,
+		  const AVFrame &frame,
+		  FfmpegBuffer &buffer)
+{
+	const uint16_t kbit_rate = codec_context.bit_rate / 1000;
+
+	if (av_sample_fmt_is_planar(codec_context.sample_fmt) &&
+	    codec_context.channels > 1) {
+		const unsigned nframes = frame.nb_samples;
+		const unsigned sample_size =
+			av_get_bytes_per_sample(codec_context.sample_fmt);
+		const size_t frame_size = sample_size * codec_context.channels;
+
+		DecoderCommand cmd = DecoderCommand::NONE;
+		unsigned position = 0;
+		while (position < nframes && cmd == DecoderCommand::NONE) {
+			const auto dest = decoder_write_begin(decoder, is,
+							      kbit_rate);
+			if (dest.IsNull())
+				break;
+
+			const unsigned n =
+				std::min<size_t>(nframes - position,
+						 dest.size / frame_size);
+			copy_interleave_frame2((uint8_t *)dest.data,
+					       frame.extended_data,
+					       position, position + n,
+					       codec_context.channels,
+					       sample_size);
+			position += n;
+
+			cmd = decoder_write_commit(decoder, n * frame_size);
+		}
+
+		if (position == nframes || cmd != DecoderCommand::NONE)
+			return cmd;
+
+		if (position > 0)
+			/* interrupted by a command */
+			return decoder_get_command(decoder);
+
+		/* writing in place is not possible; fall back to
+		   decoder_data() */
+	}
+
+	Error error;
+	auto output_buffer =
+		copy_interleave_frame(codec_context, frame,
+				      buffer, error);
+	if (output_buffer.IsNull()) {
+		/* this must be a serious error,
+		   e.g. OOM */
+		LogError(error);
+		return DecoderCommand::STOP;
+	}
+
+	return decoder_data(decoder, is,
+			    output_buffer.data, output_buffer.size,
+			    kbit_rate);
+}
+
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 37, 100)
+
+/**
+ * Receive all frames which are available from the codec and send
+ * them to the decoder API.
+ */
+static DecoderCommand
+ffmpeg_receive_frames(Decoder &decoder, InputStream &is,
+		      AVCodecContext &codec_context,
+		      AVFrame &frame,
+		      FfmpegBuffer &buffer)
+{
+	DecoderCommand cmd = DecoderCommand::NONE;
+	while (cmd == DecoderCommand::NONE) {
+		int err = avcodec_receive_frame(&codec_context, &frame);
+		if (err == AVERROR(EAGAIN) || err == AVERROR_EOF)
+			break;
+
+		if (err < 0) {
+			LogFfmpegError(err, "decoding failed, frame skipped");
+			break;
+		}
+
+		if (frame.nb_samples > 0)
+			cmd = ffmpeg_send_frame(decoder, is, codec_context,
+						frame, buffer);
+	}
+
+	return cmd;
+}
+
+#endif
+
 /**
  * Decode an #AVPacket and send the resulting PCM data to the decoder
  * API.
@@ -182,8 +316,17 @@ ffmpeg_send_packet(Decoder &decoder, InputStream &is,
 							     stream.time_base));
 	}
 
-	Error error;
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 37, 100)
+	int err = avcodec_send_packet(&codec_context, &packet);
+	if (err < 0) {
+		/* if error, we skip the frame */
+		LogFfmpegError(err, "decoding failed, frame skipped");
+		return DecoderCommand::NONE;
+	}
 
+	return ffmpeg_receive_frames(decoder, is, codec_context,
+				     frame, buffer);
+#else
 	DecoderCommand cmd = DecoderCommand::NONE;
 	while (packet.size > 0 && cmd == DecoderCommand::NONE) {
 		int got_frame = 0;
@@ -202,21 +345,11 @@ ffmpeg_send_packet(Decoder &decoder, InputStream &is,
 		if (!got_frame || frame.nb_samples <= 0)
 			continue;
 
-		auto output_buffer =
-			copy_interleave_frame(codec_context, frame,
-					      buffer, error);
-		if (output_buffer.IsNull()) {
-			/* this must be a serious error,
-			   e.g. OOM */
-			LogError(error);
-			return DecoderCommand::STOP;
-		}
-
-		cmd = decoder_data(decoder, is,
-				   output_buffer.data, output_buffer.size,
-				   codec_context.bit_rate / 1000);
+		cmd = ffmpeg_send_frame(decoder, is, codec_context,
+					frame, buffer);
 	}
 	return cmd;
+#endif
 }
 
 gcc_const
@@ -394,6 +527,7 @@ FfmpegCheckTag(Decoder &decoder, InputStream &is,
 	stream.event_flags &= ~AVSTREAM_EVENT_FLAG_METADATA_UPDATED;
 
 	TagBuilder tag;
+	tag.SetTransient();
 	FfmpegScanTag(format_context, audio_stream, tag);
 	if (!tag.IsEmpty())
 		decoder_tag(decoder, is, tag.Commit());
@@ -463,6 +597,9 @@ FfmpegDecode(Decoder &decoder, InputStream &input,
 	   values into AVCodecContext.channels - a change that will be
 	   reverted later by avcodec_decode_audio3() */
 
+	codec_context.thread_count = ffmpeg_thread_count;
+	codec_context.thread_type = ffmpeg_thread_type;
+
 	const int open_result = avcodec_open2(&codec_context, codec, nullptr);
 	if (open_result < 0) {
 		LogError(ffmpeg_domain, "Could not open codec");
@@ -489,12 +626,22 @@ FfmpegDecode(Decoder &decoder, InputStream &input,
 
 	FfmpegBuffer interleaved_buffer;
 
+	AVPacket packet;
+
 	DecoderCommand cmd;
 	do {
-		AVPacket packet;
-		if (av_read_frame(&format_context, &packet) < 0)
+		if (av_read_frame(&format_context, &packet) < 0) {
 			/* end of file */
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 37, 100)
+			/* drain the frames which are still queued in
+			   the codec (e.g. by frame threading) */
+			if (avcodec_send_packet(&codec_context, nullptr) == 0)
+				ffmpeg_receive_frames(decoder, input,
+						      codec_context, *frame,
+						      interleaved_buffer);
+#endif
 			break;
+		}
 
 #if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(56, 1, 0)
 		FfmpegCheckTag(decoder, input, format_context, audio_stream);
@@ -509,7 +656,11 @@ FfmpegDecode(Decoder &decoder, InputStream &input,
 		else
 			cmd = decoder_get_command(decoder);
 
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 8, 0)
+		av_packet_unref(&packet);
+#else
 		av_free_packet(&packet);
+#endif
 
 		if (cmd == DecoderCommand::SEEK) {
 			int64_t where =
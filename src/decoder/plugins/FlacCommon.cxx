@@ -29,6 +29,8 @@
 #include "util/Error.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 flac_data::flac_data(Decoder &_decoder,
 		     InputStream &_input_stream)
 	:FlacInput(_input_stream, &_decoder),
@@ -154,28 +156,59 @@ flac_common_write(struct flac_data *data, const FLAC__Frame * frame,
 		  const FLAC__int32 *const buf[],
 		  FLAC__uint64 nbytes)
 {
-	void *buffer;
 	unsigned bit_rate;
 
 	if (!data->initialized && !flac_got_first_frame(data, &frame->header))
 		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 
-	size_t buffer_size = frame->header.blocksize * data->frame_size;
-	buffer = data->buffer.Get(buffer_size);
-
-	flac_convert(buffer, frame->header.channels,
-		     data->audio_format.format, buf,
-		     0, frame->header.blocksize);
-
 	if (nbytes > 0)
 		bit_rate = nbytes * 8 * frame->header.sample_rate /
 			(1000 * frame->header.blocksize);
 	else
 		bit_rate = 0;
 
-	auto cmd = decoder_data(data->decoder, data->input_stream,
-				buffer, buffer_size,
-				bit_rate);
+	/* interleave the samples directly into the music pipe */
+
+	const unsigned blocksize = frame->header.blocksize;
+	unsigned position = 0;
+	DecoderCommand cmd = DecoderCommand::NONE;
+	while (position < blocksize) {
+		const auto dest = decoder_write_begin(data->decoder,
+						      data->input_stream,
+						      bit_rate);
+		if (dest.IsNull())
+			break;
+
+		const unsigned n = std::min<size_t>(blocksize - position,
+						    dest.size / data->frame_size);
+		flac_convert(dest.data, frame->header.channels,
+			     data->audio_format.format, buf,
+			     position, position + n);
+		position += n;
+
+		cmd = decoder_write_commit(data->decoder,
+					   n * data->frame_size);
+		if (cmd != DecoderCommand::NONE)
+			break;
+	}
+
+	if (cmd == DecoderCommand::NONE && position < blocksize) {
+		/* writing in place is not possible (e.g. the data
+		   needs to be converted): use a temporary buffer */
+
+		const size_t buffer_size =
+			(blocksize - position) * data->frame_size;
+		void *buffer = data->buffer.Get(buffer_size);
+
+		flac_convert(buffer, frame->header.channels,
+			     data->audio_format.format, buf,
+			     position, blocksize);
+
+		cmd = decoder_data(data->decoder, data->input_stream,
+				   buffer, buffer_size,
+				   bit_rate);
+	}
+
 	data->next_frame += frame->header.blocksize;
 	switch (cmd) {
 	case DecoderCommand::NONE:
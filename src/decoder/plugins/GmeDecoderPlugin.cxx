@@ -21,7 +21,9 @@
 #include "GmeDecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
 #include "CheckAudioFormat.hxx"
+#include "../ContainerTrack.hxx"
 #include "tag/TagHandler.hxx"
+#include "tag/TagBuilder.hxx"
 #include "fs/Path.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "util/Alloc.hxx"
@@ -85,31 +87,6 @@ ParseContainerPath(Path path_fs)
 	return { path_fs.GetDirectoryName(), track - 1 };
 }
 
-static char *
-gme_container_scan(Path path_fs, const unsigned int tnum)
-{
-	Music_Emu *emu;
-	const char *gme_err = gme_open_file(path_fs.c_str(), &emu,
-					    GME_SAMPLE_RATE);
-	if (gme_err != nullptr) {
-		LogWarning(gme_domain, gme_err);
-		return nullptr;
-	}
-
-	const unsigned num_songs = gme_track_count(emu);
-	gme_delete(emu);
-	/* if it only contains a single tune, don't treat as container */
-	if (num_songs < 2)
-		return nullptr;
-
-	const char *subtune_suffix = uri_get_suffix(path_fs.c_str());
-	if (tnum <= num_songs){
-		return FormatNew(SUBTUNE_PREFIX "%03u.%s",
-				 tnum, subtune_suffix);
-	} else
-		return nullptr;
-}
-
 static void
 gme_file_decode(Decoder &decoder, Path path_fs)
 {
@@ -265,6 +242,44 @@ gme_scan_file(Path path_fs,
 	return result;
 }
 
+static std::forward_list<ContainerTrack>
+gme_container_scan(Path path_fs)
+{
+	std::forward_list<ContainerTrack> list;
+
+	Music_Emu *emu;
+	const char *gme_err = gme_open_file(path_fs.c_str(), &emu,
+					    GME_SAMPLE_RATE);
+	if (gme_err != nullptr) {
+		LogWarning(gme_domain, gme_err);
+		return list;
+	}
+
+	const unsigned num_songs = gme_track_count(emu);
+	/* if it only contains a single tune, don't treat as container */
+	if (num_songs < 2) {
+		gme_delete(emu);
+		return list;
+	}
+
+	const char *subtune_suffix = uri_get_suffix(path_fs.c_str());
+
+	TagBuilder tag_builder;
+	auto tail = list.before_begin();
+	for (unsigned i = 0; i < num_songs; ++i) {
+		ScanMusicEmu(emu, i, &add_tag_handler, &tag_builder);
+
+		char *name = FormatNew(SUBTUNE_PREFIX "%03u.%s",
+				       i + 1, subtune_suffix);
+		tail = list.emplace_after(tail, name,
+					  tag_builder.Commit());
+		delete[] name;
+	}
+
+	gme_delete(emu);
+	return list;
+}
+
 static const char *const gme_suffixes[] = {
 	"ay", "gbs", "gym", "hes", "kss", "nsf",
 	"nsfe", "sap", "spc", "vgm", "vgz",
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "MadDecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
+#include "../SeekTableCache.hxx"
 #include "input/InputStream.hxx"
 #include "config/ConfigGlobal.hxx"
 #include "tag/TagId3.hxx"
@@ -69,6 +70,13 @@ static constexpr Domain mad_domain("mad");
 
 static bool gapless_playback;
 
+/**
+ * The frame offsets of songs which have been played, to allow exact
+ * seeking without decoding all frames again; 4 bytes per frame, so
+ * this is enough for about 30 hours of MP3.
+ */
+static SeekTableCache mad_seek_tables(16 * 1024 * 1024);
+
 gcc_const
 static SongTime
 ToSongTime(mad_timer_t t)
@@ -114,6 +122,12 @@ mp3_plugin_init(gcc_unused const ConfigBlock &block)
 	return true;
 }
 
+static void
+mp3_plugin_finish()
+{
+	mad_seek_tables.Clear();
+}
+
 struct MadDecoder {
 	static constexpr size_t READ_BUFFER_SIZE = 40960;
 	static constexpr size_t MP3_DATA_OUTPUT_BUFFER_SIZE = 2048;
@@ -167,6 +181,20 @@ struct MadDecoder {
 
 	bool DecodeFirstFrame(Tag **tag);
 
+	/**
+	 * Initialize #frame_offsets and #times from
+	 * #mad_seek_tables.  Must be called after the arrays have
+	 * been allocated, before the first frame has been recorded.
+	 */
+	void LoadSeekTable();
+
+	/**
+	 * Store #frame_offsets in #mad_seek_tables.  This works only
+	 * if all frames have the same duration, because #times is
+	 * not stored.
+	 */
+	void StoreSeekTable() const;
+
 	gcc_pure
 	long TimeToFrame(SongTime t) const;
 
@@ -822,11 +850,74 @@ MadDecoder::DecodeFirstFrame(Tag **tag)
 	frame_offsets = new long[max_frames];
 	times = new mad_timer_t[max_frames];
 
+	if (decoder != nullptr)
+		LoadSeekTable();
+
 	return true;
 }
 
+void
+MadDecoder::LoadSeekTable()
+{
+	assert(highest_frame == 0);
+
+	if (!input_stream.IsSeekable() || !input_stream.KnownSize())
+		return;
+
+	std::vector<uint32_t> offsets;
+	if (!mad_seek_tables.Lookup(input_stream.GetURI(),
+				    input_stream.GetSize(), offsets))
+		return;
+
+	/* the first frame (which has just been decoded) must be at
+	   the same position as before */
+	if (offsets.empty() || offsets.front() != ThisFrameOffset())
+		return;
+
+	mad_timer_t t = mad_timer_zero;
+	for (const auto offset : offsets) {
+		if (highest_frame >= max_frames)
+			break;
+
+		mad_timer_add(&t, frame.header.duration);
+		frame_offsets[highest_frame] = offset;
+		times[highest_frame] = t;
+		++highest_frame;
+	}
+}
+
+void
+MadDecoder::StoreSeekTable() const
+{
+	if (highest_frame == 0 ||
+	    !input_stream.IsSeekable() || !input_stream.KnownSize())
+		return;
+
+	std::vector<uint32_t> offsets;
+	offsets.reserve(highest_frame);
+
+	const mad_timer_t duration = times[0];
+	mad_timer_t t = mad_timer_zero;
+	for (unsigned long i = 0; i < highest_frame; ++i) {
+		mad_timer_add(&t, duration);
+		if (mad_timer_compare(t, times[i]) != 0 ||
+		    frame_offsets[i] < 0 || frame_offsets[i] > long(UINT32_MAX))
+			/* variable frame duration or huge file: the
+			   table cannot be stored */
+			return;
+
+		offsets.push_back(frame_offsets[i]);
+	}
+
+	mad_seek_tables.Store(input_stream.GetURI(), input_stream.GetSize(),
+			      std::move(offsets));
+}
+
 MadDecoder::~MadDecoder()
 {
+	if (decoder != nullptr)
+		StoreSeekTable();
+
 	mad_synth_finish(&synth);
 	mad_frame_finish(&frame);
 	mad_stream_finish(&stream);
@@ -1093,7 +1184,7 @@ static const char *const mp3_mime_types[] = { "audio/mpeg", nullptr };
 const struct DecoderPlugin mad_decoder_plugin = {
 	"mad",
 	mp3_plugin_init,
-	nullptr,
+	mp3_plugin_finish,
 	mp3_decode,
 	nullptr,
 	nullptr,
@@ -125,6 +125,7 @@ static void
 mpd_mpg123_id3v2_tag(Decoder &decoder, const mpg123_id3v2 &id3v2)
 {
 	TagBuilder tag;
+	tag.SetTransient();
 
 	AddTagItem(tag, TAG_TITLE, id3v2.title);
 	AddTagItem(tag, TAG_ARTIST, id3v2.artist);
@@ -328,6 +328,7 @@ MPDOpusDecoder::HandleTags(const ogg_packet &packet)
 	rgi.Clear();
 
 	TagBuilder tag_builder;
+	tag_builder.SetTransient();
 
 	DecoderCommand cmd;
 	if (ScanOpusTags(packet.packet, packet.bytes,
@@ -349,10 +350,26 @@ MPDOpusDecoder::HandleAudio(const ogg_packet &packet)
 {
 	assert(opus_decoder != nullptr);
 
+	/* decode directly into the music pipe if the packet fits
+	   into the current chunk */
+	const int packet_frames =
+		opus_packet_get_nb_samples((const unsigned char*)packet.packet,
+					   packet.bytes, opus_sample_rate);
+	const auto dest = packet_frames > 0
+		? decoder_write_begin(decoder, input_stream, 0)
+		: nullptr;
+	const bool in_place = !dest.IsNull() &&
+		dest.size >= size_t(packet_frames) * frame_size;
+
 	int nframes = opus_decode(opus_decoder,
 				  (const unsigned char*)packet.packet,
 				  packet.bytes,
-				  output_buffer, opus_output_buffer_frames,
+				  in_place
+				  ? (opus_int16 *)dest.data
+				  : output_buffer,
+				  in_place
+				  ? packet_frames
+				  : opus_output_buffer_frames,
 				  0);
 	if (nframes < 0) {
 		FormatError(opus_domain, "libopus error: %s",
@@ -362,9 +379,11 @@ MPDOpusDecoder::HandleAudio(const ogg_packet &packet)
 
 	if (nframes > 0) {
 		const size_t nbytes = nframes * frame_size;
-		auto cmd = decoder_data(decoder, input_stream,
-					output_buffer, nbytes,
-					0);
+		auto cmd = in_place
+			? decoder_write_commit(decoder, nbytes)
+			: decoder_data(decoder, input_stream,
+				       output_buffer, nbytes,
+				       0);
 		if (cmd != DecoderCommand::NONE)
 			return cmd;
 
@@ -54,22 +54,43 @@ pcm_stream_decode(Decoder &decoder, InputStream &is)
 	do {
 		char buffer[4096];
 
+		/* read directly into the music pipe if possible */
+		auto dest = decoder_write_begin(decoder, is, 0);
+		const bool in_place = !dest.IsNull();
+		if (!in_place)
+			dest = {buffer, sizeof(buffer)};
+
 		size_t nbytes = decoder_read(decoder, is,
-					     buffer, sizeof(buffer));
+					     dest.data, dest.size);
 
 		if (nbytes == 0 && is.LockIsEOF())
 			break;
 
+		/* submit only whole frames: complete a partial
+		   frame, or drop it if that fails */
+		const size_t partial = nbytes % frame_size;
+		if (partial > 0) {
+			if (decoder_read_full(&decoder, is,
+					      (char *)dest.data + nbytes,
+					      frame_size - partial))
+				nbytes += frame_size - partial;
+			else
+				nbytes -= partial;
+		}
+
 		if (reverse_endian)
 			/* make sure we deliver samples in host byte order */
-			reverse_bytes_16((uint16_t *)buffer,
-					 (uint16_t *)buffer,
-					 (uint16_t *)(buffer + nbytes));
-
-		cmd = nbytes > 0
-			? decoder_data(decoder, is,
-				       buffer, nbytes, 0)
-			: decoder_get_command(decoder);
+			reverse_bytes_16((uint16_t *)dest.data,
+					 (uint16_t *)dest.data,
+					 (uint16_t *)((char *)dest.data + nbytes));
+
+		if (nbytes == 0)
+			cmd = decoder_get_command(decoder);
+		else if (in_place)
+			cmd = decoder_write_commit(decoder, nbytes);
+		else
+			cmd = decoder_data(decoder, is, buffer, nbytes, 0);
+
 		if (cmd == DecoderCommand::SEEK) {
 			uint64_t frame = decoder_seek_where_frame(decoder);
 			offset_type offset = frame * frame_size;
@@ -20,7 +20,9 @@
 #include "config.h"
 #include "SidplayDecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
+#include "../ContainerTrack.hxx"
 #include "tag/TagHandler.hxx"
+#include "tag/TagBuilder.hxx"
 #include "fs/Path.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "util/FormatString.hxx"
@@ -284,19 +286,13 @@ sidplay_file_decode(Decoder &decoder, Path path_fs)
 	} while (cmd != DecoderCommand::STOP);
 }
 
-static bool
-sidplay_scan_file(Path path_fs,
-		  const struct tag_handler *handler, void *handler_ctx)
+/**
+ * Pass the metadata of the selected song of the tune to the handler.
+ */
+static void
+ScanSidTuneInfo(SidTuneMod &tune, unsigned song_num,
+		const struct tag_handler *handler, void *handler_ctx)
 {
-	const auto container = ParseContainerPath(path_fs);
-	const unsigned song_num = container.track;
-
-	SidTuneMod tune(container.path.c_str());
-	if (!tune)
-		return false;
-
-	tune.selectSong(song_num);
-
 	const SidTuneInfo &info = tune.getInfo();
 
 	/* title */
@@ -331,30 +327,56 @@ sidplay_scan_file(Path path_fs,
 	if (!duration.IsNegative())
 		tag_handler_invoke_duration(handler, handler_ctx,
 					    SongTime(duration));
+}
 
+static bool
+sidplay_scan_file(Path path_fs,
+		  const struct tag_handler *handler, void *handler_ctx)
+{
+	const auto container = ParseContainerPath(path_fs);
+	const unsigned song_num = container.track;
+
+	SidTuneMod tune(container.path.c_str());
+	if (!tune)
+		return false;
+
+	tune.selectSong(song_num);
+
+	ScanSidTuneInfo(tune, song_num, handler, handler_ctx);
 	return true;
 }
 
-static char *
-sidplay_container_scan(Path path_fs, const unsigned int tnum)
+static std::forward_list<ContainerTrack>
+sidplay_container_scan(Path path_fs)
 {
-	SidTune tune(path_fs.c_str(), nullptr, true);
+	std::forward_list<ContainerTrack> list;
+
+	SidTuneMod tune(path_fs.c_str());
 	if (!tune)
-		return nullptr;
+		return list;
 
-	const SidTuneInfo &info=tune.getInfo();
+	const unsigned n_tracks = tune.getInfo().songs;
 
 	/* Don't treat sids containing a single tune
 		as containers */
-	if(!all_files_are_containers && info.songs<2)
-		return nullptr;
+	if(!all_files_are_containers && n_tracks < 2)
+		return list;
+
+	TagBuilder tag_builder;
+	auto tail = list.before_begin();
+	for (unsigned i = 1; i <= n_tracks; ++i) {
+		tune.selectSong(i);
+		ScanSidTuneInfo(tune, i, &add_tag_handler, &tag_builder);
+
+		/* Construct container/tune path names, eg.
+			Delta.sid/tune_001.sid */
+		char *name = FormatNew(SUBTUNE_PREFIX "%03u.sid", i);
+		tail = list.emplace_after(tail, name,
+					  tag_builder.Commit());
+		delete[] name;
+	}
 
-	/* Construct container/tune path names, eg.
-		Delta.sid/tune_001.sid */
-	if(tnum<=info.songs) {
-		return FormatNew(SUBTUNE_PREFIX "%03u.sid", tnum);
-	} else
-		return nullptr;
+	return list;
 }
 
 static const char *const sidplay_suffixes[] = {
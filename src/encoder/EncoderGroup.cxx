@@ -0,0 +1,902 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "EncoderGroup.hxx"
+#include "EncoderInterface.hxx"
+#include "EncoderPlugin.hxx"
+#include "AudioFormat.hxx"
+#include "config/Block.hxx"
+#include "tag/Tag.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "system/Clock.hxx"
+#include "util/DynamicFifoBuffer.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <algorithm>
+#include <atomic>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+static constexpr Domain encoder_group_domain("encoder_group");
+
+/**
+ * The default for "encoder_queue_size" (in KiB).  If more than this
+ * number of PCM bytes is waiting for the encoder thread, writers
+ * block until it has caught up.
+ */
+static constexpr unsigned DEFAULT_QUEUE_SIZE = 1024;
+
+/**
+ * The amount of audio (in microseconds) over which the encoder load
+ * is averaged.
+ */
+static constexpr uint64_t LOAD_PERIOD_US = 2000000;
+
+class EncoderGroup;
+
+/**
+ * The proxy #Encoder handed out to each output of an #EncoderGroup.
+ */
+struct SharedEncoder {
+	Encoder encoder;
+
+	EncoderGroup &group;
+
+	/**
+	 * A private copy of the stream header, which is delivered by
+	 * read() before the shared stream.
+	 */
+	std::vector<uint8_t> header;
+	size_t header_position;
+
+	/**
+	 * The absolute position of the next byte of the shared
+	 * encoded stream to be read by this output.
+	 */
+	uint64_t cursor;
+
+	/**
+	 * The number of PCM bytes this output has written.  It is
+	 * compared with EncoderGroup::position to decide whether the
+	 * data is new or has already been submitted by another
+	 * output.
+	 */
+	uint64_t position;
+
+	/**
+	 * Has this output called end()?
+	 */
+	bool ended;
+
+	SharedEncoder(const EncoderPlugin &plugin, EncoderGroup &_group)
+		:encoder(plugin), group(_group) {}
+};
+
+/**
+ * A command for the encoder thread.
+ */
+struct EncoderJob {
+	enum class Type {
+		WRITE,
+		FLUSH,
+		PRE_TAG,
+		TAG,
+		END,
+	} type;
+
+	std::vector<uint8_t> data;
+
+	Tag tag;
+
+	explicit EncoderJob(Type _type):type(_type) {}
+
+	EncoderJob(Type _type, const Tag &_tag)
+		:type(_type), tag(_tag) {}
+};
+
+class EncoderGroup {
+	const std::string name;
+
+	/**
+	 * The plugin of the proxy objects.  Its "pre_tag" and "tag"
+	 * methods are only set if the real encoder implements them,
+	 * because outputs check this to choose between stream tags
+	 * and other kinds of metadata.
+	 */
+	EncoderPlugin proxy_plugin;
+
+	Encoder &encoder;
+
+	/**
+	 * The number of #SharedEncoder objects; protected by the
+	 * registry mutex.
+	 */
+	unsigned refs;
+
+	Thread thread;
+
+	Mutex mutex;
+
+	/**
+	 * Wakes up the encoder thread.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled by the encoder thread after each job.
+	 */
+	Cond done_cond;
+
+	std::list<EncoderJob> jobs;
+
+	/**
+	 * The number of PCM bytes in #jobs.
+	 */
+	size_t queued_bytes;
+
+	/**
+	 * The "encoder_queue_size" setting in bytes.
+	 */
+	const size_t max_queued_bytes;
+
+	uint64_t n_queued, n_done;
+
+	bool quit;
+
+	/**
+	 * The subscribers which are currently open.
+	 */
+	std::list<SharedEncoder *> subscribers;
+
+	/**
+	 * The audio format passed to Encoder::Open() by the first
+	 * subscriber, and the one the encoder has chosen.
+	 */
+	AudioFormat in_format, out_format;
+
+	/**
+	 * The shared encoded stream which has not yet been read by
+	 * all subscribers.
+	 */
+	DynamicFifoBuffer<uint8_t> log;
+
+	/**
+	 * The absolute stream position of the first byte in #log.
+	 */
+	uint64_t log_start;
+
+	/**
+	 * The current stream header, for subscribers which join
+	 * later.
+	 */
+	std::vector<uint8_t> header;
+
+	/**
+	 * The number of PCM bytes submitted to the encoder.
+	 */
+	uint64_t position;
+
+	/**
+	 * The PCM position of the last pre_tag() call, to submit
+	 * each tag only once.
+	 */
+	uint64_t tag_position;
+	bool tagged;
+
+	/**
+	 * Was pre_tag() submitted, but tag() not yet?
+	 */
+	bool tag_pending;
+
+	/**
+	 * Did the encoder thread fail to submit pre_tag()?  Then
+	 * tag() must be skipped.
+	 */
+	bool pre_tag_failed;
+
+	/**
+	 * Was end() submitted to the encoder?
+	 */
+	bool ended;
+
+	/**
+	 * The first error of the encoder thread; it is reported to
+	 * all subscribers until the encoder is closed.
+	 */
+	Error error;
+
+	/**
+	 * The time spent in encoder_write() and the duration of the
+	 * audio data passed to it in the current measuring period.
+	 * Only used by the encoder thread.
+	 */
+	uint64_t encode_us, audio_us;
+
+	/**
+	 * The real-time factor of the encoder in the last measuring
+	 * period, in 1/1000.
+	 */
+	std::atomic_uint load;
+
+public:
+	EncoderGroup(const char *_name, Encoder &_encoder,
+		     size_t _max_queued_bytes);
+	~EncoderGroup();
+
+	EncoderGroup(const EncoderGroup &) = delete;
+	EncoderGroup &operator=(const EncoderGroup &) = delete;
+
+	static EncoderGroup *Create(const char *name,
+				    const EncoderPlugin &plugin,
+				    const ConfigBlock &block,
+				    Error &error);
+
+	const EncoderPlugin &GetPlugin() const {
+		return encoder.plugin;
+	}
+
+	bool Unref() {
+		assert(refs > 0);
+
+		return --refs == 0;
+	}
+
+	SharedEncoder *NewSubscriber() {
+		++refs;
+		return new SharedEncoder(proxy_plugin, *this);
+	}
+
+	unsigned GetLoad() const {
+		return load.load();
+	}
+
+	bool Open(SharedEncoder &s, AudioFormat &audio_format, Error &error);
+	void Close(SharedEncoder &s);
+	bool End(SharedEncoder &s, Error &error);
+	bool Flush(SharedEncoder &s, Error &error);
+	bool PreTag(SharedEncoder &s, Error &error);
+	bool SendTag(SharedEncoder &s, const Tag &tag, Error &error);
+	bool Write(SharedEncoder &s, const void *data, size_t length,
+		   Error &error);
+	size_t Read(SharedEncoder &s, void *dest, size_t length);
+
+	const char *GetMimeType() {
+		return encoder_get_mime_type(&encoder);
+	}
+
+private:
+	/**
+	 * Caller must lock the mutex.
+	 */
+	void Queue(EncoderJob &&job) {
+		queued_bytes += job.data.size();
+		jobs.emplace_back(std::move(job));
+		++n_queued;
+		cond.signal();
+	}
+
+	/**
+	 * Wait until the encoder thread has finished all jobs which
+	 * are queued now.  Caller must lock the mutex.
+	 */
+	void WaitDone() {
+		const uint64_t n = n_queued;
+		while (n_done < n)
+			done_cond.wait(mutex);
+	}
+
+	/**
+	 * Copy the encoder thread's error.  Caller must lock the
+	 * mutex.
+	 */
+	bool CheckError(Error &_error) const {
+		if (!error.IsDefined())
+			return true;
+
+		_error.Set(error);
+		return false;
+	}
+
+	/**
+	 * Read everything the encoder has produced.
+	 */
+	void Drain(std::vector<uint8_t> &dest);
+
+	/**
+	 * Discard data which has been read by all subscribers.
+	 * Caller must lock the mutex.
+	 */
+	void Trim();
+
+	bool RunJob(EncoderJob &job, std::vector<uint8_t> &output,
+		    Error &error);
+
+	void Run();
+
+	static void Run(void *ctx) {
+		EncoderGroup &group = *(EncoderGroup *)ctx;
+		group.Run();
+	}
+};
+
+static Mutex encoder_groups_mutex;
+static std::map<std::string, EncoderGroup *> encoder_groups;
+
+static void
+shared_encoder_finish(Encoder *_encoder)
+{
+	SharedEncoder *s = (SharedEncoder *)_encoder;
+	EncoderGroup &group = s->group;
+	delete s;
+
+	const ScopeLock protect(encoder_groups_mutex);
+	if (group.Unref()) {
+		for (auto i = encoder_groups.begin();
+		     i != encoder_groups.end(); ++i) {
+			if (i->second == &group) {
+				encoder_groups.erase(i);
+				break;
+			}
+		}
+
+		delete &group;
+	}
+}
+
+static bool
+shared_encoder_open(Encoder *_encoder, AudioFormat &audio_format,
+		    Error &error)
+{
+	SharedEncoder &s = *(SharedEncoder *)_encoder;
+	return s.group.Open(s, audio_format, error);
+}
+
+static void
+shared_encoder_close(Encoder *_encoder)
+{
+	SharedEncoder &s = *(SharedEncoder *)_encoder;
+	s.group.Close(s);
+}
+
+static bool
+shared_encoder_end(Encoder *_encoder, Error &error)
+{
+	SharedEncoder &s = *(SharedEncoder *)_encoder;
+	return s.group.End(s, error);
+}
+
+static bool
+shared_encoder_flush(Encoder *_encoder, Error &error)
+{
+	SharedEncoder &s = *(SharedEncoder *)_encoder;
+	return s.group.Flush(s, error);
+}
+
+static bool
+shared_encoder_pre_tag(Encoder *_encoder, Error &error)
+{
+	SharedEncoder &s = *(SharedEncoder *)_encoder;
+	return s.group.PreTag(s, error);
+}
+
+static bool
+shared_encoder_tag(Encoder *_encoder, const Tag &tag, Error &error)
+{
+	SharedEncoder &s = *(SharedEncoder *)_encoder;
+	return s.group.SendTag(s, tag, error);
+}
+
+static bool
+shared_encoder_write(Encoder *_encoder, const void *data, size_t length,
+		     Error &error)
+{
+	SharedEncoder &s = *(SharedEncoder *)_encoder;
+	return s.group.Write(s, data, length, error);
+}
+
+static size_t
+shared_encoder_read(Encoder *_encoder, void *dest, size_t length)
+{
+	SharedEncoder &s = *(SharedEncoder *)_encoder;
+	return s.group.Read(s, dest, length);
+}
+
+static const char *
+shared_encoder_get_mime_type(Encoder *_encoder)
+{
+	SharedEncoder &s = *(SharedEncoder *)_encoder;
+	return s.group.GetMimeType();
+}
+
+EncoderGroup::EncoderGroup(const char *_name, Encoder &_encoder,
+			   size_t _max_queued_bytes)
+	:name(_name),
+	 proxy_plugin{
+		_encoder.plugin.name,
+		nullptr,
+		shared_encoder_finish,
+		shared_encoder_open,
+		shared_encoder_close,
+		shared_encoder_end,
+		shared_encoder_flush,
+		_encoder.plugin.pre_tag != nullptr
+		? shared_encoder_pre_tag : nullptr,
+		_encoder.plugin.tag != nullptr
+		? shared_encoder_tag : nullptr,
+		shared_encoder_write,
+		shared_encoder_read,
+		shared_encoder_get_mime_type,
+	},
+	 encoder(_encoder), refs(0),
+	 queued_bytes(0), max_queued_bytes(_max_queued_bytes),
+	 n_queued(0), n_done(0), quit(false),
+	 log(65536), log_start(0), position(0),
+	 tag_position(0), tagged(false), tag_pending(false), pre_tag_failed(false),
+	 ended(false),
+	 encode_us(0), audio_us(0), load(0) {}
+
+EncoderGroup::~EncoderGroup()
+{
+	assert(refs == 0);
+	assert(subscribers.empty());
+
+	if (thread.IsDefined()) {
+		mutex.lock();
+		quit = true;
+		cond.signal();
+		mutex.unlock();
+
+		thread.Join();
+	}
+
+	encoder.Dispose();
+}
+
+EncoderGroup *
+EncoderGroup::Create(const char *name, const EncoderPlugin &plugin,
+		     const ConfigBlock &block, Error &error)
+{
+	const unsigned queue_size =
+		block.GetBlockValue("encoder_queue_size", DEFAULT_QUEUE_SIZE);
+	if (queue_size == 0) {
+		error.Set(encoder_group_domain,
+			  "encoder_queue_size must be positive");
+		return nullptr;
+	}
+
+	Encoder *encoder = encoder_init(plugin, block, error);
+	if (encoder == nullptr)
+		return nullptr;
+
+	auto *group = new EncoderGroup(name, *encoder,
+				       size_t(queue_size) * 1024);
+	if (!group->thread.Start(Run, group, error)) {
+		delete group;
+		return nullptr;
+	}
+
+	return group;
+}
+
+void
+EncoderGroup::Drain(std::vector<uint8_t> &dest)
+{
+	while (true) {
+		uint8_t buffer[32768];
+		size_t nbytes = encoder_read(&encoder, buffer, sizeof(buffer));
+		if (nbytes == 0)
+			break;
+
+		dest.insert(dest.end(), buffer, buffer + nbytes);
+	}
+}
+
+void
+EncoderGroup::Trim()
+{
+	if (subscribers.empty())
+		return;
+
+	uint64_t min_cursor = subscribers.front()->cursor;
+	for (const auto *s : subscribers)
+		min_cursor = std::min(min_cursor, s->cursor);
+
+	assert(min_cursor >= log_start);
+	log.Consume(min_cursor - log_start);
+	log_start = min_cursor;
+}
+
+bool
+EncoderGroup::Open(SharedEncoder &s, AudioFormat &audio_format,
+		   Error &_error)
+{
+	const ScopeLock protect(mutex);
+
+	if (subscribers.empty()) {
+		/* the first subscriber opens the real encoder; the
+		   encoder thread is idle */
+		assert(n_done == n_queued);
+
+		in_format = audio_format;
+		if (!encoder.Open(audio_format, _error))
+			return false;
+
+		out_format = audio_format;
+
+		header.clear();
+		Drain(header);
+
+		log.Clear();
+		log_start = 0;
+		position = 0;
+		tagged = tag_pending = pre_tag_failed = ended = false;
+		error.Clear();
+		encode_us = audio_us = 0;
+	} else {
+		if (audio_format != in_format) {
+			_error.Format(encoder_group_domain,
+				      "Encoder group \"%s\" is already open "
+				      "with a different audio format",
+				      name.c_str());
+			return false;
+		}
+
+		if (ended) {
+			_error.Format(encoder_group_domain,
+				      "Encoder group \"%s\" has already "
+				      "ended its stream", name.c_str());
+			return false;
+		}
+
+		audio_format = out_format;
+
+		FormatDebug(encoder_group_domain,
+			    "Joining encoder group \"%s\"", name.c_str());
+	}
+
+	/* the new subscriber receives the header, and then
+	   everything which is encoded from now on */
+	s.header = header;
+	s.header_position = 0;
+	s.cursor = log_start + log.GetAvailable();
+	s.position = position;
+	s.ended = false;
+
+	subscribers.push_back(&s);
+	return true;
+}
+
+void
+EncoderGroup::Close(SharedEncoder &s)
+{
+	const ScopeLock protect(mutex);
+
+	subscribers.remove(&s);
+	s.header.clear();
+
+	if (!subscribers.empty()) {
+		Trim();
+		return;
+	}
+
+	/* the last subscriber closes the real encoder */
+	WaitDone();
+	encoder.Close();
+
+	log.Clear();
+	log_start = 0;
+	header.clear();
+	load = 0;
+}
+
+bool
+EncoderGroup::End(SharedEncoder &s, Error &_error)
+{
+	const ScopeLock protect(mutex);
+
+	s.ended = true;
+
+	/* as long as another subscriber keeps streaming, this one
+	   just stops reading */
+	for (const auto *i : subscribers)
+		if (!i->ended)
+			return true;
+
+	if (!ended) {
+		ended = true;
+		Queue(EncoderJob(EncoderJob::Type::END));
+	}
+
+	WaitDone();
+	return CheckError(_error);
+}
+
+bool
+EncoderGroup::Flush(SharedEncoder &s, Error &_error)
+{
+	const ScopeLock protect(mutex);
+
+	/* only the subscriber which submits new data flushes, and
+	   consecutive flushes are merged */
+	if (s.position >= position &&
+	    (jobs.empty() ||
+	     jobs.back().type != EncoderJob::Type::FLUSH))
+		Queue(EncoderJob(EncoderJob::Type::FLUSH));
+
+	return CheckError(_error);
+}
+
+bool
+EncoderGroup::PreTag(SharedEncoder &s, Error &_error)
+{
+	const ScopeLock protect(mutex);
+
+	if (s.position >= position &&
+	    !(tagged && tag_position == s.position)) {
+		tagged = true;
+		tag_position = s.position;
+		tag_pending = true;
+		Queue(EncoderJob(EncoderJob::Type::PRE_TAG));
+	}
+
+	/* wait for the encoder, so the caller can read the end of
+	   the current stream before calling tag() */
+	WaitDone();
+	return CheckError(_error);
+}
+
+bool
+EncoderGroup::SendTag(SharedEncoder &, const Tag &tag, Error &_error)
+{
+	const ScopeLock protect(mutex);
+
+	if (tag_pending) {
+		tag_pending = false;
+
+		Queue(EncoderJob(EncoderJob::Type::TAG, tag));
+	}
+
+	/* wait for the encoder, so the next read() returns the new
+	   stream header */
+	WaitDone();
+	return CheckError(_error);
+}
+
+bool
+EncoderGroup::Write(SharedEncoder &s, const void *data, size_t length,
+		    Error &_error)
+{
+	const ScopeLock protect(mutex);
+
+	const uint64_t end = s.position + length;
+	if (end > position) {
+		/* submit only the part which no other subscriber has
+		   submitted yet */
+		const size_t skip = position > s.position
+			? size_t(position - s.position)
+			: 0;
+
+		EncoderJob job(EncoderJob::Type::WRITE);
+		job.data.assign((const uint8_t *)data + skip,
+				(const uint8_t *)data + length);
+		Queue(std::move(job));
+
+		position = end;
+	}
+
+	s.position = end;
+
+	while (queued_bytes > max_queued_bytes && !error.IsDefined())
+		done_cond.wait(mutex);
+
+	return CheckError(_error);
+}
+
+size_t
+EncoderGroup::Read(SharedEncoder &s, void *_dest, size_t length)
+{
+	uint8_t *dest = (uint8_t *)_dest;
+
+	if (s.header_position < s.header.size()) {
+		size_t nbytes = std::min(length,
+					 s.header.size() - s.header_position);
+		memcpy(dest, s.header.data() + s.header_position, nbytes);
+		s.header_position += nbytes;
+		return nbytes;
+	}
+
+	const ScopeLock protect(mutex);
+
+	assert(s.cursor >= log_start);
+
+	const auto r = log.Read();
+	const size_t offset = s.cursor - log_start;
+	assert(offset <= r.size);
+
+	const size_t nbytes = std::min(length, r.size - offset);
+	if (nbytes == 0)
+		return 0;
+
+	memcpy(dest, r.data + offset, nbytes);
+	s.cursor += nbytes;
+
+	Trim();
+	return nbytes;
+}
+
+inline bool
+EncoderGroup::RunJob(EncoderJob &job, std::vector<uint8_t> &output,
+		     Error &_error)
+{
+	bool success = true;
+
+	switch (job.type) {
+	case EncoderJob::Type::WRITE: {
+		const uint64_t start = MonotonicClockUS();
+		success = encoder_write(&encoder, job.data.data(),
+					job.data.size(), _error);
+		encode_us += MonotonicClockUS() - start;
+
+		audio_us += uint64_t(job.data.size() /
+				     out_format.GetFrameSize()) * 1000000u
+			/ out_format.sample_rate;
+		if (audio_us >= LOAD_PERIOD_US) {
+			load = unsigned(encode_us * 1000 / audio_us);
+			encode_us = audio_us = 0;
+		}
+
+		break;
+	}
+
+	case EncoderJob::Type::FLUSH:
+		success = encoder_flush(&encoder, _error);
+		break;
+
+	case EncoderJob::Type::PRE_TAG:
+		success = encoder_pre_tag(&encoder, _error);
+		pre_tag_failed = !success;
+		break;
+
+	case EncoderJob::Type::TAG:
+		if (pre_tag_failed)
+			break;
+
+		success = encoder_tag(&encoder, job.tag, _error);
+		break;
+
+	case EncoderJob::Type::END:
+		success = encoder_end(&encoder, _error);
+		break;
+	}
+
+	Drain(output);
+	return success;
+}
+
+inline void
+EncoderGroup::Run()
+{
+	SetThreadName("encoder");
+
+	const ScopeLock protect(mutex);
+
+	while (true) {
+		if (jobs.empty()) {
+			if (quit)
+				break;
+
+			cond.wait(mutex);
+			continue;
+		}
+
+		EncoderJob job = std::move(jobs.front());
+		jobs.pop_front();
+
+		std::vector<uint8_t> output;
+		Error job_error;
+		bool success = true;
+
+		if (!error.IsDefined()) {
+			mutex.unlock();
+			success = RunJob(job, output, job_error);
+			mutex.lock();
+		}
+
+		queued_bytes -= job.data.size();
+
+		if (!success)
+			error = std::move(job_error);
+
+		if (job.type == EncoderJob::Type::TAG)
+			/* the new stream begins with this header */
+			header = output;
+
+		log.Append(output.data(), output.size());
+
+		++n_done;
+		done_cond.broadcast();
+	}
+}
+
+Encoder *
+encoder_group_init(const EncoderPlugin &plugin, const ConfigBlock &block,
+		   Error &error)
+{
+	const char *name = block.GetBlockValue("encoder_group");
+	if (name == nullptr) {
+		if (!block.GetBlockValue("encoder_thread", false))
+			return encoder_init(plugin, block, error);
+
+		/* a private encoder thread: an anonymous group with
+		   only one member */
+		EncoderGroup *group =
+			EncoderGroup::Create("", plugin, block, error);
+		if (group == nullptr)
+			return nullptr;
+
+		const ScopeLock protect(encoder_groups_mutex);
+		return &group->NewSubscriber()->encoder;
+	}
+
+	const ScopeLock protect(encoder_groups_mutex);
+
+	EncoderGroup *group;
+	auto i = encoder_groups.find(name);
+	if (i == encoder_groups.end()) {
+		group = EncoderGroup::Create(name, plugin, block, error);
+		if (group == nullptr)
+			return nullptr;
+
+		encoder_groups.emplace(name, group);
+	} else {
+		group = i->second;
+		if (&group->GetPlugin() != &plugin) {
+			error.Format(encoder_group_domain,
+				     "Encoder group \"%s\" uses the encoder "
+				     "plugin \"%s\"",
+				     name, group->GetPlugin().name);
+			return nullptr;
+		}
+	}
+
+	return &group->NewSubscriber()->encoder;
+}
+
+unsigned
+encoder_get_load(const Encoder &encoder)
+{
+	if (encoder.plugin.open != shared_encoder_open)
+		return 0;
+
+	const SharedEncoder &s = (const SharedEncoder &)encoder;
+	return s.group.GetLoad();
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ENCODER_GROUP_HXX
+#define MPD_ENCODER_GROUP_HXX
+
+#include "Compiler.h"
+
+struct Encoder;
+struct EncoderPlugin;
+struct ConfigBlock;
+class Error;
+
+/**
+ * Creates a new encoder object for an audio output.
+ *
+ * If the configuration block has an "encoder_group" setting, all
+ * outputs which name the same group share one encoder: it is created
+ * from the settings of the first output, and it runs in its own
+ * thread.  The returned object is a proxy which feeds PCM data into
+ * the shared encoder and reads the shared encoded stream; an output
+ * which opens the proxy while others are already streaming receives
+ * the stream header first and then joins the live stream.
+ *
+ * With "encoder_thread", the output gets a private encoder thread
+ * (a group with only one member).  Without both settings, this is
+ * the same as encoder_init().
+ *
+ * Writes are queued for the encoder thread; if the queue exceeds
+ * "encoder_queue_size" (KiB), the writer blocks.
+ *
+ * @return an encoder object on success, nullptr on failure
+ */
+Encoder *
+encoder_group_init(const EncoderPlugin &plugin, const ConfigBlock &block,
+		   Error &error);
+
+/**
+ * Returns the real-time factor of a threaded encoder (the time spent
+ * encoding divided by the duration of the audio) in 1/1000, or 0 if
+ * the encoder does not run in its own thread or if it has not been
+ * measured yet.
+ */
+gcc_pure
+unsigned
+encoder_get_load(const Encoder &encoder);
+
+#endif
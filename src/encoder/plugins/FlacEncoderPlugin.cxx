@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "FlacEncoderPlugin.hxx"
+#include "FlacParallelEncoder.hxx"
 #include "../EncoderAPI.hxx"
 #include "AudioFormat.hxx"
 #include "pcm/PcmBuffer.hxx"
@@ -34,14 +35,30 @@
 #error libFLAC is too old
 #endif
 
+/**
+ * The upper limit for the "threads" setting.
+ */
+static constexpr unsigned FLAC_MAX_THREADS = 64;
+
 struct flac_encoder {
 	Encoder encoder;
 
 	AudioFormat audio_format;
 	unsigned compression;
 
+	/**
+	 * The number of worker threads; 1 means encode in the
+	 * caller's thread with #fse.
+	 */
+	unsigned threads;
+
 	FLAC__StreamEncoder *fse;
 
+	/**
+	 * Used instead of #fse if #threads is greater than 1.
+	 */
+	FlacParallelEncoder *parallel;
+
 	PcmBuffer expand_buffer;
 
 	/**
@@ -57,10 +74,18 @@ static constexpr Domain flac_encoder_domain("vorbis_encoder");
 
 static bool
 flac_encoder_configure(struct flac_encoder *encoder, const ConfigBlock &block,
-		       gcc_unused Error &error)
+		       Error &error)
 {
 	encoder->compression = block.GetBlockValue("compression", 5u);
 
+	encoder->threads = block.GetBlockValue("threads", 1u);
+	if (encoder->threads < 1 || encoder->threads > FLAC_MAX_THREADS) {
+		error.Format(config_domain,
+			     "Invalid number of flac threads: %u",
+			     encoder->threads);
+		return false;
+	}
+
 	return true;
 }
 
@@ -145,7 +170,10 @@ flac_encoder_close(Encoder *_encoder)
 {
 	struct flac_encoder *encoder = (struct flac_encoder *)_encoder;
 
-	FLAC__stream_encoder_delete(encoder->fse);
+	if (encoder->parallel != nullptr)
+		delete encoder->parallel;
+	else
+		FLAC__stream_encoder_delete(encoder->fse);
 
 	encoder->expand_buffer.Clear();
 	encoder->output_buffer.Destruct();
@@ -178,6 +206,25 @@ flac_encoder_open(Encoder *_encoder, AudioFormat &audio_format, Error &error)
 		audio_format.format = SampleFormat::S24_P32;
 	}
 
+	if (encoder->threads > 1) {
+		/* the stream header is generated together with the
+		   first segment */
+		encoder->parallel =
+			new FlacParallelEncoder(audio_format.channels,
+						bits_per_sample,
+						audio_format.sample_rate,
+						encoder->compression);
+		if (!encoder->parallel->Start(encoder->threads, error)) {
+			delete encoder->parallel;
+			return false;
+		}
+
+		encoder->output_buffer.Construct(8192);
+		return true;
+	}
+
+	encoder->parallel = nullptr;
+
 	/* allocate the encoder */
 	encoder->fse = FLAC__stream_encoder_new();
 	if (encoder->fse == nullptr) {
@@ -215,10 +262,14 @@ flac_encoder_open(Encoder *_encoder, AudioFormat &audio_format, Error &error)
 
 
 static bool
-flac_encoder_flush(Encoder *_encoder, gcc_unused Error &error)
+flac_encoder_flush(Encoder *_encoder, Error &error)
 {
 	struct flac_encoder *encoder = (struct flac_encoder *)_encoder;
 
+	if (encoder->parallel != nullptr)
+		return encoder->parallel->Finish(encoder->output_buffer.Get(),
+						 error);
+
 	(void) FLAC__stream_encoder_finish(encoder->fse);
 	return true;
 }
@@ -244,7 +295,7 @@ pcm16_to_flac(int32_t *out, const int16_t *in, unsigned num_samples)
 static bool
 flac_encoder_write(Encoder *_encoder,
 		   const void *data, size_t length,
-		   gcc_unused Error &error)
+		   Error &error)
 {
 	struct flac_encoder *encoder = (struct flac_encoder *)_encoder;
 	unsigned num_frames, num_samples;
@@ -256,6 +307,14 @@ flac_encoder_write(Encoder *_encoder,
 	num_frames = length / encoder->audio_format.GetFrameSize();
 	num_samples = num_frames * encoder->audio_format.channels;
 
+	if (encoder->parallel != nullptr)
+		/* the samples are converted while they are copied
+		   into the segment buffer */
+		return encoder->parallel->Write(data, num_frames,
+						encoder->audio_format.format,
+						encoder->output_buffer.Get(),
+						error);
+
 	switch (encoder->audio_format.format) {
 	case SampleFormat::S8:
 		exbuffer = encoder->expand_buffer.Get(length * 4);
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "FlacFrame.hxx"
+
+#include <string.h>
+
+namespace {
+
+struct FlacCrcTables {
+	uint8_t crc8[256];
+	uint16_t crc16[256];
+
+	FlacCrcTables() {
+		for (unsigned i = 0; i < 256; ++i) {
+			unsigned c8 = i, c16 = i << 8;
+			for (unsigned j = 0; j < 8; ++j) {
+				c8 = c8 & 0x80 ? (c8 << 1) ^ 0x07 : c8 << 1;
+				c16 = c16 & 0x8000
+					? (c16 << 1) ^ 0x8005
+					: c16 << 1;
+			}
+
+			crc8[i] = uint8_t(c8);
+			crc16[i] = uint16_t(c16);
+		}
+	}
+};
+
+}
+
+static const FlacCrcTables &
+GetFlacCrcTables()
+{
+	static const FlacCrcTables tables;
+	return tables;
+}
+
+uint8_t
+FlacCrc8(const uint8_t *data, size_t size)
+{
+	const auto &table = GetFlacCrcTables().crc8;
+
+	uint8_t crc = 0;
+	while (size-- > 0)
+		crc = table[crc ^ *data++];
+	return crc;
+}
+
+uint16_t
+FlacCrc16(const uint8_t *data, size_t size)
+{
+	const auto &table = GetFlacCrcTables().crc16;
+
+	uint16_t crc = 0;
+	while (size-- > 0)
+		crc = uint16_t(crc << 8) ^ table[(crc >> 8) ^ *data++];
+	return crc;
+}
+
+/**
+ * Write a frame number in the "UTF-8" coding used by FLAC.
+ *
+ * @return the number of bytes written (1 to 6)
+ */
+static size_t
+WriteFlacUtf8(uint8_t *p, uint32_t value)
+{
+	if (value < 0x80) {
+		p[0] = uint8_t(value);
+		return 1;
+	}
+
+	size_t n;
+	if (value < 0x800)
+		n = 2;
+	else if (value < 0x10000)
+		n = 3;
+	else if (value < 0x200000)
+		n = 4;
+	else if (value < 0x4000000)
+		n = 5;
+	else
+		n = 6;
+
+	for (size_t i = n - 1; i > 0; --i) {
+		p[i] = uint8_t(0x80 | (value & 0x3f));
+		value >>= 6;
+	}
+
+	p[0] = uint8_t((0xff00 >> n) | value);
+	return n;
+}
+
+/**
+ * Determine the length of a "UTF-8" coded number from its first
+ * byte.
+ *
+ * @return the length or 0 if the byte is invalid
+ */
+gcc_const
+static size_t
+GetFlacUtf8Length(uint8_t first)
+{
+	if ((first & 0x80) == 0)
+		return 1;
+
+	size_t n = 0;
+	while (first & 0x80) {
+		++n;
+		first <<= 1;
+	}
+
+	return n >= 2 && n <= 7 ? n : 0;
+}
+
+bool
+FlacAppendRenumberedFrame(std::vector<uint8_t> &dest,
+			  const uint8_t *src, size_t size,
+			  uint32_t frame_number)
+{
+	/* sync code and "fixed block size" strategy */
+	if (size < 5 || src[0] != 0xff || src[1] != 0xf8)
+		return false;
+
+	const size_t number_length = GetFlacUtf8Length(src[4]);
+	if (number_length == 0)
+		return false;
+
+	/* the optional block size and sample rate fields */
+	const unsigned block_size_code = src[2] >> 4;
+	const unsigned sample_rate_code = src[2] & 0xf;
+	size_t extra = 0;
+	if (block_size_code == 6)
+		extra += 1;
+	else if (block_size_code == 7)
+		extra += 2;
+
+	if (sample_rate_code == 12)
+		extra += 1;
+	else if (sample_rate_code == 13 || sample_rate_code == 14)
+		extra += 2;
+
+	/* the header, its CRC-8 and the frame's CRC-16 */
+	const size_t old_header_size = 4 + number_length + extra;
+	if (size < old_header_size + 1 + 2)
+		return false;
+
+	uint8_t header[4 + 6 + 4 + 1];
+	memcpy(header, src, 4);
+	size_t header_size = 4 + WriteFlacUtf8(header + 4, frame_number);
+	memcpy(header + header_size, src + 4 + number_length, extra);
+	header_size += extra;
+	header[header_size] = FlacCrc8(header, header_size);
+	++header_size;
+
+	const uint8_t *body = src + old_header_size + 1;
+	const size_t body_size = size - old_header_size - 1 - 2;
+
+	const size_t start = dest.size();
+	dest.insert(dest.end(), header, header + header_size);
+	dest.insert(dest.end(), body, body + body_size);
+
+	const uint16_t crc = FlacCrc16(dest.data() + start,
+				       dest.size() - start);
+	dest.push_back(uint8_t(crc >> 8));
+	dest.push_back(uint8_t(crc));
+	return true;
+}
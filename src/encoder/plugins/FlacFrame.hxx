@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_FLAC_FRAME_HXX
+#define MPD_FLAC_FRAME_HXX
+
+#include "Compiler.h"
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Calculate the CRC-8 of a FLAC frame header (polynomial 0x07).
+ */
+gcc_pure
+uint8_t
+FlacCrc8(const uint8_t *data, size_t size);
+
+/**
+ * Calculate the CRC-16 of a FLAC frame (polynomial 0x8005).
+ */
+gcc_pure
+uint16_t
+FlacCrc16(const uint8_t *data, size_t size);
+
+/**
+ * Append a copy of a FLAC frame with a fixed block size to the
+ * buffer, replacing its frame number.  The frame header is resized
+ * if needed, and both CRCs are recalculated.
+ *
+ * This allows concatenating frames which were encoded by separate
+ * libFLAC encoder instances, each of which begins counting at zero.
+ *
+ * @return false if the frame is malformed or does not use a fixed
+ * block size
+ */
+bool
+FlacAppendRenumberedFrame(std::vector<uint8_t> &dest,
+			  const uint8_t *src, size_t size,
+			  uint32_t frame_number);
+
+#endif
@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "FlacParallelEncoder.hxx"
+#include "FlacFrame.hxx"
+#include "thread/Name.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#include <assert.h>
+#include <string.h>
+
+static constexpr Domain flac_parallel_domain("flac_parallel");
+
+/**
+ * The number of FLAC frames per segment.  Larger segments reduce the
+ * overhead of restarting the libFLAC encoder, smaller ones reduce
+ * the latency and the memory usage.
+ */
+static constexpr unsigned FLAC_SEGMENT_BLOCKS = 16;
+
+namespace {
+
+struct FlacWriteContext {
+	std::vector<uint8_t> &output;
+
+	const uint32_t first_frame;
+
+	const bool header;
+
+	bool success = true;
+
+	FlacWriteContext(std::vector<uint8_t> &_output,
+			 uint32_t _first_frame, bool _header)
+		:output(_output), first_frame(_first_frame),
+		 header(_header) {}
+};
+
+}
+
+FlacParallelEncoder::FlacParallelEncoder(unsigned _channels,
+					 unsigned _bits_per_sample,
+					 unsigned _sample_rate,
+					 unsigned _compression)
+	:channels(_channels), bits_per_sample(_bits_per_sample),
+	 sample_rate(_sample_rate), compression(_compression),
+	 quit(false),
+	 filling(nullptr), next_frame(0),
+	 header_done(false), finished(false)
+{
+}
+
+FlacParallelEncoder::~FlacParallelEncoder()
+{
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (auto &worker : workers) {
+		if (worker.thread.IsDefined())
+			worker.thread.Join();
+		FLAC__stream_encoder_delete(worker.fse);
+	}
+
+	for (Job *job : jobs)
+		delete job;
+	for (Job *job : free_jobs)
+		delete job;
+	delete filling;
+}
+
+bool
+FlacParallelEncoder::Setup(FLAC__StreamEncoder *fse) const
+{
+	return FLAC__stream_encoder_set_compression_level(fse, compression) &&
+		FLAC__stream_encoder_set_channels(fse, channels) &&
+		FLAC__stream_encoder_set_bits_per_sample(fse,
+							 bits_per_sample) &&
+		FLAC__stream_encoder_set_sample_rate(fse, sample_rate);
+}
+
+bool
+FlacParallelEncoder::Start(unsigned n_threads, Error &error)
+{
+	assert(n_threads > 0);
+	assert(workers.empty());
+
+	for (unsigned i = 0; i < n_threads; ++i) {
+		FLAC__StreamEncoder *fse = FLAC__stream_encoder_new();
+		if (fse == nullptr) {
+			error.Set(flac_parallel_domain, "flac_new() failed");
+			return false;
+		}
+
+		workers.emplace_front(*this, fse);
+	}
+
+	/* the block size depends on the compression level */
+	FLAC__StreamEncoder *fse = workers.front().fse;
+	if (!Setup(fse)) {
+		error.Set(flac_parallel_domain,
+			  "failed to configure the flac encoder");
+		return false;
+	}
+
+	block_size = FLAC__stream_encoder_get_blocksize(fse);
+	segment_frames = block_size * FLAC_SEGMENT_BLOCKS;
+
+	/* two jobs per thread: one being encoded, one being filled
+	   or waiting */
+	for (unsigned i = 0; i < 2 * n_threads; ++i) {
+		Job *job = new Job();
+		job->samples.resize(segment_frames * channels);
+		free_jobs.push_back(job);
+	}
+
+	for (auto &worker : workers)
+		if (!worker.thread.Start(Run, &worker, error))
+			return false;
+
+	return true;
+}
+
+FlacParallelEncoder::Job *
+FlacParallelEncoder::GetFreeJob(DynamicFifoBuffer<uint8_t> &output,
+				Error &error)
+{
+	while (free_jobs.empty()) {
+		assert(!jobs.empty());
+
+		if (!Collect(output, false, error))
+			return nullptr;
+
+		if (free_jobs.empty())
+			done_cond.wait(mutex);
+	}
+
+	Job *job = free_jobs.back();
+	free_jobs.pop_back();
+	return job;
+}
+
+void
+FlacParallelEncoder::Submit()
+{
+	assert(filling != nullptr);
+	assert(filling->n_frames > 0);
+
+	filling->first_frame = next_frame;
+	filling->header = !header_done;
+	filling->state = Job::State::QUEUED;
+
+	next_frame += (filling->n_frames + block_size - 1) / block_size;
+	header_done = true;
+
+	const ScopeLock protect(mutex);
+	jobs.push_back(filling);
+	filling = nullptr;
+	cond.signal();
+}
+
+bool
+FlacParallelEncoder::Collect(DynamicFifoBuffer<uint8_t> &output, bool wait,
+			     Error &error)
+{
+	while (!jobs.empty()) {
+		Job *job = jobs.front();
+		if (job->state != Job::State::DONE) {
+			if (!wait)
+				break;
+
+			done_cond.wait(mutex);
+			continue;
+		}
+
+		jobs.pop_front();
+
+		const bool success = job->success;
+		if (success)
+			output.Append(job->output.data(),
+				      job->output.size());
+
+		job->output.clear();
+		free_jobs.push_back(job);
+
+		if (!success) {
+			error.Set(flac_parallel_domain,
+				  "flac encoder process failed");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Copy samples into the segment buffer, expanding them to 32 bit.
+ */
+static void
+ConvertToFlac(FLAC__int32 *dest, const void *src, size_t n,
+	      SampleFormat format)
+{
+	switch (format) {
+	case SampleFormat::S8: {
+		const int8_t *p = (const int8_t *)src;
+		for (size_t i = 0; i < n; ++i)
+			dest[i] = p[i];
+		break;
+	}
+
+	case SampleFormat::S16: {
+		const int16_t *p = (const int16_t *)src;
+		for (size_t i = 0; i < n; ++i)
+			dest[i] = p[i];
+		break;
+	}
+
+	default:
+		/* S24_P32: same layout */
+		memcpy(dest, src, n * sizeof(*dest));
+		break;
+	}
+}
+
+bool
+FlacParallelEncoder::Write(const void *data, unsigned n_frames,
+			   SampleFormat format,
+			   DynamicFifoBuffer<uint8_t> &output, Error &error)
+{
+	if (finished) {
+		error.Set(flac_parallel_domain,
+			  "flac encoder process failed");
+		return false;
+	}
+
+	const size_t frame_size = channels * sample_format_size(format);
+	const uint8_t *p = (const uint8_t *)data;
+
+	while (n_frames > 0) {
+		if (filling == nullptr) {
+			const ScopeLock protect(mutex);
+			filling = GetFreeJob(output, error);
+			if (filling == nullptr)
+				return false;
+
+			filling->n_frames = 0;
+			filling->state = Job::State::FILLING;
+		}
+
+		unsigned n = segment_frames - filling->n_frames;
+		if (n > n_frames)
+			n = n_frames;
+
+		ConvertToFlac(filling->samples.data() +
+			      filling->n_frames * channels,
+			      p, n * channels, format);
+		filling->n_frames += n;
+		p += n * frame_size;
+		n_frames -= n;
+
+		if (filling->n_frames == segment_frames)
+			Submit();
+	}
+
+	const ScopeLock protect(mutex);
+	return Collect(output, false, error);
+}
+
+bool
+FlacParallelEncoder::Finish(DynamicFifoBuffer<uint8_t> &output,
+			    Error &error)
+{
+	if (filling != nullptr && filling->n_frames > 0)
+		Submit();
+
+	finished = true;
+
+	const ScopeLock protect(mutex);
+	return Collect(output, true, error);
+}
+
+FLAC__StreamEncoderWriteStatus
+FlacParallelEncoder::WriteCallback(gcc_unused const FLAC__StreamEncoder *fse,
+				   const FLAC__byte data[],
+				   size_t bytes, unsigned samples,
+				   unsigned current_frame, void *client_data)
+{
+	FlacWriteContext &ctx = *(FlacWriteContext *)client_data;
+
+	if (samples == 0) {
+		/* the stream header and the metadata blocks */
+		if (ctx.header)
+			ctx.output.insert(ctx.output.end(),
+					  data, data + bytes);
+	} else if (!FlacAppendRenumberedFrame(ctx.output, data, bytes,
+					      ctx.first_frame +
+					      current_frame)) {
+		ctx.success = false;
+		return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+	}
+
+	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+inline void
+FlacParallelEncoder::Encode(FLAC__StreamEncoder *fse, Job &job)
+{
+	FlacWriteContext ctx(job.output, job.first_frame, job.header);
+
+	/* FLAC__stream_encoder_finish() resets the settings, so they
+	   must be applied again for each segment */
+	job.success = Setup(fse) &&
+		FLAC__stream_encoder_init_stream(fse, WriteCallback,
+						 nullptr, nullptr, nullptr,
+						 &ctx) == FLAC__STREAM_ENCODER_INIT_STATUS_OK;
+	if (!job.success)
+		return;
+
+	job.success = FLAC__stream_encoder_process_interleaved(fse,
+							      job.samples.data(),
+							      job.n_frames);
+	job.success = FLAC__stream_encoder_finish(fse) && job.success &&
+		ctx.success;
+}
+
+inline void
+FlacParallelEncoder::Run(Worker &worker)
+{
+	SetThreadName("flac");
+
+	const ScopeLock protect(mutex);
+
+	while (true) {
+		Job *job = nullptr;
+		for (Job *i : jobs) {
+			if (i->state == Job::State::QUEUED) {
+				job = i;
+				break;
+			}
+		}
+
+		if (job == nullptr) {
+			if (quit)
+				break;
+
+			cond.wait(mutex);
+			continue;
+		}
+
+		job->state = Job::State::ENCODING;
+		mutex.unlock();
+
+		Encode(worker.fse, *job);
+
+		mutex.lock();
+		job->state = Job::State::DONE;
+		done_cond.broadcast();
+	}
+}
+
+void
+FlacParallelEncoder::Run(void *ctx)
+{
+	Worker &worker = *(Worker *)ctx;
+	worker.parent.Run(worker);
+}
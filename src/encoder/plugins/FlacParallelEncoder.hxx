@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_FLAC_PARALLEL_ENCODER_HXX
+#define MPD_FLAC_PARALLEL_ENCODER_HXX
+
+#include "check.h"
+#include "AudioFormat.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "util/DynamicFifoBuffer.hxx"
+
+#include <FLAC/stream_encoder.h>
+
+#include <deque>
+#include <forward_list>
+#include <vector>
+
+#include <stdint.h>
+
+class Error;
+
+/**
+ * Encodes FLAC with several libFLAC stream encoders in worker
+ * threads.  The input is split into segments of whole blocks; each
+ * segment is encoded by one worker as a separate stream.  The frames
+ * are then renumbered and concatenated in order, and only the first
+ * segment's stream header is kept.  FLAC frames do not depend on each
+ * other, so the result is a valid stream.
+ */
+class FlacParallelEncoder {
+	struct Job {
+		/**
+		 * The interleaved input samples.
+		 */
+		std::vector<FLAC__int32> samples;
+
+		/**
+		 * The number of PCM frames in #samples.
+		 */
+		unsigned n_frames;
+
+		/**
+		 * The FLAC frame number of this segment's first
+		 * frame.
+		 */
+		uint32_t first_frame;
+
+		/**
+		 * Keep the stream header?  Only for the first
+		 * segment.
+		 */
+		bool header;
+
+		enum class State {
+			FILLING,
+			QUEUED,
+			ENCODING,
+			DONE,
+		} state;
+
+		bool success;
+
+		std::vector<uint8_t> output;
+	};
+
+	struct Worker {
+		FlacParallelEncoder &parent;
+
+		FLAC__StreamEncoder *const fse;
+
+		Thread thread;
+
+		Worker(FlacParallelEncoder &_parent,
+		       FLAC__StreamEncoder *_fse)
+			:parent(_parent), fse(_fse) {}
+	};
+
+	const unsigned channels, bits_per_sample, sample_rate;
+	const unsigned compression;
+
+	/**
+	 * The number of PCM frames per FLAC frame.
+	 */
+	unsigned block_size;
+
+	/**
+	 * The number of PCM frames per #Job; a multiple of
+	 * #block_size, because only the last FLAC frame of a stream
+	 * may be short.
+	 */
+	unsigned segment_frames;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a job was queued or when the workers shall
+	 * quit.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled by a worker when a job is done.
+	 */
+	Cond done_cond;
+
+	/**
+	 * Submitted jobs in stream order.  Protected by #mutex.
+	 */
+	std::deque<Job *> jobs;
+
+	/**
+	 * Unused jobs.  Protected by #mutex.
+	 */
+	std::vector<Job *> free_jobs;
+
+	std::forward_list<Worker> workers;
+
+	bool quit;
+
+	/* the following attributes are used only by the caller */
+
+	/**
+	 * The job which is being filled by Write().
+	 */
+	Job *filling;
+
+	uint32_t next_frame;
+
+	/**
+	 * Has the stream header been generated already?
+	 */
+	bool header_done;
+
+	/**
+	 * Has the stream been finished with Finish()?  Only the last
+	 * FLAC frame may be short, so no more data can be appended.
+	 */
+	bool finished;
+
+public:
+	FlacParallelEncoder(unsigned _channels, unsigned _bits_per_sample,
+			    unsigned _sample_rate, unsigned _compression);
+
+	/**
+	 * Stops the worker threads and discards pending data.
+	 */
+	~FlacParallelEncoder();
+
+	FlacParallelEncoder(const FlacParallelEncoder &) = delete;
+	FlacParallelEncoder &operator=(const FlacParallelEncoder &) = delete;
+
+	/**
+	 * Start the worker threads.
+	 */
+	bool Start(unsigned n_threads, Error &error);
+
+	/**
+	 * Append PCM data.  Finished segments are moved to #output.
+	 *
+	 * @param format the sample format: #SampleFormat::S8,
+	 * #SampleFormat::S16 or #SampleFormat::S24_P32; samples are
+	 * converted while they are copied into the segment buffer
+	 */
+	bool Write(const void *data, unsigned n_frames, SampleFormat format,
+		   DynamicFifoBuffer<uint8_t> &output, Error &error);
+
+	/**
+	 * Encode the pending data (which ends with a short FLAC
+	 * frame), wait for all workers and move the rest to #output.
+	 */
+	bool Finish(DynamicFifoBuffer<uint8_t> &output, Error &error);
+
+private:
+	/**
+	 * Configure a libFLAC encoder with our settings.
+	 */
+	bool Setup(FLAC__StreamEncoder *fse) const;
+
+	/**
+	 * Obtain an unused job, collecting finished jobs (and
+	 * waiting for them if necessary).  Caller must hold the
+	 * mutex.
+	 */
+	Job *GetFreeJob(DynamicFifoBuffer<uint8_t> &output, Error &error);
+
+	/**
+	 * Queue the #filling job.
+	 */
+	void Submit();
+
+	/**
+	 * Move the output of all finished jobs at the front of #jobs
+	 * to #output.  Caller must hold the mutex.
+	 *
+	 * @param wait wait until all jobs are done?
+	 */
+	bool Collect(DynamicFifoBuffer<uint8_t> &output, bool wait,
+		     Error &error);
+
+	void Encode(FLAC__StreamEncoder *fse, Job &job);
+
+	void Run(Worker &worker);
+	static void Run(void *ctx);
+
+	static FLAC__StreamEncoderWriteStatus
+	WriteCallback(const FLAC__StreamEncoder *fse,
+		      const FLAC__byte data[],
+		      size_t bytes, unsigned samples,
+		      unsigned current_frame, void *client_data);
+};
+
+#endif
@@ -28,12 +28,27 @@
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "system/ByteOrder.hxx"
+#include "Compiler.h"
 
 #include <opus.h>
+#include <opus_multistream.h>
 #include <ogg/ogg.h>
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+
+/**
+ * The maximum number of channels; more are mixed down to stereo.
+ * This is the limit of the Vorbis channel mapping (RFC 7845 5.1.1.2).
+ */
+static constexpr unsigned OPUS_MAX_CHANNELS = 8;
+
+/**
+ * The maximum size of one Opus packet per elementary stream (RFC
+ * 6716 3.2.5).
+ */
+static constexpr size_t OPUS_MAX_PACKET_SIZE = 1275 * 3 + 7;
 
 struct opus_encoder {
 	/** the base class */
@@ -44,6 +59,18 @@ struct opus_encoder {
 	opus_int32 bitrate;
 	int complexity;
 	int signal;
+	int application;
+
+	/**
+	 * The number of 48 kHz frames per Opus packet.
+	 */
+	unsigned packet_frames;
+
+	/**
+	 * Flush an Ogg page after this number of packets (0 = let
+	 * libogg decide, based on the page size).
+	 */
+	unsigned packets_per_page;
 
 	/* runtime information */
 
@@ -54,9 +81,24 @@ struct opus_encoder {
 	size_t buffer_frames, buffer_size, buffer_position;
 	uint8_t *buffer;
 
-	OpusEncoder *enc;
+	OpusMSEncoder *enc;
+
+	/**
+	 * The channel mapping family (RFC 7845 5.1.1.2): 0 for mono
+	 * and stereo, 1 for surround.
+	 */
+	int mapping_family;
+	int streams, coupled_streams;
+	unsigned char mapping[OPUS_MAX_CHANNELS];
 
-	unsigned char buffer2[1275 * 3 + 7];
+	/**
+	 * If not nullptr, then the input channels must be reordered
+	 * from MPD's channel order to the Vorbis channel order: the
+	 * Vorbis channel i is MPD's channel reorder[i].
+	 */
+	const unsigned char *reorder;
+
+	unsigned char buffer2[OPUS_MAX_CHANNELS * OPUS_MAX_PACKET_SIZE];
 
 	OggStream stream;
 
@@ -66,6 +108,11 @@ struct opus_encoder {
 
 	ogg_int64_t granulepos;
 
+	/**
+	 * The number of packets in the current Ogg page.
+	 */
+	unsigned page_packets;
+
 	opus_encoder():encoder(opus_encoder_plugin) {}
 };
 
@@ -108,6 +155,37 @@ opus_encoder_configure(struct opus_encoder *encoder,
 		return false;
 	}
 
+	value = block.GetBlockValue("application", "audio");
+	if (strcmp(value, "audio") == 0)
+		encoder->application = OPUS_APPLICATION_AUDIO;
+	else if (strcmp(value, "voip") == 0)
+		encoder->application = OPUS_APPLICATION_VOIP;
+	else if (strcmp(value, "lowdelay") == 0)
+		encoder->application = OPUS_APPLICATION_RESTRICTED_LOWDELAY;
+	else {
+		error.Format(config_domain, "Invalid application");
+		return false;
+	}
+
+	/* the frame duration in milliseconds; Opus supports 2.5,
+	   5, 10, 20, 40 and 60 ms */
+	value = block.GetBlockValue("frame_duration", "20");
+	char *endptr;
+	const double duration = strtod(value, &endptr);
+	encoder->packet_frames = unsigned(duration * 48);
+	if (endptr == value || *endptr != 0 ||
+	    double(encoder->packet_frames) != duration * 48 ||
+	    (encoder->packet_frames != 120 && encoder->packet_frames != 240 &&
+	     encoder->packet_frames != 480 && encoder->packet_frames != 960 &&
+	     encoder->packet_frames != 1920 &&
+	     encoder->packet_frames != 2880)) {
+		error.Format(config_domain, "Invalid frame duration");
+		return false;
+	}
+
+	encoder->packets_per_page =
+		block.GetBlockValue("packets_per_page", 0u);
+
 	return true;
 }
 
@@ -136,6 +214,53 @@ opus_encoder_finish(Encoder *_encoder)
 	delete encoder;
 }
 
+/**
+ * Translate MPD's channel order (like WAVE_FORMAT_EXTENSIBLE) to the
+ * Vorbis channel order which is used by the Opus channel mapping
+ * family 1.  Returns nullptr if both are the same.
+ */
+gcc_const
+static const unsigned char *
+GetVorbisChannelReorder(unsigned channels)
+{
+	/* FL FR FC -> FL FC FR */
+	static constexpr unsigned char reorder3[] = { 0, 2, 1 };
+
+	/* FL FR FC BL BR -> FL FC FR BL BR */
+	static constexpr unsigned char reorder5[] = { 0, 2, 1, 3, 4 };
+
+	/* FL FR FC LFE BL BR -> FL FC FR BL BR LFE */
+	static constexpr unsigned char reorder6[] = { 0, 2, 1, 4, 5, 3 };
+
+	/* FL FR FC LFE BC SL SR -> FL FC FR SL SR BC LFE */
+	static constexpr unsigned char reorder7[] = { 0, 2, 1, 5, 6, 4, 3 };
+
+	/* FL FR FC LFE BL BR SL SR -> FL FC FR SL SR BL BR LFE */
+	static constexpr unsigned char reorder8[] = {
+		0, 2, 1, 6, 7, 4, 5, 3,
+	};
+
+	switch (channels) {
+	case 3:
+		return reorder3;
+
+	case 5:
+		return reorder5;
+
+	case 6:
+		return reorder6;
+
+	case 7:
+		return reorder7;
+
+	case 8:
+		return reorder8;
+
+	default:
+		return nullptr;
+	}
+}
+
 static bool
 opus_encoder_open(Encoder *_encoder,
 		  AudioFormat &audio_format,
@@ -146,8 +271,8 @@ opus_encoder_open(Encoder *_encoder,
 	/* libopus supports only 48 kHz */
 	audio_format.sample_rate = 48000;
 
-	if (audio_format.channels > 2)
-		audio_format.channels = 1;
+	if (audio_format.channels > OPUS_MAX_CHANNELS)
+		audio_format.channels = 2;
 
 	switch (audio_format.format) {
 	case SampleFormat::S16:
@@ -166,31 +291,47 @@ opus_encoder_open(Encoder *_encoder,
 	encoder->audio_format = audio_format;
 	encoder->frame_size = audio_format.GetFrameSize();
 
+	/* mono and stereo use one elementary stream (mapping family
+	   0); surround uses the libopus surround encoder, which
+	   allocates coupled stereo streams for channel pairs */
+	encoder->mapping_family = audio_format.channels > 2 ? 1 : 0;
+	encoder->reorder = GetVorbisChannelReorder(audio_format.channels);
+
 	int error_code;
-	encoder->enc = opus_encoder_create(audio_format.sample_rate,
-					   audio_format.channels,
-					   OPUS_APPLICATION_AUDIO,
-					   &error_code);
+	encoder->enc =
+		opus_multistream_surround_encoder_create(audio_format.sample_rate,
+							 audio_format.channels,
+							 encoder->mapping_family,
+							 &encoder->streams,
+							 &encoder->coupled_streams,
+							 encoder->mapping,
+							 encoder->application,
+							 &error_code);
 	if (encoder->enc == nullptr) {
 		error.Set(opus_encoder_domain, error_code,
 			  opus_strerror(error_code));
 		return false;
 	}
 
-	opus_encoder_ctl(encoder->enc, OPUS_SET_BITRATE(encoder->bitrate));
-	opus_encoder_ctl(encoder->enc,
-			 OPUS_SET_COMPLEXITY(encoder->complexity));
-	opus_encoder_ctl(encoder->enc, OPUS_SET_SIGNAL(encoder->signal));
+	opus_multistream_encoder_ctl(encoder->enc,
+				     OPUS_SET_BITRATE(encoder->bitrate));
+	opus_multistream_encoder_ctl(encoder->enc,
+				     OPUS_SET_COMPLEXITY(encoder->complexity));
+	opus_multistream_encoder_ctl(encoder->enc,
+				     OPUS_SET_SIGNAL(encoder->signal));
 
-	opus_encoder_ctl(encoder->enc, OPUS_GET_LOOKAHEAD(&encoder->lookahead));
+	opus_multistream_encoder_ctl(encoder->enc,
+				     OPUS_GET_LOOKAHEAD(&encoder->lookahead));
 
-	encoder->buffer_frames = audio_format.sample_rate / 50;
+	encoder->buffer_frames = encoder->packet_frames;
 	encoder->buffer_size = encoder->frame_size * encoder->buffer_frames;
 	encoder->buffer_position = 0;
 	encoder->buffer = (unsigned char *)xalloc(encoder->buffer_size);
 
 	encoder->stream.Initialize(GenerateOggSerial());
 	encoder->packetno = 0;
+	encoder->granulepos = 0;
+	encoder->page_packets = 0;
 
 	return true;
 }
@@ -202,27 +343,55 @@ opus_encoder_close(Encoder *_encoder)
 
 	encoder->stream.Deinitialize();
 	free(encoder->buffer);
-	opus_encoder_destroy(encoder->enc);
+	opus_multistream_encoder_destroy(encoder->enc);
 }
 
-static bool
-opus_encoder_do_encode(struct opus_encoder *encoder, bool eos,
-		       Error &error)
+/**
+ * Convert the frames in #buffer to the Vorbis channel order.
+ */
+static void
+opus_encoder_reorder(struct opus_encoder *encoder)
 {
-	assert(encoder->buffer_position == encoder->buffer_size);
+	const unsigned channels = encoder->audio_format.channels;
+	const size_t sample_size = encoder->frame_size / channels;
+
+	uint8_t frame[OPUS_MAX_CHANNELS * sizeof(float)];
+
+	uint8_t *p = encoder->buffer;
+	for (size_t i = 0; i < encoder->buffer_frames; ++i) {
+		memcpy(frame, p, encoder->frame_size);
+
+		for (unsigned c = 0; c < channels; ++c)
+			memcpy(p + c * sample_size,
+			       frame + encoder->reorder[c] * sample_size,
+			       sample_size);
+
+		p += encoder->frame_size;
+	}
+}
 
+/**
+ * Encode one packet of #buffer_frames frames.
+ *
+ * @param pcm the input, either #buffer or (to avoid copying) the
+ * caller's buffer
+ */
+static bool
+opus_encoder_do_encode(struct opus_encoder *encoder, const void *pcm,
+		       bool eos, Error &error)
+{
 	opus_int32 result =
 		encoder->audio_format.format == SampleFormat::S16
-		? opus_encode(encoder->enc,
-			      (const opus_int16 *)encoder->buffer,
-			      encoder->buffer_frames,
-			      encoder->buffer2,
-			      sizeof(encoder->buffer2))
-		: opus_encode_float(encoder->enc,
-				    (const float *)encoder->buffer,
-				    encoder->buffer_frames,
-				    encoder->buffer2,
-				    sizeof(encoder->buffer2));
+		? opus_multistream_encode(encoder->enc,
+					  (const opus_int16 *)pcm,
+					  encoder->buffer_frames,
+					  encoder->buffer2,
+					  sizeof(encoder->buffer2))
+		: opus_multistream_encode_float(encoder->enc,
+						(const float *)pcm,
+						encoder->buffer_frames,
+						encoder->buffer2,
+						sizeof(encoder->buffer2));
 	if (result < 0) {
 		error.Set(opus_encoder_domain, "Opus encoder error");
 		return false;
@@ -239,11 +408,34 @@ opus_encoder_do_encode(struct opus_encoder *encoder, bool eos,
 	packet.packetno = encoder->packetno++;
 	encoder->stream.PacketIn(packet);
 
-	encoder->buffer_position = 0;
+	if (encoder->packets_per_page > 0 &&
+	    ++encoder->page_packets >= encoder->packets_per_page) {
+		/* emit the page now instead of waiting until it is
+		   full, to reduce the stream latency */
+		encoder->stream.Flush();
+		encoder->page_packets = 0;
+	}
 
 	return true;
 }
 
+/**
+ * Encode the full #buffer.
+ */
+static bool
+opus_encoder_encode_buffer(struct opus_encoder *encoder, bool eos,
+			   Error &error)
+{
+	assert(encoder->buffer_position == encoder->buffer_size);
+
+	if (encoder->reorder != nullptr)
+		opus_encoder_reorder(encoder);
+
+	encoder->buffer_position = 0;
+
+	return opus_encoder_do_encode(encoder, encoder->buffer, eos, error);
+}
+
 static bool
 opus_encoder_end(Encoder *_encoder, Error &error)
 {
@@ -255,7 +447,7 @@ opus_encoder_end(Encoder *_encoder, Error &error)
 	       encoder->buffer_size - encoder->buffer_position);
 	encoder->buffer_position = encoder->buffer_size;
 
-	return opus_encoder_do_encode(encoder, true, error);
+	return opus_encoder_encode_buffer(encoder, true, error);
 }
 
 static bool
@@ -285,7 +477,7 @@ opus_encoder_write_silence(struct opus_encoder *encoder, unsigned fill_frames,
 		fill_bytes -= nbytes;
 
 		if (encoder->buffer_position == encoder->buffer_size &&
-		    !opus_encoder_do_encode(encoder, false, error))
+		    !opus_encoder_encode_buffer(encoder, false, error))
 			return false;
 	}
 
@@ -313,6 +505,38 @@ opus_encoder_write(Encoder *_encoder,
 		encoder->lookahead = 0;
 	}
 
+	if (encoder->reorder == nullptr) {
+		if (encoder->buffer_position > 0) {
+			/* complete the packet in the buffer first */
+			size_t nbytes = encoder->buffer_size -
+				encoder->buffer_position;
+			if (nbytes > length)
+				nbytes = length;
+
+			memcpy(encoder->buffer + encoder->buffer_position,
+			       data, nbytes);
+			data += nbytes;
+			length -= nbytes;
+			encoder->buffer_position += nbytes;
+
+			if (encoder->buffer_position == encoder->buffer_size &&
+			    !opus_encoder_encode_buffer(encoder, false, error))
+				return false;
+		}
+
+		/* encode whole packets directly from the caller's
+		   buffer */
+		while (encoder->buffer_position == 0 &&
+		       length >= encoder->buffer_size) {
+			if (!opus_encoder_do_encode(encoder, data,
+						    false, error))
+				return false;
+
+			data += encoder->buffer_size;
+			length -= encoder->buffer_size;
+		}
+	}
+
 	while (length > 0) {
 		size_t nbytes =
 			encoder->buffer_size - encoder->buffer_position;
@@ -326,7 +550,7 @@ opus_encoder_write(Encoder *_encoder,
 		encoder->buffer_position += nbytes;
 
 		if (encoder->buffer_position == encoder->buffer_size &&
-		    !opus_encoder_do_encode(encoder, false, error))
+		    !opus_encoder_encode_buffer(encoder, false, error))
 			return false;
 	}
 
@@ -336,20 +560,31 @@ opus_encoder_write(Encoder *_encoder,
 static void
 opus_encoder_generate_head(struct opus_encoder *encoder)
 {
-	unsigned char header[19];
+	const unsigned channels = encoder->audio_format.channels;
+
+	unsigned char header[21 + OPUS_MAX_CHANNELS];
 	memcpy(header, "OpusHead", 8);
 	header[8] = 1;
-	header[9] = encoder->audio_format.channels;
+	header[9] = channels;
 	*(uint16_t *)(header + 10) = ToLE16(encoder->lookahead);
 	*(uint32_t *)(header + 12) =
 		ToLE32(encoder->audio_format.sample_rate);
 	header[16] = 0;
 	header[17] = 0;
-	header[18] = 0;
+	header[18] = encoder->mapping_family;
+
+	size_t size = 19;
+	if (encoder->mapping_family != 0) {
+		/* the channel mapping table (RFC 7845 5.1.1) */
+		header[19] = encoder->streams;
+		header[20] = encoder->coupled_streams;
+		memcpy(header + 21, encoder->mapping, channels);
+		size = 21 + channels;
+	}
 
 	ogg_packet packet;
 	packet.packet = header;
-	packet.bytes = 19;
+	packet.bytes = size;
 	packet.b_o_s = true;
 	packet.e_o_s = false;
 	packet.granulepos = 0;
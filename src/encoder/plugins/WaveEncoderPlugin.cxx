@@ -20,7 +20,9 @@
 #include "config.h"
 #include "WaveEncoderPlugin.hxx"
 #include "../EncoderAPI.hxx"
+#include "pcm/PcmPack.hxx"
 #include "system/ByteOrder.hxx"
+#include "util/ByteReverse.hxx"
 #include "util/Manual.hxx"
 #include "util/DynamicFifoBuffer.hxx"
 
@@ -152,28 +154,10 @@ wave_encoder_close(Encoder *_encoder)
 	encoder->buffer.Destruct();
 }
 
-static size_t
-pcm16_to_wave(uint16_t *dst16, const uint16_t *src16, size_t length)
-{
-	size_t cnt = length >> 1;
-	while (cnt > 0) {
-		*dst16++ = ToLE16(*src16++);
-		cnt--;
-	}
-	return length;
-}
-
-static size_t
-pcm32_to_wave(uint32_t *dst32, const uint32_t *src32, size_t length)
-{
-	size_t cnt = length >> 2;
-	while (cnt > 0){
-		*dst32++ = ToLE32(*src32++);
-		cnt--;
-	}
-	return length;
-}
-
+/**
+ * Portable fallback for big-endian hosts, where pcm_pack_24() would
+ * produce big-endian triples.
+ */
 static size_t
 pcm24_to_wave(uint8_t *dst8, const uint32_t *src32, size_t length)
 {
@@ -200,35 +184,42 @@ wave_encoder_write(Encoder *_encoder,
 	WaveEncoder *encoder = (WaveEncoder *)_encoder;
 
 	uint8_t *dst = encoder->buffer->Write(length);
+	const uint8_t *src8 = (const uint8_t *)src;
 
-	if (IsLittleEndian()) {
-		switch (encoder->bits) {
-		case 8:
-		case 16:
-		case 32:// optimized cases
+	switch (encoder->bits) {
+	case 8:
+		memcpy(dst, src, length);
+		break;
+
+	case 16:
+		if (IsLittleEndian())
 			memcpy(dst, src, length);
-			break;
-		case 24:
-			length = pcm24_to_wave(dst, (const uint32_t *)src, length);
-			break;
-		}
-	} else {
-		switch (encoder->bits) {
-		case 8:
+		else
+			reverse_bytes_16((uint16_t *)dst,
+					 (const uint16_t *)src8,
+					 (const uint16_t *)(src8 + length));
+		break;
+
+	case 24:
+		if (IsLittleEndian()) {
+			/* the SIMD implementation of pcm_pack_24()
+			   emits little-endian triples here */
+			pcm_pack_24(dst, (const int32_t *)src8,
+				    (const int32_t *)(src8 + length));
+			length = length / 4 * 3;
+		} else
+			length = pcm24_to_wave(dst, (const uint32_t *)src,
+					       length);
+		break;
+
+	case 32:
+		if (IsLittleEndian())
 			memcpy(dst, src, length);
-			break;
-		case 16:
-			length = pcm16_to_wave((uint16_t *)dst,
-					       (const uint16_t *)src, length);
-			break;
-		case 24:
-			length = pcm24_to_wave(dst, (const uint32_t *)src, length);
-			break;
-		case 32:
-			length = pcm32_to_wave((uint32_t *)dst,
-					       (const uint32_t *)src, length);
-			break;
-		}
+		else
+			reverse_bytes_32((uint32_t *)dst,
+					 (const uint32_t *)src8,
+					 (const uint32_t *)(src8 + length));
+		break;
 	}
 
 	encoder->buffer->Append(length);
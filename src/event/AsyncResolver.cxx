@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "AsyncResolver.hxx"
+#include "net/Resolver.hxx"
+#include "net/SocketAddress.hxx"
+#include "thread/Name.hxx"
+
+#ifdef WIN32
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#endif
+
+#include <algorithm>
+#include <iterator>
+
+#include <stdio.h>
+
+/**
+ * How long are results kept in the cache?
+ */
+static constexpr std::chrono::steady_clock::duration RESOLVER_CACHE_TTL =
+	std::chrono::minutes(5);
+
+/**
+ * The maximum number of items in AsyncResolver::cache.
+ */
+static constexpr size_t RESOLVER_CACHE_SIZE = 256;
+
+static AsyncResolver global_resolver;
+
+static ResolverResult
+ToResolverResult(const struct addrinfo *ai)
+{
+	ResolverResult result;
+	for (const struct addrinfo *i = ai; i != nullptr; i = i->ai_next) {
+		result.emplace_back();
+		result.back() = SocketAddress(i->ai_addr, i->ai_addrlen);
+	}
+
+	return result;
+}
+
+bool
+AsyncResolver::Start(Error &error)
+{
+	assert(!threads[0].IsDefined());
+
+	for (auto &thread : threads) {
+		if (!thread.Start(Run, this, error)) {
+			Stop();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void
+AsyncResolver::Stop()
+{
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (auto &thread : threads)
+		if (thread.IsDefined())
+			thread.Join();
+
+	quit = false;
+}
+
+std::string
+AsyncResolver::MakeKey(const char *host_port, unsigned default_port,
+		       int flags, int socktype)
+{
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%d/%d/%u/",
+		 flags, socktype, default_port);
+
+	std::string key(buffer);
+	key.append(host_port);
+	return key;
+}
+
+bool
+AsyncResolver::LookupCache(const std::string &key, ResolverResult &result)
+{
+	auto i = cache.find(key);
+	if (i == cache.end())
+		return false;
+
+	if (std::chrono::steady_clock::now() >= i->second.expires) {
+		cache.erase(i);
+		return false;
+	}
+
+	result = i->second.addresses;
+	return true;
+}
+
+bool
+AsyncResolver::LookupCached(const char *host_port, unsigned default_port,
+			    int flags, int socktype,
+			    ResolverResult &result)
+{
+	/* numeric addresses don't need a DNS server */
+	Error error;
+	struct addrinfo *ai = resolve_host_port(host_port, default_port,
+						flags | AI_NUMERICHOST,
+						socktype, error);
+	if (ai != nullptr) {
+		result = ToResolverResult(ai);
+		freeaddrinfo(ai);
+		return true;
+	}
+
+	const ScopeLock protect(mutex);
+	return LookupCache(MakeKey(host_port, default_port, flags, socktype),
+			   result);
+}
+
+void
+AsyncResolver::Submit(ResolveRequest &request, const char *host_port,
+		      unsigned default_port, int flags, int socktype)
+{
+	assert(request.lookup == nullptr);
+
+	auto key = MakeKey(host_port, default_port, flags, socktype);
+
+	const ScopeLock protect(mutex);
+
+	auto i = std::find_if(lookups.begin(), lookups.end(),
+			      [&key](const Lookup &lookup){
+				      return lookup.key == key;
+			      });
+	if (i == lookups.end()) {
+		lookups.emplace_back(std::move(key), host_port, default_port,
+				     flags, socktype);
+		i = std::prev(lookups.end());
+		cond.signal();
+	}
+
+	i->requests.push_back(&request);
+	request.lookup = &*i;
+}
+
+void
+AsyncResolver::Cancel(ResolveRequest &request)
+{
+	Lookup *lookup = request.lookup;
+	if (lookup == nullptr)
+		return;
+
+	request.lookup = nullptr;
+	lookup->requests.remove(&request);
+
+	if (lookup->requests.empty() && !lookup->running)
+		/* nobody is interested anymore and no worker thread
+		   has picked it up yet */
+		lookups.remove_if([lookup](const Lookup &l){
+				return &l == lookup;
+			});
+}
+
+inline void
+AsyncResolver::Run()
+{
+	SetThreadName("resolver");
+
+	mutex.lock();
+
+	while (true) {
+		auto lookup = std::find_if(lookups.begin(), lookups.end(),
+					   [](const Lookup &l){
+						   return !l.running;
+					   });
+		if (lookup == lookups.end()) {
+			if (quit)
+				break;
+
+			cond.wait(mutex);
+			continue;
+		}
+
+		/* while "running" is set, nobody else erases the
+		   lookup, so it may be accessed without the lock */
+		lookup->running = true;
+		mutex.unlock();
+
+		Error error;
+		struct addrinfo *ai =
+			resolve_host_port(lookup->host_port.c_str(),
+					  lookup->default_port,
+					  lookup->flags, lookup->socktype,
+					  error);
+
+		ResolverResult addresses;
+		if (ai != nullptr) {
+			addresses = ToResolverResult(ai);
+			freeaddrinfo(ai);
+		}
+
+		mutex.lock();
+
+		if (ai != nullptr) {
+			if (cache.size() >= RESOLVER_CACHE_SIZE)
+				cache.clear();
+
+			CacheItem &item = cache[lookup->key];
+			item.addresses = addresses;
+			item.expires = std::chrono::steady_clock::now() +
+				RESOLVER_CACHE_TTL;
+		}
+
+		for (auto *request : lookup->requests)
+			request->Finish(addresses, error);
+
+		lookups.erase(lookup);
+	}
+
+	mutex.unlock();
+}
+
+void
+AsyncResolver::Run(void *ctx)
+{
+	AsyncResolver &resolver = *(AsyncResolver *)ctx;
+	resolver.Run();
+}
+
+bool
+ResolveRequest::IsPending()
+{
+	const ScopeLock protect(resolver.mutex);
+	return lookup != nullptr || finished;
+}
+
+void
+ResolveRequest::Start(const char *host_port, unsigned default_port,
+		      int flags, int socktype)
+{
+	Cancel();
+
+	ResolverResult result;
+	if (resolver.LookupCached(host_port, default_port, flags, socktype,
+				  result)) {
+		const ScopeLock protect(resolver.mutex);
+		Finish(result, Error());
+		return;
+	}
+
+	resolver.Submit(*this, host_port, default_port, flags, socktype);
+}
+
+void
+ResolveRequest::Cancel()
+{
+	resolver.mutex.lock();
+	resolver.Cancel(*this);
+	finished = false;
+	resolver.mutex.unlock();
+
+	DeferredMonitor::Cancel();
+}
+
+void
+ResolveRequest::Finish(const ResolverResult &_addresses, const Error &_error)
+{
+	lookup = nullptr;
+	finished = true;
+	addresses = _addresses;
+
+	if (_error.IsDefined())
+		error.Set(_error);
+	else
+		error.Clear();
+
+	DeferredMonitor::Schedule();
+}
+
+void
+ResolveRequest::RunDeferred()
+{
+	resolver.mutex.lock();
+
+	if (!finished) {
+		/* cancelled meanwhile */
+		resolver.mutex.unlock();
+		return;
+	}
+
+	finished = false;
+	const ResolverResult _addresses = std::move(addresses);
+	const Error _error = std::move(error);
+
+	resolver.mutex.unlock();
+
+	if (_error.IsDefined())
+		handler.OnResolverError(_error);
+	else
+		handler.OnResolverSuccess(_addresses);
+}
+
+bool
+resolver_global_start(Error &error)
+{
+	return global_resolver.Start(error);
+}
+
+void
+resolver_global_finish()
+{
+	global_resolver.Stop();
+}
+
+AsyncResolver &
+resolver_get()
+{
+	return global_resolver;
+}
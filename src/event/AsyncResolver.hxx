@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ASYNC_RESOLVER_HXX
+#define MPD_ASYNC_RESOLVER_HXX
+
+#include "check.h"
+#include "DeferredMonitor.hxx"
+#include "net/StaticSocketAddress.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "util/Error.hxx"
+#include "Compiler.h"
+
+#include <chrono>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+class ResolveRequest;
+
+typedef std::vector<StaticSocketAddress> ResolverResult;
+
+/**
+ * Receives the result of a #ResolveRequest.  The methods are invoked
+ * in the #EventLoop thread of the request.
+ */
+class ResolverHandler {
+public:
+	virtual void OnResolverSuccess(const ResolverResult &addresses) = 0;
+	virtual void OnResolverError(const Error &error) = 0;
+};
+
+/**
+ * Resolves host names with getaddrinfo() in a few worker threads, so
+ * a slow DNS server does not block any #EventLoop, and caches the
+ * results.  There is one global instance shared by all network
+ * subsystems; see resolver_get().
+ *
+ * Numeric addresses are resolved immediately, without a worker
+ * thread.  Concurrent requests for the same name share one lookup.
+ *
+ * This class is thread-safe.
+ */
+class AsyncResolver {
+	friend class ResolveRequest;
+
+	/**
+	 * A getaddrinfo() call which is queued or running in a worker
+	 * thread, and the requests waiting for it.
+	 */
+	struct Lookup {
+		const std::string key, host_port;
+		const unsigned default_port;
+		const int flags, socktype;
+
+		std::list<ResolveRequest *> requests;
+
+		/**
+		 * Has a worker thread picked up this lookup?
+		 */
+		bool running = false;
+
+		Lookup(std::string &&_key, const char *_host_port,
+		       unsigned _default_port, int _flags, int _socktype)
+			:key(std::move(_key)), host_port(_host_port),
+			 default_port(_default_port),
+			 flags(_flags), socktype(_socktype) {}
+	};
+
+	struct CacheItem {
+		ResolverResult addresses;
+		std::chrono::steady_clock::time_point expires;
+	};
+
+	static constexpr unsigned N_THREADS = 4;
+
+	Mutex mutex;
+	Cond cond;
+
+	std::list<Lookup> lookups;
+
+	/**
+	 * Successful results by lookup key.  getaddrinfo() does not
+	 * reveal the TTL of DNS records, so all items expire after
+	 * the same period.
+	 */
+	std::map<std::string, CacheItem> cache;
+
+	Thread threads[N_THREADS];
+
+	bool quit = false;
+
+public:
+	AsyncResolver() = default;
+	AsyncResolver(const AsyncResolver &) = delete;
+	AsyncResolver &operator=(const AsyncResolver &) = delete;
+
+	/**
+	 * Start the worker threads.  Requests submitted before are
+	 * queued until then; this allows submitting requests before
+	 * the process is daemonized.
+	 */
+	bool Start(Error &error);
+
+	/**
+	 * Stop and join the worker threads.  All requests must have
+	 * been cancelled already.
+	 */
+	void Stop();
+
+	/**
+	 * Resolve a numeric address or look up a cached result,
+	 * without blocking.  The parameters are the same as
+	 * resolve_host_port().
+	 *
+	 * @return true if the result is available
+	 */
+	bool LookupCached(const char *host_port, unsigned default_port,
+			  int flags, int socktype,
+			  ResolverResult &result);
+
+private:
+	gcc_pure
+	static std::string MakeKey(const char *host_port,
+				   unsigned default_port,
+				   int flags, int socktype);
+
+	bool LookupCache(const std::string &key, ResolverResult &result);
+
+	void Submit(ResolveRequest &request, const char *host_port,
+		    unsigned default_port, int flags, int socktype);
+	void Cancel(ResolveRequest &request);
+
+	void Run();
+	static void Run(void *ctx);
+};
+
+/**
+ * One asynchronous host name lookup, bound to an #EventLoop.  The
+ * #ResolverHandler is invoked in that loop; destroying the object
+ * cancels the lookup.
+ */
+class ResolveRequest final : DeferredMonitor {
+	friend class AsyncResolver;
+
+	AsyncResolver &resolver;
+	ResolverHandler &handler;
+
+	/* the following attributes are protected by
+	   AsyncResolver::mutex */
+
+	/**
+	 * The lookup this request is waiting for, or nullptr.
+	 */
+	AsyncResolver::Lookup *lookup = nullptr;
+
+	/**
+	 * Has a result been delivered which has not yet been passed
+	 * to the #handler?
+	 */
+	bool finished = false;
+
+	ResolverResult addresses;
+	Error error;
+
+public:
+	ResolveRequest(EventLoop &_loop, AsyncResolver &_resolver,
+		       ResolverHandler &_handler)
+		:DeferredMonitor(_loop),
+		 resolver(_resolver), handler(_handler) {}
+
+	~ResolveRequest() {
+		Cancel();
+	}
+
+	using DeferredMonitor::GetEventLoop;
+
+	/**
+	 * Is a lookup in progress, or is the result waiting to be
+	 * delivered to the #ResolverHandler?
+	 */
+	gcc_pure
+	bool IsPending();
+
+	/**
+	 * Start a lookup.  The parameters are the same as
+	 * resolve_host_port().  A pending lookup is cancelled first.
+	 */
+	void Start(const char *host_port, unsigned default_port,
+		   int flags, int socktype);
+
+	void Cancel();
+
+private:
+	/**
+	 * Store the result and schedule the handler invocation.
+	 * Caller must lock AsyncResolver::mutex.
+	 */
+	void Finish(const ResolverResult &_addresses, const Error &_error);
+
+	/* virtual methods from DeferredMonitor */
+	void RunDeferred() override;
+};
+
+/**
+ * Start the worker threads of the global #AsyncResolver.  Call this
+ * after the process has been daemonized.  Requests may be submitted
+ * before, but they are processed only after this call.
+ */
+bool
+resolver_global_start(Error &error);
+
+void
+resolver_global_finish();
+
+gcc_const
+AsyncResolver &
+resolver_get();
+
+#endif
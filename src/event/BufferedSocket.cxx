@@ -49,19 +49,22 @@ BufferedSocket::DirectRead(void *data, size_t length)
 	return -1;
 }
 
-bool
+BufferedSocket::ssize_t
 BufferedSocket::ReadToBuffer()
 {
 	assert(IsDefined());
 
-	const auto buffer = input.Write();
+	if (input == nullptr)
+		input.reset(new InputBuffer());
+
+	const auto buffer = input->Write();
 	assert(!buffer.IsEmpty());
 
 	const auto nbytes = DirectRead(buffer.data, buffer.size);
 	if (nbytes > 0)
-		input.Append(nbytes);
+		input->Append(nbytes);
 
-	return nbytes >= 0;
+	return nbytes;
 }
 
 bool
@@ -69,39 +72,55 @@ BufferedSocket::ResumeInput()
 {
 	assert(IsDefined());
 
-	while (true) {
-		const auto buffer = input.Read();
-		if (buffer.IsEmpty()) {
-			ScheduleRead();
-			return true;
-		}
+	input_paused = false;
 
-		const auto result = OnSocketInput(buffer.data, buffer.size);
-		switch (result) {
-		case InputResult::MORE:
-			if (input.IsFull()) {
-				// TODO
-				static constexpr Domain buffered_socket_domain("buffered_socket");
-				Error error;
-				error.Set(buffered_socket_domain,
-					  "Input buffer is full");
-				OnSocketError(std::move(error));
+	while (true) {
+		const auto buffer = input != nullptr
+			? input->Read()
+			: InputBuffer::Range(nullptr, 0);
+		if (!buffer.IsEmpty()) {
+			const auto result = OnSocketInput(buffer.data,
+							  buffer.size);
+			switch (result) {
+			case InputResult::MORE:
+				if (input->IsFull()) {
+					// TODO
+					static constexpr Domain buffered_socket_domain("buffered_socket");
+					Error error;
+					error.Set(buffered_socket_domain,
+						  "Input buffer is full");
+					OnSocketError(std::move(error));
+					return false;
+				}
+
+				break;
+
+			case InputResult::PAUSE:
+				if (edge_triggered)
+					input_paused = true;
+				else
+					CancelRead();
+				return true;
+
+			case InputResult::AGAIN:
+				continue;
+
+			case InputResult::CLOSED:
 				return false;
 			}
+		}
 
+		if (!edge_triggered) {
 			ScheduleRead();
 			return true;
-
-		case InputResult::PAUSE:
-			CancelRead();
-			return true;
-
-		case InputResult::AGAIN:
-			continue;
-
-		case InputResult::CLOSED:
-			return false;
 		}
+
+		/* edge-triggered: there will be no new edge for data
+		   which is already in the kernel buffer, so read until
+		   it is empty */
+		const auto nbytes = ReadToBuffer();
+		if (nbytes <= 0)
+			return nbytes == 0;
 	}
 }
 
@@ -116,13 +135,17 @@ BufferedSocket::OnSocketReady(unsigned flags)
 	}
 
 	if (flags & READ) {
-		assert(!input.IsFull());
+		if (input_paused)
+			/* edge-triggered: leave the data in the
+			   kernel buffer, ResumeInput() will read it */
+			return true;
 
-		if (!ReadToBuffer() || !ResumeInput())
-			return false;
+		assert(input == nullptr || !input->IsFull());
 
-		if (!input.IsFull())
-			ScheduleRead();
+		/* ResumeInput() schedules the next read, unless
+		   OnSocketInput() has paused input */
+		if (ReadToBuffer() < 0 || !ResumeInput())
+			return false;
 	}
 
 	return true;
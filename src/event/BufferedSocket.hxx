@@ -24,6 +24,8 @@
 #include "SocketMonitor.hxx"
 #include "util/StaticFifoBuffer.hxx"
 
+#include <memory>
+
 #include <assert.h>
 #include <stdint.h>
 
@@ -32,29 +34,60 @@ class EventLoop;
 
 /**
  * A #SocketMonitor specialization that adds an input buffer.
+ *
+ * In edge-triggered mode, the socket is registered only once, and
+ * pausing or resuming input does not modify the #EventLoop
+ * registration; instead, the socket is read until the kernel buffer
+ * is empty.  This mode is only available with epoll; elsewhere, the
+ * socket falls back to level-triggered mode.
  */
 class BufferedSocket : protected SocketMonitor {
-	StaticFifoBuffer<uint8_t, 8192> input;
+	typedef StaticFifoBuffer<uint8_t, 8192> InputBuffer;
+
+	/**
+	 * Allocated when the first data arrives, so a connection which
+	 * has just been accepted (or never sends anything) does not
+	 * occupy the buffer.
+	 */
+	std::unique_ptr<InputBuffer> input;
+
+	const bool edge_triggered;
+
+	/**
+	 * Has OnSocketInput() returned InputResult::PAUSE?  Only used
+	 * in edge-triggered mode.
+	 */
+	bool input_paused;
 
 public:
-	BufferedSocket(int _fd, EventLoop &_loop)
-		:SocketMonitor(_fd, _loop) {
-		ScheduleRead();
+	BufferedSocket(int _fd, EventLoop &_loop, bool _edge_triggered=false)
+		:SocketMonitor(_fd, _loop),
+		 edge_triggered(_edge_triggered && EDGE != 0),
+		 input_paused(false) {
+		if (edge_triggered)
+			Schedule(READ|HANGUP|ERROR|EDGE);
+		else
+			ScheduleRead();
 	}
 
 	using SocketMonitor::IsDefined;
 	using SocketMonitor::Close;
 	using SocketMonitor::Write;
 
+	bool IsEdgeTriggered() const {
+		return edge_triggered;
+	}
+
 private:
 	ssize_t DirectRead(void *data, size_t length);
 
 	/**
 	 * Receive data from the socket to the input buffer.
 	 *
-	 * @return false if the socket has been closed
+	 * @return the number of bytes received, 0 if no data was
+	 * available, -1 if the socket has been closed
 	 */
-	bool ReadToBuffer();
+	ssize_t ReadToBuffer();
 
 protected:
 	/**
@@ -70,8 +103,9 @@ protected:
 	 */
 	void ConsumeInput(size_t nbytes) {
 		assert(IsDefined());
+		assert(input != nullptr);
 
-		input.Consume(nbytes);
+		input->Consume(nbytes);
 	}
 
 	enum class InputResult {
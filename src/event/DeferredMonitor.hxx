@@ -22,6 +22,10 @@
 
 #include "check.h"
 
+#include <boost/intrusive/list_hook.hpp>
+
+#include <atomic>
+
 class EventLoop;
 
 /**
@@ -33,11 +37,36 @@ class DeferredMonitor {
 	EventLoop &loop;
 
 	friend class EventLoop;
-	bool pending;
+
+	enum : unsigned {
+		/**
+		 * RunDeferred() shall be called.
+		 */
+		PENDING = 0x1,
+
+		/**
+		 * This object is in the lock-free list
+		 * EventLoop::scheduled (linked with #next).
+		 */
+		QUEUED = 0x2,
+	};
+
+	std::atomic<unsigned> state;
+
+	/**
+	 * The next item in EventLoop::scheduled.
+	 */
+	DeferredMonitor *next;
+
+	/**
+	 * Siblings in EventLoop::deferred.  Protected with
+	 * EventLoop::mutex.
+	 */
+	boost::intrusive::list_member_hook<> deferred_hook;
 
 public:
 	DeferredMonitor(EventLoop &_loop)
-		:loop(_loop), pending(false) {}
+		:loop(_loop), state(0), next(nullptr) {}
 
 	~DeferredMonitor() {
 		Cancel();
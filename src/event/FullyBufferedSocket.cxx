@@ -21,6 +21,7 @@
 #include "FullyBufferedSocket.hxx"
 #include "net/SocketError.hxx"
 #include "util/Error.hxx"
+#include "util/ConstBuffer.hxx"
 #include "util/Domain.hxx"
 #include "Compiler.h"
 
@@ -39,8 +40,10 @@ FullyBufferedSocket::DirectWrite(const void *data, size_t length)
 	const auto nbytes = SocketMonitor::Write((const char *)data, length);
 	if (gcc_unlikely(nbytes < 0)) {
 		const auto code = GetSocketError();
-		if (IsSocketErrorAgain(code))
+		if (IsSocketErrorAgain(code)) {
+			output_blocked = true;
 			return 0;
+		}
 
 		IdleMonitor::Cancel();
 		BufferedSocket::Cancel();
@@ -54,32 +57,113 @@ FullyBufferedSocket::DirectWrite(const void *data, size_t length)
 	return nbytes;
 }
 
+void
+FullyBufferedSocket::OutputBufferFull()
+{
+	// TODO
+	static constexpr Domain buffered_socket_domain("buffered_socket");
+	Error error;
+	error.Set(buffered_socket_domain, "Output buffer is full");
+	OnSocketError(std::move(error));
+}
+
+bool
+FullyBufferedSocket::FlushFiltered()
+{
+	assert(filter != nullptr);
+	assert(filtered != nullptr);
+	assert(unfiltered == 0);
+
+	while (filtered->IsEmpty()) {
+		const auto data = output.Read();
+		if (data.IsEmpty()) {
+			FlushDone();
+			return true;
+		}
+
+		Error error;
+		if (!filter->Filter({data.data, data.size}, *filtered, error)) {
+			IdleMonitor::Cancel();
+			BufferedSocket::Cancel();
+			OnSocketError(std::move(error));
+			return false;
+		}
+
+		output.Consume(data.size);
+
+		if (gcc_unlikely(filtered->GetAvailable() > output_limit)) {
+			/* the filter has expanded the data beyond
+			   the limit */
+			IdleMonitor::Cancel();
+			BufferedSocket::Cancel();
+			OutputBufferFull();
+			return false;
+		}
+	}
+
+	const auto data = filtered->Read();
+	auto nbytes = DirectWrite(data.data, data.size);
+	if (gcc_unlikely(nbytes <= 0))
+		return nbytes == 0;
+
+	filtered->Consume(nbytes);
+
+	if (IsOutputEmpty()) {
+		FlushDone();
+		return OnSocketDrained();
+	}
+
+	return true;
+}
+
 bool
 FullyBufferedSocket::Flush()
 {
 	assert(IsDefined());
 
+	if (filter != nullptr && unfiltered == 0)
+		return FlushFiltered();
+
 	const auto data = output.Read();
 	if (data.IsEmpty()) {
-		IdleMonitor::Cancel();
-		CancelWrite();
+		FlushDone();
 		return true;
 	}
 
-	auto nbytes = DirectWrite(data.data, data.size);
+	size_t length = data.size;
+	if (filter != nullptr && length > unfiltered)
+		/* don't send data which was written after the filter
+		   was installed */
+		length = unfiltered;
+
+	auto nbytes = DirectWrite(data.data, length);
 	if (gcc_unlikely(nbytes <= 0))
 		return nbytes == 0;
 
 	output.Consume(nbytes);
+	if (filter != nullptr)
+		unfiltered -= nbytes;
 
-	if (output.IsEmpty()) {
-		IdleMonitor::Cancel();
-		CancelWrite();
+	if (IsOutputEmpty()) {
+		FlushDone();
+		return OnSocketDrained();
 	}
 
 	return true;
 }
 
+bool
+FullyBufferedSocket::FlushEdge()
+{
+	assert(IsEdgeTriggered());
+
+	while (!output_blocked && !IsOutputEmpty())
+		if (!Flush())
+			return false;
+
+	return true;
+}
+
 bool
 FullyBufferedSocket::Write(const void *data, size_t length)
 {
@@ -90,29 +174,65 @@ FullyBufferedSocket::Write(const void *data, size_t length)
 
 	const bool was_empty = output.IsEmpty();
 
-	if (!output.Append(data, length)) {
-		// TODO
-		static constexpr Domain buffered_socket_domain("buffered_socket");
-		Error error;
-		error.Set(buffered_socket_domain, "Output buffer is full");
-		OnSocketError(std::move(error));
+	/* with an output filter, the filtered data which has not
+	   been sent yet counts toward the limit, or a slow reader
+	   could make the #filtered buffer grow without bounds */
+	if (IsOverLimit(length) || !output.Append(data, length)) {
+		OutputBufferFull();
 		return false;
 	}
 
+	output_count += length;
+
 	if (was_empty)
 		IdleMonitor::Schedule();
 	return true;
 }
 
+void
+FullyBufferedSocket::CommitWrite(size_t length)
+{
+	assert(IsDefined());
+
+	if (length == 0)
+		return;
+
+	const bool was_empty = output.IsEmpty();
+
+	output.Append(length);
+	output_count += length;
+
+	if (was_empty)
+		IdleMonitor::Schedule();
+}
+
+void
+FullyBufferedSocket::SetOutputFilter(std::unique_ptr<SocketOutputFilter> &&_filter)
+{
+	assert(IsDefined());
+	assert(filter == nullptr);
+	assert(_filter != nullptr);
+
+	filter = std::move(_filter);
+	unfiltered = output.GetSize();
+	filtered.reset(new DynamicFifoBuffer<uint8_t>(16384));
+}
+
 bool
 FullyBufferedSocket::OnSocketReady(unsigned flags)
 {
 	if (flags & WRITE) {
-		assert(!output.IsEmpty());
-		assert(!IdleMonitor::IsActive());
+		if (IsEdgeTriggered()) {
+			output_blocked = false;
+			if (!FlushEdge())
+				return false;
+		} else {
+			assert(!IsOutputEmpty());
+			assert(!IdleMonitor::IsActive());
 
-		if (!Flush())
-			return false;
+			if (!Flush())
+				return false;
+		}
 	}
 
 	if (!BufferedSocket::OnSocketReady(flags))
@@ -124,6 +244,13 @@ FullyBufferedSocket::OnSocketReady(unsigned flags)
 void
 FullyBufferedSocket::OnIdle()
 {
-	if (Flush() && !output.IsEmpty())
+	if (IsEdgeTriggered()) {
+		/* if blocked, the next WRITE event will flush */
+		if (!output_blocked)
+			FlushEdge();
+		return;
+	}
+
+	if (Flush() && !IsOutputEmpty())
 		ScheduleWrite();
 }
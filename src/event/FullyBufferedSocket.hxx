@@ -23,7 +23,13 @@
 #include "check.h"
 #include "BufferedSocket.hxx"
 #include "IdleMonitor.hxx"
+#include "SocketOutputFilter.hxx"
 #include "util/PeakBuffer.hxx"
+#include "util/DynamicFifoBuffer.hxx"
+
+#include <memory>
+
+#include <stdint.h>
 
 /**
  * A #BufferedSocket specialization that adds an output buffer.
@@ -31,11 +37,54 @@
 class FullyBufferedSocket : protected BufferedSocket, private IdleMonitor {
 	PeakBuffer output;
 
+	/**
+	 * The maximum number of bytes in #output and #filtered
+	 * together.
+	 */
+	const size_t output_limit;
+
+	/**
+	 * If set, data from #output is passed through this filter
+	 * before it is sent.  See SetOutputFilter().
+	 */
+	std::unique_ptr<SocketOutputFilter> filter;
+
+	/**
+	 * The number of bytes at the beginning of #output which were
+	 * written before the #filter was installed, and must be sent
+	 * unfiltered.
+	 */
+	size_t unfiltered;
+
+	/**
+	 * Data returned by the #filter which has not been sent yet.
+	 */
+	std::unique_ptr<DynamicFifoBuffer<uint8_t>> filtered;
+
+	/**
+	 * Has the last write failed with EAGAIN?  Only used in
+	 * edge-triggered mode, where WRITE stays registered all the
+	 * time: no write is attempted until the next WRITE event.
+	 */
+	bool output_blocked;
+
+	/**
+	 * The total number of bytes passed to Write() and
+	 * CommitWrite(), before the #filter.
+	 */
+	uint64_t output_count;
+
 public:
 	FullyBufferedSocket(int _fd, EventLoop &_loop,
-			    size_t normal_size, size_t peak_size=0)
-		:BufferedSocket(_fd, _loop), IdleMonitor(_loop),
-		 output(normal_size, peak_size) {
+			    size_t normal_size, size_t peak_size=0,
+			    bool _edge_triggered=false)
+		:BufferedSocket(_fd, _loop, _edge_triggered),
+		 IdleMonitor(_loop),
+		 output(normal_size, peak_size),
+		 output_limit(normal_size + peak_size), unfiltered(0),
+		 output_blocked(false), output_count(0) {
+		if (IsEdgeTriggered())
+			ScheduleWrite();
 	}
 
 	using BufferedSocket::IsDefined;
@@ -45,9 +94,62 @@ public:
 		BufferedSocket::Close();
 	}
 
+protected:
+	uint64_t GetOutputCount() const {
+		return output_count;
+	}
+
+	gcc_pure
+	bool IsOutputEmpty() const {
+		return output.IsEmpty() &&
+			(filtered == nullptr || filtered->IsEmpty());
+	}
+
 private:
 	ssize_t DirectWrite(const void *data, size_t length);
 
+	/**
+	 * Would appending the specified number of bytes exceed
+	 * #output_limit?  The #filtered buffer counts, too.
+	 */
+	gcc_pure
+	bool IsOverLimit(size_t length) const {
+		return filtered != nullptr &&
+			output.GetSize() + filtered->GetAvailable() + length
+			> output_limit;
+	}
+
+	/**
+	 * Report that the output buffer is full.
+	 */
+	void OutputBufferFull();
+
+	/**
+	 * Filter the next chunk of #output (if #filtered is empty)
+	 * and send from #filtered.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool FlushFiltered();
+
+	/**
+	 * Called when the output buffer is empty.  Unregisters the
+	 * WRITE event, unless in edge-triggered mode.
+	 */
+	void FlushDone() {
+		IdleMonitor::Cancel();
+		if (!IsEdgeTriggered())
+			CancelWrite();
+	}
+
+	/**
+	 * Edge-triggered mode: call Flush() until the output buffer
+	 * is empty or the socket blocks.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool FlushEdge();
+
 protected:
 	/**
 	 * Send data from the output buffer to the socket.
@@ -61,6 +163,43 @@ protected:
 	 */
 	bool Write(const void *data, size_t length);
 
+	/**
+	 * Obtain free space in the output buffer, allowing the caller
+	 * to generate data in place instead of copying it with
+	 * Write().  The returned buffer may be empty or too small; in
+	 * that case, use Write().  Call CommitWrite() afterwards.
+	 */
+	WritableBuffer<void> PrepareWrite() {
+		return output.Write();
+	}
+
+	/**
+	 * Commit data which was written to the buffer returned by
+	 * PrepareWrite().
+	 */
+	void CommitWrite(size_t length);
+
+	/**
+	 * Pass all data written from now on through the given
+	 * filter.  Data which is already in the output buffer is sent
+	 * unmodified.  A filter cannot be removed or replaced.
+	 */
+	void SetOutputFilter(std::unique_ptr<SocketOutputFilter> &&_filter);
+
+	bool HasOutputFilter() const {
+		return filter != nullptr;
+	}
+
+	/**
+	 * The output buffer has become empty.  The method may write
+	 * more data.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	virtual bool OnSocketDrained() {
+		return true;
+	}
+
 	virtual bool OnSocketReady(unsigned flags) override;
 	virtual void OnIdle() override;
 };
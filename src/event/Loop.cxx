@@ -28,9 +28,12 @@
 
 #include <algorithm>
 
+#include <limits.h>
+
 EventLoop::EventLoop()
 	:SocketMonitor(*this),
-	 now_ms(::MonotonicClockMS()),
+	 scheduled(nullptr),
+	 now_ms(::MonotonicClockMS()), wide_now_ms(0),
 	 quit(false), busy(true),
 #ifndef NDEBUG
 	 virgin(true),
@@ -44,7 +47,7 @@ EventLoop::EventLoop()
 EventLoop::~EventLoop()
 {
 	assert(idle.empty());
-	assert(timers.empty());
+	assert(timers.IsEmpty());
 
 	/* this is necessary to get a well-defined destruction
 	   order */
@@ -97,6 +100,14 @@ EventLoop::RemoveIdle(IdleMonitor &i)
 	idle.erase(it);
 }
 
+void
+EventLoop::UpdateTime()
+{
+	const unsigned t = ::MonotonicClockMS();
+	wide_now_ms += t - now_ms;
+	now_ms = t;
+}
+
 void
 EventLoop::AddTimer(TimeoutMonitor &t, unsigned ms)
 {
@@ -104,21 +115,37 @@ EventLoop::AddTimer(TimeoutMonitor &t, unsigned ms)
 	   modifies the timeout during avahi_client_free() */
 	assert(IsInsideOrNull());
 
-	timers.insert(TimerRecord(t, now_ms + ms));
+	timers.Add(t, wide_now_ms + ms);
 	again = true;
 }
 
 void
-EventLoop::CancelTimer(TimeoutMonitor &t)
+EventLoop::AddCoarseTimer(TimeoutMonitor &t, unsigned ms)
 {
 	assert(IsInsideOrNull());
 
-	for (auto i = timers.begin(), end = timers.end(); i != end; ++i) {
-		if (&i->timer == &t) {
-			timers.erase(i);
-			return;
-		}
+	uint64_t due = wide_now_ms + ms;
+
+	if (ms >= 16) {
+		/* round up to a multiple of the largest power of two
+		   not above ms/8 */
+		uint64_t granularity = 1;
+		while (granularity * 16 <= ms)
+			granularity <<= 1;
+
+		due = (due + granularity - 1) & ~(granularity - 1);
 	}
+
+	timers.Add(t, due);
+	again = true;
+}
+
+void
+EventLoop::CancelTimer(TimeoutMonitor &t)
+{
+	assert(IsInsideOrNull());
+
+	timers.Remove(t);
 }
 
 void
@@ -137,32 +164,27 @@ EventLoop::Run()
 	assert(busy);
 
 	do {
-		now_ms = ::MonotonicClockMS();
+		UpdateTime();
 		again = false;
 
 		/* invoke timers */
 
-		int timeout_ms;
-		while (true) {
-			auto i = timers.begin();
-			if (i == timers.end()) {
-				timeout_ms = -1;
-				break;
-			}
-
-			timeout_ms = i->due_ms - now_ms;
-			if (timeout_ms > 0)
-				break;
-
-			TimeoutMonitor &m = i->timer;
-			timers.erase(i);
-
-			m.Run();
+		TimerWheel::Timer *t;
+		while ((t = timers.Pop(wide_now_ms)) != nullptr) {
+			static_cast<TimeoutMonitor *>(t)->Run();
 
 			if (quit)
 				return;
 		}
 
+		int timeout_ms = -1;
+		const uint64_t next = timers.GetNextEvent();
+		if (next != UINT64_MAX) {
+			assert(next > wide_now_ms);
+			const uint64_t delta = next - wide_now_ms;
+			timeout_ms = delta < INT_MAX ? int(delta) : INT_MAX;
+		}
+
 		/* invoke idle */
 
 		while (!idle.empty()) {
@@ -176,13 +198,13 @@ EventLoop::Run()
 
 		/* try to handle DeferredMonitors without WakeFD
 		   overhead */
-		mutex.lock();
 		HandleDeferred();
 		busy = false;
-		const bool _again = again;
-		mutex.unlock();
 
-		if (_again)
+		/* check #scheduled after clearing #busy: a
+		   concurrent AddDeferred() either sees busy==false
+		   and wakes us, or we see its monitor here */
+		if (again || scheduled.load() != nullptr)
 			/* re-evaluate timers because one of the
 			   IdleMonitors may have added a new
 			   timeout */
@@ -192,11 +214,9 @@ EventLoop::Run()
 
 		poll_group.ReadEvents(poll_result, timeout_ms);
 
-		now_ms = ::MonotonicClockMS();
+		UpdateTime();
 
-		mutex.lock();
 		busy = true;
-		mutex.unlock();
 
 		/* invoke sockets */
 		for (int i = 0; i < poll_result.GetSize(); ++i) {
@@ -224,56 +244,132 @@ EventLoop::Run()
 void
 EventLoop::AddDeferred(DeferredMonitor &d)
 {
-	mutex.lock();
-	if (d.pending) {
-		mutex.unlock();
+	unsigned state = d.state.load();
+	unsigned new_state;
+	do {
+		if (state & DeferredMonitor::PENDING)
+			/* already scheduled */
+			return;
+
+		new_state = state | DeferredMonitor::PENDING |
+			DeferredMonitor::QUEUED;
+	} while (!d.state.compare_exchange_weak(state, new_state));
+
+	if (state & DeferredMonitor::QUEUED)
+		/* it is still in #scheduled after having been
+		   cancelled; HandleDeferred() will see the new
+		   PENDING flag */
 		return;
-	}
 
-	assert(std::find(deferred.begin(),
-			 deferred.end(), &d) == deferred.end());
+	DeferredMonitor *head = scheduled.load();
+	do {
+		d.next = head;
+	} while (!scheduled.compare_exchange_weak(head, &d));
 
 	/* we don't need to wake up the EventLoop if another
-	   DeferredMonitor has already done it */
-	const bool must_wake = !busy && deferred.empty();
+	   DeferredMonitor has already done it, or if it is awake
+	   anyway */
+	if (head == nullptr && !busy.load())
+		wake_fd.Write();
+}
 
-	d.pending = true;
-	deferred.push_back(&d);
-	again = true;
-	mutex.unlock();
+bool
+EventLoop::UnlinkScheduled(DeferredMonitor &d)
+{
+	/* producers only ever replace the head, so the "next"
+	   pointers can be modified safely while holding the
+	   mutex */
 
-	if (must_wake)
-		wake_fd.Write();
+	DeferredMonitor *head = scheduled.load();
+	while (head == &d) {
+		if (scheduled.compare_exchange_weak(head, d.next))
+			return true;
+
+		/* another monitor was pushed meanwhile; now "d" is
+		   not the head anymore */
+	}
+
+	for (DeferredMonitor *i = head; i != nullptr; i = i->next) {
+		if (i->next == &d) {
+			i->next = d.next;
+			return true;
+		}
+	}
+
+	/* not found: a concurrent AddDeferred() has not finished
+	   pushing it yet */
+	return false;
 }
 
 void
 EventLoop::RemoveDeferred(DeferredMonitor &d)
 {
+	if (d.state.load() == 0)
+		/* fast path without locking the mutex */
+		return;
+
 	const ScopeLock protect(mutex);
 
-	if (!d.pending) {
-		assert(std::find(deferred.begin(),
-				 deferred.end(), &d) == deferred.end());
-		return;
-	}
+	const unsigned state =
+		d.state.fetch_and(~unsigned(DeferredMonitor::PENDING));
 
-	d.pending = false;
+	if (d.deferred_hook.is_linked())
+		deferred.erase(deferred.iterator_to(d));
 
-	auto i = std::find(deferred.begin(), deferred.end(), &d);
-	assert(i != deferred.end());
+	if ((state & DeferredMonitor::QUEUED) && UnlinkScheduled(d))
+		/* clear both flags: a concurrent AddDeferred() which
+		   has seen QUEUED did not push it again, so its
+		   PENDING flag must not survive */
+		d.state.store(0);
+}
+
+void
+EventLoop::CollectDeferred()
+{
+	DeferredMonitor *head = scheduled.exchange(nullptr);
+
+	/* reverse the stack to get them in the order they were
+	   scheduled */
+	DeferredMonitor *reversed = nullptr;
+	while (head != nullptr) {
+		DeferredMonitor *next = head->next;
+		head->next = reversed;
+		reversed = head;
+		head = next;
+	}
 
-	deferred.erase(i);
+	while (reversed != nullptr) {
+		DeferredMonitor &m = *reversed;
+		reversed = m.next;
+
+		/* after this, AddDeferred() may push it again */
+		const unsigned state =
+			m.state.fetch_and(~unsigned(DeferredMonitor::QUEUED));
+		if ((state & DeferredMonitor::PENDING) &&
+		    !m.deferred_hook.is_linked())
+			deferred.push_back(m);
+	}
 }
 
 void
 EventLoop::HandleDeferred()
 {
-	while (!deferred.empty() && !quit) {
-		DeferredMonitor &m = *deferred.front();
-		assert(m.pending);
+	const ScopeLock protect(mutex);
+
+	while (!quit) {
+		if (deferred.empty()) {
+			CollectDeferred();
+			if (deferred.empty())
+				break;
+		}
 
+		DeferredMonitor &m = deferred.front();
 		deferred.pop_front();
-		m.pending = false;
+
+		const unsigned state =
+			m.state.fetch_and(~unsigned(DeferredMonitor::PENDING));
+		if (!(state & DeferredMonitor::PENDING))
+			continue;
 
 		mutex.unlock();
 		m.RunDeferred();
@@ -288,9 +384,7 @@ EventLoop::OnSocketReady(gcc_unused unsigned flags)
 
 	wake_fd.Read();
 
-	mutex.lock();
 	HandleDeferred();
-	mutex.unlock();
 
 	return true;
 }
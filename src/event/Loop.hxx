@@ -28,13 +28,18 @@
 #include "thread/Mutex.hxx"
 #include "WakeFD.hxx"
 #include "SocketMonitor.hxx"
+#include "DeferredMonitor.hxx"
+#include "TimerWheel.hxx"
+
+#include <boost/intrusive/list.hpp>
 
 #include <list>
-#include <set>
+#include <atomic>
+
+#include <stdint.h>
 
 class TimeoutMonitor;
 class IdleMonitor;
-class DeferredMonitor;
 class SocketMonitor;
 
 #include <assert.h>
@@ -50,38 +55,49 @@ class SocketMonitor;
  */
 class EventLoop final : SocketMonitor
 {
-	struct TimerRecord {
-		/**
-		 * Projected monotonic_clock_ms() value when this
-		 * timer is due.
-		 */
-		const unsigned due_ms;
-
-		TimeoutMonitor &timer;
-
-		constexpr TimerRecord(TimeoutMonitor &_timer,
-				      unsigned _due_ms)
-			:due_ms(_due_ms), timer(_timer) {}
-
-		bool operator<(const TimerRecord &other) const {
-			return due_ms < other.due_ms;
-		}
-
-		bool IsDue(unsigned _now_ms) const {
-			return _now_ms >= due_ms;
-		}
-	};
-
 	WakeFD wake_fd;
 
-	std::multiset<TimerRecord> timers;
+	/**
+	 * All scheduled #TimeoutMonitor instances.
+	 */
+	TimerWheel timers;
 	std::list<IdleMonitor *> idle;
 
+	/**
+	 * A lock-free stack of #DeferredMonitor instances which were
+	 * scheduled by DeferredMonitor::Schedule(), newest first.
+	 * Any thread may push; only HandleDeferred() (with #mutex
+	 * locked) removes the whole stack.  Cancelling a queued
+	 * monitor unlinks it with #mutex locked, too.
+	 */
+	std::atomic<DeferredMonitor *> scheduled;
+
+	/**
+	 * Protects #deferred and removals from #scheduled.
+	 */
 	Mutex mutex;
-	std::list<DeferredMonitor *> deferred;
+
+	typedef boost::intrusive::list<DeferredMonitor,
+				       boost::intrusive::member_hook<DeferredMonitor,
+								     boost::intrusive::list_member_hook<>,
+								     &DeferredMonitor::deferred_hook>,
+				       boost::intrusive::constant_time_size<false>> DeferredList;
+
+	/**
+	 * The #DeferredMonitor instances collected from #scheduled,
+	 * in the order they were scheduled.
+	 */
+	DeferredList deferred;
 
 	unsigned now_ms;
 
+	/**
+	 * Milliseconds since the #EventLoop was constructed.  Unlike
+	 * #now_ms, this does not wrap around; it is the time base of
+	 * #timers.
+	 */
+	uint64_t wide_now_ms;
+
 	bool quit;
 
 	/**
@@ -92,11 +108,10 @@ class EventLoop final : SocketMonitor
 
 	/**
 	 * True when handling callbacks, false when waiting for I/O or
-	 * timeout.
-	 *
-	 * Protected with #mutex.
+	 * timeout.  While it is true, AddDeferred() does not need to
+	 * wake up the loop.
 	 */
-	bool busy;
+	std::atomic_bool busy;
 
 #ifndef NDEBUG
 	/**
@@ -159,12 +174,21 @@ public:
 	void RemoveIdle(IdleMonitor &i);
 
 	void AddTimer(TimeoutMonitor &t, unsigned ms);
+
+	/**
+	 * Like AddTimer(), but the timer may fire up to 1/8 of the
+	 * given duration late.  This rounds the due time, so timers
+	 * with similar deadlines expire in the same iteration.
+	 */
+	void AddCoarseTimer(TimeoutMonitor &t, unsigned ms);
+
 	void CancelTimer(TimeoutMonitor &t);
 
 	/**
 	 * Schedule a call to DeferredMonitor::RunDeferred().
 	 *
-	 * This method is thread-safe.
+	 * This method is thread-safe and lock-free.  Only the first
+	 * call after the loop has gone to sleep writes to the #WakeFD.
 	 */
 	void AddDeferred(DeferredMonitor &d);
 
@@ -184,10 +208,29 @@ public:
 
 private:
 	/**
-	 * Invoke all pending DeferredMonitors.
+	 * Update #now_ms and #wide_now_ms from the monotonic clock.
+	 */
+	void UpdateTime();
+
+	/**
+	 * Move all monitors from #scheduled to #deferred.
 	 *
 	 * Caller must lock the mutex.
 	 */
+	void CollectDeferred();
+
+	/**
+	 * Remove the given monitor from #scheduled.
+	 *
+	 * Caller must lock the mutex.
+	 *
+	 * @return false if it was not found
+	 */
+	bool UnlinkScheduled(DeferredMonitor &d);
+
+	/**
+	 * Invoke all pending DeferredMonitors.
+	 */
 	void HandleDeferred();
 
 	virtual bool OnSocketReady(unsigned flags) override;
@@ -26,6 +26,12 @@ typedef PollResultEPoll PollResult;
 typedef PollGroupEPoll  PollGroup;
 #endif
 
+#ifdef USE_IO_URING
+#include "PollGroupUring.hxx"
+typedef PollResultGeneric PollResult;
+typedef PollGroupUring    PollGroup;
+#endif
+
 #ifdef USE_WINSELECT
 #include "PollGroupWinSelect.hxx"
 typedef PollResultGeneric  PollResult;
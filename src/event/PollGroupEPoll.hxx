@@ -25,22 +25,43 @@
 #include "Compiler.h"
 #include "system/EPollFD.hxx"
 
-#include <array>
+#include <vector>
 #include <algorithm>
 
 class PollResultEPoll
 {
 	friend class PollGroupEPoll;
 
-	std::array<epoll_event, 16> events;
+	/**
+	 * The initial batch size.
+	 */
+	static constexpr size_t MIN_EVENTS = 16;
+
+	/**
+	 * The batch grows up to this size when epoll_wait() keeps
+	 * filling it completely.
+	 */
+	static constexpr size_t MAX_EVENTS = 1024;
+
+	std::vector<epoll_event> events;
 	int n_events;
 public:
-	PollResultEPoll() : n_events(0) { }
+	PollResultEPoll() : events(MIN_EVENTS), n_events(0) { }
 
 	int GetSize() const { return n_events; }
 	unsigned GetEvents(int i) const { return events[i].events; }
 	void *GetObject(int i) const { return events[i].data.ptr; }
-	void Reset() { n_events = 0; }
+
+	void Reset() {
+		if (size_t(n_events) == events.size() &&
+		    events.size() < MAX_EVENTS)
+			/* the batch was full; more events are probably
+			   waiting, so fetch more with the next
+			   epoll_wait() call */
+			events.resize(events.size() * 2);
+
+		n_events = 0;
+	}
 
 	void Clear(void *obj) {
 		for (int i = 0; i < n_events; ++i)
@@ -60,6 +81,7 @@ public:
 	static constexpr unsigned WRITE = EPOLLOUT;
 	static constexpr unsigned ERROR = EPOLLERR;
 	static constexpr unsigned HANGUP = EPOLLHUP;
+	static constexpr unsigned EDGE = EPOLLET;
 
 	PollGroupEPoll() = default;
 
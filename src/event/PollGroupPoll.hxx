@@ -48,6 +48,12 @@ public:
 	static constexpr unsigned ERROR = POLLERR;
 	static constexpr unsigned HANGUP = POLLHUP;
 
+	/**
+	 * Edge-triggered mode is not supported; this flag is ignored
+	 * and sockets are always level-triggered.
+	 */
+	static constexpr unsigned EDGE = 0;
+
 	PollGroupPoll();
 	~PollGroupPoll();
 
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#ifdef USE_IO_URING
+
+#include "PollGroupUring.hxx"
+#include "system/FatalError.hxx"
+#include "util/Error.hxx"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+
+PollGroupUring::PollGroupUring()
+{
+	Error error;
+	if (!ring.Open(256, error))
+		FatalError(error);
+
+	if (!ring.HasFeature(IORING_FEAT_EXT_ARG))
+		FatalError("io_uring lacks IORING_FEAT_EXT_ARG (Linux 5.11)");
+}
+
+PollGroupUring::~PollGroupUring()
+{
+	/* close the ring first, which cancels all pending
+	   requests */
+	ring.Close();
+
+	all_items.clear_and_dispose([](Item *item){ delete item; });
+}
+
+io_uring_sqe &
+PollGroupUring::GetSqe()
+{
+	io_uring_sqe *sqe = ring.GetSqe();
+	if (sqe == nullptr) {
+		/* the submission queue is full: flush it */
+		int result = ring.Submit();
+		if (result < 0) {
+			errno = -result;
+			FatalSystemError("io_uring_enter() failed");
+		}
+
+		sqe = ring.GetSqe();
+		assert(sqe != nullptr);
+	}
+
+	return *sqe;
+}
+
+void
+PollGroupUring::Arm(Item &item)
+{
+	assert(!item.armed);
+	assert(!item.removed);
+
+	io_uring_sqe &sqe = GetSqe();
+	sqe.opcode = IORING_OP_POLL_ADD;
+	sqe.fd = item.fd;
+	sqe.poll32_events = item.events;
+	sqe.user_data = (uint64_t)(uintptr_t)&item;
+
+	item.armed = true;
+}
+
+void
+PollGroupUring::Disarm(Item &item)
+{
+	assert(item.armed);
+
+	io_uring_sqe &sqe = GetSqe();
+	sqe.opcode = IORING_OP_POLL_REMOVE;
+	sqe.addr = (uint64_t)(uintptr_t)&item;
+	/* user_data=0: the completion of this request is ignored;
+	   the cancelled request completes with -ECANCELED */
+}
+
+bool
+PollGroupUring::Add(int fd, unsigned events, void *obj)
+{
+	assert(items.find(fd) == items.end());
+
+	Item *item = new Item(fd, events, obj);
+	all_items.push_back(*item);
+	items[fd] = item;
+
+	Arm(*item);
+	return true;
+}
+
+bool
+PollGroupUring::Modify(int fd, unsigned events, void *obj)
+{
+	auto i = items.find(fd);
+	assert(i != items.end());
+	Item &item = *i->second;
+
+	const bool changed = events != item.events;
+	item.events = events;
+	item.obj = obj;
+
+	if (!item.armed)
+		Arm(item);
+	else if (changed)
+		/* re-armed with the new mask when the cancelled
+		   request completes */
+		Disarm(item);
+
+	return true;
+}
+
+bool
+PollGroupUring::Remove(int fd)
+{
+	auto i = items.find(fd);
+	assert(i != items.end());
+	Item &item = *i->second;
+	items.erase(i);
+
+	if (item.armed) {
+		item.removed = true;
+		Disarm(item);
+	} else
+		delete &item;
+
+	return true;
+}
+
+void
+PollGroupUring::ReadEvents(PollResultGeneric &result, int timeout_ms)
+{
+	int ret = ring.Submit(1, timeout_ms);
+	if (ret < 0 && ret != -EBUSY) {
+		errno = -ret;
+		FatalSystemError("io_uring_enter() failed");
+	}
+
+	const io_uring_cqe *cqe;
+	while ((cqe = ring.PeekCqe()) != nullptr) {
+		Item *item = (Item *)(uintptr_t)cqe->user_data;
+		const int res = cqe->res;
+		ring.SeenCqe();
+
+		if (item == nullptr)
+			/* completion of IORING_OP_POLL_REMOVE */
+			continue;
+
+		assert(item->armed);
+		item->armed = false;
+
+		if (item->removed) {
+			delete item;
+			continue;
+		}
+
+		if (res > 0) {
+			const unsigned events = res & (item->events|ERROR|HANGUP);
+			if (events != 0)
+				result.Add(events, item->obj);
+		} else if (res != -ECANCELED) {
+			/* the file descriptor is not pollable anymore;
+			   report an error and don't re-arm */
+			result.Add(ERROR|HANGUP, item->obj);
+			continue;
+		}
+
+		rearm.push_back(item);
+	}
+
+	/* re-arm the requests after all completions have been
+	   collected (submitting while collecting could complete them
+	   again right away); they will be submitted with the next
+	   ReadEvents() call, after the events have been handled */
+	for (Item *item : rearm)
+		if (!item->armed)
+			Arm(*item);
+	rearm.clear();
+}
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_EVENT_POLLGROUP_URING_HXX
+#define MPD_EVENT_POLLGROUP_URING_HXX
+
+#include "check.h"
+#include "PollResultGeneric.hxx"
+#include "system/IoUring.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+#include <sys/poll.h>
+
+/**
+ * A poll group which submits one-shot IORING_OP_POLL_ADD requests to
+ * an io_uring.  A request is re-armed after it has completed, which
+ * gives level-triggered semantics.  Registration changes and the
+ * wait for events are submitted with a single io_uring_enter() call.
+ */
+class PollGroupUring
+{
+	struct Item
+		: boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink>> {
+		const int fd;
+		unsigned events;
+		void *obj;
+
+		/**
+		 * Is a IORING_OP_POLL_ADD request pending?
+		 */
+		bool armed;
+
+		/**
+		 * Has this item been removed from the group?  It is
+		 * deleted as soon as its pending request completes.
+		 */
+		bool removed;
+
+		Item(int _fd, unsigned _events, void *_obj)
+			:fd(_fd), events(_events), obj(_obj),
+			 armed(false), removed(false) {}
+	};
+
+	IoUring ring;
+
+	std::unordered_map<int, Item *> items;
+
+	/**
+	 * All #Item instances, including removed ones which are
+	 * still waiting for their request to complete.
+	 */
+	boost::intrusive::list<Item,
+			       boost::intrusive::constant_time_size<false>> all_items;
+
+	/**
+	 * Temporary list for ReadEvents().
+	 */
+	std::vector<Item *> rearm;
+
+	PollGroupUring(PollGroupUring &) = delete;
+	PollGroupUring &operator=(PollGroupUring &) = delete;
+public:
+	static constexpr unsigned READ = POLLIN;
+	static constexpr unsigned WRITE = POLLOUT;
+	static constexpr unsigned ERROR = POLLERR;
+	static constexpr unsigned HANGUP = POLLHUP;
+
+	/**
+	 * Edge-triggered mode is not supported; this flag is ignored
+	 * and sockets are always level-triggered.
+	 */
+	static constexpr unsigned EDGE = 0;
+
+	PollGroupUring();
+	~PollGroupUring();
+
+	void ReadEvents(PollResultGeneric &result, int timeout_ms);
+	bool Add(int fd, unsigned events, void *obj);
+	bool Modify(int fd, unsigned events, void *obj);
+	bool Remove(int fd);
+
+	bool Abandon(int fd) {
+		/* the pending request holds a reference on the file,
+		   so it has to be cancelled even after close() */
+		return Remove(fd);
+	}
+
+private:
+	io_uring_sqe &GetSqe();
+
+	void Arm(Item &item);
+
+	/**
+	 * Cancel the pending request of the given item.
+	 */
+	void Disarm(Item &item);
+};
+
+#endif
@@ -98,6 +98,12 @@ public:
 	static constexpr unsigned ERROR = 0;
 	static constexpr unsigned HANGUP = 0;
 
+	/**
+	 * Edge-triggered mode is not supported; this flag is ignored
+	 * and sockets are always level-triggered.
+	 */
+	static constexpr unsigned EDGE = 0;
+
 	PollGroupWinSelect();
 	~PollGroupWinSelect();
 
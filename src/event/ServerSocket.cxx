@@ -49,6 +49,7 @@
 #include <winsock.h>
 #else
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <netdb.h>
@@ -119,7 +120,13 @@ public:
 		SocketMonitor::ScheduleRead();
 	}
 
-	void Accept();
+	/**
+	 * Accept one pending connection.
+	 *
+	 * @return false if there was no pending connection or if
+	 * accept() has failed
+	 */
+	bool Accept();
 
 private:
 	virtual bool OnSocketReady(unsigned flags) override;
@@ -127,6 +134,26 @@ private:
 
 static constexpr Domain server_socket_domain("server_socket");
 
+/**
+ * The listen() backlog.  It is large enough to hold the connection
+ * storm after a network outage, when all clients reconnect at once.
+ */
+static constexpr int LISTEN_BACKLOG = 64;
+
+/**
+ * The maximum number of connections accepted from one listener
+ * socket per #EventLoop iteration.  The rest stays in the kernel's
+ * backlog until the next iteration, so a connection storm cannot
+ * starve other events (e.g. the player's).
+ */
+static constexpr unsigned MAX_ACCEPT_BATCH = 16;
+
+/**
+ * How many seconds does the kernel wait for the first data of a
+ * connection on a TCP_DEFER_ACCEPT socket?
+ */
+static constexpr int DEFER_ACCEPT_SECONDS = 10;
+
 static int
 get_remote_uid(int fd)
 {
@@ -152,7 +179,7 @@ get_remote_uid(int fd)
 #endif
 }
 
-inline void
+inline bool
 OneServerSocket::Accept()
 {
 	StaticSocketAddress peer_address;
@@ -161,10 +188,14 @@ OneServerSocket::Accept()
 		accept_cloexec_nonblock(Get(), peer_address,
 					&peer_address_length);
 	if (peer_fd < 0) {
+		if (IsSocketErrorAgain(GetSocketError()))
+			/* the backlog is empty */
+			return false;
+
 		const SocketErrorMessage msg;
 		FormatError(server_socket_domain,
 			    "accept() failed: %s", (const char *)msg);
-		return;
+		return false;
 	}
 
 	peer_address.SetSize(peer_address_length);
@@ -178,12 +209,19 @@ OneServerSocket::Accept()
 
 	parent.OnAccept(peer_fd, peer_address,
 			get_remote_uid(peer_fd));
+	return true;
 }
 
 bool
 OneServerSocket::OnSocketReady(gcc_unused unsigned flags)
 {
-	Accept();
+	/* accept a batch of connections, but leave the rest for the
+	   next iteration; the socket is level-triggered, so we'll be
+	   called again */
+	for (unsigned i = 0; i < MAX_ACCEPT_BATCH && IsDefined(); ++i)
+		if (!Accept())
+			break;
+
 	return true;
 }
 
@@ -194,11 +232,24 @@ OneServerSocket::Open(Error &error)
 
 	int _fd = socket_bind_listen(address.GetFamily(),
 				     SOCK_STREAM, 0,
-				     address, 5,
+				     address, LISTEN_BACKLOG,
+				     parent.reuse_port,
 				     error);
 	if (_fd < 0)
 		return false;
 
+#ifdef TCP_DEFER_ACCEPT
+	if (parent.defer_accept &&
+	    (address.GetFamily() == AF_INET ||
+	     address.GetFamily() == AF_INET6)) {
+		/* not fatal: without it, the connection is merely
+		   reported earlier */
+		const int seconds = DEFER_ACCEPT_SECONDS;
+		setsockopt(_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+			   &seconds, sizeof(seconds));
+	}
+#endif
+
 #ifdef HAVE_UN
 	/* allow everybody to connect */
 
@@ -214,7 +265,8 @@ OneServerSocket::Open(Error &error)
 }
 
 ServerSocket::ServerSocket(EventLoop &_loop)
-	:loop(_loop), next_serial(1) {}
+	:loop(_loop), next_serial(1),
+	 reuse_port(false), defer_accept(false) {}
 
 /* this is just here to allow the OneServerSocket forward
    declaration */
@@ -281,6 +333,53 @@ ServerSocket::Open(Error &error)
 	return true;
 }
 
+bool
+ServerSocket::OpenAddresses(const std::vector<StaticSocketAddress> &addresses,
+			    Error &error)
+{
+	const unsigned serial = next_serial++;
+	bool good = false;
+	Error last_error;
+
+	for (const auto &address : addresses) {
+		sockets.emplace_back(loop, *this, serial, address);
+		OneServerSocket &s = sockets.back();
+
+		Error error2;
+		if (s.Open(error2)) {
+			good = true;
+			continue;
+		}
+
+		const auto address_string = s.ToString();
+		sockets.pop_back();
+
+		if (!last_error.IsDefined()) {
+			error2.FormatPrefix("Failed to bind to '%s': ",
+					    address_string.c_str());
+			last_error = std::move(error2);
+		} else
+			FormatWarning(server_socket_domain,
+				      "bind to '%s' failed: %s",
+				      address_string.c_str(),
+				      error2.GetMessage());
+	}
+
+	if (!good) {
+		if (last_error.IsDefined())
+			error = std::move(last_error);
+		else
+			error.Set(server_socket_domain, "No address");
+		return false;
+	}
+
+	if (last_error.IsDefined())
+		FormatWarning(server_socket_domain, "%s (continuing anyway)",
+			      last_error.GetMessage());
+
+	return true;
+}
+
 void
 ServerSocket::Close()
 {
@@ -419,6 +518,15 @@ ServerSocket::AddHost(const char *hostname, unsigned port, Error &error)
 #endif /* HAVE_TCP */
 }
 
+void
+ServerSocket::AddAddresses(const std::vector<StaticSocketAddress> &addresses)
+{
+	for (const auto &address : addresses)
+		AddAddress(address);
+
+	++next_serial;
+}
+
 bool
 ServerSocket::AddPath(AllocatedPath &&path, Error &error)
 {
@@ -21,10 +21,12 @@
 #define MPD_SERVER_SOCKET_HXX
 
 #include <list>
+#include <vector>
 
 #include <stddef.h>
 
 class SocketAddress;
+class StaticSocketAddress;
 class EventLoop;
 class Error;
 class AllocatedPath;
@@ -42,6 +44,16 @@ class ServerSocket {
 
 	unsigned next_serial;
 
+	/**
+	 * Set SO_REUSEPORT on all listener sockets?
+	 */
+	bool reuse_port;
+
+	/**
+	 * Set TCP_DEFER_ACCEPT on all TCP listener sockets?
+	 */
+	bool defer_accept;
+
 public:
 	ServerSocket(EventLoop &_loop);
 	~ServerSocket();
@@ -50,6 +62,30 @@ public:
 		return loop;
 	}
 
+	/**
+	 * Enable SO_REUSEPORT on the listener sockets.  This allows
+	 * several #ServerSocket instances (usually in different
+	 * threads) to listen on the same port; the kernel distributes
+	 * incoming connections among them.  Must be called before
+	 * Open().
+	 */
+	void SetReusePort(bool _reuse_port) {
+		reuse_port = _reuse_port;
+	}
+
+	/**
+	 * Enable TCP_DEFER_ACCEPT on the TCP listener sockets: the
+	 * kernel reports a connection only after the client has sent
+	 * its first data, which saves a wakeup per connection and
+	 * keeps half-open connections away from the #EventLoop.  Only
+	 * suitable for protocols where the client speaks first (e.g.
+	 * HTTP); the MPD protocol begins with the server's greeting.
+	 * Must be called before Open().
+	 */
+	void SetDeferAccept(bool _defer_accept) {
+		defer_accept = _defer_accept;
+	}
+
 private:
 	OneServerSocket &AddAddress(SocketAddress address);
 
@@ -88,6 +124,12 @@ public:
 	 */
 	bool AddHost(const char *hostname, unsigned port, Error &error);
 
+	/**
+	 * Adds listeners on all addresses of a resolved host name,
+	 * e.g. one obtained from AsyncResolver::LookupCached().
+	 */
+	void AddAddresses(const std::vector<StaticSocketAddress> &addresses);
+
 	/**
 	 * Add a listener on a Unix domain socket.
 	 *
@@ -107,6 +149,17 @@ public:
 	bool Open(Error &error);
 	void Close();
 
+	/**
+	 * Add listeners on all addresses of a resolved host name and
+	 * open them immediately.  Unlike Open(), this may be called
+	 * while the other listeners are already open, e.g. after an
+	 * asynchronous host name lookup has finished.
+	 *
+	 * @return true if at least one address could be bound
+	 */
+	bool OpenAddresses(const std::vector<StaticSocketAddress> &addresses,
+			   Error &error);
+
 protected:
 	virtual void OnAccept(int fd, SocketAddress address, int uid) = 0;
 };
@@ -24,11 +24,13 @@
 #include "Compiler.h"
 
 #include <assert.h>
+#include <string.h>
 
 #ifdef WIN32
 #include <winsock2.h>
 #else
 #include <sys/socket.h>
+#include <sys/uio.h>
 #endif
 
 void
@@ -130,3 +132,28 @@ SocketMonitor::Write(const void *data, size_t length)
 
 	return send(Get(), (const char *)data, length, flags);
 }
+
+#ifndef WIN32
+
+SocketMonitor::ssize_t
+SocketMonitor::Write(const struct iovec *iov, size_t n)
+{
+	assert(IsDefined());
+
+	int flags = 0;
+#ifdef MSG_NOSIGNAL
+	flags |= MSG_NOSIGNAL;
+#endif
+#ifdef MSG_DONTWAIT
+	flags |= MSG_DONTWAIT;
+#endif
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = const_cast<struct iovec *>(iov);
+	msg.msg_iovlen = n;
+
+	return sendmsg(Get(), &msg, flags);
+}
+
+#endif
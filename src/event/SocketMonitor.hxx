@@ -38,6 +38,10 @@
 
 class EventLoop;
 
+#ifndef WIN32
+struct iovec;
+#endif
+
 /**
  * Monitor events on a socket.  Call Schedule() to announce events
  * you're interested in, or Cancel() to cancel your subscription.  The
@@ -66,6 +70,13 @@ public:
 	static constexpr unsigned ERROR = PollGroup::ERROR;
 	static constexpr unsigned HANGUP = PollGroup::HANGUP;
 
+	/**
+	 * Schedule with this flag to get edge-triggered
+	 * notifications.  It is 0 if the #PollGroup does not support
+	 * it.
+	 */
+	static constexpr unsigned EDGE = PollGroup::EDGE;
+
 	typedef std::make_signed<size_t>::type ssize_t;
 
 	SocketMonitor(EventLoop &_loop)
@@ -136,6 +147,13 @@ public:
 	ssize_t Read(void *data, size_t length);
 	ssize_t Write(const void *data, size_t length);
 
+#ifndef WIN32
+	/**
+	 * Write several buffers with one system call.
+	 */
+	ssize_t Write(const struct iovec *iov, size_t n);
+#endif
+
 protected:
 	/**
 	 * @return false if the socket has been closed
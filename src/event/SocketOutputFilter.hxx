@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SOCKET_OUTPUT_FILTER_HXX
+#define MPD_SOCKET_OUTPUT_FILTER_HXX
+
+#include "check.h"
+
+#include <stdint.h>
+
+template<typename T> struct ConstBuffer;
+template<typename T> class DynamicFifoBuffer;
+class Error;
+
+/**
+ * Transforms data (e.g. compresses it) before a #FullyBufferedSocket
+ * sends it.  See FullyBufferedSocket::SetOutputFilter().
+ */
+class SocketOutputFilter {
+public:
+	virtual ~SocketOutputFilter() {}
+
+	/**
+	 * Transform a chunk of data and append the result to the
+	 * given buffer.  All of the result must be appended; the
+	 * socket does not call this method again until the buffer has
+	 * been sent.
+	 *
+	 * @return false on error
+	 */
+	virtual bool Filter(ConstBuffer<void> src,
+			    DynamicFifoBuffer<uint8_t> &dest,
+			    Error &error) = 0;
+};
+
+#endif
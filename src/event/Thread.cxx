@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Thread.hxx"
+#include "DeferredMonitor.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Name.hxx"
+
+#include <assert.h>
+
+/**
+ * Helper for EventThread::Start() which waits until the new thread
+ * has entered EventLoop::Run().  Until then, EventLoop::IsInside()
+ * must not be called, and therefore BlockingCall() cannot be used.
+ */
+class EventThreadStartMonitor final : DeferredMonitor {
+	Mutex mutex;
+	Cond cond;
+
+	bool running;
+
+public:
+	explicit EventThreadStartMonitor(EventLoop &_loop)
+		:DeferredMonitor(_loop), running(false) {}
+
+	void Wait() {
+		Schedule();
+
+		const ScopeLock protect(mutex);
+		while (!running)
+			cond.wait(mutex);
+	}
+
+private:
+	virtual void RunDeferred() override {
+		const ScopeLock protect(mutex);
+		running = true;
+		cond.signal();
+	}
+};
+
+bool
+EventThread::Start(Error &error)
+{
+	assert(!thread.IsDefined());
+
+	if (!thread.Start(ThreadFunc, this, error))
+		return false;
+
+	EventThreadStartMonitor m(event_loop);
+	m.Wait();
+	return true;
+}
+
+void
+EventThread::Stop()
+{
+	if (thread.IsDefined()) {
+		event_loop.Break();
+		thread.Join();
+	}
+}
+
+void
+EventThread::ThreadFunc(void *ctx)
+{
+	auto &et = *(EventThread *)ctx;
+
+	SetThreadName(et.name);
+
+	et.event_loop.Run();
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_EVENT_THREAD_HXX
+#define MPD_EVENT_THREAD_HXX
+
+#include "check.h"
+#include "Loop.hxx"
+#include "thread/Thread.hxx"
+
+class Error;
+
+/**
+ * A thread which runs an #EventLoop.
+ */
+class EventThread final {
+	EventLoop event_loop;
+
+	Thread thread;
+
+	/**
+	 * The name of the thread, see SetThreadName().
+	 */
+	const char *const name;
+
+public:
+	explicit EventThread(const char *_name):name(_name) {}
+
+	~EventThread() {
+		Stop();
+	}
+
+	EventThread(const EventThread &) = delete;
+	EventThread &operator=(const EventThread &) = delete;
+
+	EventLoop &GetEventLoop() {
+		return event_loop;
+	}
+
+	bool IsDefined() const {
+		return thread.IsDefined();
+	}
+
+	/**
+	 * Start the thread, and wait until its #EventLoop is running.
+	 * The #EventLoop cannot be restarted after Stop().
+	 */
+	bool Start(Error &error);
+
+	/**
+	 * Stop the #EventLoop and wait for the thread to exit.  Does
+	 * nothing if the thread is not running.
+	 */
+	void Stop();
+
+private:
+	static void ThreadFunc(void *ctx);
+};
+
+#endif
@@ -24,33 +24,30 @@
 void
 TimeoutMonitor::Cancel()
 {
-	if (IsActive()) {
-		active = false;
+	if (IsActive())
 		loop.CancelTimer(*this);
-	}
 }
 
 void
-
 TimeoutMonitor::Schedule(unsigned ms)
 {
-	Cancel();
-
-	active = true;
 	loop.AddTimer(*this, ms);
 }
 
 void
-TimeoutMonitor::ScheduleSeconds(unsigned s)
+TimeoutMonitor::ScheduleCoarse(unsigned ms)
 {
-	Cancel();
+	loop.AddCoarseTimer(*this, ms);
+}
 
-	Schedule(s * 1000u);
+void
+TimeoutMonitor::ScheduleSeconds(unsigned s)
+{
+	ScheduleCoarse(s * 1000u);
 }
 
 void
 TimeoutMonitor::Run()
 {
-	active = false;
 	OnTimeout();
 }
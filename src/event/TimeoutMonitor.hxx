@@ -21,6 +21,7 @@
 #define MPD_SOCKET_TIMEOUT_MONITOR_HXX
 
 #include "check.h"
+#include "TimerWheel.hxx"
 
 class EventLoop;
 
@@ -32,16 +33,14 @@ class EventLoop;
  * thread that runs the #EventLoop, except where explicitly documented
  * as thread-safe.
  */
-class TimeoutMonitor {
+class TimeoutMonitor : TimerWheel::Timer {
 	friend class EventLoop;
 
 	EventLoop &loop;
 
-	bool active;
-
 public:
 	TimeoutMonitor(EventLoop &_loop)
-		:loop(_loop), active(false) {
+		:loop(_loop) {
 	}
 
 	~TimeoutMonitor() {
@@ -53,10 +52,21 @@ public:
 	}
 
 	bool IsActive() const {
-		return active;
+		return IsScheduled();
 	}
 
 	void Schedule(unsigned ms);
+
+	/**
+	 * Like Schedule(), but allows the timer to fire up to 1/8 of
+	 * the duration late, which lets the #EventLoop batch timers.
+	 * Use this for timeouts which need no precision.
+	 */
+	void ScheduleCoarse(unsigned ms);
+
+	/**
+	 * Schedule a coarse timer (see ScheduleCoarse()) in seconds.
+	 */
 	void ScheduleSeconds(unsigned s);
 	void Cancel();
 
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "TimerWheel.hxx"
+
+#include <assert.h>
+
+/**
+ * Rotate the bits right, so bit 0 of the result is bit #n of the
+ * operand.
+ */
+static constexpr uint64_t
+RotateRight(uint64_t value, unsigned n)
+{
+	return n == 0
+		? value
+		: (value >> n) | (value << (64 - n));
+}
+
+TimerWheel::TimerWheel(uint64_t _now)
+	:now(_now)
+{
+	for (auto &i : occupied)
+		i = 0;
+}
+
+bool
+TimerWheel::IsEmpty() const
+{
+	for (auto i : occupied)
+		if (i != 0)
+			return false;
+
+	return true;
+}
+
+void
+TimerWheel::Insert(Timer &t)
+{
+	assert(!t.is_linked());
+	assert(t.due >= now);
+
+	unsigned level = 0;
+	while ((t.due >> Shift(level)) - (now >> Shift(level)) >= LEVEL_SIZE)
+		++level;
+
+	assert(level < NUM_LEVELS);
+
+	/* a timer above level 0 never lands in the slot which is
+	   current on its level; that slot has already been cascaded
+	   (or the timer would fit into a lower level) */
+	assert(level == 0 ||
+	       (t.due >> Shift(level)) != (now >> Shift(level)));
+
+	const unsigned index = (t.due >> Shift(level)) & LEVEL_MASK;
+	t.slot = level * LEVEL_SIZE + index;
+	slots[t.slot].push_back(t);
+	occupied[level] |= uint64_t(1) << index;
+}
+
+void
+TimerWheel::Add(Timer &t, uint64_t due)
+{
+	Remove(t);
+
+	t.due = due > now ? due : now;
+	Insert(t);
+}
+
+void
+TimerWheel::Remove(Timer &t)
+{
+	if (!t.is_linked())
+		return;
+
+	t.unlink();
+	ClearIfEmpty(t.slot);
+}
+
+uint64_t
+TimerWheel::GetNextEvent() const
+{
+	uint64_t result = UINT64_MAX;
+
+	for (unsigned level = 0; level < NUM_LEVELS; ++level) {
+		if (occupied[level] == 0)
+			continue;
+
+		const uint64_t base = now >> Shift(level);
+		const uint64_t bits =
+			RotateRight(occupied[level], base & LEVEL_MASK);
+		assert(bits != 0);
+
+		/* the distance (in slots of this level) to the next
+		   non-empty slot */
+		const unsigned distance = __builtin_ctzll(bits);
+		assert(level == 0 || distance > 0);
+
+		const uint64_t t = level == 0
+			? now + distance
+			: (base + distance) << Shift(level);
+		if (t < result)
+			result = t;
+	}
+
+	return result;
+}
+
+void
+TimerWheel::Cascade(unsigned level, unsigned index)
+{
+	const unsigned slot = level * LEVEL_SIZE + index;
+
+	TimerList tmp;
+	tmp.splice(tmp.end(), slots[slot]);
+	occupied[level] &= ~(uint64_t(1) << index);
+
+	while (!tmp.empty()) {
+		Timer &t = tmp.front();
+		tmp.pop_front();
+		Insert(t);
+	}
+}
+
+TimerWheel::Timer *
+TimerWheel::Pop(uint64_t _now)
+{
+	while (true) {
+		auto &current = slots[now & LEVEL_MASK];
+		if (!current.empty()) {
+			Timer &t = current.front();
+			assert(t.due == now);
+			current.pop_front();
+			ClearIfEmpty(t.slot);
+			return &t;
+		}
+
+		const uint64_t next = GetNextEvent();
+		if (next > _now) {
+			if (_now > now)
+				now = _now;
+			return nullptr;
+		}
+
+		/* jump straight to the next event; nothing can be
+		   missed in between */
+		assert(next > now);
+		now = next;
+
+		for (unsigned level = NUM_LEVELS - 1; level > 0; --level)
+			if ((now & ((uint64_t(1) << Shift(level)) - 1)) == 0)
+				Cascade(level,
+					(now >> Shift(level)) & LEVEL_MASK);
+	}
+}
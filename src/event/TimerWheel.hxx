@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TIMER_WHEEL_HXX
+#define MPD_TIMER_WHEEL_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <boost/intrusive/list.hpp>
+
+#include <stdint.h>
+
+/**
+ * A hierarchical timer wheel with millisecond resolution.  Adding and
+ * removing a timer is O(1) and does not allocate memory.
+ *
+ * Level 0 has one slot per millisecond; each higher level has slots
+ * which are 64 times wider than the ones below.  A timer is put into
+ * the lowest level which can hold its due time, and is moved
+ * ("cascaded") one or more levels down when the wheel reaches the
+ * beginning of its slot.
+ *
+ * This class is not thread-safe.
+ */
+class TimerWheel {
+	static constexpr unsigned LEVEL_BITS = 6;
+	static constexpr unsigned LEVEL_SIZE = 1u << LEVEL_BITS;
+	static constexpr unsigned LEVEL_MASK = LEVEL_SIZE - 1;
+
+	/**
+	 * Six levels cover 2^36 milliseconds, which is more than the
+	 * largest "unsigned" delay.
+	 */
+	static constexpr unsigned NUM_LEVELS = 6;
+
+public:
+	class Timer
+		: public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink>> {
+		friend class TimerWheel;
+
+		uint64_t due;
+
+		/**
+		 * The index of the slot this timer is in
+		 * (level * #LEVEL_SIZE + slot).
+		 */
+		unsigned slot;
+
+	public:
+		bool IsScheduled() const {
+			return is_linked();
+		}
+
+		uint64_t GetDue() const {
+			return due;
+		}
+	};
+
+private:
+	typedef boost::intrusive::list<Timer,
+				       boost::intrusive::constant_time_size<false>> TimerList;
+
+	/**
+	 * The current time of the wheel.  All timers which were due
+	 * before have been returned by Pop().
+	 */
+	uint64_t now;
+
+	/**
+	 * One bit per slot, set if the slot is non-empty.
+	 */
+	uint64_t occupied[NUM_LEVELS];
+
+	TimerList slots[NUM_LEVELS * LEVEL_SIZE];
+
+public:
+	explicit TimerWheel(uint64_t _now=0);
+
+	TimerWheel(const TimerWheel &) = delete;
+	TimerWheel &operator=(const TimerWheel &) = delete;
+
+	uint64_t GetNow() const {
+		return now;
+	}
+
+	gcc_pure
+	bool IsEmpty() const;
+
+	/**
+	 * Schedule a timer.  If it is already scheduled, it is moved.
+	 * A due time in the past is treated as "now".
+	 */
+	void Add(Timer &t, uint64_t due);
+
+	void Remove(Timer &t);
+
+	/**
+	 * Returns the time of the next event: either the due time of
+	 * a timer or the time when a higher level slot needs to be
+	 * cascaded (which is never later than the earliest timer in
+	 * it).  Returns UINT64_MAX if the wheel is empty.
+	 */
+	gcc_pure
+	uint64_t GetNextEvent() const;
+
+	/**
+	 * Advance the wheel up to the given time and remove and
+	 * return one timer which is due.  Returns nullptr if there is
+	 * none left; in that case, the wheel's time is the given time.
+	 */
+	Timer *Pop(uint64_t now);
+
+private:
+	static constexpr unsigned Shift(unsigned level) {
+		return level * LEVEL_BITS;
+	}
+
+	void Insert(Timer &t);
+
+	/**
+	 * Move all timers from the given slot to lower levels.
+	 */
+	void Cascade(unsigned level, unsigned index);
+
+	void ClearIfEmpty(unsigned slot) {
+		if (slots[slot].empty())
+			occupied[slot / LEVEL_SIZE] &=
+				~(uint64_t(1) << (slot % LEVEL_SIZE));
+	}
+};
+
+#endif
@@ -25,11 +25,14 @@
 #ifndef MPD_FILTER_INTERNAL_HXX
 #define MPD_FILTER_INTERNAL_HXX
 
+#include "util/ConstBuffer.hxx"
+#include "Compiler.h"
+
+#include <assert.h>
 #include <stddef.h>
 
 struct AudioFormat;
 class Error;
-template<typename T> struct ConstBuffer;
 
 class Filter {
 public:
@@ -62,6 +65,34 @@ public:
 	 * error
 	 */
 	virtual ConstBuffer<void> FilterPCM(ConstBuffer<void> src, Error &error) = 0;
+
+	/**
+	 * Does this filter implement FilterPCMTo(), i.e. can it write
+	 * its output into a buffer provided by the caller?  This is
+	 * only possible if the output has the same size as the input,
+	 * and if the filter cannot fail.  May only be called after a
+	 * successful Open().
+	 */
+	virtual bool CanFilterInPlace() const {
+		return false;
+	}
+
+	/**
+	 * Like FilterPCM(), but write the output into a buffer
+	 * provided by the caller.  The destination may be the same
+	 * as #src (in-place operation), but must not overlap it
+	 * otherwise.  Only allowed if CanFilterInPlace() has
+	 * returned true.
+	 *
+	 * @param dest a writable buffer of at least src.size bytes
+	 * @return the output, which is either {dest, src.size} or
+	 * #src itself if the filter had nothing to do
+	 */
+	virtual ConstBuffer<void> FilterPCMTo(ConstBuffer<void> src,
+					      gcc_unused void *dest) {
+		assert(false);
+		return src;
+	}
 };
 
 #endif
@@ -35,6 +35,8 @@ extern const struct filter_plugin route_filter_plugin;
 extern const struct filter_plugin normalize_filter_plugin;
 extern const struct filter_plugin volume_filter_plugin;
 extern const struct filter_plugin replay_gain_filter_plugin;
+extern const struct filter_plugin convolution_filter_plugin;
+extern const struct filter_plugin equalizer_filter_plugin;
 
 gcc_pure
 const struct filter_plugin *
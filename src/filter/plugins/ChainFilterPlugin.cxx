@@ -23,6 +23,7 @@
 #include "filter/FilterInternal.hxx"
 #include "filter/FilterRegistry.hxx"
 #include "AudioFormat.hxx"
+#include "pcm/PcmBuffer.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "util/ConstBuffer.hxx"
@@ -36,8 +37,14 @@ class ChainFilter final : public Filter {
 		const char *name;
 		Filter *filter;
 
+		/**
+		 * Shall FilterPCMTo() be used for this filter?
+		 * Determined by Open().
+		 */
+		bool in_place;
+
 		Child(const char *_name, Filter *_filter)
-			:name(_name), filter(_filter) {}
+			:name(_name), filter(_filter), in_place(false) {}
 		~Child() {
 			delete filter;
 		}
@@ -48,11 +55,22 @@ class ChainFilter final : public Filter {
 
 	std::list<Child> children;
 
+	/**
+	 * The buffer which is passed to the FilterPCMTo() method of
+	 * filters which can work in-place.  A run of such filters
+	 * processes the data in this buffer without copying it.
+	 */
+	PcmBuffer buffer;
+
 public:
 	void Append(const char *name, Filter *filter) {
 		children.emplace_back(name, filter);
 	}
 
+	bool IsEmpty() const {
+		return children.empty();
+	}
+
 	/* virtual methods from class Filter */
 	AudioFormat Open(AudioFormat &af, Error &error) override;
 	void Close() override;
@@ -132,6 +150,8 @@ ChainFilter::Open(AudioFormat &in_audio_format, Error &error)
 			CloseUntil(child.filter);
 			break;
 		}
+
+		child.in_place = child.filter->CanFilterInPlace();
 	}
 
 	/* return the output format of the last filter */
@@ -143,17 +163,36 @@ ChainFilter::Close()
 {
 	for (auto &child : children)
 		child.filter->Close();
+
+	buffer.Clear();
 }
 
 ConstBuffer<void>
 ChainFilter::FilterPCM(ConstBuffer<void> src, Error &error)
 {
+	/* is #src in our own #buffer, i.e. may it be modified? */
+	bool writable = false;
+
 	for (auto &child : children) {
 		/* feed the output of the previous filter as input
 		   into the current one */
+
+		if (child.in_place && !src.IsEmpty()) {
+			/* write into our own buffer; if the data is
+			   already there, this is done in-place */
+			void *dest = writable
+				? const_cast<void *>(src.data)
+				: buffer.Get(src.size);
+			src = child.filter->FilterPCMTo(src, dest);
+			writable = src.data == dest;
+			continue;
+		}
+
 		src = child.filter->FilterPCM(src, error);
 		if (src.IsNull())
 			return nullptr;
+
+		writable = false;
 	}
 
 	/* return the output of the last filter */
@@ -178,3 +217,11 @@ filter_chain_append(Filter &_chain, const char *name, Filter *filter)
 
 	chain.Append(name, filter);
 }
+
+bool
+filter_chain_is_empty(const Filter &_chain)
+{
+	const ChainFilter &chain = (const ChainFilter &)_chain;
+
+	return chain.IsEmpty();
+}
@@ -27,6 +27,8 @@
 #ifndef MPD_FILTER_CHAIN_HXX
 #define MPD_FILTER_CHAIN_HXX
 
+#include "Compiler.h"
+
 class Filter;
 
 /**
@@ -45,4 +47,11 @@ filter_chain_new();
 void
 filter_chain_append(Filter &chain, const char *name, Filter *filter);
 
+/**
+ * Does the filter chain contain no filters?
+ */
+gcc_pure
+bool
+filter_chain_is_empty(const Filter &chain);
+
 #endif
@@ -0,0 +1,536 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** \file
+ *
+ * This filter convolves each channel with an impulse response, e.g.
+ * for room correction.  The impulse responses are loaded from a WAV
+ * file: a mono file is applied to all channels, a file with more
+ * channels has one impulse response per channel (and the input is
+ * converted to its channel count).  The input is also converted to
+ * the sample rate of the file.
+ *
+ * The convolution is done with uniformly partitioned FFTs; the
+ * latency is one partition.  Optionally, half of the channels are
+ * convolved in a worker thread.
+ */
+
+#include "config.h"
+#include "filter/FilterPlugin.hxx"
+#include "filter/FilterInternal.hxx"
+#include "filter/FilterRegistry.hxx"
+#include "filter/plugins/AutoConvertFilterPlugin.hxx"
+#include "config/Block.hxx"
+#include "config/ConfigError.hxx"
+#include "pcm/Convolver.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "pcm/Simd.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/io/FileReader.hxx"
+#include "fs/FileInfo.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "system/ByteOrder.hxx"
+#include "AudioFormat.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#include <algorithm>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+static constexpr Domain convolution_domain("convolution");
+
+/**
+ * Refuse to load impulse response files larger than this.
+ */
+static constexpr uint64_t MAX_IR_FILE_SIZE = 256 * 1024 * 1024;
+
+/**
+ * Impulse responses loaded from a WAV file.
+ */
+struct ImpulseResponse {
+	unsigned sample_rate;
+
+	/**
+	 * One impulse response per channel.
+	 */
+	std::vector<std::vector<float>> channels;
+};
+
+static bool
+ReadWholeFile(Path path, std::vector<uint8_t> &data, Error &error)
+{
+	FileReader reader(path, error);
+	if (!reader.IsDefined())
+		return false;
+
+	FileInfo info;
+	if (!reader.GetFileInfo(info, error))
+		return false;
+
+	if (info.GetSize() > MAX_IR_FILE_SIZE) {
+		error.Set(convolution_domain, "Impulse response file is too large");
+		return false;
+	}
+
+	data.resize(info.GetSize());
+
+	size_t position = 0;
+	while (position < data.size()) {
+		size_t nbytes = reader.Read(data.data() + position,
+					    data.size() - position, error);
+		if (nbytes == 0) {
+			if (!error.IsDefined())
+				error.Set(convolution_domain,
+					  "Unexpected end of file");
+			return false;
+		}
+
+		position += nbytes;
+	}
+
+	return true;
+}
+
+static uint16_t
+ReadLE16(const uint8_t *p)
+{
+	uint16_t value;
+	memcpy(&value, p, sizeof(value));
+	return FromLE16(value);
+}
+
+static uint32_t
+ReadLE32(const uint8_t *p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return FromLE32(value);
+}
+
+/**
+ * Convert one sample of a WAV file to float.
+ */
+static float
+ConvertWaveSample(const uint8_t *p, unsigned bits, bool is_float)
+{
+	if (is_float) {
+		const uint32_t bits32 = ReadLE32(p);
+		float value;
+		memcpy(&value, &bits32, sizeof(value));
+		return value;
+	}
+
+	switch (bits) {
+	case 16:
+		return int16_t(ReadLE16(p)) / 32768.0f;
+
+	case 24:
+		return int32_t((uint32_t(p[0]) << 8) | (uint32_t(p[1]) << 16) |
+			       (uint32_t(p[2]) << 24)) / 2147483648.0f;
+
+	default:
+		return int32_t(ReadLE32(p)) / 2147483648.0f;
+	}
+}
+
+/**
+ * Load a RIFF WAVE file with 16, 24 or 32 bit integer samples or
+ * 32 bit floating point samples.
+ */
+static bool
+LoadImpulseResponse(Path path, ImpulseResponse &ir, Error &error)
+{
+	std::vector<uint8_t> data;
+	if (!ReadWholeFile(path, data, error))
+		return false;
+
+	if (data.size() < 12 || memcmp(data.data(), "RIFF", 4) != 0 ||
+	    memcmp(data.data() + 8, "WAVE", 4) != 0) {
+		error.Set(convolution_domain, "Not a WAV file");
+		return false;
+	}
+
+	unsigned channels = 0, bits = 0;
+	bool is_float = false;
+	const uint8_t *samples = nullptr;
+	size_t samples_size = 0;
+
+	for (size_t position = 12; position + 8 <= data.size();) {
+		const uint8_t *chunk = data.data() + position;
+		const size_t size = std::min<size_t>(ReadLE32(chunk + 4),
+						     data.size() - position - 8);
+		const uint8_t *body = chunk + 8;
+
+		if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+			unsigned format = ReadLE16(body);
+			channels = ReadLE16(body + 2);
+			ir.sample_rate = ReadLE32(body + 4);
+			bits = ReadLE16(body + 14);
+
+			/* WAVE_FORMAT_EXTENSIBLE: the format is the
+			   first two bytes of the sub-format GUID */
+			if (format == 0xfffe && size >= 26)
+				format = ReadLE16(body + 24);
+
+			if (format == 3 && bits == 32)
+				is_float = true;
+			else if (format != 1 ||
+				 (bits != 16 && bits != 24 && bits != 32)) {
+				error.Set(convolution_domain,
+					  "Unsupported WAV sample format");
+				return false;
+			}
+		} else if (memcmp(chunk, "data", 4) == 0) {
+			samples = body;
+			samples_size = size;
+		}
+
+		/* chunks are padded to an even size */
+		position += 8 + size + (size & 1);
+	}
+
+	if (channels == 0 || samples == nullptr) {
+		error.Set(convolution_domain, "Malformed WAV file");
+		return false;
+	}
+
+	if (!audio_valid_channel_count(channels)) {
+		error.Format(convolution_domain,
+			     "Unsupported channel count: %u", channels);
+		return false;
+	}
+
+	if (!audio_valid_sample_rate(ir.sample_rate)) {
+		error.Format(convolution_domain,
+			     "Unsupported sample rate: %u", ir.sample_rate);
+		return false;
+	}
+
+	const unsigned sample_size = bits / 8;
+	const size_t frames = samples_size / (sample_size * channels);
+	if (frames == 0) {
+		error.Set(convolution_domain, "Empty impulse response");
+		return false;
+	}
+
+	ir.channels.assign(channels, std::vector<float>(frames));
+	for (size_t i = 0; i < frames; ++i)
+		for (unsigned c = 0; c < channels; ++c)
+			ir.channels[c][i] =
+				ConvertWaveSample(samples +
+						  (i * channels + c) * sample_size,
+						  bits, is_float);
+
+	return true;
+}
+
+class ConvolutionFilter final : public Filter {
+	const ImpulseResponse ir;
+
+	/**
+	 * The partition size, in frames.
+	 */
+	const unsigned block_size;
+
+	/**
+	 * Convolve half of the channels in #thread?
+	 */
+	const bool use_thread;
+
+	unsigned channels;
+
+	std::vector<PartitionedConvolver *> convolvers;
+
+	/**
+	 * The current input block and the output of the previous
+	 * one, one block per channel.
+	 */
+	std::vector<float> in_blocks, out_blocks;
+
+	/**
+	 * Pointers into #in_blocks at #position, for
+	 * PcmSimd::deinterleave_float().
+	 */
+	std::vector<float *> in_pointers;
+
+	/**
+	 * The number of frames in the current input block.
+	 */
+	unsigned position;
+
+	PcmBuffer buffer;
+
+	Thread thread;
+
+	/**
+	 * Protects #work_pending and #quit.
+	 */
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * The channels below this one are convolved by #thread.
+	 */
+	unsigned split;
+
+	/**
+	 * Shall #thread convolve its channels of the current block?
+	 * It clears this flag when it is done.
+	 */
+	bool work_pending;
+
+	bool quit;
+
+public:
+	ConvolutionFilter(ImpulseResponse &&_ir, unsigned _block_size,
+			  bool _use_thread)
+		:ir(std::move(_ir)), block_size(_block_size),
+		 use_thread(_use_thread) {}
+
+	/* virtual methods from class Filter */
+	AudioFormat Open(AudioFormat &af, Error &error) override;
+	void Close() override;
+	ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
+				    Error &error) override;
+
+	bool CanFilterInPlace() const override {
+		return true;
+	}
+
+	ConstBuffer<void> FilterPCMTo(ConstBuffer<void> src,
+				      void *dest) override;
+
+private:
+	void ConvolveChannels(unsigned start, unsigned end);
+
+	/**
+	 * Convolve the complete input block of all channels.
+	 */
+	void ProcessBlock();
+
+	void ThreadFunc();
+	static void ThreadFunc(void *ctx);
+};
+
+static Filter *
+convolution_filter_init(const ConfigBlock &block, Error &error)
+{
+	const AllocatedPath path = block.GetBlockPath("path", error);
+	if (path.IsNull()) {
+		if (!error.IsDefined())
+			error.Set(config_domain,
+				  "No \"path\" parameter specified");
+		return nullptr;
+	}
+
+	const unsigned block_size =
+		block.GetBlockValue("partition_size", 1024u);
+	if (block_size < 16 || block_size > 65536 ||
+	    (block_size & (block_size - 1)) != 0) {
+		error.Format(config_domain,
+			     "Invalid partition_size: %u", block_size);
+		return nullptr;
+	}
+
+	ImpulseResponse ir;
+	if (!LoadImpulseResponse(path, ir, error)) {
+		error.FormatPrefix("Failed to load impulse response from \"%s\": ",
+				   path.ToUTF8().c_str());
+		return nullptr;
+	}
+
+	/* the input is converted to the format of the impulse
+	   response */
+	return autoconvert_filter_new(new ConvolutionFilter(std::move(ir),
+							    block_size,
+							    block.GetBlockValue("thread",
+										false)));
+}
+
+AudioFormat
+ConvolutionFilter::Open(AudioFormat &audio_format, Error &error)
+{
+	audio_format.format = SampleFormat::FLOAT;
+	audio_format.sample_rate = ir.sample_rate;
+	if (ir.channels.size() > 1)
+		audio_format.channels = ir.channels.size();
+
+	channels = audio_format.channels;
+
+	for (unsigned c = 0; c < channels; ++c) {
+		const auto &response = ir.channels.size() > 1
+			? ir.channels[c]
+			: ir.channels.front();
+		convolvers.push_back(new PartitionedConvolver(response.data(),
+							      response.size(),
+							      block_size));
+	}
+
+	in_blocks.assign(channels * block_size, 0.0f);
+	out_blocks.assign(channels * block_size, 0.0f);
+	in_pointers.resize(channels);
+	position = 0;
+
+	if (use_thread && channels > 1) {
+		split = channels / 2;
+		work_pending = false;
+		quit = false;
+
+		if (!thread.Start(ThreadFunc, this, error)) {
+			Close();
+			return AudioFormat::Undefined();
+		}
+	}
+
+	return audio_format;
+}
+
+void
+ConvolutionFilter::Close()
+{
+	if (thread.IsDefined()) {
+		mutex.lock();
+		quit = true;
+		cond.broadcast();
+		mutex.unlock();
+
+		thread.Join();
+	}
+
+	for (auto *convolver : convolvers)
+		delete convolver;
+	convolvers.clear();
+
+	buffer.Clear();
+}
+
+inline void
+ConvolutionFilter::ConvolveChannels(unsigned start, unsigned end)
+{
+	for (unsigned c = start; c < end; ++c)
+		convolvers[c]->Process(&in_blocks[c * block_size],
+				       &out_blocks[c * block_size]);
+}
+
+inline void
+ConvolutionFilter::ProcessBlock()
+{
+	if (!thread.IsDefined()) {
+		ConvolveChannels(0, channels);
+		return;
+	}
+
+	mutex.lock();
+	work_pending = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	ConvolveChannels(split, channels);
+
+	mutex.lock();
+	while (work_pending)
+		cond.wait(mutex);
+	mutex.unlock();
+}
+
+inline void
+ConvolutionFilter::ThreadFunc()
+{
+	SetThreadName("convolution");
+
+	const ScopeLock protect(mutex);
+
+	while (!quit) {
+		if (!work_pending) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		mutex.unlock();
+		ConvolveChannels(0, split);
+		mutex.lock();
+
+		work_pending = false;
+		cond.broadcast();
+	}
+}
+
+void
+ConvolutionFilter::ThreadFunc(void *ctx)
+{
+	ConvolutionFilter &filter = *(ConvolutionFilter *)ctx;
+	filter.ThreadFunc();
+}
+
+ConstBuffer<void>
+ConvolutionFilter::FilterPCM(ConstBuffer<void> src, gcc_unused Error &error)
+{
+	return FilterPCMTo(src, buffer.Get(src.size));
+}
+
+ConstBuffer<void>
+ConvolutionFilter::FilterPCMTo(ConstBuffer<void> _src, void *_dest)
+{
+	const float *src = (const float *)_src.data;
+	float *dest = (float *)_dest;
+	size_t frames = _src.size / (channels * sizeof(float));
+
+	/* each frame is replaced with the output frame from one block
+	   ago; the size does not change */
+	while (frames > 0) {
+		const size_t n = std::min<size_t>(frames,
+						  block_size - position);
+
+		/* read before writing: #dest may be equal to #src */
+		for (unsigned c = 0; c < channels; ++c)
+			in_pointers[c] = &in_blocks[c * block_size + position];
+		GetPcmSimd().deinterleave_float(in_pointers.data(), src, n,
+						channels);
+
+		for (size_t i = 0; i < n; ++i)
+			for (unsigned c = 0; c < channels; ++c)
+				dest[i * channels + c] =
+					out_blocks[c * block_size + position + i];
+
+		src += n * channels;
+		dest += n * channels;
+		frames -= n;
+		position += n;
+
+		if (position == block_size) {
+			ProcessBlock();
+			position = 0;
+		}
+	}
+
+	return { _dest, _src.size };
+}
+
+const struct filter_plugin convolution_filter_plugin = {
+	"convolution",
+	convolution_filter_init,
+};
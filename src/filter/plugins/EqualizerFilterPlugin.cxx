@@ -0,0 +1,353 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** \file
+ *
+ * A parametric equalizer: a cascade of biquad filters configured
+ * with a "bands" setting, e.g.:
+ *
+ * bands "lowshelf:100:3, peak:1000:-2:1.4, highshelf:8000:2"
+ *
+ * Each band is "type:frequency[:gain[:q]]"; the gain is in dB
+ * (default 0), the quality defaults to 0.707.  Float input is
+ * filtered in floating point, everything else is converted to 32 bit
+ * integers and filtered in fixed point.
+ *
+ * All filters created from the same template share their settings,
+ * which can be changed at runtime with the "setequalizer" command.
+ */
+
+#include "config.h"
+#include "EqualizerFilterPlugin.hxx"
+#include "filter/FilterPlugin.hxx"
+#include "filter/FilterInternal.hxx"
+#include "filter/FilterRegistry.hxx"
+#include "filter/plugins/AutoConvertFilterPlugin.hxx"
+#include "config/Block.hxx"
+#include "config/ConfigError.hxx"
+#include "pcm/Equalizer.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "thread/Mutex.hxx"
+#include "AudioFormat.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/NumberParser.hxx"
+#include "util/SplitString.hxx"
+#include "util/Error.hxx"
+
+#include <atomic>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <assert.h>
+#include <string.h>
+
+/**
+ * The settings of all filters created from one template.  They are
+ * shared with the output threads.
+ */
+struct EqualizerSettings {
+	const std::string name;
+
+	/**
+	 * The number of #EqualizerFilter instances using this
+	 * object.  Only accessed by the main thread.
+	 */
+	unsigned ref = 0;
+
+	Mutex mutex;
+
+	/**
+	 * Protected by #mutex.  Bands may be modified, but never
+	 * added or removed.
+	 */
+	std::vector<EqualizerBand> bands;
+
+	/**
+	 * Incremented after each modification of #bands, so the
+	 * filters can check for changes without locking #mutex.
+	 */
+	std::atomic_uint serial;
+
+	EqualizerSettings(const char *_name,
+			  std::vector<EqualizerBand> &&_bands)
+		:name(_name), bands(std::move(_bands)), serial(0) {}
+};
+
+/**
+ * All #EqualizerSettings which are in use.  Only accessed by the
+ * main thread.
+ */
+static std::list<EqualizerSettings> equalizer_settings;
+
+gcc_pure
+static EqualizerSettings *
+FindEqualizerSettings(const char *name)
+{
+	for (auto &i : equalizer_settings)
+		if (i.name == name)
+			return &i;
+
+	return nullptr;
+}
+
+class EqualizerFilter final : public Filter {
+	EqualizerSettings &settings;
+
+	/**
+	 * The EqualizerSettings::serial value #eq was configured
+	 * with.
+	 */
+	unsigned serial;
+
+	/**
+	 * A copy of EqualizerSettings::bands, to calculate the
+	 * coefficients outside of the lock.
+	 */
+	std::vector<EqualizerBand> bands;
+
+	PcmEqualizer eq;
+
+	PcmBuffer buffer;
+
+public:
+	explicit EqualizerFilter(EqualizerSettings &_settings)
+		:settings(_settings) {
+		++settings.ref;
+	}
+
+	~EqualizerFilter() {
+		assert(settings.ref > 0);
+
+		if (--settings.ref == 0)
+			equalizer_settings.remove_if([this](const EqualizerSettings &s){
+					return &s == &settings;
+				});
+	}
+
+	/* virtual methods from class Filter */
+	AudioFormat Open(AudioFormat &af, Error &error) override;
+	void Close() override;
+	ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
+				    Error &error) override;
+
+	bool CanFilterInPlace() const override {
+		return true;
+	}
+
+	ConstBuffer<void> FilterPCMTo(ConstBuffer<void> src,
+				      void *dest) override;
+
+private:
+	/**
+	 * Recalculate the coefficients if the settings have been
+	 * changed.  Called in the output thread.
+	 */
+	void Update(bool force=false);
+};
+
+/**
+ * Parse one "type:frequency[:gain[:q]]" band specification.
+ */
+static bool
+ParseEqualizerBand(const std::string &spec, EqualizerBand &band,
+		   Error &error)
+{
+	const auto fields = SplitString(spec.c_str(), ':');
+	auto i = fields.begin();
+
+	if (i == fields.end() || !ParseEqualizerBandType(i->c_str(),
+							 band.type)) {
+		error.Format(config_domain,
+			     "Malformed equalizer band: \"%s\"",
+			     spec.c_str());
+		return false;
+	}
+
+	band.frequency = 0;
+	band.gain = 0;
+	band.q = 0.707f;
+
+	float *const values[] = { &band.frequency, &band.gain, &band.q };
+	for (float *value : values) {
+		if (++i == fields.end())
+			break;
+
+		char *endptr;
+		*value = ParseFloat(i->c_str(), &endptr);
+		if (endptr == i->c_str() || *endptr != 0) {
+			error.Format(config_domain,
+				     "Malformed equalizer band: \"%s\"",
+				     spec.c_str());
+			return false;
+		}
+	}
+
+	if (i != fields.end() && ++i != fields.end()) {
+		error.Format(config_domain,
+			     "Malformed equalizer band: \"%s\"",
+			     spec.c_str());
+		return false;
+	}
+
+	if (!(band.frequency > 0) || !(band.q > 0) ||
+	    !(band.gain >= -EQUALIZER_MAX_GAIN) ||
+	    !(band.gain <= EQUALIZER_MAX_GAIN)) {
+		error.Format(config_domain,
+			     "Invalid equalizer band: \"%s\"",
+			     spec.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+static Filter *
+equalizer_filter_init(const ConfigBlock &block, Error &error)
+{
+	const char *name = block.GetBlockValue("name", "equalizer");
+
+	EqualizerSettings *settings = FindEqualizerSettings(name);
+	if (settings == nullptr) {
+		const char *spec = block.GetBlockValue("bands");
+		if (spec == nullptr) {
+			error.Set(config_domain,
+				  "No \"bands\" parameter specified");
+			return nullptr;
+		}
+
+		std::vector<EqualizerBand> bands;
+		for (const auto &i : SplitString(spec, ',')) {
+			EqualizerBand band;
+			if (!ParseEqualizerBand(i, band, error))
+				return nullptr;
+
+			bands.push_back(band);
+		}
+
+		equalizer_settings.emplace_back(name, std::move(bands));
+		settings = &equalizer_settings.back();
+	}
+
+	/* the input is converted to a format supported by
+	   PcmEqualizer */
+	return autoconvert_filter_new(new EqualizerFilter(*settings));
+}
+
+inline void
+EqualizerFilter::Update(bool force)
+{
+	const unsigned new_serial =
+		settings.serial.load(std::memory_order_acquire);
+	if (new_serial == serial && !force)
+		return;
+
+	serial = new_serial;
+
+	settings.mutex.lock();
+	bands = settings.bands;
+	settings.mutex.unlock();
+
+	eq.SetBands({bands.data(), bands.size()});
+}
+
+AudioFormat
+EqualizerFilter::Open(AudioFormat &audio_format, gcc_unused Error &error)
+{
+	if (!PcmEqualizer::IsSupported(audio_format.format))
+		audio_format.format =
+			audio_format.format == SampleFormat::DSD
+			? SampleFormat::FLOAT
+			: SampleFormat::S32;
+
+	eq.Open(audio_format.format, audio_format.channels,
+		audio_format.sample_rate);
+	Update(true);
+
+	return audio_format;
+}
+
+void
+EqualizerFilter::Close()
+{
+	buffer.Clear();
+}
+
+ConstBuffer<void>
+EqualizerFilter::FilterPCM(ConstBuffer<void> src, gcc_unused Error &error)
+{
+	return FilterPCMTo(src, buffer.Get(src.size));
+}
+
+ConstBuffer<void>
+EqualizerFilter::FilterPCMTo(ConstBuffer<void> src, void *dest)
+{
+	Update();
+
+	if (dest != src.data)
+		memcpy(dest, src.data, src.size);
+
+	eq.Apply(dest, src.size);
+	return { dest, src.size };
+}
+
+const struct filter_plugin equalizer_filter_plugin = {
+	"equalizer",
+	equalizer_filter_init,
+};
+
+void
+equalizer_filter_visit(const std::function<void(const char *name,
+						unsigned n,
+						const EqualizerBand &band)> &f)
+{
+	for (const auto &settings : equalizer_settings)
+		/* no lock: only the main thread modifies the
+		   settings */
+		for (unsigned i = 0; i < settings.bands.size(); ++i)
+			f(settings.name.c_str(), i, settings.bands[i]);
+}
+
+bool
+equalizer_filter_get_band(const char *name, unsigned n,
+			  EqualizerBand &band_r)
+{
+	const EqualizerSettings *settings = FindEqualizerSettings(name);
+	if (settings == nullptr || n >= settings->bands.size())
+		return false;
+
+	band_r = settings->bands[n];
+	return true;
+}
+
+bool
+equalizer_filter_set_band(const char *name, unsigned n,
+			  const EqualizerBand &band)
+{
+	EqualizerSettings *settings = FindEqualizerSettings(name);
+	if (settings == nullptr || n >= settings->bands.size())
+		return false;
+
+	settings->mutex.lock();
+	settings->bands[n] = band;
+	settings->mutex.unlock();
+
+	settings->serial.fetch_add(1, std::memory_order_release);
+	return true;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_EQUALIZER_FILTER_PLUGIN_HXX
+#define MPD_EQUALIZER_FILTER_PLUGIN_HXX
+
+#include <functional>
+
+struct EqualizerBand;
+
+/**
+ * Invoke a function for each band of each "equalizer" filter
+ * template which is in use.  Must be called from the main thread.
+ *
+ * @param f a function receiving the template name, the band number
+ * and the band's current settings
+ */
+void
+equalizer_filter_visit(const std::function<void(const char *name,
+						unsigned n,
+						const EqualizerBand &band)> &f);
+
+/**
+ * Look up the current settings of one band.  Must be called from
+ * the main thread.
+ *
+ * @param name the name of the "filter" block
+ * @return false if there is no such equalizer or band
+ */
+bool
+equalizer_filter_get_band(const char *name, unsigned n,
+			  EqualizerBand &band_r);
+
+/**
+ * Change the settings of one band of all filters created from the
+ * specified template.  The output threads pick up the new
+ * coefficients with the next chunk; the filter chain is not
+ * reopened.  Must be called from the main thread.
+ *
+ * @return false if there is no such equalizer or band
+ */
+bool
+equalizer_filter_set_band(const char *name, unsigned n,
+			  const EqualizerBand &band);
+
+#endif
@@ -22,14 +22,14 @@
 #include "filter/FilterInternal.hxx"
 #include "filter/FilterRegistry.hxx"
 #include "pcm/PcmBuffer.hxx"
+#include "pcm/Normalizer.hxx"
 #include "AudioFormat.hxx"
-#include "AudioCompress/compress.h"
 #include "util/ConstBuffer.hxx"
 
 #include <string.h>
 
 class NormalizeFilter final : public Filter {
-	struct Compressor *compressor;
+	PcmNormalizer normalizer;
 
 	PcmBuffer buffer;
 
@@ -39,6 +39,13 @@ public:
 	void Close() override;
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
 				    Error &error) override;
+
+	bool CanFilterInPlace() const override {
+		return true;
+	}
+
+	ConstBuffer<void> FilterPCMTo(ConstBuffer<void> src,
+				      void *dest) override;
 };
 
 static Filter *
@@ -51,9 +58,11 @@ normalize_filter_init(gcc_unused const ConfigBlock &block,
 AudioFormat
 NormalizeFilter::Open(AudioFormat &audio_format, gcc_unused Error &error)
 {
-	audio_format.format = SampleFormat::S16;
+	/* other formats are converted by the autoconvert filter */
+	if (!PcmNormalizer::IsSupported(audio_format.format))
+		audio_format.format = SampleFormat::S16;
 
-	compressor = Compressor_new(0);
+	normalizer.Open(audio_format.format);
 
 	return audio_format;
 }
@@ -62,16 +71,22 @@ void
 NormalizeFilter::Close()
 {
 	buffer.Clear();
-	Compressor_delete(compressor);
 }
 
 ConstBuffer<void>
 NormalizeFilter::FilterPCM(ConstBuffer<void> src, gcc_unused Error &error)
 {
-	int16_t *dest = (int16_t *)buffer.Get(src.size);
-	memcpy(dest, src.data, src.size);
+	return FilterPCMTo(src, buffer.Get(src.size));
+}
+
+ConstBuffer<void>
+NormalizeFilter::FilterPCMTo(ConstBuffer<void> src, void *dest)
+{
+	/* the normalizer works in-place */
+	if (dest != src.data)
+		memcpy(dest, src.data, src.size);
 
-	Compressor_Process_int16(compressor, dest, src.size / 2);
+	normalizer.Process(dest, src.size);
 	return { (const void *)dest, src.size };
 }
 
@@ -107,6 +107,10 @@ public:
 		Update();
 	}
 
+	unsigned GetVolume() const {
+		return pv.GetVolume();
+	}
+
 	/**
 	 * Recalculates the new volume after a property was changed.
 	 */
@@ -117,6 +121,13 @@ public:
 	void Close() override;
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
 				    Error &error) override;
+
+	bool CanFilterInPlace() const override {
+		return true;
+	}
+
+	ConstBuffer<void> FilterPCMTo(ConstBuffer<void> src,
+				      void *dest) override;
 };
 
 void
@@ -177,6 +188,12 @@ ReplayGainFilter::FilterPCM(ConstBuffer<void> src, gcc_unused Error &error)
 	return pv.Apply(src);
 }
 
+ConstBuffer<void>
+ReplayGainFilter::FilterPCMTo(ConstBuffer<void> src, void *dest)
+{
+	return pv.Apply(src, dest);
+}
+
 const struct filter_plugin replay_gain_filter_plugin = {
 	"replay_gain",
 	replay_gain_filter_init,
@@ -206,3 +223,11 @@ replay_gain_filter_set_mode(Filter *_filter, ReplayGainMode mode)
 
 	filter->SetMode(mode);
 }
+
+unsigned
+replay_gain_filter_get_volume(const Filter *_filter)
+{
+	const ReplayGainFilter *filter = (const ReplayGainFilter *)_filter;
+
+	return filter->GetVolume();
+}
@@ -21,6 +21,7 @@
 #define MPD_REPLAY_GAIN_FILTER_PLUGIN_HXX
 
 #include "ReplayGainInfo.hxx"
+#include "Compiler.h"
 
 class Filter;
 class Mixer;
@@ -49,4 +50,12 @@ replay_gain_filter_set_info(Filter *filter, const ReplayGainInfo *info);
 void
 replay_gain_filter_set_mode(Filter *filter, ReplayGainMode mode);
 
+/**
+ * Returns the volume level (see #PCM_VOLUME_1) which the filter
+ * applies for the current #ReplayGainInfo and mode.
+ */
+gcc_pure
+unsigned
+replay_gain_filter_get_volume(const Filter *filter);
+
 #endif
@@ -47,6 +47,7 @@
 #include "filter/FilterInternal.hxx"
 #include "filter/FilterRegistry.hxx"
 #include "pcm/PcmBuffer.hxx"
+#include "pcm/Simd.hxx"
 #include "util/StringUtil.hxx"
 #include "util/Error.hxx"
 #include "util/ConstBuffer.hxx"
@@ -54,7 +55,6 @@
 #include <algorithm>
 
 #include <assert.h>
-#include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -81,6 +81,19 @@ class RouteFilter final : public Filter {
 	 */
 	int8_t sources[MAX_CHANNELS];
 
+	/**
+	 * The routing table compiled for the current input format by
+	 * Open(): like #sources, but -1 for all sources which are not
+	 * present in the input.
+	 */
+	int8_t map[MAX_CHANNELS];
+
+	/**
+	 * True if the routing table is the identity for the current
+	 * input format, i.e. FilterPCM() can return the input as-is.
+	 */
+	bool passthrough;
+
 	/**
 	 * The actual input format of our signal, once opened
 	 */
@@ -120,11 +133,26 @@ public:
 	 */
 	bool Configure(const ConfigBlock &block, Error &error);
 
+private:
+	/**
+	 * Route #n frames from #src to #dest, which must not
+	 * overlap.
+	 */
+	void Route(const void *src, void *dest, size_t n) const;
+
+public:
 	/* virtual methods from class Filter */
 	AudioFormat Open(AudioFormat &af, Error &error) override;
 	void Close() override;
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
 				    Error &error) override;
+
+	bool CanFilterInPlace() const override {
+		return output_format.channels == input_format.channels;
+	}
+
+	ConstBuffer<void> FilterPCMTo(ConstBuffer<void> src,
+				      void *dest) override;
 };
 
 bool
@@ -231,6 +259,17 @@ RouteFilter::Open(AudioFormat &audio_format, gcc_unused Error &error)
 	// Precalculate this simple value, to speed up allocation later
 	output_frame_size = output_format.GetFrameSize();
 
+	passthrough = output_format.channels == input_format.channels;
+	for (unsigned c = 0; c < min_output_channels; ++c) {
+		map[c] = sources[c] >= 0 &&
+			unsigned(sources[c]) < input_format.channels
+			? sources[c]
+			: -1;
+
+		if (map[c] != int(c))
+			passthrough = false;
+	}
+
 	return output_format;
 }
 
@@ -240,55 +279,116 @@ RouteFilter::Close()
 	output_buffer.Clear();
 }
 
+template<typename T>
+static void
+RouteFrames(T *gcc_restrict dest, const T *gcc_restrict src, size_t n,
+	    unsigned src_channels, unsigned dest_channels,
+	    const int8_t *map)
+{
+	for (size_t i = 0; i != n; ++i, src += src_channels)
+		for (unsigned c = 0; c < dest_channels; ++c)
+			*dest++ = map[c] >= 0 ? src[map[c]] : 0;
+}
+
+/**
+ * Route frames in-place: each frame is copied to a temporary buffer
+ * first, because the routing table may read a channel after it has
+ * been overwritten.
+ */
+template<typename T>
+static void
+RouteFramesInPlace(T *data, size_t n, unsigned channels, const int8_t *map)
+{
+	T frame[MAX_CHANNELS];
+
+	for (size_t i = 0; i != n; ++i, data += channels) {
+		std::copy_n(data, channels, frame);
+		for (unsigned c = 0; c < channels; ++c)
+			data[c] = map[c] >= 0 ? frame[map[c]] : 0;
+	}
+}
+
+void
+RouteFilter::Route(const void *src, void *dest, size_t n) const
+{
+	switch (input_format.GetSampleSize()) {
+	case 1:
+		RouteFrames((uint8_t *)dest, (const uint8_t *)src, n,
+			    input_format.channels, min_output_channels, map);
+		break;
+
+	case 2:
+		RouteFrames((uint16_t *)dest, (const uint16_t *)src, n,
+			    input_format.channels, min_output_channels, map);
+		break;
+
+	case 4:
+		GetPcmSimd().route_32((uint32_t *)dest, (const uint32_t *)src,
+				      n, input_format.channels,
+				      min_output_channels, map);
+		break;
+
+	default:
+		assert(false);
+		gcc_unreachable();
+	}
+}
+
 ConstBuffer<void>
 RouteFilter::FilterPCM(ConstBuffer<void> src, gcc_unused Error &error)
 {
-	size_t number_of_frames = src.size / input_frame_size;
-
-	const size_t bytes_per_frame_per_channel = input_format.GetSampleSize();
+	if (passthrough)
+		return src;
 
-	// A moving pointer that always refers to channel 0 in the input, at the currently handled frame
-	const uint8_t *base_source = (const uint8_t *)src.data;
+	const size_t number_of_frames = src.size / input_frame_size;
 
-	// Grow our reusable buffer, if needed, and set the moving pointer
+	// Grow our reusable buffer, if needed
 	const size_t result_size = number_of_frames * output_frame_size;
 	void *const result = output_buffer.Get(result_size);
 
-	// A moving pointer that always refers to the currently filled channel of the currently handled frame, in the output
-	uint8_t *chan_destination = (uint8_t *)result;
-
-	// Perform our copy operations, with N input channels and M output channels
-	for (unsigned int s=0; s<number_of_frames; ++s) {
-
-		// Need to perform one copy per output channel
-		for (unsigned int c=0; c<min_output_channels; ++c) {
-			if (sources[c] == -1 ||
-			    (unsigned)sources[c] >= input_format.channels) {
-				// No source for this destination output,
-				// give it zeroes as input
-				memset(chan_destination,
-					0x00,
-					bytes_per_frame_per_channel);
-			} else {
-				// Get the data from channel sources[c]
-				// and copy it to the output
-				const uint8_t *data = base_source +
-					(sources[c] * bytes_per_frame_per_channel);
-				memcpy(chan_destination,
-					  data,
-					  bytes_per_frame_per_channel);
-			}
-			// Move on to the next output channel
-			chan_destination += bytes_per_frame_per_channel;
-		}
+	Route(src.data, result, number_of_frames);
+
+	// Here it is, ladies and gentlemen! Rerouted data!
+	return { result, result_size };
+}
+
+ConstBuffer<void>
+RouteFilter::FilterPCMTo(ConstBuffer<void> src, void *dest)
+{
+	assert(CanFilterInPlace());
 
+	if (passthrough)
+		return src;
 
-		// Go on to the next N input samples
-		base_source += input_frame_size;
+	const size_t number_of_frames = src.size / input_frame_size;
+
+	if (dest != src.data) {
+		Route(src.data, dest, number_of_frames);
+		return { dest, src.size };
 	}
 
-	// Here it is, ladies and gentlemen! Rerouted data!
-	return { result, result_size };
+	switch (input_format.GetSampleSize()) {
+	case 1:
+		RouteFramesInPlace((uint8_t *)dest, number_of_frames,
+				   input_format.channels, map);
+		break;
+
+	case 2:
+		RouteFramesInPlace((uint16_t *)dest, number_of_frames,
+				   input_format.channels, map);
+		break;
+
+	case 4:
+		RouteFramesInPlace((uint32_t *)dest, number_of_frames,
+				   input_format.channels, map);
+		break;
+
+	default:
+		assert(false);
+		gcc_unreachable();
+	}
+
+	return { dest, src.size };
 }
 
 const struct filter_plugin route_filter_plugin = {
@@ -34,13 +34,27 @@
 class VolumeFilter final : public Filter {
 	PcmVolume pv;
 
+	/**
+	 * The volume level set by the mixer.
+	 */
+	unsigned volume = PCM_VOLUME_1;
+
+	/**
+	 * An additional gain set by volume_filter_set_gain().
+	 */
+	unsigned gain = PCM_VOLUME_1;
+
 public:
 	unsigned GetVolume() const {
-		return pv.GetVolume();
+		return volume;
 	}
 
 	void SetVolume(unsigned _volume) {
-		pv.SetVolume(_volume);
+		volume = _volume;
+	}
+
+	void SetGain(unsigned _gain) {
+		gain = _gain;
 	}
 
 	/* virtual methods from class Filter */
@@ -48,6 +62,26 @@ public:
 	void Close() override;
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
 				    Error &error) override;
+
+	bool CanFilterInPlace() const override {
+		return true;
+	}
+
+	ConstBuffer<void> FilterPCMTo(ConstBuffer<void> src,
+				      void *dest) override;
+
+private:
+	/**
+	 * Apply the product of #volume and #gain to #pv.  This is
+	 * done in the filter thread, because #volume may be changed
+	 * by the mixer at any time.
+	 */
+	void Update() {
+		pv.SetVolume(gain == PCM_VOLUME_1
+			     ? volume
+			     : (volume * gain + PCM_VOLUME_1 / 2)
+			     / PCM_VOLUME_1);
+	}
 };
 
 static constexpr Domain volume_domain("pcm_volume");
@@ -77,9 +111,17 @@ VolumeFilter::Close()
 ConstBuffer<void>
 VolumeFilter::FilterPCM(ConstBuffer<void> src, gcc_unused Error &error)
 {
+	Update();
 	return pv.Apply(src);
 }
 
+ConstBuffer<void>
+VolumeFilter::FilterPCMTo(ConstBuffer<void> src, void *dest)
+{
+	Update();
+	return pv.Apply(src, dest);
+}
+
 const struct filter_plugin volume_filter_plugin = {
 	"volume",
 	volume_filter_init,
@@ -102,3 +144,11 @@ volume_filter_set(Filter *_filter, unsigned volume)
 	filter->SetVolume(volume);
 }
 
+void
+volume_filter_set_gain(Filter *_filter, unsigned gain)
+{
+	VolumeFilter *filter = (VolumeFilter *)_filter;
+
+	filter->SetGain(gain);
+}
+
@@ -28,4 +28,13 @@ volume_filter_get(const Filter *filter);
 void
 volume_filter_set(Filter *filter, unsigned volume);
 
+/**
+ * Set an additional gain (see #PCM_VOLUME_1) which is multiplied
+ * with the volume level, e.g. for applying replay gain in the same
+ * pass.  Unlike volume_filter_set(), this must be called from the
+ * thread which runs the filter.
+ */
+void
+volume_filter_set_gain(Filter *filter, unsigned gain);
+
 #endif
@@ -24,6 +24,7 @@
 #include "Log.hxx"
 #include "lib/icu/Converter.hxx"
 #include "util/Error.hxx"
+#include "util/UTF8.hxx"
 
 #ifdef WIN32
 #include <windows.h>
@@ -33,6 +34,7 @@
 
 #include <assert.h>
 #include <string.h>
+#include <strings.h>
 
 #ifdef HAVE_FS_CHARSET
 
@@ -40,12 +42,33 @@ static std::string fs_charset;
 
 static IcuConverter *fs_converter;
 
+/**
+ * Is the filesystem character set UTF-8?  In that case, no
+ * #IcuConverter is needed; file names are only validated.
+ */
+static bool fs_utf8;
+
+gcc_pure
+static bool
+IsUTF8(const char *charset)
+{
+	return strcasecmp(charset, "UTF-8") == 0 ||
+		strcasecmp(charset, "UTF8") == 0;
+}
+
 bool
 SetFSCharset(const char *charset, Error &error)
 {
 	assert(charset != nullptr);
 	assert(fs_converter == nullptr);
 
+	if (IsUTF8(charset)) {
+		fs_utf8 = true;
+		FormatDebug(path_domain,
+			    "SetFSCharset: fs charset is UTF-8");
+		return true;
+	}
+
 	fs_converter = IcuConverter::Create(charset, error);
 	if (fs_converter == nullptr)
 		return false;
@@ -64,6 +87,9 @@ DeinitFSCharset()
 	delete fs_converter;
 	fs_converter = nullptr;
 #endif
+#ifdef HAVE_FS_CHARSET
+	fs_utf8 = false;
+#endif
 }
 
 const char *
@@ -118,6 +144,9 @@ PathToUTF8(PathTraitsFS::const_pointer path_fs)
 	return FixSeparators(std::move(result));
 #else
 #ifdef HAVE_FS_CHARSET
+	if (fs_utf8 && !ValidateUTF8(path_fs))
+		return PathTraitsUTF8::string();
+
 	if (fs_converter == nullptr)
 #endif
 		return FixSeparators(path_fs);
@@ -156,6 +185,9 @@ PathFromUTF8(PathTraitsUTF8::const_pointer path_utf8)
 	delete[] buffer;
 	return std::move(result);
 #else
+	if (fs_utf8 && !ValidateUTF8(path_utf8))
+		return PathTraitsFS::string();
+
 	if (fs_converter == nullptr)
 		return path_utf8;
 
@@ -141,6 +141,15 @@ public:
 		return dirp == nullptr;
 	}
 
+	/**
+	 * Returns the file descriptor of the directory, which may be
+	 * used to access entries with fstatat().
+	 */
+	int GetFD() const {
+		assert(!HasFailed());
+		return dirfd(dirp);
+	}
+
 	/**
 	 * Checks if directory entry is available.
 	 */
@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "AsyncFileOutputStream.hxx"
+#include "FileOutputStream.hxx"
+#include "thread/Name.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+/**
+ * Write() collects this much data before submitting it to the
+ * thread.
+ */
+static constexpr size_t ASYNC_FILE_BLOCK_SIZE = 64 * 1024;
+
+/**
+ * If more data than this is queued, Write() waits for the thread.
+ * This limits the memory usage when the disk is slower than the
+ * producer for a long time.
+ */
+static constexpr size_t ASYNC_FILE_MAX_QUEUED = 8 * 1024 * 1024;
+
+AsyncFileOutputStream::AsyncFileOutputStream(uint64_t _sync_size,
+					     uint64_t _preallocate_size)
+	:sync_size(_sync_size), preallocate_size(_preallocate_size)
+{
+	buffer.reserve(ASYNC_FILE_BLOCK_SIZE);
+
+	/* on failure, work synchronously */
+	Error error;
+	thread.Start(Run, this, error);
+}
+
+AsyncFileOutputStream::~AsyncFileOutputStream()
+{
+	if (is_open)
+		Cancel();
+
+	if (IsThreaded()) {
+		mutex.lock();
+		quit = true;
+		cond.signal();
+		mutex.unlock();
+
+		thread.Join();
+	}
+
+	assert(jobs.empty());
+
+	/* the destructor deletes a file which was not committed */
+	delete current;
+}
+
+bool
+AsyncFileOutputStream::CheckError(Error &error)
+{
+	if (!IsThreaded())
+		return true;
+
+	const ScopeLock protect(mutex);
+	if (!thread_error.IsDefined())
+		return true;
+
+	error = std::move(thread_error);
+	thread_error.Clear();
+	return false;
+}
+
+bool
+AsyncFileOutputStream::Submit(Job *job, Error &error)
+{
+	if (!IsThreaded()) {
+		bool success = Handle(*job, error);
+		delete job;
+		return success;
+	}
+
+	const ScopeLock protect(mutex);
+
+	if (job->type == Job::Type::DATA) {
+		while (queued_bytes > ASYNC_FILE_MAX_QUEUED)
+			done_cond.wait(mutex);
+
+		queued_bytes += job->data.size();
+	}
+
+	jobs.push_back(job);
+	cond.signal();
+	return true;
+}
+
+bool
+AsyncFileOutputStream::FlushBuffer(Error &error)
+{
+	if (buffer.empty())
+		return true;
+
+	Job *job = new Job(Job::Type::DATA);
+	job->data.swap(buffer);
+	buffer.reserve(ASYNC_FILE_BLOCK_SIZE);
+
+	return Submit(job, error);
+}
+
+bool
+AsyncFileOutputStream::Open(Path path, Error &error)
+{
+	assert(!is_open);
+
+	if (!CheckError(error))
+		return false;
+
+	FileOutputStream *file = FileOutputStream::Create(path, error);
+	if (file == nullptr)
+		return false;
+
+	Job *job = new Job(Job::Type::OPEN);
+	job->file = file;
+	if (!Submit(job, error))
+		return false;
+
+	is_open = true;
+	file_size = 0;
+	return true;
+}
+
+bool
+AsyncFileOutputStream::Commit(Error &error)
+{
+	assert(is_open);
+
+	is_open = false;
+
+	return FlushBuffer(error) &&
+		Submit(new Job(Job::Type::COMMIT), error) &&
+		CheckError(error);
+}
+
+void
+AsyncFileOutputStream::Cancel()
+{
+	assert(is_open);
+
+	is_open = false;
+	buffer.clear();
+
+	Error error;
+	Submit(new Job(Job::Type::CANCEL), error);
+}
+
+bool
+AsyncFileOutputStream::Drain(Error &error)
+{
+	if (!FlushBuffer(error))
+		return false;
+
+	if (IsThreaded()) {
+		const ScopeLock protect(mutex);
+		while (!jobs.empty() || busy)
+			done_cond.wait(mutex);
+	}
+
+	return CheckError(error);
+}
+
+bool
+AsyncFileOutputStream::Write(const void *data, size_t size, Error &error)
+{
+	assert(is_open);
+
+	if (!CheckError(error))
+		return false;
+
+	const uint8_t *p = (const uint8_t *)data;
+	buffer.insert(buffer.end(), p, p + size);
+	file_size += size;
+
+	return buffer.size() < ASYNC_FILE_BLOCK_SIZE || FlushBuffer(error);
+}
+
+bool
+AsyncFileOutputStream::HandleData(const Job &job, Error &error)
+{
+	if (current == nullptr)
+		/* the file has failed already */
+		return true;
+
+	const size_t size = job.data.size();
+
+	if (preallocate_size > 0 && written + size > preallocated) {
+		preallocated = written +
+			std::max<uint64_t>(preallocate_size, size);
+		current->Preallocate(written, preallocated - written);
+	}
+
+	if (!current->Write(job.data.data(), size, error)) {
+		delete current;
+		current = nullptr;
+		return false;
+	}
+
+	written += size;
+	unsynced += size;
+
+	if (sync_size > 0 && unsynced >= sync_size) {
+		/* sync in large batches, not after each write */
+		unsynced = 0;
+
+		if (!current->Sync(error)) {
+			delete current;
+			current = nullptr;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool
+AsyncFileOutputStream::Handle(Job &job, Error &error)
+{
+	switch (job.type) {
+	case Job::Type::OPEN:
+		delete current;
+		current = job.file;
+		job.file = nullptr;
+		written = preallocated = unsynced = 0;
+		return true;
+
+	case Job::Type::DATA:
+		return HandleData(job, error);
+
+	case Job::Type::COMMIT:
+		if (current == nullptr)
+			return true;
+
+		{
+			bool success = (sync_size == 0 || current->Sync(error)) &&
+				current->Commit(error);
+			delete current;
+			current = nullptr;
+			return success;
+		}
+
+	case Job::Type::CANCEL:
+		delete current;
+		current = nullptr;
+		return true;
+	}
+
+	assert(false);
+	gcc_unreachable();
+}
+
+void
+AsyncFileOutputStream::Run()
+{
+	SetThreadName("writer");
+
+	const ScopeLock protect(mutex);
+
+	while (true) {
+		if (jobs.empty()) {
+			if (quit)
+				break;
+
+			cond.wait(mutex);
+			continue;
+		}
+
+		Job *job = jobs.front();
+		jobs.pop_front();
+		busy = true;
+
+		mutex.unlock();
+
+		Error error;
+		const bool success = Handle(*job, error);
+		const size_t n = job->type == Job::Type::DATA
+			? job->data.size()
+			: 0;
+		delete job;
+
+		mutex.lock();
+
+		busy = false;
+		queued_bytes -= n;
+
+		if (!success && !thread_error.IsDefined())
+			thread_error = std::move(error);
+
+		done_cond.broadcast();
+	}
+}
+
+void
+AsyncFileOutputStream::Run(void *ctx)
+{
+	AsyncFileOutputStream &s = *(AsyncFileOutputStream *)ctx;
+	s.Run();
+}
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ASYNC_FILE_OUTPUT_STREAM_HXX
+#define MPD_ASYNC_FILE_OUTPUT_STREAM_HXX
+
+#include "check.h"
+#include "OutputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "util/Error.hxx"
+#include "Compiler.h"
+
+#include <deque>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Path;
+class FileOutputStream;
+
+/**
+ * An #OutputStream which writes to a sequence of #FileOutputStream
+ * objects in a separate thread, so a slow disk does not block the
+ * caller.  Creating a file happens in the calling thread (so errors
+ * are reported immediately); writing, flushing and committing are
+ * queued.  Errors which occur in the thread are reported by the next
+ * method call.
+ *
+ * If the thread cannot be started, all operations are performed
+ * synchronously.
+ */
+class AsyncFileOutputStream final : public OutputStream {
+	struct Job {
+		enum class Type {
+			/**
+			 * Switch to the file in #file.
+			 */
+			OPEN,
+
+			/**
+			 * Write #data to the current file.
+			 */
+			DATA,
+
+			/**
+			 * Commit the current file.
+			 */
+			COMMIT,
+
+			/**
+			 * Delete the current file.
+			 */
+			CANCEL,
+		} type;
+
+		FileOutputStream *file;
+
+		std::vector<uint8_t> data;
+
+		explicit Job(Type _type):type(_type), file(nullptr) {}
+	};
+
+	/**
+	 * Call fdatasync() after this number of bytes (0 =
+	 * never).
+	 */
+	const uint64_t sync_size;
+
+	/**
+	 * Reserve disk space in chunks of this size (0 = don't).
+	 */
+	const uint64_t preallocate_size;
+
+	Thread thread;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a job was submitted or when the thread
+	 * shall quit.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled by the thread when a job has been finished.
+	 */
+	Cond done_cond;
+
+	/**
+	 * Jobs which have not been picked up by the thread yet.
+	 */
+	std::deque<Job *> jobs;
+
+	/**
+	 * The number of #Job::DATA bytes in #jobs and in the job
+	 * which is currently being handled.
+	 */
+	size_t queued_bytes = 0;
+
+	/**
+	 * Is the thread currently handling a job?
+	 */
+	bool busy = false;
+
+	bool quit = false;
+
+	/**
+	 * The first error which occurred in the thread; it is
+	 * passed to the caller by the next method call.
+	 */
+	Error thread_error;
+
+	/* the following attributes are used only by the thread (or
+	   by the caller if there is no thread) */
+
+	FileOutputStream *current = nullptr;
+
+	/**
+	 * The number of bytes written to #current since the last
+	 * Sync().
+	 */
+	uint64_t unsynced = 0;
+
+	/**
+	 * The number of bytes written to #current, and the end of
+	 * the space reserved with Preallocate().
+	 */
+	uint64_t written, preallocated;
+
+	/* the following attributes are used only by the caller */
+
+	/**
+	 * Data collected by Write() which has not been submitted
+	 * yet.
+	 */
+	std::vector<uint8_t> buffer;
+
+	/**
+	 * Is a file open, i.e. has Open() been called, but not
+	 * Commit() or Cancel()?
+	 */
+	bool is_open = false;
+
+	/**
+	 * The number of bytes written since Open().
+	 */
+	uint64_t file_size;
+
+public:
+	AsyncFileOutputStream(uint64_t _sync_size, uint64_t _preallocate_size);
+
+	/**
+	 * Waits for all queued jobs.  A file which has not been
+	 * committed is deleted.
+	 */
+	~AsyncFileOutputStream();
+
+	bool IsOpen() const {
+		return is_open;
+	}
+
+	/**
+	 * Returns the number of bytes written to the current file.
+	 */
+	uint64_t GetFileSize() const {
+		return file_size;
+	}
+
+	/**
+	 * Create a new file.  Subsequent Write() calls will write to
+	 * it.  Call Commit() or Cancel() on the previous file first.
+	 */
+	bool Open(Path path, Error &error);
+
+	/**
+	 * Commit the current file after all of its data has been
+	 * written.  This does not wait for it; errors will be reported
+	 * later.
+	 */
+	bool Commit(Error &error);
+
+	/**
+	 * Delete the current file.
+	 */
+	void Cancel();
+
+	/**
+	 * Wait until all queued jobs have been finished.
+	 *
+	 * @return false if an error has occurred
+	 */
+	bool Drain(Error &error);
+
+	/* virtual methods from class OutputStream */
+	bool Write(const void *data, size_t size, Error &error) override;
+
+private:
+	bool IsThreaded() const {
+		return thread.IsDefined();
+	}
+
+	/**
+	 * Move the pending error from the thread to the caller.
+	 */
+	bool CheckError(Error &error);
+
+	bool FlushBuffer(Error &error);
+
+	bool Submit(Job *job, Error &error);
+
+	void Run();
+	static void Run(void *ctx);
+
+	/**
+	 * Handle one job in the thread (or in the caller if there is
+	 * no thread).
+	 */
+	bool Handle(Job &job, Error &error);
+
+	bool HandleData(const Job &job, Error &error);
+};
+
+#endif
@@ -20,7 +20,8 @@
 #include "config.h"
 #include "BufferedReader.hxx"
 #include "Reader.hxx"
-#include "util/TextFile.hxx"
+
+#include <string.h>
 
 bool
 BufferedReader::Fill(bool need_more)
@@ -32,6 +33,13 @@ BufferedReader::Fill(bool need_more)
 		return !need_more;
 
 	auto w = buffer.Write();
+	if (w.size < buffer.GetCapacity() / 2) {
+		/* move the pending data to the beginning of the
+		   buffer, so the next read is large */
+		buffer.Shift();
+		w = buffer.Write();
+	}
+
 	if (w.IsEmpty()) {
 		if (buffer.GetCapacity() >= MAX_SIZE)
 			return !need_more;
@@ -58,11 +66,22 @@ char *
 BufferedReader::ReadLine()
 {
 	do {
-		char *line = ReadBufferedLine(buffer);
-		if (line != nullptr) {
+		auto r = buffer.Read();
+		char *newline = (char *)memchr(r.data + scanned, '\n',
+					       r.size - scanned);
+		if (newline != nullptr) {
+			Consume(newline + 1 - r.data);
+
+			if (newline > r.data && newline[-1] == '\r')
+				--newline;
+			*newline = 0;
+
 			++line_number;
-			return line;
+			return r.data;
 		}
+
+		/* don't search these bytes again after Fill() */
+		scanned = r.size;
 	} while (Fill(true));
 
 	if (last_error.IsDefined() || !eof || buffer.IsEmpty())
@@ -80,6 +99,7 @@ BufferedReader::ReadLine()
 
 	char *line = buffer.Read().data;
 	buffer.Clear();
+	scanned = 0;
 	++line_number;
 	return line;
 }
@@ -31,6 +31,7 @@ class Reader;
 class Error;
 
 class BufferedReader {
+	static constexpr size_t INITIAL_SIZE = 64 * 1024;
 	static constexpr size_t MAX_SIZE = 512 * 1024;
 
 	Reader &reader;
@@ -43,10 +44,18 @@ class BufferedReader {
 
 	unsigned line_number;
 
+	/**
+	 * The number of bytes at the beginning of the buffer which
+	 * are known to contain no newline character.  ReadLine()
+	 * continues searching after them when more data has been
+	 * read.
+	 */
+	size_t scanned;
+
 public:
 	BufferedReader(Reader &_reader)
-		:reader(_reader), buffer(4096), eof(false),
-		 line_number(0) {}
+		:reader(_reader), buffer(INITIAL_SIZE), eof(false),
+		 line_number(0), scanned(0) {}
 
 	gcc_pure
 	bool Check() const {
@@ -70,6 +79,7 @@ public:
 
 	void Consume(size_t n) {
 		buffer.Consume(n);
+		scanned = 0;
 	}
 
 	char *ReadLine();
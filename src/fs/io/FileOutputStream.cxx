@@ -81,6 +81,20 @@ BaseFileOutputStream::Write(const void *data, size_t size, Error &error)
 	return true;
 }
 
+bool
+BaseFileOutputStream::Sync(Error &error)
+{
+	assert(IsDefined());
+
+	if (!FlushFileBuffers(handle)) {
+		error.FormatLastError("Failed to flush %s",
+				      path.ToUTF8().c_str());
+		return false;
+	}
+
+	return true;
+}
+
 bool
 FileOutputStream::Commit(gcc_unused Error &error)
 {
@@ -104,6 +118,7 @@ FileOutputStream::Cancel()
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdio.h>
 
 #ifdef HAVE_LINKAT
 #ifndef O_TMPFILE
@@ -129,19 +144,21 @@ OpenTempFile(FileDescriptor &fd, Path path)
 #endif /* HAVE_LINKAT */
 
 FileOutputStream::FileOutputStream(Path _path, Error &error)
-	:BaseFileOutputStream(_path)
+	:BaseFileOutputStream(_path),
+	 tmp_path(AllocatedPath::FromFS(std::string(_path.c_str()) + ".tmp"))
 {
 #ifdef HAVE_LINKAT
 	/* try Linux's O_TMPFILE first */
 	is_tmpfile = OpenTempFile(SetFD(), GetPath());
 	if (!is_tmpfile) {
 #endif
-		/* fall back to plain POSIX */
-		if (!SetFD().Open(GetPath().c_str(),
+		/* fall back to plain POSIX: write a temporary file
+		   which is renamed by Commit() */
+		if (!SetFD().Open(tmp_path.c_str(),
 				  O_WRONLY|O_CREAT|O_TRUNC,
 				  0666))
 			error.FormatErrno("Failed to create %s",
-					  GetPath().c_str());
+					  tmp_path.c_str());
 #ifdef HAVE_LINKAT
 	}
 #endif
@@ -171,20 +188,69 @@ BaseFileOutputStream::Write(const void *data, size_t size, Error &error)
 	return true;
 }
 
+bool
+BaseFileOutputStream::Sync(Error &error)
+{
+	assert(IsDefined());
+
+#ifdef __APPLE__
+	const int result = fsync(fd.Get());
+#else
+	const int result = fdatasync(fd.Get());
+#endif
+	if (result < 0) {
+		error.FormatErrno("Failed to flush %s", GetPath().c_str());
+		return false;
+	}
+
+	return true;
+}
+
+#ifdef __linux__
+
+void
+BaseFileOutputStream::Preallocate(uint64_t offset, uint64_t length)
+{
+	assert(IsDefined());
+
+	if (fallocate(fd.Get(), FALLOC_FL_KEEP_SIZE, offset, length) == 0)
+		preallocated = true;
+}
+
+#endif
+
+void
+BaseFileOutputStream::TrimPreallocation()
+{
+	assert(IsDefined());
+
+	if (!preallocated)
+		return;
+
+	/* with FALLOC_FL_KEEP_SIZE, the reserved blocks beyond the
+	   end of the file stay allocated until it is truncated */
+	const off_t size = fd.Tell();
+	if (size >= 0 && ftruncate(fd.Get(), size) == 0)
+		preallocated = false;
+}
+
 bool
 FileOutputStream::Commit(Error &error)
 {
 	assert(IsDefined());
 
+	TrimPreallocation();
+
 #if HAVE_LINKAT
 	if (is_tmpfile) {
-		RemoveFile(GetPath());
+		RemoveFile(tmp_path);
 
-		/* hard-link the temporary file to the final path */
+		/* hard-link the anonymous file to the temporary path;
+		   it is renamed to the final path below */
 		char fd_path[64];
 		snprintf(fd_path, sizeof(fd_path), "/proc/self/fd/%d",
 			 GetFD().Get());
-		if (linkat(AT_FDCWD, fd_path, AT_FDCWD, GetPath().c_str(),
+		if (linkat(AT_FDCWD, fd_path, AT_FDCWD, tmp_path.c_str(),
 			   AT_SYMLINK_FOLLOW) < 0) {
 			error.FormatErrno("Failed to commit %s",
 					  GetPath().c_str());
@@ -194,11 +260,22 @@ FileOutputStream::Commit(Error &error)
 	}
 #endif
 
-	bool success = Close();
-	if (!success)
+	if (!Close()) {
 		error.FormatErrno("Failed to commit %s", GetPath().c_str());
+		RemoveFile(tmp_path);
+		return false;
+	}
 
-	return success;
+	/* replace the old file atomically, so readers (and MPD
+	   after a crash) see either the old or the new version,
+	   but never an incomplete one */
+	if (rename(tmp_path.c_str(), GetPath().c_str()) < 0) {
+		error.FormatErrno("Failed to commit %s", GetPath().c_str());
+		RemoveFile(tmp_path);
+		return false;
+	}
+
+	return true;
 }
 
 void
@@ -211,7 +288,7 @@ FileOutputStream::Cancel()
 #ifdef HAVE_LINKAT
 	if (!is_tmpfile)
 #endif
-		RemoveFile(GetPath());
+		RemoveFile(tmp_path);
 }
 
 #endif
@@ -44,6 +44,12 @@ class BaseFileOutputStream : public OutputStream {
 	HANDLE handle;
 #else
 	FileDescriptor fd;
+
+	/**
+	 * Has Preallocate() reserved space beyond the end of the
+	 * file?  It is released by TrimPreallocation().
+	 */
+	bool preallocated = false;
 #endif
 
 protected:
@@ -83,6 +89,16 @@ protected:
 	}
 #endif
 
+	/**
+	 * Release disk space which was reserved by Preallocate() but
+	 * not written.
+	 */
+#ifdef WIN32
+	void TrimPreallocation() {}
+#else
+	void TrimPreallocation();
+#endif
+
 	bool Close() {
 		assert(IsDefined());
 
@@ -118,6 +134,24 @@ public:
 	gcc_pure
 	uint64_t Tell() const;
 
+	/**
+	 * Write the file contents (but not necessarily all metadata)
+	 * to the disk.
+	 */
+	bool Sync(Error &error);
+
+	/**
+	 * Reserve disk space for data which is going to be written,
+	 * without changing the file size, to reduce fragmentation.
+	 * This is only a hint; errors are ignored.
+	 */
+#ifdef __linux__
+	void Preallocate(uint64_t offset, uint64_t length);
+#else
+	void Preallocate(gcc_unused uint64_t offset,
+			 gcc_unused uint64_t length) {}
+#endif
+
 	/* virtual methods from class OutputStream */
 	bool Write(const void *data, size_t size, Error &error) override;
 };
@@ -131,6 +165,14 @@ class FileOutputStream final : public BaseFileOutputStream {
 	bool is_tmpfile;
 #endif
 
+#ifndef WIN32
+	/**
+	 * The file is written to this path (or linked here, see
+	 * #is_tmpfile), and Commit() renames it to the final path.
+	 */
+	const AllocatedPath tmp_path;
+#endif
+
 public:
 	FileOutputStream(Path _path, Error &error);
 
@@ -20,11 +20,50 @@
 #include "config.h"
 #include "GzipOutputStream.hxx"
 #include "lib/zlib/Domain.hxx"
+#include "thread/Name.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 
-GzipOutputStream::GzipOutputStream(OutputStream &_next, Error &error)
-	:next(_next)
+#include <algorithm>
+#include <iterator>
+
+#include <unistd.h>
+
+/**
+ * The amount of input which is compressed by one job.
+ */
+static constexpr size_t GZIP_BLOCK_SIZE = 128 * 1024;
+
+/**
+ * The size of the deflate window; each block is primed with this
+ * much of the previous block.
+ */
+static constexpr size_t GZIP_DICTIONARY_SIZE = 32 * 1024;
+
+/**
+ * The maximum number of jobs per thread which may be in flight; this
+ * limits the amount of memory occupied by data which has not been
+ * written yet.
+ */
+static constexpr unsigned GZIP_JOBS_PER_THREAD = 4;
+
+static constexpr unsigned GZIP_MAX_THREADS = 8;
+
+static unsigned
+GetGzipThreadCount()
+{
+#ifdef _SC_NPROCESSORS_ONLN
+	/* the calling thread produces the data; the others compress
+	   it */
+	const long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n > 1)
+		return std::min<unsigned long>(n - 1, GZIP_MAX_THREADS);
+#endif
+
+	return 0;
+}
+
+GzipOutputStream::Compressor::Compressor()
 {
 	z.next_in = nullptr;
 	z.avail_in = 0;
@@ -32,72 +71,273 @@ GzipOutputStream::GzipOutputStream(OutputStream &_next, Error &error)
 	z.zfree = Z_NULL;
 	z.opaque = Z_NULL;
 
-	constexpr int windowBits = 15;
-	constexpr int gzip_encoding = 16;
+	/* a raw deflate stream; the gzip header and trailer are
+	   written by GzipOutputStream */
+	constexpr int windowBits = -15;
 
-	int result = deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
-				  windowBits | gzip_encoding,
-				  8, Z_DEFAULT_STRATEGY);
-	if (result != Z_OK) {
-		z.opaque = this;
-		error.Set(zlib_domain, result, zError(result));
-	}
+	init_result = deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+				   windowBits, 8, Z_DEFAULT_STRATEGY);
 }
 
-GzipOutputStream::~GzipOutputStream()
+GzipOutputStream::Compressor::~Compressor()
 {
 	if (IsDefined())
 		deflateEnd(&z);
 }
 
-bool
-GzipOutputStream::Flush(Error &error)
+void
+GzipOutputStream::Compressor::Compress(Job &job)
 {
-	/* no more input */
-	z.next_in = nullptr;
-	z.avail_in = 0;
+	assert(IsDefined());
+
+	job.crc = crc32(crc32(0, Z_NULL, 0),
+			job.input.data(), job.input.size());
+
+	deflateReset(&z);
+
+	if (!job.dictionary.empty()) {
+		job.result = deflateSetDictionary(&z, job.dictionary.data(),
+						  job.dictionary.size());
+		if (job.result != Z_OK)
+			return;
+	}
+
+	z.next_in = job.input.data();
+	z.avail_in = job.input.size();
+
+	/* Z_SYNC_FLUSH ends the block on a byte boundary without
+	   marking it as the final one, so the blocks can be
+	   concatenated */
+	const int flush = job.last ? Z_FINISH : Z_SYNC_FLUSH;
+
+	job.output.resize(deflateBound(&z, job.input.size()) + 16);
+	size_t fill = 0;
 
 	while (true) {
-		Bytef output[4096];
-		z.next_out = output;
-		z.avail_out = sizeof(output);
+		z.next_out = job.output.data() + fill;
+		z.avail_out = job.output.size() - fill;
 
-		int result = deflate(&z, Z_FINISH);
-		if (z.next_out > output &&
-		    !next.Write(output, z.next_out - output, error))
-			return false;
+		int result = deflate(&z, flush);
+		fill = job.output.size() - z.avail_out;
 
 		if (result == Z_STREAM_END)
-			return true;
-		else if (result != Z_OK) {
-			error.Set(zlib_domain, result, zError(result));
-			return false;
+			break;
+
+		if (result != Z_OK) {
+			job.result = result;
+			return;
+		}
+
+		if (z.avail_out == 0)
+			job.output.resize(job.output.size() * 2);
+		else if (flush == Z_SYNC_FLUSH)
+			break;
+	}
+
+	job.output.resize(fill);
+	job.result = Z_OK;
+
+	/* the dictionary is not needed anymore */
+	std::vector<Bytef>().swap(job.dictionary);
+}
+
+GzipOutputStream::GzipOutputStream(OutputStream &_next, Error &error)
+	:next(_next), crc(crc32(0, Z_NULL, 0))
+{
+	if (!compressor.IsDefined()) {
+		const int result = compressor.GetInitResult();
+		error.Set(zlib_domain, result, zError(result));
+		return;
+	}
+
+	StartWorkers(GetGzipThreadCount());
+
+	unsigned n_workers = std::distance(workers.begin(), workers.end());
+	max_jobs = std::max(n_workers, 1u) * GZIP_JOBS_PER_THREAD;
+
+	input.reserve(GZIP_BLOCK_SIZE);
+}
+
+GzipOutputStream::~GzipOutputStream()
+{
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (auto &worker : workers)
+		worker.thread.Join();
+
+	for (Job *job : jobs)
+		delete job;
+}
+
+void
+GzipOutputStream::StartWorkers(unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i) {
+		workers.emplace_front(*this);
+
+		Worker &worker = workers.front();
+		if (!worker.compressor.IsDefined()) {
+			workers.pop_front();
+			break;
+		}
+
+		/* on failure, continue with the threads which are
+		   already running (or in the calling thread) */
+		Error error;
+		if (!worker.thread.Start(Worker::Run, &worker, error)) {
+			workers.pop_front();
+			break;
+		}
+	}
+}
+
+void
+GzipOutputStream::Worker::Run()
+{
+	SetThreadName("gzip");
+
+	const ScopeLock protect(gzip.mutex);
+
+	while (!gzip.quit) {
+		if (gzip.pending.empty()) {
+			gzip.cond.wait(gzip.mutex);
+			continue;
 		}
-    }
+
+		Job *job = gzip.pending.front();
+		gzip.pending.pop_front();
+
+		gzip.mutex.unlock();
+		compressor.Compress(*job);
+		gzip.mutex.lock();
+
+		job->done = true;
+		gzip.finished_cond.signal();
+	}
+}
+
+void
+GzipOutputStream::Worker::Run(void *ctx)
+{
+	Worker &worker = *(Worker *)ctx;
+	worker.Run();
 }
 
 bool
-GzipOutputStream::Write(const void *_data, size_t size, Error &error)
+GzipOutputStream::Submit(bool last, Error &error)
 {
-	/* zlib's API requires non-const input pointer */
-	void *data = const_cast<void *>(_data);
+	Job *job = new Job();
+	job->last = last;
 
-	z.next_in = reinterpret_cast<Bytef *>(data);
-	z.avail_in = size;
+	/* prime the block with the end of the previous one, and
+	   remember the end of this one for the next block */
+	job->dictionary = std::move(dictionary);
+	const size_t n = std::min(input.size(), GZIP_DICTIONARY_SIZE);
+	dictionary.assign(input.end() - n, input.end());
 
-	while (z.avail_in > 0) {
-		Bytef output[4096];
-		z.next_out = output;
-		z.avail_out = sizeof(output);
+	job->input = std::move(input);
+	input.clear();
+	input.reserve(GZIP_BLOCK_SIZE);
 
-		int result = deflate(&z, Z_NO_FLUSH);
-		if (result != Z_OK) {
-			error.Set(zlib_domain, result, zError(result));
+	jobs.push_back(job);
+
+	if (workers.empty()) {
+		/* no threads: compress it right now */
+		compressor.Compress(*job);
+		job->done = true;
+	} else {
+		const ScopeLock protect(mutex);
+		pending.push_back(job);
+		cond.signal();
+	}
+
+	while (jobs.size() > max_jobs)
+		if (!WriteOne(error))
+			return false;
+
+	return true;
+}
+
+bool
+GzipOutputStream::WriteOne(Error &error)
+{
+	assert(!jobs.empty());
+
+	Job *job = jobs.front();
+	jobs.pop_front();
+
+	mutex.lock();
+	while (!job->done)
+		finished_cond.wait(mutex);
+	mutex.unlock();
+
+	if (job->result != Z_OK) {
+		error.Set(zlib_domain, job->result, zError(job->result));
+		delete job;
+		return false;
+	}
+
+	if (!header_written) {
+		/* magic, "deflate", no flags, no mtime, no extra
+		   flags, "Unix" (like zlib does) */
+		static constexpr Bytef header[10] = {
+			0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3,
+		};
+
+		if (!next.Write(header, sizeof(header), error)) {
+			delete job;
 			return false;
 		}
 
-		if (z.next_out > output &&
-		    !next.Write(output, z.next_out - output, error))
+		header_written = true;
+	}
+
+	crc = crc32_combine(crc, job->crc, job->input.size());
+	length += job->input.size();
+
+	bool success = job->output.empty() ||
+		next.Write(job->output.data(), job->output.size(), error);
+	delete job;
+	return success;
+}
+
+bool
+GzipOutputStream::Flush(Error &error)
+{
+	if (!Submit(true, error))
+		return false;
+
+	while (!jobs.empty())
+		if (!WriteOne(error))
+			return false;
+
+	/* the CRC32 and the length modulo 2^32, little-endian */
+	Bytef trailer[8];
+	for (unsigned i = 0; i < 4; ++i) {
+		trailer[i] = Bytef(crc >> (8 * i));
+		trailer[4 + i] = Bytef(length >> (8 * i));
+	}
+
+	return next.Write(trailer, sizeof(trailer), error);
+}
+
+bool
+GzipOutputStream::Write(const void *_data, size_t size, Error &error)
+{
+	const Bytef *data = (const Bytef *)_data;
+
+	while (size > 0) {
+		const size_t n = std::min(size,
+					  GZIP_BLOCK_SIZE - input.size());
+		input.insert(input.end(), data, data + n);
+		data += n;
+		size -= n;
+
+		if (input.size() >= GZIP_BLOCK_SIZE &&
+		    !Submit(false, error))
 			return false;
 	}
 
@@ -22,9 +22,17 @@
 
 #include "check.h"
 #include "OutputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
 #include "Compiler.h"
 
+#include <deque>
+#include <forward_list>
+#include <vector>
+
 #include <assert.h>
+#include <stdint.h>
 #include <zlib.h>
 
 class Error;
@@ -34,12 +42,149 @@ class Domain;
  * A filter that compresses data written to it using zlib, forwarding
  * compressed data in the "gzip" format.
  *
+ * The input is split into blocks which are compressed by a pool of
+ * threads (like "pigz" does); each block is primed with the end of
+ * the previous one, so the compression ratio is nearly the same as
+ * with a single zlib stream.  The result is one regular gzip member.
+ *
  * Don't forget to call Flush() before destructing this object.
  */
 class GzipOutputStream final : public OutputStream {
+	/**
+	 * One block of input and its compressed form.
+	 */
+	struct Job {
+		std::vector<Bytef> input;
+
+		/**
+		 * The last 32 kB of the previous block's input.
+		 */
+		std::vector<Bytef> dictionary;
+
+		std::vector<Bytef> output;
+
+		/**
+		 * Is this the last block of the stream?
+		 */
+		bool last;
+
+		uLong crc;
+
+		/**
+		 * The zlib error code, or Z_OK.
+		 */
+		int result;
+
+		/**
+		 * Has this job been compressed?  Protected by
+		 * GzipOutputStream::mutex.
+		 */
+		bool done = false;
+	};
+
+	/**
+	 * A raw deflate stream which compresses one #Job at a time.
+	 */
+	class Compressor {
+		z_stream z;
+
+		/**
+		 * The return value of deflateInit2().
+		 */
+		int init_result;
+
+	public:
+		Compressor();
+		~Compressor();
+
+		Compressor(const Compressor &) = delete;
+		Compressor &operator=(const Compressor &) = delete;
+
+		bool IsDefined() const {
+			return init_result == Z_OK;
+		}
+
+		int GetInitResult() const {
+			return init_result;
+		}
+
+		void Compress(Job &job);
+	};
+
+	struct Worker {
+		GzipOutputStream &gzip;
+
+		Compressor compressor;
+
+		Thread thread;
+
+		explicit Worker(GzipOutputStream &_gzip):gzip(_gzip) {}
+
+		void Run();
+		static void Run(void *ctx);
+	};
+
 	OutputStream &next;
 
-	z_stream z;
+	/**
+	 * Compresses the blocks in the calling thread if no
+	 * #Worker could be started.
+	 */
+	Compressor compressor;
+
+	std::forward_list<Worker> workers;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a job was submitted or when the workers
+	 * shall quit.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled when a job has been compressed.
+	 */
+	Cond finished_cond;
+
+	/**
+	 * All jobs which have not been written yet, in stream order.
+	 */
+	std::deque<Job *> jobs;
+
+	/**
+	 * Jobs which have not been picked up by a worker yet.
+	 */
+	std::deque<Job *> pending;
+
+	bool quit = false;
+
+	/**
+	 * The maximum number of jobs in #jobs.
+	 */
+	unsigned max_jobs;
+
+	/**
+	 * The block which is being filled by Write().
+	 */
+	std::vector<Bytef> input;
+
+	/**
+	 * The last 32 kB of the previously submitted block.
+	 */
+	std::vector<Bytef> dictionary;
+
+	bool header_written = false;
+
+	/**
+	 * The CRC32 of all blocks which have been written.
+	 */
+	uLong crc;
+
+	/**
+	 * The number of input bytes which have been written.
+	 */
+	uint64_t length = 0;
 
 public:
 	/**
@@ -54,7 +199,7 @@ public:
 	 * Check whether the constructor has succeeded.
 	 */
 	bool IsDefined() const {
-		return z.opaque == nullptr;
+		return compressor.IsDefined();
 	}
 
 	/**
@@ -65,6 +210,20 @@ public:
 
 	/* virtual methods from class OutputStream */
 	bool Write(const void *data, size_t size, Error &error) override;
+
+private:
+	void StartWorkers(unsigned n);
+
+	/**
+	 * Pass the current block (#input) to the workers.
+	 */
+	bool Submit(bool last, Error &error);
+
+	/**
+	 * Wait until the oldest job has been compressed, and write
+	 * it to #next.
+	 */
+	bool WriteOne(Error &error);
 };
 
 #endif
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_LINE_READER_HXX
+#define MPD_LINE_READER_HXX
+
+#include "check.h"
+
+/**
+ * An interface which reads text lines.  The caller may modify the
+ * returned line; it is valid until the next ReadLine() call.
+ */
+class LineReader {
+public:
+	LineReader() = default;
+	LineReader(const LineReader &) = delete;
+
+	/**
+	 * Reads a line, and strips trailing space.
+	 *
+	 * @return a pointer to the line, or nullptr on end-of-file or
+	 * error
+	 */
+	virtual char *ReadLine() = 0;
+};
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "MappedFile.hxx"
+#include "FileReader.hxx"
+#include "fs/FileInfo.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+#include <assert.h>
+
+static constexpr Domain mapped_file_domain("mapped_file");
+
+bool
+MappedFile::Open(Path path, Error &error)
+{
+	assert(!IsDefined());
+
+	FileReader reader(path, error);
+	if (!reader.IsDefined())
+		return false;
+
+	FileInfo info;
+	if (!reader.GetFileInfo(info, error))
+		return false;
+
+	const uint64_t file_size = info.GetSize();
+	if (file_size == 0 || file_size != (size_t)file_size) {
+		const auto path_utf8 = path.ToUTF8();
+		error.Format(mapped_file_domain,
+			     "Cannot map file %s: bad size", path_utf8.c_str());
+		return false;
+	}
+
+	size = file_size;
+
+#ifdef WIN32
+	data = new char[size];
+
+	size_t position = 0;
+	while (position < size) {
+		size_t nbytes = reader.Read((char *)data + position,
+					    size - position, error);
+		if (nbytes == 0) {
+			if (!error.IsDefined()) {
+				const auto path_utf8 = path.ToUTF8();
+				error.Format(mapped_file_domain,
+					     "Unexpected end of file %s",
+					     path_utf8.c_str());
+			}
+
+			Close();
+			return false;
+		}
+
+		position += nbytes;
+	}
+#else
+	void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED,
+		       reader.GetFD().Get(), 0);
+	if (p == MAP_FAILED) {
+		const auto path_utf8 = path.ToUTF8();
+		error.FormatErrno("Failed to map %s", path_utf8.c_str());
+		return false;
+	}
+
+	data = p;
+#endif
+
+	return true;
+}
+
+void
+MappedFile::Close()
+{
+	if (data == nullptr)
+		return;
+
+#ifdef WIN32
+	delete[] (char *)data;
+#else
+	munmap(data, size);
+#endif
+
+	data = nullptr;
+	size = 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STRING_OUTPUT_STREAM_HXX
+#define MPD_STRING_OUTPUT_STREAM_HXX
+
+#include "check.h"
+#include "OutputStream.hxx"
+#include "Compiler.h"
+
+#include <string>
+
+/**
+ * An #OutputStream which collects everything in memory.
+ */
+class StringOutputStream final : public OutputStream {
+	std::string value;
+
+public:
+	const std::string &GetValue() const {
+		return value;
+	}
+
+	/* virtual methods from class OutputStream */
+	bool Write(const void *data, size_t size,
+		   gcc_unused Error &error) override {
+		value.append((const char *)data, size);
+		return true;
+	}
+};
+
+#endif
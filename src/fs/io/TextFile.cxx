@@ -43,6 +43,11 @@ TextFile::TextFile(Path path_fs, Error &error)
 					      )
 			 : nullptr)
 {
+#ifndef WIN32
+	if (file_reader->IsDefined())
+		/* text files are always read from start to end */
+		file_reader->GetFD().AdviseSequential();
+#endif
 }
 
 TextFile::~TextFile()
@@ -21,6 +21,7 @@
 #define MPD_TEXT_FILE_HXX
 
 #include "check.h"
+#include "LineReader.hxx"
 #include "Compiler.h"
 
 #include <stddef.h>
@@ -31,7 +32,7 @@ class FileReader;
 class AutoGunzipReader;
 class BufferedReader;
 
-class TextFile {
+class TextFile final : public LineReader {
 	FileReader *const file_reader;
 
 #ifdef ENABLE_ZLIB
@@ -61,7 +62,7 @@ public:
 	 *
 	 * @return a pointer to the line, or nullptr on end-of-file or error
 	 */
-	char *ReadLine();
+	char *ReadLine() override;
 
 	/**
 	 * Check whether a ReadLine() call has thrown an error.
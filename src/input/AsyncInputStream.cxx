@@ -21,21 +21,89 @@
 #include "AsyncInputStream.hxx"
 #include "Domain.hxx"
 #include "tag/Tag.hxx"
+#include "event/Loop.hxx"
 #include "event/Call.hxx"
 #include "thread/Cond.hxx"
-#include "IOThread.hxx"
+#include "config/Block.hxx"
+#include "system/Clock.hxx"
 #include "util/HugeAllocator.hxx"
+#include "util/Error.hxx"
 
 #include <assert.h>
 #include <string.h>
 
-AsyncInputStream::AsyncInputStream(const char *_url,
+/**
+ * The adaptive high watermark is never lower than this.
+ */
+static constexpr size_t MIN_HIGH_WATERMARK = 128 * 1024;
+
+/**
+ * The minimum distance between the two watermarks; it must be larger
+ * than the chunks a plugin appends at once, or a paused transfer
+ * may never be resumed.
+ */
+static constexpr size_t MIN_WATERMARK_DISTANCE = 64 * 1024;
+
+/**
+ * The duration of a bitrate measurement period.
+ */
+static constexpr uint64_t RATE_PERIOD_US = 1000000;
+
+/**
+ * Buffer this much playback time in addition to the jitter
+ * allowance.
+ */
+static constexpr uint64_t MIN_BUFFER_TIME_US = 2000000;
+
+/**
+ * The jitter allowance is this multiple of the longest recently
+ * observed gap between incoming data.
+ */
+static constexpr unsigned JITTER_FACTOR = 4;
+
+bool
+AsyncInputStreamConfig::Load(const ConfigBlock &block, Error &error)
+{
+	const unsigned kib = block.GetBlockValue("buffer_size",
+						 unsigned(buffer_size / 1024));
+	if (kib < 64) {
+		error.Set(input_domain, "buffer_size is too small");
+		return false;
+	}
+
+	const unsigned high_percent =
+		block.GetBlockValue("high_watermark",
+				    unsigned(high_watermark * 100 / buffer_size));
+	const unsigned low_percent =
+		block.GetBlockValue("low_watermark",
+				    unsigned(low_watermark * 100 / buffer_size));
+	if (high_percent == 0 || high_percent > 100 ||
+	    low_percent >= high_percent) {
+		error.Set(input_domain, "Invalid high_watermark/low_watermark");
+		return false;
+	}
+
+	buffer_size = size_t(kib) * 1024;
+	high_watermark = buffer_size / 100 * high_percent;
+	low_watermark = std::min(buffer_size / 100 * low_percent,
+				 high_watermark - std::min(high_watermark,
+							   MIN_WATERMARK_DISTANCE));
+	adaptive = block.GetBlockValue("adaptive", adaptive);
+	return true;
+}
+
+AsyncInputStream::AsyncInputStream(EventLoop &event_loop,
+				   const char *_url,
 				   Mutex &_mutex, Cond &_cond,
-				   void *_buffer, size_t _buffer_size,
-				   size_t _resume_at)
-	:InputStream(_url, _mutex, _cond), DeferredMonitor(io_thread_get()),
-	 buffer((uint8_t *)_buffer, _buffer_size),
-	 resume_at(_resume_at),
+				   void *_buffer,
+				   const AsyncInputStreamConfig &_config)
+	:InputStream(_url, _mutex, _cond), DeferredMonitor(event_loop),
+	 buffer((uint8_t *)_buffer, _config.buffer_size),
+	 config(_config),
+	 high_watermark(_config.high_watermark),
+	 low_watermark(_config.low_watermark),
+	 rate_bytes(0), rate_start(MonotonicClockUS()), rate(0),
+	 last_append(0), max_gap(0), jitter(0),
 	 open(true),
 	 paused(false),
 	 seek_state(SeekState::NONE),
@@ -59,7 +127,7 @@ AsyncInputStream::SetTag(Tag *_tag)
 void
 AsyncInputStream::Pause()
 {
-	assert(io_thread_inside());
+	assert(GetEventLoop().IsInside());
 
 	paused = true;
 }
@@ -67,7 +135,7 @@ AsyncInputStream::Pause()
 void
 AsyncInputStream::PostponeError(Error &&error)
 {
-	assert(io_thread_inside());
+	assert(GetEventLoop().IsInside());
 
 	seek_state = SeekState::NONE;
 	postponed_error = std::move(error);
@@ -77,14 +145,69 @@ AsyncInputStream::PostponeError(Error &&error)
 inline void
 AsyncInputStream::Resume()
 {
-	assert(io_thread_inside());
+	assert(GetEventLoop().IsInside());
 
 	if (paused) {
 		paused = false;
+		last_append = 0;
 		DoResume();
 	}
 }
 
+void
+AsyncInputStream::Adapt()
+{
+	if (!config.adaptive || rate == 0)
+		return;
+
+	const uint64_t buffer_time = MIN_BUFFER_TIME_US +
+		JITTER_FACTOR * jitter;
+	const uint64_t wanted = rate * buffer_time / 1000000;
+
+	high_watermark = std::max<uint64_t>(std::min<uint64_t>(wanted,
+							       config.high_watermark),
+					    std::min(MIN_HIGH_WATERMARK,
+						     config.high_watermark));
+
+	/* keep the configured ratio between the watermarks */
+	low_watermark = std::min<uint64_t>((uint64_t)high_watermark *
+					   config.low_watermark /
+					   config.high_watermark,
+					   high_watermark -
+					   std::min(high_watermark,
+						    MIN_WATERMARK_DISTANCE));
+}
+
+inline void
+AsyncInputStream::Consumed(size_t nbytes)
+{
+	offset += (offset_type)nbytes;
+
+	rate_bytes += nbytes;
+
+	const uint64_t now = MonotonicClockUS();
+	const uint64_t elapsed = now - rate_start;
+	if (elapsed >= RATE_PERIOD_US) {
+		const uint64_t period_rate = rate_bytes * 1000000 / elapsed;
+		rate = rate > 0
+			? (rate * 3 + period_rate) / 4
+			: period_rate;
+
+		/* the jitter allowance decays slowly, and grows
+		   immediately with a larger gap */
+		jitter = std::max(max_gap, jitter - jitter / 8);
+		max_gap = 0;
+
+		rate_bytes = 0;
+		rate_start = now;
+
+		Adapt();
+	}
+
+	if (paused && buffer.GetSize() < low_watermark)
+		DeferredMonitor::Schedule();
+}
+
 bool
 AsyncInputStream::Check(Error &error)
 {
@@ -157,7 +280,7 @@ AsyncInputStream::Seek(offset_type new_offset, Error &error)
 void
 AsyncInputStream::SeekDone()
 {
-	assert(io_thread_inside());
+	assert(GetEventLoop().IsInside());
 	assert(IsSeekPending());
 
 	/* we may have reached end-of-file previously, and the
@@ -165,6 +288,9 @@ AsyncInputStream::SeekDone()
 	   seeking successfully, the connection must be alive again */
 	open = true;
 
+	/* the request latency is not jitter */
+	last_append = 0;
+
 	seek_state = SeekState::NONE;
 	cond.broadcast();
 }
@@ -188,7 +314,7 @@ AsyncInputStream::IsAvailable()
 size_t
 AsyncInputStream::Read(void *ptr, size_t read_size, Error &error)
 {
-	assert(!io_thread_inside());
+	assert(!GetEventLoop().IsInside());
 
 	/* wait for data */
 	CircularBuffer<uint8_t>::Range r;
@@ -207,14 +333,59 @@ AsyncInputStream::Read(void *ptr, size_t read_size, Error &error)
 	memcpy(ptr, r.data, nbytes);
 	buffer.Consume(nbytes);
 
-	offset += (offset_type)nbytes;
-
-	if (paused && buffer.GetSize() < resume_at)
-		DeferredMonitor::Schedule();
+	Consumed(nbytes);
 
 	return nbytes;
 }
 
+bool
+AsyncInputStream::SupportsPeek() const
+{
+	return true;
+}
+
+ConstBuffer<void>
+AsyncInputStream::Peek(Error &error)
+{
+	assert(!GetEventLoop().IsInside());
+
+	while (true) {
+		if (!Check(error))
+			return nullptr;
+
+		/* the I/O thread only appends to the free part of the
+		   buffer, so this range stays valid until it is
+		   consumed */
+		auto r = buffer.Read();
+		if (!r.IsEmpty())
+			return { r.data, r.size };
+
+		if (IsEOF())
+			return nullptr;
+
+		cond.wait(mutex);
+	}
+}
+
+void
+AsyncInputStream::Consume(size_t nbytes)
+{
+	assert(!GetEventLoop().IsInside());
+	assert(nbytes <= buffer.GetSize());
+
+	buffer.Consume(nbytes);
+
+	Consumed(nbytes);
+}
+
+bool
+AsyncInputStream::GetBufferLevel(size_t &used, size_t &limit)
+{
+	used = buffer.GetSize();
+	limit = high_watermark;
+	return true;
+}
+
 void
 AsyncInputStream::AppendToBuffer(const void *data, size_t append_size)
 {
@@ -235,6 +406,11 @@ AsyncInputStream::AppendToBuffer(const void *data, size_t append_size)
 		buffer.Append(remaining);
 	}
 
+	const uint64_t now = MonotonicClockUS();
+	if (last_append > 0)
+		max_gap = std::max(max_gap, now - last_append);
+	last_append = now;
+
 	if (!IsReady())
 		SetReady();
 	else
@@ -25,6 +25,56 @@
 #include "util/CircularBuffer.hxx"
 #include "util/Error.hxx"
 
+#include <algorithm>
+
+#include <stdint.h>
+
+struct ConfigBlock;
+
+/**
+ * Read-ahead buffer settings of an #AsyncInputStream.  Each input
+ * plugin has its own.
+ */
+struct AsyncInputStreamConfig {
+	/**
+	 * The size of the ring buffer in bytes.
+	 */
+	size_t buffer_size;
+
+	/**
+	 * Pause the transfer when the buffer is filled up to this
+	 * number of bytes.
+	 */
+	size_t high_watermark;
+
+	/**
+	 * Resume the transfer when the buffer drops below this number
+	 * of bytes.
+	 */
+	size_t low_watermark;
+
+	/**
+	 * Lower both watermarks (proportionally) to what the
+	 * observed bitrate and network jitter require?
+	 */
+	bool adaptive;
+
+	constexpr AsyncInputStreamConfig(size_t _buffer_size,
+					 size_t _low_watermark)
+		:buffer_size(_buffer_size),
+		 high_watermark(_buffer_size),
+		 low_watermark(_low_watermark),
+		 adaptive(true) {}
+
+	/**
+	 * Load the settings "buffer_size" (KiB), "high_watermark",
+	 * "low_watermark" (percent of the buffer size) and "adaptive"
+	 * from the input plugin's configuration block.  Missing
+	 * settings keep their current value.
+	 */
+	bool Load(const ConfigBlock &block, Error &error);
+};
+
 /**
  * Helper class for moving asynchronous (non-blocking) InputStream
  * implementations to the I/O thread.  Data is being read into a ring
@@ -37,7 +87,45 @@ class AsyncInputStream : public InputStream, private DeferredMonitor {
 	};
 
 	CircularBuffer<uint8_t> buffer;
-	const size_t resume_at;
+
+	const AsyncInputStreamConfig &config;
+
+	/**
+	 * The effective watermarks: the configured ones, or lower
+	 * values calculated by Adapt().  Protected by the mutex.
+	 */
+	size_t high_watermark, low_watermark;
+
+	/**
+	 * The number of bytes consumed by the client since
+	 * #rate_start; used to estimate the bitrate.
+	 */
+	uint64_t rate_bytes;
+
+	/**
+	 * MonotonicClockUS() when the current measurement period
+	 * began.
+	 */
+	uint64_t rate_start;
+
+	/**
+	 * The estimated consumption rate in bytes per second, 0 if
+	 * unknown.
+	 */
+	uint64_t rate;
+
+	/**
+	 * MonotonicClockUS() of the last AppendToBuffer() call, or 0
+	 * after the transfer was (re)started.
+	 */
+	uint64_t last_append;
+
+	/**
+	 * The longest time between two AppendToBuffer() calls in the
+	 * current measurement period, and the decaying maximum of
+	 * those (in microseconds).
+	 */
+	uint64_t max_gap, jitter;
 
 	bool open;
 
@@ -63,13 +151,17 @@ protected:
 
 public:
 	/**
-	 * @param _buffer a buffer allocated with HugeAllocate(); the
-	 * destructor will free it using HugeFree()
+	 * @param event_loop the #EventLoop which runs the transfer;
+	 * the "I/O thread" mentioned in this class is its thread
+	 * @param _buffer a buffer of _config.buffer_size bytes
+	 * allocated with HugeAllocate(); the destructor will free it
+	 * using HugeFree()
+	 * @param _config the plugin's settings; the reference must
+	 * remain valid
 	 */
-	AsyncInputStream(const char *_url,
+	AsyncInputStream(EventLoop &event_loop, const char *_url,
 			 Mutex &_mutex, Cond &_cond,
-			 void *_buffer, size_t _buffer_size,
-			 size_t _resume_at);
+			 void *_buffer, const AsyncInputStreamConfig &_config);
 
 	virtual ~AsyncInputStream();
 
@@ -80,8 +172,14 @@ public:
 	Tag *ReadTag() final;
 	bool IsAvailable() final;
 	size_t Read(void *ptr, size_t read_size, Error &error) final;
+	bool SupportsPeek() const final;
+	ConstBuffer<void> Peek(Error &error) final;
+	void Consume(size_t nbytes) final;
+	bool GetBufferLevel(size_t &used, size_t &limit) final;
 
 protected:
+	using DeferredMonitor::GetEventLoop;
+
 	/**
 	 * Pass an tag from the I/O thread to the client thread.
 	 */
@@ -115,16 +213,23 @@ protected:
 		return buffer.IsEmpty();
 	}
 
+	/**
+	 * Is the buffer filled up to the high watermark?
+	 */
 	bool IsBufferFull() const {
-		return buffer.IsFull();
+		return GetBufferSpace() == 0;
 	}
 
 	/**
-	 * Determine how many bytes can be added to the buffer.
+	 * Determine how many bytes can be added to the buffer before
+	 * the high watermark is reached.
 	 */
 	gcc_pure
 	size_t GetBufferSpace() const {
-		return buffer.GetSpace();
+		const size_t nbytes = buffer.GetSize();
+		return nbytes < high_watermark
+			? std::min(high_watermark - nbytes, buffer.GetSpace())
+			: 0;
 	}
 
 	/**
@@ -159,6 +264,19 @@ protected:
 private:
 	void Resume();
 
+	/**
+	 * Account consumed data for the bitrate estimation, and
+	 * schedule resuming the transfer if the buffer is below the
+	 * low watermark.  Runs in the client thread.
+	 */
+	void Consumed(size_t nbytes);
+
+	/**
+	 * Recalculate the watermarks from the observed bitrate and
+	 * jitter.
+	 */
+	void Adapt();
+
 	/* virtual methods from DeferredMonitor */
 	void RunDeferred() final;
 };
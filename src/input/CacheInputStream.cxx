@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "CacheInputStream.hxx"
+#include "InputCache.hxx"
+#include "InputPrefetcher.hxx"
+#include "Domain.hxx"
+#include "system/Clock.hxx"
+#include "util/Error.hxx"
+
+#include <vector>
+
+#include <assert.h>
+
+#ifndef WIN32
+
+/**
+ * Seeks which follow each other more quickly than this are assumed
+ * to come from the decoder (e.g. a bisection search) rather than
+ * from a client scrubbing through the file; they do not trigger
+ * prefetching.
+ */
+static constexpr unsigned SCRUB_INTERVAL_MS = 200;
+
+CacheInputStream::CacheInputStream(InputCache &_cache,
+				   InputCacheEntry &_entry,
+				   InputStream *_input,
+				   const char *_uri,
+				   Mutex &_mutex, Cond &_cond)
+	:InputStream(_uri, _mutex, _cond),
+	 cache(_cache), entry(_entry), input(_input),
+	 caching(_input == nullptr), seeked(false)
+{
+	if (input == nullptr) {
+		/* completely cached: no need to talk to the server */
+		const std::string mime_type = cache.GetMimeType(entry);
+		if (!mime_type.empty())
+			SetMimeType(mime_type.c_str());
+
+		size = cache.GetSize(entry);
+		seekable = true;
+		SetReady();
+	}
+}
+
+CacheInputStream::~CacheInputStream()
+{
+	delete input;
+	cache.Release(entry);
+}
+
+void
+CacheInputStream::CopyAttributes()
+{
+	assert(input != nullptr);
+
+	if (!IsReady()) {
+		if (!input->IsReady())
+			return;
+
+		if (input->HasMimeType())
+			SetMimeType(input->GetMimeType());
+
+		size = input->KnownSize()
+			? input->GetSize()
+			: UNKNOWN_SIZE;
+		seekable = input->IsSeekable();
+
+		caching = KnownSize() && seekable &&
+			size <= cache.GetMaxSize();
+		if (caching)
+			cache.SetAttributes(entry, size,
+					    HasMimeType()
+					    ? GetMimeType()
+					    : nullptr);
+
+		SetReady();
+	}
+
+	if (!caching)
+		offset = input->GetOffset();
+}
+
+bool
+CacheInputStream::Check(Error &error)
+{
+	return input == nullptr || input->Check(error);
+}
+
+void
+CacheInputStream::Update()
+{
+	if (input != nullptr) {
+		input->Update();
+		CopyAttributes();
+	}
+}
+
+bool
+CacheInputStream::Seek(offset_type new_offset, Error &error)
+{
+	if (!caching) {
+		bool success = input->Seek(new_offset, error);
+		CopyAttributes();
+		return success;
+	}
+
+	if (new_offset > size) {
+		error.Set(input_domain, "Invalid seek offset");
+		return false;
+	}
+
+	if (input != nullptr)
+		SchedulePrefetch(new_offset);
+
+	/* the remote stream is seeked by Read() if necessary */
+	offset = new_offset;
+	return true;
+}
+
+void
+CacheInputStream::SchedulePrefetch(offset_type target)
+{
+	if (input_prefetcher == nullptr)
+		return;
+
+	const unsigned now = MonotonicClockMS();
+	const bool scrubbing = seeked &&
+		now - last_seek_time >= SCRUB_INTERVAL_MS;
+	const int64_t delta = int64_t(target) - int64_t(last_seek_offset);
+
+	seeked = true;
+	last_seek_offset = target;
+	last_seek_time = now;
+
+	if (!scrubbing ||
+	    uint64_t(delta < 0 ? -delta : delta) <
+	    input_prefetcher->GetRangeSize())
+		return;
+
+	std::vector<offset_type> offsets;
+	int64_t next = target;
+	for (unsigned i = 0; i < input_prefetcher->GetWorkerCount(); ++i) {
+		next += delta;
+		if (next < 0 || offset_type(next) >= size)
+			break;
+
+		if (!cache.IsCached(entry, next))
+			offsets.push_back(next);
+	}
+
+	if (!offsets.empty())
+		input_prefetcher->Schedule(GetURI(), offsets.data(),
+					   offsets.size());
+}
+
+bool
+CacheInputStream::IsEOF()
+{
+	return caching
+		? offset >= size
+		: input->IsEOF();
+}
+
+Tag *
+CacheInputStream::ReadTag()
+{
+	return input != nullptr
+		? input->ReadTag()
+		: nullptr;
+}
+
+bool
+CacheInputStream::IsAvailable()
+{
+	if (!caching)
+		return input->IsAvailable();
+
+	return IsEOF() || cache.IsCached(entry, offset) ||
+		input == nullptr ||
+		/* Read() needs to seek first */
+		input->GetOffset() != offset ||
+		input->IsAvailable();
+}
+
+size_t
+CacheInputStream::Read(void *ptr, size_t read_size, Error &error)
+{
+	if (!caching) {
+		size_t nbytes = input->Read(ptr, read_size, error);
+		CopyAttributes();
+		return nbytes;
+	}
+
+	if (offset >= size)
+		return 0;
+
+	if ((offset_type)read_size > size - offset)
+		read_size = size - offset;
+
+	size_t nbytes = cache.Read(entry, offset, ptr, read_size);
+	if (nbytes > 0) {
+		offset += nbytes;
+		return nbytes;
+	}
+
+	if (input == nullptr) {
+		error.Format(input_domain, "Failed to read the cache of %s",
+			     GetURI());
+		return 0;
+	}
+
+	/* not cached: fetch it from the remote stream, but only up
+	   to the next cached range */
+
+	if (input->GetOffset() != offset && !input->Seek(offset, error))
+		return 0;
+
+	const offset_type missing = cache.GetMissing(entry, offset);
+	if ((offset_type)read_size > missing)
+		read_size = missing;
+
+	nbytes = input->Read(ptr, read_size, error);
+	if (nbytes > 0) {
+		cache.Write(entry, offset, ptr, nbytes);
+		offset += nbytes;
+	}
+
+	return nbytes;
+}
+
+bool
+CacheInputStream::GetBufferLevel(size_t &used, size_t &limit)
+{
+	return input != nullptr && input->GetBufferLevel(used, limit);
+}
+
+#endif
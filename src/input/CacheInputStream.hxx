@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_CACHE_INPUT_STREAM_HXX
+#define MPD_CACHE_INPUT_STREAM_HXX
+
+#include "check.h"
+#include "InputStream.hxx"
+
+class InputCache;
+struct InputCacheEntry;
+
+/**
+ * An #InputStream which reads from the #InputCache, and fetches only
+ * missing data from the remote stream (and adds it to the cache).
+ * Seeking only changes the offset; the remote stream is seeked
+ * lazily when missing data is needed.
+ *
+ * If the remote file cannot be cached (unknown size, not seekable or
+ * too large), all calls are forwarded to the remote stream.
+ */
+class CacheInputStream final : public InputStream {
+	InputCache &cache;
+	InputCacheEntry &entry;
+
+	/**
+	 * The remote stream; nullptr if the file is completely
+	 * cached.
+	 */
+	InputStream *const input;
+
+	/**
+	 * Is data served from (and added to) the cache?  This is
+	 * decided as soon as the remote stream is ready.
+	 */
+	bool caching;
+
+	/**
+	 * Has Seek() been called before?  If yes, then
+	 * #last_seek_offset and #last_seek_time are valid.
+	 */
+	bool seeked;
+
+	offset_type last_seek_offset;
+
+	/**
+	 * The time of the last Seek() call [MonotonicClockMS()].
+	 */
+	unsigned last_seek_time;
+
+public:
+	/**
+	 * @param _entry an entry obtained with InputCache::Acquire(),
+	 * which will be released by the destructor
+	 * @param _input the remote stream, or nullptr if the entry is
+	 * complete; this object takes over ownership
+	 */
+	CacheInputStream(InputCache &_cache, InputCacheEntry &_entry,
+			 InputStream *_input,
+			 const char *_uri, Mutex &_mutex, Cond &_cond);
+
+	~CacheInputStream();
+
+	CacheInputStream(const CacheInputStream &) = delete;
+	CacheInputStream &operator=(const CacheInputStream &) = delete;
+
+	/* virtual methods from InputStream */
+	bool Check(Error &error) override;
+	void Update() override;
+	bool Seek(offset_type new_offset, Error &error) override;
+	bool IsEOF() override;
+	Tag *ReadTag() override;
+	bool IsAvailable() override;
+	size_t Read(void *ptr, size_t read_size, Error &error) override;
+	bool GetBufferLevel(size_t &used, size_t &limit) override;
+
+private:
+	/**
+	 * Copy the attributes of the remote stream as soon as it is
+	 * ready, and decide whether it can be cached.
+	 */
+	void CopyAttributes();
+
+	/**
+	 * Detect a client scrubbing through the file, and let the
+	 * #InputPrefetcher load the ranges it is likely to seek to
+	 * next: repeating the distance between the previous and this
+	 * seek.
+	 */
+	void SchedulePrefetch(offset_type target);
+};
+
+#endif
@@ -0,0 +1,617 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "InputCache.hxx"
+#include "Domain.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "config/Block.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "util/StringUtil.hxx"
+#include "util/NumberParser.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <vector>
+
+#include <assert.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifndef WIN32
+
+static constexpr char DATA_SUFFIX[] = ".data";
+static constexpr char INDEX_SUFFIX[] = ".idx";
+
+InputCache *input_cache;
+
+static const char *
+AfterPrefix(const char *s, const char *prefix)
+{
+	const size_t length = strlen(prefix);
+	return memcmp(s, prefix, length) == 0
+		? s + length
+		: nullptr;
+}
+
+/**
+ * Derive the file name from the URI (64 bit FNV-1a, hex).
+ */
+static std::string
+MakeEntryName(const char *uri)
+{
+	uint64_t h = 14695981039346656037ull;
+	for (const char *p = uri; *p != 0; ++p)
+		h = (h ^ uint8_t(*p)) * 1099511628211ull;
+
+	char buffer[17];
+	snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)h);
+	return buffer;
+}
+
+offset_type
+InputCacheEntry::GetCachedAt(offset_type offset) const
+{
+	auto i = ranges.upper_bound(offset);
+	if (i == ranges.begin())
+		return 0;
+
+	--i;
+	return i->second > offset
+		? i->second - offset
+		: 0;
+}
+
+offset_type
+InputCacheEntry::GetMissingAt(offset_type offset) const
+{
+	auto i = ranges.upper_bound(offset);
+	if (i == ranges.end())
+		return size != UNKNOWN_SIZE && size > offset
+			? size - offset
+			: UNKNOWN_SIZE;
+
+	return i->first - offset;
+}
+
+offset_type
+InputCacheEntry::AddRange(offset_type start, offset_type end)
+{
+	assert(start < end);
+
+	/* find the first range which touches the new one */
+	auto i = ranges.upper_bound(start);
+	if (i != ranges.begin()) {
+		auto prev = std::prev(i);
+		if (prev->second >= start)
+			i = prev;
+	}
+
+	offset_type removed = 0;
+	while (i != ranges.end() && i->first <= end) {
+		start = std::min(start, i->first);
+		end = std::max(end, i->second);
+		removed += i->second - i->first;
+		i = ranges.erase(i);
+	}
+
+	ranges.emplace(start, end);
+
+	const offset_type added = (end - start) - removed;
+	cached += added;
+	return added;
+}
+
+InputCache::InputCache(AllocatedPath &&_directory, offset_type _max_size)
+	:directory(std::move(_directory)), max_size(_max_size),
+	 total_size(0) {}
+
+InputCache::~InputCache()
+{
+	for (auto &entry : entries) {
+		assert(entry.refs == 0);
+
+		if (entry.dirty)
+			SaveIndex(entry);
+	}
+}
+
+bool
+InputCache::IsEnabledFor(const char *uri) const
+{
+	for (const auto &prefix : prefixes)
+		if (StringStartsWith(uri, prefix.c_str()))
+			return true;
+
+	return false;
+}
+
+AllocatedPath
+InputCache::GetDataPath(const std::string &name) const
+{
+	return AllocatedPath::Build(directory, (name + DATA_SUFFIX).c_str());
+}
+
+AllocatedPath
+InputCache::GetIndexPath(const std::string &name) const
+{
+	return AllocatedPath::Build(directory, (name + INDEX_SUFFIX).c_str());
+}
+
+bool
+InputCache::OpenData(InputCacheEntry &entry, Error &error)
+{
+	if (entry.fd >= 0)
+		return true;
+
+	const auto path = GetDataPath(entry.name);
+	entry.fd = OpenFile(path, O_RDWR|O_CREAT, 0600);
+	if (entry.fd < 0) {
+		error.FormatErrno("Failed to open %s", path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void
+InputCache::SaveIndex(InputCacheEntry &entry)
+{
+	Error error;
+	FileOutputStream fos(GetIndexPath(entry.name), error);
+	if (!fos.IsDefined()) {
+		LogError(error);
+		return;
+	}
+
+	BufferedOutputStream bos(fos);
+	bos.Format("uri: %s\n", entry.uri.c_str());
+	if (entry.size != InputCacheEntry::UNKNOWN_SIZE)
+		bos.Format("size: %llu\n", (unsigned long long)entry.size);
+	if (!entry.mime.empty())
+		bos.Format("mime: %s\n", entry.mime.c_str());
+	for (const auto &i : entry.ranges)
+		bos.Format("range: %llu %llu\n",
+			   (unsigned long long)i.first,
+			   (unsigned long long)i.second);
+
+	if (!bos.Flush(error) || !fos.Commit(error)) {
+		LogError(error);
+		return;
+	}
+
+	entry.dirty = false;
+}
+
+/**
+ * An entry loaded from the cache directory, with the modification
+ * time of its index file, which determines the LRU order.
+ */
+struct LoadedEntry {
+	time_t mtime;
+	InputCacheEntry entry;
+
+	LoadedEntry(time_t _mtime, InputCacheEntry &&_entry)
+		:mtime(_mtime), entry(std::move(_entry)) {}
+
+	bool operator<(const LoadedEntry &other) const {
+		return mtime < other.mtime;
+	}
+};
+
+/**
+ * Parse an index file.
+ */
+static bool
+LoadIndexFile(Path path, InputCacheEntry &entry, Error &error)
+{
+	TextFile file(path, error);
+	if (file.HasFailed())
+		return false;
+
+	char *line;
+	while ((line = file.ReadLine()) != nullptr) {
+		const char *value;
+		if ((value = AfterPrefix(line, "uri: ")) != nullptr)
+			entry.uri = value;
+		else if ((value = AfterPrefix(line, "size: ")) != nullptr)
+			entry.size = ParseUint64(value);
+		else if ((value = AfterPrefix(line, "mime: ")) != nullptr)
+			entry.mime = value;
+		else if ((value = AfterPrefix(line, "range: ")) != nullptr) {
+			char *endptr;
+			const offset_type start = ParseUint64(value, &endptr);
+			const offset_type end = ParseUint64(endptr, &endptr);
+			if (*endptr != 0 || start >= end || end > entry.size) {
+				error.Format(input_domain,
+					     "Malformed line in %s",
+					     path.c_str());
+				return false;
+			}
+
+			entry.AddRange(start, end);
+		}
+	}
+
+	if (!file.Check(error))
+		return false;
+
+	if (entry.uri.empty() ||
+	    MakeEntryName(entry.uri.c_str()) != entry.name) {
+		error.Format(input_domain, "Malformed cache index %s",
+			     path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool
+InputCache::Load(Error &error)
+{
+	assert(entries.empty());
+
+	if (!DirectoryExists(directory) &&
+	    mkdir(directory.c_str(), 0700) < 0) {
+		error.FormatErrno("Failed to create %s", directory.c_str());
+		return false;
+	}
+
+	std::vector<LoadedEntry> loaded;
+	std::vector<std::string> data_files;
+
+	{
+		DirectoryReader reader(directory);
+		if (reader.HasFailed()) {
+			error.FormatErrno("Failed to open %s",
+					  directory.c_str());
+			return false;
+		}
+
+		while (reader.ReadEntry()) {
+			const char *filename = reader.GetEntry().c_str();
+
+			const char *suffix = FindStringSuffix(filename,
+							      INDEX_SUFFIX);
+			if (suffix != nullptr) {
+				InputCacheEntry entry(std::string(),
+						      std::string(filename,
+								  suffix));
+				const auto path =
+					AllocatedPath::Build(directory,
+							     filename);
+
+				struct stat st;
+				Error error2;
+				if (!StatFile(path, st) ||
+				    !LoadIndexFile(path, entry, error2)) {
+					if (error2.IsDefined())
+						LogError(error2);
+					RemoveFile(path);
+					continue;
+				}
+
+				loaded.emplace_back(st.st_mtime,
+						    std::move(entry));
+			} else if (FindStringSuffix(filename,
+						    DATA_SUFFIX) != nullptr)
+				data_files.emplace_back(filename);
+		}
+	}
+
+	std::sort(loaded.begin(), loaded.end());
+
+	for (auto &i : loaded) {
+		InputCacheEntry &entry = i.entry;
+
+		/* the data file must contain all ranges */
+		const auto data_path = GetDataPath(entry.name);
+		struct stat st;
+		if (!StatFile(data_path, st) ||
+		    (!entry.ranges.empty() &&
+		     offset_type(st.st_size) < entry.ranges.rbegin()->second)) {
+			RemoveFile(GetIndexPath(entry.name));
+			continue;
+		}
+
+		auto e = entries.emplace(entries.end(), std::move(entry));
+		by_uri.emplace(e->uri, e);
+		total_size += e->cached;
+	}
+
+	/* delete data files without an index */
+	for (const auto &filename : data_files) {
+		const std::string name(filename, 0,
+				       filename.length() - strlen(DATA_SUFFIX));
+		auto e = std::find_if(entries.begin(), entries.end(),
+				      [&name](const InputCacheEntry &entry){
+					      return entry.name == name;
+				      });
+		if (e == entries.end())
+			RemoveFile(GetDataPath(name));
+	}
+
+	FormatDebug(input_domain, "Loaded %u files (%llu bytes) from the cache",
+		    unsigned(entries.size()), (unsigned long long)total_size);
+
+	Trim();
+	return true;
+}
+
+InputCacheEntry *
+InputCache::Acquire(const char *uri, Error &error)
+{
+	const ScopeLock protect(mutex);
+
+	EntryIterator i;
+	auto f = by_uri.find(uri);
+	if (f != by_uri.end()) {
+		/* mark as most recently used */
+		i = f->second;
+		entries.splice(entries.end(), entries, i);
+	} else {
+		i = entries.emplace(entries.end(), uri, MakeEntryName(uri));
+		by_uri.emplace(i->uri, i);
+	}
+
+	if (!OpenData(*i, error)) {
+		if (i->refs == 0)
+			Remove(i);
+		return nullptr;
+	}
+
+	++i->refs;
+	return &*i;
+}
+
+void
+InputCache::Release(InputCacheEntry &entry)
+{
+	const ScopeLock protect(mutex);
+
+	assert(entry.refs > 0);
+
+	if (--entry.refs > 0)
+		return;
+
+	close(entry.fd);
+	entry.fd = -1;
+
+	if (entry.cached == 0) {
+		Remove(by_uri.find(entry.uri)->second);
+		return;
+	}
+
+	if (entry.dirty)
+		SaveIndex(entry);
+
+	Trim();
+}
+
+void
+InputCache::SetAttributes(InputCacheEntry &entry, offset_type size,
+			  const char *mime)
+{
+	const ScopeLock protect(mutex);
+
+	if (entry.size != size) {
+		if (entry.cached > 0) {
+			/* the remote file has changed: discard the
+			   stale data */
+			FormatDebug(input_domain, "Discarding stale cache of %s",
+				    entry.uri.c_str());
+
+			total_size -= entry.cached;
+			entry.cached = 0;
+			entry.ranges.clear();
+
+			if (entry.fd >= 0 && ftruncate(entry.fd, 0) < 0)
+				FormatErrno(input_domain,
+					    "Failed to truncate cache of %s",
+					    entry.uri.c_str());
+		}
+
+		entry.size = size;
+		entry.dirty = true;
+	}
+
+	if (mime != nullptr && entry.mime != mime) {
+		entry.mime = mime;
+		entry.dirty = true;
+	}
+}
+
+offset_type
+InputCache::GetSize(const InputCacheEntry &entry) const
+{
+	const ScopeLock protect(mutex);
+	return entry.size;
+}
+
+std::string
+InputCache::GetMimeType(const InputCacheEntry &entry) const
+{
+	const ScopeLock protect(mutex);
+	return entry.mime;
+}
+
+bool
+InputCache::IsComplete(const InputCacheEntry &entry) const
+{
+	const ScopeLock protect(mutex);
+	return entry.IsComplete();
+}
+
+bool
+InputCache::IsCached(const InputCacheEntry &entry, offset_type offset) const
+{
+	const ScopeLock protect(mutex);
+	return entry.GetCachedAt(offset) > 0;
+}
+
+offset_type
+InputCache::GetMissing(const InputCacheEntry &entry,
+		       offset_type offset) const
+{
+	const ScopeLock protect(mutex);
+	return entry.GetMissingAt(offset);
+}
+
+size_t
+InputCache::Read(InputCacheEntry &entry, offset_type offset,
+		 void *dest, size_t length)
+{
+	assert(entry.refs > 0);
+	assert(entry.fd >= 0);
+
+	mutex.lock();
+	const offset_type available = entry.GetCachedAt(offset);
+	mutex.unlock();
+
+	if (available == 0)
+		return 0;
+
+	if ((offset_type)length > available)
+		length = available;
+
+	/* the file descriptor remains valid while we hold a
+	   reference */
+	const ssize_t nbytes = pread(entry.fd, dest, length, offset);
+	if (nbytes < 0) {
+		FormatErrno(input_domain, "Failed to read cache of %s",
+			    entry.uri.c_str());
+		return 0;
+	}
+
+	return nbytes;
+}
+
+void
+InputCache::Write(InputCacheEntry &entry, offset_type offset,
+		  const void *src, size_t length)
+{
+	assert(entry.refs > 0);
+	assert(entry.fd >= 0);
+
+	const ssize_t nbytes = pwrite(entry.fd, src, length, offset);
+	if (nbytes <= 0) {
+		if (nbytes < 0)
+			FormatErrno(input_domain,
+				    "Failed to write cache of %s",
+				    entry.uri.c_str());
+		return;
+	}
+
+	const ScopeLock protect(mutex);
+
+	total_size += entry.AddRange(offset, offset + nbytes);
+	entry.dirty = true;
+
+	Trim();
+}
+
+void
+InputCache::Remove(EntryIterator i)
+{
+	assert(i->refs == 0);
+
+	if (i->fd >= 0)
+		close(i->fd);
+
+	RemoveFile(GetDataPath(i->name));
+	RemoveFile(GetIndexPath(i->name));
+
+	total_size -= i->cached;
+	by_uri.erase(i->uri);
+	entries.erase(i);
+}
+
+void
+InputCache::Trim()
+{
+	for (auto i = entries.begin();
+	     total_size > max_size && i != entries.end();) {
+		auto next = std::next(i);
+		if (i->refs == 0)
+			Remove(i);
+		i = next;
+	}
+}
+
+bool
+input_cache_global_init(Error &error)
+{
+	const auto *block = config_get_block(ConfigBlockOption::INPUT_CACHE);
+	if (block == nullptr)
+		return true;
+
+	auto path = block->GetBlockPath("path", error);
+	if (path.IsNull()) {
+		if (!error.IsDefined())
+			error.Set(input_domain,
+				  "No \"path\" in input_cache block");
+		return false;
+	}
+
+	const unsigned size_mb = block->GetBlockValue("size", 1024u);
+	if (size_mb == 0) {
+		error.Set(input_domain, "Invalid input_cache size");
+		return false;
+	}
+
+	input_cache = new InputCache(std::move(path),
+				     offset_type(size_mb) << 20);
+
+	const char *schemes = block->GetBlockValue("schemes",
+						   "http https nfs smb");
+	for (const char *p = schemes; *(p = StripLeft(p)) != 0;) {
+		const size_t length = strcspn(p, " \t,");
+		input_cache->AddPrefix(std::string(p, length) + "://");
+
+		p += length;
+		if (*p != 0)
+			++p;
+	}
+
+	if (!input_cache->Load(error)) {
+		delete input_cache;
+		input_cache = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+void
+input_cache_global_finish()
+{
+	delete input_cache;
+	input_cache = nullptr;
+}
+
+#endif
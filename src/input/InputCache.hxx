@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_INPUT_CACHE_HXX
+#define MPD_INPUT_CACHE_HXX
+
+#include "check.h"
+#include "Offset.hxx"
+#include "thread/Mutex.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "Compiler.h"
+
+#include <string>
+#include <list>
+#include <map>
+#include <forward_list>
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Error;
+class BufferedOutputStream;
+
+/**
+ * An entry of the #InputCache: the cached parts of one remote file.
+ * It is stored in two files in the cache directory: a sparse data
+ * file and an index file which describes which byte ranges of the
+ * data file are valid.
+ *
+ * All attributes are protected by InputCache::mutex.
+ */
+struct InputCacheEntry {
+	static constexpr offset_type UNKNOWN_SIZE = -1;
+
+	/**
+	 * The URI of the remote file.
+	 */
+	std::string uri;
+
+	/**
+	 * The base name of the files in the cache directory, derived
+	 * from a hash of the URI.
+	 */
+	std::string name;
+
+	std::string mime;
+
+	/**
+	 * The size of the remote file, or #UNKNOWN_SIZE if not yet
+	 * known.
+	 */
+	offset_type size;
+
+	/**
+	 * The valid byte ranges of the data file: maps the start
+	 * offset to the end offset.  Adjacent ranges are merged.
+	 */
+	std::map<offset_type, offset_type> ranges;
+
+	/**
+	 * The sum of all #ranges.
+	 */
+	offset_type cached;
+
+	/**
+	 * The file descriptor of the data file, or -1 if it is not
+	 * open.
+	 */
+	int fd;
+
+	/**
+	 * The number of streams using this entry.  An entry which is
+	 * in use will not be evicted.
+	 */
+	unsigned refs;
+
+	/**
+	 * Has this entry been modified since the index file was
+	 * written?
+	 */
+	bool dirty;
+
+	InputCacheEntry(std::string &&_uri, std::string &&_name)
+		:uri(std::move(_uri)), name(std::move(_name)),
+		 size(UNKNOWN_SIZE), cached(0), fd(-1), refs(0), dirty(false) {}
+
+	bool IsComplete() const {
+		return size != UNKNOWN_SIZE && cached == size;
+	}
+
+	/**
+	 * Returns the number of cached bytes beginning at the
+	 * specified offset (0 if that offset is not cached).
+	 */
+	gcc_pure
+	offset_type GetCachedAt(offset_type offset) const;
+
+	/**
+	 * Returns the number of missing bytes beginning at the
+	 * specified offset, until the next cached range.
+	 */
+	gcc_pure
+	offset_type GetMissingAt(offset_type offset) const;
+
+	/**
+	 * Mark a range as valid.
+	 *
+	 * @return the number of bytes which were not cached before
+	 */
+	offset_type AddRange(offset_type start, offset_type end);
+};
+
+/**
+ * A persistent, size-limited cache on the local disk for files
+ * loaded from remote servers (e.g. via HTTP, NFS or SMB).  It stores
+ * the byte ranges which were read; the least recently used files are
+ * evicted when the cache is full.  The remote files are assumed to
+ * be immutable; an entry is only discarded if the remote file size
+ * changes.
+ *
+ * This class is thread-safe.
+ */
+class InputCache {
+	const AllocatedPath directory;
+
+	/**
+	 * The maximum total size of all cached data in bytes.
+	 */
+	const offset_type max_size;
+
+	/**
+	 * The URI prefixes (e.g. "http://") which are cached.
+	 */
+	std::forward_list<std::string> prefixes;
+
+	mutable Mutex mutex;
+
+	/**
+	 * All entries; the least recently used one is at the front.
+	 */
+	std::list<InputCacheEntry> entries;
+
+	typedef std::list<InputCacheEntry>::iterator EntryIterator;
+
+	std::map<std::string, EntryIterator> by_uri;
+
+	/**
+	 * The sum of InputCacheEntry::cached of all entries.
+	 */
+	offset_type total_size;
+
+public:
+	InputCache(AllocatedPath &&_directory, offset_type _max_size);
+
+	/**
+	 * Saves the index files of all modified entries.
+	 */
+	~InputCache();
+
+	InputCache(const InputCache &) = delete;
+	InputCache &operator=(const InputCache &) = delete;
+
+	offset_type GetMaxSize() const {
+		return max_size;
+	}
+
+	/**
+	 * Add a URI prefix (e.g. "http://") which shall be cached.
+	 */
+	void AddPrefix(std::string &&prefix) {
+		prefixes.emplace_front(std::move(prefix));
+	}
+
+	gcc_pure
+	bool IsEnabledFor(const char *uri) const;
+
+	/**
+	 * Load the index files from the cache directory.  Data files
+	 * without a valid index are deleted.
+	 */
+	bool Load(Error &error);
+
+	/**
+	 * Obtain (and create, if necessary) the entry for the
+	 * specified URI and open its data file.  The caller must
+	 * release it with Release().
+	 *
+	 * @return nullptr on error
+	 */
+	InputCacheEntry *Acquire(const char *uri, Error &error);
+
+	/**
+	 * Release an entry obtained with Acquire().  The index file
+	 * is written if the entry is not used anymore.
+	 */
+	void Release(InputCacheEntry &entry);
+
+	/**
+	 * Declare the size and MIME type of the remote file, as
+	 * reported by the server.  If the size differs from the
+	 * cached one, all cached data is discarded.
+	 */
+	void SetAttributes(InputCacheEntry &entry, offset_type size,
+			   const char *mime);
+
+	/**
+	 * Returns the size of the remote file, or
+	 * InputCacheEntry::UNKNOWN_SIZE.
+	 */
+	gcc_pure
+	offset_type GetSize(const InputCacheEntry &entry) const;
+
+	gcc_pure
+	std::string GetMimeType(const InputCacheEntry &entry) const;
+
+	gcc_pure
+	bool IsComplete(const InputCacheEntry &entry) const;
+
+	/**
+	 * Is the byte at the specified offset cached?
+	 */
+	gcc_pure
+	bool IsCached(const InputCacheEntry &entry, offset_type offset) const;
+
+	/**
+	 * See InputCacheEntry::GetMissingAt().
+	 */
+	gcc_pure
+	offset_type GetMissing(const InputCacheEntry &entry,
+			       offset_type offset) const;
+
+	/**
+	 * Read cached data.
+	 *
+	 * @return the number of bytes read; 0 if the specified offset
+	 * is not cached
+	 */
+	size_t Read(InputCacheEntry &entry, offset_type offset,
+		    void *dest, size_t length);
+
+	/**
+	 * Store data which has been read from the remote file.
+	 * Errors are logged and otherwise ignored; the data is then
+	 * just not cached.
+	 */
+	void Write(InputCacheEntry &entry, offset_type offset,
+		   const void *src, size_t length);
+
+private:
+	AllocatedPath GetDataPath(const std::string &name) const;
+	AllocatedPath GetIndexPath(const std::string &name) const;
+
+	bool OpenData(InputCacheEntry &entry, Error &error);
+
+	void SaveIndex(InputCacheEntry &entry);
+
+	/**
+	 * Delete the files of an entry which is not in use and forget
+	 * it.
+	 */
+	void Remove(EntryIterator i);
+
+	/**
+	 * Evict the least recently used entries which are not in use
+	 * until the total size fits into #max_size.
+	 */
+	void Trim();
+};
+
+/**
+ * The global cache instance; nullptr if the cache is disabled.
+ */
+extern InputCache *input_cache;
+
+/**
+ * Create #input_cache if the "input_cache" block is configured.
+ */
+bool
+input_cache_global_init(Error &error);
+
+void
+input_cache_global_finish();
+
+#endif
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "InputPrefetcher.hxx"
+#include "InputCache.hxx"
+#include "InputStream.hxx"
+#include "Domain.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "config/Block.hxx"
+#include "thread/Name.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+#ifndef WIN32
+
+InputPrefetcher *input_prefetcher;
+
+/**
+ * The maximum number of pending jobs; older ones are discarded.
+ */
+static constexpr size_t MAX_JOBS = 64;
+
+InputPrefetcher::~InputPrefetcher()
+{
+	Stop();
+}
+
+bool
+InputPrefetcher::Start(Error &error)
+{
+	assert(threads.empty());
+
+	quit = false;
+
+	for (unsigned i = 0; i < n_workers; ++i) {
+		threads.emplace_back();
+		if (!threads.back().Start(Run, this, error)) {
+			threads.pop_back();
+			Stop();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void
+InputPrefetcher::Stop()
+{
+	mutex.lock();
+	quit = true;
+	jobs.clear();
+	cond.broadcast();
+	mutex.unlock();
+
+	for (auto &thread : threads)
+		thread.Join();
+	threads.clear();
+}
+
+void
+InputPrefetcher::Schedule(const char *uri, const offset_type *offsets,
+			  unsigned n)
+{
+	const ScopeLock protect(mutex);
+
+	jobs.remove_if([uri](const Job &job){
+			return job.uri == uri;
+		});
+
+	/* the workers pick the last job first */
+	for (unsigned i = n; i > 0; --i)
+		jobs.emplace_back(uri, offsets[i - 1]);
+
+	while (jobs.size() > MAX_JOBS)
+		jobs.pop_front();
+
+	cond.broadcast();
+}
+
+void
+InputPrefetcher::Fetch(const Job &job, void *buffer, size_t buffer_size)
+{
+	Error error;
+
+	mutex.unlock();
+	InputStream *is = InputStream::Open(job.uri.c_str(),
+					    mutex, cond, error);
+	mutex.lock();
+
+	if (is == nullptr) {
+		LogError(error);
+		return;
+	}
+
+	while (!quit && !is->IsReady()) {
+		is->Update();
+		if (!is->IsReady())
+			cond.wait(mutex);
+	}
+
+	if (!quit && is->Check(error) && is->IsSeekable() &&
+	    is->Seek(job.offset, error)) {
+		size_t remaining = range_size;
+		while (remaining > 0 && !quit && !is->IsEOF()) {
+			if (!is->IsAvailable()) {
+				cond.wait(mutex);
+				continue;
+			}
+
+			size_t nbytes = is->Read(buffer,
+						 std::min(buffer_size,
+							  remaining),
+						 error);
+			if (nbytes == 0)
+				break;
+
+			remaining -= nbytes;
+		}
+	}
+
+	if (error.IsDefined())
+		LogError(error);
+
+	mutex.unlock();
+	delete is;
+	mutex.lock();
+}
+
+inline void
+InputPrefetcher::Run()
+{
+	SetThreadName("prefetch");
+
+	char buffer[16384];
+
+	const ScopeLock protect(mutex);
+
+	while (true) {
+		while (!quit && jobs.empty())
+			cond.wait(mutex);
+
+		if (quit)
+			break;
+
+		/* the most recently scheduled job first: it belongs
+		   to the most recent seek */
+		const Job job = std::move(jobs.back());
+		jobs.pop_back();
+
+		FormatDebug(input_domain, "prefetching %s at %llu",
+			    job.uri.c_str(), (unsigned long long)job.offset);
+		Fetch(job, buffer, sizeof(buffer));
+	}
+}
+
+void
+InputPrefetcher::Run(void *ctx)
+{
+	InputPrefetcher &prefetcher = *(InputPrefetcher *)ctx;
+	prefetcher.Run();
+}
+
+bool
+input_prefetcher_global_init(Error &error)
+{
+	if (input_cache == nullptr)
+		return true;
+
+	const auto *block = config_get_block(ConfigBlockOption::INPUT_CACHE);
+	assert(block != nullptr);
+
+	const unsigned n_workers = block->GetBlockValue("prefetch", 4u);
+	if (n_workers == 0)
+		return true;
+
+	const unsigned range_kb = block->GetBlockValue("prefetch_size", 256u);
+	if (range_kb == 0) {
+		error.Set(input_domain, "Invalid prefetch_size");
+		return false;
+	}
+
+	input_prefetcher = new InputPrefetcher(size_t(range_kb) * 1024,
+					       n_workers);
+	if (!input_prefetcher->Start(error)) {
+		delete input_prefetcher;
+		input_prefetcher = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+void
+input_prefetcher_global_finish()
+{
+	delete input_prefetcher;
+	input_prefetcher = nullptr;
+}
+
+#endif
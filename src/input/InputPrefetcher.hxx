@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_INPUT_PREFETCHER_HXX
+#define MPD_INPUT_PREFETCHER_HXX
+
+#include "check.h"
+#include "Offset.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <string>
+#include <list>
+
+#include <stddef.h>
+
+class Error;
+
+/**
+ * Loads ranges of remote files into the #InputCache in the
+ * background, with several concurrent requests.  This is used to
+ * fetch the likely targets of the next seek while a client scrubs
+ * through a long remote file, so the seek can be served from the
+ * cache.
+ *
+ * Each range is loaded by a worker thread with a separate
+ * #InputStream (opened through the cache, so only missing data is
+ * requested from the server).
+ */
+class InputPrefetcher {
+	struct Job {
+		std::string uri;
+		offset_type offset;
+
+		Job(const char *_uri, offset_type _offset)
+			:uri(_uri), offset(_offset) {}
+	};
+
+	/**
+	 * The number of bytes loaded by each job.
+	 */
+	const size_t range_size;
+
+	/**
+	 * The maximum number of concurrent requests, which is the
+	 * number of worker threads.
+	 */
+	const unsigned n_workers;
+
+	/**
+	 * Protects #jobs and #quit, and is also the mutex of all
+	 * #InputStream instances created by the workers.
+	 */
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * Jobs which have not been started yet; the next one to be
+	 * started is at the end.
+	 */
+	std::list<Job> jobs;
+
+	std::list<Thread> threads;
+
+	bool quit;
+
+public:
+	InputPrefetcher(size_t _range_size, unsigned _n_workers)
+		:range_size(_range_size), n_workers(_n_workers),
+		 quit(false) {}
+
+	/**
+	 * Calls Stop().
+	 */
+	~InputPrefetcher();
+
+	InputPrefetcher(const InputPrefetcher &) = delete;
+	InputPrefetcher &operator=(const InputPrefetcher &) = delete;
+
+	size_t GetRangeSize() const {
+		return range_size;
+	}
+
+	unsigned GetWorkerCount() const {
+		return n_workers;
+	}
+
+	bool Start(Error &error);
+
+	/**
+	 * Cancel all pending jobs and wait for the running ones to
+	 * finish.
+	 */
+	void Stop();
+
+	/**
+	 * Replace all pending jobs for the specified URI with new
+	 * ones.  Older jobs of the same URI are obsolete, because
+	 * the client has seeked elsewhere in the meantime.
+	 *
+	 * @param offsets the start offsets of the ranges, the most
+	 * important one first
+	 */
+	void Schedule(const char *uri, const offset_type *offsets,
+		      unsigned n);
+
+private:
+	/**
+	 * Load one range.  The caller holds the #mutex.
+	 */
+	void Fetch(const Job &job, void *buffer, size_t buffer_size);
+
+	void Run();
+	static void Run(void *ctx);
+};
+
+/**
+ * The global #InputPrefetcher instance; nullptr if prefetching is
+ * disabled.
+ */
+extern InputPrefetcher *input_prefetcher;
+
+/**
+ * Configure and start the #InputPrefetcher.  Prefetching is only
+ * enabled if the #InputCache is.
+ */
+bool
+input_prefetcher_global_init(Error &error);
+
+void
+input_prefetcher_global_finish();
+
+#endif
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "InputStream.hxx"
 #include "thread/Cond.hxx"
+#include "system/Trace.hxx"
 #include "util/StringUtil.hxx"
 
 #include <assert.h>
@@ -119,6 +120,32 @@ InputStream::IsAvailable()
 	return true;
 }
 
+bool
+InputStream::SupportsPeek() const
+{
+	return false;
+}
+
+ConstBuffer<void>
+InputStream::Peek(gcc_unused Error &error)
+{
+	assert(false);
+	return nullptr;
+}
+
+void
+InputStream::Consume(gcc_unused size_t nbytes)
+{
+	assert(false);
+}
+
+bool
+InputStream::GetBufferLevel(gcc_unused size_t &used,
+			    gcc_unused size_t &limit)
+{
+	return false;
+}
+
 size_t
 InputStream::LockRead(void *ptr, size_t _size, Error &error)
 {
@@ -128,8 +155,12 @@ InputStream::LockRead(void *ptr, size_t _size, Error &error)
 #endif
 	assert(_size > 0);
 
+	ScopeTrace trace("InputStream::LockRead");
+
 	const ScopeLock protect(mutex);
-	return Read(ptr, _size, error);
+	const size_t nbytes = Read(ptr, _size, error);
+	trace.SetArgument(nbytes);
+	return nbytes;
 }
 
 bool
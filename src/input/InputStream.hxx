@@ -23,6 +23,7 @@
 #include "check.h"
 #include "Offset.hxx"
 #include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
 #include "Compiler.h"
 
 #include <string>
@@ -363,6 +364,51 @@ public:
 	 */
 	gcc_nonnull_all
 	size_t LockRead(void *ptr, size_t size, Error &error);
+
+	/**
+	 * Does this stream implement Peek() and Consume()?
+	 */
+	gcc_pure
+	virtual bool SupportsPeek() const;
+
+	/**
+	 * Returns the data at the current offset inside the stream's
+	 * own buffer, without copying it.  Like Read(), this waits
+	 * until data is available.  Returns an empty buffer on error
+	 * or eof (check with IsEOF()).
+	 *
+	 * The data remains valid, even after the mutex has been
+	 * released, until Consume(), Read() or Seek() is called.
+	 * The offset is not changed until Consume() is called.
+	 *
+	 * Only available if SupportsPeek() returns true.  The caller
+	 * must lock the mutex.
+	 */
+	virtual ConstBuffer<void> Peek(Error &error);
+
+	/**
+	 * Mark data returned by Peek() as consumed, and advance the
+	 * offset.
+	 *
+	 * The caller must lock the mutex.
+	 *
+	 * @param nbytes the number of bytes; must not be larger than
+	 * the buffer returned by Peek()
+	 */
+	virtual void Consume(size_t nbytes);
+
+	/**
+	 * Determine the fill level of the stream's read-ahead
+	 * buffer.
+	 *
+	 * The caller must lock the mutex.
+	 *
+	 * @param used the number of bytes currently buffered
+	 * @param limit the number of bytes at which the stream stops
+	 * reading ahead
+	 * @return false if this stream has no read-ahead buffer
+	 */
+	virtual bool GetBufferLevel(size_t &used, size_t &limit);
 };
 
 #endif
@@ -22,6 +22,8 @@
 #include "Registry.hxx"
 #include "InputPlugin.hxx"
 #include "LocalOpen.hxx"
+#include "InputCache.hxx"
+#include "CacheInputStream.hxx"
 #include "Domain.hxx"
 #include "plugins/RewindInputPlugin.hxx"
 #include "fs/Traits.hxx"
@@ -29,21 +31,11 @@
 #include "fs/AllocatedPath.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
+#include "Log.hxx"
 
-InputStream *
-InputStream::Open(const char *url,
-		  Mutex &mutex, Cond &cond,
-		  Error &error)
+static InputStream *
+OpenRemote(const char *url, Mutex &mutex, Cond &cond, Error &error)
 {
-	if (PathTraitsUTF8::IsAbsolute(url)) {
-		const auto path = AllocatedPath::FromUTF8(url, error);
-		if (path.IsNull())
-			return nullptr;
-
-		return OpenLocalInputStream(path,
-					    mutex, cond, error);
-	}
-
 	input_plugins_for_each_enabled(plugin) {
 		InputStream *is;
 
@@ -60,6 +52,57 @@ InputStream::Open(const char *url,
 	return nullptr;
 }
 
+#ifndef WIN32
+
+static InputStream *
+OpenCached(InputCache &cache, const char *url, Mutex &mutex, Cond &cond,
+	   Error &error)
+{
+	Error cache_error;
+	InputCacheEntry *entry = cache.Acquire(url, cache_error);
+	if (entry == nullptr) {
+		/* the cache is broken, but playback can go on
+		   without it */
+		LogError(cache_error);
+		return OpenRemote(url, mutex, cond, error);
+	}
+
+	InputStream *is = nullptr;
+	if (!cache.IsComplete(*entry)) {
+		is = OpenRemote(url, mutex, cond, error);
+		if (is == nullptr) {
+			cache.Release(*entry);
+			return nullptr;
+		}
+	}
+
+	return new CacheInputStream(cache, *entry, is, url, mutex, cond);
+}
+
+#endif
+
+InputStream *
+InputStream::Open(const char *url,
+		  Mutex &mutex, Cond &cond,
+		  Error &error)
+{
+	if (PathTraitsUTF8::IsAbsolute(url)) {
+		const auto path = AllocatedPath::FromUTF8(url, error);
+		if (path.IsNull())
+			return nullptr;
+
+		return OpenLocalInputStream(path,
+					    mutex, cond, error);
+	}
+
+#ifndef WIN32
+	if (input_cache != nullptr && input_cache->IsEnabledFor(url))
+		return OpenCached(*input_cache, url, mutex, cond, error);
+#endif
+
+	return OpenRemote(url, mutex, cond, error);
+}
+
 InputStream *
 InputStream::OpenReady(const char *uri,
 		       Mutex &mutex, Cond &cond,
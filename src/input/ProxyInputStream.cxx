@@ -98,3 +98,9 @@ ProxyInputStream::Read(void *ptr, size_t read_size, Error &error)
 	CopyAttributes();
 	return nbytes;
 }
+
+bool
+ProxyInputStream::GetBufferLevel(size_t &used, size_t &limit)
+{
+	return input.GetBufferLevel(used, limit);
+}
@@ -50,6 +50,7 @@ public:
 	Tag *ReadTag() override;
 	bool IsAvailable() override;
 	size_t Read(void *ptr, size_t read_size, Error &error) override;
+	bool GetBufferLevel(size_t &used, size_t &limit) override;
 
 protected:
 	/**
@@ -20,13 +20,20 @@
 #ifndef MPD_TEXT_INPUT_STREAM_HXX
 #define MPD_TEXT_INPUT_STREAM_HXX
 
-#include "util/StaticFifoBuffer.hxx"
+#include "util/DynamicFifoBuffer.hxx"
 
 class InputStream;
 
 class TextInputStream {
 	InputStream &is;
-	StaticFifoBuffer<char, 4096> buffer;
+
+	/**
+	 * Large enough for long lines, and to read large playlists
+	 * with few InputStream::LockRead() calls.  Allocated on the
+	 * heap, because some callers have a #TextInputStream on the
+	 * stack.
+	 */
+	DynamicFifoBuffer<char> buffer;
 
 public:
 	/**
@@ -36,7 +43,7 @@ public:
 	 * @param _is an open #InputStream object
 	 */
 	explicit TextInputStream(InputStream &_is)
-		:is(_is) {}
+		:is(_is), buffer(32768) {}
 
 	TextInputStream(const TextInputStream &) = delete;
 	TextInputStream& operator=(const TextInputStream &) = delete;
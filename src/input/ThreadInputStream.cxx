@@ -20,9 +20,11 @@
 #include "config.h"
 #include "ThreadInputStream.hxx"
 #include "thread/Name.hxx"
-#include "util/CircularBuffer.hxx"
+#include "util/LockFreeCircularBuffer.hxx"
 #include "util/HugeAllocator.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 
@@ -38,8 +40,7 @@ ThreadInputStream::~ThreadInputStream()
 	thread.Join();
 
 	if (buffer != nullptr) {
-		buffer->Clear();
-		HugeFree(buffer->Write().data, buffer_size);
+		HugeFree(buffer->GetData(), buffer_size);
 		delete buffer;
 	}
 }
@@ -55,7 +56,8 @@ ThreadInputStream::Start(Error &error)
 		return nullptr;
 	}
 
-	buffer = new CircularBuffer<uint8_t>((uint8_t *)p, buffer_size);
+	buffer = new LockFreeCircularBuffer<uint8_t>((uint8_t *)p,
+						     buffer_size);
 
 	if (!thread.Start(ThreadFunc, this, error))
 		return nullptr;
@@ -77,34 +79,47 @@ ThreadInputStream::ThreadFunc()
 
 	/* we're ready, tell it to our client */
 	SetReady();
+	Unlock();
+
+	const size_t min_space = std::max(wake_threshold, size_t(1));
 
 	while (!close) {
 		assert(!postponed_error.IsDefined());
 
 		auto w = buffer->Write();
 		if (w.IsEmpty()) {
-			wake_cond.wait(mutex);
-		} else {
-			Unlock();
-
-			Error error;
-			size_t nbytes = ThreadRead(w.data, w.size, error);
+			/* the buffer is full: sleep until the client
+			   has consumed a good part of it */
+			const ScopeLock protect(mutex);
+			thread_waiting = true;
+			while (!close && buffer->GetSpace() < min_space)
+				wake_cond.wait(mutex);
+			thread_waiting = false;
+			continue;
+		}
 
-			Lock();
+		Error error;
+		size_t nbytes = ThreadRead(w.data, w.size, error);
+		if (nbytes == 0) {
+			const ScopeLock protect(mutex);
+			eof = true;
+			postponed_error = std::move(error);
 			cond.broadcast();
+			break;
+		}
 
-			if (nbytes == 0) {
-				eof = true;
-				postponed_error = std::move(error);
-				break;
-			}
+		buffer->Append(nbytes);
 
-			buffer->Append(nbytes);
+		/* pairs with the fence in CheckData(): either the
+		   client sees the new data, or we see its flag */
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (client_waiting.load(std::memory_order_relaxed) &&
+		    client_waiting.exchange(false)) {
+			const ScopeLock protect(mutex);
+			cond.broadcast();
 		}
 	}
 
-	Unlock();
-
 	Close();
 }
 
@@ -115,6 +130,29 @@ ThreadInputStream::ThreadFunc(void *ctx)
 	tis.ThreadFunc();
 }
 
+bool
+ThreadInputStream::CheckData()
+{
+	if (!buffer->IsEmpty())
+		return true;
+
+	client_waiting.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	/* check again: the thread may have appended data before it
+	   could see the flag */
+	return !buffer->IsEmpty();
+}
+
+inline void
+ThreadInputStream::Consumed(size_t nbytes)
+{
+	offset += nbytes;
+
+	if (thread_waiting && buffer->GetSpace() >= wake_threshold)
+		wake_cond.signal();
+}
+
 bool
 ThreadInputStream::Check(Error &error)
 {
@@ -133,7 +171,7 @@ ThreadInputStream::IsAvailable()
 {
 	assert(!thread.IsInside());
 
-	return !buffer->IsEmpty() || eof || postponed_error.IsDefined();
+	return eof || postponed_error.IsDefined() || CheckData();
 }
 
 inline size_t
@@ -152,18 +190,60 @@ ThreadInputStream::Read(void *ptr, size_t read_size, Error &error)
 			size_t nbytes = std::min(read_size, r.size);
 			memcpy(ptr, r.data, nbytes);
 			buffer->Consume(nbytes);
-			wake_cond.broadcast();
-			offset += nbytes;
+			Consumed(nbytes);
 			return nbytes;
 		}
 
 		if (eof)
 			return 0;
 
-		cond.wait(mutex);
+		if (!CheckData())
+			cond.wait(mutex);
+	}
+}
+
+bool
+ThreadInputStream::SupportsPeek() const
+{
+	return true;
+}
+
+ConstBuffer<void>
+ThreadInputStream::Peek(Error &error)
+{
+	assert(!thread.IsInside());
+
+	while (true) {
+		if (postponed_error.IsDefined()) {
+			error = std::move(postponed_error);
+			return nullptr;
+		}
+
+		/* the thread only writes to the free part of the
+		   buffer, so this range stays valid until it is
+		   consumed */
+		auto r = buffer->Read();
+		if (!r.IsEmpty())
+			return { r.data, r.size };
+
+		if (eof)
+			return nullptr;
+
+		if (!CheckData())
+			cond.wait(mutex);
 	}
 }
 
+void
+ThreadInputStream::Consume(size_t nbytes)
+{
+	assert(!thread.IsInside());
+	assert(nbytes <= buffer->GetSize());
+
+	buffer->Consume(nbytes);
+	Consumed(nbytes);
+}
+
 bool
 ThreadInputStream::IsEOF()
 {
@@ -26,9 +26,11 @@
 #include "thread/Cond.hxx"
 #include "util/Error.hxx"
 
+#include <atomic>
+
 #include <stdint.h>
 
-template<typename T> class CircularBuffer;
+template<typename T> class LockFreeCircularBuffer;
 
 /**
  * Helper class for moving InputStream implementations with blocking
@@ -38,6 +40,12 @@ template<typename T> class CircularBuffer;
  * manages the thread and the buffer.
  *
  * This works only for "streams": unknown length, no seeking, no tags.
+ *
+ * The buffer itself is lock-free.  The thread takes the mutex only
+ * to sleep while the buffer is full, and to wake up the client when
+ * the client has announced that it is going to wait (see
+ * #client_waiting).  The client wakes up the thread only after
+ * #wake_threshold bytes have become free.
  */
 class ThreadInputStream : public InputStream {
 	const char *const plugin;
@@ -45,21 +53,41 @@ class ThreadInputStream : public InputStream {
 	Thread thread;
 
 	/**
-	 * Signalled when the thread shall be woken up: when data from
-	 * the buffer has been consumed and when the stream shall be
-	 * closed.
+	 * Signalled when the thread shall be woken up: when enough
+	 * data from the buffer has been consumed and when the stream
+	 * shall be closed.
 	 */
 	Cond wake_cond;
 
 	Error postponed_error;
 
 	const size_t buffer_size;
-	CircularBuffer<uint8_t> *buffer;
+
+	/**
+	 * The thread waits for this much free space in the buffer
+	 * before it reads again, so it fills it in large batches.
+	 */
+	const size_t wake_threshold;
+
+	LockFreeCircularBuffer<uint8_t> *buffer;
 
 	/**
 	 * Shall the stream be closed?
 	 */
-	bool close;
+	std::atomic_bool close;
+
+	/**
+	 * Is the thread waiting on #wake_cond for free space?
+	 * Protected by the mutex.
+	 */
+	bool thread_waiting;
+
+	/**
+	 * Set by the client when it found the buffer empty, and is
+	 * probably going to wait on InputStream::cond; the thread
+	 * clears it and signals after it has appended data.
+	 */
+	std::atomic_bool client_waiting;
 
 	/**
 	 * Has the end of the stream been seen by the thread?
@@ -73,8 +101,10 @@ public:
 		:InputStream(_uri, _mutex, _cond),
 		 plugin(_plugin),
 		 buffer_size(_buffer_size),
+		 wake_threshold(_buffer_size / 4),
 		 buffer(nullptr),
-		 close(false), eof(false) {}
+		 close(false), thread_waiting(false),
+		 client_waiting(false), eof(false) {}
 
 	virtual ~ThreadInputStream();
 
@@ -90,6 +120,9 @@ public:
 	bool IsEOF() override final;
 	bool IsAvailable() override final;
 	size_t Read(void *ptr, size_t size, Error &error) override final;
+	bool SupportsPeek() const override final;
+	ConstBuffer<void> Peek(Error &error) override final;
+	void Consume(size_t nbytes) override final;
 
 protected:
 	void SetMimeType(const char *_mime) {
@@ -137,6 +170,24 @@ protected:
 	virtual void Cancel() {}
 
 private:
+	/**
+	 * Checks whether the buffer contains data.  If not, set
+	 * #client_waiting, so the thread signals InputStream::cond
+	 * after it has appended data.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	bool CheckData();
+
+	/**
+	 * Called by the client after it has consumed data.  Wakes up
+	 * the thread if it waits for free space, and enough is free
+	 * now.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void Consumed(size_t nbytes);
+
 	void ThreadFunc();
 	static void ThreadFunc(void *ctx);
 };
@@ -23,6 +23,7 @@
 #include "archive/ArchiveLookup.hxx"
 #include "archive/ArchiveList.hxx"
 #include "archive/ArchivePlugin.hxx"
+#include "archive/ArchiveCache.hxx"
 #include "archive/ArchiveFile.hxx"
 #include "../InputPlugin.hxx"
 #include "fs/Traits.hxx"
@@ -57,7 +58,7 @@ OpenArchiveInputStream(Path path, Mutex &mutex, Cond &cond, Error &error)
 		return nullptr;
 	}
 
-	auto file = archive_file_open(arplug, Path::FromFS(archive), error);
+	auto file = archive_cache_open(*arplug, Path::FromFS(archive), error);
 	if (file == nullptr) {
 		free(pname);
 		return nullptr;
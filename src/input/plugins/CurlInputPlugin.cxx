@@ -28,8 +28,13 @@
 #include "tag/TagBuilder.hxx"
 #include "event/SocketMonitor.hxx"
 #include "event/TimeoutMonitor.hxx"
+#include "event/IdleMonitor.hxx"
+#include "event/Thread.hxx"
 #include "event/Call.hxx"
+#include "event/AsyncResolver.hxx"
+#include "net/Resolver.hxx"
 #include "IOThread.hxx"
+#include "thread/Mutex.hxx"
 #include "util/ASCII.hxx"
 #include "util/StringUtil.hxx"
 #include "util/NumberParser.hxx"
@@ -39,9 +44,20 @@
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <string>
+#include <vector>
+#include <forward_list>
+#include <atomic>
+
 #include <assert.h>
 #include <string.h>
 
+#ifdef WIN32
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#endif
+
 #include <curl/curl.h>
 
 #if LIBCURL_VERSION_NUM < 0x071200
@@ -49,39 +65,48 @@
 #endif
 
 /**
- * Do not buffer more than this number of bytes.  It should be a
- * reasonable limit that doesn't make low-end machines suffer too
- * much, but doesn't cause stuttering on high-latency lines.
+ * The read-ahead buffer settings.  The default buffer size should be
+ * a reasonable limit that doesn't make low-end machines suffer too
+ * much, but doesn't cause stuttering on high-latency lines; the
+ * stream is resumed at 384 kB after it has been paused.
  */
-static const size_t CURL_MAX_BUFFERED = 512 * 1024;
+static AsyncInputStreamConfig curl_buffer_config(512 * 1024,
+						 384 * 1024);
 
-/**
- * Resume the stream at this number of bytes after it has been paused.
- */
-static const size_t CURL_RESUME_AT = 384 * 1024;
+class CurlMulti;
+
+struct CurlInputStream final : public AsyncInputStream, ResolverHandler {
+	/**
+	 * The #CurlMulti which runs this stream's transfers; its
+	 * #EventLoop is the "I/O thread" of this stream.
+	 */
+	CurlMulti &multi;
 
-struct CurlInputStream final : public AsyncInputStream {
 	/* some buffers which were passed to libcurl, which we have
 	   too free */
 	char range[32];
 	struct curl_slist *request_headers;
+	struct curl_slist *connect_to;
 
 	/** the curl handles */
 	CURL *easy;
 
+	/**
+	 * Resolves the server name before the request is started, if
+	 * libcurl would resolve it synchronously.  Runs in the I/O
+	 * thread.
+	 */
+	ResolveRequest resolve;
+
 	/** error message provided by libcurl */
 	char error_buffer[CURL_ERROR_SIZE];
 
 	/** parser for icy-metadata */
 	IcyInputStream *icy;
 
-	CurlInputStream(const char *_url, Mutex &_mutex, Cond &_cond,
-			void *_buffer)
-		:AsyncInputStream(_url, _mutex, _cond,
-				  _buffer, CURL_MAX_BUFFERED,
-				  CURL_RESUME_AT),
-		 request_headers(nullptr),
-		 icy(new IcyInputStream(this)) {}
+	CurlInputStream(CurlMulti &_multi,
+			const char *_url, Mutex &_mutex, Cond &_cond,
+			void *_buffer);
 
 	~CurlInputStream();
 
@@ -93,6 +118,22 @@ struct CurlInputStream final : public AsyncInputStream {
 
 	bool InitEasy(Error &error);
 
+	/**
+	 * Start resolving the server name with the #AsyncResolver,
+	 * unless the result is cached already.
+	 *
+	 * @return true if the lookup has been started; the request
+	 * will be started by OnResolverSuccess()
+	 */
+	bool StartResolve();
+
+	/**
+	 * Fail the stream before a request has been started.
+	 *
+	 * Runs in the I/O thread.
+	 */
+	void Abort(Error &&error);
+
 	/**
 	 * Frees the current "libcurl easy" handle, and everything
 	 * associated with it.
@@ -130,9 +171,11 @@ struct CurlInputStream final : public AsyncInputStream {
 	/* virtual methods from AsyncInputStream */
 	virtual void DoResume() override;
 	virtual void DoSeek(offset_type new_offset) override;
-};
 
-class CurlMulti;
+	/* virtual methods from ResolverHandler */
+	void OnResolverSuccess(const ResolverResult &addresses) override;
+	void OnResolverError(const Error &error) override;
+};
 
 /**
  * Monitor for one socket created by CURL.
@@ -192,11 +235,24 @@ private:
 };
 
 /**
- * Manager for the global CURLM object.
+ * Manager for one CURLM object and its #EventLoop.
  */
-class CurlMulti final : private TimeoutMonitor {
+class CurlMulti final : private TimeoutMonitor, IdleMonitor {
 	CURLM *const multi;
 
+	/**
+	 * The number of #CurlInputStream instances assigned to this
+	 * object; used to balance new streams among the I/O threads.
+	 */
+	std::atomic_uint n_streams;
+
+	/**
+	 * Sockets which have become ready during the current
+	 * #EventLoop iteration, and their CURL_CSELECT_* flags.  They
+	 * are passed to libcurl by OnIdle().
+	 */
+	std::vector<std::pair<curl_socket_t, int>> ready_sockets;
+
 public:
 	CurlMulti(EventLoop &_loop, CURLM *_multi);
 
@@ -204,6 +260,23 @@ public:
 		curl_multi_cleanup(multi);
 	}
 
+	CurlMulti(const CurlMulti &) = delete;
+	CurlMulti &operator=(const CurlMulti &) = delete;
+
+	using TimeoutMonitor::GetEventLoop;
+
+	unsigned GetStreamCount() const {
+		return n_streams.load(std::memory_order_relaxed);
+	}
+
+	void IncrementStreams() {
+		n_streams.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void DecrementStreams() {
+		n_streams.fetch_sub(1, std::memory_order_relaxed);
+	}
+
 	bool Add(CurlInputStream *c, Error &error);
 	void Remove(CurlInputStream *c);
 
@@ -220,6 +293,17 @@ public:
 
 	void SocketAction(curl_socket_t fd, int ev_bitmask);
 
+	/**
+	 * Like SocketAction(), but postpone the call until all events
+	 * of this #EventLoop iteration have been dispatched, and then
+	 * check for finished responses only once.
+	 */
+	void ScheduleSocketAction(curl_socket_t fd, int ev_bitmask) {
+		ready_sockets.emplace_back(fd, ev_bitmask);
+		if (!IdleMonitor::IsActive())
+			IdleMonitor::Schedule();
+	}
+
 	void InvalidateSockets() {
 		SocketAction(CURL_SOCKET_TIMEOUT, 0);
 	}
@@ -235,9 +319,16 @@ public:
 	}
 
 private:
+	/**
+	 * Call curl_multi_socket_action() without checking for
+	 * finished responses.
+	 */
+	void RunSocketAction(curl_socket_t fd, int ev_bitmask);
+
 	static int TimerFunction(CURLM *multi, long timeout_ms, void *userp);
 
 	virtual void OnTimeout() override;
+	virtual void OnIdle() override;
 };
 
 /**
@@ -254,14 +345,57 @@ static unsigned proxy_port;
 
 static bool verify_peer, verify_host;
 
-static CurlMulti *curl_multi;
+/**
+ * Does libcurl resolve host names asynchronously?  If not, they are
+ * resolved with the #AsyncResolver before the request is started.
+ */
+static bool curl_async_dns;
+
+/**
+ * Use HTTP/2 (and multiplex all streams to the same server over one
+ * connection) if libcurl supports it?
+ */
+static bool http2;
+
+/**
+ * Additional I/O threads for curl transfers, see the "threads"
+ * setting.
+ */
+static std::forward_list<EventThread> curl_threads;
+
+/**
+ * One #CurlMulti per I/O thread; the first one runs in the main
+ * I/O thread.  A new stream is assigned to the one with the fewest
+ * streams.
+ */
+static std::forward_list<CurlMulti> curl_multis;
+
+/**
+ * The upper limit for the "threads" setting.
+ */
+static constexpr unsigned MAX_THREADS = 64;
+
+/**
+ * Shares the DNS cache and TLS sessions among all easy handles, so a
+ * new request (e.g. after seeking, or the next song from the same
+ * server) skips the name lookup and the full TLS handshake.  The
+ * connection cache itself is owned by the #CurlMulti object.
+ */
+static CURLSH *curl_share;
+
+/**
+ * Protects the data in #curl_share.  Easy handles are configured
+ * outside of the I/O thread, therefore libcurl needs locking.
+ */
+static Mutex curl_share_mutex[CURL_LOCK_DATA_LAST];
 
 static constexpr Domain http_domain("http");
 static constexpr Domain curl_domain("curl");
 static constexpr Domain curlm_domain("curlm");
 
 CurlMulti::CurlMulti(EventLoop &_loop, CURLM *_multi)
-	:TimeoutMonitor(_loop), multi(_multi)
+	:TimeoutMonitor(_loop), IdleMonitor(_loop),
+	 multi(_multi), n_streams(0)
 {
 	curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION,
 			  CurlSocket::SocketFunction);
@@ -269,6 +403,51 @@ CurlMulti::CurlMulti(EventLoop &_loop, CURLM *_multi)
 
 	curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, TimerFunction);
 	curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
+
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	/* with HTTP/2, requests to the same server share one
+	   connection instead of opening a new one each */
+	if (http2)
+		curl_multi_setopt(multi, CURLMOPT_PIPELINING,
+				  (long)CURLPIPE_MULTIPLEX);
+#endif
+}
+
+static void
+input_curl_share_lock(gcc_unused CURL *easy, curl_lock_data data,
+		      gcc_unused curl_lock_access access,
+		      gcc_unused void *userptr)
+{
+	curl_share_mutex[data].lock();
+}
+
+static void
+input_curl_share_unlock(gcc_unused CURL *easy, curl_lock_data data,
+			gcc_unused void *userptr)
+{
+	curl_share_mutex[data].unlock();
+}
+
+/**
+ * Create the #curl_share object.  Failure is not fatal; every easy
+ * handle will then have its own caches.
+ */
+static void
+input_curl_share_init()
+{
+	curl_share = curl_share_init();
+	if (curl_share == nullptr)
+		return;
+
+	curl_share_setopt(curl_share, CURLSHOPT_LOCKFUNC,
+			  input_curl_share_lock);
+	curl_share_setopt(curl_share, CURLSHOPT_UNLOCKFUNC,
+			  input_curl_share_unlock);
+	curl_share_setopt(curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+#if LIBCURL_VERSION_NUM >= 0x071700
+	curl_share_setopt(curl_share, CURLSHOPT_SHARE,
+			  CURL_LOCK_DATA_SSL_SESSION);
+#endif
 }
 
 /**
@@ -280,8 +459,6 @@ gcc_pure
 static CurlInputStream *
 input_curl_find_request(CURL *easy)
 {
-	assert(io_thread_inside());
-
 	void *p;
 	CURLcode code = curl_easy_getinfo(easy, CURLINFO_PRIVATE, &p);
 	if (code != CURLE_OK)
@@ -293,7 +470,7 @@ input_curl_find_request(CURL *easy)
 void
 CurlInputStream::DoResume()
 {
-	assert(io_thread_inside());
+	assert(GetEventLoop().IsInside());
 
 	mutex.unlock();
 
@@ -303,9 +480,9 @@ CurlInputStream::DoResume()
 		/* libcurl older than 7.32.0 does not update
 		   its sockets after curl_easy_pause(); force
 		   libcurl to do it now */
-		curl_multi->ResumeSockets();
+		multi.ResumeSockets();
 
-	curl_multi->InvalidateSockets();
+	multi.InvalidateSockets();
 
 	mutex.lock();
 }
@@ -317,7 +494,7 @@ CurlSocket::SocketFunction(gcc_unused CURL *easy,
 	CurlMulti &multi = *(CurlMulti *)userp;
 	CurlSocket *cs = (CurlSocket *)socketp;
 
-	assert(io_thread_inside());
+	assert(multi.GetEventLoop().IsInside());
 
 	if (action == CURL_POLL_REMOVE) {
 		delete cs;
@@ -325,7 +502,7 @@ CurlSocket::SocketFunction(gcc_unused CURL *easy,
 	}
 
 	if (cs == nullptr) {
-		cs = new CurlSocket(multi, io_thread_get(), s);
+		cs = new CurlSocket(multi, multi.GetEventLoop(), s);
 		multi.Assign(s, *cs);
 	} else {
 #ifdef USE_EPOLL
@@ -350,9 +527,9 @@ CurlSocket::SocketFunction(gcc_unused CURL *easy,
 bool
 CurlSocket::OnSocketReady(unsigned flags)
 {
-	assert(io_thread_inside());
+	assert(multi.GetEventLoop().IsInside());
 
-	multi.SocketAction(Get(), FlagsToCurlCSelect(flags));
+	multi.ScheduleSocketAction(Get(), FlagsToCurlCSelect(flags));
 	return true;
 }
 
@@ -362,7 +539,7 @@ CurlSocket::OnSocketReady(unsigned flags)
 inline bool
 CurlMulti::Add(CurlInputStream *c, Error &error)
 {
-	assert(io_thread_inside());
+	assert(GetEventLoop().IsInside());
 	assert(c != nullptr);
 	assert(c->easy != nullptr);
 
@@ -389,8 +566,8 @@ input_curl_easy_add_indirect(CurlInputStream *c, Error &error)
 	assert(c->easy != nullptr);
 
 	bool result;
-	BlockingCall(io_thread_get(), [c, &error, &result](){
-			result = curl_multi->Add(c, error);
+	BlockingCall(c->multi.GetEventLoop(), [c, &error, &result](){
+			result = c->multi.Add(c, error);
 		});
 	return result;
 }
@@ -404,26 +581,30 @@ CurlMulti::Remove(CurlInputStream *c)
 void
 CurlInputStream::FreeEasy()
 {
-	assert(io_thread_inside());
+	assert(GetEventLoop().IsInside());
 
 	if (easy == nullptr)
 		return;
 
-	curl_multi->Remove(this);
+	multi.Remove(this);
 
 	curl_easy_cleanup(easy);
 	easy = nullptr;
 
 	curl_slist_free_all(request_headers);
 	request_headers = nullptr;
+
+	curl_slist_free_all(connect_to);
+	connect_to = nullptr;
 }
 
 void
 CurlInputStream::FreeEasyIndirect()
 {
-	BlockingCall(io_thread_get(), [this](){
+	BlockingCall(GetEventLoop(), [this](){
+			resolve.Cancel();
 			FreeEasy();
-			curl_multi->InvalidateSockets();
+			multi.InvalidateSockets();
 		});
 
 	assert(easy == nullptr);
@@ -432,7 +613,7 @@ CurlInputStream::FreeEasyIndirect()
 inline void
 CurlInputStream::RequestDone(CURLcode result, long status)
 {
-	assert(io_thread_inside());
+	assert(GetEventLoop().IsInside());
 	assert(!postponed_error.IsDefined());
 
 	FreeEasy();
@@ -467,8 +648,8 @@ input_curl_handle_done(CURL *easy_handle, CURLcode result)
 	c->RequestDone(result, status);
 }
 
-void
-CurlMulti::SocketAction(curl_socket_t fd, int ev_bitmask)
+inline void
+CurlMulti::RunSocketAction(curl_socket_t fd, int ev_bitmask)
 {
 	int running_handles;
 	CURLMcode mcode = curl_multi_socket_action(multi, fd, ev_bitmask,
@@ -477,7 +658,12 @@ CurlMulti::SocketAction(curl_socket_t fd, int ev_bitmask)
 		FormatError(curlm_domain,
 			    "curl_multi_socket_action() failed: %s",
 			    curl_multi_strerror(mcode));
+}
 
+void
+CurlMulti::SocketAction(curl_socket_t fd, int ev_bitmask)
+{
+	RunSocketAction(fd, ev_bitmask);
 	ReadInfo();
 }
 
@@ -489,7 +675,7 @@ CurlMulti::SocketAction(curl_socket_t fd, int ev_bitmask)
 inline void
 CurlMulti::ReadInfo()
 {
-	assert(io_thread_inside());
+	assert(GetEventLoop().IsInside());
 
 	CURLMsg *msg;
 	int msgs_in_queue;
@@ -508,7 +694,7 @@ CurlMulti::TimerFunction(gcc_unused CURLM *_multi, long timeout_ms, void *userp)
 	assert(_multi == multi.multi);
 
 	if (timeout_ms < 0) {
-		multi.Cancel();
+		multi.TimeoutMonitor::Cancel();
 		return 0;
 	}
 
@@ -519,7 +705,7 @@ CurlMulti::TimerFunction(gcc_unused CURLM *_multi, long timeout_ms, void *userp)
 		   of 10ms. */
 		timeout_ms = 10;
 
-	multi.Schedule(timeout_ms);
+	multi.TimeoutMonitor::Schedule(timeout_ms);
 	return 0;
 }
 
@@ -529,6 +715,36 @@ CurlMulti::OnTimeout()
 	SocketAction(CURL_SOCKET_TIMEOUT, 0);
 }
 
+void
+CurlMulti::OnIdle()
+{
+	/* libcurl may remove a socket while another one is being
+	   handled; that is harmless, because it ignores actions on
+	   unknown sockets */
+	for (const auto &i : ready_sockets)
+		RunSocketAction(i.first, i.second);
+	ready_sockets.clear();
+
+	ReadInfo();
+}
+
+/**
+ * Choose the #CurlMulti for a new stream.
+ */
+static CurlMulti &
+input_curl_select_multi()
+{
+	assert(!curl_multis.empty());
+
+	CurlMulti *best = nullptr;
+	for (auto &m : curl_multis)
+		if (best == nullptr ||
+		    m.GetStreamCount() < best->GetStreamCount())
+			best = &m;
+
+	return *best;
+}
+
 /*
  * InputPlugin methods
  *
@@ -553,8 +769,19 @@ input_curl_init(const ConfigBlock &block, Error &error)
 				    version_info->ssl_version);
 
 		curl_version_num = version_info->version_num;
+		curl_async_dns = (version_info->features &
+				  CURL_VERSION_ASYNCHDNS) != 0;
 	}
 
+	http2 = block.GetBlockValue("http2", true);
+#ifdef CURL_VERSION_HTTP2
+	if (version_info == nullptr ||
+	    (version_info->features & CURL_VERSION_HTTP2) == 0)
+		http2 = false;
+#else
+	http2 = false;
+#endif
+
 	http_200_aliases = curl_slist_append(http_200_aliases, "ICY 200 OK");
 
 	proxy = block.GetBlockValue("proxy");
@@ -574,24 +801,72 @@ input_curl_init(const ConfigBlock &block, Error &error)
 	verify_peer = block.GetBlockValue("verify_peer", true);
 	verify_host = block.GetBlockValue("verify_host", true);
 
-	CURLM *multi = curl_multi_init();
-	if (multi == nullptr) {
+	const unsigned n_threads = block.GetBlockValue("threads", 1u);
+	if (n_threads < 1 || n_threads > MAX_THREADS) {
+		error.Format(curl_domain, 0,
+			     "Invalid number of threads: %u", n_threads);
 		curl_slist_free_all(http_200_aliases);
 		curl_global_cleanup();
-		error.Set(curl_domain, 0, "curl_multi_init() failed");
-		return InputPlugin::InitResult::UNAVAILABLE;
+		return InputPlugin::InitResult::ERROR;
+	}
+
+	if (!curl_buffer_config.Load(block, error)) {
+		curl_slist_free_all(http_200_aliases);
+		curl_global_cleanup();
+		return InputPlugin::InitResult::ERROR;
+	}
+
+	/* create one CurlMulti per thread; the first one runs in the
+	   IOThread */
+
+	for (unsigned i = 0; i < n_threads; ++i) {
+		EventLoop *loop = &io_thread_get();
+		if (i > 0) {
+			curl_threads.emplace_front("curl");
+			if (!curl_threads.front().Start(error)) {
+				curl_multis.clear();
+				curl_threads.clear();
+				curl_slist_free_all(http_200_aliases);
+				curl_global_cleanup();
+				return InputPlugin::InitResult::ERROR;
+			}
+
+			loop = &curl_threads.front().GetEventLoop();
+		}
+
+		CURLM *multi = curl_multi_init();
+		if (multi == nullptr) {
+			curl_multis.clear();
+			curl_threads.clear();
+			curl_slist_free_all(http_200_aliases);
+			curl_global_cleanup();
+			error.Set(curl_domain, 0, "curl_multi_init() failed");
+			return InputPlugin::InitResult::UNAVAILABLE;
+		}
+
+		curl_multis.emplace_front(*loop, multi);
 	}
 
-	curl_multi = new CurlMulti(io_thread_get(), multi);
+	input_curl_share_init();
+
 	return InputPlugin::InitResult::SUCCESS;
 }
 
 static void
 input_curl_finish(void)
 {
-	BlockingCall(io_thread_get(), [](){
-			delete curl_multi;
-		});
+	/* each CurlMulti must be destroyed in its own thread */
+	while (!curl_multis.empty())
+		BlockingCall(curl_multis.front().GetEventLoop(), [](){
+				curl_multis.pop_front();
+			});
+
+	curl_threads.clear();
+
+	if (curl_share != nullptr) {
+		curl_share_cleanup(curl_share);
+		curl_share = nullptr;
+	}
 
 	curl_slist_free_all(http_200_aliases);
 	http_200_aliases = nullptr;
@@ -599,9 +874,26 @@ input_curl_finish(void)
 	curl_global_cleanup();
 }
 
+inline
+CurlInputStream::CurlInputStream(CurlMulti &_multi,
+				 const char *_url, Mutex &_mutex, Cond &_cond,
+				 void *_buffer)
+	:AsyncInputStream(_multi.GetEventLoop(), _url, _mutex, _cond,
+			  _buffer, curl_buffer_config),
+	 multi(_multi),
+	 request_headers(nullptr), connect_to(nullptr),
+	 easy(nullptr),
+	 resolve(_multi.GetEventLoop(), resolver_get(), *this),
+	 icy(new IcyInputStream(this))
+{
+	multi.IncrementStreams();
+}
+
 CurlInputStream::~CurlInputStream()
 {
 	FreeEasyIndirect();
+
+	multi.DecrementStreams();
 }
 
 inline void
@@ -641,6 +933,7 @@ CurlInputStream::HeaderReceived(const char *name, std::string &&value)
 		   StringEqualsCaseASCII(name, "ice-name") ||
 		   StringEqualsCaseASCII(name, "x-audiocast-name")) {
 		TagBuilder tag_builder;
+		tag_builder.SetTransient();
 		tag_builder.AddItem(TAG_NAME, value.c_str());
 
 		SetTag(tag_builder.CommitNew());
@@ -734,6 +1027,58 @@ input_curl_writefunction(void *ptr, size_t size, size_t nmemb, void *stream)
 	return c.DataReceived(ptr, size);
 }
 
+/**
+ * Extract the host name and the port from a "http://" or "https://"
+ * URL.
+ *
+ * @return false if the URL could not be parsed
+ */
+static bool
+ParseUrlHost(const char *url, std::string &host, unsigned &port)
+{
+	if (memcmp(url, "http://", 7) == 0) {
+		url += 7;
+		port = 80;
+	} else if (memcmp(url, "https://", 8) == 0) {
+		url += 8;
+		port = 443;
+	} else
+		return false;
+
+	const char *end = url + strcspn(url, "/?#");
+
+	/* skip the user info */
+	const char *at = (const char *)memchr(url, '@', end - url);
+	if (at != nullptr)
+		url = at + 1;
+
+	const char *colon;
+	if (*url == '[') {
+		/* IPv6 address */
+		const char *bracket = (const char *)
+			memchr(url, ']', end - url);
+		if (bracket == nullptr)
+			return false;
+
+		host.assign(url + 1, bracket);
+		colon = bracket + 1 < end && bracket[1] == ':'
+			? bracket + 1
+			: nullptr;
+	} else {
+		colon = (const char *)memchr(url, ':', end - url);
+		host.assign(url, colon != nullptr ? colon : end);
+	}
+
+	if (colon != nullptr && colon + 1 < end) {
+		char *endptr;
+		port = ParseUnsigned(colon + 1, &endptr);
+		if (endptr != end || port == 0 || port > 0xffff)
+			return false;
+	}
+
+	return !host.empty();
+}
+
 bool
 CurlInputStream::InitEasy(Error &error)
 {
@@ -762,6 +1107,24 @@ CurlInputStream::InitEasy(Error &error)
 	curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1l);
 	curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, 10l);
 
+	if (curl_share != nullptr)
+		curl_easy_setopt(easy, CURLOPT_SHARE, curl_share);
+
+#if LIBCURL_VERSION_NUM >= 0x071900
+	/* keep idle connections in the cache alive */
+	curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1l);
+#endif
+
+#if LIBCURL_VERSION_NUM >= 0x072f00
+	if (http2) {
+		curl_easy_setopt(easy, CURLOPT_HTTP_VERSION,
+				 (long)CURL_HTTP_VERSION_2TLS);
+		/* wait for an existing connection which may be
+		   multiplexed instead of opening another one */
+		curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1l);
+	}
+#endif
+
 	if (proxy != nullptr)
 		curl_easy_setopt(easy, CURLOPT_PROXY, proxy);
 
@@ -776,6 +1139,36 @@ CurlInputStream::InitEasy(Error &error)
 		curl_easy_setopt(easy, CURLOPT_PROXYUSERPWD, proxy_auth_str);
 	}
 
+#if LIBCURL_VERSION_NUM >= 0x073100
+	if (proxy == nullptr) {
+		/* connect to the address from the resolver cache
+		   instead of letting libcurl look up the name; unlike
+		   CURLOPT_RESOLVE, this does not add permanent
+		   entries to libcurl's DNS cache */
+		std::string host;
+		unsigned port;
+		ResolverResult addresses;
+		if (ParseUrlHost(GetURI(), host, port) &&
+		    resolver_get().LookupCached(host.c_str(), port,
+						0, SOCK_STREAM, addresses)) {
+			std::string address =
+				sockaddr_host_to_string(addresses.front());
+			if (address.find(':') != address.npos)
+				address = "[" + address + "]";
+
+			if (!address.empty()) {
+				const std::string entry = host + ":" +
+					std::to_string(port) + ":" +
+					address + ":" + std::to_string(port);
+				connect_to = curl_slist_append(nullptr,
+							       entry.c_str());
+				curl_easy_setopt(easy, CURLOPT_CONNECT_TO,
+						 connect_to);
+			}
+		}
+	}
+#endif
+
 	curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, verify_peer ? 1l : 0l);
 	curl_easy_setopt(easy, CURLOPT_SSL_VERIFYHOST, verify_host ? 2l : 0l);
 
@@ -795,12 +1188,68 @@ CurlInputStream::InitEasy(Error &error)
 	return true;
 }
 
+bool
+CurlInputStream::StartResolve()
+{
+	if (proxy != nullptr)
+		/* libcurl resolves only the proxy name, and this is
+		   not supported here */
+		return false;
+
+	std::string host;
+	unsigned port;
+	ResolverResult addresses;
+	if (!ParseUrlHost(GetURI(), host, port) ||
+	    resolver_get().LookupCached(host.c_str(), port, 0, SOCK_STREAM,
+					addresses))
+		return false;
+
+	resolve.Start(host.c_str(), port, 0, SOCK_STREAM);
+	return true;
+}
+
+void
+CurlInputStream::Abort(Error &&error)
+{
+	assert(GetEventLoop().IsInside());
+
+	FreeEasy();
+	AsyncInputStream::SetClosed();
+
+	const ScopeLock protect(mutex);
+	postponed_error = std::move(error);
+	SetReady();
+}
+
+void
+CurlInputStream::OnResolverSuccess(gcc_unused const ResolverResult &addresses)
+{
+	assert(GetEventLoop().IsInside());
+
+	/* InitEasy() picks up the result from the resolver cache */
+	Error error;
+	if (!InitEasy(error) || !multi.Add(this, error))
+		Abort(std::move(error));
+}
+
+void
+CurlInputStream::OnResolverError(const Error &error)
+{
+	assert(GetEventLoop().IsInside());
+
+	Error error2;
+	error2.Set(error);
+	Abort(std::move(error2));
+}
+
 void
 CurlInputStream::DoSeek(offset_type new_offset)
 {
 	assert(IsReady());
 
-	/* close the old connection and open a new one */
+	/* abort the old request and start a new one; libcurl
+	   reuses the connection if possible (always with HTTP/2,
+	   which can cancel a single stream) */
 
 	mutex.unlock();
 
@@ -844,13 +1293,20 @@ inline InputStream *
 CurlInputStream::Open(const char *url, Mutex &mutex, Cond &cond,
 		      Error &error)
 {
-	void *buffer = HugeAllocate(CURL_MAX_BUFFERED);
+	void *buffer = HugeAllocate(curl_buffer_config.buffer_size);
 	if (buffer == nullptr) {
 		error.Set(curl_domain, "Out of memory");
 		return nullptr;
 	}
 
-	CurlInputStream *c = new CurlInputStream(url, mutex, cond, buffer);
+	CurlInputStream *c = new CurlInputStream(input_curl_select_multi(),
+						 url, mutex, cond, buffer);
+
+	if (!curl_async_dns && c->StartResolve())
+		/* libcurl would block the I/O thread on a slow DNS
+		   server; the request is started when the name has
+		   been resolved */
+		return c->icy;
 
 	if (!c->InitEasy(error) || !input_curl_easy_add_indirect(c, error)) {
 		delete c;
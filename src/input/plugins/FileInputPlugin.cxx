@@ -21,22 +21,213 @@
 #include "FileInputPlugin.hxx"
 #include "../InputStream.hxx"
 #include "../InputPlugin.hxx"
+#include "config/Block.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
+#include "util/ConstBuffer.hxx"
 #include "fs/Path.hxx"
 #include "fs/FileInfo.hxx"
 #include "fs/io/FileReader.hxx"
 #include "system/FileDescriptor.hxx"
 
+#ifdef HAVE_IO_URING
+#include "system/IoUring.hxx"
+
+#include <memory>
+#include <algorithm>
+
+#include <assert.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#endif
+
+#ifndef WIN32
+#include <sys/mman.h>
+
+#include <algorithm>
+
+#include <assert.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#endif
+
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
 
 static constexpr Domain file_domain("file");
 
+/**
+ * After a seek, the kernel is asked to load this many bytes ahead of
+ * the new offset; sequential read-ahead starts over after a seek.
+ */
+static constexpr size_t WILLNEED_SIZE = 1024 * 1024;
+
+#ifndef WIN32
+/**
+ * Map local files into memory instead of reading them?  Configured
+ * with the "mmap" setting.
+ */
+static bool file_mmap;
+#endif
+
+#ifdef HAVE_IO_URING
+
+/**
+ * Reads ahead with io_uring: when the buffered data has been
+ * consumed, the next chunk is requested from the kernel right away,
+ * so disk I/O overlaps with decoding, and the decoder's small reads
+ * are served from memory without a system call.
+ */
+class FileReadAhead {
+	static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+	IoUring ring;
+
+	const int fd;
+
+	std::unique_ptr<uint8_t[]> buffer;
+
+	/**
+	 * The file offset of the beginning of #buffer.
+	 */
+	off_t buffer_offset;
+
+	/**
+	 * The number of valid bytes in #buffer.
+	 */
+	size_t buffer_size;
+
+	/**
+	 * Is an IORING_OP_READ request pending?  While it is,
+	 * #buffer is owned by the kernel.
+	 */
+	bool pending;
+
+public:
+	explicit FileReadAhead(int _fd)
+		:fd(_fd), buffer(new uint8_t[CHUNK_SIZE]),
+		 buffer_offset(0), buffer_size(0), pending(false) {}
+
+	~FileReadAhead() {
+		if (pending)
+			Wait();
+	}
+
+	/**
+	 * @return false if io_uring is not available
+	 */
+	bool Open() {
+		Error error;
+		return ring.Open(2, error);
+	}
+
+	/**
+	 * Copy data at the given offset from the buffer.
+	 *
+	 * @return the number of bytes copied; 0 if the data is not
+	 * in the buffer
+	 */
+	size_t Read(off_t offset, void *dest, size_t size);
+
+	/**
+	 * Start reading the chunk at the given offset, unless it is
+	 * already in the buffer.
+	 *
+	 * @return false on error; read ahead should not be used
+	 * anymore
+	 */
+	bool Start(off_t offset);
+
+private:
+	void Wait();
+};
+
+size_t
+FileReadAhead::Read(off_t offset, void *dest, size_t size)
+{
+	if (pending)
+		Wait();
+
+	if (offset < buffer_offset ||
+	    offset >= buffer_offset + off_t(buffer_size))
+		return 0;
+
+	const size_t position = offset - buffer_offset;
+	const size_t nbytes = std::min(size, buffer_size - position);
+	memcpy(dest, buffer.get() + position, nbytes);
+	return nbytes;
+}
+
+bool
+FileReadAhead::Start(off_t offset)
+{
+	if (!ring.IsDefined())
+		return false;
+
+	if (pending ||
+	    (offset >= buffer_offset &&
+	     offset < buffer_offset + off_t(buffer_size)))
+		return true;
+
+	io_uring_sqe *sqe = ring.GetSqe();
+	if (sqe == nullptr)
+		return false;
+
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)buffer.get();
+	sqe->len = CHUNK_SIZE;
+	sqe->off = offset;
+
+	buffer_offset = offset;
+	buffer_size = 0;
+
+	if (ring.Submit() < 0)
+		return false;
+
+	pending = true;
+	return true;
+}
+
+void
+FileReadAhead::Wait()
+{
+	assert(pending);
+
+	const io_uring_cqe *cqe;
+	while ((cqe = ring.PeekCqe()) == nullptr) {
+		if (ring.Submit(1) < 0) {
+			/* can't wait; close the ring, which cancels the
+			   request */
+			ring.Close();
+			pending = false;
+			return;
+		}
+	}
+
+	/* errors are ignored here; the synchronous read will
+	   report them */
+	buffer_size = cqe->res > 0 ? cqe->res : 0;
+	ring.SeenCqe();
+	pending = false;
+}
+
+#endif
+
 class FileInputStream final : public InputStream {
 	FileReader reader;
 
+#ifdef HAVE_IO_URING
+	/**
+	 * If this is set, the file is read with pread() at #offset
+	 * (and the file position of #reader is unused).
+	 */
+	std::unique_ptr<FileReadAhead> read_ahead;
+#endif
+
 public:
 	FileInputStream(const char *path, FileReader &&_reader, off_t _size,
 			Mutex &_mutex, Cond &_cond)
@@ -44,9 +235,51 @@ public:
 		 reader(std::move(_reader)) {
 		size = _size;
 		seekable = true;
+
+#ifdef HAVE_IO_URING
+		read_ahead.reset(new FileReadAhead(reader.GetFD().Get()));
+		if (!read_ahead->Open())
+			read_ahead.reset();
+#endif
+
+		SetReady();
+	}
+
+	/* virtual methods from InputStream */
+
+	bool IsEOF() override {
+		return GetOffset() >= GetSize();
+	}
+
+	size_t Read(void *ptr, size_t size, Error &error) override;
+	bool Seek(offset_type offset, Error &error) override;
+};
+
+#ifndef WIN32
+
+/**
+ * An #InputStream which maps the whole file into memory.  Read() is
+ * a memcpy() from the page cache, and Peek() returns a pointer into
+ * the mapping, so decoders which support it read without any system
+ * call or copy.
+ */
+class MmapFileInputStream final : public InputStream {
+	const uint8_t *const data;
+
+public:
+	MmapFileInputStream(const char *path, const void *_data, size_t _size,
+			    Mutex &_mutex, Cond &_cond)
+		:InputStream(path, _mutex, _cond),
+		 data((const uint8_t *)_data) {
+		size = _size;
+		seekable = true;
 		SetReady();
 	}
 
+	~MmapFileInputStream() {
+		munmap(const_cast<uint8_t *>(data), size);
+	}
+
 	/* virtual methods from InputStream */
 
 	bool IsEOF() override {
@@ -55,8 +288,98 @@ public:
 
 	size_t Read(void *ptr, size_t size, Error &error) override;
 	bool Seek(offset_type offset, Error &error) override;
+	bool SupportsPeek() const override;
+	ConstBuffer<void> Peek(Error &error) override;
+	void Consume(size_t nbytes) override;
+
+private:
+	size_t GetRemaining() const {
+		return offset < size ? size_t(size - offset) : 0;
+	}
 };
 
+bool
+MmapFileInputStream::Seek(offset_type new_offset, Error &error)
+{
+	if (new_offset > size) {
+		error.Set(file_domain, "Invalid seek offset");
+		return false;
+	}
+
+	offset = new_offset;
+
+	/* request the pages at the new offset right away */
+	const size_t page_mask = sysconf(_SC_PAGESIZE) - 1;
+	const size_t start = size_t(offset) & ~page_mask;
+	const size_t length = std::min(size_t(WILLNEED_SIZE),
+				     size_t(size) - start);
+	if (length > 0)
+		madvise(const_cast<uint8_t *>(data) + start, length,
+			MADV_WILLNEED);
+
+	return true;
+}
+
+size_t
+MmapFileInputStream::Read(void *ptr, size_t read_size,
+			  gcc_unused Error &error)
+{
+	const size_t nbytes = std::min(read_size, GetRemaining());
+	memcpy(ptr, data + offset, nbytes);
+	offset += nbytes;
+	return nbytes;
+}
+
+bool
+MmapFileInputStream::SupportsPeek() const
+{
+	return true;
+}
+
+ConstBuffer<void>
+MmapFileInputStream::Peek(gcc_unused Error &error)
+{
+	return { data + offset, GetRemaining() };
+}
+
+void
+MmapFileInputStream::Consume(size_t nbytes)
+{
+	assert(nbytes <= GetRemaining());
+
+	offset += nbytes;
+}
+
+/**
+ * Attempt to map the file into memory.
+ *
+ * @return the new stream, or nullptr if the file cannot be mapped
+ * (the caller falls back to reading it)
+ */
+static InputStream *
+OpenMmapFileInputStream(Path path, FileReader &reader, offset_type size,
+			Mutex &mutex, Cond &cond)
+{
+	if (size == 0 || size > offset_type(SIZE_MAX / 2))
+		return nullptr;
+
+	void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED,
+			  reader.GetFD().Get(), 0);
+	if (data == MAP_FAILED)
+		return nullptr;
+
+	madvise(data, size, MADV_SEQUENTIAL);
+
+	/* the mapping remains valid after the file has been
+	   closed */
+	reader.Close();
+
+	return new MmapFileInputStream(path.ToUTF8().c_str(), data, size,
+				       mutex, cond);
+}
+
+#endif
+
 InputStream *
 OpenFileInputStream(Path path,
 		    Mutex &mutex, Cond &cond,
@@ -76,9 +399,18 @@ OpenFileInputStream(Path path,
 		return nullptr;
 	}
 
-#ifdef POSIX_FADV_SEQUENTIAL
-	posix_fadvise(reader.GetFD().Get(), (off_t)0, info.GetSize(),
-		      POSIX_FADV_SEQUENTIAL);
+#ifndef WIN32
+	if (file_mmap) {
+		InputStream *is =
+			OpenMmapFileInputStream(path, reader, info.GetSize(),
+						mutex, cond);
+		if (is != nullptr)
+			return is;
+	}
+#endif
+
+#ifndef WIN32
+	reader.GetFD().AdviseSequential();
 #endif
 
 	return new FileInputStream(path.ToUTF8().c_str(),
@@ -86,6 +418,16 @@ OpenFileInputStream(Path path,
 				   mutex, cond);
 }
 
+static InputPlugin::InitResult
+input_file_init(gcc_unused const ConfigBlock &block, gcc_unused Error &error)
+{
+#ifndef WIN32
+	file_mmap = block.GetBlockValue("mmap", false);
+#endif
+
+	return InputPlugin::InitResult::SUCCESS;
+}
+
 static InputStream *
 input_file_open(gcc_unused const char *filename,
 		gcc_unused Mutex &mutex, gcc_unused Cond &cond,
@@ -99,6 +441,17 @@ input_file_open(gcc_unused const char *filename,
 bool
 FileInputStream::Seek(offset_type new_offset, Error &error)
 {
+#ifndef WIN32
+	reader.GetFD().AdviseWillNeed(new_offset, WILLNEED_SIZE);
+#endif
+
+#ifdef HAVE_IO_URING
+	if (read_ahead != nullptr) {
+		offset = new_offset;
+		return true;
+	}
+#endif
+
 	if (!reader.Seek((off_t)new_offset, error))
 		return false;
 
@@ -109,6 +462,36 @@ FileInputStream::Seek(offset_type new_offset, Error &error)
 size_t
 FileInputStream::Read(void *ptr, size_t read_size, Error &error)
 {
+#ifdef HAVE_IO_URING
+	if (read_ahead != nullptr) {
+		size_t nbytes = read_ahead->Read(offset, ptr, read_size);
+		if (nbytes == 0) {
+			/* not in the buffer (first read or after a
+			   seek): read synchronously */
+			ssize_t result = pread(reader.GetFD().Get(), ptr,
+					       read_size, offset);
+			if (result < 0) {
+				error.FormatErrno("Failed to read from %s",
+						  GetURI());
+				return 0;
+			}
+
+			nbytes = result;
+		}
+
+		offset += nbytes;
+
+		if (offset < size && !read_ahead->Start(offset)) {
+			/* fall back to FileReader */
+			read_ahead.reset();
+			if (!reader.Seek(offset, error))
+				return 0;
+		}
+
+		return nbytes;
+	}
+#endif
+
 	ssize_t nbytes = reader.Read(ptr, read_size, error);
 	if (nbytes < 0)
 		return 0;
@@ -119,7 +502,7 @@ FileInputStream::Read(void *ptr, size_t read_size, Error &error)
 
 const InputPlugin input_plugin_file = {
 	"file",
-	nullptr,
+	input_file_init,
 	nullptr,
 	input_file_open,
 };
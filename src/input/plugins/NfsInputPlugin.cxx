@@ -21,9 +21,11 @@
 #include "NfsInputPlugin.hxx"
 #include "../AsyncInputStream.hxx"
 #include "../InputPlugin.hxx"
+#include "config/Block.hxx"
 #include "lib/nfs/Domain.hxx"
 #include "lib/nfs/Glue.hxx"
 #include "lib/nfs/FileReader.hxx"
+#include "IOThread.hxx"
 #include "util/HugeAllocator.hxx"
 #include "util/StringUtil.hxx"
 #include "util/Error.hxx"
@@ -33,29 +35,48 @@
 #include <fcntl.h>
 
 /**
- * Do not buffer more than this number of bytes.  It should be a
- * reasonable limit that doesn't make low-end machines suffer too
- * much, but doesn't cause stuttering on high-latency lines.
+ * The read-ahead buffer settings.  The default buffer size should be
+ * a reasonable limit that doesn't make low-end machines suffer too
+ * much, but doesn't cause stuttering on high-latency lines; the
+ * stream is resumed at 384 kB after it has been paused.
  */
-static const size_t NFS_MAX_BUFFERED = 512 * 1024;
+static AsyncInputStreamConfig nfs_buffer_config(512 * 1024, 384 * 1024);
 
 /**
- * Resume the stream at this number of bytes after it has been paused.
+ * The maximum number of concurrent READ calls per stream.  On
+ * high-latency links, the throughput of a single call at a time is
+ * limited to the read size divided by the round trip time.
  */
-static const size_t NFS_RESUME_AT = 384 * 1024;
+static unsigned nfs_read_window = 4;
+
+/**
+ * The size of each READ call; 0 means use the maximum negotiated
+ * with the server.
+ */
+static size_t nfs_read_size;
 
 class NfsInputStream final : public AsyncInputStream, NfsFileReader {
+	/**
+	 * The offset following the data which has been appended to
+	 * the buffer.
+	 */
 	uint64_t next_offset;
 
+	/**
+	 * The offset following the data which has been requested
+	 * from the server.  The difference to #next_offset is the
+	 * data in flight.
+	 */
+	uint64_t request_offset;
+
 	bool reconnect_on_resume, reconnecting;
 
 public:
 	NfsInputStream(const char *_uri,
 		       Mutex &_mutex, Cond &_cond,
 		       void *_buffer)
-		:AsyncInputStream(_uri, _mutex, _cond,
-				  _buffer, NFS_MAX_BUFFERED,
-				  NFS_RESUME_AT),
+		:AsyncInputStream(io_thread_get(), _uri, _mutex, _cond,
+				  _buffer, nfs_buffer_config),
 		 reconnect_on_resume(false), reconnecting(false) {}
 
 	virtual ~NfsInputStream() {
@@ -86,29 +107,47 @@ private:
 bool
 NfsInputStream::DoRead()
 {
-	assert(NfsFileReader::IsIdle());
+	size_t read_size = nfs_read_size;
+	if (read_size == 0) {
+		read_size = NfsFileReader::GetReadMax();
+		if (read_size == 0)
+			/* libnfs doesn't know; fall back to a
+			   conservative size */
+			read_size = 32768;
+	}
 
-	int64_t remaining = size - next_offset;
-	if (remaining <= 0)
-		return true;
+	while (NfsFileReader::GetPendingReads() < nfs_read_window) {
+		int64_t remaining = size - request_offset;
+		if (remaining <= 0)
+			return true;
+
+		/* the buffer must have room for the data in flight */
+		const size_t in_flight = request_offset - next_offset;
+		size_t buffer_space = GetBufferSpace();
+		if (buffer_space <= in_flight) {
+			if (in_flight == 0)
+				Pause();
+			return true;
+		}
 
-	const size_t buffer_space = GetBufferSpace();
-	if (buffer_space == 0) {
-		Pause();
-		return true;
-	}
+		buffer_space -= in_flight;
 
-	size_t nbytes = std::min<size_t>(std::min<uint64_t>(remaining, 32768),
-					 buffer_space);
+		size_t nbytes = std::min<size_t>(std::min<uint64_t>(remaining,
+								    read_size),
+						 buffer_space);
 
-	mutex.unlock();
-	Error error;
-	bool success = NfsFileReader::Read(next_offset, nbytes, error);
-	mutex.lock();
+		mutex.unlock();
+		Error error;
+		bool success = NfsFileReader::Read(request_offset, nbytes,
+						   error);
+		mutex.lock();
 
-	if (!success) {
-		PostponeError(std::move(error));
-		return false;
+		if (!success) {
+			PostponeError(std::move(error));
+			return false;
+		}
+
+		request_offset += nbytes;
 	}
 
 	return true;
@@ -139,8 +178,6 @@ NfsInputStream::DoResume()
 		return;
 	}
 
-	assert(NfsFileReader::IsIdle());
-
 	DoRead();
 }
 
@@ -151,7 +188,7 @@ NfsInputStream::DoSeek(offset_type new_offset)
 	NfsFileReader::CancelRead();
 	mutex.lock();
 
-	next_offset = offset = new_offset;
+	next_offset = request_offset = offset = new_offset;
 	SeekDone();
 	DoRead();
 }
@@ -165,13 +202,14 @@ NfsInputStream::OnNfsFileOpen(uint64_t _size)
 		/* reconnect has succeeded */
 
 		reconnecting = false;
+		request_offset = next_offset;
 		DoRead();
 		return;
 	}
 
 	size = _size;
 	seekable = true;
-	next_offset = 0;
+	next_offset = request_offset = 0;
 	SetReady();
 	DoRead();
 }
@@ -180,12 +218,16 @@ void
 NfsInputStream::OnNfsFileRead(const void *data, size_t data_size)
 {
 	const ScopeLock protect(mutex);
-	assert(!IsBufferFull());
-	assert(IsBufferFull() == (GetBufferSpace() == 0));
 	AppendToBuffer(data, data_size);
 
 	next_offset += data_size;
 
+	if (NfsFileReader::GetPendingReads() == 0)
+		/* after a short read, the following requests have
+		   been canceled; continue after the data which was
+		   actually received */
+		request_offset = next_offset;
+
 	DoRead();
 }
 
@@ -221,9 +263,27 @@ NfsInputStream::OnNfsFileError(Error &&error)
  */
 
 static InputPlugin::InitResult
-input_nfs_init(const ConfigBlock &, Error &)
+input_nfs_init(const ConfigBlock &block, Error &error)
 {
+	if (!nfs_buffer_config.Load(block, error))
+		return InputPlugin::InitResult::ERROR;
+
+	nfs_read_window = block.GetBlockValue("read_window", 4u);
+	if (nfs_read_window == 0) {
+		error.Set(nfs_domain, "Invalid read_window");
+		return InputPlugin::InitResult::ERROR;
+	}
+
+	nfs_read_size = size_t(block.GetBlockValue("read_size", 0u)) * 1024;
+
+	const unsigned sessions = block.GetBlockValue("sessions", 2u);
+	if (sessions == 0) {
+		error.Set(nfs_domain, "Invalid sessions");
+		return InputPlugin::InitResult::ERROR;
+	}
+
 	nfs_init();
+	nfs_set_max_sessions(sessions);
 	return InputPlugin::InitResult::SUCCESS;
 }
 
@@ -241,7 +301,7 @@ input_nfs_open(const char *uri,
 	if (!StringStartsWith(uri, "nfs://"))
 		return nullptr;
 
-	void *buffer = HugeAllocate(NFS_MAX_BUFFERED);
+	void *buffer = HugeAllocate(nfs_buffer_config.buffer_size);
 	if (buffer == nullptr) {
 		error.Set(nfs_domain, "Out of memory");
 		return nullptr;
@@ -17,37 +17,112 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+
 #include "config.h"
 #include "SmbclientInputPlugin.hxx"
 #include "lib/smbclient/Init.hxx"
-#include "lib/smbclient/Mutex.hxx"
+#include "lib/smbclient/Context.hxx"
+#include "lib/smbclient/Domain.hxx"
 #include "../InputStream.hxx"
 #include "../InputPlugin.hxx"
+#include "config/Block.hxx"
+#include "thread/Mutex.hxx"
+#include "util/DynamicFifoBuffer.hxx"
+#include "util/ConstBuffer.hxx"
 #include "util/StringUtil.hxx"
 #include "util/Error.hxx"
 
-#include <libsmbclient.h>
+#include <memory>
+#include <vector>
+
+#include <assert.h>
+#include <string.h>
+
+/**
+ * A libsmbclient context shared by several streams.
+ */
+struct SmbclientPoolSlot {
+	std::unique_ptr<SmbclientContext> context;
+
+	/**
+	 * The number of streams using this context.
+	 */
+	unsigned users = 0;
+};
+
+/**
+ * A pool of libsmbclient contexts.  Each stream is assigned to the
+ * least busy one, and operations on different contexts do not block
+ * each other, so several streams can read in parallel.
+ */
+static std::vector<SmbclientPoolSlot> smbclient_pool;
+static Mutex smbclient_pool_mutex;
+
+/**
+ * The minimum size of each smbc_read() call.  Decoders often read
+ * only a few kilobytes at a time, and each call is a round trip to
+ * the server.
+ */
+static size_t smbclient_read_size;
+
+static SmbclientPoolSlot *
+AcquireContext(Error &error)
+{
+	const ScopeLock protect(smbclient_pool_mutex);
+
+	SmbclientPoolSlot *best = nullptr;
+	for (auto &slot : smbclient_pool)
+		if (best == nullptr || slot.users < best->users)
+			best = &slot;
+
+	assert(best != nullptr);
+
+	if (best->context == nullptr) {
+		best->context.reset(SmbclientContext::New(error));
+		if (best->context == nullptr)
+			return nullptr;
+	}
+
+	++best->users;
+	return best;
+}
+
+static void
+ReleaseContext(SmbclientPoolSlot &slot)
+{
+	const ScopeLock protect(smbclient_pool_mutex);
+
+	assert(slot.users > 0);
+	--slot.users;
+}
 
 class SmbclientInputStream final : public InputStream {
-	SMBCCTX *ctx;
-	int fd;
+	SmbclientPoolSlot &slot;
+	SmbclientContext &ctx;
+	SMBCFILE *const file;
+
+	/**
+	 * Data which has been read from the server but not yet
+	 * consumed.  It begins at #offset.
+	 */
+	DynamicFifoBuffer<uint8_t> buffer;
 
 public:
 	SmbclientInputStream(const char *_uri,
 			     Mutex &_mutex, Cond &_cond,
-			     SMBCCTX *_ctx, int _fd, const struct stat &st)
+			     SmbclientPoolSlot &_slot,
+			     SMBCFILE *_file, const struct stat &st)
 		:InputStream(_uri, _mutex, _cond),
-		 ctx(_ctx), fd(_fd) {
+		 slot(_slot), ctx(*_slot.context), file(_file),
+		 buffer(smbclient_read_size) {
 		seekable = true;
 		size = st.st_size;
 		SetReady();
 	}
 
 	~SmbclientInputStream() {
-		smbclient_mutex.lock();
-		smbc_close(fd);
-		smbc_free_context(ctx, 1);
-		smbclient_mutex.unlock();
+		ctx.Close(file);
+		ReleaseContext(slot);
 	}
 
 	/* virtual methods from InputStream */
@@ -58,6 +133,18 @@ public:
 
 	size_t Read(void *ptr, size_t size, Error &error) override;
 	bool Seek(offset_type offset, Error &error) override;
+
+	bool SupportsPeek() const override;
+	ConstBuffer<void> Peek(Error &error) override;
+	void Consume(size_t nbytes) override;
+
+private:
+	/**
+	 * Refill the (empty) buffer from the server.
+	 *
+	 * @return false on error or end of file
+	 */
+	bool Fill(Error &error);
 };
 
 /*
@@ -66,18 +153,38 @@ public:
  */
 
 static InputPlugin::InitResult
-input_smbclient_init(gcc_unused const ConfigBlock &block, Error &error)
+input_smbclient_init(const ConfigBlock &block, Error &error)
 {
 	if (!SmbclientInit(error))
 		return InputPlugin::InitResult::UNAVAILABLE;
 
-	// TODO: create one global SMBCCTX here?
+	const unsigned contexts = block.GetBlockValue("contexts", 4u);
+	if (contexts == 0) {
+		error.Set(smbclient_domain, "Invalid contexts");
+		return InputPlugin::InitResult::ERROR;
+	}
+
+	smbclient_read_size =
+		size_t(block.GetBlockValue("read_size", 64u)) * 1024;
+	if (smbclient_read_size == 0) {
+		error.Set(smbclient_domain, "Invalid read_size");
+		return InputPlugin::InitResult::ERROR;
+	}
+
+	/* the contexts are created on demand */
+	smbclient_pool.resize(contexts);
 
 	// TODO: evaluate ConfigBlock, call smbc_setOption*()
 
 	return InputPlugin::InitResult::SUCCESS;
 }
 
+static void
+input_smbclient_finish()
+{
+	smbclient_pool.clear();
+}
+
 static InputStream *
 input_smbclient_open(const char *uri,
 		     Mutex &mutex, Cond &cond,
@@ -86,73 +193,128 @@ input_smbclient_open(const char *uri,
 	if (!StringStartsWith(uri, "smb://"))
 		return nullptr;
 
-	const ScopeLock protect(smbclient_mutex);
-
-	SMBCCTX *ctx = smbc_new_context();
-	if (ctx == nullptr) {
-		error.SetErrno("smbc_new_context() failed");
+	SmbclientPoolSlot *slot = AcquireContext(error);
+	if (slot == nullptr)
 		return nullptr;
-	}
 
-	SMBCCTX *ctx2 = smbc_init_context(ctx);
-	if (ctx2 == nullptr) {
-		error.SetErrno("smbc_init_context() failed");
-		smbc_free_context(ctx, 1);
-		return nullptr;
-	}
-
-	ctx = ctx2;
+	SmbclientContext &ctx = *slot->context;
 
-	int fd = smbc_open(uri, O_RDONLY, 0);
-	if (fd < 0) {
-		error.SetErrno("smbc_open() failed");
-		smbc_free_context(ctx, 1);
+	SMBCFILE *file = ctx.Open(uri, O_RDONLY, error);
+	if (file == nullptr) {
+		ReleaseContext(*slot);
 		return nullptr;
 	}
 
 	struct stat st;
-	if (smbc_fstat(fd, &st) < 0) {
-		error.SetErrno("smbc_fstat() failed");
-		smbc_close(fd);
-		smbc_free_context(ctx, 1);
+	if (!ctx.Stat(file, st, error)) {
+		ctx.Close(file);
+		ReleaseContext(*slot);
 		return nullptr;
 	}
 
-	return new SmbclientInputStream(uri, mutex, cond, ctx, fd, st);
+	return new SmbclientInputStream(uri, mutex, cond, *slot, file, st);
+}
+
+bool
+SmbclientInputStream::Fill(Error &error)
+{
+	assert(buffer.IsEmpty());
+
+	buffer.Clear();
+	auto w = buffer.Write();
+	assert(!w.IsEmpty());
+
+	ssize_t nbytes = ctx.Read(file, w.data, w.size, error);
+	if (nbytes <= 0)
+		return false;
+
+	buffer.Append(nbytes);
+	return true;
 }
 
 size_t
 SmbclientInputStream::Read(void *ptr, size_t read_size, Error &error)
 {
-	smbclient_mutex.lock();
-	ssize_t nbytes = smbc_read(fd, ptr, read_size);
-	smbclient_mutex.unlock();
-	if (nbytes < 0) {
-		error.SetErrno("smbc_read() failed");
-		nbytes = 0;
+	if (buffer.IsEmpty()) {
+		if (read_size >= buffer.GetCapacity()) {
+			/* large reads bypass the buffer */
+			ssize_t nbytes = ctx.Read(file, ptr, read_size, error);
+			if (nbytes <= 0)
+				return 0;
+
+			offset += nbytes;
+			return nbytes;
+		}
+
+		if (!Fill(error))
+			return 0;
 	}
 
-	return nbytes;
+	auto r = buffer.Read();
+	if (read_size > r.size)
+		read_size = r.size;
+
+	memcpy(ptr, r.data, read_size);
+	buffer.Consume(read_size);
+	offset += read_size;
+	return read_size;
 }
 
 bool
 SmbclientInputStream::Seek(offset_type new_offset, Error &error)
 {
-	smbclient_mutex.lock();
-	off_t result = smbc_lseek(fd, new_offset, SEEK_SET);
-	smbclient_mutex.unlock();
-	if (result < 0) {
-		error.SetErrno("smbc_lseek() failed");
+	/* skip forward within the buffer without asking the
+	   server */
+	if (new_offset >= offset &&
+	    new_offset - offset <= buffer.GetAvailable()) {
+		buffer.Consume(new_offset - offset);
+		offset = new_offset;
+		return true;
+	}
+
+	const offset_type end = offset + buffer.GetAvailable();
+
+	buffer.Clear();
+
+	if (!ctx.Seek(file, new_offset, error)) {
+		/* the server's file position is still at the end of
+		   the discarded buffer */
+		offset = end;
 		return false;
 	}
 
-	offset = result;
+	offset = new_offset;
+	return true;
+}
+
+bool
+SmbclientInputStream::SupportsPeek() const
+{
 	return true;
 }
 
+ConstBuffer<void>
+SmbclientInputStream::Peek(Error &error)
+{
+	if (buffer.IsEmpty() && !IsEOF() && !Fill(error))
+		return nullptr;
+
+	auto r = buffer.Read();
+	return { r.data, r.size };
+}
+
+void
+SmbclientInputStream::Consume(size_t nbytes)
+{
+	assert(nbytes <= buffer.GetAvailable());
+
+	buffer.Consume(nbytes);
+	offset += nbytes;
+}
+
 const InputPlugin input_plugin_smbclient = {
 	"smbclient",
 	input_smbclient_init,
-	nullptr,
+	input_smbclient_finish,
 	input_smbclient_open,
 };
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Block.hxx"
+
+#include <assert.h>
+#include <string.h>
+
+static void
+PutBits(uint8_t *dest, uint64_t position, uint64_t value, unsigned n)
+{
+	while (n > 0) {
+		--n;
+		if ((value >> n) & 1)
+			dest[position / 8] |= 0x80 >> (position % 8);
+		++position;
+	}
+}
+
+size_t
+Bzip2MakeBlockStream(uint8_t *dest, const uint8_t *src, unsigned shift,
+		     uint64_t n_bits, char level)
+{
+	assert(shift < 8);
+	assert(n_bits >= 48 + 32);
+	assert(level >= '1' && level <= '9');
+
+	const size_t size = Bzip2BlockStreamSize(n_bits);
+	memset(dest, 0, size);
+
+	dest[0] = 'B';
+	dest[1] = 'Z';
+	dest[2] = 'h';
+	dest[3] = level;
+
+	/* copy the block, aligned to a byte boundary */
+
+	uint8_t *const block = dest + 4;
+	const size_t n_bytes = (n_bits + 7) / 8;
+	const size_t src_size = (shift + n_bits + 7) / 8;
+
+	if (shift == 0) {
+		memcpy(block, src, n_bytes);
+	} else {
+		for (size_t i = 0; i < n_bytes; ++i) {
+			unsigned b = src[i] << shift;
+			if (i + 1 < src_size)
+				b |= src[i + 1] >> (8 - shift);
+			block[i] = b;
+		}
+	}
+
+	if (n_bits % 8 != 0)
+		/* clear the bits of the next marker */
+		block[n_bytes - 1] &= 0xff << (8 - n_bits % 8);
+
+	/* a stream with only one block: the combined CRC is the
+	   block CRC, which follows the block marker */
+	const uint32_t crc = (uint32_t(block[6]) << 24) |
+		(uint32_t(block[7]) << 16) |
+		(uint32_t(block[8]) << 8) |
+		uint32_t(block[9]);
+
+	const uint64_t end = 32 + n_bits;
+	PutBits(dest, end, Bzip2BlockScanner::END_MAGIC, 48);
+	PutBits(dest, end + 48, crc, 32);
+
+	return size;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_BZIP2_BLOCK_HXX
+#define MPD_BZIP2_BLOCK_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Finds the markers in a bzip2 file which begin a compressed block or
+ * end a stream.  The markers are not aligned to bytes, so the data is
+ * searched bit by bit.
+ *
+ * Feed the file from its beginning; the reported positions are bit
+ * offsets from there.
+ */
+class Bzip2BlockScanner {
+	static constexpr uint64_t MASK = 0xffffffffffffULL;
+
+	uint64_t bits;
+
+	/**
+	 * The number of bits which have been fed.
+	 */
+	uint64_t position;
+
+public:
+	static constexpr uint64_t BLOCK_MAGIC = 0x314159265359ULL;
+	static constexpr uint64_t END_MAGIC = 0x177245385090ULL;
+
+	Bzip2BlockScanner():bits(0), position(0) {}
+
+	uint64_t GetPosition() const {
+		return position;
+	}
+
+	/**
+	 * Search the given data, which follows the data passed to the
+	 * previous call.
+	 *
+	 * @param f a function called with the bit offset of the
+	 * marker and a bool which is true for the end of a stream
+	 */
+	template<typename F>
+	void Feed(const uint8_t *data, size_t size, F &&f) {
+		for (size_t i = 0; i < size; ++i) {
+			const unsigned b = data[i];
+			for (int j = 7; j >= 0; --j) {
+				bits = (bits << 1) | ((b >> j) & 1);
+				++position;
+
+				const uint64_t m = bits & MASK;
+				if (gcc_unlikely(m == BLOCK_MAGIC))
+					f(position - 48, false);
+				else if (gcc_unlikely(m == END_MAGIC))
+					f(position - 48, true);
+			}
+		}
+	}
+};
+
+/**
+ * Returns the buffer size needed by Bzip2MakeBlockStream().
+ */
+constexpr size_t
+Bzip2BlockStreamSize(uint64_t n_bits)
+{
+	/* "BZh" header, the block, the end marker and the
+	   combined CRC */
+	return 4 + (n_bits + 48 + 32 + 7) / 8;
+}
+
+/**
+ * Build a stand-alone bzip2 stream which contains only one block of
+ * another stream, to be passed to BZ2_bzDecompress().  This allows
+ * decoding a bzip2 file beginning at any block.
+ *
+ * @param dest a buffer of Bzip2BlockStreamSize() bytes
+ * @param src the file data, beginning with the byte which contains
+ * the first bit of the block
+ * @param shift the position of the block's first bit within the
+ * first byte of #src (0 = most significant bit)
+ * @param n_bits the length of the block including its marker, i.e.
+ * the distance to the next marker
+ * @param level the block size level ('1' to '9') of the original
+ * stream
+ * @return the size of the stream in bytes
+ */
+size_t
+Bzip2MakeBlockStream(uint8_t *dest, const uint8_t *src, unsigned shift,
+		     uint64_t n_bits, char level);
+
+#endif
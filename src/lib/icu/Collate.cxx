@@ -114,6 +114,55 @@ IcuCollate(const char *a, const char *b)
 #endif
 }
 
+std::string
+IcuCollateKey(const char *src)
+{
+#if !CLANG_CHECK_VERSION(3,6)
+	/* disabled on clang due to -Wtautological-pointer-compare */
+	assert(src != nullptr);
+#endif
+
+#ifdef HAVE_ICU
+	assert(collator != nullptr);
+
+	const auto u = UCharFromUTF8(src);
+	if (u.IsNull())
+		return std::string(src);
+
+	uint8_t buffer[256];
+	int32_t length = ucol_getSortKey(collator, u.data, u.size,
+					 buffer, sizeof(buffer));
+	if (length > int32_t(sizeof(buffer))) {
+		/* too large for the stack buffer */
+		uint8_t *key = new uint8_t[length];
+		ucol_getSortKey(collator, u.data, u.size, key, length);
+		delete[] u.data;
+
+		std::string result((const char *)key);
+		delete[] key;
+		return result;
+	}
+
+	delete[] u.data;
+
+	if (length == 0)
+		return std::string(src);
+
+	/* the key is null-terminated */
+	return std::string((const char *)buffer);
+#elif defined(HAVE_GLIB)
+	char *tmp = g_utf8_collate_key(src, -1);
+	std::string result(tmp);
+	g_free(tmp);
+	return result;
+#else
+	/* strcmp() on lower-case strings equals strcasecmp() */
+	std::string result(src);
+	std::transform(result.begin(), result.end(), result.begin(), tolower);
+	return result;
+#endif
+}
+
 std::string
 IcuCaseFold(const char *src)
 {
@@ -37,6 +37,16 @@ gcc_pure gcc_nonnull_all
 int
 IcuCollate(const char *a, const char *b);
 
+/**
+ * Calculate a sort key for the given string: comparing two keys
+ * with strcmp() gives the same result as IcuCollate() on the original
+ * strings.  This is cheaper when a string is compared many times,
+ * e.g. while sorting.
+ */
+gcc_pure gcc_nonnull_all
+std::string
+IcuCollateKey(const char *src);
+
 gcc_pure gcc_nonnull_all
 std::string
 IcuCaseFold(const char *src);
@@ -25,6 +25,7 @@
 #include "util/WritableBuffer.hxx"
 #include "util/ConstBuffer.hxx"
 
+#include <assert.h>
 #include <string.h>
 
 #ifdef HAVE_ICU
@@ -37,11 +38,109 @@ static constexpr Domain g_iconv_domain("g_iconv");
 
 #ifdef HAVE_ICU
 
+struct IcuConverter::Slot {
+	/**
+	 * The #IcuConverter which owns the clone in this slot, or
+	 * nullptr if it is not attached.
+	 */
+	const IcuConverter *owner = nullptr;
+
+	/** the next slot in IcuConverter::slots */
+	Slot *next = nullptr;
+
+	UConverter *clone = nullptr;
+
+	~Slot() {
+		if (owner != nullptr)
+			owner->Detach(*this);
+	}
+};
+
+/**
+ * Each thread has only one slot, because there is usually only one
+ * #IcuConverter (the one for the filesystem character set); a thread
+ * which switches to another one closes its old clone.
+ */
+static thread_local IcuConverter::Slot thread_slot;
+
 IcuConverter::~IcuConverter()
 {
+	{
+		const ScopeLock protect(mutex);
+
+		while (slots != nullptr) {
+			Slot &slot = *slots;
+			slots = slot.next;
+
+			ucnv_close(slot.clone);
+			slot.clone = nullptr;
+			slot.owner = nullptr;
+			slot.next = nullptr;
+		}
+	}
+
 	ucnv_close(converter);
 }
 
+bool
+IcuConverter::Attach(Slot &slot) const
+{
+	assert(slot.owner != this);
+
+	if (slot.owner != nullptr)
+		slot.owner->Detach(slot);
+
+	const ScopeLock protect(mutex);
+
+	UErrorCode code = U_ZERO_ERROR;
+#if U_ICU_VERSION_MAJOR_NUM >= 71
+	slot.clone = ucnv_clone(converter, &code);
+#else
+	int32_t size = 0;
+	slot.clone = ucnv_safeClone(converter, nullptr, &size, &code);
+#endif
+	if (U_FAILURE(code) || slot.clone == nullptr) {
+		slot.clone = nullptr;
+		return false;
+	}
+
+	slot.owner = this;
+	slot.next = slots;
+	slots = &slot;
+	return true;
+}
+
+void
+IcuConverter::Detach(Slot &slot) const
+{
+	assert(slot.owner == this);
+
+	const ScopeLock protect(mutex);
+
+	Slot **p = &slots;
+	while (*p != &slot) {
+		assert(*p != nullptr);
+		p = &(*p)->next;
+	}
+
+	*p = slot.next;
+
+	ucnv_close(slot.clone);
+	slot.clone = nullptr;
+	slot.next = nullptr;
+	slot.owner = nullptr;
+}
+
+UConverter *
+IcuConverter::GetThreadConverter() const
+{
+	Slot &slot = thread_slot;
+	if (slot.owner != this && !Attach(slot))
+		return nullptr;
+
+	return slot.clone;
+}
+
 #endif
 
 #ifdef HAVE_ICU_CONVERTER
@@ -104,9 +203,11 @@ std::string
 IcuConverter::ToUTF8(const char *s) const
 {
 #ifdef HAVE_ICU
-	const ScopeLock protect(mutex);
+	UConverter *const cnv = GetThreadConverter();
+	if (cnv == nullptr)
+		return std::string();
 
-	ucnv_resetToUnicode(converter);
+	ucnv_resetToUnicode(cnv);
 
 	// TODO: dynamic buffer?
 	UChar buffer[4096], *target = buffer;
@@ -114,7 +215,7 @@ IcuConverter::ToUTF8(const char *s) const
 
 	UErrorCode code = U_ZERO_ERROR;
 
-	ucnv_toUnicode(converter, &target, buffer + ARRAY_SIZE(buffer),
+	ucnv_toUnicode(cnv, &target, buffer + ARRAY_SIZE(buffer),
 		       &source, source + strlen(source),
 		       nullptr, true, &code);
 	if (code != U_ZERO_ERROR)
@@ -138,20 +239,24 @@ std::string
 IcuConverter::FromUTF8(const char *s) const
 {
 #ifdef HAVE_ICU
-	const ScopeLock protect(mutex);
-
 	const auto u = UCharFromUTF8(s);
 	if (u.IsNull())
 		return std::string();
 
-	ucnv_resetFromUnicode(converter);
+	UConverter *const cnv = GetThreadConverter();
+	if (cnv == nullptr) {
+		delete[] u.data;
+		return std::string();
+	}
+
+	ucnv_resetFromUnicode(cnv);
 
 	// TODO: dynamic buffer?
 	char buffer[4096], *target = buffer;
 	const UChar *source = u.data;
 	UErrorCode code = U_ZERO_ERROR;
 
-	ucnv_fromUnicode(converter, &target, buffer + ARRAY_SIZE(buffer),
+	ucnv_fromUnicode(cnv, &target, buffer + ARRAY_SIZE(buffer),
 			 &source, u.end(),
 			 nullptr, true, &code);
 	delete[] u.data;
@@ -48,14 +48,38 @@ struct UConverter;
 class IcuConverter {
 #ifdef HAVE_ICU
 	/**
-	 * ICU's UConverter class is not thread-safe.  This mutex
-	 * serializes simultaneous calls.
+	 * ICU's UConverter class is not thread-safe.  Therefore,
+	 * each thread converts with its own clone, which lives in a
+	 * thread-local #Slot.  This mutex protects the #slots list
+	 * only; it is not locked during conversions.
 	 */
 	mutable Mutex mutex;
 
+	/**
+	 * The converter which was created by Create().  It is never
+	 * used for converting, only as the template for clones.
+	 */
 	UConverter *const converter;
 
+public:
+	struct Slot;
+
+private:
+	/**
+	 * All thread-local slots which hold a clone of #converter.
+	 */
+	mutable Slot *slots = nullptr;
+
 	IcuConverter(UConverter *_converter):converter(_converter) {}
+
+	/**
+	 * Returns the calling thread's clone of #converter, or
+	 * nullptr on error.
+	 */
+	UConverter *GetThreadConverter() const;
+
+	bool Attach(Slot &slot) const;
+	void Detach(Slot &slot) const;
 #elif defined(HAVE_GLIB)
 	const GIConv to_utf8, from_utf8;
 
@@ -23,7 +23,9 @@
 #include "Domain.hxx"
 #include "Callback.hxx"
 #include "event/Loop.hxx"
+#include "net/Resolver.hxx"
 #include "system/fd_util.h"
+#include "system/Clock.hxx"
 #include "util/Error.hxx"
 
 extern "C" {
@@ -33,9 +35,21 @@ extern "C" {
 #include <utility>
 
 #include <poll.h> /* for POLLIN, POLLOUT */
+#include <sys/socket.h>
 
 static constexpr unsigned NFS_MOUNT_TIMEOUT = 60;
 
+NfsConnection::CancellableCallback::CancellableCallback(NfsCallback &_callback,
+							NfsConnection &_connection,
+							bool _open)
+	:CancellablePointer<NfsCallback>(_callback),
+	 connection(_connection),
+	 open(_open), close_fh(nullptr),
+	 start_time(MonotonicClockUS())
+{
+	++connection.queue_depth;
+}
+
 inline bool
 NfsConnection::CancellableCallback::Stat(nfs_context *ctx,
 					 const char *path,
@@ -140,7 +154,8 @@ NfsConnection::CancellableCallback::PrepareDestroyContext()
 	assert(IsCancelled());
 
 	if (close_fh != nullptr) {
-		connection.InternalClose(close_fh);
+		if (connection.ReleaseClose(close_fh))
+			connection.InternalClose(close_fh);
 		close_fh = nullptr;
 	}
 }
@@ -150,6 +165,8 @@ NfsConnection::CancellableCallback::Callback(int err, void *data)
 {
 	assert(connection.GetEventLoop().IsInside());
 
+	connection.UpdateRoundTripTime(MonotonicClockUS() - start_time);
+
 	if (!IsCancelled()) {
 		assert(close_fh == nullptr);
 
@@ -173,7 +190,8 @@ NfsConnection::CancellableCallback::Callback(int err, void *data)
 				struct nfsfh *fh = (struct nfsfh *)data;
 				connection.Close(fh);
 			}
-		} else if (close_fh != nullptr)
+		} else if (close_fh != nullptr &&
+			   connection.ReleaseClose(close_fh))
 			connection.DeferClose(close_fh);
 
 		connection.callbacks.Remove(*this);
@@ -189,6 +207,16 @@ NfsConnection::CancellableCallback::Callback(int err,
 	c.Callback(err, data);
 }
 
+void
+NfsConnection::UpdateRoundTripTime(unsigned us)
+{
+	/* exponentially weighted moving average with a weight of
+	   1/8 for the new sample, like the TCP RTT estimator */
+	rtt_us = rtt_us == 0
+		? us
+		: rtt_us - rtt_us / 8 + us / 8;
+}
+
 static constexpr unsigned
 libnfs_to_events(int i)
 {
@@ -367,9 +395,32 @@ void
 NfsConnection::CancelAndClose(struct nfsfh *fh, NfsCallback &callback)
 {
 	CancellableCallback &cancel = callbacks.Get(callback);
+	++close_refs[fh];
 	cancel.CancelAndScheduleClose(fh);
 }
 
+bool
+NfsConnection::ReleaseClose(struct nfsfh *fh)
+{
+	auto i = close_refs.find(fh);
+	assert(i != close_refs.end());
+	assert(i->second > 0);
+
+	if (--i->second > 0)
+		return false;
+
+	close_refs.erase(i);
+	return true;
+}
+
+size_t
+NfsConnection::GetReadMax() const
+{
+	assert(context != nullptr);
+
+	return nfs_get_readmax(context);
+}
+
 void
 NfsConnection::DestroyContext()
 {
@@ -556,7 +607,7 @@ NfsConnection::MountCallback(int status, nfs_context *nfs, void *data,
 }
 
 inline bool
-NfsConnection::MountInternal(Error &error)
+NfsConnection::MountInternal(const char *host, Error &error)
 {
 	assert(GetEventLoop().IsInside());
 	assert(context == nullptr);
@@ -578,7 +629,7 @@ NfsConnection::MountInternal(Error &error)
 	in_destroy = false;
 #endif
 
-	if (nfs_mount_async(context, server.c_str(), export_name.c_str(),
+	if (nfs_mount_async(context, host, export_name.c_str(),
 			    MountCallback, this) != 0) {
 		error.Format(nfs_domain,
 			     "nfs_mount_async() failed: %s",
@@ -650,13 +701,39 @@ NfsConnection::RunDeferred()
 	assert(GetEventLoop().IsInside());
 
 	if (context == nullptr) {
-		Error error;
-		if (!MountInternal(error)) {
-			BroadcastMountError(std::move(error));
-			return;
-		}
+		/* resolve the server name first; OnResolverSuccess()
+		   will mount */
+		if (!resolve.IsPending())
+			resolve.Start(server.c_str(), 0, 0, SOCK_STREAM);
+		return;
 	}
 
 	if (mount_finished)
 		BroadcastMountSuccess();
 }
+
+void
+NfsConnection::OnResolverSuccess(const ResolverResult &addresses)
+{
+	assert(GetEventLoop().IsInside());
+	assert(context == nullptr);
+	assert(!addresses.empty());
+
+	auto host = sockaddr_host_to_string(addresses.front());
+	if (host.empty())
+		host = server;
+
+	Error error;
+	if (!MountInternal(host.c_str(), error))
+		BroadcastMountError(std::move(error));
+}
+
+void
+NfsConnection::OnResolverError(const Error &error)
+{
+	assert(GetEventLoop().IsInside());
+
+	Error error2;
+	error2.Set(error);
+	BroadcastMountError(std::move(error2));
+}
@@ -25,12 +25,14 @@
 #include "event/SocketMonitor.hxx"
 #include "event/TimeoutMonitor.hxx"
 #include "event/DeferredMonitor.hxx"
+#include "event/AsyncResolver.hxx"
 #include "util/Error.hxx"
 
 #include <boost/intrusive/list.hpp>
 
 #include <string>
 #include <list>
+#include <map>
 #include <forward_list>
 
 struct nfs_context;
@@ -41,7 +43,8 @@ class NfsCallback;
 /**
  * An asynchronous connection to a NFS server.
  */
-class NfsConnection : SocketMonitor, TimeoutMonitor, DeferredMonitor {
+class NfsConnection : SocketMonitor, TimeoutMonitor, DeferredMonitor,
+		      ResolverHandler {
 	class CancellableCallback : public CancellablePointer<NfsCallback> {
 		NfsConnection &connection;
 
@@ -59,13 +62,20 @@ class NfsConnection : SocketMonitor, TimeoutMonitor, DeferredMonitor {
 		 */
 		struct nfsfh *close_fh;
 
+		/**
+		 * The time stamp [us] when this operation was
+		 * submitted, for measuring the round trip time.
+		 */
+		const uint64_t start_time;
+
 	public:
 		explicit CancellableCallback(NfsCallback &_callback,
 					     NfsConnection &_connection,
-					     bool _open)
-			:CancellablePointer<NfsCallback>(_callback),
-			 connection(_connection),
-			 open(_open), close_fh(nullptr) {}
+					     bool _open);
+
+		~CancellableCallback() {
+			--connection.queue_depth;
+		}
 
 		bool Stat(nfs_context *context, const char *path,
 			  Error &error);
@@ -100,6 +110,12 @@ class NfsConnection : SocketMonitor, TimeoutMonitor, DeferredMonitor {
 
 	std::string server, export_name;
 
+	/**
+	 * Resolves #server before mounting; libnfs would resolve it
+	 * synchronously, blocking the #EventLoop.
+	 */
+	ResolveRequest resolve;
+
 	nfs_context *context;
 
 	typedef std::list<NfsLease *> LeaseList;
@@ -117,6 +133,25 @@ class NfsConnection : SocketMonitor, TimeoutMonitor, DeferredMonitor {
 	 */
 	std::forward_list<struct nfsfh *> deferred_close;
 
+	/**
+	 * File handles passed to CancelAndClose(), and the number of
+	 * cancelled operations which must finish before the handle
+	 * may be closed.
+	 */
+	std::map<struct nfsfh *, unsigned> close_refs;
+
+	/**
+	 * The number of operations submitted to the server which
+	 * have not finished yet (including cancelled ones).
+	 */
+	unsigned queue_depth;
+
+	/**
+	 * The smoothed round trip time of recent operations in
+	 * microseconds; 0 if nothing has been measured yet.
+	 */
+	unsigned rtt_us;
+
 	Error postponed_mount_error;
 
 #ifndef NDEBUG
@@ -146,7 +181,9 @@ public:
 		:SocketMonitor(_loop), TimeoutMonitor(_loop),
 		 DeferredMonitor(_loop),
 		 server(_server), export_name(_export_name),
-		 context(nullptr) {}
+		 resolve(_loop, resolver_get(), *this),
+		 context(nullptr),
+		 queue_depth(0), rtt_us(0) {}
 
 	/**
 	 * Must be run from EventLoop's thread.
@@ -167,6 +204,38 @@ public:
 		return SocketMonitor::GetEventLoop();
 	}
 
+	/**
+	 * Returns the number of operations which are currently in
+	 * flight.
+	 */
+	unsigned GetQueueDepth() const {
+		return queue_depth;
+	}
+
+	/**
+	 * Returns the smoothed round trip time [us] of recent
+	 * operations.
+	 */
+	unsigned GetRoundTripTime() const {
+		return rtt_us;
+	}
+
+	/**
+	 * Returns the number of registered #NfsLease objects.
+	 */
+	unsigned GetLeaseCount() const {
+		return new_leases.size() + active_leases.size();
+	}
+
+	/**
+	 * A rough estimate how busy this connection is: leases plus
+	 * operations in flight.  Used to pick the least busy session
+	 * of a pool.
+	 */
+	unsigned GetLoad() const {
+		return GetLeaseCount() + GetQueueDepth();
+	}
+
 	/**
 	 * Ensure that the connection is established.  The connection
 	 * is kept up while at least one #NfsLease is registered.
@@ -192,14 +261,34 @@ public:
 	void Cancel(NfsCallback &callback);
 
 	void Close(struct nfsfh *fh);
+
+	/**
+	 * Cancel the operation and close the file handle as soon as
+	 * it has finished.  This may be called for several
+	 * operations on the same file handle; it is closed after the
+	 * last one has finished.
+	 */
 	void CancelAndClose(struct nfsfh *fh, NfsCallback &callback);
 
+	/**
+	 * Returns the maximum size of a single READ call, as
+	 * negotiated with the server (its "rsize").
+	 */
+	gcc_pure
+	size_t GetReadMax() const;
+
 protected:
 	virtual void OnNfsConnectionError(Error &&error) = 0;
 
 private:
 	void DestroyContext();
 
+	/**
+	 * Account for a finished operation in the smoothed round
+	 * trip time.
+	 */
+	void UpdateRoundTripTime(unsigned us);
+
 	/**
 	 * Wrapper for nfs_close_async().
 	 */
@@ -210,7 +299,17 @@ private:
 	 */
 	void DeferClose(struct nfsfh *fh);
 
-	bool MountInternal(Error &error);
+	/**
+	 * Release one reference added by CancelAndClose().
+	 *
+	 * @return true if the file handle shall be closed now
+	 */
+	bool ReleaseClose(struct nfsfh *fh);
+
+	/**
+	 * @param host the numeric address of #server
+	 */
+	bool MountInternal(const char *host, Error &error);
 	void BroadcastMountSuccess();
 	void BroadcastMountError(Error &&error);
 	void BroadcastError(Error &&error);
@@ -234,6 +333,10 @@ private:
 
 	/* virtual methods from DeferredMonitor */
 	virtual void RunDeferred() override;
+
+	/* virtual methods from ResolverHandler */
+	void OnResolverSuccess(const ResolverResult &addresses) override;
+	void OnResolverError(const Error &error) override;
 };
 
 #endif
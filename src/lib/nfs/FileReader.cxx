@@ -68,11 +68,22 @@ NfsFileReader::CancelOrClose()
 	assert(state != State::INITIAL &&
 	       state != State::DEFER);
 
-	if (state == State::IDLE)
-		/* no async operation in progress: can close
-		   immediately */
-		connection->Close(fh);
-	else if (state > State::OPEN)
+	if (state == State::IDLE) {
+		if (reads.empty())
+			/* no async operation in progress: can close
+			   immediately */
+			connection->Close(fh);
+		else {
+			/* cancel all read requests and close the
+			   file handle after the last one has
+			   finished */
+			for (auto &request : reads)
+				if (!request.IsDone())
+					connection->CancelAndClose(fh, request);
+
+			reads.clear();
+		}
+	} else if (state > State::OPEN)
 		/* one async operation in progress: cancel it and
 		   defer the nfs_close_async() call */
 		connection->CancelAndClose(fh, *this);
@@ -139,20 +150,109 @@ NfsFileReader::Read(uint64_t offset, size_t size, Error &error)
 {
 	assert(state == State::IDLE);
 
-	if (!connection->Read(fh, offset, size, *this, error))
+	reads.emplace_back(*this, size);
+	if (!connection->Read(fh, offset, size, reads.back(), error)) {
+		reads.pop_back();
 		return false;
+	}
 
-	state = State::READ;
 	return true;
 }
 
 void
 NfsFileReader::CancelRead()
 {
-	if (state == State::READ) {
-		connection->Cancel(*this);
-		state = State::IDLE;
+	for (auto &request : reads)
+		if (!request.IsDone())
+			connection->Cancel(request);
+
+	reads.clear();
+}
+
+size_t
+NfsFileReader::GetReadMax() const
+{
+	assert(state == State::IDLE);
+
+	return connection->GetReadMax();
+}
+
+void
+NfsFileReader::ReadRequest::OnNfsCallback(unsigned status, void *_data)
+{
+	reader.ReadCallback(*this, _data, status);
+}
+
+void
+NfsFileReader::ReadRequest::OnNfsError(Error &&error)
+{
+	reader.ReadError(*this, std::move(error));
+}
+
+inline void
+NfsFileReader::ReadCallback(ReadRequest &request,
+			    const void *data, size_t size)
+{
+	assert(state == State::IDLE);
+	assert(!reads.empty());
+	assert(!request.IsDone());
+
+	if (&request != &reads.front()) {
+		/* an earlier request is still pending: keep a copy
+		   until it has finished */
+		request.data.reset(new uint8_t[size > 0 ? size : 1]);
+		memcpy(request.data.get(), data, size);
+		request.received = size;
+		return;
 	}
+
+	const bool short_read = size < request.size;
+	reads.pop_front();
+
+	if (short_read)
+		/* the following requests would leave a gap */
+		CancelRead();
+
+	OnNfsFileRead(data, size);
+
+	if (!short_read)
+		FlushReads();
+}
+
+void
+NfsFileReader::FlushReads()
+{
+	/* OnNfsFileRead() may submit new requests or cancel all of
+	   them, therefore the front is checked again after each
+	   call */
+	while (!reads.empty() && reads.front().IsDone()) {
+		const std::unique_ptr<uint8_t[]> data =
+			std::move(reads.front().data);
+		const size_t size = reads.front().received;
+		const bool short_read = size < reads.front().size;
+		reads.pop_front();
+
+		if (short_read)
+			CancelRead();
+
+		OnNfsFileRead(data.get(), size);
+	}
+}
+
+inline void
+NfsFileReader::ReadError(ReadRequest &request, Error &&error)
+{
+	assert(state == State::IDLE);
+
+	/* the request which has failed has already been removed from
+	   the NfsConnection; cancel the others */
+	for (auto i = reads.begin(); i != reads.end();) {
+		if (&*i != &request && !i->IsDone())
+			connection->Cancel(*i);
+		i = reads.erase(i);
+	}
+
+	OnNfsFileError(std::move(error));
 }
 
 void
@@ -230,7 +330,7 @@ NfsFileReader::StatCallback(const struct stat *st)
 }
 
 void
-NfsFileReader::OnNfsCallback(unsigned status, void *data)
+NfsFileReader::OnNfsCallback(gcc_unused unsigned status, void *data)
 {
 	switch (state) {
 	case State::INITIAL:
@@ -247,11 +347,6 @@ NfsFileReader::OnNfsCallback(unsigned status, void *data)
 	case State::STAT:
 		StatCallback((const struct stat *)data);
 		break;
-
-	case State::READ:
-		state = State::IDLE;
-		OnNfsFileRead(data, status);
-		break;
 	}
 }
 
@@ -276,10 +371,6 @@ NfsFileReader::OnNfsError(Error &&error)
 		connection->Close(fh);
 		state = State::INITIAL;
 		break;
-
-	case State::READ:
-		state = State::IDLE;
-		break;
 	}
 
 	OnNfsFileError(std::move(error));
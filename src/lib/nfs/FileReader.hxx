@@ -27,6 +27,8 @@
 #include "Compiler.h"
 
 #include <string>
+#include <list>
+#include <memory>
 
 #include <stdint.h>
 #include <stddef.h>
@@ -42,12 +44,53 @@ class NfsFileReader : NfsLease, NfsCallback, DeferredMonitor {
 		MOUNT,
 		OPEN,
 		STAT,
-		READ,
 		IDLE,
 	};
 
+	/**
+	 * One nfs_pread_async() call.  Several of them may be in
+	 * flight at the same time; their results are passed to
+	 * OnNfsFileRead() in the order they were submitted.
+	 */
+	class ReadRequest final : public NfsCallback {
+		NfsFileReader &reader;
+
+	public:
+		const size_t size;
+
+		/**
+		 * A copy of the data which has arrived before the
+		 * data of an earlier request; nullptr while the
+		 * request is still pending.
+		 */
+		std::unique_ptr<uint8_t[]> data;
+
+		/**
+		 * The number of bytes in #data.
+		 */
+		size_t received;
+
+		ReadRequest(NfsFileReader &_reader, size_t _size)
+			:reader(_reader), size(_size), received(0) {}
+
+		bool IsDone() const {
+			return data != nullptr;
+		}
+
+		/* virtual methods from NfsCallback */
+		void OnNfsCallback(unsigned status, void *data) override;
+		void OnNfsError(Error &&error) override;
+	};
+
 	State state;
 
+	/**
+	 * The pending read requests, in submission order.  Requests
+	 * which have finished stay here until all earlier ones have
+	 * finished.
+	 */
+	std::list<ReadRequest> reads;
+
 	std::string server, export_name;
 	const char *path;
 
@@ -63,13 +106,39 @@ public:
 	void DeferClose();
 
 	bool Open(const char *uri, Error &error);
+
+	/**
+	 * Submit a read request.  This may be called while earlier
+	 * requests are still pending; the results are passed to
+	 * OnNfsFileRead() in order.  If a request returns less data
+	 * than requested (e.g. at the end of the file), all
+	 * following requests are canceled.
+	 */
 	bool Read(uint64_t offset, size_t size, Error &error);
+
+	/**
+	 * Cancel all pending read requests.
+	 */
 	void CancelRead();
 
+	/**
+	 * Is the file open, with no read request pending?
+	 */
 	bool IsIdle() const {
-		return state == State::IDLE;
+		return state == State::IDLE && reads.empty();
 	}
 
+	unsigned GetPendingReads() const {
+		return reads.size();
+	}
+
+	/**
+	 * Returns the maximum size of a single READ call negotiated
+	 * with the server.  Only valid while the file is open.
+	 */
+	gcc_pure
+	size_t GetReadMax() const;
+
 protected:
 	virtual void OnNfsFileOpen(uint64_t size) = 0;
 	virtual void OnNfsFileRead(const void *data, size_t size) = 0;
@@ -85,6 +154,15 @@ private:
 	void OpenCallback(nfsfh *_fh);
 	void StatCallback(const struct stat *st);
 
+	void ReadCallback(ReadRequest &request, const void *data, size_t size);
+	void ReadError(ReadRequest &request, Error &&error);
+
+	/**
+	 * Pass the results of finished requests at the front of
+	 * #reads to OnNfsFileRead().
+	 */
+	void FlushReads();
+
 	/* virtual methods from NfsLease */
 	void OnNfsConnectionReady() final;
 	void OnNfsConnectionFailed(const Error &error) final;
@@ -29,6 +29,11 @@
 static Manual<NfsManager> nfs_glue;
 static unsigned in_use;
 
+/**
+ * The maximum number of sessions per NFS export.
+ */
+static unsigned nfs_max_sessions = 2;
+
 void
 nfs_init()
 {
@@ -49,11 +54,43 @@ nfs_finish()
 	BlockingCall(io_thread_get(), [](){ nfs_glue.Destruct(); });
 }
 
+void
+nfs_set_max_sessions(unsigned max_sessions)
+{
+	assert(in_use > 0);
+	assert(max_sessions > 0);
+
+	nfs_max_sessions = max_sessions;
+}
+
 NfsConnection &
 nfs_get_connection(const char *server, const char *export_name)
 {
 	assert(in_use > 0);
 	assert(io_thread_inside());
 
-	return nfs_glue->GetConnection(server, export_name);
+	return nfs_glue->GetConnection(server, export_name,
+				       nfs_max_sessions);
+}
+
+std::vector<NfsConnectionStats>
+nfs_get_stats()
+{
+	assert(!io_thread_inside());
+
+	std::vector<NfsConnectionStats> result;
+	if (in_use == 0)
+		return result;
+
+	BlockingCall(io_thread_get(), [&result](){
+			nfs_glue->ForEach([&result](const NfsConnection &c){
+					result.push_back({c.GetServer(),
+							  c.GetExportName(),
+							  c.GetRoundTripTime(),
+							  c.GetQueueDepth(),
+							  c.GetLeaseCount()});
+				});
+		});
+
+	return result;
 }
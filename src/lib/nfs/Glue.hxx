@@ -23,16 +23,58 @@
 #include "check.h"
 #include "Compiler.h"
 
+#include <string>
+#include <vector>
+
 class NfsConnection;
 
+/**
+ * Diagnostic information about one NFS session.
+ */
+struct NfsConnectionStats {
+	std::string server, export_name;
+
+	/**
+	 * The smoothed round trip time in microseconds.
+	 */
+	unsigned rtt_us;
+
+	/**
+	 * The number of operations in flight.
+	 */
+	unsigned queue_depth;
+
+	/**
+	 * The number of users of this session.
+	 */
+	unsigned leases;
+};
+
 void
 nfs_init();
 
 void
 nfs_finish();
 
-gcc_pure
+/**
+ * Configure the maximum number of sessions per NFS export.  Must be
+ * called after nfs_init().
+ */
+void
+nfs_set_max_sessions(unsigned max_sessions);
+
+/**
+ * Obtain a session to the specified export; the least busy one is
+ * chosen.  Must be called from the I/O thread.
+ */
 NfsConnection &
 nfs_get_connection(const char *server, const char *export_name);
 
+/**
+ * Collect diagnostic information about all NFS sessions.  Must not
+ * be called from the I/O thread.
+ */
+std::vector<NfsConnectionStats>
+nfs_get_stats();
+
 #endif
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "Manager.hxx"
+#include "Domain.hxx"
 #include "event/Loop.hxx"
 #include "Log.hxx"
 
@@ -71,23 +72,40 @@ NfsManager::~NfsManager()
 }
 
 NfsConnection &
-NfsManager::GetConnection(const char *server, const char *export_name)
+NfsManager::GetConnection(const char *server, const char *export_name,
+			  unsigned max_sessions)
 {
 	assert(server != nullptr);
 	assert(export_name != nullptr);
+	assert(max_sessions > 0);
 	assert(GetEventLoop().IsInside());
 
-	Map::insert_commit_data hint;
-	auto result = connections.insert_check(LookupKey{server, export_name},
-					       Compare(), hint);
-	if (result.second) {
-		auto c = new ManagedConnection(*this, GetEventLoop(),
-					       server, export_name);
-		connections.insert_commit(*c, hint);
-		return *c;
-	} else {
-		return *result.first;
+	const auto range = connections.equal_range(LookupKey{server,
+							     export_name},
+						   Compare());
+
+	ManagedConnection *best = nullptr;
+	unsigned best_load = 0, n = 0;
+	for (auto i = range.first; i != range.second; ++i, ++n) {
+		const unsigned load = i->GetLoad();
+		if (best == nullptr || load < best_load) {
+			best = &*i;
+			best_load = load;
+		}
 	}
+
+	if (best != nullptr && (best_load == 0 || n >= max_sessions))
+		return *best;
+
+	auto c = new ManagedConnection(*this, GetEventLoop(),
+				       server, export_name);
+	connections.insert(range.second, *c);
+
+	if (n > 0)
+		FormatDebug(nfs_domain, "Opening NFS session %u to %s:%s",
+			    n + 1, server, export_name);
+
+	return *c;
 }
 
 void
@@ -30,7 +30,10 @@
 
 /**
  * A manager for NFS connections.  Handles multiple connections to
- * multiple NFS servers.
+ * multiple NFS servers.  Each export may have a small pool of
+ * sessions (i.e. separate connections), so unrelated operations
+ * (e.g. playback reads and the database update) do not queue behind
+ * each other.
  */
 class NfsManager final : IdleMonitor {
 	struct LookupKey {
@@ -64,12 +67,20 @@ class NfsManager final : IdleMonitor {
 		gcc_pure
 		bool operator()(const ManagedConnection &a,
 				const LookupKey b) const;
+
+		gcc_pure
+		bool operator()(const ManagedConnection &a,
+				const ManagedConnection &b) const {
+			return (*this)(a, LookupKey{b.GetServer(),
+						    b.GetExportName()});
+		}
 	};
 
 	/**
-	 * Maps server and export_name to #ManagedConnection.
+	 * Maps server and export_name to #ManagedConnection.  There
+	 * may be several sessions with the same key.
 	 */
-	typedef boost::intrusive::set<ManagedConnection,
+	typedef boost::intrusive::multiset<ManagedConnection,
 				      boost::intrusive::compare<Compare>,
 				      boost::intrusive::constant_time_size<false>> Map;
 
@@ -93,9 +104,23 @@ public:
 	 */
 	~NfsManager();
 
-	gcc_pure
+	/**
+	 * Returns the least busy session to the specified export.
+	 * A new session is established if all existing sessions are
+	 * busy and there are fewer than the given maximum.
+	 */
 	NfsConnection &GetConnection(const char *server,
-				     const char *export_name);
+				     const char *export_name,
+				     unsigned max_sessions);
+
+	/**
+	 * Invoke the function for each session.
+	 */
+	template<typename F>
+	void ForEach(F &&f) const {
+		for (const auto &c : connections)
+			f(c);
+	}
 
 private:
 	void ScheduleDelete(ManagedConnection &c) {
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Context.hxx"
+#include "Init.hxx"
+#include "Mutex.hxx"
+#include "util/Error.hxx"
+
+SmbclientContext *
+SmbclientContext::New(Error &error)
+{
+	/* creating and initializing a context modifies global
+	   libsmbclient state */
+	const ScopeLock protect(smbclient_mutex);
+
+	SMBCCTX *ctx = smbc_new_context();
+	if (ctx == nullptr) {
+		error.SetErrno("smbc_new_context() failed");
+		return nullptr;
+	}
+
+	smbc_setFunctionAuthData(ctx, mpd_smbc_get_auth_data);
+
+	SMBCCTX *ctx2 = smbc_init_context(ctx);
+	if (ctx2 == nullptr) {
+		error.SetErrno("smbc_init_context() failed");
+		smbc_free_context(ctx, 1);
+		return nullptr;
+	}
+
+	return new SmbclientContext(ctx2);
+}
+
+SmbclientContext::~SmbclientContext()
+{
+	const ScopeLock protect(smbclient_mutex);
+	smbc_free_context(ctx, 1);
+}
+
+SMBCFILE *
+SmbclientContext::Open(const char *url, int flags, Error &error)
+{
+	const ScopeLock protect(mutex);
+
+	SMBCFILE *file = smbc_getFunctionOpen(ctx)(ctx, url, flags, 0);
+	if (file == nullptr)
+		error.FormatErrno("Failed to open %s", url);
+	return file;
+}
+
+bool
+SmbclientContext::Stat(const char *url, struct stat &st, Error &error)
+{
+	const ScopeLock protect(mutex);
+
+	if (smbc_getFunctionStat(ctx)(ctx, url, &st) < 0) {
+		error.FormatErrno("Failed to stat %s", url);
+		return false;
+	}
+
+	return true;
+}
+
+bool
+SmbclientContext::Stat(SMBCFILE *file, struct stat &st, Error &error)
+{
+	const ScopeLock protect(mutex);
+
+	if (smbc_getFunctionFstat(ctx)(ctx, file, &st) < 0) {
+		error.SetErrno("smbc_fstat() failed");
+		return false;
+	}
+
+	return true;
+}
+
+ssize_t
+SmbclientContext::Read(SMBCFILE *file, void *buffer, size_t size,
+		       Error &error)
+{
+	const ScopeLock protect(mutex);
+
+	ssize_t nbytes = smbc_getFunctionRead(ctx)(ctx, file, buffer, size);
+	if (nbytes < 0)
+		error.SetErrno("smbc_read() failed");
+	return nbytes;
+}
+
+bool
+SmbclientContext::Seek(SMBCFILE *file, off_t offset, Error &error)
+{
+	const ScopeLock protect(mutex);
+
+	if (smbc_getFunctionLseek(ctx)(ctx, file, offset, SEEK_SET) < 0) {
+		error.SetErrno("smbc_lseek() failed");
+		return false;
+	}
+
+	return true;
+}
+
+void
+SmbclientContext::Close(SMBCFILE *file)
+{
+	const ScopeLock protect(mutex);
+	smbc_getFunctionClose(ctx)(ctx, file);
+}
+
+SMBCFILE *
+SmbclientContext::OpenDirectory(const char *url, Error &error)
+{
+	const ScopeLock protect(mutex);
+
+	SMBCFILE *dir = smbc_getFunctionOpendir(ctx)(ctx, url);
+	if (dir == nullptr)
+		error.FormatErrno("Failed to open directory %s", url);
+	return dir;
+}
+
+const struct smbc_dirent *
+SmbclientContext::ReadDirectory(SMBCFILE *dir)
+{
+	const ScopeLock protect(mutex);
+	return smbc_getFunctionReaddir(ctx)(ctx, dir);
+}
+
+#ifdef HAVE_SMBC_READDIRPLUS
+
+const struct libsmb_file_info *
+SmbclientContext::ReadDirectoryPlus(SMBCFILE *dir)
+{
+	const ScopeLock protect(mutex);
+	return smbc_getFunctionReaddirPlus(ctx)(ctx, dir);
+}
+
+#endif
+
+void
+SmbclientContext::CloseDirectory(SMBCFILE *dir)
+{
+	const ScopeLock protect(mutex);
+	smbc_getFunctionClosedir(ctx)(ctx, dir);
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_SMBCLIENT_CONTEXT_HXX
+#define MPD_SMBCLIENT_CONTEXT_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+
+#include <libsmbclient.h>
+
+#include <utility>
+
+class Error;
+
+/**
+ * Wrapper for a libsmbclient context (SMBCCTX).  Unlike the
+ * "compat" API (smbc_open() etc.), which shares one implicit context
+ * and therefore needs the global #smbclient_mutex, operations on
+ * different #SmbclientContext objects may run in parallel.  Each
+ * object has its own mutex which serializes operations on it.
+ */
+class SmbclientContext {
+	Mutex mutex;
+
+	SMBCCTX *ctx;
+
+	explicit SmbclientContext(SMBCCTX *_ctx):ctx(_ctx) {}
+
+public:
+	~SmbclientContext();
+
+	SmbclientContext(const SmbclientContext &) = delete;
+	SmbclientContext &operator=(const SmbclientContext &) = delete;
+
+	/**
+	 * Create and initialize a new context.  SmbclientInit() must
+	 * have been called already.
+	 *
+	 * @return the new object (to be freed with delete) or nullptr
+	 * on error
+	 */
+	static SmbclientContext *New(Error &error);
+
+	SMBCFILE *Open(const char *url, int flags, Error &error);
+	bool Stat(const char *url, struct stat &st, Error &error);
+	bool Stat(SMBCFILE *file, struct stat &st, Error &error);
+	ssize_t Read(SMBCFILE *file, void *buffer, size_t size,
+		     Error &error);
+	bool Seek(SMBCFILE *file, off_t offset, Error &error);
+	void Close(SMBCFILE *file);
+
+	SMBCFILE *OpenDirectory(const char *url, Error &error);
+
+	/**
+	 * Read the next directory entry.  The returned pointer is
+	 * valid until the next call on this directory handle.
+	 */
+	const struct smbc_dirent *ReadDirectory(SMBCFILE *dir);
+
+#ifdef HAVE_SMBC_READDIRPLUS
+	/**
+	 * Read the next directory entry together with its
+	 * attributes, which the server sends with the directory
+	 * listing.  The returned pointer is valid until the next call
+	 * on this directory handle.
+	 */
+	const struct libsmb_file_info *ReadDirectoryPlus(SMBCFILE *dir);
+#endif
+
+	void CloseDirectory(SMBCFILE *dir);
+};
+
+#endif
@@ -27,7 +27,7 @@
 
 #include <string.h>
 
-static void
+void
 mpd_smbc_get_auth_data(gcc_unused const char *srv,
 		       gcc_unused const char *shr,
 		       char *wg, gcc_unused int wglen,
@@ -30,4 +30,14 @@ class Error;
 bool
 SmbclientInit(Error &error);
 
+/**
+ * The authentication callback for libsmbclient.  It is installed by
+ * SmbclientInit() and on each #SmbclientContext.
+ */
+void
+mpd_smbc_get_auth_data(const char *srv, const char *shr,
+		       char *wg, int wglen,
+		       char *un, int unlen,
+		       char *pw, int pwlen);
+
 #endif
@@ -24,6 +24,7 @@
 #include "ixmlwrap.hxx"
 #include "Util.hxx"
 #include "Action.hxx"
+#include "util/NumberParser.hxx"
 #include "util/UriUtil.hxx"
 #include "util/Error.hxx"
 
@@ -92,3 +93,41 @@ ContentDirectoryService::getSearchCapabilities(UpnpClient_Handle hdl,
 	ixmlDocument_free(response);
 	return success;
 }
+
+bool
+ContentDirectoryService::getSystemUpdateID(UpnpClient_Handle hdl,
+					   unsigned &result,
+					   Error &error) const
+{
+	IXML_Document *request =
+		UpnpMakeAction("GetSystemUpdateID", m_serviceType.c_str(),
+			       0,
+			       nullptr, nullptr);
+	if (request == 0) {
+		error.Set(upnp_domain, "UpnpMakeAction() failed");
+		return false;
+	}
+
+	IXML_Document *response;
+	auto code = UpnpSendAction(hdl, m_actionURL.c_str(),
+				   m_serviceType.c_str(),
+				   0 /*devUDN*/, request, &response);
+	ixmlDocument_free(request);
+	if (code != UPNP_E_SUCCESS) {
+		error.Format(upnp_domain, code,
+			     "UpnpSendAction() failed: %s",
+			     UpnpGetErrorMessage(code));
+		return false;
+	}
+
+	const char *s = ixmlwrap::getFirstElementValue(response, "Id");
+	if (s == nullptr || *s == 0) {
+		ixmlDocument_free(response);
+		error.Set(upnp_domain, "Bad response");
+		return false;
+	}
+
+	result = ParseUnsigned(s);
+	ixmlDocument_free(response);
+	return true;
+}
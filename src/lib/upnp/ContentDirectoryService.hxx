@@ -122,6 +122,14 @@ public:
 				   std::list<std::string> &result,
 				   Error &error) const;
 
+	/**
+	 * Retrieve the "SystemUpdateID" state variable, which the
+	 * server changes whenever any object in its directory is
+	 * modified.
+	 */
+	bool getSystemUpdateID(UpnpClient_Handle handle, unsigned &result,
+			       Error &error) const;
+
 	gcc_pure
 	std::string GetURI() const {
 		return "upnp://" + m_deviceId + "/" + m_serviceType;
@@ -218,6 +218,9 @@ UPnPDeviceDirectory::ExpireDevices(Error &error)
 	for (auto it = directories.begin();
 	     it != directories.end();) {
 		if (now > it->expires) {
+			if (listener != nullptr)
+				AnnounceLostUPnP(*listener, it->device);
+
 			it = directories.erase(it);
 			didsomething = true;
 		} else {
@@ -307,6 +310,13 @@ UPnPDeviceDirectory::GetDirectories(std::vector<ContentDirectoryService> &out,
 	return true;
 }
 
+bool
+UPnPDeviceDirectory::Expire(Error &error)
+{
+	const ScopeLock protect(mutex);
+	return ExpireDevices(error);
+}
+
 bool
 UPnPDeviceDirectory::GetServer(const char *friendly_name,
 			       ContentDirectoryService &server,
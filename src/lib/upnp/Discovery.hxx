@@ -124,6 +124,12 @@ public:
 	/** Retrieve the directory services currently seen on the network */
 	bool GetDirectories(std::vector<ContentDirectoryService> &, Error &);
 
+	/**
+	 * Get rid of the devices which have not been seen for too
+	 * long, see ExpireDevices().
+	 */
+	bool Expire(Error &error);
+
 	/**
 	 * Get server by friendly name.
 	 */
@@ -137,7 +143,7 @@ private:
 	/**
 	 * Look at the devices and get rid of those which have not
 	 * been seen for too long. We do this when listing the top
-	 * directory.
+	 * directory.  The listener is notified about each of them.
 	 *
 	 * Caller must lock #mutex.
 	 */
@@ -0,0 +1,520 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Service.hxx"
+#include "Table.hxx"
+#include "MusicChunk.hxx"
+#include "DetachedSong.hxx"
+#include "db/Interface.hxx"
+#include "db/LightSong.hxx"
+#include "db/Selection.hxx"
+#include "storage/StorageInterface.hxx"
+#include "sticker/StickerDatabase.hxx"
+#include "pcm/PcmFormat.hxx"
+#include "ThreadConfig.hxx"
+#include "system/FatalError.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#ifndef NDEBUG
+#include "event/Loop.hxx"
+#endif
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static constexpr Domain loudness_domain("loudness");
+
+/**
+ * The number of chunks in each worker's #MusicBuffer.  The decoder
+ * does not need to run ahead, this just avoids ping-pong.
+ */
+static constexpr unsigned LOUDNESS_BUFFER_CHUNKS = 16;
+
+/**
+ * The chunks of each worker's #MusicBuffer which do not count
+ * against the "audio_buffer_budget".  This is enough for the decoder
+ * to make progress.
+ */
+static constexpr unsigned LOUDNESS_RESERVE_CHUNKS = 4;
+
+/**
+ * The MixRamp points are measured at these levels [dBFS]: from
+ * #MIX_RAMP_MIN_DB to 0 in steps of #MIX_RAMP_STEP_DB.
+ */
+static constexpr int MIX_RAMP_MIN_DB = -60;
+static constexpr int MIX_RAMP_STEP_DB = 3;
+
+constexpr double LoudnessService::REFERENCE_LOUDNESS;
+constexpr const char *LoudnessService::STICKER_NAME;
+constexpr const char *LoudnessService::MIX_RAMP_START_STICKER;
+constexpr const char *LoudnessService::MIX_RAMP_END_STICKER;
+
+/**
+ * Format the MixRamp points in the syntax of the "mixramp_start" and
+ * "mixramp_end" tags: "DB SECONDS" pairs separated by semicolons,
+ * with increasing levels.
+ *
+ * @return an empty string if no level was reached
+ */
+static std::string
+FormatMixRamp(const PcmMixRampMeter &meter, bool end)
+{
+	std::string result;
+
+	for (int db = MIX_RAMP_MIN_DB; db <= 0; db += MIX_RAMP_STEP_DB) {
+		const double t = end ? meter.FindEnd(db) : meter.FindStart(db);
+		if (t < 0)
+			break;
+
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%s%d.00 %.2f",
+			 result.empty() ? "" : ";", db, t);
+		result.append(buffer);
+	}
+
+	return result;
+}
+
+LoudnessService::Worker::Worker(LoudnessService &_service)
+	:service(_service),
+	 dc(dc_mutex, dc_cond),
+	 buffer(LOUDNESS_BUFFER_CHUNKS, DEFAULT_CHUNK_SIZE,
+		LOUDNESS_RESERVE_CHUNKS)
+{
+	dc.background = true;
+}
+
+void
+LoudnessService::Worker::Start()
+{
+	Error error;
+	if (!thread.Start(Run, this, error))
+		FatalError(error);
+}
+
+void
+LoudnessService::Worker::Join()
+{
+	thread.Join();
+}
+
+void
+LoudnessService::Worker::Wake()
+{
+	dc.Lock();
+	dc.client_cond.signal();
+	dc.Unlock();
+}
+
+MusicChunk *
+LoudnessService::Worker::WaitChunk()
+{
+	while (true) {
+		MusicChunk *chunk = pipe.Shift();
+		if (chunk != nullptr)
+			return chunk;
+
+		const ScopeLock protect(dc.mutex);
+
+		/* check the pipe again while holding the lock; the
+		   decoder signals only after it has pushed a chunk */
+		if (!pipe.IsEmpty())
+			continue;
+
+		if (dc.IsIdle() || service.cancel)
+			return nullptr;
+
+		dc.WaitForDecoder();
+	}
+}
+
+void
+LoudnessService::Worker::ReturnChunk(MusicChunk *chunk)
+{
+	buffer.Return(chunk);
+
+	dc.Lock();
+	dc.Signal();
+	dc.Unlock();
+}
+
+bool
+LoudnessService::Worker::Analyze(const Job &job, Result &result)
+{
+	DetachedSong *song = new DetachedSong(job.uri.c_str());
+	song->SetRealURI(job.real_uri);
+
+	dc.Start(song, job.start_time, job.end_time, buffer, pipe);
+
+	AudioFormat format = AudioFormat::Undefined();
+	bool has_replay_gain = false, has_mix_ramp = false;
+	bool success = true;
+
+	MusicChunk *chunk;
+	while ((chunk = WaitChunk()) != nullptr) {
+		if (chunk->replay_gain_serial != 0)
+			has_replay_gain = true;
+
+		if (chunk->length > 0) {
+			if (!format.IsDefined()) {
+				dc.Lock();
+				format = dc.out_audio_format;
+				has_mix_ramp = dc.GetMixRampStart() != nullptr &&
+					dc.GetMixRampEnd() != nullptr;
+				dc.Unlock();
+
+				meter.Open(format.sample_rate,
+					   format.channels);
+				mix_ramp_meter.Open(format.sample_rate,
+						    format.channels);
+			}
+
+			if (has_replay_gain && has_mix_ramp) {
+				/* the song has all tags; no need to
+				   measure it */
+				ReturnChunk(chunk);
+				success = false;
+				break;
+			}
+
+			const auto f =
+				pcm_convert_to_float(pcm_buffer,
+						     format.format,
+						     {chunk->data,
+						      chunk->length});
+			if (f.IsNull()) {
+				/* DSD cannot be measured */
+				ReturnChunk(chunk);
+				success = false;
+				break;
+			}
+
+			const size_t n_frames = f.size / format.channels;
+			if (!has_replay_gain)
+				meter.Process(f.data, n_frames);
+			if (!has_mix_ramp)
+				mix_ramp_meter.Process(f.data, n_frames);
+		}
+
+		ReturnChunk(chunk);
+	}
+
+	dc.Stop();
+	pipe.Clear(buffer);
+
+	dc.Lock();
+	if (dc.HasFailed()) {
+		LogError(dc.GetError());
+		success = false;
+	}
+	dc.ClearError();
+	dc.Unlock();
+
+	if (!success || service.cancel || !format.IsDefined())
+		return false;
+
+	double loudness;
+	if (!has_replay_gain && meter.GetIntegratedLoudness(loudness)) {
+		/* silence is not measured */
+		result.tuple.gain = REFERENCE_LOUDNESS - loudness;
+		result.tuple.peak = meter.GetPeak();
+
+		FormatDebug(loudness_domain,
+			    "%s: %.2f LUFS, gain %.2f dB, peak %.6f",
+			    job.uri.c_str(), loudness,
+			    result.tuple.gain, result.tuple.peak);
+	}
+
+	if (!has_mix_ramp) {
+		result.mix_ramp.SetStart(FormatMixRamp(mix_ramp_meter, false));
+		result.mix_ramp.SetEnd(FormatMixRamp(mix_ramp_meter, true));
+	}
+
+	return result.tuple.IsDefined() || result.mix_ramp.IsDefined();
+}
+
+inline void
+LoudnessService::Worker::Run()
+{
+	SetThreadName("loudness");
+	SetThreadIdlePriority();
+	ApplyThreadConfig("loudness");
+
+	Job job;
+	while (service.PopJob(job)) {
+		Result result;
+		result.tuple.Clear();
+		Analyze(job, result);
+		result.uri = std::move(job.uri);
+
+		service.PushResult(std::move(result));
+	}
+
+	dc.Quit();
+	buffer.FlushThreadCache();
+
+	service.WorkerFinished();
+}
+
+void
+LoudnessService::Worker::Run(void *ctx)
+{
+	Worker &worker = *(Worker *)ctx;
+	worker.Run();
+}
+
+LoudnessService::LoudnessService(EventLoop &_loop, Storage &_storage,
+				 unsigned _n_threads)
+	:DeferredMonitor(_loop), storage(_storage),
+	 n_threads(_n_threads),
+	 rescan_db(nullptr),
+	 running(0), cancel(false)
+{
+	assert(n_threads > 0);
+}
+
+LoudnessService::~LoudnessService()
+{
+	if (!workers.empty()) {
+		mutex.lock();
+		queue.clear();
+		mutex.unlock();
+
+		cancel = true;
+
+		for (auto &worker : workers)
+			worker.Wake();
+
+		for (auto &worker : workers)
+			worker.Join();
+	}
+
+	loudness_table_clear();
+}
+
+static void
+LoadReplayGainSticker(const char *uri, const char *value,
+		      gcc_unused void *ctx)
+{
+	char *endptr;
+	ReplayGainTuple tuple;
+	tuple.gain = strtof(value, &endptr);
+	if (endptr == value || *endptr != ' ')
+		return;
+
+	tuple.peak = strtof(endptr + 1, &endptr);
+	if (*endptr != 0 || !tuple.IsDefined())
+		return;
+
+	loudness_table_set(uri, tuple);
+}
+
+static void
+LoadMixRampStartSticker(const char *uri, const char *value,
+			gcc_unused void *ctx)
+{
+	loudness_table_set_mix_ramp_start(uri, value);
+}
+
+static void
+LoadMixRampEndSticker(const char *uri, const char *value,
+		      gcc_unused void *ctx)
+{
+	loudness_table_set_mix_ramp_end(uri, value);
+}
+
+void
+LoudnessService::Load()
+{
+	Error error;
+	if (!sticker_find("song", "", STICKER_NAME, StickerOperator::EXISTS,
+			  nullptr, LoadReplayGainSticker, nullptr, error) ||
+	    !sticker_find("song", "", MIX_RAMP_START_STICKER,
+			  StickerOperator::EXISTS,
+			  nullptr, LoadMixRampStartSticker, nullptr, error) ||
+	    !sticker_find("song", "", MIX_RAMP_END_STICKER,
+			  StickerOperator::EXISTS,
+			  nullptr, LoadMixRampEndSticker, nullptr, error))
+		LogError(error);
+}
+
+void
+LoudnessService::Rescan(const Database &db)
+{
+	assert(GetEventLoop().IsInside());
+
+	if (!workers.empty()) {
+		/* scan again after the threads have finished */
+		rescan_db = &db;
+		return;
+	}
+
+	std::list<Job> jobs;
+
+	const auto f = [this, &jobs](const LightSong &song, Error &){
+		auto uri = song.GetURI();
+		if (skip.find(uri) != skip.end() ||
+		    loudness_table_contains(uri.c_str()))
+			return true;
+
+		Job job;
+		job.real_uri = song.real_uri != nullptr
+			? std::string(song.real_uri)
+			: storage.MapUTF8(uri.c_str());
+		job.uri = std::move(uri);
+		job.start_time = song.start_time;
+		job.end_time = song.end_time;
+		jobs.emplace_back(std::move(job));
+		return true;
+	};
+
+	Error error;
+	if (!db.Visit(DatabaseSelection("", true), f, error)) {
+		LogError(error);
+		return;
+	}
+
+	if (jobs.empty())
+		return;
+
+	const unsigned n = std::min<size_t>(n_threads, jobs.size());
+
+	FormatDebug(loudness_domain, "analyzing %u songs in %u threads",
+		    unsigned(jobs.size()), n);
+
+	mutex.lock();
+	queue = std::move(jobs);
+	running = n;
+	mutex.unlock();
+
+	for (unsigned i = 0; i < n; ++i) {
+		workers.emplace_front(*this);
+		workers.front().Start();
+	}
+}
+
+bool
+LoudnessService::PopJob(Job &job)
+{
+	const ScopeLock protect(mutex);
+	if (cancel || queue.empty())
+		return false;
+
+	job = std::move(queue.front());
+	queue.pop_front();
+	return true;
+}
+
+void
+LoudnessService::PushResult(Result &&result)
+{
+	mutex.lock();
+	results.emplace_back(std::move(result));
+	mutex.unlock();
+
+	DeferredMonitor::Schedule();
+}
+
+void
+LoudnessService::WorkerFinished()
+{
+	mutex.lock();
+	assert(running > 0);
+	--running;
+	mutex.unlock();
+
+	DeferredMonitor::Schedule();
+}
+
+void
+LoudnessService::StoreResult(const Result &result)
+{
+	const char *uri = result.uri.c_str();
+	Error error;
+
+	if (result.tuple.IsDefined()) {
+		loudness_table_set(uri, result.tuple);
+
+		char value[64];
+		snprintf(value, sizeof(value), "%.2f %.6f",
+			 result.tuple.gain, result.tuple.peak);
+
+		if (!sticker_store_value("song", uri, STICKER_NAME,
+					 value, error)) {
+			LogError(error);
+			error.Clear();
+		}
+	}
+
+	const char *start = result.mix_ramp.GetStart();
+	if (start != nullptr) {
+		loudness_table_set_mix_ramp_start(uri, start);
+
+		if (!sticker_store_value("song", uri, MIX_RAMP_START_STICKER,
+					 start, error)) {
+			LogError(error);
+			error.Clear();
+		}
+	}
+
+	const char *end = result.mix_ramp.GetEnd();
+	if (end != nullptr) {
+		loudness_table_set_mix_ramp_end(uri, end);
+
+		if (!sticker_store_value("song", uri, MIX_RAMP_END_STICKER,
+					 end, error))
+			LogError(error);
+	}
+}
+
+void
+LoudnessService::RunDeferred()
+{
+	mutex.lock();
+	std::list<Result> r = std::move(results);
+	results.clear();
+	const bool finished = running == 0;
+	mutex.unlock();
+
+	for (const auto &i : r) {
+		if (i.tuple.IsDefined() || i.mix_ramp.IsDefined())
+			StoreResult(i);
+		else
+			skip.insert(i.uri);
+	}
+
+	if (finished && !workers.empty()) {
+		for (auto &worker : workers)
+			worker.Join();
+		workers.clear();
+
+		const Database *db = rescan_db;
+		rescan_db = nullptr;
+		if (db != nullptr)
+			Rescan(*db);
+	}
+}
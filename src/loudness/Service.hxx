@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_LOUDNESS_SERVICE_HXX
+#define MPD_LOUDNESS_SERVICE_HXX
+
+#include "check.h"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
+#include "Chrono.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicPipe.hxx"
+#include "decoder/DecoderControl.hxx"
+#include "pcm/LoudnessMeter.hxx"
+#include "pcm/MixRampMeter.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "Compiler.h"
+
+#include <atomic>
+#include <forward_list>
+#include <list>
+#include <string>
+#include <unordered_set>
+
+class Database;
+class Storage;
+struct MusicChunk;
+
+/**
+ * Measures the loudness and the MixRamp points of songs without such
+ * tags in low-priority threads, using the regular decoder thread
+ * code.  One decoder pass yields both.  The results are stored as
+ * "replay_gain", "mixramp_start" and "mixramp_end" stickers and in
+ * the loudness table (see Table.hxx), which the decoder thread
+ * applies when such a song is played.
+ */
+class LoudnessService final : DeferredMonitor {
+	struct Job {
+		std::string uri, real_uri;
+		SongTime start_time, end_time;
+	};
+
+	struct Result {
+		std::string uri;
+
+		/**
+		 * The gain, or an undefined tuple if the song could
+		 * not be measured (or if it has ReplayGain tags).
+		 */
+		ReplayGainTuple tuple;
+
+		/**
+		 * The MixRamp points; undefined if the song could not
+		 * be measured (or if it has MixRamp tags).
+		 */
+		MixRampInfo mix_ramp;
+	};
+
+	/**
+	 * One analysis thread with its own decoder thread.
+	 */
+	class Worker {
+		LoudnessService &service;
+
+		Thread thread;
+
+		/**
+		 * The #DecoderControl::mutex and
+		 * #DecoderControl::client_cond of #dc.
+		 */
+		Mutex dc_mutex;
+		Cond dc_cond;
+
+		DecoderControl dc;
+		MusicBuffer buffer;
+		MusicPipe pipe;
+
+		PcmLoudnessMeter meter;
+		PcmMixRampMeter mix_ramp_meter;
+		PcmBuffer pcm_buffer;
+
+	public:
+		explicit Worker(LoudnessService &_service);
+
+		void Start();
+		void Join();
+
+		/**
+		 * Wake up the thread if it waits for the decoder,
+		 * after #LoudnessService::cancel has been set.
+		 */
+		void Wake();
+
+	private:
+		/**
+		 * Decode a song and measure it.
+		 *
+		 * @return false if nothing was measured
+		 */
+		bool Analyze(const Job &job, Result &result);
+
+		/**
+		 * Wait for the next chunk from the decoder.
+		 *
+		 * @return nullptr if the decoder has finished or if
+		 * the service is being cancelled
+		 */
+		MusicChunk *WaitChunk();
+
+		/**
+		 * Returns a chunk to the #MusicBuffer and wakes up
+		 * the decoder, which may be waiting for a free chunk.
+		 */
+		void ReturnChunk(MusicChunk *chunk);
+
+		void Run();
+		static void Run(void *ctx);
+	};
+
+	Storage &storage;
+
+	/**
+	 * The maximum number of #Worker threads.
+	 */
+	const unsigned n_threads;
+
+	/**
+	 * Songs which do not need to be analyzed again while this
+	 * process runs: they have all tags or they failed.  Only
+	 * accessed by the main thread.
+	 */
+	std::unordered_set<std::string> skip;
+
+	/**
+	 * If not nullptr, then this database was modified while the
+	 * threads were running; it will be scanned again afterwards.
+	 */
+	const Database *rescan_db;
+
+	std::forward_list<Worker> workers;
+
+	/**
+	 * Protects #queue, #results and #running.
+	 */
+	Mutex mutex;
+
+	std::list<Job> queue;
+
+	std::list<Result> results;
+
+	/**
+	 * The number of #Worker threads which have not finished yet.
+	 */
+	unsigned running;
+
+	/**
+	 * Set by the destructor to make the threads exit.
+	 */
+	std::atomic_bool cancel;
+
+public:
+	/**
+	 * A gain which makes songs as loud as this (in LUFS), see
+	 * ReplayGain 2.0.
+	 */
+	static constexpr double REFERENCE_LOUDNESS = -18;
+
+	/**
+	 * The name of the sticker which stores the measured gain.
+	 */
+	static constexpr const char *STICKER_NAME = "replay_gain";
+
+	static constexpr const char *MIX_RAMP_START_STICKER = "mixramp_start";
+	static constexpr const char *MIX_RAMP_END_STICKER = "mixramp_end";
+
+	LoudnessService(EventLoop &_loop, Storage &_storage,
+			unsigned _n_threads);
+	~LoudnessService();
+
+	/**
+	 * Load the results of previous runs from the sticker database
+	 * into the loudness table.
+	 */
+	void Load();
+
+	/**
+	 * Queue all songs of the database which have not been
+	 * analyzed yet, and start the threads.
+	 */
+	void Rescan(const Database &db);
+
+private:
+	/**
+	 * Called by a #Worker to obtain the next job.
+	 *
+	 * @return false if there is no more work
+	 */
+	bool PopJob(Job &job);
+
+	void PushResult(Result &&result);
+
+	/**
+	 * Called by a #Worker before its thread exits.
+	 */
+	void WorkerFinished();
+
+	void StoreResult(const Result &result);
+
+	/* virtual methods from class DeferredMonitor */
+	virtual void RunDeferred() override;
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Table.hxx"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
+#include "thread/Mutex.hxx"
+
+#include <string>
+#include <unordered_map>
+
+struct LoudnessTableEntry {
+	ReplayGainTuple tuple;
+	MixRampInfo mix_ramp;
+
+	LoudnessTableEntry() {
+		tuple.Clear();
+	}
+};
+
+static Mutex loudness_table_mutex;
+
+static std::unordered_map<std::string, LoudnessTableEntry> loudness_table;
+
+void
+loudness_table_set(const char *uri, const ReplayGainTuple &tuple)
+{
+	const ScopeLock protect(loudness_table_mutex);
+	loudness_table[uri].tuple = tuple;
+}
+
+void
+loudness_table_set_mix_ramp_start(const char *uri, const char *value)
+{
+	const ScopeLock protect(loudness_table_mutex);
+	loudness_table[uri].mix_ramp.SetStart(value);
+}
+
+void
+loudness_table_set_mix_ramp_end(const char *uri, const char *value)
+{
+	const ScopeLock protect(loudness_table_mutex);
+	loudness_table[uri].mix_ramp.SetEnd(value);
+}
+
+bool
+loudness_table_get(const char *uri, ReplayGainInfo &info,
+		   MixRampInfo &mix_ramp)
+{
+	const ScopeLock protect(loudness_table_mutex);
+	if (loudness_table.empty())
+		return false;
+
+	const auto i = loudness_table.find(uri);
+	if (i == loudness_table.end())
+		return false;
+
+	info.Clear();
+	if (i->second.tuple.IsDefined()) {
+		info.tuples[REPLAY_GAIN_TRACK] = i->second.tuple;
+		info.Complete();
+	}
+
+	mix_ramp = i->second.mix_ramp;
+	return true;
+}
+
+bool
+loudness_table_contains(const char *uri)
+{
+	const ScopeLock protect(loudness_table_mutex);
+	return loudness_table.find(uri) != loudness_table.end();
+}
+
+void
+loudness_table_clear()
+{
+	const ScopeLock protect(loudness_table_mutex);
+	loudness_table.clear();
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_LOUDNESS_TABLE_HXX
+#define MPD_LOUDNESS_TABLE_HXX
+
+#include "Compiler.h"
+
+struct ReplayGainTuple;
+struct ReplayGainInfo;
+class MixRampInfo;
+
+/**
+ * Remember the track gain which was measured by the
+ * #LoudnessService for a song.
+ *
+ * This table may be accessed by any thread.
+ *
+ * @param uri the song URI (relative to the music directory)
+ */
+void
+loudness_table_set(const char *uri, const ReplayGainTuple &tuple);
+
+/**
+ * Remember the MixRamp start points (see #MixRampInfo) which were
+ * measured by the #LoudnessService for a song.
+ */
+void
+loudness_table_set_mix_ramp_start(const char *uri, const char *value);
+
+/**
+ * Like loudness_table_set_mix_ramp_start(), but for the end points.
+ */
+void
+loudness_table_set_mix_ramp_end(const char *uri, const char *value);
+
+/**
+ * Look up the measured gain and MixRamp points of a song, to be used
+ * for songs without such tags.  Either may be undefined.
+ *
+ * @return true if the song was found
+ */
+bool
+loudness_table_get(const char *uri, ReplayGainInfo &info,
+		   MixRampInfo &mix_ramp);
+
+gcc_pure
+bool
+loudness_table_contains(const char *uri);
+
+void
+loudness_table_clear();
+
+#endif
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_METRICS_COUNTER_HXX
+#define MPD_METRICS_COUNTER_HXX
+
+#include "Compiler.h"
+
+#include <atomic>
+
+#include <stdint.h>
+
+/**
+ * A monotonic counter which may be incremented by any thread
+ * without locking.
+ */
+class MetricCounter {
+	std::atomic<uint64_t> value;
+
+public:
+	constexpr MetricCounter():value(0) {}
+
+	MetricCounter(const MetricCounter &) = delete;
+	MetricCounter &operator=(const MetricCounter &) = delete;
+
+	void Add(uint64_t n=1) {
+		value.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	gcc_pure
+	uint64_t Get() const {
+		return value.load(std::memory_order_relaxed);
+	}
+};
+
+/**
+ * A value which may be set by any thread without locking.
+ */
+class MetricGauge {
+	std::atomic<int64_t> value;
+
+public:
+	constexpr MetricGauge():value(0) {}
+
+	MetricGauge(const MetricGauge &) = delete;
+	MetricGauge &operator=(const MetricGauge &) = delete;
+
+	void Set(int64_t _value) {
+		value.store(_value, std::memory_order_relaxed);
+	}
+
+	gcc_pure
+	int64_t Get() const {
+		return value.load(std::memory_order_relaxed);
+	}
+};
+
+/**
+ * A histogram with fixed bucket boundaries.  Observe() is lock-free;
+ * a reader may see a sample in its bucket before it has been added
+ * to the sum, which is harmless for monitoring.
+ *
+ * @param N the number of finite upper bounds; there is an implicit
+ * "+Inf" bucket
+ */
+template<unsigned N>
+class MetricHistogram {
+	const double (&bounds)[N];
+
+	/**
+	 * The number of samples in each bucket (not cumulative).
+	 */
+	std::atomic<uint64_t> counts[N + 1];
+
+	std::atomic<double> sum;
+
+public:
+	/**
+	 * @param _bounds the upper bounds of the buckets in
+	 * ascending order; the array must outlive this object
+	 */
+	explicit MetricHistogram(const double (&_bounds)[N])
+		:bounds(_bounds), sum(0) {
+		for (auto &i : counts)
+			i.store(0, std::memory_order_relaxed);
+	}
+
+	MetricHistogram(const MetricHistogram &) = delete;
+	MetricHistogram &operator=(const MetricHistogram &) = delete;
+
+	static constexpr unsigned GetBucketCount() {
+		return N;
+	}
+
+	void Observe(double value) {
+		unsigned i = 0;
+		while (i < N && value > bounds[i])
+			++i;
+
+		counts[i].fetch_add(1, std::memory_order_relaxed);
+
+		double old = sum.load(std::memory_order_relaxed);
+		while (!sum.compare_exchange_weak(old, old + value,
+						  std::memory_order_relaxed))
+			;
+	}
+
+	/**
+	 * Returns the upper bound of the specified bucket.
+	 */
+	double GetBound(unsigned i) const {
+		return bounds[i];
+	}
+
+	/**
+	 * Returns the number of samples in the specified bucket,
+	 * excluding the lower buckets; #N is the "+Inf" bucket.
+	 */
+	gcc_pure
+	uint64_t GetCount(unsigned i) const {
+		return counts[i].load(std::memory_order_relaxed);
+	}
+
+	gcc_pure
+	double GetSum() const {
+		return sum.load(std::memory_order_relaxed);
+	}
+};
+
+#endif
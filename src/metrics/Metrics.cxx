@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Metrics.hxx"
+#include "Writer.hxx"
+#include "Instance.hxx"
+#include "Partition.hxx"
+#include "MusicBuffer.hxx"
+#include "Stats.hxx"
+#include "output/MultipleOutputs.hxx"
+#include "output/Internal.hxx"
+#include "client/ClientList.hxx"
+#include "command/AllCommands.hxx"
+#include "tag/TagPool.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/DatabaseLock.hxx"
+#endif
+
+const double update_duration_bounds[6] = {
+	1, 10, 60, 300, 1800, 7200,
+};
+
+GlobalMetrics global_metrics;
+
+static void
+CollectPlayer(OpenMetricsWriter &w, PlayerControl &pc)
+{
+	w.Family("mpd_play_time_seconds", "counter",
+		 "Time spent playing since MPD was started");
+	w.Sample("mpd_play_time_seconds", "_total", nullptr, nullptr,
+		 pc.GetTotalPlayTime());
+
+	w.Gauge("mpd_pipe_chunks",
+		"Chunks queued between the decoder and the outputs",
+		global_metrics.pipe_chunks.Get());
+
+	const auto buffer_stats = MusicBuffer::GetStats();
+	w.Gauge("mpd_buffer_chunks",
+		"Chunks reserved in the audio buffer",
+		buffer_stats.chunks);
+	w.Gauge("mpd_buffer_free_chunks",
+		"Audio buffer chunks which are not in use",
+		buffer_stats.chunks - buffer_stats.chunks_in_use);
+	w.Gauge("mpd_buffer_borrowed_chunks",
+		"Audio buffer chunks borrowed from the audio_buffer_budget",
+		buffer_stats.chunks_borrowed);
+
+	const auto s = pc.GetStatistics();
+	w.Gauge("mpd_decoder_realtime_factor",
+		"Decoding speed of the current song relative to real time",
+		s.decoder.GetSpeed());
+
+	w.Counter("mpd_player_stalls",
+		  "Playback interruptions because the decoder was too slow",
+		  global_metrics.player_stalls.Get());
+}
+
+static void
+CollectOutputs(OpenMetricsWriter &w, const MultipleOutputs &outputs)
+{
+	const unsigned n = outputs.Size();
+
+	w.Family("mpd_output_chunks_played", "counter",
+		 "Chunks played by the audio output");
+	for (unsigned i = 0; i < n; ++i) {
+		const AudioOutput &ao = outputs.Get(i);
+		w.Sample("mpd_output_chunks_played", "_total",
+			 "output", ao.name,
+			 uint64_t(ao.chunks_played.load()));
+	}
+
+	w.Family("mpd_output_xruns", "counter",
+		 "Buffer underruns reported by the audio output");
+	for (unsigned i = 0; i < n; ++i) {
+		const AudioOutput &ao = outputs.Get(i);
+		w.Sample("mpd_output_xruns", "_total",
+			 "output", ao.name,
+			 uint64_t(ao.xruns.load()));
+	}
+
+	w.Family("mpd_output_latency_seconds", "gauge",
+		 "Audio queued in the output device");
+	for (unsigned i = 0; i < n; ++i) {
+		const AudioOutput &ao = outputs.Get(i);
+		w.Sample("mpd_output_latency_seconds", "",
+			 "output", ao.name,
+			 ao.latency_us.load() / 1000000.);
+	}
+}
+
+#ifdef ENABLE_DATABASE
+
+static void
+CollectDatabase(OpenMetricsWriter &w)
+{
+	w.Histogram("mpd_update_duration_seconds",
+		    "Duration of database updates",
+		    global_metrics.update_duration);
+
+	const auto lock_stats = db_lock_get_stats();
+	w.Family("mpd_db_lock_acquisitions", "counter",
+		 "Acquisitions of the database lock");
+	w.Sample("mpd_db_lock_acquisitions", "_total", "mode", "shared",
+		 uint64_t(lock_stats.shared));
+	w.Sample("mpd_db_lock_acquisitions", "_total", "mode", "exclusive",
+		 uint64_t(lock_stats.exclusive));
+
+	w.Counter("mpd_db_lock_contended",
+		  "Database lock acquisitions which had to wait",
+		  lock_stats.contended);
+
+	w.Family("mpd_db_lock_wait_seconds", "counter",
+		 "Time spent waiting for the database lock");
+	w.Sample("mpd_db_lock_wait_seconds", "_total", nullptr, nullptr,
+		 lock_stats.wait_us / 1000000.);
+}
+
+#endif
+
+void
+metrics_collect(Instance &instance, std::string &out)
+{
+	OpenMetricsWriter w(out);
+
+	w.Gauge("mpd_uptime_seconds", "Time since MPD was started",
+		stats_get_uptime());
+
+	w.Gauge("mpd_clients", "Connected clients",
+		instance.client_list->GetSize());
+
+	command_write_metrics(w);
+
+	CollectPlayer(w, instance.partition->pc);
+	CollectOutputs(w, instance.partition->outputs);
+
+#ifdef ENABLE_DATABASE
+	CollectDatabase(w);
+#endif
+
+	w.Gauge("mpd_tag_pool_items", "Distinct tag values in the pool",
+		tag_pool_get_stats().items);
+
+	w.Finish();
+}
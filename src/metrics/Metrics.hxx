@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_METRICS_HXX
+#define MPD_METRICS_HXX
+
+#include "Counter.hxx"
+
+#include <string>
+
+struct Instance;
+
+/**
+ * The bucket bounds of #GlobalMetrics::update_duration [seconds].
+ */
+extern const double update_duration_bounds[6];
+
+/**
+ * Metrics which are updated from hot paths and do not belong to an
+ * object which could be queried instead.
+ */
+struct GlobalMetrics {
+	/**
+	 * The number of chunks in the player's #MusicPipe, sampled
+	 * by the player thread each time it sends a chunk to the
+	 * outputs.
+	 */
+	MetricGauge pipe_chunks;
+
+	/**
+	 * The number of times the #MusicPipe ran empty while the
+	 * decoder was still busy; see PlayerStatistics::stalls.
+	 */
+	MetricCounter player_stalls;
+
+	/**
+	 * The duration of database updates.
+	 */
+	MetricHistogram<6> update_duration;
+
+	GlobalMetrics():update_duration(update_duration_bounds) {}
+};
+
+extern GlobalMetrics global_metrics;
+
+/**
+ * Generate the OpenMetrics document describing this MPD instance.
+ * Must be called in the main thread.
+ */
+void
+metrics_collect(Instance &instance, std::string &out);
+
+#endif
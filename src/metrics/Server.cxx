@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Server.hxx"
+#include "Metrics.hxx"
+#include "event/ServerSocket.hxx"
+#include "event/FullyBufferedSocket.hxx"
+#include "event/TimeoutMonitor.hxx"
+#include "net/SocketAddress.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <string>
+
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static constexpr Domain metrics_domain("metrics");
+
+/**
+ * Close connections which have not sent a complete request after
+ * this duration [seconds].
+ */
+static constexpr unsigned METRICS_REQUEST_TIMEOUT = 10;
+
+/**
+ * Refuse more connections than this.
+ */
+static constexpr unsigned METRICS_MAX_CONNECTIONS = 16;
+
+class MetricsServer;
+
+/* TimeoutMonitor has a list hook already; this one needs a tag */
+struct MetricsConnectionTag;
+typedef boost::intrusive::list_base_hook<boost::intrusive::tag<MetricsConnectionTag>,
+					 boost::intrusive::link_mode<boost::intrusive::normal_link>> MetricsConnectionHook;
+
+/**
+ * One HTTP connection to the #MetricsServer.  It answers a single
+ * request and closes the connection.
+ */
+class MetricsConnection final
+	: FullyBufferedSocket, TimeoutMonitor,
+	  public MetricsConnectionHook {
+	MetricsServer &server;
+
+public:
+	MetricsConnection(MetricsServer &_server, EventLoop &_loop, int _fd)
+		:FullyBufferedSocket(_fd, _loop, 16384, 4 * 1024 * 1024),
+		 TimeoutMonitor(_loop),
+		 server(_server) {
+		TimeoutMonitor::ScheduleSeconds(METRICS_REQUEST_TIMEOUT);
+	}
+
+	using FullyBufferedSocket::IsDefined;
+
+	void Close() {
+		if (FullyBufferedSocket::IsDefined())
+			FullyBufferedSocket::Close();
+	}
+
+private:
+	/**
+	 * Close the socket and schedule the destruction of this
+	 * object.  It is deferred because the caller may still
+	 * access the socket object.
+	 */
+	void Finish() {
+		Close();
+		TimeoutMonitor::Schedule(0);
+	}
+
+	void SendResponse(const char *status, const std::string &body,
+			  bool head);
+
+	void HandleRequest(const char *request, size_t length);
+
+	/* virtual methods from class BufferedSocket */
+	InputResult OnSocketInput(void *data, size_t length) override;
+	void OnSocketError(Error &&error) override;
+	void OnSocketClosed() override;
+
+	/* virtual methods from class FullyBufferedSocket */
+	bool OnSocketDrained() override;
+
+	/* virtual methods from class TimeoutMonitor */
+	void OnTimeout() override;
+};
+
+class MetricsServer final : public ServerSocket {
+	Instance &instance;
+
+	typedef boost::intrusive::list<MetricsConnection,
+				       boost::intrusive::base_hook<MetricsConnectionHook>,
+				       boost::intrusive::constant_time_size<true>> ConnectionList;
+	ConnectionList connections;
+
+public:
+	MetricsServer(EventLoop &_loop, Instance &_instance)
+		:ServerSocket(_loop), instance(_instance) {}
+
+	~MetricsServer() {
+		connections.clear_and_dispose([](MetricsConnection *c){
+				c->Close();
+				delete c;
+			});
+	}
+
+	Instance &GetInstance() {
+		return instance;
+	}
+
+	void Remove(MetricsConnection &c) {
+		connections.erase(connections.iterator_to(c));
+		delete &c;
+	}
+
+private:
+	void OnAccept(int fd, gcc_unused SocketAddress address,
+		      gcc_unused int uid) override {
+		if (connections.size() >= METRICS_MAX_CONNECTIONS) {
+			close(fd);
+			return;
+		}
+
+		connections.push_front(*new MetricsConnection(*this,
+							      GetEventLoop(),
+							      fd));
+	}
+};
+
+static MetricsServer *metrics_server;
+
+void
+MetricsConnection::SendResponse(const char *status, const std::string &body,
+				bool head)
+{
+	char header[256];
+	int length = snprintf(header, sizeof(header),
+			      "HTTP/1.1 %s\r\n"
+			      "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+			      "Content-Length: %lu\r\n"
+			      "Connection: close\r\n"
+			      "\r\n",
+			      status, (unsigned long)body.length());
+
+	if (!Write(header, length))
+		return;
+
+	if (!head)
+		Write(body.data(), body.length());
+}
+
+inline void
+MetricsConnection::HandleRequest(const char *request, size_t length)
+{
+	const char *end = (const char *)memchr(request, '\n', length);
+	std::string line(request, end != nullptr ? end : request + length);
+
+	bool head = false;
+	const char *path;
+	if (line.compare(0, 4, "GET ") == 0)
+		path = line.c_str() + 4;
+	else if (line.compare(0, 5, "HEAD ") == 0) {
+		path = line.c_str() + 5;
+		head = true;
+	} else {
+		SendResponse("405 Method Not Allowed", std::string(), false);
+		return;
+	}
+
+	const char *space = strchr(path, ' ');
+	const std::string uri = space != nullptr
+		? std::string(path, space)
+		: std::string(path);
+
+	if (uri != "/metrics" && uri != "/") {
+		SendResponse("404 Not Found", std::string(), head);
+		return;
+	}
+
+	std::string body;
+	metrics_collect(server.GetInstance(), body);
+	SendResponse("200 OK", body, head);
+}
+
+BufferedSocket::InputResult
+MetricsConnection::OnSocketInput(void *data, size_t length)
+{
+	/* wait until the whole request header has been received;
+	   the body (if any) is ignored */
+	const char *p = (const char *)data;
+	size_t i = 0;
+	while (true) {
+		const char *lf = (const char *)memchr(p + i, '\n', length - i);
+		if (lf == nullptr)
+			return InputResult::MORE;
+
+		i = lf + 1 - p;
+		if (i < length && p[i] == '\n')
+			break;
+		if (i + 1 < length && p[i] == '\r' && p[i + 1] == '\n')
+			break;
+	}
+
+	TimeoutMonitor::Cancel();
+	HandleRequest(p, length);
+
+	if (!IsDefined())
+		/* an error has occurred */
+		return InputResult::CLOSED;
+
+	ConsumeInput(length);
+	return InputResult::PAUSE;
+}
+
+void
+MetricsConnection::OnSocketError(Error &&error)
+{
+	LogDebug(metrics_domain, error.GetMessage());
+	Finish();
+}
+
+void
+MetricsConnection::OnSocketClosed()
+{
+	Finish();
+}
+
+bool
+MetricsConnection::OnSocketDrained()
+{
+	/* the response has been sent completely */
+	Finish();
+	return false;
+}
+
+void
+MetricsConnection::OnTimeout()
+{
+	Close();
+	server.Remove(*this);
+}
+
+bool
+metrics_global_init(EventLoop &loop, Instance &instance, Error &error)
+{
+	const unsigned port = config_get_unsigned(ConfigOption::METRICS_PORT,
+						  0);
+	if (port == 0)
+		return true;
+
+	const char *address =
+		config_get_string(ConfigOption::METRICS_BIND_TO_ADDRESS,
+				  nullptr);
+
+	metrics_server = new MetricsServer(loop, instance);
+
+	/* HTTP clients send their request first */
+	metrics_server->SetDeferAccept(true);
+
+	const bool success = address == nullptr || strcmp(address, "any") == 0
+		? metrics_server->AddPort(port, error)
+		: metrics_server->AddHost(address, port, error);
+	if (!success || !metrics_server->Open(error)) {
+		delete metrics_server;
+		metrics_server = nullptr;
+		error.FormatPrefix("Failed to listen on metrics port %u: ",
+				   port);
+		return false;
+	}
+
+	return true;
+}
+
+void
+metrics_global_finish()
+{
+	delete metrics_server;
+}
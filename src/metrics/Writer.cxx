@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Writer.hxx"
+
+#include <stdio.h>
+
+static void
+AppendUnsigned(std::string &out, uint64_t value)
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)value);
+	out.append(buffer);
+}
+
+static void
+AppendDouble(std::string &out, double value)
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.9g", value);
+	out.append(buffer);
+}
+
+/**
+ * Append a label value, escaping backslash, double quote and line
+ * feed.
+ */
+static void
+AppendEscaped(std::string &out, const char *value)
+{
+	for (; *value != 0; ++value) {
+		switch (*value) {
+		case '\\':
+			out.append("\\\\");
+			break;
+
+		case '"':
+			out.append("\\\"");
+			break;
+
+		case '\n':
+			out.append("\\n");
+			break;
+
+		default:
+			out.push_back(*value);
+		}
+	}
+}
+
+void
+OpenMetricsWriter::Family(const char *name, const char *type,
+			  const char *help)
+{
+	out.append("# TYPE ");
+	out.append(name);
+	out.push_back(' ');
+	out.append(type);
+	out.append("\n# HELP ");
+	out.append(name);
+	out.push_back(' ');
+	out.append(help);
+	out.push_back('\n');
+}
+
+void
+OpenMetricsWriter::BeginSample(const char *name, const char *suffix,
+			       const char *label_name,
+			       const char *label_value)
+{
+	out.append(name);
+	out.append(suffix);
+
+	if (label_name != nullptr) {
+		out.push_back('{');
+		out.append(label_name);
+		out.append("=\"");
+		AppendEscaped(out, label_value);
+		out.append("\"}");
+	}
+
+	out.push_back(' ');
+}
+
+void
+OpenMetricsWriter::Sample(const char *name, const char *suffix,
+			  const char *label_name, const char *label_value,
+			  uint64_t value)
+{
+	BeginSample(name, suffix, label_name, label_value);
+	AppendUnsigned(out, value);
+	out.push_back('\n');
+}
+
+void
+OpenMetricsWriter::Sample(const char *name, const char *suffix,
+			  const char *label_name, const char *label_value,
+			  double value)
+{
+	BeginSample(name, suffix, label_name, label_value);
+	AppendDouble(out, value);
+	out.push_back('\n');
+}
+
+void
+OpenMetricsWriter::Bucket(const char *name,
+			  const char *label_name, const char *label_value,
+			  const double *bound, uint64_t count)
+{
+	out.append(name);
+	out.append("_bucket{");
+
+	if (label_name != nullptr) {
+		out.append(label_name);
+		out.append("=\"");
+		AppendEscaped(out, label_value);
+		out.append("\",");
+	}
+
+	out.append("le=\"");
+	if (bound != nullptr)
+		AppendDouble(out, *bound);
+	else
+		out.append("+Inf");
+	out.append("\"} ");
+	AppendUnsigned(out, count);
+	out.push_back('\n');
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_METRICS_WRITER_HXX
+#define MPD_METRICS_WRITER_HXX
+
+#include "Counter.hxx"
+
+#include <string>
+
+#include <stdint.h>
+
+/**
+ * Generates the OpenMetrics text exposition format.  Each metric
+ * family begins with a Family() call, followed by its samples;
+ * Finish() terminates the document.
+ */
+class OpenMetricsWriter {
+	std::string &out;
+
+public:
+	explicit OpenMetricsWriter(std::string &_out):out(_out) {}
+
+	/**
+	 * Begin a metric family: write its "TYPE" and "HELP" lines.
+	 *
+	 * @param type "counter", "gauge" or "histogram"
+	 */
+	void Family(const char *name, const char *type, const char *help);
+
+	/**
+	 * Write one sample.
+	 *
+	 * @param suffix appended to the family name, e.g. "_total"
+	 * @param label_name the name of the one label, or nullptr
+	 * if the sample has no label
+	 */
+	void Sample(const char *name, const char *suffix,
+		    const char *label_name, const char *label_value,
+		    uint64_t value);
+
+	void Sample(const char *name, const char *suffix,
+		    const char *label_name, const char *label_value,
+		    double value);
+
+	/**
+	 * Write a counter family with one unlabelled sample.
+	 */
+	void Counter(const char *name, const char *help, uint64_t value) {
+		Family(name, "counter", help);
+		Sample(name, "_total", nullptr, nullptr, value);
+	}
+
+	/**
+	 * Write a gauge family with one unlabelled sample.
+	 */
+	void Gauge(const char *name, const char *help, double value) {
+		Family(name, "gauge", help);
+		Sample(name, "", nullptr, nullptr, value);
+	}
+
+	template<unsigned N>
+	void Histogram(const char *name, const char *help,
+		       const MetricHistogram<N> &histogram) {
+		Family(name, "histogram", help);
+		HistogramSamples(name, nullptr, nullptr, histogram);
+	}
+
+	/**
+	 * Write the samples of one histogram in a family which was
+	 * started with Family(name, "histogram", ...).  Call this
+	 * once per label value.
+	 */
+	template<unsigned N>
+	void HistogramSamples(const char *name,
+			      const char *label_name, const char *label_value,
+			      const MetricHistogram<N> &histogram) {
+		uint64_t count = 0;
+		for (unsigned i = 0; i < N; ++i) {
+			count += histogram.GetCount(i);
+			double bound = histogram.GetBound(i);
+			Bucket(name, label_name, label_value, &bound, count);
+		}
+
+		count += histogram.GetCount(N);
+		Bucket(name, label_name, label_value, nullptr, count);
+
+		Sample(name, "_count", label_name, label_value, count);
+		Sample(name, "_sum", label_name, label_value,
+		       histogram.GetSum());
+	}
+
+	/**
+	 * Terminate the document.
+	 */
+	void Finish() {
+		out.append("# EOF\n");
+	}
+
+private:
+	void BeginSample(const char *name, const char *suffix,
+			 const char *label_name, const char *label_value);
+
+	/**
+	 * @param bound the upper bound of the bucket, or nullptr for
+	 * "+Inf"
+	 */
+	void Bucket(const char *name,
+		    const char *label_name, const char *label_value,
+		    const double *bound, uint64_t count);
+};
+
+#endif
@@ -73,6 +73,13 @@ class AlsaMixer final : public Mixer {
 	long volume_max;
 	int volume_set;
 
+	/**
+	 * The volume which was last read from the element, updated
+	 * by alsa_mixer_elem_callback().  GetVolume() returns it
+	 * without talking to the device.
+	 */
+	int cached_volume;
+
 	AlsaMixerMonitor *monitor;
 
 public:
@@ -85,6 +92,23 @@ public:
 	void Configure(const ConfigBlock &block);
 	bool Setup(Error &error);
 
+	/**
+	 * The element's value has changed: refresh #cached_volume and
+	 * notify the listener.
+	 */
+	void OnElementChanged();
+
+private:
+	/**
+	 * Read the current volume from the element (which libasound
+	 * keeps up to date while handling events).
+	 *
+	 * @return the volume or -1 on error
+	 */
+	int ReadVolume(Error &error) const;
+
+public:
+
 	/* virtual methods from class Mixer */
 	virtual bool Open(Error &error) override;
 	virtual void Close() override;
@@ -148,10 +172,8 @@ alsa_mixer_elem_callback(snd_mixer_elem_t *elem, unsigned mask)
 	AlsaMixer &mixer = *(AlsaMixer *)
 		snd_mixer_elem_get_callback_private(elem);
 
-	if (mask & SND_CTL_EVENT_MASK_VALUE) {
-		int volume = mixer.GetVolume(IgnoreError());
-		mixer.listener.OnMixerVolumeChanged(mixer, volume);
-	}
+	if (mask & SND_CTL_EVENT_MASK_VALUE)
+		mixer.OnElementChanged();
 
 	return 0;
 }
@@ -243,6 +265,10 @@ AlsaMixer::Setup(Error &error)
 	snd_mixer_selem_get_playback_volume_range(elem, &volume_min,
 						  &volume_max);
 
+	cached_volume = ReadVolume(error);
+	if (cached_volume < 0)
+		return false;
+
 	snd_mixer_elem_set_callback_private(elem, this);
 	snd_mixer_elem_set_callback(elem, alsa_mixer_elem_callback);
 
@@ -284,35 +310,22 @@ AlsaMixer::Close()
 	snd_mixer_close(handle);
 }
 
-inline int
-AlsaMixer::GetVolume(Error &error)
+int
+AlsaMixer::ReadVolume(Error &error) const
 {
-	int err;
-	int ret;
 	long level;
-
-	assert(handle != nullptr);
-
-	err = snd_mixer_handle_events(handle);
-	if (err < 0) {
-		error.Format(alsa_mixer_domain, err,
-			     "snd_mixer_handle_events() failed: %s",
-			     snd_strerror(err));
-		return false;
-	}
-
-	err = snd_mixer_selem_get_playback_volume(elem,
-						  SND_MIXER_SCHN_FRONT_LEFT,
-						  &level);
+	int err = snd_mixer_selem_get_playback_volume(elem,
+						      SND_MIXER_SCHN_FRONT_LEFT,
+						      &level);
 	if (err < 0) {
 		error.Format(alsa_mixer_domain, err,
 			     "failed to read ALSA volume: %s",
 			     snd_strerror(err));
-		return false;
+		return -1;
 	}
 
-	ret = ((volume_set / 100.0) * (volume_max - volume_min)
-	       + volume_min) + 0.5;
+	int ret = ((volume_set / 100.0) * (volume_max - volume_min)
+		   + volume_min) + 0.5;
 	if (volume_set > 0 && ret == level) {
 		ret = volume_set;
 	} else {
@@ -323,6 +336,28 @@ AlsaMixer::GetVolume(Error &error)
 	return ret;
 }
 
+inline void
+AlsaMixer::OnElementChanged()
+{
+	Error error;
+	cached_volume = ReadVolume(error);
+	if (cached_volume < 0)
+		LogError(error);
+
+	listener.OnMixerVolumeChanged(*this, cached_volume);
+}
+
+inline int
+AlsaMixer::GetVolume(gcc_unused Error &error)
+{
+	assert(handle != nullptr);
+
+	/* no need to ask the device: AlsaMixerMonitor handles its
+	   events, and alsa_mixer_elem_callback() updates the
+	   cache */
+	return cached_volume;
+}
+
 inline bool
 AlsaMixer::SetVolume(unsigned volume, Error &error)
 {
@@ -348,6 +383,7 @@ AlsaMixer::SetVolume(unsigned volume, Error &error)
 		return false;
 	}
 
+	cached_volume = volume_set;
 	return true;
 }
 
@@ -32,6 +32,8 @@
 #include <pulse/stream.h>
 #include <pulse/subscribe.h>
 
+#include <atomic>
+
 #include <assert.h>
 
 class PulseMixer final : public Mixer {
@@ -40,10 +42,17 @@ class PulseMixer final : public Mixer {
 	bool online;
 	struct pa_cvolume volume;
 
+	/**
+	 * A copy of GetVolumeInternal(), updated whenever #online or
+	 * #volume change.  GetVolume() reads it without locking the
+	 * PulseAudio main loop.
+	 */
+	std::atomic_int cached_volume;
+
 public:
 	PulseMixer(PulseOutput &_output, MixerListener &_listener)
 		:Mixer(pulse_mixer_plugin, _listener),
-		 output(_output), online(false)
+		 output(_output), online(false), cached_volume(-1)
 	{
 	}
 
@@ -73,6 +82,7 @@ PulseMixer::Offline()
 		return;
 
 	online = false;
+	cached_volume = -1;
 
 	listener.OnMixerVolumeChanged(*this, -1);
 }
@@ -91,7 +101,9 @@ PulseMixer::VolumeCallback(const pa_sink_input_info *i, int eol)
 	online = true;
 	volume = i->volume;
 
-	listener.OnMixerVolumeChanged(*this, GetVolumeInternal(IgnoreError()));
+	const int new_volume = GetVolumeInternal(IgnoreError());
+	cached_volume = new_volume;
+	listener.OnMixerVolumeChanged(*this, new_volume);
 }
 
 /**
@@ -182,12 +194,8 @@ PulseMixer::~PulseMixer()
 int
 PulseMixer::GetVolume(gcc_unused Error &error)
 {
-	pulse_output_lock(output);
-
-	int result = GetVolumeInternal(error);
-	pulse_output_unlock(output);
-
-	return result;
+	/* the subscription keeps the cache up to date */
+	return cached_volume;
 }
 
 /**
@@ -216,8 +224,10 @@ PulseMixer::SetVolume(unsigned new_volume, Error &error)
 	pa_cvolume_set(&cvolume, volume.channels,
 		       (pa_volume_t)new_volume * PA_VOLUME_NORM / 100 + 0.5);
 	bool success = pulse_output_set_volume(output, &cvolume, error);
-	if (success)
+	if (success) {
 		volume = cvolume;
+		cached_volume = GetVolumeInternal(IgnoreError());
+	}
 
 	pulse_output_unlock(output);
 	return success;
@@ -20,17 +20,16 @@
 #ifndef MPD_NEIGHBOR_EXPLORER_HXX
 #define MPD_NEIGHBOR_EXPLORER_HXX
 
-#include <forward_list>
-
 class Error;
 class NeighborListener;
-struct NeighborInfo;
 
 /**
  * An object that explores the neighborhood for music servers.
  *
  * As soon as this object is opened, it will start exploring, and
- * notify the #NeighborListener when it found or lost something.
+ * notify the #NeighborListener when it found or lost something.  The
+ * listener is the only way to report neighbors; the list is kept by
+ * #NeighborGlue.
  *
  * The implementation is supposed to be non-blocking.  This can be
  * implemented either using the #EventLoop instance that was passed to
@@ -45,8 +44,6 @@ protected:
 		:listener(_listener) {}
 
 public:
-	typedef std::forward_list<NeighborInfo> List;
-
 	/**
 	 * Free instance data.
          */
@@ -61,11 +58,6 @@ public:
          * Stop exploring.
 	 */
 	virtual void Close() = 0;
-
-	/**
-	 * Obtain a list of currently known neighbors.
-	 */
-	virtual List GetList() const = 0;
 };
 
 #endif
@@ -28,6 +28,8 @@
 #include "config/Block.hxx"
 #include "util/Error.hxx"
 
+#include <algorithm>
+
 NeighborGlue::Explorer::~Explorer()
 {
 	delete explorer;
@@ -57,12 +59,14 @@ CreateNeighborExplorer(EventLoop &loop, NeighborListener &listener,
 }
 
 bool
-NeighborGlue::Init(EventLoop &loop, NeighborListener &listener, Error &error)
+NeighborGlue::Init(EventLoop &loop, NeighborListener &_listener, Error &error)
 {
+	listener = &_listener;
+
 	for (const auto *block = config_get_block(ConfigBlockOption::NEIGHBORS);
 	     block != nullptr; block = block->next) {
 		NeighborExplorer *explorer =
-			CreateNeighborExplorer(loop, listener, *block, error);
+			CreateNeighborExplorer(loop, *this, *block, error);
 		if (explorer == nullptr) {
 			error.FormatPrefix("Line %i: ", block->line);
 			return false;
@@ -100,12 +104,54 @@ NeighborGlue::Close()
 NeighborGlue::List
 NeighborGlue::GetList() const
 {
-	List result;
+	const ScopeLock protect(mutex);
+	return list;
+}
+
+void
+NeighborGlue::FoundNeighbor(const NeighborInfo &info)
+{
+	{
+		const ScopeLock protect(mutex);
+
+		auto i = std::find_if(list.begin(), list.end(),
+				      [&info](const NeighborInfo &n){
+					      return n.uri == info.uri;
+				      });
+		if (i == list.end())
+			list.push_front(info);
+		else if (i->display_name != info.display_name)
+			i->display_name = info.display_name;
+		else
+			/* no change */
+			return;
+	}
 
-	for (const auto &i : explorers)
-		result.splice_after(result.before_begin(),
-				    i.explorer->GetList());
+	listener->FoundNeighbor(info);
+}
+
+void
+NeighborGlue::LostNeighbor(const NeighborInfo &info)
+{
+	{
+		const ScopeLock protect(mutex);
+
+		auto prev = list.before_begin();
+		while (true) {
+			auto i = std::next(prev);
+			if (i == list.end())
+				/* not known */
+				return;
+
+			if (i->uri == info.uri) {
+				list.erase_after(prev);
+				break;
+			}
+
+			prev = i;
+		}
+	}
 
-	return result;
+	listener->LostNeighbor(info);
 }
 
@@ -21,6 +21,8 @@
 #define MPD_NEIGHBOR_ALL_HXX
 
 #include "check.h"
+#include "Listener.hxx"
+#include "Info.hxx"
 #include "Compiler.h"
 #include "thread/Mutex.hxx"
 
@@ -30,13 +32,15 @@ struct config_param;
 class Error;
 class EventLoop;
 class NeighborExplorer;
-class NeighborListener;
-struct NeighborInfo;
 
 /**
  * A class that initializes and opens all configured neighbor plugins.
+ *
+ * It listens to the events of all plugins and keeps the combined list
+ * of neighbors, so GetList() never needs to ask a plugin (which may
+ * have to wait for a scan or for the network).
  */
-class NeighborGlue {
+class NeighborGlue final : NeighborListener {
 	struct Explorer {
 		NeighborExplorer *const explorer;
 
@@ -45,13 +49,30 @@ class NeighborGlue {
 		~Explorer();
 	};
 
-	Mutex mutex;
-
 	std::forward_list<Explorer> explorers;
 
 public:
 	typedef std::forward_list<NeighborInfo> List;
 
+private:
+	/**
+	 * Receives all events after they have been applied to
+	 * #list.
+	 */
+	NeighborListener *listener = nullptr;
+
+	/**
+	 * Protects #list.
+	 */
+	mutable Mutex mutex;
+
+	/**
+	 * All neighbors which have been reported by the plugins.
+	 */
+	List list;
+
+public:
+
 	NeighborGlue() = default;
 	NeighborGlue(const NeighborGlue &) = delete;
 	~NeighborGlue();
@@ -71,6 +92,11 @@ public:
 	 */
 	gcc_pure
 	List GetList() const;
+
+private:
+	/* virtual methods from class NeighborListener */
+	void FoundNeighbor(const NeighborInfo &info) override;
+	void LostNeighbor(const NeighborInfo &info) override;
 };
 
 #endif
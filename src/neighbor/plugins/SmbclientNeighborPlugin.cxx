@@ -37,37 +37,36 @@
 
 #include <libsmbclient.h>
 
-#include <list>
-#include <algorithm>
+#include <forward_list>
+#include <string>
 
 class SmbclientNeighborExplorer final : public NeighborExplorer {
 	struct Server {
-		std::string name, comment;
+		NeighborInfo info;
 
+		/**
+		 * Has this server been seen by the current scan?
+		 */
 		bool alive;
 
-		Server(std::string &&_name, std::string &&_comment)
-			:name(std::move(_name)), comment(std::move(_comment)),
+		template<typename U, typename DN>
+		Server(U &&_uri, DN &&_display_name)
+			:info(std::forward<U>(_uri),
+			      std::forward<DN>(_display_name)),
 			 alive(true) {}
 		Server(const Server &) = delete;
-
-		gcc_pure
-		bool operator==(const Server &other) const {
-			return name == other.name;
-		}
-
-		gcc_pure
-		NeighborInfo Export() const {
-			return { "smb://" + name + "/", comment };
-		}
 	};
 
 	Thread thread;
 
-	mutable Mutex mutex;
+	Mutex mutex;
 	Cond cond;
 
-	List list;
+	/**
+	 * The servers which have been reported to the listener.  Only
+	 * accessed by the thread.
+	 */
+	std::forward_list<Server> servers;
 
 	bool quit;
 
@@ -78,10 +77,24 @@ public:
 	/* virtual methods from class NeighborExplorer */
 	virtual bool Open(Error &error) override;
 	virtual void Close() override;
-	virtual List GetList() const override;
 
 private:
+	/**
+	 * Scan the network.  New servers are reported to the
+	 * listener as soon as they are found; servers which have
+	 * disappeared are reported after the scan.
+	 */
 	void Run();
+
+	/**
+	 * Called by the scanner for each server it sees.
+	 */
+	void OnServer(std::string &&uri, std::string &&display_name);
+
+	bool ReadServers(const char *uri);
+	void ReadServers(int fd);
+	void ReadEntry(const smbc_dirent &e);
+
 	void ThreadFunc();
 	static void ThreadFunc(void *ctx);
 };
@@ -104,140 +117,99 @@ SmbclientNeighborExplorer::Close()
 	thread.Join();
 }
 
-NeighborExplorer::List
-SmbclientNeighborExplorer::GetList() const
-{
-	const ScopeLock protect(mutex);
-	/*
-	List list;
-	for (const auto &i : servers)
-		list.emplace_front(i.Export());
-	*/
-	return list;
-}
-
-static void
-ReadServer(NeighborExplorer::List &list, const smbc_dirent &e)
+void
+SmbclientNeighborExplorer::OnServer(std::string &&uri,
+				    std::string &&display_name)
 {
-	const std::string name(e.name, e.namelen);
-	const std::string comment(e.comment, e.commentlen);
+	for (auto &i : servers) {
+		if (i.info.uri == uri) {
+			i.alive = true;
 
-	list.emplace_front("smb://" + name, name + " (" + comment + ")");
-}
+			if (i.info.display_name != display_name) {
+				i.info.display_name = std::move(display_name);
+				listener.FoundNeighbor(i.info);
+			}
 
-static void
-ReadServers(NeighborExplorer::List &list, const char *uri);
+			return;
+		}
+	}
 
-static void
-ReadWorkgroup(NeighborExplorer::List &list, const std::string &name)
-{
-	std::string uri = "smb://" + name;
-	ReadServers(list, uri.c_str());
+	servers.emplace_front(std::move(uri), std::move(display_name));
+	listener.FoundNeighbor(servers.front().info);
 }
 
-static void
-ReadEntry(NeighborExplorer::List &list, const smbc_dirent &e)
+inline void
+SmbclientNeighborExplorer::ReadEntry(const smbc_dirent &e)
 {
 	switch (e.smbc_type) {
-	case SMBC_WORKGROUP:
-		ReadWorkgroup(list, std::string(e.name, e.namelen));
+	case SMBC_WORKGROUP: {
+		const std::string uri = "smb://" + std::string(e.name, e.namelen);
+		ReadServers(uri.c_str());
 		break;
+	}
+
+	case SMBC_SERVER: {
+		std::string name(e.name, e.namelen);
+		const std::string comment(e.comment, e.commentlen);
 
-	case SMBC_SERVER:
-		ReadServer(list, e);
+		std::string display_name = name + " (" + comment + ")";
+		OnServer("smb://" + name, std::move(display_name));
 		break;
 	}
+	}
 }
 
-static void
-ReadServers(NeighborExplorer::List &list, int fd)
+void
+SmbclientNeighborExplorer::ReadServers(int fd)
 {
 	smbc_dirent *e;
 	while ((e = smbc_readdir(fd)) != nullptr)
-		ReadEntry(list, *e);
-
-	smbc_closedir(fd);
+		ReadEntry(*e);
 }
 
-static void
-ReadServers(NeighborExplorer::List &list, const char *uri)
+bool
+SmbclientNeighborExplorer::ReadServers(const char *uri)
 {
 	int fd = smbc_opendir(uri);
-	if (fd >= 0) {
-		ReadServers(list, fd);
-		smbc_closedir(fd);
-	} else
+	if (fd < 0) {
 		FormatErrno(smbclient_domain, "smbc_opendir('%s') failed",
 			    uri);
-}
-
-gcc_pure
-static NeighborExplorer::List
-DetectServers()
-{
-	NeighborExplorer::List list;
-	const ScopeLock protect(smbclient_mutex);
-	ReadServers(list, "smb://");
-	return list;
-}
-
-gcc_pure
-static NeighborExplorer::List::const_iterator
-FindBeforeServerByURI(NeighborExplorer::List::const_iterator prev,
-		      NeighborExplorer::List::const_iterator end,
-		      const std::string &uri)
-{
-	for (auto i = std::next(prev); i != end; prev = i, i = std::next(prev))
-		if (i->uri == uri)
-			return prev;
+		return false;
+	}
 
-	return end;
+	ReadServers(fd);
+	smbc_closedir(fd);
+	return true;
 }
 
 inline void
 SmbclientNeighborExplorer::Run()
 {
-	List found = DetectServers(), lost;
+	for (auto &i : servers)
+		i.alive = false;
 
-	mutex.lock();
+	bool success;
 
-	const auto found_before_begin = found.before_begin();
-	const auto found_end = found.end();
-
-	for (auto prev = list.before_begin(), i = std::next(prev), end = list.end();
-	     i != end; i = std::next(prev)) {
-		auto f = FindBeforeServerByURI(found_before_begin, found_end,
-					       i->uri);
-		if (f != found_end) {
-			/* still visible: remove from "found" so we
-			   don't believe it's a new one */
-			*i = std::move(*std::next(f));
-			found.erase_after(f);
-			prev = i;
-		} else {
-			/* can't see it anymore: move to "lost" */
-#if CLANG_OR_GCC_VERSION(4,7)
-			lost.splice_after(lost.before_begin(), list, prev);
-#else
-			/* the forward_list::splice_after() lvalue
-			   reference overload is missing in gcc 4.6 */
-			lost.emplace_front(std::move(*i));
-			list.erase_after(prev);
-#endif
-		}
+	{
+		const ScopeLock protect(smbclient_mutex);
+		success = ReadServers("smb://");
 	}
 
-	for (auto prev = found_before_begin, i = std::next(prev);
-	     i != found_end; prev = i, i = std::next(prev))
-		list.push_front(*i);
+	if (!success)
+		/* the network is not available at all: keep the
+		   servers we know until the next scan */
+		return;
 
-	mutex.unlock();
-
-	for (auto &i : lost)
-		listener.LostNeighbor(i);
+	for (auto prev = servers.before_begin(), i = std::next(prev);
+	     i != servers.end(); i = std::next(prev)) {
+		if (i->alive) {
+			prev = i;
+			continue;
+		}
 
-	for (auto &i : found)
-		listener.FoundNeighbor(i);
+		listener.LostNeighbor(i->info);
+		servers.erase_after(prev);
+	}
 }
 
 inline void
@@ -27,10 +27,18 @@
 #include "neighbor/Explorer.hxx"
 #include "neighbor/Listener.hxx"
 #include "neighbor/Info.hxx"
+#include "event/TimeoutMonitor.hxx"
+#include "event/Call.hxx"
+#include "util/Error.hxx"
 #include "Log.hxx"
 
+/**
+ * How often are devices checked for expiry?
+ */
+static constexpr unsigned UPNP_EXPIRE_INTERVAL_S = 60;
+
 class UpnpNeighborExplorer final
-	: public NeighborExplorer, UPnPDiscoveryListener {
+	: public NeighborExplorer, UPnPDiscoveryListener, TimeoutMonitor {
 	struct Server {
 		std::string name, comment;
 
@@ -55,15 +63,17 @@ class UpnpNeighborExplorer final
 	UPnPDeviceDirectory *discovery;
 
 public:
-	UpnpNeighborExplorer(NeighborListener &_listener)
-		:NeighborExplorer(_listener) {}
+	UpnpNeighborExplorer(EventLoop &_loop, NeighborListener &_listener)
+		:NeighborExplorer(_listener), TimeoutMonitor(_loop) {}
 
 	/* virtual methods from class NeighborExplorer */
 	virtual bool Open(Error &error) override;
 	virtual void Close() override;
-	virtual List GetList() const override;
 
 private:
+	/* virtual methods from class TimeoutMonitor */
+	virtual void OnTimeout() override;
+
 	/* virtual methods from class UPnPDiscoveryListener */
 	virtual void FoundUPnP(const ContentDirectoryService &service) override;
 	virtual void LostUPnP(const ContentDirectoryService &service) override;
@@ -83,31 +93,34 @@ UpnpNeighborExplorer::Open(Error &error)
 		return false;
 	}
 
+	BlockingCall(TimeoutMonitor::GetEventLoop(), [this](){
+			ScheduleSeconds(UPNP_EXPIRE_INTERVAL_S);
+		});
+
 	return true;
 }
 
 void
 UpnpNeighborExplorer::Close()
 {
+	BlockingCall(TimeoutMonitor::GetEventLoop(), [this](){
+			Cancel();
+		});
+
 	delete discovery;
 	UpnpClientGlobalFinish();
 }
 
-NeighborExplorer::List
-UpnpNeighborExplorer::GetList() const
+void
+UpnpNeighborExplorer::OnTimeout()
 {
-	std::vector<ContentDirectoryService> tmp;
-
-	{
-		Error error;
-		if (!discovery->GetDirectories(tmp, error))
-			LogError(error);
-	}
+	/* devices which have not renewed their advertisement are
+	   reported with LostUPnP() */
+	Error error;
+	if (!discovery->Expire(error))
+		LogError(error);
 
-	List result;
-	for (const auto &i : tmp)
-		result.emplace_front(i.GetURI(), i.getFriendlyName());
-	return result;
+	ScheduleSeconds(UPNP_EXPIRE_INTERVAL_S);
 }
 
 void
@@ -125,12 +138,12 @@ UpnpNeighborExplorer::LostUPnP(const ContentDirectoryService &service)
 }
 
 static NeighborExplorer *
-upnp_neighbor_create(gcc_unused EventLoop &loop,
+upnp_neighbor_create(EventLoop &loop,
 		     NeighborListener &listener,
 		     gcc_unused const ConfigBlock &block,
 		     gcc_unused Error &error)
 {
-	return new UpnpNeighborExplorer(listener);
+	return new UpnpNeighborExplorer(loop, listener);
 }
 
 const NeighborPlugin upnp_neighbor_plugin = {
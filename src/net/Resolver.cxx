@@ -129,6 +129,19 @@ sockaddr_to_string(SocketAddress address)
 	return result;
 }
 
+std::string
+sockaddr_host_to_string(SocketAddress address)
+{
+	char host[NI_MAXHOST];
+	int ret = getnameinfo(address.GetAddress(), address.GetSize(),
+			      host, sizeof(host), nullptr, 0,
+			      NI_NUMERICHOST);
+	if (ret != 0)
+		return std::string();
+
+	return host;
+}
+
 struct addrinfo *
 resolve_host_port(const char *host_port, unsigned default_port,
 		  int flags, int socktype,
@@ -41,6 +41,16 @@ gcc_pure
 std::string
 sockaddr_to_string(SocketAddress address);
 
+/**
+ * Converts the host part of the specified socket address into a
+ * numeric string, without the port and without square braces.  This
+ * can be passed to libraries which would otherwise resolve a host
+ * name synchronously.
+ */
+gcc_pure
+std::string
+sockaddr_host_to_string(SocketAddress address);
+
 /**
  * Resolve a specification in the form "host", "host:port",
  * "[host]:port".  This is a convenience wrapper for getaddrinfo().
@@ -32,7 +32,7 @@
 int
 socket_bind_listen(int domain, int type, int protocol,
 		   SocketAddress address,
-		   int backlog,
+		   int backlog, bool reuse_port,
 		   Error &error)
 {
 	int fd, ret;
@@ -54,6 +54,24 @@ socket_bind_listen(int domain, int type, int protocol,
 		return -1;
 	}
 
+	if (reuse_port) {
+#ifdef SO_REUSEPORT
+		ret = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT,
+				 (const char *) &reuse, sizeof(reuse));
+		if (ret < 0) {
+			SetSocketError(error);
+			error.AddPrefix("setsockopt(SO_REUSEPORT) failed: ");
+			close_socket(fd);
+			return -1;
+		}
+#else
+		error.Set(socket_domain,
+			  "SO_REUSEPORT is not supported on this platform");
+		close_socket(fd);
+		return -1;
+#endif
+	}
+
 	ret = bind(fd, address.GetAddress(), address.GetSize());
 	if (ret < 0) {
 		SetSocketError(error);
@@ -38,6 +38,8 @@ class Error;
  * @param protocol the protocol, usually 0 to let the kernel choose
  * @param address the address to listen on
  * @param backlog the backlog parameter for the listen() system call
+ * @param reuse_port set SO_REUSEPORT, to allow several sockets (each
+ * in its own thread) to listen on the same address
  * @param error location to store the error occurring, or NULL to
  * ignore errors
  * @return the socket file descriptor or -1 on error
@@ -45,7 +47,7 @@ class Error;
 int
 socket_bind_listen(int domain, int type, int protocol,
 		   SocketAddress address,
-		   int backlog,
+		   int backlog, bool reuse_port,
 		   Error &error);
 
 int
@@ -56,10 +56,16 @@ AudioOutput::AudioOutput(const AudioOutputPlugin &_plugin)
 	 allow_play(true),
 	 in_playback_loop(false),
 	 woken_for_play(false),
+	 xruns(0), chunks_played(0), latency_us(0), encoder_load(0),
 	 filter(nullptr),
 	 replay_gain_filter(nullptr),
 	 other_replay_gain_filter(nullptr),
-	 command(Command::NONE)
+	 replay_gain_mixer(false),
+	 fused_volume_filter(nullptr),
+	 pre_output(nullptr),
+	 sync_master(false),
+	 command(Command::NONE),
+	 consumed_serial(UINT64_MAX)
 {
 	assert(plugin.finish != nullptr);
 	assert(plugin.open != nullptr);
@@ -183,6 +189,8 @@ AudioOutput::Configure(const ConfigBlock &block, Error &error)
 
 	tags = block.GetBlockValue("tags", true);
 	always_on = block.GetBlockValue("always_on", false);
+	sync_group_name = block.GetBlockValue("sync_group", "");
+	sync_master = block.GetBlockValue("sync_master", false);
 	enabled = block.GetBlockValue("enabled", true);
 
 	/* set up the filter chain */
@@ -251,6 +259,8 @@ audio_output_setup(EventLoop &event_loop, AudioOutput &ao,
 
 	/* set up the mixer */
 
+	const bool chain_empty = filter_chain_is_empty(*ao.filter);
+
 	Error mixer_error;
 	ao.mixer = audio_output_load_mixer(event_loop, ao, block,
 					   ao.plugin.mixer_plugin,
@@ -265,10 +275,11 @@ audio_output_setup(EventLoop &event_loop, AudioOutput &ao,
 	/* use the hardware mixer for replay gain? */
 
 	if (strcmp(replay_gain_handler, "mixer") == 0) {
-		if (ao.mixer != nullptr)
+		if (ao.mixer != nullptr) {
 			replay_gain_filter_set_mixer(ao.replay_gain_filter,
 						     ao.mixer, 100);
-		else
+			ao.replay_gain_mixer = true;
+		} else
 			FormatError(output_domain,
 				    "No such mixer for output '%s'", ao.name);
 	} else if (strcmp(replay_gain_handler, "software") != 0 &&
@@ -278,6 +289,14 @@ audio_output_setup(EventLoop &event_loop, AudioOutput &ao,
 		return false;
 	}
 
+	/* if the software mixer is the first filter, it can apply
+	   replay gain in the same pass */
+
+	if (chain_empty && ao.mixer != nullptr &&
+	    ao.replay_gain_filter != nullptr && !ao.replay_gain_mixer &&
+	    audio_output_mixer_type(block) == MixerType::SOFTWARE)
+		ao.fused_volume_filter = software_mixer_get_filter(ao.mixer);
+
 	/* the "convert" filter must be the last one in the chain */
 
 	ao.convert_filter = filter_new(&convert_filter_plugin, ConfigBlock(),
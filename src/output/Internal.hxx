@@ -28,9 +28,14 @@
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
 #include "system/PeriodClock.hxx"
+#include "SyncGroup.hxx"
+
+#include <string>
+#include <atomic>
 
 class Error;
 class Filter;
+class PreOutputStage;
 class MusicPipe;
 class EventLoop;
 class Mixer;
@@ -39,6 +44,7 @@ struct MusicChunk;
 struct ConfigBlock;
 struct PlayerControl;
 struct AudioOutputPlugin;
+template<typename T> struct ConstBuffer;
 
 struct AudioOutput {
 	enum class Command {
@@ -147,6 +153,35 @@ struct AudioOutput {
 	 */
 	bool woken_for_play;
 
+	/**
+	 * The number of buffer underruns (xruns) reported by the
+	 * plugin since MPD was started.  The plugin increments it in
+	 * the output thread or in its own (realtime) thread.
+	 */
+	std::atomic_uint xruns;
+
+	/**
+	 * The number of chunks played since MPD was started.  It is
+	 * incremented by the output thread.
+	 */
+	std::atomic<uint64_t> chunks_played;
+
+	/**
+	 * The most recently measured output latency (the amount of
+	 * audio queued in the device) in microseconds, or 0 if the
+	 * plugin does not report it.  It is updated by the output
+	 * thread after each play() call (see
+	 * AudioOutputPlugin::get_latency).
+	 */
+	std::atomic_uint latency_us;
+
+	/**
+	 * The real-time factor of the plugin's encoder in 1/1000 (see
+	 * encoder_get_load()), or 0 if the plugin does not have a
+	 * threaded encoder.
+	 */
+	std::atomic_uint encoder_load;
+
 	/**
 	 * If not nullptr, the device has failed, and this timer is used
 	 * to estimate how long it should stay disabled (unless
@@ -183,6 +218,12 @@ struct AudioOutput {
 	 */
 	PcmDither cross_fade_dither;
 
+	/**
+	 * The buffer which concatenates the pre-processed data of
+	 * several chunks, to pass them to the filter chain at once.
+	 */
+	PcmBuffer batch_buffer;
+
 	/**
 	 * The filter object of this audio output.  This is an
 	 * instance of chain_filter_plugin.
@@ -214,6 +255,54 @@ struct AudioOutput {
 	 */
 	unsigned other_replay_gain_serial;
 
+	/**
+	 * Does this output apply replay gain with its hardware
+	 * mixer?  Then its replay gain stage cannot be shared with
+	 * other outputs.
+	 */
+	bool replay_gain_mixer;
+
+	/**
+	 * The software mixer's volume filter, if it is the first
+	 * filter in the chain and replay gain is applied in
+	 * software.  Then, unless this output shares a
+	 * #PreOutputStage or is cross-fading, replay gain is
+	 * multiplied into the volume level instead of being applied
+	 * in a separate pass.  nullptr otherwise.
+	 */
+	Filter *fused_volume_filter;
+
+	/**
+	 * The stage which applies replay gain and cross-fading for
+	 * this output and others with the same configuration, or
+	 * nullptr if this output does that itself (with the filters
+	 * above).
+	 */
+	PreOutputStage *pre_output;
+
+	/**
+	 * The "sync_group" setting, or empty.  MultipleOutputs
+	 * attaches #sync to the group.
+	 */
+	std::string sync_group_name;
+
+	/**
+	 * The "sync_master" setting: this output is the reference
+	 * clock of its sync group.
+	 */
+	bool sync_master;
+
+	/**
+	 * Drift correction against the other outputs of the sync
+	 * group.
+	 */
+	SyncMember sync;
+
+	/**
+	 * A buffer for repeating frames (see #sync).
+	 */
+	PcmBuffer sync_buffer;
+
 	/**
 	 * The convert_filter_plugin instance of this audio output.
 	 * It is the last item in the filter chain, and is responsible
@@ -269,6 +358,15 @@ struct AudioOutput {
 	 */
 	bool current_chunk_finished;
 
+	/**
+	 * A lock-free copy of this output's position in the pipe for
+	 * MultipleOutputs::Check(): all chunks with a smaller
+	 * MusicChunk::serial have been consumed.  It is 0 if the
+	 * output will start at the head of the pipe, and UINT64_MAX
+	 * if it is closed.  Updated by PublishConsumed().
+	 */
+	std::atomic<uint64_t> consumed_serial;
+
 	AudioOutput(const AudioOutputPlugin &_plugin);
 	~AudioOutput();
 
@@ -283,6 +381,12 @@ struct AudioOutput {
 		return open;
 	}
 
+	/**
+	 * Update #consumed_serial after #open or #current_chunk has
+	 * been modified.  Caller must lock the mutex.
+	 */
+	void PublishConsumed();
+
 	bool IsCommandFinished() const {
 		return command == Command::NONE;
 	}
@@ -402,7 +506,21 @@ private:
 	gcc_pure
 	const MusicChunk *GetNextChunk() const;
 
-	bool PlayChunk(const MusicChunk *chunk);
+	/**
+	 * Ask #sync for a drift correction, and drop or repeat
+	 * frames accordingly.
+	 */
+	ConstBuffer<char> ApplySync(ConstBuffer<char> data);
+
+	/**
+	 * Play the specified chunk and as many of its successors as
+	 * are ready (up to the next tag), filtering them as one
+	 * batch.  #current_chunk is advanced while the data is being
+	 * played.
+	 *
+	 * @return false if the output has been closed due to an error
+	 */
+	bool PlayChunks(const MusicChunk *chunk);
 
 	/**
 	 * Plays all remaining chunks, until the tail of the pipe has
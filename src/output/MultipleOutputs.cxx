@@ -21,16 +21,22 @@
 #include "MultipleOutputs.hxx"
 #include "PlayerControl.hxx"
 #include "Internal.hxx"
+#include "PreOutputStage.hxx"
+#include "SyncGroup.hxx"
 #include "Domain.hxx"
 #include "MusicBuffer.hxx"
 #include "MusicPipe.hxx"
 #include "MusicChunk.hxx"
 #include "system/FatalError.hxx"
+#include "system/Trace.hxx"
 #include "util/Error.hxx"
 #include "config/Block.hxx"
 #include "config/ConfigGlobal.hxx"
 #include "config/ConfigOption.hxx"
 #include "notify.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
 
 #include <assert.h>
 #include <string.h>
@@ -39,7 +45,8 @@ MultipleOutputs::MultipleOutputs(MixerListener &_mixer_listener)
 	:mixer_listener(_mixer_listener),
 	 input_audio_format(AudioFormat::Undefined()),
 	 buffer(nullptr), pipe(nullptr),
-	 elapsed_time(SignedSongTime::Negative())
+	 elapsed_time(SignedSongTime::Negative()),
+	 replay_gain_mode(REPLAY_GAIN_OFF)
 {
 }
 
@@ -49,6 +56,12 @@ MultipleOutputs::~MultipleOutputs()
 		i->LockDisableWait();
 		i->Finish();
 	}
+
+	for (auto i : pre_output_stages)
+		delete i;
+
+	for (auto i : sync_groups)
+		delete i;
 }
 
 static AudioOutput *
@@ -92,6 +105,72 @@ MultipleOutputs::Configure(EventLoop &event_loop, PlayerControl &pc)
 					 pc, empty);
 		outputs.push_back(output);
 	}
+
+	SetupPreOutputStages();
+	SetupSyncGroups();
+}
+
+void
+MultipleOutputs::SetupPreOutputStages()
+{
+	/* outputs which apply replay gain in software (or not at
+	   all) produce identical data before their own filter chain;
+	   with a hardware mixer, replay gain is applied there
+	   instead */
+
+	for (const bool replay_gain : {false, true}) {
+		std::vector<AudioOutput *> group;
+		for (auto ao : outputs)
+			if (!ao->replay_gain_mixer &&
+			    (ao->replay_gain_filter != nullptr) == replay_gain)
+				group.push_back(ao);
+
+		if (group.size() < 2)
+			/* nothing to share */
+			continue;
+
+		auto stage = new PreOutputStage(replay_gain);
+		pre_output_stages.push_back(stage);
+
+		for (auto ao : group)
+			ao->pre_output = stage;
+	}
+}
+
+void
+MultipleOutputs::SetupSyncGroups()
+{
+	for (auto ao : outputs) {
+		if (ao->sync_group_name.empty())
+			continue;
+
+		auto i = std::find_if(sync_groups.begin(), sync_groups.end(),
+				      [ao](const SyncGroup *g){
+					      return g->name == ao->sync_group_name;
+				      });
+		if (i != sync_groups.end())
+			continue;
+
+		auto group = new SyncGroup(ao->sync_group_name.c_str());
+		sync_groups.push_back(group);
+
+		/* the master is the output with "sync_master", or
+		   the first one of the group */
+		AudioOutput *master = nullptr;
+		for (auto j : outputs)
+			if (j->sync_group_name == group->name &&
+			    (master == nullptr || (j->sync_master &&
+						   !master->sync_master)))
+				master = j;
+
+		for (auto j : outputs)
+			if (j->sync_group_name == group->name)
+				j->sync.Attach(*group, j == master);
+
+		FormatDebug(output_domain,
+			    "sync group \"%s\": master is \"%s\"",
+			    group->name.c_str(), master->name);
+	}
 }
 
 AudioOutput *
@@ -182,8 +261,13 @@ MultipleOutputs::Update()
 void
 MultipleOutputs::SetReplayGainMode(ReplayGainMode mode)
 {
+	replay_gain_mode = mode;
+
 	for (auto ao : outputs)
 		ao->SetReplayGainMode(mode);
+
+	for (auto stage : pre_output_stages)
+		stage->SetReplayGainMode(mode);
 }
 
 bool
@@ -194,6 +278,8 @@ MultipleOutputs::Play(MusicChunk *chunk, Error &error)
 	assert(chunk != nullptr);
 	assert(chunk->CheckFormat(input_audio_format));
 
+	const ScopeTrace trace("MultipleOutputs::Play");
+
 	if (!Update()) {
 		/* TODO: obtain real error */
 		error.Set(output_domain, "Failed to open audio output");
@@ -284,6 +370,16 @@ chunk_is_consumed_in(const AudioOutput *ao,
 	return ao->current_chunk_finished && chunk->next == nullptr;
 }
 
+inline uint64_t
+MultipleOutputs::GetConsumedSerial() const
+{
+	uint64_t serial = UINT64_MAX;
+	for (const auto *ao : outputs)
+		serial = std::min(serial,
+				  ao->consumed_serial.load(std::memory_order_acquire));
+	return serial;
+}
+
 bool
 MultipleOutputs::IsChunkConsumed(const MusicChunk *chunk) const
 {
@@ -319,9 +415,28 @@ MultipleOutputs::ClearTailChunk(gcc_unused const MusicChunk *chunk,
 		assert(ao->current_chunk == chunk);
 		assert(ao->current_chunk_finished);
 		ao->current_chunk = nullptr;
+		ao->PublishConsumed();
 	}
 }
 
+SignedSongTime
+MultipleOutputs::GetElapsedTime() const
+{
+	if (elapsed_time.IsNegative())
+		return elapsed_time;
+
+	/* the output with the largest latency determines when the
+	   position is audible on all of them */
+	unsigned latency_us = 0;
+	for (const auto *ao : outputs)
+		latency_us = std::max(latency_us, ao->latency_us.load());
+
+	const auto latency = SignedSongTime::FromMS(latency_us / 1000);
+	return latency < elapsed_time
+		? elapsed_time - latency
+		: SignedSongTime::zero();
+}
+
 unsigned
 MultipleOutputs::Check()
 {
@@ -333,18 +448,33 @@ MultipleOutputs::Check()
 	assert(buffer != nullptr);
 	assert(pipe != nullptr);
 
+	const ScopeTrace trace("MultipleOutputs::Check");
+
+	/* the outputs only move forward while we're here (opening
+	   an output or clearing the pipe happens in this thread), so
+	   one snapshot is enough */
+	const uint64_t consumed = GetConsumedSerial();
+
 	while ((chunk = pipe->Peek()) != nullptr) {
 		assert(!pipe->IsEmpty());
 
-		if (!IsChunkConsumed(chunk))
+		if (chunk->serial >= consumed &&
+		    /* the outputs keep pointing to the tail after
+		       they have finished it, to find its successor;
+		       only then, they need to be asked */
+		    (chunk->next != nullptr || !IsChunkConsumed(chunk)))
 			/* at least one output is not finished playing
 			   this chunk */
 			return pipe->GetSize();
 
 		if (chunk->length > 0 && !chunk->time.IsNegative())
 			/* only update elapsed_time if the chunk
-			   provides a defined value */
-			elapsed_time = chunk->time;
+			   provides a defined value; all outputs have
+			   consumed the whole chunk, so this is the
+			   chunk's end */
+			elapsed_time = chunk->time +
+				SignedSongTime::FromS(chunk->length /
+						      input_audio_format.GetTimeToSize());
 
 		is_tail = chunk->next == nullptr;
 		if (is_tail)
@@ -364,6 +494,8 @@ MultipleOutputs::Check()
 					outputs[i]->mutex.unlock();
 
 		/* return the chunk to the buffer */
+		for (auto stage : pre_output_stages)
+			stage->Forget(*shifted);
 		buffer->Return(shifted);
 	}
 
@@ -419,7 +551,7 @@ MultipleOutputs::Cancel()
 	/* clear the music pipe and return all chunks to the buffer */
 
 	if (pipe != nullptr)
-		pipe->Clear(*buffer);
+		ClearPipe();
 
 	/* the audio outputs are now waiting for a signal, to
 	   synchronize the cleared music pipe */
@@ -431,6 +563,18 @@ MultipleOutputs::Cancel()
 	elapsed_time = SignedSongTime::Negative();
 }
 
+void
+MultipleOutputs::ClearPipe()
+{
+	assert(pipe != nullptr);
+	assert(buffer != nullptr);
+
+	for (auto stage : pre_output_stages)
+		stage->Clear();
+
+	pipe->Clear(*buffer);
+}
+
 void
 MultipleOutputs::Close()
 {
@@ -440,7 +584,7 @@ MultipleOutputs::Close()
 	if (pipe != nullptr) {
 		assert(buffer != nullptr);
 
-		pipe->Clear(*buffer);
+		ClearPipe();
 		delete pipe;
 		pipe = nullptr;
 	}
@@ -461,7 +605,7 @@ MultipleOutputs::Release()
 	if (pipe != nullptr) {
 		assert(buffer != nullptr);
 
-		pipe->Clear(*buffer);
+		ClearPipe();
 		delete pipe;
 		pipe = nullptr;
 	}
@@ -32,8 +32,10 @@
 #include "Compiler.h"
 
 #include <vector>
+#include <atomic>
 
 #include <assert.h>
+#include <stdint.h>
 
 struct AudioFormat;
 class MusicBuffer;
@@ -43,6 +45,8 @@ class MixerListener;
 struct MusicChunk;
 struct PlayerControl;
 struct AudioOutput;
+class PreOutputStage;
+class SyncGroup;
 class Error;
 
 class MultipleOutputs {
@@ -50,6 +54,18 @@ class MultipleOutputs {
 
 	std::vector<AudioOutput *> outputs;
 
+	/**
+	 * Replay gain and cross-fade stages shared by outputs with
+	 * the same configuration.
+	 */
+	std::vector<PreOutputStage *> pre_output_stages;
+
+	/**
+	 * The groups of outputs which are kept in step (the
+	 * "sync_group" setting).
+	 */
+	std::vector<SyncGroup *> sync_groups;
+
 	AudioFormat input_audio_format;
 
 	/**
@@ -69,6 +85,12 @@ class MultipleOutputs {
 	 */
 	SignedSongTime elapsed_time;
 
+	/**
+	 * The replay gain mode most recently passed to
+	 * SetReplayGainMode().  It is read by the player thread.
+	 */
+	std::atomic<ReplayGainMode> replay_gain_mode;
+
 public:
 	/**
 	 * Load audio outputs from the configuration file and
@@ -140,6 +162,11 @@ public:
 
 	void SetReplayGainMode(ReplayGainMode mode);
 
+	gcc_pure
+	ReplayGainMode GetReplayGainMode() const {
+		return replay_gain_mode.load();
+	}
+
 	/**
 	 * Enqueue a #MusicChunk object for playing, i.e. pushes it to a
 	 * #MusicPipe.
@@ -190,14 +217,13 @@ public:
 	void SongBorder();
 
 	/**
-	 * Returns the "elapsed_time" stamp of the most recently finished
-	 * chunk.  A negative value is returned when no chunk has been
-	 * finished yet.
+	 * Returns the end of the most recently finished chunk, minus
+	 * the largest device latency reported by the outputs, i.e.
+	 * the position which is audible right now.  A negative value
+	 * is returned when no chunk has been finished yet.
 	 */
 	gcc_pure
-	SignedSongTime GetElapsedTime() const {
-		return elapsed_time;
-	}
+	SignedSongTime GetElapsedTime() const;
 
 	/**
 	 * Returns the average volume of all available mixers (range
@@ -261,7 +287,17 @@ private:
 	bool Update();
 
 	/**
-	 * Has this chunk been consumed by all audio outputs?
+	 * Returns the smallest AudioOutput::consumed_serial, i.e. all
+	 * chunks with a smaller MusicChunk::serial have been consumed
+	 * by all audio outputs.  This does not lock the outputs.
+	 */
+	gcc_pure
+	uint64_t GetConsumedSerial() const;
+
+	/**
+	 * Has this chunk been consumed by all audio outputs?  Unlike
+	 * GetConsumedSerial(), this locks each output, and it
+	 * detects a finished tail chunk.
 	 */
 	bool IsChunkConsumed(const MusicChunk *chunk) const;
 
@@ -271,6 +307,23 @@ private:
 	 * reference.
 	 */
 	void ClearTailChunk(const MusicChunk *chunk, bool *locked);
+
+	/**
+	 * Let outputs with equivalent replay gain configuration share
+	 * one #PreOutputStage.
+	 */
+	void SetupPreOutputStages();
+
+	/**
+	 * Create the #SyncGroup objects and attach their members.
+	 */
+	void SetupSyncGroups();
+
+	/**
+	 * Clear the #MusicPipe and discard all cached
+	 * #PreOutputStage results.
+	 */
+	void ClearPipe();
 };
 
 #endif
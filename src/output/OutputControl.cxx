@@ -125,6 +125,7 @@ AudioOutput::Open(const AudioFormat audio_format, const MusicPipe &mp)
 
 		if (pause) {
 			current_chunk = nullptr;
+			PublishConsumed();
 			pipe = &mp;
 
 			/* unpause with the CANCEL command; this is a
@@ -142,6 +143,7 @@ AudioOutput::Open(const AudioFormat audio_format, const MusicPipe &mp)
 
 	in_audio_format = audio_format;
 	current_chunk = nullptr;
+	PublishConsumed();
 
 	pipe = &mp;
 
@@ -57,13 +57,23 @@ bool
 ao_plugin_open(AudioOutput *ao, AudioFormat &audio_format,
 	       Error &error)
 {
-	return ao->plugin.open(ao, audio_format, error);
+	if (!ao->plugin.open(ao, audio_format, error))
+		return false;
+
+	if (ao->sync.IsDefined())
+		ao->sync.Reset();
+
+	return true;
 }
 
 void
 ao_plugin_close(AudioOutput *ao)
 {
 	ao->plugin.close(ao);
+	ao->latency_us = 0;
+
+	if (ao->sync.IsDefined())
+		ao->sync.Reset();
 }
 
 unsigned
@@ -100,6 +110,11 @@ ao_plugin_cancel(AudioOutput *ao)
 {
 	if (ao->plugin.cancel != nullptr)
 		ao->plugin.cancel(ao);
+
+	ao->latency_us = 0;
+
+	if (ao->sync.IsDefined())
+		ao->sync.Reset();
 }
 
 bool
@@ -107,3 +122,11 @@ ao_plugin_pause(AudioOutput *ao)
 {
 	return ao->plugin.pause != nullptr && ao->plugin.pause(ao);
 }
+
+unsigned
+ao_plugin_get_latency(AudioOutput *ao)
+{
+	return ao->plugin.get_latency != nullptr
+		? ao->plugin.get_latency(ao)
+		: 0;
+}
@@ -141,6 +141,14 @@ struct AudioOutputPlugin {
 	 */
 	bool (*pause)(AudioOutput *data);
 
+	/**
+	 * Returns the amount of audio which has been passed to
+	 * play(), but is not yet audible (i.e. the delay of the
+	 * device's buffers) in microseconds.  This method is
+	 * optional; it is called in the output thread after play().
+	 */
+	unsigned (*get_latency)(AudioOutput *data);
+
 	/**
 	 * The mixer plugin associated with this output plugin.  This
 	 * may be nullptr if no mixer plugin is implemented.  When
@@ -200,4 +208,7 @@ ao_plugin_cancel(AudioOutput *ao);
 bool
 ao_plugin_pause(AudioOutput *ao);
 
+unsigned
+ao_plugin_get_latency(AudioOutput *ao);
+
 #endif
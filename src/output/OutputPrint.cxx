@@ -39,5 +39,36 @@ printAudioDevices(Client &client, const MultipleOutputs &outputs)
 			      "outputname: %s\n"
 			      "outputenabled: %i\n",
 			      i, ao.name, ao.enabled);
+
+		client_printf(client, "xruns: %u\n", ao.xruns.load());
+
+		const unsigned latency_us = ao.latency_us.load();
+		if (latency_us > 0)
+			client_printf(client, "latency: %1.3f\n",
+				      latency_us / 1000000.);
+
+		if (ao.sync.IsDefined()) {
+			client_printf(client,
+				      "sync_group: %s\n"
+				      "sync_master: %i\n",
+				      ao.sync.GetGroup().name.c_str(),
+				      ao.sync.IsMaster());
+
+			if (!ao.sync.IsMaster())
+				client_printf(client,
+					      "sync_offset: %1.6f\n"
+					      "sync_drift_ppm: %d\n"
+					      "sync_dropped: %u\n"
+					      "sync_inserted: %u\n",
+					      ao.sync.offset_us.load() / 1000000.,
+					      ao.sync.drift_ppm.load(),
+					      ao.sync.dropped.load(),
+					      ao.sync.inserted.load());
+		}
+
+		const unsigned encoder_load = ao.encoder_load.load();
+		if (encoder_load > 0)
+			client_printf(client, "encoder_rtf: %1.3f\n",
+				      encoder_load / 1000.);
 	}
 }
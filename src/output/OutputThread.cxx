@@ -19,21 +19,25 @@
 
 #include "config.h"
 #include "Internal.hxx"
+#include "PreOutputStage.hxx"
 #include "OutputAPI.hxx"
 #include "Domain.hxx"
-#include "pcm/PcmMix.hxx"
 #include "pcm/Domain.hxx"
 #include "notify.hxx"
 #include "filter/FilterInternal.hxx"
 #include "filter/plugins/ConvertFilterPlugin.hxx"
-#include "filter/plugins/ReplayGainFilterPlugin.hxx"
+#include "filter/plugins/VolumeFilterPlugin.hxx"
+#include "pcm/Volume.hxx"
 #include "PlayerControl.hxx"
 #include "MusicPipe.hxx"
 #include "MusicChunk.hxx"
+#include "LatencyProfile.hxx"
+#include "ThreadConfig.hxx"
 #include "thread/Util.hxx"
 #include "thread/Slack.hxx"
 #include "thread/Name.hxx"
 #include "system/FatalError.hxx"
+#include "system/Trace.hxx"
 #include "util/Error.hxx"
 #include "util/ConstBuffer.hxx"
 #include "Log.hxx"
@@ -227,6 +231,7 @@ AudioOutput::Open()
 	}
 
 	open = true;
+	PublishConsumed();
 
 	FormatDebug(output_domain,
 		    "opened plugin=%s name=\"%s\" audio_format=%s",
@@ -248,6 +253,7 @@ AudioOutput::Close(bool drain)
 
 	current_chunk = nullptr;
 	open = false;
+	PublishConsumed();
 
 	mutex.unlock();
 
@@ -291,6 +297,7 @@ AudioOutput::ReopenFilter()
 
 		current_chunk = nullptr;
 		open = false;
+		PublishConsumed();
 		fail_timer.Update();
 
 		mutex.unlock();
@@ -347,94 +354,173 @@ AudioOutput::WaitForDelay()
 	}
 }
 
+/**
+ * The maximum number of chunks which are passed to the filter chain
+ * at once.
+ */
+static constexpr unsigned MAX_BATCH_CHUNKS = 16;
+
+/**
+ * Don't add more chunks to a batch once it has reached this size
+ * (in bytes of the input format).
+ */
+static constexpr size_t MAX_BATCH_SIZE = 64 * 1024;
+
+/**
+ * Apply replay gain and cross-fade to one chunk, possibly shared
+ * with other outputs.
+ *
+ * @param fused true if replay gain is applied by the software
+ * volume filter (see ao_fuse_replay_gain())
+ *
+ * @return the processed data, or nullptr on error
+ */
 static ConstBuffer<void>
-ao_chunk_data(AudioOutput *ao, const MusicChunk *chunk,
-	      Filter *replay_gain_filter,
-	      unsigned *replay_gain_serial_p)
+ao_pre_output_chunk(AudioOutput *ao, const MusicChunk &chunk,
+		    bool fused)
 {
-	assert(chunk != nullptr);
-	assert(!chunk->IsEmpty());
-	assert(chunk->CheckFormat(ao->in_audio_format));
+	Error error;
 
-	ConstBuffer<void> data(chunk->data, chunk->length);
+	ConstBuffer<void> data = ao->pre_output != nullptr
+		? ao->pre_output->Get(chunk, ao->in_audio_format, error)
+		: pre_output_filter_chunk(chunk, ao->in_audio_format,
+					  fused
+					  ? nullptr
+					  : ao->replay_gain_filter,
+					  ao->replay_gain_serial,
+					  ao->other_replay_gain_filter,
+					  ao->other_replay_gain_serial,
+					  ao->cross_fade_buffer,
+					  ao->cross_fade_dither,
+					  error);
+	if (data.IsNull())
+		FormatError(error, "\"%s\" [%s] failed to filter",
+			    ao->name, ao->plugin.name);
 
-	(void)ao;
+	return data;
+}
 
-	assert(data.size % ao->in_audio_format.GetFrameSize() == 0);
+/**
+ * Determine how many chunks (starting with the given one) are ready
+ * to be filtered as one batch.  A batch ends before the next chunk
+ * with a tag, so the tag can be sent to the device in time, and
+ * where the replay gain info or the cross-fading state changes, so
+ * replay gain can be applied to the whole batch at once.
+ *
+ * @param max_size_r returns an upper bound for the size of the
+ * pre-processed data of the batch
+ */
+static unsigned
+ao_count_batch(const AudioOutput *ao, const MusicChunk *chunk,
+	       size_t &max_size_r)
+{
+	const unsigned replay_gain_serial = chunk->replay_gain_serial;
+	const bool cross_fade = chunk->other != nullptr;
 
-	if (!data.IsEmpty() && replay_gain_filter != nullptr) {
-		if (chunk->replay_gain_serial != *replay_gain_serial_p) {
-			replay_gain_filter_set_info(replay_gain_filter,
-						    chunk->replay_gain_serial != 0
-						    ? &chunk->replay_gain_info
-						    : nullptr);
-			*replay_gain_serial_p = chunk->replay_gain_serial;
-		}
+	unsigned n = 0;
+	size_t max_size = 0;
 
-		Error error;
-		data = replay_gain_filter->FilterPCM(data, error);
-		if (data.IsNull())
-			FormatError(error, "\"%s\" [%s] failed to filter",
-				    ao->name, ao->plugin.name);
-	}
+	do {
+		/* cross-fading may extend the chunk to the length
+		   of the "other" chunk */
+		size_t size = chunk->length;
+		if (chunk->other != nullptr && chunk->other->length > size)
+			size = chunk->other->length;
 
-	return data;
+		if (n > 0 && max_size + size > MAX_BATCH_SIZE)
+			break;
+
+		max_size += size;
+		++n;
+		chunk = chunk->next;
+	} while (n < MAX_BATCH_CHUNKS && chunk != nullptr &&
+		 !(ao->tags && chunk->tag != nullptr) &&
+		 chunk->replay_gain_serial == replay_gain_serial &&
+		 (chunk->other != nullptr) == cross_fade);
+
+	max_size_r = max_size;
+	return n;
 }
 
+/**
+ * Decide whether the software volume filter shall apply replay gain
+ * to the batch starting with the given chunk, and configure its
+ * gain accordingly.  This saves one pass (and one dither) over the
+ * data.  It is not possible while cross-fading (replay gain must be
+ * applied to both chunks before mixing them) or if the output shares
+ * its #PreOutputStage with others.
+ *
+ * @return true if replay gain shall not be applied separately
+ */
+static bool
+ao_fuse_replay_gain(AudioOutput *ao, const MusicChunk &chunk)
+{
+	if (ao->fused_volume_filter == nullptr)
+		return false;
+
+	const bool fused = ao->pre_output == nullptr &&
+		chunk.other == nullptr;
+
+	unsigned gain = PCM_VOLUME_1;
+	if (fused)
+		gain = pre_output_replay_gain_volume(chunk,
+						     ao->replay_gain_filter,
+						     ao->replay_gain_serial);
+
+	volume_filter_set_gain(ao->fused_volume_filter, gain);
+	return fused;
+}
+
+/**
+ * Pass a run of consecutive chunks through replay gain, cross-fade
+ * and the filter chain.  Replay gain and cross-fade are applied to
+ * each chunk on its own; the results are concatenated, and the
+ * filter chain is invoked only once for the whole batch.
+ *
+ * @param n the number of chunks (see ao_count_batch())
+ * @param ends receives the end offset of each chunk within the
+ * pre-processed data
+ * @return the filtered data, or nullptr on error
+ */
 static ConstBuffer<void>
-ao_filter_chunk(AudioOutput *ao, const MusicChunk *chunk)
+ao_filter_chunks(AudioOutput *ao, const MusicChunk *chunk,
+		 unsigned n, size_t max_size, size_t *ends)
 {
-	ConstBuffer<void> data =
-		ao_chunk_data(ao, chunk, ao->replay_gain_filter,
-			      &ao->replay_gain_serial);
-	if (data.IsEmpty())
-		return data;
+	assert(n > 0);
 
-	/* cross-fade */
+	const bool fused = ao_fuse_replay_gain(ao, *chunk);
 
-	if (chunk->other != nullptr) {
-		ConstBuffer<void> other_data =
-			ao_chunk_data(ao, chunk->other,
-				      ao->other_replay_gain_filter,
-				      &ao->other_replay_gain_serial);
-		if (other_data.IsNull())
-			return nullptr;
+	ConstBuffer<void> data;
 
-		if (other_data.IsEmpty())
-			return data;
-
-		/* if the "other" chunk is longer, then that trailer
-		   is used as-is, without mixing; it is part of the
-		   "next" song being faded in, and if there's a rest,
-		   it means cross-fading ends here */
-
-		if (data.size > other_data.size)
-			data.size = other_data.size;
-
-		float mix_ratio = chunk->mix_ratio;
-		if (mix_ratio >= 0)
-			/* reverse the mix ratio (because the
-			   arguments to pcm_mix() are reversed), but
-			   only if the mix ratio is non-negative; a
-			   negative mix ratio is a MixRamp special
-			   case */
-			mix_ratio = 1.0 - mix_ratio;
-
-		void *dest = ao->cross_fade_buffer.Get(other_data.size);
-		memcpy(dest, other_data.data, other_data.size);
-		if (!pcm_mix(ao->cross_fade_dither, dest, data.data, data.size,
-			     ao->in_audio_format.format,
-			     mix_ratio)) {
-			FormatError(output_domain,
-				    "Cannot cross-fade format %s",
-				    sample_format_to_string(ao->in_audio_format.format));
+	if (n == 1) {
+		/* no copy needed */
+		data = ao_pre_output_chunk(ao, *chunk, fused);
+		if (data.IsNull())
 			return nullptr;
+
+		ends[0] = data.size;
+	} else {
+		uint8_t *dest = (uint8_t *)ao->batch_buffer.Get(max_size);
+		size_t size = 0;
+
+		for (unsigned i = 0; i < n; ++i, chunk = chunk->next) {
+			const auto src = ao_pre_output_chunk(ao, *chunk,
+							     fused);
+			if (src.IsNull())
+				return nullptr;
+
+			assert(size + src.size <= max_size);
+			memcpy(dest + size, src.data, src.size);
+			size += src.size;
+			ends[i] = size;
 		}
 
-		data.data = dest;
-		data.size = other_data.size;
+		data = {dest, size};
 	}
 
+	if (data.IsEmpty())
+		return data;
+
 	/* apply filter chain */
 
 	Error error;
@@ -448,10 +534,42 @@ ao_filter_chunk(AudioOutput *ao, const MusicChunk *chunk)
 	return data;
 }
 
+inline ConstBuffer<char>
+AudioOutput::ApplySync(ConstBuffer<char> data)
+{
+	const size_t frame_size = out_audio_format.GetFrameSize();
+	const size_t n_frames = data.size / frame_size;
+
+	const int correction = sync.Update(in_audio_format.sample_rate,
+					   out_audio_format.sample_rate,
+					   latency_us, n_frames);
+	if (correction < 0) {
+		/* drop frames at the end */
+		data.size -= size_t(-correction) * frame_size;
+	} else if (correction > 0) {
+		/* repeat the last frame */
+		const size_t size = data.size + correction * frame_size;
+		char *dest = (char *)sync_buffer.Get(size);
+		memcpy(dest, data.data, data.size);
+
+		const char *last = data.data + data.size - frame_size;
+		for (int i = 0; i < correction; ++i)
+			memcpy(dest + data.size + i * frame_size,
+			       last, frame_size);
+
+		data = {dest, size};
+	}
+
+	return data;
+}
+
 inline bool
-AudioOutput::PlayChunk(const MusicChunk *chunk)
+AudioOutput::PlayChunks(const MusicChunk *chunk)
 {
 	assert(filter != nullptr);
+	assert(current_chunk == chunk);
+
+	ScopeTrace trace("AudioOutput::PlayChunks");
 
 	if (tags && gcc_unlikely(chunk->tag != nullptr)) {
 		mutex.unlock();
@@ -459,7 +577,14 @@ AudioOutput::PlayChunk(const MusicChunk *chunk)
 		mutex.lock();
 	}
 
-	auto data = ConstBuffer<char>::FromVoid(ao_filter_chunk(this, chunk));
+	size_t max_size;
+	const unsigned n = ao_count_batch(this, chunk, max_size);
+	trace.SetArgument(n);
+
+	size_t ends[MAX_BATCH_CHUNKS];
+	auto data = ConstBuffer<char>::FromVoid(ao_filter_chunks(this, chunk,
+								n, max_size,
+								ends));
 	if (data.IsNull()) {
 		Close(false);
 
@@ -469,6 +594,34 @@ AudioOutput::PlayChunk(const MusicChunk *chunk)
 		return false;
 	}
 
+	if (sync.IsDefined() && !data.IsEmpty())
+		data = ApplySync(data);
+
+	/* translate the chunk boundaries to offsets within the
+	   filtered data, so #current_chunk can follow the playback
+	   position */
+
+	const size_t frame_size = out_audio_format.GetFrameSize();
+	const size_t in_size = ends[n - 1], out_size = data.size;
+	for (unsigned i = 0; i < n; ++i)
+		ends[i] = in_size > 0
+			? size_t(uint64_t(ends[i]) * out_size / in_size
+				 / frame_size * frame_size)
+			: 0;
+
+	/* sum up the input length for #sync now: the chunks may be
+	   returned to the #MusicBuffer while they are being played
+	   (see PublishConsumed()) */
+	size_t sync_length = 0;
+	if (sync.IsDefined()) {
+		const MusicChunk *c = chunk;
+		for (unsigned j = 0; j < n; ++j, c = c->next)
+			sync_length += c->length;
+	}
+
+	size_t position = 0;
+	unsigned i = 0;
+
 	Error error;
 
 	while (!data.IsEmpty() && command == Command::NONE) {
@@ -478,6 +631,8 @@ AudioOutput::PlayChunk(const MusicChunk *chunk)
 		mutex.unlock();
 		size_t nbytes = ao_plugin_play(this, data.data, data.size,
 					       error);
+		if (nbytes > 0)
+			latency_us = ao_plugin_get_latency(this);
 		mutex.lock();
 		if (nbytes == 0) {
 			/* play()==0 means failure */
@@ -495,15 +650,53 @@ AudioOutput::PlayChunk(const MusicChunk *chunk)
 		}
 
 		assert(nbytes <= data.size);
-		assert(nbytes % out_audio_format.GetFrameSize() == 0);
+		assert(nbytes % frame_size == 0);
 
 		data.data += nbytes;
 		data.size -= nbytes;
+
+		/* chunks which have been played completely may be
+		   returned to the #MusicBuffer */
+		position += nbytes;
+		if (i + 1 < n && ends[i] <= position) {
+			for (; i + 1 < n && ends[i] <= position; ++i)
+				current_chunk = current_chunk->next;
+			PublishConsumed();
+		}
+	}
+
+	chunks_played.fetch_add(data.IsEmpty() ? n : i,
+				std::memory_order_relaxed);
+
+	if (data.IsEmpty()) {
+		for (; i + 1 < n; ++i)
+			current_chunk = current_chunk->next;
+		PublishConsumed();
+
+		if (sync.IsDefined())
+			sync.AddContent(sync_length /
+					in_audio_format.GetFrameSize());
 	}
 
 	return true;
 }
 
+void
+AudioOutput::PublishConsumed()
+{
+	uint64_t serial;
+	if (!open)
+		serial = UINT64_MAX;
+	else if (current_chunk != nullptr)
+		serial = current_chunk->serial;
+	else
+		serial = 0;
+
+	/* "release" orders this after the last access to the
+	   chunks before #current_chunk */
+	consumed_serial.store(serial, std::memory_order_release);
+}
+
 inline const MusicChunk *
 AudioOutput::GetNextChunk() const
 {
@@ -533,14 +726,14 @@ AudioOutput::Play()
 		assert(!current_chunk_finished);
 
 		current_chunk = chunk;
+		PublishConsumed();
 
-		if (!PlayChunk(chunk)) {
+		if (!PlayChunks(chunk)) {
 			assert(current_chunk == nullptr);
 			break;
 		}
 
-		assert(current_chunk == chunk);
-		chunk = chunk->next;
+		chunk = current_chunk->next;
 	}
 
 	assert(in_playback_loop);
@@ -588,7 +781,8 @@ AudioOutput::Task()
 	FormatThreadName("output:%s", name);
 
 	SetThreadRealtime();
-	SetThreadTimerSlackUS(100);
+	SetThreadTimerSlackUS(GetLatencySettings().output_timer_slack);
+	ApplyThreadConfig("output", name);
 
 	mutex.lock();
 
@@ -657,6 +851,7 @@ AudioOutput::Task()
 
 		case Command::CANCEL:
 			current_chunk = nullptr;
+			PublishConsumed();
 
 			if (open) {
 				mutex.unlock();
@@ -669,6 +864,7 @@ AudioOutput::Task()
 
 		case Command::KILL:
 			current_chunk = nullptr;
+			PublishConsumed();
 			CommandFinished();
 			mutex.unlock();
 			return;
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "PreOutputStage.hxx"
+#include "Domain.hxx"
+#include "MusicChunk.hxx"
+#include "filter/FilterPlugin.hxx"
+#include "filter/FilterInternal.hxx"
+#include "filter/FilterRegistry.hxx"
+#include "filter/plugins/ReplayGainFilterPlugin.hxx"
+#include "config/Block.hxx"
+#include "pcm/PcmMix.hxx"
+#include "util/Error.hxx"
+
+#include <assert.h>
+#include <string.h>
+
+unsigned
+pre_output_replay_gain_volume(const MusicChunk &chunk,
+			      Filter *replay_gain_filter,
+			      unsigned &replay_gain_serial)
+{
+	if (chunk.replay_gain_serial != replay_gain_serial) {
+		replay_gain_filter_set_info(replay_gain_filter,
+					    chunk.replay_gain_serial != 0
+					    ? &chunk.replay_gain_info
+					    : nullptr);
+		replay_gain_serial = chunk.replay_gain_serial;
+	}
+
+	return replay_gain_filter_get_volume(replay_gain_filter);
+}
+
+static ConstBuffer<void>
+ApplyReplayGain(const MusicChunk &chunk, AudioFormat format,
+		Filter *replay_gain_filter, unsigned &replay_gain_serial,
+		Error &error)
+{
+	assert(!chunk.IsEmpty());
+	assert(chunk.CheckFormat(format));
+
+	ConstBuffer<void> data(chunk.data, chunk.length);
+
+	assert(data.size % format.GetFrameSize() == 0);
+	(void)format;
+
+	if (!data.IsEmpty() && replay_gain_filter != nullptr) {
+		pre_output_replay_gain_volume(chunk, replay_gain_filter,
+					      replay_gain_serial);
+		data = replay_gain_filter->FilterPCM(data, error);
+	}
+
+	return data;
+}
+
+ConstBuffer<void>
+pre_output_filter_chunk(const MusicChunk &chunk, AudioFormat format,
+			Filter *replay_gain_filter,
+			unsigned &replay_gain_serial,
+			Filter *other_replay_gain_filter,
+			unsigned &other_replay_gain_serial,
+			PcmBuffer &cross_fade_buffer,
+			PcmDither &cross_fade_dither,
+			Error &error)
+{
+	ConstBuffer<void> data =
+		ApplyReplayGain(chunk, format,
+				replay_gain_filter, replay_gain_serial,
+				error);
+	if (data.IsEmpty())
+		return data;
+
+	/* cross-fade */
+
+	if (chunk.other != nullptr) {
+		ConstBuffer<void> other_data =
+			ApplyReplayGain(*chunk.other, format,
+					other_replay_gain_filter,
+					other_replay_gain_serial,
+					error);
+		if (other_data.IsNull())
+			return nullptr;
+
+		if (other_data.IsEmpty())
+			return data;
+
+		/* if the "other" chunk is longer, then that trailer
+		   is used as-is, without mixing; it is part of the
+		   "next" song being faded in, and if there's a rest,
+		   it means cross-fading ends here */
+
+		if (data.size > other_data.size)
+			data.size = other_data.size;
+
+		float mix_ratio = chunk.mix_ratio;
+		if (mix_ratio >= 0)
+			/* reverse the mix ratio (because the
+			   arguments to pcm_mix() are reversed), but
+			   only if the mix ratio is non-negative; a
+			   negative mix ratio is a MixRamp special
+			   case */
+			mix_ratio = 1.0 - mix_ratio;
+
+		void *dest = cross_fade_buffer.Get(other_data.size);
+		memcpy(dest, other_data.data, other_data.size);
+		if (!pcm_mix(cross_fade_dither, dest, data.data, data.size,
+			     format.format,
+			     mix_ratio)) {
+			error.Format(output_domain,
+				     "Cannot cross-fade format %s",
+				     sample_format_to_string(format.format));
+			return nullptr;
+		}
+
+		data.data = dest;
+		data.size = other_data.size;
+	}
+
+	return data;
+}
+
+static Filter *
+NewReplayGainFilter()
+{
+	Filter *filter = filter_new(&replay_gain_filter_plugin, ConfigBlock(),
+				    IgnoreError());
+	assert(filter != nullptr);
+	return filter;
+}
+
+PreOutputStage::PreOutputStage(bool replay_gain)
+	:replay_gain_filter(replay_gain ? NewReplayGainFilter() : nullptr),
+	 other_replay_gain_filter(replay_gain ? NewReplayGainFilter() : nullptr),
+	 replay_gain_serial(0), other_replay_gain_serial(0),
+	 format(AudioFormat::Undefined())
+{
+}
+
+PreOutputStage::~PreOutputStage()
+{
+	CloseFilters();
+
+	delete replay_gain_filter;
+	delete other_replay_gain_filter;
+}
+
+void
+PreOutputStage::SetReplayGainMode(ReplayGainMode mode)
+{
+	const ScopeLock protect(mutex);
+
+	if (replay_gain_filter != nullptr)
+		replay_gain_filter_set_mode(replay_gain_filter, mode);
+	if (other_replay_gain_filter != nullptr)
+		replay_gain_filter_set_mode(other_replay_gain_filter, mode);
+}
+
+void
+PreOutputStage::CloseFilters()
+{
+	if (!format.IsDefined())
+		return;
+
+	if (replay_gain_filter != nullptr)
+		replay_gain_filter->Close();
+	if (other_replay_gain_filter != nullptr)
+		other_replay_gain_filter->Close();
+
+	format.Clear();
+}
+
+bool
+PreOutputStage::OpenFilters(AudioFormat _format, Error &error)
+{
+	assert(!format.IsDefined());
+
+	AudioFormat af = _format;
+	if (replay_gain_filter != nullptr &&
+	    !replay_gain_filter->Open(af, error).IsDefined())
+		return false;
+
+	af = _format;
+	if (other_replay_gain_filter != nullptr &&
+	    !other_replay_gain_filter->Open(af, error).IsDefined()) {
+		if (replay_gain_filter != nullptr)
+			replay_gain_filter->Close();
+		return false;
+	}
+
+	/* the filters have forgotten the replay gain info */
+	replay_gain_serial = other_replay_gain_serial = 0;
+
+	format = _format;
+	return true;
+}
+
+ConstBuffer<void>
+PreOutputStage::Get(const MusicChunk &chunk, AudioFormat _format,
+		    Error &error)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = cache.find(&chunk);
+	if (i != cache.end())
+		return { i->second.data(), i->second.size() };
+
+	if (_format != format) {
+		CloseFilters();
+		if (!OpenFilters(_format, error))
+			return nullptr;
+	}
+
+	const ConstBuffer<void> data =
+		pre_output_filter_chunk(chunk, format,
+					replay_gain_filter,
+					replay_gain_serial,
+					other_replay_gain_filter,
+					other_replay_gain_serial,
+					cross_fade_buffer, cross_fade_dither,
+					error);
+	if (data.IsNull())
+		return nullptr;
+
+	/* copy the result, because the filters will overwrite their
+	   buffers with the next chunk */
+
+	std::vector<uint8_t> buffer;
+	if (!spare.empty()) {
+		buffer = std::move(spare.back());
+		spare.pop_back();
+	}
+
+	const uint8_t *p = (const uint8_t *)data.data;
+	buffer.assign(p, p + data.size);
+
+	i = cache.emplace(&chunk, std::move(buffer)).first;
+	return { i->second.data(), i->second.size() };
+}
+
+void
+PreOutputStage::Forget(const MusicChunk &chunk)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = cache.find(&chunk);
+	if (i == cache.end())
+		return;
+
+	spare.emplace_back(std::move(i->second));
+	cache.erase(i);
+}
+
+void
+PreOutputStage::Clear()
+{
+	const ScopeLock protect(mutex);
+
+	for (auto &i : cache)
+		spare.emplace_back(std::move(i.second));
+	cache.clear();
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_OUTPUT_PRE_OUTPUT_STAGE_HXX
+#define MPD_OUTPUT_PRE_OUTPUT_STAGE_HXX
+
+#include "check.h"
+#include "AudioFormat.hxx"
+#include "ReplayGainInfo.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "pcm/PcmDither.hxx"
+#include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <map>
+#include <vector>
+
+#include <stdint.h>
+
+struct MusicChunk;
+class Filter;
+class Error;
+
+/**
+ * Apply replay gain and cross-fading to a chunk: the processing
+ * which happens before the output's own filter chain.
+ *
+ * @param replay_gain_filter the replay_gain_filter_plugin instance
+ * for the chunk (may be nullptr)
+ * @param other_replay_gain_filter the replay_gain_filter_plugin
+ * instance for the "other" chunk during cross-fading (may be
+ * nullptr)
+ * @return the processed data, or nullptr on error
+ */
+ConstBuffer<void>
+pre_output_filter_chunk(const MusicChunk &chunk, AudioFormat format,
+			Filter *replay_gain_filter,
+			unsigned &replay_gain_serial,
+			Filter *other_replay_gain_filter,
+			unsigned &other_replay_gain_serial,
+			PcmBuffer &cross_fade_buffer,
+			PcmDither &cross_fade_dither,
+			Error &error);
+
+/**
+ * Pass the chunk's #ReplayGainInfo to the replay_gain_filter_plugin
+ * instance (if it has changed) and return the volume level it would
+ * apply, without filtering anything.  This is used when replay gain
+ * is applied by the software volume filter in the same pass.
+ */
+unsigned
+pre_output_replay_gain_volume(const MusicChunk &chunk,
+			      Filter *replay_gain_filter,
+			      unsigned &replay_gain_serial);
+
+/**
+ * Replay gain and cross-fading shared by several audio outputs with
+ * the same configuration.  The work is done once per chunk, by
+ * whichever output gets to it first; the others copy the cached
+ * result.
+ *
+ * A cached result is kept until the chunk is removed from the
+ * #MusicPipe, i.e. until all outputs have consumed it.
+ *
+ * This class is thread-safe.
+ */
+class PreOutputStage {
+	Mutex mutex;
+
+	/**
+	 * The replay_gain_filter_plugin instances, or nullptr if
+	 * replay gain is disabled for this stage.
+	 */
+	Filter *const replay_gain_filter, *const other_replay_gain_filter;
+
+	unsigned replay_gain_serial, other_replay_gain_serial;
+
+	/**
+	 * The audio format the filters have been opened with.
+	 */
+	AudioFormat format;
+
+	PcmBuffer cross_fade_buffer;
+	PcmDither cross_fade_dither;
+
+	/**
+	 * The processed data of each chunk which is still in the
+	 * pipe.
+	 */
+	std::map<const MusicChunk *, std::vector<uint8_t>> cache;
+
+	/**
+	 * Buffers of forgotten chunks, to be reused.
+	 */
+	std::vector<std::vector<uint8_t>> spare;
+
+public:
+	/**
+	 * @param replay_gain apply replay gain in software?
+	 */
+	explicit PreOutputStage(bool replay_gain);
+	~PreOutputStage();
+
+	PreOutputStage(const PreOutputStage &) = delete;
+	PreOutputStage &operator=(const PreOutputStage &) = delete;
+
+	void SetReplayGainMode(ReplayGainMode mode);
+
+	/**
+	 * Obtain the processed data of the chunk.  The returned
+	 * buffer remains valid until Forget() or Clear() is called.
+	 *
+	 * @return the processed data, or nullptr on error
+	 */
+	ConstBuffer<void> Get(const MusicChunk &chunk, AudioFormat format,
+			      Error &error);
+
+	/**
+	 * The chunk is about to be returned to the #MusicBuffer;
+	 * discard its cached data.
+	 */
+	void Forget(const MusicChunk &chunk);
+
+	/**
+	 * Discard all cached data, e.g. after the pipe was cleared.
+	 */
+	void Clear();
+
+private:
+	void CloseFilters();
+	bool OpenFilters(AudioFormat format, Error &error);
+};
+
+#endif
@@ -33,6 +33,7 @@
 #include "plugins/PulseOutputPlugin.hxx"
 #include "plugins/RecorderOutputPlugin.hxx"
 #include "plugins/RoarOutputPlugin.hxx"
+#include "plugins/RtpOutputPlugin.hxx"
 #include "plugins/ShoutOutputPlugin.hxx"
 #include "plugins/sles/SlesOutputPlugin.hxx"
 #include "plugins/SolarisOutputPlugin.hxx"
@@ -87,6 +88,9 @@ const AudioOutputPlugin *const audio_output_plugins[] = {
 #ifdef ENABLE_RECORDER_OUTPUT
 	&recorder_output_plugin,
 #endif
+#ifdef ENABLE_RTP_OUTPUT
+	&rtp_output_plugin,
+#endif
 #ifdef ENABLE_WINMM_OUTPUT
 	&winmm_output_plugin,
 #endif
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "SyncGroup.hxx"
+#include "system/Clock.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+/**
+ * Offsets smaller than this are not corrected, to avoid reacting to
+ * measurement jitter.
+ */
+static constexpr int64_t SYNC_THRESHOLD_US = 500;
+
+/**
+ * Measurements are ignored for this long after a reset.
+ */
+static constexpr uint64_t SYNC_SETTLE_US = 2000000;
+
+/**
+ * Correct at most one frame in this many, to keep the corrections
+ * inaudible.
+ */
+static constexpr size_t SYNC_MAX_CORRECTION_RATIO = 1000;
+
+bool
+SyncGroup::GetMasterPosition(unsigned _epoch, uint64_t now_us,
+			     int64_t &position_us) const
+{
+	const ScopeLock protect(mutex);
+	if (_epoch != epoch || !master_valid)
+		return false;
+
+	position_us = master_position_us +
+		int64_t(now_us - master_time_us);
+	return true;
+}
+
+void
+SyncMember::Reset()
+{
+	content_frames = 0;
+
+	if (group != nullptr)
+		group->Reset();
+}
+
+int
+SyncMember::Update(unsigned in_sample_rate, unsigned out_sample_rate,
+		   unsigned latency_us, size_t available_frames)
+{
+	assert(group != nullptr);
+	assert(in_sample_rate > 0);
+	assert(out_sample_rate > 0);
+
+	const uint64_t now_us = MonotonicClockUS();
+	const int64_t position_us =
+		int64_t(content_frames * 1000000 / in_sample_rate) -
+		int64_t(latency_us);
+
+	const unsigned group_epoch = group->GetEpoch();
+	if (group_epoch != epoch) {
+		/* start over after a reset */
+		epoch = group_epoch;
+		referenced = false;
+		settle_time_us = now_us + SYNC_SETTLE_US;
+	}
+
+	if (now_us < settle_time_us)
+		return 0;
+
+	if (master) {
+		group->PublishMaster(epoch, now_us, position_us);
+		return 0;
+	}
+
+	int64_t master_position_us;
+	if (!group->GetMasterPosition(epoch, now_us, master_position_us))
+		return 0;
+
+	const int64_t offset = position_us - master_position_us;
+
+	if (!referenced) {
+		referenced = true;
+		reference_time_us = now_us;
+		reference_offset_us = offset;
+		correction_us = 0;
+		offset_us = 0;
+		return 0;
+	}
+
+	const int64_t relative = offset - reference_offset_us;
+	offset_us = int(relative);
+
+	/* the drift is the offset which would have accumulated
+	   without corrections */
+	const uint64_t elapsed_us = now_us - reference_time_us;
+	if (elapsed_us >= 10000000)
+		drift_ppm = int((relative - correction_us) * 1000000 /
+				int64_t(elapsed_us));
+
+	if (relative > -SYNC_THRESHOLD_US && relative < SYNC_THRESHOLD_US)
+		return 0;
+
+	/* correct the whole offset, but not more than one frame in
+	   SYNC_MAX_CORRECTION_RATIO */
+	const uint64_t offset_frames =
+		uint64_t(relative > 0 ? relative : -relative)
+		* out_sample_rate / 1000000;
+	const size_t max_frames =
+		std::max<size_t>(available_frames / SYNC_MAX_CORRECTION_RATIO,
+				 1);
+	const size_t n = std::min<uint64_t>(std::max<uint64_t>(offset_frames,
+							       1),
+					    max_frames);
+	if (n >= available_frames)
+		/* never drop a whole buffer */
+		return 0;
+
+	const int64_t duration_us = int64_t(n) * 1000000 / out_sample_rate;
+
+	if (relative > 0) {
+		/* this output is ahead: repeat frames */
+		inserted += n;
+		correction_us -= duration_us;
+		return int(n);
+	} else {
+		/* this output lags behind: drop frames */
+		dropped += n;
+		correction_us += duration_us;
+		return -int(n);
+	}
+}
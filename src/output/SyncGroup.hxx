@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_OUTPUT_SYNC_GROUP_HXX
+#define MPD_OUTPUT_SYNC_GROUP_HXX
+
+#include "thread/Mutex.hxx"
+
+#include <string>
+#include <atomic>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Keeps the outputs of a "sync_group" in step.  The master publishes
+ * its audible stream position; the other members (see #SyncMember)
+ * compare their own position with it and drop or repeat single
+ * frames to compensate for the clock drift between the devices.
+ */
+class SyncGroup {
+	mutable Mutex mutex;
+
+	/**
+	 * Incremented by Reset().  Measurements of an older epoch
+	 * are discarded.
+	 */
+	unsigned epoch;
+
+	/**
+	 * Has the master published a position in this epoch?
+	 */
+	bool master_valid;
+
+	uint64_t master_time_us;
+	int64_t master_position_us;
+
+public:
+	const std::string name;
+
+	explicit SyncGroup(const char *_name)
+		:epoch(0), master_valid(false), name(_name) {}
+
+	SyncGroup(const SyncGroup &) = delete;
+	SyncGroup &operator=(const SyncGroup &) = delete;
+
+	/**
+	 * Invalidate all measurements, because one of the members
+	 * has been opened, paused or cancelled.
+	 */
+	void Reset() {
+		const ScopeLock protect(mutex);
+		++epoch;
+		master_valid = false;
+	}
+
+	unsigned GetEpoch() const {
+		const ScopeLock protect(mutex);
+		return epoch;
+	}
+
+	void PublishMaster(unsigned _epoch, uint64_t now_us,
+			   int64_t position_us) {
+		const ScopeLock protect(mutex);
+		if (_epoch != epoch)
+			return;
+
+		master_valid = true;
+		master_time_us = now_us;
+		master_position_us = position_us;
+	}
+
+	/**
+	 * Determine the master's audible position at the specified
+	 * time, extrapolated from its most recent measurement.
+	 *
+	 * @return false if the master has not published a position
+	 * in this epoch
+	 */
+	bool GetMasterPosition(unsigned _epoch, uint64_t now_us,
+			       int64_t &position_us) const;
+};
+
+/**
+ * The state of one output in a #SyncGroup.  It is used by the output
+ * thread only, except for the statistics.
+ */
+class SyncMember {
+	SyncGroup *group;
+
+	bool master;
+
+	/**
+	 * The group epoch of the current reference.
+	 */
+	unsigned epoch;
+
+	/**
+	 * The number of input frames played since the output was
+	 * opened or cancelled.
+	 */
+	uint64_t content_frames;
+
+	/**
+	 * Measurements are ignored until this time, to let the
+	 * device buffers fill after a reset.
+	 */
+	uint64_t settle_time_us;
+
+	/**
+	 * Has the offset to the master been recorded in this epoch?
+	 */
+	bool referenced;
+
+	uint64_t reference_time_us;
+
+	/**
+	 * The offset to the master at #reference_time_us; only the
+	 * change relative to it is corrected.
+	 */
+	int64_t reference_offset_us;
+
+	/**
+	 * The duration of the frames dropped (negative: inserted)
+	 * since #reference_time_us.
+	 */
+	int64_t correction_us;
+
+public:
+	/**
+	 * The current offset to the master in microseconds
+	 * (positive: this output is ahead).
+	 */
+	std::atomic_int offset_us;
+
+	/**
+	 * The clock drift relative to the master, in parts per
+	 * million.
+	 */
+	std::atomic_int drift_ppm;
+
+	/**
+	 * The number of frames which have been dropped or repeated
+	 * since MPD was started.
+	 */
+	std::atomic_uint dropped, inserted;
+
+	SyncMember()
+		:group(nullptr), master(false),
+		 epoch(0), content_frames(0), settle_time_us(0),
+		 referenced(false),
+		 offset_us(0), drift_ppm(0), dropped(0), inserted(0) {}
+
+	SyncMember(const SyncMember &) = delete;
+	SyncMember &operator=(const SyncMember &) = delete;
+
+	bool IsDefined() const {
+		return group != nullptr;
+	}
+
+	const SyncGroup &GetGroup() const {
+		return *group;
+	}
+
+	bool IsMaster() const {
+		return master;
+	}
+
+	void Attach(SyncGroup &_group, bool _master) {
+		group = &_group;
+		master = _master;
+	}
+
+	/**
+	 * The output has been opened, paused or cancelled: start
+	 * counting again, and invalidate the whole group's
+	 * measurements.
+	 */
+	void Reset();
+
+	/**
+	 * Account for input frames which have been passed to the
+	 * device.
+	 */
+	void AddContent(size_t frames) {
+		content_frames += frames;
+	}
+
+	/**
+	 * Measure the offset to the master and decide how to correct
+	 * it before the next play() call.
+	 *
+	 * @param in_sample_rate the sample rate of the frames passed
+	 * to AddContent()
+	 * @param out_sample_rate the sample rate of the device
+	 * @param latency_us the device latency
+	 * @param available_frames the number of frames about to be
+	 * played
+	 * @return the number of frames to repeat (positive) or to
+	 * drop (negative)
+	 */
+	int Update(unsigned in_sample_rate, unsigned out_sample_rate,
+		   unsigned latency_us, size_t available_frames);
+};
+
+#endif
@@ -96,6 +96,11 @@ struct AudioOutputWrapper {
 		T &t = Cast(*ao);
 		return t.Pause();
 	}
+
+	static unsigned GetLatency(AudioOutput *ao) {
+		T &t = Cast(*ao);
+		return t.GetLatency();
+	}
 };
 
 #endif
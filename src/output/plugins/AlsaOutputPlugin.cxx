@@ -28,10 +28,12 @@
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "util/ConstBuffer.hxx"
+#include "LatencyProfile.hxx"
 #include "Log.hxx"
 
 #include <alsa/asoundlib.h>
 
+#include <algorithm>
 #include <string>
 
 #if SND_LIB_VERSION >= 0x1001c
@@ -39,9 +41,12 @@
 #define HAVE_ALSA_DSD
 #endif
 
-static const char default_device[] = "default";
+#if SND_LIB_VERSION >= 0x10102
+/* alsa-lib supports DSD_U16_BE and DSD_U32_BE since version 1.1.2 */
+#define HAVE_ALSA_DSD_U32
+#endif
 
-static constexpr unsigned MPD_ALSA_BUFFER_TIME_US = 500000;
+static const char default_device[] = "default";
 
 static constexpr unsigned MPD_ALSA_RETRY_NR = 5;
 
@@ -98,6 +103,12 @@ struct AlsaOutput {
 	 */
 	size_t out_frame_size;
 
+	/**
+	 * The sample rate of the device; used to convert the delay
+	 * to a latency.
+	 */
+	unsigned out_sample_rate;
+
 	/**
 	 * The size of one period, in number of frames.
 	 */
@@ -108,6 +119,13 @@ struct AlsaOutput {
 	 */
 	snd_pcm_uframes_t period_position;
 
+	/**
+	 * The start threshold configured in the software parameters.
+	 * In mmap mode, we have to start the device manually when
+	 * this many frames have been committed.
+	 */
+	snd_pcm_uframes_t start_threshold;
+
 	/**
 	 * Do we need to call snd_pcm_prepare() before the next write?
 	 * It means that we put the device to SND_PCM_STATE_SETUP by
@@ -155,6 +173,8 @@ struct AlsaOutput {
 	void Drain();
 	void Cancel();
 
+	unsigned GetLatency();
+
 private:
 	bool SetupDop(AudioFormat audio_format,
 		      bool *shift8_r, bool *packed_r, bool *reverse_endian_r,
@@ -163,6 +183,22 @@ private:
 
 	int Recover(int err);
 
+	/**
+	 * The #use_mmap implementation of Play(): export the chunk
+	 * directly into the memory mapped hardware buffer.
+	 *
+	 * @return the number of source bytes consumed, 0 on error
+	 */
+	size_t PlayMmap(ConstBuffer<void> src, Error &error);
+
+	/**
+	 * Wait until the device has room for more frames, starting
+	 * it if the buffer is full.
+	 *
+	 * @return 0 on success or a negative error code
+	 */
+	int WaitMmap();
+
 	/**
 	 * Write silence to the ALSA device.
 	 */
@@ -188,9 +224,11 @@ AlsaOutput::Configure(const ConfigBlock &block, Error &error)
 		/* legacy name from MPD 0.18 and older: */
 		block.GetBlockValue("dsd_usb", false);
 
+	const LatencySettings &latency = GetLatencySettings();
 	buffer_time = block.GetBlockValue("buffer_time",
-					      MPD_ALSA_BUFFER_TIME_US);
-	period_time = block.GetBlockValue("period_time", 0u);
+					      latency.alsa_buffer_time);
+	period_time = block.GetBlockValue("period_time",
+					      latency.alsa_period_time);
 
 #ifdef SND_PCM_NO_AUTO_RESAMPLE
 	if (!block.GetBlockValue("auto_resample", true))
@@ -314,10 +352,42 @@ byteswap_bitformat(snd_pcm_format_t fmt)
 		return SND_PCM_FORMAT_S24_3BE;
 
 	case SND_PCM_FORMAT_S32_BE: return SND_PCM_FORMAT_S32_LE;
+
+#ifdef HAVE_ALSA_DSD_U32
+	case SND_PCM_FORMAT_DSD_U16_BE: return SND_PCM_FORMAT_DSD_U16_LE;
+	case SND_PCM_FORMAT_DSD_U16_LE: return SND_PCM_FORMAT_DSD_U16_BE;
+	case SND_PCM_FORMAT_DSD_U32_BE: return SND_PCM_FORMAT_DSD_U32_LE;
+	case SND_PCM_FORMAT_DSD_U32_LE: return SND_PCM_FORMAT_DSD_U32_BE;
+#endif
+
 	default: return SND_PCM_FORMAT_UNKNOWN;
 	}
 }
 
+/**
+ * Returns the number of DSD bytes per channel in one frame of the
+ * specified ALSA format, if it is DSD_U16 or DSD_U32; these bytes
+ * are packed by #PcmExport.  Returns 0 for all other formats.
+ */
+static unsigned
+alsa_dsd_pack_size(snd_pcm_format_t fmt)
+{
+	switch (fmt) {
+#ifdef HAVE_ALSA_DSD_U32
+	case SND_PCM_FORMAT_DSD_U16_LE:
+	case SND_PCM_FORMAT_DSD_U16_BE:
+		return 2;
+
+	case SND_PCM_FORMAT_DSD_U32_LE:
+	case SND_PCM_FORMAT_DSD_U32_BE:
+		return 4;
+#endif
+
+	default:
+		return 0;
+	}
+}
+
 /**
  * Check if there is a "packed" version of the give PCM format.
  * Returns SND_PCM_FORMAT_UNKNOWN if not.
@@ -364,18 +434,14 @@ alsa_try_format_or_packed(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
 }
 
 /**
- * Attempts to configure the specified sample format, and tries the
- * reversed host byte order if was not supported.
+ * Attempts to configure the specified ALSA format, and tries the
+ * reversed byte order if was not supported.
  */
 static int
-alsa_output_try_format(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
-		       SampleFormat sample_format,
-		       bool *packed_r, bool *reverse_endian_r)
+alsa_try_format_or_byteswap(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
+			    snd_pcm_format_t alsa_format,
+			    bool *packed_r, bool *reverse_endian_r)
 {
-	snd_pcm_format_t alsa_format = get_bitformat(sample_format);
-	if (alsa_format == SND_PCM_FORMAT_UNKNOWN)
-		return -EINVAL;
-
 	int err = alsa_try_format_or_packed(pcm, hwparams, alsa_format,
 					    packed_r);
 	if (err == 0)
@@ -395,6 +461,39 @@ alsa_output_try_format(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
 	return err;
 }
 
+/**
+ * Attempts to configure the specified sample format, and tries the
+ * reversed host byte order if was not supported.  If the device
+ * does not support DSD_U8, this tries DSD_U32 and DSD_U16, which
+ * have several DSD bytes in each sample.
+ */
+static int
+alsa_output_try_format(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
+		       SampleFormat sample_format,
+		       bool *packed_r, bool *reverse_endian_r)
+{
+	snd_pcm_format_t alsa_format = get_bitformat(sample_format);
+	if (alsa_format == SND_PCM_FORMAT_UNKNOWN)
+		return -EINVAL;
+
+	int err = alsa_try_format_or_byteswap(pcm, hwparams, alsa_format,
+					      packed_r, reverse_endian_r);
+
+#ifdef HAVE_ALSA_DSD_U32
+	if (err == -EINVAL && sample_format == SampleFormat::DSD)
+		err = alsa_try_format_or_byteswap(pcm, hwparams,
+						  SND_PCM_FORMAT_DSD_U32_BE,
+						  packed_r, reverse_endian_r);
+
+	if (err == -EINVAL && sample_format == SampleFormat::DSD)
+		err = alsa_try_format_or_byteswap(pcm, hwparams,
+						  SND_PCM_FORMAT_DSD_U16_BE,
+						  packed_r, reverse_endian_r);
+#endif
+
+	return err;
+}
+
 /**
  * Configure a sample format, and probe other formats if that fails.
  */
@@ -441,7 +540,8 @@ alsa_output_setup_format(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
  */
 static bool
 alsa_setup(AlsaOutput *ad, AudioFormat &audio_format,
-	   bool *packed_r, bool *reverse_endian_r, Error &error)
+	   bool *packed_r, bool *reverse_endian_r, unsigned *dsd_pack_r,
+	   Error &error)
 {
 	unsigned int sample_rate = audio_format.sample_rate;
 	unsigned int channels = audio_format.channels;
@@ -500,6 +600,15 @@ configure_hw:
 		FormatDebug(alsa_output_domain,
 			    "format=%s (%s)", snd_pcm_format_name(format),
 			    snd_pcm_format_description(format));
+	else
+		format = SND_PCM_FORMAT_UNKNOWN;
+
+	/* with DSD_U16 and DSD_U32, each frame contains several DSD
+	   bytes per channel, which divides the frame rate */
+	*dsd_pack_r = alsa_dsd_pack_size(format);
+	sample_rate = audio_format.sample_rate;
+	if (*dsd_pack_r > 0)
+		sample_rate /= *dsd_pack_r;
 
 	err = snd_pcm_hw_params_set_channels_near(ad->pcm, hwparams,
 						  &channels);
@@ -520,7 +629,9 @@ configure_hw:
 			     ad->GetDevice(), audio_format.sample_rate);
 		return false;
 	}
-	audio_format.sample_rate = sample_rate;
+	audio_format.sample_rate = *dsd_pack_r > 0
+		? sample_rate * *dsd_pack_r
+		: sample_rate;
 
 	snd_pcm_uframes_t buffer_size_min, buffer_size_max;
 	snd_pcm_hw_params_get_buffer_size_min(hwparams, &buffer_size_min);
@@ -607,9 +718,9 @@ configure_hw:
 		goto error;
 
 	cmd = "snd_pcm_sw_params_set_start_threshold";
+	ad->start_threshold = alsa_buffer_size - alsa_period_size;
 	err = snd_pcm_sw_params_set_start_threshold(ad->pcm, swparams,
-						    alsa_buffer_size -
-						    alsa_period_size);
+						    ad->start_threshold);
 	if (err < 0)
 		goto error;
 
@@ -668,7 +779,9 @@ AlsaOutput::SetupDop(const AudioFormat audio_format,
 
 	const AudioFormat check = dop_format;
 
-	if (!alsa_setup(this, dop_format, packed_r, reverse_endian_r, error))
+	unsigned dsd_pack;
+	if (!alsa_setup(this, dop_format, packed_r, reverse_endian_r,
+			&dsd_pack, error))
 		return false;
 
 	/* if the device allows only 32 bit, shift all DoP
@@ -697,6 +810,7 @@ inline bool
 AlsaOutput::SetupOrDop(AudioFormat &audio_format, Error &error)
 {
 	bool shift8 = false, packed, reverse_endian;
+	unsigned dsd_pack = 0;
 
 	const bool dop2 = dop &&
 		audio_format.format == SampleFormat::DSD;
@@ -705,13 +819,13 @@ AlsaOutput::SetupOrDop(AudioFormat &audio_format, Error &error)
 			   &shift8, &packed, &reverse_endian,
 			   error)
 		: alsa_setup(this, audio_format, &packed, &reverse_endian,
-			     error);
+			     &dsd_pack, error);
 	if (!success)
 		return false;
 
 	pcm_export->Open(audio_format.format,
 			 audio_format.channels,
-			 dop2, shift8, packed, reverse_endian);
+			 dop2, shift8, packed, reverse_endian, dsd_pack);
 	return true;
 }
 
@@ -738,16 +852,35 @@ AlsaOutput::Open(AudioFormat &audio_format, Error &error)
 
 	in_frame_size = audio_format.GetFrameSize();
 	out_frame_size = pcm_export->GetFrameSize(audio_format);
+	out_sample_rate = pcm_export->dop
+		/* DoP packs two DSD bytes per channel into each frame */
+		? audio_format.sample_rate / 2
+		: (pcm_export->dsd_pack > 0
+		   /* so do DSD_U16 and DSD_U32 */
+		   ? audio_format.sample_rate / pcm_export->dsd_pack
+		   : audio_format.sample_rate);
 
 	must_prepare = false;
 
 	return true;
 }
 
+inline unsigned
+AlsaOutput::GetLatency()
+{
+	snd_pcm_sframes_t delay;
+	if (snd_pcm_delay(pcm, &delay) < 0 || delay < 0)
+		return 0;
+
+	return uint64_t(delay) * 1000000u / out_sample_rate;
+}
+
 inline int
 AlsaOutput::Recover(int err)
 {
 	if (err == -EPIPE) {
+		++base.xruns;
+
 		FormatDebug(alsa_output_domain,
 			    "Underrun on ALSA device \"%s\"",
 			    GetDevice());
@@ -820,6 +953,108 @@ AlsaOutput::Close()
 	delete[] silence;
 }
 
+inline int
+AlsaOutput::WaitMmap()
+{
+	if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED)
+		/* the buffer is full, but the device has not been
+		   started yet; start it now, or we would wait
+		   forever */
+		return snd_pcm_start(pcm);
+
+	int err = snd_pcm_wait(pcm, -1);
+	return err < 0 ? err : 0;
+}
+
+inline size_t
+AlsaOutput::PlayMmap(ConstBuffer<void> src, Error &error)
+{
+	const snd_pcm_uframes_t src_frames =
+		pcm_export->CalcOutputSize(src.size) / out_frame_size;
+	if (src_frames == 0)
+		/* see Play() */
+		return src.size;
+
+	while (true) {
+		snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm);
+		int err = avail < 0
+			? int(avail)
+			: (avail == 0 ? WaitMmap() : 0);
+		if (err < 0) {
+			if (err == -EAGAIN || err == -EINTR)
+				continue;
+
+			if (Recover(err) < 0) {
+				error.Set(alsa_output_domain, err,
+					  snd_strerror(-err));
+				return 0;
+			}
+
+			continue;
+		}
+
+		if (avail <= 0)
+			continue;
+
+		const snd_pcm_channel_area_t *areas;
+		snd_pcm_uframes_t offset;
+		snd_pcm_uframes_t frames = std::min<snd_pcm_uframes_t>(avail,
+								       src_frames);
+		err = snd_pcm_mmap_begin(pcm, &areas, &offset, &frames);
+		if (err < 0) {
+			if (Recover(err) < 0) {
+				error.Set(alsa_output_domain, err,
+					  snd_strerror(-err));
+				return 0;
+			}
+
+			continue;
+		}
+
+		/* with SND_PCM_ACCESS_MMAP_INTERLEAVED, all channels
+		   share one area, and the first one points to the
+		   beginning of the frame */
+		assert(areas[0].step == out_frame_size * 8);
+		uint8_t *dest = (uint8_t *)areas[0].addr
+			+ (areas[0].first + offset * areas[0].step) / 8;
+
+		const size_t consumed =
+			pcm_export->CalcSourceSize(frames * out_frame_size);
+		gcc_unused const size_t written =
+			pcm_export->ExportTo({src.data, consumed}, dest);
+		assert(written == frames * out_frame_size);
+
+		snd_pcm_sframes_t ret = snd_pcm_mmap_commit(pcm, offset,
+							    frames);
+		if (ret < 0 || snd_pcm_uframes_t(ret) != frames) {
+			err = ret < 0 ? int(ret) : -EPIPE;
+			if (Recover(err) < 0) {
+				error.Set(alsa_output_domain, err,
+					  snd_strerror(-err));
+				return 0;
+			}
+
+			continue;
+		}
+
+		period_position = (period_position + frames) % period_frames;
+
+		snd_pcm_sframes_t delay;
+		if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED &&
+		    snd_pcm_delay(pcm, &delay) == 0 &&
+		    snd_pcm_uframes_t(delay) >= start_threshold) {
+			err = snd_pcm_start(pcm);
+			if (err < 0 && Recover(err) < 0) {
+				error.Set(alsa_output_domain, err,
+					  snd_strerror(-err));
+				return 0;
+			}
+		}
+
+		return consumed;
+	}
+}
+
 inline size_t
 AlsaOutput::Play(const void *chunk, size_t size, Error &error)
 {
@@ -836,14 +1071,17 @@ AlsaOutput::Play(const void *chunk, size_t size, Error &error)
 		}
 	}
 
+	if (use_mmap)
+		return PlayMmap({chunk, size}, error);
+
 	const auto e = pcm_export->Export({chunk, size});
 	if (e.size == 0)
-		/* the DoP (DSD over PCM) filter converts two frames
-		   at a time and ignores the last odd frame; if there
-		   was only one frame (e.g. the last frame in the
-		   file), the result is empty; to avoid an endless
-		   loop, bail out here, and pretend the one frame has
-		   been played */
+		/* the DoP (DSD over PCM) filter and the DSD_U16/U32
+		   packer convert several frames at a time and ignore
+		   the trailing frames; if there were not enough frames
+		   (e.g. the last frames in the file), the result is
+		   empty; to avoid an endless loop, bail out here, and
+		   pretend these frames have been played */
 		return size;
 
 	chunk = e.data;
@@ -889,6 +1127,7 @@ const struct AudioOutputPlugin alsa_output_plugin = {
 	&Wrapper::Drain,
 	&Wrapper::Cancel,
 	nullptr,
+	&Wrapper::GetLatency,
 
 	&alsa_mixer_plugin,
 };
@@ -33,6 +33,7 @@
 
 #include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 #define FIFO_BUFFER_SIZE 65536 /* pipe capacity on Linux >= 2.6.11 */
@@ -48,10 +49,16 @@ struct FifoOutput {
 	bool created;
 	Timer *timer;
 
+	/**
+	 * The requested pipe capacity in bytes; 0 keeps the kernel
+	 * default.
+	 */
+	unsigned pipe_size;
+
 	FifoOutput()
 		:base(fifo_output_plugin),
 		 path(AllocatedPath::Null()), input(-1), output(-1),
-		 created(false) {}
+		 created(false), pipe_size(0) {}
 
 	~FifoOutput() {
 		Close();
@@ -171,6 +178,15 @@ FifoOutput::Open(Error &error)
 		return false;
 	}
 
+#ifdef F_SETPIPE_SZ
+	/* a larger pipe gives the reader more slack before
+	   Play() has to discard data */
+	if (pipe_size > 0 && fcntl(output, F_SETPIPE_SZ, pipe_size) < 0)
+		FormatErrno(fifo_output_domain,
+			    "Failed to set the size of FIFO \"%s\"",
+			    path_utf8.c_str());
+#endif
+
 	return true;
 }
 
@@ -196,6 +212,8 @@ FifoOutput::Create(const ConfigBlock &block, Error &error)
 		return nullptr;
 	}
 
+	fd->pipe_size = block.GetBlockValue("pipe_size", 0u);
+
 	if (!fd->Open(error)) {
 		delete fd;
 		return nullptr;
@@ -296,4 +314,5 @@ const struct AudioOutputPlugin fifo_output_plugin = {
 	&Wrapper::Cancel,
 	nullptr,
 	nullptr,
+	nullptr,
 };
@@ -22,19 +22,23 @@
 #include "../OutputAPI.hxx"
 #include "../Wrapper.hxx"
 #include "config/ConfigError.hxx"
+#include "pcm/Simd.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/SplitString.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <atomic>
+
 #include <assert.h>
 
 #include <jack/jack.h>
 #include <jack/types.h>
 #include <jack/ringbuffer.h>
 
-#include <unistd.h> /* for usleep() */
 #include <stdlib.h>
 #include <string.h>
 
@@ -80,8 +84,38 @@ struct JackOutput {
 	 */
 	bool pause;
 
+	/**
+	 * Set by Play(), cleared by Drain() and Pause(): while it is
+	 * set, an empty ring buffer in the "process" callback is an
+	 * underrun, and is counted in AudioOutput::xruns.
+	 */
+	std::atomic_bool playing;
+
+	/**
+	 * The output thread waits on #cond for ring buffer space
+	 * instead of polling.  The "process" callback must never
+	 * block, so it only signals if it gets the #mutex with
+	 * try_lock(); a missed wakeup is repeated in the next period.
+	 */
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * Is the output thread waiting on #cond?
+	 */
+	std::atomic_bool waiting;
+
+	/**
+	 * The "process" callback wakes up the output thread when this
+	 * many bytes per ring buffer are free (or when it is empty).
+	 * Waking it up for every JACK period would be expensive with
+	 * small periods.
+	 */
+	size_t wake_space;
+
 	JackOutput()
-		:base(jack_output_plugin) {}
+		:base(jack_output_plugin),
+		 playing(false), waiting(false) {}
 
 	bool Configure(const ConfigBlock &block, Error &error);
 
@@ -94,6 +128,9 @@ struct JackOutput {
 
 	void Shutdown() {
 		shutdown = true;
+
+		const ScopeLock protect(mutex);
+		cond.signal();
 	}
 
 	bool Enable(Error &error);
@@ -117,6 +154,23 @@ struct JackOutput {
 
 	void Process(jack_nframes_t nframes);
 
+	void OnXrun() {
+		++base.xruns;
+	}
+
+	/**
+	 * Called by the "process" callback to wake up the output
+	 * thread if it is waiting and there is enough to do.
+	 */
+	void WakeWriter();
+
+	/**
+	 * Wait until the predicate returns true, the JACK connection
+	 * fails, or a timeout expires.
+	 */
+	template<typename P>
+	void WaitFor(P &&predicate);
+
 	/**
 	 * @return the number of frames that were written
 	 */
@@ -128,8 +182,16 @@ struct JackOutput {
 			: 0;
 	}
 
+	/**
+	 * The audio in our ring buffers plus the playback latency
+	 * reported by the JACK port.
+	 */
+	unsigned GetLatency() const;
+
 	size_t Play(const void *chunk, size_t size, Error &error);
 
+	void Drain();
+
 	bool Pause();
 };
 
@@ -236,11 +298,16 @@ JackOutput::Process(jack_nframes_t nframes)
 
 		MultiWriteSilence({ports, n_channels}, nframes);
 
+		WakeWriter();
 		return;
 	}
 
-	if (available > nframes)
+	if (available >= nframes)
 		available = nframes;
+	else if (playing.load(std::memory_order_relaxed))
+		/* the output thread was too slow; the rest of this
+		   period will be silence */
+		OnXrun();
 
 	for (unsigned i = 0; i < n_channels; ++i)
 		Copy(*ports[i], nframes, *ringbuffer[i], available);
@@ -249,6 +316,42 @@ JackOutput::Process(jack_nframes_t nframes)
 
 	MultiWriteSilence({ports + n_channels, num_source_ports - n_channels},
 			  nframes);
+
+	WakeWriter();
+}
+
+inline void
+JackOutput::WakeWriter()
+{
+	if (!waiting.load(std::memory_order_relaxed))
+		return;
+
+	if (jack_ringbuffer_write_space(ringbuffer[0]) < wake_space &&
+	    GetAvailable() > 0)
+		return;
+
+	if (mutex.try_lock()) {
+		waiting = false;
+		cond.signal();
+		mutex.unlock();
+	}
+}
+
+template<typename P>
+inline void
+JackOutput::WaitFor(P &&predicate)
+{
+	const ScopeLock protect(mutex);
+
+	while (!shutdown && !predicate()) {
+		waiting = true;
+
+		/* the timeout is only a safety net in case the
+		   "process" callback stops being called */
+		cond.timed_wait(mutex, 100);
+	}
+
+	waiting = false;
 }
 
 static int
@@ -260,6 +363,15 @@ mpd_jack_process(jack_nframes_t nframes, void *arg)
 	return 0;
 }
 
+static int
+mpd_jack_xrun(void *arg)
+{
+	JackOutput &jo = *(JackOutput *) arg;
+
+	jo.OnXrun();
+	return 0;
+}
+
 static void
 mpd_jack_shutdown(void *arg)
 {
@@ -328,6 +440,7 @@ JackOutput::Connect(Error &error)
 
 	jack_set_process_callback(client, mpd_jack_process, this);
 	jack_on_shutdown(client, mpd_jack_shutdown, this);
+	jack_set_xrun_callback(client, mpd_jack_xrun, this);
 
 	for (unsigned i = 0; i < num_source_ports; ++i) {
 		ports[i] = jack_port_register(client,
@@ -518,6 +631,8 @@ JackOutput::Start(Error &error)
 		jack_ringbuffer_reset(ringbuffer[i]);
 	}
 
+	wake_space = ringbuffer_size / 4;
+
 	if ( jack_activate(client) ) {
 		error.Set(jack_output_domain, "cannot activate client");
 		Stop();
@@ -664,11 +779,9 @@ JackOutput::WriteSamples(const float *src, size_t n_frames)
 	if (space == 0)
 		return 0;
 
-	const size_t result = n_frames = std::min(space, n_frames);
+	const size_t result = std::min(space, n_frames);
 
-	while (n_frames-- > 0)
-		for (unsigned i = 0; i < n_channels; ++i)
-			*dest[i]++ = *src++;
+	GetPcmSimd().deinterleave_float(dest, src, result, n_channels);
 
 	const size_t per_channel_advance = result * jack_sample_size;
 	for (unsigned i = 0; i < n_channels; ++i)
@@ -682,6 +795,7 @@ inline size_t
 JackOutput::Play(const void *chunk, size_t size, Error &error)
 {
 	pause = false;
+	playing = true;
 
 	const size_t frame_size = audio_format.GetFrameSize();
 	assert(size % frame_size == 0);
@@ -700,12 +814,39 @@ JackOutput::Play(const void *chunk, size_t size, Error &error)
 		if (frames_written > 0)
 			return frames_written * frame_size;
 
-		/* XXX do something more intelligent to
-		   synchronize */
-		usleep(1000);
+		/* wait for the "process" callback to make room */
+		WaitFor([this](){
+				return jack_ringbuffer_write_space(ringbuffer[0]) >=
+					jack_sample_size;
+			});
 	}
 }
 
+inline void
+JackOutput::Drain()
+{
+	/* the end of the stream: the ring buffer running empty is no
+	   underrun */
+	playing = false;
+
+	WaitFor([this](){
+			return pause || GetAvailable() == 0;
+		});
+}
+
+inline unsigned
+JackOutput::GetLatency() const
+{
+	if (shutdown)
+		return 0;
+
+	jack_latency_range_t range;
+	jack_port_get_latency_range(ports[0], JackPlaybackLatency, &range);
+
+	const jack_nframes_t frames = GetAvailable() + range.max;
+	return uint64_t(frames) * 1000000u / audio_format.sample_rate;
+}
+
 inline bool
 JackOutput::Pause()
 {
@@ -713,6 +854,7 @@ JackOutput::Pause()
 		return false;
 
 	pause = true;
+	playing = false;
 
 	return true;
 }
@@ -731,8 +873,9 @@ const struct AudioOutputPlugin jack_output_plugin = {
 	&Wrapper::Delay,
 	nullptr,
 	&Wrapper::Play,
-	nullptr,
+	&Wrapper::Drain,
 	nullptr,
 	&Wrapper::Pause,
+	&Wrapper::GetLatency,
 	nullptr,
 };
@@ -110,4 +110,5 @@ const struct AudioOutputPlugin null_output_plugin = {
 	&Wrapper::Cancel,
 	nullptr,
 	nullptr,
+	nullptr,
 };
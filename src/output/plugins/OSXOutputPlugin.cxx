@@ -428,4 +428,5 @@ const struct AudioOutputPlugin osx_output_plugin = {
 	osx_output_cancel,
 	nullptr,
 	nullptr,
+	nullptr,
 };
@@ -274,4 +274,5 @@ const struct AudioOutputPlugin openal_output_plugin = {
 	&Wrapper::Cancel,
 	nullptr,
 	nullptr,
+	nullptr,
 };
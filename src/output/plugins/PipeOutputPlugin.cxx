@@ -25,9 +25,14 @@
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 
+#include "Log.hxx"
+
 #include <string>
 
 #include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 class PipeOutput {
 	friend struct AudioOutputWrapper<PipeOutput>;
@@ -37,6 +42,12 @@ class PipeOutput {
 	std::string cmd;
 	FILE *fh;
 
+	/**
+	 * The requested pipe capacity in bytes; 0 keeps the kernel
+	 * default.
+	 */
+	unsigned pipe_size;
+
 	PipeOutput()
 		:base(pipe_output_plugin) {}
 
@@ -70,6 +81,7 @@ PipeOutput::Configure(const ConfigBlock &block, Error &error)
 		return false;
 	}
 
+	pipe_size = block.GetBlockValue("pipe_size", 0u);
 	return true;
 }
 
@@ -96,17 +108,33 @@ PipeOutput::Open(gcc_unused AudioFormat &audio_format, Error &error)
 		return false;
 	}
 
+#ifdef F_SETPIPE_SZ
+	if (pipe_size > 0 &&
+	    fcntl(fileno(fh), F_SETPIPE_SZ, pipe_size) < 0)
+		FormatErrno(pipe_output_domain,
+			    "Failed to set the size of pipe \"%s\"",
+			    cmd.c_str());
+#endif
+
 	return true;
 }
 
 inline size_t
 PipeOutput::Play(const void *chunk, size_t size, Error &error)
 {
-	size_t nbytes = fwrite(chunk, 1, size, fh);
-	if (nbytes == 0)
-		error.SetErrno("Write error on pipe");
+	/* bypass the stdio buffer, which would only add another
+	   copy; nothing is ever written to it */
+	while (true) {
+		ssize_t nbytes = write(fileno(fh), chunk, size);
+		if (nbytes > 0)
+			return (size_t)nbytes;
 
-	return nbytes;
+		if (nbytes < 0 && errno == EINTR)
+			continue;
+
+		error.SetErrno("Write error on pipe");
+		return 0;
+	}
 }
 
 typedef AudioOutputWrapper<PipeOutput> Wrapper;
@@ -127,4 +155,5 @@ const struct AudioOutputPlugin pipe_output_plugin = {
 	nullptr,
 	nullptr,
 	nullptr,
+	nullptr,
 };
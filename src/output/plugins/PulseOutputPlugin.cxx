@@ -36,9 +36,13 @@
 #include <pulse/subscribe.h>
 #include <pulse/version.h>
 
+#include <algorithm>
+
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define MPD_PULSE_NAME "Music Player Daemon"
 
@@ -59,10 +63,31 @@ class PulseOutput {
 
 	size_t writable;
 
+	/**
+	 * Server memory obtained with pa_stream_begin_write(), which
+	 * Play() fills.  It is passed to pa_stream_write() when it is
+	 * full (or before the stream gets drained, flushed or
+	 * corked), so PulseAudio does not have to copy it, and
+	 * several Play() calls share one mainloop lock.  nullptr if
+	 * there is none.
+	 */
+	uint8_t *write_buffer;
+
+	size_t write_size, write_position;
+
+	size_t frame_size;
+
+	/**
+	 * The maximum size of #write_buffer.  Data in it does not
+	 * reach the server yet, so this is kept short.
+	 */
+	size_t max_batch_size;
+
 	PulseOutput()
 		:base(pulse_output_plugin),
 		 mixer(nullptr),
-		 mainloop(nullptr), stream(nullptr) {}
+		 mainloop(nullptr), stream(nullptr),
+		 write_buffer(nullptr) {}
 
 public:
 	void SetMixer(PulseMixer &_mixer);
@@ -108,6 +133,7 @@ public:
 	void Close();
 
 	unsigned Delay();
+	unsigned GetLatency();
 	size_t Play(const void *chunk, size_t size, Error &error);
 	void Cancel();
 	bool Pause();
@@ -178,6 +204,24 @@ private:
 	 * Sets cork mode on the stream.
 	 */
 	bool StreamPause(bool pause, Error &error);
+
+	/**
+	 * Obtain a new #write_buffer.  The mainloop must be locked
+	 * before calling this function.
+	 */
+	bool BeginWrite(Error &error);
+
+	/**
+	 * Submit the data in #write_buffer to the server.  The
+	 * mainloop must be locked before calling this function.
+	 */
+	bool CommitWrite(Error &error);
+
+	/**
+	 * Discard #write_buffer.  The mainloop must be locked before
+	 * calling this function.
+	 */
+	void CancelWrite();
 };
 
 void
@@ -381,6 +425,9 @@ PulseOutput::DeleteStream()
 {
 	assert(stream != nullptr);
 
+	if (write_buffer != nullptr)
+		CancelWrite();
+
 	pa_stream_set_suspended_callback(stream, nullptr, nullptr);
 
 	pa_stream_set_state_callback(stream, nullptr, nullptr);
@@ -688,6 +735,9 @@ PulseOutput::Open(AudioFormat &audio_format, Error &error)
 	ss.rate = audio_format.sample_rate;
 	ss.channels = audio_format.channels;
 
+	frame_size = pa_frame_size(&ss);
+	max_batch_size = pa_usec_to_bytes(50000, &ss);
+
 	/* create a stream .. */
 
 	if (!SetupStream(ss, error)) {
@@ -698,7 +748,9 @@ PulseOutput::Open(AudioFormat &audio_format, Error &error)
 	/* .. and connect it (asynchronously) */
 
 	if (pa_stream_connect_playback(stream, sink,
-				       nullptr, pa_stream_flags_t(0),
+				       nullptr,
+				       pa_stream_flags_t(PA_STREAM_INTERPOLATE_TIMING|
+							 PA_STREAM_AUTO_TIMING_UPDATE),
 				       nullptr, nullptr) < 0) {
 		DeleteStream();
 
@@ -719,6 +771,10 @@ PulseOutput::Close()
 
 	pa_threaded_mainloop_lock(mainloop);
 
+	if (write_buffer != nullptr &&
+	    pa_stream_get_state(stream) == PA_STREAM_READY)
+		CommitWrite(IgnoreError());
+
 	if (pa_stream_get_state(stream) == PA_STREAM_READY) {
 		pa_operation *o =
 			pa_stream_drain(stream,
@@ -788,6 +844,10 @@ PulseOutput::StreamPause(bool pause, Error &error)
 inline unsigned
 PulseOutput::Delay()
 {
+	if (write_buffer != nullptr)
+		/* Play() can fill #write_buffer without waiting */
+		return 0;
+
 	pa_threaded_mainloop_lock(mainloop);
 
 	unsigned result = 0;
@@ -801,62 +861,149 @@ PulseOutput::Delay()
 	return result;
 }
 
-inline size_t
-PulseOutput::Play(const void *chunk, size_t size, Error &error)
+inline unsigned
+PulseOutput::GetLatency()
 {
-	assert(mainloop != nullptr);
-	assert(stream != nullptr);
-
 	pa_threaded_mainloop_lock(mainloop);
 
+	pa_usec_t latency;
+	int negative;
+	unsigned result = 0;
+	if (stream != nullptr &&
+	    pa_stream_get_state(stream) == PA_STREAM_READY &&
+	    pa_stream_get_latency(stream, &latency, &negative) == 0 &&
+	    !negative)
+		result = latency;
+
+	pa_threaded_mainloop_unlock(mainloop);
+
+	return result;
+}
+
+bool
+PulseOutput::BeginWrite(Error &error)
+{
+	assert(write_buffer == nullptr);
+
 	/* check if the stream is (already) connected */
 
-	if (!WaitStream(error)) {
-		pa_threaded_mainloop_unlock(mainloop);
-		return 0;
-	}
+	if (!WaitStream(error))
+		return false;
 
 	assert(context != nullptr);
 
 	/* unpause if previously paused */
 
-	if (pa_stream_is_corked(stream) && !StreamPause(false, error)) {
-		pa_threaded_mainloop_unlock(mainloop);
-		return 0;
-	}
+	if (pa_stream_is_corked(stream) && !StreamPause(false, error))
+		return false;
 
 	/* wait until the server allows us to write */
 
-	while (writable == 0) {
+	while (writable < frame_size) {
 		if (pa_stream_is_suspended(stream)) {
-			pa_threaded_mainloop_unlock(mainloop);
 			error.Set(pulse_domain, "suspended");
-			return 0;
+			return false;
 		}
 
 		pa_threaded_mainloop_wait(mainloop);
 
 		if (pa_stream_get_state(stream) != PA_STREAM_READY) {
-			pa_threaded_mainloop_unlock(mainloop);
 			error.Set(pulse_domain, "disconnected");
-			return 0;
+			return false;
 		}
 	}
 
-	/* now write */
+	/* don't ask for more than the server wants */
 
-	if (size > writable)
-		/* don't send more than possible */
-		size = writable;
+	size_t nbytes = std::min(writable, max_batch_size);
+	nbytes -= nbytes % frame_size;
 
-	writable -= size;
+	void *p;
+	if (pa_stream_begin_write(stream, &p, &nbytes) < 0 || p == nullptr) {
+		SetPulseError(error, context,
+			      "pa_stream_begin_write() failed");
+		return false;
+	}
+
+	/* the server may return less */
+	nbytes -= nbytes % frame_size;
+	if (nbytes == 0) {
+		pa_stream_cancel_write(stream);
+		error.Set(pulse_domain, "pa_stream_begin_write() failed");
+		return false;
+	}
+
+	write_buffer = (uint8_t *)p;
+	write_size = nbytes;
+	write_position = 0;
+	return true;
+}
+
+bool
+PulseOutput::CommitWrite(Error &error)
+{
+	assert(write_buffer != nullptr);
+
+	if (write_position == 0) {
+		CancelWrite();
+		return true;
+	}
+
+	/* this is the memory returned by pa_stream_begin_write(), so
+	   it is not copied again */
+	int result = pa_stream_write(stream, write_buffer, write_position,
+				     nullptr, 0, PA_SEEK_RELATIVE);
+	write_buffer = nullptr;
 
-	int result = pa_stream_write(stream, chunk, size, nullptr,
-				     0, PA_SEEK_RELATIVE);
-	pa_threaded_mainloop_unlock(mainloop);
 	if (result < 0) {
 		SetPulseError(error, context, "pa_stream_write() failed");
-		return 0;
+		return false;
+	}
+
+	writable = writable > write_position
+		? writable - write_position
+		: 0;
+	return true;
+}
+
+void
+PulseOutput::CancelWrite()
+{
+	assert(write_buffer != nullptr);
+
+	pa_stream_cancel_write(stream);
+	write_buffer = nullptr;
+}
+
+inline size_t
+PulseOutput::Play(const void *chunk, size_t size, Error &error)
+{
+	assert(mainloop != nullptr);
+	assert(stream != nullptr);
+
+	if (write_buffer == nullptr) {
+		pa_threaded_mainloop_lock(mainloop);
+		const bool success = BeginWrite(error);
+		pa_threaded_mainloop_unlock(mainloop);
+		if (!success)
+			return 0;
+	}
+
+	/* the buffer belongs to us until it is committed; filling it
+	   does not need the lock */
+
+	if (size > write_size - write_position)
+		size = write_size - write_position;
+
+	memcpy(write_buffer + write_position, chunk, size);
+	write_position += size;
+
+	if (write_position == write_size) {
+		pa_threaded_mainloop_lock(mainloop);
+		const bool success = CommitWrite(error);
+		pa_threaded_mainloop_unlock(mainloop);
+		if (!success)
+			return 0;
 	}
 
 	return size;
@@ -870,6 +1017,9 @@ PulseOutput::Cancel()
 
 	pa_threaded_mainloop_lock(mainloop);
 
+	if (write_buffer != nullptr)
+		CancelWrite();
+
 	if (pa_stream_get_state(stream) != PA_STREAM_READY) {
 		/* no need to flush when the stream isn't connected
 		   yet */
@@ -911,7 +1061,14 @@ PulseOutput::Pause()
 
 	assert(context != nullptr);
 
-	/* cork the stream */
+	/* submit what has been played so far, and cork the
+	   stream */
+
+	if (write_buffer != nullptr && !CommitWrite(error)) {
+		pa_threaded_mainloop_unlock(mainloop);
+		LogError(error);
+		return false;
+	}
 
 	if (!pa_stream_is_corked(stream) && !StreamPause(true, error)) {
 		pa_threaded_mainloop_unlock(mainloop);
@@ -959,6 +1116,7 @@ const struct AudioOutputPlugin pulse_output_plugin = {
 	nullptr,
 	&Wrapper::Cancel,
 	&Wrapper::Pause,
+	&Wrapper::GetLatency,
 
 	&pulse_mixer_plugin,
 };
@@ -22,20 +22,28 @@
 #include "../OutputAPI.hxx"
 #include "../Wrapper.hxx"
 #include "tag/Format.hxx"
+#include "tag/Tag.hxx"
 #include "encoder/ToOutputStream.hxx"
 #include "encoder/EncoderInterface.hxx"
 #include "encoder/EncoderPlugin.hxx"
+#include "encoder/EncoderGroup.hxx"
 #include "encoder/EncoderList.hxx"
 #include "config/ConfigError.hxx"
 #include "config/ConfigPath.hxx"
 #include "Log.hxx"
 #include "fs/AllocatedPath.hxx"
-#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/AsyncFileOutputStream.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 
+#include <memory>
+#include <string>
+
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 static constexpr Domain recorder_domain("recorder");
 
@@ -50,7 +58,8 @@ class RecorderOutput {
 	Encoder *encoder;
 
 	/**
-	 * The destination file name.
+	 * The destination file name.  With segment rotation, each
+	 * segment gets a time stamp inserted before the suffix.
 	 */
 	AllocatedPath path;
 
@@ -60,6 +69,32 @@ class RecorderOutput {
 	 */
 	std::string format_path;
 
+	/**
+	 * Start a new segment after this number of seconds (0 =
+	 * disabled).  Segments begin at multiples of this duration
+	 * (UTC).
+	 */
+	unsigned rotate_time;
+
+	/**
+	 * Start a new segment after this number of bytes (0 =
+	 * disabled).
+	 */
+	uint64_t rotate_size;
+
+	/**
+	 * The #rotate_time period of the current segment.
+	 */
+	time_t segment_period;
+
+	/**
+	 * The time stamp of the most recent segment file name, and a
+	 * counter which makes names unique if several segments start
+	 * within the same second.
+	 */
+	time_t segment_time;
+	unsigned segment_counter;
+
 	/**
 	 * The #AudioFormat that is currently active.  This is used
 	 * for switching to another file.
@@ -67,9 +102,15 @@ class RecorderOutput {
 	AudioFormat effective_audio_format;
 
 	/**
-	 * The destination file.
+	 * The most recent tag; it is written again to each new
+	 * segment.
+	 */
+	std::unique_ptr<Tag> last_tag;
+
+	/**
+	 * The destination file; written in a separate thread.
 	 */
-	FileOutputStream *file;
+	std::unique_ptr<AsyncFileOutputStream> file;
 
 	RecorderOutput()
 		:base(recorder_output_plugin),
@@ -107,11 +148,45 @@ private:
 		return !format_path.empty();
 	}
 
+	bool IsSegmented() const {
+		return rotate_time > 0 || rotate_size > 0;
+	}
+
+	/**
+	 * Build the file name of a new segment starting now.
+	 */
+	AllocatedPath MakeSegmentPath(Error &error);
+
+	/**
+	 * Create the file for a new segment of #path.
+	 */
+	bool OpenFile(Error &error);
+
 	/**
-	 * Finish the encoder and commit the file.
+	 * Finish the encoder and commit the file.  The file is
+	 * closed asynchronously.
 	 */
 	bool Commit(Error &error);
 
+	/**
+	 * Does the current segment need to be rotated?
+	 */
+	gcc_pure
+	bool ShouldRotate() const;
+
+	/**
+	 * Finish the current segment and begin a new one.  The
+	 * encoder is restarted, so each segment is a complete file,
+	 * but the old file is committed in the writer thread.
+	 */
+	bool Rotate(Error &error);
+
+	/**
+	 * Open the encoder after a file has been created, and write
+	 * its header and the most recent tag.
+	 */
+	bool ReopenEncoder(Error &error);
+
 	void FinishFormat();
 	bool ReopenFormat(AllocatedPath &&new_path, Error &error);
 };
@@ -148,12 +223,23 @@ RecorderOutput::Configure(const ConfigBlock &block, Error &error)
 		return false;
 	}
 
+	rotate_time = block.GetBlockValue("rotate_time", 0u);
+	rotate_size = uint64_t(block.GetBlockValue("rotate_size", 0u)) * 1024;
+
+	const uint64_t sync_size =
+		uint64_t(block.GetBlockValue("sync_size", 0u)) * 1024;
+	const uint64_t preallocate =
+		uint64_t(block.GetBlockValue("preallocate", 0u)) * 1024;
+
 	/* initialize encoder */
 
-	encoder = encoder_init(*encoder_plugin, block, error);
+	encoder = encoder_group_init(*encoder_plugin, block, error);
 	if (encoder == nullptr)
 		return false;
 
+	file.reset(new AsyncFileOutputStream(sync_size, preallocate));
+	segment_time = 0;
+
 	return true;
 }
 
@@ -178,12 +264,74 @@ RecorderOutput::Create(const ConfigBlock &block, Error &error)
 inline bool
 RecorderOutput::EncoderToFile(Error &error)
 {
-	assert(file != nullptr);
-	assert(file->IsDefined());
+	assert(file->IsOpen());
 
 	return EncoderToOutputStream(*file, *encoder, error);
 }
 
+AllocatedPath
+RecorderOutput::MakeSegmentPath(Error &error)
+{
+	assert(!path.IsNull());
+
+	if (!IsSegmented())
+		return AllocatedPath(path);
+
+	const time_t t = time(nullptr);
+	segment_period = rotate_time > 0 ? t / rotate_time : 0;
+
+	if (t == segment_time)
+		++segment_counter;
+	else {
+		segment_time = t;
+		segment_counter = 0;
+	}
+
+#ifdef WIN32
+	const struct tm *tm = gmtime(&t);
+#else
+	struct tm tm_buffer;
+	const struct tm *tm = gmtime_r(&t, &tm_buffer);
+#endif
+
+	char stamp[64] = "";
+	if (tm != nullptr) {
+		size_t length = strftime(stamp, sizeof(stamp) - 16,
+					 "-%Y%m%dT%H%M%SZ", tm);
+		if (segment_counter > 0)
+			snprintf(stamp + length, sizeof(stamp) - length,
+				 "-%u", segment_counter);
+	}
+
+	/* insert the time stamp before the suffix */
+	std::string s = path.ToUTF8();
+	size_t dot = s.rfind('.');
+	size_t slash = s.find_last_of("/\\");
+	if (dot == std::string::npos ||
+	    (slash != std::string::npos && dot < slash))
+		dot = s.length();
+
+	s.insert(dot, stamp);
+	return AllocatedPath::FromUTF8(s.c_str(), error);
+}
+
+bool
+RecorderOutput::OpenFile(Error &error)
+{
+	const AllocatedPath segment_path = MakeSegmentPath(error);
+	if (segment_path.IsNull())
+		return false;
+
+	if (!file->Open(segment_path, error))
+		return false;
+
+	if (IsSegmented())
+		FormatDebug(recorder_domain, "Recording to \"%s\"",
+			    segment_path.ToUTF8().c_str());
+
+	return true;
+}
+
 inline bool
 RecorderOutput::Open(AudioFormat &audio_format, Error &error)
 {
@@ -192,34 +340,33 @@ RecorderOutput::Open(AudioFormat &audio_format, Error &error)
 	if (!HasDynamicPath()) {
 		assert(!path.IsNull());
 
-		file = FileOutputStream::Create(path, error);
-		if (file == nullptr)
+		if (!OpenFile(error))
 			return false;
 	} else {
 		/* don't open the file just yet; wait until we have
 		   a tag that we can use to build the path */
 		assert(path.IsNull());
-
-		file = nullptr;
 	}
 
 	/* open the encoder */
 
 	if (!encoder->Open(audio_format, error)) {
-		delete file;
+		if (file->IsOpen())
+			file->Cancel();
 		return false;
 	}
 
+	/* remember the AudioFormat for ReopenFormat() and
+	   Rotate() */
+	effective_audio_format = audio_format;
+
 	if (!HasDynamicPath()) {
 		if (!EncoderToFile(error)) {
 			encoder->Close();
-			delete file;
+			file->Cancel();
 			return false;
 		}
 	} else {
-		/* remember the AudioFormat for ReopenFormat() */
-		effective_audio_format = audio_format;
-
 		/* close the encoder for now; it will be opened as
 		   soon as we have received a tag */
 		encoder->Close();
@@ -242,10 +389,10 @@ RecorderOutput::Commit(Error &error)
 
 	encoder->Close();
 
-	if (success && !file->Commit(error))
-		success = false;
-
-	delete file;
+	if (success)
+		success = file->Commit(error);
+	else
+		file->Cancel();
 
 	return success;
 }
@@ -253,22 +400,75 @@ RecorderOutput::Commit(Error &error)
 inline void
 RecorderOutput::Close()
 {
-	if (file == nullptr) {
-		/* not currently encoding to a file; nothing needs to
-		   be done now */
-		assert(HasDynamicPath());
-		assert(path.IsNull());
-		return;
+	last_tag.reset();
+
+	/* if not currently encoding to a file (or if a segment
+	   rotation has failed), nothing needs to be committed */
+	if (file->IsOpen()) {
+		Error error;
+		if (!Commit(error))
+			LogError(error);
 	}
 
+	if (HasDynamicPath())
+		path.SetNull();
+
+	/* wait for the writer thread, to report its errors and to
+	   have all files complete when the output is closed */
 	Error error;
-	if (!Commit(error))
+	if (!file->Drain(error))
 		LogError(error);
+}
 
-	if (HasDynamicPath()) {
-		assert(!path.IsNull());
-		path.SetNull();
+inline bool
+RecorderOutput::ShouldRotate() const
+{
+	return (rotate_size > 0 && file->GetFileSize() >= rotate_size) ||
+		(rotate_time > 0 &&
+		 time(nullptr) / rotate_time != segment_period);
+}
+
+bool
+RecorderOutput::ReopenEncoder(Error &error)
+{
+	AudioFormat new_audio_format = effective_audio_format;
+	if (!encoder->Open(new_audio_format, error))
+		return false;
+
+	/* reopening the encoder must always result in the same
+	   AudioFormat as before */
+	assert(new_audio_format == effective_audio_format);
+
+	if (!EncoderToFile(error)) {
+		encoder->Close();
+		return false;
+	}
+
+	if (last_tag != nullptr &&
+	    (!encoder_pre_tag(encoder, error) ||
+	     !EncoderToFile(error) ||
+	     !encoder_tag(encoder, *last_tag, error))) {
+		encoder->Close();
+		return false;
 	}
+
+	return true;
+}
+
+bool
+RecorderOutput::Rotate(Error &error)
+{
+	if (Commit(error) && OpenFile(error)) {
+		if (ReopenEncoder(error))
+			return true;
+
+		file->Cancel();
+	}
+
+	if (HasDynamicPath())
+		path.SetNull();
+
+	return false;
 }
 
 void
@@ -276,14 +476,13 @@ RecorderOutput::FinishFormat()
 {
 	assert(HasDynamicPath());
 
-	if (file == nullptr)
+	if (!file->IsOpen())
 		return;
 
 	Error error;
 	if (!Commit(error))
 		LogError(error);
 
-	file = nullptr;
 	path.SetNull();
 }
 
@@ -292,32 +491,25 @@ RecorderOutput::ReopenFormat(AllocatedPath &&new_path, Error &error)
 {
 	assert(HasDynamicPath());
 	assert(path.IsNull());
-	assert(file == nullptr);
+	assert(!file->IsOpen());
 
-	FileOutputStream *new_file =
-		FileOutputStream::Create(new_path, error);
-	if (new_file == nullptr)
-		return false;
+	path = std::move(new_path);
 
-	AudioFormat new_audio_format = effective_audio_format;
-	if (!encoder->Open(new_audio_format, error)) {
-		delete new_file;
+	if (!OpenFile(error)) {
+		path.SetNull();
 		return false;
 	}
 
-	/* reopening the encoder must always result in the same
-	   AudioFormat as before */
-	assert(new_audio_format == effective_audio_format);
+	/* the tag which caused the new path is sent by SendTag()
+	   after this method returns */
+	last_tag.reset();
 
-	if (!EncoderToOutputStream(*new_file, *encoder, error)) {
-		encoder->Close();
-		delete new_file;
+	if (!ReopenEncoder(error)) {
+		file->Cancel();
+		path.SetNull();
 		return false;
 	}
 
-	path = std::move(new_path);
-	file = new_file;
-
 	FormatDebug(recorder_domain, "Recording to \"%s\"",
 		    path.ToUTF8().c_str());
 
@@ -356,6 +548,11 @@ RecorderOutput::SendTag(const Tag &tag)
 		}
 	}
 
+	if (!file->IsOpen())
+		return;
+
+	last_tag.reset(new Tag(tag));
+
 	Error error;
 	if (!encoder_pre_tag(encoder, error) ||
 	    !EncoderToFile(error) ||
@@ -366,7 +563,7 @@ RecorderOutput::SendTag(const Tag &tag)
 inline size_t
 RecorderOutput::Play(const void *chunk, size_t size, Error &error)
 {
-	if (file == nullptr) {
+	if (!file->IsOpen()) {
 		/* not currently encoding to a file; discard incoming
 		   data */
 		assert(HasDynamicPath());
@@ -374,8 +571,15 @@ RecorderOutput::Play(const void *chunk, size_t size, Error &error)
 		return size;
 	}
 
-	return encoder_write(encoder, chunk, size, error) &&
-		EncoderToFile(error)
+	if (ShouldRotate() && !Rotate(error))
+		return 0;
+
+	if (!encoder_write(encoder, chunk, size, error))
+		return 0;
+
+	base.encoder_load = encoder_get_load(*encoder);
+
+	return EncoderToFile(error)
 		? size : 0;
 }
 
@@ -397,4 +601,5 @@ const struct AudioOutputPlugin recorder_output_plugin = {
 	nullptr,
 	nullptr,
 	nullptr,
+	nullptr,
 };
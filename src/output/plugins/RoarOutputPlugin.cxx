@@ -394,5 +394,6 @@ const struct AudioOutputPlugin roar_output_plugin = {
 	nullptr,
 	&Wrapper::Cancel,
 	nullptr,
+	nullptr,
 	&roar_mixer_plugin,
 };
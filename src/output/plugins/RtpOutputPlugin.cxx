@@ -0,0 +1,704 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "RtpOutputPlugin.hxx"
+#include "../OutputAPI.hxx"
+#include "../Wrapper.hxx"
+#include "../Timer.hxx"
+#include "encoder/EncoderInterface.hxx"
+#include "encoder/EncoderGroup.hxx"
+#include "encoder/EncoderList.hxx"
+#include "config/ConfigError.hxx"
+#include "net/Resolver.hxx"
+#include "net/StaticSocketAddress.hxx"
+#include "net/SocketError.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "system/ByteOrder.hxx"
+#include "system/fd_util.h"
+#include "util/DynamicFifoBuffer.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/**
+ * The default port for RTP audio (RFC 3551).
+ */
+static constexpr unsigned RTP_DEFAULT_PORT = 5004;
+
+/**
+ * The size of the fixed RTP header (RFC 3550 5.1) without CSRC
+ * list.
+ */
+static constexpr size_t RTP_HEADER_SIZE = 12;
+
+/**
+ * The RTP clock rate of Opus is always 48 kHz (RFC 7587 4.1).
+ */
+static constexpr unsigned OPUS_RTP_RATE = 48000;
+
+class RtpOutput {
+	friend struct AudioOutputWrapper<RtpOutput>;
+
+	enum class Payload {
+		L16, L24, OPUS,
+	};
+
+	AudioOutput base;
+
+	Payload payload;
+
+	std::string host;
+	StaticSocketAddress address;
+
+	unsigned ttl;
+
+	/**
+	 * The RTP payload type number.  0 means "choose one
+	 * automatically".
+	 */
+	unsigned payload_type;
+
+	/**
+	 * The maximum size of one RTP payload, derived from the
+	 * "mtu" setting.
+	 */
+	size_t max_payload_size;
+
+	/**
+	 * The Opus encoder (only if #payload is Payload::OPUS).
+	 */
+	Encoder *encoder;
+
+	int fd;
+
+	AudioFormat audio_format;
+
+	Timer *timer;
+
+	/**
+	 * The PCM samples of the current chunk, converted to network
+	 * byte order.
+	 */
+	PcmBuffer buffer;
+
+	/**
+	 * Encoder output which has not been demultiplexed yet: the
+	 * Opus encoder plugin writes Ogg pages, and each Opus packet
+	 * inside is sent as one RTP packet.
+	 */
+	DynamicFifoBuffer<uint8_t> ogg_buffer;
+
+	/**
+	 * An Opus packet which spans more than one Ogg page.
+	 */
+	std::vector<uint8_t> partial_packet;
+
+	uint8_t current_payload_type;
+	uint16_t sequence;
+	uint32_t timestamp;
+	uint32_t ssrc;
+
+	/**
+	 * Set the RTP marker bit on the next packet: it is the first
+	 * one after a gap.
+	 */
+	bool marker;
+
+	RtpOutput()
+		:base(rtp_output_plugin),
+		 encoder(nullptr), fd(-1),
+		 ogg_buffer(8192) {}
+
+	~RtpOutput() {
+		if (encoder != nullptr)
+			encoder->Dispose();
+	}
+
+	bool Configure(const ConfigBlock &block, Error &error);
+
+public:
+	static RtpOutput *Create(const ConfigBlock &block, Error &error);
+
+	bool Open(AudioFormat &audio_format, Error &error);
+	void Close();
+
+	unsigned Delay() const {
+		return timer->IsStarted()
+			? timer->GetDelay()
+			: 0;
+	}
+
+	size_t Play(const void *chunk, size_t size, Error &error);
+
+	void Cancel() {
+		timer->Reset();
+		marker = true;
+	}
+
+private:
+	bool OpenSocket(Error &error);
+
+	/**
+	 * Send one RTP packet.  The header and the payload are passed
+	 * to the kernel as two separate buffers; the payload is not
+	 * copied.
+	 *
+	 * @param frames the duration of the payload in RTP clock
+	 * ticks
+	 */
+	bool SendPacket(const void *payload, size_t size, unsigned frames,
+			Error &error);
+
+	bool PlayPCM(const void *chunk, size_t size, Error &error);
+	bool PlayOpus(const void *chunk, size_t size, Error &error);
+
+	bool SendOpusPacket(const uint8_t *packet, size_t size,
+			    Error &error);
+	bool SendOggPages(Error &error);
+};
+
+static constexpr Domain rtp_output_domain("rtp_output");
+
+inline bool
+RtpOutput::Configure(const ConfigBlock &block, Error &error)
+{
+	if (!base.Configure(block, error))
+		return false;
+
+	const char *value = block.GetBlockValue("payload", "L16");
+	if (strcmp(value, "L16") == 0)
+		payload = Payload::L16;
+	else if (strcmp(value, "L24") == 0)
+		payload = Payload::L24;
+	else if (strcmp(value, "opus") == 0)
+		payload = Payload::OPUS;
+	else {
+		error.Format(config_domain,
+			     "Unsupported RTP payload: \"%s\"", value);
+		return false;
+	}
+
+	value = block.GetBlockValue("host");
+	if (value == nullptr) {
+		error.Set(config_domain, "No \"host\" parameter specified");
+		return false;
+	}
+
+	host = value;
+
+	struct addrinfo *ai = resolve_host_port(value, RTP_DEFAULT_PORT,
+						0, SOCK_DGRAM, error);
+	if (ai == nullptr)
+		return false;
+
+	address = SocketAddress(ai->ai_addr, ai->ai_addrlen);
+	freeaddrinfo(ai);
+
+	ttl = block.GetBlockValue("ttl", 1u);
+	if (ttl < 1 || ttl > 255) {
+		error.Set(config_domain, "Invalid \"ttl\" value");
+		return false;
+	}
+
+	payload_type = block.GetBlockValue("payload_type", 0u);
+	if (payload_type != 0 && (payload_type < 96 || payload_type > 127)) {
+		error.Set(config_domain,
+			  "\"payload_type\" must be a dynamic payload type (96-127)");
+		return false;
+	}
+
+	/* subtract the IPv6 (or IPv4) and UDP headers */
+	const unsigned mtu = block.GetBlockValue("mtu", 1500u);
+	const size_t ip_udp_header_size =
+		(address.GetFamily() == AF_INET6 ? 40 : 20) + 8;
+	if (mtu < ip_udp_header_size + RTP_HEADER_SIZE + 256) {
+		error.Set(config_domain, "\"mtu\" is too small");
+		return false;
+	}
+
+	max_payload_size = mtu - ip_udp_header_size - RTP_HEADER_SIZE;
+
+	if (payload == Payload::OPUS) {
+		const EncoderPlugin *plugin = encoder_plugin_get("opus");
+		if (plugin == nullptr) {
+			error.Set(config_domain,
+				  "Opus encoder support is not compiled in");
+			return false;
+		}
+
+		encoder = encoder_group_init(*plugin, block, error);
+		if (encoder == nullptr)
+			return false;
+	}
+
+	return true;
+}
+
+inline RtpOutput *
+RtpOutput::Create(const ConfigBlock &block, Error &error)
+{
+	RtpOutput *ro = new RtpOutput();
+
+	if (!ro->Configure(block, error)) {
+		delete ro;
+		return nullptr;
+	}
+
+	return ro;
+}
+
+gcc_pure
+static bool
+IsMulticast(SocketAddress address)
+{
+	switch (address.GetFamily()) {
+	case AF_INET: {
+		const auto &sin = *(const struct sockaddr_in *)
+			address.GetAddress();
+		return IN_MULTICAST(FromBE32(sin.sin_addr.s_addr));
+	}
+
+#ifdef HAVE_IPV6
+	case AF_INET6: {
+		const auto &sin6 = *(const struct sockaddr_in6 *)
+			address.GetAddress();
+		return IN6_IS_ADDR_MULTICAST(&sin6.sin6_addr);
+	}
+#endif
+
+	default:
+		return false;
+	}
+}
+
+inline bool
+RtpOutput::OpenSocket(Error &error)
+{
+	fd = socket_cloexec_nonblock(address.GetFamily(), SOCK_DGRAM, 0);
+	if (fd < 0) {
+		SetSocketError(error);
+		error.AddPrefix("Failed to create socket: ");
+		return false;
+	}
+
+	if (IsMulticast(address)) {
+		/* one datagram reaches all receivers which have
+		   joined the group; the TTL limits how far it
+		   travels */
+		int result;
+#ifdef HAVE_IPV6
+		if (address.GetFamily() == AF_INET6) {
+			const int hops = ttl;
+			result = setsockopt(fd, IPPROTO_IPV6,
+					    IPV6_MULTICAST_HOPS,
+					    &hops, sizeof(hops));
+		} else
+#endif
+		{
+			const unsigned char value = ttl;
+			result = setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL,
+					    &value, sizeof(value));
+		}
+
+		if (result < 0) {
+			SetSocketError(error);
+			error.AddPrefix("Failed to set the multicast TTL: ");
+			close(fd);
+			fd = -1;
+			return false;
+		}
+	}
+
+	if (connect(fd, address, address.GetSize()) < 0) {
+		SetSocketError(error);
+		error.FormatPrefix("Failed to connect to \"%s\": ",
+				   host.c_str());
+		close(fd);
+		fd = -1;
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Choose a payload type: the static ones from RFC 3551 if the format
+ * matches, 96 (the first dynamic one) otherwise.
+ */
+gcc_pure
+static uint8_t
+ChoosePayloadType(bool l16, const AudioFormat &audio_format)
+{
+	if (l16 && audio_format.sample_rate == 44100) {
+		if (audio_format.channels == 2)
+			return 10;
+		if (audio_format.channels == 1)
+			return 11;
+	}
+
+	return 96;
+}
+
+inline bool
+RtpOutput::Open(AudioFormat &_audio_format, Error &error)
+{
+	switch (payload) {
+	case Payload::L16:
+		_audio_format.format = SampleFormat::S16;
+		break;
+
+	case Payload::L24:
+		_audio_format.format = SampleFormat::S24_P32;
+		break;
+
+	case Payload::OPUS:
+		if (!encoder->Open(_audio_format, error))
+			return false;
+
+		ogg_buffer.Clear();
+		partial_packet.clear();
+		break;
+	}
+
+	if (!OpenSocket(error)) {
+		if (encoder != nullptr)
+			encoder->Close();
+		return false;
+	}
+
+	audio_format = _audio_format;
+	current_payload_type = payload_type != 0
+		? payload_type
+		: ChoosePayloadType(payload == Payload::L16, audio_format);
+
+	/* random initial values, as recommended by RFC 3550 5.1 */
+	std::random_device rd;
+	sequence = rd();
+	timestamp = rd();
+	ssrc = rd();
+	marker = true;
+
+	timer = new Timer(audio_format);
+	return true;
+}
+
+inline void
+RtpOutput::Close()
+{
+	delete timer;
+
+	close(fd);
+	fd = -1;
+
+	if (encoder != nullptr)
+		encoder->Close();
+}
+
+inline bool
+RtpOutput::SendPacket(const void *data, size_t size, unsigned frames,
+		      Error &error)
+{
+	assert(size <= max_payload_size);
+
+	uint8_t header[RTP_HEADER_SIZE];
+	header[0] = 0x80; /* version 2 */
+	header[1] = current_payload_type | (marker ? 0x80 : 0);
+	*(uint16_t *)(header + 2) = ToBE16(sequence);
+	*(uint32_t *)(header + 4) = ToBE32(timestamp);
+	*(uint32_t *)(header + 8) = ToBE32(ssrc);
+
+	struct iovec iov[2];
+	iov[0].iov_base = header;
+	iov[0].iov_len = sizeof(header);
+	iov[1].iov_base = const_cast<void *>(data);
+	iov[1].iov_len = size;
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+
+	if (sendmsg(fd, &msg, MSG_NOSIGNAL) < 0) {
+		const socket_error_t code = GetSocketError();
+
+		/* a unicast receiver which is not (yet) running
+		   makes the kernel report "connection refused" for a
+		   later datagram, and a full socket buffer loses
+		   this one; neither is a reason to stop playback */
+		if (code != ECONNREFUSED && !IsSocketErrorAgain(code) &&
+		    !IsSocketErrorInterruped(code)) {
+			SetSocketError(error, code);
+			error.FormatPrefix("Failed to send to \"%s\": ",
+					   host.c_str());
+			return false;
+		}
+	}
+
+	marker = false;
+	++sequence;
+	timestamp += frames;
+	return true;
+}
+
+inline bool
+RtpOutput::PlayPCM(const void *chunk, size_t size, Error &error)
+{
+	const size_t n_samples = size / audio_format.GetSampleSize();
+	const uint8_t *data;
+	size_t sample_size;
+
+	if (payload == Payload::L16) {
+		sample_size = 2;
+
+		if (IsBigEndian()) {
+			/* already in network byte order */
+			data = (const uint8_t *)chunk;
+		} else {
+			const uint16_t *src = (const uint16_t *)chunk;
+			uint16_t *dest = buffer.GetT<uint16_t>(n_samples);
+			for (size_t i = 0; i < n_samples; ++i)
+				dest[i] = ToBE16(src[i]);
+			data = (const uint8_t *)dest;
+		}
+	} else {
+		/* pack 24 bit samples, most significant byte
+		   first */
+		sample_size = 3;
+
+		const int32_t *src = (const int32_t *)chunk;
+		uint8_t *dest = buffer.GetT<uint8_t>(n_samples * 3);
+		for (size_t i = 0; i < n_samples; ++i) {
+			const uint32_t s = src[i];
+			dest[i * 3] = s >> 16;
+			dest[i * 3 + 1] = s >> 8;
+			dest[i * 3 + 2] = s;
+		}
+
+		data = dest;
+	}
+
+	/* split the converted chunk into packets; each one refers to
+	   its slice of the buffer */
+	const size_t frame_size = sample_size * audio_format.channels;
+	const size_t packet_frames = max_payload_size / frame_size;
+	size_t frames = n_samples / audio_format.channels;
+
+	while (frames > 0) {
+		const size_t n = std::min(frames, packet_frames);
+		if (!SendPacket(data, n * frame_size, n, error))
+			return false;
+
+		data += n * frame_size;
+		frames -= n;
+	}
+
+	return true;
+}
+
+/**
+ * Determine the number of 48 kHz samples in an Opus packet from its
+ * TOC byte (RFC 6716 3.1).
+ */
+gcc_pure
+static unsigned
+GetOpusPacketSamples(const uint8_t *packet, size_t size)
+{
+	if (size < 1)
+		return 0;
+
+	const unsigned config = packet[0] >> 3;
+	unsigned frame_samples;
+	if (config < 12)
+		/* SILK: 10, 20, 40, 60 ms */
+		frame_samples = 480 << (config & 0x3);
+	else if (config < 16)
+		/* hybrid: 10, 20 ms */
+		frame_samples = 480 << (config & 0x1);
+	else
+		/* CELT: 2.5, 5, 10, 20 ms */
+		frame_samples = 120 << (config & 0x3);
+
+	switch (packet[0] & 0x3) {
+	case 0:
+		return frame_samples;
+
+	case 1:
+	case 2:
+		return 2 * frame_samples;
+
+	default:
+		return size >= 2
+			? (packet[1] & 0x3f) * frame_samples
+			: 0;
+	}
+}
+
+inline bool
+RtpOutput::SendOpusPacket(const uint8_t *packet, size_t size,
+			  Error &error)
+{
+	/* skip the Ogg Opus headers (RFC 7845 5); they are not sent
+	   over RTP */
+	if ((size >= 8 && memcmp(packet, "OpusHead", 8) == 0) ||
+	    (size >= 8 && memcmp(packet, "OpusTags", 8) == 0))
+		return true;
+
+	if (size > max_payload_size)
+		/* cannot happen with a sane MTU and bit rate */
+		return true;
+
+	return SendPacket(packet, size,
+			  GetOpusPacketSamples(packet, size), error);
+}
+
+inline bool
+RtpOutput::SendOggPages(Error &error)
+{
+	while (true) {
+		auto r = ogg_buffer.Read();
+		const uint8_t *page = r.data;
+
+		/* the Ogg page header (RFC 3533 6) */
+		if (r.size < 27)
+			return true;
+
+		if (memcmp(page, "OggS", 4) != 0) {
+			error.Set(rtp_output_domain,
+				  "Malformed Ogg page from encoder");
+			return false;
+		}
+
+		const unsigned n_segments = page[26];
+		const size_t header_size = 27 + n_segments;
+		if (r.size < header_size)
+			return true;
+
+		size_t body_size = 0;
+		for (unsigned i = 0; i < n_segments; ++i)
+			body_size += page[27 + i];
+
+		if (r.size < header_size + body_size)
+			return true;
+
+		/* each packet is a run of 255 byte lacing values
+		   terminated by a shorter one; a run which reaches
+		   the end of the page continues on the next page */
+		const uint8_t *p = page + header_size, *start = p;
+		for (unsigned i = 0; i < n_segments; ++i) {
+			const unsigned lacing = page[27 + i];
+			p += lacing;
+
+			if (lacing == 255)
+				continue;
+
+			bool success;
+			if (partial_packet.empty()) {
+				/* the usual case: send directly from
+				   the page */
+				success = SendOpusPacket(start, p - start,
+							 error);
+			} else {
+				partial_packet.insert(partial_packet.end(),
+						      start, p);
+				success = SendOpusPacket(partial_packet.data(),
+							 partial_packet.size(),
+							 error);
+				partial_packet.clear();
+			}
+
+			if (!success)
+				return false;
+
+			start = p;
+		}
+
+		partial_packet.insert(partial_packet.end(), start, p);
+
+		ogg_buffer.Consume(header_size + body_size);
+	}
+}
+
+inline bool
+RtpOutput::PlayOpus(const void *chunk, size_t size, Error &error)
+{
+	if (!encoder_write(encoder, chunk, size, error) ||
+	    !encoder_flush(encoder, error))
+		return false;
+
+	base.encoder_load = encoder_get_load(*encoder);
+
+	while (true) {
+		uint8_t *dest = ogg_buffer.Write(4096);
+		const size_t nbytes = encoder_read(encoder, dest, 4096);
+		if (nbytes == 0)
+			break;
+
+		ogg_buffer.Append(nbytes);
+	}
+
+	return SendOggPages(error);
+}
+
+inline size_t
+RtpOutput::Play(const void *chunk, size_t size, Error &error)
+{
+	/* RTP has no flow control; send in real time */
+	if (!timer->IsStarted())
+		timer->Start();
+	timer->Add(size);
+
+	const bool success = payload == Payload::OPUS
+		? PlayOpus(chunk, size, error)
+		: PlayPCM(chunk, size, error);
+	return success ? size : 0;
+}
+
+typedef AudioOutputWrapper<RtpOutput> Wrapper;
+
+const struct AudioOutputPlugin rtp_output_plugin = {
+	"rtp",
+	nullptr,
+	&Wrapper::Init,
+	&Wrapper::Finish,
+	nullptr,
+	nullptr,
+	&Wrapper::Open,
+	&Wrapper::Close,
+	&Wrapper::Delay,
+	nullptr,
+	&Wrapper::Play,
+	nullptr,
+	&Wrapper::Cancel,
+	nullptr,
+	nullptr,
+	nullptr,
+};
@@ -20,17 +20,29 @@
 #include "config.h"
 #include "ShoutOutputPlugin.hxx"
 #include "../OutputAPI.hxx"
+#include "../Timer.hxx"
 #include "encoder/EncoderInterface.hxx"
 #include "encoder/EncoderPlugin.hxx"
+#include "encoder/EncoderGroup.hxx"
 #include "encoder/EncoderList.hxx"
 #include "config/ConfigError.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "event/TimeoutMonitor.hxx"
+#include "event/Call.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "IOThread.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "system/FatalError.hxx"
+#include "system/Clock.hxx"
 #include "Log.hxx"
 
 #include <shout/shout.h>
 
+#include <deque>
+#include <vector>
+
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
@@ -38,7 +50,62 @@
 
 static constexpr unsigned DEFAULT_CONN_TIMEOUT = 2;
 
-struct ShoutOutput final {
+/**
+ * The default limit of the send buffer [KiB].
+ */
+static constexpr unsigned DEFAULT_BUFFER_SIZE = 256;
+
+/**
+ * libshout does not expose its socket, therefore the IOThread polls
+ * it at this interval [ms] while connecting or while data is pending.
+ */
+static constexpr unsigned SHOUT_POLL_MS = 10;
+
+/**
+ * What to do when the send buffer is full because the server does
+ * not accept data quickly enough.
+ */
+enum class ShoutDropPolicy {
+	/**
+	 * Wait until there is enough room.  This stalls playback
+	 * while the server is slow.
+	 */
+	BLOCK,
+
+	/**
+	 * Discard the oldest buffered data.
+	 */
+	OLDEST,
+
+	/**
+	 * Discard the new data.
+	 */
+	NEWEST,
+};
+
+/**
+ * One portion of encoded data, as returned by encoder_read().
+ */
+struct ShoutChunk {
+	std::vector<uint8_t> data;
+
+	/**
+	 * Stream headers must never be dropped, because the stream
+	 * cannot be decoded without them.
+	 */
+	bool keep;
+
+	ShoutChunk(const uint8_t *_data, size_t size, bool _keep)
+		:data(_data, _data + size), keep(_keep) {}
+};
+
+/**
+ * The connection to the server is non-blocking and is driven by the
+ * IOThread: the output thread only encodes and appends to a bounded
+ * buffer, so a slow or unreachable server never stalls it (unless
+ * the drop policy is #ShoutDropPolicy::BLOCK).
+ */
+struct ShoutOutput final : DeferredMonitor, TimeoutMonitor {
 	AudioOutput base;
 
 	shout_t *shout_conn;
@@ -46,20 +113,79 @@ struct ShoutOutput final {
 
 	Encoder *encoder;
 
+	::Timer *timer;
+
 	float quality;
 	int bitrate;
 
 	int timeout;
 
+	/**
+	 * The maximum number of bytes in #chunks.
+	 */
+	size_t buffer_limit;
+
+	ShoutDropPolicy drop_policy;
+
 	uint8_t buffer[32768];
 
+	/**
+	 * Protects #shout_conn and all of the following attributes.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Signalled by the IOThread when it has made room in the
+	 * buffer or when the connection has failed.
+	 */
+	Cond cond;
+
+	enum class State {
+		CLOSED,
+		CONNECTING,
+		CONNECTED,
+
+		/**
+		 * The connection has failed; #error describes the
+		 * problem, and the output thread reports it.
+		 */
+		FAILED,
+	} state;
+
+	/**
+	 * The MonotonicClockMS() value at which connecting shall be
+	 * aborted.
+	 */
+	unsigned connect_deadline;
+
+	/**
+	 * Encoded data which has not yet been passed to libshout.
+	 */
+	std::deque<ShoutChunk> chunks;
+
+	/**
+	 * The number of bytes in #chunks.
+	 */
+	size_t buffered;
+
+	/**
+	 * The number of bytes discarded by the drop policy since the
+	 * output was opened.
+	 */
+	unsigned long dropped;
+
+	Error error;
+
 	ShoutOutput()
-		:base(shout_output_plugin),
+		:DeferredMonitor(io_thread_get()),
+		 TimeoutMonitor(io_thread_get()),
+		 base(shout_output_plugin),
 		 shout_conn(shout_new()),
 		shout_meta(shout_metadata_new()),
 		quality(-2.0),
 		bitrate(-1),
-		timeout(DEFAULT_CONN_TIMEOUT) {}
+		timeout(DEFAULT_CONN_TIMEOUT),
+		state(State::CLOSED) {}
 
 	~ShoutOutput() {
 		if (shout_meta != nullptr)
@@ -73,6 +199,48 @@ struct ShoutOutput final {
 	}
 
 	bool Configure(const ConfigBlock &block, Error &error);
+
+	/**
+	 * Prepare the asynchronous connection.  The IOThread connects
+	 * as soon as Schedule() is called.
+	 */
+	void Start();
+
+	/**
+	 * Append encoded data to the buffer, applying the drop
+	 * policy.  Called by the output thread.
+	 */
+	bool Append(const uint8_t *data, size_t size, bool keep,
+		    Error &error);
+
+	/**
+	 * Discard all buffered data except for stream headers.
+	 */
+	void DropBuffered();
+
+	/**
+	 * Close the connection.  Runs in the IOThread.
+	 */
+	void CloseConnection();
+
+private:
+	/**
+	 * Connect or send buffered data, as far as possible without
+	 * blocking.  Runs in the IOThread, and the caller must hold
+	 * the mutex.
+	 */
+	void Poll();
+
+	void Connect();
+	void Send();
+
+	void Fail(Error &&_error);
+
+	/* virtual methods from class DeferredMonitor */
+	void RunDeferred() override;
+
+	/* virtual methods from class TimeoutMonitor */
+	void OnTimeout() override;
 };
 
 static int shout_init_count;
@@ -174,7 +342,7 @@ ShoutOutput::Configure(const ConfigBlock &block, Error &error)
 		return false;
 	}
 
-	encoder = encoder_init(*encoder_plugin, block, error);
+	encoder = encoder_group_init(*encoder_plugin, block, error);
 	if (encoder == nullptr)
 		return false;
 
@@ -220,7 +388,8 @@ ShoutOutput::Configure(const ConfigBlock &block, Error &error)
 	    shout_set_format(shout_conn, shout_format)
 	    != SHOUTERR_SUCCESS ||
 	    shout_set_protocol(shout_conn, protocol) != SHOUTERR_SUCCESS ||
-	    shout_set_agent(shout_conn, "MPD") != SHOUTERR_SUCCESS) {
+	    shout_set_agent(shout_conn, "MPD") != SHOUTERR_SUCCESS ||
+	    shout_set_nonblocking(shout_conn, 1) != SHOUTERR_SUCCESS) {
 		error.Set(shout_output_domain, shout_get_error(shout_conn));
 		return false;
 	}
@@ -228,6 +397,28 @@ ShoutOutput::Configure(const ConfigBlock &block, Error &error)
 	/* optional paramters */
 	timeout = block.GetBlockValue("timeout", DEFAULT_CONN_TIMEOUT);
 
+	buffer_limit = block.GetBlockValue("buffer_size",
+					   DEFAULT_BUFFER_SIZE) * 1024;
+	if (buffer_limit == 0) {
+		error.Set(config_domain, "buffer_size must be positive");
+		return false;
+	}
+
+	value = block.GetBlockValue("drop_policy", "oldest");
+	if (strcmp(value, "block") == 0)
+		drop_policy = ShoutDropPolicy::BLOCK;
+	else if (strcmp(value, "oldest") == 0)
+		drop_policy = ShoutDropPolicy::OLDEST;
+	else if (strcmp(value, "newest") == 0)
+		drop_policy = ShoutDropPolicy::NEWEST;
+	else {
+		error.Format(config_domain,
+			     "shout drop_policy \"%s\" is not \"block\", "
+			     "\"oldest\" or \"newest\"",
+			     value);
+		return false;
+	}
+
 	value = block.GetBlockValue("genre");
 	if (value != nullptr && shout_set_genre(shout_conn, value)) {
 		error.Set(shout_output_domain, shout_get_error(shout_conn));
@@ -298,6 +489,9 @@ handle_shout_error(ShoutOutput *sd, int err, Error &error)
 {
 	switch (err) {
 	case SHOUTERR_SUCCESS:
+	case SHOUTERR_BUSY:
+		/* in non-blocking mode, libshout keeps the rest in
+		   its own queue */
 		break;
 
 	case SHOUTERR_UNCONNECTED:
@@ -321,8 +515,244 @@ handle_shout_error(ShoutOutput *sd, int err, Error &error)
 	return true;
 }
 
+void
+ShoutOutput::Start()
+{
+	const ScopeLock protect(mutex);
+
+	chunks.clear();
+	buffered = 0;
+	dropped = 0;
+	error.Clear();
+
+	state = State::CONNECTING;
+	connect_deadline = MonotonicClockMS() + timeout * 1000;
+}
+
+void
+ShoutOutput::Fail(Error &&_error)
+{
+	error = std::move(_error);
+	state = State::FAILED;
+
+	chunks.clear();
+	buffered = 0;
+
+	if (shout_get_connected(shout_conn) != SHOUTERR_UNCONNECTED)
+		shout_close(shout_conn);
+
+	cond.broadcast();
+}
+
+void
+ShoutOutput::Connect()
+{
+	assert(state == State::CONNECTING);
+
+	int result = shout_get_connected(shout_conn);
+	if (result == SHOUTERR_UNCONNECTED)
+		result = shout_open(shout_conn);
+
+	switch (result) {
+	case SHOUTERR_SUCCESS:
+	case SHOUTERR_CONNECTED:
+		state = State::CONNECTED;
+		return;
+
+	case SHOUTERR_BUSY:
+		if ((int)(MonotonicClockMS() - connect_deadline) < 0)
+			/* still connecting */
+			return;
+
+		Fail(Error(shout_output_domain, SHOUTERR_SOCKET,
+			   "timeout while connecting to shout server"));
+		return;
+
+	default: {
+		Error error2;
+		error2.Format(shout_output_domain, result,
+			      "problem opening connection to shout server %s:%i: %s",
+			      shout_get_host(shout_conn),
+			      shout_get_port(shout_conn),
+			      shout_get_error(shout_conn));
+		Fail(std::move(error2));
+		return;
+	}
+	}
+}
+
+void
+ShoutOutput::Send()
+{
+	assert(state == State::CONNECTED);
+
+	Error error2;
+
+	while (true) {
+		/* pass new data to libshout only after its own queue
+		   has been flushed; this keeps libshout's queue short,
+		   and our buffer is where the drop policy applies */
+		if (shout_queuelen(shout_conn) > 0) {
+			if (!handle_shout_error(this,
+						shout_send(shout_conn,
+							   nullptr, 0),
+						error2)) {
+				Fail(std::move(error2));
+				return;
+			}
+
+			if (shout_queuelen(shout_conn) > 0)
+				break;
+		}
+
+		if (chunks.empty())
+			break;
+
+		const ShoutChunk &chunk = chunks.front();
+		const int result = shout_send(shout_conn, chunk.data.data(),
+					      chunk.data.size());
+		buffered -= chunk.data.size();
+		chunks.pop_front();
+
+		if (!handle_shout_error(this, result, error2)) {
+			Fail(std::move(error2));
+			return;
+		}
+	}
+
+	/* wake up the output thread if it waits for room */
+	cond.broadcast();
+}
+
+inline void
+ShoutOutput::Poll()
+{
+	if (state == State::CONNECTING)
+		Connect();
+
+	if (state == State::CONNECTED)
+		Send();
+
+	if (state == State::CONNECTING ||
+	    (state == State::CONNECTED &&
+	     (!chunks.empty() || shout_queuelen(shout_conn) > 0)))
+		TimeoutMonitor::Schedule(SHOUT_POLL_MS);
+}
+
+void
+ShoutOutput::RunDeferred()
+{
+	const ScopeLock protect(mutex);
+	Poll();
+}
+
+void
+ShoutOutput::OnTimeout()
+{
+	const ScopeLock protect(mutex);
+	Poll();
+}
+
+void
+ShoutOutput::CloseConnection()
+{
+	const ScopeLock protect(mutex);
+
+	/* a last attempt to send what is left, without waiting */
+	if (state == State::CONNECTED)
+		Send();
+
+	DeferredMonitor::Cancel();
+	TimeoutMonitor::Cancel();
+
+	state = State::CLOSED;
+	chunks.clear();
+	buffered = 0;
+
+	if (shout_get_connected(shout_conn) != SHOUTERR_UNCONNECTED &&
+	    shout_close(shout_conn) != SHOUTERR_SUCCESS) {
+		FormatWarning(shout_output_domain,
+			      "problem closing connection to shout server: %s",
+			      shout_get_error(shout_conn));
+	}
+
+	if (dropped > 0)
+		FormatWarning(shout_output_domain,
+			      "dropped %lu bytes because the shout server "
+			      "was too slow", dropped);
+}
+
+bool
+ShoutOutput::Append(const uint8_t *data, size_t size, bool keep,
+		    Error &error_r)
+{
+	{
+		const ScopeLock protect(mutex);
+
+		while (!keep && buffered + size > buffer_limit &&
+		       state != State::FAILED) {
+			if (drop_policy == ShoutDropPolicy::BLOCK) {
+				DeferredMonitor::Schedule();
+				cond.wait(mutex);
+				continue;
+			}
+
+			if (drop_policy == ShoutDropPolicy::NEWEST) {
+				dropped += size;
+				return true;
+			}
+
+			/* ShoutDropPolicy::OLDEST */
+			auto i = chunks.begin();
+			while (i != chunks.end() && i->keep)
+				++i;
+
+			if (i == chunks.end())
+				/* only stream headers left; exceed
+				   the limit */
+				break;
+
+			dropped += i->data.size();
+			buffered -= i->data.size();
+			chunks.erase(i);
+		}
+
+		if (state == State::FAILED) {
+			error_r.Set(error);
+			return false;
+		}
+
+		chunks.emplace_back(data, size, keep);
+		buffered += size;
+	}
+
+	DeferredMonitor::Schedule();
+	return true;
+}
+
+void
+ShoutOutput::DropBuffered()
+{
+	const ScopeLock protect(mutex);
+
+	for (auto i = chunks.begin(); i != chunks.end();) {
+		if (i->keep) {
+			++i;
+		} else {
+			buffered -= i->data.size();
+			i = chunks.erase(i);
+		}
+	}
+}
+
+/**
+ * Move all data from the encoder to the send buffer.
+ *
+ * @param keep true if the data contains stream headers which must
+ * not be dropped
+ */
 static bool
-write_page(ShoutOutput *sd, Error &error)
+write_page(ShoutOutput *sd, bool keep, Error &error)
 {
 	assert(sd->encoder != nullptr);
 
@@ -332,8 +762,7 @@ write_page(ShoutOutput *sd, Error &error)
 		if (nbytes == 0)
 			return true;
 
-		int err = shout_send(sd->shout_conn, sd->buffer, nbytes);
-		if (!handle_shout_error(sd, err, error))
+		if (!sd->Append(sd->buffer, nbytes, keep, error))
 			return false;
 	}
 
@@ -344,17 +773,16 @@ static void close_shout_conn(ShoutOutput * sd)
 {
 	if (sd->encoder != nullptr) {
 		if (encoder_end(sd->encoder, IgnoreError()))
-			write_page(sd, IgnoreError());
+			write_page(sd, false, IgnoreError());
 
 		sd->encoder->Close();
 	}
 
-	if (shout_get_connected(sd->shout_conn) != SHOUTERR_UNCONNECTED &&
-	    shout_close(sd->shout_conn) != SHOUTERR_SUCCESS) {
-		FormatWarning(shout_output_domain,
-			      "problem closing connection to shout server: %s",
-			      shout_get_error(sd->shout_conn));
-	}
+	BlockingCall(io_thread_get(), [sd](){
+			sd->CloseConnection();
+		});
+
+	delete sd->timer;
 }
 
 static void
@@ -375,10 +803,10 @@ my_shout_finish_driver(AudioOutput *ao)
 static void
 my_shout_drop_buffered_audio(AudioOutput *ao)
 {
-	gcc_unused
 	ShoutOutput *sd = (ShoutOutput *)ao;
 
-	/* needs to be implemented for shout */
+	sd->DropBuffered();
+	sd->timer->Reset();
 }
 
 static void
@@ -389,44 +817,32 @@ my_shout_close_device(AudioOutput *ao)
 	close_shout_conn(sd);
 }
 
-static bool
-shout_connect(ShoutOutput *sd, Error &error)
-{
-	switch (shout_open(sd->shout_conn)) {
-	case SHOUTERR_SUCCESS:
-	case SHOUTERR_CONNECTED:
-		return true;
-
-	default:
-		error.Format(shout_output_domain,
-			     "problem opening connection to shout server %s:%i: %s",
-			     shout_get_host(sd->shout_conn),
-			     shout_get_port(sd->shout_conn),
-			     shout_get_error(sd->shout_conn));
-		return false;
-	}
-}
-
 static bool
 my_shout_open_device(AudioOutput *ao, AudioFormat &audio_format,
 		     Error &error)
 {
 	ShoutOutput *sd = (ShoutOutput *)ao;
 
-	if (!shout_connect(sd, error))
+	if (!sd->encoder->Open(audio_format, error))
 		return false;
 
-	if (!sd->encoder->Open(audio_format, error)) {
-		shout_close(sd->shout_conn);
-		return false;
-	}
+	sd->Start();
 
-	if (!write_page(sd, error)) {
+	/* the stream headers are buffered until the IOThread has
+	   connected to the server */
+	if (!write_page(sd, true, error)) {
 		sd->encoder->Close();
-		shout_close(sd->shout_conn);
+		BlockingCall(io_thread_get(), [sd](){
+				sd->CloseConnection();
+			});
 		return false;
 	}
 
+	sd->timer = new ::Timer(audio_format);
+
+	/* let the IOThread connect */
+	sd->DeferredMonitor::Schedule();
+
 	return true;
 }
 
@@ -435,11 +851,12 @@ my_shout_delay(AudioOutput *ao)
 {
 	ShoutOutput *sd = (ShoutOutput *)ao;
 
-	int delay = shout_delay(sd->shout_conn);
-	if (delay < 0)
-		delay = 0;
-
-	return delay;
+	/* the timer paces the output thread; libshout's own pacing
+	   (shout_delay()) would stop working while the server is
+	   slow */
+	return sd->timer->IsStarted()
+		? sd->timer->GetDelay()
+		: 0;
 }
 
 static size_t
@@ -448,8 +865,16 @@ my_shout_play(AudioOutput *ao, const void *chunk, size_t size,
 {
 	ShoutOutput *sd = (ShoutOutput *)ao;
 
-	return encoder_write(sd->encoder, chunk, size, error) &&
-		write_page(sd, error)
+	if (!encoder_write(sd->encoder, chunk, size, error))
+		return 0;
+
+	sd->base.encoder_load = encoder_get_load(*sd->encoder);
+
+	if (!sd->timer->IsStarted())
+		sd->timer->Start();
+	sd->timer->Add(size);
+
+	return write_page(sd, false, error)
 		? size
 		: 0;
 }
@@ -493,21 +918,28 @@ static void my_shout_set_tag(AudioOutput *ao,
 {
 	ShoutOutput *sd = (ShoutOutput *)ao;
 
+	bool keep = false;
 	if (sd->encoder->plugin.tag != nullptr) {
 		/* encoder plugin supports stream tags */
 
 		Error error;
 		if (!encoder_pre_tag(sd->encoder, error) ||
-		    !write_page(sd, error) ||
+		    !write_page(sd, false, error) ||
 		    !encoder_tag(sd->encoder, tag, error)) {
 			LogError(error);
 			return;
 		}
+
+		/* the encoder begins a new stream with new headers */
+		keep = true;
 	} else {
 		/* no stream tag support: fall back to icy-metadata */
 		char song[1024];
 		shout_tag_to_metadata(tag, song, sizeof(song));
 
+		/* this sends a separate (blocking) HTTP request and
+		   does not touch the stream connection which is
+		   managed by the IOThread */
 		shout_metadata_add(sd->shout_meta, "song", song);
 		if (SHOUTERR_SUCCESS != shout_set_metadata(sd->shout_conn,
 							   sd->shout_meta)) {
@@ -516,7 +948,7 @@ static void my_shout_set_tag(AudioOutput *ao,
 		}
 	}
 
-	write_page(sd, IgnoreError());
+	write_page(sd, keep, IgnoreError());
 }
 
 const struct AudioOutputPlugin shout_output_plugin = {
@@ -535,4 +967,5 @@ const struct AudioOutputPlugin shout_output_plugin = {
 	my_shout_drop_buffered_audio,
 	my_shout_pause,
 	nullptr,
+	nullptr,
 };
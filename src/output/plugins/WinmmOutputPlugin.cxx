@@ -370,5 +370,6 @@ const struct AudioOutputPlugin winmm_output_plugin = {
 	winmm_output_drain,
 	winmm_output_cancel,
 	nullptr,
+	nullptr,
 	&winmm_mixer_plugin,
 };
@@ -20,24 +20,46 @@
 #include "config.h"
 #include "HttpdClient.hxx"
 #include "HttpdInternal.hxx"
+#include "HttpdShard.hxx"
 #include "util/ASCII.hxx"
 #include "Page.hxx"
+#include "PageRing.hxx"
 #include "IcyMetaDataServer.hxx"
 #include "net/SocketError.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
 
+#ifdef WIN32
+/* there is no writev() on Windows; HttpdClient::TryWrite() sends one
+   segment at a time */
+struct iovec {
+	void *iov_base;
+	size_t iov_len;
+};
+#else
+#include <sys/uio.h>
+#endif
+
+/**
+ * Clients which lag behind by more than this number of bytes skip
+ * to the newest page.
+ */
+static constexpr uint64_t MAX_CLIENT_LAG = 256 * 1024;
+
+/**
+ * The maximum number of buffers passed to one writev() call.
+ */
+static constexpr size_t MAX_SEGMENTS = 64;
+
 HttpdClient::~HttpdClient()
 {
-	if (state == RESPONSE) {
-		if (current_page != nullptr)
-			current_page->Unref();
-
-		ClearQueue();
-	}
+	if (state == RESPONSE && current_page != nullptr)
+		current_page->Unref();
 
 	if (metadata)
 		metadata->Unref();
@@ -49,7 +71,7 @@ HttpdClient::~HttpdClient()
 void
 HttpdClient::Close()
 {
-	httpd.RemoveClient(*this);
+	httpd.RemoveClient(shard, *this);
 }
 
 void
@@ -64,9 +86,16 @@ HttpdClient::BeginResponse()
 {
 	assert(state != RESPONSE);
 
-	state = RESPONSE;
 	current_page = nullptr;
 
+	{
+		/* start streaming with the burst (if configured) or
+		   with the next page which gets pushed to the ring */
+		const ScopeLock protect(httpd.mutex);
+		state = RESPONSE;
+		next_page = httpd.GetBurstStart();
+	}
+
 	if (!head_method)
 		httpd.SendHeader(*this);
 }
@@ -193,12 +222,11 @@ HttpdClient::SendResponse()
 	return true;
 }
 
-HttpdClient::HttpdClient(HttpdOutput &_httpd, int _fd, EventLoop &_loop,
+HttpdClient::HttpdClient(HttpdOutput &_httpd, HttpdShard &_shard, int _fd,
 			 bool _metadata_supported)
-	:BufferedSocket(_fd, _loop),
-	 httpd(_httpd),
+	:BufferedSocket(_fd, _shard.GetEventLoop()),
+	 httpd(_httpd), shard(_shard),
 	 state(REQUEST),
-	 queue_size(0),
 	 head_method(false),
 	 dlna_streaming_requested(false),
 	 metadata_supported(_metadata_supported),
@@ -209,196 +237,297 @@ HttpdClient::HttpdClient(HttpdOutput &_httpd, int _fd, EventLoop &_loop,
 {
 }
 
-void
-HttpdClient::ClearQueue()
-{
-	assert(state == RESPONSE);
-
-	while (!pages.empty()) {
-		Page *page = pages.front();
-		pages.pop();
-
-#ifndef NDEBUG
-		assert(queue_size >= page->size);
-		queue_size -= page->size;
-#endif
-
-		page->Unref();
-	}
-
-	assert(queue_size == 0);
-}
-
 void
 HttpdClient::CancelQueue()
 {
 	if (state != RESPONSE)
 		return;
 
-	ClearQueue();
+	next_page = httpd.ring.GetHead();
 
 	if (current_page == nullptr)
 		CancelWrite();
 }
 
-ssize_t
-HttpdClient::TryWritePage(const Page &page, size_t position)
+void
+HttpdClient::ConsumeData(Page &page, uint64_t sequence, size_t position)
 {
-	assert(position < page.size);
+	if (&page != current_page) {
+		/* a page from the ring; another thread may have moved
+		   #next_page ahead meanwhile (CancelQueue()) */
+		assert(current_page == nullptr);
+
+		next_page = std::max(next_page, sequence + 1);
+		if (position == page.size)
+			/* sent completely, no need to reference it */
+			return;
+
+		page.Ref();
+		current_page = &page;
+	}
+
+	if (position < page.size) {
+		current_position = position;
+		return;
+	}
 
-	return Write(page.data + position, page.size - position);
+	current_page->Unref();
+	current_page = nullptr;
 }
 
-ssize_t
-HttpdClient::TryWritePageN(const Page &page, size_t position, ssize_t n)
+void
+HttpdClient::SkipLaggingPages()
 {
-	return n >= 0
-		? Write(page.data + position, n)
-		: TryWritePage(page, position);
+	const PageRing &ring = httpd.ring;
+	if (ring.GetHead() == ring.GetTail()) {
+		/* the ring has been cleared */
+		next_page = ring.GetHead();
+		return;
+	}
+
+	if (next_page < ring.GetTail() ||
+	    ring.GetRemaining(next_page) > MAX_CLIENT_LAG +
+	    httpd.GetBurstBytes()) {
+		FormatDebug(httpd_output_domain,
+			    "client is too slow, flushing its queue");
+		next_page = ring.GetHead() - 1;
+	}
 }
 
-ssize_t
-HttpdClient::GetBytesTillMetaData() const
+bool
+HttpdClient::HandleWriteError()
 {
-	if (metadata_requested &&
-	    current_page->size - current_position > metaint - metadata_fill)
-		return metaint - metadata_fill;
+	auto e = GetSocketError();
+	if (IsSocketErrorAgain(e))
+		return true;
 
-	return -1;
+	if (!IsSocketErrorClosed(e)) {
+		SocketErrorMessage msg(e);
+		FormatWarning(httpd_output_domain,
+			      "failed to write to client: %s",
+			      (const char *)msg);
+	}
+
+	Close();
+	return false;
 }
 
 inline bool
 HttpdClient::TryWrite()
 {
-	const ScopeLock protect(httpd.mutex);
+	enum class Segment : uint8_t {
+		DATA, METADATA, EMPTY_METADATA,
+	};
 
-	assert(state == RESPONSE);
+	/**
+	 * Describes one element of the iovec array.  Each
+	 * #Segment::DATA entry holds a reference to its page, so the
+	 * page survives even if it is dropped from the ring while
+	 * httpd.mutex is not locked.
+	 */
+	struct SegmentInfo {
+		Segment type;
+
+		Page *page;
+
+		/**
+		 * The sequence number of #page in the ring (undefined
+		 * for #current_page).
+		 */
+		uint64_t sequence;
+
+		/**
+		 * The position in #page after this segment.
+		 */
+		size_t end;
+	};
+
+	static char empty_metadata = 0;
 
-	if (current_page == nullptr) {
-		if (pages.empty()) {
-			/* another thread has removed the event source
-			   while this thread was waiting for
+	struct iovec iov[MAX_SEGMENTS];
+	SegmentInfo segments[MAX_SEGMENTS];
+	size_t n = 0;
+
+	/* a reference to the metadata page being sent */
+	Page *sending_metadata = nullptr;
+
+	{
+		/* with several threads, the ring may have been
+		   modified since OnPagesAvailable() */
+		const ScopeLock protect(httpd.mutex);
+
+		assert(state == RESPONSE);
+
+		SkipLaggingPages();
+
+		const PageRing &ring = httpd.ring;
+
+		if (current_page == nullptr && !ring.Contains(next_page)) {
+			/* another thread has removed the event
+			   source while this thread was waiting for
 			   httpd.mutex */
 			CancelWrite();
 			return true;
 		}
 
-		current_page = pages.front();
-		pages.pop();
-		current_position = 0;
+		/* collect as many pages as possible, with the ICY
+		   metadata blocks spliced in, and send them with one
+		   system call after releasing the mutex */
+
+		unsigned fill = metadata_fill;
+		bool sent = metadata_sent;
+
+		auto add_page = [&](Page &page, uint64_t sequence,
+				    size_t position){
+			while (position < page.size && n < MAX_SEGMENTS) {
+				if (metadata_requested && fill == metaint) {
+					if (!sent) {
+						iov[n].iov_base = metadata->data +
+							metadata_current_position;
+						iov[n].iov_len = metadata->size -
+							metadata_current_position;
+						segments[n].type = Segment::METADATA;
+						metadata->Ref();
+						sending_metadata = metadata;
+						sent = true;
+					} else {
+						iov[n].iov_base = &empty_metadata;
+						iov[n].iov_len = 1;
+						segments[n].type = Segment::EMPTY_METADATA;
+					}
+
+					fill = 0;
+					if (++n == MAX_SEGMENTS)
+						break;
+				}
 
-		assert(queue_size >= current_page->size);
-		queue_size -= current_page->size;
-	}
+				size_t length = page.size - position;
+				if (metadata_requested)
+					length = std::min<size_t>(length,
+								  metaint - fill);
 
-	const ssize_t bytes_to_write = GetBytesTillMetaData();
-	if (bytes_to_write == 0) {
-		if (!metadata_sent) {
-			ssize_t nbytes = TryWritePage(*metadata,
-						      metadata_current_position);
-			if (nbytes < 0) {
-				auto e = GetSocketError();
-				if (IsSocketErrorAgain(e))
-					return true;
-
-				if (!IsSocketErrorClosed(e)) {
-					SocketErrorMessage msg(e);
-					FormatWarning(httpd_output_domain,
-						      "failed to write to client: %s",
-						      (const char *)msg);
-				}
+				iov[n].iov_base = page.data + position;
+				iov[n].iov_len = length;
 
-				Close();
-				return false;
+				position += length;
+				fill += length;
+
+				page.Ref();
+				segments[n].type = Segment::DATA;
+				segments[n].page = &page;
+				segments[n].sequence = sequence;
+				segments[n].end = position;
+				++n;
 			}
+		};
+
+		if (current_page != nullptr)
+			add_page(*current_page, 0, current_position);
+
+		for (uint64_t i = next_page;
+		     i < ring.GetHead() && n < MAX_SEGMENTS; ++i)
+			add_page(ring.Get(i), i, 0);
+
+		if (n == 0) {
+			CancelWrite();
+			return true;
+		}
+	}
+
+	/* don't hold httpd.mutex while sending, or a slow client
+	   would block all other shards */
+
+#ifdef WIN32
+	/* no writev() */
+	ssize_t nbytes = Write(iov[0].iov_base, iov[0].iov_len);
+#else
+	ssize_t nbytes = Write(iov, n);
+#endif
+
+	const ScopeLock protect(httpd.mutex);
+
+	bool result;
+	if (nbytes >= 0) {
+		for (size_t i = 0; i < n && nbytes > 0; ++i) {
+			const size_t length = std::min<size_t>(nbytes,
+							       iov[i].iov_len);
+			nbytes -= length;
+
+			switch (segments[i].type) {
+			case Segment::DATA:
+				ConsumeData(*segments[i].page,
+					    segments[i].sequence,
+					    segments[i].end - iov[i].iov_len
+					    + length);
+				if (metadata_requested)
+					metadata_fill += length;
+				break;
+
+			case Segment::METADATA:
+				metadata_current_position += length;
+
+				if (metadata_current_position == sending_metadata->size) {
+					metadata_fill = 0;
+					metadata_current_position = 0;
+
+					/* PushMetaData() may have
+					   replaced it meanwhile, and the
+					   new one is still to be sent */
+					if (metadata == sending_metadata)
+						metadata_sent = true;
+				}
 
-			metadata_current_position += nbytes;
+				break;
 
-			if (metadata->size - metadata_current_position == 0) {
+			case Segment::EMPTY_METADATA:
 				metadata_fill = 0;
 				metadata_current_position = 0;
-				metadata_sent = true;
+				break;
 			}
-		} else {
-			char empty_data = 0;
-
-			ssize_t nbytes = Write(&empty_data, 1);
-			if (nbytes < 0) {
-				auto e = GetSocketError();
-				if (IsSocketErrorAgain(e))
-					return true;
-
-				if (!IsSocketErrorClosed(e)) {
-					SocketErrorMessage msg(e);
-					FormatWarning(httpd_output_domain,
-						      "failed to write to client: %s",
-						      (const char *)msg);
-				}
+		}
 
-				Close();
-				return false;
-			}
+		if (current_page == nullptr &&
+		    next_page == httpd.ring.GetHead())
+			/* all pages are sent: remove the event
+			   source */
+			CancelWrite();
 
-			metadata_fill = 0;
-			metadata_current_position = 0;
-		}
-	} else {
-		ssize_t nbytes =
-			TryWritePageN(*current_page, current_position,
-				      bytes_to_write);
-		if (nbytes < 0) {
-			auto e = GetSocketError();
-			if (IsSocketErrorAgain(e))
-				return true;
-
-			if (!IsSocketErrorClosed(e)) {
-				SocketErrorMessage msg(e);
-				FormatWarning(httpd_output_domain,
-					      "failed to write to client: %s",
-					      (const char *)msg);
-			}
+		result = true;
+	} else
+		/* this may delete this object */
+		result = HandleWriteError();
 
-			Close();
-			return false;
-		}
+	for (size_t i = 0; i < n; ++i)
+		if (segments[i].type == Segment::DATA)
+			segments[i].page->Unref();
 
-		current_position += nbytes;
-		assert(current_position <= current_page->size);
+	if (sending_metadata != nullptr)
+		sending_metadata->Unref();
 
-		if (metadata_requested)
-			metadata_fill += nbytes;
+	return result;
+}
 
-		if (current_position >= current_page->size) {
-			current_page->Unref();
-			current_page = nullptr;
+void
+HttpdClient::PushHeader(Page *page)
+{
+	assert(state == RESPONSE);
+	assert(current_page == nullptr);
 
-			if (pages.empty())
-				/* all pages are sent: remove the
-				   event source */
-				CancelWrite();
-		}
-	}
+	page->Ref();
+	current_page = page;
+	current_position = 0;
 
-	return true;
+	ScheduleWrite();
 }
 
 void
-HttpdClient::PushPage(Page *page)
+HttpdClient::OnPagesAvailable()
 {
 	if (state != RESPONSE)
 		/* the client is still writing the HTTP request */
 		return;
 
-	if (queue_size > 256 * 1024) {
-		FormatDebug(httpd_output_domain,
-			    "client is too slow, flushing its queue");
-		ClearQueue();
-	}
-
-	page->Ref();
-	pages.push(page);
-	queue_size += page->size;
-
+	SkipLaggingPages();
 	ScheduleWrite();
 }
 
@@ -23,12 +23,11 @@
 #include "event/BufferedSocket.hxx"
 #include "Compiler.h"
 
-#include <queue>
-#include <list>
-
 #include <stddef.h>
+#include <stdint.h>
 
 class HttpdOutput;
+class HttpdShard;
 class Page;
 
 class HttpdClient final : BufferedSocket {
@@ -37,6 +36,12 @@ class HttpdClient final : BufferedSocket {
 	 */
 	HttpdOutput &httpd;
 
+	/**
+	 * The #HttpdShard which has accepted this client; its
+	 * #EventLoop is the one this client runs in.
+	 */
+	HttpdShard &shard;
+
 	/**
 	 * The current state of the client.
 	 */
@@ -52,17 +57,10 @@ class HttpdClient final : BufferedSocket {
 	} state;
 
 	/**
-	 * A queue of #Page objects to be sent to the client.
-	 */
-	std::queue<Page *, std::list<Page *>> pages;
-
-	/**
-	 * The sum of all page sizes in #pages.
-	 */
-	size_t queue_size;
-
-	/**
-	 * The #page which is currently being sent to the client.
+	 * The #Page which is currently being sent to the client; this
+	 * object holds a reference to it.  This is either the header
+	 * page or a page from HttpdOutput::ring which was sent
+	 * partially.
 	 */
 	Page *current_page;
 
@@ -72,6 +70,12 @@ class HttpdClient final : BufferedSocket {
 	 */
 	size_t current_position;
 
+	/**
+	 * The sequence number of the next page in HttpdOutput::ring
+	 * to be sent after #current_page.
+	 */
+	uint64_t next_page;
+
 	/**
 	 * Is this a HEAD request?
 	 */
@@ -124,9 +128,10 @@ class HttpdClient final : BufferedSocket {
 public:
 	/**
 	 * @param httpd the HTTP output device
+	 * @param _shard the shard which has accepted the connection
 	 * @param _fd the socket file descriptor
 	 */
-	HttpdClient(HttpdOutput &httpd, int _fd, EventLoop &_loop,
+	HttpdClient(HttpdOutput &httpd, HttpdShard &_shard, int _fd,
 		    bool _metadata_supported);
 
 	/**
@@ -143,7 +148,8 @@ public:
 	void LockClose();
 
 	/**
-	 * Clears the page queue.
+	 * Clears the page queue, i.e. skips all pages in
+	 * HttpdOutput::ring.
 	 */
 	void CancelQueue();
 
@@ -162,18 +168,20 @@ public:
 	 */
 	bool SendResponse();
 
-	gcc_pure
-	ssize_t GetBytesTillMetaData() const;
-
-	ssize_t TryWritePage(const Page &page, size_t position);
-	ssize_t TryWritePageN(const Page &page, size_t position, ssize_t n);
-
 	bool TryWrite();
 
 	/**
-	 * Appends a page to the client's queue.
+	 * Sends the encoder header page before all pages from
+	 * HttpdOutput::ring.  Must be called right after
+	 * BeginResponse().
 	 */
-	void PushPage(Page *page);
+	void PushHeader(Page *page);
+
+	/**
+	 * New pages have been added to HttpdOutput::ring.  Caller
+	 * must lock the mutex.
+	 */
+	void OnPagesAvailable();
 
 	/**
 	 * Sends the passed metadata.
@@ -181,7 +189,30 @@ public:
 	void PushMetaData(Page *page);
 
 private:
-	void ClearQueue();
+	/**
+	 * Mark the data of the specified page up to the specified
+	 * position as sent, advancing #current_page and #next_page.
+	 * Caller must lock the mutex.
+	 *
+	 * @param page either #current_page or a page from the ring
+	 * @param sequence the sequence number of the page in the
+	 * ring (ignored for #current_page)
+	 */
+	void ConsumeData(Page &page, uint64_t sequence, size_t position);
+
+	/**
+	 * If this client lags too far behind (or its next page has
+	 * been dropped from the ring already), skip to the newest
+	 * page.  Caller must lock the mutex.
+	 */
+	void SkipLaggingPages();
+
+	/**
+	 * Handle a failed write.
+	 *
+	 * @return false if the client has been closed
+	 */
+	bool HandleWriteError();
 
 protected:
 	virtual bool OnSocketReady(unsigned flags) override;
@@ -28,8 +28,8 @@
 #include "output/Internal.hxx"
 #include "output/Timer.hxx"
 #include "thread/Mutex.hxx"
-#include "event/ServerSocket.hxx"
 #include "event/DeferredMonitor.hxx"
+#include "event/Thread.hxx"
 #include "util/Cast.hxx"
 #include "Compiler.h"
 
@@ -38,6 +38,9 @@
 #include "HttpdClient.hxx"
 #endif
 
+#include "HttpdShard.hxx"
+#include "PageRing.hxx"
+
 #include <forward_list>
 #include <queue>
 #include <list>
@@ -45,13 +48,13 @@
 struct ConfigBlock;
 class Error;
 class EventLoop;
-class ServerSocket;
+class SocketAddress;
 class HttpdClient;
 class Page;
 struct Encoder;
 struct Tag;
 
-class HttpdOutput final : ServerSocket, DeferredMonitor {
+class HttpdOutput final : DeferredMonitor {
 	AudioOutput base;
 
 	/**
@@ -80,8 +83,8 @@ public:
 	const char *content_type;
 
 	/**
-	 * This mutex protects the listener socket and the client
-	 * list.
+	 * This mutex protects the listener sockets and the client
+	 * lists.
 	 */
 	mutable Mutex mutex;
 
@@ -108,15 +111,67 @@ private:
 	 */
 	Page *metadata;
 
+	struct QueuedPage {
+		Page *page;
+
+		/**
+		 * The value of #pcm_position after this page was
+		 * generated.
+		 */
+		uint64_t time;
+
+		/**
+		 * Is this a new header page?  New clients must not
+		 * receive pages generated before it.
+		 */
+		bool header;
+	};
+
 	/**
 	 * The page queue, i.e. pages from the encoder to be
 	 * broadcasted to all clients.  This container is necessary to
 	 * pass pages from the OutputThread to the IOThread.  It is
 	 * protected by #mutex, and removing signals #cond.
 	 */
-	std::queue<Page *, std::list<Page *>> pages;
+	std::queue<QueuedPage, std::list<QueuedPage>> pages;
+
+	/**
+	 * The configured "burst" duration in seconds.  If non-zero,
+	 * new clients receive this much audio from #ring
+	 * immediately, so they can fill their buffer and begin
+	 * playback quickly.
+	 */
+	unsigned burst_time;
+
+	/**
+	 * #burst_time converted to PCM bytes; 0 if disabled.
+	 * Protected by #mutex.
+	 */
+	uint64_t burst_size;
+
+	/**
+	 * The number of PCM bytes which have been fed into the
+	 * encoder since it was opened.  Only accessed by the
+	 * OutputThread.
+	 */
+	uint64_t pcm_position;
+
+	/**
+	 * The sequence number of the first #ring page generated after
+	 * the current #header.  Bursts must not begin before it,
+	 * because older pages belong to an older stream.  Protected
+	 * by #mutex.
+	 */
+	uint64_t burst_floor;
 
  public:
+	/**
+	 * The pages which have been broadcasted to the clients.
+	 * Each client has a cursor into this ring.  It is
+	 * protected by #mutex, and only the IOThread appends to it.
+	 */
+	PageRing ring;
+
 	/**
 	 * The configured name.
 	 */
@@ -132,10 +187,16 @@ private:
 
 private:
 	/**
-	 * A linked list containing all clients which are currently
-	 * connected.
+	 * The additional threads configured with the "threads"
+	 * setting, each running one #HttpdShard.
+	 */
+	std::forward_list<EventThread> threads;
+
+	/**
+	 * The listeners and their clients.  The first one runs in
+	 * the IOThread, all others in one of #threads.
 	 */
-	std::forward_list<HttpdClient> clients;
+	std::forward_list<HttpdShard> shards;
 
 	/**
 	 * A temporary buffer for the httpd_output_read_page()
@@ -202,7 +263,11 @@ public:
 	 */
 	gcc_pure
 	bool HasClients() const {
-		return !clients.empty();
+		for (const auto &shard : shards)
+			if (shard.HasClients())
+				return true;
+
+		return false;
 	}
 
 	/**
@@ -214,12 +279,20 @@ public:
 		return HasClients();
 	}
 
-	void AddClient(int fd);
+	/**
+	 * Called by #HttpdShard when a client has connected.
+	 */
+	void OnAccept(HttpdShard &shard, int fd, SocketAddress address,
+		      int uid);
+
+	void AddClient(HttpdShard &shard, int fd);
 
 	/**
-	 * Removes a client from the httpd_output.clients linked list.
+	 * Removes a client from the client list of its #HttpdShard.
+	 *
+	 * Caller must lock the mutex.
 	 */
-	void RemoveClient(HttpdClient &client);
+	void RemoveClient(HttpdShard &shard, HttpdClient &client);
 
 	/**
 	 * Sends the encoder header to the client.  This is called
@@ -227,6 +300,28 @@ public:
 	 */
 	void SendHeader(HttpdClient &client) const;
 
+	/**
+	 * Returns the sequence number in #ring where a new client
+	 * shall begin streaming, which is #burst_time before the
+	 * newest page.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	gcc_pure
+	uint64_t GetBurstStart() const;
+
+	/**
+	 * Returns the number of bytes a new client receives as a
+	 * burst.  Clients which lag behind by this amount are not
+	 * considered too slow.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	gcc_pure
+	uint64_t GetBurstBytes() const {
+		return ring.GetRemaining(GetBurstStart());
+	}
+
 	gcc_pure
 	unsigned Delay() const;
 
@@ -240,8 +335,10 @@ public:
 	 * Broadcasts a page struct to all clients.
 	 *
 	 * Mutext must not be locked.
+	 *
+	 * @param header true if this is a new header page
 	 */
-	void BroadcastPage(Page *page);
+	void BroadcastPage(Page *page, bool header=false);
 
 	/**
 	 * Broadcasts data from the encoder to all clients.
@@ -258,8 +355,6 @@ public:
 
 private:
 	virtual void RunDeferred() override;
-
-	void OnAccept(int fd, SocketAddress address, int uid) override;
 };
 
 extern const class Domain httpd_output_domain;
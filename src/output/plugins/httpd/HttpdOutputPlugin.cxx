@@ -24,6 +24,7 @@
 #include "output/OutputAPI.hxx"
 #include "encoder/EncoderInterface.hxx"
 #include "encoder/EncoderPlugin.hxx"
+#include "encoder/EncoderGroup.hxx"
 #include "encoder/EncoderList.hxx"
 #include "net/Resolver.hxx"
 #include "net/SocketAddress.hxx"
@@ -36,6 +37,8 @@
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 
 #include <sys/types.h>
@@ -50,12 +53,18 @@
 
 const Domain httpd_output_domain("httpd_output");
 
+/**
+ * The upper limit for the "threads" setting.
+ */
+static constexpr unsigned MAX_THREADS = 64;
+
 inline
 HttpdOutput::HttpdOutput(EventLoop &_loop)
-	:ServerSocket(_loop), DeferredMonitor(_loop),
+	:DeferredMonitor(_loop),
 	 base(httpd_output_plugin),
 	 encoder(nullptr), unflushed_input(0),
-	 metadata(nullptr)
+	 metadata(nullptr),
+	 burst_size(0), burst_floor(0)
 {
 }
 
@@ -74,11 +83,15 @@ HttpdOutput::Bind(Error &error)
 {
 	open = false;
 
-	bool result = false;
-	BlockingCall(GetEventLoop(), [this, &error, &result](){
-			result = ServerSocket::Open(error);
-		});
-	return result;
+	for (auto &shard : shards) {
+		if (!shard.Bind(error)) {
+			for (auto &i : shards)
+				i.Unbind();
+			return false;
+		}
+	}
+
+	return true;
 }
 
 inline void
@@ -86,9 +99,8 @@ HttpdOutput::Unbind()
 {
 	assert(!open);
 
-	BlockingCall(GetEventLoop(), [this](){
-			ServerSocket::Close();
-		});
+	for (auto &shard : shards)
+		shard.Unbind();
 }
 
 inline bool
@@ -112,19 +124,50 @@ HttpdOutput::Configure(const ConfigBlock &block, Error &error)
 
 	clients_max = block.GetBlockValue("max_clients", 0u);
 
+	burst_time = block.GetBlockValue("burst", 0u);
+
+	/* create one shard per thread; the first one runs in the
+	   IOThread */
+
+	const unsigned n_threads = block.GetBlockValue("threads", 1u);
+	if (n_threads < 1 || n_threads > MAX_THREADS) {
+		error.Format(httpd_output_domain,
+			     "Invalid number of threads: %u", n_threads);
+		return false;
+	}
+
+	shards.emplace_front(*this, GetEventLoop());
+
+	for (unsigned i = 1; i < n_threads; ++i) {
+		threads.emplace_front("httpd");
+		if (!threads.front().Start(error))
+			return false;
+
+		shards.emplace_front(*this, threads.front().GetEventLoop());
+	}
+
 	/* set up bind_to_address */
 
 	const char *bind_to_address = block.GetBlockValue("bind_to_address");
-	bool success = bind_to_address != nullptr &&
-		strcmp(bind_to_address, "any") != 0
-		? AddHost(bind_to_address, port, error)
-		: AddPort(port, error);
-	if (!success)
-		return false;
+	for (auto &shard : shards) {
+		/* with more than one thread, all shards listen on the
+		   same port, and the kernel balances the load */
+		shard.SetReusePort(n_threads > 1);
+
+		/* HTTP clients send their request first */
+		shard.SetDeferAccept(true);
+
+		bool success = bind_to_address != nullptr &&
+			strcmp(bind_to_address, "any") != 0
+			? shard.AddHost(bind_to_address, port, error)
+			: shard.AddPort(port, error);
+		if (!success)
+			return false;
+	}
 
 	/* initialize encoder */
 
-	encoder = encoder_init(*encoder_plugin, block, error);
+	encoder = encoder_group_init(*encoder_plugin, block, error);
 	if (encoder == nullptr)
 		return false;
 
@@ -164,18 +207,18 @@ httpd_output_finish(AudioOutput *ao)
 
 /**
  * Creates a new #HttpdClient object and adds it into the
- * HttpdOutput.clients linked list.
+ * client list of the given #HttpdShard.
  */
 inline void
-HttpdOutput::AddClient(int fd)
+HttpdOutput::AddClient(HttpdShard &shard, int fd)
 {
-	clients.emplace_front(*this, fd, GetEventLoop(),
-			      encoder->plugin.tag == nullptr);
+	HttpdClient &client =
+		shard.AddClient(fd, encoder->plugin.tag == nullptr);
 	++clients_cnt;
 
 	/* pass metadata to client */
 	if (metadata != nullptr)
-		clients.front().PushMetaData(metadata);
+		client.PushMetaData(metadata);
 }
 
 void
@@ -187,22 +230,32 @@ HttpdOutput::RunDeferred()
 	const ScopeLock protect(mutex);
 
 	while (!pages.empty()) {
-		Page *page = pages.front();
-		pages.pop();
+		const QueuedPage &queued = pages.front();
+		Page *page = queued.page;
 
-		for (auto &client : clients)
-			client.PushPage(page);
+		ring.Push(*page, queued.time);
+		if (queued.header)
+			/* new clients receive this page as their
+			   header; the burst must not include it or
+			   older pages */
+			burst_floor = ring.GetHead();
 
+		pages.pop();
 		page->Unref();
 	}
 
+	/* wake up the clients in all threads */
+	for (auto &shard : shards)
+		shard.NotifyPages();
+
 	/* wake up the client that may be waiting for the queue to be
 	   flushed */
 	cond.broadcast();
 }
 
 void
-HttpdOutput::OnAccept(int fd, SocketAddress address, gcc_unused int uid)
+HttpdOutput::OnAccept(HttpdShard &shard, int fd, SocketAddress address,
+		      gcc_unused int uid)
 {
 	/* the listener socket has become readable - a client has
 	   connected */
@@ -236,7 +289,7 @@ HttpdOutput::OnAccept(int fd, SocketAddress address, gcc_unused int uid)
 	if (fd >= 0) {
 		/* can we allow additional client */
 		if (open && (clients_max == 0 ||  clients_cnt < clients_max))
-			AddClient(fd);
+			AddClient(shard, fd);
 		else
 			close_socket(fd);
 	} else if (fd < 0 && errno != EINTR) {
@@ -310,7 +363,7 @@ inline bool
 HttpdOutput::Open(AudioFormat &audio_format, Error &error)
 {
 	assert(!open);
-	assert(clients.empty());
+	assert(!HasClients());
 
 	/* open the encoder */
 
@@ -322,6 +375,10 @@ HttpdOutput::Open(AudioFormat &audio_format, Error &error)
 	clients_cnt = 0;
 	timer = new Timer(audio_format);
 
+	burst_size = (uint64_t)burst_time * audio_format.GetTimeToSize();
+	pcm_position = 0;
+	burst_floor = ring.GetHead();
+
 	open = true;
 
 	return true;
@@ -346,9 +403,10 @@ HttpdOutput::Close()
 
 	delete timer;
 
-	BlockingCall(GetEventLoop(), [this](){
-			clients.clear();
-		});
+	for (auto &shard : shards)
+		shard.CloseClients();
+
+	ring.Clear();
 
 	if (header != nullptr)
 		header->Unref();
@@ -366,26 +424,34 @@ httpd_output_close(AudioOutput *ao)
 }
 
 void
-HttpdOutput::RemoveClient(HttpdClient &client)
+HttpdOutput::RemoveClient(HttpdShard &shard, HttpdClient &client)
 {
 	assert(clients_cnt > 0);
 
-	for (auto prev = clients.before_begin(), i = std::next(prev);;
-	     prev = i, i = std::next(prev)) {
-		assert(i != clients.end());
-		if (&*i == &client) {
-			clients.erase_after(prev);
-			clients_cnt--;
-			break;
-		}
-	}
+	shard.RemoveClient(client);
+	clients_cnt--;
 }
 
 void
 HttpdOutput::SendHeader(HttpdClient &client) const
 {
 	if (header != nullptr)
-		client.PushPage(header);
+		client.PushHeader(header);
+}
+
+uint64_t
+HttpdOutput::GetBurstStart() const
+{
+	const uint64_t head = ring.GetHead();
+	const uint64_t start = std::max(ring.GetTail(), burst_floor);
+	if (burst_size == 0 || start >= head)
+		return head;
+
+	const uint64_t newest = ring.GetTime(head - 1);
+	if (newest <= burst_size)
+		return start;
+
+	return ring.FindTime(start, newest - burst_size);
 }
 
 inline unsigned
@@ -418,12 +484,12 @@ httpd_output_delay(AudioOutput *ao)
 }
 
 void
-HttpdOutput::BroadcastPage(Page *page)
+HttpdOutput::BroadcastPage(Page *page, bool _header)
 {
 	assert(page != nullptr);
 
 	mutex.lock();
-	pages.push(page);
+	pages.push({page, pcm_position, _header});
 	page->Ref();
 	mutex.unlock();
 
@@ -440,7 +506,7 @@ HttpdOutput::BroadcastFromEncoder()
 
 	Page *page;
 	while ((page = ReadPage()) != nullptr)
-		pages.push(page);
+		pages.push({page, pcm_position, false});
 
 	mutex.unlock();
 
@@ -454,6 +520,8 @@ HttpdOutput::EncodeAndPlay(const void *chunk, size_t size, Error &error)
 		return false;
 
 	unflushed_input += size;
+	pcm_position += size;
+	base.encoder_load = encoder_get_load(*encoder);
 
 	BroadcastFromEncoder();
 	return true;
@@ -462,7 +530,9 @@ HttpdOutput::EncodeAndPlay(const void *chunk, size_t size, Error &error)
 inline size_t
 HttpdOutput::Play(const void *chunk, size_t size, Error &error)
 {
-	if (LockHasClients()) {
+	/* with "burst", the encoder runs even without clients, to
+	   have audio for the next client */
+	if (burst_time > 0 || LockHasClients()) {
 		if (!EncodeAndPlay(chunk, size, error))
 			return 0;
 	}
@@ -522,7 +592,7 @@ HttpdOutput::SendTag(const Tag &tag)
 			if (header != nullptr)
 				header->Unref();
 			header = page;
-			BroadcastPage(page);
+			BroadcastPage(page, true);
 		}
 	} else {
 		/* use Icy-Metadata */
@@ -538,8 +608,10 @@ HttpdOutput::SendTag(const Tag &tag)
 		metadata = icy_server_metadata_page(tag, &types[0]);
 		if (metadata != nullptr) {
 			const ScopeLock protect(mutex);
-			for (auto &client : clients)
-				client.PushMetaData(metadata);
+			for (auto &shard : shards)
+				shard.ForEachClient([this](HttpdClient &client){
+						client.PushMetaData(metadata);
+					});
 		}
 	}
 }
@@ -558,13 +630,17 @@ HttpdOutput::CancelAllClients()
 	const ScopeLock protect(mutex);
 
 	while (!pages.empty()) {
-		Page *page = pages.front();
+		Page *page = pages.front().page;
 		pages.pop();
 		page->Unref();
 	}
 
-	for (auto &client : clients)
-		client.CancelQueue();
+	ring.Clear();
+
+	for (auto &shard : shards)
+		shard.ForEachClient([](HttpdClient &client){
+				client.CancelQueue();
+			});
 
 	cond.broadcast();
 }
@@ -595,4 +671,5 @@ const struct AudioOutputPlugin httpd_output_plugin = {
 	httpd_output_cancel,
 	httpd_output_pause,
 	nullptr,
+	nullptr,
 };
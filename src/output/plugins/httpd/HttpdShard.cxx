@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "HttpdShard.hxx"
+#include "HttpdInternal.hxx"
+#include "HttpdClient.hxx"
+#include "event/Call.hxx"
+#include "net/SocketAddress.hxx"
+
+#include <assert.h>
+
+HttpdShard::HttpdShard(HttpdOutput &_httpd, EventLoop &_loop)
+	:ServerSocket(_loop), DeferredMonitor(_loop),
+	 httpd(_httpd)
+{
+}
+
+HttpdShard::~HttpdShard()
+{
+	assert(clients.empty());
+}
+
+bool
+HttpdShard::Bind(Error &error)
+{
+	bool result = false;
+	BlockingCall(GetEventLoop(), [this, &error, &result](){
+			result = ServerSocket::Open(error);
+		});
+	return result;
+}
+
+void
+HttpdShard::Unbind()
+{
+	BlockingCall(GetEventLoop(), [this](){
+			ServerSocket::Close();
+		});
+}
+
+HttpdClient &
+HttpdShard::AddClient(int fd, bool metadata_supported)
+{
+	clients.emplace_front(httpd, *this, fd, metadata_supported);
+	return clients.front();
+}
+
+void
+HttpdShard::RemoveClient(HttpdClient &client)
+{
+	for (auto prev = clients.before_begin(), i = std::next(prev);;
+	     prev = i, i = std::next(prev)) {
+		assert(i != clients.end());
+		if (&*i == &client) {
+			clients.erase_after(prev);
+			break;
+		}
+	}
+}
+
+void
+HttpdShard::CloseClients()
+{
+	BlockingCall(GetEventLoop(), [this](){
+			clients.clear();
+		});
+}
+
+void
+HttpdShard::RunDeferred()
+{
+	/* this method runs in the shard's thread; it wakes up all
+	   clients after HttpdOutput::RunDeferred() has appended pages
+	   to the ring */
+
+	const ScopeLock protect(httpd.mutex);
+
+	for (auto &client : clients)
+		client.OnPagesAvailable();
+}
+
+void
+HttpdShard::OnAccept(int fd, SocketAddress address, int uid)
+{
+	httpd.OnAccept(*this, fd, address, uid);
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_OUTPUT_HTTPD_SHARD_HXX
+#define MPD_OUTPUT_HTTPD_SHARD_HXX
+
+#include "event/ServerSocket.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "Compiler.h"
+
+#ifdef _LIBCPP_VERSION
+/* can't use incomplete template arguments with libc++ */
+#include "HttpdClient.hxx"
+#endif
+
+#include <forward_list>
+
+class Error;
+class EventLoop;
+class HttpdOutput;
+class HttpdClient;
+
+/**
+ * One listener socket and the clients it has accepted, all running
+ * in one #EventLoop.  An #HttpdOutput has one shard per configured
+ * thread; if there are several, they all listen on the same port
+ * with SO_REUSEPORT, and the kernel distributes connections among
+ * them.
+ */
+class HttpdShard final : ServerSocket, DeferredMonitor {
+	HttpdOutput &httpd;
+
+	/**
+	 * A linked list containing all clients of this shard.  It is
+	 * protected by HttpdOutput::mutex.
+	 */
+	std::forward_list<HttpdClient> clients;
+
+public:
+	HttpdShard(HttpdOutput &_httpd, EventLoop &_loop);
+	~HttpdShard();
+
+	HttpdShard(const HttpdShard &) = delete;
+	HttpdShard &operator=(const HttpdShard &) = delete;
+
+	using DeferredMonitor::GetEventLoop;
+	using ServerSocket::SetReusePort;
+	using ServerSocket::SetDeferAccept;
+	using ServerSocket::AddPort;
+	using ServerSocket::AddHost;
+
+	/**
+	 * Open the listener sockets (in the shard's thread).
+	 */
+	bool Bind(Error &error);
+
+	/**
+	 * Close the listener sockets (in the shard's thread).
+	 */
+	void Unbind();
+
+	/**
+	 * Caller must lock the mutex.
+	 */
+	gcc_pure
+	bool HasClients() const {
+		return !clients.empty();
+	}
+
+	/**
+	 * Creates a new #HttpdClient object and adds it into the
+	 * client list.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	HttpdClient &AddClient(int fd, bool metadata_supported);
+
+	/**
+	 * Removes a client from the list and frees it.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void RemoveClient(HttpdClient &client);
+
+	/**
+	 * Disconnect all clients (in the shard's thread).
+	 */
+	void CloseClients();
+
+	/**
+	 * Invoke a function for each client.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	template<typename F>
+	void ForEachClient(F &&f) {
+		for (auto &client : clients)
+			f(client);
+	}
+
+	/**
+	 * Notify all clients (in the shard's thread) that new pages
+	 * were appended to HttpdOutput::ring.  This method is
+	 * thread-safe.
+	 */
+	void NotifyPages() {
+		DeferredMonitor::Schedule();
+	}
+
+private:
+	virtual void RunDeferred() override;
+
+	void OnAccept(int fd, SocketAddress address, int uid) override;
+};
+
+#endif
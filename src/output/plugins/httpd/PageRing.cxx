@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "PageRing.hxx"
+#include "Page.hxx"
+
+#include <assert.h>
+
+inline void
+PageRing::PopTail()
+{
+	assert(tail < head);
+
+	slots[tail % CAPACITY].page->Unref();
+	++tail;
+}
+
+void
+PageRing::Push(Page &page, uint64_t time)
+{
+	if (head - tail == CAPACITY)
+		PopTail();
+
+	page.Ref();
+
+	Slot &slot = slots[head % CAPACITY];
+	slot.page = &page;
+	slot.position = size;
+	slot.time = time;
+
+	size += page.size;
+	++head;
+}
+
+uint64_t
+PageRing::FindTime(uint64_t start, uint64_t time) const
+{
+	assert(start >= tail);
+	assert(start <= head);
+
+	/* binary search; the "time" values are monotonic */
+	uint64_t end = head;
+	while (start < end) {
+		const uint64_t middle = start + (end - start) / 2;
+		if (GetTime(middle) < time)
+			start = middle + 1;
+		else
+			end = middle;
+	}
+
+	return start;
+}
+
+void
+PageRing::Clear()
+{
+	while (tail < head)
+		PopTail();
+}
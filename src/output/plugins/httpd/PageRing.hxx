@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_OUTPUT_HTTPD_PAGE_RING_HXX
+#define MPD_OUTPUT_HTTPD_PAGE_RING_HXX
+
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Page;
+
+/**
+ * A ring buffer of #Page references which is shared by all clients
+ * of one httpd output.  Instead of queueing each page for each
+ * client, every client keeps a cursor (a sequence number) into this
+ * ring.  When the ring is full, the oldest page is dropped.
+ *
+ * This class is not thread-safe; the caller is responsible for
+ * locking.
+ */
+class PageRing {
+	static constexpr size_t CAPACITY = 1024;
+
+	struct Slot {
+		Page *page;
+
+		/**
+		 * The stream position of the page's first byte.
+		 */
+		uint64_t position;
+
+		/**
+		 * The position in the source (e.g. the number of PCM
+		 * bytes fed into the encoder) after this page was
+		 * generated.  It is only used for comparisons and must
+		 * not decrease.
+		 */
+		uint64_t time;
+	};
+
+	Slot slots[CAPACITY];
+
+	/**
+	 * The sequence number of the oldest page in the ring.
+	 */
+	uint64_t tail;
+
+	/**
+	 * The sequence number of the next page to be pushed.
+	 */
+	uint64_t head;
+
+	/**
+	 * The total number of bytes pushed so far.
+	 */
+	uint64_t size;
+
+public:
+	PageRing():tail(0), head(0), size(0) {}
+
+	~PageRing() {
+		Clear();
+	}
+
+	PageRing(const PageRing &) = delete;
+	PageRing &operator=(const PageRing &) = delete;
+
+	uint64_t GetTail() const {
+		return tail;
+	}
+
+	uint64_t GetHead() const {
+		return head;
+	}
+
+	bool Contains(uint64_t sequence) const {
+		return sequence >= tail && sequence < head;
+	}
+
+	/**
+	 * Returns the page with the specified sequence number.
+	 */
+	gcc_pure
+	Page &Get(uint64_t sequence) const {
+		return *slots[sequence % CAPACITY].page;
+	}
+
+	/**
+	 * Returns the number of bytes between the beginning of the
+	 * specified page and the end of the ring.
+	 *
+	 * @param sequence a sequence number between tail and head
+	 * (including)
+	 */
+	gcc_pure
+	uint64_t GetRemaining(uint64_t sequence) const {
+		return sequence == head
+			? 0
+			: size - slots[sequence % CAPACITY].position;
+	}
+
+	/**
+	 * Returns the "time" value of the specified page (see
+	 * Push()).
+	 */
+	gcc_pure
+	uint64_t GetTime(uint64_t sequence) const {
+		return slots[sequence % CAPACITY].time;
+	}
+
+	/**
+	 * Find the oldest page at or after #start whose "time" value
+	 * is at least the specified one.
+	 *
+	 * @param start a sequence number between tail and head
+	 * (including)
+	 * @return a sequence number; #head if there is no such page
+	 */
+	gcc_pure
+	uint64_t FindTime(uint64_t start, uint64_t time) const;
+
+	/**
+	 * Appends a page, adding a reference to it.
+	 *
+	 * @param time the source position after this page, see
+	 * FindTime()
+	 */
+	void Push(Page &page, uint64_t time=0);
+
+	/**
+	 * Drop all pages.  Sequence numbers are not reset, so clients
+	 * can detect that their pages are gone.
+	 */
+	void Clear();
+
+private:
+	void PopTail();
+};
+
+#endif
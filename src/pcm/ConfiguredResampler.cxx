@@ -20,6 +20,7 @@
 #include "config.h"
 #include "ConfiguredResampler.hxx"
 #include "FallbackResampler.hxx"
+#include "PolyphaseResampler.hxx"
 #include "config/ConfigGlobal.hxx"
 #include "config/ConfigOption.hxx"
 #include "config/ConfigError.hxx"
@@ -39,6 +40,7 @@
 
 enum class SelectedResampler {
 	FALLBACK,
+	POLYPHASE,
 
 #ifdef ENABLE_LIBSAMPLERATE
 	LIBSAMPLERATE,
@@ -49,7 +51,39 @@ enum class SelectedResampler {
 #endif
 };
 
-static SelectedResampler selected_resampler = SelectedResampler::FALLBACK;
+static SelectedResampler selected_resampler = SelectedResampler::POLYPHASE;
+
+/**
+ * The number of filter taps of the "internal" resampler, see
+ * #PolyphasePcmResampler.
+ */
+static unsigned polyphase_taps = 32;
+
+/**
+ * Parse the "quality" setting of the "internal" resampler.
+ */
+static bool
+pcm_resample_internal_global_init(const ConfigBlock &block, Error &error)
+{
+	const char *quality = block.GetBlockValue("quality", "high");
+	if (strcmp(quality, "high") == 0) {
+		selected_resampler = SelectedResampler::POLYPHASE;
+		polyphase_taps = 32;
+	} else if (strcmp(quality, "medium") == 0) {
+		selected_resampler = SelectedResampler::POLYPHASE;
+		polyphase_taps = 16;
+	} else if (strcmp(quality, "fast") == 0) {
+		/* the old nearest-neighbour resampler */
+		selected_resampler = SelectedResampler::FALLBACK;
+	} else {
+		error.Format(config_domain,
+			     "unknown quality setting '%s' in line %d",
+			     quality, block.line);
+		return false;
+	}
+
+	return true;
+}
 
 static const ConfigBlock *
 MakeResamplerDefaultConfig(ConfigBlock &block)
@@ -146,8 +180,7 @@ pcm_resampler_global_init(Error &error)
 	}
 
 	if (strcmp(plugin_name, "internal") == 0) {
-		selected_resampler = SelectedResampler::FALLBACK;
-		return true;
+		return pcm_resample_internal_global_init(*block, error);
 #ifdef ENABLE_SOXR
 	} else if (strcmp(plugin_name, "soxr") == 0) {
 		selected_resampler = SelectedResampler::SOXR;
@@ -173,6 +206,9 @@ pcm_resampler_create()
 	case SelectedResampler::FALLBACK:
 		return new FallbackPcmResampler();
 
+	case SelectedResampler::POLYPHASE:
+		return new PolyphasePcmResampler(polyphase_taps);
+
 #ifdef ENABLE_LIBSAMPLERATE
 	case SelectedResampler::LIBSAMPLERATE:
 		return new LibsampleratePcmResampler();
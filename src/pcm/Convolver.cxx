@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Convolver.hxx"
+#include "Simd.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+PartitionedConvolver::PartitionedConvolver(const float *ir, size_t ir_length,
+					   unsigned _block_size)
+	:block_size(_block_size), bins(_block_size + 1),
+	 n_partitions(std::max<size_t>((ir_length + _block_size - 1) / _block_size,
+				       1)),
+	 fft(2 * _block_size),
+	 ir_re(n_partitions * bins), ir_im(n_partitions * bins),
+	 fdl_re(n_partitions * bins), fdl_im(n_partitions * bins),
+	 fdl_position(0),
+	 input(2 * _block_size),
+	 acc_re(bins), acc_im(bins),
+	 output(2 * _block_size)
+{
+	assert(block_size >= 2);
+
+	/* the inverse FFT is scaled by its size; compensate that
+	   here once */
+	const float scale = 1.0f / fft.GetSize();
+
+	std::vector<float> segment(fft.GetSize());
+	for (unsigned p = 0; p < n_partitions; ++p) {
+		const size_t offset = size_t(p) * block_size;
+		const size_t n = offset < ir_length
+			? std::min<size_t>(ir_length - offset, block_size)
+			: 0;
+
+		std::fill(segment.begin(), segment.end(), 0.0f);
+		for (size_t i = 0; i < n; ++i)
+			segment[i] = ir[offset + i] * scale;
+
+		fft.Forward(segment.data(),
+			    &ir_re[p * bins], &ir_im[p * bins]);
+	}
+}
+
+void
+PartitionedConvolver::Reset()
+{
+	std::fill(fdl_re.begin(), fdl_re.end(), 0.0f);
+	std::fill(fdl_im.begin(), fdl_im.end(), 0.0f);
+	std::fill(input.begin(), input.end(), 0.0f);
+	fdl_position = 0;
+}
+
+void
+PartitionedConvolver::Process(const float *src, float *dest)
+{
+	/* slide the input window by one block */
+	std::copy(input.begin() + block_size, input.end(), input.begin());
+	std::copy(src, src + block_size, input.begin() + block_size);
+
+	fdl_position = (fdl_position + n_partitions - 1) % n_partitions;
+	fft.Forward(input.data(),
+		    &fdl_re[fdl_position * bins],
+		    &fdl_im[fdl_position * bins]);
+
+	std::fill(acc_re.begin(), acc_re.end(), 0.0f);
+	std::fill(acc_im.begin(), acc_im.end(), 0.0f);
+
+	/* partition p is multiplied with the input block from p
+	   blocks ago */
+	const auto complex_mac = GetPcmSimd().complex_mac_float;
+	unsigned slot = fdl_position;
+	for (unsigned p = 0; p < n_partitions; ++p) {
+		complex_mac(acc_re.data(), acc_im.data(),
+			    &fdl_re[slot * bins], &fdl_im[slot * bins],
+			    &ir_re[p * bins], &ir_im[p * bins],
+			    bins);
+
+		if (++slot == n_partitions)
+			slot = 0;
+	}
+
+	fft.Inverse(acc_re.data(), acc_im.data(), output.data());
+
+	/* overlap-save: the first half is aliased by the circular
+	   convolution, the second half is valid */
+	std::copy(output.begin() + block_size, output.end(), dest);
+}
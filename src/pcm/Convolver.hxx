@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_CONVOLVER_HXX
+#define MPD_PCM_CONVOLVER_HXX
+
+#include "Fft.hxx"
+
+#include <vector>
+
+#include <stddef.h>
+
+/**
+ * Convolve one channel with an impulse response, using uniformly
+ * partitioned FFT convolution (overlap-save): the impulse response is
+ * split into partitions of the block size, and each block of input
+ * is transformed once and multiplied with the spectra of all
+ * partitions in a frequency-domain delay line.  The cost per sample
+ * grows only with the number of partitions, and the latency is one
+ * block.
+ *
+ * The complex multiply-accumulate uses
+ * PcmSimd::complex_mac_float().
+ */
+class PartitionedConvolver {
+	const unsigned block_size;
+
+	/**
+	 * The number of frequency bins per spectrum.
+	 */
+	const unsigned bins;
+
+	unsigned n_partitions;
+
+	RealFft fft;
+
+	/**
+	 * The spectra of all impulse response partitions, scaled so
+	 * the inverse FFT needs no normalization.
+	 */
+	std::vector<float> ir_re, ir_im;
+
+	/**
+	 * The spectra of the last #n_partitions input blocks, a ring
+	 * buffer whose newest entry is at #fdl_position.
+	 */
+	std::vector<float> fdl_re, fdl_im;
+	unsigned fdl_position;
+
+	/**
+	 * The previous and the current input block.
+	 */
+	std::vector<float> input;
+
+	std::vector<float> acc_re, acc_im;
+
+	std::vector<float> output;
+
+public:
+	/**
+	 * @param ir the impulse response
+	 * @param ir_length the number of samples in #ir
+	 * @param _block_size the number of samples per Process()
+	 * call; must be a power of two and at least 2
+	 */
+	PartitionedConvolver(const float *ir, size_t ir_length,
+			     unsigned _block_size);
+
+	PartitionedConvolver(const PartitionedConvolver &) = delete;
+	PartitionedConvolver &operator=(const PartitionedConvolver &) = delete;
+
+	unsigned GetBlockSize() const {
+		return block_size;
+	}
+
+	/**
+	 * Forget all previous input.
+	 */
+	void Reset();
+
+	/**
+	 * Convolve one block of GetBlockSize() samples with the
+	 * impulse response, continuing the signal passed to previous
+	 * calls.  #dest may be equal to #src.
+	 */
+	void Process(const float *src, float *dest);
+};
+
+#endif
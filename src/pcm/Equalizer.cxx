@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Equalizer.hxx"
+#include "Simd.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <algorithm>
+#include <cmath>
+
+#include <assert.h>
+#include <string.h>
+
+static constexpr struct {
+	EqualizerBandType type;
+	const char *name;
+} equalizer_band_types[] = {
+	{ EqualizerBandType::PEAK, "peak" },
+	{ EqualizerBandType::LOW_SHELF, "lowshelf" },
+	{ EqualizerBandType::HIGH_SHELF, "highshelf" },
+	{ EqualizerBandType::LOW_PASS, "lowpass" },
+	{ EqualizerBandType::HIGH_PASS, "highpass" },
+};
+
+bool
+ParseEqualizerBandType(const char *s, EqualizerBandType &type_r)
+{
+	for (const auto &i : equalizer_band_types) {
+		if (strcmp(s, i.name) == 0) {
+			type_r = i.type;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const char *
+GetEqualizerBandTypeName(EqualizerBandType type)
+{
+	for (const auto &i : equalizer_band_types)
+		if (i.type == type)
+			return i.name;
+
+	assert(false);
+	gcc_unreachable();
+}
+
+/**
+ * Calculate the biquad coefficients (b0, b1, b2, a1, a2; normalized
+ * to a0 = 1) of one band.
+ *
+ * @return false if the band is a no-op
+ */
+static bool
+CalculateBiquad(const EqualizerBand &band, unsigned sample_rate,
+		double c[5])
+{
+	if (!(band.frequency > 0) || band.frequency * 2 >= sample_rate ||
+	    !(band.q > 0))
+		return false;
+
+	const double gain = std::min(std::max(double(band.gain),
+					      -double(EQUALIZER_MAX_GAIN)),
+				     double(EQUALIZER_MAX_GAIN));
+	const bool has_gain = band.type != EqualizerBandType::LOW_PASS &&
+		band.type != EqualizerBandType::HIGH_PASS;
+	if (has_gain && std::fabs(gain) < 0.01)
+		return false;
+
+	const double A = std::pow(10., gain / 40);
+	const double w0 = 2 * M_PI * band.frequency / sample_rate;
+	const double cos_w0 = std::cos(w0);
+	const double alpha = std::sin(w0) / (2 * band.q);
+	const double sqrt_a_alpha = 2 * std::sqrt(A) * alpha;
+
+	double b0, b1, b2, a0, a1, a2;
+
+	switch (band.type) {
+	case EqualizerBandType::PEAK:
+		b0 = 1 + alpha * A;
+		b1 = -2 * cos_w0;
+		b2 = 1 - alpha * A;
+		a0 = 1 + alpha / A;
+		a1 = -2 * cos_w0;
+		a2 = 1 - alpha / A;
+		break;
+
+	case EqualizerBandType::LOW_SHELF:
+		b0 = A * ((A + 1) - (A - 1) * cos_w0 + sqrt_a_alpha);
+		b1 = 2 * A * ((A - 1) - (A + 1) * cos_w0);
+		b2 = A * ((A + 1) - (A - 1) * cos_w0 - sqrt_a_alpha);
+		a0 = (A + 1) + (A - 1) * cos_w0 + sqrt_a_alpha;
+		a1 = -2 * ((A - 1) + (A + 1) * cos_w0);
+		a2 = (A + 1) + (A - 1) * cos_w0 - sqrt_a_alpha;
+		break;
+
+	case EqualizerBandType::HIGH_SHELF:
+		b0 = A * ((A + 1) + (A - 1) * cos_w0 + sqrt_a_alpha);
+		b1 = -2 * A * ((A - 1) + (A + 1) * cos_w0);
+		b2 = A * ((A + 1) + (A - 1) * cos_w0 - sqrt_a_alpha);
+		a0 = (A + 1) - (A - 1) * cos_w0 + sqrt_a_alpha;
+		a1 = 2 * ((A - 1) - (A + 1) * cos_w0);
+		a2 = (A + 1) - (A - 1) * cos_w0 - sqrt_a_alpha;
+		break;
+
+	case EqualizerBandType::LOW_PASS:
+		b0 = (1 - cos_w0) / 2;
+		b1 = 1 - cos_w0;
+		b2 = (1 - cos_w0) / 2;
+		a0 = 1 + alpha;
+		a1 = -2 * cos_w0;
+		a2 = 1 - alpha;
+		break;
+
+	case EqualizerBandType::HIGH_PASS:
+		b0 = (1 + cos_w0) / 2;
+		b1 = -(1 + cos_w0);
+		b2 = (1 + cos_w0) / 2;
+		a0 = 1 + alpha;
+		a1 = -2 * cos_w0;
+		a2 = 1 - alpha;
+		break;
+
+	default:
+		return false;
+	}
+
+	c[0] = b0 / a0;
+	c[1] = b1 / a0;
+	c[2] = b2 / a0;
+	c[3] = a1 / a0;
+	c[4] = a2 / a0;
+	return true;
+}
+
+static int32_t
+ToFixedPoint(double x)
+{
+	x = std::round(x * (1 << PCM_BIQUAD_BITS));
+	return int32_t(std::min(std::max(x, double(INT32_MIN)),
+				double(INT32_MAX)));
+}
+
+void
+PcmEqualizer::Open(SampleFormat _format, unsigned _channels,
+		   unsigned _sample_rate)
+{
+	assert(IsSupported(_format));
+	assert(_channels > 0);
+	assert(_sample_rate > 0);
+
+	format = _format;
+	channels = _channels;
+	sample_rate = _sample_rate;
+
+	n_bands = 0;
+	active.clear();
+	coefficients_float.clear();
+	coefficients_32.clear();
+	state_float.clear();
+	state_32.clear();
+}
+
+void
+PcmEqualizer::SetBands(ConstBuffer<EqualizerBand> bands)
+{
+	assert(format != SampleFormat::UNDEFINED);
+
+	if (bands.size != n_bands) {
+		/* a different set of bands: start from scratch */
+		n_bands = bands.size;
+		active.assign(n_bands, false);
+		coefficients_float.assign(n_bands * 5, 0.0f);
+		coefficients_32.assign(n_bands * 5, 0);
+		state_float.assign(n_bands * 2 * channels, 0.0f);
+		state_32.assign(n_bands * 4 * channels, 0);
+	}
+
+	for (unsigned i = 0; i < n_bands; ++i) {
+		double c[5];
+		const bool was_active = active[i];
+		active[i] = CalculateBiquad(bands.data[i], sample_rate, c);
+		if (!active[i])
+			continue;
+
+		for (unsigned j = 0; j < 5; ++j) {
+			coefficients_float[i * 5 + j] = c[j];
+			coefficients_32[i * 5 + j] = ToFixedPoint(c[j]);
+		}
+
+		if (!was_active) {
+			/* the state of a disabled band is stale */
+			std::fill_n(&state_float[i * 2 * channels],
+				    2 * channels, 0.0f);
+			std::fill_n(&state_32[i * 4 * channels],
+				    4 * channels, 0);
+		}
+	}
+}
+
+void
+PcmEqualizer::Reset()
+{
+	std::fill(state_float.begin(), state_float.end(), 0.0f);
+	std::fill(state_32.begin(), state_32.end(), 0);
+}
+
+void
+PcmEqualizer::Apply(void *data, size_t size)
+{
+	assert(format != SampleFormat::UNDEFINED);
+
+	const auto &simd = GetPcmSimd();
+
+	if (format == SampleFormat::FLOAT) {
+		const size_t n = size / (channels * sizeof(float));
+
+		for (unsigned i = 0; i < n_bands; ++i)
+			if (active[i])
+				simd.biquad_float((float *)data, n, channels,
+						  &coefficients_float[i * 5],
+						  &state_float[i * 2 * channels]);
+
+		/* flush tiny values to zero, or the recursion would
+		   decay into slow denormals during silence */
+		for (auto &z : state_float)
+			if (std::fabs(z) < 1e-20f)
+				z = 0;
+	} else {
+		assert(format == SampleFormat::S32);
+
+		const size_t n = size / (channels * sizeof(int32_t));
+
+		for (unsigned i = 0; i < n_bands; ++i)
+			if (active[i])
+				simd.biquad_32((int32_t *)data, n, channels,
+					       &coefficients_32[i * 5],
+					       &state_32[i * 4 * channels]);
+	}
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_EQUALIZER_HXX
+#define MPD_PCM_EQUALIZER_HXX
+
+#include "AudioFormat.hxx"
+#include "Compiler.h"
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+template<typename T> struct ConstBuffer;
+
+/**
+ * The shape of an equalizer band, see the "Audio EQ Cookbook" by
+ * Robert Bristow-Johnson.
+ */
+enum class EqualizerBandType : uint8_t {
+	PEAK,
+	LOW_SHELF,
+	HIGH_SHELF,
+	LOW_PASS,
+	HIGH_PASS,
+};
+
+/**
+ * The largest boost or cut of one band [dB].  This limit keeps the
+ * fixed-point coefficients (see #PCM_BIQUAD_BITS) and their sums in
+ * range.
+ */
+static constexpr float EQUALIZER_MAX_GAIN = 15;
+
+struct EqualizerBand {
+	EqualizerBandType type;
+
+	/**
+	 * The center frequency (#PEAK) or the corner frequency [Hz].
+	 */
+	float frequency;
+
+	/**
+	 * The gain [dB]; ignored by #LOW_PASS and #HIGH_PASS.
+	 */
+	float gain;
+
+	float q;
+};
+
+/**
+ * Parse the name of an #EqualizerBandType ("peak", "lowshelf",
+ * "highshelf", "lowpass", "highpass").
+ *
+ * @return false if the name is not recognized
+ */
+bool
+ParseEqualizerBandType(const char *s, EqualizerBandType &type_r);
+
+gcc_const
+const char *
+GetEqualizerBandTypeName(EqualizerBandType type);
+
+/**
+ * A parametric equalizer: a cascade of biquad filters, one per
+ * band.  All channels are filtered at once in the lanes of the
+ * #PcmSimd kernels; float samples are filtered in floating point,
+ * 32 bit integer samples in fixed point.
+ */
+class PcmEqualizer {
+	SampleFormat format;
+
+	unsigned channels, sample_rate;
+
+	/**
+	 * The number of bands passed to SetBands().
+	 */
+	unsigned n_bands;
+
+	/**
+	 * Which bands are not a no-op?  Bands which are not active
+	 * are skipped.
+	 */
+	std::vector<bool> active;
+
+	/**
+	 * Five coefficients per band; only the ones for #format are
+	 * used.
+	 */
+	std::vector<float> coefficients_float;
+	std::vector<int32_t> coefficients_32;
+
+	/**
+	 * The filter state of each band, see PcmSimd::biquad_float()
+	 * and PcmSimd::biquad_32().
+	 */
+	std::vector<float> state_float;
+	std::vector<int32_t> state_32;
+
+public:
+	PcmEqualizer() {
+#ifndef NDEBUG
+		format = SampleFormat::UNDEFINED;
+#endif
+	}
+
+	/**
+	 * Can this class process the specified sample format?  All
+	 * other formats must be converted to one of them first.
+	 */
+	gcc_const
+	static bool IsSupported(SampleFormat format) {
+		return format == SampleFormat::FLOAT ||
+			format == SampleFormat::S32;
+	}
+
+	/**
+	 * Prepare for Apply().  There are no bands until SetBands()
+	 * is called.
+	 *
+	 * @param format a format accepted by IsSupported()
+	 */
+	void Open(SampleFormat format, unsigned channels,
+		  unsigned sample_rate);
+
+	/**
+	 * Calculate the coefficients for a new set of bands.  This
+	 * may be called at any time after Open(); the state of bands
+	 * which stay active is kept, so the signal is not
+	 * interrupted.
+	 *
+	 * Bands which are a no-op (e.g. a gain of 0 dB) or whose
+	 * frequency is not below the Nyquist frequency are disabled.
+	 */
+	void SetBands(ConstBuffer<EqualizerBand> bands);
+
+	/**
+	 * Forget the filter state, e.g. after seeking.
+	 */
+	void Reset();
+
+	/**
+	 * Filter a buffer of interleaved frames in-place.
+	 */
+	void Apply(void *data, size_t size);
+};
+
+#endif
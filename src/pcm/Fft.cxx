@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Fft.hxx"
+
+#include <cmath>
+
+#include <assert.h>
+
+RealFft::RealFft(unsigned _size)
+	:size(_size), half(_size / 2),
+	 twiddle_re(half / 2), twiddle_im(half / 2),
+	 split_re(half + 1), split_im(half + 1),
+	 bit_reverse(half),
+	 z_re(half), z_im(half)
+{
+	assert(size >= 4);
+	assert((size & (size - 1)) == 0);
+
+	for (unsigned k = 0; k < half / 2; ++k) {
+		const double phi = -2 * M_PI * k / half;
+		twiddle_re[k] = cos(phi);
+		twiddle_im[k] = sin(phi);
+	}
+
+	for (unsigned k = 0; k <= half; ++k) {
+		const double phi = -2 * M_PI * k / size;
+		split_re[k] = cos(phi);
+		split_im[k] = sin(phi);
+	}
+
+	unsigned bits = 0;
+	while ((1u << bits) < half)
+		++bits;
+
+	for (unsigned i = 0; i < half; ++i) {
+		unsigned r = 0;
+		for (unsigned b = 0; b < bits; ++b)
+			if (i & (1u << b))
+				r |= 1u << (bits - 1 - b);
+		bit_reverse[i] = r;
+	}
+}
+
+void
+RealFft::Transform()
+{
+	for (unsigned i = 0; i < half; ++i) {
+		const unsigned j = bit_reverse[i];
+		if (i < j) {
+			std::swap(z_re[i], z_re[j]);
+			std::swap(z_im[i], z_im[j]);
+		}
+	}
+
+	float *const re = z_re.data(), *const im = z_im.data();
+
+	for (unsigned length = 2; length <= half; length *= 2) {
+		const unsigned h = length / 2;
+		const unsigned stride = half / length;
+
+		for (unsigned start = 0; start < half; start += length) {
+			for (unsigned k = 0; k < h; ++k) {
+				const float w_re = twiddle_re[k * stride];
+				const float w_im = twiddle_im[k * stride];
+
+				const unsigned a = start + k, b = a + h;
+				const float t_re = re[b] * w_re - im[b] * w_im;
+				const float t_im = re[b] * w_im + im[b] * w_re;
+
+				re[b] = re[a] - t_re;
+				im[b] = im[a] - t_im;
+				re[a] += t_re;
+				im[a] += t_im;
+			}
+		}
+	}
+}
+
+void
+RealFft::Forward(const float *src, float *re, float *im)
+{
+	/* the even samples are the real parts, the odd samples are
+	   the imaginary parts */
+	for (unsigned i = 0; i < half; ++i) {
+		z_re[i] = src[2 * i];
+		z_im[i] = src[2 * i + 1];
+	}
+
+	Transform();
+
+	for (unsigned k = 0; k <= half; ++k) {
+		const unsigned a = k == half ? 0 : k;
+		const unsigned b = k == 0 ? 0 : half - k;
+
+		/* the spectra of the even samples (e) and of the odd
+		   samples (o) */
+		const float e_re = (z_re[a] + z_re[b]) * 0.5f;
+		const float e_im = (z_im[a] - z_im[b]) * 0.5f;
+		const float o_re = (z_im[a] + z_im[b]) * 0.5f;
+		const float o_im = (z_re[b] - z_re[a]) * 0.5f;
+
+		re[k] = e_re + o_re * split_re[k] - o_im * split_im[k];
+		im[k] = e_im + o_re * split_im[k] + o_im * split_re[k];
+	}
+}
+
+void
+RealFft::Inverse(const float *re, const float *im, float *dest)
+{
+	for (unsigned k = 0; k < half; ++k) {
+		const unsigned b = half - k;
+
+		const float e_re = re[k] + re[b];
+		const float e_im = im[k] - im[b];
+
+		/* (X[k] - conj(X[half - k])) * exp(2 pi i k / size) */
+		const float d_re = re[k] - re[b];
+		const float d_im = im[k] + im[b];
+		const float o_re = d_re * split_re[k] + d_im * split_im[k];
+		const float o_im = d_im * split_re[k] - d_re * split_im[k];
+
+		/* the inverse transform is done with the forward
+		   transform of the complex conjugate */
+		z_re[k] = e_re - o_im;
+		z_im[k] = -(e_im + o_re);
+	}
+
+	Transform();
+
+	for (unsigned i = 0; i < half; ++i) {
+		dest[2 * i] = z_re[i];
+		dest[2 * i + 1] = -z_im[i];
+	}
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_FFT_HXX
+#define MPD_PCM_FFT_HXX
+
+#include "Compiler.h"
+
+#include <vector>
+
+/**
+ * A fast Fourier transform of real signals whose size is a power of
+ * two.  It is implemented with a complex radix-2 FFT of half the
+ * size.  Spectra are stored with separate arrays for the real and
+ * the imaginary parts; only the GetBins() non-redundant bins are
+ * stored.
+ *
+ * An object has scratch buffers, therefore it must not be used by
+ * more than one thread at a time.
+ */
+class RealFft {
+	/**
+	 * The size of the real signal.
+	 */
+	unsigned size;
+
+	/**
+	 * The size of the complex FFT (half of #size).
+	 */
+	unsigned half;
+
+	/**
+	 * exp(-2 pi i k / half) for k < half / 2.
+	 */
+	std::vector<float> twiddle_re, twiddle_im;
+
+	/**
+	 * exp(-2 pi i k / size) for k <= half, for separating the
+	 * spectra of the even and the odd samples.
+	 */
+	std::vector<float> split_re, split_im;
+
+	std::vector<unsigned> bit_reverse;
+
+	std::vector<float> z_re, z_im;
+
+public:
+	/**
+	 * @param _size the signal size; must be a power of two and
+	 * at least 4
+	 */
+	explicit RealFft(unsigned _size);
+
+	RealFft(const RealFft &) = delete;
+	RealFft &operator=(const RealFft &) = delete;
+
+	unsigned GetSize() const {
+		return size;
+	}
+
+	/**
+	 * Returns the number of frequency bins: size / 2 + 1.
+	 */
+	unsigned GetBins() const {
+		return half + 1;
+	}
+
+	/**
+	 * Transform GetSize() samples into GetBins() bins.
+	 */
+	void Forward(const float *src, float *re, float *im);
+
+	/**
+	 * The inverse transform of GetBins() bins into GetSize()
+	 * samples.  It is not normalized: the result is scaled by
+	 * GetSize().  The imaginary parts of the first and the last
+	 * bin are ignored.
+	 */
+	void Inverse(const float *re, const float *im, float *dest);
+
+private:
+	/**
+	 * The complex FFT of #z_re/#z_im, in-place.
+	 */
+	void Transform();
+};
+
+#endif
@@ -55,6 +55,7 @@ PcmFormatConverter::Open(SampleFormat _src_format, SampleFormat _dest_format,
 
 	src_format = _src_format;
 	dest_format = _dest_format;
+	simd = &GetPcmSimd();
 	return true;
 }
 
@@ -80,22 +81,22 @@ PcmFormatConverter::Convert(ConstBuffer<void> src, gcc_unused Error &error)
 	case SampleFormat::S16:
 		return pcm_convert_to_16(buffer, dither,
 					 src_format,
-					 src).ToVoid();
+					 src, *simd).ToVoid();
 
 	case SampleFormat::S24_P32:
 		return pcm_convert_to_24(buffer,
 					 src_format,
-					 src).ToVoid();
+					 src, *simd).ToVoid();
 
 	case SampleFormat::S32:
 		return pcm_convert_to_32(buffer,
 					 src_format,
-					 src).ToVoid();
+					 src, *simd).ToVoid();
 
 	case SampleFormat::FLOAT:
 		return pcm_convert_to_float(buffer,
 					    src_format,
-					    src).ToVoid();
+					    src, *simd).ToVoid();
 	}
 
 	assert(false);
@@ -24,6 +24,7 @@
 #include "AudioFormat.hxx"
 #include "PcmBuffer.hxx"
 #include "PcmDither.hxx"
+#include "Simd.hxx"
 
 #ifndef NDEBUG
 #include <assert.h>
@@ -41,6 +42,11 @@ class PcmFormatConverter {
 	PcmBuffer buffer;
 	PcmDither dither;
 
+	/**
+	 * The conversion kernels, chosen by Open().
+	 */
+	const PcmSimd *simd;
+
 public:
 #ifndef NDEBUG
 	PcmFormatConverter()
@@ -20,31 +20,52 @@
 #include "config.h"
 #include "GlueResampler.hxx"
 #include "ConfiguredResampler.hxx"
+#include "ResamplerCache.hxx"
 #include "Resampler.hxx"
 
 #include <assert.h>
 
+/**
+ * Idle resamplers which may be reused by the next Open() call with
+ * the same parameters, e.g. after an audio output has reopened its
+ * filter chain at a song boundary.
+ */
+static PcmResamplerCache resampler_cache(4);
+
 GluePcmResampler::GluePcmResampler()
-	:resampler(pcm_resampler_create()) {}
+	:resampler(nullptr) {}
 
 GluePcmResampler::~GluePcmResampler()
 {
-	delete resampler;
+	assert(resampler == nullptr);
 }
 
 bool
-GluePcmResampler::Open(AudioFormat src_format, unsigned new_sample_rate,
+GluePcmResampler::Open(AudioFormat _src_format, unsigned _new_sample_rate,
 		       Error &error)
 {
-	assert(src_format.IsValid());
-	assert(audio_valid_sample_rate(new_sample_rate));
-
-	AudioFormat requested_format = src_format;
-	AudioFormat dest_format = resampler->Open(requested_format,
-						  new_sample_rate,
-						  error);
-	if (!dest_format.IsValid())
-		return false;
+	assert(resampler == nullptr);
+	assert(_src_format.IsValid());
+	assert(audio_valid_sample_rate(_new_sample_rate));
+
+	src_format = _src_format;
+	new_sample_rate = _new_sample_rate;
+
+	resampler = resampler_cache.Take(src_format, new_sample_rate,
+					 requested_format, dest_format);
+	if (resampler == nullptr) {
+		resampler = pcm_resampler_create();
+
+		requested_format = src_format;
+		dest_format = resampler->Open(requested_format,
+					      new_sample_rate,
+					      error);
+		if (!dest_format.IsValid()) {
+			delete resampler;
+			resampler = nullptr;
+			return false;
+		}
+	}
 
 	assert(requested_format.channels == src_format.channels);
 	assert(dest_format.channels == src_format.channels);
@@ -52,30 +73,38 @@ GluePcmResampler::Open(AudioFormat src_format, unsigned new_sample_rate,
 
 	if (requested_format.format != src_format.format &&
 	    !format_converter.Open(src_format.format, requested_format.format,
-				   error))
+				   error)) {
+		resampler_cache.Put(src_format, new_sample_rate,
+				    requested_format, dest_format,
+				    resampler);
+		resampler = nullptr;
 		return false;
+	}
 
-	src_sample_format = src_format.format;
-	requested_sample_format = requested_format.format;
-	output_sample_format = dest_format.format;
 	return true;
 }
 
 void
 GluePcmResampler::Close()
 {
-	if (requested_sample_format != src_sample_format)
+	assert(resampler != nullptr);
+
+	if (requested_format.format != src_format.format)
 		format_converter.Close();
 
-	resampler->Close();
+	resampler_cache.Put(src_format, new_sample_rate,
+			    requested_format, dest_format,
+			    resampler);
+	resampler = nullptr;
 }
 
 ConstBuffer<void>
 GluePcmResampler::Resample(ConstBuffer<void> src, Error &error)
 {
+	assert(resampler != nullptr);
 	assert(!src.IsNull());
 
-	if (requested_sample_format != src_sample_format) {
+	if (requested_format.format != src_format.format) {
 		src = format_converter.Convert(src, error);
 		if (src.IsNull())
 			return nullptr;
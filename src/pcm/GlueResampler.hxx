@@ -34,10 +34,20 @@ template<typename T> struct ConstBuffer;
  * #PcmResampler instance.
  */
 class GluePcmResampler {
-	PcmResampler *const resampler;
+	/**
+	 * The resampler while opened; it is taken from and returned
+	 * to the #PcmResamplerCache.
+	 */
+	PcmResampler *resampler;
+
+	AudioFormat src_format;
+	unsigned new_sample_rate;
 
-	SampleFormat src_sample_format, requested_sample_format;
-	SampleFormat output_sample_format;
+	/**
+	 * The input format requested by the #PcmResampler and its
+	 * output format.
+	 */
+	AudioFormat requested_format, dest_format;
 
 	/**
 	 * This object converts input data to the sample format
@@ -49,12 +59,12 @@ public:
 	GluePcmResampler();
 	~GluePcmResampler();
 
-	bool Open(AudioFormat src_format, unsigned new_sample_rate,
+	bool Open(AudioFormat _src_format, unsigned _new_sample_rate,
 		  Error &error);
 	void Close();
 
 	SampleFormat GetOutputSampleFormat() const {
-		return output_sample_format;
+		return dest_format.format;
 	}
 
 	ConstBuffer<void> Resample(ConstBuffer<void> src, Error &error);
@@ -122,6 +122,12 @@ LibsampleratePcmResampler::Close()
 	state = src_delete(state);
 }
 
+void
+LibsampleratePcmResampler::Reset()
+{
+	src_reset(state);
+}
+
 static bool
 src_process(SRC_STATE *state, SRC_DATA *data, Error &error)
 {
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "LoudnessMeter.hxx"
+#include "Simd.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+/**
+ * Blocks quieter than this are ignored [LUFS].
+ */
+static constexpr double ABSOLUTE_GATE = -70;
+
+/**
+ * Blocks quieter than the mean of the blocks above the absolute gate
+ * by this amount are ignored [LU].
+ */
+static constexpr double RELATIVE_GATE = -10;
+
+static double
+LoudnessToEnergy(double lufs)
+{
+	return pow(10., (lufs + 0.691) / 10.);
+}
+
+static double
+EnergyToLoudness(double energy)
+{
+	return -0.691 + 10. * log10(energy);
+}
+
+/**
+ * The channel weights of ITU-R BS.1770 for MPD's channel order: the
+ * surround channels are amplified, the LFE channel is ignored.
+ */
+gcc_const
+static float
+ChannelWeight(unsigned channels, unsigned i)
+{
+	if (channels <= 3)
+		return 1;
+
+	if (channels == 4)
+		/* FL, FR, BL, BR */
+		return i < 2 ? 1 : 1.41f;
+
+	if (channels == 5)
+		/* FL, FR, FC, BL, BR */
+		return i < 3 ? 1 : 1.41f;
+
+	/* FL, FR, FC, LFE, ... */
+	if (i < 3)
+		return 1;
+	else if (i == 3)
+		return 0;
+	else
+		return 1.41f;
+}
+
+PcmLoudnessMeter::PcmLoudnessMeter()
+	:simd(GetPcmSimd()), channels(0) {}
+
+void
+PcmLoudnessMeter::Open(unsigned sample_rate, unsigned _channels)
+{
+	assert(audio_valid_sample_rate(sample_rate));
+	assert(audio_valid_channel_count(_channels));
+
+	channels = _channels;
+
+	/* the filter coefficients of BS.1770, adapted to the
+	   sample rate (like libebur128 does) */
+	double f0 = 1681.974450955533;
+	const double G = 3.999843853973347;
+	double Q = 0.7071752369554196;
+
+	double K = tan(M_PI * f0 / sample_rate);
+	const double Vh = pow(10., G / 20.);
+	const double Vb = pow(Vh, 0.4996667741545416);
+
+	double a0 = 1. + K / Q + K * K;
+	shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+	shelf.b1 = 2. * (K * K - Vh) / a0;
+	shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+	shelf.a1 = 2. * (K * K - 1.) / a0;
+	shelf.a2 = (1. - K / Q + K * K) / a0;
+
+	f0 = 38.13547087602444;
+	Q = 0.5003270373238773;
+	K = tan(M_PI * f0 / sample_rate);
+
+	a0 = 1. + K / Q + K * K;
+	highpass.b0 = 1.;
+	highpass.b1 = -2.;
+	highpass.b2 = 1.;
+	highpass.a1 = 2. * (K * K - 1.) / a0;
+	highpass.a2 = (1. - K / Q + K * K) / a0;
+
+	for (unsigned i = 0; i < channels; ++i)
+		weights[i] = ChannelWeight(channels, i);
+
+	memset(state, 0, sizeof(state));
+
+	subblock_frames = std::max(sample_rate / 10, 1u);
+	subblock_fill = 0;
+	subblock_energy = 0;
+	n_subblocks = 0;
+	blocks.clear();
+	peak = 0;
+}
+
+inline double
+PcmLoudnessMeter::Biquad::Run(double *z, double x) const
+{
+	const double y = b0 * x + z[0];
+	z[0] = b1 * x - a1 * y + z[1];
+	z[1] = b2 * x - a2 * y;
+	return y;
+}
+
+inline void
+PcmLoudnessMeter::ProcessChunk(const float *src, size_t n)
+{
+	assert(n <= BUFFER_FRAMES);
+
+	float *dest[MAX_CHANNELS];
+	for (unsigned c = 0; c < channels; ++c)
+		dest[c] = buffer[c];
+
+	simd.deinterleave_float(dest, src, n, channels);
+
+	for (unsigned c = 0; c < channels; ++c) {
+		if (weights[c] <= 0)
+			continue;
+
+		float *p = buffer[c];
+		double *z0 = state[c].z[0], *z1 = state[c].z[1];
+
+		/* the filters are recursive, there is nothing to
+		   vectorize here */
+		for (size_t i = 0; i < n; ++i)
+			p[i] = highpass.Run(z1, shelf.Run(z0, p[i]));
+
+		subblock_energy += weights[c] * simd.dot_float(p, p, n);
+	}
+}
+
+inline void
+PcmLoudnessMeter::FinishSubblock()
+{
+	recent[n_subblocks++ % 4] = subblock_energy;
+	subblock_energy = 0;
+	subblock_fill = 0;
+
+	if (n_subblocks >= 4) {
+		/* the gating blocks overlap by 75% */
+		const double sum = recent[0] + recent[1] +
+			recent[2] + recent[3];
+		blocks.push_back(sum / (4 * subblock_frames));
+	}
+}
+
+void
+PcmLoudnessMeter::Process(const float *src, size_t n)
+{
+	assert(channels > 0);
+
+	peak = std::max(peak, simd.peak_float(src, n * channels));
+
+	while (n > 0) {
+		size_t chunk = std::min(n, size_t(BUFFER_FRAMES));
+		chunk = std::min(chunk, subblock_frames - subblock_fill);
+
+		ProcessChunk(src, chunk);
+		src += chunk * channels;
+		n -= chunk;
+
+		subblock_fill += chunk;
+		if (subblock_fill == subblock_frames)
+			FinishSubblock();
+	}
+}
+
+bool
+PcmLoudnessMeter::GetIntegratedLoudness(double &loudness_r) const
+{
+	const double absolute = LoudnessToEnergy(ABSOLUTE_GATE);
+
+	double sum = 0;
+	size_t count = 0;
+	for (double e : blocks) {
+		if (e > absolute) {
+			sum += e;
+			++count;
+		}
+	}
+
+	if (count == 0)
+		return false;
+
+	const double relative = sum / count * pow(10., RELATIVE_GATE / 10.);
+	const double threshold = std::max(absolute, relative);
+
+	sum = 0;
+	count = 0;
+	for (double e : blocks) {
+		if (e > threshold) {
+			sum += e;
+			++count;
+		}
+	}
+
+	if (count == 0)
+		return false;
+
+	loudness_r = EnergyToLoudness(sum / count);
+	return true;
+}
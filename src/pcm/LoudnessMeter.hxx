@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_LOUDNESS_METER_HXX
+#define MPD_PCM_LOUDNESS_METER_HXX
+
+#include "AudioFormat.hxx"
+#include "Compiler.h"
+
+#include <vector>
+
+#include <stddef.h>
+
+struct PcmSimd;
+
+/**
+ * Measures the integrated loudness (EBU R128 / ITU-R BS.1770) and
+ * the sample peak of a song.  The input is interleaved floating
+ * point samples; the channel filters are scalar, but the peak,
+ * deinterleaving and energy sums use the #PcmSimd kernels.
+ */
+class PcmLoudnessMeter {
+	/**
+	 * The number of frames which are filtered at a time.
+	 */
+	static constexpr size_t BUFFER_FRAMES = 1024;
+
+	/**
+	 * Two cascaded biquad filters (the "K" weighting: a high
+	 * shelf and a high pass), transposed direct form II.
+	 */
+	struct Biquad {
+		double b0, b1, b2, a1, a2;
+
+		double Run(double *z, double x) const;
+	};
+
+	struct ChannelState {
+		double z[2][2];
+	};
+
+	const PcmSimd &simd;
+
+	Biquad shelf, highpass;
+
+	unsigned channels;
+
+	float weights[MAX_CHANNELS];
+
+	ChannelState state[MAX_CHANNELS];
+
+	/**
+	 * The length of a gating sub-block (100 ms) in frames.
+	 */
+	size_t subblock_frames;
+
+	/**
+	 * The number of frames in the current sub-block.
+	 */
+	size_t subblock_fill;
+
+	/**
+	 * The weighted energy sum of the current sub-block.
+	 */
+	double subblock_energy;
+
+	/**
+	 * The energy sums of the last 4 sub-blocks, which make one
+	 * 400 ms gating block.
+	 */
+	double recent[4];
+
+	unsigned n_subblocks;
+
+	/**
+	 * The mean square of each gating block.
+	 */
+	std::vector<double> blocks;
+
+	float peak;
+
+	float buffer[MAX_CHANNELS][BUFFER_FRAMES];
+
+public:
+	PcmLoudnessMeter();
+
+	/**
+	 * Prepare for Process() and reset all measurements.
+	 */
+	void Open(unsigned sample_rate, unsigned channels);
+
+	/**
+	 * Feed interleaved samples (in the range -1..1) into the
+	 * meter.
+	 *
+	 * @param n the number of frames
+	 */
+	void Process(const float *src, size_t n);
+
+	/**
+	 * Determine the integrated (gated) loudness of all samples
+	 * passed to Process() in LUFS.
+	 *
+	 * @return false if everything was below the gates (e.g.
+	 * silence), i.e. there is no measurement
+	 */
+	bool GetIntegratedLoudness(double &loudness_r) const;
+
+	/**
+	 * Returns the sample peak (full scale is 1).
+	 */
+	float GetPeak() const {
+		return peak;
+	}
+
+private:
+	void ProcessChunk(const float *src, size_t n);
+	void FinishSubblock();
+};
+
+#endif
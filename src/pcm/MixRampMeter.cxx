@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MixRampMeter.hxx"
+#include "Simd.hxx"
+#include "AudioFormat.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+
+gcc_const
+static float
+DbfsToMeanSquare(double dbfs)
+{
+	return pow(10., dbfs / 10.);
+}
+
+PcmMixRampMeter::PcmMixRampMeter()
+	:simd(GetPcmSimd()), channels(0) {}
+
+void
+PcmMixRampMeter::Open(unsigned _sample_rate, unsigned _channels)
+{
+	assert(audio_valid_sample_rate(_sample_rate));
+	assert(audio_valid_channel_count(_channels));
+
+	sample_rate = _sample_rate;
+	channels = _channels;
+	block_frames = std::max(sample_rate / 10, 1u);
+	block_fill = 0;
+	block_sum = 0;
+	levels.clear();
+}
+
+void
+PcmMixRampMeter::Process(const float *src, size_t n)
+{
+	assert(channels > 0);
+
+	while (n > 0) {
+		const size_t chunk = std::min(n, block_frames - block_fill);
+		const size_t n_samples = chunk * channels;
+
+		block_sum += simd.dot_float(src, src, n_samples);
+		src += n_samples;
+		n -= chunk;
+
+		block_fill += chunk;
+		if (block_fill == block_frames) {
+			levels.push_back(block_sum /
+					 (block_frames * channels));
+			block_sum = 0;
+			block_fill = 0;
+		}
+	}
+}
+
+double
+PcmMixRampMeter::FindStart(double dbfs) const
+{
+	const float threshold = DbfsToMeanSquare(dbfs);
+
+	const auto i = std::find_if(levels.begin(), levels.end(),
+				    [threshold](float level){
+					    return level >= threshold;
+				    });
+	if (i == levels.end())
+		return -1;
+
+	return double(std::distance(levels.begin(), i) * block_frames) /
+		sample_rate;
+}
+
+double
+PcmMixRampMeter::FindEnd(double dbfs) const
+{
+	const float threshold = DbfsToMeanSquare(dbfs);
+
+	const auto i = std::find_if(levels.rbegin(), levels.rend(),
+				    [threshold](float level){
+					    return level >= threshold;
+				    });
+	if (i == levels.rend())
+		return -1;
+
+	/* the incomplete last block counts as part of the end */
+	return double(std::distance(levels.rbegin(), i) * block_frames +
+		      block_fill) / sample_rate;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_MIX_RAMP_METER_HXX
+#define MPD_PCM_MIX_RAMP_METER_HXX
+
+#include "Compiler.h"
+
+#include <vector>
+
+#include <stddef.h>
+
+struct PcmSimd;
+
+/**
+ * Records the level of a song in 100 ms blocks, to find out where it
+ * fades in and out (the "MixRamp" start and end points, see
+ * MixRampInfo).  The level is the unweighted mean square of all
+ * channels, relative to full scale.
+ */
+class PcmMixRampMeter {
+	const PcmSimd &simd;
+
+	unsigned sample_rate, channels;
+
+	/**
+	 * The length of a block in frames.
+	 */
+	size_t block_frames;
+
+	/**
+	 * The number of frames in the current block.
+	 */
+	size_t block_fill;
+
+	/**
+	 * The sum of squares of the current block.
+	 */
+	double block_sum;
+
+	/**
+	 * The mean square of each finished block.
+	 */
+	std::vector<float> levels;
+
+public:
+	PcmMixRampMeter();
+
+	/**
+	 * Prepare for Process() and reset all measurements.
+	 */
+	void Open(unsigned sample_rate, unsigned channels);
+
+	/**
+	 * Feed interleaved samples (in the range -1..1) into the
+	 * meter.
+	 *
+	 * @param n the number of frames
+	 */
+	void Process(const float *src, size_t n);
+
+	/**
+	 * Returns the time from the beginning of the song until the
+	 * level reaches the specified value for the first time [s],
+	 * or a negative value if it never does.
+	 */
+	gcc_pure
+	double FindStart(double dbfs) const;
+
+	/**
+	 * Returns the time from the last point where the level
+	 * reaches the specified value until the end of the song [s],
+	 * or a negative value if it never does.
+	 */
+	gcc_pure
+	double FindEnd(double dbfs) const;
+};
+
+#endif
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Normalizer.hxx"
+#include "Simd.hxx"
+#include "Traits.hxx"
+
+#include <algorithm>
+#include <cmath>
+
+#include <assert.h>
+#include <stdint.h>
+
+/**
+ * The level which is aimed at, relative to full scale.
+ */
+static constexpr float TARGET = 0.5;
+
+/**
+ * The maximum amplification.
+ */
+static constexpr float MAX_GAIN = 32;
+
+/**
+ * The inertia of gain changes: each window moves the gain by
+ * 1/SMOOTH towards the target.
+ */
+static constexpr float SMOOTH = 256;
+
+/**
+ * The number of samples which are analyzed at a time.  This is
+ * what AudioCompress processed per call with MPD's default chunk
+ * size, and determines the time constants of the history and of
+ * #SMOOTH.
+ */
+static constexpr size_t WINDOW = 2048;
+
+/**
+ * Gain changes are ramped in steps of this number of samples.
+ */
+static constexpr size_t RAMP_BLOCK = 64;
+
+/**
+ * The peak assumed for silence, which limits the gain.
+ */
+static constexpr float MIN_PEAK = 1.0f / 32768;
+
+static float
+PeakOf(const int16_t *src, size_t n)
+{
+	return GetPcmSimd().peak_16(src, n);
+}
+
+static float
+PeakOf(const int32_t *src, size_t n)
+{
+	return GetPcmSimd().peak_32(src, n);
+}
+
+static float
+PeakOf(const float *src, size_t n)
+{
+	return GetPcmSimd().peak_float(src, n);
+}
+
+static void
+ApplyGain(int16_t *data, size_t n, float gain, gcc_unused int16_t max)
+{
+	const long g = std::min(std::lrint(gain * 1024), 32767L);
+	GetPcmSimd().gain_16(data, data, n, int(g));
+}
+
+static void
+ApplyGain(int32_t *data, size_t n, float gain, int32_t max)
+{
+	const int64_t g = std::lrint(gain * 65536);
+
+	for (size_t i = 0; i != n; ++i) {
+		const int64_t x = (int64_t(data[i]) * g) >> 16;
+		data[i] = int32_t(std::min<int64_t>(std::max<int64_t>(x, -max - 1),
+						    max));
+	}
+}
+
+static void
+ApplyGain(float *data, size_t n, float gain, gcc_unused float max)
+{
+	GetPcmSimd().volume_float(data, data, n, gain);
+}
+
+bool
+PcmNormalizer::IsSupported(SampleFormat format)
+{
+	switch (format) {
+	case SampleFormat::S16:
+	case SampleFormat::S24_P32:
+	case SampleFormat::S32:
+	case SampleFormat::FLOAT:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+void
+PcmNormalizer::Open(SampleFormat _format)
+{
+	assert(IsSupported(_format));
+
+	format = _format;
+	std::fill_n(peaks, HISTORY, 0.0f);
+	pos = 0;
+	gain = 1;
+}
+
+template<SampleFormat F>
+void
+PcmNormalizer::ProcessWindow(void *_data, size_t n)
+{
+	typedef SampleTraits<F> Traits;
+	const auto data = (typename Traits::pointer_type)_data;
+
+	const float peak = PeakOf(data, n) / float(Traits::MAX);
+
+	pos = (pos + 1) % HISTORY;
+	peaks[pos] = peak;
+
+	const float history_peak =
+		std::max(*std::max_element(peaks, peaks + HISTORY), MIN_PEAK);
+
+	/* approach the gain which brings the history's peak to the
+	   target level */
+	float new_gain = TARGET / history_peak;
+	new_gain = (gain * (SMOOTH - 1) + new_gain) / SMOOTH;
+	new_gain = std::max(std::min(new_gain, MAX_GAIN), 1.0f);
+
+	/* don't let the loudest sample clip; if that would happen,
+	   switch to the lower gain immediately instead of ramping */
+	bool ramp = true;
+	if (history_peak * new_gain > 1) {
+		new_gain = std::max(1 / history_peak, 1.0f);
+		ramp = false;
+	}
+
+	const float old_gain = gain;
+	gain = new_gain;
+
+	if (!ramp || old_gain == new_gain) {
+		if (new_gain != 1)
+			ApplyGain(data, n, new_gain, Traits::MAX);
+		return;
+	}
+
+	const size_t n_blocks = (n + RAMP_BLOCK - 1) / RAMP_BLOCK;
+	for (size_t i = 0; i < n_blocks; ++i) {
+		const size_t offset = i * RAMP_BLOCK;
+		const float g = old_gain +
+			(new_gain - old_gain) * (i + 1) / n_blocks;
+		ApplyGain(data + offset, std::min(RAMP_BLOCK, n - offset),
+			  g, Traits::MAX);
+	}
+}
+
+void
+PcmNormalizer::Process(void *data, size_t size)
+{
+	assert(IsSupported(format));
+
+	const size_t sample_size = sample_format_size(format);
+	size_t n = size / sample_size;
+	uint8_t *p = (uint8_t *)data;
+
+	while (n > 0) {
+		const size_t window = std::min(n, WINDOW);
+
+		switch (format) {
+		case SampleFormat::S16:
+			ProcessWindow<SampleFormat::S16>(p, window);
+			break;
+
+		case SampleFormat::S24_P32:
+			ProcessWindow<SampleFormat::S24_P32>(p, window);
+			break;
+
+		case SampleFormat::S32:
+			ProcessWindow<SampleFormat::S32>(p, window);
+			break;
+
+		case SampleFormat::FLOAT:
+			ProcessWindow<SampleFormat::FLOAT>(p, window);
+			break;
+
+		default:
+			assert(false);
+			gcc_unreachable();
+		}
+
+		p += window * sample_size;
+		n -= window;
+	}
+}
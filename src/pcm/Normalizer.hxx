@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_NORMALIZER_HXX
+#define MPD_PCM_NORMALIZER_HXX
+
+#include "AudioFormat.hxx"
+#include "Compiler.h"
+
+#include <stddef.h>
+
+/**
+ * A dynamic range compressor which adjusts the volume towards a
+ * target level, based on the peaks of the recent past.  This
+ * implements the algorithm of AudioCompress 2.0 (by busybee), but
+ * works on all linear PCM sample formats natively, and uses the
+ * #PcmSimd kernels for finding peaks and applying the gain.
+ */
+class PcmNormalizer {
+	/**
+	 * The number of windows in the peak history.
+	 */
+	static constexpr unsigned HISTORY = 400;
+
+	SampleFormat format;
+
+	/**
+	 * The peak of each window in the history, relative to full
+	 * scale.
+	 */
+	float peaks[HISTORY];
+
+	/**
+	 * The index of the most recent entry in #peaks.
+	 */
+	unsigned pos;
+
+	/**
+	 * The gain which was applied at the end of the previous
+	 * window.
+	 */
+	float gain;
+
+public:
+	PcmNormalizer() {
+#ifndef NDEBUG
+		format = SampleFormat::UNDEFINED;
+#endif
+	}
+
+	/**
+	 * Can this class process the specified sample format?  All
+	 * other formats must be converted (e.g. to S16) first.
+	 */
+	gcc_const
+	static bool IsSupported(SampleFormat format);
+
+	/**
+	 * Prepare for Process(), and reset the history.
+	 *
+	 * @param format a format accepted by IsSupported()
+	 */
+	void Open(SampleFormat format);
+
+	/**
+	 * Normalize the specified samples in-place.
+	 *
+	 * @param size the size of the buffer in bytes
+	 */
+	void Process(void *data, size_t size);
+
+private:
+	/**
+	 * Process one window: measure its peak, determine the new
+	 * gain and ramp from the previous one towards it.
+	 */
+	template<SampleFormat F>
+	void ProcessWindow(void *data, size_t n);
+};
+
+#endif
@@ -19,6 +19,19 @@
 
 #include "config.h"
 #include "PcmBuffer.hxx"
+#include "util/HugeAllocator.hxx"
+
+#include <stdlib.h>
+
+void
+PcmBuffer::Clear()
+{
+	if (buffer != nullptr) {
+		HugeFree(buffer, capacity);
+		buffer = nullptr;
+		capacity = 0;
+	}
+}
 
 void *
 PcmBuffer::Get(size_t new_size)
@@ -28,5 +41,19 @@ PcmBuffer::Get(size_t new_size)
 		   assumed to be an error condition */
 		new_size = 1;
 
-	return buffer.Get(new_size);
+	if (gcc_unlikely(new_size > capacity)) {
+		/* too small: grow */
+		Clear();
+
+		const size_t new_capacity = ((new_size - 1) | (ALIGN - 1)) + 1;
+		buffer = HugeAllocate(new_capacity);
+		if (gcc_unlikely(buffer == nullptr))
+			/* out of memory; like xalloc(), don't attempt
+			   to recover */
+			abort();
+
+		capacity = new_capacity;
+	}
+
+	return buffer;
 }
@@ -20,24 +20,44 @@
 #ifndef PCM_BUFFER_HXX
 #define PCM_BUFFER_HXX
 
-#include "util/ReusableArray.hxx"
 #include "Compiler.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
 /**
  * Manager for a temporary buffer which grows as needed.  We could
  * allocate a new buffer every time pcm_convert() is called, but that
  * would put too much stress on the allocator.
+ *
+ * The memory is obtained from HugeAllocate(), so it follows the
+ * "locked" policy of the audio path (see HugeSetLocked()).
  */
 class PcmBuffer {
-	ReusableArray<uint8_t, 8192> buffer;
+	/**
+	 * Always allocate multiples of this number of bytes.
+	 */
+	static constexpr size_t ALIGN = 8192;
+
+	void *buffer = nullptr;
+	size_t capacity = 0;
 
 public:
-	void Clear() {
-		buffer.Clear();
+	PcmBuffer() = default;
+
+	PcmBuffer(const PcmBuffer &) = delete;
+	PcmBuffer &operator=(const PcmBuffer &) = delete;
+
+	~PcmBuffer() {
+		Clear();
 	}
 
+	/**
+	 * Free resources allocated by this object.  This invalidates
+	 * the buffer returned by Get().
+	 */
+	void Clear();
+
 	/**
 	 * Get the buffer, and guarantee a minimum size.  This buffer becomes
 	 * invalid with the next pcm_buffer_get() call.
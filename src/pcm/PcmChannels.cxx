@@ -20,6 +20,7 @@
 #include "config.h"
 #include "PcmChannels.hxx"
 #include "PcmBuffer.hxx"
+#include "Simd.hxx"
 #include "Traits.hxx"
 #include "AudioFormat.hxx"
 #include "util/ConstBuffer.hxx"
@@ -115,6 +116,53 @@ NToM(typename Traits::pointer_type dest,
 	return dest;
 }
 
+/**
+ * Use a #PcmSimd kernel if there is one for this conversion.
+ *
+ * @return false if there is no kernel
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static bool
+ConvertChannelsSimd(typename Traits::pointer_type dest,
+		    unsigned dest_channels,
+		    unsigned src_channels,
+		    ConstBuffer<typename Traits::value_type> src)
+{
+	const PcmSimd &simd = GetPcmSimd();
+
+	if (src_channels == 1 && dest_channels == 2) {
+		if (sizeof(*dest) == sizeof(int16_t))
+			simd.mono_to_stereo_16((int16_t *)dest,
+					       (const int16_t *)src.data,
+					       src.size);
+		else if (sizeof(*dest) == sizeof(uint32_t))
+			simd.mono_to_stereo_32((uint32_t *)dest,
+					       (const uint32_t *)src.data,
+					       src.size);
+		else
+			return false;
+
+		return true;
+	}
+
+	if (src_channels == 2 && dest_channels == 1) {
+		if (F == SampleFormat::S16)
+			simd.stereo_to_mono_16((int16_t *)dest,
+					       (const int16_t *)src.data,
+					       src.size / 2);
+		else if (F == SampleFormat::FLOAT)
+			simd.stereo_to_mono_float((float *)dest,
+						  (const float *)src.data,
+						  src.size / 2);
+		else
+			return false;
+
+		return true;
+	}
+
+	return false;
+}
+
 template<SampleFormat F, class Traits=SampleTraits<F>>
 static ConstBuffer<typename Traits::value_type>
 ConvertChannels(PcmBuffer &buffer,
@@ -127,6 +175,9 @@ ConvertChannels(PcmBuffer &buffer,
 	const size_t dest_size = src.size / src_channels * dest_channels;
 	auto dest = buffer.GetT<typename Traits::value_type>(dest_size);
 
+	if (ConvertChannelsSimd<F>(dest, dest_channels, src_channels, src))
+		return { dest, dest_size };
+
 	if (src_channels == 1 && dest_channels == 2)
 		MonoToStereo(dest, src.begin(), src.end());
 	else if (src_channels == 2 && dest_channels == 1)
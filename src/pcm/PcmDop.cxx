@@ -20,25 +20,12 @@
 #include "config.h"
 #include "PcmDop.hxx"
 #include "PcmBuffer.hxx"
+#include "Simd.hxx"
 #include "AudioFormat.hxx"
 #include "util/ConstBuffer.hxx"
 
 #include <assert.h>
 
-constexpr
-static inline uint32_t
-pcm_two_dsd_to_dop_marker1(uint8_t a, uint8_t b)
-{
-	return 0xff050000 | (a << 8) | b;
-}
-
-constexpr
-static inline uint32_t
-pcm_two_dsd_to_dop_marker2(uint8_t a, uint8_t b)
-{
-	return 0xfffa0000 | (a << 8) | b;
-}
-
 ConstBuffer<uint32_t>
 pcm_dsd_to_dop(PcmBuffer &buffer, unsigned channels,
 	       ConstBuffer<uint8_t> _src)
@@ -51,46 +38,15 @@ pcm_dsd_to_dop(PcmBuffer &buffer, unsigned channels,
 	const unsigned num_src_samples = _src.size;
 	const unsigned num_src_frames = num_src_samples / channels;
 
-	/* this rounds down and discards the last odd frame; not
-	   elegant, but good enough for now */
-	const unsigned num_frames = num_src_frames / 2;
-	const unsigned num_samples = num_frames * channels;
-
-	uint32_t *const dest0 = (uint32_t *)buffer.GetT<uint32_t>(num_samples),
-		*dest = dest0;
-
-	auto src = _src.data;
-	for (unsigned i = num_frames / 2; i > 0; --i) {
-		for (unsigned c = channels; c > 0; --c) {
-			/* each 24 bit sample has 16 DSD sample bits
-			   plus the magic 0x05 marker */
-
-			*dest++ = pcm_two_dsd_to_dop_marker1(src[0], src[channels]);
-
-			/* seek the source pointer to the next
-			   channel */
-			++src;
-		}
-
-		/* skip the second byte of each channel, because we
-		   have already copied it */
-		src += channels;
-
-		for (unsigned c = channels; c > 0; --c) {
-			/* each 24 bit sample has 16 DSD sample bits
-			   plus the magic 0xfa marker */
-
-			*dest++ = pcm_two_dsd_to_dop_marker2(src[0], src[channels]);
+	/* each block of 4 DSD frames becomes 2 DoP frames; this
+	   rounds down and discards the trailing frames; not elegant,
+	   but good enough for now */
+	const unsigned num_blocks = num_src_frames / 4;
+	const unsigned num_samples = num_blocks * 2 * channels;
 
-			/* seek the source pointer to the next
-			   channel */
-			++src;
-		}
+	uint32_t *const dest = buffer.GetT<uint32_t>(num_samples);
 
-		/* skip the second byte of each channel, because we
-		   have already copied it */
-		src += channels;
-	}
+	GetPcmSimd().dsd_to_dop(dest, _src.data, num_blocks, channels);
 
-	return { dest0, num_samples };
+	return { dest, num_samples };
 }
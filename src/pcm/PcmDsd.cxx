@@ -19,7 +19,9 @@
 
 #include "config.h"
 #include "PcmDsd.hxx"
+#include "Simd.hxx"
 #include "dsd2pcm/dsd2pcm.h"
+#include "util/bit_reverse.h"
 #include "util/Macros.hxx"
 #include "util/ConstBuffer.hxx"
 
@@ -27,24 +29,29 @@
 
 #include <assert.h>
 
-PcmDsd::PcmDsd()
+void
+PcmDsd::Channel::Reset()
 {
-	std::fill_n(dsd2pcm, ARRAY_SIZE(dsd2pcm), nullptr);
+	/* 0x69 is the "silence pattern" which dsd2pcm_reset() fills
+	   its FIFO with; of the bytes which dsd2pcm_translate() reads
+	   in reversed bit order, only the last 6 have actually been
+	   reversed at that point */
+	std::fill_n(fwd, HISTORY, 0x69);
+	std::fill_n(rev, 5, 0x69);
+	std::fill_n(rev + 5, HISTORY - 5, bit_reverse(0x69));
 }
 
-PcmDsd::~PcmDsd()
+PcmDsd::PcmDsd()
+	:ctables(dsd2pcm_get_ctables())
 {
-	for (unsigned i = 0; i < ARRAY_SIZE(dsd2pcm); ++i)
-		if (dsd2pcm[i] != nullptr)
-			dsd2pcm_destroy(dsd2pcm[i]);
+	Reset();
 }
 
 void
 PcmDsd::Reset()
 {
-	for (unsigned i = 0; i < ARRAY_SIZE(dsd2pcm); ++i)
-		if (dsd2pcm[i] != nullptr)
-			dsd2pcm_reset(dsd2pcm[i]);
+	for (auto &i : state)
+		i.Reset();
 }
 
 ConstBuffer<float>
@@ -53,25 +60,47 @@ PcmDsd::ToFloat(unsigned channels, ConstBuffer<uint8_t> src)
 	assert(!src.IsNull());
 	assert(!src.IsEmpty());
 	assert(src.size % channels == 0);
-	assert(channels <= ARRAY_SIZE(dsd2pcm));
+	assert(channels <= ARRAY_SIZE(state));
 
 	const unsigned num_samples = src.size;
 	const unsigned num_frames = src.size / channels;
 
-	float *dest;
-	const size_t dest_size = num_samples * sizeof(*dest);
-	dest = (float *)buffer.Get(dest_size);
+	float *dest = buffer.GetT<float>(num_samples);
+
+	/* the scratch buffer contains one channel of output (unless
+	   it can be written to "dest" directly), followed by the
+	   input bytes with history in both bit orders */
+	const size_t n = HISTORY + num_frames;
+	float *const tmp =
+		(float *)scratch_buffer.Get(num_frames * sizeof(float) +
+					    2 * n);
+	uint8_t *const fwd = (uint8_t *)(tmp + num_frames);
+	uint8_t *const rev = fwd + n;
+
+	const auto &simd = GetPcmSimd();
 
 	for (unsigned c = 0; c < channels; ++c) {
-		if (dsd2pcm[c] == nullptr) {
-			dsd2pcm[c] = dsd2pcm_init();
-			if (dsd2pcm[c] == nullptr)
-				return nullptr;
+		Channel &channel = state[c];
+
+		std::copy_n(channel.fwd, HISTORY, fwd);
+		std::copy_n(channel.rev, HISTORY, rev);
+
+		for (unsigned i = 0; i < num_frames; ++i) {
+			const uint8_t x = src.data[i * channels + c];
+			fwd[HISTORY + i] = x;
+			rev[HISTORY + i] = bit_reverse(x);
+		}
+
+		if (channels == 1) {
+			simd.dsd2pcm(dest, fwd, rev, num_frames, ctables);
+		} else {
+			simd.dsd2pcm(tmp, fwd, rev, num_frames, ctables);
+			for (unsigned i = 0; i < num_frames; ++i)
+				dest[i * channels + c] = tmp[i];
 		}
 
-		dsd2pcm_translate(dsd2pcm[c], num_frames,
-				  src.data + c, channels,
-				  false, dest + c, channels);
+		std::copy_n(fwd + num_frames, HISTORY, channel.fwd);
+		std::copy_n(rev + num_frames, HISTORY, channel.rev);
 	}
 
 	return { dest, num_samples };
@@ -28,16 +28,35 @@
 template<typename T> struct ConstBuffer;
 
 /**
- * Wrapper for the dsd2pcm library.
+ * Convert DSD to PCM with the dsd2pcm filter.  The filter itself is
+ * implemented by the #PcmSimd kernel; this class manages the
+ * per-channel history.
  */
 class PcmDsd {
-	PcmBuffer buffer;
+	/**
+	 * The number of DSD bytes of each channel which must be
+	 * remembered for the next call.
+	 */
+	static constexpr unsigned HISTORY = 11;
 
-	struct dsd2pcm_ctx_s *dsd2pcm[32];
+	struct Channel {
+		/**
+		 * The last #HISTORY bytes in original and in
+		 * reversed bit order.
+		 */
+		uint8_t fwd[HISTORY], rev[HISTORY];
+
+		void Reset();
+	};
+
+	PcmBuffer buffer, scratch_buffer;
+
+	Channel state[32];
+
+	const float *ctables;
 
 public:
 	PcmDsd();
-	~PcmDsd();
 
 	void Reset();
 
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "PcmDsdPack.hxx"
+#include "util/ConstBuffer.hxx"
+#include "Compiler.h"
+
+#include <assert.h>
+
+/**
+ * The inner loop, with all parameters known at compile time for
+ * the common cases; this allows the compiler to turn it into a
+ * sequence of byte shuffles.
+ */
+template<unsigned SIZE, bool BIG_ENDIAN_, unsigned CHANNELS>
+static void
+DsdPack(uint8_t *gcc_restrict dest, const uint8_t *gcc_restrict src,
+	size_t n_frames)
+{
+	for (size_t i = 0; i < n_frames; ++i) {
+		for (unsigned c = 0; c < CHANNELS; ++c)
+			for (unsigned k = 0; k < SIZE; ++k)
+				dest[c * SIZE + (BIG_ENDIAN_ ? k : SIZE - 1 - k)] =
+					src[k * CHANNELS + c];
+
+		src += SIZE * CHANNELS;
+		dest += SIZE * CHANNELS;
+	}
+}
+
+template<unsigned SIZE, bool BIG_ENDIAN_>
+static void
+DsdPack(uint8_t *gcc_restrict dest, const uint8_t *gcc_restrict src,
+	size_t n_frames, unsigned channels)
+{
+	switch (channels) {
+	case 1:
+		DsdPack<SIZE, BIG_ENDIAN_, 1>(dest, src, n_frames);
+		return;
+
+	case 2:
+		DsdPack<SIZE, BIG_ENDIAN_, 2>(dest, src, n_frames);
+		return;
+	}
+
+	for (size_t i = 0; i < n_frames; ++i) {
+		for (unsigned c = 0; c < channels; ++c)
+			for (unsigned k = 0; k < SIZE; ++k)
+				dest[c * SIZE + (BIG_ENDIAN_ ? k : SIZE - 1 - k)] =
+					src[k * channels + c];
+
+		src += SIZE * channels;
+		dest += SIZE * channels;
+	}
+}
+
+size_t
+pcm_dsd_pack(uint8_t *dest, unsigned channels, ConstBuffer<uint8_t> src,
+	     unsigned sample_size, bool big_endian)
+{
+	assert(channels > 0);
+	assert(src.size % channels == 0);
+	assert(sample_size == 2 || sample_size == 4);
+
+	const size_t n_frames = src.size / (channels * sample_size);
+
+	if (sample_size == 2) {
+		if (big_endian)
+			DsdPack<2, true>(dest, src.data, n_frames, channels);
+		else
+			DsdPack<2, false>(dest, src.data, n_frames, channels);
+	} else {
+		if (big_endian)
+			DsdPack<4, true>(dest, src.data, n_frames, channels);
+		else
+			DsdPack<4, false>(dest, src.data, n_frames, channels);
+	}
+
+	return n_frames * channels * sample_size;
+}
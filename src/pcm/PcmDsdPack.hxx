@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_DSD_PACK_HXX
+#define MPD_PCM_DSD_PACK_HXX
+
+#include "check.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+template<typename T> struct ConstBuffer;
+
+/**
+ * Pack consecutive DSD bytes of each channel into 16 or 32 bit
+ * samples, for playback with ALSA's native DSD_U16 and DSD_U32
+ * formats.  The first (oldest) byte is the most significant one.
+ * Trailing frames which do not fill a whole sample are discarded.
+ *
+ * Packing and byte order are done in one pass.
+ *
+ * @param dest the destination buffer; it must be large enough for
+ * (src.size / (channels * sample_size)) * channels * sample_size
+ * bytes
+ * @param sample_size the number of DSD bytes per sample (2 or 4)
+ * @param big_endian true for DSD_U16_BE/DSD_U32_BE, false for the
+ * little-endian variants
+ * @return the number of bytes written to #dest
+ */
+size_t
+pcm_dsd_pack(uint8_t *dest, unsigned channels, ConstBuffer<uint8_t> src,
+	     unsigned sample_size, bool big_endian);
+
+#endif
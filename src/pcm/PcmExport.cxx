@@ -20,18 +20,24 @@
 #include "config.h"
 #include "PcmExport.hxx"
 #include "PcmDop.hxx"
+#include "PcmDsdPack.hxx"
 #include "PcmPack.hxx"
 #include "util/ByteReverse.hxx"
 #include "util/ConstBuffer.hxx"
 
 #include <iterator>
 
+#include <string.h>
+
 void
 PcmExport::Open(SampleFormat sample_format, unsigned _channels,
-		bool _dop, bool _shift8, bool _pack, bool _reverse_endian)
+		bool _dop, bool _shift8, bool _pack, bool _reverse_endian,
+		unsigned _dsd_pack)
 {
 	assert(audio_valid_sample_format(sample_format));
 	assert(!_dop || audio_valid_channel_count(_channels));
+	assert(_dsd_pack <= 1 || audio_valid_channel_count(_channels));
+	assert(_dsd_pack <= 1 || _dsd_pack == 2 || _dsd_pack == 4);
 
 	channels = _channels;
 	dop = _dop && sample_format == SampleFormat::DSD;
@@ -40,6 +46,10 @@ PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 		   samples are stuffed inside fake 24 bit samples */
 		sample_format = SampleFormat::S24_P32;
 
+	dsd_pack = _dsd_pack > 1 && sample_format == SampleFormat::DSD
+		? _dsd_pack
+		: 0;
+
 	shift8 = _shift8 && sample_format == SampleFormat::S24_P32;
 	pack24 = _pack && sample_format == SampleFormat::S24_P32;
 
@@ -49,7 +59,9 @@ PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 	if (_reverse_endian) {
 		size_t sample_size = pack24
 			? 3
-			: sample_format_size(sample_format);
+			: (dsd_pack > 0
+			   ? dsd_pack
+			   : sample_format_size(sample_format));
 		assert(sample_size <= 0xff);
 
 		if (sample_size > 1)
@@ -71,36 +83,63 @@ PcmExport::GetFrameSize(const AudioFormat &audio_format) const
 		   bytes per sample) */
 		return channels * 4;
 
+	if (dsd_pack > 0)
+		return channels * dsd_pack;
+
 	return audio_format.GetFrameSize();
 }
 
+/**
+ * Pack 24 bit samples or shift them left by 8 bits, depending on the
+ * #PcmExport settings.
+ *
+ * @param dest the destination buffer; must be large enough
+ * @return the number of bytes written to #dest
+ */
+static size_t
+PackOrShift(bool pack24, void *_dest, ConstBuffer<void> data)
+{
+	const auto src = ConstBuffer<int32_t>::FromVoid(data);
+
+	if (pack24) {
+		uint8_t *dest = (uint8_t *)_dest;
+		pcm_pack_24(dest, src.begin(), src.end());
+		return src.size * 3;
+	} else {
+		uint32_t *dest = (uint32_t *)_dest;
+		for (auto i : src)
+			*dest++ = i << 8;
+		return data.size;
+	}
+}
+
 ConstBuffer<void>
 PcmExport::Export(ConstBuffer<void> data)
 {
+	if (dsd_pack > 0) {
+		/* packing and byte order in one pass */
+		uint8_t *dest = dsd_buffer.GetT<uint8_t>(data.size);
+		const size_t size =
+			pcm_dsd_pack(dest, channels,
+				     ConstBuffer<uint8_t>::FromVoid(data),
+				     dsd_pack, reverse_endian == 0);
+		return { dest, size };
+	}
+
 	if (dop)
 		data = pcm_dsd_to_dop(dop_buffer, channels,
 				      ConstBuffer<uint8_t>::FromVoid(data))
 			.ToVoid();
 
-	if (pack24) {
-		const auto src = ConstBuffer<int32_t>::FromVoid(data);
-		const size_t num_samples = src.size;
-		const size_t dest_size = num_samples * 3;
-		uint8_t *dest = (uint8_t *)pack_buffer.Get(dest_size);
+	if (pack24 || shift8) {
+		const size_t dest_size = pack24
+			? data.size / 4 * 3
+			: data.size;
+		void *dest = pack_buffer.Get(dest_size);
 		assert(dest != nullptr);
 
-		pcm_pack_24(dest, src.begin(), src.end());
-
-		data.data = dest;
-		data.size = dest_size;
-	} else if (shift8) {
-		const auto src = ConstBuffer<int32_t>::FromVoid(data);
-
-		uint32_t *dest = (uint32_t *)pack_buffer.Get(data.size);
+		data.size = PackOrShift(pack24, dest, data);
 		data.data = dest;
-
-		for (auto i : src)
-			*dest++ = i << 8;
 	}
 
 	if (reverse_endian > 0) {
@@ -118,6 +157,70 @@ PcmExport::Export(ConstBuffer<void> data)
 	return data;
 }
 
+size_t
+PcmExport::ExportTo(ConstBuffer<void> data, void *dest)
+{
+	if (dsd_pack > 0)
+		return pcm_dsd_pack((uint8_t *)dest, channels,
+				    ConstBuffer<uint8_t>::FromVoid(data),
+				    dsd_pack, reverse_endian == 0);
+
+	if (dop)
+		data = pcm_dsd_to_dop(dop_buffer, channels,
+				      ConstBuffer<uint8_t>::FromVoid(data))
+			.ToVoid();
+
+	if (reverse_endian > 0) {
+		assert(reverse_endian >= 2);
+
+		if (pack24 || shift8) {
+			const size_t dest_size = pack24
+				? data.size / 4 * 3
+				: data.size;
+			void *tmp = pack_buffer.Get(dest_size);
+			assert(tmp != nullptr);
+
+			data.size = PackOrShift(pack24, tmp, data);
+			data.data = tmp;
+		}
+
+		const auto src = ConstBuffer<uint8_t>::FromVoid(data);
+		reverse_bytes((uint8_t *)dest, src.begin(), src.end(),
+			      reverse_endian);
+		return data.size;
+	}
+
+	if (pack24 || shift8)
+		return PackOrShift(pack24, dest, data);
+
+	memcpy(dest, data.data, data.size);
+	return data.size;
+}
+
+size_t
+PcmExport::CalcOutputSize(size_t size) const
+{
+	if (dop) {
+		/* DoP doubles the transport size, and it converts
+		   four DSD frames (two DoP frames) at a time */
+		const size_t src_frame_size = 4 * channels;
+		size = size / src_frame_size * src_frame_size * 2;
+	}
+
+	if (dsd_pack > 0) {
+		/* trailing frames which do not fill a whole sample
+		   are discarded */
+		const size_t dest_frame_size = dsd_pack * channels;
+		size = size / dest_frame_size * dest_frame_size;
+	}
+
+	if (pack24)
+		/* 32 bit to 24 bit conversion (4 to 3 bytes) */
+		size = (size / 4) * 3;
+
+	return size;
+}
+
 size_t
 PcmExport::CalcSourceSize(size_t size) const
 {
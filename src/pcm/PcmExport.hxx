@@ -41,6 +41,14 @@ struct PcmExport {
 	 */
 	PcmBuffer dop_buffer;
 
+	/**
+	 * The buffer is used to pack DSD bytes into 16 or 32 bit
+	 * samples.
+	 *
+	 * @see #dsd_pack
+	 */
+	PcmBuffer dsd_buffer;
+
 	/**
 	 * The buffer is used to pack samples, removing padding.
 	 *
@@ -67,6 +75,15 @@ struct PcmExport {
 	 */
 	bool dop;
 
+	/**
+	 * Pack several DSD bytes of each channel into one sample
+	 * (ALSA's DSD_U16 and DSD_U32 formats)?  A non-zero value is
+	 * the number of bytes per sample (2 or 4).  Input format must
+	 * be SampleFormat::DSD.  The big-endian variant is the
+	 * default; #reverse_endian selects little-endian.
+	 */
+	uint8_t dsd_pack;
+
 	/**
 	 * Convert (padded) 24 bit samples to 32 bit by shifting 8
 	 * bits to the left?
@@ -93,10 +110,13 @@ struct PcmExport {
 	 *
 	 * This function cannot fail.
 	 *
-	 * @param channels the number of channels; ignored unless dop is set
+	 * @param channels the number of channels; ignored unless dop
+	 * or dsd_pack is set
+	 * @param dsd_pack see #dsd_pack; 0 or 1 disables it
 	 */
 	void Open(SampleFormat sample_format, unsigned channels,
-		  bool dop, bool shift8, bool pack, bool reverse_endian);
+		  bool dop, bool shift8, bool pack, bool reverse_endian,
+		  unsigned dsd_pack=0);
 
 	/**
 	 * Calculate the size of one output frame.
@@ -112,6 +132,26 @@ struct PcmExport {
 	 */
 	ConstBuffer<void> Export(ConstBuffer<void> src);
 
+	/**
+	 * Like Export(), but write the result to the specified
+	 * buffer (e.g. a memory mapped device buffer).  The last
+	 * conversion writes its output directly into the buffer, and
+	 * if there is no conversion at all, the source is copied.
+	 *
+	 * @param dest the destination buffer; it must be large
+	 * enough to hold CalcOutputSize(src.size) bytes
+	 * @return the number of bytes written to the destination
+	 */
+	size_t ExportTo(ConstBuffer<void> src, void *dest);
+
+	/**
+	 * Converts the number of bytes in the pcm_export() source
+	 * buffer to the according number of bytes in the
+	 * destination buffer; the inverse of CalcSourceSize().
+	 */
+	gcc_pure
+	size_t CalcOutputSize(size_t src_size) const;
+
 	/**
 	 * Converts the number of consumed bytes from the pcm_export()
 	 * destination buffer to the according number of bytes from the
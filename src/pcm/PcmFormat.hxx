@@ -21,6 +21,7 @@
 #define MPD_PCM_FORMAT_HXX
 
 #include "AudioFormat.hxx"
+#include "Simd.hxx"
 
 #include <stdint.h>
 #include <stddef.h>
@@ -36,47 +37,55 @@ class PcmDither;
  * @param buffer a #PcmBuffer object
  * @param dither a #PcmDither object for 24-to-16 conversion
  * @param src the source PCM buffer
+ * @param simd the kernels to be used
  * @return the destination buffer
  */
 gcc_pure
 ConstBuffer<int16_t>
 pcm_convert_to_16(PcmBuffer &buffer, PcmDither &dither,
-		  SampleFormat src_format, ConstBuffer<void> src);
+		  SampleFormat src_format, ConstBuffer<void> src,
+		  const PcmSimd &simd=GetPcmSimd());
 
 /**
  * Converts PCM samples to 24 bit (32 bit alignment).
  *
  * @param buffer a #PcmBuffer object
  * @param src the source PCM buffer
+ * @param simd the kernels to be used
  * @return the destination buffer
  */
 gcc_pure
 ConstBuffer<int32_t>
 pcm_convert_to_24(PcmBuffer &buffer,
-		  SampleFormat src_format, ConstBuffer<void> src);
+		  SampleFormat src_format, ConstBuffer<void> src,
+		  const PcmSimd &simd=GetPcmSimd());
 
 /**
  * Converts PCM samples to 32 bit.
  *
  * @param buffer a #PcmBuffer object
  * @param src the source PCM buffer
+ * @param simd the kernels to be used
  * @return the destination buffer
  */
 gcc_pure
 ConstBuffer<int32_t>
 pcm_convert_to_32(PcmBuffer &buffer,
-		  SampleFormat src_format, ConstBuffer<void> src);
+		  SampleFormat src_format, ConstBuffer<void> src,
+		  const PcmSimd &simd=GetPcmSimd());
 
 /**
  * Converts PCM samples to 32 bit floating point.
  *
  * @param buffer a #PcmBuffer object
  * @param src the source PCM buffer
+ * @param simd the kernels to be used
  * @return the destination buffer
  */
 gcc_pure
 ConstBuffer<float>
 pcm_convert_to_float(PcmBuffer &buffer,
-		     SampleFormat src_format, ConstBuffer<void> src);
+		     SampleFormat src_format, ConstBuffer<void> src,
+		     const PcmSimd &simd=GetPcmSimd());
 
 #endif
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "PcmMix.hxx"
 #include "Volume.hxx"
+#include "Simd.hxx"
 #include "PcmUtils.hxx"
 #include "AudioFormat.hxx"
 #include "Traits.hxx"
@@ -71,20 +72,6 @@ PcmAddVolumeVoid(PcmDither &dither,
 				volume1, volume2);
 }
 
-static void
-pcm_add_vol_float(float *buffer1, const float *buffer2,
-		  unsigned num_samples, float volume1, float volume2)
-{
-	while (num_samples > 0) {
-		float sample1 = *buffer1;
-		float sample2 = *buffer2++;
-
-		sample1 = (sample1 * volume1 + sample2 * volume2);
-		*buffer1++ = sample1;
-		--num_samples;
-	}
-}
-
 static bool
 pcm_add_vol(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 	    int vol1, int vol2,
@@ -121,10 +108,11 @@ pcm_add_vol(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::FLOAT:
-		pcm_add_vol_float((float *)buffer1, (const float *)buffer2,
-				  size / 4,
-				  pcm_volume_to_float(vol1),
-				  pcm_volume_to_float(vol2));
+		GetPcmSimd().add_volume_float((float *)buffer1,
+					      (const float *)buffer2,
+					      size / sizeof(float),
+					      pcm_volume_to_float(vol1),
+					      pcm_volume_to_float(vol2));
 		return true;
 	}
 
@@ -163,17 +151,6 @@ PcmAddVoid(void *a, const void *b, size_t size)
 			  size / sample_size);
 }
 
-static void
-pcm_add_float(float *buffer1, const float *buffer2, unsigned num_samples)
-{
-	while (num_samples > 0) {
-		float sample1 = *buffer1;
-		float sample2 = *buffer2++;
-		*buffer1++ = sample1 + sample2;
-		--num_samples;
-	}
-}
-
 static bool
 pcm_add(void *buffer1, const void *buffer2, size_t size,
 	SampleFormat format)
@@ -189,7 +166,9 @@ pcm_add(void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::S16:
-		PcmAddVoid<SampleFormat::S16>(buffer1, buffer2, size);
+		assert(size % sizeof(int16_t) == 0);
+		GetPcmSimd().add_16((int16_t *)buffer1, (const int16_t *)buffer2,
+				    size / sizeof(int16_t));
 		return true;
 
 	case SampleFormat::S24_P32:
@@ -201,8 +180,8 @@ pcm_add(void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::FLOAT:
-		pcm_add_float((float *)buffer1, (const float *)buffer2,
-			      size / 4);
+		GetPcmSimd().add_float((float *)buffer1, (const float *)buffer2,
+				       size / sizeof(float));
 		return true;
 	}
 
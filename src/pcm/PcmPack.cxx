@@ -18,59 +18,16 @@
  */
 
 #include "PcmPack.hxx"
-#include "system/ByteOrder.hxx"
-
-static void
-pack_sample(uint8_t *dest, const int32_t *src0)
-{
-	const uint8_t *src = (const uint8_t *)src0;
-
-	if (IsBigEndian())
-		++src;
-
-	*dest++ = *src++;
-	*dest++ = *src++;
-	*dest++ = *src++;
-}
+#include "Simd.hxx"
 
 void
 pcm_pack_24(uint8_t *dest, const int32_t *src, const int32_t *src_end)
 {
-	/* duplicate loop to help the compiler's optimizer (constant
-	   parameter to the pack_sample() inline function) */
-
-	while (src < src_end) {
-		pack_sample(dest, src++);
-		dest += 3;
-	}
-}
-
-static void
-unpack_sample(int32_t *dest0, const uint8_t *src)
-{
-	uint8_t *dest = (uint8_t *)dest0;
-
-	if (IsBigEndian())
-		/* extend the sign bit to the most fourth byte */
-		*dest++ = *src & 0x80 ? 0xff : 0x00;
-
-	*dest++ = *src++;
-	*dest++ = *src++;
-	*dest++ = *src;
-
-	if (IsLittleEndian())
-		/* extend the sign bit to the most fourth byte */
-		*dest++ = *src & 0x80 ? 0xff : 0x00;
+	GetPcmSimd().pack_24(dest, src, src_end - src);
 }
 
 void
 pcm_unpack_24(int32_t *dest, const uint8_t *src, const uint8_t *src_end)
 {
-	/* duplicate loop to help the compiler's optimizer (constant
-	   parameter to the unpack_sample() inline function) */
-
-	while (src < src_end) {
-		unpack_sample(dest++, src);
-		src += 3;
-	}
+	GetPcmSimd().unpack_24(dest, src, (src_end - src) / 3);
 }
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PolyphaseResampler.hxx"
+#include "Simd.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+
+/**
+ * The maximum number of filter phases.  Beyond that, the position of
+ * an output frame is rounded to the nearest lower phase.
+ */
+static constexpr unsigned MAX_PHASES = 1024;
+
+static constexpr unsigned MAX_TAPS = 256;
+
+/**
+ * The Kaiser window parameter; 8 gives about 80 dB stopband
+ * attenuation.
+ */
+static constexpr double KAISER_BETA = 8;
+
+/**
+ * The cutoff frequency relative to the lower one of the two Nyquist
+ * frequencies.
+ */
+static constexpr double ROLLOFF = 0.92;
+
+gcc_const
+static unsigned
+Gcd(unsigned a, unsigned b)
+{
+	while (b != 0) {
+		unsigned t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+/**
+ * The modified Bessel function of the first kind, order 0.
+ */
+gcc_const
+static double
+BesselI0(double x)
+{
+	double sum = 1, term = 1;
+	for (unsigned k = 1; term > sum * 1e-12; ++k) {
+		const double y = x / (2 * k);
+		term *= y * y;
+		sum += term;
+	}
+
+	return sum;
+}
+
+gcc_const
+static double
+Sinc(double x)
+{
+	return x == 0
+		? 1
+		: sin(M_PI * x) / (M_PI * x);
+}
+
+/**
+ * Calculate the coefficients of all phases.  Phase p of the output
+ * frame lies p/n_phases after the input frame n_taps/2-1 of the
+ * filter window.
+ *
+ * @param cutoff the cutoff frequency relative to the input Nyquist
+ * frequency
+ */
+static void
+MakeFilter(float *dest, unsigned n_phases, unsigned n_taps, double cutoff)
+{
+	const double half = n_taps / 2.;
+	const double i0_beta = BesselI0(KAISER_BETA);
+
+	for (unsigned p = 0; p < n_phases; ++p) {
+		float *row = dest + p * n_taps;
+		const double offset = half - 1 + double(p) / n_phases;
+
+		double sum = 0;
+		for (unsigned k = 0; k < n_taps; ++k) {
+			const double t = offset - k;
+			const double x = t / half;
+			const double window = x > -1 && x < 1
+				? BesselI0(KAISER_BETA * sqrt(1 - x * x)) / i0_beta
+				: 0;
+			const double h = cutoff * Sinc(cutoff * t) * window;
+			row[k] = h;
+			sum += h;
+		}
+
+		/* unity gain at DC */
+		for (unsigned k = 0; k < n_taps; ++k)
+			row[k] /= sum;
+	}
+}
+
+AudioFormat
+PolyphasePcmResampler::Open(AudioFormat &af, unsigned new_sample_rate,
+			    gcc_unused Error &error)
+{
+	assert(af.IsValid());
+	assert(audio_valid_sample_rate(new_sample_rate));
+
+	channels = af.channels;
+
+	const unsigned g = Gcd(af.sample_rate, new_sample_rate);
+	up = new_sample_rate / g;
+	down = af.sample_rate / g;
+
+	n_phases = std::min(up, MAX_PHASES);
+
+	n_taps = base_taps;
+	if (down > up)
+		/* the filter must be longer for the lower cutoff
+		   frequency */
+		n_taps = std::min((n_taps * down + up - 1) / up, MAX_TAPS);
+
+	/* a multiple of 4 for the SIMD kernels */
+	n_taps = (n_taps + 3) & ~3u;
+
+	coefficients.resize(n_phases * n_taps);
+	MakeFilter(coefficients.data(), n_phases, n_taps,
+		   ROLLOFF * std::min(1., double(up) / down));
+
+	Reset();
+
+	/* this resampler works with floating point samples */
+	af.format = SampleFormat::FLOAT;
+
+	AudioFormat result = af;
+	result.sample_rate = new_sample_rate;
+	return result;
+}
+
+void
+PolyphasePcmResampler::Close()
+{
+	coefficients.clear();
+
+	for (unsigned c = 0; c < channels; ++c)
+		planes[c].clear();
+}
+
+void
+PolyphasePcmResampler::Reset()
+{
+	/* start with silence, so the first output frame is centered
+	   on the first input frame */
+	const size_t delay = n_taps / 2 - 1;
+	for (unsigned c = 0; c < channels; ++c)
+		planes[c].assign(delay, 0.f);
+
+	input_frames = delay;
+	position = 0;
+	phase = 0;
+}
+
+inline void
+PolyphasePcmResampler::Fill(ConstBuffer<float> src)
+{
+	assert(src.size % channels == 0);
+
+	const size_t n = src.size / channels;
+
+	float *dest[MAX_CHANNELS];
+	for (unsigned c = 0; c < channels; ++c) {
+		planes[c].resize(input_frames + n);
+		dest[c] = planes[c].data() + input_frames;
+	}
+
+	GetPcmSimd().deinterleave_float(dest, src.data, n, channels);
+	input_frames += n;
+}
+
+inline void
+PolyphasePcmResampler::Consume()
+{
+	const size_t n = std::min(position, input_frames);
+	for (unsigned c = 0; c < channels; ++c)
+		planes[c].erase(planes[c].begin(), planes[c].begin() + n);
+
+	input_frames -= n;
+	position -= n;
+}
+
+ConstBuffer<void>
+PolyphasePcmResampler::Resample(ConstBuffer<void> src, gcc_unused Error &error)
+{
+	Fill(ConstBuffer<float>::FromVoid(src));
+
+	/* an upper bound of the number of output frames */
+	const size_t max_frames = input_frames > position
+		? size_t(uint64_t(input_frames - position) * up / down) + 1
+		: 0;
+
+	float *const dest = (float *)
+		buffer.Get(max_frames * channels * sizeof(float));
+	float *o = dest;
+
+	const auto dot = GetPcmSimd().dot_float;
+
+	while (position + n_taps <= input_frames) {
+		assert(o < dest + max_frames * channels);
+
+		const size_t p = uint64_t(phase) * n_phases / up;
+		const float *h = &coefficients[p * n_taps];
+
+		for (unsigned c = 0; c < channels; ++c)
+			*o++ = dot(planes[c].data() + position, h, n_taps);
+
+		phase += down;
+		position += phase / up;
+		phase %= up;
+	}
+
+	Consume();
+
+	return { dest, (o - dest) * sizeof(float) };
+}
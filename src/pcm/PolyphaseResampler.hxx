@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_POLYPHASE_RESAMPLER_HXX
+#define MPD_PCM_POLYPHASE_RESAMPLER_HXX
+
+#include "Resampler.hxx"
+#include "PcmBuffer.hxx"
+#include "AudioFormat.hxx"
+#include "Compiler.h"
+
+#include <vector>
+
+#include <stddef.h>
+
+/**
+ * A built-in resampler with a polyphase FIR filter (Kaiser-windowed
+ * sinc).  The conversion ratio is reduced to a fraction L/M; there
+ * is one filter phase for each of the L possible output positions
+ * between two input frames (or a close approximation if L is very
+ * large).  The dot products use the #PcmSimd kernels.
+ */
+class PolyphasePcmResampler final : public PcmResampler {
+	/**
+	 * The number of filter taps per phase when upsampling;
+	 * downsampling needs proportionally more.
+	 */
+	const unsigned base_taps;
+
+	unsigned channels;
+
+	/**
+	 * The reduced conversion ratio: #up output frames for each
+	 * #down input frames.
+	 */
+	unsigned up, down;
+
+	unsigned n_phases, n_taps;
+
+	/**
+	 * The filter: #n_phases rows of #n_taps coefficients.
+	 */
+	std::vector<float> coefficients;
+
+	/**
+	 * Planar input for each channel, beginning with the frames
+	 * which are still needed by the filter.
+	 */
+	std::vector<float> planes[MAX_CHANNELS];
+
+	/**
+	 * The number of frames in each of #planes.
+	 */
+	size_t input_frames;
+
+	/**
+	 * The first input frame of the next output frame's filter
+	 * window; may be beyond #input_frames when downsampling.
+	 */
+	size_t position;
+
+	/**
+	 * The position of the next output frame between two input
+	 * frames in units of 1/#up.
+	 */
+	unsigned phase;
+
+	PcmBuffer buffer;
+
+public:
+	/**
+	 * @param _base_taps the number of filter taps per phase when
+	 * upsampling; this trades quality for CPU usage
+	 */
+	explicit PolyphasePcmResampler(unsigned _base_taps=32)
+		:base_taps(_base_taps) {}
+
+	virtual AudioFormat Open(AudioFormat &af, unsigned new_sample_rate,
+				 Error &error) override;
+	virtual void Close() override;
+	virtual void Reset() override;
+	virtual ConstBuffer<void> Resample(ConstBuffer<void> src,
+					   Error &error) override;
+
+private:
+	void Fill(ConstBuffer<float> src);
+	void Consume();
+};
+
+#endif
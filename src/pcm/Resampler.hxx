@@ -54,6 +54,13 @@ public:
 	 */
 	virtual void Close() = 0;
 
+	/**
+	 * Discard the filter state of the current stream, as if the
+	 * resampler had just been opened with the same parameters.
+	 * This is cheaper than closing and reopening it.
+	 */
+	virtual void Reset() {}
+
 	/**
 	 * Resamples a block of PCM data.
 	 *
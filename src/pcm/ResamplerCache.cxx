@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ResamplerCache.hxx"
+#include "Resampler.hxx"
+
+#include <assert.h>
+
+static void
+DeleteResampler(PcmResampler *resampler)
+{
+	resampler->Close();
+	delete resampler;
+}
+
+PcmResampler *
+PcmResamplerCache::Take(AudioFormat src_format, unsigned new_sample_rate,
+			AudioFormat &requested_format,
+			AudioFormat &dest_format)
+{
+	const ScopeLock protect(mutex);
+
+	for (auto i = items.begin(); i != items.end(); ++i) {
+		if (i->src_format == src_format &&
+		    i->new_sample_rate == new_sample_rate) {
+			requested_format = i->requested_format;
+			dest_format = i->dest_format;
+			PcmResampler *resampler = i->resampler;
+			items.erase(i);
+			return resampler;
+		}
+	}
+
+	return nullptr;
+}
+
+void
+PcmResamplerCache::Put(AudioFormat src_format, unsigned new_sample_rate,
+		       AudioFormat requested_format, AudioFormat dest_format,
+		       PcmResampler *resampler)
+{
+	assert(resampler != nullptr);
+
+	/* discard the state of the previous stream now, so Take()
+	   does not need to */
+	resampler->Reset();
+
+	PcmResampler *evicted = nullptr;
+
+	mutex.lock();
+	items.push_front({src_format, new_sample_rate,
+			  requested_format, dest_format,
+			  resampler});
+	if (items.size() > max_size) {
+		evicted = items.back().resampler;
+		items.pop_back();
+	}
+	mutex.unlock();
+
+	if (evicted != nullptr)
+		DeleteResampler(evicted);
+}
+
+void
+PcmResamplerCache::Clear()
+{
+	mutex.lock();
+	std::list<Item> old;
+	old.swap(items);
+	mutex.unlock();
+
+	for (const auto &i : old)
+		DeleteResampler(i.resampler);
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_RESAMPLER_CACHE_HXX
+#define MPD_PCM_RESAMPLER_CACHE_HXX
+
+#include "check.h"
+#include "AudioFormat.hxx"
+#include "thread/Mutex.hxx"
+
+#include <list>
+
+class PcmResampler;
+
+/**
+ * A small pool of open #PcmResampler instances which are not in use.
+ * Opening a resampler may be expensive (e.g. soxr calculates its
+ * filter tables), and the filter chain of an audio output is often
+ * reopened with the same audio format at a song boundary.  Instead
+ * of closing the resampler, it is reset and kept here, and the next
+ * Open() with the same parameters takes it back.
+ *
+ * The resampler configuration is global, so the source format and
+ * the output sample rate are a sufficient key.
+ *
+ * This class is thread-safe.
+ */
+class PcmResamplerCache {
+	struct Item {
+		AudioFormat src_format;
+		unsigned new_sample_rate;
+
+		/**
+		 * The formats which were returned by
+		 * PcmResampler::Open().
+		 */
+		AudioFormat requested_format, dest_format;
+
+		PcmResampler *resampler;
+	};
+
+	Mutex mutex;
+
+	/**
+	 * The idle resamplers; the most recently used one is at the
+	 * front.
+	 */
+	std::list<Item> items;
+
+	const unsigned max_size;
+
+public:
+	explicit PcmResamplerCache(unsigned _max_size)
+		:max_size(_max_size) {}
+
+	~PcmResamplerCache() {
+		Clear();
+	}
+
+	PcmResamplerCache(const PcmResamplerCache &) = delete;
+	PcmResamplerCache &operator=(const PcmResamplerCache &) = delete;
+
+	/**
+	 * Take an open resampler matching the given parameters out of
+	 * the cache.
+	 *
+	 * @param requested_format receives the input format the
+	 * resampler requested in PcmResampler::Open()
+	 * @param dest_format receives the output format
+	 * @return the resampler (owned by the caller now) or nullptr
+	 * if there is none
+	 */
+	PcmResampler *Take(AudioFormat src_format, unsigned new_sample_rate,
+			   AudioFormat &requested_format,
+			   AudioFormat &dest_format);
+
+	/**
+	 * Return an open resampler which is not needed anymore.  It
+	 * is reset; if the cache is full, the least recently used one
+	 * is closed and deleted.
+	 */
+	void Put(AudioFormat src_format, unsigned new_sample_rate,
+		 AudioFormat requested_format, AudioFormat dest_format,
+		 PcmResampler *resampler);
+
+	/**
+	 * Close and delete all cached resamplers.
+	 */
+	void Clear();
+};
+
+#endif
@@ -0,0 +1,2273 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Simd.hxx"
+#include "Traits.hxx"
+#include "PcmUtils.hxx"
+#include "FloatConvert.hxx"
+#include "system/ByteOrder.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include <assert.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_PCM_SSE2
+#endif
+
+#if CLANG_OR_GCC_VERSION(4,9)
+/* the "target" attribute allows SSSE3 and AVX2 code in this object
+   even though the compiler was not invoked with -mssse3 or -mavx2;
+   it is only called if the CPU supports it */
+#include <immintrin.h>
+#define HAVE_PCM_SSSE3
+#define PCM_SSSE3 __attribute__((target("ssse3")))
+#define HAVE_PCM_AVX2
+#define PCM_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include "Neon.hxx"
+#define HAVE_PCM_NEON
+#endif
+
+static void
+portable_volume_float(float *dest,
+		      const float *src, size_t n,
+		      float volume)
+{
+	for (size_t i = 0; i != n; ++i)
+		dest[i] = src[i] * volume;
+}
+
+static void
+portable_add_volume_float(float *gcc_restrict a,
+			  const float *gcc_restrict b, size_t n,
+			  float volume1, float volume2)
+{
+	for (size_t i = 0; i != n; ++i)
+		a[i] = a[i] * volume1 + b[i] * volume2;
+}
+
+static void
+portable_add_float(float *gcc_restrict a,
+		   const float *gcc_restrict b, size_t n)
+{
+	for (size_t i = 0; i != n; ++i)
+		a[i] += b[i];
+}
+
+static void
+portable_add_16(int16_t *gcc_restrict a,
+		const int16_t *gcc_restrict b, size_t n)
+{
+	typedef SampleTraits<SampleFormat::S16> Traits;
+
+	for (size_t i = 0; i != n; ++i)
+		a[i] = PcmClamp<SampleFormat::S16>(Traits::sum_type(a[i]) +
+						   Traits::sum_type(b[i]));
+}
+
+typedef FloatToIntegerSampleConvert<SampleFormat::S16> FloatTo16;
+typedef FloatToIntegerSampleConvert<SampleFormat::S24_P32> FloatTo24;
+typedef FloatToIntegerSampleConvert<SampleFormat::S32> FloatTo32;
+typedef IntegerToFloatSampleConvert<SampleFormat::S16> S16ToFloat;
+typedef IntegerToFloatSampleConvert<SampleFormat::S24_P32> S24ToFloat;
+typedef IntegerToFloatSampleConvert<SampleFormat::S32> S32ToFloat;
+
+template<class C>
+static void
+PortableConvert(typename C::DstTraits::pointer_type gcc_restrict dest,
+		typename C::SrcTraits::const_pointer_type gcc_restrict src,
+		size_t n)
+{
+	for (size_t i = 0; i != n; ++i)
+		dest[i] = C::Convert(src[i]);
+}
+
+static void
+portable_dsd2pcm(float *gcc_restrict dest,
+		 const uint8_t *fwd, const uint8_t *rev, size_t n,
+		 const float *ctables)
+{
+	for (size_t i = 0; i < n; ++i) {
+		float acc = 0;
+		for (unsigned k = 0; k < 6; ++k)
+			acc += ctables[k * 256 + fwd[11 + i - k]] +
+				ctables[k * 256 + rev[i + k]];
+		dest[i] = acc;
+	}
+}
+
+/**
+ * Each 24 bit DoP sample has 16 DSD sample bits plus the magic 0x05
+ * or 0xfa marker.
+ */
+static constexpr uint32_t DOP_MARKER1 = 0xff050000;
+static constexpr uint32_t DOP_MARKER2 = 0xfffa0000;
+
+static void
+portable_dsd_to_dop(uint32_t *gcc_restrict dest,
+		    const uint8_t *gcc_restrict src, size_t n,
+		    unsigned channels)
+{
+	for (; n > 0; --n) {
+		for (unsigned c = 0; c < channels; ++c)
+			*dest++ = DOP_MARKER1 | (src[c] << 8) |
+				src[channels + c];
+
+		src += 2 * channels;
+
+		for (unsigned c = 0; c < channels; ++c)
+			*dest++ = DOP_MARKER2 | (src[c] << 8) |
+				src[channels + c];
+
+		src += 2 * channels;
+	}
+}
+
+static void
+portable_deinterleave_float(float *const*dest,
+			    const float *gcc_restrict src, size_t n,
+			    unsigned channels)
+{
+	for (unsigned c = 0; c < channels; ++c) {
+		float *gcc_restrict d = dest[c];
+		const float *s = src + c;
+		for (size_t i = 0; i < n; ++i, s += channels)
+			d[i] = *s;
+	}
+}
+
+static float
+portable_dot_float(const float *a, const float *b, size_t n)
+{
+	float sum = 0;
+	for (size_t i = 0; i != n; ++i)
+		sum += a[i] * b[i];
+	return sum;
+}
+
+static void
+portable_complex_mac_float(float *gcc_restrict acc_re,
+			   float *gcc_restrict acc_im,
+			   const float *a_re, const float *a_im,
+			   const float *b_re, const float *b_im,
+			   size_t n)
+{
+	for (size_t i = 0; i != n; ++i) {
+		acc_re[i] += a_re[i] * b_re[i] - a_im[i] * b_im[i];
+		acc_im[i] += a_re[i] * b_im[i] + a_im[i] * b_re[i];
+	}
+}
+
+static void
+portable_biquad_float(float *data, size_t n, unsigned channels,
+		      const float *coefficients, float *state)
+{
+	const float b0 = coefficients[0], b1 = coefficients[1];
+	const float b2 = coefficients[2], a1 = coefficients[3];
+	const float a2 = coefficients[4];
+	float *z1 = state, *z2 = state + channels;
+
+	for (unsigned c = 0; c < channels; ++c) {
+		float s1 = z1[c], s2 = z2[c];
+		float *p = data + c;
+
+		for (size_t i = 0; i != n; ++i, p += channels) {
+			const float x = *p;
+			const float y = b0 * x + s1;
+			s1 = b1 * x - a1 * y + s2;
+			s2 = b2 * x - a2 * y;
+			*p = y;
+		}
+
+		z1[c] = s1;
+		z2[c] = s2;
+	}
+}
+
+static void
+portable_biquad_32(int32_t *data, size_t n, unsigned channels,
+		   const int32_t *coefficients, int32_t *state)
+{
+	const int64_t b0 = coefficients[0], b1 = coefficients[1];
+	const int64_t b2 = coefficients[2], a1 = coefficients[3];
+	const int64_t a2 = coefficients[4];
+	int32_t *x1 = state, *x2 = x1 + channels;
+	int32_t *y1 = x2 + channels, *y2 = y1 + channels;
+
+	for (unsigned c = 0; c < channels; ++c) {
+		int64_t sx1 = x1[c], sx2 = x2[c], sy1 = y1[c], sy2 = y2[c];
+		int32_t *p = data + c;
+
+		for (size_t i = 0; i != n; ++i, p += channels) {
+			const int64_t x = *p;
+			const int64_t acc = b0 * x + b1 * sx1 + b2 * sx2
+				- a1 * sy1 - a2 * sy2
+				+ (int64_t(1) << (PCM_BIQUAD_BITS - 1));
+			const int32_t y =
+				PcmClamp<SampleFormat::S32>(acc >> PCM_BIQUAD_BITS);
+
+			sx2 = sx1;
+			sx1 = x;
+			sy2 = sy1;
+			sy1 = y;
+			*p = y;
+		}
+
+		x1[c] = sx1;
+		x2[c] = sx2;
+		y1[c] = sy1;
+		y2[c] = sy2;
+	}
+}
+
+template<typename T>
+static void
+portable_mono_to_stereo(T *gcc_restrict dest, const T *gcc_restrict src,
+			size_t n)
+{
+	for (size_t i = 0; i != n; ++i) {
+		*dest++ = src[i];
+		*dest++ = src[i];
+	}
+}
+
+static void
+portable_stereo_to_mono_16(int16_t *gcc_restrict dest,
+			   const int16_t *gcc_restrict src, size_t n)
+{
+	for (size_t i = 0; i != n; ++i, src += 2)
+		dest[i] = int16_t((int(src[0]) + int(src[1])) / 2);
+}
+
+static void
+portable_stereo_to_mono_float(float *gcc_restrict dest,
+			      const float *gcc_restrict src, size_t n)
+{
+	for (size_t i = 0; i != n; ++i, src += 2)
+		dest[i] = (src[0] + src[1]) / 2;
+}
+
+static void
+portable_route_32(uint32_t *gcc_restrict dest,
+		  const uint32_t *gcc_restrict src, size_t n,
+		  unsigned src_channels, unsigned dest_channels,
+		  const int8_t *map)
+{
+	for (size_t i = 0; i != n; ++i, src += src_channels)
+		for (unsigned c = 0; c < dest_channels; ++c)
+			*dest++ = map[c] >= 0 ? src[map[c]] : 0;
+}
+
+static unsigned
+portable_peak_16(const int16_t *src, size_t n)
+{
+	int peak = 0;
+	for (size_t i = 0; i != n; ++i)
+		peak = std::max(peak, src[i] ^ (src[i] >> 15));
+	return peak;
+}
+
+static uint32_t
+portable_peak_32(const int32_t *src, size_t n)
+{
+	int32_t peak = 0;
+	for (size_t i = 0; i != n; ++i)
+		peak = std::max(peak, src[i] ^ (src[i] >> 31));
+	return peak;
+}
+
+static float
+portable_peak_float(const float *src, size_t n)
+{
+	float peak = 0;
+	for (size_t i = 0; i != n; ++i)
+		peak = std::max(peak, std::fabs(src[i]));
+	return peak;
+}
+
+static void
+portable_gain_16(int16_t *dest, const int16_t *src, size_t n, int gain)
+{
+	for (size_t i = 0; i != n; ++i) {
+		const int x = (src[i] * gain) >> 10;
+		dest[i] = int16_t(std::min(std::max(x, -32768), 32767));
+	}
+}
+
+static void
+portable_pack_24(uint8_t *dest, const int32_t *src, size_t n)
+{
+	for (size_t i = 0; i != n; ++i) {
+		const uint8_t *p = (const uint8_t *)&src[i];
+		if (IsBigEndian())
+			++p;
+
+		*dest++ = p[0];
+		*dest++ = p[1];
+		*dest++ = p[2];
+	}
+}
+
+static void
+portable_unpack_24(int32_t *gcc_restrict dest,
+		   const uint8_t *gcc_restrict src, size_t n)
+{
+	for (size_t i = 0; i != n; ++i, src += 3) {
+		int32_t x = IsBigEndian()
+			? (src[0] << 16) | (src[1] << 8) | src[2]
+			: (src[2] << 16) | (src[1] << 8) | src[0];
+
+		/* extend the sign bit to the most significant byte */
+		if (x & 0x800000)
+			x |= ~0xffffff;
+
+		dest[i] = x;
+	}
+}
+
+const PcmSimd pcm_simd_portable = {
+	"portable",
+	portable_volume_float,
+	portable_add_volume_float,
+	portable_add_float,
+	portable_add_16,
+	PortableConvert<FloatTo16>,
+	PortableConvert<FloatTo24>,
+	PortableConvert<FloatTo32>,
+	PortableConvert<S16ToFloat>,
+	PortableConvert<S24ToFloat>,
+	PortableConvert<S32ToFloat>,
+	portable_dsd2pcm,
+	portable_dsd_to_dop,
+	portable_deinterleave_float,
+	portable_dot_float,
+	portable_complex_mac_float,
+	portable_biquad_float,
+	portable_biquad_32,
+	portable_mono_to_stereo<int16_t>,
+	portable_mono_to_stereo<uint32_t>,
+	portable_stereo_to_mono_16,
+	portable_stereo_to_mono_float,
+	portable_route_32,
+	portable_peak_16,
+	portable_peak_32,
+	portable_peak_float,
+	portable_gain_16,
+	portable_pack_24,
+	portable_unpack_24,
+};
+
+#ifdef HAVE_PCM_SSE2
+
+static void
+sse2_volume_float(float *dest,
+		  const float *src, size_t n,
+		  float volume)
+{
+	const __m128 v = _mm_set1_ps(volume);
+
+	for (; n >= 4; n -= 4, src += 4, dest += 4)
+		_mm_storeu_ps(dest, _mm_mul_ps(_mm_loadu_ps(src), v));
+
+	portable_volume_float(dest, src, n, volume);
+}
+
+static void
+sse2_add_volume_float(float *gcc_restrict a,
+		      const float *gcc_restrict b, size_t n,
+		      float volume1, float volume2)
+{
+	const __m128 v1 = _mm_set1_ps(volume1), v2 = _mm_set1_ps(volume2);
+
+	for (; n >= 4; n -= 4, a += 4, b += 4)
+		_mm_storeu_ps(a, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a), v1),
+					    _mm_mul_ps(_mm_loadu_ps(b), v2)));
+
+	portable_add_volume_float(a, b, n, volume1, volume2);
+}
+
+static void
+sse2_add_float(float *gcc_restrict a, const float *gcc_restrict b, size_t n)
+{
+	for (; n >= 4; n -= 4, a += 4, b += 4)
+		_mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a),
+					    _mm_loadu_ps(b)));
+
+	portable_add_float(a, b, n);
+}
+
+static void
+sse2_add_16(int16_t *gcc_restrict a, const int16_t *gcc_restrict b, size_t n)
+{
+	for (; n >= 8; n -= 8, a += 8, b += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)a);
+		const __m128i y = _mm_loadu_si128((const __m128i *)b);
+		_mm_storeu_si128((__m128i *)a, _mm_adds_epi16(x, y));
+	}
+
+	portable_add_16(a, b, n);
+}
+
+/**
+ * Scale and clamp float samples, and convert them to 32 bit integers
+ * with truncation, just like FloatToIntegerSampleConvert does.  The
+ * bounds must be exactly representable as float.
+ */
+static inline __m128i
+sse2_float_to_int(__m128 x, __m128 factor, __m128 min, __m128 max)
+{
+	return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(x, factor),
+						      min),
+					   max));
+}
+
+static void
+sse2_float_to_16(int16_t *gcc_restrict dest,
+		 const float *gcc_restrict src, size_t n)
+{
+	const __m128 factor = _mm_set1_ps(FloatTo16::factor);
+	const __m128 min = _mm_set1_ps(FloatTo16::DstTraits::MIN);
+	const __m128 max = _mm_set1_ps(FloatTo16::DstTraits::MAX);
+
+	for (; n >= 8; n -= 8, src += 8, dest += 8) {
+		const __m128i a = sse2_float_to_int(_mm_loadu_ps(src),
+						    factor, min, max);
+		const __m128i b = sse2_float_to_int(_mm_loadu_ps(src + 4),
+						    factor, min, max);
+		_mm_storeu_si128((__m128i *)dest, _mm_packs_epi32(a, b));
+	}
+
+	PortableConvert<FloatTo16>(dest, src, n);
+}
+
+static void
+sse2_float_to_24(int32_t *gcc_restrict dest,
+		 const float *gcc_restrict src, size_t n)
+{
+	const __m128 factor = _mm_set1_ps(FloatTo24::factor);
+	const __m128 min = _mm_set1_ps(FloatTo24::DstTraits::MIN);
+	const __m128 max = _mm_set1_ps(FloatTo24::DstTraits::MAX);
+
+	for (; n >= 4; n -= 4, src += 4, dest += 4)
+		_mm_storeu_si128((__m128i *)dest,
+				 sse2_float_to_int(_mm_loadu_ps(src),
+						   factor, min, max));
+
+	PortableConvert<FloatTo24>(dest, src, n);
+}
+
+static void
+sse2_float_to_32(int32_t *gcc_restrict dest,
+		 const float *gcc_restrict src, size_t n)
+{
+	/* the upper bound is not representable as float; values
+	   which overflow are converted to 0x80000000 by cvttps, and
+	   XORing the comparison mask turns that into 0x7fffffff */
+	const __m128 factor = _mm_set1_ps(FloatTo32::factor);
+	const __m128 min = _mm_set1_ps(FloatTo32::DstTraits::MIN);
+	const __m128 limit = _mm_set1_ps(2147483648.f);
+
+	for (; n >= 4; n -= 4, src += 4, dest += 4) {
+		const __m128 x = _mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src),
+						       factor),
+					    min);
+		const __m128i overflow =
+			_mm_castps_si128(_mm_cmpge_ps(x, limit));
+		_mm_storeu_si128((__m128i *)dest,
+				 _mm_xor_si128(_mm_cvttps_epi32(x), overflow));
+	}
+
+	PortableConvert<FloatTo32>(dest, src, n);
+}
+
+static void
+sse2_s16_to_float(float *gcc_restrict dest,
+		  const int16_t *gcc_restrict src, size_t n)
+{
+	const __m128 factor = _mm_set1_ps(S16ToFloat::factor);
+
+	for (; n >= 8; n -= 8, src += 8, dest += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+
+		/* sign-extend to 32 bit */
+		const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+
+		_mm_storeu_ps(dest,
+			      _mm_mul_ps(_mm_cvtepi32_ps(lo), factor));
+		_mm_storeu_ps(dest + 4,
+			      _mm_mul_ps(_mm_cvtepi32_ps(hi), factor));
+	}
+
+	PortableConvert<S16ToFloat>(dest, src, n);
+}
+
+template<class C>
+static void
+sse2_s32_to_float(float *gcc_restrict dest,
+		  const int32_t *gcc_restrict src, size_t n)
+{
+	const __m128 factor = _mm_set1_ps(C::factor);
+
+	for (; n >= 4; n -= 4, src += 4, dest += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_ps(dest, _mm_mul_ps(_mm_cvtepi32_ps(x), factor));
+	}
+
+	PortableConvert<C>(dest, src, n);
+}
+
+/**
+ * Stereo only: 16 DSD bytes (two blocks) per iteration.
+ */
+static void
+sse2_dsd_to_dop(uint32_t *gcc_restrict dest,
+		const uint8_t *gcc_restrict src, size_t n,
+		unsigned channels)
+{
+	if (channels == 2) {
+		const __m128i marker =
+			_mm_setr_epi16(int16_t(0xff05), int16_t(0xff05),
+				       int16_t(0xfffa), int16_t(0xfffa),
+				       int16_t(0xff05), int16_t(0xff05),
+				       int16_t(0xfffa), int16_t(0xfffa));
+
+		for (; n >= 2; n -= 2, src += 16, dest += 8) {
+			/* 16 bit words: (L0 R0) (L1 R1) (L2 R2) ... */
+			const __m128i x =
+				_mm_loadu_si128((const __m128i *)src);
+
+			/* separate even and odd words */
+			const __m128i low = _mm_slli_epi32(x, 16);
+			const __m128i even =
+				_mm_packs_epi32(_mm_srai_epi32(low, 16),
+						_mm_setzero_si128());
+			const __m128i odd =
+				_mm_packs_epi32(_mm_srai_epi32(x, 16),
+						_mm_setzero_si128());
+
+			/* (L1 L0) (R1 R0) (L3 L2) ...; the first
+			   byte goes to bits 8..15 */
+			const __m128i pairs = _mm_unpacklo_epi8(odd, even);
+
+			_mm_storeu_si128((__m128i *)dest,
+					 _mm_unpacklo_epi16(pairs, marker));
+			_mm_storeu_si128((__m128i *)(dest + 4),
+					 _mm_unpackhi_epi16(pairs, marker));
+		}
+	}
+
+	portable_dsd_to_dop(dest, src, n, channels);
+}
+
+/**
+ * Stereo only: 4 frames per iteration.
+ */
+static void
+sse2_deinterleave_float(float *const*dest,
+			const float *gcc_restrict src, size_t n,
+			unsigned channels)
+{
+	if (channels == 2) {
+		float *gcc_restrict left = dest[0], *gcc_restrict right = dest[1];
+
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4, src += 8) {
+			const __m128 a = _mm_loadu_ps(src);
+			const __m128 b = _mm_loadu_ps(src + 4);
+			_mm_storeu_ps(left + i,
+				      _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(right + i,
+				      _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+
+		float *const tail[2] = { left + i, right + i };
+		portable_deinterleave_float(tail, src, n - i, channels);
+		return;
+	}
+
+	portable_deinterleave_float(dest, src, n, channels);
+}
+
+static float
+sse2_dot_float(const float *a, const float *b, size_t n)
+{
+	__m128 acc = _mm_setzero_ps();
+	for (; n >= 4; n -= 4, a += 4, b += 4)
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a),
+						 _mm_loadu_ps(b)));
+
+	/* horizontal sum */
+	acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+	acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+
+	return _mm_cvtss_f32(acc) + portable_dot_float(a, b, n);
+}
+
+static void
+sse2_complex_mac_float(float *gcc_restrict acc_re, float *gcc_restrict acc_im,
+		       const float *a_re, const float *a_im,
+		       const float *b_re, const float *b_im,
+		       size_t n)
+{
+	for (; n >= 4; n -= 4, acc_re += 4, acc_im += 4,
+		     a_re += 4, a_im += 4, b_re += 4, b_im += 4) {
+		const __m128 ar = _mm_loadu_ps(a_re), ai = _mm_loadu_ps(a_im);
+		const __m128 br = _mm_loadu_ps(b_re), bi = _mm_loadu_ps(b_im);
+
+		__m128 re = _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi));
+		__m128 im = _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br));
+		_mm_storeu_ps(acc_re, _mm_add_ps(_mm_loadu_ps(acc_re), re));
+		_mm_storeu_ps(acc_im, _mm_add_ps(_mm_loadu_ps(acc_im), im));
+	}
+
+	portable_complex_mac_float(acc_re, acc_im, a_re, a_im, b_re, b_im, n);
+}
+
+/**
+ * Load the first #k (1 to 4) floats into a vector.
+ */
+template<unsigned k>
+static inline __m128
+sse2_load_partial(const float *p)
+{
+	switch (k) {
+	case 1:
+		return _mm_load_ss(p);
+
+	case 2:
+		return _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)p);
+
+	case 3:
+		return _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(),
+						  (const __m64 *)p),
+				     _mm_load_ss(p + 2));
+
+	default:
+		return _mm_loadu_ps(p);
+	}
+}
+
+/**
+ * Store the first #k (1 to 4) floats of a vector.
+ */
+template<unsigned k>
+static inline void
+sse2_store_partial(float *p, __m128 v)
+{
+	switch (k) {
+	case 1:
+		_mm_store_ss(p, v);
+		break;
+
+	case 2:
+		_mm_storel_pi((__m64 *)p, v);
+		break;
+
+	case 3:
+		_mm_storel_pi((__m64 *)p, v);
+		_mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+		break;
+
+	default:
+		_mm_storeu_ps(p, v);
+	}
+}
+
+/**
+ * Filter #k adjacent channels in the lanes of one vector.
+ */
+template<unsigned k>
+static void
+sse2_biquad_float_lanes(float *data, size_t n, unsigned channels,
+			const float *coefficients, float *z1, float *z2)
+{
+	const __m128 b0 = _mm_set1_ps(coefficients[0]);
+	const __m128 b1 = _mm_set1_ps(coefficients[1]);
+	const __m128 b2 = _mm_set1_ps(coefficients[2]);
+	const __m128 a1 = _mm_set1_ps(coefficients[3]);
+	const __m128 a2 = _mm_set1_ps(coefficients[4]);
+
+	__m128 s1 = sse2_load_partial<k>(z1), s2 = sse2_load_partial<k>(z2);
+
+	for (size_t i = 0; i != n; ++i, data += channels) {
+		const __m128 x = sse2_load_partial<k>(data);
+		const __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), s1);
+		s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x),
+					   _mm_mul_ps(a1, y)), s2);
+		s2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+		sse2_store_partial<k>(data, y);
+	}
+
+	sse2_store_partial<k>(z1, s1);
+	sse2_store_partial<k>(z2, s2);
+}
+
+static void
+sse2_biquad_float(float *data, size_t n, unsigned channels,
+		  const float *coefficients, float *state)
+{
+	float *z1 = state, *z2 = state + channels;
+
+	unsigned c = 0;
+	for (; c + 4 <= channels; c += 4)
+		sse2_biquad_float_lanes<4>(data + c, n, channels,
+					   coefficients, z1 + c, z2 + c);
+
+	switch (channels - c) {
+	case 1:
+		sse2_biquad_float_lanes<1>(data + c, n, channels,
+					   coefficients, z1 + c, z2 + c);
+		break;
+
+	case 2:
+		sse2_biquad_float_lanes<2>(data + c, n, channels,
+					   coefficients, z1 + c, z2 + c);
+		break;
+
+	case 3:
+		sse2_biquad_float_lanes<3>(data + c, n, channels,
+					   coefficients, z1 + c, z2 + c);
+		break;
+	}
+}
+
+static void
+sse2_mono_to_stereo_16(int16_t *gcc_restrict dest,
+		       const int16_t *gcc_restrict src, size_t n)
+{
+	for (; n >= 8; n -= 8, src += 8, dest += 16) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_si128((__m128i *)dest, _mm_unpacklo_epi16(x, x));
+		_mm_storeu_si128((__m128i *)(dest + 8),
+				 _mm_unpackhi_epi16(x, x));
+	}
+
+	portable_mono_to_stereo(dest, src, n);
+}
+
+static void
+sse2_mono_to_stereo_32(uint32_t *gcc_restrict dest,
+		       const uint32_t *gcc_restrict src, size_t n)
+{
+	for (; n >= 4; n -= 4, src += 4, dest += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_si128((__m128i *)dest, _mm_unpacklo_epi32(x, x));
+		_mm_storeu_si128((__m128i *)(dest + 4),
+				 _mm_unpackhi_epi32(x, x));
+	}
+
+	portable_mono_to_stereo(dest, src, n);
+}
+
+/**
+ * Divide signed 32 bit integers by two, rounding towards zero.
+ */
+static inline __m128i
+sse2_half_epi32(__m128i x)
+{
+	return _mm_srai_epi32(_mm_add_epi32(x, _mm_srli_epi32(x, 31)), 1);
+}
+
+static void
+sse2_stereo_to_mono_16(int16_t *gcc_restrict dest,
+		       const int16_t *gcc_restrict src, size_t n)
+{
+	const __m128i one = _mm_set1_epi16(1);
+
+	for (; n >= 8; n -= 8, src += 16, dest += 8) {
+		/* _mm_madd_epi16() adds the two samples of each
+		   frame as 32 bit integers */
+		const __m128i a =
+			_mm_madd_epi16(_mm_loadu_si128((const __m128i *)src),
+				       one);
+		const __m128i b =
+			_mm_madd_epi16(_mm_loadu_si128((const __m128i *)(src + 8)),
+				       one);
+		_mm_storeu_si128((__m128i *)dest,
+				 _mm_packs_epi32(sse2_half_epi32(a),
+						 sse2_half_epi32(b)));
+	}
+
+	portable_stereo_to_mono_16(dest, src, n);
+}
+
+static void
+sse2_stereo_to_mono_float(float *gcc_restrict dest,
+			  const float *gcc_restrict src, size_t n)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+
+	for (; n >= 4; n -= 4, src += 8, dest += 4) {
+		const __m128 a = _mm_loadu_ps(src);
+		const __m128 b = _mm_loadu_ps(src + 4);
+		const __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		const __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+		_mm_storeu_ps(dest, _mm_mul_ps(_mm_add_ps(left, right), half));
+	}
+
+	portable_stereo_to_mono_float(dest, src, n);
+}
+
+static unsigned
+sse2_peak_16(const int16_t *src, size_t n)
+{
+	__m128i acc = _mm_setzero_si128();
+	for (; n >= 8; n -= 8, src += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+		acc = _mm_max_epi16(acc,
+				    _mm_xor_si128(x, _mm_srai_epi16(x, 15)));
+	}
+
+	int16_t lanes[8];
+	_mm_storeu_si128((__m128i *)lanes, acc);
+	return std::max(portable_peak_16(lanes, 8),
+			portable_peak_16(src, n));
+}
+
+static uint32_t
+sse2_peak_32(const int32_t *src, size_t n)
+{
+	__m128i acc = _mm_setzero_si128();
+	for (; n >= 4; n -= 4, src += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)src);
+		x = _mm_xor_si128(x, _mm_srai_epi32(x, 31));
+
+		/* SSE2 has no _mm_max_epi32() */
+		const __m128i greater = _mm_cmpgt_epi32(x, acc);
+		acc = _mm_or_si128(_mm_and_si128(greater, x),
+				   _mm_andnot_si128(greater, acc));
+	}
+
+	int32_t lanes[4];
+	_mm_storeu_si128((__m128i *)lanes, acc);
+	return std::max(portable_peak_32(lanes, 4),
+			portable_peak_32(src, n));
+}
+
+static float
+sse2_peak_float(const float *src, size_t n)
+{
+	const __m128 sign = _mm_set1_ps(-0.0f);
+
+	__m128 acc = _mm_setzero_ps();
+	for (; n >= 4; n -= 4, src += 4)
+		acc = _mm_max_ps(acc, _mm_andnot_ps(sign, _mm_loadu_ps(src)));
+
+	acc = _mm_max_ps(acc, _mm_movehl_ps(acc, acc));
+	acc = _mm_max_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+
+	return std::max(_mm_cvtss_f32(acc), portable_peak_float(src, n));
+}
+
+static void
+sse2_gain_16(int16_t *dest, const int16_t *src, size_t n, int gain)
+{
+	const __m128i g = _mm_set1_epi16(gain);
+
+	for (; n >= 8; n -= 8, src += 8, dest += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+
+		/* 32 bit products from the low and high halves */
+		const __m128i lo = _mm_mullo_epi16(x, g);
+		const __m128i hi = _mm_mulhi_epi16(x, g);
+		const __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 10);
+		const __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 10);
+
+		/* _mm_packs_epi32() clamps */
+		_mm_storeu_si128((__m128i *)dest, _mm_packs_epi32(a, b));
+	}
+
+	portable_gain_16(dest, src, n, gain);
+}
+
+static constexpr PcmSimd pcm_simd_sse2 = {
+	"sse2",
+	sse2_volume_float,
+	sse2_add_volume_float,
+	sse2_add_float,
+	sse2_add_16,
+	sse2_float_to_16,
+	sse2_float_to_24,
+	sse2_float_to_32,
+	sse2_s16_to_float,
+	sse2_s32_to_float<S24ToFloat>,
+	sse2_s32_to_float<S32ToFloat>,
+	portable_dsd2pcm,
+	sse2_dsd_to_dop,
+	sse2_deinterleave_float,
+	sse2_dot_float,
+	sse2_complex_mac_float,
+	sse2_biquad_float,
+	portable_biquad_32,
+	sse2_mono_to_stereo_16,
+	sse2_mono_to_stereo_32,
+	sse2_stereo_to_mono_16,
+	sse2_stereo_to_mono_float,
+	portable_route_32,
+	sse2_peak_16,
+	sse2_peak_32,
+	sse2_peak_float,
+	sse2_gain_16,
+	portable_pack_24,
+	portable_unpack_24,
+};
+
+#endif
+
+#ifdef HAVE_PCM_SSSE3
+
+/*
+ * The 24 bit kernels use "pshufb" to move the three significant bytes
+ * of each sample; x86 is always little-endian.
+ */
+
+PCM_SSSE3
+static void
+ssse3_pack_24(uint8_t *dest, const int32_t *src, size_t n)
+{
+	const __m128i mask = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10,
+					   12, 13, 14, -1, -1, -1, -1);
+
+	/* 16 samples become 48 bytes, i.e. three full vectors */
+	for (; n >= 16; n -= 16, src += 16, dest += 48) {
+		const __m128i *s = (const __m128i *)src;
+		const __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(s), mask);
+		const __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(s + 1), mask);
+		const __m128i c = _mm_shuffle_epi8(_mm_loadu_si128(s + 2), mask);
+		const __m128i d = _mm_shuffle_epi8(_mm_loadu_si128(s + 3), mask);
+
+		__m128i *o = (__m128i *)dest;
+		_mm_storeu_si128(o, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+		_mm_storeu_si128(o + 1, _mm_or_si128(_mm_srli_si128(b, 4),
+						     _mm_slli_si128(c, 8)));
+		_mm_storeu_si128(o + 2, _mm_or_si128(_mm_srli_si128(c, 8),
+						     _mm_slli_si128(d, 4)));
+	}
+
+	portable_pack_24(dest, src, n);
+}
+
+/**
+ * Move the 4 packed samples in the lower 12 bytes to the upper three
+ * bytes of each 32 bit lane and shift them back, which extends the
+ * sign bit.
+ */
+PCM_SSSE3
+static inline __m128i
+ssse3_unpack_24_4(__m128i x)
+{
+	const __m128i mask = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+					   -1, 6, 7, 8, -1, 9, 10, 11);
+	return _mm_srai_epi32(_mm_shuffle_epi8(x, mask), 8);
+}
+
+PCM_SSSE3
+static void
+ssse3_unpack_24(int32_t *gcc_restrict dest,
+		const uint8_t *gcc_restrict src, size_t n)
+{
+	for (; n >= 16; n -= 16, src += 48, dest += 16) {
+		const __m128i *s = (const __m128i *)src;
+		const __m128i a = _mm_loadu_si128(s);
+		const __m128i b = _mm_loadu_si128(s + 1);
+		const __m128i c = _mm_loadu_si128(s + 2);
+
+		__m128i *o = (__m128i *)dest;
+		_mm_storeu_si128(o, ssse3_unpack_24_4(a));
+		_mm_storeu_si128(o + 1,
+				 ssse3_unpack_24_4(_mm_alignr_epi8(b, a, 12)));
+		_mm_storeu_si128(o + 2,
+				 ssse3_unpack_24_4(_mm_alignr_epi8(c, b, 8)));
+		_mm_storeu_si128(o + 3,
+				 ssse3_unpack_24_4(_mm_srli_si128(c, 4)));
+	}
+
+	portable_unpack_24(dest, src, n);
+}
+
+#ifdef HAVE_PCM_SSE2
+
+/**
+ * The SSE2 kernels plus those which need SSSE3.
+ */
+static constexpr PcmSimd pcm_simd_ssse3 = {
+	"ssse3",
+	sse2_volume_float,
+	sse2_add_volume_float,
+	sse2_add_float,
+	sse2_add_16,
+	sse2_float_to_16,
+	sse2_float_to_24,
+	sse2_float_to_32,
+	sse2_s16_to_float,
+	sse2_s32_to_float<S24ToFloat>,
+	sse2_s32_to_float<S32ToFloat>,
+	portable_dsd2pcm,
+	sse2_dsd_to_dop,
+	sse2_deinterleave_float,
+	sse2_dot_float,
+	sse2_complex_mac_float,
+	sse2_biquad_float,
+	portable_biquad_32,
+	sse2_mono_to_stereo_16,
+	sse2_mono_to_stereo_32,
+	sse2_stereo_to_mono_16,
+	sse2_stereo_to_mono_float,
+	portable_route_32,
+	sse2_peak_16,
+	sse2_peak_32,
+	sse2_peak_float,
+	sse2_gain_16,
+	ssse3_pack_24,
+	ssse3_unpack_24,
+};
+
+#endif
+
+#endif
+
+#ifdef HAVE_PCM_AVX2
+
+PCM_AVX2
+static void
+avx2_volume_float(float *dest,
+		  const float *src, size_t n,
+		  float volume)
+{
+	const __m256 v = _mm256_set1_ps(volume);
+
+	for (; n >= 8; n -= 8, src += 8, dest += 8)
+		_mm256_storeu_ps(dest, _mm256_mul_ps(_mm256_loadu_ps(src), v));
+
+	portable_volume_float(dest, src, n, volume);
+}
+
+PCM_AVX2
+static void
+avx2_add_volume_float(float *gcc_restrict a,
+		      const float *gcc_restrict b, size_t n,
+		      float volume1, float volume2)
+{
+	const __m256 v1 = _mm256_set1_ps(volume1);
+	const __m256 v2 = _mm256_set1_ps(volume2);
+
+	for (; n >= 8; n -= 8, a += 8, b += 8)
+		_mm256_storeu_ps(a,
+				 _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(a), v1),
+					       _mm256_mul_ps(_mm256_loadu_ps(b), v2)));
+
+	portable_add_volume_float(a, b, n, volume1, volume2);
+}
+
+PCM_AVX2
+static void
+avx2_add_float(float *gcc_restrict a, const float *gcc_restrict b, size_t n)
+{
+	for (; n >= 8; n -= 8, a += 8, b += 8)
+		_mm256_storeu_ps(a, _mm256_add_ps(_mm256_loadu_ps(a),
+						  _mm256_loadu_ps(b)));
+
+	portable_add_float(a, b, n);
+}
+
+PCM_AVX2
+static void
+avx2_add_16(int16_t *gcc_restrict a, const int16_t *gcc_restrict b, size_t n)
+{
+	for (; n >= 16; n -= 16, a += 16, b += 16) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)a);
+		const __m256i y = _mm256_loadu_si256((const __m256i *)b);
+		_mm256_storeu_si256((__m256i *)a, _mm256_adds_epi16(x, y));
+	}
+
+	portable_add_16(a, b, n);
+}
+
+PCM_AVX2
+static inline __m256i
+avx2_float_to_int(__m256 x, __m256 factor, __m256 min, __m256 max)
+{
+	return _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(x, factor),
+							       min),
+						 max));
+}
+
+PCM_AVX2
+static void
+avx2_float_to_16(int16_t *gcc_restrict dest,
+		 const float *gcc_restrict src, size_t n)
+{
+	const __m256 factor = _mm256_set1_ps(FloatTo16::factor);
+	const __m256 min = _mm256_set1_ps(FloatTo16::DstTraits::MIN);
+	const __m256 max = _mm256_set1_ps(FloatTo16::DstTraits::MAX);
+
+	for (; n >= 16; n -= 16, src += 16, dest += 16) {
+		const __m256i a = avx2_float_to_int(_mm256_loadu_ps(src),
+						    factor, min, max);
+		const __m256i b = avx2_float_to_int(_mm256_loadu_ps(src + 8),
+						    factor, min, max);
+
+		/* packs works on each 128 bit lane separately;
+		   restore the sample order */
+		const __m256i packed =
+			_mm256_permute4x64_epi64(_mm256_packs_epi32(a, b),
+						 0xd8);
+		_mm256_storeu_si256((__m256i *)dest, packed);
+	}
+
+	PortableConvert<FloatTo16>(dest, src, n);
+}
+
+PCM_AVX2
+static void
+avx2_float_to_24(int32_t *gcc_restrict dest,
+		 const float *gcc_restrict src, size_t n)
+{
+	const __m256 factor = _mm256_set1_ps(FloatTo24::factor);
+	const __m256 min = _mm256_set1_ps(FloatTo24::DstTraits::MIN);
+	const __m256 max = _mm256_set1_ps(FloatTo24::DstTraits::MAX);
+
+	for (; n >= 8; n -= 8, src += 8, dest += 8)
+		_mm256_storeu_si256((__m256i *)dest,
+				    avx2_float_to_int(_mm256_loadu_ps(src),
+						      factor, min, max));
+
+	PortableConvert<FloatTo24>(dest, src, n);
+}
+
+PCM_AVX2
+static void
+avx2_float_to_32(int32_t *gcc_restrict dest,
+		 const float *gcc_restrict src, size_t n)
+{
+	/* see sse2_float_to_32() */
+	const __m256 factor = _mm256_set1_ps(FloatTo32::factor);
+	const __m256 min = _mm256_set1_ps(FloatTo32::DstTraits::MIN);
+	const __m256 limit = _mm256_set1_ps(2147483648.f);
+
+	for (; n >= 8; n -= 8, src += 8, dest += 8) {
+		const __m256 x = _mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src),
+							     factor),
+					       min);
+		const __m256i overflow =
+			_mm256_castps_si256(_mm256_cmp_ps(x, limit,
+							  _CMP_GE_OQ));
+		_mm256_storeu_si256((__m256i *)dest,
+				    _mm256_xor_si256(_mm256_cvttps_epi32(x),
+						     overflow));
+	}
+
+	PortableConvert<FloatTo32>(dest, src, n);
+}
+
+PCM_AVX2
+static void
+avx2_s16_to_float(float *gcc_restrict dest,
+		  const int16_t *gcc_restrict src, size_t n)
+{
+	const __m256 factor = _mm256_set1_ps(S16ToFloat::factor);
+
+	for (; n >= 8; n -= 8, src += 8, dest += 8) {
+		const __m256i x =
+			_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)src));
+		_mm256_storeu_ps(dest,
+				 _mm256_mul_ps(_mm256_cvtepi32_ps(x), factor));
+	}
+
+	PortableConvert<S16ToFloat>(dest, src, n);
+}
+
+template<class C>
+PCM_AVX2
+static void
+avx2_s32_to_float(float *gcc_restrict dest,
+		  const int32_t *gcc_restrict src, size_t n)
+{
+	const __m256 factor = _mm256_set1_ps(C::factor);
+
+	for (; n >= 8; n -= 8, src += 8, dest += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)src);
+		_mm256_storeu_ps(dest,
+				 _mm256_mul_ps(_mm256_cvtepi32_ps(x), factor));
+	}
+
+	PortableConvert<C>(dest, src, n);
+}
+
+/**
+ * Eight output samples at a time; the table lookups are done with
+ * "gather" instructions.  The sum is evaluated in the same order as
+ * portable_dsd2pcm(), therefore the result is bit-exact.
+ */
+PCM_AVX2
+static void
+avx2_dsd2pcm(float *gcc_restrict dest,
+	     const uint8_t *fwd, const uint8_t *rev, size_t n,
+	     const float *ctables)
+{
+	for (; n >= 8; n -= 8, fwd += 8, rev += 8, dest += 8) {
+		__m256 acc = _mm256_setzero_ps();
+
+		for (unsigned k = 0; k < 6; ++k) {
+			const __m128i a8 =
+				_mm_loadl_epi64((const __m128i *)(fwd + 11 - k));
+			const __m128i b8 =
+				_mm_loadl_epi64((const __m128i *)(rev + k));
+			const __m256i a = _mm256_cvtepu8_epi32(a8);
+			const __m256i b = _mm256_cvtepu8_epi32(b8);
+			const float *t = ctables + k * 256;
+
+			const __m256 sum =
+				_mm256_add_ps(_mm256_i32gather_ps(t, a, 4),
+					      _mm256_i32gather_ps(t, b, 4));
+			acc = _mm256_add_ps(acc, sum);
+		}
+
+		_mm256_storeu_ps(dest, acc);
+	}
+
+	portable_dsd2pcm(dest, fwd, rev, n, ctables);
+}
+
+PCM_AVX2
+static float
+avx2_dot_float(const float *a, const float *b, size_t n)
+{
+	__m256 acc = _mm256_setzero_ps();
+	for (; n >= 8; n -= 8, a += 8, b += 8)
+		acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a),
+						       _mm256_loadu_ps(b)));
+
+	/* horizontal sum */
+	__m128 x = _mm_add_ps(_mm256_castps256_ps128(acc),
+			      _mm256_extractf128_ps(acc, 1));
+	x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+	x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+
+	return _mm_cvtss_f32(x) + portable_dot_float(a, b, n);
+}
+
+PCM_AVX2
+static void
+avx2_complex_mac_float(float *gcc_restrict acc_re, float *gcc_restrict acc_im,
+		       const float *a_re, const float *a_im,
+		       const float *b_re, const float *b_im,
+		       size_t n)
+{
+	for (; n >= 8; n -= 8, acc_re += 8, acc_im += 8,
+		     a_re += 8, a_im += 8, b_re += 8, b_im += 8) {
+		const __m256 ar = _mm256_loadu_ps(a_re);
+		const __m256 ai = _mm256_loadu_ps(a_im);
+		const __m256 br = _mm256_loadu_ps(b_re);
+		const __m256 bi = _mm256_loadu_ps(b_im);
+
+		__m256 re = _mm256_sub_ps(_mm256_mul_ps(ar, br),
+					  _mm256_mul_ps(ai, bi));
+		__m256 im = _mm256_add_ps(_mm256_mul_ps(ar, bi),
+					  _mm256_mul_ps(ai, br));
+		_mm256_storeu_ps(acc_re,
+				 _mm256_add_ps(_mm256_loadu_ps(acc_re), re));
+		_mm256_storeu_ps(acc_im,
+				 _mm256_add_ps(_mm256_loadu_ps(acc_im), im));
+	}
+
+	portable_complex_mac_float(acc_re, acc_im, a_re, a_im, b_re, b_im, n);
+}
+
+/**
+ * Returns a mask which selects the first #k lanes (all lanes if #k
+ * is 8 or more).
+ */
+PCM_AVX2
+static inline __m256i
+avx2_lane_mask(int k)
+{
+	return _mm256_cmpgt_epi32(_mm256_set1_epi32(k),
+				  _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+PCM_AVX2
+static void
+avx2_biquad_float(float *data, size_t n, unsigned channels,
+		  const float *coefficients, float *state)
+{
+	const __m256 b0 = _mm256_set1_ps(coefficients[0]);
+	const __m256 b1 = _mm256_set1_ps(coefficients[1]);
+	const __m256 b2 = _mm256_set1_ps(coefficients[2]);
+	const __m256 a1 = _mm256_set1_ps(coefficients[3]);
+	const __m256 a2 = _mm256_set1_ps(coefficients[4]);
+
+	float *z1 = state, *z2 = state + channels;
+
+	/* up to 8 channels per vector; masked loads and stores
+	   leave the other channels alone */
+	for (unsigned c = 0; c < channels; c += 8) {
+		const __m256i mask = avx2_lane_mask(channels - c);
+
+		__m256 s1 = _mm256_maskload_ps(z1 + c, mask);
+		__m256 s2 = _mm256_maskload_ps(z2 + c, mask);
+
+		float *p = data + c;
+		for (size_t i = 0; i != n; ++i, p += channels) {
+			const __m256 x = _mm256_maskload_ps(p, mask);
+			const __m256 y = _mm256_add_ps(_mm256_mul_ps(b0, x),
+						       s1);
+			s1 = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(b1, x),
+							 _mm256_mul_ps(a1, y)),
+					   s2);
+			s2 = _mm256_sub_ps(_mm256_mul_ps(b2, x),
+					   _mm256_mul_ps(a2, y));
+			_mm256_maskstore_ps(p, mask, y);
+		}
+
+		_mm256_maskstore_ps(z1 + c, mask, s1);
+		_mm256_maskstore_ps(z2 + c, mask, s2);
+	}
+}
+
+/**
+ * Load up to 4 (masked) 32 bit integers and sign-extend them to 64
+ * bit lanes.
+ */
+PCM_AVX2
+static inline __m256i
+avx2_load_epi32_epi64(const int32_t *p, __m128i mask)
+{
+	return _mm256_cvtepi32_epi64(_mm_maskload_epi32((const int *)p,
+							mask));
+}
+
+/**
+ * Store the low 32 bits of each 64 bit lane (masked).
+ */
+PCM_AVX2
+static inline void
+avx2_store_epi64_epi32(int32_t *p, __m128i mask, __m256i v)
+{
+	const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+	_mm_maskstore_epi32((int *)p, mask,
+			    _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, pack)));
+}
+
+PCM_AVX2
+static void
+avx2_biquad_32(int32_t *data, size_t n, unsigned channels,
+	       const int32_t *coefficients, int32_t *state)
+{
+	/* _mm256_mul_epi32() multiplies the low 32 bits of each 64
+	   bit lane */
+	const __m256i b0 = _mm256_set1_epi64x(coefficients[0]);
+	const __m256i b1 = _mm256_set1_epi64x(coefficients[1]);
+	const __m256i b2 = _mm256_set1_epi64x(coefficients[2]);
+	const __m256i a1 = _mm256_set1_epi64x(coefficients[3]);
+	const __m256i a2 = _mm256_set1_epi64x(coefficients[4]);
+
+	const __m256i round =
+		_mm256_set1_epi64x(int64_t(1) << (PCM_BIQUAD_BITS - 1));
+	const __m256i max =
+		_mm256_set1_epi64x((int64_t(1) << (31 + PCM_BIQUAD_BITS)) - 1);
+	const __m256i min =
+		_mm256_set1_epi64x(-(int64_t(1) << (31 + PCM_BIQUAD_BITS)));
+
+	int32_t *x1 = state, *x2 = x1 + channels;
+	int32_t *y1 = x2 + channels, *y2 = y1 + channels;
+
+	for (unsigned c = 0; c < channels; c += 4) {
+		const __m128i mask =
+			_mm_cmpgt_epi32(_mm_set1_epi32(channels - c),
+					_mm_setr_epi32(0, 1, 2, 3));
+
+		__m256i sx1 = avx2_load_epi32_epi64(x1 + c, mask);
+		__m256i sx2 = avx2_load_epi32_epi64(x2 + c, mask);
+		__m256i sy1 = avx2_load_epi32_epi64(y1 + c, mask);
+		__m256i sy2 = avx2_load_epi32_epi64(y2 + c, mask);
+
+		int32_t *p = data + c;
+		for (size_t i = 0; i != n; ++i, p += channels) {
+			const __m256i x = avx2_load_epi32_epi64(p, mask);
+
+			__m256i acc = _mm256_add_epi64(_mm256_mul_epi32(b0, x),
+						       _mm256_mul_epi32(b1, sx1));
+			acc = _mm256_add_epi64(acc, _mm256_mul_epi32(b2, sx2));
+			acc = _mm256_sub_epi64(acc, _mm256_mul_epi32(a1, sy1));
+			acc = _mm256_sub_epi64(acc, _mm256_mul_epi32(a2, sy2));
+			acc = _mm256_add_epi64(acc, round);
+
+			/* clamp before shifting, because there is no
+			   arithmetic 64 bit shift; the low 32 bits of
+			   the logical shift are correct, and nothing
+			   else is used */
+			acc = _mm256_blendv_epi8(acc, max,
+						 _mm256_cmpgt_epi64(acc, max));
+			acc = _mm256_blendv_epi8(acc, min,
+						 _mm256_cmpgt_epi64(min, acc));
+			const __m256i y = _mm256_srli_epi64(acc,
+							    PCM_BIQUAD_BITS);
+
+			sx2 = sx1;
+			sx1 = x;
+			sy2 = sy1;
+			sy1 = y;
+
+			avx2_store_epi64_epi32(p, mask, y);
+		}
+
+		avx2_store_epi64_epi32(x1 + c, mask, sx1);
+		avx2_store_epi64_epi32(x2 + c, mask, sx2);
+		avx2_store_epi64_epi32(y1 + c, mask, sy1);
+		avx2_store_epi64_epi32(y2 + c, mask, sy2);
+	}
+}
+
+/**
+ * One frame per iteration: load 8 samples starting at the source
+ * frame, permute them with the routing table and store 8 samples;
+ * the surplus samples are overwritten by the next frame.  The last
+ * frames, where this would access memory beyond the buffers, are
+ * done by the portable implementation.
+ */
+PCM_AVX2
+static void
+avx2_route_32(uint32_t *gcc_restrict dest,
+	      const uint32_t *gcc_restrict src, size_t n,
+	      unsigned src_channels, unsigned dest_channels,
+	      const int8_t *map)
+{
+	assert(src_channels <= 8);
+	assert(dest_channels <= 8);
+
+	int32_t indices[8], mask[8];
+	for (unsigned c = 0; c < 8; ++c) {
+		const bool used = c < dest_channels && map[c] >= 0;
+		indices[c] = used ? map[c] : 0;
+		mask[c] = used ? -1 : 0;
+	}
+
+	const __m256i vindices = _mm256_loadu_si256((const __m256i *)indices);
+	const __m256i vmask = _mm256_loadu_si256((const __m256i *)mask);
+
+	/* frames which can be done with 8 sample loads and stores */
+	const size_t src_safe = src_channels < 8
+		? (n * src_channels >= 8 ? (n * src_channels - 8) / src_channels + 1 : 0)
+		: n;
+	const size_t dest_safe = dest_channels < 8
+		? (n * dest_channels >= 8 ? (n * dest_channels - 8) / dest_channels + 1 : 0)
+		: n;
+	const size_t safe = std::min(src_safe, dest_safe);
+
+	for (size_t i = 0; i < safe; ++i, src += src_channels,
+		     dest += dest_channels) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)src);
+		_mm256_storeu_si256((__m256i *)dest,
+				    _mm256_and_si256(_mm256_permutevar8x32_epi32(x, vindices),
+						     vmask));
+	}
+
+	portable_route_32(dest, src, n - safe,
+			  src_channels, dest_channels, map);
+}
+
+PCM_AVX2
+static unsigned
+avx2_peak_16(const int16_t *src, size_t n)
+{
+	__m256i acc = _mm256_setzero_si256();
+	for (; n >= 16; n -= 16, src += 16) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)src);
+		acc = _mm256_max_epi16(acc,
+				       _mm256_xor_si256(x, _mm256_srai_epi16(x, 15)));
+	}
+
+	int16_t lanes[16];
+	_mm256_storeu_si256((__m256i *)lanes, acc);
+	return std::max(portable_peak_16(lanes, 16),
+			portable_peak_16(src, n));
+}
+
+PCM_AVX2
+static uint32_t
+avx2_peak_32(const int32_t *src, size_t n)
+{
+	__m256i acc = _mm256_setzero_si256();
+	for (; n >= 8; n -= 8, src += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)src);
+		acc = _mm256_max_epi32(acc,
+				       _mm256_xor_si256(x, _mm256_srai_epi32(x, 31)));
+	}
+
+	int32_t lanes[8];
+	_mm256_storeu_si256((__m256i *)lanes, acc);
+	return std::max(portable_peak_32(lanes, 8),
+			portable_peak_32(src, n));
+}
+
+PCM_AVX2
+static float
+avx2_peak_float(const float *src, size_t n)
+{
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+
+	__m256 acc = _mm256_setzero_ps();
+	for (; n >= 8; n -= 8, src += 8)
+		acc = _mm256_max_ps(acc,
+				    _mm256_andnot_ps(sign, _mm256_loadu_ps(src)));
+
+	__m128 x = _mm_max_ps(_mm256_castps256_ps128(acc),
+			      _mm256_extractf128_ps(acc, 1));
+	x = _mm_max_ps(x, _mm_movehl_ps(x, x));
+	x = _mm_max_ss(x, _mm_shuffle_ps(x, x, 1));
+
+	return std::max(_mm_cvtss_f32(x), portable_peak_float(src, n));
+}
+
+/**
+ * Like sse2_gain_16(); the unpack and pack instructions work within
+ * each 128 bit lane, so the sample order is preserved.
+ */
+PCM_AVX2
+static void
+avx2_gain_16(int16_t *dest, const int16_t *src, size_t n, int gain)
+{
+	const __m256i g = _mm256_set1_epi16(gain);
+
+	for (; n >= 16; n -= 16, src += 16, dest += 16) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)src);
+		const __m256i lo = _mm256_mullo_epi16(x, g);
+		const __m256i hi = _mm256_mulhi_epi16(x, g);
+		const __m256i a =
+			_mm256_srai_epi32(_mm256_unpacklo_epi16(lo, hi), 10);
+		const __m256i b =
+			_mm256_srai_epi32(_mm256_unpackhi_epi16(lo, hi), 10);
+		_mm256_storeu_si256((__m256i *)dest,
+				    _mm256_packs_epi32(a, b));
+	}
+
+	portable_gain_16(dest, src, n, gain);
+}
+
+static constexpr PcmSimd pcm_simd_avx2 = {
+	"avx2",
+	avx2_volume_float,
+	avx2_add_volume_float,
+	avx2_add_float,
+	avx2_add_16,
+	avx2_float_to_16,
+	avx2_float_to_24,
+	avx2_float_to_32,
+	avx2_s16_to_float,
+	avx2_s32_to_float<S24ToFloat>,
+	avx2_s32_to_float<S32ToFloat>,
+	avx2_dsd2pcm,
+#ifdef HAVE_PCM_SSE2
+	sse2_dsd_to_dop,
+	sse2_deinterleave_float,
+#else
+	portable_dsd_to_dop,
+	portable_deinterleave_float,
+#endif
+	avx2_dot_float,
+	avx2_complex_mac_float,
+	avx2_biquad_float,
+	avx2_biquad_32,
+#ifdef HAVE_PCM_SSE2
+	sse2_mono_to_stereo_16,
+	sse2_mono_to_stereo_32,
+	sse2_stereo_to_mono_16,
+	sse2_stereo_to_mono_float,
+#else
+	portable_mono_to_stereo<int16_t>,
+	portable_mono_to_stereo<uint32_t>,
+	portable_stereo_to_mono_16,
+	portable_stereo_to_mono_float,
+#endif
+	avx2_route_32,
+	avx2_peak_16,
+	avx2_peak_32,
+	avx2_peak_float,
+	avx2_gain_16,
+	ssse3_pack_24,
+	ssse3_unpack_24,
+};
+
+#endif
+
+#ifdef HAVE_PCM_NEON
+
+static void
+neon_volume_float(float *dest,
+		  const float *src, size_t n,
+		  float volume)
+{
+	for (; n >= 4; n -= 4, src += 4, dest += 4)
+		vst1q_f32(dest, vmulq_n_f32(vld1q_f32(src), volume));
+
+	portable_volume_float(dest, src, n, volume);
+}
+
+static void
+neon_add_volume_float(float *gcc_restrict a,
+		      const float *gcc_restrict b, size_t n,
+		      float volume1, float volume2)
+{
+	for (; n >= 4; n -= 4, a += 4, b += 4)
+		vst1q_f32(a, vaddq_f32(vmulq_n_f32(vld1q_f32(a), volume1),
+				       vmulq_n_f32(vld1q_f32(b), volume2)));
+
+	portable_add_volume_float(a, b, n, volume1, volume2);
+}
+
+static void
+neon_add_float(float *gcc_restrict a, const float *gcc_restrict b, size_t n)
+{
+	for (; n >= 4; n -= 4, a += 4, b += 4)
+		vst1q_f32(a, vaddq_f32(vld1q_f32(a), vld1q_f32(b)));
+
+	portable_add_float(a, b, n);
+}
+
+static void
+neon_add_16(int16_t *gcc_restrict a, const int16_t *gcc_restrict b, size_t n)
+{
+	for (; n >= 8; n -= 8, a += 8, b += 8)
+		vst1q_s16(a, vqaddq_s16(vld1q_s16(a), vld1q_s16(b)));
+
+	portable_add_16(a, b, n);
+}
+
+static void
+neon_float_to_16(int16_t *gcc_restrict dest,
+		 const float *gcc_restrict src, size_t n)
+{
+	NeonFloatTo16().Convert(dest, src, n);
+
+	/* use the "portable" algorithm for the trailing samples */
+	const size_t done = n - n % NeonFloatTo16::BLOCK_SIZE;
+	PortableConvert<FloatTo16>(dest + done, src + done, n - done);
+}
+
+/**
+ * Stereo only: 32 DSD bytes (four blocks) per iteration.
+ */
+static void
+neon_dsd_to_dop(uint32_t *gcc_restrict dest,
+		const uint8_t *gcc_restrict src, size_t n,
+		unsigned channels)
+{
+	if (channels == 2) {
+		static constexpr uint8_t marker_values[16] = {
+			0x05, 0x05, 0xfa, 0xfa, 0x05, 0x05, 0xfa, 0xfa,
+			0x05, 0x05, 0xfa, 0xfa, 0x05, 0x05, 0xfa, 0xfa,
+		};
+
+		uint8x16x4_t v;
+		v.val[2] = vld1q_u8(marker_values);
+		v.val[3] = vdupq_n_u8(0xff);
+
+		for (; n >= 4; n -= 4, src += 32, dest += 16) {
+			/* even words: (L0 R0) (L2 R2) ...; odd words:
+			   (L1 R1) (L3 R3) ... */
+			const uint16x8x2_t x =
+				vld2q_u16((const uint16_t *)src);
+
+			/* each output word consists of the bytes
+			   (odd, even, marker, 0xff) */
+			v.val[0] = vreinterpretq_u8_u16(x.val[1]);
+			v.val[1] = vreinterpretq_u8_u16(x.val[0]);
+			vst4q_u8((uint8_t *)dest, v);
+		}
+	}
+
+	portable_dsd_to_dop(dest, src, n, channels);
+}
+
+/**
+ * Stereo only: 4 frames per iteration.
+ */
+static void
+neon_deinterleave_float(float *const*dest,
+			const float *gcc_restrict src, size_t n,
+			unsigned channels)
+{
+	if (channels == 2) {
+		float *gcc_restrict left = dest[0], *gcc_restrict right = dest[1];
+
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4, src += 8) {
+			const float32x4x2_t x = vld2q_f32(src);
+			vst1q_f32(left + i, x.val[0]);
+			vst1q_f32(right + i, x.val[1]);
+		}
+
+		float *const tail[2] = { left + i, right + i };
+		portable_deinterleave_float(tail, src, n - i, channels);
+		return;
+	}
+
+	portable_deinterleave_float(dest, src, n, channels);
+}
+
+static float
+neon_dot_float(const float *a, const float *b, size_t n)
+{
+	float32x4_t acc = vdupq_n_f32(0);
+	for (; n >= 4; n -= 4, a += 4, b += 4)
+		acc = vmlaq_f32(acc, vld1q_f32(a), vld1q_f32(b));
+
+	const float32x2_t x = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+	return vget_lane_f32(vpadd_f32(x, x), 0) +
+		portable_dot_float(a, b, n);
+}
+
+static void
+neon_complex_mac_float(float *gcc_restrict acc_re, float *gcc_restrict acc_im,
+		       const float *a_re, const float *a_im,
+		       const float *b_re, const float *b_im,
+		       size_t n)
+{
+	for (; n >= 4; n -= 4, acc_re += 4, acc_im += 4,
+		     a_re += 4, a_im += 4, b_re += 4, b_im += 4) {
+		const float32x4_t ar = vld1q_f32(a_re), ai = vld1q_f32(a_im);
+		const float32x4_t br = vld1q_f32(b_re), bi = vld1q_f32(b_im);
+
+		float32x4_t re = vld1q_f32(acc_re), im = vld1q_f32(acc_im);
+		re = vmlsq_f32(vmlaq_f32(re, ar, br), ai, bi);
+		im = vmlaq_f32(vmlaq_f32(im, ar, bi), ai, br);
+		vst1q_f32(acc_re, re);
+		vst1q_f32(acc_im, im);
+	}
+
+	portable_complex_mac_float(acc_re, acc_im, a_re, a_im, b_re, b_im, n);
+}
+
+/**
+ * Load the first #k (1 to 4) floats into a vector.
+ */
+template<unsigned k>
+static inline float32x4_t
+neon_load_partial(const float *p)
+{
+	if (k == 4)
+		return vld1q_f32(p);
+
+	float32x4_t v = vld1q_lane_f32(p, vdupq_n_f32(0), 0);
+	if (k > 1)
+		v = vld1q_lane_f32(p + 1, v, 1);
+	if (k > 2)
+		v = vld1q_lane_f32(p + 2, v, 2);
+	return v;
+}
+
+template<unsigned k>
+static inline void
+neon_store_partial(float *p, float32x4_t v)
+{
+	if (k == 4) {
+		vst1q_f32(p, v);
+		return;
+	}
+
+	vst1q_lane_f32(p, v, 0);
+	if (k > 1)
+		vst1q_lane_f32(p + 1, v, 1);
+	if (k > 2)
+		vst1q_lane_f32(p + 2, v, 2);
+}
+
+template<unsigned k>
+static inline int32x4_t
+neon_load_partial(const int32_t *p)
+{
+	if (k == 4)
+		return vld1q_s32(p);
+
+	int32x4_t v = vld1q_lane_s32(p, vdupq_n_s32(0), 0);
+	if (k > 1)
+		v = vld1q_lane_s32(p + 1, v, 1);
+	if (k > 2)
+		v = vld1q_lane_s32(p + 2, v, 2);
+	return v;
+}
+
+template<unsigned k>
+static inline void
+neon_store_partial(int32_t *p, int32x4_t v)
+{
+	if (k == 4) {
+		vst1q_s32(p, v);
+		return;
+	}
+
+	vst1q_lane_s32(p, v, 0);
+	if (k > 1)
+		vst1q_lane_s32(p + 1, v, 1);
+	if (k > 2)
+		vst1q_lane_s32(p + 2, v, 2);
+}
+
+/**
+ * Filter #k adjacent channels in the lanes of one vector.
+ */
+template<unsigned k>
+static void
+neon_biquad_float_lanes(float *data, size_t n, unsigned channels,
+			const float *coefficients, float *z1, float *z2)
+{
+	const float32x4_t b0 = vdupq_n_f32(coefficients[0]);
+	const float32x4_t b1 = vdupq_n_f32(coefficients[1]);
+	const float32x4_t b2 = vdupq_n_f32(coefficients[2]);
+	const float32x4_t a1 = vdupq_n_f32(coefficients[3]);
+	const float32x4_t a2 = vdupq_n_f32(coefficients[4]);
+
+	float32x4_t s1 = neon_load_partial<k>(z1);
+	float32x4_t s2 = neon_load_partial<k>(z2);
+
+	for (size_t i = 0; i != n; ++i, data += channels) {
+		const float32x4_t x = neon_load_partial<k>(data);
+		const float32x4_t y = vmlaq_f32(s1, b0, x);
+		s1 = vmlsq_f32(vmlaq_f32(s2, b1, x), a1, y);
+		s2 = vmlsq_f32(vmulq_f32(b2, x), a2, y);
+		neon_store_partial<k>(data, y);
+	}
+
+	neon_store_partial<k>(z1, s1);
+	neon_store_partial<k>(z2, s2);
+}
+
+static void
+neon_biquad_float(float *data, size_t n, unsigned channels,
+		  const float *coefficients, float *state)
+{
+	float *z1 = state, *z2 = state + channels;
+
+	unsigned c = 0;
+	for (; c + 4 <= channels; c += 4)
+		neon_biquad_float_lanes<4>(data + c, n, channels,
+					   coefficients, z1 + c, z2 + c);
+
+	switch (channels - c) {
+	case 1:
+		neon_biquad_float_lanes<1>(data + c, n, channels,
+					   coefficients, z1 + c, z2 + c);
+		break;
+
+	case 2:
+		neon_biquad_float_lanes<2>(data + c, n, channels,
+					   coefficients, z1 + c, z2 + c);
+		break;
+
+	case 3:
+		neon_biquad_float_lanes<3>(data + c, n, channels,
+					   coefficients, z1 + c, z2 + c);
+		break;
+	}
+}
+
+/**
+ * Calculate one 64 bit accumulator for two channels and round,
+ * shift and saturate it.
+ */
+static inline int32x2_t
+neon_biquad_32_half(int32x2_t x, int32x2_t x1, int32x2_t x2,
+		    int32x2_t y1, int32x2_t y2,
+		    int32x2_t b0, int32x2_t b1, int32x2_t b2,
+		    int32x2_t a1, int32x2_t a2)
+{
+	int64x2_t acc = vmull_s32(x, b0);
+	acc = vmlal_s32(acc, x1, b1);
+	acc = vmlal_s32(acc, x2, b2);
+	acc = vmlsl_s32(acc, y1, a1);
+	acc = vmlsl_s32(acc, y2, a2);
+	return vqrshrn_n_s64(acc, PCM_BIQUAD_BITS);
+}
+
+template<unsigned k>
+static void
+neon_biquad_32_lanes(int32_t *data, size_t n, unsigned channels,
+		     const int32_t *coefficients,
+		     int32_t *x1, int32_t *x2, int32_t *y1, int32_t *y2)
+{
+	const int32x2_t b0 = vdup_n_s32(coefficients[0]);
+	const int32x2_t b1 = vdup_n_s32(coefficients[1]);
+	const int32x2_t b2 = vdup_n_s32(coefficients[2]);
+	const int32x2_t a1 = vdup_n_s32(coefficients[3]);
+	const int32x2_t a2 = vdup_n_s32(coefficients[4]);
+
+	int32x4_t sx1 = neon_load_partial<k>(x1);
+	int32x4_t sx2 = neon_load_partial<k>(x2);
+	int32x4_t sy1 = neon_load_partial<k>(y1);
+	int32x4_t sy2 = neon_load_partial<k>(y2);
+
+	for (size_t i = 0; i != n; ++i, data += channels) {
+		const int32x4_t x = neon_load_partial<k>(data);
+
+		const int32x2_t lo =
+			neon_biquad_32_half(vget_low_s32(x),
+					    vget_low_s32(sx1),
+					    vget_low_s32(sx2),
+					    vget_low_s32(sy1),
+					    vget_low_s32(sy2),
+					    b0, b1, b2, a1, a2);
+		const int32x2_t hi = k > 2
+			? neon_biquad_32_half(vget_high_s32(x),
+					      vget_high_s32(sx1),
+					      vget_high_s32(sx2),
+					      vget_high_s32(sy1),
+					      vget_high_s32(sy2),
+					      b0, b1, b2, a1, a2)
+			: vdup_n_s32(0);
+		const int32x4_t y = vcombine_s32(lo, hi);
+
+		sx2 = sx1;
+		sx1 = x;
+		sy2 = sy1;
+		sy1 = y;
+
+		neon_store_partial<k>(data, y);
+	}
+
+	neon_store_partial<k>(x1, sx1);
+	neon_store_partial<k>(x2, sx2);
+	neon_store_partial<k>(y1, sy1);
+	neon_store_partial<k>(y2, sy2);
+}
+
+static void
+neon_biquad_32(int32_t *data, size_t n, unsigned channels,
+	       const int32_t *coefficients, int32_t *state)
+{
+	int32_t *x1 = state, *x2 = x1 + channels;
+	int32_t *y1 = x2 + channels, *y2 = y1 + channels;
+
+	unsigned c = 0;
+	for (; c + 4 <= channels; c += 4)
+		neon_biquad_32_lanes<4>(data + c, n, channels, coefficients,
+					x1 + c, x2 + c, y1 + c, y2 + c);
+
+	switch (channels - c) {
+	case 1:
+		neon_biquad_32_lanes<1>(data + c, n, channels, coefficients,
+					x1 + c, x2 + c, y1 + c, y2 + c);
+		break;
+
+	case 2:
+		neon_biquad_32_lanes<2>(data + c, n, channels, coefficients,
+					x1 + c, x2 + c, y1 + c, y2 + c);
+		break;
+
+	case 3:
+		neon_biquad_32_lanes<3>(data + c, n, channels, coefficients,
+					x1 + c, x2 + c, y1 + c, y2 + c);
+		break;
+	}
+}
+
+static void
+neon_mono_to_stereo_16(int16_t *gcc_restrict dest,
+		       const int16_t *gcc_restrict src, size_t n)
+{
+	for (; n >= 8; n -= 8, src += 8, dest += 16) {
+		int16x8x2_t x;
+		x.val[0] = x.val[1] = vld1q_s16(src);
+		vst2q_s16(dest, x);
+	}
+
+	portable_mono_to_stereo(dest, src, n);
+}
+
+static void
+neon_mono_to_stereo_32(uint32_t *gcc_restrict dest,
+		       const uint32_t *gcc_restrict src, size_t n)
+{
+	for (; n >= 4; n -= 4, src += 4, dest += 8) {
+		uint32x4x2_t x;
+		x.val[0] = x.val[1] = vld1q_u32(src);
+		vst2q_u32(dest, x);
+	}
+
+	portable_mono_to_stereo(dest, src, n);
+}
+
+/**
+ * Divide signed 32 bit integers by two, rounding towards zero.
+ */
+static inline int32x4_t
+neon_half_s32(int32x4_t x)
+{
+	const uint32x4_t sign = vshrq_n_u32(vreinterpretq_u32_s32(x), 31);
+	return vshrq_n_s32(vaddq_s32(x, vreinterpretq_s32_u32(sign)), 1);
+}
+
+static void
+neon_stereo_to_mono_16(int16_t *gcc_restrict dest,
+		       const int16_t *gcc_restrict src, size_t n)
+{
+	for (; n >= 8; n -= 8, src += 16, dest += 8) {
+		const int16x8x2_t x = vld2q_s16(src);
+		const int32x4_t lo = vaddl_s16(vget_low_s16(x.val[0]),
+					       vget_low_s16(x.val[1]));
+		const int32x4_t hi = vaddl_s16(vget_high_s16(x.val[0]),
+					       vget_high_s16(x.val[1]));
+		vst1q_s16(dest, vcombine_s16(vmovn_s32(neon_half_s32(lo)),
+					     vmovn_s32(neon_half_s32(hi))));
+	}
+
+	portable_stereo_to_mono_16(dest, src, n);
+}
+
+static void
+neon_stereo_to_mono_float(float *gcc_restrict dest,
+			  const float *gcc_restrict src, size_t n)
+{
+	for (; n >= 4; n -= 4, src += 8, dest += 4) {
+		const float32x4x2_t x = vld2q_f32(src);
+		vst1q_f32(dest, vmulq_n_f32(vaddq_f32(x.val[0], x.val[1]),
+					    0.5f));
+	}
+
+	portable_stereo_to_mono_float(dest, src, n);
+}
+
+static unsigned
+neon_peak_16(const int16_t *src, size_t n)
+{
+	int16x8_t acc = vdupq_n_s16(0);
+	for (; n >= 8; n -= 8, src += 8) {
+		const int16x8_t x = vld1q_s16(src);
+		acc = vmaxq_s16(acc, veorq_s16(x, vshrq_n_s16(x, 15)));
+	}
+
+	int16_t lanes[8];
+	vst1q_s16(lanes, acc);
+	return std::max(portable_peak_16(lanes, 8),
+			portable_peak_16(src, n));
+}
+
+static uint32_t
+neon_peak_32(const int32_t *src, size_t n)
+{
+	int32x4_t acc = vdupq_n_s32(0);
+	for (; n >= 4; n -= 4, src += 4) {
+		const int32x4_t x = vld1q_s32(src);
+		acc = vmaxq_s32(acc, veorq_s32(x, vshrq_n_s32(x, 31)));
+	}
+
+	int32_t lanes[4];
+	vst1q_s32(lanes, acc);
+	return std::max(portable_peak_32(lanes, 4),
+			portable_peak_32(src, n));
+}
+
+static float
+neon_peak_float(const float *src, size_t n)
+{
+	float32x4_t acc = vdupq_n_f32(0);
+	for (; n >= 4; n -= 4, src += 4)
+		acc = vmaxq_f32(acc, vabsq_f32(vld1q_f32(src)));
+
+	float lanes[4];
+	vst1q_f32(lanes, acc);
+	return std::max(portable_peak_float(lanes, 4),
+			portable_peak_float(src, n));
+}
+
+static void
+neon_gain_16(int16_t *dest, const int16_t *src, size_t n, int gain)
+{
+	const int16x4_t g = vdup_n_s16(gain);
+
+	for (; n >= 8; n -= 8, src += 8, dest += 8) {
+		const int16x8_t x = vld1q_s16(src);
+
+		/* vqshrn_n_s32() shifts and clamps */
+		const int16x4_t a =
+			vqshrn_n_s32(vmull_s16(vget_low_s16(x), g), 10);
+		const int16x4_t b =
+			vqshrn_n_s32(vmull_s16(vget_high_s16(x), g), 10);
+		vst1q_s16(dest, vcombine_s16(a, b));
+	}
+
+	portable_gain_16(dest, src, n, gain);
+}
+
+/*
+ * The 24 bit kernels let the structured load/store instructions
+ * (de)interleave the bytes of each sample; they assume a
+ * little-endian CPU.
+ */
+
+static void
+neon_pack_24(uint8_t *dest, const int32_t *src, size_t n)
+{
+	if (IsLittleEndian()) {
+		for (; n >= 16; n -= 16, src += 16, dest += 48) {
+			const uint8x16x4_t x = vld4q_u8((const uint8_t *)src);
+			uint8x16x3_t y;
+			y.val[0] = x.val[0];
+			y.val[1] = x.val[1];
+			y.val[2] = x.val[2];
+			vst3q_u8(dest, y);
+		}
+	}
+
+	portable_pack_24(dest, src, n);
+}
+
+static void
+neon_unpack_24(int32_t *gcc_restrict dest,
+	       const uint8_t *gcc_restrict src, size_t n)
+{
+	if (IsLittleEndian()) {
+		for (; n >= 16; n -= 16, src += 48, dest += 16) {
+			const uint8x16x3_t x = vld3q_u8(src);
+			uint8x16x4_t y;
+			y.val[0] = x.val[0];
+			y.val[1] = x.val[1];
+			y.val[2] = x.val[2];
+			/* the sign extension byte */
+			const int8x16_t msb = vreinterpretq_s8_u8(x.val[2]);
+			y.val[3] = vreinterpretq_u8_s8(vshrq_n_s8(msb, 7));
+			vst4q_u8((uint8_t *)dest, y);
+		}
+	}
+
+	portable_unpack_24(dest, src, n);
+}
+
+static constexpr PcmSimd pcm_simd_neon = {
+	"neon",
+	neon_volume_float,
+	neon_add_volume_float,
+	neon_add_float,
+	neon_add_16,
+	neon_float_to_16,
+	PortableConvert<FloatTo24>,
+	PortableConvert<FloatTo32>,
+	PortableConvert<S16ToFloat>,
+	PortableConvert<S24ToFloat>,
+	PortableConvert<S32ToFloat>,
+	portable_dsd2pcm,
+	neon_dsd_to_dop,
+	neon_deinterleave_float,
+	neon_dot_float,
+	neon_complex_mac_float,
+	neon_biquad_float,
+	neon_biquad_32,
+	neon_mono_to_stereo_16,
+	neon_mono_to_stereo_32,
+	neon_stereo_to_mono_16,
+	neon_stereo_to_mono_float,
+	portable_route_32,
+	neon_peak_16,
+	neon_peak_32,
+	neon_peak_float,
+	neon_gain_16,
+	neon_pack_24,
+	neon_unpack_24,
+};
+
+#endif
+
+/**
+ * All implementations supported by this CPU, see
+ * GetSupportedPcmSimd().  There is room for the portable one, three
+ * x86 tables and the nullptr terminator.
+ */
+static const PcmSimd *supported_pcm_simd[5];
+
+/**
+ * Probe the CPU and fill #supported_pcm_simd.
+ */
+static const PcmSimd *const*
+ProbePcmSimd()
+{
+	unsigned n = 0;
+
+#ifdef HAVE_PCM_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		supported_pcm_simd[n++] = &pcm_simd_avx2;
+#endif
+
+#if defined(HAVE_PCM_SSSE3) && defined(HAVE_PCM_SSE2)
+	if (__builtin_cpu_supports("ssse3"))
+		supported_pcm_simd[n++] = &pcm_simd_ssse3;
+#endif
+
+#if defined(HAVE_PCM_SSE2)
+	supported_pcm_simd[n++] = &pcm_simd_sse2;
+#elif defined(HAVE_PCM_NEON)
+	supported_pcm_simd[n++] = &pcm_simd_neon;
+#endif
+
+	supported_pcm_simd[n++] = &pcm_simd_portable;
+	supported_pcm_simd[n] = nullptr;
+
+	return supported_pcm_simd;
+}
+
+/**
+ * The implementation returned by GetPcmSimd(); nullptr until it is
+ * first used.  This is initialized lazily (and not by a dynamic
+ * initializer), so it works even when called by static constructors
+ * in other translation units.
+ */
+static std::atomic<const PcmSimd *> pcm_simd(nullptr);
+
+const PcmSimd &
+GetPcmSimd()
+{
+	const PcmSimd *simd = pcm_simd.load(std::memory_order_relaxed);
+	if (gcc_unlikely(simd == nullptr)) {
+		const PcmSimd *expected = nullptr;
+		simd = GetSupportedPcmSimd()[0];
+
+		/* don't overwrite a concurrent SetPcmSimd() call */
+		if (!pcm_simd.compare_exchange_strong(expected, simd,
+						      std::memory_order_relaxed))
+			simd = expected;
+	}
+
+	return *simd;
+}
+
+const PcmSimd *const*
+GetSupportedPcmSimd()
+{
+	/* the CPU is probed only once, on the first call (C++11
+	   guarantees that this is thread-safe) */
+	static const PcmSimd *const*const supported = ProbePcmSimd();
+	return supported;
+}
+
+void
+SetPcmSimd(const PcmSimd &simd)
+{
+	pcm_simd.store(&simd, std::memory_order_relaxed);
+}
@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_SIMD_HXX
+#define MPD_PCM_SIMD_HXX
+
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The number of fractional bits of the fixed-point coefficients
+ * passed to PcmSimd::biquad_32().
+ */
+static constexpr unsigned PCM_BIQUAD_BITS = 27;
+
+/**
+ * A table of PCM kernels which have a SIMD implementation.  The best
+ * implementation for the current CPU is chosen once at startup, see
+ * GetPcmSimd().
+ */
+struct PcmSimd {
+	/**
+	 * A human readable name of this implementation, e.g. for
+	 * the log file or benchmarks.
+	 */
+	const char *name;
+
+	/**
+	 * dest[i] = src[i] * volume
+	 *
+	 * dest may be equal to src (in-place operation).
+	 */
+	void (*volume_float)(float *dest, const float *src, size_t n,
+			     float volume);
+
+	/**
+	 * a[i] = a[i] * volume1 + b[i] * volume2
+	 */
+	void (*add_volume_float)(float *gcc_restrict a,
+				 const float *gcc_restrict b, size_t n,
+				 float volume1, float volume2);
+
+	/**
+	 * a[i] = a[i] + b[i]
+	 */
+	void (*add_float)(float *gcc_restrict a,
+			  const float *gcc_restrict b, size_t n);
+
+	/**
+	 * a[i] = a[i] + b[i], with saturation
+	 */
+	void (*add_16)(int16_t *gcc_restrict a,
+		       const int16_t *gcc_restrict b, size_t n);
+
+	/**
+	 * Sample format conversions; these produce the same result
+	 * as the templates in FloatConvert.hxx.
+	 */
+	void (*float_to_16)(int16_t *gcc_restrict dest,
+			    const float *gcc_restrict src, size_t n);
+	void (*float_to_24)(int32_t *gcc_restrict dest,
+			    const float *gcc_restrict src, size_t n);
+	void (*float_to_32)(int32_t *gcc_restrict dest,
+			    const float *gcc_restrict src, size_t n);
+	void (*s16_to_float)(float *gcc_restrict dest,
+			     const int16_t *gcc_restrict src, size_t n);
+	void (*s24_to_float)(float *gcc_restrict dest,
+			     const int32_t *gcc_restrict src, size_t n);
+	void (*s32_to_float)(float *gcc_restrict dest,
+			     const int32_t *gcc_restrict src, size_t n);
+
+	/**
+	 * The dsd2pcm FIR filter for one channel, see
+	 * dsd2pcm_get_ctables():
+	 *
+	 * dest[i] = sum(ctables[k][fwd[11 + i - k]] +
+	 *               ctables[k][rev[i + k]]), k = 0..5
+	 *
+	 * @param fwd 11 bytes of history followed by #n new DSD bytes
+	 * @param rev the same bytes with their bit order reversed
+	 * @param ctables DSD2PCM_CTABLES tables of 256 floats
+	 */
+	void (*dsd2pcm)(float *gcc_restrict dest,
+			const uint8_t *fwd, const uint8_t *rev, size_t n,
+			const float *ctables);
+
+	/**
+	 * Convert #n blocks of 4 DSD frames to 2 DoP frames each,
+	 * see pcm_dsd_to_dop().
+	 */
+	void (*dsd_to_dop)(uint32_t *gcc_restrict dest,
+			   const uint8_t *gcc_restrict src, size_t n,
+			   unsigned channels);
+
+	/**
+	 * Split #n interleaved frames into one buffer per channel:
+	 *
+	 * dest[c][i] = src[i * channels + c]
+	 */
+	void (*deinterleave_float)(float *const*dest,
+				   const float *gcc_restrict src, size_t n,
+				   unsigned channels);
+
+	/**
+	 * Returns sum(a[i] * b[i]), e.g. one FIR filter output
+	 * sample.
+	 */
+	float (*dot_float)(const float *a, const float *b, size_t n);
+
+	/**
+	 * Multiply two vectors of complex numbers (with separate
+	 * arrays for the real and the imaginary parts) and add the
+	 * products to an accumulator, e.g. for fast convolution:
+	 *
+	 * acc[i] += a[i] * b[i]
+	 */
+	void (*complex_mac_float)(float *gcc_restrict acc_re,
+				  float *gcc_restrict acc_im,
+				  const float *a_re, const float *a_im,
+				  const float *b_re, const float *b_im,
+				  size_t n);
+
+	/**
+	 * Apply one biquad filter section (transposed direct form
+	 * II) in-place to #n interleaved frames; each channel is
+	 * filtered in its own SIMD lane:
+	 *
+	 * y = b0 * x + z1
+	 * z1 = b1 * x - a1 * y + z2
+	 * z2 = b2 * x - a2 * y
+	 *
+	 * @param coefficients b0, b1, b2, a1, a2 (normalized to
+	 * a0 = 1)
+	 * @param state z1 of all channels followed by z2 of all
+	 * channels
+	 */
+	void (*biquad_float)(float *data, size_t n, unsigned channels,
+			     const float *coefficients, float *state);
+
+	/**
+	 * Like biquad_float(), but for 32 bit integer samples, with
+	 * fixed-point coefficients (#PCM_BIQUAD_BITS fractional
+	 * bits) and a 64 bit accumulator (direct form I):
+	 *
+	 * y = clamp(round((b0 * x + b1 * x1 + b2 * x2
+	 *                  - a1 * y1 - a2 * y2) >> PCM_BIQUAD_BITS))
+	 *
+	 * @param state x1, x2, y1 and y2, each for all channels
+	 */
+	void (*biquad_32)(int32_t *data, size_t n, unsigned channels,
+			  const int32_t *coefficients, int32_t *state);
+
+	/**
+	 * Duplicate #n mono samples to stereo frames.  The 32 bit
+	 * variant is used for all 32 bit sample formats (including
+	 * float).
+	 */
+	void (*mono_to_stereo_16)(int16_t *gcc_restrict dest,
+				  const int16_t *gcc_restrict src, size_t n);
+	void (*mono_to_stereo_32)(uint32_t *gcc_restrict dest,
+				  const uint32_t *gcc_restrict src, size_t n);
+
+	/**
+	 * Mix down #n stereo frames to mono: dest[i] = (a + b) / 2,
+	 * rounded towards zero like the generic code in
+	 * PcmChannels.cxx.
+	 */
+	void (*stereo_to_mono_16)(int16_t *gcc_restrict dest,
+				  const int16_t *gcc_restrict src, size_t n);
+	void (*stereo_to_mono_float)(float *gcc_restrict dest,
+				     const float *gcc_restrict src, size_t n);
+
+	/**
+	 * Copy channels of #n frames of 32 bit samples according to
+	 * a routing table:
+	 *
+	 * dest[i][c] = map[c] >= 0 ? src[i][map[c]] : 0
+	 *
+	 * @param map one entry per destination channel; each one is
+	 * -1 or a source channel number
+	 */
+	void (*route_32)(uint32_t *gcc_restrict dest,
+			 const uint32_t *gcc_restrict src, size_t n,
+			 unsigned src_channels, unsigned dest_channels,
+			 const int8_t *map);
+
+	/**
+	 * Returns the peak magnitude of #n samples.  Negative
+	 * integer samples are measured with their one's complement
+	 * (-x - 1), which cannot overflow.  The 32 bit variant is
+	 * used for S24_P32 and S32.
+	 */
+	unsigned (*peak_16)(const int16_t *src, size_t n);
+	uint32_t (*peak_32)(const int32_t *src, size_t n);
+	float (*peak_float)(const float *src, size_t n);
+
+	/**
+	 * Amplify 16 bit samples with a fixed-point gain (10
+	 * fractional bits, less than 32768), clamping the result:
+	 *
+	 * dest[i] = clamp((src[i] * gain) >> 10)
+	 *
+	 * dest may be equal to src (in-place operation).
+	 */
+	void (*gain_16)(int16_t *dest, const int16_t *src, size_t n,
+			int gain);
+
+	/**
+	 * Pack/unpack #n 24 bit samples between 32 bit integers and
+	 * packed 3 byte samples, see pcm_pack_24() and
+	 * pcm_unpack_24().
+	 *
+	 * pack_24() may be used in-place (dest equal to src).
+	 */
+	void (*pack_24)(uint8_t *dest, const int32_t *src, size_t n);
+	void (*unpack_24)(int32_t *gcc_restrict dest,
+			  const uint8_t *gcc_restrict src, size_t n);
+};
+
+/**
+ * The portable (scalar) implementation.
+ */
+extern const PcmSimd pcm_simd_portable;
+
+/**
+ * Returns the fastest implementation supported by this CPU.
+ */
+gcc_pure
+const PcmSimd &
+GetPcmSimd();
+
+/**
+ * Returns all implementations supported by this CPU, the fastest one
+ * first and #pcm_simd_portable last.  The list is terminated with
+ * nullptr.
+ */
+gcc_pure
+const PcmSimd *const*
+GetSupportedPcmSimd();
+
+/**
+ * Override the implementation returned by GetPcmSimd(), e.g. to
+ * compare them in a benchmark.  Objects which have already been
+ * opened may keep using the previous one.  This function is not
+ * thread-safe.
+ */
+void
+SetPcmSimd(const PcmSimd &simd);
+
+#endif
@@ -43,6 +43,13 @@ static constexpr unsigned long SOXR_INVALID_RECIPE = -1;
 static soxr_quality_spec_t soxr_quality;
 static soxr_runtime_spec_t soxr_runtime;
 
+/**
+ * Was the "threads" setting specified?  If not, libsoxr runs
+ * single-threaded for mono and stereo, and chooses the number of
+ * threads for more channels.
+ */
+static bool soxr_threads_configured;
+
 static constexpr struct {
 	unsigned long recipe;
 	const char *name;
@@ -75,7 +82,7 @@ soxr_parse_quality(const char *quality)
 		return SOXR_DEFAULT_RECIPE;
 
 	for (const auto *i = soxr_quality_table; i->name != nullptr; ++i)
-		if (strcmp(i->name, "very high") == 0)
+		if (strcmp(i->name, quality) == 0)
 			return i->recipe;
 
 	return SOXR_INVALID_RECIPE;
@@ -101,9 +108,28 @@ pcm_resample_soxr_global_init(const ConfigBlock &block, Error &error)
 		    "soxr converter '%s'",
 		    soxr_quality_name(recipe));
 
+	soxr_threads_configured = block.GetBlockValue("threads") != nullptr;
 	const unsigned n_threads = block.GetBlockValue("threads", 1);
 	soxr_runtime = soxr_runtime_spec(n_threads);
 
+	soxr_runtime.log2_min_dft_size =
+		block.GetBlockValue("log2_min_dft_size",
+				    soxr_runtime.log2_min_dft_size);
+	soxr_runtime.log2_large_dft_size =
+		block.GetBlockValue("log2_large_dft_size",
+				    soxr_runtime.log2_large_dft_size);
+
+	if (soxr_runtime.log2_min_dft_size < 8 ||
+	    soxr_runtime.log2_min_dft_size > 15 ||
+	    soxr_runtime.log2_large_dft_size < 8 ||
+	    soxr_runtime.log2_large_dft_size > 20 ||
+	    soxr_runtime.log2_min_dft_size > soxr_runtime.log2_large_dft_size) {
+		error.Format(soxr_domain,
+			     "invalid DFT size setting in line %d",
+			     block.line);
+		return false;
+	}
+
 	return true;
 }
 
@@ -114,10 +140,17 @@ SoxrPcmResampler::Open(AudioFormat &af, unsigned new_sample_rate,
 	assert(af.IsValid());
 	assert(audio_valid_sample_rate(new_sample_rate));
 
+	/* libsoxr processes the channels in parallel; this is only
+	   worth the synchronization overhead with more than two
+	   channels */
+	soxr_runtime_spec_t runtime = soxr_runtime;
+	if (!soxr_threads_configured)
+		runtime.num_threads = af.channels > 2 ? 0 : 1;
+
 	soxr_error_t e;
 	soxr = soxr_create(af.sample_rate, new_sample_rate,
 			   af.channels, &e,
-			   nullptr, &soxr_quality, &soxr_runtime);
+			   nullptr, &soxr_quality, &runtime);
 	if (soxr == nullptr) {
 		error.Format(soxr_domain,
 			     "soxr initialization has failed: %s", e);
@@ -147,6 +180,12 @@ SoxrPcmResampler::Close()
 	soxr_delete(soxr);
 }
 
+void
+SoxrPcmResampler::Reset()
+{
+	soxr_clear(soxr);
+}
+
 ConstBuffer<void>
 SoxrPcmResampler::Resample(ConstBuffer<void> src, Error &error)
 {
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "Volume.hxx"
+#include "Simd.hxx"
 #include "Domain.hxx"
 #include "PcmUtils.hxx"
 #include "Traits.hxx"
@@ -88,14 +89,6 @@ pcm_volume_change_32(PcmDither &dither,
 	pcm_volume_change<SampleFormat::S32>(dither, dest, src, n, volume);
 }
 
-static void
-pcm_volume_change_float(float *dest, const float *src, size_t n,
-			float volume)
-{
-	for (size_t i = 0; i != n; ++i)
-		dest[i] = src[i] * volume;
-}
-
 bool
 PcmVolume::Open(SampleFormat _format, Error &error)
 {
@@ -130,7 +123,14 @@ PcmVolume::Apply(ConstBuffer<void> src)
 	if (volume == PCM_VOLUME_1)
 		return src;
 
-	void *data = buffer.Get(src.size);
+	return Apply(src, buffer.Get(src.size));
+}
+
+ConstBuffer<void>
+PcmVolume::Apply(ConstBuffer<void> src, void *data)
+{
+	if (volume == PCM_VOLUME_1)
+		return src;
 
 	if (volume == 0) {
 		/* optimized special case: 0% volume = memset(0) */
@@ -174,10 +174,10 @@ PcmVolume::Apply(ConstBuffer<void> src)
 		break;
 
 	case SampleFormat::FLOAT:
-		pcm_volume_change_float((float *)data,
-					(const float *)src.data,
-					src.size / sizeof(float),
-					pcm_volume_to_float(volume));
+		GetPcmSimd().volume_float((float *)data,
+					  (const float *)src.data,
+					  src.size / sizeof(float),
+					  pcm_volume_to_float(volume));
 		break;
 
 	case SampleFormat::DSD:
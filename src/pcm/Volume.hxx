@@ -125,6 +125,17 @@ public:
 	 */
 	gcc_pure
 	ConstBuffer<void> Apply(ConstBuffer<void> src);
+
+	/**
+	 * Apply the volume level, writing the result into a buffer
+	 * provided by the caller.  The destination may be the same
+	 * as the source (in-place operation), but must not overlap
+	 * it otherwise.
+	 *
+	 * @return the result (either in #dest, or the unmodified
+	 * source if there is nothing to do)
+	 */
+	ConstBuffer<void> Apply(ConstBuffer<void> src, void *dest);
 };
 
 #endif
@@ -40,6 +40,10 @@ or implied, of Sebastian Gesemann.
 #define FIFOMASK (FIFOSIZE-1)   /* bit mask for FIFO offsets */
 #define CTABLES ((HTAPS+7)/8)   /* number of "8 MACs" lookup tables */
 
+#if CTABLES != DSD2PCM_CTABLES
+#error "DSD2PCM_CTABLES mismatch"
+#endif
+
 #if FIFOSIZE*8 < HTAPS*2
 #error "FIFOSIZE too small"
 #endif
@@ -137,6 +141,12 @@ static void precalc(void)
 	precalculated = 1;
 }
 
+extern const float *dsd2pcm_get_ctables(void)
+{
+	if (!precalculated) precalc();
+	return &ctables[0][0];
+}
+
 struct dsd2pcm_ctx_s
 {
 	unsigned char fifo[FIFOSIZE];
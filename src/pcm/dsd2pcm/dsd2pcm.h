@@ -40,6 +40,12 @@ extern "C" {
 
 struct dsd2pcm_ctx_s;
 
+/**
+ * the number of "8 MACs" lookup tables returned by
+ * dsd2pcm_get_ctables()
+ */
+#define DSD2PCM_CTABLES 6
+
 typedef struct dsd2pcm_ctx_s dsd2pcm_ctx;
 
 /**
@@ -86,6 +92,21 @@ extern void dsd2pcm_translate(dsd2pcm_ctx *ctx,
 	int lsbitfirst,
 	float *dst, ptrdiff_t dst_stride);
 
+/**
+ * returns the precomputed coefficient tables (DSD2PCM_CTABLES tables
+ * of 256 floats each), computing them if necessary; this allows
+ * alternative (e.g. vectorized) implementations of
+ * dsd2pcm_translate()
+ *
+ * Output sample i is the sum of ctables[k][x(i-k)] and
+ * ctables[k][bit_reverse(x(i-11+k))] for k=0..5, where x is the
+ * stream of (MSB first) input octets.
+ *
+ * Like dsd2pcm_init(), this is not thread-safe when called for the
+ * first time.
+ */
+extern const float *dsd2pcm_get_ctables(void);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "CueCache.hxx"
+
+bool
+CueCache::Lookup(const std::string &path, time_t mtime, uint64_t size,
+		 std::forward_list<DetachedSong> &tracks)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(path);
+	if (i == map.end())
+		return false;
+
+	const List::iterator entry = i->second;
+	if (entry->mtime != mtime || entry->size != size) {
+		/* the file has been modified; the entry is stale */
+		list.erase(entry);
+		map.erase(i);
+		return false;
+	}
+
+	/* mark it "most recently used" */
+	list.splice(list.begin(), list, entry);
+
+	tracks = entry->tracks;
+	return true;
+}
+
+void
+CueCache::Store(const std::string &path, time_t mtime, uint64_t size,
+		const std::forward_list<DetachedSong> &tracks)
+{
+	if (capacity == 0)
+		return;
+
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(path);
+	if (i != map.end()) {
+		list.erase(i->second);
+		map.erase(i);
+	} else if (map.size() >= capacity) {
+		/* evict the least recently used entry */
+		map.erase(list.back().path);
+		list.pop_back();
+	}
+
+	list.emplace_front(path, mtime, size, tracks);
+	map.emplace(path, list.begin());
+}
+
+void
+CueCache::Clear()
+{
+	const ScopeLock protect(mutex);
+
+	map.clear();
+	list.clear();
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CUE_CACHE_HXX
+#define MPD_CUE_CACHE_HXX
+
+#include "check.h"
+#include "DetachedSong.hxx"
+#include "thread/Mutex.hxx"
+#include "Compiler.h"
+
+#include <forward_list>
+#include <list>
+#include <map>
+#include <string>
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * A cache of parsed CUE sheets (the track table), keyed by the file
+ * name.  Each entry remembers the modification time and the size of
+ * the file it was parsed from; a lookup misses when the file has
+ * been modified since.  This avoids opening a file and parsing its
+ * tags again each time its embedded CUE sheet is accessed.
+ *
+ * An empty track list is a valid entry: it means the file does not
+ * contain a CUE sheet.
+ *
+ * When the cache is full, the least recently used entry is evicted.
+ * This class is thread-safe.
+ */
+class CueCache {
+	struct Entry {
+		std::string path;
+		time_t mtime;
+		uint64_t size;
+
+		std::forward_list<DetachedSong> tracks;
+
+		template<typename P, typename T>
+		Entry(P &&_path, time_t _mtime, uint64_t _size, T &&_tracks)
+			:path(std::forward<P>(_path)),
+			 mtime(_mtime), size(_size),
+			 tracks(std::forward<T>(_tracks)) {}
+	};
+
+	typedef std::list<Entry> List;
+
+	const unsigned capacity;
+
+	mutable Mutex mutex;
+
+	/**
+	 * All entries, the most recently used one first.
+	 */
+	List list;
+
+	std::map<std::string, List::iterator> map;
+
+public:
+	explicit CueCache(unsigned _capacity):capacity(_capacity) {}
+
+	CueCache(const CueCache &) = delete;
+	CueCache &operator=(const CueCache &) = delete;
+
+	gcc_pure
+	unsigned GetSize() const {
+		const ScopeLock protect(mutex);
+		return map.size();
+	}
+
+	/**
+	 * Look up a file.  On success, a copy of the track list is
+	 * returned in #tracks.
+	 *
+	 * @return true if a valid entry was found
+	 */
+	bool Lookup(const std::string &path, time_t mtime, uint64_t size,
+		    std::forward_list<DetachedSong> &tracks);
+
+	/**
+	 * Add (or replace) the entry for the specified file.
+	 */
+	void Store(const std::string &path, time_t mtime, uint64_t size,
+		   const std::forward_list<DetachedSong> &tracks);
+
+	void Clear();
+};
+
+#endif
@@ -26,110 +26,99 @@
 #include "config.h"
 #include "EmbeddedCuePlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../SongEnumerator.hxx"
+#include "../MemorySongEnumerator.hxx"
 #include "../cue/CueParser.hxx"
+#include "../cue/CueCache.hxx"
 #include "tag/TagHandler.hxx"
 #include "tag/TagId3.hxx"
 #include "tag/ApeTag.hxx"
+#include "tag/TagScanFile.hxx"
 #include "DetachedSong.hxx"
 #include "TagFile.hxx"
 #include "fs/Traits.hxx"
 #include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
 #include "util/ASCII.hxx"
 
 #include <string.h>
 
-class EmbeddedCuePlaylist final : public SongEnumerator {
-public:
-	/**
-	 * This is an override for the CUE's "FILE".  An embedded CUE
-	 * sheet must always point to the song file it is contained
-	 * in.
-	 */
-	std::string filename;
-
-	/**
-	 * The value of the file's "CUESHEET" tag.
-	 */
-	std::string cuesheet;
-
-	/**
-	 * The offset of the next line within "cuesheet".
-	 */
-	char *next;
-
-	CueParser *parser;
-
-public:
-	EmbeddedCuePlaylist()
-		:parser(nullptr) {
-	}
-
-	virtual ~EmbeddedCuePlaylist() {
-		delete parser;
-	}
+/**
+ * The number of files whose track tables are cached.
+ */
+static constexpr unsigned EMBCUE_CACHE_SIZE = 256;
 
-	virtual DetachedSong *NextSong() override;
-};
+/**
+ * The track tables of recently opened files, so a file needs to be
+ * scanned again only after it has been modified.
+ */
+static CueCache embcue_cache(EMBCUE_CACHE_SIZE);
 
 static void
 embcue_tag_pair(const char *name, const char *value, void *ctx)
 {
-	EmbeddedCuePlaylist *playlist = (EmbeddedCuePlaylist *)ctx;
+	std::string &cuesheet = *(std::string *)ctx;
 
-	if (playlist->cuesheet.empty() &&
-	    StringEqualsCaseASCII(name, "cuesheet"))
-		playlist->cuesheet = value;
+	if (cuesheet.empty() && StringEqualsCaseASCII(name, "cuesheet"))
+		cuesheet = value;
 }
 
 static const struct tag_handler embcue_tag_handler = {
 	nullptr,
 	nullptr,
 	embcue_tag_pair,
+	nullptr,
 };
 
-static SongEnumerator *
-embcue_playlist_open_uri(const char *uri,
-			 gcc_unused Mutex &mutex,
-			 gcc_unused Cond &cond)
+/**
+ * Read the value of the file's "CUESHEET" tag.
+ *
+ * @return an empty string if there is none
+ */
+static std::string
+embcue_scan_cuesheet(Path path_fs)
 {
-	if (!PathTraitsUTF8::IsAbsolute(uri))
-		/* only local files supported */
-		return nullptr;
-
-	const auto path_fs = AllocatedPath::FromUTF8(uri);
-	if (path_fs.IsNull())
-		return nullptr;
-
-	const auto playlist = new EmbeddedCuePlaylist();
-
-	tag_file_scan(path_fs, embcue_tag_handler, playlist);
-	if (playlist->cuesheet.empty()) {
-		tag_ape_scan2(path_fs, &embcue_tag_handler, playlist);
-		if (playlist->cuesheet.empty())
-			tag_id3_scan(path_fs, &embcue_tag_handler, playlist);
-	}
+	std::string cuesheet;
 
-	if (playlist->cuesheet.empty()) {
-		/* no "CUESHEET" tag found */
-		delete playlist;
-		return nullptr;
+	tag_file_scan(path_fs, embcue_tag_handler, &cuesheet);
+	if (cuesheet.empty()) {
+		LocalTagScanFile file(path_fs);
+		if (file.IsDefined()) {
+			tag_ape_scan2(file, &embcue_tag_handler, &cuesheet);
+			if (cuesheet.empty())
+				tag_id3_scan(file, &embcue_tag_handler,
+					     &cuesheet);
+		}
 	}
 
-	playlist->filename = PathTraitsUTF8::GetBase(uri);
-
-	playlist->next = &playlist->cuesheet[0];
-	playlist->parser = new CueParser();
+	return cuesheet;
+}
 
-	return playlist;
+static void
+embcue_add_songs(CueParser &parser, const std::string &filename,
+		 std::forward_list<DetachedSong> &tracks,
+		 std::forward_list<DetachedSong>::iterator &tail)
+{
+	DetachedSong *song;
+	while ((song = parser.Get()) != nullptr) {
+		/* an embedded CUE sheet must always point to the
+		   song file it is contained in, regardless of its
+		   "FILE" */
+		song->SetURI(filename);
+		tail = tracks.emplace_after(tail, std::move(*song));
+		delete song;
+	}
 }
 
-DetachedSong *
-EmbeddedCuePlaylist::NextSong()
+/**
+ * Parse the CUE sheet line by line into a track table.  The buffer
+ * is modified.
+ */
+static void
+embcue_parse(char *next, const std::string &filename,
+	     std::forward_list<DetachedSong> &tracks)
 {
-	DetachedSong *song = parser->Get();
-	if (song != nullptr)
-		return song;
+	CueParser parser;
+	auto tail = tracks.before_begin();
 
 	while (*next != 0) {
 		const char *line = next;
@@ -143,19 +132,57 @@ EmbeddedCuePlaylist::NextSong()
 			   end of the buffer */
 			next += strlen(line);
 
-		parser->Feed(line);
-		song = parser->Get();
-		if (song != nullptr) {
-			song->SetURI(filename);
-			return song;
-		}
+		parser.Feed(line);
+		embcue_add_songs(parser, filename, tracks, tail);
 	}
 
-	parser->Finish();
-	song = parser->Get();
-	if (song != nullptr)
-		song->SetURI(filename);
-	return song;
+	parser.Finish();
+	embcue_add_songs(parser, filename, tracks, tail);
+}
+
+static SongEnumerator *
+embcue_playlist_open_uri(const char *uri,
+			 gcc_unused Mutex &mutex,
+			 gcc_unused Cond &cond)
+{
+	if (!PathTraitsUTF8::IsAbsolute(uri))
+		/* only local files supported */
+		return nullptr;
+
+	const auto path_fs = AllocatedPath::FromUTF8(uri);
+	if (path_fs.IsNull())
+		return nullptr;
+
+	FileInfo info;
+	const bool cacheable = GetFileInfo(path_fs, info) &&
+		info.IsRegular();
+
+	std::forward_list<DetachedSong> tracks;
+	if (!cacheable ||
+	    !embcue_cache.Lookup(uri, info.GetModificationTime(),
+				 info.GetSize(), tracks)) {
+		std::string cuesheet = embcue_scan_cuesheet(path_fs);
+		if (!cuesheet.empty())
+			embcue_parse(&cuesheet[0],
+				     PathTraitsUTF8::GetBase(uri), tracks);
+
+		/* files without a CUE sheet are remembered, too */
+		if (cacheable)
+			embcue_cache.Store(uri, info.GetModificationTime(),
+					   info.GetSize(), tracks);
+	}
+
+	if (tracks.empty())
+		/* no "CUESHEET" tag found */
+		return nullptr;
+
+	return new MemorySongEnumerator(std::move(tracks));
+}
+
+static void
+embcue_playlist_finish()
+{
+	embcue_cache.Clear();
 }
 
 static const char *const embcue_playlist_suffixes[] = {
@@ -174,7 +201,7 @@ const struct playlist_plugin embcue_playlist_plugin = {
 	"embcue",
 
 	nullptr,
-	nullptr,
+	embcue_playlist_finish,
 	embcue_playlist_open_uri,
 	nullptr,
 
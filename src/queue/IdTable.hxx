@@ -22,69 +22,201 @@
 
 #include "Compiler.h"
 
-#include <algorithm>
-
 #include <assert.h>
 
 /**
- * A table that maps id numbers to position numbers.
+ * A table that maps id numbers to queue items.
+ *
+ * It is an open addressing hash table with linear probing; its
+ * memory usage depends on the number of items, not on the size of
+ * the id number space.
  */
+template<typename T>
 class IdTable {
-	unsigned size;
+	struct Slot {
+		unsigned id;
+		T *item;
+	};
+
+	static constexpr unsigned MIN_CAPACITY = 16;
+
+	/**
+	 * The size of the id number space; ids are between 1 and
+	 * limit-1.
+	 */
+	unsigned limit;
 
 	unsigned next;
 
-	int *data;
+	/** the number of ids in use */
+	unsigned count;
+
+	/** the number of slots; always a power of two */
+	unsigned capacity;
+
+	Slot *slots;
 
 public:
-	IdTable(unsigned _size):size(_size), next(1), data(new int[size]) {
-		std::fill_n(data, size, -1);
+	IdTable(unsigned _limit)
+		:limit(_limit), next(1), count(0),
+		 capacity(MIN_CAPACITY), slots(new Slot[capacity]) {
+		Clear(slots, capacity);
 	}
 
 	~IdTable() {
-		delete[] data;
+		delete[] slots;
 	}
 
-	int IdToPosition(unsigned id) const {
-		return id < size
-			? data[id]
-			: -1;
+	IdTable(const IdTable &) = delete;
+	IdTable &operator=(const IdTable &) = delete;
+
+	/**
+	 * @return the item or nullptr if the id is not known
+	 */
+	gcc_pure
+	T *Lookup(unsigned id) const {
+		if (id == 0)
+			return nullptr;
+
+		for (unsigned i = Hash(id);; i = (i + 1) & Mask()) {
+			const Slot &slot = slots[i];
+			if (slot.id == id)
+				return slot.item;
+			if (slot.id == 0)
+				return nullptr;
+		}
 	}
 
 	unsigned GenerateId() {
 		assert(next > 0);
-		assert(next < size);
+		assert(next < limit);
+		assert(count + 1 < limit);
 
 		while (true) {
 			unsigned id = next;
 
 			++next;
-			if (next == size)
+			if (next == limit)
 				next = 1;
 
-			if (data[id] < 0)
+			if (Lookup(id) == nullptr)
 				return id;
 		}
 	}
 
-	unsigned Insert(unsigned position) {
+	/**
+	 * Make room for the specified number of additional ids.
+	 */
+	void Reserve(unsigned n) {
+		unsigned new_capacity = capacity;
+		while ((count + n) * 2 > new_capacity)
+			new_capacity *= 2;
+
+		if (new_capacity != capacity)
+			Resize(new_capacity);
+	}
+
+	unsigned Insert(T &item) {
+		if ((count + 1) * 2 > capacity)
+			Resize(capacity * 2);
+
 		unsigned id = GenerateId();
-		data[id] = position;
+		Slot &slot = FindFree(slots, Mask(), id);
+		slot.id = id;
+		slot.item = &item;
+		++count;
 		return id;
 	}
 
-	void Move(unsigned id, unsigned position) {
-		assert(id < size);
-		assert(data[id] >= 0);
+	void Move(unsigned id, T &item) {
+		Slot *slot = Find(id);
+		assert(slot != nullptr);
 
-		data[id] = position;
+		slot->item = &item;
 	}
 
 	void Erase(unsigned id) {
-		assert(id < size);
-		assert(data[id] >= 0);
+		Slot *slot = Find(id);
+		assert(slot != nullptr);
+		assert(count > 0);
+
+		--count;
+
+		/* backward shift deletion: move following entries of
+		   the cluster into the gap, so lookups never need
+		   tombstones */
+		unsigned gap = slot - slots;
+		for (unsigned i = (gap + 1) & Mask(); slots[i].id != 0;
+		     i = (i + 1) & Mask()) {
+			const unsigned home = Hash(slots[i].id);
+			if (((i - home) & Mask()) >= ((i - gap) & Mask())) {
+				slots[gap] = slots[i];
+				gap = i;
+			}
+		}
+
+		slots[gap].id = 0;
+
+		if (capacity > MIN_CAPACITY && count * 8 < capacity)
+			Resize(capacity / 2);
+	}
+
+private:
+	unsigned Mask() const {
+		return capacity - 1;
+	}
+
+	/**
+	 * Ids are allocated sequentially, so the low bits are a good
+	 * enough hash.
+	 */
+	static unsigned Hash(unsigned id, unsigned mask) {
+		return id & mask;
+	}
+
+	unsigned Hash(unsigned id) const {
+		return Hash(id, Mask());
+	}
+
+	static void Clear(Slot *s, unsigned n) {
+		for (unsigned i = 0; i < n; ++i)
+			s[i].id = 0;
+	}
+
+	Slot *Find(unsigned id) {
+		assert(id > 0);
+
+		for (unsigned i = Hash(id);; i = (i + 1) & Mask()) {
+			Slot &slot = slots[i];
+			if (slot.id == id)
+				return &slot;
+			if (slot.id == 0)
+				return nullptr;
+		}
+	}
+
+	static Slot &FindFree(Slot *s, unsigned mask, unsigned id) {
+		unsigned i = Hash(id, mask);
+		while (s[i].id != 0)
+			i = (i + 1) & mask;
+		return s[i];
+	}
+
+	void Resize(unsigned new_capacity) {
+		Slot *old_slots = slots;
+		const unsigned old_capacity = capacity;
+
+		slots = new Slot[new_capacity];
+		capacity = new_capacity;
+		Clear(slots, capacity);
+
+		for (unsigned i = 0; i < old_capacity; ++i) {
+			const Slot &slot = old_slots[i];
+			if (slot.id != 0)
+				FindFree(slots, Mask(), slot.id) = slot;
+		}
 
-		data[id] = -1;
+		delete[] old_slots;
 	}
 };
 
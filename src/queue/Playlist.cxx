@@ -177,10 +177,17 @@ playlist::SyncWithPlayer(PlayerControl &pc)
 		return;
 
 	pc.Lock();
+	const bool pc_busy = pc.IsCommandPending();
 	const PlayerState pc_state = pc.GetState();
 	const DetachedSong *pc_next_song = pc.next_song;
 	pc.Unlock();
 
+	if (pc_busy)
+		/* the player thread is still working on an
+		   asynchronous command (e.g. a seek); it will
+		   request another sync when it has finished */
+		return;
+
 	if (pc_state == PlayerState::STOP)
 		/* the player thread has stopped: check if playback
 		   should be restarted with the next song.  That can
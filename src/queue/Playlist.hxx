@@ -27,6 +27,7 @@ enum TagType : uint8_t;
 struct PlayerControl;
 class DetachedSong;
 class Database;
+class Storage;
 class Error;
 class SongLoader;
 class SongTime;
@@ -192,6 +193,15 @@ public:
 	 * The database has been modified.  Pull all updates.
 	 */
 	void DatabaseModified(const Database &db);
+
+	/**
+	 * A storage has been mounted on (or unmounted from) the
+	 * specified mount point.  The real URIs of the affected songs,
+	 * which were mapped when they were added, are mapped again, so
+	 * the decoder does not open a stale location.
+	 */
+	void StorageMountChanged(const Storage &storage,
+				 const char *mount_point);
 #endif
 
 	/**
@@ -201,6 +211,19 @@ public:
 			    DetachedSong &&song,
 			    Error &error);
 
+	/**
+	 * Append many songs at once.  The playlist takes ownership of
+	 * the #DetachedSong objects.  This is much faster than
+	 * calling AppendSong() for each one: the new songs are
+	 * shuffled and the version is incremented only once.
+	 *
+	 * If there is not enough room, as many songs as possible are
+	 * added, the rest is freed, and an error is returned.
+	 */
+	bool AppendSongs(PlayerControl &pc,
+			 DetachedSong *const*songs, unsigned n,
+			 Error &error);
+
 	/**
 	 * @return the new song id or 0 on error
 	 */
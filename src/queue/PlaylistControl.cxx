@@ -216,8 +216,10 @@ playlist::SeekSongOrder(PlayerControl &pc, unsigned i, SongTime seek_time)
 		return PlaylistResult::NOT_PLAYING;
 	}
 
+	/* the seek is asynchronous; the next song will be queued
+	   by SyncWithPlayer() when the player thread has finished
+	   it */
 	queued = -1;
-	UpdateQueuedSong(pc, nullptr);
 
 	return PlaylistResult::SUCCESS;
 }
@@ -254,6 +256,10 @@ playlist::SeekCurrent(PlayerControl &pc,
 		return PlaylistResult::NOT_PLAYING;
 
 	if (relative) {
+		/* the position must not be reported by
+		   GetStatus() before a previous seek has finished */
+		pc.LockWaitCommand();
+
 		const auto status = pc.GetStatus();
 
 		if (status.state != PlayerState::PLAY &&
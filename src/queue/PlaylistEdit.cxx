@@ -89,14 +89,20 @@ playlist::CommitBulk(PlayerControl &pc)
 	OnModified();
 }
 
+static void
+SetTooLargeError(Error &error)
+{
+	error.Set(playlist_domain, int(PlaylistResult::TOO_LARGE),
+		  "Playlist is too large");
+}
+
 unsigned
 playlist::AppendSong(PlayerControl &pc, DetachedSong &&song, Error &error)
 {
 	unsigned id;
 
 	if (queue.IsFull()) {
-		error.Set(playlist_domain, int(PlaylistResult::TOO_LARGE),
-			  "Playlist is too large");
+		SetTooLargeError(error);
 		return 0;
 	}
 
@@ -114,7 +120,8 @@ playlist::AppendSong(PlayerControl &pc, DetachedSong &&song, Error &error)
 		else
 			start = current + 1;
 		if (start < queue.GetLength())
-			queue.ShuffleOrderLast(start, queue.GetLength());
+			queue.ShuffleOrderLastWithPriority(start,
+							   queue.GetLength());
 	}
 
 	UpdateQueuedSong(pc, queued_song);
@@ -123,6 +130,56 @@ playlist::AppendSong(PlayerControl &pc, DetachedSong &&song, Error &error)
 	return id;
 }
 
+bool
+playlist::AppendSongs(PlayerControl &pc,
+		      DetachedSong *const*songs, unsigned n,
+		      Error &error)
+{
+	const unsigned room = queue.max_length - queue.GetLength();
+	const bool too_large = n > room;
+	if (too_large) {
+		for (unsigned i = room; i < n; ++i)
+			delete songs[i];
+
+		n = room;
+	}
+
+	if (n > 0) {
+		const DetachedSong *const queued_song = GetQueuedSong();
+
+		queue.Append(songs, n, 0);
+
+		if (queue.random) {
+			/* shuffle the new songs into the list of
+			   remaining songs to play, one after another
+			   (an "inside-out" Fisher-Yates shuffle), so
+			   the songs which were already there need not
+			   be shuffled again */
+
+			unsigned start;
+			if (queued >= 0)
+				start = queued + 1;
+			else
+				start = current + 1;
+
+			const unsigned length = queue.GetLength();
+			for (unsigned end = std::max(start, length - n) + 1;
+			     end <= length; ++end)
+				queue.ShuffleOrderLastWithPriority(start, end);
+		}
+
+		UpdateQueuedSong(pc, queued_song);
+		OnModified();
+	}
+
+	if (too_large) {
+		SetTooLargeError(error);
+		return false;
+	}
+
+	return true;
+}
+
 unsigned
 playlist::AppendURI(PlayerControl &pc, const SongLoader &loader,
 		    const char *uri,
@@ -325,8 +382,12 @@ playlist::DeleteId(PlayerControl &pc, unsigned id)
 void
 playlist::DeleteSong(PlayerControl &pc, const char *uri)
 {
+	/* look up the shared string once, and then compare only
+	   pointers */
+	const SharedUri key(uri);
+
 	for (int i = queue.GetLength() - 1; i >= 0; --i)
-		if (queue.Get(i).IsURI(uri))
+		if (queue.Get(i).IsURI(key))
 			DeletePosition(pc, i);
 }
 
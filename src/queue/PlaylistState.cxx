@@ -51,14 +51,17 @@
 #define PLAYLIST_STATE_FILE_MIXRAMPDELAY	"mixrampdelay: "
 #define PLAYLIST_STATE_FILE_PLAYLIST_BEGIN	"playlist_begin"
 #define PLAYLIST_STATE_FILE_PLAYLIST_END	"playlist_end"
+#define PLAYLIST_STATE_FILE_CHANGES_BEGIN	"playlist_changes_begin: "
+#define PLAYLIST_STATE_FILE_CHANGES_END		"playlist_changes_end"
 
 #define PLAYLIST_STATE_FILE_STATE_PLAY		"play"
 #define PLAYLIST_STATE_FILE_STATE_PAUSE		"pause"
 #define PLAYLIST_STATE_FILE_STATE_STOP		"stop"
 
-void
-playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
-		    PlayerControl &pc)
+static void
+playlist_state_save_status(BufferedOutputStream &os,
+			   const struct playlist &playlist,
+			   PlayerControl &pc)
 {
 	const auto player_status = pc.GetStatus();
 
@@ -93,14 +96,33 @@ playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
 	os.Format(PLAYLIST_STATE_FILE_MIXRAMPDB "%f\n", pc.GetMixRampDb());
 	os.Format(PLAYLIST_STATE_FILE_MIXRAMPDELAY "%f\n",
 		  pc.GetMixRampDelay());
+}
+
+void
+playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
+		    PlayerControl &pc)
+{
+	playlist_state_save_status(os, playlist, pc);
 	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_BEGIN "\n");
 	queue_save(os, playlist.queue);
 	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_END "\n");
 }
 
+unsigned
+playlist_state_save_changes(BufferedOutputStream &os,
+			    const struct playlist &playlist,
+			    PlayerControl &pc, uint32_t version)
+{
+	playlist_state_save_status(os, playlist, pc);
+	os.Format(PLAYLIST_STATE_FILE_CHANGES_BEGIN "%u\n",
+		  playlist.queue.GetLength());
+	const unsigned n = queue_save_changes(os, playlist.queue, version);
+	os.Write(PLAYLIST_STATE_FILE_CHANGES_END "\n");
+	return n;
+}
+
 static void
-playlist_state_load(TextFile &file, const SongLoader &song_loader,
-		    struct playlist &playlist)
+playlist_state_load(TextFile &file, QueueLoader &queue_loader)
 {
 	const char *line = file.ReadLine();
 	if (line == nullptr) {
@@ -109,7 +131,7 @@ playlist_state_load(TextFile &file, const SongLoader &song_loader,
 	}
 
 	while (!StringStartsWith(line, PLAYLIST_STATE_FILE_PLAYLIST_END)) {
-		queue_load_song(file, song_loader, line, playlist.queue);
+		queue_loader.LoadSong(file, line);
 
 		line = file.ReadLine();
 		if (line == nullptr) {
@@ -119,8 +141,42 @@ playlist_state_load(TextFile &file, const SongLoader &song_loader,
 			break;
 		}
 	}
+}
 
-	playlist.queue.IncrementVersion();
+/**
+ * Load a journal block which was appended by
+ * playlist_state_save_changes().  An incomplete block (from an
+ * interrupted write) is ignored.
+ */
+static void
+playlist_state_load_changes(TextFile &file, unsigned length,
+			    QueueLoader &queue_loader)
+{
+	const char *line;
+	while ((line = file.ReadLine()) != nullptr) {
+		if (StringStartsWith(line, PLAYLIST_STATE_FILE_CHANGES_END)) {
+			queue_loader.ApplyChanges(length);
+			return;
+		}
+
+		queue_loader.LoadChange(file, line);
+	}
+
+	LogWarning(playlist_domain,
+		   "'" PLAYLIST_STATE_FILE_CHANGES_END
+		   "' not found in state file");
+	queue_loader.DiscardChanges();
+}
+
+static PlayerState
+playlist_state_parse(const char *line)
+{
+	if (strcmp(line, PLAYLIST_STATE_FILE_STATE_PLAY) == 0)
+		return PlayerState::PLAY;
+	else if (strcmp(line, PLAYLIST_STATE_FILE_STATE_PAUSE) == 0)
+		return PlayerState::PAUSE;
+	else
+		return PlayerState::STOP;
 }
 
 bool
@@ -135,18 +191,20 @@ playlist_state_restore(const char *line, TextFile &file,
 	if (!StringStartsWith(line, PLAYLIST_STATE_FILE_STATE))
 		return false;
 
-	line += sizeof(PLAYLIST_STATE_FILE_STATE) - 1;
+	PlayerState state =
+		playlist_state_parse(line + sizeof(PLAYLIST_STATE_FILE_STATE) - 1);
 
-	PlayerState state;
-	if (strcmp(line, PLAYLIST_STATE_FILE_STATE_PLAY) == 0)
-		state = PlayerState::PLAY;
-	else if (strcmp(line, PLAYLIST_STATE_FILE_STATE_PAUSE) == 0)
-		state = PlayerState::PAUSE;
-	else
-		state = PlayerState::STOP;
+	QueueLoader queue_loader;
 
 	while ((line = file.ReadLine()) != nullptr) {
-		if (StringStartsWith(line, PLAYLIST_STATE_FILE_TIME)) {
+		if (StringStartsWith(line, PLAYLIST_STATE_FILE_STATE)) {
+			/* a journal block begins with a new copy of
+			   the playback state */
+			line += sizeof(PLAYLIST_STATE_FILE_STATE) - 1;
+			state = playlist_state_parse(line);
+			current = -1;
+			seek_time = SongTime::zero();
+		} else if (StringStartsWith(line, PLAYLIST_STATE_FILE_TIME)) {
 			double seconds = atof(line + strlen(PLAYLIST_STATE_FILE_TIME));
 			seek_time = SongTime::FromS(seconds);
 		} else if (StringStartsWith(line, PLAYLIST_STATE_FILE_REPEAT)) {
@@ -181,10 +239,18 @@ playlist_state_restore(const char *line, TextFile &file,
 					  (PLAYLIST_STATE_FILE_CURRENT)]));
 		} else if (StringStartsWith(line,
 					    PLAYLIST_STATE_FILE_PLAYLIST_BEGIN)) {
-			playlist_state_load(file, song_loader, playlist);
+			playlist_state_load(file, queue_loader);
+		} else if (StringStartsWith(line,
+					    PLAYLIST_STATE_FILE_CHANGES_BEGIN)) {
+			const char *p = line + strlen(PLAYLIST_STATE_FILE_CHANGES_BEGIN);
+			playlist_state_load_changes(file, strtoul(p, nullptr, 10),
+						    queue_loader);
 		}
 	}
 
+	queue_loader.Commit(song_loader, playlist.queue);
+	playlist.queue.IncrementVersion();
+
 	playlist.SetRandom(pc, random_mode);
 
 	if (!playlist.queue.IsEmpty()) {
@@ -25,6 +25,8 @@
 #ifndef MPD_PLAYLIST_STATE_HXX
 #define MPD_PLAYLIST_STATE_HXX
 
+#include <stdint.h>
+
 struct playlist;
 struct PlayerControl;
 class TextFile;
@@ -35,6 +37,18 @@ void
 playlist_state_save(BufferedOutputStream &os, const playlist &playlist,
 		    PlayerControl &pc);
 
+/**
+ * Saves the playback state and the songs which were modified since
+ * the specified queue version.  The result is meant to be appended to
+ * a state file written by playlist_state_save().
+ *
+ * @return the number of songs which were saved
+ */
+unsigned
+playlist_state_save_changes(BufferedOutputStream &os,
+			    const playlist &playlist,
+			    PlayerControl &pc, uint32_t version);
+
 bool
 playlist_state_restore(const char *line, TextFile &file,
 		       const SongLoader &song_loader,
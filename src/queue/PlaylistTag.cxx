@@ -50,7 +50,7 @@ playlist::AddSongIdTag(unsigned id, TagType tag_type, const char *value,
 	}
 
 	{
-		TagBuilder tag(std::move(song.WritableTag()));
+		TagBuilder tag(song.GetTag());
 		tag.AddItem(tag_type, value);
 		song.SetTag(tag.Commit());
 	}
@@ -79,7 +79,7 @@ playlist::ClearSongIdTag(unsigned id, TagType tag_type,
 	}
 
 	{
-		TagBuilder tag(std::move(song.WritableTag()));
+		TagBuilder tag(song.GetTag());
 		if (tag_type == TAG_NUM_OF_ITEM_TYPES)
 			tag.RemoveAll();
 		else
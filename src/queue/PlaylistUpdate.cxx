@@ -21,9 +21,11 @@
 #include "Playlist.hxx"
 #include "db/Interface.hxx"
 #include "db/LightSong.hxx"
+#include "storage/StorageInterface.hxx"
 #include "DetachedSong.hxx"
 #include "tag/Tag.hxx"
 #include "Idle.hxx"
+#include "util/UriUtil.hxx"
 #include "util/Error.hxx"
 
 static bool
@@ -71,3 +73,17 @@ playlist::DatabaseModified(const Database &db)
 		idle_add(IDLE_PLAYLIST);
 	}
 }
+
+void
+playlist::StorageMountChanged(const Storage &storage, const char *mount_point)
+{
+	for (unsigned i = 0, n = queue.GetLength(); i != n; ++i) {
+		DetachedSong &song = queue.Get(i);
+		if (song.IsInDatabase() &&
+		    uri_is_child_or_same(mount_point, song.GetURI()))
+			song.SetRealURI(storage.MapUTF8(song.GetURI()));
+	}
+
+	/* the real URI is not visible to clients; no need to
+	   increment the queue version */
+}
@@ -21,11 +21,55 @@
 #include "Queue.hxx"
 #include "DetachedSong.hxx"
 
+void
+Queue::OrderItem::Update()
+{
+	min_priority = max_priority = item.priority;
+
+	if (left != nullptr) {
+		min_priority = std::min(min_priority, left->min_priority);
+		max_priority = std::max(max_priority, left->max_priority);
+	}
+
+	if (right != nullptr) {
+		min_priority = std::min(min_priority, right->min_priority);
+		max_priority = std::max(max_priority, right->max_priority);
+	}
+}
+
+void
+Queue::Item::Update()
+{
+	min_version = max_version = version;
+
+	if (left != nullptr) {
+		min_version = std::min(min_version, left->min_version);
+		max_version = std::max(max_version, left->max_version);
+	}
+
+	if (right != nullptr) {
+		min_version = std::min(min_version, right->min_version);
+		max_version = std::max(max_version, right->max_version);
+	}
+}
+
+void
+Queue::Item::Push()
+{
+	if (!has_pending)
+		return;
+
+	if (left != nullptr)
+		left->SetSubtreeVersion(pending_version);
+	if (right != nullptr)
+		right->SetSubtreeVersion(pending_version);
+
+	has_pending = false;
+}
+
 Queue::Queue(unsigned _max_length)
-	:max_length(_max_length), length(0),
+	:max_length(_max_length),
 	 version(1),
-	 items(new Item[max_length]),
-	 order(new unsigned[max_length]),
 	 id_table(max_length * HASH_MULT),
 	 repeat(false),
 	 single(false),
@@ -37,19 +81,16 @@ Queue::Queue(unsigned _max_length)
 Queue::~Queue()
 {
 	Clear();
-
-	delete[] items;
-	delete[] order;
 }
 
 int
 Queue::GetNextOrder(unsigned _order) const
 {
-	assert(_order < length);
+	assert(_order < GetLength());
 
 	if (single && repeat && !consume)
 		return _order;
-	else if (_order + 1 < length)
+	else if (_order + 1 < GetLength())
 		return _order + 1;
 	else if (repeat && (_order > 0 || !consume))
 		/* restart at first song */
@@ -59,6 +100,23 @@ Queue::GetNextOrder(unsigned _order) const
 		return -1;
 }
 
+unsigned
+Queue::FindNewerPosition(unsigned start, uint32_t _version) const
+{
+	if (_version > version)
+		return std::min(start, GetLength());
+
+	return items.FindFirst(start,
+			       [_version](const Item &item){
+				       return item.max_version >= _version ||
+					       item.min_version == 0;
+			       },
+			       [_version](const Item &item){
+				       return item.version >= _version ||
+					       item.version == 0;
+			       });
+}
+
 void
 Queue::IncrementVersion()
 {
@@ -67,8 +125,9 @@ Queue::IncrementVersion()
 	version++;
 
 	if (version >= max) {
-		for (unsigned i = 0; i < length; i++)
-			items[i].version = 0;
+		items.ApplyRange(0, GetLength(), [](Item &item){
+				item.SetSubtreeVersion(0);
+			});
 
 		version = 1;
 	}
@@ -77,10 +136,18 @@ Queue::IncrementVersion()
 void
 Queue::ModifyAtOrder(unsigned _order)
 {
-	assert(_order < length);
+	assert(_order < GetLength());
 
-	unsigned position = order[_order];
-	ModifyAtPosition(position);
+	ModifyItem(order.At(_order).item);
+}
+
+void
+Queue::ModifyRange(unsigned start, unsigned end)
+{
+	const uint32_t v = version;
+	items.ApplyRange(start, end, [v](Item &item){
+			item.SetSubtreeVersion(v);
+		});
 }
 
 unsigned
@@ -88,195 +155,138 @@ Queue::Append(DetachedSong &&song, uint8_t priority)
 {
 	assert(!IsFull());
 
-	const unsigned position = length++;
-	const unsigned id = id_table.Insert(position);
+	Item *item = new Item(new DetachedSong(std::move(song)), 0,
+			      version, priority);
+	item->id = id_table.Insert(*item);
 
-	auto &item = items[position];
-	item.song = new DetachedSong(std::move(song));
-	item.id = id;
-	item.version = version;
-	item.priority = priority;
+	items.PushBack(*item);
+	order.PushBack(item->order);
 
-	order[position] = position;
-
-	return id;
+	return item->id;
 }
 
 void
-Queue::SwapPositions(unsigned position1, unsigned position2)
+Queue::Append(DetachedSong *const*songs, unsigned n, uint8_t priority)
 {
-	unsigned id1 = items[position1].id;
-	unsigned id2 = items[position2].id;
+	assert(GetLength() + n <= max_length);
 
-	std::swap(items[position1], items[position2]);
+	std::vector<Item *> new_items;
+	std::vector<OrderItem *> new_order;
+	new_items.reserve(n);
+	new_order.reserve(n);
+	id_table.Reserve(n);
 
-	items[position1].version = version;
-	items[position2].version = version;
+	for (unsigned i = 0; i < n; ++i) {
+		Item *item = new Item(songs[i], 0, version, priority);
+		item->id = id_table.Insert(*item);
 
-	id_table.Move(id1, position2);
-	id_table.Move(id2, position1);
+		new_items.push_back(item);
+		new_order.push_back(&item->order);
+	}
+
+	items.PushBack(new_items.data(), n);
+	order.PushBack(new_order.data(), n);
 }
 
 void
-Queue::MovePostion(unsigned from, unsigned to)
+Queue::SwapPositions(unsigned position1, unsigned position2)
 {
-	const Item tmp = items[from];
-
-	/* move songs to one less in from->to */
-
-	for (unsigned i = from; i < to; i++)
-		MoveItemTo(i + 1, i);
+	Item &item1 = items.At(position1);
+	Item &item2 = items.At(position2);
 
-	/* move songs to one more in to->from */
+	/* the nodes stay where they are, only the songs are
+	   exchanged; just like the positions, the "order" list does
+	   not change */
 
-	for (unsigned i = from; i > to; i--)
-		MoveItemTo(i - 1, i);
+	std::swap(item1.song, item2.song);
+	std::swap(item1.id, item2.id);
+	std::swap(item1.priority, item2.priority);
 
-	/* put song at _to_ */
+	id_table.Move(item1.id, item1);
+	id_table.Move(item2.id, item2);
 
-	id_table.Move(tmp.id, to);
-	items[to] = tmp;
-	items[to].version = version;
+	ModifyItem(item1);
+	ModifyItem(item2);
 
-	/* now deal with order */
+	order.UpdatePath(item1.order);
+	order.UpdatePath(item2.order);
+}
 
-	if (random) {
-		for (unsigned i = 0; i < length; i++) {
-			if (order[i] > from && order[i] <= to)
-				order[i]--;
-			else if (order[i] < from &&
-				 order[i] >= to)
-				order[i]++;
-			else if (from == order[i])
-				order[i] = to;
-		}
-	}
+void
+Queue::MovePostion(unsigned from, unsigned to)
+{
+	MoveRange(from, from + 1, to);
 }
 
 void
 Queue::MoveRange(unsigned start, unsigned end, unsigned to)
 {
-	Item tmp[end - start];
-	// Copy the original block [start,end-1]
-	for (unsigned i = start; i < end; i++)
-		tmp[i - start] = items[i];
-
-	// If to > start, we need to move to-start items to start, starting from end
-	for (unsigned i = end; i < end + to - start; i++)
-		MoveItemTo(i, start + i - end);
-
-	// If to < start, we need to move start-to items to newend (= end + to - start), starting from to
-	// This is the same as moving items from start-1 to to (decreasing), with start-1 going to end-1
-	// We have to iterate in this order to avoid writing over something we haven't yet moved
-	for (int i = start - 1; i >= int(to); i--)
-		MoveItemTo(i, i + end - start);
-
-	// Copy the original block back in, starting at to.
-	for (unsigned i = start; i< end; i++)
-	{
-		id_table.Move(tmp[i - start].id, to + i - start);
-		items[to + i - start] = tmp[i-start];
-		items[to + i - start].version = version;
-	}
+	items.Move(start, end, to);
 
-	if (random) {
-		// Update the positions in the queue.
-		// Note that the ranges for these cases are the same as the ranges of
-		// the loops above.
-		for (unsigned i = 0; i < length; i++) {
-			if (order[i] >= end && order[i] < to + end - start)
-				order[i] -= end - start;
-			else if (order[i] < start &&
-				 order[i] >= to)
-				order[i] += end - start;
-			else if (start <= order[i] && order[i] < end)
-				order[i] += to - start;
-		}
-	}
+	/* all songs between the old and the new location have a new
+	   position */
+	ModifyRange(std::min(start, to), std::max(end, to + end - start));
+
+	/* in random mode, the "order" list refers to the items, which
+	   are still the same; without random, it must stay the
+	   identity */
+	if (!random)
+		order.Move(start, end, to);
 }
 
 void
 Queue::MoveOrder(unsigned from_order, unsigned to_order)
 {
-	assert(from_order < length);
-	assert(to_order <= length);
-
-	const unsigned from_position = OrderToPosition(from_order);
+	assert(from_order < GetLength());
+	assert(to_order < GetLength());
 
-	if (from_order < to_order) {
-		for (unsigned i = from_order; i < to_order; ++i)
-			order[i] = order[i + 1];
-	} else {
-		for (unsigned i = from_order; i > to_order; --i)
-			order[i] = order[i - 1];
-	}
-
-	order[to_order] = from_position;
+	order.Move(from_order, from_order + 1, to_order);
 }
 
 void
 Queue::DeletePosition(unsigned position)
 {
-	assert(position < length);
-
-	delete items[position].song;
+	assert(position < GetLength());
 
-	const unsigned id = PositionToId(position);
-	const unsigned _order = PositionToOrder(position);
-
-	--length;
+	Item &item = items.At(position);
 
 	/* release the song id */
 
-	id_table.Erase(id);
-
-	/* delete song from songs array */
+	id_table.Erase(item.id);
 
-	for (unsigned i = position; i < length; i++)
-		MoveItemTo(i + 1, i);
+	/* remove the item from both lists */
 
-	/* delete the entry from the order array */
+	order.Erase(item.order);
+	items.Erase(item);
 
-	for (unsigned i = _order; i < length; i++)
-		order[i] = order[i + 1];
+	delete item.song;
+	delete &item;
 
-	/* readjust values in the order array */
+	/* all following songs have a new position */
 
-	for (unsigned i = 0; i < length; i++)
-		if (order[i] > position)
-			--order[i];
+	ModifyRange(position, GetLength());
 }
 
 void
 Queue::Clear()
 {
-	for (unsigned i = 0; i < length; i++) {
-		Item *item = &items[i];
-
-		delete item->song;
+	order.Reset();
 
-		id_table.Erase(item->id);
-	}
-
-	length = 0;
+	items.ClearAndDispose([this](Item *item){
+			id_table.Erase(item->id);
+			delete item->song;
+			delete item;
+		});
 }
 
-static void
-queue_sort_order_by_priority(Queue *queue, unsigned start, unsigned end)
+void
+Queue::RestoreOrder()
 {
-	assert(queue != nullptr);
-	assert(queue->random);
-	assert(start <= end);
-	assert(end <= queue->length);
-
-	auto cmp = [queue](unsigned a_pos, unsigned b_pos){
-		const Queue::Item &a = queue->items[a_pos];
-		const Queue::Item &b = queue->items[b_pos];
+	order.Reset();
 
-		return a.priority > b.priority;
-	};
-
-	std::stable_sort(queue->order + start, queue->order + end, cmp);
+	items.ForEach([this](Item &item){
+			order.PushBack(item.order);
+		});
 }
 
 void
@@ -284,10 +294,12 @@ Queue::ShuffleOrderRange(unsigned start, unsigned end)
 {
 	assert(random);
 	assert(start <= end);
-	assert(end <= length);
+	assert(end <= GetLength());
 
 	rand.AutoCreate();
-	std::shuffle(order + start, order + end, rand);
+	order.ReorderRange(start, end, [this](std::vector<OrderItem *> &v){
+			std::shuffle(v.begin(), v.end(), rand);
+		});
 }
 
 /**
@@ -299,39 +311,44 @@ Queue::ShuffleOrderRangeWithPriority(unsigned start, unsigned end)
 {
 	assert(random);
 	assert(start <= end);
-	assert(end <= length);
-
-	if (start == end)
-		return;
-
-	/* first group the range by priority */
-	queue_sort_order_by_priority(this, start, end);
-
-	/* now shuffle each priority group */
-	unsigned group_start = start;
-	uint8_t group_priority = GetOrderPriority(start);
+	assert(end <= GetLength());
 
-	for (unsigned i = start + 1; i < end; ++i) {
-		const uint8_t priority = GetOrderPriority(i);
-		assert(priority <= group_priority);
-
-		if (priority != group_priority) {
-			/* start of a new group - shuffle the one that
-			   has just ended */
-			ShuffleOrderRange(group_start, i);
-			group_start = i;
-			group_priority = priority;
-		}
-	}
-
-	/* shuffle the last group */
-	ShuffleOrderRange(group_start, end);
+	rand.AutoCreate();
+	order.ReorderRange(start, end, [this](std::vector<OrderItem *> &v){
+			/* first group the range by priority: a counting
+			   sort with one bucket per priority value,
+			   highest first */
+			unsigned count[256] = {0};
+			for (const OrderItem *o : v)
+				++count[o->item.priority];
+
+			unsigned bucket_end[256];
+			unsigned offset = 0;
+			for (unsigned p = 256; p-- > 0;) {
+				offset += count[p];
+				bucket_end[p] = offset;
+			}
+
+			std::vector<OrderItem *> sorted(v.size());
+			for (auto i = v.rbegin(); i != v.rend(); ++i)
+				sorted[--bucket_end[(*i)->item.priority]] = *i;
+
+			/* now shuffle each priority group; bucket_end
+			   points to the beginning of each group now */
+			for (unsigned p = 0; p < 256; ++p)
+				if (count[p] > 1)
+					std::shuffle(sorted.begin() + bucket_end[p],
+						     sorted.begin() + bucket_end[p] + count[p],
+						     rand);
+
+			v.swap(sorted);
+		});
 }
 
 void
 Queue::ShuffleOrder()
 {
-	ShuffleOrderRangeWithPriority(0, length);
+	ShuffleOrderRangeWithPriority(0, GetLength());
 }
 
 void
@@ -352,11 +369,37 @@ Queue::ShuffleOrderLast(unsigned start, unsigned end)
 	SwapOrders(end - 1, distribution(rand));
 }
 
+void
+Queue::ShuffleOrderLastWithPriority(unsigned start, unsigned end)
+{
+	assert(random);
+	assert(start < end);
+	assert(end <= GetLength());
+
+	/* move the last item to the beginning of its priority group
+	   (the range is sorted by priority), and then swap it with a
+	   random member of that group */
+
+	const unsigned last = end - 1;
+	const uint8_t priority = GetOrderPriority(last);
+
+	unsigned group = FindPriorityOrder(start, priority, last);
+	if (group > last)
+		group = last;
+	else
+		MoveOrder(last, group);
+
+	const unsigned count = std::min(CountSamePriority(group, priority),
+					end - group);
+	assert(count >= 1);
+	ShuffleOrderFirst(group, group + count);
+}
+
 void
 Queue::ShuffleRange(unsigned start, unsigned end)
 {
 	assert(start <= end);
-	assert(end <= length);
+	assert(end <= GetLength());
 
 	rand.AutoCreate();
 
@@ -373,53 +416,61 @@ Queue::FindPriorityOrder(unsigned start_order, uint8_t priority,
 			 unsigned exclude_order) const
 {
 	assert(random);
-	assert(start_order <= length);
+	assert(start_order <= GetLength());
 
-	for (unsigned i = start_order; i < length; ++i) {
-		const unsigned position = OrderToPosition(i);
-		const Item *item = &items[position];
-		if (item->priority <= priority && i != exclude_order)
-			return i;
-	}
+	auto subtree = [priority](const OrderItem &o){
+		return o.min_priority <= priority;
+	};
+	auto node = [priority](const OrderItem &o){
+		return o.item.priority <= priority;
+	};
+
+	unsigned i = order.FindFirst(start_order, subtree, node);
+	if (i == exclude_order)
+		i = order.FindFirst(i + 1, subtree, node);
 
-	return length;
+	return i;
 }
 
 unsigned
 Queue::CountSamePriority(unsigned start_order, uint8_t priority) const
 {
 	assert(random);
-	assert(start_order <= length);
-
-	for (unsigned i = start_order; i < length; ++i) {
-		const unsigned position = OrderToPosition(i);
-		const Item *item = &items[position];
-		if (item->priority != priority)
-			return i - start_order;
-	}
-
-	return length - start_order;
+	assert(start_order <= GetLength());
+
+	const unsigned end =
+		order.FindFirst(start_order,
+				[priority](const OrderItem &o){
+					return o.min_priority != priority ||
+						o.max_priority != priority;
+				},
+				[priority](const OrderItem &o){
+					return o.item.priority != priority;
+				});
+
+	return end - start_order;
 }
 
 bool
 Queue::SetPriority(unsigned position, uint8_t priority, int after_order,
 		   bool reorder)
 {
-	assert(position < length);
+	assert(position < GetLength());
 
-	Item *item = &items[position];
+	Item *item = &items.At(position);
 	uint8_t old_priority = item->priority;
 	if (old_priority == priority)
 		return false;
 
-	item->version = version;
 	item->priority = priority;
+	ModifyItem(*item);
+	order.UpdatePath(item->order);
 
 	if (!random || !reorder)
 		/* don't reorder if not in random mode */
 		return true;
 
-	unsigned _order = PositionToOrder(position);
+	unsigned _order = order.Rank(item->order);
 	if (after_order >= 0) {
 		if (_order == (unsigned)after_order)
 			/* don't reorder the current song */
@@ -430,10 +481,8 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order,
 			   - enqueue it only if its priority has just
 			   become bigger than the current one's */
 
-			const unsigned after_position =
-				OrderToPosition(after_order);
 			const Item *after_item =
-				&items[after_position];
+				&GetOrderItem(after_order);
 			if (old_priority > after_item->priority ||
 			    priority <= after_item->priority)
 				/* priority hasn't become bigger */
@@ -465,7 +514,7 @@ Queue::SetPriorityRange(unsigned start_position, unsigned end_position,
 			uint8_t priority, int after_order)
 {
 	assert(start_position <= end_position);
-	assert(end_position <= length);
+	assert(end_position <= GetLength());
 
 	bool modified = false;
 	int after_position = after_order >= 0
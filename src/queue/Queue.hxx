@@ -22,6 +22,7 @@
 
 #include "Compiler.h"
 #include "IdTable.hxx"
+#include "RankTree.hxx"
 #include "util/LazyRandomEngine.hxx"
 
 #include <algorithm>
@@ -40,6 +41,10 @@ class DetachedSong;
  * - the position in the queue
  * - the unique id (which stays the same, regardless of moves)
  * - the order number (which only differs from "position" in random mode)
+ *
+ * Both the "position" list and the "order" list are #RankTree
+ * instances, so lookups and modifications are O(log n) even in very
+ * large queues.
  */
 struct Queue {
 	/**
@@ -48,11 +53,29 @@ struct Queue {
 	 */
 	static constexpr unsigned HASH_MULT = 4;
 
+	struct Item;
+
+	/**
+	 * A node in the "order" list.  It is embedded in its #Item.
+	 */
+	struct OrderItem final : RankTreeHook<OrderItem> {
+		Item &item;
+
+		/** the range of priorities in this subtree */
+		uint8_t min_priority, max_priority;
+
+		explicit OrderItem(Item &_item):item(_item) {}
+
+		void Update();
+
+		void Push() {}
+	};
+
 	/**
 	 * One element of the queue: basically a song plus some queue specific
 	 * information attached.
 	 */
-	struct Item {
+	struct Item final : RankTreeHook<Item> {
 		DetachedSong *song;
 
 		/** the unique id of this item in the queue */
@@ -67,25 +90,56 @@ struct Queue {
 		 * "random" mode.
 		 */
 		uint8_t priority;
+
+		/**
+		 * Has #pending_version not been applied to the children
+		 * yet?
+		 */
+		bool has_pending;
+
+		/** the range of versions in this subtree */
+		uint32_t min_version, max_version;
+
+		uint32_t pending_version;
+
+		OrderItem order;
+
+		Item(DetachedSong *_song, unsigned _id, uint32_t _version,
+		     uint8_t _priority)
+			:song(_song), id(_id), version(_version),
+			 priority(_priority), has_pending(false),
+			 order(*this) {}
+
+		Item(const Item &) = delete;
+		Item &operator=(const Item &) = delete;
+
+		/**
+		 * Set the version of all items in this subtree.
+		 */
+		void SetSubtreeVersion(uint32_t _version) {
+			version = min_version = max_version =
+				pending_version = _version;
+			has_pending = true;
+		}
+
+		void Update();
+		void Push();
 	};
 
 	/** configured maximum length of the queue */
 	unsigned max_length;
 
-	/** number of songs in the queue */
-	unsigned length;
-
 	/** the current version number */
 	uint32_t version;
 
 	/** all songs in "position" order */
-	Item *items;
+	RankTree<Item> items;
 
-	/** map order numbers to positions */
-	unsigned *order;
+	/** all songs in "order" order */
+	RankTree<OrderItem> order;
 
-	/** map song ids to positions */
-	IdTable id_table;
+	/** map song ids to items */
+	IdTable<Item> id_table;
 
 	/** repeat playback when the end of the queue has been
 	    reached? */
@@ -115,82 +169,79 @@ struct Queue {
 	Queue &operator=(const Queue &) = delete;
 
 	unsigned GetLength() const {
-		assert(length <= max_length);
-
-		return length;
+		return items.GetSize();
 	}
 
 	/**
 	 * Determine if the queue is empty, i.e. there are no songs.
 	 */
 	bool IsEmpty() const {
-		return length == 0;
+		return items.IsEmpty();
 	}
 
 	/**
 	 * Determine if the maximum number of songs has been reached.
 	 */
 	bool IsFull() const {
-		assert(length <= max_length);
+		assert(GetLength() <= max_length);
 
-		return length >= max_length;
+		return GetLength() >= max_length;
 	}
 
 	/**
 	 * Is that a valid position number?
 	 */
 	bool IsValidPosition(unsigned position) const {
-		return position < length;
+		return position < GetLength();
 	}
 
 	/**
 	 * Is that a valid order number?
 	 */
 	bool IsValidOrder(unsigned _order) const {
-		return _order < length;
+		return _order < GetLength();
 	}
 
+	gcc_pure
 	int IdToPosition(unsigned id) const {
-		return id_table.IdToPosition(id);
+		const Item *item = id_table.Lookup(id);
+		return item != nullptr
+			? (int)items.Rank(*item)
+			: -1;
 	}
 
 	int PositionToId(unsigned position) const
 	{
-		assert(position < length);
+		assert(position < GetLength());
 
-		return items[position].id;
+		return items.At(position).id;
 	}
 
 	gcc_pure
 	unsigned OrderToPosition(unsigned _order) const {
-		assert(_order < length);
+		assert(_order < GetLength());
 
-		return order[_order];
+		return items.Rank(order.At(_order).item);
 	}
 
 	gcc_pure
 	unsigned PositionToOrder(unsigned position) const {
-		assert(position < length);
-
-		for (unsigned i = 0;; ++i) {
-			assert(i < length);
+		assert(position < GetLength());
 
-			if (order[i] == position)
-				return i;
-		}
+		return order.Rank(items.At(position).order);
 	}
 
 	gcc_pure
 	uint8_t GetPriorityAtPosition(unsigned position) const {
-		assert(position < length);
+		assert(position < GetLength());
 
-		return items[position].priority;
+		return items.At(position).priority;
 	}
 
 	const Item &GetOrderItem(unsigned i) const {
 		assert(IsValidOrder(i));
 
-		return items[OrderToPosition(i)];
+		return order.At(i).item;
 	}
 
 	uint8_t GetOrderPriority(unsigned i) const {
@@ -201,9 +252,9 @@ struct Queue {
 	 * Returns the song at the specified position.
 	 */
 	DetachedSong &Get(unsigned position) const {
-		assert(position < length);
+		assert(position < GetLength());
 
-		return *items[position].song;
+		return *items.At(position).song;
 	}
 
 	/**
@@ -218,13 +269,25 @@ struct Queue {
 	 * version?
 	 */
 	bool IsNewerAtPosition(unsigned position, uint32_t _version) const {
-		assert(position < length);
+		assert(position < GetLength());
 
+		const Item &item = items.At(position);
 		return _version > version ||
-			items[position].version >= _version ||
-			items[position].version == 0;
+			item.version >= _version ||
+			item.version == 0;
 	}
 
+	/**
+	 * Find the first song at or after the specified position
+	 * which is newer than the specified version (see
+	 * IsNewerAtPosition()).  Unmodified parts of the queue are
+	 * skipped in O(log n).
+	 *
+	 * @return the position, or GetLength() if there is none
+	 */
+	gcc_pure
+	unsigned FindNewerPosition(unsigned start, uint32_t _version) const;
+
 	/**
 	 * Returns the order number following the specified one.  This takes
 	 * end of queue and "repeat" mode into account.
@@ -246,9 +309,9 @@ struct Queue {
 	 * number.
 	 */
 	void ModifyAtPosition(unsigned position) {
-		assert(position < length);
+		assert(position < GetLength());
 
-		items[position].version = version;
+		ModifyItem(items.At(position));
 	}
 
 	/**
@@ -270,6 +333,15 @@ struct Queue {
 	 */
 	unsigned Append(DetachedSong &&song, uint8_t priority);
 
+	/**
+	 * Appends many songs at once, in O(n).  The queue takes
+	 * ownership of the #DetachedSong objects.  Prior to that, the
+	 * caller must check if there is enough room.
+	 *
+	 * @param priority the priority of the new queue items
+	 */
+	void Append(DetachedSong *const*songs, unsigned n, uint8_t priority);
+
 	/**
 	 * Swaps two songs, addressed by their position.
 	 */
@@ -279,7 +351,7 @@ struct Queue {
 	 * Swaps two songs, addressed by their order number.
 	 */
 	void SwapOrders(unsigned order1, unsigned order2) {
-		std::swap(order[order1], order[order2]);
+		order.Swap(order1, order2);
 	}
 
 	/**
@@ -303,12 +375,9 @@ struct Queue {
 	void Clear();
 
 	/**
-	 * Initializes the "order" array, and restores "normal" order.
+	 * Restores "normal" order.
 	 */
-	void RestoreOrder() {
-		for (unsigned i = 0; i < length; ++i)
-			order[i] = i;
-	}
+	void RestoreOrder();
 
 	/**
 	 * Shuffle the order of items in the specified range, ignoring
@@ -337,6 +406,13 @@ struct Queue {
 	 */
 	void ShuffleOrderLast(unsigned start, unsigned end);
 
+	/**
+	 * Like ShuffleOrderLast(), but the last song is shuffled only
+	 * within its priority group, so the range stays sorted by
+	 * priority.  This costs O(log n).
+	 */
+	void ShuffleOrderLastWithPriority(unsigned start, unsigned end);
+
 	/**
 	 * Shuffles a (position) range in the queue.  The songs are physically
 	 * shuffled, not by using the "order" mapping.
@@ -355,14 +431,21 @@ private:
 	 */
 	void MoveOrder(unsigned from_order, unsigned to_order);
 
-	void MoveItemTo(unsigned from, unsigned to) {
-		unsigned from_id = items[from].id;
-
-		items[to] = items[from];
-		items[to].version = version;
-		id_table.Move(from_id, to);
+	/**
+	 * Marks the specified item as "modified".
+	 */
+	void ModifyItem(Item &item) {
+		items.PushPath(item);
+		item.version = version;
+		items.UpdatePath(item);
 	}
 
+	/**
+	 * Marks all items in the specified position range as
+	 * "modified".
+	 */
+	void ModifyRange(unsigned start, unsigned end);
+
 	/**
 	 * Find the first item that has this specified priority or
 	 * higher.
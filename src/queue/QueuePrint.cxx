@@ -23,6 +23,7 @@
 #include "SongFilter.hxx"
 #include "SongPrint.hxx"
 #include "client/Client.hxx"
+#include "client/CompactRecord.hxx"
 
 /**
  * Send detailed information about a range of songs in the queue to a
@@ -36,13 +37,17 @@ static void
 queue_print_song_info(Client &client, const Queue &queue,
 		      unsigned position)
 {
+	client_begin_record(client);
+
 	song_print_info(client, queue.Get(position));
-	client_printf(client, "Pos: %u\nId: %u\n",
-		      position, queue.PositionToId(position));
+	client_print_field(client, COMPACT_POS, position);
+	client_print_field(client, COMPACT_ID, queue.PositionToId(position));
 
 	uint8_t priority = queue.GetPriorityAtPosition(position);
 	if (priority != 0)
-		client_printf(client, "Prio: %u\n", priority);
+		client_print_field(client, COMPACT_PRIO, unsigned(priority));
+
+	client_end_record(client);
 }
 
 void
@@ -73,20 +78,22 @@ void
 queue_print_changes_info(Client &client, const Queue &queue,
 			 uint32_t version)
 {
-	for (unsigned i = 0; i < queue.GetLength(); i++) {
-		if (queue.IsNewerAtPosition(i, version))
-			queue_print_song_info(client, queue, i);
-	}
+	for (unsigned i = queue.FindNewerPosition(0, version);
+	     i < queue.GetLength();
+	     i = queue.FindNewerPosition(i + 1, version))
+		queue_print_song_info(client, queue, i);
 }
 
 void
 queue_print_changes_position(Client &client, const Queue &queue,
 			     uint32_t version)
 {
-	for (unsigned i = 0; i < queue.GetLength(); i++)
-		if (queue.IsNewerAtPosition(i, version))
-			client_printf(client, "cpos: %i\nId: %i\n",
-				      i, queue.PositionToId(i));
+	for (unsigned i = queue.FindNewerPosition(0, version);
+	     i < queue.GetLength();
+	     i = queue.FindNewerPosition(i + 1, version)) {
+		client_print_pair(client, "cpos", i);
+		client_print_pair(client, "Id", queue.PositionToId(i));
+	}
 }
 
 void
@@ -29,12 +29,15 @@
 #include "fs/io/BufferedOutputStream.hxx"
 #include "util/StringUtil.hxx"
 #include "util/Error.hxx"
+#include "util/ConstBuffer.hxx"
 #include "fs/Traits.hxx"
 #include "Log.hxx"
 
+#include <assert.h>
 #include <stdlib.h>
 
 #define PRIO_LABEL "Prio: "
+#define POS_LABEL "Pos: "
 
 static void
 queue_save_database_song(BufferedOutputStream &os,
@@ -63,64 +66,222 @@ queue_save_song(BufferedOutputStream &os, int idx, const DetachedSong &song)
 		queue_save_full_song(os, song);
 }
 
+static void
+queue_save_position(BufferedOutputStream &os, const Queue &queue,
+		    unsigned position)
+{
+	uint8_t prio = queue.GetPriorityAtPosition(position);
+	if (prio != 0)
+		os.Format(PRIO_LABEL "%u\n", prio);
+
+	queue_save_song(os, position, queue.Get(position));
+}
+
 void
 queue_save(BufferedOutputStream &os, const Queue &queue)
 {
-	for (unsigned i = 0; i < queue.GetLength(); i++) {
-		uint8_t prio = queue.GetPriorityAtPosition(i);
-		if (prio != 0)
-			os.Format(PRIO_LABEL "%u\n", prio);
+	for (unsigned i = 0; i < queue.GetLength(); i++)
+		queue_save_position(os, queue, i);
+}
 
-		queue_save_song(os, i, queue.Get(i));
+unsigned
+queue_save_changes(BufferedOutputStream &os, const Queue &queue,
+		   uint32_t version)
+{
+	unsigned n = 0;
+	for (unsigned i = queue.FindNewerPosition(0, version);
+	     i < queue.GetLength();
+	     i = queue.FindNewerPosition(i + 1, version), ++n) {
+		os.Format(POS_LABEL "%u\n", i);
+		queue_save_position(os, queue, i);
 	}
+
+	return n;
 }
 
-void
-queue_load_song(TextFile &file, const SongLoader &loader,
-		const char *line, Queue &queue)
+/**
+ * Parses one song from the state file.
+ *
+ * @return the song or nullptr on error
+ */
+static DetachedSong *
+queue_parse_song(TextFile &file, const char *line,
+		 uint8_t &priority, bool &brief)
 {
-	if (queue.IsFull())
-		return;
-
-	uint8_t priority = 0;
+	priority = 0;
 	if (StringStartsWith(line, PRIO_LABEL)) {
 		priority = strtoul(line + sizeof(PRIO_LABEL) - 1, nullptr, 10);
 
 		line = file.ReadLine();
 		if (line == nullptr)
-			return;
+			return nullptr;
 	}
 
-	DetachedSong *song;
-
 	if (StringStartsWith(line, SONG_BEGIN)) {
 		const char *uri = line + sizeof(SONG_BEGIN) - 1;
 
 		Error error;
-		song = song_load(file, uri, error);
-		if (song == nullptr) {
+		DetachedSong *song = song_load(file, uri, error);
+		if (song == nullptr)
 			LogError(error);
-			return;
-		}
+
+		brief = false;
+		return song;
 	} else {
 		char *endptr;
 		long ret = strtol(line, &endptr, 10);
 		if (ret < 0 || *endptr != ':' || endptr[1] == 0) {
 			LogError(playlist_domain,
 				 "Malformed playlist line in state file");
-			return;
+			return nullptr;
 		}
 
 		const char *uri = endptr + 1;
 
-		song = new DetachedSong(uri);
+		brief = true;
+		return new DetachedSong(uri);
+	}
+}
+
+QueueLoader::~QueueLoader()
+{
+	DiscardChanges();
+
+	for (const auto &entry : entries)
+		delete entry.song;
+}
+
+void
+QueueLoader::LoadSong(TextFile &file, const char *line)
+{
+	Entry entry;
+	entry.song = queue_parse_song(file, line, entry.priority, entry.brief);
+	if (entry.song != nullptr)
+		entries.push_back(entry);
+}
+
+void
+QueueLoader::LoadChange(TextFile &file, const char *line)
+{
+	if (!StringStartsWith(line, POS_LABEL)) {
+		LogError(playlist_domain,
+			 "Malformed playlist line in state file");
+		return;
+	}
+
+	Change change;
+	change.position = strtoul(line + sizeof(POS_LABEL) - 1, nullptr, 10);
+
+	line = file.ReadLine();
+	if (line == nullptr)
+		return;
+
+	Entry &entry = change.entry;
+	entry.song = queue_parse_song(file, line, entry.priority, entry.brief);
+	if (entry.song != nullptr)
+		changes.push_back(change);
+}
+
+void
+QueueLoader::ApplyChanges(unsigned length)
+{
+	for (unsigned i = length; i < entries.size(); ++i)
+		delete entries[i].song;
+
+	entries.resize(length, Entry{nullptr, false, 0});
+
+	for (const auto &change : changes) {
+		if (change.position >= length) {
+			delete change.entry.song;
+			continue;
+		}
+
+		Entry &entry = entries[change.position];
+		delete entry.song;
+		entry = change.entry;
+	}
+
+	changes.clear();
+}
+
+void
+QueueLoader::DiscardChanges()
+{
+	for (const auto &change : changes)
+		delete change.entry.song;
+
+	changes.clear();
+}
+
+/**
+ * Look up the song's metadata.  For brief entries, this is just the
+ * database song.
+ *
+ * @return the resolved song (may be the given one) or nullptr if it
+ * does not exist anymore
+ */
+static DetachedSong *
+queue_resolve_song(DetachedSong *song, bool brief, const SongLoader &loader)
+{
+	if (brief) {
+		DetachedSong *tmp = loader.LoadSong(song->GetURI(),
+						    IgnoreError());
+		delete song;
+		return tmp;
 	}
 
 	if (!playlist_check_translate_song(*song, nullptr, loader)) {
 		delete song;
-		return;
+		return nullptr;
 	}
 
-	queue.Append(std::move(*song), priority);
-	delete song;
+	return song;
+}
+
+void
+QueueLoader::Commit(const SongLoader &loader, Queue &queue)
+{
+	assert(changes.empty());
+
+	/* let a remote database look up all songs at once */
+	std::vector<const char *> uris;
+	uris.reserve(entries.size());
+	for (const auto &entry : entries)
+		if (entry.song != nullptr)
+			uris.push_back(entry.song->GetURI());
+	loader.Prefetch({uris.data(), uris.size()});
+
+	/* append runs of songs with the same priority in one batch */
+	std::vector<DetachedSong *> songs;
+	uint8_t priority = 0;
+
+	for (auto &entry : entries) {
+		DetachedSong *song = entry.song;
+		entry.song = nullptr;
+
+		if (song == nullptr)
+			continue;
+
+		if (queue.GetLength() + songs.size() >= queue.max_length) {
+			delete song;
+			continue;
+		}
+
+		song = queue_resolve_song(song, entry.brief, loader);
+		if (song == nullptr)
+			continue;
+
+		if (entry.priority != priority && !songs.empty()) {
+			queue.Append(songs.data(), songs.size(), priority);
+			songs.clear();
+		}
+
+		priority = entry.priority;
+		songs.push_back(song);
+	}
+
+	if (!songs.empty())
+		queue.Append(songs.data(), songs.size(), priority);
+
+	entries.clear();
 }
@@ -25,7 +25,12 @@
 #ifndef MPD_QUEUE_SAVE_HXX
 #define MPD_QUEUE_SAVE_HXX
 
+#include <vector>
+
+#include <stdint.h>
+
 struct Queue;
+class DetachedSong;
 class BufferedOutputStream;
 class TextFile;
 class SongLoader;
@@ -34,10 +39,84 @@ void
 queue_save(BufferedOutputStream &os, const Queue &queue);
 
 /**
- * Loads one song from the state file and appends it to the queue.
+ * Saves the songs which were modified since the specified queue
+ * version (see Queue::FindNewerPosition()), each one prefixed with
+ * its position.  This is used for appending a journal block to the
+ * state file.
+ *
+ * @return the number of songs which were saved
  */
-void
-queue_load_song(TextFile &file, const SongLoader &loader,
-		const char *line, Queue &queue);
+unsigned
+queue_save_changes(BufferedOutputStream &os, const Queue &queue,
+		   uint32_t version);
+
+/**
+ * Collects the queue from the state file.  The songs are resolved
+ * (see playlist_check_translate_song()) and appended to the queue only
+ * by Commit(), after all journal blocks have been applied; this way,
+ * songs which were replaced later in the file are never looked up.
+ */
+class QueueLoader {
+	struct Entry {
+		DetachedSong *song;
+
+		/**
+		 * Was only the URI of a database song saved?  Then
+		 * there is no metadata to merge, and the song can be
+		 * taken from the database as-is.
+		 */
+		bool brief;
+
+		uint8_t priority;
+	};
+
+	std::vector<Entry> entries;
+
+	struct Change {
+		unsigned position;
+		Entry entry;
+	};
+
+	/**
+	 * The songs of the current journal block, applied by
+	 * ApplyChanges().
+	 */
+	std::vector<Change> changes;
+
+public:
+	QueueLoader() = default;
+	QueueLoader(const QueueLoader &) = delete;
+	QueueLoader &operator=(const QueueLoader &) = delete;
+
+	~QueueLoader();
+
+	/**
+	 * Loads one song from the state file and appends it.
+	 */
+	void LoadSong(TextFile &file, const char *line);
+
+	/**
+	 * Loads one song of a journal block (see
+	 * queue_save_changes()).
+	 */
+	void LoadChange(TextFile &file, const char *line);
+
+	/**
+	 * Apply the journal block which was loaded with LoadChange().
+	 *
+	 * @param length the queue length after the block
+	 */
+	void ApplyChanges(unsigned length);
+
+	/**
+	 * Discard an incomplete journal block.
+	 */
+	void DiscardChanges();
+
+	/**
+	 * Resolves all songs and appends them to the queue.
+	 */
+	void Commit(const SongLoader &loader, Queue &queue);
+};
 
 #endif
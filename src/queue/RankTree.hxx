@@ -0,0 +1,489 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_RANK_TREE_HXX
+#define MPD_RANK_TREE_HXX
+
+#include "Compiler.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+
+/**
+ * The base class for nodes of a #RankTree.  The derived class T must
+ * implement two methods:
+ *
+ * - void Update(): recalculate aggregate values from the children
+ *   (which are already up to date)
+ *
+ * - void Push(): pass pending lazy modifications down to the
+ *   children; called before the children are visited or relinked
+ */
+template<typename T>
+struct RankTreeHook {
+	T *left, *right, *parent;
+
+	/** the number of nodes in this subtree */
+	unsigned size;
+
+	/** the (random) heap key which keeps the tree balanced */
+	uint32_t weight;
+};
+
+/**
+ * A sequence of intrusive nodes, implemented as an implicit treap:
+ * the nodes are not sorted by a key, their position is the in-order
+ * rank.  Lookups by rank, the rank of a node, insertion, removal and
+ * moving a range are O(log n).
+ *
+ * The tree does not own its nodes.
+ */
+template<typename T>
+class RankTree {
+	T *root;
+
+	uint32_t seed;
+
+public:
+	RankTree():root(nullptr), seed(0x9e3779b9) {}
+
+	RankTree(const RankTree &) = delete;
+	RankTree &operator=(const RankTree &) = delete;
+
+	bool IsEmpty() const {
+		return root == nullptr;
+	}
+
+	unsigned GetSize() const {
+		return Size(root);
+	}
+
+	/**
+	 * Forget all nodes.  They are not freed.
+	 */
+	void Reset() {
+		root = nullptr;
+	}
+
+	/**
+	 * Returns the node at the specified rank.
+	 */
+	T &At(unsigned rank) const {
+		assert(rank < GetSize());
+
+		T *n = root;
+		while (true) {
+			n->Push();
+
+			const unsigned left = Size(n->left);
+			if (rank < left)
+				n = n->left;
+			else if (rank == left)
+				return *n;
+			else {
+				rank -= left + 1;
+				n = n->right;
+			}
+		}
+	}
+
+	/**
+	 * Returns the rank of the specified node, which must be in
+	 * this tree.
+	 */
+	gcc_pure
+	unsigned Rank(const T &node) const {
+		unsigned rank = Size(node.left);
+		for (const T *n = &node; n->parent != nullptr; n = n->parent)
+			if (n == n->parent->right)
+				rank += Size(n->parent->left) + 1;
+
+		assert(rank < GetSize());
+		return rank;
+	}
+
+	/**
+	 * Apply all pending modifications to the specified node, to
+	 * prepare reading or changing its values.
+	 */
+	void PushPath(T &node) const {
+		if (node.parent != nullptr)
+			PushPath(*node.parent);
+		node.Push();
+	}
+
+	/**
+	 * Recalculate the aggregate values of the specified node and
+	 * its ancestors after its value has been changed.  Call
+	 * PushPath() before changing the value.
+	 */
+	void UpdatePath(T &node) {
+		for (T *n = &node; n != nullptr; n = n->parent)
+			n->Update();
+	}
+
+	void Insert(unsigned rank, T &node) {
+		assert(rank <= GetSize());
+
+		InitNode(node);
+
+		T *a, *b;
+		Split(root, rank, a, b);
+		SetRoot(Merge(Merge(a, &node), b));
+	}
+
+	void PushBack(T &node) {
+		InitNode(node);
+		SetRoot(Merge(root, &node));
+	}
+
+	/**
+	 * Append many nodes at once.  This is O(n) plus O(log n) for
+	 * attaching them to the tree.
+	 */
+	void PushBack(T *const*nodes, unsigned n) {
+		for (unsigned i = 0; i < n; ++i)
+			nodes[i]->weight = NextWeight();
+
+		SetRoot(Merge(root, Build(nodes, n)));
+	}
+
+	void Erase(T &node) {
+		const unsigned rank = Rank(node);
+
+		T *a, *b, *c;
+		Split(root, rank, a, b);
+		Split(b, 1, b, c);
+		assert(b == &node);
+
+		SetRoot(Merge(a, c));
+	}
+
+	/**
+	 * Moves the range [start, end) so it begins at rank "to"
+	 * afterwards.
+	 */
+	void Move(unsigned start, unsigned end, unsigned to) {
+		assert(start <= end);
+		assert(end <= GetSize());
+		assert(to + (end - start) <= GetSize());
+
+		T *a, *b, *c;
+		Split(root, end, b, c);
+		Split(b, start, a, b);
+
+		T *rest = Merge(a, c), *d;
+		Split(rest, to, a, d);
+		SetRoot(Merge(Merge(a, b), d));
+	}
+
+	/**
+	 * Exchange the nodes at the two specified ranks.
+	 */
+	void Swap(unsigned rank1, unsigned rank2) {
+		if (rank1 == rank2)
+			return;
+
+		if (rank1 > rank2)
+			std::swap(rank1, rank2);
+
+		assert(rank2 < GetSize());
+
+		T *a, *x, *b, *y, *c;
+		Split(root, rank2, b, y);
+		Split(y, 1, y, c);
+		Split(b, rank1, a, b);
+		Split(b, 1, x, b);
+
+		SetRoot(Merge(Merge(Merge(a, y), Merge(b, x)), c));
+	}
+
+	/**
+	 * Invoke the function with the root of the subtree which
+	 * contains exactly the range [start, end).  This is used to
+	 * apply a lazy modification to the whole range.
+	 */
+	template<typename F>
+	void ApplyRange(unsigned start, unsigned end, F &&f) {
+		assert(start <= end);
+		assert(end <= GetSize());
+
+		if (start == end)
+			return;
+
+		T *a, *b, *c;
+		Split(root, end, b, c);
+		Split(b, start, a, b);
+
+		f(*b);
+
+		SetRoot(Merge(Merge(a, b), c));
+	}
+
+	/**
+	 * Pass the nodes in the range [start, end) as a std::vector
+	 * to the function, which may permute it; afterwards, the
+	 * range is rebuilt in the new order.
+	 */
+	template<typename F>
+	void ReorderRange(unsigned start, unsigned end, F &&f) {
+		assert(start <= end);
+		assert(end <= GetSize());
+
+		if (end - start < 2)
+			return;
+
+		T *a, *b, *c;
+		Split(root, end, b, c);
+		Split(b, start, a, b);
+
+		std::vector<T *> v;
+		v.reserve(end - start);
+		Collect(b, v);
+
+		f(v);
+		assert(v.size() == end - start);
+
+		SetRoot(Merge(Merge(a, Build(v.data(), v.size())), c));
+	}
+
+	/**
+	 * Find the first node at or after the specified rank which
+	 * matches a predicate.
+	 *
+	 * @param subtree_pred checks the aggregate values of a
+	 * subtree; returns false if the subtree cannot contain a match
+	 * @param node_pred checks the node itself
+	 * @return the rank of the match or GetSize() if there is none
+	 */
+	template<typename S, typename P>
+	unsigned FindFirst(unsigned start, S &&subtree_pred,
+			   P &&node_pred) const {
+		const T *n = Find(root, start, 0, subtree_pred, node_pred);
+		return n != nullptr
+			? Rank(*n)
+			: GetSize();
+	}
+
+	/**
+	 * Invoke the function for each node in order.
+	 */
+	template<typename F>
+	void ForEach(F &&f) const {
+		ForEach(root, f);
+	}
+
+	/**
+	 * Remove all nodes and pass each one to the function (which
+	 * may free it).
+	 */
+	template<typename F>
+	void ClearAndDispose(F &&dispose) {
+		T *n = root;
+		root = nullptr;
+		Dispose(n, dispose);
+	}
+
+private:
+	static unsigned Size(const T *n) {
+		return n != nullptr ? n->size : 0;
+	}
+
+	uint32_t NextWeight() {
+		/* xorshift32 */
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		return seed;
+	}
+
+	void InitNode(T &node) {
+		node.left = node.right = node.parent = nullptr;
+		node.weight = NextWeight();
+		Fix(&node);
+	}
+
+	void SetRoot(T *n) {
+		root = n;
+		if (n != nullptr)
+			n->parent = nullptr;
+	}
+
+	/**
+	 * Recalculate the size and the aggregate values of a node
+	 * after its children have changed.
+	 */
+	static void Fix(T *n) {
+		n->size = 1 + Size(n->left) + Size(n->right);
+		if (n->left != nullptr)
+			n->left->parent = n;
+		if (n->right != nullptr)
+			n->right->parent = n;
+		n->Update();
+	}
+
+	static T *Merge(T *a, T *b) {
+		if (a == nullptr)
+			return b;
+		if (b == nullptr)
+			return a;
+
+		if (a->weight > b->weight) {
+			a->Push();
+			a->right = Merge(a->right, b);
+			Fix(a);
+			return a;
+		} else {
+			b->Push();
+			b->left = Merge(a, b->left);
+			Fix(b);
+			return b;
+		}
+	}
+
+	/**
+	 * Split the subtree into the first #k nodes and the rest.
+	 */
+	static void Split(T *n, unsigned k, T *&a, T *&b) {
+		if (n == nullptr) {
+			a = b = nullptr;
+			return;
+		}
+
+		n->Push();
+
+		const unsigned left = Size(n->left);
+		if (k <= left) {
+			T *l = n->left;
+			Split(l, k, a, n->left);
+			Fix(n);
+			b = n;
+		} else {
+			T *r = n->right;
+			Split(r, k - left - 1, n->right, b);
+			Fix(n);
+			a = n;
+		}
+	}
+
+	/**
+	 * Build a subtree from a sequence of nodes whose weights have
+	 * already been assigned, in O(n): a node's parent is the
+	 * nearer of the two closest heavier nodes to its left and
+	 * right.
+	 */
+	static T *Build(T *const*nodes, unsigned n) {
+		std::vector<T *> spine;
+
+		for (unsigned i = 0; i < n; ++i) {
+			T *node = nodes[i];
+			node->right = nullptr;
+
+			T *last = nullptr;
+			while (!spine.empty() && spine.back()->weight <= node->weight) {
+				last = spine.back();
+				spine.pop_back();
+			}
+
+			node->left = last;
+			if (!spine.empty())
+				spine.back()->right = node;
+
+			spine.push_back(node);
+		}
+
+		if (spine.empty())
+			return nullptr;
+
+		FixAll(spine.front());
+		return spine.front();
+	}
+
+	/**
+	 * Recalculate sizes and aggregate values of a whole subtree,
+	 * bottom-up.
+	 */
+	static void FixAll(T *n) {
+		if (n == nullptr)
+			return;
+
+		FixAll(n->left);
+		FixAll(n->right);
+		Fix(n);
+	}
+
+	static void Collect(T *n, std::vector<T *> &v) {
+		if (n == nullptr)
+			return;
+
+		n->Push();
+		Collect(n->left, v);
+		v.push_back(n);
+		Collect(n->right, v);
+	}
+
+	template<typename S, typename P>
+	static const T *Find(T *n, unsigned start, unsigned offset,
+			     S &subtree_pred, P &node_pred) {
+		if (n == nullptr || offset + n->size <= start ||
+		    !subtree_pred(*n))
+			return nullptr;
+
+		n->Push();
+
+		const T *result = Find(n->left, start, offset,
+				       subtree_pred, node_pred);
+		if (result != nullptr)
+			return result;
+
+		const unsigned rank = offset + Size(n->left);
+		if (rank >= start && node_pred(*n))
+			return n;
+
+		return Find(n->right, start, rank + 1,
+			    subtree_pred, node_pred);
+	}
+
+	template<typename F>
+	static void ForEach(T *n, F &f) {
+		if (n == nullptr)
+			return;
+
+		n->Push();
+		ForEach(n->left, f);
+		f(*n);
+		ForEach(n->right, f);
+	}
+
+	template<typename F>
+	static void Dispose(T *n, F &dispose) {
+		if (n == nullptr)
+			return;
+
+		T *left = n->left, *right = n->right;
+		dispose(n);
+		Dispose(left, dispose);
+		Dispose(right, dispose);
+	}
+};
+
+#endif
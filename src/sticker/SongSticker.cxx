@@ -22,9 +22,12 @@
 #include "StickerDatabase.hxx"
 #include "db/LightSong.hxx"
 #include "db/Interface.hxx"
+#include "db/Selection.hxx"
 #include "util/Error.hxx"
 #include "util/Alloc.hxx"
 
+#include <unordered_map>
+
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
@@ -67,14 +70,16 @@ sticker_song_get(const LightSong &song, Error &error)
 	return sticker_load("song", uri.c_str(), error);
 }
 
+/**
+ * From this number of matches on, sticker_song_visit_matches()
+ * visits the base directory once instead of looking up each song.
+ */
+static constexpr size_t STICKER_VISIT_THRESHOLD = 256;
+
 struct sticker_song_find_data {
-	const Database *db;
 	const char *base_uri;
 	size_t base_uri_length;
-
-	void (*func)(const LightSong &song, const char *value,
-		     void *user_data);
-	void *user_data;
+	std::vector<SongStickerMatch> *matches;
 };
 
 static void
@@ -87,26 +92,17 @@ sticker_song_find_cb(const char *uri, const char *value, void *user_data)
 		/* should not happen, ignore silently */
 		return;
 
-	const Database *db = data->db;
-	const LightSong *song = db->GetSong(uri, IgnoreError());
-	if (song != nullptr) {
-		data->func(*song, value, data->user_data);
-		db->ReturnSong(song);
-	}
+	data->matches->push_back({uri, value});
 }
 
 bool
-sticker_song_find(const Database &db, const char *base_uri, const char *name,
-		  StickerOperator op, const char *value,
-		  void (*func)(const LightSong &song, const char *value,
-			       void *user_data),
-		  void *user_data,
-		  Error &error)
+sticker_song_find_values(const char *base_uri, const char *name,
+			 StickerOperator op, const char *value,
+			 std::vector<SongStickerMatch> &matches,
+			 Error &error)
 {
 	struct sticker_song_find_data data;
-	data.db = &db;
-	data.func = func;
-	data.user_data = user_data;
+	data.matches = &matches;
 
 	char *allocated;
 	data.base_uri = base_uri;
@@ -127,3 +123,60 @@ sticker_song_find(const Database &db, const char *base_uri, const char *name,
 
 	return success;
 }
+
+void
+sticker_song_visit_matches(const Database &db, const char *base_uri,
+			   const std::vector<SongStickerMatch> &matches,
+			   void (*func)(const LightSong &song,
+					const char *value,
+					void *user_data),
+			   void *user_data)
+{
+	if (matches.size() < STICKER_VISIT_THRESHOLD) {
+		for (const auto &i : matches) {
+			const LightSong *song = db.GetSong(i.uri.c_str(),
+							   IgnoreError());
+			if (song != nullptr) {
+				func(*song, i.value.c_str(), user_data);
+				db.ReturnSong(song);
+			}
+		}
+
+		return;
+	}
+
+	/* many matches: walk the base directory once instead of
+	   looking up each song by its path */
+
+	std::unordered_map<std::string, const char *> values;
+	values.reserve(matches.size());
+	for (const auto &i : matches)
+		values.emplace(i.uri, i.value.c_str());
+
+	const DatabaseSelection selection(base_uri, true);
+	db.Visit(selection,
+		 [&values, func, user_data](const LightSong &song, Error &){
+			 auto i = values.find(song.GetURI());
+			 if (i != values.end())
+				 func(song, i->second, user_data);
+			 return true;
+		 },
+		 IgnoreError());
+}
+
+bool
+sticker_song_find(const Database &db, const char *base_uri, const char *name,
+		  StickerOperator op, const char *value,
+		  void (*func)(const LightSong &song, const char *value,
+			       void *user_data),
+		  void *user_data,
+		  Error &error)
+{
+	std::vector<SongStickerMatch> matches;
+	if (!sticker_song_find_values(base_uri, name, op, value,
+				      matches, error))
+		return false;
+
+	sticker_song_visit_matches(db, base_uri, matches, func, user_data);
+	return true;
+}
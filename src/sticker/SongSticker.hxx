@@ -24,6 +24,7 @@
 #include "Compiler.h"
 
 #include <string>
+#include <vector>
 
 struct LightSong;
 struct Sticker;
@@ -70,6 +71,44 @@ sticker_song_delete_value(const LightSong &song, const char *name,
 Sticker *
 sticker_song_get(const LightSong &song, Error &error);
 
+/**
+ * A sticker value found by sticker_song_find_values().
+ */
+struct SongStickerMatch {
+	std::string uri, value;
+};
+
+/**
+ * The first half of sticker_song_find(): query the sticker database,
+ * without looking up the songs.  This does not access the music
+ * database, and may be called in any thread.
+ *
+ * @return true on success (even if no sticker was found), false on
+ * failure
+ */
+bool
+sticker_song_find_values(const char *base_uri, const char *name,
+			 StickerOperator op, const char *value,
+			 std::vector<SongStickerMatch> &matches,
+			 Error &error);
+
+/**
+ * The second half of sticker_song_find(): look up the songs of the
+ * matches, and invoke the callback for each one which exists.  Many
+ * matches are resolved with one walk of the base directory, and are
+ * then passed in database order.
+ *
+ * @param base_uri the base directory which was passed to
+ * sticker_song_find_values()
+ */
+void
+sticker_song_visit_matches(const Database &db, const char *base_uri,
+			   const std::vector<SongStickerMatch> &matches,
+			   void (*func)(const LightSong &song,
+					const char *value,
+					void *user_data),
+			   void *user_data);
+
 /**
  * Finds stickers with the specified name below the specified
  * directory.
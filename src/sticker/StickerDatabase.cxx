@@ -22,9 +22,13 @@
 #include "lib/sqlite/Domain.hxx"
 #include "lib/sqlite/Util.hxx"
 #include "fs/Path.hxx"
+#include "config/ConfigError.hxx"
+#include "thread/Mutex.hxx"
 #include "Idle.hxx"
 #include "util/Error.hxx"
 #include "util/Macros.hxx"
+#include "util/ASCII.hxx"
+#include "Log.hxx"
 
 #include <string>
 #include <map>
@@ -46,6 +50,10 @@ enum sticker_sql {
 	STICKER_SQL_FIND_VALUE,
 	STICKER_SQL_FIND_LT,
 	STICKER_SQL_FIND_GT,
+	STICKER_SQL_FIND_ALL,
+	STICKER_SQL_FIND_ALL_VALUE,
+	STICKER_SQL_FIND_ALL_LT,
+	STICKER_SQL_FIND_ALL_GT,
 };
 
 static const char *const sticker_sql[] = {
@@ -61,17 +69,35 @@ static const char *const sticker_sql[] = {
 	"DELETE FROM sticker WHERE type=? AND uri=?",
 	//[STICKER_SQL_DELETE_VALUE] =
 	"DELETE FROM sticker WHERE type=? AND uri=? AND name=?",
+	/* the URI prefix is a range, which (unlike LIKE) can use the
+	   "sticker_value" index */
+
 	//[STICKER_SQL_FIND] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=?",
+	"SELECT uri,value FROM sticker WHERE type=? AND uri>=? AND uri<? AND name=?",
 
 	//[STICKER_SQL_FIND_VALUE] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value=?",
+	"SELECT uri,value FROM sticker WHERE type=? AND uri>=? AND uri<? AND name=? AND value=?",
 
 	//[STICKER_SQL_FIND_LT] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value<?",
+	"SELECT uri,value FROM sticker WHERE type=? AND uri>=? AND uri<? AND name=? AND value<?",
 
 	//[STICKER_SQL_FIND_GT] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value>?",
+	"SELECT uri,value FROM sticker WHERE type=? AND uri>=? AND uri<? AND name=? AND value>?",
+
+	/* without a URI prefix, the "sticker_name_value" index
+	   applies */
+
+	//[STICKER_SQL_FIND_ALL] =
+	"SELECT uri,value FROM sticker WHERE type=? AND name=?",
+
+	//[STICKER_SQL_FIND_ALL_VALUE] =
+	"SELECT uri,value FROM sticker WHERE type=? AND name=? AND value=?",
+
+	//[STICKER_SQL_FIND_ALL_LT] =
+	"SELECT uri,value FROM sticker WHERE type=? AND name=? AND value<?",
+
+	//[STICKER_SQL_FIND_ALL_GT] =
+	"SELECT uri,value FROM sticker WHERE type=? AND name=? AND value>?",
 };
 
 static const char sticker_sql_create[] =
@@ -83,11 +109,36 @@ static const char sticker_sql_create[] =
 	");"
 	"CREATE UNIQUE INDEX IF NOT EXISTS"
 	" sticker_value ON sticker(type, uri, name);"
+	"CREATE INDEX IF NOT EXISTS"
+	" sticker_name_value ON sticker(type, name, value);"
 	"";
 
+static const char *const sticker_synchronous_values[] = {
+	"off", "normal", "full",
+};
+
 static sqlite3 *sticker_db;
 static sqlite3_stmt *sticker_stmt[ARRAY_SIZE(sticker_sql)];
 
+/**
+ * Serializes access to #sticker_db and the prepared statements in
+ * #sticker_stmt, because "sticker find" runs in a separate thread.
+ */
+static Mutex sticker_mutex;
+
+/**
+ * The nesting level of sticker_batch_begin().  Protected by
+ * #sticker_mutex.
+ */
+static unsigned sticker_batch_depth;
+
+/**
+ * Has a transaction been started for the current batch?  This
+ * happens with the first modification.  Protected by
+ * #sticker_mutex.
+ */
+static bool sticker_batch_transaction;
+
 static sqlite3_stmt *
 sticker_prepare(const char *sql, Error &error)
 {
@@ -103,13 +154,41 @@ sticker_prepare(const char *sql, Error &error)
 	return stmt;
 }
 
+/**
+ * Execute a SQL statement without parameters and results.
+ */
+static bool
+sticker_exec(const char *sql, Error &error)
+{
+	int ret = sqlite3_exec(sticker_db, sql, nullptr, nullptr, nullptr);
+	if (ret != SQLITE_OK) {
+		error.Format(sqlite_domain, ret,
+			     "Failed to execute \"%s\": %s",
+			     sql, sqlite3_errmsg(sticker_db));
+		return false;
+	}
+
+	return true;
+}
+
 bool
-sticker_global_init(Path path, Error &error)
+sticker_global_init(Path path, const char *synchronous, Error &error)
 {
 	assert(!path.IsNull());
+	assert(synchronous != nullptr);
 
 	int ret;
 
+	unsigned synchronous_index = 0;
+	while (!StringEqualsCaseASCII(synchronous,
+				      sticker_synchronous_values[synchronous_index]))
+		if (++synchronous_index == ARRAY_SIZE(sticker_synchronous_values)) {
+			error.Format(config_domain,
+				     "Invalid sticker_synchronous value: %s",
+				     synchronous);
+			return false;
+		}
+
 	/* open/create the sqlite database */
 
 	ret = sqlite3_open(path.c_str(), &sticker_db);
@@ -121,6 +200,19 @@ sticker_global_init(Path path, Error &error)
 		return false;
 	}
 
+	/* the write-ahead log needs only one fsync() per transaction,
+	   and with synchronous=normal, none at all except at
+	   checkpoints */
+
+	if (!sticker_exec("PRAGMA journal_mode=WAL", error))
+		return false;
+
+	const std::string pragma_synchronous =
+		std::string("PRAGMA synchronous=") +
+		sticker_synchronous_values[synchronous_index];
+	if (!sticker_exec(pragma_synchronous.c_str(), error))
+		return false;
+
 	/* create the table and index */
 
 	ret = sqlite3_exec(sticker_db, sticker_sql_create,
@@ -152,6 +244,8 @@ sticker_global_finish()
 		/* not configured */
 		return;
 
+	assert(sticker_batch_depth == 0);
+
 	for (unsigned i = 0; i < ARRAY_SIZE(sticker_stmt); ++i) {
 		assert(sticker_stmt[i] != nullptr);
 
@@ -167,6 +261,54 @@ sticker_enabled()
 	return sticker_db != nullptr;
 }
 
+void
+sticker_batch_begin()
+{
+	if (!sticker_enabled())
+		return;
+
+	const ScopeLock protect(sticker_mutex);
+	++sticker_batch_depth;
+}
+
+void
+sticker_batch_end()
+{
+	if (!sticker_enabled())
+		return;
+
+	const ScopeLock protect(sticker_mutex);
+	assert(sticker_batch_depth > 0);
+
+	if (--sticker_batch_depth > 0 || !sticker_batch_transaction)
+		return;
+
+	sticker_batch_transaction = false;
+
+	Error error;
+	if (!sticker_exec("COMMIT", error)) {
+		LogError(error);
+		sticker_exec("ROLLBACK", IgnoreError());
+	}
+}
+
+/**
+ * Prepare a modification: inside a batch, start its transaction if
+ * that has not happened yet.  Caller must lock #sticker_mutex.
+ */
+static bool
+sticker_prepare_write(Error &error)
+{
+	if (sticker_batch_depth == 0 || sticker_batch_transaction)
+		return true;
+
+	if (!sticker_exec("BEGIN", error))
+		return false;
+
+	sticker_batch_transaction = true;
+	return true;
+}
+
 std::string
 sticker_load_value(const char *type, const char *uri, const char *name,
 		   Error &error)
@@ -181,6 +323,8 @@ sticker_load_value(const char *type, const char *uri, const char *name,
 	if (*name == 0)
 		return std::string();
 
+	const ScopeLock protect(sticker_mutex);
+
 	if (!BindAll(error, stmt, type, uri, name))
 		return std::string();
 
@@ -290,6 +434,11 @@ sticker_store_value(const char *type, const char *uri,
 	if (*name == 0)
 		return false;
 
+	const ScopeLock protect(sticker_mutex);
+
+	if (!sticker_prepare_write(error))
+		return false;
+
 	return sticker_update_value(type, uri, name, value, error) ||
 		sticker_insert_value(type, uri, name, value, error);
 }
@@ -303,7 +452,10 @@ sticker_delete(const char *type, const char *uri, Error &error)
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
-	if (!BindAll(error, stmt, type, uri))
+	const ScopeLock protect(sticker_mutex);
+
+	if (!sticker_prepare_write(error) ||
+	    !BindAll(error, stmt, type, uri))
 		return false;
 
 	bool modified = ExecuteModified(stmt, error);
@@ -326,7 +478,10 @@ sticker_delete_value(const char *type, const char *uri, const char *name,
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
-	if (!BindAll(error, stmt, type, uri, name))
+	const ScopeLock protect(sticker_mutex);
+
+	if (!sticker_prepare_write(error) ||
+	    !BindAll(error, stmt, type, uri, name))
 		return false;
 
 	bool modified = ExecuteModified(stmt, error);
@@ -370,8 +525,11 @@ sticker_load(const char *type, const char *uri, Error &error)
 {
 	Sticker s;
 
-	if (!sticker_list_values(s.table, type, uri, error))
-		return nullptr;
+	{
+		const ScopeLock protect(sticker_mutex);
+		if (!sticker_list_values(s.table, type, uri, error))
+			return nullptr;
+	}
 
 	if (s.table.empty())
 		/* don't return empty sticker objects */
@@ -380,36 +538,89 @@ sticker_load(const char *type, const char *uri, Error &error)
 	return new Sticker(std::move(s));
 }
 
+/**
+ * Calculate the smallest string which is larger than all strings
+ * beginning with the given prefix.  Returns false if there is none
+ * (i.e. the prefix is empty or consists only of 0xff bytes).
+ */
+static bool
+UpperBound(const char *prefix, std::string &result)
+{
+	result = prefix;
+
+	while (!result.empty()) {
+		unsigned char &last = (unsigned char &)result.back();
+		if (last < 0xff) {
+			++last;
+			return true;
+		}
+
+		result.pop_back();
+	}
+
+	return false;
+}
+
+/**
+ * @param upper the upper bound of the URI range, see UpperBound(),
+ * or nullptr to search all URIs; it must remain valid until the
+ * statement is reset
+ */
 static sqlite3_stmt *
-BindFind(const char *type, const char *base_uri, const char *name,
-	 StickerOperator op, const char *value,
+BindFind(const char *type, const char *base_uri, const char *upper,
+	 const char *name, StickerOperator op, const char *value,
 	 Error &error)
 {
 	assert(type != nullptr);
 	assert(name != nullptr);
 
-	if (base_uri == nullptr)
-		base_uri = "";
-
-	switch (op) {
-	case StickerOperator::EXISTS:
-		return BindAllOrNull(error, sticker_stmt[STICKER_SQL_FIND],
-				     type, base_uri, name);
-
-	case StickerOperator::EQUALS:
-		return BindAllOrNull(error,
-				     sticker_stmt[STICKER_SQL_FIND_VALUE],
-				     type, base_uri, name, value);
-
-	case StickerOperator::LESS_THAN:
-		return BindAllOrNull(error,
-				     sticker_stmt[STICKER_SQL_FIND_LT],
-				     type, base_uri, name, value);
-
-	case StickerOperator::GREATER_THAN:
-		return BindAllOrNull(error,
-				     sticker_stmt[STICKER_SQL_FIND_GT],
-				     type, base_uri, name, value);
+	if (upper == nullptr) {
+		switch (op) {
+		case StickerOperator::EXISTS:
+			return BindAllOrNull(error,
+					     sticker_stmt[STICKER_SQL_FIND_ALL],
+					     type, name);
+
+		case StickerOperator::EQUALS:
+			return BindAllOrNull(error,
+					     sticker_stmt[STICKER_SQL_FIND_ALL_VALUE],
+					     type, name, value);
+
+		case StickerOperator::LESS_THAN:
+			return BindAllOrNull(error,
+					     sticker_stmt[STICKER_SQL_FIND_ALL_LT],
+					     type, name, value);
+
+		case StickerOperator::GREATER_THAN:
+			return BindAllOrNull(error,
+					     sticker_stmt[STICKER_SQL_FIND_ALL_GT],
+					     type, name, value);
+		}
+	} else {
+		switch (op) {
+		case StickerOperator::EXISTS:
+			return BindAllOrNull(error,
+					     sticker_stmt[STICKER_SQL_FIND],
+					     type, base_uri, upper, name);
+
+		case StickerOperator::EQUALS:
+			return BindAllOrNull(error,
+					     sticker_stmt[STICKER_SQL_FIND_VALUE],
+					     type, base_uri, upper, name,
+					     value);
+
+		case StickerOperator::LESS_THAN:
+			return BindAllOrNull(error,
+					     sticker_stmt[STICKER_SQL_FIND_LT],
+					     type, base_uri, upper, name,
+					     value);
+
+		case StickerOperator::GREATER_THAN:
+			return BindAllOrNull(error,
+					     sticker_stmt[STICKER_SQL_FIND_GT],
+					     type, base_uri, upper, name,
+					     value);
+		}
 	}
 
 	assert(false);
@@ -427,8 +638,17 @@ sticker_find(const char *type, const char *base_uri, const char *name,
 	assert(func != nullptr);
 	assert(sticker_enabled());
 
-	sqlite3_stmt *const stmt = BindFind(type, base_uri, name, op, value,
-					    error);
+	if (base_uri == nullptr)
+		base_uri = "";
+
+	std::string upper;
+	const bool has_upper = UpperBound(base_uri, upper);
+
+	const ScopeLock protect(sticker_mutex);
+
+	sqlite3_stmt *const stmt = BindFind(type, base_uri,
+					    has_upper ? upper.c_str() : nullptr,
+					    name, op, value, error);
 	if (stmt == nullptr)
 		return false;
 
@@ -54,10 +54,12 @@ struct Sticker;
 /**
  * Opens the sticker database.
  *
+ * @param synchronous the value of SQLite's "synchronous" setting:
+ * "off", "normal" or "full"
  * @return true on success, false on error
  */
 bool
-sticker_global_init(Path path, Error &error);
+sticker_global_init(Path path, const char *synchronous, Error &error);
 
 /**
  * Close the sticker database.
@@ -72,6 +74,40 @@ gcc_const
 bool
 sticker_enabled();
 
+/**
+ * Begin a batch of sticker operations, e.g. a command list: all
+ * modifications until the matching sticker_batch_end() call are
+ * committed in one transaction.  Batches may be nested.  This is a
+ * no-op if the sticker database is disabled.
+ */
+void
+sticker_batch_begin();
+
+/**
+ * End a batch started with sticker_batch_begin(), and commit its
+ * modifications.  Errors are logged.
+ */
+void
+sticker_batch_end();
+
+/**
+ * Calls sticker_batch_begin() and sticker_batch_end() in the
+ * constructor and the destructor.
+ */
+class ScopeStickerBatch {
+public:
+	ScopeStickerBatch() {
+		sticker_batch_begin();
+	}
+
+	~ScopeStickerBatch() {
+		sticker_batch_end();
+	}
+
+	ScopeStickerBatch(const ScopeStickerBatch &) = delete;
+	ScopeStickerBatch &operator=(const ScopeStickerBatch &) = delete;
+};
+
 /**
  * Returns one value from an object's sticker record.  Returns an
  * empty string if the value doesn't exist.
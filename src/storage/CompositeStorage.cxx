@@ -25,6 +25,7 @@
 #include "util/Domain.hxx"
 
 #include <set>
+#include <algorithm>
 
 #include <string.h>
 
@@ -96,23 +97,58 @@ CompositeDirectoryReader::GetInfo(bool follow, StorageFileInfo &info,
 	return true;
 }
 
-static std::string
-NextSegment(const char *&uri_r)
+/**
+ * Split the next segment from the URI.  Unlike a std::string, this
+ * does not allocate memory.
+ */
+static const char *
+NextSegment(const char *&uri_r, size_t &length_r)
 {
 	const char *uri = uri_r;
 	const char *slash = strchr(uri, '/');
 	if (slash == nullptr) {
-		uri_r += strlen(uri);
-		return std::string(uri);
+		length_r = strlen(uri);
+		uri_r += length_r;
 	} else {
+		length_r = slash - uri;
 		uri_r = slash + 1;
-		return std::string(uri, slash);
 	}
+
+	return uri;
+}
+
+/**
+ * Compare a path segment with a child name, ordering like
+ * std::string::compare().
+ */
+gcc_pure
+static int
+CompareSegment(const std::string &name, const char *segment, size_t length)
+{
+	return name.compare(0, std::string::npos, segment, length);
 }
 
-CompositeStorage::Directory::~Directory()
+template<typename V>
+static auto
+LowerBound(V &children, const char *name, size_t length)
+	-> decltype(children.begin())
 {
-	delete storage;
+	return std::lower_bound(children.begin(), children.end(), name,
+				[length](const typename V::value_type &i,
+					 const char *n){
+					return CompareSegment(i.first,
+							      n, length) < 0;
+				});
+}
+
+const CompositeStorage::Directory *
+CompositeStorage::Directory::FindChild(const char *name, size_t length) const
+{
+	auto i = LowerBound(children, name, length);
+	if (i == children.end() || CompareSegment(i->first, name, length) != 0)
+		return nullptr;
+
+	return &i->second;
 }
 
 const CompositeStorage::Directory *
@@ -120,12 +156,11 @@ CompositeStorage::Directory::Find(const char *uri) const
 {
 	const Directory *directory = this;
 	while (*uri != 0) {
-		const std::string name = NextSegment(uri);
-		auto i = directory->children.find(name);
-		if (i == directory->children.end())
+		size_t length;
+		const char *name = NextSegment(uri, length);
+		directory = directory->FindChild(name, length);
+		if (directory == nullptr)
 			return nullptr;
-
-		directory = &i->second;
 	}
 
 	return directory;
@@ -136,15 +171,17 @@ CompositeStorage::Directory::Make(const char *uri)
 {
 	Directory *directory = this;
 	while (*uri != 0) {
-		const std::string name = NextSegment(uri);
-#if CLANG_OR_GCC_VERSION(4,8)
-		auto i = directory->children.emplace(std::move(name),
-						     Directory());
-#else
-		auto i = directory->children.insert(std::make_pair(std::move(name),
-								   Directory()));
-#endif
-		directory = &i.first->second;
+		size_t length;
+		const char *name = NextSegment(uri, length);
+
+		auto &siblings = directory->children;
+		auto i = LowerBound(siblings, name, length);
+		if (i == siblings.end() ||
+		    CompareSegment(i->first, name, length) != 0)
+			i = siblings.insert(i, Child(std::string(name, length),
+						     Directory()));
+
+		directory = &i->second;
 	}
 
 	return *directory;
@@ -156,8 +193,7 @@ CompositeStorage::Directory::Unmount()
 	if (storage == nullptr)
 		return false;
 
-	delete storage;
-	storage = nullptr;
+	storage.reset();
 	return true;
 }
 
@@ -167,10 +203,13 @@ CompositeStorage::Directory::Unmount(const char *uri)
 	if (*uri == 0)
 		return Unmount();
 
-	const std::string name = NextSegment(uri);
+	size_t length;
+	const char *name = NextSegment(uri, length);
 
-	auto i = children.find(name);
-	if (i == children.end() || !i->second.Unmount(uri))
+	auto i = LowerBound(children, name, length);
+	if (i == children.end() ||
+	    CompareSegment(i->first, name, length) != 0 ||
+	    !i->second.Unmount(uri))
 		return false;
 
 	if (i->second.IsEmpty())
@@ -205,6 +244,7 @@ CompositeStorage::Directory::MapToRelativeUTF8(std::string &buffer,
 }
 
 CompositeStorage::CompositeStorage()
+	:root(std::make_shared<Directory>())
 {
 }
 
@@ -212,17 +252,31 @@ CompositeStorage::~CompositeStorage()
 {
 }
 
+void
+CompositeStorage::SetRoot(Directory &&new_root)
+{
+	DirectoryPtr old_root =
+		std::make_shared<const Directory>(std::move(new_root));
+
+	root_mutex.lock();
+	std::swap(root, old_root);
+	root_mutex.unlock();
+
+	/* the old tree is freed here, outside of the lock, or by the
+	   last thread still using it */
+}
+
 Storage *
 CompositeStorage::GetMount(const char *uri)
 {
-	const ScopeLock protect(mutex);
+	const auto snapshot = GetRoot();
 
-	auto result = FindStorage(uri);
+	auto result = FindStorage(*snapshot, uri);
 	if (*result.uri != 0)
 		/* not a mount point */
 		return nullptr;
 
-	return result.directory->storage;
+	return result.directory->storage.get();
 }
 
 void
@@ -230,10 +284,9 @@ CompositeStorage::Mount(const char *uri, Storage *storage)
 {
 	const ScopeLock protect(mutex);
 
-	Directory &directory = root.Make(uri);
-	if (directory.storage != nullptr)
-		delete directory.storage;
-	directory.storage = storage;
+	Directory new_root(*GetRoot());
+	new_root.Make(uri).storage.reset(storage);
+	SetRoot(std::move(new_root));
 }
 
 bool
@@ -241,23 +294,28 @@ CompositeStorage::Unmount(const char *uri)
 {
 	const ScopeLock protect(mutex);
 
-	return root.Unmount(uri);
+	Directory new_root(*GetRoot());
+	if (!new_root.Unmount(uri))
+		return false;
+
+	SetRoot(std::move(new_root));
+	return true;
 }
 
 CompositeStorage::FindResult
-CompositeStorage::FindStorage(const char *uri) const
+CompositeStorage::FindStorage(const Directory &root, const char *uri)
 {
 	FindResult result{&root, uri};
 
 	const Directory *directory = &root;
 	while (*uri != 0) {
-		const std::string name = NextSegment(uri);
+		size_t length;
+		const char *name = NextSegment(uri, length);
 
-		auto i = directory->children.find(name);
-		if (i == directory->children.end())
+		directory = directory->FindChild(name, length);
+		if (directory == nullptr)
 			break;
 
-		directory = &i->second;
 		if (directory->storage != nullptr)
 			result = FindResult{directory, uri};
 	}
@@ -266,9 +324,10 @@ CompositeStorage::FindStorage(const char *uri) const
 }
 
 CompositeStorage::FindResult
-CompositeStorage::FindStorage(const char *uri, Error &error) const
+CompositeStorage::FindStorage(const Directory &root, const char *uri,
+			      Error &error)
 {
-	auto result = FindStorage(uri);
+	auto result = FindStorage(root, uri);
 	if (result.directory == nullptr)
 		error.Set(composite_domain, "No such directory");
 	return result;
@@ -278,9 +337,9 @@ bool
 CompositeStorage::GetInfo(const char *uri, bool follow, StorageFileInfo &info,
 			  Error &error)
 {
-	const ScopeLock protect(mutex);
+	const auto snapshot = GetRoot();
 
-	auto f = FindStorage(uri, error);
+	auto f = FindStorage(*snapshot, uri, error);
 	if (f.directory->storage != nullptr &&
 	    f.directory->storage->GetInfo(f.uri, follow, info, error))
 		return true;
@@ -302,9 +361,9 @@ StorageDirectoryReader *
 CompositeStorage::OpenDirectory(const char *uri,
 				Error &error)
 {
-	const ScopeLock protect(mutex);
+	const auto snapshot = GetRoot();
 
-	auto f = FindStorage(uri, error);
+	auto f = FindStorage(*snapshot, uri, error);
 	const Directory *directory = f.directory->Find(f.uri);
 	if (directory == nullptr || directory->children.empty()) {
 		/* no virtual directories here */
@@ -320,12 +379,63 @@ CompositeStorage::OpenDirectory(const char *uri,
 	return new CompositeDirectoryReader(other, directory->children);
 }
 
+bool
+CompositeStorage::ListDirectory(const char *uri, bool follow,
+				StorageDirectoryListing &list, Error &error)
+{
+	const auto snapshot = GetRoot();
+
+	auto f = FindStorage(*snapshot, uri, error);
+	const Directory *directory = f.directory->Find(f.uri);
+	if (directory == nullptr || directory->children.empty()) {
+		/* no virtual directories here */
+
+		if (f.directory->storage == nullptr) {
+			error.Set(composite_domain, "No such directory");
+			return false;
+		}
+
+		return f.directory->storage->ListDirectory(f.uri, follow,
+							   list, error);
+	}
+
+	if (f.directory->storage != nullptr)
+		f.directory->storage->ListDirectory(f.uri, follow,
+						    list, IgnoreError());
+
+	/* add the virtual directories which are not shadowed by a
+	   real directory entry */
+
+	const auto &children = directory->children;
+	std::vector<bool> shadowed(children.size(), false);
+	for (const auto &i : list) {
+		auto c = LowerBound(children, i.name.data(), i.name.length());
+		if (c != children.end() && c->first == i.name)
+			shadowed[c - children.begin()] = true;
+	}
+
+	for (size_t i = 0; i < children.size(); ++i) {
+		if (shadowed[i])
+			continue;
+
+		list.emplace_front(children[i].first);
+		StorageFileInfo &info = list.front().info;
+		info.type = StorageFileInfo::Type::DIRECTORY;
+		info.size = 0;
+		info.mtime = 0;
+		info.device = 0;
+		info.inode = 0;
+	}
+
+	return true;
+}
+
 std::string
 CompositeStorage::MapUTF8(const char *uri) const
 {
-	const ScopeLock protect(mutex);
+	const auto snapshot = GetRoot();
 
-	auto f = FindStorage(uri);
+	auto f = FindStorage(*snapshot, uri);
 	if (f.directory->storage == nullptr)
 		return std::string();
 
@@ -335,9 +445,9 @@ CompositeStorage::MapUTF8(const char *uri) const
 AllocatedPath
 CompositeStorage::MapFS(const char *uri) const
 {
-	const ScopeLock protect(mutex);
+	const auto snapshot = GetRoot();
 
-	auto f = FindStorage(uri);
+	auto f = FindStorage(*snapshot, uri);
 	if (f.directory->storage == nullptr)
 		return AllocatedPath::Null();
 
@@ -347,15 +457,18 @@ CompositeStorage::MapFS(const char *uri) const
 const char *
 CompositeStorage::MapToRelativeUTF8(const char *uri) const
 {
-	const ScopeLock protect(mutex);
+	const auto snapshot = GetRoot();
 
-	if (root.storage != nullptr) {
-		const char *result = root.storage->MapToRelativeUTF8(uri);
+	if (snapshot->storage != nullptr) {
+		const char *result = snapshot->storage->MapToRelativeUTF8(uri);
 		if (result != nullptr)
 			return result;
 	}
 
-	if (!root.MapToRelativeUTF8(relative_buffer, uri))
+	/* relative_buffer is shared by all callers */
+	const ScopeLock protect(mutex);
+
+	if (!snapshot->MapToRelativeUTF8(relative_buffer, uri))
 		return nullptr;
 
 	return relative_buffer.c_str();
@@ -23,10 +23,13 @@
 #include "check.h"
 #include "StorageInterface.hxx"
 #include "thread/Mutex.hxx"
+#include "thread/SharedMutex.hxx"
 #include "Compiler.h"
 
 #include <string>
-#include <map>
+#include <vector>
+#include <memory>
+#include <utility>
 
 class Error;
 class Storage;
@@ -37,31 +40,43 @@ class Storage;
  * instances into the storage tree.
  *
  * This class is thread-safe: mounts may be added and removed at any
- * time in any thread.
+ * time in any thread.  The tree is never modified in place: Mount()
+ * and Unmount() build a new copy and publish it, and lookups work on
+ * a snapshot without holding a lock, so a slow #Storage call (e.g. a
+ * NFS request) does not block other threads.
  */
 class CompositeStorage final : public Storage {
 	/**
-	 * A node in the virtual directory tree.
+	 * A node in the virtual directory tree, i.e. a trie of path
+	 * segments.  It is immutable after it has been published.
 	 */
 	struct Directory {
+		typedef std::pair<std::string, Directory> Child;
+
 		/**
 		 * The #Storage mounted n this virtual directory.  All
 		 * "leaf" Directory instances must have a #Storage.
 		 * Other Directory instances may have one, and child
-		 * mounts will be "mixed" in.
+		 * mounts will be "mixed" in.  It is shared by all
+		 * snapshots which contain this mount.
 		 */
-		Storage *storage;
-
-		std::map<std::string, Directory> children;
+		std::shared_ptr<Storage> storage;
 
-		Directory():storage(nullptr) {}
-		~Directory();
+		/**
+		 * Sorted by name, for a binary search which does not
+		 * need to copy the path segment.
+		 */
+		std::vector<Child> children;
 
 		gcc_pure
 		bool IsEmpty() const {
 			return storage == nullptr && children.empty();
 		}
 
+		gcc_pure
+		const Directory *FindChild(const char *name,
+					   size_t length) const;
+
 		gcc_pure
 		const Directory *Find(const char *uri) const;
 
@@ -75,19 +90,26 @@ class CompositeStorage final : public Storage {
 				       const char *uri) const;
 	};
 
+	typedef std::shared_ptr<const Directory> DirectoryPtr;
+
 	struct FindResult {
 		const Directory *directory;
 		const char *uri;
 	};
 
 	/**
-	 * Protects the virtual #Directory tree.
-	 *
-	 * TODO: use readers-writer lock
+	 * Serializes Mount() and Unmount(), and protects
+	 * #relative_buffer.
 	 */
 	mutable Mutex mutex;
 
-	Directory root;
+	/**
+	 * Protects the #root pointer; it is held only while copying or
+	 * replacing the pointer.
+	 */
+	mutable SharedMutex root_mutex;
+
+	DirectoryPtr root;
 
 	mutable std::string relative_buffer;
 
@@ -113,9 +135,9 @@ public:
 	 */
 	template<typename T>
 	void VisitMounts(T t) const {
-		const ScopeLock protect(mutex);
+		const auto snapshot = GetRoot();
 		std::string uri;
-		VisitMounts(uri, root, t);
+		VisitMounts(uri, *snapshot, t);
 	}
 
 	void Mount(const char *uri, Storage *storage);
@@ -128,6 +150,10 @@ public:
 	StorageDirectoryReader *OpenDirectory(const char *uri,
 					      Error &error) override;
 
+	bool ListDirectory(const char *uri, bool follow,
+			   StorageDirectoryListing &list,
+			   Error &error) override;
+
 	std::string MapUTF8(const char *uri) const override;
 
 	AllocatedPath MapFS(const char *uri) const override;
@@ -135,10 +161,25 @@ public:
 	const char *MapToRelativeUTF8(const char *uri) const override;
 
 private:
+	/**
+	 * Obtain a reference to the current tree.
+	 */
+	DirectoryPtr GetRoot() const {
+		root_mutex.lock_shared();
+		DirectoryPtr result = root;
+		root_mutex.unlock_shared();
+		return result;
+	}
+
+	/**
+	 * Replace the tree.  Caller must lock #mutex.
+	 */
+	void SetRoot(Directory &&new_root);
+
 	template<typename T>
 	void VisitMounts(std::string &uri, const Directory &directory,
 			 T t) const {
-		const Storage *const storage = directory.storage;
+		const Storage *const storage = directory.storage.get();
 		if (storage != nullptr)
 			t(uri.c_str(), *storage);
 
@@ -156,11 +197,10 @@ private:
 	}
 
 	gcc_pure
-	FindResult FindStorage(const char *uri) const;
-	FindResult FindStorage(const char *uri, Error &error) const;
-
-	const char *MapToRelativeUTF8(const Directory &directory,
-				      const char *uri) const;
+	static FindResult FindStorage(const Directory &root,
+				      const char *uri);
+	static FindResult FindStorage(const Directory &root,
+				      const char *uri, Error &error);
 };
 
 #endif
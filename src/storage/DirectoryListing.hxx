@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STORAGE_DIRECTORY_LISTING_HXX
+#define MPD_STORAGE_DIRECTORY_LISTING_HXX
+
+#include "check.h"
+#include "FileInfo.hxx"
+
+#include <string>
+#include <forward_list>
+#include <utility>
+
+/**
+ * A directory entry with its #StorageFileInfo, as returned by
+ * Storage::ListDirectory().
+ */
+struct StorageDirectoryEntry {
+	/**
+	 * The name of the entry (UTF-8), without the directory
+	 * path.
+	 */
+	std::string name;
+
+	StorageFileInfo info;
+
+	template<typename N>
+	explicit StorageDirectoryEntry(N &&_name)
+		:name(std::forward<N>(_name)) {}
+};
+
+/**
+ * All entries of a directory, in no particular order.
+ */
+typedef std::forward_list<StorageDirectoryEntry> StorageDirectoryListing;
+
+#endif
@@ -22,10 +22,7 @@
 
 #include "check.h"
 #include "StorageInterface.hxx"
-#include "FileInfo.hxx"
-
-#include <string>
-#include <forward_list>
+#include "DirectoryListing.hxx"
 
 /**
  * A #StorageDirectoryReader implementation that returns directory
@@ -33,16 +30,8 @@
  */
 class MemoryStorageDirectoryReader final : public StorageDirectoryReader {
 public:
-	struct Entry {
-		std::string name;
-
-		StorageFileInfo info;
-
-		template<typename N>
-		explicit Entry(N &&_name):name(std::forward<N>(_name)) {}
-	};
-
-	typedef std::forward_list<Entry> List;
+	typedef StorageDirectoryEntry Entry;
+	typedef StorageDirectoryListing List;
 
 private:
 	List entries;
@@ -21,6 +21,11 @@
 #include "StorageInterface.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/Traits.hxx"
+#include "util/Error.hxx"
+
+#include <memory>
+
+#include <assert.h>
 
 AllocatedPath
 Storage::MapFS(gcc_unused const char *uri_utf8) const
@@ -35,3 +40,25 @@ Storage::MapChildFS(const char *uri_utf8,
 	const auto uri2 = PathTraitsUTF8::Build(uri_utf8, child_utf8);
 	return MapFS(uri2.c_str());
 }
+
+bool
+Storage::ListDirectory(const char *uri_utf8, bool follow,
+		       StorageDirectoryListing &list, Error &error)
+{
+	assert(list.empty());
+
+	const std::unique_ptr<StorageDirectoryReader>
+		reader(OpenDirectory(uri_utf8, error));
+	if (reader == nullptr)
+		return false;
+
+	const char *name;
+	while ((name = reader->Read()) != nullptr) {
+		list.emplace_front(name);
+		if (!reader->GetInfo(follow, list.front().info,
+				     IgnoreError()))
+			list.pop_front();
+	}
+
+	return true;
+}
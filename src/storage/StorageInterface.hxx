@@ -21,6 +21,7 @@
 #define MPD_STORAGE_INTERFACE_HXX
 
 #include "check.h"
+#include "DirectoryListing.hxx"
 #include "Compiler.h"
 
 #include <string>
@@ -53,6 +54,22 @@ public:
 	virtual StorageDirectoryReader *OpenDirectory(const char *uri_utf8,
 						      Error &error) = 0;
 
+	/**
+	 * Read all entries of a directory together with their
+	 * #StorageFileInfo.  Unlike OpenDirectory() and
+	 * StorageDirectoryReader::GetInfo(), remote storages need
+	 * only one request per directory instead of one per entry.
+	 *
+	 * Entries whose #StorageFileInfo cannot be obtained are
+	 * omitted.  The default implementation uses OpenDirectory().
+	 *
+	 * @param list an empty list which receives the entries
+	 * @return false on error (the directory could not be read)
+	 */
+	virtual bool ListDirectory(const char *uri_utf8, bool follow,
+				   StorageDirectoryListing &list,
+				   Error &error);
+
 	/**
 	 * Map the given relative URI to an absolute URI.
 	 */
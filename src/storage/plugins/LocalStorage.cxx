@@ -29,6 +29,17 @@
 
 #include <string>
 
+#include <errno.h>
+
+#ifndef WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef HAVE_STATX
+#include <sys/sysmacros.h>
+#endif
+#endif
+
 class LocalDirectoryReader final : public StorageDirectoryReader {
 	AllocatedPath base_fs;
 
@@ -68,6 +79,12 @@ public:
 	StorageDirectoryReader *OpenDirectory(const char *uri_utf8,
 					      Error &error) override;
 
+#ifndef WIN32
+	bool ListDirectory(const char *uri_utf8, bool follow,
+			   StorageDirectoryListing &list,
+			   Error &error) override;
+#endif
+
 	std::string MapUTF8(const char *uri_utf8) const override;
 
 	AllocatedPath MapFS(const char *uri_utf8) const override;
@@ -179,6 +196,99 @@ SkipNameFS(PathTraitsFS::const_pointer name_fs)
 		 (name_fs[1] == '.' && name_fs[2] == 0));
 }
 
+#ifndef WIN32
+
+/**
+ * Obtain the attributes of a directory entry relative to the
+ * directory file descriptor, so the kernel needs to resolve only a
+ * single path component.
+ */
+static bool
+StatAt(int dir_fd, const char *name_fs, bool follow, StorageFileInfo &info)
+{
+#ifdef HAVE_STATX
+	/* request only the attributes we need; this may save work
+	   on some filesystems, e.g. on network mounts */
+	struct statx stx;
+	if (statx(dir_fd, name_fs,
+		  (follow ? 0 : AT_SYMLINK_NOFOLLOW) | AT_STATX_DONT_SYNC,
+		  STATX_TYPE|STATX_SIZE|STATX_MTIME|STATX_INO, &stx) < 0)
+		return false;
+
+	if (S_ISREG(stx.stx_mode))
+		info.type = StorageFileInfo::Type::REGULAR;
+	else if (S_ISDIR(stx.stx_mode))
+		info.type = StorageFileInfo::Type::DIRECTORY;
+	else
+		info.type = StorageFileInfo::Type::OTHER;
+
+	info.size = stx.stx_size;
+	info.mtime = stx.stx_mtime.tv_sec;
+	info.device = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+	info.inode = stx.stx_ino;
+#else
+	struct stat st;
+	if (fstatat(dir_fd, name_fs, &st,
+		    follow ? 0 : AT_SYMLINK_NOFOLLOW) < 0)
+		return false;
+
+	if (S_ISREG(st.st_mode))
+		info.type = StorageFileInfo::Type::REGULAR;
+	else if (S_ISDIR(st.st_mode))
+		info.type = StorageFileInfo::Type::DIRECTORY;
+	else
+		info.type = StorageFileInfo::Type::OTHER;
+
+	info.size = st.st_size;
+	info.mtime = st.st_mtime;
+	info.device = st.st_dev;
+	info.inode = st.st_ino;
+#endif
+	return true;
+}
+
+bool
+LocalStorage::ListDirectory(const char *uri_utf8, bool follow,
+			    StorageDirectoryListing &list, Error &error)
+{
+	const AllocatedPath path_fs = MapFS(uri_utf8, error);
+	if (path_fs.IsNull())
+		return false;
+
+	DIR *const dir = opendir(path_fs.c_str());
+	if (dir == nullptr) {
+		error.FormatErrno("Failed to open '%s'", uri_utf8);
+		return false;
+	}
+
+	/* stat() the entries relative to the directory file
+	   descriptor, so the kernel does not need to resolve the
+	   whole path again for each one */
+	const int dir_fd = dirfd(dir);
+
+	const struct dirent *ent;
+	while ((ent = readdir(dir)) != nullptr) {
+		if (SkipNameFS(ent->d_name))
+			continue;
+
+		StorageFileInfo info;
+		if (!StatAt(dir_fd, ent->d_name, follow, info))
+			continue;
+
+		std::string name_utf8 = Path::FromFS(ent->d_name).ToUTF8();
+		if (name_utf8.empty())
+			continue;
+
+		list.emplace_front(std::move(name_utf8));
+		list.front().info = info;
+	}
+
+	closedir(dir);
+	return true;
+}
+
+#endif
+
 const char *
 LocalDirectoryReader::Read()
 {
@@ -200,9 +310,21 @@ LocalDirectoryReader::Read()
 bool
 LocalDirectoryReader::GetInfo(bool follow, StorageFileInfo &info, Error &error)
 {
+#ifndef WIN32
+	const Path name_fs = reader.GetEntry();
+	if (StatAt(reader.GetFD(), name_fs.c_str(), follow, info))
+		return true;
+
+	const int e = errno;
+	const std::string path_utf8 =
+		AllocatedPath::Build(base_fs, name_fs).ToUTF8();
+	error.FormatErrno(e, "Failed to access %s", path_utf8.c_str());
+	return false;
+#else
 	const AllocatedPath path_fs =
 		AllocatedPath::Build(base_fs, reader.GetEntry());
 	return Stat(path_fs, follow, info, error);
+#endif
 }
 
 Storage *
@@ -90,6 +90,10 @@ public:
 	StorageDirectoryReader *OpenDirectory(const char *uri_utf8,
 					      Error &error) override;
 
+	bool ListDirectory(const char *uri_utf8, bool follow,
+			   StorageDirectoryListing &list,
+			   Error &error) override;
+
 	std::string MapUTF8(const char *uri_utf8) const override;
 
 	const char *MapToRelativeUTF8(const char *uri_utf8) const override;
@@ -340,6 +344,10 @@ public:
 		return new MemoryStorageDirectoryReader(std::move(entries));
 	}
 
+	void MoveTo(StorageDirectoryListing &list) {
+		list = std::move(entries);
+	}
+
 protected:
 	bool Start(Error &_error) override {
 		return connection.OpenDirectory(path, *this, _error);
@@ -395,6 +403,29 @@ NfsStorage::OpenDirectory(const char *uri_utf8, Error &error)
 	return operation.ToReader();
 }
 
+bool
+NfsStorage::ListDirectory(const char *uri_utf8, gcc_unused bool follow,
+			  StorageDirectoryListing &list, Error &error)
+{
+	/* libnfs reads directories with READDIRPLUS, which returns
+	   the attributes of all entries, so this needs no additional
+	   request */
+
+	const std::string path = UriToNfsPath(uri_utf8, error);
+	if (path.empty())
+		return false;
+
+	if (!WaitConnected(error))
+		return false;
+
+	NfsListDirectoryOperation operation(*connection, path.c_str());
+	if (!operation.Run(error))
+		return false;
+
+	operation.MoveTo(list);
+	return true;
+}
+
 static Storage *
 CreateNfsStorageURI(EventLoop &event_loop, const char *base,
 		    Error &error)
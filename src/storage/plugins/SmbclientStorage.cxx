@@ -23,22 +23,24 @@
 #include "storage/StorageInterface.hxx"
 #include "storage/FileInfo.hxx"
 #include "lib/smbclient/Init.hxx"
-#include "lib/smbclient/Mutex.hxx"
+#include "lib/smbclient/Context.hxx"
 #include "fs/Traits.hxx"
 #include "util/Error.hxx"
-#include "thread/Mutex.hxx"
 
-#include <libsmbclient.h>
+#include <memory>
 
 class SmbclientDirectoryReader final : public StorageDirectoryReader {
+	SmbclientContext &ctx;
+
 	const std::string base;
-	const unsigned handle;
+	SMBCFILE *const handle;
 
 	const char *name;
 
 public:
-	SmbclientDirectoryReader(std::string &&_base, unsigned _handle)
-		:base(std::move(_base)), handle(_handle) {}
+	SmbclientDirectoryReader(SmbclientContext &_ctx,
+				 std::string &&_base, SMBCFILE *_handle)
+		:ctx(_ctx), base(std::move(_base)), handle(_handle) {}
 
 	virtual ~SmbclientDirectoryReader();
 
@@ -48,21 +50,19 @@ public:
 		     Error &error) override;
 };
 
+/**
+ * Each storage has its own libsmbclient context, so the database
+ * update does not block (and is not blocked by) the input streams.
+ */
 class SmbclientStorage final : public Storage {
 	const std::string base;
 
-	SMBCCTX *const ctx;
+	const std::unique_ptr<SmbclientContext> ctx;
 
 public:
-	SmbclientStorage(const char *_base, SMBCCTX *_ctx)
+	SmbclientStorage(const char *_base, SmbclientContext *_ctx)
 		:base(_base), ctx(_ctx) {}
 
-	virtual ~SmbclientStorage() {
-		smbclient_mutex.lock();
-		smbc_free_context(ctx, 1);
-		smbclient_mutex.unlock();
-	}
-
 	/* virtual methods from class Storage */
 	bool GetInfo(const char *uri_utf8, bool follow, StorageFileInfo &info,
 		     Error &error) override;
@@ -70,6 +70,12 @@ public:
 	StorageDirectoryReader *OpenDirectory(const char *uri_utf8,
 					      Error &error) override;
 
+#ifdef HAVE_SMBC_READDIRPLUS
+	bool ListDirectory(const char *uri_utf8, bool follow,
+			   StorageDirectoryListing &list,
+			   Error &error) override;
+#endif
+
 	std::string MapUTF8(const char *uri_utf8) const override;
 
 	const char *MapToRelativeUTF8(const char *uri_utf8) const override;
@@ -93,16 +99,12 @@ SmbclientStorage::MapToRelativeUTF8(const char *uri_utf8) const
 }
 
 static bool
-GetInfo(const char *path, StorageFileInfo &info, Error &error)
+GetInfo(SmbclientContext &ctx, const char *path, StorageFileInfo &info,
+	Error &error)
 {
 	struct stat st;
-	smbclient_mutex.lock();
-	bool success = smbc_stat(path, &st) == 0;
-	smbclient_mutex.unlock();
-	if (!success) {
-		error.SetErrno();
+	if (!ctx.Stat(path, st, error))
 		return false;
-	}
 
 	if (S_ISREG(st.st_mode))
 		info.type = StorageFileInfo::Type::REGULAR;
@@ -123,22 +125,18 @@ SmbclientStorage::GetInfo(const char *uri_utf8, gcc_unused bool follow,
 			  StorageFileInfo &info, Error &error)
 {
 	const std::string mapped = MapUTF8(uri_utf8);
-	return ::GetInfo(mapped.c_str(), info, error);
+	return ::GetInfo(*ctx, mapped.c_str(), info, error);
 }
 
 StorageDirectoryReader *
 SmbclientStorage::OpenDirectory(const char *uri_utf8, Error &error)
 {
 	std::string mapped = MapUTF8(uri_utf8);
-	smbclient_mutex.lock();
-	int handle = smbc_opendir(mapped.c_str());
-	smbclient_mutex.unlock();
-	if (handle < 0) {
-		error.SetErrno();
+	SMBCFILE *handle = ctx->OpenDirectory(mapped.c_str(), error);
+	if (handle == nullptr)
 		return nullptr;
-	}
 
-	return new SmbclientDirectoryReader(std::move(mapped.c_str()), handle);
+	return new SmbclientDirectoryReader(*ctx, std::move(mapped), handle);
 }
 
 gcc_pure
@@ -150,20 +148,56 @@ SkipNameFS(const char *name)
 		 (name[1] == '.' && name[2] == 0));
 }
 
+#ifdef HAVE_SMBC_READDIRPLUS
+
+static void
+Copy(StorageFileInfo &info, const struct libsmb_file_info &src)
+{
+	info.type = src.attrs & SMBC_DOS_MODE_DIRECTORY
+		? StorageFileInfo::Type::DIRECTORY
+		: StorageFileInfo::Type::REGULAR;
+	info.size = src.size;
+	info.mtime = src.mtime_ts.tv_sec;
+
+	/* not available in the listing */
+	info.device = 0;
+	info.inode = 0;
+}
+
+bool
+SmbclientStorage::ListDirectory(const char *uri_utf8, gcc_unused bool follow,
+				StorageDirectoryListing &list, Error &error)
+{
+	const std::string mapped = MapUTF8(uri_utf8);
+	SMBCFILE *handle = ctx->OpenDirectory(mapped.c_str(), error);
+	if (handle == nullptr)
+		return false;
+
+	const struct libsmb_file_info *i;
+	while ((i = ctx->ReadDirectoryPlus(handle)) != nullptr) {
+		if (SkipNameFS(i->name))
+			continue;
+
+		list.emplace_front(i->name);
+		Copy(list.front().info, *i);
+	}
+
+	ctx->CloseDirectory(handle);
+	return true;
+}
+
+#endif
+
 SmbclientDirectoryReader::~SmbclientDirectoryReader()
 {
-	smbclient_mutex.lock();
-	smbc_close(handle);
-	smbclient_mutex.unlock();
+	ctx.CloseDirectory(handle);
 }
 
 const char *
 SmbclientDirectoryReader::Read()
 {
-	const ScopeLock protect(smbclient_mutex);
-
-	struct smbc_dirent *e;
-	while ((e = smbc_readdir(handle)) != nullptr) {
+	const struct smbc_dirent *e;
+	while ((e = ctx.ReadDirectory(handle)) != nullptr) {
 		name = e->name;
 		if (!SkipNameFS(name))
 			return name;
@@ -178,7 +212,7 @@ SmbclientDirectoryReader::GetInfo(gcc_unused bool follow,
 				  Error &error)
 {
 	const std::string path = PathTraitsUTF8::Build(base.c_str(), name);
-	return ::GetInfo(path.c_str(), info, error);
+	return ::GetInfo(ctx, path.c_str(), info, error);
 }
 
 static Storage *
@@ -191,21 +225,11 @@ CreateSmbclientStorageURI(gcc_unused EventLoop &event_loop, const char *base,
 	if (!SmbclientInit(error))
 		return nullptr;
 
-	const ScopeLock protect(smbclient_mutex);
-	SMBCCTX *ctx = smbc_new_context();
-	if (ctx == nullptr) {
-		error.SetErrno("smbc_new_context() failed");
+	SmbclientContext *ctx = SmbclientContext::New(error);
+	if (ctx == nullptr)
 		return nullptr;
-	}
-
-	SMBCCTX *ctx2 = smbc_init_context(ctx);
-	if (ctx2 == nullptr) {
-		error.SetErrno("smbc_init_context() failed");
-		smbc_free_context(ctx, 1);
-		return nullptr;
-	}
 
-	return new SmbclientStorage(base, ctx2);
+	return new SmbclientStorage(base, ctx);
 }
 
 const StoragePlugin smbclient_storage_plugin = {
@@ -118,6 +118,20 @@ MonotonicClockUS(void)
 #endif
 }
 
+uint64_t
+ThreadCpuTimeUS()
+{
+#if !defined(WIN32) && !defined(__APPLE__) && defined(CLOCK_THREAD_CPUTIME_ID)
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+		return 0;
+
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)(ts.tv_nsec / 1000);
+#else
+	return 0;
+#endif
+}
+
 #ifdef WIN32
 
 gcc_const
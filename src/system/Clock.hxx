@@ -45,6 +45,14 @@ gcc_pure
 uint64_t
 MonotonicClockUS();
 
+/**
+ * Returns the CPU time consumed by the calling thread in
+ * microseconds, or 0 if this is not supported on this platform.
+ */
+gcc_pure
+uint64_t
+ThreadCpuTimeUS();
+
 #ifdef WIN32
 
 /**
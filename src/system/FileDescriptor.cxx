@@ -175,6 +175,41 @@ FileDescriptor::Rewind()
 	return lseek(fd, 0, SEEK_SET) == 0;
 }
 
+void
+FileDescriptor::AdviseSequential()
+{
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+void
+FileDescriptor::AdviseRandom()
+{
+#ifdef POSIX_FADV_RANDOM
+	posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+#endif
+}
+
+void
+FileDescriptor::AdviseWillNeed(off_t offset, off_t length)
+{
+#ifdef POSIX_FADV_WILLNEED
+	posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED);
+#else
+	(void)offset;
+	(void)length;
+#endif
+}
+
+void
+FileDescriptor::AdviseDontNeed()
+{
+#ifdef POSIX_FADV_DONTNEED
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+}
+
 off_t
 FileDescriptor::GetSize() const
 {
@@ -157,6 +157,34 @@ public:
 	gcc_pure
 	off_t GetSize() const;
 
+	/**
+	 * Tell the kernel that the file will be read sequentially,
+	 * which enables aggressive read-ahead.
+	 *
+	 * This and the following methods wrap posix_fadvise().  They
+	 * are only hints; errors are ignored, and they do nothing on
+	 * systems which don't support it.
+	 */
+	void AdviseSequential();
+
+	/**
+	 * Tell the kernel that only small parts of the file will be
+	 * read, which disables read-ahead.
+	 */
+	void AdviseRandom();
+
+	/**
+	 * Start loading the specified range into the page cache
+	 * asynchronously.
+	 */
+	void AdviseWillNeed(off_t offset, off_t length);
+
+	/**
+	 * Evict the (clean) pages of the whole file from the page
+	 * cache.
+	 */
+	void AdviseDontNeed();
+
 	ssize_t Read(void *buffer, size_t length) {
 		return ::read(fd, buffer, length);
 	}
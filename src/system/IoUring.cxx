@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#ifdef HAVE_IO_URING
+#include "IoUring.hxx"
+#include "util/Error.hxx"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+
+template<typename T>
+static inline T *
+RingPointer(void *ring, unsigned offset)
+{
+	return (T *)((char *)ring + offset);
+}
+
+bool
+IoUring::Open(unsigned entries, Error &error)
+{
+	assert(!IsDefined());
+
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	fd = syscall(__NR_io_uring_setup, entries, &params);
+	if (fd < 0) {
+		error.SetErrno("io_uring_setup() failed");
+		return false;
+	}
+
+	features = params.features;
+
+	sq_ring_size = params.sq_off.array +
+		params.sq_entries * sizeof(unsigned);
+	cq_ring_size = params.cq_off.cqes +
+		params.cq_entries * sizeof(io_uring_cqe);
+
+	const bool single_mmap = HasFeature(IORING_FEAT_SINGLE_MMAP);
+	if (single_mmap && cq_ring_size > sq_ring_size)
+		sq_ring_size = cq_ring_size;
+
+	sq_ring = mmap(nullptr, sq_ring_size, PROT_READ|PROT_WRITE,
+		       MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq_ring == MAP_FAILED) {
+		error.SetErrno("mmap(IORING_OFF_SQ_RING) failed");
+		close(fd);
+		fd = -1;
+		return false;
+	}
+
+	if (single_mmap) {
+		cq_ring = sq_ring;
+	} else {
+		cq_ring = mmap(nullptr, cq_ring_size, PROT_READ|PROT_WRITE,
+			       MAP_SHARED|MAP_POPULATE, fd,
+			       IORING_OFF_CQ_RING);
+		if (cq_ring == MAP_FAILED) {
+			error.SetErrno("mmap(IORING_OFF_CQ_RING) failed");
+			munmap(sq_ring, sq_ring_size);
+			close(fd);
+			fd = -1;
+			return false;
+		}
+	}
+
+	sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+	sqes = (io_uring_sqe *)mmap(nullptr, sqes_size,
+				    PROT_READ|PROT_WRITE,
+				    MAP_SHARED|MAP_POPULATE, fd,
+				    IORING_OFF_SQES);
+	if (sqes == MAP_FAILED) {
+		error.SetErrno("mmap(IORING_OFF_SQES) failed");
+		if (cq_ring != sq_ring)
+			munmap(cq_ring, cq_ring_size);
+		munmap(sq_ring, sq_ring_size);
+		close(fd);
+		fd = -1;
+		return false;
+	}
+
+	sq_head = RingPointer<unsigned>(sq_ring, params.sq_off.head);
+	sq_tail = RingPointer<unsigned>(sq_ring, params.sq_off.tail);
+	sq_mask = RingPointer<unsigned>(sq_ring, params.sq_off.ring_mask);
+	sq_entries = RingPointer<unsigned>(sq_ring,
+					   params.sq_off.ring_entries);
+	sq_array = RingPointer<unsigned>(sq_ring, params.sq_off.array);
+
+	cq_head = RingPointer<unsigned>(cq_ring, params.cq_off.head);
+	cq_tail = RingPointer<unsigned>(cq_ring, params.cq_off.tail);
+	cq_mask = RingPointer<unsigned>(cq_ring, params.cq_off.ring_mask);
+	cqes = RingPointer<io_uring_cqe>(cq_ring, params.cq_off.cqes);
+
+	sqe_tail = *sq_tail;
+	return true;
+}
+
+void
+IoUring::Close()
+{
+	if (!IsDefined())
+		return;
+
+	munmap(sqes, sqes_size);
+	if (cq_ring != sq_ring)
+		munmap(cq_ring, cq_ring_size);
+	munmap(sq_ring, sq_ring_size);
+	close(fd);
+	fd = -1;
+}
+
+io_uring_sqe *
+IoUring::GetSqe()
+{
+	assert(IsDefined());
+
+	const unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+	if (sqe_tail - head >= *sq_entries)
+		return nullptr;
+
+	const unsigned index = sqe_tail & *sq_mask;
+	sq_array[index] = index;
+	++sqe_tail;
+
+	io_uring_sqe *sqe = &sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+int
+IoUring::Submit(unsigned wait_nr, int timeout_ms)
+{
+	assert(IsDefined());
+
+	const unsigned to_submit = sqe_tail - *sq_tail;
+	__atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+
+	if (to_submit == 0 && wait_nr == 0)
+		return 0;
+
+	unsigned flags = 0;
+	if (wait_nr > 0)
+		flags |= IORING_ENTER_GETEVENTS;
+
+	void *arg = nullptr;
+	size_t arg_size = 0;
+
+	__kernel_timespec ts;
+	io_uring_getevents_arg getevents_arg;
+	if (wait_nr > 0 && timeout_ms >= 0) {
+		assert(HasFeature(IORING_FEAT_EXT_ARG));
+
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+		memset(&getevents_arg, 0, sizeof(getevents_arg));
+		getevents_arg.sigmask_sz = _NSIG / 8;
+		getevents_arg.ts = (uint64_t)(uintptr_t)&ts;
+
+		flags |= IORING_ENTER_EXT_ARG;
+		arg = &getevents_arg;
+		arg_size = sizeof(getevents_arg);
+	}
+
+	int result = syscall(__NR_io_uring_enter, fd, to_submit, wait_nr,
+			     flags, arg, arg_size);
+	if (result < 0) {
+		if (errno == EINTR || errno == ETIME)
+			return 0;
+
+		return -errno;
+	}
+
+	return result;
+}
+
+#endif
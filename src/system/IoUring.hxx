@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_IO_URING_HXX
+#define MPD_IO_URING_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <linux/io_uring.h>
+
+#include <assert.h>
+#include <stddef.h>
+
+class Error;
+
+/**
+ * A minimal wrapper for a Linux io_uring instance, using the system
+ * calls directly.
+ *
+ * This class is not thread-safe.
+ */
+class IoUring {
+	int fd;
+
+	unsigned features;
+
+	void *sq_ring, *cq_ring;
+	size_t sq_ring_size, cq_ring_size;
+
+	io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_entries, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	io_uring_cqe *cqes;
+
+	/**
+	 * The local copy of the submission queue tail; entries up to
+	 * here have been prepared, but not yet published to the
+	 * kernel.
+	 */
+	unsigned sqe_tail;
+
+public:
+	IoUring():fd(-1) {}
+
+	~IoUring() {
+		Close();
+	}
+
+	IoUring(const IoUring &) = delete;
+	IoUring &operator=(const IoUring &) = delete;
+
+	bool IsDefined() const {
+		return fd >= 0;
+	}
+
+	/**
+	 * Create the io_uring instance.
+	 *
+	 * @param entries the minimum size of the submission queue
+	 */
+	bool Open(unsigned entries, Error &error);
+
+	void Close();
+
+	bool HasFeature(unsigned feature) const {
+		assert(IsDefined());
+
+		return (features & feature) != 0;
+	}
+
+	/**
+	 * Obtain a cleared submission queue entry.  Returns nullptr
+	 * if the queue is full; call Submit() and try again.
+	 */
+	io_uring_sqe *GetSqe();
+
+	/**
+	 * Submit all prepared entries to the kernel, and optionally
+	 * wait for completions.
+	 *
+	 * @param wait_nr the number of completions to wait for
+	 * @param timeout_ms the maximum wait time; -1 means no limit
+	 * (requires #IORING_FEAT_EXT_ARG)
+	 * @return the number of submitted entries or a negative errno
+	 * value; an interrupted or timed out wait is not an error
+	 */
+	int Submit(unsigned wait_nr=0, int timeout_ms=-1);
+
+	/**
+	 * Returns the next completion, or nullptr if there is none.
+	 * Call SeenCqe() after processing it.
+	 */
+	gcc_pure
+	const io_uring_cqe *PeekCqe() const {
+		assert(IsDefined());
+
+		const unsigned head = *cq_head;
+		if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+			return nullptr;
+
+		return &cqes[head & *cq_mask];
+	}
+
+	void SeenCqe() {
+		assert(IsDefined());
+
+		__atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+	}
+};
+
+#endif
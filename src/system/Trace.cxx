@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Trace.hxx"
+#include "thread/Mutex.hxx"
+
+#include <algorithm>
+
+#include <stdio.h>
+
+#ifdef HAVE_PRCTL
+#include <sys/prctl.h>
+#endif
+
+/**
+ * The number of events in each thread's ring buffer.  Must be a
+ * power of two.
+ */
+static constexpr unsigned TRACE_BUFFER_SIZE = 16384;
+
+std::atomic_bool trace_enabled;
+
+/**
+ * A single-producer ring buffer owned by one thread.  Only the owner
+ * writes events; trace_snapshot() reads them without locking, and
+ * discards the ones which may have been overwritten meanwhile.
+ */
+struct TraceBuffer {
+	/**
+	 * The next buffer in #trace_buffers.  Protected by
+	 * #trace_mutex.
+	 */
+	TraceBuffer *next;
+
+	/**
+	 * Is this buffer owned by a thread?  After the thread exits,
+	 * the buffer is kept for trace_snapshot() and may be reused
+	 * by a new thread.  Protected by #trace_mutex.
+	 */
+	bool in_use;
+
+	/**
+	 * The thread id shown in the trace.  Protected by
+	 * #trace_mutex.
+	 */
+	unsigned tid;
+
+	char thread_name[16];
+
+	/**
+	 * The total number of events written to this buffer.
+	 */
+	std::atomic<uint64_t> head;
+
+	TraceEvent events[TRACE_BUFFER_SIZE];
+};
+
+static Mutex trace_mutex;
+static TraceBuffer *trace_buffers;
+static unsigned trace_next_tid;
+
+/**
+ * Releases the calling thread's buffer when the thread exits.
+ */
+struct TraceThread {
+	TraceBuffer *buffer = nullptr;
+
+	~TraceThread() {
+		if (buffer != nullptr) {
+			const ScopeLock protect(trace_mutex);
+			buffer->in_use = false;
+		}
+	}
+};
+
+static thread_local TraceThread trace_thread;
+
+static void
+trace_get_thread_name(char (&buffer)[16], unsigned tid)
+{
+#if defined(HAVE_PRCTL) && defined(PR_GET_NAME)
+	if (prctl(PR_GET_NAME, (unsigned long)buffer, 0, 0, 0) == 0) {
+		buffer[sizeof(buffer) - 1] = 0;
+		return;
+	}
+#endif
+
+	snprintf(buffer, sizeof(buffer), "thread %u", tid);
+}
+
+/**
+ * Find an unused buffer or allocate a new one, and assign it to the
+ * calling thread.
+ */
+static TraceBuffer *
+trace_register_thread()
+{
+	const ScopeLock protect(trace_mutex);
+
+	TraceBuffer *buffer = trace_buffers;
+	while (buffer != nullptr && buffer->in_use)
+		buffer = buffer->next;
+
+	if (buffer == nullptr) {
+		buffer = new TraceBuffer();
+		buffer->next = trace_buffers;
+		trace_buffers = buffer;
+	}
+
+	buffer->in_use = true;
+	buffer->tid = ++trace_next_tid;
+	buffer->head.store(0, std::memory_order_relaxed);
+	trace_get_thread_name(buffer->thread_name, buffer->tid);
+
+	return buffer;
+}
+
+void
+trace_add(const char *name, uint64_t start_us, uint64_t end_us,
+	  uint64_t arg)
+{
+	TraceBuffer *buffer = trace_thread.buffer;
+	if (gcc_unlikely(buffer == nullptr))
+		buffer = trace_thread.buffer = trace_register_thread();
+
+	const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+	TraceEvent &event = buffer->events[head & (TRACE_BUFFER_SIZE - 1)];
+	event.name = name;
+	event.start_us = start_us;
+	event.duration_us = end_us - start_us;
+	event.arg = arg;
+
+	buffer->head.store(head + 1, std::memory_order_release);
+}
+
+/**
+ * Copy the events of one buffer into the vector, skipping those
+ * which the owning thread may have overwritten while they were
+ * being copied.
+ */
+static void
+trace_snapshot(const TraceBuffer &buffer, std::vector<TraceEvent> &events)
+{
+	const uint64_t head = buffer.head.load(std::memory_order_acquire);
+	const uint64_t tail = head > TRACE_BUFFER_SIZE
+		? head - TRACE_BUFFER_SIZE
+		: 0;
+
+	events.reserve(head - tail);
+	for (uint64_t i = tail; i != head; ++i)
+		events.push_back(buffer.events[i & (TRACE_BUFFER_SIZE - 1)]);
+
+	/* like a seqlock: the event copies must be complete before
+	   the head is checked again */
+	std::atomic_thread_fence(std::memory_order_acquire);
+	const uint64_t new_head = buffer.head.load(std::memory_order_relaxed);
+
+	/* the writer may be overwriting the slot of event
+	   "new_head - TRACE_BUFFER_SIZE" right now; drop it and all
+	   older ones */
+	if (new_head >= tail + TRACE_BUFFER_SIZE) {
+		const uint64_t n = std::min(new_head - TRACE_BUFFER_SIZE - tail + 1,
+					    head - tail);
+		events.erase(events.begin(), events.begin() + n);
+	}
+}
+
+std::vector<TraceThreadSnapshot>
+trace_snapshot()
+{
+	std::vector<TraceThreadSnapshot> threads;
+
+	const ScopeLock protect(trace_mutex);
+	for (const TraceBuffer *buffer = trace_buffers;
+	     buffer != nullptr; buffer = buffer->next) {
+		threads.emplace_back();
+		TraceThreadSnapshot &t = threads.back();
+		t.tid = buffer->tid;
+		std::copy_n(buffer->thread_name, sizeof(t.name), t.name);
+		trace_snapshot(*buffer, t.events);
+	}
+
+	return threads;
+}
+
+void
+trace_free_buffers()
+{
+	/* the calling thread is the last one; its TraceThread
+	   destructor must not touch the buffer after it has been
+	   freed */
+	trace_thread.buffer = nullptr;
+
+	const ScopeLock protect(trace_mutex);
+	while (trace_buffers != nullptr) {
+		TraceBuffer *buffer = trace_buffers;
+		trace_buffers = buffer->next;
+		delete buffer;
+	}
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/** \file
+ *
+ * A low-overhead tracing facility: each thread records timestamped
+ * events in its own ring buffer, which can be dumped on demand (see
+ * TraceFile.hxx).
+ */
+
+#ifndef MPD_TRACE_HXX
+#define MPD_TRACE_HXX
+
+#include "Clock.hxx"
+#include "Compiler.h"
+
+#include <atomic>
+#include <vector>
+
+#include <stdint.h>
+
+/**
+ * Is tracing enabled?  While it is disabled, #ScopeTrace costs only
+ * one load.
+ */
+extern std::atomic_bool trace_enabled;
+
+struct TraceEvent {
+	/**
+	 * A string literal.
+	 */
+	const char *name;
+
+	/**
+	 * MonotonicClockUS() values.
+	 */
+	uint64_t start_us, duration_us;
+
+	uint64_t arg;
+};
+
+/**
+ * Append a "complete" event to the calling thread's ring buffer.
+ * The buffer is allocated on the first call in each thread.  Once
+ * the buffer is full, the oldest events are overwritten.
+ *
+ * @param name the event name; must be a string literal (only the
+ * pointer is stored)
+ * @param arg an arbitrary number shown with the event, e.g. a byte
+ * count
+ */
+void
+trace_add(const char *name, uint64_t start_us, uint64_t end_us,
+	  uint64_t arg);
+
+/**
+ * Records the lifetime of this object as a trace event.
+ */
+class ScopeTrace {
+	const char *const name;
+
+	/**
+	 * The MonotonicClockUS() value at construction, or 0 if
+	 * tracing is disabled.
+	 */
+	const uint64_t start_us;
+
+	uint64_t arg;
+
+public:
+	explicit ScopeTrace(const char *_name)
+		:name(_name),
+		 start_us(gcc_unlikely(trace_enabled.load(std::memory_order_relaxed))
+			  ? MonotonicClockUS()
+			  : 0),
+		 arg(0) {}
+
+	~ScopeTrace() {
+		if (gcc_unlikely(start_us != 0))
+			trace_add(name, start_us, MonotonicClockUS(), arg);
+	}
+
+	ScopeTrace(const ScopeTrace &) = delete;
+	ScopeTrace &operator=(const ScopeTrace &) = delete;
+
+	void SetArgument(uint64_t _arg) {
+		arg = _arg;
+	}
+};
+
+struct TraceThreadSnapshot {
+	/**
+	 * A small number identifying the thread in the trace.
+	 */
+	unsigned tid;
+
+	char name[16];
+
+	/**
+	 * The events in chronological order.
+	 */
+	std::vector<TraceEvent> events;
+};
+
+/**
+ * Copy the events of all threads (including those which have
+ * exited).  This may be called while other threads add events; the
+ * buffers are not modified.
+ */
+std::vector<TraceThreadSnapshot>
+trace_snapshot();
+
+/**
+ * Free all buffers.  Must be called after all other threads which
+ * have recorded events have exited.
+ */
+void
+trace_free_buffers();
+
+#endif
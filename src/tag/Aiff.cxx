@@ -19,18 +19,14 @@
 
 #include "config.h" /* must be first for large file support */
 #include "Aiff.hxx"
-#include "util/Domain.hxx"
+#include "HeaderReader.hxx"
 #include "system/ByteOrder.hxx"
-#include "Log.hxx"
 
 #include <limits>
 
 #include <stdint.h>
-#include <sys/stat.h>
 #include <string.h>
 
-static constexpr Domain aiff_domain("aiff");
-
 struct aiff_header {
 	char id[4];
 	uint32_t size;
@@ -43,28 +39,17 @@ struct aiff_chunk_header {
 };
 
 size_t
-aiff_seek_id3(FILE *file)
+aiff_seek_id3(HeaderReader &reader)
 {
-	/* determine the file size */
-
-	struct stat st;
-	if (fstat(fileno(file), &st) < 0) {
-		LogErrno(aiff_domain, "Failed to stat file descriptor");
-		return 0;
-	}
-
 	/* seek to the beginning and read the AIFF header */
 
-	if (fseek(file, 0, SEEK_SET) != 0) {
-		LogErrno(aiff_domain, "Failed to seek");
+	if (!reader.Seek(0))
 		return 0;
-	}
 
 	aiff_header header;
-	size_t size = fread(&header, sizeof(header), 1, file);
-	if (size != 1 ||
+	if (!reader.Read(&header, sizeof(header)) ||
 	    memcmp(header.id, "FORM", 4) != 0 ||
-	    FromBE32(header.size) > (uint32_t)st.st_size ||
+	    FromBE32(header.size) > reader.GetSize() ||
 	    (memcmp(header.format, "AIFF", 4) != 0 &&
 	     memcmp(header.format, "AIFC", 4) != 0))
 		/* not a AIFF file */
@@ -74,11 +59,10 @@ aiff_seek_id3(FILE *file)
 		/* read the chunk header */
 
 		aiff_chunk_header chunk;
-		size = fread(&chunk, sizeof(chunk), 1, file);
-		if (size != 1)
+		if (!reader.Read(&chunk, sizeof(chunk)))
 			return 0;
 
-		size = FromBE32(chunk.size);
+		size_t size = FromBE32(chunk.size);
 		if (size > unsigned(std::numeric_limits<int>::max()))
 			/* too dangerous, bail out: possible integer
 			   underflow when casting to off_t */
@@ -92,7 +76,7 @@ aiff_seek_id3(FILE *file)
 			/* found it! */
 			return size;
 
-		if (fseek(file, size, SEEK_CUR) != 0)
+		if (!reader.Skip(size))
 			return 0;
 	}
 }
@@ -26,15 +26,17 @@
 #define MPD_AIFF_HXX
 
 #include <stddef.h>
-#include <stdio.h>
+
+class HeaderReader;
 
 /**
- * Seeks the AIFF file to the ID3 chunk.
+ * Seeks the AIFF file to the ID3 chunk, i.e. positions the reader
+ * at its beginning.
  *
  * @return the size of the ID3 chunk on success, or 0 if this is not a
  * AIFF file or no ID3 chunk was found
  */
 size_t
-aiff_seek_id3(FILE *file);
+aiff_seek_id3(HeaderReader &reader);
 
 #endif
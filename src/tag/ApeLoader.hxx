@@ -27,6 +27,7 @@
 #include <stddef.h>
 
 class Path;
+class TagScanFile;
 
 typedef std::function<bool(unsigned long flags, const char *key,
 			   const char *value,
@@ -42,4 +43,12 @@ typedef std::function<bool(unsigned long flags, const char *key,
 bool
 tag_ape_scan(Path path_fs, ApeTagCallback callback);
 
+/**
+ * Scans the APE tag values from a file which is already open.
+ *
+ * @return false if no APE tag is present
+ */
+bool
+tag_ape_scan(TagScanFile &file, ApeTagCallback callback);
+
 #endif
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "ApeTag.hxx"
 #include "ApeLoader.hxx"
+#include "TagScanFile.hxx"
 #include "Tag.hxx"
 #include "TagTable.hxx"
 #include "TagHandler.hxx"
@@ -104,7 +105,7 @@ tag_ape_import_item(unsigned long flags,
 }
 
 bool
-tag_ape_scan2(Path path_fs,
+tag_ape_scan2(TagScanFile &file,
 	      const struct tag_handler *handler, void *handler_ctx)
 {
 	bool recognized = false;
@@ -119,5 +120,13 @@ tag_ape_scan2(Path path_fs,
 		return true;
 	};
 
-	return tag_ape_scan(path_fs, callback) && recognized;
+	return tag_ape_scan(file, callback) && recognized;
+}
+
+bool
+tag_ape_scan2(Path path_fs,
+	      const struct tag_handler *handler, void *handler_ctx)
+{
+	LocalTagScanFile file(path_fs);
+	return file.IsDefined() && tag_ape_scan2(file, handler, handler_ctx);
 }
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "FlacHeader.hxx"
+#include "HeaderReader.hxx"
+#include "XiphHeader.hxx"
+#include "Id3v2Header.hxx"
+#include "TagHandler.hxx"
+#include "Chrono.hxx"
+
+#include <memory>
+#include <string>
+
+#include <string.h>
+
+enum {
+	FLAC_METADATA_STREAMINFO = 0,
+	FLAC_METADATA_VORBIS_COMMENT = 4,
+	FLAC_METADATA_PICTURE = 6,
+};
+
+/**
+ * The part of the STREAMINFO block which contains the sample rate and
+ * the number of samples.
+ */
+static constexpr size_t FLAC_STREAMINFO_SIZE = 18;
+
+static bool
+flac_scan_streaminfo(HeaderReader &reader, uint32_t length,
+		     const tag_handler &handler, void *handler_ctx)
+{
+	uint8_t b[FLAC_STREAMINFO_SIZE];
+	if (length < sizeof(b) || !reader.Read(b, sizeof(b)) ||
+	    !reader.Skip(length - sizeof(b)))
+		return false;
+
+	const unsigned sample_rate = (unsigned(b[10]) << 12) |
+		(unsigned(b[11]) << 4) | (b[12] >> 4);
+	const uint64_t total_samples = (uint64_t(b[13] & 0x0f) << 32) |
+		(uint64_t(b[14]) << 24) | (uint64_t(b[15]) << 16) |
+		(uint64_t(b[16]) << 8) | uint64_t(b[17]);
+
+	if (sample_rate > 0)
+		tag_handler_invoke_duration(&handler, handler_ctx,
+					    SongTime::FromScale<uint64_t>(total_samples,
+									  sample_rate));
+
+	return true;
+}
+
+static uint32_t
+ReadBE32(const uint8_t *p)
+{
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+		(uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+/**
+ * Parse a PICTURE block: picture type, MIME type, description,
+ * dimensions and the image.
+ */
+static bool
+flac_scan_picture(HeaderReader &reader, uint32_t length,
+		  const tag_handler &handler, void *handler_ctx)
+{
+	std::unique_ptr<uint8_t[]> buffer(new uint8_t[length]);
+	if (!reader.Read(buffer.get(), length))
+		return false;
+
+	const uint8_t *p = buffer.get(), *const end = p + length;
+
+	if (end - p < 8)
+		return true;
+
+	const unsigned type = ReadBE32(p);
+	const uint32_t mime_length = ReadBE32(p + 4);
+	p += 8;
+	if (uint32_t(end - p) < mime_length)
+		return true;
+
+	const std::string mime_type((const char *)p, mime_length);
+	p += mime_length;
+
+	if (end - p < 4)
+		return true;
+
+	const uint32_t description_length = ReadBE32(p);
+	p += 4;
+	if (uint32_t(end - p) < description_length)
+		return true;
+
+	/* skip the description, width, height, depth and the number
+	   of colors */
+	p += description_length;
+	if (end - p < 20)
+		return true;
+
+	const uint32_t data_length = ReadBE32(p + 16);
+	p += 20;
+	if (data_length == 0 || uint32_t(end - p) < data_length)
+		return true;
+
+	tag_handler_invoke_picture(&handler, handler_ctx, mime_type.c_str(),
+				   type, {p, data_length});
+	return true;
+}
+
+bool
+flac_header_scan(HeaderReader &reader,
+		 const tag_handler &handler, void *handler_ctx)
+{
+	uint8_t header[ID3V2_HEADER_SIZE];
+	if (!reader.Read(header, 4))
+		return false;
+
+	if (memcmp(header, "ID3", 3) == 0) {
+		/* skip a (non-standard) ID3v2 tag */
+		if (!reader.Read(header + 4, sizeof(header) - 4))
+			return false;
+
+		const size_t size = id3v2_tag_size(header);
+		if (size == 0 || !reader.Seek(size) ||
+		    !reader.Read(header, 4))
+			return false;
+	}
+
+	if (memcmp(header, "fLaC", 4) != 0)
+		return false;
+
+	bool found_streaminfo = false;
+
+	while (true) {
+		uint8_t block[4];
+		if (!reader.Read(block, sizeof(block)))
+			return false;
+
+		const bool last = (block[0] & 0x80) != 0;
+		const unsigned type = block[0] & 0x7f;
+		const uint32_t length = (uint32_t(block[1]) << 16) |
+			(uint32_t(block[2]) << 8) | uint32_t(block[3]);
+
+		switch (type) {
+		case FLAC_METADATA_STREAMINFO:
+			if (!flac_scan_streaminfo(reader, length,
+						  handler, handler_ctx))
+				return false;
+
+			found_streaminfo = true;
+			break;
+
+		case FLAC_METADATA_VORBIS_COMMENT: {
+			const uint64_t end = reader.Tell() + length;
+			if (!xiph_header_scan_comments(reader,
+						       handler, handler_ctx) ||
+			    reader.Tell() > end || !reader.Seek(end))
+				return false;
+			break;
+		}
+
+		case FLAC_METADATA_PICTURE:
+			if (tag_handler_wants_picture(&handler)) {
+				if (!flac_scan_picture(reader, length,
+						       handler, handler_ctx))
+					return false;
+				break;
+			}
+
+			if (!reader.Skip(length))
+				return false;
+			break;
+
+		default:
+			/* skip all other blocks */
+			if (!reader.Skip(length))
+				return false;
+			break;
+		}
+
+		if (last)
+			return found_streaminfo;
+	}
+}
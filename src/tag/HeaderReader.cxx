@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h" /* must be first for large file support */
+#include "HeaderReader.hxx"
+#include "TagScanFile.hxx"
+#include "system/ByteOrder.hxx"
+
+#include <algorithm>
+
+bool
+HeaderSource::ReadLE32(uint32_t &value_r)
+{
+	uint32_t value;
+	if (!Read(&value, sizeof(value)))
+		return false;
+
+	value_r = FromLE32(value);
+	return true;
+}
+
+bool
+HeaderSource::ReadBE32(uint32_t &value_r)
+{
+	uint32_t value;
+	if (!Read(&value, sizeof(value)))
+		return false;
+
+	value_r = FromBE32(value);
+	return true;
+}
+
+bool
+HeaderSource::ReadBE64(uint64_t &value_r)
+{
+	uint64_t value;
+	if (!Read(&value, sizeof(value)))
+		return false;
+
+	value_r = FromBE64(value);
+	return true;
+}
+
+uint64_t
+HeaderReader::GetSize() const
+{
+	return file.GetSize();
+}
+
+bool
+HeaderReader::Seek(uint64_t offset)
+{
+	if (offset > file.GetSize())
+		return false;
+
+	position = offset;
+	return true;
+}
+
+size_t
+HeaderReader::ReadSome(void *dest, size_t length)
+{
+	const uint64_t size = file.GetSize();
+	if (position >= size)
+		return 0;
+
+	length = std::min(uint64_t(length), size - position);
+	if (!file.ReadAt(position, dest, length))
+		return 0;
+
+	position += length;
+	return length;
+}
+
+bool
+HeaderReader::Read(void *dest, size_t length)
+{
+	if (!file.ReadAt(position, dest, length))
+		return false;
+
+	position += length;
+	return true;
+}
+
+bool
+HeaderReader::Skip(uint64_t length)
+{
+	const uint64_t size = file.GetSize();
+	return position <= size && length <= size - position &&
+		Seek(position + length);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/** \file
+ *
+ * Bounded readers for the header-only tag scanners (see
+ * HeaderScan.hxx).
+ */
+
+#ifndef MPD_TAG_HEADER_READER_HXX
+#define MPD_TAG_HEADER_READER_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+class TagScanFile;
+
+/**
+ * A sequential source of bytes, e.g. a file or an Ogg packet.
+ */
+class HeaderSource {
+public:
+	/**
+	 * Read exactly the specified number of bytes.
+	 *
+	 * @return false on I/O error or if the source ends too early
+	 */
+	virtual bool Read(void *dest, size_t length) = 0;
+
+	/**
+	 * Skip the specified number of bytes without reading them
+	 * (if possible).
+	 */
+	virtual bool Skip(uint64_t length) = 0;
+
+	bool ReadLE32(uint32_t &value_r);
+	bool ReadBE32(uint32_t &value_r);
+	bool ReadBE64(uint64_t &value_r);
+};
+
+/**
+ * A #HeaderSource reading sequentially from a #TagScanFile.  Skipped
+ * ranges are not read at all.
+ */
+class HeaderReader final : public HeaderSource {
+	TagScanFile &file;
+
+	uint64_t position;
+
+public:
+	/**
+	 * @param _file the file; reading starts at the beginning
+	 */
+	explicit HeaderReader(TagScanFile &_file)
+		:file(_file), position(0) {}
+
+	gcc_pure
+	uint64_t GetSize() const;
+
+	uint64_t Tell() const {
+		return position;
+	}
+
+	bool Seek(uint64_t offset);
+
+	/**
+	 * Read up to the specified number of bytes; unlike Read(),
+	 * this stops at the end of the file.
+	 *
+	 * @return the number of bytes which were read
+	 */
+	size_t ReadSome(void *dest, size_t length);
+
+	/* virtual methods from class HeaderSource */
+	bool Read(void *dest, size_t length) override;
+	bool Skip(uint64_t length) override;
+};
+
+#endif
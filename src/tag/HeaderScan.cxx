@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h" /* must be first for large file support */
+#include "HeaderScan.hxx"
+#include "HeaderReader.hxx"
+#include "TagScanFile.hxx"
+#include "FlacHeader.hxx"
+#include "OggHeader.hxx"
+#include "Mp4Header.hxx"
+#include "MpegHeader.hxx"
+#include "TagId3.hxx"
+#include "ApeTag.hxx"
+#include "fs/Path.hxx"
+#include "util/ASCII.hxx"
+
+#include <assert.h>
+
+enum class HeaderFormat {
+	UNKNOWN,
+	FLAC,
+	OGG,
+	MP4,
+	MPEG,
+};
+
+gcc_pure
+static HeaderFormat
+header_format_from_suffix(const char *suffix)
+{
+	if (StringEqualsCaseASCII(suffix, "flac"))
+		return HeaderFormat::FLAC;
+
+	if (StringEqualsCaseASCII(suffix, "ogg") ||
+	    StringEqualsCaseASCII(suffix, "oga") ||
+	    StringEqualsCaseASCII(suffix, "opus"))
+		return HeaderFormat::OGG;
+
+	if (StringEqualsCaseASCII(suffix, "m4a") ||
+	    StringEqualsCaseASCII(suffix, "m4b") ||
+	    StringEqualsCaseASCII(suffix, "mp4"))
+		return HeaderFormat::MP4;
+
+	if (StringEqualsCaseASCII(suffix, "mp3"))
+		return HeaderFormat::MPEG;
+
+	return HeaderFormat::UNKNOWN;
+}
+
+static bool
+tag_header_scan(TagScanFile &file, HeaderFormat format,
+		const tag_handler &handler, void *handler_ctx)
+{
+	HeaderReader reader(file);
+
+	switch (format) {
+	case HeaderFormat::UNKNOWN:
+		break;
+
+	case HeaderFormat::FLAC:
+		return flac_header_scan(reader, handler, handler_ctx);
+
+	case HeaderFormat::OGG:
+		return ogg_header_scan(reader, handler, handler_ctx);
+
+	case HeaderFormat::MP4:
+		return mp4_header_scan(reader, handler, handler_ctx);
+
+	case HeaderFormat::MPEG: {
+		size_t id3_size;
+		if (!mpeg_header_scan(reader, handler, handler_ctx, id3_size))
+			return false;
+
+		/* the ID3 tag at the beginning has already been
+		   cached by the #TagScanFile */
+		if (!tag_id3_scan(file, &handler, handler_ctx))
+			tag_ape_scan2(file, &handler, handler_ctx);
+		return true;
+	}
+	}
+
+	return false;
+}
+
+bool
+tag_header_scan(TagScanFile &file, Path path_fs,
+		const tag_handler &handler, void *handler_ctx)
+{
+	assert(!path_fs.IsNull());
+
+	const auto *suffix = path_fs.GetSuffix();
+	if (suffix == nullptr)
+		return false;
+
+	const auto suffix_utf8 = Path::FromFS(suffix).ToUTF8();
+	const HeaderFormat format =
+		header_format_from_suffix(suffix_utf8.c_str());
+	if (format == HeaderFormat::UNKNOWN)
+		return false;
+
+	return tag_header_scan(file, format, handler, handler_ctx);
+}
+
+bool
+tag_ape_id3_scan(TagScanFile &file,
+		 const tag_handler *handler, void *handler_ctx)
+{
+	return tag_ape_scan2(file, handler, handler_ctx) ||
+		tag_id3_scan(file, handler, handler_ctx);
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/** \file
+ *
+ * Reads tags and the duration from the headers of common container
+ * formats (FLAC, Ogg Vorbis/Opus, MP4 and MP3 with a Xing/Info
+ * header) with a small bounded buffer, without going through a
+ * decoder plugin and its #InputStream.  Only the necessary byte
+ * ranges are read; large metadata (e.g. embedded pictures and the
+ * media data) is skipped with a seek.
+ */
+
+#ifndef MPD_TAG_HEADER_SCAN_HXX
+#define MPD_TAG_HEADER_SCAN_HXX
+
+#include "check.h"
+
+class Path;
+class TagScanFile;
+struct tag_handler;
+
+/**
+ * Scan the tags of a local file from its container headers.
+ *
+ * On failure, the caller shall discard all values which were passed
+ * to the handler, and fall back to tag_file_scan().
+ *
+ * @param file the file, opened by the caller; it may be used for
+ * tag_ape_id3_scan() afterwards without reading the same parts again
+ * @param path_fs the path of the file; only its suffix is used
+ * @return false if the file format is not supported or if the file
+ * could not be parsed completely
+ */
+bool
+tag_header_scan(TagScanFile &file, Path path_fs,
+		const tag_handler &handler, void *handler_ctx);
+
+/**
+ * Attempts to load APE or ID3 tags from the specified file.  This
+ * is the fallback for files whose decoder plugin did not find any
+ * tags.
+ */
+bool
+tag_ape_id3_scan(TagScanFile &file,
+		 const tag_handler *handler, void *handler_ctx);
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_TAG_ID3V2_HEADER_HXX
+#define MPD_TAG_ID3V2_HEADER_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The size of an ID3v2 tag header (and footer).
+ */
+static constexpr size_t ID3V2_HEADER_SIZE = 10;
+
+/**
+ * Parses an ID3v2 tag header.
+ *
+ * @return the total size of the tag including header and footer, or 0
+ * if this is not an ID3v2 tag header
+ */
+gcc_pure
+static inline size_t
+id3v2_tag_size(const uint8_t *header)
+{
+	if (header[0] != 'I' || header[1] != 'D' || header[2] != '3' ||
+	    header[3] == 0xff || header[4] == 0xff ||
+	    ((header[6] | header[7] | header[8] | header[9]) & 0x80) != 0)
+		return 0;
+
+	size_t size = ID3V2_HEADER_SIZE +
+		((size_t(header[6]) << 21) | (size_t(header[7]) << 14) |
+		 (size_t(header[8]) << 7) | size_t(header[9]));
+
+	if (header[5] & 0x10)
+		/* footer present */
+		size += ID3V2_HEADER_SIZE;
+
+	return size;
+}
+
+#endif
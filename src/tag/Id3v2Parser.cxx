@@ -0,0 +1,648 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Id3v2Parser.hxx"
+#include "Id3v2Header.hxx"
+#include "TagHandler.hxx"
+#include "TagTable.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/StringUtil.hxx"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <string.h>
+
+/**
+ * The text encodings (ID3v2.4.0 structure section 4).
+ */
+enum {
+	ID3V2_ENCODING_LATIN1 = 0,
+	ID3V2_ENCODING_UTF16 = 1,
+	ID3V2_ENCODING_UTF16BE = 2,
+	ID3V2_ENCODING_UTF8 = 3,
+};
+
+/**
+ * The frames which are mapped to a #TagType, in the order in which
+ * scan_id3_tag() imports them.
+ */
+static constexpr struct {
+	char id[5];
+	TagType type;
+} id3v2_text_frames[] = {
+	{ "TPE1", TAG_ARTIST },
+	{ "TPE2", TAG_ALBUM_ARTIST },
+	{ "TSOP", TAG_ARTIST_SORT },
+	{ "TSOA", TAG_ALBUM_SORT },
+	{ "TSO2", TAG_ALBUM_ARTIST_SORT },
+	{ "TIT2", TAG_TITLE },
+	{ "TALB", TAG_ALBUM },
+	{ "TRCK", TAG_TRACK },
+	{ "TDRC", TAG_DATE },
+	{ "TCON", TAG_GENRE },
+	{ "TCOM", TAG_COMPOSER },
+	{ "TPE3", TAG_PERFORMER },
+	{ "TPE4", TAG_PERFORMER },
+	{ "COMM", TAG_COMMENT },
+	{ "TPOS", TAG_DISC },
+};
+
+TagType
+tag_id3_parse_txxx_name(const char *name)
+{
+	static constexpr struct tag_table txxx_tags[] = {
+		{ "ALBUMARTISTSORT", TAG_ALBUM_ARTIST_SORT },
+		{ "MusicBrainz Artist Id", TAG_MUSICBRAINZ_ARTISTID },
+		{ "MusicBrainz Album Id", TAG_MUSICBRAINZ_ALBUMID },
+		{ "MusicBrainz Album Artist Id",
+		  TAG_MUSICBRAINZ_ALBUMARTISTID },
+		{ "MusicBrainz Track Id", TAG_MUSICBRAINZ_TRACKID },
+		{ "MusicBrainz Release Track Id",
+		  TAG_MUSICBRAINZ_RELEASETRACKID },
+		{ nullptr, TAG_NUM_OF_ITEM_TYPES }
+	};
+
+	return tag_table_lookup(txxx_tags, name);
+}
+
+size_t
+id3v2_resync(uint8_t *data, size_t length)
+{
+	uint8_t *const end = data + length;
+	uint8_t *dest = data;
+
+	/* memchr() is vectorized by the C library; the bytes
+	   between two 0xff bytes are moved as one block, and
+	   nothing is moved before the first stuffed null byte */
+	for (uint8_t *p = data; p < end;) {
+		uint8_t *ff = (uint8_t *)memchr(p, 0xff, end - p);
+		uint8_t *run_end = ff != nullptr ? ff + 1 : end;
+
+		if (dest != p)
+			memmove(dest, p, run_end - p);
+		dest += run_end - p;
+		p = run_end;
+
+		if (ff != nullptr && p < end && *p == 0)
+			++p;
+	}
+
+	return dest - data;
+}
+
+static constexpr size_t
+Id3v2SyncSafe(const uint8_t *p)
+{
+	return ((size_t(p[0]) & 0x7f) << 21) | ((size_t(p[1]) & 0x7f) << 14) |
+		((size_t(p[2]) & 0x7f) << 7) | (size_t(p[3]) & 0x7f);
+}
+
+static constexpr size_t
+Id3v2BigEndian32(const uint8_t *p)
+{
+	return (size_t(p[0]) << 24) | (size_t(p[1]) << 16) |
+		(size_t(p[2]) << 8) | size_t(p[3]);
+}
+
+gcc_pure
+static bool
+IsValidFrameId(const uint8_t *p)
+{
+	for (unsigned i = 0; i < 4; ++i)
+		if (!((p[i] >= 'A' && p[i] <= 'Z') ||
+		      (p[i] >= '0' && p[i] <= '9')))
+			return false;
+
+	return true;
+}
+
+gcc_pure
+static bool
+IsWantedFrame(const char *id)
+{
+	for (const auto &i : id3v2_text_frames)
+		if (memcmp(id, i.id, 4) == 0)
+			return true;
+
+	return memcmp(id, "TXXX", 4) == 0 || memcmp(id, "UFID", 4) == 0;
+}
+
+static constexpr size_t
+TerminatorSize(unsigned encoding)
+{
+	return encoding == ID3V2_ENCODING_UTF16 ||
+		encoding == ID3V2_ENCODING_UTF16BE
+		? 2 : 1;
+}
+
+/**
+ * Returns the length of the first string in the buffer, i.e. the
+ * position of its null terminator, or the buffer size if it is not
+ * terminated.
+ */
+gcc_pure
+static size_t
+FindTerminator(unsigned encoding, ConstBuffer<uint8_t> src)
+{
+	if (TerminatorSize(encoding) == 1) {
+		const void *z = memchr(src.data, 0, src.size);
+		return z != nullptr
+			? (const uint8_t *)z - src.data
+			: src.size;
+	}
+
+	for (size_t i = 0; i + 1 < src.size; i += 2)
+		if (src.data[i] == 0 && src.data[i + 1] == 0)
+			return i;
+
+	return src.size;
+}
+
+static void
+AppendUtf8(std::string &dest, unsigned ch)
+{
+	if (ch < 0x80) {
+		dest.push_back(char(ch));
+	} else if (ch < 0x800) {
+		dest.push_back(char(0xc0 | (ch >> 6)));
+		dest.push_back(char(0x80 | (ch & 0x3f)));
+	} else if (ch < 0x10000) {
+		dest.push_back(char(0xe0 | (ch >> 12)));
+		dest.push_back(char(0x80 | ((ch >> 6) & 0x3f)));
+		dest.push_back(char(0x80 | (ch & 0x3f)));
+	} else {
+		dest.push_back(char(0xf0 | (ch >> 18)));
+		dest.push_back(char(0x80 | ((ch >> 12) & 0x3f)));
+		dest.push_back(char(0x80 | ((ch >> 6) & 0x3f)));
+		dest.push_back(char(0x80 | (ch & 0x3f)));
+	}
+}
+
+static void
+AppendLatin1(std::string &dest, const uint8_t *p, const uint8_t *end)
+{
+	while (p < end) {
+		/* copy runs of ASCII characters as one block, checking
+		   eight bytes at a time */
+		const uint8_t *run = p;
+		while (end - p >= 8) {
+			uint64_t word;
+			memcpy(&word, p, sizeof(word));
+			if (word & 0x8080808080808080ULL)
+				break;
+			p += 8;
+		}
+
+		while (p < end && *p < 0x80)
+			++p;
+
+		dest.append((const char *)run, p - run);
+
+		if (p < end)
+			AppendUtf8(dest, *p++);
+	}
+}
+
+static void
+AppendUtf16(std::string &dest, const uint8_t *p, size_t size,
+	    bool big_endian)
+{
+	const unsigned hi = big_endian ? 0 : 1, lo = 1 - hi;
+
+	for (size_t i = 0; i + 1 < size; i += 2) {
+		unsigned ch = (unsigned(p[i + hi]) << 8) | p[i + lo];
+
+		if (ch >= 0xd800 && ch < 0xdc00 && i + 3 < size) {
+			const unsigned ch2 =
+				(unsigned(p[i + 2 + hi]) << 8) | p[i + 2 + lo];
+			if (ch2 >= 0xdc00 && ch2 < 0xe000) {
+				ch = 0x10000 + ((ch - 0xd800) << 10) +
+					(ch2 - 0xdc00);
+				i += 2;
+			}
+		}
+
+		if (ch >= 0xd800 && ch < 0xe000)
+			/* unpaired surrogate */
+			continue;
+
+		AppendUtf8(dest, ch);
+	}
+}
+
+/**
+ * Decode one string (without its terminator) to UTF-8.
+ */
+static void
+DecodeString(unsigned encoding, ConstBuffer<uint8_t> src, std::string &dest)
+{
+	dest.clear();
+
+	switch (encoding) {
+	case ID3V2_ENCODING_LATIN1:
+		AppendLatin1(dest, src.begin(), src.end());
+		break;
+
+	case ID3V2_ENCODING_UTF16:
+		if (src.size >= 2 && src.data[0] == 0xff &&
+		    src.data[1] == 0xfe) {
+			AppendUtf16(dest, src.data + 2, src.size - 2, false);
+			break;
+		}
+
+		if (src.size >= 2 && src.data[0] == 0xfe &&
+		    src.data[1] == 0xff)
+			src.skip_front(2);
+
+		AppendUtf16(dest, src.data, src.size, true);
+		break;
+
+	case ID3V2_ENCODING_UTF16BE:
+		AppendUtf16(dest, src.data, src.size, true);
+		break;
+
+	case ID3V2_ENCODING_UTF8:
+		dest.append((const char *)src.data, src.size);
+		break;
+	}
+}
+
+/**
+ * Decode the first string of the buffer and remove it (including the
+ * terminator) from the buffer.
+ *
+ * @return false if the buffer does not contain a terminated string
+ * and #require_terminator is set
+ */
+static bool
+ShiftString(unsigned encoding, ConstBuffer<uint8_t> &src, std::string &dest,
+	    bool require_terminator=false)
+{
+	const size_t length = FindTerminator(encoding, src);
+	if (length == src.size && require_terminator)
+		return false;
+
+	DecodeString(encoding, {src.data, length}, dest);
+
+	src.skip_front(std::min(length + TerminatorSize(encoding),
+				src.size));
+	return true;
+}
+
+/**
+ * Invoke the function for each string of a "Text information frame"
+ * (ID3v2.4.0 section 4.2) with a writable pointer to the UTF-8
+ * string.
+ */
+template<typename F>
+static void
+ForEachString(ConstBuffer<uint8_t> frame, std::string &buffer, F &&f)
+{
+	if (frame.IsEmpty())
+		return;
+
+	const unsigned encoding = frame.shift();
+	if (encoding > ID3V2_ENCODING_UTF8)
+		return;
+
+	while (!frame.IsEmpty()) {
+		ShiftString(encoding, frame, buffer);
+		f(&buffer[0]);
+	}
+}
+
+/**
+ * Does this "TCON" frame refer to an ID3v1 genre number?  Resolving
+ * those is left to libid3tag.
+ */
+static bool
+IsGenreReference(ConstBuffer<uint8_t> frame, unsigned version)
+{
+	std::string buffer;
+	bool result = false;
+	ForEachString(frame, buffer, [&result, version](const char *s){
+			if (strcmp(s, "RX") == 0 || strcmp(s, "CR") == 0 ||
+			    (version == 3 && *s == '('))
+				result = true;
+
+			if (*s == 0)
+				return;
+
+			while (*s >= '0' && *s <= '9')
+				++s;
+
+			if (*s == 0)
+				result = true;
+		});
+
+	return result;
+}
+
+struct Id3v2Frame {
+	char id[4];
+	ConstBuffer<uint8_t> data;
+};
+
+/**
+ * Collect the frames which are interesting for us.
+ *
+ * @param pictures collect "APIC" frames, too?
+ * @return false if the tag uses a feature which is not implemented
+ */
+static bool
+CollectFrames(uint8_t *data, std::vector<Id3v2Frame> &frames, bool pictures)
+{
+	const unsigned version = data[3];
+	if (version != 3 && version != 4)
+		return false;
+
+	const uint8_t flags = data[5];
+	const bool unsync = (flags & 0x80) != 0;
+
+	uint8_t *p = data + ID3V2_HEADER_SIZE;
+	uint8_t *end = p + Id3v2SyncSafe(data + 6);
+
+	if (version == 3 && unsync)
+		/* in ID3v2.3, the whole tag is unsynchronised, and
+		   the frame sizes refer to the decoded data */
+		end = p + id3v2_resync(p, end - p);
+
+	if (flags & 0x40) {
+		/* skip the extended header */
+		if (end - p < 4)
+			return false;
+
+		const size_t size = version == 4
+			? Id3v2SyncSafe(p)
+			: 4 + Id3v2BigEndian32(p);
+		if (size > size_t(end - p))
+			return false;
+
+		p += size;
+	}
+
+	while (end - p >= 10 && IsValidFrameId(p)) {
+		const size_t size = version == 4
+			? Id3v2SyncSafe(p + 4)
+			: Id3v2BigEndian32(p + 4);
+		const uint8_t format_flags = p[9];
+
+		uint8_t *frame_data = p + 10;
+		if (size > size_t(end - frame_data))
+			break;
+
+		p = frame_data + size;
+
+		Id3v2Frame frame;
+		memcpy(frame.id, frame_data - 10, sizeof(frame.id));
+
+		if (memcmp(frame.id, "SEEK", 4) == 0)
+			return false;
+
+		if (version == 3 && memcmp(frame.id, "TYER", 4) == 0)
+			/* libid3tag translates this obsolete
+			   ID3v2.3 frame */
+			memcpy(frame.id, "TDRC", 4);
+
+		if (!IsWantedFrame(frame.id) &&
+		    !(pictures && memcmp(frame.id, "APIC", 4) == 0))
+			continue;
+
+		uint8_t *frame_end = p;
+
+		if (version == 3) {
+			if (format_flags & 0xc0)
+				/* compressed or encrypted */
+				return false;
+
+			if (format_flags & 0x20)
+				/* grouping identity */
+				++frame_data;
+		} else {
+			if (format_flags & 0x0c)
+				/* compressed or encrypted */
+				return false;
+
+			if (format_flags & 0x40)
+				/* grouping identity */
+				++frame_data;
+
+			if (format_flags & 0x01)
+				/* data length indicator */
+				frame_data += 4;
+
+			if (frame_data > frame_end)
+				continue;
+
+			if (unsync || (format_flags & 0x02))
+				frame_end = frame_data +
+					id3v2_resync(frame_data,
+						     frame_end - frame_data);
+		}
+
+		if (frame_data > frame_end)
+			continue;
+
+		frame.data = {frame_data, size_t(frame_end - frame_data)};
+
+		if (memcmp(frame.id, "TCON", 4) == 0 &&
+		    IsGenreReference(frame.data, version))
+			return false;
+
+		frames.push_back(frame);
+	}
+
+	return true;
+}
+
+/**
+ * Import a "Text information frame" (ID3v2.4.0 section 4.2).
+ */
+static void
+ImportText(ConstBuffer<uint8_t> frame, TagType type, std::string &buffer,
+	   const struct tag_handler *handler, void *handler_ctx)
+{
+	ForEachString(frame, buffer, [=](char *s){
+			tag_handler_invoke_tag(handler, handler_ctx,
+					       type, Strip(s));
+		});
+}
+
+/**
+ * Import a "Comment frame" (ID3v2.4.0 section 4.10): encoding,
+ * language, short description and the actual text.
+ */
+static void
+ImportComment(ConstBuffer<uint8_t> frame, TagType type, std::string &buffer,
+	      const struct tag_handler *handler, void *handler_ctx)
+{
+	if (frame.size < 4)
+		return;
+
+	const unsigned encoding = frame.shift();
+	if (encoding > ID3V2_ENCODING_UTF8)
+		return;
+
+	frame.skip_front(3);
+
+	if (!ShiftString(encoding, frame, buffer, true))
+		return;
+
+	ShiftString(encoding, frame, buffer);
+	tag_handler_invoke_tag(handler, handler_ctx, type, Strip(&buffer[0]));
+}
+
+/**
+ * Import a "User defined text information frame" (ID3v2.4.0
+ * section 4.2.6) as a name/value pair, and as a tag if the name is
+ * a known MusicBrainz or sort tag.
+ */
+static void
+ImportTxxx(ConstBuffer<uint8_t> frame, std::string &name, std::string &value,
+	   const struct tag_handler *handler, void *handler_ctx)
+{
+	if (frame.IsEmpty())
+		return;
+
+	const unsigned encoding = frame.shift();
+	if (encoding > ID3V2_ENCODING_UTF8 ||
+	    !ShiftString(encoding, frame, name, true))
+		return;
+
+	ShiftString(encoding, frame, value);
+
+	tag_handler_invoke_pair(handler, handler_ctx,
+				name.c_str(), value.c_str());
+
+	TagType type = tag_id3_parse_txxx_name(name.c_str());
+	if (type != TAG_NUM_OF_ITEM_TYPES)
+		tag_handler_invoke_tag(handler, handler_ctx,
+				       type, value.c_str());
+}
+
+/**
+ * Import the MusicBrainz TrackId from a "Unique file identifier"
+ * frame (ID3v2.4.0 section 4.1).
+ */
+static void
+ImportUfid(ConstBuffer<uint8_t> frame,
+	   const struct tag_handler *handler, void *handler_ctx)
+{
+	static constexpr char owner[] = "http://musicbrainz.org";
+
+	if (frame.size <= sizeof(owner) ||
+	    memcmp(frame.data, owner, sizeof(owner)) != 0)
+		return;
+
+	frame.skip_front(sizeof(owner));
+
+	std::string p((const char *)frame.data, frame.size);
+	tag_handler_invoke_tag(handler, handler_ctx,
+			       TAG_MUSICBRAINZ_TRACKID, p.c_str());
+}
+
+/**
+ * Import an "Attached picture" frame (ID3v2.4.0 section 4.14):
+ * encoding, MIME type, picture type, description and the image.
+ */
+static void
+ImportPicture(ConstBuffer<uint8_t> frame, std::string &buffer,
+	      const struct tag_handler *handler, void *handler_ctx)
+{
+	if (frame.size < 2)
+		return;
+
+	const unsigned encoding = frame.shift();
+	if (encoding > ID3V2_ENCODING_UTF8 ||
+	    !ShiftString(ID3V2_ENCODING_LATIN1, frame, buffer, true) ||
+	    frame.IsEmpty())
+		return;
+
+	const unsigned type = frame.shift();
+
+	/* skip the description */
+	const size_t length = FindTerminator(encoding, frame);
+	if (length == frame.size)
+		return;
+
+	frame.skip_front(length + TerminatorSize(encoding));
+
+	if (frame.IsEmpty())
+		return;
+
+	/* some taggers write ID3v2.2 image formats instead of a
+	   MIME type */
+	if (buffer == "JPG")
+		buffer = "image/jpeg";
+	else if (buffer == "PNG")
+		buffer = "image/png";
+
+	tag_handler_invoke_picture(handler, handler_ctx, buffer.c_str(),
+				   type, frame.ToVoid());
+}
+
+bool
+id3v2_parse(uint8_t *data, size_t size,
+	    const struct tag_handler *handler, void *handler_ctx)
+{
+	if (size < ID3V2_HEADER_SIZE)
+		return false;
+
+	const size_t tag_size = id3v2_tag_size(data);
+	if (tag_size == 0 || tag_size > size)
+		return false;
+
+	std::vector<Id3v2Frame> frames;
+	if (!CollectFrames(data, frames, tag_handler_wants_picture(handler)))
+		return false;
+
+	std::string buffer, buffer2;
+
+	for (const auto &i : id3v2_text_frames) {
+		for (const auto &frame : frames) {
+			if (memcmp(frame.id, i.id, 4) != 0)
+				continue;
+
+			if (i.type == TAG_COMMENT)
+				ImportComment(frame.data, i.type, buffer,
+					      handler, handler_ctx);
+			else
+				ImportText(frame.data, i.type, buffer,
+					   handler, handler_ctx);
+		}
+	}
+
+	for (const auto &frame : frames)
+		if (memcmp(frame.id, "TXXX", 4) == 0)
+			ImportTxxx(frame.data, buffer, buffer2,
+				   handler, handler_ctx);
+
+	for (const auto &frame : frames)
+		if (memcmp(frame.id, "UFID", 4) == 0)
+			ImportUfid(frame.data, handler, handler_ctx);
+
+	for (const auto &frame : frames)
+		if (memcmp(frame.id, "APIC", 4) == 0)
+			ImportPicture(frame.data, buffer, handler, handler_ctx);
+
+	return true;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TAG_ID3V2_PARSER_HXX
+#define MPD_TAG_ID3V2_PARSER_HXX
+
+#include "check.h"
+#include "TagType.h"
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct tag_handler;
+
+/**
+ * Parse a TXXX name, and convert it to a TagType enum value.
+ * Returns TAG_NUM_OF_ITEM_TYPES if the TXXX name is not understood.
+ */
+gcc_pure
+TagType
+tag_id3_parse_txxx_name(const char *name);
+
+/**
+ * Undo ID3v2 unsynchronisation (ID3v2.4.0 structure section 6.1):
+ * remove each null byte which follows a 0xff byte.  The buffer is
+ * modified in place.
+ *
+ * @return the new length
+ */
+size_t
+id3v2_resync(uint8_t *data, size_t length);
+
+/**
+ * Parse an ID3v2.3 or ID3v2.4 tag without libid3tag, decoding the
+ * common text frames, comments, TXXX and UFID directly from the
+ * raw tag into UTF-8 and passing them to the handler in the same
+ * order as scan_id3_tag() does.  If the handler wants pictures,
+ * "APIC" frames are passed to it last.
+ *
+ * Features which are rare in the wild (ID3v2.2, compressed or
+ * encrypted frames, SEEK frames, numeric genre references) are not
+ * implemented; in that case, this function returns false before the
+ * handler has been invoked, and the caller should fall back to
+ * libid3tag.
+ *
+ * @param data the complete tag, beginning with the header; the
+ * buffer is modified while undoing unsynchronisation
+ * @param size the size of the buffer
+ * @return true if the tag has been parsed
+ */
+bool
+id3v2_parse(uint8_t *data, size_t size,
+	    const tag_handler *handler, void *handler_ctx);
+
+#endif
@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Mp4Header.hxx"
+#include "HeaderReader.hxx"
+#include "TagHandler.hxx"
+#include "Chrono.hxx"
+
+#include <memory>
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Values of "ilst" items which are larger than this are skipped
+ * (e.g. "covr").
+ */
+static constexpr uint32_t MP4_MAX_VALUE_LENGTH = 64 * 1024;
+
+/**
+ * The "data" atom type indicators for UTF-8 text and images.
+ */
+static constexpr uint32_t MP4_DATA_UTF8 = 1;
+static constexpr uint32_t MP4_DATA_JPEG = 13;
+static constexpr uint32_t MP4_DATA_PNG = 14;
+static constexpr uint32_t MP4_DATA_BMP = 27;
+
+struct Mp4Atom {
+	char type[4];
+
+	/**
+	 * The offset of the first byte after this atom.
+	 */
+	uint64_t end;
+
+	bool Is(const char *_type) const {
+		return memcmp(type, _type, sizeof(type)) == 0;
+	}
+};
+
+static constexpr struct {
+	char type[5];
+	TagType tag;
+} mp4_tags[] = {
+	{ "\251nam", TAG_TITLE },
+	{ "\251ART", TAG_ARTIST },
+	{ "aART", TAG_ALBUM_ARTIST },
+	{ "\251alb", TAG_ALBUM },
+	{ "\251day", TAG_DATE },
+	{ "\251gen", TAG_GENRE },
+	{ "\251wrt", TAG_COMPOSER },
+	{ "\251cmt", TAG_COMMENT },
+	{ "soar", TAG_ARTIST_SORT },
+	{ "soaa", TAG_ALBUM_ARTIST_SORT },
+	{ "soal", TAG_ALBUM_SORT },
+};
+
+/**
+ * Read the header of the next atom which ends before #parent_end.
+ */
+static bool
+mp4_read_atom(HeaderReader &reader, uint64_t parent_end, Mp4Atom &atom)
+{
+	const uint64_t start = reader.Tell();
+
+	uint32_t size32;
+	if (start > parent_end || parent_end - start < 8 ||
+	    !reader.ReadBE32(size32) ||
+	    !reader.Read(atom.type, sizeof(atom.type)))
+		return false;
+
+	uint64_t size = size32;
+	if (size == 1) {
+		/* 64 bit size */
+		if (!reader.ReadBE64(size) || size < 16)
+			return false;
+	} else if (size == 0)
+		/* extends to the end of the parent */
+		size = parent_end - start;
+	else if (size < 8)
+		return false;
+
+	if (size > parent_end - start)
+		return false;
+
+	atom.end = start + size;
+	return true;
+}
+
+/**
+ * Find the child atom with the given type.
+ */
+static bool
+mp4_find_atom(HeaderReader &reader, uint64_t parent_end,
+	      const char *type, Mp4Atom &atom)
+{
+	while (mp4_read_atom(reader, parent_end, atom)) {
+		if (atom.Is(type))
+			return true;
+
+		if (!reader.Seek(atom.end))
+			return false;
+	}
+
+	return false;
+}
+
+static bool
+mp4_scan_mvhd(HeaderReader &reader,
+	      const tag_handler &handler, void *handler_ctx)
+{
+	uint8_t version[4];
+	if (!reader.Read(version, sizeof(version)))
+		return false;
+
+	uint32_t timescale;
+	uint64_t duration;
+	if (version[0] == 1) {
+		if (!reader.Skip(16) || !reader.ReadBE32(timescale) ||
+		    !reader.ReadBE64(duration))
+			return false;
+	} else {
+		uint32_t duration32;
+		if (!reader.Skip(8) || !reader.ReadBE32(timescale) ||
+		    !reader.ReadBE32(duration32))
+			return false;
+		duration = duration32;
+	}
+
+	if (timescale > 0)
+		tag_handler_invoke_duration(&handler, handler_ctx,
+					    SongTime::FromScale<uint64_t>(duration,
+									  timescale));
+
+	return true;
+}
+
+/**
+ * Read the value of an "ilst" item from its "data" atom.
+ *
+ * @return the length of the value, or -1 if there is no "data" atom
+ * or it is too large
+ */
+static long
+mp4_read_data(HeaderReader &reader, const Mp4Atom &item,
+	      uint32_t &data_type, char *buffer)
+{
+	Mp4Atom data;
+	if (!mp4_find_atom(reader, item.end, "data", data))
+		return -1;
+
+	uint32_t locale;
+	if (!reader.ReadBE32(data_type) || !reader.ReadBE32(locale))
+		return -1;
+
+	data_type &= 0xffffff;
+
+	const uint64_t length = data.end - reader.Tell();
+	if (length > MP4_MAX_VALUE_LENGTH ||
+	    !reader.Read(buffer, length))
+		return -1;
+
+	buffer[length] = 0;
+	return long(length);
+}
+
+/**
+ * Parse the binary "trkn" and "disk" values.
+ */
+static bool
+mp4_scan_number(const char *buffer, long length, TagType type,
+		const tag_handler &handler, void *handler_ctx)
+{
+	if (length < 6)
+		return false;
+
+	const uint8_t *p = (const uint8_t *)buffer;
+	const unsigned number = (p[2] << 8) | p[3];
+	const unsigned total = (p[4] << 8) | p[5];
+
+	char value[32];
+	if (total > 0)
+		snprintf(value, sizeof(value), "%u/%u", number, total);
+	else
+		snprintf(value, sizeof(value), "%u", number);
+
+	tag_handler_invoke_tag(&handler, handler_ctx, type, value);
+	return true;
+}
+
+/**
+ * Pass the image of a "covr" item to the handler.
+ */
+static bool
+mp4_scan_cover(HeaderReader &reader, const Mp4Atom &item,
+	       const tag_handler &handler, void *handler_ctx)
+{
+	Mp4Atom data;
+	if (!mp4_find_atom(reader, item.end, "data", data))
+		return true;
+
+	uint32_t data_type, locale;
+	if (!reader.ReadBE32(data_type) || !reader.ReadBE32(locale))
+		return false;
+
+	const char *mime_type;
+	switch (data_type & 0xffffff) {
+	case MP4_DATA_JPEG:
+		mime_type = "image/jpeg";
+		break;
+
+	case MP4_DATA_PNG:
+		mime_type = "image/png";
+		break;
+
+	case MP4_DATA_BMP:
+		mime_type = "image/bmp";
+		break;
+
+	default:
+		mime_type = "";
+		break;
+	}
+
+	const uint64_t length = data.end - reader.Tell();
+	if (length == 0 || length > TAG_MAX_PICTURE_SIZE)
+		return true;
+
+	std::unique_ptr<uint8_t[]> buffer(new uint8_t[length]);
+	if (!reader.Read(buffer.get(), length))
+		return false;
+
+	tag_handler_invoke_picture(&handler, handler_ctx, mime_type,
+				   TAG_PICTURE_FRONT_COVER,
+				   {buffer.get(), size_t(length)});
+	return true;
+}
+
+static bool
+mp4_scan_ilst(HeaderReader &reader, uint64_t end,
+	      const tag_handler &handler, void *handler_ctx)
+{
+	std::unique_ptr<char[]> buffer(new char[MP4_MAX_VALUE_LENGTH + 1]);
+
+	Mp4Atom item;
+	while (mp4_read_atom(reader, end, item)) {
+		if (item.Is("gnre"))
+			/* a numeric ID3v1 genre which we cannot
+			   translate; let the decoder plugin handle this
+			   file */
+			return false;
+
+		TagType type = TAG_NUM_OF_ITEM_TYPES;
+		for (const auto &i : mp4_tags)
+			if (item.Is(i.type))
+				type = i.tag;
+
+		if (item.Is("covr") && tag_handler_wants_picture(&handler) &&
+		    !mp4_scan_cover(reader, item, handler, handler_ctx))
+			return false;
+
+		const bool number = item.Is("trkn") || item.Is("disk");
+		if (number)
+			type = item.Is("trkn") ? TAG_TRACK : TAG_DISC;
+
+		if (type != TAG_NUM_OF_ITEM_TYPES) {
+			uint32_t data_type;
+			const long length = mp4_read_data(reader, item,
+							  data_type,
+							  buffer.get());
+			if (length < 0)
+				return false;
+
+			if (number)
+				mp4_scan_number(buffer.get(), length, type,
+						handler, handler_ctx);
+			else if (data_type == MP4_DATA_UTF8)
+				tag_handler_invoke_tag(&handler, handler_ctx,
+						       type, buffer.get());
+		}
+
+		if (!reader.Seek(item.end))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Scan the "meta" atom (a "full box" with version and flags) for the
+ * "ilst" atom.
+ */
+static bool
+mp4_scan_meta(HeaderReader &reader, const Mp4Atom &meta,
+	      const tag_handler &handler, void *handler_ctx)
+{
+	Mp4Atom ilst;
+	return reader.Skip(4) &&
+		mp4_find_atom(reader, meta.end, "ilst", ilst) &&
+		mp4_scan_ilst(reader, ilst.end, handler, handler_ctx);
+}
+
+static bool
+mp4_scan_moov(HeaderReader &reader, const Mp4Atom &moov,
+	      const tag_handler &handler, void *handler_ctx)
+{
+	bool found_mvhd = false;
+
+	Mp4Atom atom;
+	while (mp4_read_atom(reader, moov.end, atom)) {
+		if (atom.Is("mvhd")) {
+			if (!mp4_scan_mvhd(reader, handler, handler_ctx))
+				return false;
+
+			found_mvhd = true;
+		} else if (atom.Is("meta")) {
+			if (!mp4_scan_meta(reader, atom,
+					   handler, handler_ctx))
+				return false;
+		} else if (atom.Is("udta")) {
+			Mp4Atom meta;
+			if (mp4_find_atom(reader, atom.end, "meta", meta) &&
+			    !mp4_scan_meta(reader, meta,
+					   handler, handler_ctx))
+				return false;
+		}
+
+		if (!reader.Seek(atom.end))
+			return false;
+	}
+
+	return found_mvhd;
+}
+
+bool
+mp4_header_scan(HeaderReader &reader,
+		const tag_handler &handler, void *handler_ctx)
+{
+	const uint64_t size = reader.GetSize();
+
+	Mp4Atom atom;
+	if (!mp4_read_atom(reader, size, atom) || !atom.Is("ftyp") ||
+	    !reader.Seek(atom.end))
+		return false;
+
+	/* the "moov" atom may be before or after "mdat" */
+	return mp4_find_atom(reader, size, "moov", atom) &&
+		mp4_scan_moov(reader, atom, handler, handler_ctx);
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "MpegHeader.hxx"
+#include "HeaderReader.hxx"
+#include "Id3v2Header.hxx"
+#include "TagHandler.hxx"
+#include "Chrono.hxx"
+
+#include <algorithm>
+
+#include <string.h>
+
+/**
+ * How far to search for the first frame after the ID3v2 tag?
+ */
+static constexpr size_t MPEG_MAX_SYNC_SEARCH = 4096;
+
+/**
+ * The number of bytes needed from the first frame to find the
+ * Xing/Info and the VBRI header.
+ */
+static constexpr size_t MPEG_FIRST_FRAME_SIZE = 64;
+
+static constexpr size_t MPEG_VBRI_OFFSET = 4 + 32;
+
+struct MpegFrameHeader {
+	unsigned sample_rate;
+	unsigned samples_per_frame;
+
+	/**
+	 * The offset of the Xing/Info header within the frame.
+	 */
+	size_t xing_offset;
+
+	/**
+	 * Parse a layer III frame header.
+	 */
+	bool Parse(const uint8_t *p) {
+		if (p[0] != 0xff || (p[1] & 0xe0) != 0xe0)
+			return false;
+
+		const unsigned version = (p[1] >> 3) & 0x3;
+		const unsigned layer = (p[1] >> 1) & 0x3;
+		const unsigned bitrate_index = p[2] >> 4;
+		const unsigned sample_rate_index = (p[2] >> 2) & 0x3;
+		const bool mono = (p[3] >> 6) == 3;
+
+		/* layer III, no "free" or invalid bit rate */
+		if (version == 1 || layer != 1 ||
+		    bitrate_index == 0 || bitrate_index == 15 ||
+		    sample_rate_index == 3)
+			return false;
+
+		static constexpr unsigned rates[] = { 44100, 48000, 32000 };
+		sample_rate = rates[sample_rate_index];
+
+		if (version == 3) {
+			/* MPEG 1 */
+			samples_per_frame = 1152;
+			xing_offset = 4 + (mono ? 17 : 32);
+		} else {
+			/* MPEG 2 (version 2) and MPEG 2.5 (version 0) */
+			sample_rate /= version == 2 ? 2 : 4;
+			samples_per_frame = 576;
+			xing_offset = 4 + (mono ? 9 : 17);
+		}
+
+		return true;
+	}
+};
+
+gcc_pure
+static uint32_t
+LoadBE32(const uint8_t *p)
+{
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+		(uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+/**
+ * @return the number of frames or 0 if no Xing/Info or VBRI header
+ * was found
+ */
+gcc_pure
+static uint32_t
+mpeg_get_frame_count(const uint8_t *frame, const MpegFrameHeader &header)
+{
+	const uint8_t *xing = frame + header.xing_offset;
+	if (memcmp(xing, "Xing", 4) == 0 || memcmp(xing, "Info", 4) == 0) {
+		const uint32_t flags = LoadBE32(xing + 4);
+		return (flags & 0x1) != 0
+			? LoadBE32(xing + 8)
+			: 0;
+	}
+
+	const uint8_t *vbri = frame + MPEG_VBRI_OFFSET;
+	if (memcmp(vbri, "VBRI", 4) == 0)
+		return LoadBE32(vbri + 14);
+
+	return 0;
+}
+
+bool
+mpeg_header_scan(HeaderReader &reader,
+		 const tag_handler &handler, void *handler_ctx,
+		 size_t &id3_size_r)
+{
+	uint8_t buffer[MPEG_MAX_SYNC_SEARCH];
+	if (!reader.Read(buffer, ID3V2_HEADER_SIZE))
+		return false;
+
+	id3_size_r = id3v2_tag_size(buffer);
+	if (id3_size_r >= reader.GetSize())
+		return false;
+
+	/* find the first frame */
+
+	const size_t nbytes = std::min<uint64_t>(sizeof(buffer),
+					   reader.GetSize() - id3_size_r);
+	if (!reader.Seek(id3_size_r) || nbytes < MPEG_FIRST_FRAME_SIZE ||
+	    !reader.Read(buffer, nbytes))
+		return false;
+
+	MpegFrameHeader header;
+	size_t i = 0;
+	while (!header.Parse(buffer + i))
+		if (++i > nbytes - MPEG_FIRST_FRAME_SIZE)
+			return false;
+
+	const uint8_t *frame = buffer + i;
+	const uint32_t n_frames = mpeg_get_frame_count(frame, header);
+	if (n_frames == 0)
+		return false;
+
+	const uint64_t n_samples = uint64_t(n_frames) *
+		header.samples_per_frame;
+	tag_handler_invoke_duration(&handler, handler_ctx,
+				    SongTime::FromScale<uint64_t>(n_samples,
+								  header.sample_rate));
+	return true;
+}
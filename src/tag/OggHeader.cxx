@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "OggHeader.hxx"
+#include "HeaderReader.hxx"
+#include "XiphHeader.hxx"
+#include "TagHandler.hxx"
+#include "Chrono.hxx"
+
+#include <algorithm>
+#include <memory>
+
+#include <string.h>
+
+static constexpr size_t OGG_PAGE_HEADER_SIZE = 27;
+
+/**
+ * The maximum size of an Ogg page, including the header.
+ */
+static constexpr size_t OGG_MAX_PAGE_SIZE =
+	OGG_PAGE_HEADER_SIZE + 255 + 255 * 255;
+
+/**
+ * The first attempt to find the last page reads this many bytes
+ * from the end of the file.
+ */
+static constexpr size_t OGG_TAIL_SIZE = 8192;
+
+static constexpr unsigned OPUS_SAMPLE_RATE = 48000;
+
+gcc_pure
+static uint32_t
+LoadLE32(const uint8_t *p)
+{
+	return uint32_t(p[0]) | (uint32_t(p[1]) << 8) |
+		(uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+gcc_pure
+static uint64_t
+LoadLE64(const uint8_t *p)
+{
+	return uint64_t(LoadLE32(p)) | (uint64_t(LoadLE32(p + 4)) << 32);
+}
+
+/**
+ * Reads the packets of a logical Ogg stream, page by page, without
+ * buffering: data which is not needed is skipped with a seek.
+ */
+class OggPacketSource final : public HeaderSource {
+	HeaderReader &reader;
+
+	uint32_t serial;
+	bool have_serial;
+
+	uint8_t segments[255];
+	unsigned n_segments, next_segment;
+
+	/**
+	 * The number of bytes remaining in the current segment.
+	 */
+	unsigned segment_remaining;
+
+	/**
+	 * Has the last segment of the current packet been entered?
+	 */
+	bool packet_done;
+
+public:
+	explicit OggPacketSource(HeaderReader &_reader)
+		:reader(_reader), have_serial(false),
+		 n_segments(0), next_segment(0),
+		 segment_remaining(0), packet_done(true) {}
+
+	uint32_t GetSerial() const {
+		return serial;
+	}
+
+	/**
+	 * Skip the rest of the current packet and start reading the
+	 * next one.
+	 */
+	bool NextPacket() {
+		while (segment_remaining > 0 || !packet_done) {
+			if (!reader.Skip(segment_remaining))
+				return false;
+
+			segment_remaining = 0;
+			if (!packet_done && !NextSegment())
+				return false;
+		}
+
+		packet_done = false;
+		return true;
+	}
+
+	/* virtual methods from class HeaderSource */
+	bool Read(void *dest, size_t length) override {
+		uint8_t *p = (uint8_t *)dest;
+		while (length > 0) {
+			if (!Fill())
+				return false;
+
+			const size_t nbytes = std::min<size_t>(length,
+							       segment_remaining);
+			if (!reader.Read(p, nbytes))
+				return false;
+
+			p += nbytes;
+			length -= nbytes;
+			segment_remaining -= nbytes;
+		}
+
+		return true;
+	}
+
+	bool Skip(uint64_t length) override {
+		while (length > 0) {
+			if (!Fill())
+				return false;
+
+			const size_t nbytes = std::min<uint64_t>(length,
+								 segment_remaining);
+			if (!reader.Skip(nbytes))
+				return false;
+
+			length -= nbytes;
+			segment_remaining -= nbytes;
+		}
+
+		return true;
+	}
+
+private:
+	bool NextPage() {
+		uint8_t header[OGG_PAGE_HEADER_SIZE];
+		if (!reader.Read(header, sizeof(header)) ||
+		    memcmp(header, "OggS", 4) != 0 || header[4] != 0)
+			return false;
+
+		const uint32_t page_serial = LoadLE32(header + 14);
+		if (!have_serial) {
+			serial = page_serial;
+			have_serial = true;
+		} else if (page_serial != serial)
+			/* multiplexed stream: not supported */
+			return false;
+
+		n_segments = header[26];
+		next_segment = 0;
+		return reader.Read(segments, n_segments);
+	}
+
+	bool NextSegment() {
+		while (next_segment >= n_segments)
+			if (!NextPage())
+				return false;
+
+		segment_remaining = segments[next_segment++];
+		if (segment_remaining < 255)
+			packet_done = true;
+		return true;
+	}
+
+	/**
+	 * Make sure there is data in the current segment of this
+	 * packet.
+	 */
+	bool Fill() {
+		while (segment_remaining == 0)
+			if (packet_done || !NextSegment())
+				return false;
+
+		return true;
+	}
+};
+
+/**
+ * Find the granule position of the last page of the given logical
+ * stream within the last #size bytes of the file.
+ *
+ * @return the granule position or -1 on error
+ */
+static int64_t
+ogg_last_granulepos(HeaderReader &reader, uint32_t serial, size_t size)
+{
+	const uint64_t file_size = reader.GetSize();
+	size = std::min<uint64_t>(file_size, size);
+
+	std::unique_ptr<uint8_t[]> buffer(new uint8_t[size]);
+	if (!reader.Seek(file_size - size) ||
+	    !reader.Read(buffer.get(), size))
+		return -1;
+
+	for (size_t i = size; i >= OGG_PAGE_HEADER_SIZE;) {
+		const uint8_t *p = buffer.get() + i - OGG_PAGE_HEADER_SIZE;
+		--i;
+
+		if (memcmp(p, "OggS", 4) != 0 || p[4] != 0)
+			continue;
+
+		if (LoadLE32(p + 14) != serial)
+			/* chained stream: not supported */
+			return -1;
+
+		const int64_t granulepos = LoadLE64(p + 6);
+		if (granulepos >= 0)
+			return granulepos;
+	}
+
+	return -1;
+}
+
+/**
+ * Find the granule position of the last page of the given logical
+ * stream.  Usually, the last page is small; only if it is not found
+ * near the end, read up to one maximum page size.
+ *
+ * @return the granule position or -1 on error
+ */
+static int64_t
+ogg_last_granulepos(HeaderReader &reader, uint32_t serial)
+{
+	int64_t granulepos = ogg_last_granulepos(reader, serial,
+						 OGG_TAIL_SIZE);
+	if (granulepos < 0 && reader.GetSize() > OGG_TAIL_SIZE)
+		granulepos = ogg_last_granulepos(reader, serial,
+						 OGG_MAX_PAGE_SIZE);
+
+	return granulepos;
+}
+
+bool
+ogg_header_scan(HeaderReader &reader,
+		const tag_handler &handler, void *handler_ctx)
+{
+	OggPacketSource source(reader);
+
+	/* the identification header */
+
+	uint8_t id[16];
+	if (!source.NextPacket() || !source.Read(id, sizeof(id)))
+		return false;
+
+	unsigned sample_rate;
+	const char *comment_magic;
+	size_t comment_magic_length;
+
+	if (memcmp(id, "\001vorbis", 7) == 0) {
+		sample_rate = LoadLE32(id + 12);
+		comment_magic = "\003vorbis";
+		comment_magic_length = 7;
+	} else if (memcmp(id, "OpusHead", 8) == 0) {
+		/* the Opus decoder plugin doesn't subtract the
+		   pre-skip, and neither do we */
+		sample_rate = OPUS_SAMPLE_RATE;
+		comment_magic = "OpusTags";
+		comment_magic_length = 8;
+	} else
+		return false;
+
+	if (sample_rate == 0)
+		return false;
+
+	/* the comment header */
+
+	char magic[8];
+	if (!source.NextPacket() ||
+	    !source.Read(magic, comment_magic_length) ||
+	    memcmp(magic, comment_magic, comment_magic_length) != 0 ||
+	    !xiph_header_scan_comments(source, handler, handler_ctx))
+		return false;
+
+	const int64_t granulepos =
+		ogg_last_granulepos(reader, source.GetSerial());
+	if (granulepos < 0)
+		return false;
+
+	tag_handler_invoke_duration(&handler, handler_ctx,
+				    SongTime::FromScale<uint64_t>(granulepos,
+								  sample_rate));
+	return true;
+}
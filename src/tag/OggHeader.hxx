@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_TAG_OGG_HEADER_HXX
+#define MPD_TAG_OGG_HEADER_HXX
+
+#include "check.h"
+
+class HeaderReader;
+struct tag_handler;
+
+/**
+ * Scan the header packets of an Ogg Vorbis or Opus file, and
+ * determine the duration from the granule position of the last page.
+ * Multiplexed and chained streams are not supported.
+ */
+bool
+ogg_header_scan(HeaderReader &reader,
+		const tag_handler &handler, void *handler_ctx);
+
+#endif
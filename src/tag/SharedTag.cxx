@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SharedTag.hxx"
+#include "Tag.hxx"
+#include "thread/Mutex.hxx"
+
+#include <vector>
+
+#include <assert.h>
+#include <string.h>
+
+struct SharedTag::Block {
+	Block *next;
+
+	size_t hash;
+
+	/**
+	 * The number of #SharedTag instances referring to this block.
+	 * Protected by #shared_tag_mutex.
+	 */
+	unsigned ref;
+
+	const Tag tag;
+
+	Block(size_t _hash, const Tag &_tag)
+		:next(nullptr), hash(_hash), ref(1), tag(_tag) {}
+
+	Block(size_t _hash, Tag &&_tag)
+		:next(nullptr), hash(_hash), ref(1), tag(std::move(_tag)) {}
+};
+
+static const Tag empty_tag;
+
+/**
+ * Protects the pool and the reference counters.  This is a separate
+ * lock (not #tag_pool_lock), because freeing a #Tag may lock that one.
+ */
+static Mutex shared_tag_mutex;
+
+static std::vector<SharedTag::Block *> buckets;
+static unsigned num_blocks;
+
+gcc_pure
+static size_t
+Hash(const Tag &tag)
+{
+	size_t hash = tag.duration.count() * 31 + tag.has_playlist;
+	for (const auto &item : tag) {
+		hash = hash * 31 + item.type;
+		for (const char *p = item.value; *p != 0; ++p)
+			hash = hash * 31 + *p;
+	}
+
+	return hash;
+}
+
+gcc_pure
+static bool
+Equals(const TagItem &a, const TagItem &b)
+{
+	/* TagItem instances are pooled, so usually the pointers are
+	   equal; but the pool duplicates items with many
+	   references */
+	return &a == &b ||
+		(a.type == b.type && strcmp(a.value, b.value) == 0);
+}
+
+gcc_pure
+static bool
+Equals(const Tag &a, const Tag &b)
+{
+	if (a.duration != b.duration || a.has_playlist != b.has_playlist ||
+	    a.num_items != b.num_items)
+		return false;
+
+	for (unsigned i = 0; i < a.num_items; ++i)
+		if (!Equals(*a.items[i], *b.items[i]))
+			return false;
+
+	return true;
+}
+
+static SharedTag::Block *&
+GetBucket(size_t hash)
+{
+	return buckets[hash & (buckets.size() - 1)];
+}
+
+static void
+Grow()
+{
+	std::vector<SharedTag::Block *> old(buckets.size() * 2, nullptr);
+	old.swap(buckets);
+
+	for (auto *b : old) {
+		while (b != nullptr) {
+			auto *next = b->next;
+			auto &bucket = GetBucket(b->hash);
+			b->next = bucket;
+			bucket = b;
+			b = next;
+		}
+	}
+}
+
+/**
+ * Find an existing block.  Caller must lock #shared_tag_mutex.
+ */
+static SharedTag::Block *
+Lookup(size_t hash, const Tag &tag)
+{
+	if (buckets.empty())
+		buckets.resize(1024, nullptr);
+
+	for (auto *b = GetBucket(hash); b != nullptr; b = b->next) {
+		if (b->hash == hash && Equals(b->tag, tag)) {
+			++b->ref;
+			return b;
+		}
+	}
+
+	return nullptr;
+}
+
+/**
+ * Add a new block.  Caller must lock #shared_tag_mutex.
+ */
+static void
+Insert(SharedTag::Block *b)
+{
+	if (++num_blocks > buckets.size())
+		Grow();
+
+	auto &bucket = GetBucket(b->hash);
+	b->next = bucket;
+	bucket = b;
+}
+
+SharedTag::SharedTag(const Tag &tag)
+	:block(nullptr)
+{
+	if (!tag.IsDefined())
+		return;
+
+	const size_t hash = Hash(tag);
+
+	{
+		const ScopeLock protect(shared_tag_mutex);
+		block = Lookup(hash, tag);
+	}
+
+	if (block != nullptr)
+		return;
+
+	/* copy the tag outside of the lock; another thread may have
+	   inserted an equal block meanwhile, which just wastes a
+	   little memory */
+	Block *b = new Block(hash, tag);
+
+	const ScopeLock protect(shared_tag_mutex);
+	Insert(b);
+	block = b;
+}
+
+SharedTag::SharedTag(Tag &&tag)
+	:block(nullptr)
+{
+	if (!tag.IsDefined())
+		return;
+
+	const size_t hash = Hash(tag);
+
+	{
+		const ScopeLock protect(shared_tag_mutex);
+		block = Lookup(hash, tag);
+	}
+
+	if (block != nullptr)
+		return;
+
+	Block *b = new Block(hash, std::move(tag));
+
+	const ScopeLock protect(shared_tag_mutex);
+	Insert(b);
+	block = b;
+}
+
+SharedTag::SharedTag(const SharedTag &other)
+	:block(other.block)
+{
+	if (block != nullptr) {
+		const ScopeLock protect(shared_tag_mutex);
+		assert(block->ref > 0);
+		++block->ref;
+	}
+}
+
+void
+SharedTag::Release(Block *b)
+{
+	{
+		const ScopeLock protect(shared_tag_mutex);
+		assert(b->ref > 0);
+		if (--b->ref > 0)
+			return;
+
+		Block **p = &GetBucket(b->hash);
+		while (*p != b) {
+			assert(*p != nullptr);
+			p = &(*p)->next;
+		}
+
+		*p = b->next;
+		--num_blocks;
+	}
+
+	/* free it outside of the lock, because Tag::Clear() may lock
+	   tag_pool_lock */
+	delete b;
+}
+
+const Tag &
+SharedTag::operator*() const
+{
+	return block != nullptr
+		? block->tag
+		: empty_tag;
+}
+
+unsigned
+SharedTag::GetPoolSize()
+{
+	const ScopeLock protect(shared_tag_mutex);
+	return num_blocks;
+}
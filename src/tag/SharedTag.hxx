@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SHARED_TAG_HXX
+#define MPD_SHARED_TAG_HXX
+
+#include "Compiler.h"
+
+#include <utility>
+
+struct Tag;
+
+/**
+ * A reference to an immutable #Tag which is shared by all holders of
+ * an equal tag.  The blocks are reference counted and kept in a
+ * global pool, similar to the #TagItem pool (see TagPool.hxx).
+ *
+ * This allows many copies of the same song (e.g. in the queues of
+ * several partitions, or queue entries added from the database) to
+ * share one #Tag.
+ */
+class SharedTag {
+public:
+	/**
+	 * Opaque; defined in SharedTag.cxx.
+	 */
+	struct Block;
+
+private:
+	Block *block;
+
+public:
+	/**
+	 * Create an empty tag.
+	 */
+	SharedTag():block(nullptr) {}
+
+	explicit SharedTag(const Tag &tag);
+	explicit SharedTag(Tag &&tag);
+
+	SharedTag(const SharedTag &other);
+
+	SharedTag(SharedTag &&other):block(other.block) {
+		other.block = nullptr;
+	}
+
+	~SharedTag() {
+		if (block != nullptr)
+			Release(block);
+	}
+
+	SharedTag &operator=(const SharedTag &other) {
+		SharedTag tmp(other);
+		std::swap(block, tmp.block);
+		return *this;
+	}
+
+	SharedTag &operator=(SharedTag &&other) {
+		std::swap(block, other.block);
+		return *this;
+	}
+
+	/**
+	 * Do both objects refer to the same block, i.e. are the
+	 * tags equal?
+	 */
+	bool operator==(const SharedTag &other) const {
+		return block == other.block;
+	}
+
+	bool operator!=(const SharedTag &other) const {
+		return block != other.block;
+	}
+
+	gcc_pure
+	const Tag &operator*() const;
+
+	const Tag *operator->() const {
+		return &**this;
+	}
+
+	/**
+	 * Returns the number of blocks in the pool.  For debugging and
+	 * statistics.
+	 */
+	gcc_pure
+	static unsigned GetPoolSize();
+
+private:
+	static void Release(Block *block);
+};
+
+#endif
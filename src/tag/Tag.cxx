@@ -64,31 +64,56 @@ Tag::Clear()
 	duration = SignedSongTime::Negative();
 	has_playlist = false;
 
-	tag_pool_lock.lock();
 	for (unsigned i = 0; i < num_items; ++i)
 		tag_pool_put_item(items[i]);
-	tag_pool_lock.unlock();
 
-	delete[] items;
+	DiscardItems();
+}
+
+void
+Tag::DiscardItems()
+{
+	if (!foreign_items)
+		delete[] items;
+
 	items = nullptr;
 	num_items = 0;
+	foreign_items = false;
 }
 
 Tag::Tag(const Tag &other)
 	:duration(other.duration), has_playlist(other.has_playlist),
+	 foreign_items(false),
 	 num_items(other.num_items),
 	 items(nullptr)
 {
 	if (num_items > 0) {
 		items = new TagItem *[num_items];
 
-		tag_pool_lock.lock();
 		for (unsigned i = 0; i < num_items; i++)
 			items[i] = tag_pool_dup_item(other.items[i]);
-		tag_pool_lock.unlock();
 	}
 }
 
+void
+Tag::AssignForeign(const Tag &other, TagItem **array)
+{
+	Clear();
+
+	duration = other.duration;
+	has_playlist = other.has_playlist;
+
+	if (other.num_items == 0)
+		return;
+
+	for (unsigned i = 0; i < other.num_items; i++)
+		array[i] = tag_pool_dup_item(other.items[i]);
+
+	items = array;
+	num_items = other.num_items;
+	foreign_items = true;
+}
+
 Tag *
 Tag::Merge(const Tag &base, const Tag &add)
 {
@@ -47,6 +47,13 @@ struct Tag {
 	 */
 	bool has_playlist;
 
+	/**
+	 * Is the #items array owned by somebody else (e.g. allocated
+	 * from the database's #Arena)?  Then this object must not
+	 * free it.
+	 */
+	bool foreign_items;
+
 	/** the total number of tag items in the #items array */
 	unsigned short num_items;
 
@@ -57,15 +64,17 @@ struct Tag {
 	 * Create an empty tag.
 	 */
 	Tag():duration(SignedSongTime::Negative()), has_playlist(false),
-	      num_items(0), items(nullptr) {}
+	      foreign_items(false), num_items(0), items(nullptr) {}
 
 	Tag(const Tag &other);
 
 	Tag(Tag &&other)
 		:duration(other.duration), has_playlist(other.has_playlist),
+		 foreign_items(other.foreign_items),
 		 num_items(other.num_items), items(other.items) {
 		other.items = nullptr;
 		other.num_items = 0;
+		other.foreign_items = false;
 	}
 
 	/**
@@ -82,9 +91,26 @@ struct Tag {
 		has_playlist = other.has_playlist;
 		std::swap(items, other.items);
 		std::swap(num_items, other.num_items);
+		std::swap(foreign_items, other.foreign_items);
 		return *this;
 	}
 
+	/**
+	 * Replace the contents of this object with a copy of another
+	 * one, but store the item pointers in an array provided by the
+	 * caller, which will not be freed by this object.
+	 *
+	 * @param array an array with room for other.num_items
+	 * pointers
+	 */
+	void AssignForeign(const Tag &other, TagItem **array);
+
+	/**
+	 * Forget all items without releasing their references (which
+	 * must have been moved elsewhere), and free the #items array.
+	 */
+	void DiscardItems();
+
 	/**
 	 * Returns true if the tag contains no items.  This ignores
 	 * the "duration" attribute.
@@ -32,18 +32,18 @@
 #include <stdlib.h>
 
 TagBuilder::TagBuilder(const Tag &other)
-	:duration(other.duration), has_playlist(other.has_playlist)
+	:duration(other.duration), has_playlist(other.has_playlist),
+	 transient(false)
 {
 	items.reserve(other.num_items);
 
-	tag_pool_lock.lock();
 	for (unsigned i = 0, n = other.num_items; i != n; ++i)
 		items.push_back(tag_pool_dup_item(other.items[i]));
-	tag_pool_lock.unlock();
 }
 
 TagBuilder::TagBuilder(Tag &&other)
-	:duration(other.duration), has_playlist(other.has_playlist)
+	:duration(other.duration), has_playlist(other.has_playlist),
+	 transient(false)
 {
 	/* move all TagItem pointers from the Tag object; we don't
 	   need to contact the tag pool, because all we do is move
@@ -52,9 +52,7 @@ TagBuilder::TagBuilder(Tag &&other)
 	std::copy_n(other.items, other.num_items, std::back_inserter(items));
 
 	/* discard the pointers from the Tag object */
-	other.num_items = 0;
-	delete[] other.items;
-	other.items = nullptr;
+	other.DiscardItems();
 }
 
 TagBuilder &
@@ -66,10 +64,8 @@ TagBuilder::operator=(const TagBuilder &other)
 	items = other.items;
 
 	/* increment the tag pool refcounters */
-	tag_pool_lock.lock();
-	for (auto i : items)
-		tag_pool_dup_item(i);
-	tag_pool_lock.unlock();
+	for (auto &i : items)
+		i = tag_pool_dup_item(i);
 
 	return *this;
 }
@@ -98,9 +94,7 @@ TagBuilder::operator=(Tag &&other)
 	std::copy_n(other.items, other.num_items, std::back_inserter(items));
 
 	/* discard the pointers from the Tag object */
-	other.num_items = 0;
-	delete[] other.items;
-	other.items = nullptr;
+	other.DiscardItems();
 
 	return *this;
 }
@@ -121,6 +115,14 @@ TagBuilder::Commit(Tag &tag)
 	tag.duration = duration;
 	tag.has_playlist = has_playlist;
 
+	if (!transient && !items.empty()) {
+		/* share the new items with equal ones in the pool,
+		   all with one lock */
+		const ScopeLock protect(tag_pool_lock);
+		for (auto &i : items)
+			i = tag_pool_intern_item(i);
+	}
+
 	/* move all TagItem pointers to the new Tag object without
 	   touching the TagPool reference counters; the
 	   vector::clear() call is important to detach them from this
@@ -179,13 +181,11 @@ TagBuilder::Complement(const Tag &other)
 
 	items.reserve(items.size() + other.num_items);
 
-	tag_pool_lock.lock();
 	for (unsigned i = 0, n = other.num_items; i != n; ++i) {
 		TagItem *item = other.items[i];
 		if (!present[item->type])
 			items.push_back(tag_pool_dup_item(item));
 	}
-	tag_pool_lock.unlock();
 }
 
 inline void
@@ -203,9 +203,9 @@ TagBuilder::AddItemInternal(TagType type, const char *value, size_t length)
 		length = f.size;
 	}
 
-	tag_pool_lock.lock();
-	auto i = tag_pool_get_item(type, value, length);
-	tag_pool_lock.unlock();
+	/* no lock here: the item is looked up in the pool by
+	   Commit() */
+	auto i = tag_pool_new_item(type, value, length);
 
 	free(f.data);
 
@@ -240,20 +240,14 @@ TagBuilder::AddItem(TagType type, const char *value)
 void
 TagBuilder::AddEmptyItem(TagType type)
 {
-	tag_pool_lock.lock();
-	auto i = tag_pool_get_item(type, "", 0);
-	tag_pool_lock.unlock();
-
-	items.push_back(i);
+	items.push_back(tag_pool_new_item(type, "", 0));
 }
 
 void
 TagBuilder::RemoveAll()
 {
-	tag_pool_lock.lock();
 	for (auto i : items)
 		tag_pool_put_item(i);
-	tag_pool_lock.unlock();
 
 	items.clear();
 }
@@ -47,7 +47,16 @@ class TagBuilder {
 	 */
 	bool has_playlist;
 
-	/** an array of tag items */
+	/**
+	 * Skip looking up the items in the #TagPool in Commit()?  See
+	 * SetTransient().
+	 */
+	bool transient;
+
+	/**
+	 * An array of tag items.  Items added by AddItem() are not in
+	 * the #TagPool's hash table yet, see tag_pool_new_item().
+	 */
 	std::vector<TagItem *> items;
 
 public:
@@ -55,7 +64,8 @@ public:
 	 * Create an empty tag.
 	 */
 	TagBuilder()
-		:duration(SignedSongTime::Negative()), has_playlist(false) {}
+		:duration(SignedSongTime::Negative()), has_playlist(false),
+		 transient(false) {}
 
 	~TagBuilder() {
 		Clear();
@@ -89,6 +99,18 @@ public:
 
 	void Clear();
 
+	/**
+	 * Declare that the tags built by this object are short-lived,
+	 * e.g. stream tags received by a decoder or an input stream.
+	 * Their items are not shared with equal items in the
+	 * #TagPool, which saves the hash lookups and the
+	 * #tag_pool_lock traffic.  Tags which are going to be stored
+	 * in the database must not use this.
+	 */
+	void SetTransient() {
+		transient = true;
+	}
+
 	/**
 	 * Move this object to the given #Tag instance.  This object
 	 * is empty afterwards.
@@ -23,8 +23,21 @@
 #include "check.h"
 #include "TagType.h"
 #include "Chrono.hxx"
+#include "util/ConstBuffer.hxx"
 
 #include <assert.h>
+#include <stddef.h>
+
+/**
+ * Embedded pictures larger than this are ignored.
+ */
+static constexpr size_t TAG_MAX_PICTURE_SIZE = 16 * 1024 * 1024;
+
+/**
+ * The picture type of the front cover in ID3v2 "APIC" frames and
+ * FLAC "PICTURE" blocks.
+ */
+static constexpr unsigned TAG_PICTURE_FRONT_COVER = 3;
 
 /**
  * A callback table for receiving metadata of a song.
@@ -50,6 +63,20 @@ struct tag_handler {
 	 * representation of tags.
 	 */
 	void (*pair)(const char *key, const char *value, void *ctx);
+
+	/**
+	 * An embedded picture has been read.  Pictures are large, so
+	 * the scanners skip them unless this method is set.
+	 *
+	 * @param mime_type the MIME type of the image; may be empty
+	 * if unknown
+	 * @param type the ID3v2/FLAC picture type, e.g.
+	 * #TAG_PICTURE_FRONT_COVER
+	 * @param data the image; the pointer will become invalid
+	 * after returning
+	 */
+	void (*picture)(const char *mime_type, unsigned type,
+			ConstBuffer<void> data, void *ctx);
 };
 
 static inline void
@@ -86,6 +113,26 @@ tag_handler_invoke_pair(const struct tag_handler *handler, void *ctx,
 		handler->pair(name, value, ctx);
 }
 
+static inline bool
+tag_handler_wants_picture(const struct tag_handler *handler)
+{
+	assert(handler != nullptr);
+
+	return handler->picture != nullptr;
+}
+
+static inline void
+tag_handler_invoke_picture(const struct tag_handler *handler, void *ctx,
+			   const char *mime_type, unsigned type,
+			   ConstBuffer<void> data)
+{
+	assert(handler != nullptr);
+	assert(mime_type != nullptr);
+
+	if (handler->picture != nullptr)
+		handler->picture(mime_type, type, data, ctx);
+}
+
 /**
  * This #tag_handler implementation adds tag values to a #TagBuilder object
  * (casted from the context pointer).
@@ -30,8 +30,11 @@
 #include "config/ConfigGlobal.hxx"
 #include "Riff.hxx"
 #include "Aiff.hxx"
+#include "HeaderReader.hxx"
+#include "TagScanFile.hxx"
+#include "Id3v2Header.hxx"
+#include "Id3v2Parser.hxx"
 #include "fs/Path.hxx"
-#include "fs/FileSystem.hxx"
 
 #ifdef HAVE_GLIB
 #include <glib.h>
@@ -39,6 +42,7 @@
 
 #include <id3tag.h>
 
+#include <memory>
 #include <string>
 
 #include <stdio.h>
@@ -248,29 +252,6 @@ tag_id3_import_comment(struct id3_tag *tag, const char *id, TagType type,
 					     handler, handler_ctx);
 }
 
-/**
- * Parse a TXXX name, and convert it to a TagType enum value.
- * Returns TAG_NUM_OF_ITEM_TYPES if the TXXX name is not understood.
- */
-gcc_pure
-static TagType
-tag_id3_parse_txxx_name(const char *name)
-{
-	static constexpr struct tag_table txxx_tags[] = {
-		{ "ALBUMARTISTSORT", TAG_ALBUM_ARTIST_SORT },
-		{ "MusicBrainz Artist Id", TAG_MUSICBRAINZ_ARTISTID },
-		{ "MusicBrainz Album Id", TAG_MUSICBRAINZ_ALBUMID },
-		{ "MusicBrainz Album Artist Id",
-		  TAG_MUSICBRAINZ_ALBUMARTISTID },
-		{ "MusicBrainz Track Id", TAG_MUSICBRAINZ_TRACKID },
-		{ "MusicBrainz Release Track Id",
-		  TAG_MUSICBRAINZ_RELEASETRACKID },
-		{ nullptr, TAG_NUM_OF_ITEM_TYPES }
-	};
-
-	return tag_table_lookup(txxx_tags, name);
-}
-
 /**
  * Import all known MusicBrainz tags from TXXX frames.
  */
@@ -393,29 +374,35 @@ tag_id3_import(struct id3_tag *tag)
 		: tag_builder.CommitNew();
 }
 
+/**
+ * Read up to the specified number of bytes at the given offset.
+ * It's ok if we get less than we asked for.
+ */
 static size_t
-fill_buffer(void *buf, size_t size, FILE *stream, long offset, int whence)
+fill_buffer(void *buf, size_t size, HeaderReader &reader, uint64_t offset)
 {
-	if (fseek(stream, offset, whence) != 0) return 0;
-	return fread(buf, 1, size, stream);
+	if (!reader.Seek(offset))
+		return 0;
+
+	return reader.ReadSome(buf, size);
 }
 
 static long
-get_id3v2_footer_size(FILE *stream, long offset, int whence)
+get_id3v2_footer_size(HeaderReader &reader, uint64_t offset)
 {
 	id3_byte_t buf[ID3_TAG_QUERYSIZE];
-	size_t bufsize = fill_buffer(buf, ID3_TAG_QUERYSIZE, stream, offset, whence);
+	size_t bufsize = fill_buffer(buf, ID3_TAG_QUERYSIZE, reader, offset);
 	if (bufsize == 0) return 0;
 	return id3_tag_query(buf, bufsize);
 }
 
 static struct id3_tag *
-tag_id3_read(FILE *stream, long offset, int whence)
+tag_id3_read(HeaderReader &reader, uint64_t offset)
 {
 	/* It's ok if we get less than we asked for */
 	id3_byte_t query_buffer[ID3_TAG_QUERYSIZE];
 	size_t query_buffer_size = fill_buffer(query_buffer, ID3_TAG_QUERYSIZE,
-					       stream, offset, whence);
+					       reader, offset);
 	if (query_buffer_size <= 0)
 		return nullptr;
 
@@ -425,22 +412,20 @@ tag_id3_read(FILE *stream, long offset, int whence)
 
 	/* Found a tag.  Allocate a buffer and read it in. */
 	id3_byte_t *tag_buffer = new id3_byte_t[tag_size];
-	int tag_buffer_size = fill_buffer(tag_buffer, tag_size,
-					  stream, offset, whence);
-	if (tag_buffer_size < tag_size) {
+	if (!reader.Seek(offset) || !reader.Read(tag_buffer, tag_size)) {
 		delete[] tag_buffer;
 		return nullptr;
 	}
 
-	id3_tag *tag = id3_tag_parse(tag_buffer, tag_buffer_size);
+	id3_tag *tag = id3_tag_parse(tag_buffer, tag_size);
 	delete[] tag_buffer;
 	return tag;
 }
 
 static struct id3_tag *
-tag_id3_find_from_beginning(FILE *stream)
+tag_id3_find_from_beginning(HeaderReader &reader)
 {
-	id3_tag *tag = tag_id3_read(stream, 0, SEEK_SET);
+	id3_tag *tag = tag_id3_read(reader, 0);
 	if (!tag) {
 		return nullptr;
 	} else if (tag_is_id3v1(tag)) {
@@ -457,8 +442,9 @@ tag_id3_find_from_beginning(FILE *stream)
 		if (seek < 0)
 			break;
 
-		/* Get the tag specified by the SEEK frame */
-		id3_tag *seektag = tag_id3_read(stream, seek, SEEK_CUR);
+		/* Get the tag specified by the SEEK frame; the offset
+		   is relative to the end of the current tag */
+		id3_tag *seektag = tag_id3_read(reader, reader.Tell() + seek);
 		if (!seektag || tag_is_id3v1(seektag))
 			break;
 
@@ -471,18 +457,26 @@ tag_id3_find_from_beginning(FILE *stream)
 }
 
 static struct id3_tag *
-tag_id3_find_from_end(FILE *stream)
+tag_id3_find_from_end(HeaderReader &reader)
 {
+	const uint64_t size = reader.GetSize();
+
 	/* Get an id3v1 tag from the end of file for later use */
-	id3_tag *v1tag = tag_id3_read(stream, -128, SEEK_END);
+	id3_tag *v1tag = size >= 128
+		? tag_id3_read(reader, size - 128)
+		: nullptr;
 
 	/* Get the id3v2 tag size from the footer (located before v1tag) */
-	int tagsize = get_id3v2_footer_size(stream, (v1tag ? -128 : 0) - 10, SEEK_END);
-	if (tagsize >= 0)
+	const uint64_t footer_end = size - (v1tag ? 128 : 0);
+	if (footer_end < 10)
+		return v1tag;
+
+	int tagsize = get_id3v2_footer_size(reader, footer_end - 10);
+	if (tagsize >= 0 || uint64_t(-tagsize) > footer_end)
 		return v1tag;
 
 	/* Get the tag which the footer belongs to */
-	id3_tag *tag = tag_id3_read(stream, tagsize, SEEK_CUR);
+	id3_tag *tag = tag_id3_read(reader, footer_end + tagsize);
 	if (!tag)
 		return v1tag;
 
@@ -493,11 +487,11 @@ tag_id3_find_from_end(FILE *stream)
 }
 
 static struct id3_tag *
-tag_id3_riff_aiff_load(FILE *file)
+tag_id3_riff_aiff_load(HeaderReader &reader)
 {
-	size_t size = riff_seek_id3(file);
+	size_t size = riff_seek_id3(reader);
 	if (size == 0)
-		size = aiff_seek_id3(file);
+		size = aiff_seek_id3(reader);
 	if (size == 0)
 		return nullptr;
 
@@ -506,8 +500,7 @@ tag_id3_riff_aiff_load(FILE *file)
 		return nullptr;
 
 	id3_byte_t *buffer = new id3_byte_t[size];
-	size_t ret = fread(buffer, size, 1, file);
-	if (ret != 1) {
+	if (!reader.Read(buffer, size)) {
 		LogWarning(id3_domain, "Failed to read RIFF chunk");
 		delete[] buffer;
 		return nullptr;
@@ -519,39 +512,91 @@ tag_id3_riff_aiff_load(FILE *file)
 }
 
 struct id3_tag *
-tag_id3_load(Path path_fs, Error &error)
+tag_id3_load(TagScanFile &file)
 {
-	FILE *file = FOpen(path_fs, PATH_LITERAL("rb"));
-	if (file == nullptr) {
-		error.FormatErrno("Failed to open file %s", path_fs.c_str());
-		return nullptr;
-	}
+	HeaderReader reader(file);
 
-	struct id3_tag *tag = tag_id3_find_from_beginning(file);
+	struct id3_tag *tag = tag_id3_find_from_beginning(reader);
 	if (tag == nullptr) {
-		tag = tag_id3_riff_aiff_load(file);
+		tag = tag_id3_riff_aiff_load(reader);
 		if (tag == nullptr)
-			tag = tag_id3_find_from_end(file);
+			tag = tag_id3_find_from_end(reader);
 	}
 
-	fclose(file);
 	return tag;
 }
 
+struct id3_tag *
+tag_id3_load(Path path_fs, Error &error)
+{
+	LocalTagScanFile file(path_fs);
+	if (!file.IsDefined()) {
+		error.FormatErrno("Failed to open file %s", path_fs.c_str());
+		return nullptr;
+	}
+
+	return tag_id3_load(file);
+}
+
+/**
+ * Attempt to parse the ID3v2 tag at the beginning of the file with
+ * the native parser, which avoids libid3tag's UCS-4 strings and the
+ * parsing of large frames (e.g. cover art) we don't use.  This is
+ * also the only way to obtain embedded pictures.
+ *
+ * @return false if there is no such tag or if the native parser
+ * cannot handle it
+ */
+static bool
+tag_id3_scan_native(TagScanFile &file,
+		    const struct tag_handler *handler, void *handler_ctx)
+{
+	uint8_t header[ID3V2_HEADER_SIZE];
+	if (!file.ReadAt(0, header, sizeof(header)))
+		return false;
+
+	/* allow larger tags if the caller wants the pictures they
+	   usually consist of */
+	const size_t max_size = tag_handler_wants_picture(handler)
+		? TAG_MAX_PICTURE_SIZE
+		: 4 * 1024 * 1024;
+
+	const size_t size = id3v2_tag_size(header);
+	if (size == 0 || size > max_size)
+		return false;
+
+	std::unique_ptr<uint8_t[]> buffer(new uint8_t[size]);
+	return file.ReadAt(0, buffer.get(), size) &&
+		id3v2_parse(buffer.get(), size, handler, handler_ctx);
+}
+
 bool
-tag_id3_scan(Path path_fs,
+tag_id3_scan(TagScanFile &file,
 	     const struct tag_handler *handler, void *handler_ctx)
 {
-	Error error;
-	struct id3_tag *tag = tag_id3_load(path_fs, error);
-	if (tag == nullptr) {
-		if (error.IsDefined())
-			LogError(error);
+	if (tag_id3_scan_native(file, handler, handler_ctx))
+		return true;
 
+	struct id3_tag *tag = tag_id3_load(file);
+	if (tag == nullptr)
 		return false;
-	}
 
 	scan_id3_tag(tag, handler, handler_ctx);
 	id3_tag_delete(tag);
 	return true;
 }
+
+bool
+tag_id3_scan(Path path_fs,
+	     const struct tag_handler *handler, void *handler_ctx)
+{
+	LocalTagScanFile file(path_fs);
+	if (!file.IsDefined()) {
+		Error error;
+		error.FormatErrno("Failed to open file %s", path_fs.c_str());
+		LogError(error);
+		return false;
+	}
+
+	return tag_id3_scan(file, handler, handler_ctx);
+}
@@ -24,6 +24,7 @@
 #include "Compiler.h"
 
 class Path;
+class TagScanFile;
 struct tag_handler;
 struct Tag;
 struct id3_tag;
@@ -35,6 +36,13 @@ bool
 tag_id3_scan(Path path_fs,
 	     const tag_handler *handler, void *handler_ctx);
 
+/**
+ * Scan the ID3 tags of a file which is already open.
+ */
+bool
+tag_id3_scan(TagScanFile &file,
+	     const tag_handler *handler, void *handler_ctx);
+
 Tag *
 tag_id3_import(id3_tag *);
 
@@ -48,6 +56,14 @@ tag_id3_import(id3_tag *);
 struct id3_tag *
 tag_id3_load(Path path_fs, Error &error);
 
+/**
+ * Loads the ID3 tags from a file which is already open.
+ *
+ * @return nullptr if no ID3 tag was found in the file
+ */
+struct id3_tag *
+tag_id3_load(TagScanFile &file);
+
 /**
  * Import all tags from the provided id3_tag *tag
  *
@@ -68,6 +84,14 @@ tag_id3_scan(gcc_unused Path path_fs,
 	return false;
 }
 
+static inline bool
+tag_id3_scan(gcc_unused TagScanFile &file,
+	     gcc_unused const tag_handler *handler,
+	     gcc_unused void *handler_ctx)
+{
+	return false;
+}
+
 #endif
 
 #endif
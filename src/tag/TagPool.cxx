@@ -23,46 +23,149 @@
 #include "util/Cast.hxx"
 #include "util/VarSize.hxx"
 
+#include <vector>
+
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 
 Mutex tag_pool_lock;
 
-static constexpr size_t NUM_SLOTS = 4096;
+/**
+ * The initial (and minimum) size of the hash table; it must be a
+ * power of two.
+ */
+static constexpr size_t MIN_BUCKETS = 4096;
+
+/*
+ * Reference counting and the case-folded value don't need
+ * #tag_pool_lock; they use atomic operations.  The lock protects only
+ * the hash table: looking up items and removing the last reference of
+ * an item which is in the table.
+ */
 
 struct TagPoolSlot {
-	TagPoolSlot *next;
-	unsigned char ref;
+	/**
+	 * The case-folded copy of the value, see
+	 * tag_pool_set_folded().  It may point to #item's value if
+	 * both are equal.  nullptr if it has not been set yet.  It is
+	 * set only once, with an atomic compare-and-swap.
+	 */
+	char *folded;
+
+	/**
+	 * The reference counter; only modified with atomic
+	 * operations.  The last reference of a listed slot is
+	 * released only while #tag_pool_lock is held, so Find()
+	 * never sees a slot which is being freed.
+	 */
+	unsigned ref;
+
+	/**
+	 * The hash of #item, see calc_hash().
+	 */
+	unsigned hash;
+
+	/**
+	 * Is this slot in the hash table?  This is false for items
+	 * created by tag_pool_new_item().
+	 */
+	bool listed;
+
 	TagItem item;
 
-	TagPoolSlot(TagPoolSlot *_next, TagType type,
+	TagPoolSlot(unsigned _hash, TagType type,
 		    const char *value, size_t length)
-		:next(_next), ref(1) {
+		:folded(nullptr), ref(1), hash(_hash), listed(false) {
 		item.type = type;
 		memcpy(item.value, value, length);
 		item.value[length] = 0;
 	}
 
-	static TagPoolSlot *Create(TagPoolSlot *_next, TagType type,
+	~TagPoolSlot() {
+		if (folded != item.value)
+			delete[] folded;
+	}
+
+	static TagPoolSlot *Create(unsigned _hash, TagType type,
 				   const char *value, size_t length);
+
+	unsigned GetRef() const {
+		return __atomic_load_n(&ref, __ATOMIC_ACQUIRE);
+	}
+
+	/**
+	 * Add a reference, unless the counter is saturated.
+	 */
+	bool TryRef() {
+		unsigned r = GetRef();
+		do {
+			assert(r > 0);
+			if (r == ~0u)
+				return false;
+		} while (!__atomic_compare_exchange_n(&ref, &r, r + 1, true,
+						      __ATOMIC_ACQ_REL,
+						      __ATOMIC_ACQUIRE));
+		return true;
+	}
+
+	/**
+	 * Release a reference, unless it is the last one.
+	 *
+	 * @return false if this is the last reference, which was not
+	 * released
+	 */
+	bool TryUnref() {
+		unsigned r = GetRef();
+		do {
+			assert(r > 0);
+			if (r == 1)
+				return false;
+		} while (!__atomic_compare_exchange_n(&ref, &r, r - 1, true,
+						      __ATOMIC_ACQ_REL,
+						      __ATOMIC_ACQUIRE));
+		return true;
+	}
+
+	/**
+	 * Release a reference.
+	 *
+	 * @return true if this was the last one
+	 */
+	bool Unref() {
+		return __atomic_sub_fetch(&ref, 1, __ATOMIC_ACQ_REL) == 0;
+	}
 } gcc_packed;
 
 TagPoolSlot *
-TagPoolSlot::Create(TagPoolSlot *_next, TagType type,
+TagPoolSlot::Create(unsigned _hash, TagType type,
 		    const char *value, size_t length)
 {
 	TagPoolSlot *dummy;
 	return NewVarSize<TagPoolSlot>(sizeof(dummy->item.value),
 				       length + 1,
-				       _next, type,
+				       _hash, type,
 				       value, length);
 }
 
-static TagPoolSlot *slots[NUM_SLOTS];
+/**
+ * An entry of the open addressing hash table.  The hash is copied
+ * here so probing does not need to dereference other slots.
+ */
+struct TagPoolBucket {
+	TagPoolSlot *slot;
+	unsigned hash;
+};
+
+/**
+ * The hash table with linear probing; its size is a power of two.
+ * Empty buckets have a nullptr slot.
+ */
+static std::vector<TagPoolBucket> buckets;
+static size_t num_slots;
 
 static inline unsigned
-calc_hash_n(TagType type, const char *p, size_t length)
+calc_hash(TagType type, const char *p, size_t length)
 {
 	unsigned hash = 5381;
 
@@ -71,20 +174,16 @@ calc_hash_n(TagType type, const char *p, size_t length)
 	while (length-- > 0)
 		hash = (hash << 5) + hash + *p++;
 
-	return hash ^ type;
-}
-
-static inline unsigned
-calc_hash(TagType type, const char *p)
-{
-	unsigned hash = 5381;
-
-	assert(p != nullptr);
-
-	while (*p != 0)
-		hash = (hash << 5) + hash + *p++;
+	hash ^= type;
 
-	return hash ^ type;
+	/* the MurmurHash3 finalizer, because only the lower bits
+	   select the bucket */
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+	return hash;
 }
 
 #if CLANG_OR_GCC_VERSION(4,7)
@@ -96,79 +195,278 @@ tag_item_to_slot(TagItem *item)
 	return &ContainerCast(*item, &TagPoolSlot::item);
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, const char *value, size_t length)
+static inline size_t
+GetMask()
 {
-	return &slots[calc_hash_n(type, value, length) % NUM_SLOTS];
+	return buckets.size() - 1;
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, const char *value)
+/**
+ * Insert a slot which is not in the table yet.  The table must have
+ * at least one empty bucket.
+ */
+static void
+InsertBucket(TagPoolSlot *slot)
 {
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
+	const size_t mask = GetMask();
+	size_t i = slot->hash & mask;
+	while (buckets[i].slot != nullptr)
+		i = (i + 1) & mask;
+
+	buckets[i].slot = slot;
+	buckets[i].hash = slot->hash;
 }
 
-TagItem *
-tag_pool_get_item(TagType type, const char *value, size_t length)
+static void
+Resize(size_t new_size)
+{
+	std::vector<TagPoolBucket> old(new_size, TagPoolBucket{nullptr, 0});
+	old.swap(buckets);
+
+	for (const auto &b : old)
+		if (b.slot != nullptr)
+			InsertBucket(b.slot);
+}
+
+/**
+ * Add a new slot to the table, growing it if the load factor would
+ * exceed 0.7.
+ */
+static void
+Insert(TagPoolSlot *slot)
+{
+	if (buckets.empty())
+		buckets.resize(MIN_BUCKETS, TagPoolBucket{nullptr, 0});
+
+	if ((num_slots + 1) * 10 > buckets.size() * 7)
+		Resize(buckets.size() * 2);
+
+	InsertBucket(slot);
+	slot->listed = true;
+	++num_slots;
+}
+
+/**
+ * Remove a slot from the table.  The following buckets of the
+ * probe sequence are shifted back, so no "deleted" markers are
+ * needed.
+ */
+static void
+Remove(TagPoolSlot *slot)
 {
-	auto slot_p = tag_value_slot_p(type, value, length);
-	for (auto slot = *slot_p; slot != nullptr; slot = slot->next) {
+	const size_t mask = GetMask();
+	size_t i = slot->hash & mask;
+	while (buckets[i].slot != slot) {
+		assert(buckets[i].slot != nullptr);
+		i = (i + 1) & mask;
+	}
+
+	for (size_t j = (i + 1) & mask; buckets[j].slot != nullptr;
+	     j = (j + 1) & mask) {
+		/* may the bucket at j move to i, i.e. is its home
+		   bucket not in the (cyclic) range (i, j]? */
+		const size_t home = buckets[j].hash & mask;
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			buckets[i] = buckets[j];
+			i = j;
+		}
+	}
+
+	buckets[i].slot = nullptr;
+	--num_slots;
+
+	/* shrink after the database has been unloaded */
+	if (buckets.size() > MIN_BUCKETS && num_slots * 8 < buckets.size())
+		Resize(buckets.size() / 2);
+}
+
+/**
+ * Find a slot with the given value which can take another
+ * reference.  Returns nullptr if there is none.
+ */
+gcc_pure
+static TagPoolSlot *
+Find(unsigned hash, TagType type, const char *value, size_t length)
+{
+	if (buckets.empty())
+		return nullptr;
+
+	const size_t mask = GetMask();
+	for (size_t i = hash & mask; buckets[i].slot != nullptr;
+	     i = (i + 1) & mask) {
+		if (buckets[i].hash != hash)
+			continue;
+
+		TagPoolSlot *slot = buckets[i].slot;
 		if (slot->item.type == type &&
 		    length == strlen(slot->item.value) &&
 		    memcmp(value, slot->item.value, length) == 0 &&
-		    slot->ref < 0xff) {
-			assert(slot->ref > 0);
-			++slot->ref;
-			return &slot->item;
+		    slot->GetRef() < ~0u) {
+			assert(slot->GetRef() > 0);
+			return slot;
 		}
 	}
 
-	auto slot = TagPoolSlot::Create(*slot_p, type, value, length);
-	*slot_p = slot;
+	return nullptr;
+}
+
+TagItem *
+tag_pool_get_item(TagType type, const char *value, size_t length)
+{
+	const unsigned hash = calc_hash(type, value, length);
+
+	TagPoolSlot *slot = Find(hash, type, value, length);
+	if (slot != nullptr && slot->TryRef())
+		return &slot->item;
+
+	slot = TagPoolSlot::Create(hash, type, value, length);
+	Insert(slot);
 	return &slot->item;
 }
 
 TagItem *
-tag_pool_dup_item(TagItem *item)
+tag_pool_new_item(TagType type, const char *value, size_t length)
+{
+	auto slot = TagPoolSlot::Create(calc_hash(type, value, length),
+					type, value, length);
+	return &slot->item;
+}
+
+/**
+ * Release a reference while #tag_pool_lock is held.
+ */
+static void
+PutLocked(TagPoolSlot *slot)
+{
+	if (!slot->Unref())
+		return;
+
+	if (slot->listed)
+		Remove(slot);
+	DeleteVarSize(slot);
+}
+
+TagItem *
+tag_pool_intern_item(TagItem *item)
 {
 	TagPoolSlot *slot = tag_item_to_slot(item);
+	assert(slot->GetRef() > 0);
 
-	assert(slot->ref > 0);
+	if (slot->listed)
+		return item;
+
+	TagPoolSlot *found = Find(slot->hash, item->type, item->value,
+				  strlen(item->value));
+	if (found == nullptr) {
+		/* the first one with this value: the item itself
+		   becomes the shared copy, even if other tags still
+		   refer to it */
+		Insert(slot);
+		return item;
+	}
+
+	if (!found->TryRef()) {
+		/* saturated meanwhile by tag_pool_dup_item(); add
+		   this item as another copy */
+		Insert(slot);
+		return item;
+	}
+
+	PutLocked(slot);
+	return &found->item;
+}
+
+TagItem *
+tag_pool_dup_item(TagItem *item)
+{
+	TagPoolSlot *slot = tag_item_to_slot(item);
 
-	if (slot->ref < 0xff) {
-		++slot->ref;
+	if (slot->TryRef())
 		return item;
+
+	/* the reference counter would overflow; duplicate the item,
+	   and start with 1; the copy is not added to the hash table,
+	   because that would require the lock */
+	slot = TagPoolSlot::Create(slot->hash, item->type,
+				   item->value, strlen(item->value));
+	return &slot->item;
+}
+
+unsigned
+tag_pool_hash(TagType type, const char *value, size_t length)
+{
+	return calc_hash(type, value, length);
+}
+
+unsigned
+tag_pool_item_hash(const TagItem &item)
+{
+	const TagPoolSlot *slot =
+		tag_item_to_slot(const_cast<TagItem *>(&item));
+	return slot->hash;
+}
+
+const char *
+tag_pool_get_folded(const TagItem &item)
+{
+	const TagPoolSlot *slot =
+		tag_item_to_slot(const_cast<TagItem *>(&item));
+	return __atomic_load_n(&slot->folded, __ATOMIC_ACQUIRE);
+}
+
+const char *
+tag_pool_set_folded(const TagItem &item, const char *folded, size_t length)
+{
+	TagPoolSlot *slot = tag_item_to_slot(const_cast<TagItem *>(&item));
+	assert(slot->GetRef() > 0);
+
+	char *copy;
+	if (strcmp(folded, item.value) == 0) {
+		/* save memory if folding didn't change anything,
+		   which is the common case */
+		copy = slot->item.value;
 	} else {
-		/* the reference counter overflows above 0xff;
-		   duplicate the item, and start with 1 */
-		size_t length = strlen(item->value);
-		auto slot_p = tag_value_slot_p(item->type,
-					       item->value, length);
-		slot = TagPoolSlot::Create(*slot_p, item->type,
-					   item->value, strlen(item->value));
-		*slot_p = slot;
-		return &slot->item;
+		copy = new char[length + 1];
+		memcpy(copy, folded, length);
+		copy[length] = 0;
 	}
+
+	char *expected = nullptr;
+	if (!__atomic_compare_exchange_n(&slot->folded, &expected, copy,
+					 false,
+					 __ATOMIC_ACQ_REL,
+					 __ATOMIC_ACQUIRE)) {
+		/* another thread was faster */
+		if (copy != slot->item.value)
+			delete[] copy;
+		return expected;
+	}
+
+	return copy;
 }
 
 void
 tag_pool_put_item(TagItem *item)
 {
-	TagPoolSlot **slot_p, *slot;
-
-	slot = tag_item_to_slot(item);
-	assert(slot->ref > 0);
-	--slot->ref;
-
-	if (slot->ref > 0)
+	TagPoolSlot *slot = tag_item_to_slot(item);
+	if (slot->TryUnref())
 		return;
 
-	for (slot_p = tag_value_slot_p(item->type, item->value);
-	     *slot_p != slot;
-	     slot_p = &(*slot_p)->next) {
-		assert(*slot_p != nullptr);
+	/* this is the last reference; nobody else can add one,
+	   except Find() if the slot is listed */
+	if (!slot->listed) {
+		if (slot->Unref())
+			DeleteVarSize(slot);
+		return;
 	}
 
-	*slot_p = slot->next;
-	DeleteVarSize(slot);
+	const ScopeLock protect(tag_pool_lock);
+	PutLocked(slot);
+}
+
+TagPoolStats
+tag_pool_get_stats()
+{
+	const ScopeLock protect(tag_pool_lock);
+	return {num_slots, buckets.size()};
 }
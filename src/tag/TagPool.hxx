@@ -22,18 +22,126 @@
 
 #include "TagType.h"
 #include "thread/Mutex.hxx"
+#include "Compiler.h"
 
+#include <stddef.h>
+
+/**
+ * Protects the pool's hash table.  Adding and releasing references
+ * and the case-folded values don't need it.
+ */
 extern Mutex tag_pool_lock;
 
 struct TagItem;
 
+/**
+ * Look up an item in the pool, or add a new one.
+ *
+ * Caller must lock #tag_pool_lock.
+ */
 TagItem *
 tag_pool_get_item(TagType type, const char *value, size_t length);
 
+/**
+ * Allocate a new item which is not added to the pool's hash table:
+ * it is not shared with other items of the same value, and creating
+ * it does not require locking #tag_pool_lock.  It is reference
+ * counted like other items, and tag_pool_intern_item() can add it to
+ * the pool later.
+ */
+TagItem *
+tag_pool_new_item(TagType type, const char *value, size_t length);
+
+/**
+ * Add a reference to the item.  This function is thread-safe, and
+ * it does not lock #tag_pool_lock; it may be called with or without
+ * holding the lock.
+ *
+ * @return the item, or a new copy of it if its reference counter
+ * would overflow
+ */
 TagItem *
 tag_pool_dup_item(TagItem *item);
 
+/**
+ * If the item was created by tag_pool_new_item(), look up an equal
+ * item in the pool and return it instead, releasing the given
+ * reference; if there is none, the given item is added to the pool.
+ * Items which are in the pool already are returned unmodified.
+ *
+ * Caller must lock #tag_pool_lock.
+ */
+TagItem *
+tag_pool_intern_item(TagItem *item);
+
+/**
+ * Release a reference.  This function is thread-safe.  Releasing the
+ * last reference of an item which is in the hash table locks
+ * #tag_pool_lock, therefore the caller must not hold it.
+ */
 void
 tag_pool_put_item(TagItem *item);
 
+/**
+ * Calculate the hash of a type and a value.  It equals
+ * tag_pool_item_hash() of all items with this type and value.
+ * This function is thread-safe.
+ */
+gcc_pure
+unsigned
+tag_pool_hash(TagType type, const char *value, size_t length);
+
+/**
+ * Returns the hash of the item's type and value, which was
+ * calculated when it was created.  Items with different hashes have
+ * different values (or types), which allows rejecting most
+ * mismatches without comparing the strings.  This function is
+ * thread-safe.
+ */
+gcc_pure
+unsigned
+tag_pool_item_hash(const TagItem &item);
+
+struct TagPoolStats {
+	/**
+	 * The number of distinct items in the pool.
+	 */
+	size_t items;
+
+	/**
+	 * The number of hash table buckets.
+	 */
+	size_t buckets;
+};
+
+/**
+ * Returns statistics about the pool, e.g. for the "stats" command.
+ * This function locks #tag_pool_lock.
+ */
+TagPoolStats
+tag_pool_get_stats();
+
+/**
+ * Returns the case-folded value of the given item which was stored
+ * with tag_pool_set_folded(), or nullptr if there is none yet.  This
+ * function is thread-safe.
+ */
+gcc_pure
+const char *
+tag_pool_get_folded(const TagItem &item);
+
+/**
+ * Store the case-folded value of the given item in the pool, to be
+ * returned by tag_pool_get_folded() until the item is freed.  The
+ * folding itself is up to the caller (see IcuCaseFold()), because
+ * this library doesn't link with ICU.
+ *
+ * This function is thread-safe.  If another thread has stored a
+ * value meanwhile, that one is kept.
+ *
+ * @return the stored copy
+ */
+const char *
+tag_pool_set_folded(const TagItem &item, const char *folded, size_t length);
+
 #endif
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h" /* must be first for large file support */
+#include "TagScanFile.hxx"
+#include "fs/Path.hxx"
+#include "fs/FileSystem.hxx"
+
+#ifndef WIN32
+#include "system/FileDescriptor.hxx"
+#endif
+
+#include <algorithm>
+#include <limits>
+
+#include <string.h>
+#include <sys/stat.h>
+
+constexpr size_t TagScanFile::HEAD_SIZE;
+constexpr size_t TagScanFile::TAIL_SIZE;
+
+inline bool
+TagScanFile::FillHead()
+{
+	if (head_fill < 0) {
+		const size_t length = std::min(uint64_t(HEAD_SIZE), size);
+		const size_t nbytes = ReadRaw(0, head, length);
+		bytes_read += nbytes;
+		head_fill = nbytes;
+	}
+
+	return head_fill > 0;
+}
+
+inline bool
+TagScanFile::FillTail()
+{
+	if (tail_fill < 0) {
+		const size_t length = std::min(uint64_t(TAIL_SIZE), size);
+		const size_t nbytes = ReadRaw(size - length, tail, length);
+		bytes_read += nbytes;
+		tail_fill = nbytes == length ? int(nbytes) : 0;
+	}
+
+	return tail_fill > 0;
+}
+
+bool
+TagScanFile::ReadAt(uint64_t offset, void *dest, size_t length)
+{
+	if (offset > size || length > size - offset)
+		return false;
+
+	if (offset + length <= HEAD_SIZE && FillHead() &&
+	    offset + length <= uint64_t(head_fill)) {
+		memcpy(dest, head + offset, length);
+		return true;
+	}
+
+	const uint64_t tail_offset = size - std::min(uint64_t(TAIL_SIZE), size);
+	if (offset >= tail_offset && FillTail()) {
+		memcpy(dest, tail + (offset - tail_offset), length);
+		return true;
+	}
+
+	const size_t nbytes = ReadRaw(offset, dest, length);
+	bytes_read += nbytes;
+	return nbytes == length;
+}
+
+LocalTagScanFile::LocalTagScanFile(Path path_fs)
+	:file(FOpen(path_fs, PATH_LITERAL("rb")))
+{
+	if (file == nullptr)
+		return;
+
+	/* this class has its own caches */
+	setvbuf(file, nullptr, _IONBF, 0);
+
+	struct stat st;
+	if (fstat(fileno(file), &st) == 0 && st.st_size > 0)
+		SetSize(st.st_size);
+
+#ifndef WIN32
+	/* only a few small parts of the file are read; read-ahead
+	   would just waste disk bandwidth and page cache */
+	FileDescriptor(fileno(file)).AdviseRandom();
+#endif
+}
+
+LocalTagScanFile::~LocalTagScanFile()
+{
+	if (file == nullptr)
+		return;
+
+#ifndef WIN32
+	/* the database update visits each file only once; don't let
+	   it push the files being played out of the page cache */
+	FileDescriptor(fileno(file)).AdviseDontNeed();
+#endif
+
+	fclose(file);
+}
+
+size_t
+LocalTagScanFile::ReadRaw(uint64_t offset, void *dest, size_t length)
+{
+	if (offset > uint64_t(std::numeric_limits<long>::max()) ||
+	    fseek(file, long(offset), SEEK_SET) != 0)
+		return 0;
+
+	return fread(dest, 1, length, file);
+}
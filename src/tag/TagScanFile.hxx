@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** \file
+ *
+ * Random access to a file for the tag scanners, which opens the file
+ * only once for all of them.
+ */
+
+#ifndef MPD_TAG_SCAN_FILE_HXX
+#define MPD_TAG_SCAN_FILE_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+class Path;
+
+/**
+ * A file which is being scanned for tags.  All tag readers (the
+ * container header scanners, ID3, APE) read from one instance, so
+ * the file is opened only once.  The first and the last few
+ * kilobytes, where tags and headers usually are, are read only once
+ * and cached; other ranges are read on demand.
+ *
+ * This base class implements the caches; derived classes implement
+ * the actual I/O.
+ */
+class TagScanFile {
+	static constexpr size_t HEAD_SIZE = 8192;
+	static constexpr size_t TAIL_SIZE = 8192;
+
+	uint64_t size;
+
+	uint64_t bytes_read;
+
+	/**
+	 * The number of valid bytes in #head, or -1 if it has not
+	 * been filled yet.
+	 */
+	int head_fill, tail_fill;
+
+	uint8_t head[HEAD_SIZE], tail[TAIL_SIZE];
+
+protected:
+	TagScanFile()
+		:size(0), bytes_read(0), head_fill(-1), tail_fill(-1) {}
+
+	~TagScanFile() {}
+
+	void SetSize(uint64_t _size) {
+		size = _size;
+	}
+
+	/**
+	 * Read from the underlying file.
+	 *
+	 * @return the number of bytes which were read; less than
+	 * requested on end of file or on error
+	 */
+	virtual size_t ReadRaw(uint64_t offset, void *dest,
+			       size_t length) = 0;
+
+public:
+	TagScanFile(const TagScanFile &) = delete;
+	TagScanFile &operator=(const TagScanFile &) = delete;
+
+	uint64_t GetSize() const {
+		return size;
+	}
+
+	/**
+	 * Returns the number of bytes which were read from the
+	 * underlying file so far.
+	 */
+	uint64_t GetBytesRead() const {
+		return bytes_read;
+	}
+
+	/**
+	 * Read exactly the specified number of bytes at the given
+	 * offset.
+	 *
+	 * @return false on I/O error or if the range exceeds the end
+	 * of the file
+	 */
+	bool ReadAt(uint64_t offset, void *dest, size_t length);
+
+private:
+	bool FillHead();
+	bool FillTail();
+};
+
+/**
+ * A #TagScanFile reading a local file.
+ */
+class LocalTagScanFile final : public TagScanFile {
+	FILE *file;
+
+public:
+	explicit LocalTagScanFile(Path path_fs);
+	~LocalTagScanFile();
+
+	bool IsDefined() const {
+		return file != nullptr;
+	}
+
+protected:
+	/* virtual methods from class TagScanFile */
+	size_t ReadRaw(uint64_t offset, void *dest, size_t length) override;
+};
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "XiphHeader.hxx"
+#include "HeaderReader.hxx"
+#include "TagHandler.hxx"
+#include "TagTable.hxx"
+#include "VorbisComment.hxx"
+#include "util/DivideString.hxx"
+
+#include <memory>
+
+#include <stdint.h>
+
+/**
+ * Comments which are larger than this are skipped.  This is large
+ * enough for all tags MPD knows, but excludes embedded pictures.
+ */
+static constexpr uint32_t MAX_COMMENT_LENGTH = 64 * 1024;
+
+/**
+ * The same as xiph_tags in decoder/plugins/XiphTags.cxx, which is
+ * only built with the Xiph decoder plugins.
+ */
+static constexpr struct tag_table xiph_header_tags[] = {
+	{ "tracknumber", TAG_TRACK },
+	{ "discnumber", TAG_DISC },
+	{ "description", TAG_COMMENT },
+	{ nullptr, TAG_NUM_OF_ITEM_TYPES }
+};
+
+static bool
+xiph_copy_comment(const char *comment, const char *name, TagType type,
+		  const tag_handler &handler, void *handler_ctx)
+{
+	const char *value = vorbis_comment_value(comment, name);
+	if (value == nullptr)
+		return false;
+
+	tag_handler_invoke_tag(&handler, handler_ctx, type, value);
+	return true;
+}
+
+static void
+xiph_scan_comment(const char *comment,
+		  const tag_handler &handler, void *handler_ctx)
+{
+	if (handler.pair != nullptr) {
+		const DivideString split(comment, '=');
+		if (split.IsDefined() && !split.IsEmpty())
+			tag_handler_invoke_pair(&handler, handler_ctx,
+						split.GetFirst(),
+						split.GetSecond());
+	}
+
+	for (const struct tag_table *i = xiph_header_tags;
+	     i->name != nullptr; ++i)
+		if (xiph_copy_comment(comment, i->name, i->type,
+				      handler, handler_ctx))
+			return;
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (xiph_copy_comment(comment, tag_item_names[i], TagType(i),
+				      handler, handler_ctx))
+			return;
+}
+
+bool
+xiph_header_scan_comments(HeaderSource &source,
+			  const tag_handler &handler, void *handler_ctx)
+{
+	uint32_t length;
+	if (!source.ReadLE32(length) || !source.Skip(length))
+		/* no vendor string */
+		return false;
+
+	uint32_t n;
+	if (!source.ReadLE32(n))
+		return false;
+
+	std::unique_ptr<char[]> buffer;
+
+	while (n-- > 0) {
+		if (!source.ReadLE32(length))
+			return false;
+
+		if (length > MAX_COMMENT_LENGTH) {
+			if (!source.Skip(length))
+				return false;
+			continue;
+		}
+
+		if (buffer == nullptr)
+			buffer.reset(new char[MAX_COMMENT_LENGTH + 1]);
+
+		if (!source.Read(buffer.get(), length))
+			return false;
+
+		buffer[length] = 0;
+		xiph_scan_comment(buffer.get(), handler, handler_ctx);
+	}
+
+	return true;
+}
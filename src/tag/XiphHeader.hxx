@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_TAG_XIPH_HEADER_HXX
+#define MPD_TAG_XIPH_HEADER_HXX
+
+#include "check.h"
+
+class HeaderSource;
+struct tag_handler;
+
+/**
+ * Scan a Vorbis comment block (as used by FLAC, Ogg Vorbis and Opus)
+ * from the current position of the #HeaderSource, including the
+ * vendor string.  Very large comments (e.g. embedded pictures) are
+ * skipped.
+ */
+bool
+xiph_header_scan_comments(HeaderSource &source,
+			  const tag_handler &handler, void *handler_ctx);
+
+#endif
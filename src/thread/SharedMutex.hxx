@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2009-2015 Max Kellermann <max@duempel.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef THREAD_SHARED_MUTEX_HXX
+#define THREAD_SHARED_MUTEX_HXX
+
+#ifdef WIN32
+
+#include <windows.h>
+
+/**
+ * A reader-writer lock, implemented with a SRWLOCK.
+ */
+class SharedMutex {
+	SRWLOCK lock_;
+
+public:
+	SharedMutex() {
+		::InitializeSRWLock(&lock_);
+	}
+
+	SharedMutex(const SharedMutex &other) = delete;
+	SharedMutex &operator=(const SharedMutex &other) = delete;
+
+	void lock() {
+		::AcquireSRWLockExclusive(&lock_);
+	}
+
+	bool try_lock() {
+		return ::TryAcquireSRWLockExclusive(&lock_) != 0;
+	}
+
+	void unlock() {
+		::ReleaseSRWLockExclusive(&lock_);
+	}
+
+	void lock_shared() {
+		::AcquireSRWLockShared(&lock_);
+	}
+
+	bool try_lock_shared() {
+		return ::TryAcquireSRWLockShared(&lock_) != 0;
+	}
+
+	void unlock_shared() {
+		::ReleaseSRWLockShared(&lock_);
+	}
+};
+
+#else
+
+#include <pthread.h>
+
+/**
+ * A reader-writer lock, implemented with a pthread_rwlock_t.  Any
+ * number of threads may hold the "shared" lock at the same time, but
+ * only one may hold the exclusive lock.
+ */
+class SharedMutex {
+	pthread_rwlock_t rwlock;
+
+public:
+#if defined(__NetBSD__) || defined(__BIONIC__)
+	SharedMutex() {
+		pthread_rwlock_init(&rwlock, nullptr);
+	}
+
+	~SharedMutex() {
+		pthread_rwlock_destroy(&rwlock);
+	}
+#else
+	constexpr SharedMutex():rwlock(PTHREAD_RWLOCK_INITIALIZER) {}
+#endif
+
+	SharedMutex(const SharedMutex &other) = delete;
+	SharedMutex &operator=(const SharedMutex &other) = delete;
+
+	void lock() {
+		pthread_rwlock_wrlock(&rwlock);
+	}
+
+	bool try_lock() {
+		return pthread_rwlock_trywrlock(&rwlock) == 0;
+	}
+
+	void unlock() {
+		pthread_rwlock_unlock(&rwlock);
+	}
+
+	void lock_shared() {
+		pthread_rwlock_rdlock(&rwlock);
+	}
+
+	bool try_lock_shared() {
+		return pthread_rwlock_tryrdlock(&rwlock) == 0;
+	}
+
+	void unlock_shared() {
+		pthread_rwlock_unlock(&rwlock);
+	}
+};
+
+#endif
+
+#endif
@@ -27,6 +27,9 @@
 #include "LogInit.hxx"
 #include "event/Loop.hxx"
 #include "system/FatalError.hxx"
+#include "system/Trace.hxx"
+#include "TraceFile.hxx"
+#include "util/Error.hxx"
 #include "util/Domain.hxx"
 
 #include <signal.h>
@@ -53,6 +56,16 @@ handle_reload_event(void)
 	cycle_log_files();
 }
 
+static void
+handle_trace_dump_event(void)
+{
+	LogDebug(signal_handlers_domain, "got SIGUSR2, writing trace file");
+
+	Error error;
+	if (!trace_dump(error))
+		LogError(error);
+}
+
 #endif
 
 void
@@ -72,6 +85,9 @@ SignalHandlersInit(EventLoop &loop)
 	SignalMonitorRegister(SIGTERM, HandleShutdownSignal);
 
 	SignalMonitorRegister(SIGHUP, handle_reload_event);
+
+	if (trace_enabled.load(std::memory_order_relaxed))
+		SignalMonitorRegister(SIGUSR2, handle_trace_dump_event);
 #endif
 }
 
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Arena.hxx"
+#include "Alloc.hxx"
+
+#include <stdlib.h>
+
+/**
+ * The space for the #Block header, rounded up to keep the data
+ * aligned.
+ */
+static constexpr size_t HEADER_SIZE = Arena::ALIGNMENT;
+
+void
+Arena::AddBlock(size_t min_size)
+{
+	const size_t data_size = min_size > BLOCK_SIZE - HEADER_SIZE
+		? min_size
+		: BLOCK_SIZE - HEADER_SIZE;
+
+	Block *block = (Block *)xalloc(HEADER_SIZE + data_size);
+	block->next = head;
+	head = block;
+
+	/* the remainder of the previous block is abandoned */
+	position = (char *)block + HEADER_SIZE;
+	remaining = data_size;
+	size += HEADER_SIZE + data_size;
+}
+
+void
+Arena::Splice(Arena &other)
+{
+	if (other.head == nullptr)
+		return;
+
+	if (head == nullptr) {
+		head = other.head;
+		position = other.position;
+		remaining = other.remaining;
+	} else {
+		/* insert the other blocks behind the current one, so
+		   allocations continue there */
+		Block *tail = other.head;
+		while (tail->next != nullptr)
+			tail = tail->next;
+
+		tail->next = head->next;
+		head->next = other.head;
+	}
+
+	size += other.size;
+
+	other.head = nullptr;
+	other.position = nullptr;
+	other.remaining = 0;
+	other.size = 0;
+}
+
+void
+Arena::Clear()
+{
+	while (head != nullptr) {
+		Block *block = head;
+		head = block->next;
+		free(block);
+	}
+
+	position = nullptr;
+	remaining = 0;
+	size = 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ARENA_HXX
+#define MPD_ARENA_HXX
+
+#include "Compiler.h"
+
+#include <stddef.h>
+
+/**
+ * A "bump pointer" allocator: memory is carved sequentially out of
+ * large blocks, and it can only be freed all at once with Clear().
+ * This avoids the per-allocation overhead of malloc() for many small
+ * objects with the same lifetime, and keeps them close to each other.
+ *
+ * Objects allocated here are not destructed automatically; the caller
+ * must call their destructors (if any) before Clear().
+ *
+ * This class is not thread-safe.
+ */
+class Arena {
+	struct Block {
+		Block *next;
+	};
+
+	Block *head = nullptr;
+
+	char *position = nullptr;
+	size_t remaining = 0;
+
+	/**
+	 * The total size of all blocks, see GetSize().
+	 */
+	size_t size = 0;
+
+public:
+	/**
+	 * The size of regular blocks; bigger allocations get a block
+	 * of their own.
+	 */
+	static constexpr size_t BLOCK_SIZE = 256 * 1024;
+
+	/**
+	 * All allocations are aligned to this many bytes.
+	 */
+	static constexpr size_t ALIGNMENT = 16;
+
+	Arena() = default;
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+
+	~Arena() {
+		Clear();
+	}
+
+	/**
+	 * Allocate uninitialized memory.  This method never fails; in
+	 * out-of-memory situations, it aborts the process.
+	 */
+	gcc_malloc
+	void *Allocate(size_t _size) {
+		_size = (_size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+		if (gcc_unlikely(_size > remaining))
+			AddBlock(_size);
+
+		void *p = position;
+		position += _size;
+		remaining -= _size;
+		return p;
+	}
+
+	/**
+	 * Allocate an uninitialized array of a trivially destructible
+	 * type.
+	 */
+	template<typename T>
+	gcc_malloc
+	T *NewArray(size_t n) {
+		return (T *)Allocate(n * sizeof(T));
+	}
+
+	/**
+	 * Free all blocks.
+	 */
+	void Clear();
+
+	/**
+	 * Take over all blocks of the other arena, which becomes
+	 * empty.  Memory allocated from it remains valid, and is
+	 * freed by this object's Clear().
+	 */
+	void Splice(Arena &other);
+
+	/**
+	 * Returns the number of bytes obtained from the system.
+	 */
+	gcc_pure
+	size_t GetSize() const {
+		return size;
+	}
+
+private:
+	void AddBlock(size_t min_size);
+};
+
+#endif
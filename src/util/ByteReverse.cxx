@@ -23,6 +23,183 @@
 
 #include <assert.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#if CLANG_OR_GCC_VERSION(4,9)
+/* like pcm/Simd.cxx, the "target" attribute enables SSSE3 only for
+   the functions which are called after the CPU has been probed */
+#include <immintrin.h>
+#define HAVE_BYTE_REVERSE_SSSE3
+#define BYTE_REVERSE_SSSE3 __attribute__((target("ssse3")))
+#endif
+#endif
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HAVE_BYTE_REVERSE_NEON
+#endif
+
+#ifdef HAVE_BYTE_REVERSE_SSSE3
+
+static bool
+CheckSSSE3()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("ssse3");
+}
+
+/**
+ * The CPU is probed only once, during static initialization.
+ */
+static const bool have_ssse3 = CheckSSSE3();
+
+/**
+ * "pshufb" masks which reverse the bytes of each frame within a
+ * 16 byte vector.  The 24 bit mask reverses 5 frames and leaves the
+ * last byte alone.
+ */
+alignas(16) static const uint8_t reverse_mask_16[16] = {
+	1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+};
+
+alignas(16) static const uint8_t reverse_mask_24[16] = {
+	2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15,
+};
+
+alignas(16) static const uint8_t reverse_mask_32[16] = {
+	3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+};
+
+alignas(16) static const uint8_t reverse_mask_64[16] = {
+	7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+};
+
+/**
+ * Shuffle 16 byte vectors with the given mask, advancing by #step
+ * bytes, as long as a whole vector remains.  With a step smaller than
+ * 16, the surplus bytes are overwritten by the next iteration (or by
+ * the caller).
+ *
+ * @return the number of bytes which were processed
+ */
+BYTE_REVERSE_SSSE3
+static size_t
+ssse3_reverse_bytes(uint8_t *dest, const uint8_t *src, size_t size,
+		    const uint8_t *mask0, size_t step)
+{
+	const __m128i mask = _mm_load_si128((const __m128i *)mask0);
+
+	size_t i = 0;
+	for (; i + 16 <= size; i += step) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dest + i),
+				 _mm_shuffle_epi8(x, mask));
+	}
+
+	return i;
+}
+
+#endif
+
+#ifdef HAVE_BYTE_REVERSE_NEON
+
+/**
+ * Reverse the bytes of each frame in 16 byte vectors, as long as a
+ * whole vector remains.
+ *
+ * @return the number of bytes which were processed
+ */
+template<unsigned frame_size>
+static size_t
+neon_reverse_bytes(uint8_t *dest, const uint8_t *src, size_t size)
+{
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		uint8x16_t x = vld1q_u8(src + i);
+		switch (frame_size) {
+		case 2:
+			x = vrev16q_u8(x);
+			break;
+
+		case 4:
+			x = vrev32q_u8(x);
+			break;
+
+		case 8:
+			x = vrev64q_u8(x);
+			break;
+		}
+
+		vst1q_u8(dest + i, x);
+	}
+
+	return i;
+}
+
+/**
+ * Reverse 3 byte frames in blocks of 16 frames: the structured
+ * load/store instructions deinterleave the bytes, so only the first
+ * and the last "plane" need to be swapped.
+ */
+static size_t
+neon_reverse_bytes_24(uint8_t *dest, const uint8_t *src, size_t size)
+{
+	size_t i = 0;
+	for (; i + 48 <= size; i += 48) {
+		uint8x16x3_t x = vld3q_u8(src + i);
+		const uint8x16_t tmp = x.val[0];
+		x.val[0] = x.val[2];
+		x.val[2] = tmp;
+		vst3q_u8(dest + i, x);
+	}
+
+	return i;
+}
+
+#endif
+
+/**
+ * Run the SIMD implementation (if available) on the largest possible
+ * prefix of the buffer.
+ *
+ * @return the number of bytes which were processed
+ */
+template<unsigned frame_size>
+static size_t
+simd_reverse_bytes(gcc_unused uint8_t *dest, gcc_unused const uint8_t *src,
+		   gcc_unused size_t size)
+{
+#if defined(HAVE_BYTE_REVERSE_SSSE3)
+	if (!have_ssse3)
+		return 0;
+
+	switch (frame_size) {
+	case 2:
+		return ssse3_reverse_bytes(dest, src, size,
+					   reverse_mask_16, 16);
+
+	case 3:
+		return ssse3_reverse_bytes(dest, src, size,
+					   reverse_mask_24, 15);
+
+	case 4:
+		return ssse3_reverse_bytes(dest, src, size,
+					   reverse_mask_32, 16);
+
+	case 8:
+		return ssse3_reverse_bytes(dest, src, size,
+					   reverse_mask_64, 16);
+	}
+
+	return 0;
+#elif defined(HAVE_BYTE_REVERSE_NEON)
+	return frame_size == 3
+		? neon_reverse_bytes_24(dest, src, size)
+		: neon_reverse_bytes<frame_size>(dest, src, size);
+#else
+	return 0;
+#endif
+}
+
 void
 reverse_bytes_16(uint16_t *gcc_restrict dest,
 		 const uint16_t *gcc_restrict src, const uint16_t *src_end)
@@ -31,6 +208,12 @@ reverse_bytes_16(uint16_t *gcc_restrict dest,
 	assert(src != nullptr);
 	assert(src_end >= src);
 
+	const size_t n = simd_reverse_bytes<2>((uint8_t *)dest,
+						(const uint8_t *)src,
+						(src_end - src) * 2) / 2;
+	dest += n;
+	src += n;
+
 	while (src < src_end) {
 		const uint16_t x = *src++;
 		*dest++ = ByteSwap16(x);
@@ -45,6 +228,12 @@ reverse_bytes_32(uint32_t *gcc_restrict dest,
 	assert(src != nullptr);
 	assert(src_end >= src);
 
+	const size_t n = simd_reverse_bytes<4>((uint8_t *)dest,
+						(const uint8_t *)src,
+						(src_end - src) * 4) / 4;
+	dest += n;
+	src += n;
+
 	while (src < src_end) {
 		const uint32_t x = *src++;
 		*dest++ = ByteSwap32(x);
@@ -59,6 +248,12 @@ reverse_bytes_64(uint64_t *gcc_restrict dest,
 	assert(src != nullptr);
 	assert(src_end >= src);
 
+	const size_t n = simd_reverse_bytes<8>((uint8_t *)dest,
+						(const uint8_t *)src,
+						(src_end - src) * 8) / 8;
+	dest += n;
+	src += n;
+
 	while (src < src_end) {
 		const uint64_t x = *src++;
 		*dest++ = ByteSwap64(x);
@@ -93,6 +288,14 @@ reverse_bytes_generic(uint8_t *gcc_restrict dest,
 	}
 }
 
+static void
+reverse_bytes_24(uint8_t *gcc_restrict dest,
+		 const uint8_t *gcc_restrict src, const uint8_t *src_end)
+{
+	const size_t n = simd_reverse_bytes<3>(dest, src, src_end - src);
+	reverse_bytes_generic(dest + n, src + n, src_end, 3);
+}
+
 void
 reverse_bytes(uint8_t *gcc_restrict dest,
 	      const uint8_t *gcc_restrict src, const uint8_t *src_end,
@@ -111,6 +314,10 @@ reverse_bytes(uint8_t *gcc_restrict dest,
 				 (const uint16_t *)src_end);
 		break;
 
+	case 3:
+		reverse_bytes_24(dest, src, src_end);
+		break;
+
 	case 4:
 		reverse_bytes_32((uint32_t *)dest,
 				 (const uint32_t *)src,
@@ -62,6 +62,7 @@ public:
 	using ForeignFifoBuffer<T>::Consume;
 	using ForeignFifoBuffer<T>::Write;
 	using ForeignFifoBuffer<T>::Append;
+	using ForeignFifoBuffer<T>::Shift;
 
 	void Grow(size_type new_capacity) {
 		assert(new_capacity > GetCapacity());
@@ -38,6 +38,17 @@
 
 #ifdef __linux__
 
+/**
+ * Fault in and lock all new allocations?  See HugeSetLocked().
+ */
+static bool huge_locked;
+
+void
+HugeSetLocked(bool locked)
+{
+	huge_locked = locked;
+}
+
 /**
  * Round up the parameter, make it page-aligned.
  */
@@ -46,7 +57,7 @@ static size_t
 AlignToPageSize(size_t size)
 {
 	static const long page_size = sysconf(_SC_PAGESIZE);
-	if (page_size > 0)
+	if (page_size <= 0)
 		return size;
 
 	size_t ps(page_size);
@@ -77,6 +88,19 @@ HugeAllocate(size_t size)
 	madvise(p, size, MADV_DONTFORK);
 #endif
 
+	if (huge_locked) {
+		/* mlock() faults in all pages (as huge pages if
+		   possible, because MADV_HUGEPAGE was applied
+		   already); if RLIMIT_MEMLOCK does not allow it, at
+		   least fault them in now instead of on the audio
+		   path */
+		if (mlock(p, size) < 0) {
+#ifdef MADV_POPULATE_WRITE
+			madvise(p, size, MADV_POPULATE_WRITE);
+#endif
+		}
+	}
+
 	return p;
 }
 
@@ -89,6 +113,11 @@ HugeFree(void *p, size_t size)
 void
 HugeDiscard(void *p, size_t size)
 {
+	if (huge_locked)
+		/* keep the pages; locked pages cannot be discarded
+		   anyway */
+		return;
+
 #ifdef MADV_DONTNEED
 	madvise(p, AlignToPageSize(size), MADV_DONTNEED);
 #endif
@@ -63,6 +63,16 @@ HugeFree(void *p, size_t size);
 void
 HugeDiscard(void *p, size_t size);
 
+/**
+ * Enable or disable the "locked" policy for all future allocations:
+ * memory is faulted in and locked into RAM by HugeAllocate(), and
+ * HugeDiscard() keeps it.  This is meant for the buffers on the
+ * audio path.  Call this during startup, before other threads use
+ * this library.
+ */
+void
+HugeSetLocked(bool locked);
+
 #elif defined(WIN32)
 #include <windows.h>
 
@@ -88,6 +98,11 @@ HugeDiscard(void *p, size_t size)
 	VirtualAlloc(p, size, MEM_RESET, PAGE_NOACCESS);
 }
 
+static inline void
+HugeSetLocked(bool)
+{
+}
+
 #else
 
 /* not Linux: fall back to standard C calls */
@@ -112,6 +127,11 @@ HugeDiscard(void *, size_t)
 {
 }
 
+static inline void
+HugeSetLocked(bool)
+{
+}
+
 #endif
 
 #endif
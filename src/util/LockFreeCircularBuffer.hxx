@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_LOCK_FREE_CIRCULAR_BUFFER_HXX
+#define MPD_LOCK_FREE_CIRCULAR_BUFFER_HXX
+
+#include "WritableBuffer.hxx"
+#include "Compiler.h"
+
+#include <atomic>
+
+#include <assert.h>
+#include <stddef.h>
+
+/**
+ * A circular buffer like #CircularBuffer for exactly one producer
+ * thread and one consumer thread, which need no lock to access it.
+ * The producer calls Write() and Append(), the consumer calls
+ * Read() and Consume(); each side owns one index and only reads the
+ * other one.  The data written before Append() is visible to the
+ * consumer after it has seen the new size.
+ *
+ * Like #CircularBuffer, the last cell cannot be used.
+ */
+template<typename T>
+class LockFreeCircularBuffer {
+public:
+	typedef WritableBuffer<T> Range;
+	typedef typename Range::pointer_type pointer_type;
+	typedef typename Range::size_type size_type;
+
+private:
+	/**
+	 * The next index to be read.  Modified only by the consumer.
+	 */
+	std::atomic<size_type> head;
+
+	/**
+	 * The next index to be written to.  Modified only by the
+	 * producer.
+	 */
+	std::atomic<size_type> tail;
+
+	const size_type capacity;
+	const pointer_type data;
+
+public:
+	LockFreeCircularBuffer(pointer_type _data, size_type _capacity)
+		:head(0), tail(0), capacity(_capacity), data(_data) {}
+
+	LockFreeCircularBuffer(const LockFreeCircularBuffer &other) = delete;
+
+	/**
+	 * Remove all data.  Neither the producer nor the consumer
+	 * may access the buffer at the same time.
+	 */
+	void Clear() {
+		head.store(0, std::memory_order_relaxed);
+		tail.store(0, std::memory_order_relaxed);
+	}
+
+	pointer_type GetData() const {
+		return data;
+	}
+
+	size_type GetCapacity() const {
+		return capacity;
+	}
+
+	/**
+	 * Returns the number of elements stored in this buffer.
+	 * While the other side is active, this is only a snapshot:
+	 * for the consumer, the size may grow meanwhile, and for the
+	 * producer, it may shrink.
+	 */
+	gcc_pure
+	size_type GetSize() const {
+		return Size(head.load(std::memory_order_acquire),
+			    tail.load(std::memory_order_acquire));
+	}
+
+	gcc_pure
+	bool IsEmpty() const {
+		return GetSize() == 0;
+	}
+
+	/**
+	 * Returns the number of elements that can be added to this
+	 * buffer.
+	 */
+	gcc_pure
+	size_type GetSpace() const {
+		return capacity - 1 - GetSize();
+	}
+
+	/**
+	 * Prepares writing (producer only).  Returns a buffer range
+	 * which may be written.  When you are finished, call
+	 * Append().
+	 */
+	Range Write() {
+		const size_type h = head.load(std::memory_order_acquire);
+		const size_type t = tail.load(std::memory_order_relaxed);
+		assert(h < capacity);
+		assert(t < capacity);
+
+		size_type end = t < h
+			? h - 1
+			/* the "head==0" is there so we don't write
+			   the last cell, as this situation cannot be
+			   represented by head/tail */
+			: capacity - (h == 0);
+
+		return Range(data + t, end - t);
+	}
+
+	/**
+	 * Expands the tail of the buffer (producer only), after data
+	 * has been written to the buffer returned by Write().
+	 */
+	void Append(size_type n) {
+		size_type t = tail.load(std::memory_order_relaxed);
+		assert(n < capacity);
+		assert(t + n <= capacity);
+
+		t += n;
+		if (t == capacity)
+			t = 0;
+
+		tail.store(t, std::memory_order_release);
+	}
+
+	/**
+	 * Return a buffer range which may be read (consumer only).
+	 * The buffer pointer is writable, to allow modifications
+	 * while parsing.
+	 */
+	Range Read() {
+		const size_type h = head.load(std::memory_order_relaxed);
+		const size_type t = tail.load(std::memory_order_acquire);
+		assert(h < capacity);
+		assert(t < capacity);
+
+		return Range(data + h, (t < h ? capacity : t) - h);
+	}
+
+	/**
+	 * Marks a chunk as consumed (consumer only).
+	 */
+	void Consume(size_type n) {
+		size_type h = head.load(std::memory_order_relaxed);
+		assert(n < capacity);
+		assert(h + n <= capacity);
+
+		h += n;
+		if (h == capacity)
+			h = 0;
+
+		head.store(h, std::memory_order_release);
+	}
+
+private:
+	size_type Size(size_type h, size_type t) const {
+		return h <= t
+			? t - h
+			: capacity - h + t;
+	}
+};
+
+#endif
@@ -38,6 +38,17 @@ PeakBuffer::IsEmpty() const
 		(peak_buffer == nullptr || peak_buffer->IsEmpty());
 }
 
+size_t
+PeakBuffer::GetSize() const
+{
+	size_t size = 0;
+	if (normal_buffer != nullptr)
+		size += normal_buffer->GetAvailable();
+	if (peak_buffer != nullptr)
+		size += peak_buffer->GetAvailable();
+	return size;
+}
+
 WritableBuffer<void>
 PeakBuffer::Read() const
 {
@@ -132,3 +143,27 @@ PeakBuffer::Append(const void *data, size_t length)
 	nbytes = AppendTo(*peak_buffer, data, length);
 	return nbytes == length;
 }
+
+WritableBuffer<void>
+PeakBuffer::Write()
+{
+	if (peak_buffer != nullptr && !peak_buffer->IsEmpty())
+		return peak_buffer->Write().ToVoid();
+
+	if (normal_buffer == nullptr)
+		normal_buffer = new DynamicFifoBuffer<uint8_t>(normal_size);
+
+	return normal_buffer->Write().ToVoid();
+}
+
+void
+PeakBuffer::Append(size_t length)
+{
+	if (peak_buffer != nullptr && !peak_buffer->IsEmpty()) {
+		peak_buffer->Append(length);
+		return;
+	}
+
+	assert(normal_buffer != nullptr);
+	normal_buffer->Append(length);
+}
@@ -60,12 +60,33 @@ public:
 	gcc_pure
 	bool IsEmpty() const;
 
+	/**
+	 * Returns the number of bytes in both buffers.
+	 */
+	gcc_pure
+	size_t GetSize() const;
+
 	gcc_pure
 	WritableBuffer<void> Read() const;
 
 	void Consume(size_t length);
 
 	bool Append(const void *data, size_t length);
+
+	/**
+	 * Returns the contiguous free space at the end of the buffer
+	 * which receives new data.  Unlike Append(), this does not
+	 * allocate the peak buffer; it may return an empty buffer if
+	 * there is not enough room, and the caller should then fall
+	 * back to Append().
+	 */
+	WritableBuffer<void> Write();
+
+	/**
+	 * Commit data which has been written to the buffer returned by
+	 * Write().
+	 */
+	void Append(size_t length);
 };
 
 #endif
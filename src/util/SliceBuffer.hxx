@@ -107,6 +107,19 @@ public:
 		return n_allocated == n_max;
 	}
 
+	/**
+	 * Returns the position of the specified slice within the
+	 * buffer, a number between 0 and GetCapacity()-1.  This can
+	 * be used to associate external per-slice data.
+	 */
+	gcc_pure
+	unsigned IndexOf(const T *value) const {
+		const Slice *slice = reinterpret_cast<const Slice *>(value);
+		assert(slice >= data && slice < data + n_max);
+
+		return slice - data;
+	}
+
 	template<typename... Args>
 	T *Allocate(Args&&... args) {
 		assert(n_initialized <= n_max);
@@ -132,6 +145,18 @@ public:
 		return ::new((void *)value) T(std::forward<Args>(args)...);
 	}
 
+	/**
+	 * Forget all allocated slices without destructing them, as
+	 * if they had all been freed.  This is only allowed if the
+	 * objects have a trivial state and are not going to be used
+	 * anymore.
+	 */
+	void Abandon() {
+		n_allocated = 0;
+		n_initialized = 0;
+		available = nullptr;
+	}
+
 	void Free(T *value) {
 		assert(n_initialized <= n_max);
 		assert(n_allocated > 0);
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STRING_HASH_HXX
+#define MPD_STRING_HASH_HXX
+
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * A hash function object for null-terminated strings, to be used as
+ * the "Hash" parameter of std::unordered_map with "const char *"
+ * keys.  It implements FNV-1a.
+ */
+struct CStringHash {
+	gcc_pure
+	size_t operator()(const char *p) const {
+		size_t hash = 2166136261u;
+		for (; *p != 0; ++p)
+			hash = (hash ^ (unsigned char)*p) * 16777619u;
+		return hash;
+	}
+};
+
+/**
+ * Compares null-terminated strings; the counterpart of #CStringHash.
+ */
+struct CStringEqual {
+	gcc_pure
+	bool operator()(const char *a, const char *b) const {
+		return strcmp(a, b) == 0;
+	}
+};
+
+#endif
@@ -33,6 +33,8 @@
 
 #include <algorithm>
 
+#include <string.h>
+
 /**
  * Is this a leading byte that is followed by 1 continuation byte?
  */
@@ -123,49 +125,92 @@ MakeContinuation(unsigned char value)
 	return 0x80 | (value & 0x3f);
 }
 
-bool
-ValidateUTF8(const char *p)
+/**
+ * Skip the ASCII prefix of the buffer, checking a whole machine word
+ * per iteration.
+ */
+gcc_pure
+static const char *
+SkipASCII(const char *p, const char *end)
 {
-	for (; *p != 0; ++p) {
-		unsigned char ch = *p;
-		if (IsASCII(ch))
-			continue;
+	typedef size_t word;
+	constexpr word high_bits = word(~word(0)) / 0xff * 0x80;
+
+	while (size_t(end - p) >= sizeof(word)) {
+		word w;
+		memcpy(&w, p, sizeof(w));
+		if (w & high_bits)
+			break;
 
-		if (IsContinuation(ch))
-			/* continuation without a prefix */
+		p += sizeof(w);
+	}
+
+	while (p < end && IsASCII(*p))
+		++p;
+
+	return p;
+}
+
+/**
+ * Are the specified number of bytes (within the buffer) continuation
+ * bytes?
+ */
+gcc_pure
+static bool
+CheckContinuations(const char *p, const char *end, size_t n)
+{
+	if (size_t(end - p) < n)
+		return false;
+
+	for (size_t i = 0; i < n; ++i)
+		if (!IsContinuation(p[i]))
 			return false;
 
-		if (IsLeading1(ch)) {
-			/* 1 continuation */
-			if (!IsContinuation(*++p))
-				return false;
-		} else if (IsLeading2(ch)) {
-			/* 2 continuations */
-			if (!IsContinuation(*++p) || !IsContinuation(*++p))
-				return false;
-		} else if (IsLeading3(ch)) {
-			/* 3 continuations */
-			if (!IsContinuation(*++p) || !IsContinuation(*++p) ||
-			    !IsContinuation(*++p))
-				return false;
-		} else if (IsLeading4(ch)) {
-			/* 4 continuations */
-			if (!IsContinuation(*++p) || !IsContinuation(*++p) ||
-			    !IsContinuation(*++p) || !IsContinuation(*++p))
-				return false;
-		} else if (IsLeading5(ch)) {
-			/* 5 continuations */
-			if (!IsContinuation(*++p) || !IsContinuation(*++p) ||
-			    !IsContinuation(*++p) || !IsContinuation(*++p) ||
-			    !IsContinuation(*++p))
-				return false;
-		} else
+	return true;
+}
+
+bool
+ValidateUTF8(const char *p, size_t length)
+{
+	const char *const end = p + length;
+
+	while ((p = SkipASCII(p, end)) < end) {
+		const unsigned char ch = *p++;
+
+		size_t n;
+		if (IsLeading1(ch))
+			n = 1;
+		else if (IsLeading2(ch))
+			n = 2;
+		else if (IsLeading3(ch))
+			n = 3;
+		else if (IsLeading4(ch))
+			n = 4;
+		else if (IsLeading5(ch))
+			n = 5;
+		else
+			/* continuation without a prefix or some other
+			   illegal start byte */
 			return false;
+
+		if (!CheckContinuations(p, end, n))
+			return false;
+
+		p += n;
 	}
 
 	return true;
 }
 
+bool
+ValidateUTF8(const char *p)
+{
+	/* strlen() is heavily optimized by the C library, and
+	   knowing the end allows checking the ASCII parts word by
+	   word without reading beyond the string */
+	return ValidateUTF8(p, strlen(p));
+}
+
 size_t
 SequenceLengthUTF8(char ch)
 {
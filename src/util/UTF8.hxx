@@ -42,6 +42,14 @@ gcc_pure gcc_nonnull_all
 bool
 ValidateUTF8(const char *p);
 
+/**
+ * Is this a valid UTF-8 string?  Unlike the other overload, this one
+ * does not stop at a null byte.
+ */
+gcc_pure gcc_nonnull_all
+bool
+ValidateUTF8(const char *p, size_t length);
+
 /**
  * @return the number of the sequence beginning with the given
  * character, or 0 if the character is not a valid start byte
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "CountAllocations.hxx"
+
+#include <atomic>
+
+#include <stddef.h>
+#include <errno.h>
+
+static std::atomic_ulong n_allocations;
+
+#ifdef __GLIBC__
+
+/* count all heap allocations, including those of C libraries, by
+   interposing glibc's allocator */
+
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+
+void *
+malloc(size_t size)
+{
+	n_allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t n, size_t size)
+{
+	n_allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_calloc(n, size);
+}
+
+void *
+realloc(void *p, size_t size)
+{
+	n_allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_realloc(p, size);
+}
+
+int
+posix_memalign(void **p, size_t alignment, size_t size)
+{
+	n_allocations.fetch_add(1, std::memory_order_relaxed);
+	*p = __libc_memalign(alignment, size);
+	return *p != nullptr ? 0 : ENOMEM;
+}
+
+}
+
+#endif
+
+unsigned long
+GetAllocationCount()
+{
+	return n_allocations.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TEST_COUNT_ALLOCATIONS_HXX
+#define MPD_TEST_COUNT_ALLOCATIONS_HXX
+
+/**
+ * Returns the number of heap allocations since the program was
+ * started, including those of C libraries.  This counts only on
+ * glibc, which allows interposing its allocator; elsewhere, it
+ * always returns 0.
+ */
+unsigned long
+GetAllocationCount();
+
+#endif
@@ -37,11 +37,14 @@ decoder_initialized(Decoder &decoder,
 	assert(!decoder.initialized);
 	assert(audio_format.IsValid());
 
-	fprintf(stderr, "audio_format=%s duration=%f\n",
-		audio_format_to_string(audio_format, &af_string),
-		duration.ToDoubleS());
+	if (!decoder.quiet)
+		fprintf(stderr, "audio_format=%s duration=%f\n",
+			audio_format_to_string(audio_format, &af_string),
+			duration.ToDoubleS());
 
 	decoder.initialized = true;
+	decoder.audio_format = audio_format;
+	decoder.frame_size = audio_format.GetFrameSize();
 }
 
 DecoderCommand
@@ -86,6 +89,13 @@ decoder_read(gcc_unused Decoder *decoder,
 	return is.LockRead(buffer, length, IgnoreError());
 }
 
+ConstBuffer<void>
+decoder_peek(gcc_unused Decoder *decoder, InputStream &is)
+{
+	const ScopeLock protect(is.mutex);
+	return is.Peek(IgnoreError());
+}
+
 bool
 decoder_read_full(Decoder *decoder, InputStream &is,
 		  void *_buffer, size_t size)
@@ -127,11 +137,15 @@ decoder_timestamp(gcc_unused Decoder &decoder,
 }
 
 DecoderCommand
-decoder_data(gcc_unused Decoder &decoder,
+decoder_data(Decoder &decoder,
 	     gcc_unused InputStream *is,
 	     const void *data, size_t datalen,
 	     gcc_unused uint16_t kbit_rate)
 {
+	decoder.n_bytes += datalen;
+	if (decoder.quiet)
+		return DecoderCommand::NONE;
+
 	static uint16_t prev_kbit_rate;
 	if (kbit_rate != prev_kbit_rate) {
 		prev_kbit_rate = kbit_rate;
@@ -142,11 +156,39 @@ decoder_data(gcc_unused Decoder &decoder,
 	return DecoderCommand::NONE;
 }
 
+WritableBuffer<void>
+decoder_write_begin(Decoder &decoder,
+		    gcc_unused InputStream *is,
+		    gcc_unused uint16_t kbit_rate)
+{
+	assert(decoder.initialized);
+
+	return {decoder.buffer,
+		sizeof(decoder.buffer) / decoder.frame_size * decoder.frame_size};
+}
+
+DecoderCommand
+decoder_write_commit(Decoder &decoder, size_t length)
+{
+	assert(length <= sizeof(decoder.buffer));
+	assert(length % decoder.frame_size == 0);
+
+	decoder.n_bytes += length;
+	if (decoder.quiet)
+		return DecoderCommand::NONE;
+
+	gcc_unused ssize_t nbytes = write(1, decoder.buffer, length);
+	return DecoderCommand::NONE;
+}
+
 DecoderCommand
-decoder_tag(gcc_unused Decoder &decoder,
+decoder_tag(Decoder &decoder,
 	    gcc_unused InputStream *is,
 	    Tag &&tag)
 {
+	if (decoder.quiet)
+		return DecoderCommand::NONE;
+
 	fprintf(stderr, "TAG: duration=%f\n", tag.duration.ToDoubleS());
 
 	for (const auto &i : tag)
@@ -156,9 +198,12 @@ decoder_tag(gcc_unused Decoder &decoder,
 }
 
 void
-decoder_replay_gain(gcc_unused Decoder &decoder,
+decoder_replay_gain(Decoder &decoder,
 		    const ReplayGainInfo *rgi)
 {
+	if (decoder.quiet)
+		return;
+
 	const ReplayGainTuple *tuple = &rgi->tuples[REPLAY_GAIN_ALBUM];
 	if (tuple->IsDefined())
 		fprintf(stderr, "replay_gain[album]: gain=%f peak=%f\n",
@@ -171,8 +216,11 @@ decoder_replay_gain(gcc_unused Decoder &decoder,
 }
 
 void
-decoder_mixramp(gcc_unused Decoder &decoder, gcc_unused MixRampInfo &&mix_ramp)
+decoder_mixramp(Decoder &decoder, gcc_unused MixRampInfo &&mix_ramp)
 {
+	if (decoder.quiet)
+		return;
+
 	fprintf(stderr, "MixRamp: start='%s' end='%s'\n",
 		mix_ramp.GetStart(), mix_ramp.GetEnd());
 }
@@ -23,6 +23,10 @@
 #include "check.h"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
+#include "AudioFormat.hxx"
+
+#include <stddef.h>
+#include <stdint.h>
 
 struct Decoder {
 	Mutex mutex;
@@ -30,8 +34,30 @@ struct Decoder {
 
 	bool initialized;
 
+	/**
+	 * If true, then decoded data is discarded and nothing is
+	 * printed; used by benchmarks.
+	 */
+	bool quiet;
+
+	AudioFormat audio_format;
+
+	size_t frame_size;
+
+	/**
+	 * The number of PCM bytes submitted by the plugin.
+	 */
+	uint64_t n_bytes;
+
+	/**
+	 * The buffer returned by decoder_write_begin().
+	 */
+	uint8_t buffer[4096];
+
 	Decoder()
-		:initialized(false) {}
+		:initialized(false), quiet(false),
+		 audio_format(AudioFormat::Undefined()),
+		 frame_size(1), n_bytes(0) {}
 };
 
 #endif
@@ -21,14 +21,22 @@
 #define MPD_SCOPE_IO_THREAD_HXX
 
 #include "IOThread.hxx"
+#include "event/AsyncResolver.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
 
 struct ScopeIOThread {
 	ScopeIOThread() {
 		io_thread_init();
 		io_thread_start();
+
+		Error error;
+		if (!resolver_global_start(error))
+			LogError(error);
 	}
 
 	~ScopeIOThread() {
+		resolver_global_finish();
 		io_thread_deinit();
 	}
 };
@@ -0,0 +1,113 @@
+/*
+ * Unit tests for class LockFreeCircularBuffer.
+ */
+
+#include "check.h"
+#include "util/LockFreeCircularBuffer.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+#include <thread>
+
+class TestLockFreeCircularBuffer : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TestLockFreeCircularBuffer);
+	CPPUNIT_TEST(TestWrap);
+	CPPUNIT_TEST(TestThreads);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestWrap() {
+		static constexpr size_t N = 8;
+		int data[N];
+		LockFreeCircularBuffer<int> buffer(data, N);
+
+		CPPUNIT_ASSERT_EQUAL(size_t(N), buffer.GetCapacity());
+		CPPUNIT_ASSERT_EQUAL(true, buffer.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(size_t(7), buffer.GetSpace());
+		CPPUNIT_ASSERT_EQUAL(true, buffer.Read().IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(size_t(7), buffer.Write().size);
+
+		/* [OOOOOOOX] */
+		buffer.Append(7);
+		CPPUNIT_ASSERT_EQUAL(size_t(7), buffer.GetSize());
+		CPPUNIT_ASSERT_EQUAL(size_t(0), buffer.GetSpace());
+		CPPUNIT_ASSERT_EQUAL(true, buffer.Write().IsEmpty());
+
+		/* [...XOOOO] */
+		buffer.Consume(4);
+		CPPUNIT_ASSERT_EQUAL(size_t(3), buffer.GetSize());
+		CPPUNIT_ASSERT_EQUAL(&data[4], buffer.Read().data);
+		CPPUNIT_ASSERT_EQUAL(size_t(3), buffer.Read().size);
+		CPPUNIT_ASSERT_EQUAL(&data[7], buffer.Write().data);
+		CPPUNIT_ASSERT_EQUAL(size_t(1), buffer.Write().size);
+
+		/* [..XOOOOO] */
+		buffer.Append(1);
+		CPPUNIT_ASSERT_EQUAL(&data[0], buffer.Write().data);
+		CPPUNIT_ASSERT_EQUAL(size_t(3), buffer.Write().size);
+
+		/* [OOXOOOOO] */
+		buffer.Append(2);
+		CPPUNIT_ASSERT_EQUAL(size_t(6), buffer.GetSize());
+		CPPUNIT_ASSERT_EQUAL(size_t(4), buffer.Read().size);
+
+		/* [OOX.....] */
+		buffer.Consume(4);
+		CPPUNIT_ASSERT_EQUAL(&data[0], buffer.Read().data);
+		CPPUNIT_ASSERT_EQUAL(size_t(2), buffer.Read().size);
+
+		buffer.Consume(2);
+		CPPUNIT_ASSERT_EQUAL(true, buffer.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(size_t(7), buffer.GetSpace());
+	}
+
+	/**
+	 * Transfer a sequence of numbers from one thread to another
+	 * and verify that nothing gets lost or reordered.
+	 */
+	void TestThreads() {
+		static constexpr size_t N = 61;
+		static constexpr unsigned COUNT = 1000000;
+		unsigned data[N];
+		LockFreeCircularBuffer<unsigned> buffer(data, N);
+
+		std::thread producer([&buffer](){
+				unsigned next = 0;
+				while (next < COUNT) {
+					auto w = buffer.Write();
+					if (w.IsEmpty()) {
+						std::this_thread::yield();
+						continue;
+					}
+
+					size_t n = std::min(w.size,
+							    size_t(COUNT - next));
+					for (size_t i = 0; i < n; ++i)
+						w.data[i] = next++;
+					buffer.Append(n);
+				}
+			});
+
+		unsigned expected = 0;
+		bool ok = true;
+		while (expected < COUNT) {
+			auto r = buffer.Read();
+			if (r.IsEmpty()) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			for (size_t i = 0; i < r.size; ++i)
+				if (r.data[i] != expected++)
+					ok = false;
+			buffer.Consume(r.size);
+		}
+
+		producer.join();
+
+		CPPUNIT_ASSERT(ok);
+		CPPUNIT_ASSERT_EQUAL(true, buffer.IsEmpty());
+	}
+};
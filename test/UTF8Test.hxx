@@ -0,0 +1,67 @@
+/*
+ * Unit tests for src/util/
+ */
+
+#include "check.h"
+#include "util/UTF8.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <string.h>
+
+class UTF8Test : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(UTF8Test);
+	CPPUNIT_TEST(TestValid);
+	CPPUNIT_TEST(TestInvalid);
+	CPPUNIT_TEST(TestAlignment);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestValid() {
+		CPPUNIT_ASSERT(ValidateUTF8(""));
+		CPPUNIT_ASSERT(ValidateUTF8("foo/bar.ogg"));
+		CPPUNIT_ASSERT(ValidateUTF8("B\xc3\xa4r"));
+		CPPUNIT_ASSERT(ValidateUTF8("\xe2\x82\xac 5"));
+		CPPUNIT_ASSERT(ValidateUTF8("\xf0\x9f\x8e\xb5"));
+		CPPUNIT_ASSERT(ValidateUTF8("a long ASCII prefix, then B\xc3\xa4r"));
+	}
+
+	void TestInvalid() {
+		/* continuation without a leading byte */
+		CPPUNIT_ASSERT(!ValidateUTF8("\x80"));
+		CPPUNIT_ASSERT(!ValidateUTF8("a long ASCII prefix \xa4"));
+
+		/* truncated sequences */
+		CPPUNIT_ASSERT(!ValidateUTF8("B\xc3"));
+		CPPUNIT_ASSERT(!ValidateUTF8("\xe2\x82"));
+		CPPUNIT_ASSERT(!ValidateUTF8("\xe2\x82x"));
+
+		/* illegal byte */
+		CPPUNIT_ASSERT(!ValidateUTF8("\xff"));
+
+		/* ISO-8859-1 */
+		CPPUNIT_ASSERT(!ValidateUTF8("B\xe4r"));
+
+		/* the length excludes the last continuation */
+		CPPUNIT_ASSERT(!ValidateUTF8("B\xc3\xa4", 2));
+		CPPUNIT_ASSERT(ValidateUTF8("B\xc3\xa4", 3));
+	}
+
+	void TestAlignment() {
+		/* move a multi-byte character and an invalid byte
+		   through all positions of a word */
+		for (size_t i = 0; i < 24; ++i) {
+			std::string s(i, 'x');
+			s += "\xc3\xa4";
+			s.append(24 - i, 'y');
+			CPPUNIT_ASSERT(ValidateUTF8(s.c_str()));
+
+			s[i + 1] = 'z';
+			CPPUNIT_ASSERT(!ValidateUTF8(s.c_str()));
+			CPPUNIT_ASSERT(!ValidateUTF8(s.data(), s.length()));
+		}
+	}
+};
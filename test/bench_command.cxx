@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures how fast a synthetic command list (mostly
+ * "addid" lines, like a playlist import) is tokenized and looked up,
+ * comparing the old binary search over the command names with the
+ * perfect hash from CommandHash.hxx.
+ *
+ */
+
+#include "config.h"
+#include "command/CommandHash.hxx"
+#include "util/Tokenizer.hxx"
+#include "util/Error.hxx"
+#include "util/Macros.hxx"
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the command names from AllCommands.cxx, sorted */
+static const char *const names[] = {
+	"add", "addid", "addtagid", "channels", "clear", "clearerror",
+	"cleartagid", "close", "commands", "compact", "config",
+	"consume", "count", "crossfade", "currentsong", "decoders",
+	"deflate", "delete", "deleteid", "disableoutput",
+	"enableoutput", "find", "findadd", "idle", "kill", "list",
+	"listall", "listallinfo", "listfiles", "listmounts",
+	"listneighbors", "listplaylist", "listplaylistinfo",
+	"listplaylists", "load", "lsinfo", "mixrampdb", "mixrampdelay",
+	"mount", "move", "moveid", "next", "notcommands", "outputs",
+	"password", "pause", "ping", "play", "playid", "playlist",
+	"playlistadd", "playlistclear", "playlistdelete",
+	"playlistfind", "playlistid", "playlistinfo", "playlistmove",
+	"playlistsearch", "plchanges", "plchangesposid", "previous",
+	"prio", "prioid", "random", "rangeid", "readcomments",
+	"readmessages", "rename", "repeat", "replay_gain_mode",
+	"replay_gain_status", "rescan", "rm", "save", "search",
+	"searchadd", "searchaddpl", "seek", "seekcur", "seekid",
+	"sendmessage", "setvol", "shuffle", "single", "stats",
+	"status", "sticker", "stop", "subscribe", "swap", "swapid",
+	"tagtypes", "toggleoutput", "unmount", "unsubscribe", "update",
+	"urlhandlers", "volume",
+};
+
+static constexpr unsigned num_names = ARRAY_SIZE(names);
+
+static uint8_t slots[COMMAND_HASH_SIZE];
+
+typedef std::chrono::steady_clock Clock;
+
+static int
+LookupBinary(const char *name)
+{
+	unsigned a = 0, b = num_names;
+
+	do {
+		const unsigned i = (a + b) / 2;
+		const auto cmp = strcmp(name, names[i]);
+		if (cmp == 0)
+			return i;
+		else if (cmp < 0)
+			b = i;
+		else
+			a = i + 1;
+	} while (a < b);
+
+	return -1;
+}
+
+static int
+LookupHash(const char *name)
+{
+	const unsigned i = slots[command_hash_slot(name)];
+	return i > 0 && strcmp(name, names[i - 1]) == 0
+		? int(i - 1)
+		: -1;
+}
+
+/**
+ * Tokenize all lines (on a copy, because the #Tokenizer modifies its
+ * input) and look up each command name.
+ *
+ * @return million lines per second
+ */
+template<typename F>
+static double
+Measure(const std::vector<std::string> &lines, F lookup)
+{
+	std::vector<std::string> copy(lines);
+	unsigned found = 0, num_args = 0;
+
+	const auto start = Clock::now();
+	for (auto &line : copy) {
+		Error error;
+		Tokenizer tokenizer(&line.front());
+
+		const char *name = tokenizer.NextWord(error);
+		if (name == nullptr || lookup(name) < 0)
+			continue;
+
+		++found;
+		while (tokenizer.NextParam(error) != nullptr)
+			++num_args;
+	}
+	const std::chrono::duration<double> d = Clock::now() - start;
+
+	if (found != lines.size()) {
+		fprintf(stderr, "Lookup failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	return lines.size() / d.count() / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench_command [LINES]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned n = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 100000;
+
+	for (unsigned i = 0; i < num_names; ++i)
+		slots[command_hash_slot(names[i])] = i + 1;
+
+	std::vector<std::string> lines;
+	lines.reserve(n);
+	for (unsigned i = 0; i < n; ++i) {
+		char buffer[256];
+		if (i % 16 == 15)
+			snprintf(buffer, sizeof(buffer), "prioid 10 %u", i);
+		else
+			snprintf(buffer, sizeof(buffer),
+				 "addid \"Artist %u/Album/%02u - Title.flac\"",
+				 i / 100, i % 100);
+		lines.emplace_back(buffer);
+	}
+
+	const double binary = Measure(lines, LookupBinary);
+	const double hash = Measure(lines, LookupHash);
+
+	printf("%-8s %10s  (Mlines/s)\n", "", "lookup");
+	printf("%-8s %10.2f\n", "binary", binary);
+	printf("%-8s %10.2f\n", "hash", hash);
+
+	return EXIT_SUCCESS;
+}
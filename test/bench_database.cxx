@@ -0,0 +1,473 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the "simple" database plugin on a given
+ * database file: loading and saving it, and a set of typical
+ * queries ("find", "search", "list" with a group, "lsinfo" on a deep
+ * directory and GetSong()), with the time, the number of heap
+ * allocations and the peak RSS.  The query values are picked from
+ * the database itself, so the results are reproducible for a given
+ * file.
+ *
+ * The file is copied to a temporary directory first, so it is not
+ * modified by the "save" step.
+ *
+ */
+
+#include "config.h"
+#include "CountAllocations.hxx"
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#include "db/DatabasePlugin.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/Selection.hxx"
+#include "db/LightDirectory.hxx"
+#include "db/LightSong.hxx"
+#include "db/PlaylistVector.hxx"
+#include "config/Block.hxx"
+#include "tag/Tag.hxx"
+#include "SongFilter.hxx"
+#include "event/Loop.hxx"
+#include "util/Error.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#ifdef ENABLE_UPNP
+#include "input/InputStream.hxx"
+size_t
+InputStream::LockRead(void *, size_t, Error &)
+{
+	return 0;
+}
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * Repeat each query until it has run at least this long.
+ */
+static constexpr std::chrono::milliseconds MIN_DURATION(500);
+
+/**
+ * The number of songs looked up by the "GetSong" step.
+ */
+static constexpr unsigned GET_SONG_COUNT = 1000;
+
+class NullDatabaseListener final : public DatabaseListener {
+public:
+	void OnDatabaseModified() override {}
+	void OnDatabaseSongRemoved(const LightSong &) override {}
+};
+
+static long
+PeakRssKiB()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss;
+}
+
+static bool
+CopyFile(const char *src, const char *dest)
+{
+	int in = open(src, O_RDONLY);
+	if (in < 0) {
+		perror(src);
+		return false;
+	}
+
+	int out = open(dest, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+	if (out < 0) {
+		perror(dest);
+		close(in);
+		return false;
+	}
+
+	static char buffer[65536];
+	ssize_t nbytes;
+	bool success = true;
+	while ((nbytes = read(in, buffer, sizeof(buffer))) > 0) {
+		if (write(out, buffer, nbytes) != nbytes) {
+			perror(dest);
+			success = false;
+			break;
+		}
+	}
+
+	if (nbytes < 0) {
+		perror(src);
+		success = false;
+	}
+
+	close(out);
+	close(in);
+	return success;
+}
+
+/**
+ * Run the function once and print the time and the allocations.  It
+ * returns false on error, or else stores the number of results in
+ * the given reference.
+ */
+template<typename F>
+static bool
+MeasureOnce(const char *name, F &&f)
+{
+	const unsigned long allocations0 = GetAllocationCount();
+	const auto start = Clock::now();
+
+	unsigned results = 0;
+	Error error;
+	if (!f(results, error)) {
+		fprintf(stderr, "%s: %s\n", name, error.GetMessage());
+		return false;
+	}
+
+	const std::chrono::duration<double, std::milli> duration =
+		Clock::now() - start;
+	const unsigned long allocations =
+		GetAllocationCount() - allocations0;
+
+	printf("%-24s %10.3f ms %12lu allocs %10u results %8ld KiB\n",
+	       name, duration.count(), allocations, results, PeakRssKiB());
+	return true;
+}
+
+/**
+ * Like MeasureOnce(), but repeat the function for at least
+ * #MIN_DURATION and print the average.
+ */
+template<typename F>
+static bool
+Measure(const char *name, F &&f)
+{
+	const unsigned long allocations0 = GetAllocationCount();
+	const auto start = Clock::now();
+
+	unsigned rounds = 0, results;
+	Clock::duration elapsed;
+	do {
+		results = 0;
+		Error error;
+		if (!f(results, error)) {
+			fprintf(stderr, "%s: %s\n", name, error.GetMessage());
+			return false;
+		}
+
+		++rounds;
+		elapsed = Clock::now() - start;
+	} while (elapsed < MIN_DURATION);
+
+	const std::chrono::duration<double, std::milli> duration = elapsed;
+	const unsigned long allocations =
+		GetAllocationCount() - allocations0;
+
+	printf("%-24s %10.3f ms %12lu allocs %10u results %8ld KiB\n",
+	       name, duration.count() / rounds, allocations / rounds,
+	       results, PeakRssKiB());
+	return true;
+}
+
+/**
+ * Values picked from the database for the queries.
+ */
+struct Samples {
+	std::vector<std::string> uris;
+
+	/**
+	 * The directory with the most slashes in its URI.
+	 */
+	std::string deepest_directory;
+
+	/**
+	 * The most frequent "Artist" value.
+	 */
+	std::string artist;
+};
+
+static bool
+VisitAll(const Database &db, Samples *samples,
+	 unsigned &results, Error &error)
+{
+	std::map<std::string, unsigned> artists;
+	unsigned max_depth = 0;
+
+	const DatabaseSelection selection("", true);
+
+	const auto visit_directory = [samples, &max_depth, &results]
+		(const LightDirectory &directory, Error &) {
+		++results;
+
+		if (samples != nullptr) {
+			const char *uri = directory.GetPath();
+			const unsigned depth = 1 + std::count(uri, uri + strlen(uri),
+							      '/');
+			if (!directory.IsRoot() && depth > max_depth) {
+				max_depth = depth;
+				samples->deepest_directory = uri;
+			}
+		}
+
+		return true;
+	};
+
+	const auto visit_song = [samples, &artists, &results]
+		(const LightSong &song, Error &) {
+		++results;
+
+		if (samples != nullptr) {
+			samples->uris.emplace_back(song.GetURI());
+
+			const char *artist = song.tag->GetValue(TAG_ARTIST);
+			if (artist != nullptr)
+				++artists[artist];
+		}
+
+		return true;
+	};
+
+	const auto visit_playlist = [&results]
+		(const PlaylistInfo &, const LightDirectory &, Error &) {
+		++results;
+		return true;
+	};
+
+	if (!db.Visit(selection, visit_directory, visit_song, visit_playlist,
+		      error))
+		return false;
+
+	if (samples != nullptr) {
+		unsigned max_count = 0;
+		for (const auto &i : artists) {
+			if (i.second > max_count) {
+				max_count = i.second;
+				samples->artist = i.first;
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool
+VisitFilter(const Database &db, const SongFilter &filter,
+	    unsigned &results, Error &error)
+{
+	const DatabaseSelection selection("", true, &filter);
+	return db.Visit(selection, [&results](const LightSong &, Error &){
+			++results;
+			return true;
+		}, error);
+}
+
+static void
+Usage()
+{
+	fprintf(stderr,
+		"Usage: bench_database [-f text|binary] [NAME=VALUE...] FILE\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *path = nullptr;
+	ConfigBlock block;
+
+	for (int i = 1; i < argc; ++i) {
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (strcmp(arg, "-f") == 0 && value != nullptr) {
+			block.AddBlockParam("format", value, -1);
+			++i;
+		} else if (*arg != '-' && strchr(arg, '=') != nullptr) {
+			const char *eq = strchr(arg, '=');
+			block.AddBlockParam(std::string(arg, eq).c_str(),
+					    eq + 1, -1);
+		} else if (*arg != '-' && path == nullptr) {
+			path = arg;
+		} else {
+			Usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (path == nullptr) {
+		Usage();
+		return EXIT_FAILURE;
+	}
+
+	const char *tmpdir = getenv("TMPDIR");
+	std::string directory = tmpdir != nullptr ? tmpdir : "/tmp";
+	directory += "/bench_database.XXXXXX";
+	if (mkdtemp(&directory.front()) == nullptr) {
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+
+	const std::string copy = directory + "/db";
+	if (!CopyFile(path, copy.c_str())) {
+		rmdir(directory.c_str());
+		return EXIT_FAILURE;
+	}
+
+	block.AddBlockParam("path", copy.c_str(), -1);
+
+	EventLoop event_loop;
+	NullDatabaseListener listener;
+
+	Error error;
+	SimpleDatabase *db = (SimpleDatabase *)
+		simple_db_plugin.create(event_loop, listener, block, error);
+	if (db == nullptr) {
+		fprintf(stderr, "%s\n", error.GetMessage());
+		unlink(copy.c_str());
+		rmdir(directory.c_str());
+		return EXIT_FAILURE;
+	}
+
+	if (!MeasureOnce("load", [db](unsigned &, Error &e){
+				return db->Open(e);
+			})) {
+		delete db;
+		unlink(copy.c_str());
+		rmdir(directory.c_str());
+		return EXIT_FAILURE;
+	}
+
+	/* Open() discards a broken file and starts with an empty
+	   database */
+	bool success = db->FileExists();
+	if (!success)
+		fprintf(stderr, "Failed to load %s\n", path);
+
+	Samples samples;
+	success = success &&
+		MeasureOnce("save", [db](unsigned &, Error &e){
+				return db->Save(e);
+			}) &&
+		MeasureOnce("visit all", [db, &samples](unsigned &n, Error &e){
+				return VisitAll(*db, &samples, n, e);
+			});
+
+	if (success && !samples.artist.empty()) {
+		printf("find/search artist: \"%s\"\n", samples.artist.c_str());
+
+		const SongFilter exact(TAG_ARTIST, samples.artist.c_str());
+		success = Measure("find artist", [db, &exact](unsigned &n,
+							      Error &e){
+				return VisitFilter(*db, exact, n, e);
+			});
+
+		/* a prefix of the artist in upper case, to make case
+		   folding significant */
+		std::string prefix = samples.artist.substr(0, 3);
+		for (auto &ch : prefix)
+			if (ch >= 'a' && ch <= 'z')
+				ch -= 'a' - 'A';
+
+		const SongFilter folded(LOCATE_TAG_ANY_TYPE, prefix.c_str(),
+					true);
+		success = success &&
+			Measure("search any", [db, &folded](unsigned &n,
+							    Error &e){
+				return VisitFilter(*db, folded, n, e);
+			});
+	}
+
+	success = success &&
+		Measure("list album group", [db](unsigned &n, Error &e){
+				const DatabaseSelection selection("", true);
+				return db->VisitUniqueTags(selection, TAG_ALBUM,
+							   1u << TAG_ALBUM_ARTIST,
+							   [&n](const Tag &, Error &){
+								   ++n;
+								   return true;
+							   }, e);
+			});
+
+	if (success && !samples.deepest_directory.empty()) {
+		printf("lsinfo: \"%s\"\n", samples.deepest_directory.c_str());
+
+		const DatabaseSelection selection(samples.deepest_directory.c_str(),
+						  false);
+		success = Measure("lsinfo deep", [db, &selection](unsigned &n,
+								  Error &e){
+				return db->Visit(selection,
+						 [&n](const LightDirectory &, Error &){
+							 ++n;
+							 return true;
+						 },
+						 [&n](const LightSong &, Error &){
+							 ++n;
+							 return true;
+						 },
+						 [&n](const PlaylistInfo &,
+						      const LightDirectory &,
+						      Error &){
+							 ++n;
+							 return true;
+						 }, e);
+			});
+	}
+
+	if (success && !samples.uris.empty()) {
+		/* spread the lookups evenly over the database */
+		std::vector<std::string> uris;
+		const size_t n_uris = samples.uris.size();
+		const size_t count = std::min<size_t>(n_uris, GET_SONG_COUNT);
+		for (size_t i = 0; i < count; ++i)
+			uris.push_back(samples.uris[i * n_uris / count]);
+
+		success = Measure("GetSong", [db, &uris](unsigned &n,
+							     Error &e){
+				for (const auto &uri : uris) {
+					const LightSong *song =
+						db->GetSong(uri.c_str(), e);
+					if (song == nullptr)
+						return false;
+
+					db->ReturnSong(song);
+					++n;
+				}
+
+				return true;
+			});
+	}
+
+	db->Close();
+	delete db;
+
+	unlink(copy.c_str());
+	unlink((copy + ".journal").c_str());
+	rmdir(directory.c_str());
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * This program measures the throughput of decoder plugins: it decodes
+ * each file with each enabled plugin which supports its suffix (or
+ * with the plugins specified on the command line), discards the PCM
+ * data and prints the real-time factor, the CPU time per second of
+ * audio, the number of heap allocations and the peak RSS.
+ *
+ */
+
+#include "config.h"
+#include "ScopeIOThread.hxx"
+#include "decoder/DecoderList.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "FakeDecoderAPI.hxx"
+#include "CountAllocations.hxx"
+#include "input/Init.hxx"
+#include "input/InputStream.hxx"
+#include "fs/Path.hxx"
+#include "AudioFormat.hxx"
+#include "util/UriUtil.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+typedef std::chrono::steady_clock Clock;
+
+static double
+CpuSeconds()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+		(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static long
+PeakRssKiB()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss;
+}
+
+static bool
+Decode(const DecoderPlugin &plugin, const char *uri, Decoder &decoder)
+{
+	if (plugin.file_decode != nullptr) {
+		plugin.FileDecode(decoder, Path::FromFS(uri));
+		return true;
+	}
+
+	assert(plugin.stream_decode != nullptr);
+
+	Error error;
+	InputStream *is = InputStream::OpenReady(uri, decoder.mutex,
+						 decoder.cond, error);
+	if (is == nullptr) {
+		if (error.IsDefined())
+			LogError(error);
+		return false;
+	}
+
+	plugin.StreamDecode(decoder, *is);
+	delete is;
+	return true;
+}
+
+static void
+Run(const DecoderPlugin &plugin, const char *uri)
+{
+	Decoder decoder;
+	decoder.quiet = true;
+
+	const unsigned long allocations0 = GetAllocationCount();
+	const double cpu0 = CpuSeconds();
+	const auto start = Clock::now();
+
+	if (!Decode(plugin, uri, decoder))
+		return;
+
+	const std::chrono::duration<double> wall = Clock::now() - start;
+	const double cpu = CpuSeconds() - cpu0;
+	const unsigned long allocations =
+		GetAllocationCount() - allocations0;
+
+	if (!decoder.initialized || decoder.n_bytes == 0) {
+		printf("%-10s %s: decoding failed\n", plugin.name, uri);
+		return;
+	}
+
+	const double audio = decoder.n_bytes /
+		(double(decoder.audio_format.GetFrameSize()) *
+		 decoder.audio_format.sample_rate);
+
+	printf("%-10s %8.1fs %8.1fx %8.2f ms/s %10lu allocs %8ld KiB  %s\n",
+	       plugin.name, audio, audio / wall.count(),
+	       cpu * 1000 / audio, allocations, PeakRssKiB(), uri);
+}
+
+static bool
+IsUsable(const DecoderPlugin &plugin)
+{
+	return plugin.file_decode != nullptr ||
+		plugin.stream_decode != nullptr;
+}
+
+int
+main(int argc, char **argv)
+{
+	std::vector<std::string> names;
+	int i = 1;
+	if (i + 1 < argc && strcmp(argv[i], "-d") == 0) {
+		const char *p = argv[i + 1];
+		while (true) {
+			const char *comma = strchr(p, ',');
+			if (comma == nullptr) {
+				names.emplace_back(p);
+				break;
+			}
+
+			names.emplace_back(p, comma);
+			p = comma + 1;
+		}
+
+		i += 2;
+	}
+
+	if (i >= argc) {
+		fprintf(stderr,
+			"Usage: bench_decoder [-d PLUGIN[,PLUGIN...]] FILE...\n");
+		return EXIT_FAILURE;
+	}
+
+	const ScopeIOThread io_thread;
+
+	Error error;
+	if (!input_stream_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	decoder_plugin_init_all();
+
+	std::vector<const DecoderPlugin *> plugins;
+	for (const auto &name : names) {
+		const DecoderPlugin *plugin =
+			decoder_plugin_from_name(name.c_str());
+		if (plugin == nullptr || !IsUsable(*plugin)) {
+			fprintf(stderr, "No such decoder: %s\n", name.c_str());
+			return EXIT_FAILURE;
+		}
+
+		plugins.push_back(plugin);
+	}
+
+	for (; i < argc; ++i) {
+		const char *uri = argv[i];
+
+		if (!plugins.empty()) {
+			for (const auto *plugin : plugins)
+				Run(*plugin, uri);
+			continue;
+		}
+
+		UriSuffixBuffer suffix_buffer;
+		const char *suffix = uri_get_suffix(uri, suffix_buffer);
+		if (suffix == nullptr) {
+			fprintf(stderr, "No file name suffix: %s\n", uri);
+			continue;
+		}
+
+		decoder_plugins_for_each_enabled([uri, suffix](const DecoderPlugin &plugin){
+				if (IsUsable(plugin) &&
+				    plugin.SupportsSuffix(suffix))
+					Run(plugin, uri);
+			});
+	}
+
+	decoder_plugin_deinit_all();
+	input_stream_global_finish();
+
+	return EXIT_SUCCESS;
+}
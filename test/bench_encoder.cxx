@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures encoder plugins: it encodes a synthetic
+ * signal (or a raw PCM file) with each enabled plugin (or with the
+ * plugins specified on the command line) and prints the real-time
+ * factor, the CPU time per second of audio, the latency of the first
+ * packet (the amount of audio consumed before the plugin produced
+ * any data after the header), the output bit rate and the number of
+ * heap allocations while encoding.
+ *
+ * Plugin settings are passed as NAME=VALUE arguments.
+ *
+ */
+
+#include "config.h"
+#include "CountAllocations.hxx"
+#include "encoder/EncoderList.hxx"
+#include "encoder/EncoderPlugin.hxx"
+#include "encoder/EncoderInterface.hxx"
+#include "AudioFormat.hxx"
+#include "AudioParser.hxx"
+#include "config/Block.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+typedef std::chrono::steady_clock Clock;
+
+static double
+CpuSeconds()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+		(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+template<typename T>
+static void
+GenerateSamples(T *dest, size_t n_frames, const AudioFormat af,
+		double factor)
+{
+	uint32_t seed = 1;
+
+	for (size_t i = 0; i < n_frames; ++i) {
+		for (unsigned c = 0; c < af.channels; ++c) {
+			/* a different tone on each channel plus some
+			   noise, so the encoder has something to
+			   work on */
+			seed = seed * 1103515245 + 12345;
+			const double noise = int32_t(seed) / 2147483648.;
+			const double v = 0.5 * sin(2 * M_PI * 220 * (c + 1) *
+						  i / af.sample_rate) +
+				0.05 * noise;
+			*dest++ = T(v * factor);
+		}
+	}
+}
+
+/**
+ * Generate one second of audio in the specified format.  Returns an
+ * empty buffer if the format is not supported.
+ */
+static std::vector<uint8_t>
+Generate(const AudioFormat af)
+{
+	const size_t n_frames = af.sample_rate;
+	std::vector<uint8_t> buffer(n_frames * af.GetFrameSize());
+	void *p = buffer.data();
+
+	switch (af.format) {
+	case SampleFormat::S8:
+		GenerateSamples((int8_t *)p, n_frames, af, 127);
+		break;
+
+	case SampleFormat::S16:
+		GenerateSamples((int16_t *)p, n_frames, af, 32767);
+		break;
+
+	case SampleFormat::S24_P32:
+		GenerateSamples((int32_t *)p, n_frames, af, 8388607);
+		break;
+
+	case SampleFormat::S32:
+		GenerateSamples((int32_t *)p, n_frames, af, 2147483647.);
+		break;
+
+	case SampleFormat::FLOAT:
+		GenerateSamples((float *)p, n_frames, af, 1);
+		break;
+
+	default:
+		buffer.clear();
+		break;
+	}
+
+	return buffer;
+}
+
+static bool
+LoadFile(const char *path, std::vector<uint8_t> &buffer)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == nullptr) {
+		perror(path);
+		return false;
+	}
+
+	static uint8_t tmp[65536];
+	size_t nbytes;
+	while ((nbytes = fread(tmp, 1, sizeof(tmp), file)) > 0)
+		buffer.insert(buffer.end(), tmp, tmp + nbytes);
+
+	fclose(file);
+	return true;
+}
+
+/**
+ * Read all available data from the encoder and discard it.
+ *
+ * @return the number of bytes
+ */
+static size_t
+Drain(Encoder &encoder)
+{
+	static uint8_t buffer[65536];
+
+	size_t total = 0, nbytes;
+	while ((nbytes = encoder_read(&encoder, buffer, sizeof(buffer))) > 0)
+		total += nbytes;
+
+	return total;
+}
+
+struct Settings {
+	ConfigBlock block;
+	AudioFormat audio_format;
+
+	/**
+	 * The contents of the raw PCM file, or empty if a synthetic
+	 * signal is used.
+	 */
+	std::vector<uint8_t> file;
+
+	double seconds;
+	size_t chunk_size;
+
+	Settings():audio_format(44100, SampleFormat::S16, 2),
+		   seconds(30), chunk_size(4096) {}
+};
+
+static void
+Run(const EncoderPlugin &plugin, const Settings &settings)
+{
+	Error error;
+	Encoder *encoder = encoder_init(plugin, settings.block, error);
+	if (encoder == nullptr) {
+		printf("%-10s %s\n", plugin.name, error.GetMessage());
+		return;
+	}
+
+	AudioFormat af = settings.audio_format;
+	if (!encoder->Open(af, error)) {
+		printf("%-10s %s\n", plugin.name, error.GetMessage());
+		encoder->Dispose();
+		return;
+	}
+
+	struct audio_format_string af_string;
+
+	std::vector<uint8_t> synthetic;
+	const std::vector<uint8_t> *source = &settings.file;
+	uint64_t total;
+	if (settings.file.empty()) {
+		synthetic = Generate(af);
+		source = &synthetic;
+		total = uint64_t(settings.seconds * af.sample_rate) *
+			af.GetFrameSize();
+	} else if (af != settings.audio_format) {
+		/* we can't convert the file */
+		source = &synthetic;
+		total = 0;
+	} else
+		total = settings.file.size() / af.GetFrameSize() *
+			af.GetFrameSize();
+
+	if (source->empty()) {
+		printf("%-10s needs %s\n", plugin.name,
+		       audio_format_to_string(af, &af_string));
+		encoder->Close();
+		encoder->Dispose();
+		return;
+	}
+
+	const size_t frame_size = af.GetFrameSize();
+	const size_t chunk_size =
+		std::max(settings.chunk_size / frame_size, size_t(1)) *
+		frame_size;
+	const double bytes_per_second = double(frame_size) * af.sample_rate;
+
+	/* the header doesn't count */
+	Drain(*encoder);
+
+	const unsigned long allocations0 = GetAllocationCount();
+	const double cpu0 = CpuSeconds();
+	const auto start = Clock::now();
+
+	uint64_t in = 0, out = 0;
+	double latency = -1;
+
+	while (in < total) {
+		const size_t offset = in % source->size();
+		const size_t n = std::min<uint64_t>({chunk_size, total - in,
+					source->size() - offset});
+		if (!encoder_write(encoder, source->data() + offset, n,
+				   error)) {
+			printf("%-10s %s\n", plugin.name, error.GetMessage());
+			break;
+		}
+
+		in += n;
+
+		const size_t nbytes = Drain(*encoder);
+		if (nbytes > 0 && latency < 0)
+			latency = in / bytes_per_second;
+		out += nbytes;
+	}
+
+	if (encoder_end(encoder, error))
+		out += Drain(*encoder);
+	else
+		printf("%-10s %s\n", plugin.name, error.GetMessage());
+
+	const std::chrono::duration<double> wall = Clock::now() - start;
+	const double cpu = CpuSeconds() - cpu0;
+	const unsigned long allocations =
+		GetAllocationCount() - allocations0;
+
+	encoder->Close();
+	encoder->Dispose();
+
+	const double audio = in / bytes_per_second;
+	if (audio <= 0)
+		return;
+
+	if (latency < 0)
+		latency = audio;
+
+	printf("%-10s %-16s %8.1fx %8.2f ms/s %8.1f ms %8.1f kbit/s %10lu allocs\n",
+	       plugin.name, audio_format_to_string(af, &af_string),
+	       audio / wall.count(), cpu * 1000 / audio,
+	       latency * 1000, out * 8 / audio / 1000, allocations);
+}
+
+static void
+Usage()
+{
+	fprintf(stderr,
+		"Usage: bench_encoder [-e PLUGIN[,PLUGIN...]] [-f FORMAT]\n"
+		"                     [-t SECONDS] [-c CHUNK_SIZE]\n"
+		"                     [NAME=VALUE...] [FILE]\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	Settings settings;
+	std::vector<std::string> names;
+	const char *path = nullptr;
+	Error error;
+
+	for (int i = 1; i < argc; ++i) {
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (strcmp(arg, "-e") == 0 && value != nullptr) {
+			const char *p = value;
+			while (true) {
+				const char *comma = strchr(p, ',');
+				if (comma == nullptr) {
+					names.emplace_back(p);
+					break;
+				}
+
+				names.emplace_back(p, comma);
+				p = comma + 1;
+			}
+
+			++i;
+		} else if (strcmp(arg, "-f") == 0 && value != nullptr) {
+			if (!audio_format_parse(settings.audio_format, value,
+						false, error)) {
+				LogError(error, "Failed to parse audio format");
+				return EXIT_FAILURE;
+			}
+
+			++i;
+		} else if (strcmp(arg, "-t") == 0 && value != nullptr) {
+			settings.seconds = atof(value);
+			++i;
+		} else if (strcmp(arg, "-c") == 0 && value != nullptr) {
+			settings.chunk_size = strtoul(value, nullptr, 10);
+			++i;
+		} else if (*arg != '-' && strchr(arg, '=') != nullptr) {
+			const char *eq = strchr(arg, '=');
+			settings.block.AddBlockParam(std::string(arg, eq).c_str(),
+						     eq + 1, -1);
+		} else if (*arg != '-' && path == nullptr) {
+			path = arg;
+		} else {
+			Usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (settings.block.IsEmpty())
+		/* like run_encoder */
+		settings.block.AddBlockParam("quality", "5.0", -1);
+
+	if (path != nullptr && !LoadFile(path, settings.file))
+		return EXIT_FAILURE;
+
+	std::vector<const EncoderPlugin *> plugins;
+	for (const auto &name : names) {
+		const EncoderPlugin *plugin =
+			encoder_plugin_get(name.c_str());
+		if (plugin == nullptr) {
+			fprintf(stderr, "No such encoder: %s\n", name.c_str());
+			return EXIT_FAILURE;
+		}
+
+		plugins.push_back(plugin);
+	}
+
+	if (plugins.empty())
+		encoder_plugins_for_each(plugin)
+			plugins.push_back(plugin);
+
+	for (const auto *plugin : plugins)
+		Run(*plugin, settings);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the throughput of "playlistinfo"-style
+ * response formatting into the client's output buffer, comparing the
+ * old FormatNew() path (which allocates and copies each line) with
+ * formatting in place.
+ *
+ */
+
+#include "config.h"
+#include "util/PeakBuffer.hxx"
+#include "util/FormatString.hxx"
+
+#include <chrono>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef std::chrono::steady_clock Clock;
+
+static void
+FormatAllocated(PeakBuffer &buffer, const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	char *p = FormatNewV(fmt, args);
+	va_end(args);
+
+	buffer.Append(p, strlen(p));
+	delete[] p;
+}
+
+static void
+FormatInPlace(PeakBuffer &buffer, const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+
+	const auto w = buffer.Write();
+	int length = vsnprintf((char *)w.data, w.size, fmt, args);
+	va_end(args);
+
+	if (length >= 0 && size_t(length) < w.size) {
+		buffer.Append(length);
+		return;
+	}
+
+	va_start(args, fmt);
+	char *p = FormatNewV(fmt, args);
+	va_end(args);
+
+	buffer.Append(p, strlen(p));
+	delete[] p;
+}
+
+static void
+PrintPair(PeakBuffer &buffer, const char *name, const char *value)
+{
+	const size_t name_length = strlen(name);
+	const size_t value_length = strlen(value);
+	const size_t length = name_length + 2 + value_length + 1;
+
+	const auto w = buffer.Write();
+	if (w.size >= length) {
+		char *p = (char *)w.data;
+		memcpy(p, name, name_length);
+		p += name_length;
+		*p++ = ':';
+		*p++ = ' ';
+		memcpy(p, value, value_length);
+		p += value_length;
+		*p = '\n';
+		buffer.Append(length);
+	} else {
+		buffer.Append(name, name_length);
+		buffer.Append(": ", 2);
+		buffer.Append(value, value_length);
+		buffer.Append("\n", 1);
+	}
+}
+
+static void
+Drain(PeakBuffer &buffer, size_t &total)
+{
+	while (true) {
+		const auto r = buffer.Read();
+		if (r.IsEmpty())
+			break;
+
+		total += r.size;
+		buffer.Consume(r.size);
+	}
+}
+
+/**
+ * Emit one "playlistinfo" song, flushing the buffer when it gets
+ * full, just like the socket would.
+ */
+template<typename F>
+static double
+Measure(unsigned songs, F f)
+{
+	PeakBuffer buffer(16384, 8 * 1024 * 1024);
+	size_t total = 0;
+
+	const auto start = Clock::now();
+	for (unsigned i = 0; i < songs; ++i) {
+		f(buffer, i);
+
+		/* the socket usually empties the buffer
+		   asynchronously; emulate that every few songs */
+		if (i % 32 == 31)
+			Drain(buffer, total);
+	}
+
+	Drain(buffer, total);
+	const std::chrono::duration<double> d = Clock::now() - start;
+
+	/* songs per second */
+	return songs / d.count();
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench_format [SONGS]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned songs = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 20000;
+
+	const double old_rate = Measure(songs, [](PeakBuffer &b, unsigned i){
+			FormatAllocated(b, "file: %s\n",
+					"Artist/Album/01 - Some Title.flac");
+			FormatAllocated(b, "%s: %s\n", "Artist", "Some Artist");
+			FormatAllocated(b, "%s: %s\n", "Album", "Some Album");
+			FormatAllocated(b, "%s: %s\n", "Title", "Some Title");
+			FormatAllocated(b, "%s: %s\n", "Track", "1");
+			FormatAllocated(b, "%s: %s\n", "Date", "2015");
+			FormatAllocated(b, "%s: %s\n", "Genre", "Rock");
+			FormatAllocated(b, "Time: %i\nduration: %1.3f\n",
+					215, 215.123);
+			FormatAllocated(b, "Pos: %u\nId: %u\n", i, i + 1);
+		});
+
+	const double new_rate = Measure(songs, [](PeakBuffer &b, unsigned i){
+			PrintPair(b, "file",
+				  "Artist/Album/01 - Some Title.flac");
+			PrintPair(b, "Artist", "Some Artist");
+			PrintPair(b, "Album", "Some Album");
+			PrintPair(b, "Title", "Some Title");
+			PrintPair(b, "Track", "1");
+			PrintPair(b, "Date", "2015");
+			PrintPair(b, "Genre", "Rock");
+			FormatInPlace(b, "Time: %i\nduration: %1.3f\n",
+				      215, 215.123);
+			FormatInPlace(b, "Pos: %u\nId: %u\n", i, i + 1);
+		});
+
+	printf("%-10s %12s  (songs/s)\n", "", "playlistinfo");
+	printf("%-10s %12.0f\n", "allocated", old_rate);
+	printf("%-10s %12.0f\n", "in-place", new_rate);
+
+	return EXIT_SUCCESS;
+}
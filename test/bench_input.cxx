@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * This program measures the performance of input streams: for each
+ * URI, it prints the latency of Open() and of becoming ready, the
+ * time to the first byte, the sustained throughput, how often a
+ * Read() call blocked, the latency of random seeks and the number of
+ * read system calls per megabyte.  It is meant for tuning buffer
+ * sizes (with a configuration file) and for catching regressions in
+ * #ThreadInputStream and #AsyncInputStream.
+ *
+ */
+
+#include "config.h"
+#include "ScopeIOThread.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "input/Init.hxx"
+#include "input/InputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "fs/Path.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_ARCHIVE
+#include "archive/ArchiveList.hxx"
+#endif
+
+#include <chrono>
+#include <memory>
+#include <random>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * A Read() call which takes longer than this is counted as a stall,
+ * i.e. the stream's buffer did not keep up.
+ */
+static constexpr std::chrono::milliseconds STALL_THRESHOLD(1);
+
+static size_t block_size = 4096;
+static unsigned n_seeks = 16;
+static unsigned long long limit = 0;
+
+static double
+Milliseconds(Clock::duration d)
+{
+	return std::chrono::duration<double, std::milli>(d).count();
+}
+
+struct IoCounters {
+	unsigned long long syscr = 0, rchar = 0;
+	long nvcsw = 0;
+
+	static IoCounters Now();
+
+	IoCounters operator-(const IoCounters &other) const {
+		IoCounters result;
+		result.syscr = syscr - other.syscr;
+		result.rchar = rchar - other.rchar;
+		result.nvcsw = nvcsw - other.nvcsw;
+		return result;
+	}
+};
+
+IoCounters
+IoCounters::Now()
+{
+	IoCounters c;
+
+#ifdef __linux__
+	/* read system calls and bytes of this process (all
+	   threads) */
+	FILE *file = fopen("/proc/self/io", "r");
+	if (file != nullptr) {
+		char line[128];
+		while (fgets(line, sizeof(line), file) != nullptr) {
+			if (strncmp(line, "syscr: ", 7) == 0)
+				c.syscr = strtoull(line + 7, nullptr, 10);
+			else if (strncmp(line, "rchar: ", 7) == 0)
+				c.rchar = strtoull(line + 7, nullptr, 10);
+		}
+
+		fclose(file);
+	}
+#endif
+
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	c.nvcsw = ru.ru_nvcsw;
+
+	return c;
+}
+
+/**
+ * Measure random seeks, each followed by one Read() call.
+ */
+static void
+BenchSeek(InputStream &is, char *buffer)
+{
+	if (n_seeks == 0 || !is.IsSeekable() || !is.KnownSize() ||
+	    is.GetSize() <= block_size)
+		return;
+
+	std::mt19937_64 rng(42);
+	const offset_type range = is.GetSize() - block_size;
+
+	Clock::duration total = Clock::duration::zero();
+	Clock::duration max = Clock::duration::zero();
+	unsigned n = 0;
+
+	for (unsigned i = 0; i < n_seeks; ++i) {
+		const offset_type offset = rng() % range;
+
+		Error error;
+		const auto start = Clock::now();
+		if (!is.LockSeek(offset, error) ||
+		    is.LockRead(buffer, block_size, error) == 0) {
+			if (error.IsDefined())
+				LogError(error);
+			break;
+		}
+
+		const auto duration = Clock::now() - start;
+		total += duration;
+		if (duration > max)
+			max = duration;
+		++n;
+	}
+
+	if (n > 0)
+		printf("  seek:        %8.2f ms average, %8.2f ms max (%u seeks)\n",
+		       Milliseconds(total) / n, Milliseconds(max), n);
+}
+
+static bool
+Run(const char *uri)
+{
+	printf("%s\n", uri);
+
+	Mutex mutex;
+	Cond cond;
+	Error error;
+
+	const IoCounters counters0 = IoCounters::Now();
+	const auto start = Clock::now();
+
+	std::unique_ptr<InputStream> is(InputStream::Open(uri, mutex, cond,
+							  error));
+	if (is == nullptr) {
+		if (error.IsDefined())
+			LogError(error);
+		else
+			fprintf(stderr, "No plugin for %s\n", uri);
+		return false;
+	}
+
+	const auto opened = Clock::now();
+
+	is->LockWaitReady();
+
+	const auto ready = Clock::now();
+
+	{
+		const ScopeLock protect(mutex);
+		if (!is->Check(error)) {
+			LogError(error);
+			return false;
+		}
+	}
+
+	printf("  open:        %8.2f ms, ready after %.2f ms\n",
+	       Milliseconds(opened - start), Milliseconds(ready - start));
+
+	std::unique_ptr<char[]> buffer(new char[block_size]);
+
+	unsigned long long total = 0;
+	unsigned long reads = 0, stalls = 0;
+	Clock::time_point first_byte;
+
+	while (limit == 0 || total < limit) {
+		const auto read_start = Clock::now();
+		size_t nbytes = is->LockRead(buffer.get(), block_size, error);
+		const auto read_end = Clock::now();
+
+		if (nbytes == 0) {
+			if (error.IsDefined()) {
+				LogError(error);
+				return false;
+			}
+
+			break;
+		}
+
+		if (total == 0)
+			first_byte = read_end;
+		else if (read_end - read_start >= STALL_THRESHOLD)
+			++stalls;
+
+		total += nbytes;
+		++reads;
+	}
+
+	const auto finished = Clock::now();
+	const IoCounters counters = IoCounters::Now() - counters0;
+
+	if (total == 0) {
+		printf("  no data\n");
+		return true;
+	}
+
+	const double seconds =
+		std::chrono::duration<double>(finished - first_byte).count();
+	const double mib = total / (1024. * 1024.);
+
+	printf("  first byte:  %8.2f ms\n",
+	       Milliseconds(first_byte - start));
+	printf("  throughput:  %8.2f MiB/s (%.2f MiB, %lu reads, %lu stalls)\n",
+	       seconds > 0 ? mib / seconds : 0., mib, reads, stalls);
+#ifdef __linux__
+	printf("  syscalls:    %8.1f reads/MiB, %.2f bytes read per byte\n",
+	       counters.syscr / mib, double(counters.rchar) / total);
+#endif
+	printf("  ctx switch:  %8.1f /MiB\n", counters.nvcsw / mib);
+
+	BenchSeek(*is, buffer.get());
+	return true;
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *config_path = nullptr;
+
+	int i = 1;
+	for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+		if (strcmp(argv[i], "-c") == 0)
+			config_path = argv[i + 1];
+		else if (strcmp(argv[i], "-b") == 0)
+			block_size = strtoul(argv[i + 1], nullptr, 10);
+		else if (strcmp(argv[i], "-s") == 0)
+			n_seeks = strtoul(argv[i + 1], nullptr, 10);
+		else if (strcmp(argv[i], "-l") == 0)
+			limit = strtoull(argv[i + 1], nullptr, 10) << 20;
+		else
+			break;
+	}
+
+	if (i >= argc || block_size == 0) {
+		fprintf(stderr,
+			"Usage: bench_input [-c CONFIG] [-b BLOCK_SIZE] [-s SEEKS] [-l LIMIT_MIB] URI...\n");
+		return EXIT_FAILURE;
+	}
+
+	config_global_init();
+
+	Error error;
+	if (config_path != nullptr &&
+	    !ReadConfigFile(Path::FromFS(config_path), error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	const ScopeIOThread io_thread;
+
+#ifdef ENABLE_ARCHIVE
+	archive_plugin_init_all();
+#endif
+
+	if (!input_stream_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	int ret = EXIT_SUCCESS;
+	for (; i < argc; ++i)
+		if (!Run(argv[i]))
+			ret = EXIT_FAILURE;
+
+	input_stream_global_finish();
+
+#ifdef ENABLE_ARCHIVE
+	archive_plugin_deinit_all();
+#endif
+
+	config_global_finish();
+
+	return ret;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * This program measures the throughput of the PCM kernels which have
+ * SIMD implementations, comparing the portable implementation with
+ * the one chosen for this CPU.
+ *
+ */
+
+#include "config.h"
+#include "pcm/Simd.hxx"
+
+#include <chrono>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* one second of 48 kHz stereo */
+static constexpr size_t N = 48000 * 2;
+
+static float fa[N], fb[N];
+static int16_t sa[N], sb[N];
+static int32_t ia[N];
+static uint8_t pa[N * 3];
+
+typedef std::chrono::steady_clock Clock;
+
+template<typename F>
+static double
+Measure(unsigned iterations, F f)
+{
+	const auto start = Clock::now();
+	for (unsigned i = 0; i < iterations; ++i)
+		f();
+	const std::chrono::duration<double> d = Clock::now() - start;
+
+	/* million samples per second */
+	return double(N) * iterations / d.count() / 1e6;
+}
+
+/**
+ * Run one kernel with both implementations and print one line.
+ */
+template<typename F>
+static void
+Run(const char *name, const PcmSimd &best, unsigned iterations, F f)
+{
+	const double portable = Measure(iterations, [&f](){
+			f(pcm_simd_portable);
+		});
+	const double optimized = Measure(iterations, [&f, &best](){
+			f(best);
+		});
+
+	printf("%-14s %12.1f %12.1f\n", name, portable, optimized);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench_pcm [ITERATIONS]\n");
+		return EXIT_FAILURE;
+	}
+
+	const unsigned iterations = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 1000;
+
+	for (size_t i = 0; i < N; ++i) {
+		fa[i] = fb[i] = float(i % 1000) / 1000.f - 0.5f;
+		sa[i] = sb[i] = int16_t(i * 7919);
+		ia[i] = int32_t(i * 7919) & 0x7fffff;
+	}
+
+	const PcmSimd &best = GetPcmSimd();
+	printf("%-14s %12s %12s  (Msamples/s)\n", "",
+	       pcm_simd_portable.name, best.name);
+
+	Run("volume_float", best, iterations, [](const PcmSimd &simd){
+			simd.volume_float(fa, fb, N, 0.5f);
+		});
+	Run("add_vol_float", best, iterations, [](const PcmSimd &simd){
+			simd.add_volume_float(fa, fb, N, 0.5f, 0.5f);
+		});
+	Run("add_float", best, iterations, [](const PcmSimd &simd){
+			simd.add_float(fa, fb, N);
+		});
+	Run("add_16", best, iterations, [](const PcmSimd &simd){
+			simd.add_16(sa, sb, N);
+		});
+	Run("float_to_16", best, iterations, [](const PcmSimd &simd){
+			simd.float_to_16(sa, fb, N);
+		});
+	Run("float_to_24", best, iterations, [](const PcmSimd &simd){
+			simd.float_to_24(ia, fb, N);
+		});
+	Run("float_to_32", best, iterations, [](const PcmSimd &simd){
+			simd.float_to_32(ia, fb, N);
+		});
+	Run("s16_to_float", best, iterations, [](const PcmSimd &simd){
+			simd.s16_to_float(fa, sb, N);
+		});
+	Run("s24_to_float", best, iterations, [](const PcmSimd &simd){
+			simd.s24_to_float(fa, ia, N);
+		});
+	Run("s32_to_float", best, iterations, [](const PcmSimd &simd){
+			simd.s32_to_float(fa, ia, N);
+		});
+	Run("pack_24", best, iterations, [](const PcmSimd &simd){
+			simd.pack_24(pa, ia, N);
+		});
+	Run("unpack_24", best, iterations, [](const PcmSimd &simd){
+			simd.unpack_24(ia, pa, N);
+		});
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the throughput of the PCM library's
+ * high-level code paths (PcmConvert, PcmExport, PcmVolume, pcm_mix,
+ * PcmDither) with each SIMD implementation supported by this CPU.
+ *
+ * The output is CSV, one line per implementation and path, to be
+ * compared across releases:
+ *
+ *  simd,path,frames_per_second,cycles_per_sample
+ *
+ * The cycle count is measured with the x86 time stamp counter (which
+ * may run at a different frequency than the core); the column is
+ * empty on other CPUs.
+ *
+ */
+
+#include "config.h"
+#include "pcm/Simd.hxx"
+#include "pcm/PcmConvert.hxx"
+#include "pcm/PcmExport.hxx"
+#include "pcm/PcmMix.hxx"
+#include "pcm/PcmDither.hxx"
+#include "pcm/Volume.hxx"
+#include "AudioFormat.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+
+#include <chrono>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+/* the number of frames passed to each call, roughly one chunk */
+static constexpr size_t BLOCK_FRAMES = 1024;
+
+static constexpr size_t MAX_SAMPLES = BLOCK_FRAMES * MAX_CHANNELS;
+
+static int32_t int_input[MAX_SAMPLES];
+static float float_input[MAX_SAMPLES];
+static int32_t output_buffer[MAX_SAMPLES];
+
+static unsigned iterations;
+static const char *simd_name;
+
+static void
+FillInput()
+{
+	for (size_t i = 0; i < MAX_SAMPLES; ++i) {
+		/* within the 24 bit range, so the same data is valid
+		   for all integer formats */
+		int_input[i] = int32_t((i * 7919) & 0xffffff) - 0x800000;
+		float_input[i] = float(i % 1000) / 1000.f - 0.5f;
+	}
+}
+
+static const void *
+GetInput(SampleFormat format)
+{
+	return format == SampleFormat::FLOAT
+		? (const void *)float_input
+		: (const void *)int_input;
+}
+
+static void
+Fail(const char *path, const Error &error)
+{
+	fprintf(stderr, "%s: %s\n", path, error.GetMessage());
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * Call the function #iterations times (after one warm-up call which
+ * allocates buffers) and print one line.
+ *
+ * @param channels the number of samples per frame
+ */
+template<typename F>
+static void
+Run(const char *path, unsigned channels, F f)
+{
+	f();
+
+	const auto start = Clock::now();
+#ifdef HAVE_RDTSC
+	const uint64_t start_cycles = __rdtsc();
+#endif
+
+	for (unsigned i = 0; i < iterations; ++i)
+		f();
+
+#ifdef HAVE_RDTSC
+	const uint64_t cycles = __rdtsc() - start_cycles;
+#endif
+	const std::chrono::duration<double> d = Clock::now() - start;
+
+	const double frames = double(BLOCK_FRAMES) * iterations;
+	printf("%s,%s,%.0f,", simd_name, path, frames / d.count());
+#ifdef HAVE_RDTSC
+	printf("%.3f\n", cycles / (frames * channels));
+#else
+	printf("\n");
+#endif
+}
+
+static void
+RunConvert(const char *path, AudioFormat src, AudioFormat dest)
+{
+	Error error;
+	PcmConvert convert;
+	if (!convert.Open(src, dest, error))
+		Fail(path, error);
+
+	const ConstBuffer<void> in(GetInput(src.format),
+				   BLOCK_FRAMES * src.GetFrameSize());
+
+	Run(path, src.channels, [&convert, &in, path](){
+			Error error2;
+			if (convert.Convert(in, error2).IsNull())
+				Fail(path, error2);
+		});
+
+	convert.Close();
+}
+
+static void
+RunExport(const char *path, AudioFormat format,
+	  bool dop, bool shift8, bool pack, bool reverse_endian)
+{
+	PcmExport e;
+	e.Open(format.format, format.channels, dop, shift8, pack,
+	       reverse_endian);
+
+	const ConstBuffer<void> in(GetInput(format.format),
+				   BLOCK_FRAMES * format.GetFrameSize());
+
+	Run(path, format.channels, [&e, &in](){
+			e.Export(in);
+		});
+}
+
+static void
+RunVolume(const char *path, SampleFormat format)
+{
+	Error error;
+	PcmVolume pv;
+	if (!pv.Open(format, error))
+		Fail(path, error);
+
+	pv.SetVolume(PCM_VOLUME_1 / 2);
+
+	const ConstBuffer<void> in(GetInput(format),
+				   BLOCK_FRAMES * 2 * sample_format_size(format));
+
+	Run(path, 2, [&pv, &in](){
+			pv.Apply(in, output_buffer);
+		});
+
+	pv.Close();
+}
+
+static void
+RunMix(const char *path, SampleFormat format, float portion1)
+{
+	const size_t size = BLOCK_FRAMES * 2 * sample_format_size(format);
+	memcpy(output_buffer, GetInput(format), size);
+
+	PcmDither dither;
+	Run(path, 2, [&dither, format, size, portion1, path](){
+			if (!pcm_mix(dither, output_buffer, GetInput(format),
+				     size, format, portion1)) {
+				fprintf(stderr, "%s: not supported\n", path);
+				exit(EXIT_FAILURE);
+			}
+		});
+}
+
+static void
+RunAll()
+{
+	/* format conversion */
+	RunConvert("convert/s16_to_float",
+		   AudioFormat(44100, SampleFormat::S16, 2),
+		   AudioFormat(44100, SampleFormat::FLOAT, 2));
+	RunConvert("convert/s32_to_float",
+		   AudioFormat(44100, SampleFormat::S32, 2),
+		   AudioFormat(44100, SampleFormat::FLOAT, 2));
+	RunConvert("convert/float_to_s16",
+		   AudioFormat(44100, SampleFormat::FLOAT, 2),
+		   AudioFormat(44100, SampleFormat::S16, 2));
+	RunConvert("convert/float_to_s24",
+		   AudioFormat(44100, SampleFormat::FLOAT, 2),
+		   AudioFormat(44100, SampleFormat::S24_P32, 2));
+	RunConvert("convert/float_to_s32",
+		   AudioFormat(44100, SampleFormat::FLOAT, 2),
+		   AudioFormat(44100, SampleFormat::S32, 2));
+
+	/* channel conversion */
+	RunConvert("channels/s16_1_to_2",
+		   AudioFormat(44100, SampleFormat::S16, 1),
+		   AudioFormat(44100, SampleFormat::S16, 2));
+	RunConvert("channels/s16_2_to_1",
+		   AudioFormat(44100, SampleFormat::S16, 2),
+		   AudioFormat(44100, SampleFormat::S16, 1));
+	RunConvert("channels/float_2_to_1",
+		   AudioFormat(44100, SampleFormat::FLOAT, 2),
+		   AudioFormat(44100, SampleFormat::FLOAT, 1));
+	RunConvert("channels/s32_6_to_2",
+		   AudioFormat(44100, SampleFormat::S32, 6),
+		   AudioFormat(44100, SampleFormat::S32, 2));
+
+	/* resampling (with the default resampler) */
+	RunConvert("resample/s16_44100_to_48000",
+		   AudioFormat(44100, SampleFormat::S16, 2),
+		   AudioFormat(48000, SampleFormat::S16, 2));
+	RunConvert("resample/float_96000_to_44100",
+		   AudioFormat(96000, SampleFormat::FLOAT, 2),
+		   AudioFormat(44100, SampleFormat::FLOAT, 2));
+
+#ifdef ENABLE_DSD
+	/* DSD64 */
+	RunConvert("dsd/dsd_to_float",
+		   AudioFormat(352800, SampleFormat::DSD, 2),
+		   AudioFormat(352800, SampleFormat::FLOAT, 2));
+	RunExport("export/dop",
+		  AudioFormat(352800, SampleFormat::DSD, 2),
+		  true, false, false, false);
+#endif
+
+	RunExport("export/pack24",
+		  AudioFormat(44100, SampleFormat::S24_P32, 2),
+		  false, false, true, false);
+	RunExport("export/pack24_reverse",
+		  AudioFormat(44100, SampleFormat::S24_P32, 2),
+		  false, false, true, true);
+	RunExport("export/shift8",
+		  AudioFormat(44100, SampleFormat::S24_P32, 2),
+		  false, true, false, false);
+	RunExport("export/s16_reverse",
+		  AudioFormat(44100, SampleFormat::S16, 2),
+		  false, false, false, true);
+	RunExport("export/s32_reverse",
+		  AudioFormat(44100, SampleFormat::S32, 2),
+		  false, false, false, true);
+
+	RunVolume("volume/s16", SampleFormat::S16);
+	RunVolume("volume/s24", SampleFormat::S24_P32);
+	RunVolume("volume/s32", SampleFormat::S32);
+	RunVolume("volume/float", SampleFormat::FLOAT);
+
+	RunMix("mix/s16", SampleFormat::S16, 0.3f);
+	RunMix("mix/s24", SampleFormat::S24_P32, 0.3f);
+	RunMix("mix/s32", SampleFormat::S32, 0.3f);
+	RunMix("mix/float", SampleFormat::FLOAT, 0.3f);
+	RunMix("mix/s16_add", SampleFormat::S16, -1);
+	RunMix("mix/float_add", SampleFormat::FLOAT, -1);
+
+
+	/* PcmDither is used by the integer to 16 bit conversions */
+	RunConvert("dither/s24_to_s16",
+		   AudioFormat(44100, SampleFormat::S24_P32, 2),
+		   AudioFormat(44100, SampleFormat::S16, 2));
+	RunConvert("dither/s32_to_s16",
+		   AudioFormat(44100, SampleFormat::S32, 2),
+		   AudioFormat(44100, SampleFormat::S16, 2));
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench_pcm_pipeline [ITERATIONS]\n");
+		return EXIT_FAILURE;
+	}
+
+	iterations = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 2000;
+
+	FillInput();
+
+	printf("simd,path,frames_per_second,cycles_per_sample\n");
+
+	for (auto i = GetSupportedPcmSimd(); *i != nullptr; ++i) {
+		SetPcmSimd(**i);
+		simd_name = (*i)->name;
+		RunAll();
+	}
+
+	return EXIT_SUCCESS;
+}
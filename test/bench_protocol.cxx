@@ -0,0 +1,686 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program puts load on a running MPD instance: many simulated
+ * clients send a weighted mix of commands over TCP or a local
+ * socket, each waiting for the response before sending the next
+ * request.  It reports the throughput and latency percentiles per
+ * command and the CPU time used by the server.
+ *
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <netdb.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+typedef std::chrono::steady_clock Clock;
+
+struct Command {
+	std::string name;
+
+	/**
+	 * The request sent to the server, including the newline.
+	 */
+	std::string request;
+
+	unsigned weight;
+};
+
+struct Settings {
+	const char *address = "localhost";
+	const char *password = nullptr;
+	const char *find = "find \"genre\" \"Rock\"";
+	const char *mix =
+		"status=60,idle=20,playlistinfo=10,find=8,listallinfo=2";
+	unsigned clients = 16;
+	unsigned idle_clients = 0;
+	double seconds = 10;
+	long server_pid = -1;
+};
+
+/**
+ * The results of one simulated client.
+ */
+struct ClientResult {
+	/**
+	 * Response times in microseconds, one vector per #Command.
+	 */
+	std::vector<std::vector<float>> latencies;
+
+	/**
+	 * The number of "ACK" responses per #Command.
+	 */
+	std::vector<unsigned> acks;
+
+	unsigned long long bytes = 0;
+
+	/**
+	 * Was the connection lost before the end?
+	 */
+	bool failed = false;
+};
+
+static std::atomic_bool stop;
+
+static double
+CpuSeconds()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+		(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+/**
+ * Returns the CPU time (user and system) consumed by the specified
+ * process so far, or a negative value if it is unknown.
+ */
+static double
+ProcessCpuSeconds(long pid)
+{
+#ifdef __linux__
+	if (pid <= 0)
+		return -1;
+
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%ld/stat", pid);
+
+	FILE *file = fopen(path, "r");
+	if (file == nullptr)
+		return -1;
+
+	char buffer[1024];
+	size_t length = fread(buffer, 1, sizeof(buffer) - 1, file);
+	fclose(file);
+	buffer[length] = 0;
+
+	/* the process name may contain spaces; skip to its end and
+	   then to field 14 (utime) */
+	const char *p = strrchr(buffer, ')');
+	if (p == nullptr)
+		return -1;
+
+	unsigned long utime, stime;
+	if (sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+		   &utime, &stime) != 2)
+		return -1;
+
+	return double(utime + stime) / sysconf(_SC_CLK_TCK);
+#else
+	(void)pid;
+	return -1;
+#endif
+}
+
+/**
+ * Connect to "HOST[:PORT]" or to a local socket (an absolute path or
+ * "@NAME" for an abstract socket).
+ */
+static int
+Connect(const char *address)
+{
+	if (*address == '/' || *address == '@') {
+		sockaddr_un sun;
+		memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+
+		const size_t length = strlen(address);
+		if (length >= sizeof(sun.sun_path)) {
+			fprintf(stderr, "Socket path too long: %s\n", address);
+			return -1;
+		}
+
+		memcpy(sun.sun_path, address, length);
+		socklen_t size = offsetof(sockaddr_un, sun_path) + length;
+		if (*address == '@')
+			sun.sun_path[0] = 0;
+		else
+			++size;
+
+		int fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+		if (fd < 0) {
+			perror("socket");
+			return -1;
+		}
+
+		if (connect(fd, (const sockaddr *)&sun, size) < 0) {
+			fprintf(stderr, "Failed to connect to %s: %s\n",
+				address, strerror(errno));
+			close(fd);
+			return -1;
+		}
+
+		return fd;
+	}
+
+	std::string host = address;
+	std::string port = "6600";
+	const char *colon = strrchr(address, ':');
+	if (colon != nullptr && strchr(address, ':') == colon) {
+		host.assign(address, colon);
+		port = colon + 1;
+	} else if (*address == '[' && colon != nullptr && colon[-1] == ']') {
+		host.assign(address + 1, colon - 1);
+		port = colon + 1;
+	}
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	addrinfo *ai;
+	int result = getaddrinfo(host.c_str(), port.c_str(), &hints, &ai);
+	if (result != 0) {
+		fprintf(stderr, "Failed to resolve %s: %s\n",
+			address, gai_strerror(result));
+		return -1;
+	}
+
+	int fd = -1;
+	for (const addrinfo *i = ai; i != nullptr; i = i->ai_next) {
+		fd = socket(i->ai_family, i->ai_socktype|SOCK_CLOEXEC,
+			    i->ai_protocol);
+		if (fd < 0)
+			continue;
+
+		if (connect(fd, i->ai_addr, i->ai_addrlen) == 0)
+			break;
+
+		close(fd);
+		fd = -1;
+	}
+
+	if (fd < 0)
+		fprintf(stderr, "Failed to connect to %s: %s\n",
+			address, strerror(errno));
+
+	freeaddrinfo(ai);
+	return fd;
+}
+
+/**
+ * Reads responses from a connection, looking only at the beginning of
+ * each line; long responses are never stored completely.
+ */
+class ResponseReader {
+	const int fd;
+
+	char buffer[65536];
+	size_t start = 0, end = 0;
+
+	/**
+	 * Has the previous line been cut off because it did not fit
+	 * into the buffer?
+	 */
+	bool in_line = false;
+
+public:
+	unsigned long long bytes = 0;
+
+	explicit ResponseReader(int _fd):fd(_fd) {}
+
+	/**
+	 * Read the next line.  Lines longer than the buffer are
+	 * truncated.
+	 *
+	 * @return the null-terminated line without the newline, or
+	 * nullptr on error
+	 */
+	const char *ReadLine() {
+		while (true) {
+			char *line = buffer + start;
+			char *newline = (char *)memchr(line, '\n', end - start);
+			if (newline != nullptr) {
+				*newline = 0;
+				start = newline + 1 - buffer;
+
+				if (in_line) {
+					/* the rest of a long line */
+					in_line = false;
+					continue;
+				}
+
+				return line;
+			}
+
+			if (start > 0) {
+				memmove(buffer, buffer + start, end - start);
+				end -= start;
+				start = 0;
+			}
+
+			if (end == sizeof(buffer)) {
+				/* discard the middle of a very long
+				   line, but keep its beginning unless
+				   it has been seen already */
+				if (in_line) {
+					end = 0;
+				} else {
+					in_line = true;
+					buffer[64] = 0;
+					end = 0;
+					return buffer;
+				}
+			}
+
+			ssize_t nbytes = read(fd, buffer + end,
+					      sizeof(buffer) - end);
+			if (nbytes <= 0)
+				return nullptr;
+
+			end += nbytes;
+			bytes += nbytes;
+		}
+	}
+
+	/**
+	 * Skip the response to one command.
+	 *
+	 * @return 1 for "OK", 0 for "ACK", -1 on error
+	 */
+	int ReadResponse() {
+		while (true) {
+			const char *line = ReadLine();
+			if (line == nullptr)
+				return -1;
+
+			if (strcmp(line, "OK") == 0)
+				return 1;
+
+			if (memcmp(line, "ACK ", 4) == 0)
+				return 0;
+		}
+	}
+};
+
+static bool
+WriteFull(int fd, const std::string &s)
+{
+	const char *p = s.data();
+	size_t length = s.length();
+	while (length > 0) {
+		ssize_t nbytes = write(fd, p, length);
+		if (nbytes <= 0)
+			return false;
+
+		p += nbytes;
+		length -= nbytes;
+	}
+
+	return true;
+}
+
+/**
+ * Open a connection, check the greeting and log in.
+ */
+static int
+OpenClient(const Settings &settings)
+{
+	int fd = Connect(settings.address);
+	if (fd < 0)
+		return -1;
+
+	ResponseReader reader(fd);
+	const char *greeting = reader.ReadLine();
+	if (greeting == nullptr || memcmp(greeting, "OK MPD ", 7) != 0) {
+		fprintf(stderr, "Not a MPD server: %s\n", settings.address);
+		close(fd);
+		return -1;
+	}
+
+	if (settings.password != nullptr) {
+		std::string request = "password \"";
+		request += settings.password;
+		request += "\"\n";
+
+		if (!WriteFull(fd, request) || reader.ReadResponse() != 1) {
+			fprintf(stderr, "Wrong password\n");
+			close(fd);
+			return -1;
+		}
+	}
+
+	return fd;
+}
+
+static void
+RunClient(int fd, unsigned seed, const std::vector<Command> &commands,
+	  ClientResult &result)
+{
+	result.latencies.resize(commands.size());
+	result.acks.resize(commands.size());
+
+	unsigned total_weight = 0;
+	for (const auto &c : commands)
+		total_weight += c.weight;
+
+	std::mt19937 rng(seed);
+	ResponseReader reader(fd);
+
+	while (!stop.load(std::memory_order_relaxed)) {
+		unsigned r = rng() % total_weight;
+		unsigned i = 0;
+		while (r >= commands[i].weight)
+			r -= commands[i++].weight;
+
+		const auto start = Clock::now();
+
+		if (!WriteFull(fd, commands[i].request)) {
+			result.failed = true;
+			break;
+		}
+
+		const int response = reader.ReadResponse();
+		if (response < 0) {
+			result.failed = true;
+			break;
+		}
+
+		const std::chrono::duration<float, std::micro> duration =
+			Clock::now() - start;
+		result.latencies[i].push_back(duration.count());
+		if (response == 0)
+			++result.acks[i];
+	}
+
+	result.bytes = reader.bytes;
+}
+
+/**
+ * A connection which waits in "idle" all the time, like an idle
+ * client GUI.  It resends "idle" after each event and returns when
+ * the socket is shut down.
+ */
+static void
+RunIdleClient(int fd)
+{
+	static const std::string request = "idle\n";
+
+	ResponseReader reader(fd);
+	while (WriteFull(fd, request) && reader.ReadResponse() >= 0) {}
+}
+
+/**
+ * Parse "NAME=WEIGHT,...".  The built-in names "idle" and "find" are
+ * expanded; any other name is sent literally.
+ */
+static bool
+ParseMix(const Settings &settings, std::vector<Command> &commands)
+{
+	const char *p = settings.mix;
+	while (*p != 0) {
+		const char *comma = strchr(p, ',');
+		if (comma == nullptr)
+			comma = p + strlen(p);
+
+		const char *eq = (const char *)memchr(p, '=', comma - p);
+		if (eq == nullptr || eq == p) {
+			fprintf(stderr, "Malformed mix: %s\n", settings.mix);
+			return false;
+		}
+
+		Command c;
+		c.name.assign(p, eq);
+		c.weight = strtoul(eq + 1, nullptr, 10);
+
+		if (c.name == "idle")
+			/* a round trip through the idle machinery;
+			   "noidle" is ignored if "idle" has already
+			   returned, so there is exactly one response */
+			c.request = "idle\nnoidle\n";
+		else if (c.name == "find")
+			c.request = std::string(settings.find) + "\n";
+		else
+			c.request = c.name + "\n";
+
+		if (c.weight > 0)
+			commands.push_back(std::move(c));
+
+		p = *comma == ',' ? comma + 1 : comma;
+	}
+
+	if (commands.empty()) {
+		fprintf(stderr, "Empty mix\n");
+		return false;
+	}
+
+	return true;
+}
+
+static float
+Percentile(const std::vector<float> &sorted, double p)
+{
+	size_t i = std::min(sorted.size() - 1, size_t(p * sorted.size()));
+	return sorted[i];
+}
+
+static void
+PrintRow(const char *name, std::vector<float> &latencies, unsigned acks,
+	 double seconds)
+{
+	if (latencies.empty()) {
+		printf("%-14s %9u\n", name, 0u);
+		return;
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+
+	printf("%-14s %9zu %10.1f %8.3f %8.3f %8.3f %8.3f %6u\n",
+	       name, latencies.size(), latencies.size() / seconds,
+	       Percentile(latencies, 0.5) / 1000,
+	       Percentile(latencies, 0.9) / 1000,
+	       Percentile(latencies, 0.99) / 1000,
+	       latencies.back() / 1000, acks);
+}
+
+static void
+Usage()
+{
+	fprintf(stderr,
+		"Usage: bench_protocol [-c CLIENTS] [-i IDLE_CLIENTS] [-t SECONDS]\n"
+		"                      [-m NAME=WEIGHT[,NAME=WEIGHT...]] [-q FIND]\n"
+		"                      [-a PASSWORD] [-p SERVER_PID]\n"
+		"                      [HOST[:PORT]|/PATH|@NAME]\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	Settings settings;
+
+	for (int i = 1; i < argc; ++i) {
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (strcmp(arg, "-c") == 0 && value != nullptr) {
+			settings.clients = strtoul(value, nullptr, 10);
+			++i;
+		} else if (strcmp(arg, "-i") == 0 && value != nullptr) {
+			settings.idle_clients = strtoul(value, nullptr, 10);
+			++i;
+		} else if (strcmp(arg, "-t") == 0 && value != nullptr) {
+			settings.seconds = atof(value);
+			++i;
+		} else if (strcmp(arg, "-m") == 0 && value != nullptr) {
+			settings.mix = value;
+			++i;
+		} else if (strcmp(arg, "-q") == 0 && value != nullptr) {
+			settings.find = value;
+			++i;
+		} else if (strcmp(arg, "-a") == 0 && value != nullptr) {
+			settings.password = value;
+			++i;
+		} else if (strcmp(arg, "-p") == 0 && value != nullptr) {
+			settings.server_pid = strtol(value, nullptr, 10);
+			++i;
+		} else if (*arg != '-') {
+			settings.address = arg;
+		} else {
+			Usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (settings.clients == 0 || settings.seconds <= 0) {
+		Usage();
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Command> commands;
+	if (!ParseMix(settings, commands))
+		return EXIT_FAILURE;
+
+	signal(SIGPIPE, SIG_IGN);
+
+	/* connect all clients before starting the clock */
+	std::vector<int> fds, idle_fds;
+	for (unsigned i = 0; i < settings.clients; ++i) {
+		int fd = OpenClient(settings);
+		if (fd < 0)
+			return EXIT_FAILURE;
+		fds.push_back(fd);
+	}
+
+	for (unsigned i = 0; i < settings.idle_clients; ++i) {
+		int fd = OpenClient(settings);
+		if (fd < 0)
+			return EXIT_FAILURE;
+		idle_fds.push_back(fd);
+	}
+
+#ifdef SO_PEERCRED
+	if (settings.server_pid < 0 &&
+	    (*settings.address == '/' || *settings.address == '@')) {
+		/* a local server: ask the kernel for its pid */
+		struct ucred cred;
+		socklen_t length = sizeof(cred);
+		if (getsockopt(fds.front(), SOL_SOCKET, SO_PEERCRED,
+			       &cred, &length) == 0)
+			settings.server_pid = cred.pid;
+	}
+#endif
+
+	printf("%u clients, %u idle, %.1f seconds\n",
+	       settings.clients, settings.idle_clients, settings.seconds);
+
+	std::vector<ClientResult> results(settings.clients);
+	std::vector<std::thread> threads;
+
+	const double server_cpu_start =
+		ProcessCpuSeconds(settings.server_pid);
+	const double client_cpu_start = CpuSeconds();
+	const auto start = Clock::now();
+
+	for (int fd : idle_fds)
+		threads.emplace_back(RunIdleClient, fd);
+
+	for (unsigned i = 0; i < settings.clients; ++i)
+		threads.emplace_back(RunClient, fds[i], i + 1,
+				     std::cref(commands), std::ref(results[i]));
+
+	std::this_thread::sleep_for(std::chrono::duration<double>(settings.seconds));
+	stop = true;
+
+	/* wake up the idle connections */
+	for (int fd : idle_fds)
+		shutdown(fd, SHUT_RDWR);
+
+	for (auto &t : threads)
+		t.join();
+
+	const std::chrono::duration<double> duration = Clock::now() - start;
+	const double seconds = duration.count();
+	const double client_cpu = CpuSeconds() - client_cpu_start;
+	const double server_cpu_end = ProcessCpuSeconds(settings.server_pid);
+
+	for (int fd : fds)
+		close(fd);
+	for (int fd : idle_fds)
+		close(fd);
+
+	printf("%-14s %9s %10s %8s %8s %8s %8s %6s\n",
+	       "command", "requests", "req/s", "p50 ms", "p90 ms",
+	       "p99 ms", "max ms", "ACK");
+
+	std::vector<float> all;
+	unsigned all_acks = 0, failed = 0;
+	unsigned long long bytes = 0;
+
+	for (size_t c = 0; c < commands.size(); ++c) {
+		std::vector<float> latencies;
+		unsigned acks = 0;
+		for (auto &r : results) {
+			latencies.insert(latencies.end(),
+					 r.latencies[c].begin(),
+					 r.latencies[c].end());
+			acks += r.acks[c];
+		}
+
+		all.insert(all.end(), latencies.begin(), latencies.end());
+		all_acks += acks;
+
+		PrintRow(commands[c].name.c_str(), latencies, acks, seconds);
+	}
+
+	PrintRow("total", all, all_acks, seconds);
+
+	for (const auto &r : results) {
+		bytes += r.bytes;
+		if (r.failed)
+			++failed;
+	}
+
+	printf("received %.1f MB (%.1f MB/s)\n",
+	       bytes / 1e6, bytes / 1e6 / seconds);
+	printf("client CPU %.1f%%\n", 100 * client_cpu / seconds);
+
+	if (server_cpu_start >= 0 && server_cpu_end >= 0)
+		printf("server CPU %.1f%% (pid %ld)\n",
+		       100 * (server_cpu_end - server_cpu_start) / seconds,
+		       settings.server_pid);
+	else
+		printf("server CPU unknown (use -p PID)\n");
+
+	if (failed > 0) {
+		fprintf(stderr, "%u connections failed\n", failed);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures queue edits and "plchanges" lookups in a
+ * large queue in random mode: the per-item scan which "plchanges"
+ * used to do, compared with Queue::FindNewerPosition().  It also
+ * measures shuffling appended songs into their priority group and
+ * changing priorities.
+ *
+ */
+
+#include "config.h"
+#include "queue/Queue.hxx"
+#include "DetachedSong.hxx"
+#include "Compiler.h"
+
+#include <chrono>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef std::chrono::steady_clock Clock;
+
+static constexpr unsigned QUEUE_LENGTH = 200000;
+static constexpr unsigned ROUNDS = 1000;
+
+Tag::Tag(const Tag &) {}
+void Tag::Clear() {}
+
+static double
+Microseconds(Clock::duration d, unsigned n)
+{
+	return std::chrono::duration<double, std::micro>(d).count() / n;
+}
+
+/**
+ * The old "plchanges" implementation: check every item.
+ */
+static unsigned
+ScanChanges(const Queue &queue, uint32_t version)
+{
+	unsigned n = 0;
+	for (unsigned i = 0; i < queue.GetLength(); ++i)
+		if (queue.IsNewerAtPosition(i, version))
+			++n;
+	return n;
+}
+
+static unsigned
+FindChanges(const Queue &queue, uint32_t version)
+{
+	unsigned n = 0;
+	for (unsigned i = queue.FindNewerPosition(0, version);
+	     i < queue.GetLength();
+	     i = queue.FindNewerPosition(i + 1, version))
+		++n;
+	return n;
+}
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	Queue queue(QUEUE_LENGTH);
+	queue.random = true;
+
+	for (unsigned i = 0; i < QUEUE_LENGTH; ++i)
+		queue.Append(DetachedSong("foo.ogg"), 0);
+	queue.ShuffleOrder();
+	queue.IncrementVersion();
+
+	auto start = Clock::now();
+	for (unsigned i = 0; i < ROUNDS; ++i) {
+		/* move one song by one position, like a client
+		   dragging an entry */
+		queue.MoveRange(1000 + i, 1001 + i, 1001 + i);
+		queue.IncrementVersion();
+	}
+	printf("move:            %8.2f us\n",
+	       Microseconds(Clock::now() - start, ROUNDS));
+
+	start = Clock::now();
+	for (unsigned i = 0; i < ROUNDS; ++i) {
+		queue.DeletePosition(QUEUE_LENGTH - 1000 - i);
+		queue.IncrementVersion();
+	}
+	printf("delete:          %8.2f us\n",
+	       Microseconds(Clock::now() - start, ROUNDS));
+
+	/* append songs with mixed priorities in random mode, like
+	   playlist::AppendSong() */
+	start = Clock::now();
+	for (unsigned i = 0; i < ROUNDS; ++i) {
+		queue.Append(DetachedSong("bar.ogg"), i % 3);
+		queue.ShuffleOrderLastWithPriority(1, queue.GetLength());
+		queue.IncrementVersion();
+	}
+	printf("append shuffle:  %8.2f us\n",
+	       Microseconds(Clock::now() - start, ROUNDS));
+
+	start = Clock::now();
+	for (unsigned i = 0; i < ROUNDS; ++i) {
+		queue.SetPriority(i * 150, (i % 7) * 10, 0);
+		queue.IncrementVersion();
+	}
+	printf("priority:        %8.2f us\n",
+	       Microseconds(Clock::now() - start, ROUNDS));
+
+	/* a client which has seen all but the last edit */
+	const uint32_t version = queue.version - 1;
+
+	unsigned scanned = 0;
+	start = Clock::now();
+	for (unsigned i = 0; i < 10; ++i)
+		scanned = ScanChanges(queue, version);
+	printf("plchanges scan:  %8.2f us (%u changes)\n",
+	       Microseconds(Clock::now() - start, 10), scanned);
+
+	unsigned found = 0;
+	start = Clock::now();
+	for (unsigned i = 0; i < ROUNDS; ++i)
+		found = FindChanges(queue, version);
+	printf("plchanges find:  %8.2f us (%u changes)\n",
+	       Microseconds(Clock::now() - start, ROUNDS), found);
+
+	return scanned == found ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the request throughput of many concurrent
+ * #FullyBufferedSocket connections, comparing level-triggered and
+ * edge-triggered mode.  Each request is a line; the server answers
+ * it with a fixed-size response.
+ *
+ */
+
+#include "config.h"
+#include "event/Loop.hxx"
+#include "event/FullyBufferedSocket.hxx"
+#include "event/Call.hxx"
+#include "util/Error.hxx"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+typedef std::chrono::steady_clock Clock;
+
+static constexpr unsigned NUM_CONNECTIONS = 512;
+static constexpr unsigned NUM_ROUNDS = 200;
+static constexpr unsigned PIPELINE = 4;
+static constexpr size_t RESPONSE_SIZE = 16384;
+
+static char response[RESPONSE_SIZE];
+
+class EchoSocket final : FullyBufferedSocket {
+public:
+	unsigned long dispatches = 0;
+
+	EchoSocket(int fd, EventLoop &loop, bool edge_triggered)
+		:FullyBufferedSocket(fd, loop, 262144, 0, edge_triggered) {}
+
+	using FullyBufferedSocket::Close;
+
+protected:
+	InputResult OnSocketInput(void *data, size_t length) override {
+		const char *p = (const char *)data;
+		size_t consumed = 0;
+
+		const char *newline;
+		while ((newline = (const char *)
+			memchr(p + consumed, '\n', length - consumed)) != nullptr) {
+			consumed = newline + 1 - p;
+			if (!Write(response, sizeof(response)))
+				return InputResult::CLOSED;
+		}
+
+		ConsumeInput(consumed);
+		return InputResult::MORE;
+	}
+
+	void OnSocketError(Error &&error) override {
+		fprintf(stderr, "%s\n", error.GetMessage());
+		abort();
+	}
+
+	void OnSocketClosed() override {
+		abort();
+	}
+
+	bool OnSocketReady(unsigned flags) override {
+		++dispatches;
+		return FullyBufferedSocket::OnSocketReady(flags);
+	}
+};
+
+static void
+ReadResponses(const std::vector<int> &fds)
+{
+	std::vector<size_t> remaining(fds.size(),
+				      PIPELINE * RESPONSE_SIZE);
+	std::vector<pollfd> pfds(fds.size());
+	for (size_t i = 0; i < fds.size(); ++i) {
+		pfds[i].fd = fds[i];
+		pfds[i].events = POLLIN;
+	}
+
+	size_t pending = fds.size();
+	static char buffer[65536];
+	while (pending > 0) {
+		if (poll(pfds.data(), pfds.size(), -1) < 0) {
+			perror("poll");
+			exit(EXIT_FAILURE);
+		}
+
+		for (size_t i = 0; i < pfds.size(); ++i) {
+			if (!(pfds[i].revents & POLLIN))
+				continue;
+
+			ssize_t nbytes = read(fds[i], buffer, sizeof(buffer));
+			if (nbytes <= 0) {
+				perror("read");
+				exit(EXIT_FAILURE);
+			}
+
+			remaining[i] -= nbytes;
+			if (remaining[i] == 0) {
+				pfds[i].fd = -1;
+				--pending;
+			}
+		}
+	}
+}
+
+static void
+Run(bool edge_triggered)
+{
+	EventLoop loop;
+
+	std::vector<EchoSocket *> servers;
+	std::vector<int> clients;
+	for (unsigned i = 0; i < NUM_CONNECTIONS; ++i) {
+		int sv[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM|SOCK_NONBLOCK, 0, sv) < 0) {
+			perror("socketpair");
+			exit(EXIT_FAILURE);
+		}
+
+		/* the driver side uses blocking I/O */
+		fcntl(sv[1], F_SETFL, fcntl(sv[1], F_GETFL) & ~O_NONBLOCK);
+
+		servers.push_back(new EchoSocket(sv[0], loop, edge_triggered));
+		clients.push_back(sv[1]);
+	}
+
+	std::thread thread([&loop](){ loop.Run(); });
+
+	static constexpr char request[] = "ping\n";
+	char requests[PIPELINE * (sizeof(request) - 1)];
+	for (unsigned i = 0; i < PIPELINE; ++i)
+		memcpy(requests + i * (sizeof(request) - 1), request,
+		       sizeof(request) - 1);
+
+	const auto start = Clock::now();
+
+	for (unsigned round = 0; round < NUM_ROUNDS; ++round) {
+		for (int fd : clients)
+			if (write(fd, requests, sizeof(requests)) < 0) {
+				perror("write");
+				exit(EXIT_FAILURE);
+			}
+
+		ReadResponses(clients);
+	}
+
+	const std::chrono::duration<double> duration =
+		Clock::now() - start;
+
+	unsigned long dispatches = 0;
+	BlockingCall(loop, [&servers, &dispatches](){
+			for (auto *s : servers) {
+				dispatches += s->dispatches;
+				s->Close();
+				delete s;
+			}
+		});
+
+	loop.Break();
+	thread.join();
+
+	for (int fd : clients)
+		close(fd);
+
+	const unsigned long n = (unsigned long)NUM_CONNECTIONS *
+		NUM_ROUNDS * PIPELINE;
+	printf("%-16s %8.0f requests/s, %.2f dispatches per request\n",
+	       edge_triggered ? "edge-triggered" : "level-triggered",
+	       n / duration.count(), double(dispatches) / n);
+}
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	memset(response, 'x', sizeof(response) - 1);
+	response[sizeof(response) - 1] = '\n';
+
+	printf("%u connections, %u rounds of %u requests, %u byte responses\n",
+	       NUM_CONNECTIONS, NUM_ROUNDS, PIPELINE,
+	       unsigned(RESPONSE_SIZE));
+
+	Run(false);
+	Run(true);
+
+	return EXIT_SUCCESS;
+}
@@ -66,6 +66,7 @@ static const struct tag_handler print_handler = {
 	print_duration,
 	print_tag,
 	print_pair,
+	nullptr,
 };
 
 int main(int argc, char **argv)
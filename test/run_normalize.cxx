@@ -24,7 +24,7 @@
  */
 
 #include "config.h"
-#include "AudioCompress/compress.h"
+#include "pcm/Normalizer.hxx"
 #include "AudioParser.hxx"
 #include "AudioFormat.hxx"
 #include "util/Error.hxx"
@@ -37,7 +37,6 @@
 
 int main(int argc, char **argv)
 {
-	struct Compressor *compressor;
 	static char buffer[4096];
 	ssize_t nbytes;
 
@@ -56,14 +55,17 @@ int main(int argc, char **argv)
 		}
 	}
 
-	compressor = Compressor_new(0);
+	if (!PcmNormalizer::IsSupported(audio_format.format)) {
+		fprintf(stderr, "Sample format not supported\n");
+		return 1;
+	}
+
+	PcmNormalizer normalizer;
+	normalizer.Open(audio_format.format);
 
 	while ((nbytes = read(0, buffer, sizeof(buffer))) > 0) {
-		Compressor_Process_int16(compressor,
-					 (int16_t *)buffer, nbytes / 2);
+		normalizer.Process(buffer, nbytes);
 
 		gcc_unused ssize_t ignored = write(1, buffer, nbytes);
 	}
-
-	Compressor_delete(compressor);
 }
@@ -0,0 +1,153 @@
+/*
+ * Unit tests for class Arena and for Tag objects whose item arrays
+ * are allocated from it.
+ */
+
+#include "config.h"
+#include "util/Arena.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+class ArenaTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(ArenaTest);
+	CPPUNIT_TEST(TestAlignment);
+	CPPUNIT_TEST(TestLarge);
+	CPPUNIT_TEST(TestClear);
+	CPPUNIT_TEST(TestSplice);
+	CPPUNIT_TEST(TestForeignTag);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestAlignment() {
+		Arena arena;
+
+		char *previous = nullptr;
+		for (size_t i = 1; i < 1000; ++i) {
+			char *p = (char *)arena.Allocate(i % 37 + 1);
+			CPPUNIT_ASSERT_EQUAL(size_t(0),
+					     size_t((uintptr_t)p % Arena::ALIGNMENT));
+			CPPUNIT_ASSERT(p != previous);
+
+			/* the memory must be writable */
+			memset(p, 0xaa, i % 37 + 1);
+			previous = p;
+		}
+
+		CPPUNIT_ASSERT_EQUAL(Arena::BLOCK_SIZE, arena.GetSize());
+	}
+
+	void TestLarge() {
+		Arena arena;
+
+		arena.Allocate(100);
+		char *p = (char *)arena.Allocate(Arena::BLOCK_SIZE * 2);
+		memset(p, 0, Arena::BLOCK_SIZE * 2);
+		CPPUNIT_ASSERT(arena.GetSize() > Arena::BLOCK_SIZE * 2);
+
+		int *a = arena.NewArray<int>(1000);
+		for (unsigned i = 0; i < 1000; ++i)
+			a[i] = i;
+		CPPUNIT_ASSERT_EQUAL(999, a[999]);
+	}
+
+	void TestClear() {
+		Arena arena;
+		CPPUNIT_ASSERT_EQUAL(size_t(0), arena.GetSize());
+
+		for (unsigned i = 0; i < 100000; ++i)
+			arena.Allocate(48);
+		CPPUNIT_ASSERT(arena.GetSize() >= 100000 * 48);
+
+		arena.Clear();
+		CPPUNIT_ASSERT_EQUAL(size_t(0), arena.GetSize());
+
+		/* the arena is usable again */
+		arena.Allocate(16);
+		CPPUNIT_ASSERT_EQUAL(Arena::BLOCK_SIZE, arena.GetSize());
+	}
+
+	void TestSplice() {
+		Arena arena, other, empty;
+
+		char *a = (char *)arena.Allocate(100);
+		memset(a, 'a', 100);
+
+		/* two blocks in the other arena */
+		char *b = (char *)other.Allocate(Arena::BLOCK_SIZE / 2);
+		char *c = (char *)other.Allocate(Arena::BLOCK_SIZE / 2 + 64);
+		memset(b, 'b', Arena::BLOCK_SIZE / 2);
+		memset(c, 'c', Arena::BLOCK_SIZE / 2 + 64);
+
+		arena.Splice(other);
+		CPPUNIT_ASSERT_EQUAL(size_t(0), other.GetSize());
+		CPPUNIT_ASSERT_EQUAL(Arena::BLOCK_SIZE * 3, arena.GetSize());
+
+		/* new allocations continue in the current block */
+		char *d = (char *)arena.Allocate(100);
+		CPPUNIT_ASSERT_EQUAL(a + 112, d);
+
+		CPPUNIT_ASSERT_EQUAL('b', b[Arena::BLOCK_SIZE / 2 - 1]);
+		CPPUNIT_ASSERT_EQUAL('c', c[0]);
+
+		/* splicing into an empty arena takes over its
+		   position */
+		empty.Splice(arena);
+		CPPUNIT_ASSERT_EQUAL(Arena::BLOCK_SIZE * 3, empty.GetSize());
+		CPPUNIT_ASSERT_EQUAL(d + 112, (char *)empty.Allocate(16));
+
+		/* the other arena is usable again */
+		other.Allocate(16);
+		CPPUNIT_ASSERT_EQUAL(Arena::BLOCK_SIZE, other.GetSize());
+	}
+
+	void TestForeignTag() {
+		Arena arena;
+
+		TagBuilder builder;
+		builder.AddItem(TAG_ARTIST, "foo");
+		builder.AddItem(TAG_TITLE, "bar");
+		const Tag src = builder.Commit();
+
+		Tag tag;
+		tag.AssignForeign(src, arena.NewArray<TagItem *>(src.num_items));
+		CPPUNIT_ASSERT(tag.foreign_items);
+		CPPUNIT_ASSERT_EQUAL(2u, unsigned(tag.num_items));
+		CPPUNIT_ASSERT(strcmp(tag.GetValue(TAG_TITLE), "bar") == 0);
+
+		/* moving it into a TagBuilder must not free the array */
+		TagBuilder b2(std::move(tag));
+		CPPUNIT_ASSERT(!tag.foreign_items);
+		CPPUNIT_ASSERT(tag.IsEmpty());
+
+		Tag copy = b2.Commit();
+		CPPUNIT_ASSERT(!copy.foreign_items);
+		CPPUNIT_ASSERT(strcmp(copy.GetValue(TAG_ARTIST), "foo") == 0);
+
+		/* the destructor of a foreign tag must not free it
+		   either */
+		Tag *t = new Tag();
+		t->AssignForeign(copy, arena.NewArray<TagItem *>(copy.num_items));
+		delete t;
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ArenaTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,159 @@
+/*
+ * Unit tests for class AsyncResolver.
+ */
+
+#include "config.h"
+#include "event/AsyncResolver.hxx"
+#include "event/Loop.hxx"
+#include "net/SocketAddress.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdlib.h>
+
+#ifdef WIN32
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netdb.h>
+#endif
+
+/**
+ * Counts the results, and breaks the #EventLoop after the expected
+ * number of results.
+ */
+class CountingHandler final : public ResolverHandler {
+	EventLoop &loop;
+	unsigned &pending;
+
+public:
+	unsigned n_success = 0, n_error = 0;
+	ResolverResult addresses;
+
+	CountingHandler(EventLoop &_loop, unsigned &_pending)
+		:loop(_loop), pending(_pending) {}
+
+	void OnResolverSuccess(const ResolverResult &_addresses) override {
+		++n_success;
+		addresses = _addresses;
+		Done();
+	}
+
+	void OnResolverError(gcc_unused const Error &error) override {
+		++n_error;
+		Done();
+	}
+
+private:
+	void Done() {
+		if (--pending == 0)
+			loop.Break();
+	}
+};
+
+class AsyncResolverTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(AsyncResolverTest);
+	CPPUNIT_TEST(TestNumeric);
+	CPPUNIT_TEST(TestLookup);
+	CPPUNIT_TEST(TestCancel);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestNumeric() {
+		AsyncResolver resolver;
+
+		ResolverResult result;
+		CPPUNIT_ASSERT(resolver.LookupCached("127.0.0.1:1234", 80,
+						     0, SOCK_STREAM, result));
+		CPPUNIT_ASSERT_EQUAL(size_t(1), result.size());
+		CPPUNIT_ASSERT_EQUAL(AF_INET,
+				     int(SocketAddress(result.front()).GetFamily()));
+
+		/* a name is neither numeric nor cached */
+		CPPUNIT_ASSERT(!resolver.LookupCached("localhost", 80,
+						      0, SOCK_STREAM, result));
+
+		/* numeric addresses are delivered without worker
+		   threads */
+		EventLoop loop;
+		unsigned pending = 1;
+		CountingHandler handler(loop, pending);
+		ResolveRequest request(loop, resolver, handler);
+		request.Start("127.0.0.1", 80, 0, SOCK_STREAM);
+		CPPUNIT_ASSERT(request.IsPending());
+		loop.Run();
+
+		CPPUNIT_ASSERT(!request.IsPending());
+		CPPUNIT_ASSERT_EQUAL(1u, handler.n_success);
+		CPPUNIT_ASSERT_EQUAL(size_t(1), handler.addresses.size());
+	}
+
+	void TestLookup() {
+		AsyncResolver resolver;
+		EventLoop loop;
+
+		/* submitted before the threads are started */
+		unsigned pending = 2;
+		CountingHandler a(loop, pending), b(loop, pending);
+		ResolveRequest ra(loop, resolver, a), rb(loop, resolver, b);
+		ra.Start("localhost", 80, 0, SOCK_STREAM);
+		rb.Start("localhost", 80, 0, SOCK_STREAM);
+
+		Error error;
+		CPPUNIT_ASSERT(resolver.Start(error));
+		loop.Run();
+		resolver.Stop();
+
+		CPPUNIT_ASSERT_EQUAL(1u, a.n_success);
+		CPPUNIT_ASSERT_EQUAL(1u, b.n_success);
+		CPPUNIT_ASSERT(!a.addresses.empty());
+		CPPUNIT_ASSERT_EQUAL(a.addresses.size(), b.addresses.size());
+
+		/* the result is cached now */
+		ResolverResult result;
+		CPPUNIT_ASSERT(resolver.LookupCached("localhost", 80,
+						     0, SOCK_STREAM, result));
+		CPPUNIT_ASSERT_EQUAL(a.addresses.size(), result.size());
+
+		/* different parameters are a different cache item */
+		CPPUNIT_ASSERT(!resolver.LookupCached("localhost", 81,
+						      0, SOCK_STREAM, result));
+	}
+
+	void TestCancel() {
+		AsyncResolver resolver;
+		EventLoop loop;
+
+		unsigned pending = 1;
+		CountingHandler a(loop, pending), b(loop, pending);
+		ResolveRequest ra(loop, resolver, a), rb(loop, resolver, b);
+		ra.Start("localhost", 80, 0, SOCK_STREAM);
+		rb.Start("localhost", 80, 0, SOCK_STREAM);
+		ra.Cancel();
+		CPPUNIT_ASSERT(!ra.IsPending());
+		CPPUNIT_ASSERT(rb.IsPending());
+
+		Error error;
+		CPPUNIT_ASSERT(resolver.Start(error));
+		loop.Run();
+		resolver.Stop();
+
+		CPPUNIT_ASSERT_EQUAL(0u, a.n_success + a.n_error);
+		CPPUNIT_ASSERT_EQUAL(1u, b.n_success);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(AsyncResolverTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -35,6 +35,8 @@ class ByteReverseTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(TestByteReverse3);
 	CPPUNIT_TEST(TestByteReverse4);
 	CPPUNIT_TEST(TestByteReverse5);
+	CPPUNIT_TEST(TestByteReverseLong);
+	CPPUNIT_TEST(TestByteReverseInPlace);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -42,6 +44,8 @@ public:
 	void TestByteReverse3();
 	void TestByteReverse4();
 	void TestByteReverse5();
+	void TestByteReverseLong();
+	void TestByteReverseInPlace();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(ByteReverseTest);
@@ -94,6 +98,79 @@ ByteReverseTest::TestByteReverse5()
 	CPPUNIT_ASSERT(strcmp(result, (const char *)dest) == 0);
 }
 
+/**
+ * Fill the buffer with a pattern which does not repeat within a
+ * frame.
+ */
+static void
+FillPattern(uint8_t *p, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+		p[i] = uint8_t(i * 37 + 11);
+}
+
+static bool
+IsReversed(const uint8_t *dest, const uint8_t *src, size_t size,
+	   size_t frame_size)
+{
+	for (size_t i = 0; i < size; ++i) {
+		const size_t frame = i - i % frame_size;
+		if (dest[i] != src[frame + frame_size - 1 - i % frame_size])
+			return false;
+	}
+
+	return true;
+}
+
+void
+ByteReverseTest::TestByteReverseLong()
+{
+	/* various lengths, so the vectorized code and the tail are
+	   both used */
+	static constexpr size_t MAX_FRAMES = 67;
+	static constexpr size_t frame_sizes[] = { 2, 3, 4, 8 };
+
+	uint8_t src[MAX_FRAMES * 8], dest[MAX_FRAMES * 8];
+	FillPattern(src, sizeof(src));
+
+	for (size_t frame_size : frame_sizes) {
+		for (size_t n = 0; n <= MAX_FRAMES; ++n) {
+			const size_t size = n * frame_size;
+			memset(dest, 0, sizeof(dest));
+			reverse_bytes(dest, src, src + size, frame_size);
+			CPPUNIT_ASSERT(IsReversed(dest, src, size, frame_size));
+
+			/* nothing was written beyond the end */
+			for (size_t i = size; i < sizeof(dest); ++i)
+				CPPUNIT_ASSERT_EQUAL(uint8_t(0), dest[i]);
+		}
+	}
+}
+
+void
+ByteReverseTest::TestByteReverseInPlace()
+{
+	static constexpr size_t N = 301;
+
+	alignas(8) uint8_t src[N * 8], buffer[N * 8];
+	FillPattern(src, sizeof(src));
+
+	memcpy(buffer, src, sizeof(buffer));
+	reverse_bytes_16((uint16_t *)buffer, (const uint16_t *)buffer,
+			 (const uint16_t *)buffer + N * 4);
+	CPPUNIT_ASSERT(IsReversed(buffer, src, sizeof(buffer), 2));
+
+	memcpy(buffer, src, sizeof(buffer));
+	reverse_bytes_32((uint32_t *)buffer, (const uint32_t *)buffer,
+			 (const uint32_t *)buffer + N * 2);
+	CPPUNIT_ASSERT(IsReversed(buffer, src, sizeof(buffer), 4));
+
+	memcpy(buffer, src, sizeof(buffer));
+	reverse_bytes_64((uint64_t *)buffer, (const uint64_t *)buffer,
+			 (const uint64_t *)buffer + N);
+	CPPUNIT_ASSERT(IsReversed(buffer, src, sizeof(buffer), 8));
+}
+
 int
 main(gcc_unused int argc, gcc_unused char **argv)
 {
@@ -0,0 +1,154 @@
+/*
+ * Unit tests for src/lib/bzip2/
+ */
+
+#include "config.h"
+#include "lib/bzip2/Block.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <bzlib.h>
+
+#include <string>
+#include <vector>
+#include <random>
+
+#include <stdlib.h>
+
+static std::string
+MakeData(size_t size, unsigned seed)
+{
+	/* words from a small vocabulary: compressible, but not too
+	   much, so there are many blocks */
+	static const char *const words[] = {
+		"alpha ", "bravo ", "charlie ", "delta ", "echo ",
+		"foxtrot ", "golf ", "hotel ", "india ", "juliet\n",
+	};
+
+	std::mt19937 rng(seed);
+	std::string result;
+	while (result.length() < size) {
+		result += words[rng() % 10];
+		result += char('a' + rng() % 26);
+	}
+
+	result.resize(size);
+	return result;
+}
+
+static std::string
+Compress(const std::string &src, int level)
+{
+	std::vector<char> buffer(src.length() + src.length() / 100 + 600);
+	unsigned length = buffer.size();
+	int result = BZ2_bzBuffToBuffCompress(buffer.data(), &length,
+					      const_cast<char *>(src.data()),
+					      src.length(), level, 0, 0);
+	CPPUNIT_ASSERT_EQUAL(BZ_OK, result);
+	return std::string(buffer.data(), length);
+}
+
+/**
+ * Decode a bzip2 file block by block, using only the markers found by
+ * #Bzip2BlockScanner.
+ */
+static std::string
+DecodeBlocks(const std::string &compressed, char level, unsigned &n_blocks)
+{
+	struct Marker {
+		uint64_t position;
+		bool end;
+	};
+
+	std::vector<Marker> markers;
+	Bzip2BlockScanner scanner;
+	scanner.Feed((const uint8_t *)compressed.data(), compressed.length(),
+		     [&markers](uint64_t position, bool end){
+			     markers.push_back({position, end});
+		     });
+
+	CPPUNIT_ASSERT_EQUAL(uint64_t(compressed.length() * 8),
+			     scanner.GetPosition());
+
+	std::string result;
+	n_blocks = 0;
+
+	for (size_t i = 0; i + 1 < markers.size(); ++i) {
+		if (markers[i].end)
+			continue;
+
+		const uint64_t start = markers[i].position;
+		const uint64_t n_bits = markers[i + 1].position - start;
+
+		std::vector<uint8_t> stream(Bzip2BlockStreamSize(n_bits));
+		size_t size = Bzip2MakeBlockStream(stream.data(),
+						   (const uint8_t *)compressed.data() + start / 8,
+						   start % 8, n_bits, level);
+		CPPUNIT_ASSERT_EQUAL(stream.size(), size);
+
+		std::vector<char> output(1024 * 1024);
+		unsigned length = output.size();
+		int ret = BZ2_bzBuffToBuffDecompress(output.data(), &length,
+						     (char *)stream.data(),
+						     size, 0, 0);
+		CPPUNIT_ASSERT_EQUAL(BZ_OK, ret);
+
+		result.append(output.data(), length);
+		++n_blocks;
+	}
+
+	return result;
+}
+
+class Bzip2BlockTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(Bzip2BlockTest);
+	CPPUNIT_TEST(TestBlocks);
+	CPPUNIT_TEST(TestSingleBlock);
+	CPPUNIT_TEST(TestMultiStream);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestBlocks() {
+		const std::string data = MakeData(700000, 1);
+		const std::string compressed = Compress(data, 1);
+
+		unsigned n_blocks;
+		CPPUNIT_ASSERT(data == DecodeBlocks(compressed, '1', n_blocks));
+		CPPUNIT_ASSERT(n_blocks >= 5);
+	}
+
+	void TestSingleBlock() {
+		const std::string data = MakeData(1000, 2);
+		const std::string compressed = Compress(data, 9);
+
+		unsigned n_blocks;
+		CPPUNIT_ASSERT(data == DecodeBlocks(compressed, '9', n_blocks));
+		CPPUNIT_ASSERT_EQUAL(1u, n_blocks);
+	}
+
+	void TestMultiStream() {
+		/* concatenated streams, like the output of pbzip2 */
+		const std::string a = MakeData(250000, 3);
+		const std::string b = MakeData(150000, 4);
+		const std::string compressed = Compress(a, 1) + Compress(b, 1);
+
+		unsigned n_blocks;
+		CPPUNIT_ASSERT(a + b == DecodeBlocks(compressed, '1', n_blocks));
+		CPPUNIT_ASSERT(n_blocks >= 4);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(Bzip2BlockTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
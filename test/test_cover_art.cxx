@@ -0,0 +1,269 @@
+/*
+ * Unit tests for the embedded picture readers and
+ * src/CoverArtCache.cxx
+ */
+
+#include "config.h"
+#include "CoverArt.hxx"
+#include "CoverArtCache.hxx"
+#include "tag/TagScanFile.hxx"
+#include "tag/HeaderReader.hxx"
+#include "tag/FlacHeader.hxx"
+#include "tag/Mp4Header.hxx"
+#include "tag/TagHandler.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <memory>
+#include <string>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+class MemoryTagScanFile final : public TagScanFile {
+	const std::string data;
+
+public:
+	explicit MemoryTagScanFile(std::string &&_data)
+		:data(std::move(_data)) {
+		SetSize(data.size());
+	}
+
+protected:
+	size_t ReadRaw(uint64_t offset, void *dest, size_t length) override {
+		if (offset >= data.size())
+			return 0;
+
+		length = std::min(length, size_t(data.size() - offset));
+		memcpy(dest, data.data() + offset, length);
+		return length;
+	}
+};
+
+static void
+RecordPicture(const char *mime_type, unsigned type, ConstBuffer<void> data,
+	      void *ctx)
+{
+	std::string &s = *(std::string *)ctx;
+	s += mime_type;
+	s += ',';
+	s += std::to_string(type);
+	s += ',';
+	s.append((const char *)data.data, data.size);
+	s += '\n';
+}
+
+static constexpr struct tag_handler picture_handler = {
+	nullptr,
+	nullptr,
+	nullptr,
+	RecordPicture,
+};
+
+static constexpr struct tag_handler null_handler = {
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+};
+
+static void
+AppendBE32(std::string &s, uint32_t value)
+{
+	for (int i = 3; i >= 0; --i)
+		s.push_back(char(value >> (8 * i)));
+}
+
+static std::string
+MakeFlacBlock(unsigned type, const std::string &data, bool last=false)
+{
+	std::string s;
+	s.push_back(char(type | (last ? 0x80 : 0)));
+	s.push_back(char(data.size() >> 16));
+	s.push_back(char(data.size() >> 8));
+	s.push_back(char(data.size()));
+	return s + data;
+}
+
+static std::string
+MakeFlacPicture(unsigned type, const char *mime_type, const std::string &image)
+{
+	std::string s;
+	AppendBE32(s, type);
+	AppendBE32(s, strlen(mime_type));
+	s += mime_type;
+	AppendBE32(s, 4);
+	s += "desc";
+	s.append(16, '\0');
+	AppendBE32(s, image.size());
+	return s + image;
+}
+
+static std::string
+MakeAtom(const char *type, const std::string &data)
+{
+	std::string s;
+	AppendBE32(s, data.size() + 8);
+	s.append(type, 4);
+	return s + data;
+}
+
+static std::string
+ScanFlac(std::string &&data, const tag_handler &handler, bool &success)
+{
+	std::string result;
+	MemoryTagScanFile file(std::move(data));
+	HeaderReader reader(file);
+	success = flac_header_scan(reader, handler, &result);
+	return result;
+}
+
+static std::string
+ScanMp4(std::string &&data)
+{
+	std::string result;
+	MemoryTagScanFile file(std::move(data));
+	HeaderReader reader(file);
+	if (!mp4_header_scan(reader, picture_handler, &result))
+		return "failed";
+	return result;
+}
+
+static std::shared_ptr<const CoverArt>
+MakeCoverArt(const char *source, size_t size)
+{
+	auto cover = std::make_shared<CoverArt>();
+	cover->source = AllocatedPath::FromFS(source);
+	cover->data.assign(size, 'x');
+	return cover;
+}
+
+class CoverArtTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(CoverArtTest);
+	CPPUNIT_TEST(TestFlac);
+	CPPUNIT_TEST(TestMp4);
+	CPPUNIT_TEST(TestCache);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestFlac() {
+		const std::string flac = std::string("fLaC") +
+			MakeFlacBlock(0, std::string(34, '\0')) +
+			MakeFlacBlock(6, MakeFlacPicture(4, "image/png",
+							 "BACK")) +
+			MakeFlacBlock(6, MakeFlacPicture(3, "image/jpeg",
+							 "FRONT"), true);
+
+		bool success;
+		CPPUNIT_ASSERT_EQUAL(std::string("image/png,4,BACK\n"
+						 "image/jpeg,3,FRONT\n"),
+				     ScanFlac(std::string(flac),
+					      picture_handler, success));
+		CPPUNIT_ASSERT(success);
+
+		/* without a picture method, the blocks are skipped */
+		CPPUNIT_ASSERT_EQUAL(std::string(),
+				     ScanFlac(std::string(flac),
+					      null_handler, success));
+		CPPUNIT_ASSERT(success);
+
+		/* a truncated picture is ignored */
+		std::string picture = MakeFlacPicture(3, "image/jpeg",
+						      "FRONT");
+		picture.resize(picture.size() - 1);
+		CPPUNIT_ASSERT_EQUAL(std::string(),
+				     ScanFlac(std::string("fLaC") +
+					      MakeFlacBlock(0, std::string(34, '\0')) +
+					      MakeFlacBlock(6, picture, true),
+					      picture_handler, success));
+		CPPUNIT_ASSERT(success);
+	}
+
+	void TestMp4() {
+		std::string mvhd(4, '\0');
+		mvhd.append(8, '\0');
+		AppendBE32(mvhd, 1000);
+		AppendBE32(mvhd, 5000);
+
+		std::string cover_data;
+		AppendBE32(cover_data, 14);
+		AppendBE32(cover_data, 0);
+		cover_data += "PNGIMAGE";
+
+		const std::string ilst =
+			MakeAtom("covr", MakeAtom("data", cover_data));
+		const std::string meta = std::string(4, '\0') +
+			MakeAtom("hdlr", std::string(25, '\0')) +
+			MakeAtom("ilst", ilst);
+
+		const std::string mp4 =
+			MakeAtom("ftyp", std::string("M4A \0\0\0\0", 8)) +
+			MakeAtom("moov",
+				 MakeAtom("mvhd", mvhd) +
+				 MakeAtom("udta", MakeAtom("meta", meta)));
+
+		CPPUNIT_ASSERT_EQUAL(std::string("image/png,3,PNGIMAGE\n"),
+				     ScanMp4(std::string(mp4)));
+	}
+
+	void TestCache() {
+		CoverArtCache cache(50000);
+
+		cache.Store("/a", 1, MakeCoverArt("/a/cover.jpg", 20000));
+		cache.Store("/b", 2, MakeCoverArt("/b/cover.jpg", 20000));
+		CPPUNIT_ASSERT_EQUAL(2u, cache.GetSize());
+
+		/* a modified directory misses, and the entry is
+		   removed */
+		CPPUNIT_ASSERT(cache.Lookup("/a", 3) == nullptr);
+		CPPUNIT_ASSERT_EQUAL(1u, cache.GetSize());
+
+		cache.Store("/a", 3, MakeCoverArt("/a/cover.jpg", 20000));
+		auto a = cache.Lookup("/a", 3);
+		CPPUNIT_ASSERT(a != nullptr);
+		CPPUNIT_ASSERT_EQUAL(size_t(20000), a->data.size());
+
+		/* "/b" is now the least recently used entry */
+		cache.Store("/c", 4, MakeCoverArt("/c/cover.jpg", 20000));
+		CPPUNIT_ASSERT_EQUAL(2u, cache.GetSize());
+		CPPUNIT_ASSERT(cache.Lookup("/b", 2) == nullptr);
+		CPPUNIT_ASSERT(cache.Lookup("/a", 3) != nullptr);
+		CPPUNIT_ASSERT(cache.Lookup("/c", 4) != nullptr);
+		CPPUNIT_ASSERT(cache.GetMemorySize() <= 50000);
+
+		/* a shared entry survives Clear() */
+		cache.Clear();
+		CPPUNIT_ASSERT_EQUAL(0u, cache.GetSize());
+		CPPUNIT_ASSERT_EQUAL(size_t(0), cache.GetMemorySize());
+		CPPUNIT_ASSERT_EQUAL(size_t(20000), a->data.size());
+
+		/* an entry larger than the cache is not stored */
+		cache.Store("/d", 5, MakeCoverArt("/d/cover.jpg", 100000));
+		CPPUNIT_ASSERT_EQUAL(0u, cache.GetSize());
+
+		/* a negative entry */
+		cache.Store("/e", 6, MakeCoverArt("/e/song.flac", 0));
+		auto e = cache.Lookup("/e", 6);
+		CPPUNIT_ASSERT(e != nullptr);
+		CPPUNIT_ASSERT(e->IsEmpty());
+
+		cache.Remove("/e");
+		CPPUNIT_ASSERT(cache.Lookup("/e", 6) == nullptr);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CoverArtTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,112 @@
+/*
+ * Unit tests for class CueCache.
+ */
+
+#include "config.h"
+#include "playlist/cue/CueCache.hxx"
+#include "DetachedSong.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdlib.h>
+
+static std::forward_list<DetachedSong>
+MakeTracks(const char *uri, unsigned n)
+{
+	std::forward_list<DetachedSong> tracks;
+	for (unsigned i = 0; i < n; ++i)
+		tracks.emplace_front(uri);
+	return tracks;
+}
+
+static unsigned
+Count(const std::forward_list<DetachedSong> &tracks)
+{
+	return std::distance(tracks.begin(), tracks.end());
+}
+
+class CueCacheTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(CueCacheTest);
+	CPPUNIT_TEST(TestLookup);
+	CPPUNIT_TEST(TestModified);
+	CPPUNIT_TEST(TestEvict);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestLookup() {
+		CueCache cache(4);
+		std::forward_list<DetachedSong> tracks;
+
+		CPPUNIT_ASSERT(!cache.Lookup("/a.flac", 1, 100, tracks));
+
+		cache.Store("/a.flac", 1, 100, MakeTracks("a.flac", 3));
+		CPPUNIT_ASSERT(cache.Lookup("/a.flac", 1, 100, tracks));
+		CPPUNIT_ASSERT_EQUAL(3u, Count(tracks));
+		CPPUNIT_ASSERT_EQUAL(std::string("a.flac"),
+				     std::string(tracks.front().GetURI()));
+
+		/* a negative entry: no CUE sheet */
+		cache.Store("/b.flac", 1, 100, MakeTracks("b.flac", 0));
+		tracks = MakeTracks("x", 1);
+		CPPUNIT_ASSERT(cache.Lookup("/b.flac", 1, 100, tracks));
+		CPPUNIT_ASSERT(tracks.empty());
+
+		cache.Clear();
+		CPPUNIT_ASSERT_EQUAL(0u, cache.GetSize());
+		CPPUNIT_ASSERT(!cache.Lookup("/a.flac", 1, 100, tracks));
+	}
+
+	void TestModified() {
+		CueCache cache(4);
+		std::forward_list<DetachedSong> tracks;
+
+		cache.Store("/a.flac", 1, 100, MakeTracks("a.flac", 3));
+		CPPUNIT_ASSERT(!cache.Lookup("/a.flac", 2, 100, tracks));
+
+		/* the stale entry has been removed */
+		CPPUNIT_ASSERT_EQUAL(0u, cache.GetSize());
+
+		cache.Store("/a.flac", 2, 100, MakeTracks("a.flac", 3));
+		CPPUNIT_ASSERT(!cache.Lookup("/a.flac", 2, 101, tracks));
+
+		/* Store() replaces an existing entry */
+		cache.Store("/a.flac", 3, 100, MakeTracks("a.flac", 2));
+		cache.Store("/a.flac", 3, 100, MakeTracks("a.flac", 5));
+		CPPUNIT_ASSERT_EQUAL(1u, cache.GetSize());
+		CPPUNIT_ASSERT(cache.Lookup("/a.flac", 3, 100, tracks));
+		CPPUNIT_ASSERT_EQUAL(5u, Count(tracks));
+	}
+
+	void TestEvict() {
+		CueCache cache(2);
+		std::forward_list<DetachedSong> tracks;
+
+		cache.Store("/a.flac", 1, 100, MakeTracks("a.flac", 1));
+		cache.Store("/b.flac", 1, 100, MakeTracks("b.flac", 1));
+
+		/* "a" becomes the most recently used entry, so "b"
+		   gets evicted */
+		CPPUNIT_ASSERT(cache.Lookup("/a.flac", 1, 100, tracks));
+		cache.Store("/c.flac", 1, 100, MakeTracks("c.flac", 1));
+
+		CPPUNIT_ASSERT_EQUAL(2u, cache.GetSize());
+		CPPUNIT_ASSERT(cache.Lookup("/a.flac", 1, 100, tracks));
+		CPPUNIT_ASSERT(!cache.Lookup("/b.flac", 1, 100, tracks));
+		CPPUNIT_ASSERT(cache.Lookup("/c.flac", 1, 100, tracks));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CueCacheTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
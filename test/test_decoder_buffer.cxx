@@ -0,0 +1,222 @@
+/*
+ * Unit tests for class DecoderBuffer.
+ */
+
+#include "config.h"
+#include "decoder/DecoderBuffer.hxx"
+#include "decoder/DecoderAPI.hxx"
+#include "input/InputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "util/Error.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+
+#include <string.h>
+#include <stdlib.h>
+
+/**
+ * An #InputStream which supports Peek(), but returns at most the
+ * data up to the next multiple of #CHUNK, like a ring buffer at its
+ * wraparound point.
+ */
+class PeekInputStream final : public InputStream {
+	static constexpr size_t CHUNK = 16;
+
+	const uint8_t *const data;
+	const size_t length;
+
+public:
+	PeekInputStream(Mutex &_mutex, Cond &_cond,
+			const uint8_t *_data, size_t _length)
+		:InputStream("peek://", _mutex, _cond),
+		 data(_data), length(_length) {
+		SetReady();
+	}
+
+	/* virtual methods from InputStream */
+	bool IsEOF() override {
+		return size_t(offset) >= length;
+	}
+
+	size_t Read(void *ptr, size_t read_size, Error &error) override {
+		auto r = Peek(error);
+		size_t nbytes = std::min(r.size, read_size);
+		memcpy(ptr, r.data, nbytes);
+		Consume(nbytes);
+		return nbytes;
+	}
+
+	bool SupportsPeek() const override {
+		return true;
+	}
+
+	ConstBuffer<void> Peek(gcc_unused Error &error) override {
+		if (IsEOF())
+			return nullptr;
+
+		const size_t end = std::min((size_t(offset) / CHUNK + 1) * CHUNK,
+					    length);
+		return { data + offset, end - size_t(offset) };
+	}
+
+	void Consume(size_t nbytes) override {
+		offset += nbytes;
+	}
+};
+
+size_t
+decoder_read(gcc_unused Decoder *decoder, InputStream &is,
+	     void *buffer, size_t length)
+{
+	return is.LockRead(buffer, length, IgnoreError());
+}
+
+ConstBuffer<void>
+decoder_peek(gcc_unused Decoder *decoder, InputStream &is)
+{
+	const ScopeLock protect(is.mutex);
+	return is.Peek(IgnoreError());
+}
+
+bool
+decoder_skip(Decoder *decoder, InputStream &is, size_t size)
+{
+	while (size > 0) {
+		char buffer[64];
+		size_t nbytes = decoder_read(decoder, is, buffer,
+					     std::min(sizeof(buffer), size));
+		if (nbytes == 0)
+			return false;
+
+		size -= nbytes;
+	}
+
+	return true;
+}
+
+class DecoderBufferTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(DecoderBufferTest);
+	CPPUNIT_TEST(TestDirect);
+	CPPUNIT_TEST(TestNeed);
+	CPPUNIT_TEST(TestSkip);
+	CPPUNIT_TEST_SUITE_END();
+
+	uint8_t data[100];
+
+public:
+	DecoderBufferTest() {
+		for (unsigned i = 0; i < sizeof(data); ++i)
+			data[i] = i;
+	}
+
+	void TestDirect() {
+		Mutex mutex;
+		Cond cond;
+		PeekInputStream is(mutex, cond, data, sizeof(data));
+		DecoderBuffer buffer(nullptr, is, 64);
+
+		/* the data is returned without copying */
+		CPPUNIT_ASSERT(buffer.Fill());
+		auto r = ConstBuffer<uint8_t>::FromVoid(buffer.Read());
+		CPPUNIT_ASSERT(r.data == data);
+		CPPUNIT_ASSERT_EQUAL(size_t(16), r.size);
+
+		buffer.Consume(10);
+		CPPUNIT_ASSERT_EQUAL(offset_type(10), buffer.GetOffset());
+		CPPUNIT_ASSERT_EQUAL(offset_type(10), is.GetOffset());
+
+		r = ConstBuffer<uint8_t>::FromVoid(buffer.Read());
+		CPPUNIT_ASSERT(r.data == data + 10);
+		CPPUNIT_ASSERT_EQUAL(size_t(6), r.size);
+
+		/* read everything */
+		unsigned expected = 10;
+		while (true) {
+			r = ConstBuffer<uint8_t>::FromVoid(buffer.Read());
+			if (r.IsEmpty()) {
+				if (!buffer.Fill())
+					break;
+				continue;
+			}
+
+			for (size_t i = 0; i < r.size; ++i)
+				CPPUNIT_ASSERT_EQUAL(uint8_t(expected + i),
+						     r.data[i]);
+
+			expected += r.size;
+			buffer.Consume(r.size);
+		}
+
+		CPPUNIT_ASSERT_EQUAL(unsigned(sizeof(data)), expected);
+	}
+
+	void TestNeed() {
+		Mutex mutex;
+		Cond cond;
+		PeekInputStream is(mutex, cond, data, sizeof(data));
+		DecoderBuffer buffer(nullptr, is, 64);
+
+		CPPUNIT_ASSERT(!buffer.Need(4).IsNull());
+		buffer.Consume(12);
+
+		/* more than the stream provides contiguously: the
+		   data is copied */
+		auto r = ConstBuffer<uint8_t>::FromVoid(buffer.Need(20));
+		CPPUNIT_ASSERT(!r.IsNull());
+		CPPUNIT_ASSERT(r.size >= 20);
+		for (size_t i = 0; i < 20; ++i)
+			CPPUNIT_ASSERT_EQUAL(uint8_t(12 + i), r.data[i]);
+
+		CPPUNIT_ASSERT_EQUAL(offset_type(12), buffer.GetOffset());
+
+		buffer.Consume(r.size);
+		CPPUNIT_ASSERT_EQUAL(offset_type(12 + r.size),
+				     buffer.GetOffset());
+
+		/* after the copy has been consumed, the stream's
+		   buffer is used directly again */
+		r = ConstBuffer<uint8_t>::FromVoid(buffer.Need(1));
+		CPPUNIT_ASSERT(r.data >= data && r.data < data + sizeof(data));
+		CPPUNIT_ASSERT_EQUAL(uint8_t(buffer.GetOffset()), r.data[0]);
+
+		buffer.Clear();
+		CPPUNIT_ASSERT_EQUAL(size_t(0), buffer.GetAvailable());
+		CPPUNIT_ASSERT_EQUAL(is.GetOffset(), buffer.GetOffset());
+
+		/* not enough data left */
+		CPPUNIT_ASSERT(buffer.Need(sizeof(data)).IsNull());
+	}
+
+	void TestSkip() {
+		Mutex mutex;
+		Cond cond;
+		PeekInputStream is(mutex, cond, data, sizeof(data));
+		DecoderBuffer buffer(nullptr, is, 64);
+
+		CPPUNIT_ASSERT(!buffer.Need(20).IsNull());
+		CPPUNIT_ASSERT(buffer.Skip(50));
+		CPPUNIT_ASSERT_EQUAL(offset_type(50), buffer.GetOffset());
+
+		auto r = ConstBuffer<uint8_t>::FromVoid(buffer.Need(1));
+		CPPUNIT_ASSERT_EQUAL(uint8_t(50), r.data[0]);
+
+		CPPUNIT_ASSERT(!buffer.Skip(100));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DecoderBufferTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
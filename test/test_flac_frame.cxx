@@ -0,0 +1,183 @@
+/*
+ * Unit tests for src/encoder/plugins/FlacFrame.cxx
+ */
+
+#include "config.h"
+#include "encoder/plugins/FlacFrame.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <stdlib.h>
+
+/**
+ * A bitwise reference implementation of the FLAC CRC-8.
+ */
+static uint8_t
+ReferenceCrc8(const uint8_t *p, size_t n)
+{
+	unsigned crc = 0;
+	while (n-- > 0) {
+		crc ^= *p++;
+		for (unsigned i = 0; i < 8; ++i)
+			crc = crc & 0x80 ? ((crc << 1) ^ 0x07) & 0xff : crc << 1;
+	}
+
+	return crc;
+}
+
+/**
+ * A bitwise reference implementation of the FLAC CRC-16.
+ */
+static uint16_t
+ReferenceCrc16(const uint8_t *p, size_t n)
+{
+	unsigned crc = 0;
+	while (n-- > 0) {
+		crc ^= unsigned(*p++) << 8;
+		for (unsigned i = 0; i < 8; ++i)
+			crc = crc & 0x8000
+				? ((crc << 1) ^ 0x8005) & 0xffff
+				: crc << 1;
+	}
+
+	return crc;
+}
+
+/**
+ * Build a fake frame: the header bytes, a CRC-8, a body and a
+ * CRC-16.
+ */
+static std::vector<uint8_t>
+MakeFrame(std::initializer_list<uint8_t> header, size_t body_size)
+{
+	std::vector<uint8_t> frame(header);
+	frame.push_back(ReferenceCrc8(frame.data(), frame.size()));
+
+	for (size_t i = 0; i < body_size; ++i)
+		frame.push_back(uint8_t(i * 7 + 3));
+
+	const uint16_t crc = ReferenceCrc16(frame.data(), frame.size());
+	frame.push_back(crc >> 8);
+	frame.push_back(crc);
+	return frame;
+}
+
+class FlacFrameTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(FlacFrameTest);
+	CPPUNIT_TEST(TestCrc);
+	CPPUNIT_TEST(TestRenumber);
+	CPPUNIT_TEST(TestRenumberExtra);
+	CPPUNIT_TEST(TestMalformed);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestCrc() {
+		uint8_t data[1000];
+		for (unsigned i = 0; i < sizeof(data); ++i)
+			data[i] = uint8_t(i * 13 + i / 7);
+
+		for (size_t n : {0, 1, 2, 15, 1000}) {
+			CPPUNIT_ASSERT_EQUAL(ReferenceCrc8(data, n),
+					     FlacCrc8(data, n));
+			CPPUNIT_ASSERT_EQUAL(ReferenceCrc16(data, n),
+					     FlacCrc16(data, n));
+		}
+	}
+
+	void TestRenumber() {
+		/* 4096 frames, 44.1 kHz, stereo, 16 bit, frame 5 */
+		const auto frame = MakeFrame({0xff, 0xf8, 0xc9, 0x18, 0x05},
+					     100);
+
+		std::vector<uint8_t> dest;
+		dest.push_back(0x42);
+
+		CPPUNIT_ASSERT(FlacAppendRenumberedFrame(dest, frame.data(),
+							 frame.size(),
+							 5000));
+
+		/* the frame number needs 3 bytes now */
+		CPPUNIT_ASSERT_EQUAL(size_t(1 + frame.size() + 2),
+				     dest.size());
+		CPPUNIT_ASSERT_EQUAL(uint8_t(0x42), dest[0]);
+
+		const uint8_t *p = dest.data() + 1;
+		const size_t size = dest.size() - 1;
+		CPPUNIT_ASSERT_EQUAL(uint8_t(0xc9), p[2]);
+		CPPUNIT_ASSERT_EQUAL(uint8_t(0xe1), p[4]);
+		CPPUNIT_ASSERT_EQUAL(uint8_t(0x8e), p[5]);
+		CPPUNIT_ASSERT_EQUAL(uint8_t(0x88), p[6]);
+
+		/* a CRC over data including its CRC is zero */
+		CPPUNIT_ASSERT_EQUAL(uint8_t(0), ReferenceCrc8(p, 8));
+		CPPUNIT_ASSERT_EQUAL(uint16_t(0), ReferenceCrc16(p, size));
+
+		/* the body is unchanged */
+		CPPUNIT_ASSERT(std::equal(frame.begin() + 6, frame.end() - 2,
+					  p + 8));
+
+		/* renumbering back restores the original */
+		std::vector<uint8_t> dest2;
+		CPPUNIT_ASSERT(FlacAppendRenumberedFrame(dest2, p, size, 5));
+		CPPUNIT_ASSERT(dest2 == frame);
+	}
+
+	void TestRenumberExtra() {
+		/* 16 bit block size and 8 bit sample rate after a two
+		   byte frame number */
+		const auto frame = MakeFrame({0xff, 0xf8, 0x7c, 0x18,
+					      0xc2, 0x80, 0x12, 0x34, 0x56},
+					     10);
+
+		std::vector<uint8_t> dest;
+		CPPUNIT_ASSERT(FlacAppendRenumberedFrame(dest, frame.data(),
+							 frame.size(), 1));
+		CPPUNIT_ASSERT_EQUAL(frame.size() - 1, dest.size());
+		CPPUNIT_ASSERT_EQUAL(uint8_t(0x01), dest[4]);
+		CPPUNIT_ASSERT_EQUAL(uint8_t(0x12), dest[5]);
+		CPPUNIT_ASSERT_EQUAL(uint8_t(0x34), dest[6]);
+		CPPUNIT_ASSERT_EQUAL(uint8_t(0x56), dest[7]);
+		CPPUNIT_ASSERT_EQUAL(uint8_t(0), ReferenceCrc8(dest.data(), 9));
+		CPPUNIT_ASSERT_EQUAL(uint16_t(0),
+				     ReferenceCrc16(dest.data(), dest.size()));
+	}
+
+	void TestMalformed() {
+		std::vector<uint8_t> dest;
+
+		/* variable block size */
+		auto frame = MakeFrame({0xff, 0xf9, 0xc9, 0x18, 0x05}, 10);
+		CPPUNIT_ASSERT(!FlacAppendRenumberedFrame(dest, frame.data(),
+							  frame.size(), 1));
+
+		/* no sync code */
+		frame = MakeFrame({0xfe, 0xf8, 0xc9, 0x18, 0x05}, 10);
+		CPPUNIT_ASSERT(!FlacAppendRenumberedFrame(dest, frame.data(),
+							  frame.size(), 1));
+
+		/* truncated */
+		frame = MakeFrame({0xff, 0xf8, 0xc9, 0x18, 0x05}, 0);
+		CPPUNIT_ASSERT(!FlacAppendRenumberedFrame(dest, frame.data(),
+							  6, 1));
+
+		CPPUNIT_ASSERT(dest.empty());
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FlacFrameTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -43,6 +43,19 @@ TestIcyParserTitle(const char *input, const char *title)
 	delete tag;
 }
 
+/**
+ * Append a metadata block with its length byte and null padding.
+ */
+static void
+AppendMetaBlock(std::string &s, const char *meta)
+{
+	const size_t length = strlen(meta);
+	const size_t blocks = (length + 15) / 16;
+	s.push_back(char(blocks));
+	s.append(meta, length);
+	s.append(blocks * 16 - length, '\0');
+}
+
 static void
 TestIcyParserEmpty(const char *input)
 {
@@ -54,6 +67,7 @@ TestIcyParserEmpty(const char *input)
 class IcyTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(IcyTest);
 	CPPUNIT_TEST(TestIcyMetadataParser);
+	CPPUNIT_TEST(TestIcyDuplicate);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -71,6 +85,45 @@ public:
 		TestIcyParserTitle("a='b'c';StreamTitle='foo'bar'", "foo'bar");
 		TestIcyParserTitle("StreamTitle='fo'o'b'ar';a='b'c'd'", "fo'o'b'ar");
 	}
+
+	void TestIcyDuplicate() {
+		IcyMetaDataParser parser;
+		parser.Start(4);
+
+		std::string s("abcd");
+		AppendMetaBlock(s, "StreamTitle='foo';");
+		s.append("efgh");
+		AppendMetaBlock(s, "StreamTitle='foo';");
+		s.append("ijkl");
+		s.push_back(0);
+		s.append("mnop");
+
+		CPPUNIT_ASSERT_EQUAL(size_t(16),
+				     parser.ParseInPlace(&s[0], s.size()));
+		CPPUNIT_ASSERT_EQUAL(std::string("abcdefghijklmnop"),
+				     s.substr(0, 16));
+
+		/* one tag for two identical blocks */
+		Tag *tag = parser.ReadTag();
+		CPPUNIT_ASSERT(tag != nullptr);
+		CompareTagTitle(*tag, "foo");
+		delete tag;
+
+		s.clear();
+		AppendMetaBlock(s, "StreamTitle='foo';");
+		s.append("abcd");
+		parser.ParseInPlace(&s[0], s.size());
+		CPPUNIT_ASSERT(parser.ReadTag() == nullptr);
+
+		s.clear();
+		AppendMetaBlock(s, "StreamTitle='bar';");
+		s.append("abcd");
+		parser.ParseInPlace(&s[0], s.size());
+		tag = parser.ReadTag();
+		CPPUNIT_ASSERT(tag != nullptr);
+		CompareTagTitle(*tag, "bar");
+		delete tag;
+	}
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(IcyTest);
@@ -0,0 +1,281 @@
+/*
+ * Unit tests for src/tag/Id3v2Parser.cxx
+ */
+
+#include "config.h"
+#include "tag/Id3v2Parser.hxx"
+#include "tag/TagHandler.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void
+RecordTag(TagType type, const char *value, void *ctx)
+{
+	std::string &s = *(std::string *)ctx;
+	s += tag_item_names[type];
+	s += '=';
+	s += value;
+	s += '\n';
+}
+
+static void
+RecordPair(const char *name, const char *value, void *ctx)
+{
+	std::string &s = *(std::string *)ctx;
+	s += '[';
+	s += name;
+	s += "]=";
+	s += value;
+	s += '\n';
+}
+
+static constexpr struct tag_handler record_handler = {
+	nullptr,
+	RecordTag,
+	RecordPair,
+	nullptr,
+};
+
+static void
+RecordPicture(const char *mime_type, unsigned type, ConstBuffer<void> data,
+	      void *ctx)
+{
+	std::string &s = *(std::string *)ctx;
+	s += "picture=";
+	s += mime_type;
+	s += ',';
+	s += std::to_string(type);
+	s += ',';
+	s.append((const char *)data.data, data.size);
+	s += '\n';
+}
+
+static constexpr struct tag_handler picture_handler = {
+	nullptr,
+	RecordTag,
+	nullptr,
+	RecordPicture,
+};
+
+static void
+AppendSyncSafe(std::string &s, size_t value)
+{
+	s.push_back(char((value >> 21) & 0x7f));
+	s.push_back(char((value >> 14) & 0x7f));
+	s.push_back(char((value >> 7) & 0x7f));
+	s.push_back(char(value & 0x7f));
+}
+
+static std::string
+MakeFrame(unsigned version, const char *id, const std::string &data,
+	  uint8_t format_flags=0)
+{
+	std::string s(id, 4);
+	if (version == 4) {
+		AppendSyncSafe(s, data.size());
+	} else {
+		s.push_back(char(data.size() >> 24));
+		s.push_back(char(data.size() >> 16));
+		s.push_back(char(data.size() >> 8));
+		s.push_back(char(data.size()));
+	}
+
+	s.push_back(0);
+	s.push_back(char(format_flags));
+	return s + data;
+}
+
+static std::string
+MakeTag(unsigned version, const std::string &frames, uint8_t flags=0)
+{
+	std::string s("ID3");
+	s.push_back(char(version));
+	s.push_back(0);
+	s.push_back(char(flags));
+	AppendSyncSafe(s, frames.size() + 16);
+	return s + frames + std::string(16, '\0');
+}
+
+/**
+ * @return the handler invocations, or "unsupported"
+ */
+static std::string
+Parse(std::string tag, const tag_handler &handler=record_handler)
+{
+	std::string result;
+	if (!id3v2_parse((uint8_t *)&tag[0], tag.size(),
+			 &handler, &result))
+		return "unsupported";
+	return result;
+}
+
+class Id3v2ParserTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(Id3v2ParserTest);
+	CPPUNIT_TEST(TestResync);
+	CPPUNIT_TEST(TestEncodings);
+	CPPUNIT_TEST(TestOrder);
+	CPPUNIT_TEST(TestSpecialFrames);
+	CPPUNIT_TEST(TestUnsynchronisation);
+	CPPUNIT_TEST(TestFallback);
+	CPPUNIT_TEST(TestPicture);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestResync() {
+		std::string s("a\xff\x00" "b\xff\x00\x00\xff\xff\x00" "c", 11);
+		size_t length = id3v2_resync((uint8_t *)&s[0], s.size());
+		CPPUNIT_ASSERT_EQUAL(std::string("a\xff" "b\xff\x00\xff\xff" "c",
+						 8),
+				     s.substr(0, length));
+
+		std::string plain("no stuffing here");
+		CPPUNIT_ASSERT_EQUAL(plain.size(),
+				     id3v2_resync((uint8_t *)&plain[0],
+						  plain.size()));
+	}
+
+	void TestEncodings() {
+		const std::string latin1("\x00" "Caf\xe9 del Mar, quite long",
+					 25);
+		const std::string utf16("\x01\xff\xfe" "A\x00\xe9\x00"
+					"\x3c\xd8\xb5\xdf", 11);
+		const std::string utf16be("\x02\x00" "B\x04\x10", 5);
+		const std::string utf8("\x03  \xc3\xa4 \x00", 7);
+
+		CPPUNIT_ASSERT_EQUAL(std::string("Title=Caf\xc3\xa9 del Mar, quite long\n"
+						 "Album=A\xc3\xa9\xf0\x9f\x8e\xb5\n"
+						 "Genre=\xc3\xa4\n"
+						 "Comment=B\xd0\x90\n"),
+				     Parse(MakeTag(4,
+						   MakeFrame(4, "TIT2", latin1) +
+						   MakeFrame(4, "TALB", utf16) +
+						   MakeFrame(4, "TCON", utf8) +
+						   MakeFrame(4, "COMM",
+							     std::string("\x02" "eng\x00\x00", 6) +
+							     utf16be.substr(1)))));
+	}
+
+	void TestOrder() {
+		/* the items are reported in scan_id3_tag()'s order,
+		   not in the file's order; multiple strings are split */
+		CPPUNIT_ASSERT_EQUAL(std::string("Artist=a\n"
+						 "Artist=b\n"
+						 "Title=t\n"
+						 "Date=2015\n"),
+				     Parse(MakeTag(3,
+						   MakeFrame(3, "TIT2", std::string("\0t", 2)) +
+						   MakeFrame(3, "APIC", std::string(1000, 'x')) +
+						   MakeFrame(3, "TYER", std::string("\0" "2015", 5)) +
+						   MakeFrame(3, "TPE1", std::string("\0a\0b\0", 5)))));
+	}
+
+	void TestSpecialFrames() {
+		CPPUNIT_ASSERT_EQUAL(std::string("[MusicBrainz Album Id]=abc\n"
+						 "MUSICBRAINZ_ALBUMID=abc\n"
+						 "[foo]=bar\n"
+						 "MUSICBRAINZ_TRACKID=1234\n"),
+				     Parse(MakeTag(4,
+						   MakeFrame(4, "UFID", std::string("http://musicbrainz.org\0" "1234", 27)) +
+						   MakeFrame(4, "UFID", std::string("other\0" "5678", 10)) +
+						   MakeFrame(4, "TXXX", std::string("\3MusicBrainz Album Id\0abc", 25)) +
+						   MakeFrame(4, "TXXX", std::string("\0foo\0bar", 8)))));
+	}
+
+	void TestUnsynchronisation() {
+		/* ID3v2.4: per frame, with a data length indicator */
+		std::string data("\0\0\0\x04" "\0\xff\x00" "\xe9", 8);
+		CPPUNIT_ASSERT_EQUAL(std::string("Title=\xc3\xbf\xc3\xa9\n"),
+				     Parse(MakeTag(4,
+						   MakeFrame(4, "TIT2", data, 0x03))));
+
+		/* ID3v2.3: the whole tag, including frame headers */
+		std::string frame = MakeFrame(3, "TIT2",
+					      std::string("\0" "\xff\xff\xff", 4));
+		std::string synced;
+		for (char ch : frame) {
+			synced.push_back(ch);
+			if (ch == '\xff')
+				synced.push_back('\0');
+		}
+
+		CPPUNIT_ASSERT_EQUAL(std::string("Title=\xc3\xbf\xc3\xbf\xc3\xbf\n"),
+				     Parse(MakeTag(3, synced, 0x80)));
+	}
+
+	void TestFallback() {
+		/* ID3v2.2 */
+		CPPUNIT_ASSERT_EQUAL(std::string("unsupported"),
+				     Parse(MakeTag(2, "")));
+
+		/* numeric genre */
+		CPPUNIT_ASSERT_EQUAL(std::string("unsupported"),
+				     Parse(MakeTag(4,
+						   MakeFrame(4, "TIT2", std::string("\0t", 2)) +
+						   MakeFrame(4, "TCON", std::string("\0" "17", 3)))));
+		CPPUNIT_ASSERT_EQUAL(std::string("unsupported"),
+				     Parse(MakeTag(3,
+						   MakeFrame(3, "TCON", std::string("\0(17)Rock", 9)))));
+
+		/* compressed frame */
+		CPPUNIT_ASSERT_EQUAL(std::string("unsupported"),
+				     Parse(MakeTag(4,
+						   MakeFrame(4, "TIT2", std::string("\0t", 2),
+							     0x08))));
+
+		/* truncated buffer */
+		std::string tag = MakeTag(4, MakeFrame(4, "TIT2", std::string("\0t", 2)));
+		tag.resize(tag.size() - 1);
+		CPPUNIT_ASSERT_EQUAL(std::string("unsupported"), Parse(tag));
+	}
+
+	void TestPicture() {
+		/* a back cover with a UTF-16 description, then the
+		   front cover with an ID3v2.2 image format */
+		const std::string back("\x01" "image/png\0" "\x04"
+				       "\xff\xfe" "b\0\0\0" "PNGDATA", 25);
+		const std::string front("\x00" "JPG\0" "\x03" "front\0"
+					"JPEGDATA", 20);
+		const std::string frames =
+			MakeFrame(4, "APIC", back) +
+			MakeFrame(4, "TIT2", std::string("\0t", 2)) +
+			MakeFrame(4, "APIC", front);
+
+		CPPUNIT_ASSERT_EQUAL(std::string("Title=t\n"
+						 "picture=image/png,4,PNGDATA\n"
+						 "picture=image/jpeg,3,JPEGDATA\n"),
+				     Parse(MakeTag(4, frames),
+					   picture_handler));
+
+		/* pictures are skipped unless the handler wants them */
+		CPPUNIT_ASSERT_EQUAL(std::string("Title=t\n"),
+				     Parse(MakeTag(4, frames)));
+
+		/* a picture without data */
+		CPPUNIT_ASSERT_EQUAL(std::string(""),
+				     Parse(MakeTag(3,
+						   MakeFrame(3, "APIC",
+							     std::string("\0image/png\0\x03\0", 13))),
+					   picture_handler));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(Id3v2ParserTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
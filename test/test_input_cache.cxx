@@ -0,0 +1,198 @@
+/*
+ * Unit tests for class InputCache.
+ */
+
+#include "config.h"
+#include "input/InputCache.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "util/Error.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+
+static std::string
+MakeTempDirectory()
+{
+	char buffer[] = "/tmp/mpd_test_input_cache.XXXXXX";
+	if (mkdtemp(buffer) == nullptr)
+		abort();
+	return buffer;
+}
+
+static void
+RemoveDirectory(const std::string &path)
+{
+	const std::string command = "rm -rf " + path;
+	if (system(command.c_str()) != 0)
+		abort();
+}
+
+class InputCacheTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(InputCacheTest);
+	CPPUNIT_TEST(TestRanges);
+	CPPUNIT_TEST(TestPersistent);
+	CPPUNIT_TEST(TestSizeChanged);
+	CPPUNIT_TEST(TestEvict);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestRanges() {
+		InputCacheEntry entry(std::string("http://a/b.flac"),
+				      std::string("x"));
+		entry.size = 1000;
+
+		CPPUNIT_ASSERT_EQUAL(offset_type(100), entry.AddRange(100, 200));
+		CPPUNIT_ASSERT_EQUAL(offset_type(100), entry.AddRange(300, 400));
+		CPPUNIT_ASSERT_EQUAL(size_t(2), entry.ranges.size());
+
+		CPPUNIT_ASSERT_EQUAL(offset_type(0), entry.GetCachedAt(99));
+		CPPUNIT_ASSERT_EQUAL(offset_type(100), entry.GetCachedAt(100));
+		CPPUNIT_ASSERT_EQUAL(offset_type(1), entry.GetCachedAt(199));
+		CPPUNIT_ASSERT_EQUAL(offset_type(0), entry.GetCachedAt(200));
+
+		CPPUNIT_ASSERT_EQUAL(offset_type(100), entry.GetMissingAt(0));
+		CPPUNIT_ASSERT_EQUAL(offset_type(100), entry.GetMissingAt(200));
+		CPPUNIT_ASSERT_EQUAL(offset_type(600), entry.GetMissingAt(400));
+
+		/* overlapping and adjacent ranges are merged */
+		CPPUNIT_ASSERT_EQUAL(offset_type(100), entry.AddRange(150, 300));
+		CPPUNIT_ASSERT_EQUAL(size_t(1), entry.ranges.size());
+		CPPUNIT_ASSERT_EQUAL(offset_type(300), entry.cached);
+		CPPUNIT_ASSERT_EQUAL(offset_type(300), entry.GetCachedAt(100));
+
+		CPPUNIT_ASSERT_EQUAL(offset_type(0), entry.AddRange(120, 130));
+		CPPUNIT_ASSERT(!entry.IsComplete());
+
+		entry.AddRange(0, 100);
+		entry.AddRange(400, 1000);
+		CPPUNIT_ASSERT(entry.IsComplete());
+		CPPUNIT_ASSERT_EQUAL(size_t(1), entry.ranges.size());
+	}
+
+	void TestPersistent() {
+		const std::string directory = MakeTempDirectory();
+		static constexpr char uri[] = "http://a/b.flac";
+
+		char data[1000];
+		for (unsigned i = 0; i < sizeof(data); ++i)
+			data[i] = i;
+
+		{
+			InputCache cache(AllocatedPath::FromFS(directory.c_str()),
+					 1 << 20);
+			Error error;
+			CPPUNIT_ASSERT(cache.Load(error));
+
+			InputCacheEntry *entry = cache.Acquire(uri, error);
+			CPPUNIT_ASSERT(entry != nullptr);
+			cache.SetAttributes(*entry, sizeof(data), "audio/flac");
+			cache.Write(*entry, 0, data, 500);
+			cache.Release(*entry);
+		}
+
+		InputCache cache(AllocatedPath::FromFS(directory.c_str()),
+				 1 << 20);
+		Error error;
+		CPPUNIT_ASSERT(cache.Load(error));
+
+		InputCacheEntry *entry = cache.Acquire(uri, error);
+		CPPUNIT_ASSERT(entry != nullptr);
+		CPPUNIT_ASSERT_EQUAL(offset_type(sizeof(data)),
+				     cache.GetSize(*entry));
+		CPPUNIT_ASSERT(cache.GetMimeType(*entry) == "audio/flac");
+		CPPUNIT_ASSERT(cache.IsCached(*entry, 499));
+		CPPUNIT_ASSERT(!cache.IsCached(*entry, 500));
+		CPPUNIT_ASSERT(!cache.IsComplete(*entry));
+
+		char buffer[1000];
+		CPPUNIT_ASSERT_EQUAL(size_t(500),
+				     cache.Read(*entry, 0, buffer, sizeof(buffer)));
+		CPPUNIT_ASSERT(memcmp(buffer, data, 500) == 0);
+		CPPUNIT_ASSERT_EQUAL(size_t(0),
+				     cache.Read(*entry, 500, buffer, 10));
+
+		cache.Write(*entry, 500, data + 500, 500);
+		CPPUNIT_ASSERT(cache.IsComplete(*entry));
+		cache.Release(*entry);
+
+		RemoveDirectory(directory);
+	}
+
+	void TestSizeChanged() {
+		const std::string directory = MakeTempDirectory();
+		InputCache cache(AllocatedPath::FromFS(directory.c_str()),
+				 1 << 20);
+		Error error;
+		CPPUNIT_ASSERT(cache.Load(error));
+
+		static constexpr char data[100] = {};
+
+		InputCacheEntry *entry = cache.Acquire("http://a/c", error);
+		CPPUNIT_ASSERT(entry != nullptr);
+		cache.SetAttributes(*entry, 100, nullptr);
+		cache.Write(*entry, 0, data, 100);
+		CPPUNIT_ASSERT(cache.IsComplete(*entry));
+
+		/* the remote file has been modified: forget the old
+		   data */
+		cache.SetAttributes(*entry, 200, nullptr);
+		CPPUNIT_ASSERT(!cache.IsCached(*entry, 0));
+		CPPUNIT_ASSERT_EQUAL(offset_type(200), cache.GetSize(*entry));
+		cache.Release(*entry);
+
+		RemoveDirectory(directory);
+	}
+
+	void TestEvict() {
+		const std::string directory = MakeTempDirectory();
+		InputCache cache(AllocatedPath::FromFS(directory.c_str()),
+				 250);
+		Error error;
+		CPPUNIT_ASSERT(cache.Load(error));
+
+		static constexpr char data[100] = {};
+		static constexpr const char *uris[] = {
+			"http://a/1", "http://a/2", "http://a/3",
+		};
+
+		for (const char *uri : uris) {
+			InputCacheEntry *entry = cache.Acquire(uri, error);
+			CPPUNIT_ASSERT(entry != nullptr);
+			cache.SetAttributes(*entry, 100, nullptr);
+			cache.Write(*entry, 0, data, 100);
+			cache.Release(*entry);
+		}
+
+		/* the least recently used entry has been evicted */
+		InputCacheEntry *entry = cache.Acquire(uris[0], error);
+		CPPUNIT_ASSERT(entry != nullptr);
+		CPPUNIT_ASSERT(!cache.IsCached(*entry, 0));
+		cache.Release(*entry);
+
+		entry = cache.Acquire(uris[2], error);
+		CPPUNIT_ASSERT(entry != nullptr);
+		CPPUNIT_ASSERT(cache.IsComplete(*entry));
+		cache.Release(*entry);
+
+		RemoveDirectory(directory);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(InputCacheTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,122 @@
+/*
+ * Unit tests for src/metrics/
+ */
+
+#include "config.h"
+#include "metrics/Counter.hxx"
+#include "metrics/Writer.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <thread>
+
+#include <stdlib.h>
+
+static const double bounds[3] = { 1, 10, 100 };
+
+class MetricsTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(MetricsTest);
+	CPPUNIT_TEST(TestCounter);
+	CPPUNIT_TEST(TestLabels);
+	CPPUNIT_TEST(TestHistogram);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestCounter() {
+		MetricCounter counter;
+
+		std::thread threads[4];
+		for (auto &t : threads)
+			t = std::thread([&counter](){
+					for (unsigned i = 0; i < 10000; ++i)
+						counter.Add();
+				});
+
+		for (auto &t : threads)
+			t.join();
+
+		CPPUNIT_ASSERT_EQUAL(uint64_t(40000), counter.Get());
+
+		std::string out;
+		OpenMetricsWriter w(out);
+		w.Counter("foo", "Foo things", counter.Get());
+		w.Gauge("bar", "Bar level", 0.5);
+		w.Finish();
+
+		CPPUNIT_ASSERT_EQUAL(std::string("# TYPE foo counter\n"
+						 "# HELP foo Foo things\n"
+						 "foo_total 40000\n"
+						 "# TYPE bar gauge\n"
+						 "# HELP bar Bar level\n"
+						 "bar 0.5\n"
+						 "# EOF\n"),
+				     out);
+	}
+
+	void TestLabels() {
+		std::string out;
+		OpenMetricsWriter w(out);
+		w.Sample("foo", "_total", "output", "a \"b\"\\c\nd",
+			 uint64_t(3));
+
+		CPPUNIT_ASSERT_EQUAL(std::string("foo_total{output=\"a \\\"b\\\"\\\\c\\nd\"} 3\n"),
+				     out);
+	}
+
+	void TestHistogram() {
+		MetricHistogram<3> histogram(bounds);
+		histogram.Observe(0.5);
+		histogram.Observe(1);
+		histogram.Observe(50);
+		histogram.Observe(1000);
+
+		CPPUNIT_ASSERT_EQUAL(uint64_t(2), histogram.GetCount(0));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), histogram.GetCount(1));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(1), histogram.GetCount(2));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(1), histogram.GetCount(3));
+
+		std::string out;
+		OpenMetricsWriter w(out);
+		w.Histogram("h", "Help", histogram);
+
+		CPPUNIT_ASSERT_EQUAL(std::string("# TYPE h histogram\n"
+						 "# HELP h Help\n"
+						 "h_bucket{le=\"1\"} 2\n"
+						 "h_bucket{le=\"10\"} 2\n"
+						 "h_bucket{le=\"100\"} 3\n"
+						 "h_bucket{le=\"+Inf\"} 4\n"
+						 "h_count 4\n"
+						 "h_sum 1051.5\n"),
+				     out);
+
+		out.clear();
+		w.Family("l", "histogram", "Labelled");
+		w.HistogramSamples("l", "command", "play", histogram);
+
+		CPPUNIT_ASSERT_EQUAL(std::string("# TYPE l histogram\n"
+						 "# HELP l Labelled\n"
+						 "l_bucket{command=\"play\",le=\"1\"} 2\n"
+						 "l_bucket{command=\"play\",le=\"10\"} 2\n"
+						 "l_bucket{command=\"play\",le=\"100\"} 3\n"
+						 "l_bucket{command=\"play\",le=\"+Inf\"} 4\n"
+						 "l_count{command=\"play\"} 4\n"
+						 "l_sum{command=\"play\"} 1051.5\n"),
+				     out);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MetricsTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
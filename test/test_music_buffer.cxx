@@ -0,0 +1,228 @@
+/*
+ * Unit tests for class MusicBuffer.
+ */
+
+#include "config.h"
+#include "MusicBuffer.hxx"
+#include "MusicPipe.hxx"
+#include "MusicChunk.hxx"
+#include "AudioFormat.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <future>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <stdlib.h>
+
+/**
+ * Large enough to enable the per-thread magazines.
+ */
+static constexpr unsigned N_CHUNKS = MusicBuffer::MAGAZINE_SIZE * 16;
+
+static constexpr AudioFormat audio_format(44100, SampleFormat::S16, 2);
+
+/**
+ * Allocate as many chunks as possible, and check that they are all
+ * different.
+ */
+static std::vector<MusicChunk *>
+AllocateAll(MusicBuffer &buffer)
+{
+	std::vector<MusicChunk *> chunks;
+	std::set<const uint8_t *> payloads;
+
+	MusicChunk *chunk;
+	while ((chunk = buffer.Allocate()) != nullptr) {
+		CPPUNIT_ASSERT(chunk->IsEmpty());
+		CPPUNIT_ASSERT(chunk->data != nullptr);
+		CPPUNIT_ASSERT(payloads.insert(chunk->data).second);
+		chunks.push_back(chunk);
+	}
+
+	return chunks;
+}
+
+static void
+ReturnAll(MusicBuffer &buffer, const std::vector<MusicChunk *> &chunks)
+{
+	for (auto *chunk : chunks)
+		buffer.Return(chunk);
+}
+
+class MusicBufferTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(MusicBufferTest);
+	CPPUNIT_TEST(TestAllocateAll);
+	CPPUNIT_TEST(TestCrossThread);
+	CPPUNIT_TEST(TestConcurrent);
+	CPPUNIT_TEST(TestDestroy);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestAllocateAll() {
+		MusicBuffer buffer(N_CHUNKS, DEFAULT_CHUNK_SIZE);
+
+		auto chunks = AllocateAll(buffer);
+		CPPUNIT_ASSERT_EQUAL(size_t(N_CHUNKS), chunks.size());
+		ReturnAll(buffer, chunks);
+
+		/* the chunks cached in this thread's magazine are
+		   handed out again */
+		chunks = AllocateAll(buffer);
+		CPPUNIT_ASSERT_EQUAL(size_t(N_CHUNKS), chunks.size());
+		ReturnAll(buffer, chunks);
+
+		buffer.FlushThreadCache();
+#ifndef NDEBUG
+		CPPUNIT_ASSERT(buffer.IsEmptyUnsafe());
+#endif
+	}
+
+	/**
+	 * Chunks allocated by one thread are returned by another
+	 * one.
+	 */
+	void TestCrossThread() {
+		MusicBuffer buffer(N_CHUNKS, DEFAULT_CHUNK_SIZE);
+
+		std::vector<MusicChunk *> chunks;
+		std::thread([&buffer, &chunks](){
+				chunks = AllocateAll(buffer);
+			}).join();
+		CPPUNIT_ASSERT_EQUAL(size_t(N_CHUNKS), chunks.size());
+
+		std::thread([&buffer, &chunks](){
+				ReturnAll(buffer, chunks);
+			}).join();
+
+		/* both threads have exited, which has returned the
+		   chunks in their magazines to the buffer */
+#ifndef NDEBUG
+		CPPUNIT_ASSERT(buffer.IsEmptyUnsafe());
+#endif
+
+		chunks = AllocateAll(buffer);
+		CPPUNIT_ASSERT_EQUAL(size_t(N_CHUNKS), chunks.size());
+		ReturnAll(buffer, chunks);
+		buffer.FlushThreadCache();
+	}
+
+	/**
+	 * One thread allocates chunks while another one returns
+	 * them at the same time.
+	 */
+	void TestConcurrent() {
+		static constexpr unsigned N = 100000;
+
+		MusicBuffer buffer(N_CHUNKS, DEFAULT_CHUNK_SIZE);
+		MusicPipe pipe;
+
+		std::thread producer([&buffer, &pipe](){
+				for (unsigned i = 0; i < N; ++i) {
+					MusicChunk *chunk;
+					while ((chunk = buffer.Allocate()) == nullptr)
+						std::this_thread::yield();
+
+					chunk->Write(audio_format,
+						     SongTime::zero(), 0);
+					chunk->Expand(audio_format, 4);
+					pipe.Push(chunk);
+				}
+			});
+
+		std::thread consumer([&buffer, &pipe](){
+				for (unsigned i = 0; i < N;) {
+					MusicChunk *chunk = pipe.Shift();
+					if (chunk == nullptr) {
+						std::this_thread::yield();
+						continue;
+					}
+
+					buffer.Return(chunk);
+					++i;
+				}
+			});
+
+		producer.join();
+		consumer.join();
+
+		CPPUNIT_ASSERT(pipe.IsEmpty());
+#ifndef NDEBUG
+		CPPUNIT_ASSERT(buffer.IsEmptyUnsafe());
+#endif
+	}
+
+	/**
+	 * A buffer is destroyed while another thread still caches
+	 * its chunks; that thread must neither hand them out later
+	 * nor touch the destroyed buffer.
+	 */
+	void TestDestroy() {
+		std::promise<void> cached, destroyed;
+		auto destroyed_future = destroyed.get_future();
+		MusicBuffer *buffer = new MusicBuffer(N_CHUNKS,
+						      DEFAULT_CHUNK_SIZE);
+		MusicBuffer *buffer2 = nullptr;
+		size_t n_allocated = 0;
+
+		std::thread thread([&](){
+				/* fill this thread's magazine */
+				buffer->Return(buffer->Allocate());
+				cached.set_value();
+
+				destroyed_future.wait();
+
+				/* a new buffer (possibly at the same
+				   address) must only hand out its own
+				   chunks */
+				auto chunks = AllocateAll(*buffer2);
+				n_allocated = chunks.size();
+				ReturnAll(*buffer2, chunks);
+			});
+
+		cached.get_future().wait();
+		delete buffer;
+		buffer2 = new MusicBuffer(N_CHUNKS, DEFAULT_CHUNK_SIZE);
+		destroyed.set_value();
+
+		thread.join();
+		CPPUNIT_ASSERT_EQUAL(size_t(N_CHUNKS), n_allocated);
+#ifndef NDEBUG
+		CPPUNIT_ASSERT(buffer2->IsEmptyUnsafe());
+#endif
+		delete buffer2;
+
+		/* a thread which exits after its buffer has been
+		   destroyed */
+		buffer = new MusicBuffer(N_CHUNKS, DEFAULT_CHUNK_SIZE);
+		std::promise<void> cached2, destroyed2;
+		auto destroyed2_future = destroyed2.get_future();
+		thread = std::thread([&](){
+				buffer->Return(buffer->Allocate());
+				cached2.set_value();
+				destroyed2_future.wait();
+			});
+
+		cached2.get_future().wait();
+		delete buffer;
+		destroyed2.set_value();
+		thread.join();
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MusicBufferTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
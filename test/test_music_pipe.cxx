@@ -0,0 +1,154 @@
+/*
+ * Unit tests for class MusicPipe.
+ */
+
+#include "config.h"
+#include "MusicPipe.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
+#include "AudioFormat.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <thread>
+
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr AudioFormat audio_format(44100, SampleFormat::S16, 2);
+
+/**
+ * Allocate a chunk and store the specified value as its only frame.
+ */
+static MusicChunk *
+MakeChunk(MusicBuffer &buffer, uint32_t value)
+{
+	MusicChunk *chunk;
+	while ((chunk = buffer.Allocate()) == nullptr)
+		/* the consumer has not returned enough chunks yet */
+		std::this_thread::yield();
+
+	auto w = chunk->Write(audio_format, SongTime::zero(), 0);
+	CPPUNIT_ASSERT(w.size >= sizeof(value));
+	memcpy(w.data, &value, sizeof(value));
+	chunk->Expand(audio_format, sizeof(value));
+	return chunk;
+}
+
+static uint32_t
+GetValue(const MusicChunk &chunk)
+{
+	uint32_t value;
+	CPPUNIT_ASSERT_EQUAL(size_t(sizeof(value)), size_t(chunk.length));
+	memcpy(&value, chunk.data, sizeof(value));
+	return value;
+}
+
+class MusicPipeTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(MusicPipeTest);
+	CPPUNIT_TEST(TestPushShift);
+	CPPUNIT_TEST(TestClear);
+	CPPUNIT_TEST(TestConcurrent);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestPushShift() {
+		MusicBuffer buffer(16, DEFAULT_CHUNK_SIZE);
+		MusicPipe pipe;
+
+		CPPUNIT_ASSERT(pipe.IsEmpty());
+		CPPUNIT_ASSERT(pipe.Shift() == nullptr);
+
+		for (uint32_t i = 0; i < 3; ++i)
+			pipe.Push(MakeChunk(buffer, i));
+
+		CPPUNIT_ASSERT_EQUAL(3u, pipe.GetSize());
+		CPPUNIT_ASSERT_EQUAL(0u, GetValue(*pipe.Peek()));
+
+		uint64_t serial = 0;
+		for (uint32_t i = 0; i < 3; ++i) {
+			MusicChunk *chunk = pipe.Shift();
+			CPPUNIT_ASSERT(chunk != nullptr);
+			CPPUNIT_ASSERT_EQUAL(i, GetValue(*chunk));
+			CPPUNIT_ASSERT(chunk->serial > serial);
+			serial = chunk->serial;
+			buffer.Return(chunk);
+		}
+
+		CPPUNIT_ASSERT(pipe.IsEmpty());
+		CPPUNIT_ASSERT(pipe.Peek() == nullptr);
+		CPPUNIT_ASSERT(pipe.Shift() == nullptr);
+
+		/* the pipe is usable again after it has run empty */
+		pipe.Push(MakeChunk(buffer, 42));
+		MusicChunk *chunk = pipe.Shift();
+		CPPUNIT_ASSERT(chunk != nullptr);
+		CPPUNIT_ASSERT_EQUAL(42u, GetValue(*chunk));
+		buffer.Return(chunk);
+	}
+
+	void TestClear() {
+		MusicBuffer buffer(16, DEFAULT_CHUNK_SIZE);
+		MusicPipe pipe;
+
+		for (uint32_t i = 0; i < 8; ++i)
+			pipe.Push(MakeChunk(buffer, i));
+
+		pipe.Clear(buffer);
+		CPPUNIT_ASSERT(pipe.IsEmpty());
+		CPPUNIT_ASSERT(pipe.Peek() == nullptr);
+	}
+
+	/**
+	 * One thread pushes, another one shifts at the same time;
+	 * the small buffer keeps the pipe close to empty, so the
+	 * race between Push() and the removal of the last chunk is
+	 * hit often.
+	 */
+	void TestConcurrent() {
+		static constexpr uint32_t N = 200000;
+
+		MusicBuffer buffer(4, DEFAULT_CHUNK_SIZE);
+		MusicPipe pipe;
+
+		std::thread producer([&buffer, &pipe](){
+				for (uint32_t i = 0; i < N; ++i)
+					pipe.Push(MakeChunk(buffer, i));
+			});
+
+		uint64_t serial = 0;
+		for (uint32_t i = 0; i < N;) {
+			MusicChunk *chunk = pipe.Shift();
+			if (chunk == nullptr) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			CPPUNIT_ASSERT_EQUAL(i, GetValue(*chunk));
+			CPPUNIT_ASSERT(chunk->serial > serial);
+			serial = chunk->serial;
+			buffer.Return(chunk);
+			++i;
+		}
+
+		producer.join();
+
+		CPPUNIT_ASSERT(pipe.IsEmpty());
+		CPPUNIT_ASSERT(pipe.Shift() == nullptr);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MusicPipeTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,95 @@
+/*
+ * Unit tests for class PageRing.
+ */
+
+#include "config.h"
+#include "output/plugins/httpd/PageRing.hxx"
+#include "output/plugins/httpd/Page.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdlib.h>
+
+class PageRingTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PageRingTest);
+	CPPUNIT_TEST(TestPush);
+	CPPUNIT_TEST(TestFindTime);
+	CPPUNIT_TEST(TestOverflow);
+	CPPUNIT_TEST_SUITE_END();
+
+	static void Push(PageRing &ring, size_t size, uint64_t time) {
+		static char buffer[256];
+		Page *page = Page::Copy(buffer, size);
+		ring.Push(*page, time);
+		page->Unref();
+	}
+
+public:
+	void TestPush() {
+		PageRing ring;
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), ring.GetHead());
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), ring.GetRemaining(0));
+
+		Push(ring, 10, 100);
+		Push(ring, 20, 200);
+		Push(ring, 30, 300);
+
+		CPPUNIT_ASSERT_EQUAL(uint64_t(3), ring.GetHead());
+		CPPUNIT_ASSERT_EQUAL(uint64_t(60), ring.GetRemaining(0));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(50), ring.GetRemaining(1));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), ring.GetRemaining(3));
+		CPPUNIT_ASSERT_EQUAL(size_t(20), ring.Get(1).size);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(200), ring.GetTime(1));
+
+		ring.Clear();
+		CPPUNIT_ASSERT_EQUAL(uint64_t(3), ring.GetTail());
+		CPPUNIT_ASSERT_EQUAL(uint64_t(3), ring.GetHead());
+	}
+
+	void TestFindTime() {
+		PageRing ring;
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), ring.FindTime(0, 0));
+
+		for (unsigned i = 0; i < 100; ++i)
+			Push(ring, 1, (i + 1) * 10);
+
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), ring.FindTime(0, 0));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), ring.FindTime(0, 10));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(1), ring.FindTime(0, 11));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(49), ring.FindTime(0, 500));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(60), ring.FindTime(60, 500));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(99), ring.FindTime(0, 1000));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(100), ring.FindTime(0, 1001));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(100), ring.FindTime(100, 0));
+	}
+
+	void TestOverflow() {
+		PageRing ring;
+
+		for (unsigned i = 0; i < 3000; ++i)
+			Push(ring, 2, i);
+
+		/* the oldest pages have been dropped */
+		const uint64_t tail = ring.GetTail();
+		CPPUNIT_ASSERT(tail > 0);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(3000), ring.GetHead());
+		CPPUNIT_ASSERT_EQUAL((3000 - tail) * 2, ring.GetRemaining(tail));
+		CPPUNIT_ASSERT_EQUAL(tail, ring.FindTime(tail, 0));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(2500), ring.FindTime(tail, 2500));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PageRingTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
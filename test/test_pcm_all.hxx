@@ -38,11 +38,15 @@ class PcmPackTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(PcmPackTest);
 	CPPUNIT_TEST(TestPack24);
 	CPPUNIT_TEST(TestUnpack24);
+	CPPUNIT_TEST(TestSimd);
+	CPPUNIT_TEST(TestPackInPlace);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void TestPack24();
 	void TestUnpack24();
+	void TestSimd();
+	void TestPackInPlace();
 };
 
 class PcmChannelsTest : public CppUnit::TestFixture {
@@ -63,6 +67,7 @@ class PcmVolumeTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(TestVolume24);
 	CPPUNIT_TEST(TestVolume32);
 	CPPUNIT_TEST(TestVolumeFloat);
+	CPPUNIT_TEST(TestInPlace);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -71,6 +76,7 @@ public:
 	void TestVolume24();
 	void TestVolume32();
 	void TestVolumeFloat();
+	void TestInPlace();
 };
 
 class PcmFormatTest : public CppUnit::TestFixture {
@@ -103,12 +109,96 @@ public:
 	void TestMix32();
 };
 
+class PcmSimdTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmSimdTest);
+	CPPUNIT_TEST(TestVolumeFloat);
+	CPPUNIT_TEST(TestAddVolumeFloat);
+	CPPUNIT_TEST(TestAddFloat);
+	CPPUNIT_TEST(TestAdd16);
+	CPPUNIT_TEST(TestFloatToInteger);
+	CPPUNIT_TEST(TestIntegerToFloat);
+	CPPUNIT_TEST(TestDsd2Pcm);
+	CPPUNIT_TEST(TestDop);
+	CPPUNIT_TEST(TestDeinterleave);
+	CPPUNIT_TEST(TestDot);
+	CPPUNIT_TEST(TestComplexMac);
+	CPPUNIT_TEST(TestBiquad);
+	CPPUNIT_TEST(TestMonoStereo);
+	CPPUNIT_TEST(TestRoute);
+	CPPUNIT_TEST(TestPeak);
+	CPPUNIT_TEST(TestGain16);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestVolumeFloat();
+	void TestAddVolumeFloat();
+	void TestAddFloat();
+	void TestAdd16();
+	void TestFloatToInteger();
+	void TestIntegerToFloat();
+	void TestDsd2Pcm();
+	void TestDop();
+	void TestDeinterleave();
+	void TestDot();
+	void TestComplexMac();
+	void TestBiquad();
+	void TestMonoStereo();
+	void TestRoute();
+	void TestPeak();
+	void TestGain16();
+};
+
+class PcmNormalizerTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmNormalizerTest);
+	CPPUNIT_TEST(TestAmplify);
+	CPPUNIT_TEST(TestFormats);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestAmplify();
+	void TestFormats();
+};
+
+class PcmLoudnessMeterTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmLoudnessMeterTest);
+	CPPUNIT_TEST(TestSine);
+	CPPUNIT_TEST(TestGate);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestSine();
+	void TestGate();
+};
+
+class PcmMixRampMeterTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmMixRampMeterTest);
+	CPPUNIT_TEST(TestFade);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestFade();
+};
+
+#ifdef ENABLE_DSD
+class PcmDsdTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmDsdTest);
+	CPPUNIT_TEST(TestToFloat);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestToFloat();
+};
+#endif
+
 class PcmExportTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(PcmExportTest);
 	CPPUNIT_TEST(TestShift8);
 	CPPUNIT_TEST(TestPack24);
 	CPPUNIT_TEST(TestReverseEndian);
 	CPPUNIT_TEST(TestDop);
+	CPPUNIT_TEST(TestDopChannels);
+	CPPUNIT_TEST(TestDsdPack);
+	CPPUNIT_TEST(TestExportTo);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -116,6 +206,55 @@ public:
 	void TestPack24();
 	void TestReverseEndian();
 	void TestDop();
+	void TestDopChannels();
+	void TestDsdPack();
+	void TestExportTo();
+};
+
+class PcmResamplerCacheTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmResamplerCacheTest);
+	CPPUNIT_TEST(TestReuse);
+	CPPUNIT_TEST(TestEvict);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestReuse();
+	void TestEvict();
+};
+
+class PcmPolyphaseResamplerTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmPolyphaseResamplerTest);
+	CPPUNIT_TEST(TestSine);
+	CPPUNIT_TEST(TestReset);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestSine();
+	void TestReset();
+};
+
+class PcmConvolverTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmConvolverTest);
+	CPPUNIT_TEST(TestFft);
+	CPPUNIT_TEST(TestConvolve);
+	CPPUNIT_TEST(TestReset);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestFft();
+	void TestConvolve();
+	void TestReset();
+};
+
+class PcmEqualizerTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmEqualizerTest);
+	CPPUNIT_TEST(TestPeak);
+	CPPUNIT_TEST(TestUpdate);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestPeak();
+	void TestUpdate();
 };
 
 #endif
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "test_pcm_util.hxx"
+#include "pcm/Fft.hxx"
+#include "pcm/Convolver.hxx"
+
+#include <vector>
+
+#include <math.h>
+
+/**
+ * The reference: direct convolution of the whole signal.
+ */
+static std::vector<float>
+Convolve(const std::vector<float> &x, const std::vector<float> &h)
+{
+	std::vector<float> y(x.size());
+	for (size_t n = 0; n < x.size(); ++n) {
+		double sum = 0;
+		for (size_t k = 0; k < h.size() && k <= n; ++k)
+			sum += h[k] * x[n - k];
+		y[n] = sum;
+	}
+
+	return y;
+}
+
+template<size_t N>
+static std::vector<float>
+ToVector(const TestDataBuffer<float, N> &src)
+{
+	return std::vector<float>(src.begin(), src.end());
+}
+
+void
+PcmConvolverTest::TestFft()
+{
+	static constexpr unsigned N = 256;
+	const auto x = TestDataBuffer<float, N>(RandomFloat());
+
+	RealFft fft(N);
+	CPPUNIT_ASSERT_EQUAL(N / 2 + 1, fft.GetBins());
+
+	float re[N / 2 + 1], im[N / 2 + 1];
+	fft.Forward(x, re, im);
+
+	/* compare with the discrete Fourier transform */
+	for (unsigned k = 0; k <= N / 2; ++k) {
+		double sum_re = 0, sum_im = 0;
+		for (unsigned t = 0; t < N; ++t) {
+			const double phi = -2 * M_PI * k * t / N;
+			sum_re += x[t] * cos(phi);
+			sum_im += x[t] * sin(phi);
+		}
+
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(sum_re, re[k], 1e-4);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(sum_im, im[k], 1e-4);
+	}
+
+	/* the inverse transform is scaled by the size */
+	float y[N];
+	fft.Inverse(re, im, y);
+	for (unsigned t = 0; t < N; ++t)
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(x[t], y[t] / N, 1e-5);
+}
+
+void
+PcmConvolverTest::TestConvolve()
+{
+	const auto x = ToVector(TestDataBuffer<float, 4096>(RandomFloat()));
+	const auto ir = ToVector(TestDataBuffer<float, 1000>(RandomFloat()));
+
+	/* impulse responses shorter than, equal to and longer than
+	   one partition */
+	for (size_t length : {1, 37, 64, 1000}) {
+		const std::vector<float> h(ir.begin(), ir.begin() + length);
+		const auto expected = Convolve(x, h);
+
+		PartitionedConvolver convolver(h.data(), h.size(), 64);
+		CPPUNIT_ASSERT_EQUAL(64u, convolver.GetBlockSize());
+
+		std::vector<float> y(x);
+		for (size_t i = 0; i < y.size(); i += 64)
+			/* in-place */
+			convolver.Process(&y[i], &y[i]);
+
+		for (size_t i = 0; i < y.size(); ++i)
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[i], y[i], 1e-4);
+	}
+}
+
+void
+PcmConvolverTest::TestReset()
+{
+	const auto x = ToVector(TestDataBuffer<float, 512>(RandomFloat()));
+	const auto h = ToVector(TestDataBuffer<float, 100>(RandomFloat()));
+
+	PartitionedConvolver convolver(h.data(), h.size(), 32);
+
+	std::vector<float> first(x.size()), second(x.size());
+	for (size_t i = 0; i < x.size(); i += 32)
+		convolver.Process(&x[i], &first[i]);
+
+	/* after Reset(), the history is gone and the output repeats */
+	convolver.Reset();
+	for (size_t i = 0; i < x.size(); i += 32)
+		convolver.Process(&x[i], &second[i]);
+
+	for (size_t i = 0; i < x.size(); ++i)
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(first[i], second[i], 1e-6);
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "test_pcm_util.hxx"
+#include "pcm/PcmDsd.hxx"
+#include "pcm/dsd2pcm/dsd2pcm.h"
+
+#include <array>
+
+void
+PcmDsdTest::TestToFloat()
+{
+	static constexpr unsigned CHANNELS = 2, FRAMES = 1000;
+	const auto src = TestDataBuffer<uint8_t, CHANNELS * FRAMES>();
+
+	/* the reference: the original dsd2pcm implementation */
+	std::array<float, CHANNELS * FRAMES> expected;
+	for (unsigned c = 0; c < CHANNELS; ++c) {
+		dsd2pcm_ctx *ctx = dsd2pcm_init();
+		dsd2pcm_translate(ctx, FRAMES, src.begin() + c, CHANNELS,
+				  false, expected.begin() + c, CHANNELS);
+		dsd2pcm_destroy(ctx);
+	}
+
+	/* convert in chunks of various sizes to check that the
+	   history is carried over correctly */
+	static constexpr unsigned chunks[] = { 1, 3, 8, 17, 200, 771 };
+
+	PcmDsd dsd;
+	unsigned position = 0;
+	for (unsigned n : chunks) {
+		auto result = dsd.ToFloat(CHANNELS,
+					  { src.begin() + position * CHANNELS,
+					    n * CHANNELS });
+		CPPUNIT_ASSERT_EQUAL(size_t(n * CHANNELS), result.size);
+
+		for (unsigned i = 0; i < result.size; ++i)
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[position * CHANNELS + i],
+						     result.data[i], 1e-5);
+
+		position += n;
+	}
+
+	CPPUNIT_ASSERT_EQUAL(FRAMES, position);
+
+	/* after Reset(), the output starts from scratch */
+	dsd.Reset();
+	auto result = dsd.ToFloat(CHANNELS, { src.begin(), 64 * CHANNELS });
+	for (unsigned i = 0; i < result.size; ++i)
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[i], result.data[i], 1e-5);
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "pcm/Equalizer.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <algorithm>
+#include <vector>
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+static constexpr unsigned SAMPLE_RATE = 48000;
+static constexpr unsigned CHANNELS = 2;
+static constexpr unsigned FRAMES = 9600;
+
+/**
+ * Generate a stereo sine wave; the right channel has half the
+ * amplitude.
+ */
+template<typename T>
+static std::vector<T>
+Sine(double frequency, double amplitude)
+{
+	std::vector<T> v(FRAMES * CHANNELS);
+	for (unsigned i = 0; i < FRAMES; ++i) {
+		const double x = amplitude *
+			sin(2 * M_PI * frequency * i / SAMPLE_RATE);
+		v[i * CHANNELS] = T(x);
+		v[i * CHANNELS + 1] = T(x / 2);
+	}
+
+	return v;
+}
+
+/**
+ * Filter in chunks, to check that the state is carried over.
+ */
+template<typename T>
+static void
+Apply(PcmEqualizer &eq, std::vector<T> &v)
+{
+	for (size_t i = 0; i < v.size(); i += 1000 * CHANNELS) {
+		const size_t n = std::min<size_t>(1000 * CHANNELS,
+						  v.size() - i);
+		eq.Apply(&v[i], n * sizeof(T));
+	}
+}
+
+/**
+ * Returns the peak of one channel in the second half of the
+ * buffer, after the filter has settled.
+ */
+template<typename T>
+static double
+Peak(const std::vector<T> &v, unsigned channel)
+{
+	double peak = 0;
+	for (unsigned i = FRAMES / 2; i < FRAMES; ++i)
+		peak = std::max(peak, fabs(double(v[i * CHANNELS + channel])));
+	return peak;
+}
+
+template<typename T>
+static void
+TestPeakFormat(SampleFormat format, double amplitude)
+{
+	const EqualizerBand band = {
+		EqualizerBandType::PEAK, 1000, 6, 1,
+	};
+
+	PcmEqualizer eq;
+	eq.Open(format, CHANNELS, SAMPLE_RATE);
+	eq.SetBands({&band, 1});
+
+	/* +6 dB at the center frequency */
+	auto v = Sine<T>(1000, amplitude);
+	Apply(eq, v);
+	const double gain = pow(10, 6. / 20);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(amplitude * gain, Peak(v, 0),
+				     amplitude * 0.02);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(amplitude * gain / 2, Peak(v, 1),
+				     amplitude * 0.01);
+
+	/* almost no change far away */
+	eq.Reset();
+	v = Sine<T>(50, amplitude);
+	Apply(eq, v);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(amplitude, Peak(v, 0), amplitude * 0.03);
+}
+
+void
+PcmEqualizerTest::TestPeak()
+{
+	TestPeakFormat<float>(SampleFormat::FLOAT, 0.25);
+	TestPeakFormat<int32_t>(SampleFormat::S32, 1 << 28);
+}
+
+void
+PcmEqualizerTest::TestUpdate()
+{
+	EqualizerBand bands[] = {
+		{ EqualizerBandType::LOW_SHELF, 100, 0, 0.707f },
+		{ EqualizerBandType::PEAK, 1000, 0, 1 },
+	};
+
+	PcmEqualizer eq;
+	eq.Open(SampleFormat::FLOAT, CHANNELS, SAMPLE_RATE);
+	eq.SetBands({bands, 2});
+
+	/* 0 dB bands are skipped, the signal is unmodified */
+	const auto src = Sine<float>(1000, 0.5);
+	auto v = src;
+	Apply(eq, v);
+	CPPUNIT_ASSERT(v == src);
+
+	/* change the gain without reopening */
+	bands[1].gain = -6;
+	eq.SetBands({bands, 2});
+	Apply(eq, v);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5 * pow(10, -6. / 20), Peak(v, 0),
+				     0.01);
+}
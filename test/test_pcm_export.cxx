@@ -19,7 +19,10 @@
 
 #include "config.h"
 #include "test_pcm_all.hxx"
+#include "test_pcm_util.hxx"
 #include "pcm/PcmExport.hxx"
+#include "pcm/PcmDop.hxx"
+#include "pcm/PcmBuffer.hxx"
 #include "system/ByteOrder.hxx"
 #include "util/ConstBuffer.hxx"
 
@@ -127,3 +130,155 @@ PcmExportTest::TestDop()
 	CPPUNIT_ASSERT_EQUAL(sizeof(expected), dest.size);
 	CPPUNIT_ASSERT(memcmp(dest.data, expected, dest.size) == 0);
 }
+
+/**
+ * Check pcm_dsd_to_dop() with an odd channel count and trailing
+ * frames.
+ */
+void
+PcmExportTest::TestDopChannels()
+{
+	static constexpr unsigned CHANNELS = 3, FRAMES = 23;
+	const auto src = TestDataBuffer<uint8_t, CHANNELS * FRAMES>();
+
+	PcmBuffer buffer;
+	auto dest = pcm_dsd_to_dop(buffer, CHANNELS,
+				   { src.begin(), src.size() });
+
+	/* trailing frames which do not fill a whole block are
+	   discarded */
+	static constexpr unsigned BLOCKS = FRAMES / 4;
+	CPPUNIT_ASSERT_EQUAL(size_t(BLOCKS * 2 * CHANNELS), dest.size);
+
+	for (unsigned b = 0; b < BLOCKS; ++b) {
+		const uint8_t *s = src.begin() + b * 4 * CHANNELS;
+		const uint32_t *d = dest.data + b * 2 * CHANNELS;
+
+		for (unsigned c = 0; c < CHANNELS; ++c) {
+			CPPUNIT_ASSERT_EQUAL(uint32_t(0xff050000 |
+						      (s[c] << 8) |
+						      s[CHANNELS + c]),
+					     d[c]);
+			CPPUNIT_ASSERT_EQUAL(uint32_t(0xfffa0000 |
+						      (s[2 * CHANNELS + c] << 8) |
+						      s[3 * CHANNELS + c]),
+					     d[CHANNELS + c]);
+		}
+	}
+}
+
+void
+PcmExportTest::TestDsdPack()
+{
+	static constexpr uint8_t src[] = {
+		0x01, 0x23, 0x45, 0x67,
+		0x89, 0xab, 0xcd, 0xef,
+		0x11, 0x22,
+	};
+
+	static constexpr uint8_t expected_u16_be[] = {
+		0x01, 0x45, 0x23, 0x67,
+		0x89, 0xcd, 0xab, 0xef,
+	};
+
+	static constexpr uint8_t expected_u16_le[] = {
+		0x45, 0x01, 0x67, 0x23,
+		0xcd, 0x89, 0xef, 0xab,
+	};
+
+	static constexpr uint8_t expected_u32_be[] = {
+		0x01, 0x45, 0x89, 0xcd,
+		0x23, 0x67, 0xab, 0xef,
+	};
+
+	static constexpr uint8_t expected_u32_le[] = {
+		0xcd, 0x89, 0x45, 0x01,
+		0xef, 0xab, 0x67, 0x23,
+	};
+
+	PcmExport e;
+
+	/* the trailing frame does not fill a whole sample and is
+	   discarded */
+	e.Open(SampleFormat::DSD, 2, false, false, false, false, 2);
+	CPPUNIT_ASSERT_EQUAL(size_t(4),
+			     e.GetFrameSize(AudioFormat(352800,
+							SampleFormat::DSD,
+							2)));
+	auto dest = e.Export({src, sizeof(src)});
+	CPPUNIT_ASSERT_EQUAL(sizeof(expected_u16_be), dest.size);
+	CPPUNIT_ASSERT(memcmp(dest.data, expected_u16_be, dest.size) == 0);
+
+	e.Open(SampleFormat::DSD, 2, false, false, false, true, 2);
+	dest = e.Export({src, sizeof(src)});
+	CPPUNIT_ASSERT_EQUAL(sizeof(expected_u16_le), dest.size);
+	CPPUNIT_ASSERT(memcmp(dest.data, expected_u16_le, dest.size) == 0);
+
+	e.Open(SampleFormat::DSD, 2, false, false, false, false, 4);
+	dest = e.Export({src, sizeof(src)});
+	CPPUNIT_ASSERT_EQUAL(sizeof(expected_u32_be), dest.size);
+	CPPUNIT_ASSERT(memcmp(dest.data, expected_u32_be, dest.size) == 0);
+
+	e.Open(SampleFormat::DSD, 2, false, false, false, true, 4);
+	dest = e.Export({src, sizeof(src)});
+	CPPUNIT_ASSERT_EQUAL(sizeof(expected_u32_le), dest.size);
+	CPPUNIT_ASSERT(memcmp(dest.data, expected_u32_le, dest.size) == 0);
+
+	uint8_t buffer[sizeof(src)];
+	CPPUNIT_ASSERT_EQUAL(sizeof(expected_u32_le),
+			     e.CalcOutputSize(sizeof(src)));
+	CPPUNIT_ASSERT_EQUAL(sizeof(expected_u32_le),
+			     e.ExportTo({src, sizeof(src)}, buffer));
+	CPPUNIT_ASSERT(memcmp(buffer, expected_u32_le,
+			      sizeof(expected_u32_le)) == 0);
+}
+
+/**
+ * Check that ExportTo() and CalcOutputSize() agree with Export().
+ */
+static void
+CheckExportTo(PcmExport &e, ConstBuffer<void> src)
+{
+	uint8_t buffer[256];
+
+	const size_t size = e.ExportTo(src, buffer);
+	CPPUNIT_ASSERT_EQUAL(e.CalcOutputSize(src.size), size);
+	CPPUNIT_ASSERT_EQUAL(src.size, e.CalcSourceSize(size));
+
+	auto dest = e.Export(src);
+	CPPUNIT_ASSERT_EQUAL(dest.size, size);
+	CPPUNIT_ASSERT(memcmp(dest.data, buffer, size) == 0);
+}
+
+void
+PcmExportTest::TestExportTo()
+{
+	static constexpr int32_t src[] = {
+		0x0, 0x1, 0x100, 0x10000, 0xffffff, 0x123456, 0x7fffff, 0x800000,
+	};
+
+	PcmExport e;
+	e.Open(SampleFormat::S24_P32, 2, false, false, false, false);
+	CheckExportTo(e, {src, sizeof(src)});
+
+	e.Open(SampleFormat::S24_P32, 2, false, true, false, false);
+	CheckExportTo(e, {src, sizeof(src)});
+
+	e.Open(SampleFormat::S24_P32, 2, false, false, true, false);
+	CheckExportTo(e, {src, sizeof(src)});
+
+	e.Open(SampleFormat::S24_P32, 2, false, false, true, true);
+	CheckExportTo(e, {src, sizeof(src)});
+
+	e.Open(SampleFormat::S16, 2, false, false, false, true);
+	CheckExportTo(e, {src, sizeof(src)});
+
+	e.Open(SampleFormat::DSD, 2, true, false, false, false);
+	CheckExportTo(e, {src, sizeof(src)});
+
+	e.Open(SampleFormat::DSD, 2, true, true, false, true);
+	CheckExportTo(e, {src, sizeof(src)});
+
+	e.Open(SampleFormat::DSD, 2, false, false, false, true, 4);
+	CheckExportTo(e, {src, sizeof(src)});
+}
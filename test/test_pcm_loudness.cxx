@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "pcm/LoudnessMeter.hxx"
+
+#include <memory>
+#include <vector>
+
+#include <math.h>
+
+/**
+ * Feed a 1 kHz sine wave into all channels.
+ *
+ * @param dbfs the amplitude of the sine wave
+ * @param seconds the duration
+ */
+static void
+FeedSine(PcmLoudnessMeter &meter, unsigned sample_rate, unsigned channels,
+	 double dbfs, double seconds)
+{
+	const float amplitude = pow(10., dbfs / 20.);
+	const size_t frames = sample_rate * seconds;
+
+	std::vector<float> buffer(4096 * channels);
+	for (size_t done = 0; done < frames;) {
+		/* odd chunk sizes to cross the sub-block boundaries */
+		const size_t n = std::min<size_t>(frames - done, 3001);
+		for (size_t i = 0; i < n; ++i) {
+			const float x = amplitude *
+				sin(2 * M_PI * 1000. * (done + i) / sample_rate);
+			for (unsigned c = 0; c < channels; ++c)
+				buffer[i * channels + c] = x;
+		}
+
+		meter.Process(buffer.data(), n);
+		done += n;
+	}
+}
+
+void
+PcmLoudnessMeterTest::TestSine()
+{
+	/* EBU Tech 3341, test case 1: a stereo sine wave at -23 dBFS
+	   measures -23 LUFS */
+	std::unique_ptr<PcmLoudnessMeter> meter(new PcmLoudnessMeter());
+	double loudness;
+	meter->Open(48000, 2);
+	FeedSine(*meter, 48000, 2, -23, 20);
+
+	CPPUNIT_ASSERT(meter->GetIntegratedLoudness(loudness));
+	CPPUNIT_ASSERT(fabs(loudness + 23) < 0.1);
+	CPPUNIT_ASSERT(fabs(meter->GetPeak() - pow(10., -23 / 20.)) < 0.001);
+
+	/* the filters adapt to the sample rate */
+	meter->Open(44100, 2);
+	FeedSine(*meter, 44100, 2, -23, 20);
+	CPPUNIT_ASSERT(meter->GetIntegratedLoudness(loudness));
+	CPPUNIT_ASSERT(fabs(loudness + 23) < 0.1);
+}
+
+void
+PcmLoudnessMeterTest::TestGate()
+{
+	std::unique_ptr<PcmLoudnessMeter> meter(new PcmLoudnessMeter());
+	double loudness;
+
+	/* silence is below the absolute gate */
+	meter->Open(48000, 2);
+	FeedSine(*meter, 48000, 2, -120, 5);
+	CPPUNIT_ASSERT(!meter->GetIntegratedLoudness(loudness));
+
+	/* EBU Tech 3341, test case 3: the quiet parts are below the
+	   relative gate */
+	meter->Open(48000, 2);
+	FeedSine(*meter, 48000, 2, -36, 10);
+	FeedSine(*meter, 48000, 2, -23, 60);
+	FeedSine(*meter, 48000, 2, -36, 10);
+	CPPUNIT_ASSERT(meter->GetIntegratedLoudness(loudness));
+	CPPUNIT_ASSERT(fabs(loudness + 23) < 0.1);
+
+	/* the LFE channel of 5.1 is not measured */
+	meter->Open(48000, 6);
+	std::vector<float> buffer(48000 * 6);
+	for (size_t i = 0; i < 48000; ++i)
+		buffer[i * 6 + 3] = sin(2 * M_PI * 50. * i / 48000);
+	meter->Process(buffer.data(), 48000);
+	CPPUNIT_ASSERT(!meter->GetIntegratedLoudness(loudness));
+	CPPUNIT_ASSERT(meter->GetPeak() > 0.99f);
+}
@@ -17,6 +17,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "config.h"
 #include "test_pcm_all.hxx"
 #include "Compiler.h"
 
@@ -31,7 +32,18 @@ CPPUNIT_TEST_SUITE_REGISTRATION(PcmChannelsTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmVolumeTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmFormatTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmMixTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmSimdTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmNormalizerTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmLoudnessMeterTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmMixRampMeterTest);
+#ifdef ENABLE_DSD
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmDsdTest);
+#endif
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmExportTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmResamplerCacheTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmPolyphaseResamplerTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmConvolverTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmEqualizerTest);
 
 int
 main(gcc_unused int argc, gcc_unused char **argv)
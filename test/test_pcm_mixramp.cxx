@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "pcm/MixRampMeter.hxx"
+
+#include <vector>
+
+#include <math.h>
+
+/**
+ * Feed a 1 kHz sine wave (or silence) into all channels.
+ */
+static void
+FeedSine(PcmMixRampMeter &meter, unsigned sample_rate, unsigned channels,
+	 double dbfs, double seconds)
+{
+	const float amplitude = dbfs > -200 ? pow(10., dbfs / 20.) : 0;
+	const size_t frames = sample_rate * seconds;
+
+	std::vector<float> buffer(frames * channels);
+	for (size_t i = 0; i < frames; ++i) {
+		const float x = amplitude *
+			sin(2 * M_PI * 1000. * i / sample_rate);
+		for (unsigned c = 0; c < channels; ++c)
+			buffer[i * channels + c] = x;
+	}
+
+	/* odd chunk sizes to cross the block boundaries */
+	for (size_t done = 0; done < frames;) {
+		const size_t n = std::min<size_t>(frames - done, 1234);
+		meter.Process(buffer.data() + done * channels, n);
+		done += n;
+	}
+}
+
+void
+PcmMixRampMeterTest::TestFade()
+{
+	PcmMixRampMeter meter;
+	meter.Open(44100, 2);
+
+	/* 1 s silence, 1 s at -30 dBFS, 3 s at -6 dBFS, 2 s silence;
+	   the mean square of a sine is 3 dB below its peak */
+	FeedSine(meter, 44100, 2, -1000, 1);
+	FeedSine(meter, 44100, 2, -30, 1);
+	FeedSine(meter, 44100, 2, -6, 3);
+	FeedSine(meter, 44100, 2, -1000, 2);
+
+	CPPUNIT_ASSERT(fabs(meter.FindStart(-40) - 1) < 0.01);
+	CPPUNIT_ASSERT(fabs(meter.FindStart(-20) - 2) < 0.01);
+	CPPUNIT_ASSERT(fabs(meter.FindEnd(-40) - 2) < 0.01);
+	CPPUNIT_ASSERT(fabs(meter.FindEnd(-20) - 2) < 0.01);
+
+	/* never reached */
+	CPPUNIT_ASSERT(meter.FindStart(-3) < 0);
+	CPPUNIT_ASSERT(meter.FindEnd(-3) < 0);
+}
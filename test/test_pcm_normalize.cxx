@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "pcm/Normalizer.hxx"
+
+#include <algorithm>
+#include <vector>
+
+#include <math.h>
+#include <stdint.h>
+
+static constexpr unsigned SAMPLES = 4096;
+
+/**
+ * Generate a quiet sine wave (peak 0.05 of full scale).
+ */
+static void
+QuietSine(float *dest, unsigned n, unsigned offset)
+{
+	for (unsigned i = 0; i < n; ++i)
+		dest[i] = 0.05f * sinf((offset + i) * 0.05f);
+}
+
+void
+PcmNormalizerTest::TestAmplify()
+{
+	PcmNormalizer normalizer;
+	normalizer.Open(SampleFormat::S16);
+
+	float peak = 0, last_peak = 0;
+	int16_t buffer[SAMPLES];
+	for (unsigned round = 0; round < 200; ++round) {
+		float f[SAMPLES];
+		QuietSine(f, SAMPLES, round * SAMPLES);
+		for (unsigned i = 0; i < SAMPLES; ++i)
+			buffer[i] = int16_t(lrintf(f[i] * 32767));
+
+		normalizer.Process(buffer, sizeof(buffer));
+
+		const int16_t *m =
+			std::max_element(buffer, buffer + SAMPLES,
+					 [](int16_t a, int16_t b){
+						 return abs(a) < abs(b);
+					 });
+		last_peak = abs(*m) / 32767.0f;
+		peak = std::max(peak, last_peak);
+	}
+
+	/* the gain approaches the target level (0.5) slowly, and
+	   never overshoots full scale */
+	CPPUNIT_ASSERT(last_peak > 0.3f);
+	CPPUNIT_ASSERT(peak < 0.6f);
+}
+
+/**
+ * Compare S16, S24_P32, S32 and FLOAT processing of the same
+ * signal; they must agree within the resolution of 16 bit.
+ */
+void
+PcmNormalizerTest::TestFormats()
+{
+	PcmNormalizer n16, n24, n32, nf;
+	n16.Open(SampleFormat::S16);
+	n24.Open(SampleFormat::S24_P32);
+	n32.Open(SampleFormat::S32);
+	nf.Open(SampleFormat::FLOAT);
+
+	for (unsigned round = 0; round < 50; ++round) {
+		float f[SAMPLES];
+		QuietSine(f, SAMPLES, round * SAMPLES);
+
+		int16_t b16[SAMPLES];
+		int32_t b24[SAMPLES], b32[SAMPLES];
+		for (unsigned i = 0; i < SAMPLES; ++i) {
+			b16[i] = int16_t(lrintf(f[i] * 32767));
+			b24[i] = int32_t(lrintf(f[i] * 8388607));
+			b32[i] = int32_t(lrint(f[i] * 2147483647.0));
+		}
+
+		n16.Process(b16, sizeof(b16));
+		n24.Process(b24, sizeof(b24));
+		n32.Process(b32, sizeof(b32));
+		nf.Process(f, sizeof(f));
+
+		for (unsigned i = 0; i < SAMPLES; ++i) {
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(f[i], b16[i] / 32767.0,
+						     0.002);
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(f[i], b24[i] / 8388607.0,
+						     0.0005);
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(f[i],
+						     b32[i] / 2147483647.0,
+						     0.0005);
+		}
+	}
+}
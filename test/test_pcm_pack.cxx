@@ -20,8 +20,13 @@
 #include "test_pcm_all.hxx"
 #include "test_pcm_util.hxx"
 #include "pcm/PcmPack.hxx"
+#include "pcm/Simd.hxx"
 #include "system/ByteOrder.hxx"
 
+#include <algorithm>
+
+#include <string.h>
+
 void
 PcmPackTest::TestPack24()
 {
@@ -69,3 +74,46 @@ PcmPackTest::TestUnpack24()
 		CPPUNIT_ASSERT_EQUAL(s, dest[i]);
 	}
 }
+
+void
+PcmPackTest::TestSimd()
+{
+	/* all lengths around the vector sizes, to check the tails */
+	constexpr unsigned N = 67;
+	const auto src24 = TestDataBuffer<int32_t, N>(RandomInt24());
+	const auto src8 = TestDataBuffer<uint8_t, N * 3>();
+
+	const PcmSimd &simd = GetPcmSimd();
+
+	for (unsigned n = 0; n <= N; ++n) {
+		uint8_t expected8[N * 3], result8[N * 3];
+		memset(expected8, 0xa5, sizeof(expected8));
+		memset(result8, 0xa5, sizeof(result8));
+		pcm_simd_portable.pack_24(expected8, src24.begin(), n);
+		simd.pack_24(result8, src24.begin(), n);
+		CPPUNIT_ASSERT(memcmp(expected8, result8, sizeof(result8)) == 0);
+
+		int32_t expected32[N], result32[N];
+		memset(expected32, 0xa5, sizeof(expected32));
+		memset(result32, 0xa5, sizeof(result32));
+		pcm_simd_portable.unpack_24(expected32, src8.begin(), n);
+		simd.unpack_24(result32, src8.begin(), n);
+		CPPUNIT_ASSERT(memcmp(expected32, result32,
+				      sizeof(result32)) == 0);
+	}
+}
+
+void
+PcmPackTest::TestPackInPlace()
+{
+	constexpr unsigned N = 509;
+	const auto src = TestDataBuffer<int32_t, N>(RandomInt24());
+
+	uint8_t expected[N * 3];
+	pcm_pack_24(expected, src.begin(), src.end());
+
+	int32_t buffer[N];
+	std::copy_n(src.begin(), N, buffer);
+	pcm_pack_24((uint8_t *)buffer, buffer, buffer + N);
+	CPPUNIT_ASSERT(memcmp(expected, buffer, sizeof(expected)) == 0);
+}
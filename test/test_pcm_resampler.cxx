@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "pcm/ResamplerCache.hxx"
+#include "pcm/Resampler.hxx"
+#include "pcm/PolyphaseResampler.hxx"
+#include "util/Error.hxx"
+
+#include <vector>
+
+#include <math.h>
+
+/**
+ * A #PcmResampler which only counts how it is used.
+ */
+class CountingResampler final : public PcmResampler {
+	unsigned &n_deleted;
+
+public:
+	unsigned n_reset = 0;
+
+	explicit CountingResampler(unsigned &_n_deleted)
+		:n_deleted(_n_deleted) {}
+
+	~CountingResampler() {
+		++n_deleted;
+	}
+
+	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate,
+			 gcc_unused Error &error) override {
+		AudioFormat result = af;
+		result.sample_rate = new_sample_rate;
+		return result;
+	}
+
+	void Close() override {}
+
+	void Reset() override {
+		++n_reset;
+	}
+
+	ConstBuffer<void> Resample(ConstBuffer<void> src,
+				   gcc_unused Error &error) override {
+		return src;
+	}
+};
+
+void
+PcmResamplerCacheTest::TestReuse()
+{
+	unsigned n_deleted = 0;
+	const AudioFormat src(44100, SampleFormat::S16, 2);
+	const AudioFormat dest(48000, SampleFormat::FLOAT, 2);
+
+	{
+		PcmResamplerCache cache(4);
+		AudioFormat requested, out;
+
+		CPPUNIT_ASSERT(cache.Take(src, 48000, requested, out) == nullptr);
+
+		auto *r = new CountingResampler(n_deleted);
+		cache.Put(src, 48000, src, dest, r);
+		CPPUNIT_ASSERT_EQUAL(1u, r->n_reset);
+
+		/* a different key must not match */
+		CPPUNIT_ASSERT(cache.Take(src, 96000, requested, out) == nullptr);
+		CPPUNIT_ASSERT(cache.Take(AudioFormat(44100, SampleFormat::S16, 1),
+					  48000, requested, out) == nullptr);
+
+		CPPUNIT_ASSERT(cache.Take(src, 48000, requested, out) == r);
+		CPPUNIT_ASSERT(requested == src);
+		CPPUNIT_ASSERT(out == dest);
+
+		/* it was removed from the cache */
+		CPPUNIT_ASSERT(cache.Take(src, 48000, requested, out) == nullptr);
+
+		cache.Put(src, 48000, src, dest, r);
+		CPPUNIT_ASSERT_EQUAL(0u, n_deleted);
+	}
+
+	/* the destructor deletes the cached resampler */
+	CPPUNIT_ASSERT_EQUAL(1u, n_deleted);
+}
+
+void
+PcmResamplerCacheTest::TestEvict()
+{
+	unsigned n_deleted = 0;
+	PcmResamplerCache cache(2);
+	AudioFormat requested, out;
+
+	CountingResampler *r[3];
+	for (unsigned i = 0; i < 3; ++i) {
+		const AudioFormat src(22050 * (i + 1), SampleFormat::S16, 2);
+		r[i] = new CountingResampler(n_deleted);
+		cache.Put(src, 48000, src, src, r[i]);
+	}
+
+	/* the least recently used one was deleted */
+	CPPUNIT_ASSERT_EQUAL(1u, n_deleted);
+	CPPUNIT_ASSERT(cache.Take(AudioFormat(22050, SampleFormat::S16, 2),
+				  48000, requested, out) == nullptr);
+
+	CPPUNIT_ASSERT(cache.Take(AudioFormat(44100, SampleFormat::S16, 2),
+				  48000, requested, out) == r[1]);
+	delete r[1];
+
+	cache.Clear();
+	CPPUNIT_ASSERT_EQUAL(3u, n_deleted);
+}
+
+/**
+ * Resample a 1 kHz sine (left) and cosine (right) in chunks and
+ * compare the result with the ideal output.
+ */
+static void
+CheckSine(unsigned in_rate, unsigned out_rate, double tolerance)
+{
+	static constexpr double FREQUENCY = 1000;
+	static constexpr unsigned CHUNK = 999;
+
+	PolyphasePcmResampler r;
+
+	AudioFormat af(in_rate, SampleFormat::FLOAT, 2);
+	Error error;
+	const AudioFormat out = r.Open(af, out_rate, error);
+	CPPUNIT_ASSERT(out.IsValid());
+	CPPUNIT_ASSERT(af.format == SampleFormat::FLOAT);
+	CPPUNIT_ASSERT_EQUAL(out_rate, out.sample_rate);
+
+	std::vector<float> output;
+
+	float chunk[CHUNK * 2];
+	for (unsigned i = 0; i < in_rate / 2; i += CHUNK) {
+		for (unsigned j = 0; j < CHUNK; ++j) {
+			const double t = 2 * M_PI * FREQUENCY * (i + j) / in_rate;
+			chunk[j * 2] = sin(t);
+			chunk[j * 2 + 1] = cos(t);
+		}
+
+		const auto dest = ConstBuffer<float>::FromVoid(r.Resample({chunk, sizeof(chunk)}, error));
+		CPPUNIT_ASSERT(!dest.IsNull());
+		output.insert(output.end(), dest.begin(), dest.end());
+	}
+
+	r.Close();
+
+	/* the number of frames matches the ratio, except for the
+	   filter delay */
+	const unsigned in_frames = ((in_rate / 2 + CHUNK - 1) / CHUNK) * CHUNK;
+	const double expected_frames = double(in_frames) * out_rate / in_rate;
+	CPPUNIT_ASSERT(output.size() / 2 <= expected_frames + 1);
+	CPPUNIT_ASSERT(output.size() / 2 + 300 >= expected_frames);
+
+	/* skip the start, where the filter window contains silence */
+	for (unsigned m = 200; m < output.size() / 2; ++m) {
+		const double t = 2 * M_PI * FREQUENCY * m / out_rate;
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(sin(t), output[m * 2], tolerance);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(cos(t), output[m * 2 + 1], tolerance);
+	}
+}
+
+void
+PcmPolyphaseResamplerTest::TestSine()
+{
+	CheckSine(44100, 48000, 1e-3);
+	CheckSine(48000, 44100, 1e-3);
+	CheckSine(44100, 88200, 1e-3);
+	CheckSine(48000, 192000, 1e-3);
+	CheckSine(96000, 48000, 1e-3);
+
+	/* more than MAX_PHASES phases */
+	CheckSine(44100, 44101, 1e-2);
+}
+
+void
+PcmPolyphaseResamplerTest::TestReset()
+{
+	PolyphasePcmResampler r;
+
+	AudioFormat af(44100, SampleFormat::FLOAT, 1);
+	Error error;
+	CPPUNIT_ASSERT(r.Open(af, 48000, error).IsValid());
+
+	std::vector<float> silence(4410, 0.f), noise(4410, 1.f);
+
+	/* a Reset() forgets the previous stream: the output of the
+	   silence must not contain anything from the noise */
+	r.Resample({noise.data(), noise.size() * sizeof(float)}, error);
+	r.Reset();
+
+	auto dest = ConstBuffer<float>::FromVoid(r.Resample({silence.data(), silence.size() * sizeof(float)}, error));
+	CPPUNIT_ASSERT(dest.size > 4000);
+	for (float f : dest)
+		CPPUNIT_ASSERT_EQUAL(0.f, f);
+
+	r.Close();
+}
@@ -0,0 +1,474 @@
+/*
+ * Copyright (C) 2003-2015 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "test_pcm_util.hxx"
+#include "pcm/Simd.hxx"
+#include "pcm/dsd2pcm/dsd2pcm.h"
+#include "util/Macros.hxx"
+
+#include <algorithm>
+#include <vector>
+
+#include <math.h>
+
+/* an odd size to check the scalar tail of the SIMD kernels */
+static constexpr unsigned N = 509;
+
+void
+PcmSimdTest::TestVolumeFloat()
+{
+	const auto src = TestDataBuffer<float, N>(RandomFloat());
+
+	std::array<float, N> expected, result;
+	pcm_simd_portable.volume_float(expected.begin(), src, N, 0.3f);
+	GetPcmSimd().volume_float(result.begin(), src, N, 0.3f);
+
+	for (unsigned i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[i], result[i], 1e-6);
+}
+
+void
+PcmSimdTest::TestAddVolumeFloat()
+{
+	const auto src1 = TestDataBuffer<float, N>(RandomFloat());
+	const auto src2 = TestDataBuffer<float, N>(RandomFloat());
+
+	std::array<float, N> expected, result;
+	std::copy(src1.begin(), src1.end(), expected.begin());
+	std::copy(src1.begin(), src1.end(), result.begin());
+
+	pcm_simd_portable.add_volume_float(expected.begin(), src2, N,
+					   0.25f, 0.75f);
+	GetPcmSimd().add_volume_float(result.begin(), src2, N, 0.25f, 0.75f);
+
+	for (unsigned i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[i], result[i], 1e-6);
+}
+
+void
+PcmSimdTest::TestAddFloat()
+{
+	const auto src1 = TestDataBuffer<float, N>(RandomFloat());
+	const auto src2 = TestDataBuffer<float, N>(RandomFloat());
+
+	std::array<float, N> result;
+	std::copy(src1.begin(), src1.end(), result.begin());
+	GetPcmSimd().add_float(result.begin(), src2, N);
+
+	for (unsigned i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(src1[i] + src2[i], result[i],
+					     1e-6);
+}
+
+void
+PcmSimdTest::TestAdd16()
+{
+	const auto src1 = TestDataBuffer<int16_t, N>();
+	const auto src2 = TestDataBuffer<int16_t, N>();
+
+	std::array<int16_t, N> expected, result;
+	std::copy(src1.begin(), src1.end(), expected.begin());
+	std::copy(src1.begin(), src1.end(), result.begin());
+
+	pcm_simd_portable.add_16(expected.begin(), src2, N);
+	GetPcmSimd().add_16(result.begin(), src2, N);
+
+	/* saturation must be bit-exact */
+	for (unsigned i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_EQUAL(expected[i], result[i]);
+}
+
+template<typename T, size_t M>
+static void
+AssertEqualArrays(const std::array<T, M> &a, const std::array<T, M> &b)
+{
+	for (size_t i = 0; i < M; ++i)
+		CPPUNIT_ASSERT_EQUAL(a[i], b[i]);
+}
+
+void
+PcmSimdTest::TestFloatToInteger()
+{
+	auto src = TestDataBuffer<float, N>(RandomFloat());
+	std::array<float, N> in;
+	for (unsigned i = 0; i < N; ++i)
+		/* exceed the range to check clipping */
+		in[i] = src[i] * 1.25f;
+	in[0] = 1.f;
+	in[1] = -1.f;
+
+	std::array<int16_t, N> expected16, result16;
+	pcm_simd_portable.float_to_16(expected16.begin(), in.begin(), N);
+	GetPcmSimd().float_to_16(result16.begin(), in.begin(), N);
+	AssertEqualArrays(expected16, result16);
+
+	std::array<int32_t, N> expected32, result32;
+	pcm_simd_portable.float_to_24(expected32.begin(), in.begin(), N);
+	GetPcmSimd().float_to_24(result32.begin(), in.begin(), N);
+	AssertEqualArrays(expected32, result32);
+
+	pcm_simd_portable.float_to_32(expected32.begin(), in.begin(), N);
+	GetPcmSimd().float_to_32(result32.begin(), in.begin(), N);
+	AssertEqualArrays(expected32, result32);
+}
+
+void
+PcmSimdTest::TestIntegerToFloat()
+{
+	std::array<float, N> expected, result;
+
+	const auto src16 = TestDataBuffer<int16_t, N>();
+	pcm_simd_portable.s16_to_float(expected.begin(), src16, N);
+	GetPcmSimd().s16_to_float(result.begin(), src16, N);
+	AssertEqualArrays(expected, result);
+
+	const auto src24 = TestDataBuffer<int32_t, N>(RandomInt24());
+	pcm_simd_portable.s24_to_float(expected.begin(), src24, N);
+	GetPcmSimd().s24_to_float(result.begin(), src24, N);
+	AssertEqualArrays(expected, result);
+
+	const auto src32 = TestDataBuffer<int32_t, N>();
+	pcm_simd_portable.s32_to_float(expected.begin(), src32, N);
+	GetPcmSimd().s32_to_float(result.begin(), src32, N);
+	AssertEqualArrays(expected, result);
+}
+
+void
+PcmSimdTest::TestDsd2Pcm()
+{
+	const float *ctables = dsd2pcm_get_ctables();
+	const auto fwd = TestDataBuffer<uint8_t, N + 11>();
+	const auto rev = TestDataBuffer<uint8_t, N + 11>();
+
+	std::array<float, N> expected, result;
+	pcm_simd_portable.dsd2pcm(expected.begin(), fwd, rev, N, ctables);
+	GetPcmSimd().dsd2pcm(result.begin(), fwd, rev, N, ctables);
+	AssertEqualArrays(expected, result);
+}
+
+void
+PcmSimdTest::TestDop()
+{
+	/* an odd number of blocks to check the scalar tail */
+	static constexpr unsigned BLOCKS = 85;
+	const auto src = TestDataBuffer<uint8_t, BLOCKS * 4 * 6>();
+
+	std::array<uint32_t, BLOCKS * 2 * 6> expected, result;
+
+	for (unsigned channels = 1; channels <= 6; ++channels) {
+		expected.fill(0);
+		result.fill(0);
+
+		pcm_simd_portable.dsd_to_dop(expected.begin(), src,
+					     BLOCKS, channels);
+		GetPcmSimd().dsd_to_dop(result.begin(), src,
+					BLOCKS, channels);
+		AssertEqualArrays(expected, result);
+	}
+}
+
+void
+PcmSimdTest::TestDeinterleave()
+{
+	/* an odd number of frames to check the scalar tail */
+	static constexpr unsigned FRAMES = 1023;
+	const auto src = TestDataBuffer<float, FRAMES * 6>();
+
+	std::array<float, FRAMES * 6> expected, result;
+
+	for (unsigned channels = 1; channels <= 6; ++channels) {
+		float *e[6], *r[6];
+		for (unsigned c = 0; c < channels; ++c) {
+			e[c] = expected.begin() + c * FRAMES;
+			r[c] = result.begin() + c * FRAMES;
+		}
+
+		expected.fill(0);
+		result.fill(0);
+
+		pcm_simd_portable.deinterleave_float(e, src, FRAMES, channels);
+		GetPcmSimd().deinterleave_float(r, src, FRAMES, channels);
+		AssertEqualArrays(expected, result);
+
+		/* the first channel is every n-th sample */
+		CPPUNIT_ASSERT_EQUAL(src[channels], result[1]);
+	}
+}
+
+void
+PcmSimdTest::TestDot()
+{
+	const auto a = TestDataBuffer<float, N>(RandomFloat());
+	const auto b = TestDataBuffer<float, N>(RandomFloat());
+
+	/* all lengths up to 40 to check the scalar tail */
+	for (unsigned n = 0; n <= 40; ++n)
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(pcm_simd_portable.dot_float(a, b, n),
+					     GetPcmSimd().dot_float(a, b, n),
+					     1e-5);
+
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(pcm_simd_portable.dot_float(a, b, N),
+				     GetPcmSimd().dot_float(a, b, N),
+				     1e-4);
+}
+
+void
+PcmSimdTest::TestComplexMac()
+{
+	const auto a_re = TestDataBuffer<float, N>(RandomFloat());
+	const auto a_im = TestDataBuffer<float, N>(RandomFloat());
+	const auto b_re = TestDataBuffer<float, N>(RandomFloat());
+	const auto b_im = TestDataBuffer<float, N>(RandomFloat());
+	const auto acc = TestDataBuffer<float, N>(RandomFloat());
+
+	std::array<float, N> e_re, e_im, r_re, r_im;
+	std::copy(acc.begin(), acc.end(), e_re.begin());
+	std::copy(acc.begin(), acc.end(), e_im.begin());
+	std::copy(acc.begin(), acc.end(), r_re.begin());
+	std::copy(acc.begin(), acc.end(), r_im.begin());
+
+	pcm_simd_portable.complex_mac_float(e_re.begin(), e_im.begin(),
+					    a_re, a_im, b_re, b_im, N);
+	GetPcmSimd().complex_mac_float(r_re.begin(), r_im.begin(),
+				       a_re, a_im, b_re, b_im, N);
+
+	for (unsigned i = 0; i < N; ++i) {
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(e_re[i], r_re[i], 1e-6);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(e_im[i], r_im[i], 1e-6);
+	}
+
+	/* (1+2i) * (3+4i) = -5+10i */
+	float re = 1, im = 1;
+	const float x_re = 1, x_im = 2, y_re = 3, y_im = 4;
+	GetPcmSimd().complex_mac_float(&re, &im, &x_re, &x_im,
+				       &y_re, &y_im, 1);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(-4.0, re, 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(11.0, im, 1e-6);
+}
+
+void
+PcmSimdTest::TestBiquad()
+{
+	static constexpr unsigned FRAMES = 257;
+
+	/* a stable resonator (poles at radius 0.92) */
+	static constexpr float cf[5] = { 1.1f, -1.8f, 0.75f, -1.8f, 0.85f };
+	int32_t c32[5];
+	for (unsigned i = 0; i < 5; ++i)
+		c32[i] = lrint(cf[i] * (1 << PCM_BIQUAD_BITS));
+
+	const auto srcf = TestDataBuffer<float, FRAMES * 8>(RandomFloat());
+	auto src32 = TestDataBuffer<int32_t, FRAMES * 8>();
+
+	/* check all channel counts, because the SIMD implementations
+	   have special code for partial vectors */
+	for (unsigned channels = 1; channels <= 8; ++channels) {
+		const unsigned n = FRAMES * channels;
+
+		std::vector<float> ef(srcf.begin(), srcf.begin() + n);
+		std::vector<float> rf(ef);
+		std::vector<float> ezf(2 * channels, 0.1f), rzf(ezf);
+
+		/* two calls, to check that the state is carried
+		   over */
+		pcm_simd_portable.biquad_float(&ef[0], 100, channels, cf,
+					       &ezf[0]);
+		pcm_simd_portable.biquad_float(&ef[100 * channels],
+					       FRAMES - 100, channels, cf,
+					       &ezf[0]);
+		GetPcmSimd().biquad_float(&rf[0], 100, channels, cf, &rzf[0]);
+		GetPcmSimd().biquad_float(&rf[100 * channels], FRAMES - 100,
+					  channels, cf, &rzf[0]);
+
+		for (unsigned i = 0; i < n; ++i)
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(ef[i], rf[i], 1e-3);
+		for (unsigned i = 0; i < 2 * channels; ++i)
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(ezf[i], rzf[i], 1e-3);
+
+		/* the fixed-point kernels must be bit-exact, even
+		   when clipping */
+		std::vector<int32_t> e32(src32.begin(), src32.begin() + n);
+		std::vector<int32_t> r32(e32);
+		std::vector<int32_t> ez32(4 * channels, 0), rz32(ez32);
+
+		pcm_simd_portable.biquad_32(&e32[0], 100, channels, c32,
+					    &ez32[0]);
+		pcm_simd_portable.biquad_32(&e32[100 * channels],
+					    FRAMES - 100, channels, c32,
+					    &ez32[0]);
+		GetPcmSimd().biquad_32(&r32[0], 100, channels, c32, &rz32[0]);
+		GetPcmSimd().biquad_32(&r32[100 * channels], FRAMES - 100,
+				       channels, c32, &rz32[0]);
+
+		CPPUNIT_ASSERT(e32 == r32);
+		CPPUNIT_ASSERT(ez32 == rz32);
+	}
+
+	/* an impulse through y = x + 0.5 * y1: 1, 0.5, 0.25, ... */
+	static constexpr float half[5] = { 1, 0, 0, -0.5f, 0 };
+	float impulse[4] = { 1, 0, 0, 0 };
+	float z[2] = { 0, 0 };
+	GetPcmSimd().biquad_float(impulse, 4, 1, half, z);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, impulse[0], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, impulse[1], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.25, impulse[2], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.125, impulse[3], 1e-6);
+}
+
+void
+PcmSimdTest::TestMonoStereo()
+{
+	const auto src16 = TestDataBuffer<int16_t, N * 2>();
+	const auto src32 = TestDataBuffer<uint32_t, N * 2>();
+	const auto srcf = TestDataBuffer<float, N * 2>(RandomFloat());
+
+	std::array<int16_t, N * 2> e16, r16;
+	pcm_simd_portable.mono_to_stereo_16(e16.begin(), src16, N);
+	GetPcmSimd().mono_to_stereo_16(r16.begin(), src16, N);
+	AssertEqualArrays(e16, r16);
+	CPPUNIT_ASSERT_EQUAL(src16[N - 1], r16[N * 2 - 1]);
+
+	std::array<uint32_t, N * 2> e32, r32;
+	pcm_simd_portable.mono_to_stereo_32(e32.begin(), src32, N);
+	GetPcmSimd().mono_to_stereo_32(r32.begin(), src32, N);
+	AssertEqualArrays(e32, r32);
+
+	std::array<int16_t, N> m16e, m16r;
+	pcm_simd_portable.stereo_to_mono_16(m16e.begin(), src16, N);
+	GetPcmSimd().stereo_to_mono_16(m16r.begin(), src16, N);
+	AssertEqualArrays(m16e, m16r);
+
+	/* rounding towards zero */
+	static constexpr int16_t odd[] = { -3, 0, 3, 0, -32768, -32768, 32767, 32767 };
+	int16_t odd_result[4];
+	GetPcmSimd().stereo_to_mono_16(odd_result, odd, 4);
+	CPPUNIT_ASSERT_EQUAL(int16_t(-1), odd_result[0]);
+	CPPUNIT_ASSERT_EQUAL(int16_t(1), odd_result[1]);
+	CPPUNIT_ASSERT_EQUAL(int16_t(-32768), odd_result[2]);
+	CPPUNIT_ASSERT_EQUAL(int16_t(32767), odd_result[3]);
+
+	std::array<float, N> mfe, mfr;
+	pcm_simd_portable.stereo_to_mono_float(mfe.begin(), srcf, N);
+	GetPcmSimd().stereo_to_mono_float(mfr.begin(), srcf, N);
+	AssertEqualArrays(mfe, mfr);
+}
+
+void
+PcmSimdTest::TestRoute()
+{
+	static constexpr unsigned FRAMES = 253;
+	const auto src = TestDataBuffer<uint32_t, FRAMES * 8>();
+
+	/* 2 to 8 channels (upmix with gaps), 8 to 2 and a shuffle */
+	static constexpr struct {
+		unsigned src_channels, dest_channels;
+		int8_t map[8];
+	} routes[] = {
+		{ 2, 8, { 0, 1, -1, -1, 0, 1, 0, 1 } },
+		{ 8, 2, { 6, 7 } },
+		{ 6, 6, { 1, 0, 2, 3, 5, 4 } },
+		{ 1, 3, { 0, -1, 0 } },
+		{ 8, 8, { 7, 6, 5, 4, 3, 2, 1, 0 } },
+	};
+
+	for (const auto &r : routes) {
+		std::array<uint32_t, FRAMES * 8> expected, result;
+		expected.fill(0xdeadbeef);
+		result.fill(0xdeadbeef);
+
+		pcm_simd_portable.route_32(expected.begin(), src, FRAMES,
+					   r.src_channels, r.dest_channels,
+					   r.map);
+		GetPcmSimd().route_32(result.begin(), src, FRAMES,
+				      r.src_channels, r.dest_channels,
+				      r.map);
+		AssertEqualArrays(expected, result);
+
+		CPPUNIT_ASSERT_EQUAL(r.map[0] >= 0 ? src[r.map[0]] : 0,
+				     result[0]);
+	}
+}
+
+void
+PcmSimdTest::TestPeak()
+{
+	auto src16 = TestDataBuffer<int16_t, N>();
+	auto src32 = TestDataBuffer<int32_t, N>();
+	auto srcf = TestDataBuffer<float, N>(RandomFloat());
+
+	CPPUNIT_ASSERT_EQUAL(pcm_simd_portable.peak_16(src16, N),
+			     GetPcmSimd().peak_16(src16, N));
+	CPPUNIT_ASSERT_EQUAL(pcm_simd_portable.peak_32(src32, N),
+			     GetPcmSimd().peak_32(src32, N));
+	CPPUNIT_ASSERT_EQUAL(pcm_simd_portable.peak_float(srcf, N),
+			     GetPcmSimd().peak_float(srcf, N));
+
+	/* a quiet signal with one negative peak, in the vectorized
+	   part and in the scalar tail */
+	for (unsigned position : { 100u, N - 1 }) {
+		int16_t q16[N];
+		int32_t q32[N];
+		float qf[N];
+		for (unsigned i = 0; i < N; ++i) {
+			q16[i] = i % 7;
+			q32[i] = i % 7;
+			qf[i] = (i % 7) / 100.0f;
+		}
+
+		q16[position] = -32768;
+		q32[position] = -0x7fffffff - 1;
+		qf[position] = -0.75f;
+
+		CPPUNIT_ASSERT_EQUAL(32767u, GetPcmSimd().peak_16(q16, N));
+		CPPUNIT_ASSERT_EQUAL(uint32_t(0x7fffffff),
+				     GetPcmSimd().peak_32(q32, N));
+		CPPUNIT_ASSERT_EQUAL(0.75f, GetPcmSimd().peak_float(qf, N));
+	}
+}
+
+void
+PcmSimdTest::TestGain16()
+{
+	const auto src = TestDataBuffer<int16_t, N>();
+
+	std::array<int16_t, N> expected, result;
+	pcm_simd_portable.gain_16(expected.begin(), src, N, 3000);
+	GetPcmSimd().gain_16(result.begin(), src, N, 3000);
+	AssertEqualArrays(expected, result);
+
+	/* in-place, with clamping */
+	static constexpr int16_t loud[] = {
+		20000, -20000, 100, -100, 0, 32767, -32768, 1,
+		-1, 16383, -16384, 5000, -5000, 12, -12, 20000,
+		-20000,
+	};
+
+	int16_t data[ARRAY_SIZE(loud)];
+	std::copy(std::begin(loud), std::end(loud), data);
+	GetPcmSimd().gain_16(data, data, ARRAY_SIZE(loud), 2048);
+
+	for (unsigned i = 0; i < ARRAY_SIZE(loud); ++i)
+		CPPUNIT_ASSERT_EQUAL(int16_t(std::min(std::max(loud[i] * 2,
+							       -32768),
+						      32767)),
+				     data[i]);
+}
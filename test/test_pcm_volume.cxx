@@ -123,3 +123,43 @@ PcmVolumeTest::TestVolumeFloat()
 
 	pv.Close();
 }
+
+void
+PcmVolumeTest::TestInPlace()
+{
+	constexpr size_t N = 509;
+	const auto _src16 = TestDataBuffer<int16_t, N>();
+	const auto _src32 = TestDataBuffer<float, N>(RandomFloat());
+
+	PcmVolume pv;
+	pv.SetVolume(PCM_VOLUME_1 / 3);
+
+	/* the in-place result must match the one written to a
+	   separate buffer */
+
+	CPPUNIT_ASSERT(pv.Open(SampleFormat::S16, IgnoreError()));
+	int16_t data16[N];
+	std::copy_n(_src16.begin(), N, data16);
+	auto dest = pv.Apply({data16, sizeof(data16)}, data16);
+	CPPUNIT_ASSERT_EQUAL((const void *)data16, dest.data);
+
+	/* a fresh dither state for the reference */
+	pv.Close();
+	PcmVolume pv2;
+	pv2.SetVolume(PCM_VOLUME_1 / 3);
+	CPPUNIT_ASSERT(pv2.Open(SampleFormat::S16, IgnoreError()));
+	dest = pv2.Apply(_src16);
+	CPPUNIT_ASSERT_EQUAL(0, memcmp(dest.data, data16, sizeof(data16)));
+	pv2.Close();
+
+	CPPUNIT_ASSERT(pv.Open(SampleFormat::FLOAT, IgnoreError()));
+	float data32[N];
+	std::copy_n(_src32.begin(), N, data32);
+	dest = pv.Apply({data32, sizeof(data32)}, data32);
+	CPPUNIT_ASSERT_EQUAL((const void *)data32, dest.data);
+
+	for (unsigned i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(_src32[i] / 3, data32[i], 0.01);
+
+	pv.Close();
+}
@@ -0,0 +1,201 @@
+/*
+ * Unit tests for the asynchronous commands of class PlayerControl.
+ *
+ * A fake player thread finishes each command after a delay (like a
+ * decoder opening or seeking a song), and the tests issue the calls
+ * which the protocol handlers make for command sequences such as
+ * "play; status" and "seek; status".
+ */
+
+#include "config.h"
+#include "PlayerControl.hxx"
+#include "PlayerListener.hxx"
+#include "Idle.hxx"
+#include "DetachedSong.hxx"
+#include "util/Error.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <stdlib.h>
+
+void
+idle_add(gcc_unused unsigned flags)
+{
+}
+
+class NullPlayerListener final : public PlayerListener {
+public:
+	void OnPlayerSync() override {}
+	void OnPlayerTagModified() override {}
+};
+
+class FlagWaiter final : public PlayerCommandWaiter {
+public:
+	std::atomic_bool notified;
+
+	FlagWaiter():notified(false) {}
+
+	void OnPlayerCommandsFinished() override {
+		notified = true;
+	}
+};
+
+/**
+ * How long the fake player thread takes for "play" and "seek".
+ */
+static constexpr std::chrono::milliseconds decoder_delay(50);
+
+static void
+FakePlayerThread(void *ctx)
+{
+	PlayerControl &pc = *(PlayerControl *)ctx;
+
+	pc.Lock();
+
+	while (true) {
+		switch (pc.command) {
+		case PlayerCommand::NONE:
+			pc.Wait();
+			continue;
+
+		case PlayerCommand::QUEUE:
+		case PlayerCommand::SEEK:
+			pc.Unlock();
+			std::this_thread::sleep_for(decoder_delay);
+			pc.Lock();
+
+			pc.elapsed_time = pc.command == PlayerCommand::SEEK
+				? pc.seek_time
+				: SongTime::zero();
+			delete pc.next_song;
+			pc.next_song = nullptr;
+			pc.state = PlayerState::PLAY;
+			break;
+
+		case PlayerCommand::STOP:
+		case PlayerCommand::CLOSE_AUDIO:
+			pc.state = PlayerState::STOP;
+			break;
+
+		case PlayerCommand::EXIT:
+			pc.CommandFinished();
+			pc.Unlock();
+			return;
+
+		default:
+			break;
+		}
+
+		pc.CommandFinished();
+	}
+}
+
+/**
+ * A #PlayerControl with a running fake player thread.
+ */
+struct FakePlayer {
+	NullPlayerListener listener;
+
+	/* the fake player thread doesn't use the outputs */
+	PlayerControl pc{listener, *(MultipleOutputs *)nullptr, 64, 4096, 0};
+
+	FakePlayer() {
+		Error error;
+		CPPUNIT_ASSERT(pc.thread.Start(FakePlayerThread, &pc, error));
+	}
+
+	~FakePlayer() {
+		pc.Kill();
+	}
+};
+
+class PlayerControlTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PlayerControlTest);
+	CPPUNIT_TEST(TestPlayStatus);
+	CPPUNIT_TEST(TestSeekStatus);
+	CPPUNIT_TEST(TestWaiter);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	/**
+	 * "status" right after "play" (e.g. in a command list) must
+	 * report the new state.
+	 */
+	void TestPlayStatus() {
+		FakePlayer player;
+		PlayerControl *const pc = &player.pc;
+
+		CPPUNIT_ASSERT(pc->GetStatus().state == PlayerState::STOP);
+
+		pc->Play(new DetachedSong("foo.ogg"));
+		CPPUNIT_ASSERT(pc->GetStatus().state == PlayerState::PLAY);
+		CPPUNIT_ASSERT(pc->GetStatus().elapsed_time == SongTime::zero());
+	}
+
+	/**
+	 * "status" right after "seek" must report the new elapsed
+	 * time.
+	 */
+	void TestSeekStatus() {
+		FakePlayer player;
+		PlayerControl *const pc = &player.pc;
+
+		pc->Play(new DetachedSong("foo.ogg"));
+
+		const auto t = SongTime::FromS(42u);
+		CPPUNIT_ASSERT(pc->Seek(new DetachedSong("foo.ogg"), t));
+		CPPUNIT_ASSERT(pc->GetStatus().elapsed_time == t);
+
+		/* a second seek while the player thread is idle */
+		pc->Seek(new DetachedSong("foo.ogg"), SongTime::FromS(7u));
+		CPPUNIT_ASSERT(pc->GetStatus().elapsed_time ==
+			       SongTime::FromS(7u));
+	}
+
+	/**
+	 * Outside of a command list, "status" is deferred with a
+	 * #PlayerCommandWaiter while a command submitted by another
+	 * client is pending; when it is notified, the status is
+	 * final.
+	 */
+	void TestWaiter() {
+		FakePlayer player;
+		PlayerControl *const pc = &player.pc;
+
+		FlagWaiter idle;
+		CPPUNIT_ASSERT(!pc->AddWaiter(idle));
+
+		pc->Play(new DetachedSong("foo.ogg"));
+
+		FlagWaiter waiter;
+		CPPUNIT_ASSERT(pc->AddWaiter(waiter));
+
+		while (!waiter.notified)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		pc->Lock();
+		CPPUNIT_ASSERT(!pc->IsCommandPending());
+		pc->Unlock();
+
+		CPPUNIT_ASSERT(pc->GetStatus().state == PlayerState::PLAY);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PlayerControlTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,95 @@
+/*
+ * Unit tests for class PlaylistVector.
+ */
+
+#include "config.h"
+#include "db/PlaylistVector.hxx"
+#include "db/DatabaseLock.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <stdlib.h>
+
+static std::string
+MakeName(unsigned i)
+{
+	return "playlist" + std::to_string(i) + ".m3u";
+}
+
+static unsigned
+Count(const PlaylistVector &pv)
+{
+	unsigned n = 0;
+	for (auto i = pv.begin(); i != pv.end(); ++i)
+		++n;
+	return n;
+}
+
+class PlaylistVectorTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PlaylistVectorTest);
+	CPPUNIT_TEST(TestSmall);
+	CPPUNIT_TEST(TestLarge);
+	CPPUNIT_TEST_SUITE_END();
+
+	/**
+	 * Insert, update and remove items; the number of items
+	 * decides whether the index is used.
+	 */
+	static void Run(unsigned n) {
+		const ScopeDatabaseLock protect;
+
+		PlaylistVector pv;
+		for (unsigned i = 0; i < n; ++i)
+			CPPUNIT_ASSERT(pv.UpdateOrInsert(PlaylistInfo(MakeName(i), 1)));
+		CPPUNIT_ASSERT_EQUAL(n, Count(pv));
+
+		/* existing items are found */
+		for (unsigned i = 0; i < n; ++i)
+			CPPUNIT_ASSERT(!pv.UpdateOrInsert(PlaylistInfo(MakeName(i), 1)));
+		CPPUNIT_ASSERT(pv.UpdateOrInsert(PlaylistInfo(MakeName(0), 2)));
+		CPPUNIT_ASSERT_EQUAL(n, Count(pv));
+
+		/* remove every other item by name */
+		for (unsigned i = 0; i < n; i += 2)
+			CPPUNIT_ASSERT(pv.erase(MakeName(i).c_str()));
+		CPPUNIT_ASSERT(!pv.erase(MakeName(0).c_str()));
+		CPPUNIT_ASSERT_EQUAL(n / 2, Count(pv));
+
+		/* remove the first remaining item by iterator */
+		pv.erase(pv.begin());
+		CPPUNIT_ASSERT(!pv.erase(MakeName(1).c_str()));
+		CPPUNIT_ASSERT(pv.erase(MakeName(3).c_str()));
+
+		/* a moved vector keeps its index */
+		PlaylistVector pv2(std::move(pv));
+		CPPUNIT_ASSERT(!pv2.UpdateOrInsert(PlaylistInfo(MakeName(5), 1)));
+		CPPUNIT_ASSERT(pv2.UpdateOrInsert(PlaylistInfo(MakeName(0), 1)));
+		CPPUNIT_ASSERT_EQUAL(n / 2 - 1, Count(pv2));
+	}
+
+public:
+	void TestSmall() {
+		Run(8);
+	}
+
+	void TestLarge() {
+		Run(1000);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PlaylistVectorTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -15,14 +15,13 @@ static void
 check_descending_priority(const Queue *queue,
 			  unsigned start_order)
 {
-	assert(start_order < queue->GetLength());
+	CPPUNIT_ASSERT(start_order < queue->GetLength());
 
 	uint8_t last_priority = 0xff;
 	for (unsigned order = start_order; order < queue->GetLength(); ++order) {
 		unsigned position = queue->OrderToPosition(order);
-		uint8_t priority = queue->items[position].priority;
-		assert(priority <= last_priority);
-		(void)last_priority;
+		uint8_t priority = queue->GetPriorityAtPosition(position);
+		CPPUNIT_ASSERT(priority <= last_priority);
 		last_priority = priority;
 	}
 }
@@ -30,10 +29,12 @@ check_descending_priority(const Queue *queue,
 class QueuePriorityTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(QueuePriorityTest);
 	CPPUNIT_TEST(TestPriority);
+	CPPUNIT_TEST(TestAppendShuffle);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void TestPriority();
+	void TestAppendShuffle();
 };
 
 void
@@ -136,7 +137,7 @@ QueuePriorityTest::TestPriority()
 
 	unsigned a_order = 3;
 	unsigned a_position = queue.OrderToPosition(a_order);
-	CPPUNIT_ASSERT_EQUAL(10u, unsigned(queue.items[a_position].priority));
+	CPPUNIT_ASSERT_EQUAL(10u, unsigned(queue.GetPriorityAtPosition(a_position)));
 	queue.SetPriority(a_position, 20, current_order);
 
 	current_order = queue.PositionToOrder(current_position);
@@ -153,7 +154,7 @@ QueuePriorityTest::TestPriority()
 
 	unsigned b_order = 10;
 	unsigned b_position = queue.OrderToPosition(b_order);
-	CPPUNIT_ASSERT_EQUAL(0u, unsigned(queue.items[b_position].priority));
+	CPPUNIT_ASSERT_EQUAL(0u, unsigned(queue.GetPriorityAtPosition(b_position)));
 	queue.SetPriority(b_position, 70, current_order);
 
 	current_order = queue.PositionToOrder(current_position);
@@ -170,7 +171,7 @@ QueuePriorityTest::TestPriority()
 
 	unsigned c_order = 0;
 	unsigned c_position = queue.OrderToPosition(c_order);
-	CPPUNIT_ASSERT_EQUAL(50u, unsigned(queue.items[c_position].priority));
+	CPPUNIT_ASSERT_EQUAL(50u, unsigned(queue.GetPriorityAtPosition(c_position)));
 	queue.SetPriority(c_position, 60, current_order);
 
 	current_order = queue.PositionToOrder(current_position);
@@ -183,7 +184,7 @@ QueuePriorityTest::TestPriority()
 
 	a_order = queue.PositionToOrder(a_position);
 	CPPUNIT_ASSERT_EQUAL(5u, a_order);
-	CPPUNIT_ASSERT_EQUAL(20u, unsigned(queue.items[a_position].priority));
+	CPPUNIT_ASSERT_EQUAL(20u, unsigned(queue.GetPriorityAtPosition(a_position)));
 	queue.SetPriority(a_position, 5, current_order);
 
 	current_order = queue.PositionToOrder(current_position);
@@ -193,6 +194,39 @@ QueuePriorityTest::TestPriority()
 	CPPUNIT_ASSERT_EQUAL(6u, a_order);
 }
 
+void
+QueuePriorityTest::TestAppendShuffle()
+{
+	Queue queue(64);
+	queue.random = true;
+
+	for (unsigned i = 0; i < 16; ++i)
+		queue.Append(DetachedSong("foo.ogg"), i % 4 == 0 ? 10 : 0);
+
+	queue.ShuffleOrder();
+	check_descending_priority(&queue, 0);
+
+	/* shuffle newly appended songs into the range after the
+	   "current" song, like playlist::AppendSong() does */
+
+	const unsigned start = 2;
+	for (unsigned i = 0; i < 32; ++i) {
+		const uint8_t priority = i % 3 == 0 ? 10 : (i % 3) * 20;
+		queue.Append(DetachedSong("bar.ogg"), priority);
+		queue.ShuffleOrderLastWithPriority(start, queue.GetLength());
+		check_descending_priority(&queue, start);
+	}
+
+	/* the songs before "start" have not been touched */
+	CPPUNIT_ASSERT_EQUAL(10u, unsigned(queue.GetOrderPriority(0)));
+	CPPUNIT_ASSERT_EQUAL(10u, unsigned(queue.GetOrderPriority(1)));
+
+	/* the 10 new priority=40 songs are at the beginning */
+	for (unsigned order = start; order < start + 10; ++order)
+		CPPUNIT_ASSERT_EQUAL(40u,
+				     unsigned(queue.GetOrderPriority(order)));
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(QueuePriorityTest);
 
 int
@@ -0,0 +1,308 @@
+/*
+ * Compare the tree based #Queue with a simple array based reference
+ * implementation.
+ */
+
+#include "config.h"
+#include "queue/Queue.hxx"
+#include "DetachedSong.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <map>
+#include <vector>
+#include <random>
+
+#include <stdlib.h>
+
+Tag::Tag(const Tag &) {}
+void Tag::Clear() {}
+
+/**
+ * The reference: item attributes in "position" order, and the order
+ * list mapping order numbers to positions.
+ */
+struct ReferenceQueue {
+	std::vector<unsigned> ids;
+	std::vector<uint32_t> versions;
+	std::vector<unsigned> order;
+
+	bool random = false;
+
+	unsigned size() const {
+		return ids.size();
+	}
+
+	void Append(unsigned id, uint32_t version) {
+		order.push_back(ids.size());
+		ids.push_back(id);
+		versions.push_back(version);
+	}
+
+	void Delete(unsigned position, uint32_t version) {
+		ids.erase(ids.begin() + position);
+		versions.erase(versions.begin() + position);
+		for (unsigned i = position; i < size(); ++i)
+			versions[i] = version;
+
+		for (auto i = order.begin(); i != order.end(); ++i) {
+			if (*i == position) {
+				order.erase(i);
+				break;
+			}
+		}
+
+		for (auto &i : order)
+			if (i > position)
+				--i;
+	}
+
+	void MoveRange(unsigned start, unsigned end, unsigned to,
+		       uint32_t version) {
+		const unsigned n = end - start;
+
+		std::vector<unsigned> block(ids.begin() + start,
+					    ids.begin() + end);
+		ids.erase(ids.begin() + start, ids.begin() + end);
+		ids.insert(ids.begin() + to, block.begin(), block.end());
+
+		const unsigned lo = std::min(start, to);
+		const unsigned hi = std::max(end, to + n);
+		for (unsigned i = lo; i < hi; ++i)
+			versions[i] = version;
+
+		if (random) {
+			for (auto &i : order) {
+				if (i >= end && i < to + n)
+					i -= n;
+				else if (i < start && i >= to)
+					i += n;
+				else if (start <= i && i < end)
+					i += to - start;
+			}
+		}
+	}
+
+	void SwapPositions(unsigned a, unsigned b, uint32_t version) {
+		std::swap(ids[a], ids[b]);
+		versions[a] = versions[b] = version;
+	}
+
+	void SwapOrders(unsigned a, unsigned b) {
+		std::swap(order[a], order[b]);
+	}
+};
+
+static void
+Compare(const Queue &queue, const ReferenceQueue &ref)
+{
+	CPPUNIT_ASSERT_EQUAL(ref.size(), queue.GetLength());
+
+	for (unsigned i = 0; i < ref.size(); ++i) {
+		CPPUNIT_ASSERT_EQUAL(int(ref.ids[i]), queue.PositionToId(i));
+		CPPUNIT_ASSERT_EQUAL(int(i), queue.IdToPosition(ref.ids[i]));
+		CPPUNIT_ASSERT_EQUAL(ref.order[i], queue.OrderToPosition(i));
+		CPPUNIT_ASSERT_EQUAL(i, queue.PositionToOrder(ref.order[i]));
+	}
+
+	/* check "plchanges" for a few versions */
+	for (uint32_t v = queue.version > 8 ? queue.version - 8 : 1;
+	     v <= queue.version + 1; ++v) {
+		unsigned next = queue.FindNewerPosition(0, v);
+		for (unsigned i = 0; i < ref.size(); ++i) {
+			const bool newer = v > queue.version ||
+				ref.versions[i] >= v || ref.versions[i] == 0;
+			CPPUNIT_ASSERT_EQUAL(newer,
+					     queue.IsNewerAtPosition(i, v));
+			if (newer) {
+				CPPUNIT_ASSERT_EQUAL(i, next);
+				next = queue.FindNewerPosition(i + 1, v);
+			}
+		}
+
+		CPPUNIT_ASSERT_EQUAL(ref.size(), next);
+	}
+}
+
+static void
+RunRandom(bool random, unsigned seed)
+{
+	std::mt19937 rng(seed);
+
+	Queue queue(4096);
+	queue.random = random;
+
+	ReferenceQueue ref;
+	ref.random = random;
+
+	for (unsigned step = 0; step < 3000; ++step) {
+		const unsigned length = ref.size();
+
+		switch (length < 8 ? 0 : rng() % 7) {
+		case 0:
+		case 1:
+			if (!queue.IsFull()) {
+				unsigned id = queue.Append(DetachedSong("foo"), 0);
+				ref.Append(id, queue.version);
+			}
+			break;
+
+		case 2: {
+			unsigned position = rng() % length;
+			queue.DeletePosition(position);
+			ref.Delete(position, queue.version);
+			break;
+		}
+
+		case 3: {
+			unsigned start = rng() % length;
+			unsigned end = start + 1 + rng() % std::min(length - start, 32u);
+			unsigned to = rng() % (length - (end - start) + 1);
+			queue.MoveRange(start, end, to);
+			ref.MoveRange(start, end, to, queue.version);
+			break;
+		}
+
+		case 4: {
+			unsigned a = rng() % length, b = rng() % length;
+			queue.SwapPositions(a, b);
+			ref.SwapPositions(a, b, queue.version);
+			break;
+		}
+
+		case 5:
+			if (random) {
+				unsigned a = rng() % length, b = rng() % length;
+				queue.SwapOrders(a, b);
+				ref.SwapOrders(a, b);
+			}
+			break;
+
+		case 6: {
+			const unsigned n = std::min(1u + unsigned(rng() % 20),
+						    queue.max_length - length);
+			std::vector<DetachedSong *> songs;
+			for (unsigned i = 0; i < n; ++i)
+				songs.push_back(new DetachedSong("bar"));
+
+			queue.Append(songs.data(), n, 0);
+			for (unsigned i = 0; i < n; ++i)
+				ref.Append(queue.PositionToId(length + i),
+					   queue.version);
+			break;
+		}
+		}
+
+		queue.IncrementVersion();
+
+		if (step % 16 == 0)
+			Compare(queue, ref);
+	}
+
+	Compare(queue, ref);
+}
+
+class QueueTreeTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(QueueTreeTest);
+	CPPUNIT_TEST(TestSequential);
+	CPPUNIT_TEST(TestRandom);
+	CPPUNIT_TEST(TestPriority);
+	CPPUNIT_TEST(TestIdTable);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestSequential() {
+		RunRandom(false, 1);
+		RunRandom(false, 2);
+	}
+
+	void TestRandom() {
+		RunRandom(true, 3);
+		RunRandom(true, 4);
+	}
+
+	void TestPriority() {
+		Queue queue(256);
+		queue.random = true;
+
+		for (unsigned i = 0; i < 200; ++i)
+			queue.Append(DetachedSong("foo"), i % 5);
+
+		queue.ShuffleOrder();
+
+		/* the "order" list must be sorted by priority */
+		for (unsigned i = 1; i < queue.GetLength(); ++i)
+			CPPUNIT_ASSERT(queue.GetOrderPriority(i - 1) >=
+				       queue.GetOrderPriority(i));
+
+		/* moving items must not affect the order */
+		const unsigned first = queue.OrderToPosition(0);
+		const unsigned first_id = queue.PositionToId(first);
+		queue.MoveRange(0, 50, 150);
+		CPPUNIT_ASSERT_EQUAL(first_id,
+				     unsigned(queue.PositionToId(queue.OrderToPosition(0))));
+
+		/* raise one item's priority: it must become the first */
+		queue.SetPriority(100, 10, -1);
+		CPPUNIT_ASSERT_EQUAL(0u, queue.PositionToOrder(100));
+		CPPUNIT_ASSERT_EQUAL(uint8_t(10), queue.GetOrderPriority(0));
+
+		/* lower it again: it moves behind all higher priorities */
+		queue.SetPriority(100, 2, -1);
+		const unsigned o = queue.PositionToOrder(100);
+		CPPUNIT_ASSERT_EQUAL(uint8_t(2), queue.GetOrderPriority(o));
+		for (unsigned i = 0; i < o; ++i)
+			CPPUNIT_ASSERT(queue.GetOrderPriority(i) >= 2);
+		for (unsigned i = o + 1; i < queue.GetLength(); ++i)
+			CPPUNIT_ASSERT(queue.GetOrderPriority(i) <= 2);
+	}
+
+	void TestIdTable() {
+		/* a small id space wraps around quickly, which mixes
+		   old and new ids in the hash table */
+		IdTable<int> table(1000);
+		std::map<unsigned, int *> reference;
+		int dummy[600];
+
+		std::mt19937 rng(5);
+		for (unsigned step = 0; step < 100000; ++step) {
+			if (reference.size() < 600 &&
+			    (reference.empty() || rng() % 3 != 0)) {
+				int &item = dummy[rng() % 600];
+				unsigned id = table.Insert(item);
+				CPPUNIT_ASSERT(id > 0 && id < 1000);
+				CPPUNIT_ASSERT(reference.find(id) == reference.end());
+				reference[id] = &item;
+			} else {
+				auto i = reference.begin();
+				std::advance(i, rng() % reference.size());
+				table.Erase(i->first);
+				reference.erase(i);
+			}
+
+			if (step % 1000 == 0)
+				for (unsigned id = 0; id < 1100; ++id) {
+					auto i = reference.find(id);
+					CPPUNIT_ASSERT_EQUAL(i != reference.end()
+							     ? i->second
+							     : (int *)nullptr,
+							     table.Lookup(id));
+				}
+		}
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(QueueTreeTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,116 @@
+/*
+ * Unit tests for class SeekTableCache.
+ */
+
+#include "config.h"
+#include "decoder/SeekTableCache.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdlib.h>
+
+static std::vector<uint32_t>
+MakeTable(unsigned n)
+{
+	std::vector<uint32_t> offsets;
+	for (unsigned i = 0; i < n; ++i)
+		offsets.push_back(i * 417);
+	return offsets;
+}
+
+class SeekTableCacheTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SeekTableCacheTest);
+	CPPUNIT_TEST(TestLookup);
+	CPPUNIT_TEST(TestModified);
+	CPPUNIT_TEST(TestEvict);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestLookup() {
+		SeekTableCache cache(65536);
+		std::vector<uint32_t> offsets;
+
+		CPPUNIT_ASSERT(!cache.Lookup("/a.mp3", 100000, offsets));
+
+		cache.Store("/a.mp3", 100000, MakeTable(100));
+		CPPUNIT_ASSERT(cache.Lookup("/a.mp3", 100000, offsets));
+		CPPUNIT_ASSERT_EQUAL(size_t(100), offsets.size());
+		CPPUNIT_ASSERT_EQUAL(uint32_t(99 * 417), offsets.back());
+
+		/* a shorter table does not replace a longer one */
+		cache.Store("/a.mp3", 100000, MakeTable(50));
+		CPPUNIT_ASSERT(cache.Lookup("/a.mp3", 100000, offsets));
+		CPPUNIT_ASSERT_EQUAL(size_t(100), offsets.size());
+
+		/* a longer one does */
+		cache.Store("/a.mp3", 100000, MakeTable(200));
+		CPPUNIT_ASSERT(cache.Lookup("/a.mp3", 100000, offsets));
+		CPPUNIT_ASSERT_EQUAL(size_t(200), offsets.size());
+		CPPUNIT_ASSERT_EQUAL(1u, cache.GetSize());
+
+		cache.Clear();
+		CPPUNIT_ASSERT_EQUAL(0u, cache.GetSize());
+		CPPUNIT_ASSERT_EQUAL(size_t(0), cache.GetMemorySize());
+		CPPUNIT_ASSERT(!cache.Lookup("/a.mp3", 100000, offsets));
+	}
+
+	void TestModified() {
+		SeekTableCache cache(65536);
+		std::vector<uint32_t> offsets;
+
+		cache.Store("/a.mp3", 100000, MakeTable(100));
+		CPPUNIT_ASSERT(!cache.Lookup("/a.mp3", 100001, offsets));
+
+		/* the stale entry has been removed */
+		CPPUNIT_ASSERT_EQUAL(0u, cache.GetSize());
+		CPPUNIT_ASSERT_EQUAL(size_t(0), cache.GetMemorySize());
+
+		/* a different size replaces the entry, even if the
+		   table is shorter */
+		cache.Store("/a.mp3", 100000, MakeTable(100));
+		cache.Store("/a.mp3", 200000, MakeTable(10));
+		CPPUNIT_ASSERT(cache.Lookup("/a.mp3", 200000, offsets));
+		CPPUNIT_ASSERT_EQUAL(size_t(10), offsets.size());
+	}
+
+	void TestEvict() {
+		/* room for two tables of 1000 frames */
+		SeekTableCache cache(10000);
+		std::vector<uint32_t> offsets;
+
+		cache.Store("/a.mp3", 1, MakeTable(1000));
+		cache.Store("/b.mp3", 1, MakeTable(1000));
+		CPPUNIT_ASSERT_EQUAL(2u, cache.GetSize());
+
+		/* "a" becomes the most recently used entry, so "b"
+		   gets evicted */
+		CPPUNIT_ASSERT(cache.Lookup("/a.mp3", 1, offsets));
+		cache.Store("/c.mp3", 1, MakeTable(1000));
+
+		CPPUNIT_ASSERT_EQUAL(2u, cache.GetSize());
+		CPPUNIT_ASSERT(cache.GetMemorySize() <= 10000);
+		CPPUNIT_ASSERT(cache.Lookup("/a.mp3", 1, offsets));
+		CPPUNIT_ASSERT(!cache.Lookup("/b.mp3", 1, offsets));
+		CPPUNIT_ASSERT(cache.Lookup("/c.mp3", 1, offsets));
+
+		/* a table larger than the whole cache is not stored */
+		cache.Store("/d.mp3", 1, MakeTable(5000));
+		CPPUNIT_ASSERT(!cache.Lookup("/d.mp3", 1, offsets));
+		CPPUNIT_ASSERT_EQUAL(2u, cache.GetSize());
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SeekTableCacheTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
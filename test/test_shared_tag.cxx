@@ -0,0 +1,105 @@
+/*
+ * Unit tests for class SharedTag.
+ */
+
+#include "config.h"
+#include "tag/SharedTag.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string.h>
+#include <stdlib.h>
+
+static Tag
+MakeTag(const char *artist, const char *title)
+{
+	TagBuilder builder;
+	builder.AddItem(TAG_ARTIST, artist);
+	builder.AddItem(TAG_TITLE, title);
+	return builder.Commit();
+}
+
+class SharedTagTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SharedTagTest);
+	CPPUNIT_TEST(TestEmpty);
+	CPPUNIT_TEST(TestShare);
+	CPPUNIT_TEST(TestRelease);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestEmpty() {
+		SharedTag a, b(Tag{});
+		CPPUNIT_ASSERT(a == b);
+		CPPUNIT_ASSERT(a->IsEmpty());
+		CPPUNIT_ASSERT(!b->IsDefined());
+	}
+
+	void TestShare() {
+		const unsigned n = SharedTag::GetPoolSize();
+
+		SharedTag a(MakeTag("foo", "bar"));
+		const Tag tmp = MakeTag("foo", "bar");
+		SharedTag b(tmp);
+		SharedTag c(MakeTag("foo", "baz"));
+
+		/* equal tags share one block */
+		CPPUNIT_ASSERT(a == b);
+		CPPUNIT_ASSERT(&*a == &*b);
+		CPPUNIT_ASSERT(a != c);
+		CPPUNIT_ASSERT_EQUAL(n + 2, SharedTag::GetPoolSize());
+
+		CPPUNIT_ASSERT(strcmp(a->GetValue(TAG_TITLE), "bar") == 0);
+		CPPUNIT_ASSERT(strcmp(c->GetValue(TAG_TITLE), "baz") == 0);
+
+		SharedTag d(c);
+		CPPUNIT_ASSERT(d == c);
+		CPPUNIT_ASSERT_EQUAL(n + 2, SharedTag::GetPoolSize());
+	}
+
+	void TestRelease() {
+		const unsigned n = SharedTag::GetPoolSize();
+
+		SharedTag *a = new SharedTag(MakeTag("a", "b"));
+		SharedTag *b = new SharedTag(*a);
+		CPPUNIT_ASSERT_EQUAL(n + 1, SharedTag::GetPoolSize());
+
+		delete a;
+		CPPUNIT_ASSERT_EQUAL(n + 1, SharedTag::GetPoolSize());
+		CPPUNIT_ASSERT(strcmp((*b)->GetValue(TAG_ARTIST), "a") == 0);
+
+		delete b;
+		CPPUNIT_ASSERT_EQUAL(n, SharedTag::GetPoolSize());
+
+		/* many distinct tags make the pool grow */
+		std::vector<SharedTag> v;
+		for (unsigned i = 0; i < 5000; ++i) {
+			char buffer[16];
+			snprintf(buffer, sizeof(buffer), "%u", i);
+			v.emplace_back(MakeTag("x", buffer));
+		}
+
+		CPPUNIT_ASSERT_EQUAL(n + 5000, SharedTag::GetPoolSize());
+		for (unsigned i = 0; i < 5000; ++i)
+			CPPUNIT_ASSERT(v[i] == SharedTag(MakeTag("x", v[i]->GetValue(TAG_TITLE))));
+
+		v.clear();
+		CPPUNIT_ASSERT_EQUAL(n, SharedTag::GetPoolSize());
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SharedTagTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,121 @@
+/*
+ * Unit tests for class SharedUri and the URI handling of class
+ * DetachedSong.
+ */
+
+#include "config.h"
+#include "SharedUri.hxx"
+#include "DetachedSong.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string.h>
+#include <stdlib.h>
+
+class SharedUriTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SharedUriTest);
+	CPPUNIT_TEST(TestShare);
+	CPPUNIT_TEST(TestEmpty);
+	CPPUNIT_TEST(TestRealURI);
+	CPPUNIT_TEST(TestSetURI);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestShare() {
+		const unsigned n = SharedUri::GetPoolSize();
+
+		{
+			const SharedUri a("foo/bar.ogg");
+			const SharedUri b(std::string("foo/bar.ogg"));
+			const SharedUri c("foo/baz.ogg");
+
+			CPPUNIT_ASSERT(a == b);
+			CPPUNIT_ASSERT(a != c);
+			CPPUNIT_ASSERT_EQUAL(a.c_str(), b.c_str());
+			CPPUNIT_ASSERT(strcmp(c.c_str(), "foo/baz.ogg") == 0);
+			CPPUNIT_ASSERT_EQUAL(size_t(11), c.length());
+			CPPUNIT_ASSERT_EQUAL(n + 2, SharedUri::GetPoolSize());
+
+			SharedUri d(a);
+			d = c;
+			CPPUNIT_ASSERT(d == c);
+			CPPUNIT_ASSERT_EQUAL(n + 2, SharedUri::GetPoolSize());
+		}
+
+		CPPUNIT_ASSERT_EQUAL(n, SharedUri::GetPoolSize());
+	}
+
+	void TestEmpty() {
+		const SharedUri a, b("");
+		CPPUNIT_ASSERT(a.empty());
+		CPPUNIT_ASSERT(b.empty());
+		CPPUNIT_ASSERT(a == b);
+		CPPUNIT_ASSERT(strcmp(a.c_str(), "") == 0);
+	}
+
+	void TestRealURI() {
+		DetachedSong a("foo/bar.ogg"), b("foo/bar.ogg");
+		CPPUNIT_ASSERT(a.IsSame(b));
+		CPPUNIT_ASSERT(a.IsURI("foo/bar.ogg"));
+		CPPUNIT_ASSERT(a.IsURI(SharedUri("foo/bar.ogg")));
+		CPPUNIT_ASSERT(!a.HasRealURI());
+		CPPUNIT_ASSERT(a.GetRealURI() == "foo/bar.ogg");
+		CPPUNIT_ASSERT(a.IsInDatabase());
+
+		/* the music directory prefix is shared */
+		const unsigned n = SharedUri::GetPoolSize();
+		a.SetRealURI("/music/foo/bar.ogg");
+		CPPUNIT_ASSERT_EQUAL(n + 1, SharedUri::GetPoolSize());
+		b.SetRealURI(std::string("/music/foo/bar.ogg"));
+		CPPUNIT_ASSERT_EQUAL(n + 1, SharedUri::GetPoolSize());
+
+		CPPUNIT_ASSERT(a.HasRealURI());
+		CPPUNIT_ASSERT(a.GetRealURI() == "/music/foo/bar.ogg");
+		CPPUNIT_ASSERT(a.IsAbsoluteFile());
+		CPPUNIT_ASSERT(!a.IsRemote());
+
+		/* a real URI which doesn't end with the URI */
+		a.SetRealURI("http://example.com/x.ogg");
+		CPPUNIT_ASSERT(a.GetRealURI() == "http://example.com/x.ogg");
+		CPPUNIT_ASSERT(a.IsRemote());
+		CPPUNIT_ASSERT(!a.IsAbsoluteFile());
+
+		/* the URI must be preceded by a slash */
+		a.SetRealURI("/musicfoo/bar.ogg");
+		CPPUNIT_ASSERT(a.GetRealURI() == "/musicfoo/bar.ogg");
+
+		b.SetRealURI("smb://server/share/foo/bar.ogg");
+		CPPUNIT_ASSERT(b.IsRemote());
+		CPPUNIT_ASSERT(b.GetRealURI() == "smb://server/share/foo/bar.ogg");
+
+		const DetachedSong c(b);
+		CPPUNIT_ASSERT(c.IsSame(b));
+		CPPUNIT_ASSERT(c.GetRealURI() == b.GetRealURI());
+	}
+
+	void TestSetURI() {
+		DetachedSong a("foo/bar.ogg");
+		a.SetRealURI("/music/foo/bar.ogg");
+
+		/* changing the URI must not change the real URI */
+		a.SetURI("Artist - Title.ogg");
+		CPPUNIT_ASSERT(strcmp(a.GetURI(), "Artist - Title.ogg") == 0);
+		CPPUNIT_ASSERT(a.GetRealURI() == "/music/foo/bar.ogg");
+		CPPUNIT_ASSERT(!a.IsSame(DetachedSong("foo/bar.ogg")));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SharedUriTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
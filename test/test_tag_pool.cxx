@@ -0,0 +1,265 @@
+/*
+ * Unit tests for the TagItem pool.
+ */
+
+#include "config.h"
+#include "tag/TagPool.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagItem.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <thread>
+#include <vector>
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static TagItem *
+Get(TagType type, const char *value)
+{
+	const ScopeLock protect(tag_pool_lock);
+	return tag_pool_get_item(type, value, strlen(value));
+}
+
+static void
+Put(TagItem *item)
+{
+	tag_pool_put_item(item);
+}
+
+class TagPoolTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TagPoolTest);
+	CPPUNIT_TEST(TestShare);
+	CPPUNIT_TEST(TestManyReferences);
+	CPPUNIT_TEST(TestGrow);
+	CPPUNIT_TEST(TestIntern);
+	CPPUNIT_TEST(TestConcurrent);
+	CPPUNIT_TEST(TestBuilder);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestShare() {
+		const size_t n = tag_pool_get_stats().items;
+
+		TagItem *a = Get(TAG_ARTIST, "foo");
+		TagItem *b = Get(TAG_ARTIST, "foo");
+		TagItem *c = Get(TAG_ALBUM, "foo");
+		TagItem *d = Get(TAG_ARTIST, "fo");
+
+		CPPUNIT_ASSERT(a == b);
+		CPPUNIT_ASSERT(a != c);
+		CPPUNIT_ASSERT(a != d);
+		CPPUNIT_ASSERT_EQUAL(TAG_ALBUM, c->type);
+		CPPUNIT_ASSERT(strcmp(d->value, "fo") == 0);
+		CPPUNIT_ASSERT_EQUAL(n + 3, tag_pool_get_stats().items);
+
+		Put(a);
+		CPPUNIT_ASSERT_EQUAL(n + 3, tag_pool_get_stats().items);
+		CPPUNIT_ASSERT(strcmp(b->value, "foo") == 0);
+
+		Put(b);
+		Put(c);
+		Put(d);
+		CPPUNIT_ASSERT_EQUAL(n, tag_pool_get_stats().items);
+	}
+
+	void TestManyReferences() {
+		/* the reference counter used to overflow at 255,
+		   which duplicated popular values */
+		std::vector<TagItem *> v;
+		for (unsigned i = 0; i < 1000; ++i)
+			v.push_back(Get(TAG_ALBUM_ARTIST, "Various Artists"));
+
+		for (auto *i : v)
+			CPPUNIT_ASSERT(i == v.front());
+
+		for (unsigned i = 0; i < 1000; ++i)
+			v.push_back(tag_pool_dup_item(v.front()));
+
+		CPPUNIT_ASSERT(v.back() == v.front());
+
+		for (auto *i : v)
+			Put(i);
+	}
+
+	void TestGrow() {
+		const auto before = tag_pool_get_stats();
+
+		std::vector<TagItem *> v;
+		char buffer[32];
+		for (unsigned i = 0; i < 50000; ++i) {
+			snprintf(buffer, sizeof(buffer), "title %u", i);
+			v.push_back(Get(TAG_TITLE, buffer));
+		}
+
+		const auto grown = tag_pool_get_stats();
+		CPPUNIT_ASSERT_EQUAL(before.items + 50000, grown.items);
+		CPPUNIT_ASSERT(grown.buckets > grown.items);
+
+		/* all values can still be found, and removing every
+		   other one keeps the probe sequences intact */
+		for (unsigned i = 0; i < 50000; i += 2)
+			Put(v[i]);
+
+		for (unsigned i = 1; i < 50000; i += 2) {
+			snprintf(buffer, sizeof(buffer), "title %u", i);
+			TagItem *item = Get(TAG_TITLE, buffer);
+			CPPUNIT_ASSERT(item == v[i]);
+			Put(item);
+		}
+
+		for (unsigned i = 1; i < 50000; i += 2)
+			Put(v[i]);
+
+		const auto after = tag_pool_get_stats();
+		CPPUNIT_ASSERT_EQUAL(before.items, after.items);
+		CPPUNIT_ASSERT(after.buckets < grown.buckets);
+	}
+
+	void TestIntern() {
+		const size_t n = tag_pool_get_stats().items;
+
+		/* new items are not in the pool */
+		TagItem *a = tag_pool_new_item(TAG_GENRE, "Jazz", 4);
+		TagItem *b = tag_pool_new_item(TAG_GENRE, "Jazz", 4);
+		CPPUNIT_ASSERT(a != b);
+		CPPUNIT_ASSERT(strcmp(a->value, "Jazz") == 0);
+		CPPUNIT_ASSERT_EQUAL(n, tag_pool_get_stats().items);
+
+		TagItem *c = tag_pool_new_item(TAG_GENRE, "Soul", 4);
+
+		{
+			const ScopeLock protect(tag_pool_lock);
+
+			/* the first one becomes the shared copy, the
+			   second one is replaced by it */
+			CPPUNIT_ASSERT(tag_pool_intern_item(a) == a);
+			CPPUNIT_ASSERT(tag_pool_intern_item(b) == a);
+			CPPUNIT_ASSERT(tag_pool_intern_item(a) == a);
+			CPPUNIT_ASSERT(tag_pool_get_item(TAG_GENRE, "Jazz", 4) == a);
+			CPPUNIT_ASSERT_EQUAL(n + 1, num_items_locked());
+
+			/* a new item which is still referenced
+			   elsewhere */
+			TagItem *d = tag_pool_dup_item(c);
+			CPPUNIT_ASSERT(tag_pool_intern_item(d) == c);
+			CPPUNIT_ASSERT(tag_pool_get_item(TAG_GENRE, "Soul", 4) == c);
+		}
+
+		/* releasing the last reference locks the mutex */
+		for (unsigned i = 0; i < 3; ++i)
+			tag_pool_put_item(a);
+		for (unsigned i = 0; i < 3; ++i)
+			tag_pool_put_item(c);
+
+		CPPUNIT_ASSERT_EQUAL(n, tag_pool_get_stats().items);
+
+		/* freeing a new item doesn't touch the hash table */
+		tag_pool_put_item(tag_pool_new_item(TAG_GENRE, "Jazz", 4));
+		CPPUNIT_ASSERT_EQUAL(n, tag_pool_get_stats().items);
+	}
+
+	void TestConcurrent() {
+		const size_t n = tag_pool_get_stats().items;
+
+		/* several threads copy and release references of the
+		   same items, and look them up again, while the
+		   last references are released in between */
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < 4; ++t) {
+			threads.emplace_back([t](){
+					char buffer[32];
+					std::vector<TagItem *> v;
+					for (unsigned i = 0; i < 20000; ++i) {
+						snprintf(buffer, sizeof(buffer),
+							 "value %u", i % 64);
+						TagItem *item = Get(TAG_COMMENT, buffer);
+						v.push_back(item);
+						v.push_back(tag_pool_dup_item(item));
+
+						if (tag_pool_get_folded(*item) == nullptr)
+							tag_pool_set_folded(*item, buffer,
+									    strlen(buffer));
+
+						if (v.size() > 32 + t * 8) {
+							for (auto *j : v)
+								Put(j);
+							v.clear();
+						}
+					}
+
+					for (auto *j : v)
+						Put(j);
+				});
+		}
+
+		for (auto &t : threads)
+			t.join();
+
+		CPPUNIT_ASSERT_EQUAL(n, tag_pool_get_stats().items);
+	}
+
+	void TestBuilder() {
+		const size_t n = tag_pool_get_stats().items;
+
+		TagBuilder builder;
+		builder.AddItem(TAG_ARTIST, "foo");
+		builder.AddItem(TAG_ALBUM_ARTIST, "foo");
+		builder.AddItem(TAG_ARTIST, "foo");
+		CPPUNIT_ASSERT_EQUAL(n, tag_pool_get_stats().items);
+		CPPUNIT_ASSERT(builder.HasType(TAG_ALBUM_ARTIST));
+
+		Tag tag = builder.Commit();
+		CPPUNIT_ASSERT_EQUAL(n + 2, tag_pool_get_stats().items);
+		CPPUNIT_ASSERT_EQUAL(3u, unsigned(tag.num_items));
+		CPPUNIT_ASSERT(tag.items[0] == tag.items[2]);
+		CPPUNIT_ASSERT(tag.items[0] == Get(TAG_ARTIST, "foo"));
+		Put(tag.items[0]);
+
+		/* transient tags don't use the pool at all */
+		TagBuilder transient;
+		transient.SetTransient();
+		transient.AddItem(TAG_TITLE, "bar");
+		transient.AddItem(TAG_TITLE, "bar");
+		Tag tag2 = transient.Commit();
+		CPPUNIT_ASSERT_EQUAL(n + 2, tag_pool_get_stats().items);
+		CPPUNIT_ASSERT(tag2.items[0] != tag2.items[1]);
+		CPPUNIT_ASSERT(strcmp(tag2.GetValue(TAG_TITLE), "bar") == 0);
+
+		/* merging them into a regular tag interns them */
+		Tag *merged = Tag::Merge(tag, tag2);
+		CPPUNIT_ASSERT_EQUAL(n + 3, tag_pool_get_stats().items);
+
+		delete merged;
+		tag2.Clear();
+		tag.Clear();
+		CPPUNIT_ASSERT_EQUAL(n, tag_pool_get_stats().items);
+	}
+
+private:
+	static size_t num_items_locked() {
+		/* tag_pool_get_stats() would lock the mutex again */
+		tag_pool_lock.unlock();
+		const size_t n = tag_pool_get_stats().items;
+		tag_pool_lock.lock();
+		return n;
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TagPoolTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
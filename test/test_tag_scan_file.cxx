@@ -0,0 +1,196 @@
+/*
+ * Unit tests for src/tag/TagScanFile.cxx and the readers using it.
+ */
+
+#include "config.h"
+#include "tag/TagScanFile.hxx"
+#include "tag/HeaderReader.hxx"
+#include "tag/ApeLoader.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <map>
+#include <string>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * A #TagScanFile in memory which counts the reads from the
+ * "underlying file".
+ */
+class MemoryTagScanFile final : public TagScanFile {
+	const std::string data;
+
+public:
+	unsigned raw_reads = 0;
+
+	explicit MemoryTagScanFile(std::string &&_data)
+		:data(std::move(_data)) {
+		SetSize(data.size());
+	}
+
+protected:
+	size_t ReadRaw(uint64_t offset, void *dest, size_t length) override {
+		++raw_reads;
+
+		if (offset >= data.size())
+			return 0;
+
+		length = std::min(length, size_t(data.size() - offset));
+		memcpy(dest, data.data() + offset, length);
+		return length;
+	}
+};
+
+static std::string
+MakePattern(size_t size)
+{
+	std::string s;
+	for (size_t i = 0; i < size; ++i)
+		s.push_back(char(i * 7));
+	return s;
+}
+
+static void
+AppendLE32(std::string &s, uint32_t value)
+{
+	for (unsigned i = 0; i < 4; ++i)
+		s.push_back(char(value >> (8 * i)));
+}
+
+static void
+AppendApeItem(std::string &s, const char *key, const char *value)
+{
+	AppendLE32(s, strlen(value));
+	AppendLE32(s, 0);
+	s.append(key);
+	s.push_back(0);
+	s.append(value);
+}
+
+class TagScanFileTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TagScanFileTest);
+	CPPUNIT_TEST(TestCache);
+	CPPUNIT_TEST(TestSmall);
+	CPPUNIT_TEST(TestHeaderReader);
+	CPPUNIT_TEST(TestApe);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestCache() {
+		const std::string data = MakePattern(100000);
+		MemoryTagScanFile file{std::string(data)};
+
+		char buffer[256];
+
+		/* the head is read once */
+		CPPUNIT_ASSERT(file.ReadAt(0, buffer, 10));
+		CPPUNIT_ASSERT(memcmp(buffer, data.data(), 10) == 0);
+		CPPUNIT_ASSERT(file.ReadAt(100, buffer, 200));
+		CPPUNIT_ASSERT(memcmp(buffer, data.data() + 100, 200) == 0);
+		CPPUNIT_ASSERT_EQUAL(1u, file.raw_reads);
+
+		/* the tail is read once */
+		CPPUNIT_ASSERT(file.ReadAt(data.size() - 128, buffer, 128));
+		CPPUNIT_ASSERT(memcmp(buffer, data.data() + data.size() - 128,
+				      128) == 0);
+		CPPUNIT_ASSERT(file.ReadAt(data.size() - 138, buffer, 10));
+		CPPUNIT_ASSERT(memcmp(buffer, data.data() + data.size() - 138,
+				      10) == 0);
+		CPPUNIT_ASSERT_EQUAL(2u, file.raw_reads);
+
+		/* the middle is not cached */
+		CPPUNIT_ASSERT(file.ReadAt(50000, buffer, sizeof(buffer)));
+		CPPUNIT_ASSERT(memcmp(buffer, data.data() + 50000,
+				      sizeof(buffer)) == 0);
+		CPPUNIT_ASSERT_EQUAL(3u, file.raw_reads);
+
+		/* beyond the end */
+		CPPUNIT_ASSERT(!file.ReadAt(data.size() - 5, buffer, 10));
+		CPPUNIT_ASSERT(!file.ReadAt(data.size() + 1, buffer, 1));
+		CPPUNIT_ASSERT(file.ReadAt(data.size(), buffer, 0));
+	}
+
+	void TestSmall() {
+		/* a file which fits into the head cache */
+		const std::string data = MakePattern(100);
+		MemoryTagScanFile file{std::string(data)};
+
+		char buffer[100];
+		CPPUNIT_ASSERT(file.ReadAt(0, buffer, sizeof(buffer)));
+		CPPUNIT_ASSERT(memcmp(buffer, data.data(), sizeof(buffer)) == 0);
+		CPPUNIT_ASSERT(file.ReadAt(90, buffer, 10));
+		CPPUNIT_ASSERT(memcmp(buffer, data.data() + 90, 10) == 0);
+		CPPUNIT_ASSERT_EQUAL(1u, file.raw_reads);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(100), file.GetBytesRead());
+	}
+
+	void TestHeaderReader() {
+		const std::string data = MakePattern(20000);
+		MemoryTagScanFile file{std::string(data)};
+		HeaderReader reader(file);
+
+		char buffer[16];
+		CPPUNIT_ASSERT(reader.Read(buffer, 4));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(4), reader.Tell());
+		CPPUNIT_ASSERT(reader.Skip(10000));
+		CPPUNIT_ASSERT(reader.Read(buffer, sizeof(buffer)));
+		CPPUNIT_ASSERT(memcmp(buffer, data.data() + 10004,
+				      sizeof(buffer)) == 0);
+
+		CPPUNIT_ASSERT(reader.Seek(data.size() - 6));
+		CPPUNIT_ASSERT_EQUAL(size_t(6),
+				     reader.ReadSome(buffer, sizeof(buffer)));
+		CPPUNIT_ASSERT(!reader.Read(buffer, 1));
+		CPPUNIT_ASSERT(!reader.Skip(1));
+		CPPUNIT_ASSERT(!reader.Seek(data.size() + 1));
+	}
+
+	void TestApe() {
+		std::string items;
+		AppendApeItem(items, "Artist", "Foo");
+		AppendApeItem(items, "Title", "Bar");
+
+		std::string data = MakePattern(30000);
+		data.append(items);
+		data.append("APETAGEX");
+		AppendLE32(data, 2000);
+		AppendLE32(data, items.size() + 32);
+		AppendLE32(data, 2);
+		data.append(12, '\0');
+
+		MemoryTagScanFile file(std::move(data));
+
+		std::map<std::string, std::string> values;
+		CPPUNIT_ASSERT(tag_ape_scan(file,
+					    [&values](unsigned long, const char *key,
+						      const char *value,
+						      size_t length){
+						    values[key] = std::string(value, length);
+						    return true;
+					    }));
+		CPPUNIT_ASSERT_EQUAL(size_t(2), values.size());
+		CPPUNIT_ASSERT_EQUAL(std::string("Foo"), values["Artist"]);
+		CPPUNIT_ASSERT_EQUAL(std::string("Bar"), values["Title"]);
+
+		/* footer and items were served from the tail cache */
+		CPPUNIT_ASSERT_EQUAL(1u, file.raw_reads);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TagScanFileTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
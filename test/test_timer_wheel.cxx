@@ -0,0 +1,156 @@
+/*
+ * Unit tests for class TimerWheel.
+ */
+
+#include "config.h"
+#include "event/TimerWheel.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+
+#include <stdlib.h>
+
+typedef TimerWheel::Timer Timer;
+
+/**
+ * Advance the wheel in the given steps, and verify that each timer
+ * pops exactly at its due time.
+ */
+static void
+Drain(TimerWheel &wheel, uint64_t end, uint64_t step)
+{
+	for (uint64_t now = wheel.GetNow(); now <= end; now += step) {
+		Timer *t;
+		while ((t = wheel.Pop(now)) != nullptr) {
+			CPPUNIT_ASSERT(t->GetDue() <= now);
+			CPPUNIT_ASSERT(t->GetDue() + step > now);
+			CPPUNIT_ASSERT(!t->IsScheduled());
+		}
+	}
+}
+
+class TimerWheelTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TimerWheelTest);
+	CPPUNIT_TEST(TestSimple);
+	CPPUNIT_TEST(TestRemove);
+	CPPUNIT_TEST(TestNextEvent);
+	CPPUNIT_TEST(TestCascade);
+	CPPUNIT_TEST(TestFar);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestSimple() {
+		TimerWheel wheel(1000);
+		CPPUNIT_ASSERT(wheel.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(UINT64_MAX, wheel.GetNextEvent());
+
+		Timer a, b, c;
+		wheel.Add(a, 1010);
+		wheel.Add(b, 1005);
+		wheel.Add(c, 500);
+		CPPUNIT_ASSERT(!wheel.IsEmpty());
+		CPPUNIT_ASSERT(a.IsScheduled());
+
+		/* due times in the past are treated as "now" */
+		CPPUNIT_ASSERT_EQUAL(uint64_t(1000), c.GetDue());
+		CPPUNIT_ASSERT_EQUAL(&c, wheel.Pop(1000));
+		CPPUNIT_ASSERT(wheel.Pop(1000) == nullptr);
+
+		CPPUNIT_ASSERT(wheel.Pop(1004) == nullptr);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(1004), wheel.GetNow());
+
+		CPPUNIT_ASSERT_EQUAL(&b, wheel.Pop(1020));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(1005), wheel.GetNow());
+		CPPUNIT_ASSERT_EQUAL(&a, wheel.Pop(1020));
+		CPPUNIT_ASSERT(wheel.Pop(1020) == nullptr);
+		CPPUNIT_ASSERT(wheel.IsEmpty());
+	}
+
+	void TestRemove() {
+		TimerWheel wheel;
+
+		Timer a, b;
+		wheel.Add(a, 100);
+		wheel.Add(b, 100000);
+		wheel.Remove(a);
+		wheel.Remove(a);
+		CPPUNIT_ASSERT(!a.IsScheduled());
+		CPPUNIT_ASSERT(!wheel.IsEmpty());
+
+		/* moving a timer */
+		wheel.Add(b, 50);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(50), wheel.GetNextEvent());
+
+		wheel.Remove(b);
+		CPPUNIT_ASSERT(wheel.IsEmpty());
+		CPPUNIT_ASSERT(wheel.Pop(1000000) == nullptr);
+	}
+
+	void TestNextEvent() {
+		TimerWheel wheel(10);
+
+		Timer a;
+		wheel.Add(a, 30);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(30), wheel.GetNextEvent());
+
+		/* level 1: the wheel wakes up at the beginning of the
+		   slot to cascade it */
+		wheel.Add(a, 200);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(192), wheel.GetNextEvent());
+		CPPUNIT_ASSERT(wheel.Pop(192) == nullptr);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(200), wheel.GetNextEvent());
+		CPPUNIT_ASSERT_EQUAL(&a, wheel.Pop(200));
+	}
+
+	void TestCascade() {
+		TimerWheel wheel(12345);
+
+		std::vector<Timer> timers(5000);
+		unsigned seed = 42;
+		for (auto &t : timers) {
+			seed = seed * 1103515245 + 12345;
+			wheel.Add(t, 12345 + (seed >> 8) % 300000);
+		}
+
+		Drain(wheel, 12345 + 300000, 1);
+		CPPUNIT_ASSERT(wheel.IsEmpty());
+
+		for (auto &t : timers) {
+			seed = seed * 1103515245 + 12345;
+			wheel.Add(t, wheel.GetNow() + (seed >> 8) % 1000000);
+		}
+
+		Drain(wheel, wheel.GetNow() + 1000000, 997);
+		CPPUNIT_ASSERT(wheel.IsEmpty());
+	}
+
+	void TestFar() {
+		TimerWheel wheel(0xfffffff0);
+
+		Timer a, b;
+		wheel.Add(a, 0xfffffff0 + 0xffffffffull);
+		wheel.Add(b, 0xfffffff0 + 1000);
+
+		CPPUNIT_ASSERT_EQUAL(&b, wheel.Pop(0x200000000ull));
+		CPPUNIT_ASSERT_EQUAL(&a, wheel.Pop(0x200000000ull));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0xfffffff0 + 0xffffffffull),
+				     wheel.GetNow());
+		CPPUNIT_ASSERT(wheel.Pop(0x200000000ull) == nullptr);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TimerWheelTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
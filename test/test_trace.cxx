@@ -0,0 +1,131 @@
+/*
+ * Unit tests for src/system/Trace.cxx
+ */
+
+#include "config.h"
+#include "system/Trace.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <atomic>
+#include <thread>
+
+#include <stdlib.h>
+#include <string.h>
+
+static const TraceThreadSnapshot *
+FindThread(const std::vector<TraceThreadSnapshot> &threads,
+	   const char *first_event)
+{
+	for (const auto &t : threads)
+		if (!t.events.empty() &&
+		    strcmp(t.events.front().name, first_event) == 0)
+			return &t;
+
+	return nullptr;
+}
+
+class TraceTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TraceTest);
+	CPPUNIT_TEST(TestScope);
+	CPPUNIT_TEST(TestOverflow);
+	CPPUNIT_TEST(TestConcurrent);
+	CPPUNIT_TEST_SUITE_END();
+
+	static void Reset() {
+		trace_enabled = false;
+		trace_free_buffers();
+	}
+
+public:
+	void TestScope() {
+		{
+			ScopeTrace trace("disabled");
+		}
+
+		trace_enabled = true;
+
+		std::thread thread([](){
+				ScopeTrace trace("scope");
+				trace.SetArgument(42);
+			});
+		thread.join();
+
+		const auto threads = trace_snapshot();
+		CPPUNIT_ASSERT_EQUAL(size_t(1), threads.size());
+		CPPUNIT_ASSERT_EQUAL(size_t(1), threads.front().events.size());
+
+		const TraceEvent &e = threads.front().events.front();
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(e.name, "scope"));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(42), e.arg);
+		CPPUNIT_ASSERT(e.start_us > 0);
+
+		Reset();
+	}
+
+	void TestOverflow() {
+		trace_enabled = true;
+
+		std::thread thread([](){
+				for (unsigned i = 0; i < 100000; ++i)
+					trace_add("overflow", i, i + 1, i);
+			});
+		thread.join();
+
+		const auto threads = trace_snapshot();
+		const auto *t = FindThread(threads, "overflow");
+		CPPUNIT_ASSERT(t != nullptr);
+
+		/* only the newest events are kept, in order */
+		CPPUNIT_ASSERT(t->events.size() < 100000);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(99999), t->events.back().arg);
+		for (size_t i = 1; i < t->events.size(); ++i)
+			CPPUNIT_ASSERT_EQUAL(t->events[i - 1].arg + 1,
+					     t->events[i].arg);
+
+		Reset();
+	}
+
+	void TestConcurrent() {
+		trace_enabled = true;
+
+		std::atomic_bool stop(false);
+		std::thread thread([&stop](){
+				for (uint64_t i = 0; !stop; ++i)
+					trace_add("concurrent", i, i, i);
+			});
+
+		/* snapshots taken while the writer is running must
+		   never contain overwritten events */
+		for (unsigned n = 0; n < 50; ++n) {
+			const auto threads = trace_snapshot();
+			const auto *t = FindThread(threads, "concurrent");
+			if (t == nullptr)
+				continue;
+
+			for (size_t i = 1; i < t->events.size(); ++i)
+				CPPUNIT_ASSERT_EQUAL(t->events[i - 1].arg + 1,
+						     t->events[i].arg);
+		}
+
+		stop = true;
+		thread.join();
+
+		Reset();
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TraceTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -7,6 +7,8 @@
 #include "SplitStringTest.hxx"
 #include "UriUtilTest.hxx"
 #include "TestCircularBuffer.hxx"
+#include "TestLockFreeCircularBuffer.hxx"
+#include "UTF8Test.hxx"
 
 #include <cppunit/TestFixture.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
@@ -19,6 +21,8 @@ CPPUNIT_TEST_SUITE_REGISTRATION(DivideStringTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(SplitStringTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(UriUtilTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(TestCircularBuffer);
+CPPUNIT_TEST_SUITE_REGISTRATION(TestLockFreeCircularBuffer);
+CPPUNIT_TEST_SUITE_REGISTRATION(UTF8Test);
 
 int
 main(gcc_unused int argc, gcc_unused char **argv)
@@ -0,0 +1,448 @@
+/*
+ * Unit tests for class DatabaseWalkCursor.
+ */
+
+#include "config.h"
+#include "db/WalkCursor.hxx"
+#include "db/Interface.hxx"
+#include "db/DatabasePlugin.hxx"
+#include "db/DatabaseError.hxx"
+#include "db/Selection.hxx"
+#include "db/LightSong.hxx"
+#include "db/LightDirectory.hxx"
+#include "db/PlaylistInfo.hxx"
+#include "tag/Tag.hxx"
+#include "util/Error.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+static const DatabasePlugin fake_database_plugin = {
+	"fake",
+	0,
+	nullptr,
+};
+
+/**
+ * A database in memory which can be modified by the test while a
+ * #DatabaseWalkCursor is visiting it, just like the update thread
+ * does.
+ */
+class FakeDatabase final : public Database {
+	struct FakeDirectory {
+		time_t mtime;
+		std::vector<std::string> songs, playlists, children;
+	};
+
+	std::map<std::string, FakeDirectory> directories;
+
+	const Tag tag;
+
+public:
+	time_t stamp = 1;
+
+	/**
+	 * The number of entities passed to a visitor so far.
+	 */
+	mutable unsigned n_visited = 0;
+
+	FakeDatabase():Database(fake_database_plugin) {
+		directories[""].mtime = 0;
+	}
+
+	void AddDirectory(const std::string &parent, const char *name) {
+		const std::string uri = parent.empty()
+			? std::string(name)
+			: parent + "/" + name;
+		directories[parent].children.push_back(name);
+		directories[uri].mtime = directories.size();
+	}
+
+	void AddSong(const std::string &parent, const char *name) {
+		directories[parent].songs.push_back(name);
+	}
+
+	void AddPlaylist(const std::string &parent, const char *name) {
+		directories[parent].playlists.push_back(name);
+	}
+
+	void RemoveDirectory(const std::string &parent, const char *name) {
+		auto &children = directories[parent].children;
+		for (auto i = children.begin(); i != children.end(); ++i) {
+			if (*i == name) {
+				children.erase(i);
+				break;
+			}
+		}
+
+		directories.erase(parent.empty()
+				  ? std::string(name)
+				  : parent + "/" + name);
+	}
+
+	/* virtual methods from class Database */
+	const LightSong *GetSong(gcc_unused const char *uri,
+				 Error &error) const override {
+		error.Set(db_domain, DB_NOT_FOUND, "No such song");
+		return nullptr;
+	}
+
+	void ReturnSong(gcc_unused const LightSong *song) const override {}
+
+	bool Visit(const DatabaseSelection &selection,
+		   VisitDirectory visit_directory,
+		   VisitSong visit_song,
+		   VisitPlaylist visit_playlist,
+		   Error &error) const override {
+		auto i = directories.find(selection.uri);
+		if (i == directories.end()) {
+			error.Set(db_domain, DB_NOT_FOUND,
+				  "No such directory");
+			return false;
+		}
+
+		if (selection.recursive && visit_directory) {
+			++n_visited;
+			if (!visit_directory(LightDirectory(i->first.c_str(),
+							    i->second.mtime),
+					     error))
+				return false;
+		}
+
+		return VisitDirectory(i->first, i->second,
+				      selection.recursive,
+				      visit_directory, visit_song,
+				      visit_playlist, error);
+	}
+
+	bool VisitUniqueTags(gcc_unused const DatabaseSelection &selection,
+			     gcc_unused TagType tag_type,
+			     gcc_unused uint32_t group_mask,
+			     gcc_unused VisitTag visit_tag,
+			     gcc_unused Error &error) const override {
+		return true;
+	}
+
+	bool GetStats(gcc_unused const DatabaseSelection &selection,
+		      gcc_unused DatabaseStats &stats,
+		      gcc_unused Error &error) const override {
+		return true;
+	}
+
+	time_t GetUpdateStamp() const override {
+		return stamp;
+	}
+
+private:
+	bool VisitDirectory(const std::string &uri,
+			    const FakeDirectory &directory,
+			    bool recursive,
+			    const ::VisitDirectory &visit_directory,
+			    const VisitSong &visit_song,
+			    const VisitPlaylist &visit_playlist,
+			    Error &error) const {
+		if (visit_song) {
+			for (const auto &name : directory.songs) {
+				LightSong song;
+				song.directory = uri.empty()
+					? nullptr : uri.c_str();
+				song.uri = name.c_str();
+				song.real_uri = nullptr;
+				song.tag = &tag;
+				song.mtime = 0;
+				song.start_time = song.end_time =
+					SongTime::zero();
+
+				++n_visited;
+				if (!visit_song(song, error))
+					return false;
+			}
+		}
+
+		if (visit_playlist) {
+			const LightDirectory parent(uri.c_str(),
+						    directory.mtime);
+			for (const auto &name : directory.playlists) {
+				++n_visited;
+				if (!visit_playlist(PlaylistInfo(name, 0),
+						    parent, error))
+					return false;
+			}
+		}
+
+		for (const auto &name : directory.children) {
+			const std::string child_uri = uri.empty()
+				? name
+				: uri + "/" + name;
+			const auto &child = directories.find(child_uri)->second;
+
+			if (visit_directory) {
+				++n_visited;
+				if (!visit_directory(LightDirectory(child_uri.c_str(),
+								    child.mtime),
+						     error))
+					return false;
+			}
+
+			if (recursive &&
+			    !VisitDirectory(child_uri, child, recursive,
+					    visit_directory, visit_song,
+					    visit_playlist, error))
+				return false;
+		}
+
+		return true;
+	}
+};
+
+/**
+ * Collects the visited entities as strings.
+ */
+struct Collector {
+	std::vector<std::string> entities;
+
+	VisitDirectory MakeDirectoryVisitor() {
+		return [this](const LightDirectory &directory, Error &){
+			entities.push_back(std::string("directory: ") +
+					   directory.uri + " " +
+					   std::to_string(directory.mtime));
+			return true;
+		};
+	}
+
+	VisitSong MakeSongVisitor() {
+		return [this](const LightSong &song, Error &){
+			entities.push_back("file: " + song.GetURI());
+			return true;
+		};
+	}
+
+	VisitPlaylist MakePlaylistVisitor() {
+		return [this](const PlaylistInfo &playlist,
+			      const LightDirectory &directory, Error &){
+			entities.push_back(std::string("playlist: ") +
+					   directory.uri + "/" +
+					   playlist.name);
+			return true;
+		};
+	}
+
+	bool Visit(const Database &db, const char *uri, Error &error) {
+		return db.Visit(DatabaseSelection(uri, true),
+				MakeDirectoryVisitor(), MakeSongVisitor(),
+				MakePlaylistVisitor(), error);
+	}
+
+	bool Visit(const Database &db, DatabaseWalkCursor &cursor,
+		   unsigned limit, Error &error) {
+		return cursor.Visit(db, limit,
+				    MakeDirectoryVisitor(), MakeSongVisitor(),
+				    MakePlaylistVisitor(), error);
+	}
+};
+
+static void
+Populate(FakeDatabase &db)
+{
+	db.AddSong("", "a.mp3");
+	db.AddPlaylist("", "list");
+
+	for (unsigned i = 0; i < 20; ++i) {
+		const std::string name = "dir" + std::to_string(i);
+		db.AddDirectory("", name.c_str());
+
+		for (unsigned j = 0; j < i % 4; ++j)
+			db.AddDirectory(name, ("sub" + std::to_string(j)).c_str());
+
+		for (unsigned j = 0; j < i; ++j)
+			db.AddSong(name, ("song" + std::to_string(j)).c_str());
+
+		if (i % 3 == 0)
+			db.AddPlaylist(name, "list");
+
+		if (i % 4 == 3)
+			for (unsigned j = 0; j < 5; ++j)
+				db.AddSong(name + "/sub1",
+					   ("x" + std::to_string(j)).c_str());
+	}
+}
+
+class WalkCursorTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(WalkCursorTest);
+	CPPUNIT_TEST(TestOrder);
+	CPPUNIT_TEST(TestBase);
+	CPPUNIT_TEST(TestCost);
+	CPPUNIT_TEST(TestUpdate);
+	CPPUNIT_TEST(TestRemoved);
+	CPPUNIT_TEST(TestAdded);
+	CPPUNIT_TEST_SUITE_END();
+
+	/**
+	 * Visit the whole selection in portions and compare with a
+	 * recursive visit.
+	 */
+	static void CheckPortions(const FakeDatabase &db, const char *uri,
+				  unsigned limit) {
+		Error error;
+
+		Collector expected;
+		CPPUNIT_ASSERT(expected.Visit(db, uri, error));
+
+		Collector actual;
+		DatabaseWalkCursor cursor(db, uri, nullptr);
+		while (!cursor.IsFinished()) {
+			const size_t before = actual.entities.size();
+			CPPUNIT_ASSERT(actual.Visit(db, cursor, limit, error));
+
+			/* the base directory is not counted */
+			CPPUNIT_ASSERT(actual.entities.size() - before
+				       <= limit + 1);
+		}
+
+		CPPUNIT_ASSERT(expected.entities == actual.entities);
+	}
+
+public:
+	void TestOrder() {
+		FakeDatabase db;
+		Populate(db);
+
+		for (unsigned limit = 1; limit <= 64; ++limit)
+			CheckPortions(db, "", limit);
+	}
+
+	void TestBase() {
+		FakeDatabase db;
+		Populate(db);
+
+		CheckPortions(db, "dir7", 2);
+		CheckPortions(db, "dir7/sub1", 2);
+
+		/* a non-existing base */
+		DatabaseWalkCursor cursor(db, "nonexistent", nullptr);
+		Collector collector;
+		Error error;
+		CPPUNIT_ASSERT(!collector.Visit(db, cursor, 8, error));
+		CPPUNIT_ASSERT(error.IsDomain(db_domain));
+		CPPUNIT_ASSERT_EQUAL(int(DB_NOT_FOUND), error.GetCode());
+		CPPUNIT_ASSERT(collector.entities.empty());
+	}
+
+	/**
+	 * Each directory is visited only once (unless it is larger
+	 * than a portion), and no entity is visited again.
+	 */
+	void TestCost() {
+		FakeDatabase db;
+		Populate(db);
+
+		Collector expected;
+		Error error;
+		CPPUNIT_ASSERT(expected.Visit(db, "", error));
+		const unsigned n = db.n_visited;
+
+		db.n_visited = 0;
+		Collector actual;
+		DatabaseWalkCursor cursor(db, "", nullptr);
+		while (!cursor.IsFinished())
+			CPPUNIT_ASSERT(actual.Visit(db, cursor, 64, error));
+
+		/* the child directories are visited twice: once in
+		   the parent, once themselves; plus the base */
+		CPPUNIT_ASSERT(db.n_visited <= 2 * n);
+	}
+
+	/**
+	 * An update finishes while the walk is in progress.
+	 */
+	void TestUpdate() {
+		FakeDatabase db;
+		Populate(db);
+
+		Collector collector;
+		Error error;
+		DatabaseWalkCursor cursor(db, "", nullptr);
+		CPPUNIT_ASSERT(collector.Visit(db, cursor, 16, error));
+		CPPUNIT_ASSERT(!cursor.IsFinished());
+
+		db.AddSong("dir19", "new.mp3");
+		++db.stamp;
+
+		const size_t n = collector.entities.size();
+		CPPUNIT_ASSERT(!collector.Visit(db, cursor, 16, error));
+		CPPUNIT_ASSERT(error.IsDomain(db_domain));
+		CPPUNIT_ASSERT_EQUAL(int(DB_MODIFIED), error.GetCode());
+		CPPUNIT_ASSERT_EQUAL(n, collector.entities.size());
+	}
+
+	/**
+	 * A pending directory is deleted by an update which is still
+	 * running, i.e. the update stamp has not been changed yet.
+	 */
+	void TestRemoved() {
+		FakeDatabase db;
+		Populate(db);
+
+		Collector collector;
+		Error error;
+		DatabaseWalkCursor cursor(db, "", nullptr);
+		CPPUNIT_ASSERT(collector.Visit(db, cursor, 16, error));
+
+		/* dir19 is still pending, and the cursor knows its
+		   name */
+		db.RemoveDirectory("", "dir19");
+
+		bool success;
+		while ((success = collector.Visit(db, cursor, 16, error)) &&
+		       !cursor.IsFinished()) {}
+
+		CPPUNIT_ASSERT(!success);
+		CPPUNIT_ASSERT(error.IsDomain(db_domain));
+		CPPUNIT_ASSERT_EQUAL(int(DB_MODIFIED), error.GetCode());
+	}
+
+	/**
+	 * Songs are added to a directory which has not been visited
+	 * yet by an update which is still running; they are visited
+	 * exactly once.
+	 */
+	void TestAdded() {
+		FakeDatabase db;
+		Populate(db);
+
+		Collector collector;
+		Error error;
+		DatabaseWalkCursor cursor(db, "", nullptr);
+		CPPUNIT_ASSERT(collector.Visit(db, cursor, 16, error));
+
+		for (unsigned i = 0; i < 40; ++i)
+			db.AddSong("dir18", ("new" + std::to_string(i)).c_str());
+
+		while (!cursor.IsFinished())
+			CPPUNIT_ASSERT(collector.Visit(db, cursor, 16, error));
+
+		Collector expected;
+		CPPUNIT_ASSERT(expected.Visit(db, "", error));
+		CPPUNIT_ASSERT(expected.entities == collector.entities);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(WalkCursorTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}